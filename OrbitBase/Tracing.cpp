@@ -0,0 +1,148 @@
+#include "OrbitBase/Tracing.h"
+
+#if ORBIT_TRACING_ENABLED
+
+#include <chrono>
+#include <mutex>
+
+#ifdef __linux__
+#include <time.h>
+#endif
+
+namespace orbit {
+namespace tracing {
+
+std::atomic<bool> GIsListening{false};
+
+namespace {
+// Deeper scopes are counted but not recorded.
+constexpr uint32_t kMaxOpenScopes = 64;
+constexpr size_t kBufferSize = 256;
+// Scopes are handed to the listener once this old, when their thread is out
+// of all scopes, rather than waiting for the buffer to fill.
+constexpr uint64_t kMaxBufferLatencyNs = 10'000'000;
+
+std::mutex listener_mutex;
+std::unique_ptr<Listener> listener;
+// Incremented by SetListener, for threads to drop the scopes they started
+// for the previous listener.
+std::atomic<uint32_t> listener_generation{0};
+
+class ThreadBuffer {
+ public:
+  ~ThreadBuffer() { Flush(); }
+
+  void Begin(const char* name) {
+    CheckGeneration();
+    if (depth_ < kMaxOpenScopes) {
+      open_scopes_[depth_] = {name, MonotonicTimestampNs()};
+    }
+    ++depth_;
+  }
+
+  void End() {
+    CheckGeneration();
+    if (depth_ == 0) return;
+    --depth_;
+    if (depth_ >= kMaxOpenScopes) return;
+
+    const OpenScope& open_scope = open_scopes_[depth_];
+    ScopeEvent& event = events_[num_events_++];
+    event.name = open_scope.name;
+    event.begin_ns = open_scope.begin_ns;
+    event.end_ns = MonotonicTimestampNs();
+    event.depth = depth_;
+    if (num_events_ == kBufferSize ||
+        (depth_ == 0 &&
+         event.end_ns - events_[0].end_ns >= kMaxBufferLatencyNs)) {
+      Flush();
+    }
+  }
+
+  void Track(const char* name, double value) {
+    CheckGeneration();
+    VariableEvent& variable = variables_[num_variables_++];
+    variable.name = name;
+    variable.timestamp_ns = MonotonicTimestampNs();
+    variable.value = value;
+    if (num_variables_ == kBufferSize ||
+        variable.timestamp_ns - variables_[0].timestamp_ns >=
+            kMaxBufferLatencyNs) {
+      Flush();
+    }
+  }
+
+ private:
+  struct OpenScope {
+    const char* name;
+    uint64_t begin_ns;
+  };
+
+  void CheckGeneration() {
+    uint32_t generation = listener_generation.load(std::memory_order_relaxed);
+    if (generation != generation_) {
+      generation_ = generation;
+      depth_ = 0;
+      num_events_ = 0;
+      num_variables_ = 0;
+    }
+  }
+
+  void Flush() {
+    if (num_events_ == 0 && num_variables_ == 0) return;
+    std::lock_guard<std::mutex> lock(listener_mutex);
+    if (listener != nullptr && generation_ == listener_generation) {
+      if (num_events_ > 0) listener->OnScopes(events_, num_events_);
+      if (num_variables_ > 0) listener->OnVariables(variables_, num_variables_);
+    }
+    num_events_ = 0;
+    num_variables_ = 0;
+  }
+
+  uint32_t generation_ = 0;
+  uint32_t depth_ = 0;
+  OpenScope open_scopes_[kMaxOpenScopes];
+  size_t num_events_ = 0;
+  ScopeEvent events_[kBufferSize];
+  size_t num_variables_ = 0;
+  VariableEvent variables_[kBufferSize];
+};
+
+thread_local ThreadBuffer thread_buffer;
+}  // namespace
+
+void SetListener(std::unique_ptr<Listener> new_listener) {
+  std::unique_ptr<Listener> old_listener;
+  {
+    std::lock_guard<std::mutex> lock(listener_mutex);
+    old_listener = std::move(listener);
+    listener = std::move(new_listener);
+    ++listener_generation;
+    GIsListening.store(listener != nullptr, std::memory_order_relaxed);
+  }
+}
+
+uint64_t MonotonicTimestampNs() {
+#ifdef __linux__
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return 1'000'000'000ull * ts.tv_sec + ts.tv_nsec;
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+void BeginScope(const char* name) { thread_buffer.Begin(name); }
+
+void EndScope() { thread_buffer.End(); }
+
+void TrackValue(const char* name, double value) {
+  thread_buffer.Track(name, value);
+}
+
+}  // namespace tracing
+}  // namespace orbit
+
+#endif  // ORBIT_TRACING_ENABLED
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "OrbitBase/Tracing.h"
+
+namespace {
+struct RecordedScope {
+  std::string name;
+  uint32_t depth;
+  uint64_t begin_ns;
+  uint64_t end_ns;
+};
+
+class RecordingListener : public orbit::tracing::Listener {
+ public:
+  explicit RecordingListener(std::vector<RecordedScope>* scopes)
+      : scopes_(scopes) {}
+
+  void OnScopes(const orbit::tracing::ScopeEvent* events,
+                size_t count) override {
+    for (size_t i = 0; i < count; ++i) {
+      scopes_->push_back({events[i].name, events[i].depth, events[i].begin_ns,
+                          events[i].end_ns});
+    }
+  }
+
+ private:
+  std::vector<RecordedScope>* scopes_;
+};
+
+void TracedFunction() {
+  ORBIT_SCOPE("Outer");
+  { ORBIT_SCOPE("Inner"); }
+  ORBIT_BEGIN("Manual");
+  ORBIT_END;
+}
+}  // namespace
+
+TEST(Tracing, IsSilentWithoutListener) {
+  orbit::tracing::SetListener(nullptr);
+  EXPECT_FALSE(orbit::tracing::IsListening());
+  TracedFunction();
+}
+
+TEST(Tracing, RecordsScopesOfThreadOnExit) {
+  std::vector<RecordedScope> scopes;
+  orbit::tracing::SetListener(std::make_unique<RecordingListener>(&scopes));
+  // The buffer of the thread is flushed when it exits.
+  std::thread(TracedFunction).join();
+  orbit::tracing::SetListener(nullptr);
+
+  ASSERT_EQ(scopes.size(), 3);
+  EXPECT_EQ(scopes[0].name, "Inner");
+  EXPECT_EQ(scopes[0].depth, 1);
+  EXPECT_EQ(scopes[1].name, "Manual");
+  EXPECT_EQ(scopes[1].depth, 1);
+  EXPECT_EQ(scopes[2].name, "Outer");
+  EXPECT_EQ(scopes[2].depth, 0);
+  EXPECT_LE(scopes[2].begin_ns, scopes[0].begin_ns);
+  EXPECT_GE(scopes[2].end_ns, scopes[1].end_ns);
+}
+
+TEST(Tracing, DropsScopesOfPreviousListener) {
+  std::vector<RecordedScope> scopes;
+  std::thread thread([&scopes] {
+    ORBIT_SCOPE("Started before the listener");
+    orbit::tracing::SetListener(std::make_unique<RecordingListener>(&scopes));
+    { ORBIT_SCOPE("Recorded"); }
+  });
+  thread.join();
+  orbit::tracing::SetListener(nullptr);
+
+  ASSERT_EQ(scopes.size(), 1);
+  EXPECT_EQ(scopes[0].name, "Recorded");
+  EXPECT_EQ(scopes[0].depth, 0);
+}
+
+namespace {
+class VariableListener : public orbit::tracing::Listener {
+ public:
+  explicit VariableListener(
+      std::vector<std::pair<std::string, double>>* values)
+      : values_(values) {}
+
+  void OnScopes(const orbit::tracing::ScopeEvent* /*events*/,
+                size_t /*count*/) override {}
+  void OnVariables(const orbit::tracing::VariableEvent* events,
+                   size_t count) override {
+    for (size_t i = 0; i < count; ++i) {
+      values_->emplace_back(events[i].name, events[i].value);
+    }
+  }
+
+ private:
+  std::vector<std::pair<std::string, double>>* values_;
+};
+}  // namespace
+
+TEST(Tracing, RecordsTrackedValues) {
+  std::vector<std::pair<std::string, double>> values;
+  orbit::tracing::SetListener(std::make_unique<VariableListener>(&values));
+  std::thread([] {
+    for (int i = 0; i < 1000; ++i) {
+      ORBIT_TRACK("i", i);
+    }
+    ORBIT_TRACK("half", 0.5f);
+  }).join();
+  orbit::tracing::SetListener(nullptr);
+
+  ASSERT_EQ(values.size(), 1001);
+  EXPECT_EQ(values[999], (std::pair<std::string, double>{"i", 999}));
+  EXPECT_EQ(values[1000], (std::pair<std::string, double>{"half", 0.5}));
+}
@@ -1,50 +1,111 @@
 #ifndef ORBIT_TRACING_TRACING_H_
 #define ORBIT_TRACING_TRACING_H_
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 
-#define ORBIT_TRACING_ENABLED 0
+// Introspection of Orbit itself, compiled in unless ORBIT_TRACING_ENABLED is
+// defined to 0. While no listener is attached, a scope costs the test of one
+// flag. While one is, scopes are recorded to a buffer of their thread, which
+// is handed to the listener when full, without a virtual call per scope.
+#ifndef ORBIT_TRACING_ENABLED
+#define ORBIT_TRACING_ENABLED 1
+#endif
 
 #if ORBIT_TRACING_ENABLED
 
-// Scoped trace with user defined name.
-#define ORBIT_SCOPE(name) orbit::tracing::Scope ORBIT_UNIQUE(ORB)(name)
+// Scoped trace with user defined name, a string literal.
+#define ORBIT_SCOPE(name) ORBIT_NAMED_SCOPE("" name)
 // Scoped trace with calling function name.
-#define ORBIT_SCOPE_FUNC ORBIT_SCOPE(__FUNCTION__)
-// Manual scope begin.
-#define ORBIT_BEGIN(name) ORBIT_CALL(Begin(name))
+#define ORBIT_SCOPE_FUNC ORBIT_NAMED_SCOPE(__FUNCTION__)
+// Manual scope begin, name a string literal.
+#define ORBIT_BEGIN(name)                \
+  if (orbit::tracing::IsListening()) {   \
+    orbit::tracing::BeginScope("" name); \
+  }
 // Manual scope end.
-#define ORBIT_END ORBIT_CALL(End())
-// Track named variable (int or float).
-#define ORBIT_TRACK(name, var) ORBIT_CALL(Track(name, var))
+#define ORBIT_END                      \
+  if (orbit::tracing::IsListening()) { \
+    orbit::tracing::EndScope();        \
+  }
+// Records the current value of a numeric variable, name a string literal.
+#define ORBIT_TRACK(name, var)                                      \
+  if (orbit::tracing::IsListening()) {                             \
+    orbit::tracing::TrackValue("" name, static_cast<double>(var)); \
+  }
 
 // Internal macros.
 #define ORBIT_CONCAT_IND(x, y) (x##y)
 #define ORBIT_CONCAT(x, y) ORBIT_CONCAT_IND(x, y)
 #define ORBIT_UNIQUE(x) ORBIT_CONCAT(x, __COUNTER__)
-#define ORBIT_CALL(f)             \
-  if (orbit::tracing::GHandler) { \
-    orbit::tracing::GHandler->f;  \
-  }
+#define ORBIT_NAMED_SCOPE(name) orbit::tracing::Scope ORBIT_UNIQUE(ORB)(name)
 
 namespace orbit {
 namespace tracing {
 
-class Handler {
+// A scope that ended. The address of its name, which has static storage,
+// identifies it.
+struct ScopeEvent {
+  const char* name;
+  uint64_t begin_ns;
+  uint64_t end_ns;
+  // Number of enclosing scopes.
+  uint32_t depth;
+};
+
+// A value of a tracked variable, identified by the address of its name like
+// a scope.
+struct VariableEvent {
+  const char* name;
+  uint64_t timestamp_ns;
+  double value;
+};
+
+class Listener {
  public:
-  virtual ~Handler() {}
-  virtual void Begin(const char* name) = 0;
-  virtual void End() = 0;
-  virtual void Track(const char* name, int) = 0;
-  virtual void Track(const char* name, float) = 0;
+  virtual ~Listener() = default;
+  // On the thread of the scopes, in the order they ended. Calls are
+  // serialized.
+  virtual void OnScopes(const ScopeEvent* events, size_t count) = 0;
+  // On the thread of the values, in the order they were tracked. Serialized
+  // with OnScopes.
+  virtual void OnVariables(const VariableEvent* /*events*/,
+                           size_t /*count*/) {}
 };
 
-// This must be instantiated in user code.
-extern std::unique_ptr<Handler> GHandler;
+// Replaces the listener, nullptr to detach it. Returns once the previous one
+// is no longer called. Scopes of threads that haven't ended are dropped.
+void SetListener(std::unique_ptr<Listener> listener);
+
+// Timestamps of the scopes, of CLOCK_MONOTONIC on Linux.
+uint64_t MonotonicTimestampNs();
+
+extern std::atomic<bool> GIsListening;
+
+inline bool IsListening() {
+  return GIsListening.load(std::memory_order_relaxed);
+}
+
+void BeginScope(const char* name);
+void EndScope();
+// Written to the buffer of the thread like the scopes, without formatting.
+void TrackValue(const char* name, double value);
+
+class Scope {
+ public:
+  explicit Scope(const char* name) : is_recorded_(IsListening()) {
+    if (is_recorded_) BeginScope(name);
+  }
+  ~Scope() {
+    if (is_recorded_) EndScope();
+  }
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
 
-struct Scope {
-  Scope(const char* name) { ORBIT_BEGIN(name); }
-  ~Scope() { ORBIT_END; }
+ private:
+  bool is_recorded_;
 };
 
 }  // namespace tracing
@@ -56,7 +117,7 @@ struct Scope {
 #define ORBIT_SCOPE_FUNC
 #define ORBIT_BEGIN(name)
 #define ORBIT_END
-#define ORBIT_TRACK(var)
+#define ORBIT_TRACK(name, var)
 
 #endif  // ORBIT_TRACING_ENABLED
 
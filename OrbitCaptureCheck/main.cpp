@@ -0,0 +1,127 @@
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "CaptureSummary.h"
+#include "ParallelFor.h"
+#include "absl/strings/match.h"
+
+// Summarizes saved captures without the UI: the stats of the instrumented
+// functions from their timers, the frames of a frame function and the
+// sampling report. Optionally saves the summaries as JSON, and compares them
+// with a baseline, a summary or a capture of a known good build, to fail
+// automated runs on performance regressions. Captures are summarized in
+// parallel, across files when given several, across the timer chunks of the
+// capture otherwise.
+//
+// Exits with 0 if all captures were summarized without regressions, 1 on
+// errors, 2 on regressions.
+
+namespace {
+void PrintUsage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [--frame_function NAME] [--output_dir DIR] "
+          "[--baseline SUMMARY_OR_CAPTURE] [--max_increase PERCENT] "
+          "[--significance P] [--max_exclusive_increase POINTS] "
+          "CAPTURE...\n",
+          program);
+}
+
+bool LoadBaseline(const std::string& path,
+                  const CaptureSummaryOptions& options,
+                  CaptureSummary* baseline) {
+  if (absl::EndsWith(path, ".json")) {
+    return LoadCaptureSummary(path, baseline);
+  }
+  return SummarizeCapture(path, options, baseline);
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  CaptureSummaryOptions options;
+  RegressionThresholds thresholds;
+  std::string output_dir;
+  std::string baseline_path;
+  std::vector<std::string> capture_paths;
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "--frame_function") == 0 && has_value) {
+      options.frame_function = argv[++i];
+    } else if (strcmp(argv[i], "--output_dir") == 0 && has_value) {
+      output_dir = argv[++i];
+    } else if (strcmp(argv[i], "--baseline") == 0 && has_value) {
+      baseline_path = argv[++i];
+    } else if (strcmp(argv[i], "--max_increase") == 0 && has_value) {
+      thresholds.max_increase_percent = std::stod(argv[++i]);
+    } else if (strcmp(argv[i], "--significance") == 0 && has_value) {
+      thresholds.significance_level = std::stod(argv[++i]);
+    } else if (strcmp(argv[i], "--max_exclusive_increase") == 0 &&
+               has_value) {
+      thresholds.max_exclusive_increase = std::stof(argv[++i]);
+    } else if (argv[i][0] != '-') {
+      capture_paths.push_back(argv[i]);
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (capture_paths.empty()) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  CaptureSummary baseline;
+  if (!baseline_path.empty() &&
+      !LoadBaseline(baseline_path, options, &baseline)) {
+    fprintf(stderr, "Could not load the baseline %s\n", baseline_path.c_str());
+    return 1;
+  }
+
+  // With several captures, each is summarized on a single core, which
+  // scales better than splitting each capture in turn.
+  options.parallel = capture_paths.size() == 1;
+  std::vector<CaptureSummary> summaries(capture_paths.size());
+  std::vector<char> summarized(capture_paths.size(), 0);
+  ParallelFor(capture_paths.size(), [&](size_t index) {
+    summarized[index] =
+        SummarizeCapture(capture_paths[index], options, &summaries[index]);
+    if (summarized[index] && !output_dir.empty()) {
+      std::string file_name =
+          std::filesystem::path(capture_paths[index]).filename().string();
+      std::string output_path =
+          (std::filesystem::path(output_dir) / (file_name + ".json")).string();
+      if (!SaveCaptureSummary(summaries[index], output_path)) {
+        fprintf(stderr, "Could not write %s\n", output_path.c_str());
+      }
+    }
+  });
+
+  int exit_code = 0;
+  for (size_t i = 0; i < capture_paths.size(); ++i) {
+    const std::string& path = capture_paths[i];
+    if (!summarized[i]) {
+      fprintf(stderr, "Could not summarize %s\n", path.c_str());
+      exit_code = 1;
+      continue;
+    }
+    const CaptureSummary& summary = summaries[i];
+    printf("%s: %" PRIu64 " timers, %zu functions, %" PRIu64 " frames, %" PRIu64
+           " samples\n",
+           path.c_str(), summary.num_timers, summary.functions.size(),
+           summary.frames.m_Count, summary.num_samples);
+    if (baseline_path.empty()) continue;
+
+    for (const Regression& regression :
+         FindRegressions(baseline, summary, thresholds)) {
+      printf("REGRESSION %s: %s %s %s %.3f -> %.3f\n", path.c_str(),
+             regression.kind.c_str(), regression.name.c_str(),
+             regression.metric.c_str(), regression.baseline,
+             regression.current);
+      if (exit_code == 0) exit_code = 2;
+    }
+  }
+  return exit_code;
+}
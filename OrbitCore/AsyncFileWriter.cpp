@@ -0,0 +1,516 @@
+#include "AsyncFileWriter.h"
+
+#include <OrbitBase/Logging.h>
+#include <OrbitBase/SafeStrerror.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <functional>
+
+// The rings shared with the kernel, see io_uring_setup(2), set up with raw
+// system calls rather than with liburing.
+struct AsyncFileWriter::IoUring {
+  int fd = -1;
+  void* sq_ring = MAP_FAILED;
+  size_t sq_ring_size = 0;
+  void* cq_ring = MAP_FAILED;
+  size_t cq_ring_size = 0;
+  void* sqes = MAP_FAILED;
+  size_t sqes_size = 0;
+  unsigned* sq_tail = nullptr;
+  unsigned* sq_mask = nullptr;
+  unsigned* sq_array = nullptr;
+  unsigned* cq_head = nullptr;
+  unsigned* cq_tail = nullptr;
+  unsigned* cq_mask = nullptr;
+  io_uring_cqe* cqes = nullptr;
+  unsigned num_unsubmitted = 0;
+  // One per buffer, for IORING_OP_WRITEV, which unlike IORING_OP_WRITE is
+  // supported since io_uring exists.
+  std::vector<iovec> iovecs;
+
+  // nullptr if the kernel doesn't support io_uring or it is disabled.
+  static std::unique_ptr<IoUring> Create(const std::vector<char*>& buffers);
+  ~IoUring();
+
+  void QueueWrite(size_t buffer, int file_fd, uint64_t offset, size_t size);
+  // Submits the queued writes and waits for min_complete completions.
+  // Returns false on error, the writes queued then not being submitted.
+  bool Enter(unsigned min_complete);
+  // Unqueues the writes not submitted.
+  void DropUnsubmitted(const std::function<void(size_t buffer)>& on_dropped);
+  void ForEachCompletion(
+      const std::function<void(size_t buffer, bool success)>& on_completion);
+};
+
+std::unique_ptr<AsyncFileWriter::IoUring> AsyncFileWriter::IoUring::Create(
+    const std::vector<char*>& buffers) {
+  io_uring_params params{};
+  int fd = syscall(__NR_io_uring_setup, buffers.size(), &params);
+  if (fd < 0) {
+    LOG("io_uring is not available: %s", SafeStrerror(errno));
+    return nullptr;
+  }
+  auto ring = std::make_unique<IoUring>();
+  ring->fd = fd;
+  ring->sq_ring_size =
+      params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_ring_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    ring->sq_ring_size = std::max(ring->sq_ring_size, ring->cq_ring_size);
+  }
+  ring->sq_ring = mmap(nullptr, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (ring->sq_ring == MAP_FAILED) {
+    ERROR("mmap of io_uring: %s", SafeStrerror(errno));
+    return nullptr;
+  }
+  if (single_mmap) {
+    ring->cq_ring = ring->sq_ring;
+  } else {
+    ring->cq_ring = mmap(nullptr, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (ring->cq_ring == MAP_FAILED) {
+      ERROR("mmap of io_uring: %s", SafeStrerror(errno));
+      return nullptr;
+    }
+  }
+  ring->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  ring->sqes = mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED) {
+    ERROR("mmap of io_uring: %s", SafeStrerror(errno));
+    return nullptr;
+  }
+
+  auto* sq = static_cast<char*>(ring->sq_ring);
+  ring->sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  ring->sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  ring->sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  auto* cq = static_cast<char*>(ring->cq_ring);
+  ring->cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  ring->cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  ring->cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+  ring->iovecs.resize(buffers.size());
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    ring->iovecs[i].iov_base = buffers[i];
+  }
+  return ring;
+}
+
+AsyncFileWriter::IoUring::~IoUring() {
+  if (sqes != MAP_FAILED) {
+    munmap(sqes, sqes_size);
+  }
+  if (cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+    munmap(cq_ring, cq_ring_size);
+  }
+  if (sq_ring != MAP_FAILED) {
+    munmap(sq_ring, sq_ring_size);
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
+void AsyncFileWriter::IoUring::QueueWrite(size_t buffer, int file_fd,
+                                          uint64_t offset, size_t size) {
+  // As many entries as buffers, so there is always room. Only this thread
+  // writes the tail.
+  unsigned tail = *sq_tail;
+  unsigned index = tail & *sq_mask;
+  io_uring_sqe* sqe = static_cast<io_uring_sqe*>(sqes) + index;
+  memset(sqe, 0, sizeof(*sqe));
+  iovecs[buffer].iov_len = size;
+  sqe->opcode = IORING_OP_WRITEV;
+  sqe->fd = file_fd;
+  sqe->off = offset;
+  sqe->addr = reinterpret_cast<uint64_t>(&iovecs[buffer]);
+  sqe->len = 1;
+  sqe->user_data = buffer;
+  sq_array[index] = index;
+  __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+  ++num_unsubmitted;
+}
+
+bool AsyncFileWriter::IoUring::Enter(unsigned min_complete) {
+  while (true) {
+    int ret = syscall(__NR_io_uring_enter, fd, num_unsubmitted, min_complete,
+                      min_complete > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr,
+                      0);
+    if (ret >= 0) {
+      num_unsubmitted -= std::min<unsigned>(ret, num_unsubmitted);
+      return true;
+    }
+    if (errno != EINTR) {
+      ERROR("io_uring_enter: %s", SafeStrerror(errno));
+      return false;
+    }
+  }
+}
+
+void AsyncFileWriter::IoUring::DropUnsubmitted(
+    const std::function<void(size_t buffer)>& on_dropped) {
+  unsigned tail = *sq_tail;
+  for (unsigned i = tail - num_unsubmitted; i != tail; ++i) {
+    on_dropped(static_cast<io_uring_sqe*>(sqes)[i & *sq_mask].user_data);
+  }
+  __atomic_store_n(sq_tail, tail - num_unsubmitted, __ATOMIC_RELEASE);
+  num_unsubmitted = 0;
+}
+
+void AsyncFileWriter::IoUring::ForEachCompletion(
+    const std::function<void(size_t buffer, bool success)>& on_completion) {
+  unsigned head = *cq_head;
+  unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+  for (; head != tail; ++head) {
+    const io_uring_cqe& cqe = cqes[head & *cq_mask];
+    size_t buffer = cqe.user_data;
+    if (cqe.res < 0) {
+      ERROR("io_uring write: %s", SafeStrerror(-cqe.res));
+    }
+    on_completion(buffer, cqe.res >= 0 && static_cast<size_t>(cqe.res) ==
+                                              iovecs[buffer].iov_len);
+  }
+  __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+}
+#endif  // __linux__
+
+AsyncFileWriter::AsyncFileWriter() = default;
+
+AsyncFileWriter::~AsyncFileWriter() {
+  if (is_open_) {
+    Close();
+  }
+}
+
+bool AsyncFileWriter::Open(const std::string& path, const Options& options) {
+  if (is_open_) {
+    Close();
+  }
+  options_ = options;
+  size_t num_blocks = (options_.buffer_size + kAlignment - 1) / kAlignment;
+  options_.buffer_size = std::max<size_t>(num_blocks, 1) * kAlignment;
+  options_.num_buffers = std::max<size_t>(options_.num_buffers, 2);
+  options_.submit_batch = std::max<size_t>(options_.submit_batch, 1);
+  options_.num_threads = std::max<size_t>(options_.num_threads, 1);
+
+#ifdef __linux__
+  const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+  direct_io_ = false;
+  if (options_.direct_io) {
+    fd_ = open(path.c_str(), flags | O_DIRECT, 0644);
+    if (fd_ >= 0) {
+      direct_io_ = true;
+    } else {
+      // E.g. on tmpfs.
+      ERROR("Could not open %s with O_DIRECT, using the page cache: %s",
+            path.c_str(), SafeStrerror(errno));
+    }
+  }
+  if (fd_ < 0) {
+    fd_ = open(path.c_str(), flags, 0644);
+  }
+  if (fd_ < 0) {
+    ERROR("Could not create %s: %s", path.c_str(), SafeStrerror(errno));
+    return false;
+  }
+#else
+  file_.open(path, std::ios::binary | std::ios::trunc);
+  if (!file_) {
+    ERROR("Could not create %s", path.c_str());
+    return false;
+  }
+#endif
+
+  for (size_t i = 0; i < options_.num_buffers; ++i) {
+    buffers_.push_back(static_cast<char*>(::operator new(
+        options_.buffer_size, std::align_val_t(kAlignment))));
+  }
+  current_buffer_ = 0;
+  fill_ = 0;
+  offset_ = 0;
+  free_buffers_.clear();
+  for (size_t i = 1; i < options_.num_buffers; ++i) {
+    free_buffers_.push_back(i);
+  }
+  failed_ = false;
+  queue_depth_ = 0;
+  max_queue_depth_ = 0;
+  num_buffer_waits_ = 0;
+
+#ifdef __linux__
+  if (options_.use_io_uring) {
+    io_uring_ = IoUring::Create(buffers_);
+  }
+  if (io_uring_ == nullptr) {
+    stop_threads_ = false;
+    for (size_t i = 0; i < options_.num_threads; ++i) {
+      threads_.emplace_back(&AsyncFileWriter::WriterThread, this);
+    }
+  }
+#endif
+  is_open_ = true;
+  return true;
+}
+
+bool AsyncFileWriter::IsUsingIoUring() const {
+#ifdef __linux__
+  return io_uring_ != nullptr;
+#else
+  return false;
+#endif
+}
+
+bool AsyncFileWriter::Write(const void* data, size_t size) {
+  if (!is_open_) {
+    return false;
+  }
+  const char* bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    size_t copied = std::min(size, options_.buffer_size - fill_);
+    memcpy(buffers_[current_buffer_] + fill_, bytes, copied);
+    fill_ += copied;
+    bytes += copied;
+    size -= copied;
+    if (fill_ == options_.buffer_size) {
+      SubmitCurrentBuffer();
+    }
+  }
+  return !failed_;
+}
+
+void AsyncFileWriter::Flush() {
+  if (!is_open_ || direct_io_ || fill_ == 0) {
+    return;
+  }
+  SubmitCurrentBuffer();
+  SubmitPendingWrites();
+}
+
+bool AsyncFileWriter::Close() {
+  if (!is_open_) {
+    return false;
+  }
+  const uint64_t size = offset_ + fill_;
+  if (fill_ > 0) {
+    if (direct_io_) {
+      // O_DIRECT writes whole blocks, the padding is truncated below.
+      size_t padded_fill = (fill_ + kAlignment - 1) / kAlignment * kAlignment;
+      memset(buffers_[current_buffer_] + fill_, 0, padded_fill - fill_);
+      fill_ = padded_fill;
+    }
+    SubmitCurrentBuffer();
+  }
+  WaitForAllWrites();
+  bool success = !failed_;
+
+#ifdef __linux__
+  if (direct_io_ && ftruncate(fd_, size) != 0) {
+    ERROR("ftruncate: %s", SafeStrerror(errno));
+    success = false;
+  }
+  if (close(fd_) != 0) {
+    ERROR("close: %s", SafeStrerror(errno));
+    success = false;
+  }
+  fd_ = -1;
+#else
+  (void)size;
+  file_.close();
+#endif
+  Release();
+  return success;
+}
+
+void AsyncFileWriter::SubmitCurrentBuffer() {
+  pending_writes_.push_back({current_buffer_, offset_, fill_});
+  offset_ += fill_;
+  fill_ = 0;
+  if (pending_writes_.size() >= options_.submit_batch) {
+    SubmitPendingWrites();
+  }
+  current_buffer_ = AcquireFreeBuffer();
+}
+
+void AsyncFileWriter::SubmitPendingWrites() {
+  if (pending_writes_.empty()) {
+    return;
+  }
+  queue_depth_ += pending_writes_.size();
+  max_queue_depth_ = std::max<size_t>(max_queue_depth_, queue_depth_);
+
+#ifdef __linux__
+  if (io_uring_ != nullptr) {
+    for (const PendingWrite& write : pending_writes_) {
+      io_uring_->QueueWrite(write.buffer, fd_, write.offset, write.size);
+    }
+    pending_writes_.clear();
+    if (!io_uring_->Enter(/*min_complete=*/0)) {
+      io_uring_->DropUnsubmitted(
+          [this](size_t buffer) { OnWriteDone(buffer, false); });
+    }
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queued_writes_.insert(queued_writes_.end(), pending_writes_.begin(),
+                          pending_writes_.end());
+  }
+  pending_writes_.clear();
+  writes_queued_.notify_all();
+#else
+  for (const PendingWrite& write : pending_writes_) {
+    OnWriteDone(write.buffer, WriteSynchronously(write));
+  }
+  pending_writes_.clear();
+#endif
+}
+
+size_t AsyncFileWriter::AcquireFreeBuffer() {
+#ifdef __linux__
+  if (io_uring_ != nullptr) {
+    ReapIoUringCompletions(/*wait=*/false);
+    if (free_buffers_.empty()) {
+      ++num_buffer_waits_;
+      SubmitPendingWrites();
+      while (free_buffers_.empty()) {
+        ReapIoUringCompletions(/*wait=*/true);
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t buffer = free_buffers_.back();
+    free_buffers_.pop_back();
+    return buffer;
+  }
+#endif
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (free_buffers_.empty()) {
+    ++num_buffer_waits_;
+    lock.unlock();
+    SubmitPendingWrites();
+    lock.lock();
+    buffer_freed_.wait(lock, [this] { return !free_buffers_.empty(); });
+  }
+  size_t buffer = free_buffers_.back();
+  free_buffers_.pop_back();
+  return buffer;
+}
+
+void AsyncFileWriter::OnWriteDone(size_t buffer, bool success) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!success) {
+      failed_ = true;
+    }
+    free_buffers_.push_back(buffer);
+    --queue_depth_;
+  }
+  buffer_freed_.notify_all();
+}
+
+void AsyncFileWriter::WaitForAllWrites() {
+  SubmitPendingWrites();
+#ifdef __linux__
+  if (io_uring_ != nullptr) {
+    while (queue_depth_ > 0) {
+      ReapIoUringCompletions(/*wait=*/true);
+    }
+    return;
+  }
+#endif
+  std::unique_lock<std::mutex> lock(mutex_);
+  buffer_freed_.wait(lock, [this] { return queue_depth_ == 0; });
+}
+
+void AsyncFileWriter::ReapIoUringCompletions(bool wait) {
+#ifdef __linux__
+  if (wait && queue_depth_ > 0 && !io_uring_->Enter(/*min_complete=*/1)) {
+    io_uring_->DropUnsubmitted(
+        [this](size_t buffer) { OnWriteDone(buffer, false); });
+  }
+  io_uring_->ForEachCompletion([this](size_t buffer, bool success) {
+    OnWriteDone(buffer, success);
+  });
+#else
+  (void)wait;
+#endif
+}
+
+void AsyncFileWriter::WriterThread() {
+#ifdef __linux__
+  while (true) {
+    PendingWrite write;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      writes_queued_.wait(
+          lock, [this] { return stop_threads_ || !queued_writes_.empty(); });
+      if (queued_writes_.empty()) {
+        return;
+      }
+      write = queued_writes_.front();
+      queued_writes_.pop_front();
+    }
+    OnWriteDone(write.buffer, WriteSynchronously(write));
+  }
+#endif
+}
+
+bool AsyncFileWriter::WriteSynchronously(const PendingWrite& write) {
+  const char* data = buffers_[write.buffer];
+#ifdef __linux__
+  size_t written = 0;
+  while (written < write.size) {
+    ssize_t ret = pwrite(fd_, data + written, write.size - written,
+                         write.offset + written);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      ERROR("pwrite: %s", SafeStrerror(errno));
+      return false;
+    }
+    written += ret;
+  }
+  return true;
+#else
+  file_.write(data, write.size);
+  return static_cast<bool>(file_);
+#endif
+}
+
+void AsyncFileWriter::Release() {
+#ifdef __linux__
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_threads_ = true;
+  }
+  writes_queued_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+  io_uring_.reset();
+#endif
+  for (char* buffer : buffers_) {
+    ::operator delete(buffer, std::align_val_t(kAlignment));
+  }
+  buffers_.clear();
+  pending_writes_.clear();
+  is_open_ = false;
+}
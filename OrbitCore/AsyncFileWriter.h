@@ -0,0 +1,120 @@
+#ifndef ORBIT_CORE_ASYNC_FILE_WRITER_H_
+#define ORBIT_CORE_ASYNC_FILE_WRITER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes a file sequentially from a single thread without blocking it on the
+// disk: the data is copied into one of num_buffers preallocated buffers, and
+// every buffer filled is written in the background while the next one fills.
+// Write only blocks when all buffers are being written, i.e. when the disk
+// can't keep up, which GetNumBufferWaits counts.
+//
+// On Linux, the buffers are written with io_uring where the kernel supports it
+// (5.1 or later, and not disabled), submit_batch buffers per system call, and
+// with pwrite on num_threads threads otherwise. With direct_io, the file is
+// opened with O_DIRECT, bypassing the page cache: the buffers are then aligned
+// to kAlignment and Flush does nothing, the last buffer being padded and the
+// file truncated back by Close. Elsewhere, buffers are written synchronously.
+class AsyncFileWriter {
+ public:
+  // Of the buffers, their sizes and the offsets written at, for O_DIRECT.
+  static constexpr size_t kAlignment = 4096;
+
+  struct Options {
+    // Rounded up to a multiple of kAlignment.
+    size_t buffer_size = 1024 * 1024;
+    size_t num_buffers = 32;
+    size_t submit_batch = 4;
+    bool direct_io = false;
+    bool use_io_uring = true;
+    // Of the fallback without io_uring.
+    size_t num_threads = 2;
+  };
+
+  AsyncFileWriter();
+  ~AsyncFileWriter();
+  AsyncFileWriter(const AsyncFileWriter&) = delete;
+  AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+  // Creates or truncates the file at path.
+  bool Open(const std::string& path, const Options& options);
+
+  // Returns false once any write failed.
+  bool Write(const void* data, size_t size);
+  // Starts writing the buffer being filled, so that the data written so far
+  // reaches the file even if the process dies. Ignored with direct_io.
+  void Flush();
+  // Waits for all writes and closes the file. Returns false if any failed.
+  bool Close();
+
+  bool IsOpen() const { return is_open_; }
+  bool IsUsingIoUring() const;
+  bool IsUsingDirectIo() const { return direct_io_; }
+  // Of the buffers submitted and not written yet.
+  size_t GetQueueDepth() const { return queue_depth_; }
+  size_t GetMaxQueueDepth() const { return max_queue_depth_; }
+  uint64_t GetNumBufferWaits() const { return num_buffer_waits_; }
+  uint64_t GetNumBytes() const { return offset_ + fill_; }
+
+ private:
+  struct PendingWrite {
+    size_t buffer;
+    uint64_t offset;
+    size_t size;
+  };
+  struct IoUring;
+
+  // Queues the buffer being filled, and takes a free one.
+  void SubmitCurrentBuffer();
+  void SubmitPendingWrites();
+  // Blocks until a buffer is free, unless one already is.
+  size_t AcquireFreeBuffer();
+  void OnWriteDone(size_t buffer, bool success);
+  void WaitForAllWrites();
+  void ReapIoUringCompletions(bool wait);
+  void WriterThread();
+  bool WriteSynchronously(const PendingWrite& write);
+  void Release();
+
+  bool is_open_ = false;
+  Options options_;
+  bool direct_io_ = false;
+  std::vector<char*> buffers_;
+  size_t current_buffer_ = 0;
+  size_t fill_ = 0;
+  // Where the buffer being filled goes in the file.
+  uint64_t offset_ = 0;
+  std::vector<PendingWrite> pending_writes_;
+
+  std::mutex mutex_;
+  std::condition_variable buffer_freed_;
+  std::vector<size_t> free_buffers_;
+  std::atomic<bool> failed_ = false;
+  std::atomic<size_t> queue_depth_ = 0;
+  size_t max_queue_depth_ = 0;
+  uint64_t num_buffer_waits_ = 0;
+
+#ifdef __linux__
+  int fd_ = -1;
+  std::unique_ptr<IoUring> io_uring_;
+  // The fallback without io_uring.
+  std::condition_variable writes_queued_;
+  std::deque<PendingWrite> queued_writes_;
+  bool stop_threads_ = false;
+  std::vector<std::thread> threads_;
+#else
+  std::ofstream file_;
+#endif
+};
+
+#endif  // ORBIT_CORE_ASYNC_FILE_WRITER_H_
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "AsyncFileWriter.h"
+
+namespace {
+std::string GetTemporaryPath() {
+  return testing::TempDir() + "async_file_writer_test_" +
+         std::to_string(getpid());
+}
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+// Spans several buffers of AsyncFileWriter::kAlignment bytes, and ends within
+// one.
+std::string MakeData() {
+  std::string data;
+  for (int i = 0; data.size() < 5 * AsyncFileWriter::kAlignment + 123; ++i) {
+    data += std::to_string(i) + ",";
+  }
+  return data;
+}
+
+void WriteAndCheck(const AsyncFileWriter::Options& options) {
+  std::string path = GetTemporaryPath();
+  std::string data = MakeData();
+  AsyncFileWriter writer;
+  ASSERT_TRUE(writer.Open(path, options));
+  // In pieces of various sizes, some across buffers.
+  size_t offset = 0;
+  for (size_t size = 1; offset < data.size(); size = size * 3 + 1) {
+    size = std::min(size, data.size() - offset);
+    EXPECT_TRUE(writer.Write(data.data() + offset, size));
+    offset += size;
+  }
+  EXPECT_EQ(writer.GetNumBytes(), data.size());
+  EXPECT_TRUE(writer.Close());
+  EXPECT_EQ(writer.GetQueueDepth(), 0);
+  EXPECT_GE(writer.GetMaxQueueDepth(), 1);
+  EXPECT_EQ(ReadFile(path), data);
+  std::remove(path.c_str());
+}
+}  // namespace
+
+TEST(AsyncFileWriter, WritesWithIoUringOrThreads) {
+  AsyncFileWriter::Options options;
+  options.buffer_size = AsyncFileWriter::kAlignment;
+  options.num_buffers = 2;
+  WriteAndCheck(options);
+}
+
+TEST(AsyncFileWriter, WritesWithThreads) {
+  AsyncFileWriter::Options options;
+  options.buffer_size = AsyncFileWriter::kAlignment;
+  options.num_buffers = 3;
+  options.submit_batch = 2;
+  options.use_io_uring = false;
+  WriteAndCheck(options);
+}
+
+TEST(AsyncFileWriter, TruncatesPaddingOfDirectIo) {
+  AsyncFileWriter::Options options;
+  options.buffer_size = 2 * AsyncFileWriter::kAlignment;
+  options.direct_io = true;
+  // Falls back to the page cache where O_DIRECT is not supported.
+  WriteAndCheck(options);
+}
+
+TEST(AsyncFileWriter, FlushWritesPartialBuffers) {
+  std::string path = GetTemporaryPath();
+  AsyncFileWriter::Options options;
+  options.use_io_uring = false;
+  AsyncFileWriter writer;
+  ASSERT_TRUE(writer.Open(path, options));
+  EXPECT_TRUE(writer.Write("abc", 3));
+  writer.Flush();
+  EXPECT_TRUE(writer.Write("de", 2));
+  writer.Flush();
+  EXPECT_TRUE(writer.Close());
+  EXPECT_EQ(ReadFile(path), "abcde");
+  std::remove(path.c_str());
+}
@@ -0,0 +1,90 @@
+#include "AutoInstrumentation.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+// Sample counts below this after decaying are forgotten.
+constexpr double kMinSamples = 0.5;
+}  // namespace
+
+void AutoInstrumentation::AddSample(uint64_t function_address) {
+  if (!too_costly_.contains(function_address)) {
+    samples_[function_address] += 1;
+  }
+}
+
+void AutoInstrumentation::AddCall(uint64_t function_address) {
+  if (instrumented_.contains(function_address)) {
+    ++calls_[function_address];
+  }
+}
+
+AutoInstrumentation::Changes AutoInstrumentation::Update(uint64_t now_ns) {
+  Changes changes;
+  if (period_begin_ns_ == 0 || now_ns <= period_begin_ns_) {
+    period_begin_ns_ = now_ns;
+    return changes;
+  }
+  double period_s = (now_ns - period_begin_ns_) * 1e-9;
+  period_begin_ns_ = now_ns;
+
+  // Over budget: the functions called the most go first.
+  std::vector<std::pair<uint64_t, uint64_t>> calls(calls_.begin(),
+                                                   calls_.end());
+  calls_.clear();
+  std::sort(calls.begin(), calls.end(),
+            [](const auto& a, const auto& b) { return a.second > b.second; });
+  auto overhead_percent = [period_s](uint64_t num_calls) {
+    return 100.0 * num_calls * kCallCostNs * 1e-9 / period_s;
+  };
+  overhead_percent_ = 0;
+  for (const auto& [address, num_calls] : calls) {
+    overhead_percent_ += overhead_percent(num_calls);
+  }
+  for (const auto& [address, num_calls] : calls) {
+    if (overhead_percent_ <= max_overhead_percent_) {
+      break;
+    }
+    overhead_percent_ -= overhead_percent(num_calls);
+    instrumented_.erase(address);
+    too_costly_.insert(address);
+    samples_.erase(address);
+    changes.removed.push_back(address);
+  }
+
+  std::vector<std::pair<uint64_t, double>> ranked(samples_.begin(),
+                                                  samples_.end());
+  std::sort(ranked.begin(), ranked.end(),
+            [](const auto& a, const auto& b) { return a.second > b.second; });
+  // Only dropped once out of twice the top, not to churn on the boundary.
+  absl::flat_hash_set<uint64_t> kept;
+  for (size_t i = 0; i < ranked.size() && i < 2 * max_functions_; ++i) {
+    kept.insert(ranked[i].first);
+  }
+  for (auto it = instrumented_.begin(); it != instrumented_.end();) {
+    auto current = it++;
+    if (!kept.contains(*current)) {
+      changes.removed.push_back(*current);
+      instrumented_.erase(current);
+    }
+  }
+  // No new function while over budget.
+  for (size_t i = 0; i < ranked.size() && i < max_functions_ &&
+                     instrumented_.size() < max_functions_ &&
+                     overhead_percent_ <= max_overhead_percent_;
+       ++i) {
+    if (instrumented_.insert(ranked[i].first).second) {
+      changes.added.push_back(ranked[i].first);
+    }
+  }
+
+  for (auto it = samples_.begin(); it != samples_.end();) {
+    auto current = it++;
+    current->second /= 2;
+    if (current->second < kMinSamples) {
+      samples_.erase(current);
+    }
+  }
+  return changes;
+}
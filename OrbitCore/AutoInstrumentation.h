@@ -0,0 +1,59 @@
+#ifndef ORBIT_CORE_AUTO_INSTRUMENTATION_H_
+#define ORBIT_CORE_AUTO_INSTRUMENTATION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+
+// Picks the functions the service instruments on its own during a capture:
+// the top functions by exclusive samples, i.e. by the innermost frames of the
+// sampled callstacks, like the exclusive column of the sampling report. As
+// the sample counts decay by half at each update, the picks follow the live
+// profile.
+//
+// Instrumenting a function costs about kCallCostNs per call, so the calls of
+// the functions picked are counted: whenever their estimated overhead
+// exceeds max_overhead_percent of a core, the ones called the most are
+// removed, and never picked again during the capture.
+class AutoInstrumentation {
+ public:
+  // Of a uprobe and its uretprobe, timing only.
+  static constexpr uint64_t kCallCostNs = 3000;
+
+  AutoInstrumentation(size_t max_functions, double max_overhead_percent)
+      : max_functions_(max_functions),
+        max_overhead_percent_(max_overhead_percent) {}
+
+  void AddSample(uint64_t function_address);
+  // Of any instrumented function, only those picked are counted.
+  void AddCall(uint64_t function_address);
+
+  struct Changes {
+    std::vector<uint64_t> added;
+    std::vector<uint64_t> removed;
+  };
+  // Called periodically, e.g. once a second. The first call only starts the
+  // first period.
+  Changes Update(uint64_t now_ns);
+
+  const absl::flat_hash_set<uint64_t>& GetInstrumented() const {
+    return instrumented_;
+  }
+  // Of the functions picked, over the last period.
+  double GetOverheadPercent() const { return overhead_percent_; }
+
+ private:
+  size_t max_functions_;
+  double max_overhead_percent_;
+  absl::flat_hash_map<uint64_t, double> samples_;
+  absl::flat_hash_set<uint64_t> instrumented_;
+  absl::flat_hash_map<uint64_t, uint64_t> calls_;
+  absl::flat_hash_set<uint64_t> too_costly_;
+  uint64_t period_begin_ns_ = 0;
+  double overhead_percent_ = 0;
+};
+
+#endif  // ORBIT_CORE_AUTO_INSTRUMENTATION_H_
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "AutoInstrumentation.h"
+
+namespace {
+constexpr uint64_t kSecondNs = 1'000'000'000;
+
+void AddSamples(AutoInstrumentation* auto_instrumentation, uint64_t address,
+                int count) {
+  for (int i = 0; i < count; ++i) {
+    auto_instrumentation->AddSample(address);
+  }
+}
+
+std::vector<uint64_t> Sorted(std::vector<uint64_t> addresses) {
+  std::sort(addresses.begin(), addresses.end());
+  return addresses;
+}
+}  // namespace
+
+TEST(AutoInstrumentation, PicksTopFunctionsByExclusiveSamples) {
+  AutoInstrumentation auto_instrumentation(/*max_functions=*/2,
+                                           /*max_overhead_percent=*/5);
+  EXPECT_TRUE(auto_instrumentation.Update(kSecondNs).added.empty());
+  AddSamples(&auto_instrumentation, 0x100, 50);
+  AddSamples(&auto_instrumentation, 0x200, 30);
+  AddSamples(&auto_instrumentation, 0x300, 10);
+
+  AutoInstrumentation::Changes changes =
+      auto_instrumentation.Update(2 * kSecondNs);
+  EXPECT_EQ(Sorted(changes.added), (std::vector<uint64_t>{0x100, 0x200}));
+  EXPECT_TRUE(changes.removed.empty());
+
+  // Now the top, but 0x200 is still in twice the top: it stays.
+  AddSamples(&auto_instrumentation, 0x400, 100);
+  changes = auto_instrumentation.Update(3 * kSecondNs);
+  EXPECT_TRUE(changes.added.empty());
+  EXPECT_TRUE(changes.removed.empty());
+
+  // The samples of the first ones decayed below twice the top.
+  AddSamples(&auto_instrumentation, 0x400, 100);
+  AddSamples(&auto_instrumentation, 0x500, 90);
+  AddSamples(&auto_instrumentation, 0x600, 80);
+  AddSamples(&auto_instrumentation, 0x700, 70);
+  changes = auto_instrumentation.Update(4 * kSecondNs);
+  EXPECT_EQ(Sorted(changes.removed), (std::vector<uint64_t>{0x100, 0x200}));
+  EXPECT_EQ(Sorted(changes.added), (std::vector<uint64_t>{0x400, 0x500}));
+}
+
+TEST(AutoInstrumentation, RemovesTheFunctionsCalledTooOften) {
+  AutoInstrumentation auto_instrumentation(/*max_functions=*/2,
+                                           /*max_overhead_percent=*/1);
+  auto_instrumentation.Update(kSecondNs);
+  AddSamples(&auto_instrumentation, 0x100, 50);
+  AddSamples(&auto_instrumentation, 0x200, 30);
+  auto_instrumentation.Update(2 * kSecondNs);
+  ASSERT_EQ(auto_instrumentation.GetInstrumented().size(), 2);
+
+  // 1% of a core is about 3333 calls a second.
+  for (int i = 0; i < 10'000; ++i) {
+    auto_instrumentation.AddCall(0x100);
+  }
+  for (int i = 0; i < 1000; ++i) {
+    auto_instrumentation.AddCall(0x200);
+    // Not picked.
+    auto_instrumentation.AddCall(0x300);
+  }
+  AddSamples(&auto_instrumentation, 0x100, 50);
+  AddSamples(&auto_instrumentation, 0x200, 30);
+  AutoInstrumentation::Changes changes =
+      auto_instrumentation.Update(3 * kSecondNs);
+  EXPECT_EQ(changes.removed, (std::vector<uint64_t>{0x100}));
+  EXPECT_TRUE(changes.added.empty());
+  EXPECT_NEAR(auto_instrumentation.GetOverheadPercent(), 0.3, 1e-6);
+
+  // Never picked again.
+  AddSamples(&auto_instrumentation, 0x100, 1000);
+  changes = auto_instrumentation.Update(4 * kSecondNs);
+  EXPECT_TRUE(changes.added.empty());
+  EXPECT_FALSE(auto_instrumentation.GetInstrumented().contains(0x100));
+}
@@ -6,12 +6,32 @@
 
 #include <algorithm>
 #include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "MemoryAccounting.h"
 
 //-----------------------------------------------------------------------------
 template <class T, uint32_t BlockSize>
 struct BlockChain;
 
+//-----------------------------------------------------------------------------
+// Memory of the blocks of a chain, the heap if a chain has none.
+class BlockAllocator {
+ public:
+  virtual ~BlockAllocator() = default;
+  virtual void* Allocate(size_t a_Size) = 0;
+  virtual void Free(void* a_Block, size_t a_Size) = 0;
+  // Called by the thread adding items once a block is full: it is only read
+  // from then on, apart from the link to the next block.
+  virtual void OnBlockFull(void* /*a_Block*/, size_t /*a_Size*/) {}
+};
+
 //-----------------------------------------------------------------------------
 template <class T, uint32_t Size>
 struct Block {
@@ -20,26 +40,42 @@ struct Block {
 
   ~Block() {}
 
-  void Add(const T& a_Item) {
-    if (m_Size == Size) {
-      if (m_Next == nullptr) {
-        m_Next = new Block<T, Size>(m_Chain, this);
-      }
-
-      m_Chain->m_Current = m_Next;
-      ++m_Chain->m_NumBlocks;
-      m_Next->Add(a_Item);
+  // Items are added by a single thread while others read them: the item is
+  // written before the size is published, and a new block is constructed
+  // before it is linked, so readers only ever see complete items.
+  template <class U>
+  void Add(U&& a_Item) {
+    uint32_t size = m_Size.load(std::memory_order_relaxed);
+    if (size == Size) {
+      m_Chain->NextBlock()->Add(std::forward<U>(a_Item));
       return;
     }
 
-    assert(m_Size < Size);
-    m_Data[m_Size] = a_Item;
-    ++m_Size;
-    ++m_Chain->m_NumItems;
+    assert(size < Size);
+    m_Data[size] = std::forward<U>(a_Item);
+    Publish(size, 1);
+  }
+
+  // Publishes the a_Num items written after the a_Size first ones.
+  void Publish(uint32_t a_Size, uint32_t a_Num) {
+    m_Size.store(a_Size + a_Num, std::memory_order_release);
+    m_Chain->m_NumItems.store(
+        m_Chain->m_NumItems.load(std::memory_order_relaxed) + a_Num,
+        std::memory_order_release);
+    if (a_Size + a_Num == Size && m_Chain->m_Allocator != nullptr) {
+      m_Chain->m_Allocator->OnBlockFull(this, sizeof(*this));
+    }
+  }
+
+  // For the readers: the items [0, GetSize()) are complete, and so is the
+  // block GetNext() returns, if any.
+  uint32_t GetSize() const { return m_Size.load(std::memory_order_acquire); }
+  Block<T, Size>* GetNext() const {
+    return m_Next.load(std::memory_order_acquire);
   }
 
   Block<T, Size>* m_Prev;
-  Block<T, Size>* m_Next;
+  std::atomic<Block<T, Size>*> m_Next;
   T m_Data[Size];
   BlockChain<T, Size>* m_Chain;
   std::atomic<uint32_t> m_Size;
@@ -47,9 +83,13 @@ struct Block {
 
 //-----------------------------------------------------------------------------
 template <class T, uint32_t BlockSize>
+// Safe to use while the writer adds items: the size of a block is only
+// loaded again once the items seen of it are exhausted, and the iteration
+// ends at the last item published then.
 struct BlockIterator {
   BlockIterator(Block<T, BlockSize>* a_Block) : m_Block(a_Block) {
-    m_Index = (m_Block && (m_Block->m_Size > 0)) ? 0 : -1;
+    m_Size = m_Block ? m_Block->GetSize() : 0;
+    m_Index = m_Size > 0 ? 0 : -1;
   }
 
   T& operator*() { return m_Block->m_Data[m_Index]; }
@@ -60,13 +100,21 @@ struct BlockIterator {
   }
 
   BlockIterator& operator++() {
-    if (++m_Index == m_Block->m_Size) {
-      if (m_Block->m_Next && m_Block->m_Next->m_Size > 0) {
-        m_Index = 0;
-        m_Block = m_Block->m_Next;
-      } else {
-        m_Index = -1;
-      }
+    if (++m_Index < m_Size) return *this;
+
+    // Items may have been published since the size was loaded.
+    m_Size = m_Block->GetSize();
+    if (m_Index < m_Size) return *this;
+
+    Block<T, BlockSize>* next = m_Size == BlockSize ? m_Block->GetNext()
+                                                    : nullptr;
+    uint32_t nextSize = next ? next->GetSize() : 0;
+    if (nextSize > 0) {
+      m_Index = 0;
+      m_Block = next;
+      m_Size = nextSize;
+    } else {
+      m_Index = -1;
     }
 
     return *this;
@@ -74,13 +122,24 @@ struct BlockIterator {
 
   Block<T, BlockSize>* m_Block;
   uint32_t m_Index;
+  uint32_t m_Size;
 };
 
 //-----------------------------------------------------------------------------
+// Single writer, multiple readers: one thread adds items (push_back, Append,
+// back) while any number of threads read them (iterators, size, SlowAt,
+// GetElementAfter/Before) without locks. The writer fills an item, or a run
+// of items, before publishing the size of its block with a release store,
+// and constructs a block before linking it with a release store of m_Next;
+// readers load both with acquire, so they only see complete items, in order.
+// Items never move once published. clear, Reset and keep free or reuse
+// blocks, so they need the readers to be excluded, e.g. by a lock. The bytes
+// of the blocks are counted in the memory of the subsystem of the chain.
 template <class T, uint32_t BlockSize>
 struct BlockChain {
-  BlockChain() : m_NumBlocks(1), m_NumItems(0) {
-    m_Root = m_Current = new Block<T, BlockSize>(this, nullptr);
+  explicit BlockChain(std::shared_ptr<BlockAllocator> a_Allocator = nullptr)
+      : m_Allocator(std::move(a_Allocator)), m_NumBlocks(1), m_NumItems(0) {
+    m_Root = m_Current = NewBlock(nullptr);
   }
 
   ~BlockChain() {
@@ -90,19 +149,89 @@ struct BlockChain {
     Block<T, BlockSize>* prev = m_Current;
     while (prev) {
       prev = m_Current->m_Prev;
-      delete m_Current;
+      DeleteBlock(m_Current);
       m_Current = prev;
     }
   }
 
+  void SetMemorySubsystem(MemorySubsystem a_Subsystem) {
+    m_MemoryAccount.SetSubsystem(a_Subsystem);
+  }
+
+  Block<T, BlockSize>* NewBlock(Block<T, BlockSize>* a_Prev) {
+    m_MemoryAccount.Add(sizeof(Block<T, BlockSize>));
+    if (m_Allocator == nullptr) {
+      return new Block<T, BlockSize>(this, a_Prev);
+    }
+    void* memory = m_Allocator->Allocate(sizeof(Block<T, BlockSize>));
+    return new (memory) Block<T, BlockSize>(this, a_Prev);
+  }
+
+  void DeleteBlock(Block<T, BlockSize>* a_Block) {
+    m_MemoryAccount.Add(-static_cast<int64_t>(sizeof(Block<T, BlockSize>)));
+    if (m_Allocator == nullptr) {
+      delete a_Block;
+      return;
+    }
+    a_Block->~Block();
+    m_Allocator->Free(a_Block, sizeof(Block<T, BlockSize>));
+  }
+
+  // Moves m_Current to the block after it, which is reused if it is there
+  // from before a Reset rather than allocated.
+  Block<T, BlockSize>* NextBlock() {
+    Block<T, BlockSize>* next = m_Current->m_Next;
+    if (next == nullptr) {
+      next = NewBlock(m_Current);
+      m_Current->m_Next.store(next, std::memory_order_release);
+    }
+
+    m_Current = next;
+    ++m_NumBlocks;
+    return next;
+  }
+
   void push_back(const T& a_Item) { m_Current->Add(a_Item); }
+  void push_back(T&& a_Item) { m_Current->Add(std::move(a_Item)); }
+  // Last item added, for the thread adding the items only.
+  T& back() { return m_Current->m_Data[m_Current->m_Size - 1]; }
 
   void push_back(const T* a_Array, uint32_t a_Num) {
-    for (uint32_t i = 0; i < a_Num; ++i) m_Current->Add(a_Array[i]);
+    Append(a_Num, [a_Array](T* a_Dest, uint32_t a_Offset, uint32_t a_Count) {
+      if constexpr (std::is_trivially_copyable_v<T>) {
+        memcpy(a_Dest, a_Array + a_Offset, a_Count * sizeof(T));
+      } else {
+        std::copy(a_Array + a_Offset, a_Array + a_Offset + a_Count, a_Dest);
+      }
+    });
   }
 
   void push_back_n(const T& a_Item, uint32_t a_Num) {
-    for (uint32_t i = 0; i < a_Num; ++i) m_Current->Add(a_Item);
+    Append(a_Num, [&a_Item](T* a_Dest, uint32_t /*a_Offset*/,
+                            uint32_t a_Count) {
+      std::fill_n(a_Dest, a_Count, a_Item);
+    });
+  }
+
+  // Adds a_Num items a block at a time: a_Write(dest, offset, count) writes
+  // the items [offset, offset + count) of the a_Num to dest, and they are
+  // published at once, rather than item by item.
+  template <class Writer>
+  void Append(uint32_t a_Num, Writer&& a_Write) {
+    uint32_t offset = 0;
+    while (offset < a_Num) {
+      Block<T, BlockSize>* block = m_Current;
+      uint32_t size = block->m_Size.load(std::memory_order_relaxed);
+      if (size == BlockSize) {
+        block = NextBlock();
+        size = block->m_Size.load(std::memory_order_relaxed);
+      }
+
+      uint32_t count = std::min(a_Num - offset, BlockSize - size);
+      a_Write(&block->m_Data[size], offset, count);
+      block->Publish(size, count);
+      offset += count;
+    }
   }
 
   void clear() {
@@ -114,7 +243,7 @@ struct BlockChain {
     Block<T, BlockSize>* prev = m_Current;
     while (prev != m_Root) {
       prev = m_Current->m_Prev;
-      delete m_Current;
+      DeleteBlock(m_Current);
       m_Current = prev;
     }
 
@@ -146,7 +275,7 @@ struct BlockChain {
       assert(m_Root->m_Prev);
       assert(m_Root->m_Prev != m_Current);
 
-      delete m_Root->m_Prev;
+      DeleteBlock(m_Root->m_Prev);
       m_Root->m_Prev = nullptr;
       hasDeleted = true;
     }
@@ -157,11 +286,11 @@ struct BlockChain {
   uint32_t size() const { return m_NumItems; }
 
   T* SlowAt(uint32_t a_Index) {
-    if (a_Index < m_NumItems && a_Index >= 0) {
+    if (a_Index < m_NumItems.load(std::memory_order_acquire)) {
       uint32_t count = 1;
       Block<T, BlockSize>* block = m_Root;
-      while (count * BlockSize < a_Index && block && block->m_Next) {
-        block = block->m_Next;
+      while (count * BlockSize <= a_Index && block && block->GetNext()) {
+        block = block->GetNext();
         ++count;
       }
 
@@ -175,7 +304,7 @@ struct BlockChain {
   Block<T, BlockSize>* GetBlockContaining(const T* a_Element) {
     Block<T, BlockSize>* block = m_Root;
     while (block) {
-      uint32_t size = block->m_Size;
+      uint32_t size = block->GetSize();
       if (size) {
         T* begin = &block->m_Data[0];
         T* end = &block->m_Data[size - 1];
@@ -183,7 +312,7 @@ struct BlockChain {
           return block;
         }
       }
-      block = block->m_Next;
+      block = block->GetNext();
     }
 
     return nullptr;
@@ -194,10 +323,13 @@ struct BlockChain {
     if (block) {
       T* begin = &block->m_Data[0];
       uint32_t index = a_Element - begin;
-      if (index < block->m_Size - 1)
+      uint32_t size = block->GetSize();
+      Block<T, BlockSize>* next =
+          size == BlockSize ? block->GetNext() : nullptr;
+      if (index < size - 1)
         return &block->m_Data[++index];
-      else if (block->m_Next && block->m_Next->m_Size)
-        return &block->m_Next->m_Data[0];
+      else if (next && next->GetSize())
+        return &next->m_Data[0];
     }
     return nullptr;
   }
@@ -210,7 +342,7 @@ struct BlockChain {
       if (index > 0)
         return &block->m_Data[--index];
       else if (block->m_Prev)
-        return &block->m_Prev->m_Data[block->m_Prev->m_Size - 1];
+        return &block->m_Prev->m_Data[block->m_Prev->GetSize() - 1];
     }
     return nullptr;
   }
@@ -222,8 +354,10 @@ struct BlockChain {
     return BlockIterator<T, BlockSize>(nullptr);
   }
 
+  std::shared_ptr<BlockAllocator> m_Allocator;
   Block<T, BlockSize>* m_Root;
   Block<T, BlockSize>* m_Current;
   std::atomic<uint32_t> m_NumBlocks;
   std::atomic<uint32_t> m_NumItems;
+  MemoryAccount m_MemoryAccount;
 };
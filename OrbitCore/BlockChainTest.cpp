@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BlockChain.h"
+
+namespace {
+// Heap blocks, counting the allocations and the blocks that got full.
+class CountingAllocator : public BlockAllocator {
+ public:
+  void* Allocate(size_t size) override {
+    ++num_allocations_;
+    return ::operator new(size);
+  }
+  void Free(void* block, size_t /*size*/) override { ::operator delete(block); }
+  void OnBlockFull(void* /*block*/, size_t /*size*/) override {
+    ++num_full_blocks_;
+  }
+
+  int num_allocations_ = 0;
+  int num_full_blocks_ = 0;
+};
+
+template <class T, uint32_t BlockSize>
+std::vector<T> ToVector(BlockChain<T, BlockSize>& chain) {
+  std::vector<T> items;
+  for (const T& item : chain) items.push_back(item);
+  return items;
+}
+}  // namespace
+
+TEST(BlockChain, AppendsArraysAcrossBlocks) {
+  auto allocator = std::make_shared<CountingAllocator>();
+  BlockChain<uint32_t, 8> chain(allocator);
+  chain.push_back(100);
+  std::vector<uint32_t> items(20);
+  std::iota(items.begin(), items.end(), 0);
+  chain.push_back(items.data(), items.size());
+  chain.push_back_n(7, 5);
+
+  std::vector<uint32_t> expected = {100};
+  expected.insert(expected.end(), items.begin(), items.end());
+  expected.insert(expected.end(), 5, 7);
+  EXPECT_EQ(ToVector(chain), expected);
+  EXPECT_EQ(chain.size(), 26);
+  EXPECT_EQ(chain.m_NumBlocks, 4);
+  EXPECT_EQ(allocator->num_full_blocks_, 3);
+}
+
+TEST(BlockChain, ResetReusesTheBlocks) {
+  auto allocator = std::make_shared<CountingAllocator>();
+  BlockChain<uint32_t, 8> chain(allocator);
+  std::vector<uint32_t> items(30, 1);
+  chain.push_back(items.data(), items.size());
+  EXPECT_EQ(allocator->num_allocations_, 4);
+
+  chain.Reset();
+  EXPECT_EQ(chain.size(), 0);
+  EXPECT_TRUE(ToVector(chain).empty());
+  std::vector<uint32_t> other_items(25, 2);
+  chain.push_back(other_items.data(), other_items.size());
+  EXPECT_EQ(ToVector(chain), other_items);
+  EXPECT_EQ(allocator->num_allocations_, 4);
+}
+
+TEST(BlockChain, HoldsItemsThatAreNotTriviallyCopyable) {
+  BlockChain<std::string, 2> chain;
+  std::vector<std::string> items = {"a", "b", "c"};
+  chain.push_back(items.data(), items.size());
+  std::string moved = "d";
+  chain.push_back(std::move(moved));
+  EXPECT_EQ(ToVector(chain), (std::vector<std::string>{"a", "b", "c", "d"}));
+}
+
+TEST(BlockChain, ReadersSeeCompleteItemsWhileTheWriterAdds) {
+  constexpr uint32_t kNumItems = 100'000;
+  BlockChain<uint64_t, 64> chain;
+  std::atomic<bool> done = false;
+  std::thread writer([&chain, &done] {
+    std::vector<uint64_t> run(10);
+    for (uint64_t i = 0; i < kNumItems;) {
+      if (i % 1000 == 0) {
+        for (uint64_t& item : run) item = i++;
+        chain.push_back(run.data(), run.size());
+      } else {
+        chain.push_back(i++);
+      }
+    }
+    done = true;
+  });
+
+  // Every iteration sees a prefix of the items, at least as long as the size
+  // loaded before it.
+  bool complete = true;
+  bool stop = false;
+  while (!stop && complete) {
+    stop = done;
+    uint32_t size = chain.size();
+    uint64_t expected = 0;
+    for (uint64_t item : chain) {
+      if (item != expected++) complete = false;
+    }
+    if (expected < size) complete = false;
+  }
+  writer.join();
+  EXPECT_TRUE(complete);
+  EXPECT_EQ(chain.size(), kNumItems);
+}
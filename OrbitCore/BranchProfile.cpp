@@ -0,0 +1,90 @@
+#include "BranchProfile.h"
+
+#include <algorithm>
+#include <map>
+
+void BranchProfile::AddCounts(const BranchCount* counts, size_t num_counts) {
+  absl::MutexLock lock(&mutex_);
+  for (size_t i = 0; i < num_counts; ++i) {
+    const BranchCount& count = counts[i];
+    if (count.type == BranchCount::kBranch) {
+      branches_[count.to][count.from] += count.count;
+    } else {
+      ranges_[{count.from, count.to}] += count.count;
+    }
+  }
+}
+
+uint64_t BranchProfile::GetCallCount(uint64_t caller_begin,
+                                     uint64_t caller_end,
+                                     uint64_t callee) const {
+  absl::MutexLock lock(&mutex_);
+  auto it = branches_.find(callee);
+  if (it == branches_.end()) {
+    return 0;
+  }
+  uint64_t call_count = 0;
+  for (const auto& [source, count] : it->second) {
+    if (source >= caller_begin && source < caller_end) {
+      call_count += count;
+    }
+  }
+  return call_count;
+}
+
+absl::flat_hash_map<uint64_t, uint64_t> BranchProfile::GetTakenCounts(
+    uint64_t begin, uint64_t end) const {
+  absl::flat_hash_map<uint64_t, uint64_t> taken_counts;
+  absl::MutexLock lock(&mutex_);
+  for (const auto& [target, counts_by_source] : branches_) {
+    for (const auto& [source, count] : counts_by_source) {
+      if (source >= begin && source < end) {
+        taken_counts[source] += count;
+      }
+    }
+  }
+  return taken_counts;
+}
+
+uint64_t BranchProfile::ExecutionCounts::Get(uint64_t address) const {
+  auto it = std::upper_bound(
+      steps_.begin(), steps_.end(), address,
+      [](uint64_t address, const auto& step) { return address < step.first; });
+  return it == steps_.begin() ? 0 : std::prev(it)->second;
+}
+
+BranchProfile::ExecutionCounts BranchProfile::GetExecutionCounts(
+    uint64_t begin, uint64_t end) const {
+  // Each range adds its count from its first instruction to its last one.
+  std::map<uint64_t, int64_t> deltas;
+  {
+    absl::MutexLock lock(&mutex_);
+    for (const auto& [range, count] : ranges_) {
+      if (range.second < begin || range.first >= end) {
+        continue;
+      }
+      deltas[range.first] += count;
+      deltas[range.second + 1] -= count;
+    }
+  }
+  ExecutionCounts execution_counts;
+  int64_t current = 0;
+  for (const auto& [address, delta] : deltas) {
+    current += delta;
+    execution_counts.steps_.emplace_back(address, current);
+    execution_counts.max_ =
+        std::max(execution_counts.max_, static_cast<uint64_t>(current));
+  }
+  return execution_counts;
+}
+
+bool BranchProfile::IsEmpty() const {
+  absl::MutexLock lock(&mutex_);
+  return branches_.empty() && ranges_.empty();
+}
+
+void BranchProfile::Clear() {
+  absl::MutexLock lock(&mutex_);
+  branches_.clear();
+  ranges_.clear();
+}
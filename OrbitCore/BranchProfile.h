@@ -0,0 +1,74 @@
+#ifndef ORBIT_CORE_BRANCH_PROFILE_H_
+#define ORBIT_CORE_BRANCH_PROFILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
+#pragma pack(push, 1)
+// Payload of Msg_BranchCounts, an array of which counts the branches sampled
+// by the service since the previous message, see
+// Params::m_BranchSamplingPeriod.
+struct BranchCount {
+  enum Type : uint32_t {
+    // A taken branch from the instruction at from to the one at to. Only
+    // calls, unless Params::m_BranchSamplingAllBranches.
+    kBranch,
+    // With Params::m_BranchSamplingAllBranches, code executed straight from
+    // the instruction at from to the one at to, the source of a branch.
+    kRange,
+  };
+  Type type;
+  uint64_t from;
+  uint64_t to;
+  uint64_t count;
+};
+#pragma pack(pop)
+
+// The branches sampled during a capture with the last branch records of the
+// cores. The counts are statistical, so only their ratios are meaningful:
+// the calls to a function from each of its callers, or how hot each
+// instruction of a function is relative to the others.
+class BranchProfile {
+ public:
+  void AddCounts(const BranchCount* counts, size_t num_counts);
+
+  // Of the branches from the code in [caller_begin, caller_end) to callee,
+  // e.g. the calls from a function to another.
+  uint64_t GetCallCount(uint64_t caller_begin, uint64_t caller_end,
+                        uint64_t callee) const;
+  // Of the branches taken from each instruction in [begin, end).
+  absl::flat_hash_map<uint64_t, uint64_t> GetTakenCounts(uint64_t begin,
+                                                         uint64_t end) const;
+
+  // How many of the sampled ranges cover each instruction of some code.
+  class ExecutionCounts {
+   public:
+    uint64_t Get(uint64_t address) const;
+    uint64_t GetMax() const { return max_; }
+
+   private:
+    friend class BranchProfile;
+    // By address, the count from that address to the next one.
+    std::vector<std::pair<uint64_t, uint64_t>> steps_;
+    uint64_t max_ = 0;
+  };
+  ExecutionCounts GetExecutionCounts(uint64_t begin, uint64_t end) const;
+
+  bool IsEmpty() const;
+  void Clear();
+
+ private:
+  mutable absl::Mutex mutex_;
+  // By target, then by source.
+  absl::flat_hash_map<uint64_t, absl::flat_hash_map<uint64_t, uint64_t>>
+      branches_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<std::pair<uint64_t, uint64_t>, uint64_t> ranges_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+#endif  // ORBIT_CORE_BRANCH_PROFILE_H_
@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "BranchProfile.h"
+
+TEST(BranchProfile, CountsCallsPerCaller) {
+  BranchProfile profile;
+  EXPECT_TRUE(profile.IsEmpty());
+
+  constexpr uint64_t kCallee = 0x5000;
+  std::vector<BranchCount> counts{{BranchCount::kBranch, 0x1010, kCallee, 3},
+                                  {BranchCount::kBranch, 0x1020, kCallee, 2},
+                                  {BranchCount::kBranch, 0x2010, kCallee, 7},
+                                  {BranchCount::kBranch, 0x1010, 0x6000, 1}};
+  profile.AddCounts(counts.data(), counts.size());
+  profile.AddCounts(counts.data(), 1);
+
+  EXPECT_FALSE(profile.IsEmpty());
+  EXPECT_EQ(profile.GetCallCount(0x1000, 0x1100, kCallee), 8);
+  EXPECT_EQ(profile.GetCallCount(0x2000, 0x2100, kCallee), 7);
+  EXPECT_EQ(profile.GetCallCount(0x3000, 0x3100, kCallee), 0);
+  EXPECT_EQ(profile.GetCallCount(0x1000, 0x1100, 0x7000), 0);
+
+  absl::flat_hash_map<uint64_t, uint64_t> taken =
+      profile.GetTakenCounts(0x1000, 0x1100);
+  EXPECT_EQ(taken.size(), 2);
+  EXPECT_EQ(taken[0x1010], 7);
+  EXPECT_EQ(taken[0x1020], 2);
+
+  profile.Clear();
+  EXPECT_TRUE(profile.IsEmpty());
+}
+
+TEST(BranchProfile, CountsExecutionsOfInstructionsInRanges) {
+  BranchProfile profile;
+  // 0x1000 to 0x1010 ran 4 times, then 0x1008 to 0x1020 once more.
+  std::vector<BranchCount> counts{{BranchCount::kRange, 0x1000, 0x1010, 4},
+                                  {BranchCount::kRange, 0x1008, 0x1020, 1},
+                                  {BranchCount::kRange, 0x3000, 0x3010, 9}};
+  profile.AddCounts(counts.data(), counts.size());
+
+  BranchProfile::ExecutionCounts execution_counts =
+      profile.GetExecutionCounts(0x1000, 0x2000);
+  EXPECT_EQ(execution_counts.Get(0xff0), 0);
+  EXPECT_EQ(execution_counts.Get(0x1000), 4);
+  EXPECT_EQ(execution_counts.Get(0x1008), 5);
+  EXPECT_EQ(execution_counts.Get(0x1010), 5);
+  EXPECT_EQ(execution_counts.Get(0x1014), 1);
+  EXPECT_EQ(execution_counts.Get(0x1020), 1);
+  EXPECT_EQ(execution_counts.Get(0x1024), 0);
+  EXPECT_EQ(execution_counts.Get(0x3000), 0);
+  EXPECT_EQ(execution_counts.GetMax(), 5);
+}
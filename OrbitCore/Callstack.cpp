@@ -4,6 +4,8 @@
 
 #include "Callstack.h"
 
+#include <algorithm>
+
 #include "Capture.h"
 #include "Core.h"
 #include "OrbitProcess.h"
@@ -101,7 +103,18 @@ StackFrame::StackFrame(HANDLE a_Thread) {
 //-----------------------------------------------------------------------------
 __declspec(noinline) CallStackPOD CallStackPOD::Walk(DWORD64 a_Rip,
                                                      DWORD64 a_Rsp) {
+  return Walk(a_Rip, a_Rsp, nullptr, 0, 0);
+}
+
+//-----------------------------------------------------------------------------
+__declspec(noinline) CallStackPOD CallStackPOD::Walk(
+    DWORD64 a_Rip, DWORD64 a_Rsp, const DWORD64* a_CallerFrames,
+    int a_CallerDepth, DWORD64 a_CallerRsp,
+    const CallstackHashState& a_CallerOuterHash,
+    CallstackHashState* o_OuterHash) {
   CallStackPOD callstack;
+  // Of the outermost frames, if copied whole from the caller.
+  CallstackHashState outerHash;
 
 #ifdef _WIN64
   CONTEXT Context;
@@ -143,6 +156,22 @@ __declspec(noinline) CallStackPOD CallStackPOD::Walk(DWORD64 a_Rip,
 
     if (!Context.Rip) break;
 
+    // The walk of the enclosing call started at its entry, so its frames
+    // past the first are those from the return to its caller, which is
+    // where this unwinding is when back at the same stack location.
+    if (a_CallerDepth > 1 && Context.Rsp == a_CallerRsp + sizeof(DWORD64) &&
+        Context.Rip == a_CallerFrames[1]) {
+      int numFrames = std::min(a_CallerDepth - 1,
+                               int(ORBIT_STACK_SIZE) - callstack.m_Depth);
+      memcpy(&callstack.m_Data[callstack.m_Depth], &a_CallerFrames[1],
+             numFrames * sizeof(DWORD64));
+      callstack.m_Depth += numFrames;
+      if (numFrames == a_CallerDepth - 1) {
+        outerHash = a_CallerOuterHash;
+      }
+      break;
+    }
+
     if (callstack.m_Depth < ORBIT_STACK_SIZE) {
       callstack.m_Data[callstack.m_Depth++] = Context.Rip;
     }
@@ -152,14 +181,18 @@ __declspec(noinline) CallStackPOD CallStackPOD::Walk(DWORD64 a_Rip,
   callstack = GetCallstackManual(a_Rip, a_Rsp);
 #endif
 
-  callstack.Hash();
+  CallstackHashState unusedOuterHash;
+  callstack.Hash(outerHash,
+                 o_OuterHash != nullptr ? o_OuterHash : &unusedOuterHash);
   return callstack;
 }
 
 #endif
 
 //-----------------------------------------------------------------------------
-ORBIT_SERIALIZE(CallStack, 0) {
+// Version 1: m_Hash is from HashCallstack instead of XXH64. Hashes are kept
+// as saved, so captures of version 0 still load.
+ORBIT_SERIALIZE(CallStack, 1) {
   ORBIT_NVP_VAL(0, m_Data);
   ORBIT_NVP_VAL(0, m_Hash);
   ORBIT_NVP_VAL(0, m_Depth);
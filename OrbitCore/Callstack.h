@@ -3,6 +3,7 @@
 //-----------------------------------
 #pragma once
 
+#include "CallstackHash.h"
 #include "CallstackTypes.h"
 #include "OrbitDbgHelp.h"
 #include "PrintVar.h"
@@ -13,12 +14,43 @@
 struct CallStackPOD {
   CallStackPOD() { memset(this, 0, sizeof(CallStackPOD)); }
   static CallStackPOD Walk(DWORD64 a_Rip, DWORD64 a_Rsp);
+  // Same as Walk, for a call made within an enclosing call still running,
+  // whose callstack a_CallerFrames was walked from the return address
+  // location a_CallerRsp. Once the unwinding reaches the caller of the
+  // enclosing call, the frames above are copied from its callstack rather
+  // than unwound again, and their hash resumes from a_CallerOuterHash, the
+  // o_OuterHash of the enclosing call.
+  static CallStackPOD Walk(DWORD64 a_Rip, DWORD64 a_Rsp,
+                           const DWORD64* a_CallerFrames, int a_CallerDepth,
+                           DWORD64 a_CallerRsp,
+                           const CallstackHashState& a_CallerOuterHash =
+                               CallstackHashState(),
+                           CallstackHashState* o_OuterHash = nullptr);
   size_t GetSizeInBytes() {
     return offsetof(CallStackPOD, m_Data) + m_Depth * sizeof(m_Data[0]);
   }
 
   inline CallstackID Hash() {
-    m_Hash = XXH64(&m_Data[0], m_Depth * sizeof(DWORD64), 0xca1157ac);
+    static_assert(sizeof(m_Data[0]) == sizeof(uint64_t));
+    m_Hash = HashCallstack(reinterpret_cast<const uint64_t*>(&m_Data[0]),
+                           m_Depth);
+    return m_Hash;
+  }
+  // Same, resuming from a_OuterHash, the state of the outermost frames. The
+  // state of all the frames but the innermost is kept in o_OuterHash: the
+  // callstacks of the calls made from the innermost frame share them.
+  inline CallstackID Hash(const CallstackHashState& a_OuterHash,
+                          CallstackHashState* o_OuterHash) {
+    if (m_Depth == 0) {
+      *o_OuterHash = CallstackHashState();
+      return Hash();
+    }
+    const uint64_t* frames = reinterpret_cast<const uint64_t*>(&m_Data[0]);
+    CallstackHashState state = a_OuterHash;
+    state.Update(frames + 1, m_Depth - 1 - a_OuterHash.GetDepth());
+    *o_OuterHash = state;
+    state.Update(frames, 1);
+    m_Hash = state.Digest();
     return m_Hash;
   }
 
@@ -35,7 +67,7 @@ struct CallStack {
   CallStack(CallStackPOD a_CS);
   inline CallstackID Hash() {
     if (m_Hash != 0) return m_Hash;
-    m_Hash = XXH64(m_Data.data(), m_Depth * sizeof(uint64_t), 0xca1157ac);
+    m_Hash = HashCallstack(m_Data.data(), m_Depth);
     return m_Hash;
   }
   void Print();
@@ -0,0 +1,132 @@
+#include "CallstackEventColumns.h"
+
+#include <algorithm>
+
+bool CallstackEventColumns::Add(int64_t time, CallstackID id) {
+  size_t index = size_.load(std::memory_order_relaxed);
+  if (time < last_time_ || index == kMaxSize) {
+    return false;
+  }
+
+  size_t chunk_index = index / kChunkSize;
+  std::unique_ptr<Directory>& directory =
+      directories_[chunk_index / kChunksPerDirectory];
+  if (directory == nullptr) {
+    directory = std::make_unique<Directory>();
+    memory_account_.Add(sizeof(Directory));
+  }
+  std::unique_ptr<Chunk>& chunk =
+      (*directory)[chunk_index % kChunksPerDirectory];
+  if (chunk == nullptr) {
+    chunk = std::make_unique<Chunk>();
+    memory_account_.Add(sizeof(Chunk));
+  }
+  chunk->times[index % kChunkSize] = time;
+  chunk->ids[index % kChunkSize] = id;
+  last_time_ = time;
+  size_.store(index + 1, std::memory_order_release);
+  return true;
+}
+
+size_t CallstackEventColumns::LowerBound(int64_t time,
+                                         size_t num_samples) const {
+  size_t begin = 0;
+  size_t end = num_samples;
+  while (begin < end) {
+    size_t middle = begin + (end - begin) / 2;
+    if (GetTime(middle) < time) {
+      begin = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+  return begin;
+}
+
+size_t CallstackEventColumns::CountEvents(int64_t begin_time,
+                                          int64_t end_time) const {
+  size_t num_samples = size();
+  size_t begin = LowerBound(begin_time, num_samples);
+  return std::max(begin, LowerBound(end_time, num_samples)) - begin;
+}
+
+void CallstackEventColumns::CountEventsInBins(
+    int64_t begin_time, int64_t end_time, size_t num_bins,
+    std::vector<uint32_t>* counts) const {
+  counts->assign(num_bins, 0);
+  if (num_bins == 0 || end_time <= begin_time) {
+    return;
+  }
+  size_t num_samples = size();
+  // Bins are computed in double, as end_time - begin_time times num_bins can
+  // overflow.
+  double bin_duration =
+      static_cast<double>(end_time - begin_time) / num_bins;
+  size_t bin_begin = LowerBound(begin_time, num_samples);
+  for (size_t bin = 0; bin < num_bins && bin_begin < num_samples; ++bin) {
+    int64_t bin_end_time =
+        bin + 1 == num_bins
+            ? end_time
+            : begin_time + static_cast<int64_t>((bin + 1) * bin_duration);
+    size_t bin_end =
+        std::max(bin_begin, LowerBound(bin_end_time, num_samples));
+    (*counts)[bin] = static_cast<uint32_t>(bin_end - bin_begin);
+    bin_begin = bin_end;
+  }
+}
+
+void CallstackEventColumns::CountCallstacks(int64_t begin_time,
+                                            int64_t end_time,
+                                            CallstackCounts* counts) const {
+  size_t num_samples = size();
+  size_t begin = LowerBound(begin_time, num_samples);
+  size_t end = std::max(begin, LowerBound(end_time, num_samples));
+  size_t first_chunk = (begin + kChunkSize - 1) / kChunkSize;
+  size_t last_chunk = end / kChunkSize;
+  if (first_chunk >= last_chunk) {
+    CountSamples(begin, end, counts);
+    return;
+  }
+
+  CountSamples(begin, first_chunk * kChunkSize, counts);
+  {
+    absl::MutexLock lock(&chunk_counts_mutex_);
+    for (size_t chunk = chunk_counts_.size(); chunk < last_chunk; ++chunk) {
+      CallstackCounts& chunk_counts = chunk_counts_.emplace_back();
+      CountSamples(chunk * kChunkSize, (chunk + 1) * kChunkSize, &chunk_counts);
+      memory_account_.Add(sizeof(CallstackCounts) +
+                          chunk_counts.bucket_count() *
+                              (sizeof(CallstackCounts::value_type) + 1));
+    }
+    for (size_t chunk = first_chunk; chunk < last_chunk; ++chunk) {
+      for (const auto& it : chunk_counts_[chunk]) {
+        (*counts)[it.first] += it.second;
+      }
+    }
+  }
+  CountSamples(last_chunk * kChunkSize, end, counts);
+}
+
+size_t CallstackEventColumns::GetMemorySize() const {
+  size_t num_chunks = (size() + kChunkSize - 1) / kChunkSize;
+  size_t num_directories =
+      (num_chunks + kChunksPerDirectory - 1) / kChunksPerDirectory;
+  size_t memory_size = sizeof(*this) + num_chunks * sizeof(Chunk) +
+                       num_directories * sizeof(Directory);
+
+  absl::MutexLock lock(&chunk_counts_mutex_);
+  memory_size += chunk_counts_.capacity() * sizeof(CallstackCounts);
+  for (const CallstackCounts& chunk_counts : chunk_counts_) {
+    // A slot and a control byte per bucket.
+    memory_size += chunk_counts.bucket_count() *
+                   (sizeof(CallstackCounts::value_type) + 1);
+  }
+  return memory_size;
+}
+
+void CallstackEventColumns::CountSamples(size_t begin, size_t end,
+                                         CallstackCounts* counts) const {
+  for (size_t i = begin; i < end; ++i) {
+    ++(*counts)[GetId(i)];
+  }
+}
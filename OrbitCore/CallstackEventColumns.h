@@ -0,0 +1,113 @@
+#ifndef ORBIT_CORE_CALLSTACK_EVENT_COLUMNS_H_
+#define ORBIT_CORE_CALLSTACK_EVENT_COLUMNS_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "CallstackTypes.h"
+#include "MemoryAccounting.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
+using CallstackCounts = absl::flat_hash_map<CallstackID, uint32_t>;
+
+// Samples of a thread in time order, in chunks of kChunkSize samples holding
+// a column of times and a column of callstack ids. A single thread appends
+// samples without locking while others read them: chunks never move, and
+// the number of samples is published once they are written, so readers only
+// see complete samples.
+//
+// Counting the callstacks of a time range merges the histograms of the
+// chunks it covers and only scans the samples at its ends, so that it
+// doesn't depend on the number of samples in the range.
+class CallstackEventColumns {
+ public:
+  static constexpr size_t kChunkSize = 1024;
+  static constexpr size_t kChunksPerDirectory = 1024;
+  static constexpr size_t kMaxDirectories = 256;
+  static constexpr size_t kMaxSize =
+      kChunkSize * kChunksPerDirectory * kMaxDirectories;
+
+  // Only one thread at a time can add samples. Returns false, and drops the
+  // sample, if it is older than the previous one or if the columns are full.
+  bool Add(int64_t time, CallstackID id);
+
+  size_t size() const { return size_.load(std::memory_order_acquire); }
+  int64_t GetTime(size_t index) const {
+    return GetChunk(index)->times[index % kChunkSize];
+  }
+  CallstackID GetId(size_t index) const {
+    return GetChunk(index)->ids[index % kChunkSize];
+  }
+  // Index of the first sample at or after time, among the first num_samples.
+  size_t LowerBound(int64_t time, size_t num_samples) const;
+
+  // Calls callback(time, id) for each sample from begin_time, inclusive, to
+  // end_time, exclusive, in time order.
+  template <typename Callback>
+  void ForEachEvent(int64_t begin_time, int64_t end_time,
+                    Callback&& callback) const {
+    size_t num_samples = size();
+    for (size_t i = LowerBound(begin_time, num_samples); i < num_samples;
+         ++i) {
+      const Chunk* chunk = GetChunk(i);
+      int64_t time = chunk->times[i % kChunkSize];
+      if (time >= end_time) {
+        break;
+      }
+      callback(time, chunk->ids[i % kChunkSize]);
+    }
+  }
+
+  // Number of samples from begin_time, inclusive, to end_time, exclusive.
+  size_t CountEvents(int64_t begin_time, int64_t end_time) const;
+  // Splits [begin_time, end_time) into num_bins bins of equal duration and
+  // sets counts to the number of samples in each. Only looks up the bounds of
+  // the bins, so it doesn't depend on the number of samples in the range.
+  void CountEventsInBins(int64_t begin_time, int64_t end_time,
+                         size_t num_bins, std::vector<uint32_t>* counts) const;
+
+  // Adds the number of samples of each callstack from begin_time, inclusive,
+  // to end_time, exclusive, to counts.
+  void CountCallstacks(int64_t begin_time, int64_t end_time,
+                       CallstackCounts* counts) const;
+
+  // Bytes used by the samples and by the histograms.
+  size_t GetMemorySize() const;
+
+ private:
+  struct Chunk {
+    int64_t times[kChunkSize];
+    CallstackID ids[kChunkSize];
+  };
+  using Directory = std::array<std::unique_ptr<Chunk>, kChunksPerDirectory>;
+
+  const Chunk* GetChunk(size_t index) const {
+    size_t chunk_index = index / kChunkSize;
+    return (*directories_[chunk_index / kChunksPerDirectory])
+        [chunk_index % kChunksPerDirectory]
+            .get();
+  }
+  // Of the samples with indices in [begin, end).
+  void CountSamples(size_t begin, size_t end, CallstackCounts* counts) const;
+
+  std::atomic<size_t> size_ = 0;
+  // Only touched by the thread adding samples.
+  int64_t last_time_ = INT64_MIN;
+  // Entries are set before the samples they hold are published.
+  std::array<std::unique_ptr<Directory>, kMaxDirectories> directories_;
+
+  // Of the full chunks, computed when counting.
+  mutable absl::Mutex chunk_counts_mutex_;
+  mutable std::vector<CallstackCounts> chunk_counts_
+      ABSL_GUARDED_BY(chunk_counts_mutex_);
+
+  // Of the chunks and the histograms, as they are allocated.
+  mutable MemoryAccount memory_account_{MemorySubsystem::kEventBuffer};
+};
+
+#endif  // ORBIT_CORE_CALLSTACK_EVENT_COLUMNS_H_
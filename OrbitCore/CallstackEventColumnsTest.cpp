@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "CallstackEventColumns.h"
+
+namespace {
+// Counted one sample at a time, for reference.
+CallstackCounts CountSamples(const std::vector<int64_t>& times,
+                             const std::vector<CallstackID>& ids,
+                             int64_t begin_time, int64_t end_time) {
+  CallstackCounts counts;
+  for (size_t i = 0; i < times.size(); ++i) {
+    if (times[i] >= begin_time && times[i] < end_time) {
+      ++counts[ids[i]];
+    }
+  }
+  return counts;
+}
+}  // namespace
+
+TEST(CallstackEventColumns, CountsTimeRanges) {
+  CallstackEventColumns columns;
+  std::vector<int64_t> times;
+  std::vector<CallstackID> ids;
+  const size_t num_samples = 5 * CallstackEventColumns::kChunkSize + 10;
+  for (size_t i = 0; i < num_samples; ++i) {
+    times.push_back(10 * i);
+    ids.push_back(i % 7);
+    EXPECT_TRUE(columns.Add(times.back(), ids.back()));
+  }
+  EXPECT_EQ(columns.size(), num_samples);
+  EXPECT_EQ(columns.GetTime(num_samples - 1), times.back());
+  EXPECT_EQ(columns.GetId(num_samples - 1), ids.back());
+
+  const int64_t chunk_time = 10 * CallstackEventColumns::kChunkSize;
+  std::vector<std::pair<int64_t, int64_t>> time_ranges = {
+      {0, 0},
+      {0, 10 * num_samples},
+      {-100, 5},
+      {15, 95},
+      {50, 10},
+      {chunk_time, 2 * chunk_time},
+      {chunk_time - 5, 3 * chunk_time},
+      {25, 4 * chunk_time + 35},
+      {5 * chunk_time, INT64_MAX}};
+  for (auto [begin_time, end_time] : time_ranges) {
+    CallstackCounts counts;
+    columns.CountCallstacks(begin_time, end_time, &counts);
+    EXPECT_EQ(counts, CountSamples(times, ids, begin_time, end_time))
+        << begin_time << " " << end_time;
+  }
+}
+
+TEST(CallstackEventColumns, ListsTimeRanges) {
+  CallstackEventColumns columns;
+  for (int64_t time : {10, 20, 20, 30, 40}) {
+    EXPECT_TRUE(columns.Add(time, time + 1));
+  }
+  // Late samples are dropped.
+  EXPECT_FALSE(columns.Add(35, 0));
+  EXPECT_EQ(columns.size(), 5);
+
+  std::vector<std::pair<int64_t, CallstackID>> events;
+  columns.ForEachEvent(15, 40, [&events](int64_t time, CallstackID id) {
+    events.emplace_back(time, id);
+  });
+  EXPECT_EQ(events, (std::vector<std::pair<int64_t, CallstackID>>{
+                        {20, 21}, {20, 21}, {30, 31}}));
+  EXPECT_EQ(columns.LowerBound(20, columns.size()), 1);
+  EXPECT_EQ(columns.LowerBound(41, columns.size()), 5);
+  EXPECT_GT(columns.GetMemorySize(), 0);
+}
+
+TEST(CallstackEventColumns, CountsEventsInBins) {
+  CallstackEventColumns columns;
+  for (int64_t time : {0, 5, 9, 10, 25, 26, 27, 39, 40}) {
+    EXPECT_TRUE(columns.Add(time, 1));
+  }
+  EXPECT_EQ(columns.CountEvents(5, 40), 7);
+  EXPECT_EQ(columns.CountEvents(40, 5), 0);
+
+  std::vector<uint32_t> counts;
+  columns.CountEventsInBins(0, 40, 4, &counts);
+  EXPECT_EQ(counts, (std::vector<uint32_t>{3, 1, 3, 1}));
+  columns.CountEventsInBins(0, 40, 3, &counts);
+  EXPECT_EQ(counts, (std::vector<uint32_t>{4, 1, 3}));
+  columns.CountEventsInBins(100, 200, 2, &counts);
+  EXPECT_EQ(counts, (std::vector<uint32_t>{0, 0}));
+  columns.CountEventsInBins(0, 40, 0, &counts);
+  EXPECT_TRUE(counts.empty());
+}
+
+TEST(CallstackEventColumns, ReadsWhileAdding) {
+  CallstackEventColumns columns;
+  const size_t num_samples = 20 * CallstackEventColumns::kChunkSize;
+  std::thread producer([&columns, num_samples] {
+    for (size_t i = 0; i < num_samples; ++i) {
+      columns.Add(i, i);
+    }
+  });
+
+  for (size_t num_read = 0; num_read < num_samples;) {
+    num_read = columns.size();
+    CallstackCounts counts;
+    columns.CountCallstacks(0, num_read, &counts);
+    ASSERT_EQ(counts.size(), num_read);
+    for (size_t i = 0; i < num_read; i += 97) {
+      ASSERT_EQ(columns.GetId(i), i);
+    }
+  }
+  producer.join();
+}
@@ -0,0 +1,101 @@
+#ifndef ORBIT_CORE_CALLSTACK_HASH_H_
+#define ORBIT_CORE_CALLSTACK_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "CallstackTypes.h"
+
+// The hash identifying a callstack, computed per sample on the service and
+// per call in the Windows hooks. Unlike XXH64 over the bytes of the frames,
+// which it replaces, it reads whole 64-bit frames into four independent
+// lanes, so that the multiplications of consecutive frames overlap instead
+// of waiting on each other.
+//
+// Frames are taken from the outermost, m_Data[m_Depth - 1], to the
+// innermost, m_Data[0]: the state after the frames of a caller is a prefix
+// of the hashes of all the callstacks below it, from which hashing can
+// resume instead of going over its frames again.
+//
+// The hashes are saved in captures, where they identify the callstacks, and
+// are kept as saved when loading: a capture hashed with another version
+// stays loadable, but the value must not change within a version.
+constexpr uint32_t kCallstackHashVersion = 1;
+
+class CallstackHashState {
+ public:
+  CallstackHashState() = default;
+
+  // Adds the frames from frames[num_frames - 1], the outermost, down to
+  // frames[0].
+  void Update(const uint64_t* frames, size_t num_frames) {
+    while (num_frames > 0) {
+      // Frames go to the lane of their distance to the outermost frame.
+      if ((depth_ & 3) == 0) {
+        while (num_frames >= 4) {
+          lanes_[0] = Round(lanes_[0], frames[num_frames - 1]);
+          lanes_[1] = Round(lanes_[1], frames[num_frames - 2]);
+          lanes_[2] = Round(lanes_[2], frames[num_frames - 3]);
+          lanes_[3] = Round(lanes_[3], frames[num_frames - 4]);
+          num_frames -= 4;
+          depth_ += 4;
+        }
+        if (num_frames == 0) break;
+      }
+      lanes_[depth_ & 3] = Round(lanes_[depth_ & 3], frames[--num_frames]);
+      ++depth_;
+    }
+  }
+
+  CallstackID Digest() const {
+    uint64_t hash = RotateLeft(lanes_[0], 1) + RotateLeft(lanes_[1], 7) +
+                    RotateLeft(lanes_[2], 12) + RotateLeft(lanes_[3], 18);
+    hash ^= depth_ * kPrime5;
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+  }
+
+  uint32_t GetDepth() const { return depth_; }
+
+ private:
+  static constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+  static constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+  static constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+  static constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+  static constexpr uint64_t kSeed = 0xca1157ac;
+
+  static uint64_t RotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+  }
+  static uint64_t Round(uint64_t lane, uint64_t frame) {
+    lane += frame * kPrime2;
+    lane = RotateLeft(lane, 31);
+    return lane * kPrime1;
+  }
+
+  uint64_t lanes_[4] = {kSeed + kPrime1 + kPrime2, kSeed + kPrime2, kSeed,
+                        kSeed - kPrime1};
+  uint32_t depth_ = 0;
+};
+
+// Hash of the callstack frames[0..depth), frames[0] being the innermost.
+inline CallstackID HashCallstack(const uint64_t* frames, size_t depth) {
+  CallstackHashState state;
+  state.Update(frames, depth);
+  return state.Digest();
+}
+
+// Same, resuming from the state of its outermost frames, those of a caller:
+// only frames[0..depth - caller.GetDepth()) are read.
+inline CallstackID HashCallstack(const uint64_t* frames, size_t depth,
+                                 const CallstackHashState& caller) {
+  CallstackHashState state = caller;
+  state.Update(frames, depth - caller.GetDepth());
+  return state.Digest();
+}
+
+#endif  // ORBIT_CORE_CALLSTACK_HASH_H_
@@ -0,0 +1,35 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "CallstackHash.h"
+
+TEST(CallstackHash, IsStable) {
+  // Saved in captures: changing it needs a new kCallstackHashVersion.
+  std::vector<uint64_t> frames = {0x1000, 0x2000, 0x3000, 0x4000, 0x5000};
+  EXPECT_EQ(HashCallstack(frames.data(), frames.size()),
+            0x34eada447a1f2005ULL);
+  EXPECT_EQ(HashCallstack(frames.data(), 0), 0x9f399d63a0ab8057ULL);
+}
+
+TEST(CallstackHash, DependsOnOrderAndDepth) {
+  std::vector<uint64_t> frames = {1, 2, 3, 4, 5, 6, 7, 8};
+  std::vector<uint64_t> swapped = {2, 1, 3, 4, 5, 6, 7, 8};
+  std::vector<uint64_t> zeros(8, 0);
+  CallstackID hash = HashCallstack(frames.data(), frames.size());
+  EXPECT_NE(hash, HashCallstack(swapped.data(), swapped.size()));
+  EXPECT_NE(hash, HashCallstack(frames.data(), frames.size() - 1));
+  EXPECT_NE(HashCallstack(zeros.data(), 7), HashCallstack(zeros.data(), 8));
+}
+
+TEST(CallstackHash, ResumesFromTheFramesOfACaller) {
+  // frames[0] is the innermost frame: the callers are at the end.
+  std::vector<uint64_t> frames = {9, 8, 7, 6, 5, 4, 3, 2, 1};
+  for (size_t caller_depth = 0; caller_depth <= frames.size();
+       ++caller_depth) {
+    CallstackHashState caller;
+    caller.Update(frames.data() + frames.size() - caller_depth, caller_depth);
+    EXPECT_EQ(HashCallstack(frames.data(), frames.size(), caller),
+              HashCallstack(frames.data(), frames.size()));
+  }
+}
@@ -0,0 +1,47 @@
+#include "CallstackTree.h"
+
+CallstackTree::NodeId CallstackTree::Intern(
+    absl::Span<const uint64_t> frames) {
+  NodeId id = kRootId;
+  for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+    id = InternChild(id, *it);
+  }
+  return id;
+}
+
+CallstackTree::NodeId CallstackTree::InternChild(NodeId parent,
+                                                 uint64_t address) {
+  auto [it, inserted] = children_.try_emplace(
+      std::make_pair(parent, address), static_cast<NodeId>(nodes_.size()));
+  if (inserted) {
+    Node& parent_node = nodes_[parent];
+    nodes_.push_back(Node{address, parent, parent_node.depth + 1, kInvalidId,
+                          parent_node.first_child});
+    // parent_node might have moved with the push_back.
+    nodes_[parent].first_child = it->second;
+  }
+  return it->second;
+}
+
+std::vector<uint64_t> CallstackTree::GetFrames(NodeId id) const {
+  std::vector<uint64_t> frames;
+  frames.reserve(GetDepth(id));
+  for (; id != kRootId; id = GetParent(id)) {
+    frames.push_back(GetAddress(id));
+  }
+  return frames;
+}
+
+void CallstackTree::Clear() {
+  nodes_.assign(1, Node{0, kInvalidId, 0, kInvalidId, kInvalidId});
+  children_.clear();
+}
+
+std::vector<uint64_t> CallstackTree::ComputeInclusiveCounts(
+    std::vector<uint64_t> counts) const {
+  counts.resize(nodes_.size());
+  for (NodeId id = nodes_.size() - 1; id != kRootId; --id) {
+    counts[GetParent(id)] += counts[id];
+  }
+  return counts;
+}
@@ -0,0 +1,63 @@
+#ifndef ORBIT_CORE_CALLSTACK_TREE_H_
+#define ORBIT_CORE_CALLSTACK_TREE_H_
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
+
+// Distinct callstacks interned in a prefix tree, from the outermost frame to
+// the innermost one: callstacks sharing their callers share their nodes, and
+// a callstack is a single node id. Nodes are only appended, after their
+// parent, so that sweeping them backwards visits callees before their
+// callers, which aggregates samples over the whole tree in O(nodes).
+class CallstackTree {
+ public:
+  using NodeId = uint32_t;
+  // Node of the empty callstack, and parent of the outermost frames.
+  static constexpr NodeId kRootId = 0;
+  static constexpr NodeId kInvalidId = std::numeric_limits<NodeId>::max();
+
+  CallstackTree() { Clear(); }
+
+  // Frames are innermost first, like in CallStack::m_Data.
+  NodeId Intern(absl::Span<const uint64_t> frames);
+  // Node of the callstack calling address from the callstack of parent.
+  NodeId InternChild(NodeId parent, uint64_t address);
+
+  uint64_t GetAddress(NodeId id) const { return nodes_[id].address; }
+  NodeId GetParent(NodeId id) const { return nodes_[id].parent; }
+  uint32_t GetDepth(NodeId id) const { return nodes_[id].depth; }
+  // Children are in no particular order. kInvalidId ends the list.
+  NodeId GetFirstChild(NodeId id) const { return nodes_[id].first_child; }
+  NodeId GetNextSibling(NodeId id) const { return nodes_[id].next_sibling; }
+  // Innermost first.
+  std::vector<uint64_t> GetFrames(NodeId id) const;
+
+  // Number of nodes, the root included. Ids are below it.
+  size_t size() const { return nodes_.size(); }
+  void Clear();
+
+  // Returns the counts of each node plus those of all of its descendants,
+  // e.g. the samples with a node's frame and callers on the stack from the
+  // samples of each callstack. counts has an entry per node.
+  std::vector<uint64_t> ComputeInclusiveCounts(
+      std::vector<uint64_t> counts) const;
+
+ private:
+  struct Node {
+    uint64_t address;
+    NodeId parent;
+    uint32_t depth;
+    NodeId first_child;
+    NodeId next_sibling;
+  };
+
+  std::vector<Node> nodes_;
+  absl::flat_hash_map<std::pair<NodeId, uint64_t>, NodeId> children_;
+};
+
+#endif  // ORBIT_CORE_CALLSTACK_TREE_H_
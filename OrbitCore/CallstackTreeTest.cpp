@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "CallstackTree.h"
+
+TEST(CallstackTree, SharesCallers) {
+  CallstackTree tree;
+  // Innermost frames first.
+  std::vector<uint64_t> frames0 = {3, 2, 1};
+  std::vector<uint64_t> frames1 = {4, 2, 1};
+  CallstackTree::NodeId id0 = tree.Intern(frames0);
+  CallstackTree::NodeId id1 = tree.Intern(frames1);
+  EXPECT_NE(id0, id1);
+  // The root, then 1, 2, 3 and 4.
+  EXPECT_EQ(tree.size(), 5);
+  EXPECT_EQ(tree.GetParent(id0), tree.GetParent(id1));
+  EXPECT_EQ(tree.GetAddress(tree.GetParent(id0)), 2);
+  EXPECT_EQ(tree.GetDepth(id0), 3);
+  EXPECT_EQ(tree.Intern(frames0), id0);
+  EXPECT_EQ(tree.GetFrames(id0), frames0);
+  EXPECT_EQ(tree.GetFrames(id1), frames1);
+
+  EXPECT_EQ(tree.Intern({}), CallstackTree::kRootId);
+  EXPECT_EQ(tree.GetFrames(CallstackTree::kRootId), std::vector<uint64_t>{});
+  // A callstack that is the prefix of another one.
+  CallstackTree::NodeId id2 = tree.Intern(std::vector<uint64_t>{2, 1});
+  EXPECT_EQ(id2, tree.GetParent(id0));
+  EXPECT_EQ(tree.size(), 5);
+
+  tree.Clear();
+  EXPECT_EQ(tree.size(), 1);
+  EXPECT_EQ(tree.GetFirstChild(CallstackTree::kRootId),
+            CallstackTree::kInvalidId);
+}
+
+TEST(CallstackTree, ListsChildren) {
+  CallstackTree tree;
+  CallstackTree::NodeId parent = tree.Intern(std::vector<uint64_t>{1});
+  std::vector<uint64_t> children;
+  tree.Intern(std::vector<uint64_t>{2, 1});
+  tree.Intern(std::vector<uint64_t>{3, 1});
+  // Not a child of parent.
+  tree.Intern(std::vector<uint64_t>{4});
+  for (CallstackTree::NodeId id = tree.GetFirstChild(parent);
+       id != CallstackTree::kInvalidId; id = tree.GetNextSibling(id)) {
+    EXPECT_EQ(tree.GetParent(id), parent);
+    children.push_back(tree.GetAddress(id));
+  }
+  std::sort(children.begin(), children.end());
+  EXPECT_EQ(children, (std::vector<uint64_t>{2, 3}));
+}
+
+TEST(CallstackTree, ComputesInclusiveCounts) {
+  CallstackTree tree;
+  CallstackTree::NodeId id0 = tree.Intern(std::vector<uint64_t>{3, 2, 1});
+  CallstackTree::NodeId id1 = tree.Intern(std::vector<uint64_t>{4, 2, 1});
+  CallstackTree::NodeId id2 = tree.Intern(std::vector<uint64_t>{1});
+  std::vector<uint64_t> counts(tree.size());
+  counts[id0] = 5;
+  counts[id1] = 2;
+  counts[id2] = 1;
+  std::vector<uint64_t> inclusive = tree.ComputeInclusiveCounts(counts);
+  EXPECT_EQ(inclusive[CallstackTree::kRootId], 8);
+  EXPECT_EQ(inclusive[id2], 8);
+  EXPECT_EQ(inclusive[tree.GetParent(id0)], 7);
+  EXPECT_EQ(inclusive[id0], 5);
+  EXPECT_EQ(inclusive[id1], 2);
+}
@@ -7,10 +7,12 @@
 #include <fstream>
 #include <ostream>
 
+#include "CaptureTriggers.h"
 #include "Core.h"
 #include "CoreApp.h"
 #include "EventBuffer.h"
 #include "EventTracer.h"
+#include "FlightRecorder.h"
 #include "Injection.h"
 #include "Log.h"
 #include "OrbitBase/Logging.h"
@@ -33,6 +35,14 @@
 std::shared_ptr<Pdb> GPdbDbg;
 #endif
 
+namespace {
+// With the control block of its shared_ptr.
+uint64_t GetMemorySize(const CallStack& a_CallStack) {
+  return sizeof(CallStack) + 2 * sizeof(void*) +
+         a_CallStack.m_Data.capacity() * sizeof(a_CallStack.m_Data[0]);
+}
+}  // namespace
+
 bool Capture::GInjected = false;
 bool Capture::GIsConnected = false;
 std::string Capture::GInjectedProcess;
@@ -44,6 +54,7 @@ uint32_t Capture::GNumSamplingTicks = 0;
 uint32_t Capture::GFunctionIndex = -1;
 uint32_t Capture::GNumInstalledHooks;
 bool Capture::GHasContextSwitches;
+bool Capture::GHasThreadStates;
 Timer Capture::GTestTimer;
 ULONG64 Capture::GMainFrameFunction;
 uint64_t Capture::GNumContextSwitches;
@@ -57,18 +68,31 @@ std::string Capture::GProcessToInject = "";
 std::map<uint64_t, Function*> Capture::GSelectedFunctionsMap;
 std::map<uint64_t, Function*> Capture::GVisibleFunctionsMap;
 std::unordered_map<ULONG64, ULONG64> Capture::GFunctionCountMap;
+FunctionStatsChanges Capture::GFunctionStatsChanges;
 std::shared_ptr<CallStack> Capture::GSelectedCallstack;
 std::vector<ULONG64> Capture::GSelectedAddressesByType[Function::NUM_TYPES];
+std::vector<FunctionSamplingPolicy> Capture::GSamplingPolicies;
 std::unordered_map<DWORD64, std::shared_ptr<CallStack> > Capture::GCallstacks;
 Mutex Capture::GCallstackMutex;
+MemoryAccount Capture::GCallstacksMemory(MemorySubsystem::kCallstacks);
+LogBuffer Capture::GLogBuffer;
+Mutex Capture::GLogMutex;
+std::map<std::string, ClockCorrection> Capture::GClockCorrections;
+Mutex Capture::GClockCorrectionsMutex;
 std::unordered_map<DWORD64, std::string> Capture::GZoneNames;
-TextBox* Capture::GSelectedTextBox;
+const CompactTimer* Capture::GSelectedTimer;
 ThreadID Capture::GSelectedThreadId;
 Timer Capture::GCaptureTimer;
 std::chrono::system_clock::time_point Capture::GCaptureTimePoint;
 Capture::LoadPdbAsyncFunc Capture::GLoadPdbAsync;
 
 std::shared_ptr<SamplingProfiler> Capture::GSamplingProfiler = nullptr;
+OffCpuProfile Capture::GOffCpuProfile;
+PageFaultProfile Capture::GPageFaultProfile;
+LockContentionProfile Capture::GLockContentionProfile;
+BranchProfile Capture::GBranchProfile;
+InstrumentedCallTree Capture::GInstrumentedCallTree;
+CaptureOverview Capture::GCaptureOverview;
 std::shared_ptr<Process> Capture::GTargetProcess = nullptr;
 std::shared_ptr<Session> Capture::GSessionPresets = nullptr;
 
@@ -230,15 +254,47 @@ void Capture::StopCapture() {
 void Capture::ClearCaptureData() {
   GSelectedFunctionsMap.clear();
   GFunctionCountMap.clear();
+  GFunctionStatsChanges.Clear();
   GZoneNames.clear();
-  GSelectedTextBox = nullptr;
+  GSelectedTimer = nullptr;
   GSelectedThreadId = 0;
   GNumProfileEvents = 0;
   GTcpServer->ResetStats();
   GOrbitUnreal.NewSession();
   GHasContextSwitches = false;
+  GHasThreadStates = false;
   GNumLinuxEvents = 0;
   GNumContextSwitches = 0;
+  GOffCpuProfile.Clear();
+  GPageFaultProfile.Clear();
+  GLockContentionProfile.Clear();
+  GBranchProfile.Clear();
+  GInstrumentedCallTree.Clear();
+  GCaptureOverview.Clear();
+  {
+    ScopeLock lock(GLogMutex);
+    GLogBuffer.Clear();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void Capture::SetClockCorrection(const std::string& source,
+                                 const ClockCorrection& correction) {
+  ScopeLock lock(GClockCorrectionsMutex);
+  GClockCorrections[source] = correction;
+}
+
+//-----------------------------------------------------------------------------
+std::map<std::string, ClockCorrection> Capture::GetClockCorrections() {
+  ScopeLock lock(GClockCorrectionsMutex);
+  return GClockCorrections;
+}
+
+//-----------------------------------------------------------------------------
+void Capture::SetClockCorrections(
+    std::map<std::string, ClockCorrection> corrections) {
+  ScopeLock lock(GClockCorrectionsMutex);
+  GClockCorrections = std::move(corrections);
 }
 
 //-----------------------------------------------------------------------------
@@ -269,6 +325,7 @@ void Capture::PreFunctionHooks() {
   for (int i = 0; i < Function::NUM_TYPES; ++i) {
     GSelectedAddressesByType[i].clear();
   }
+  GSamplingPolicies.clear();
 
   // Clear current argument tracking data
   GTcpServer->Send(Msg_ClearArgTracking);
@@ -300,6 +357,9 @@ void Capture::SendFunctionHooks() {
       GSelectedFunctionsMap[address] = func;
       func->ResetStats();
       GFunctionCountMap[address] = 0;
+      if (func->IsSampled()) {
+        GSamplingPolicies.push_back({address, func->GetSamplingPolicy()});
+      }
     }
   }
 
@@ -322,6 +382,34 @@ void Capture::SendFunctionHooks() {
     GTcpClient->Send(Msg_RemoteSelectedFunctionsMap,
                      (void*)selectedFunctionsData.data(),
                      selectedFunctionsData.size());
+    GTcpClient->Send(Msg_FunctionSamplingPolicies, GSamplingPolicies);
+    std::string capture_filter_data =
+        SerializeObjectBinary(GParams.m_CaptureFilter);
+    GTcpClient->Send(Msg_CaptureFilter, (void*)capture_filter_data.data(),
+                     capture_filter_data.size());
+
+    // Handled by the service before the capture starts.
+    if (GParams.m_RecordCaptureOnService) {
+      GTcpClient->Send(Msg_CaptureRecordingRequest);
+    }
+    if (GParams.m_FlightRecorderWindowMs > 0) {
+      FlightRecorderSettings settings{
+          GParams.m_FlightRecorderWindowMs * 1'000'000,
+          GParams.m_FlightRecorderMaxMb * 1024 * 1024};
+      GTcpClient->Send(Msg_FlightRecorderRequest, settings);
+      std::optional<std::vector<CaptureTrigger>> triggers =
+          ParseCaptureTriggers(
+              GParams.m_FlightRecorderTriggers,
+              [](const std::string& name) -> std::optional<uint64_t> {
+                for (const auto& pair : GSelectedFunctionsMap) {
+                  if (pair.second->PrettyName() == name) return pair.first;
+                }
+                return std::nullopt;
+              });
+      if (triggers.has_value() && !triggers->empty()) {
+        GTcpClient->Send(Msg_CaptureTriggers, triggers.value());
+      }
+    }
 
     Message msg(Msg_StartCapture);
     msg.m_Header.m_GenericHeader.m_Address = GTargetProcess->GetID();
@@ -334,7 +422,11 @@ void Capture::SendFunctionHooks() {
     GTcpServer->Send(Msg_OrbitUnrealInfo, info);
   }
 
-  // Send all hooks by type
+  // Sent before the hooks, so that they apply from the first call.
+  GTcpServer->Send(Msg_FunctionSamplingPolicies, GSamplingPolicies);
+
+  // Send all hooks by type, which the target installs in batches.
+  GNumInstalledHooks = 0;
   for (int i = 0; i < Function::NUM_TYPES; ++i) {
     std::vector<DWORD64>& addresses = GSelectedAddressesByType[i];
     if (addresses.size()) {
@@ -587,8 +679,27 @@ void Capture::RegisterZoneName(DWORD64 a_ID, char* a_Name) {
 //-----------------------------------------------------------------------------
 void Capture::AddCallstack(CallStack& a_CallStack) {
   ScopeLock lock(GCallstackMutex);
-  Capture::GCallstacks[a_CallStack.m_Hash] =
-      std::make_shared<CallStack>(a_CallStack);
+  std::shared_ptr<CallStack>& callstack = GCallstacks[a_CallStack.m_Hash];
+  if (callstack != nullptr) {
+    GCallstacksMemory.Add(-static_cast<int64_t>(GetMemorySize(*callstack)));
+  } else {
+    GCallstacksMemory.Add(sizeof(decltype(GCallstacks)::value_type) +
+                          sizeof(void*));
+  }
+  callstack = std::make_shared<CallStack>(a_CallStack);
+  GCallstacksMemory.Add(GetMemorySize(*callstack));
+}
+
+//-----------------------------------------------------------------------------
+void Capture::UpdateCallstacksMemory() {
+  ScopeLock lock(GCallstackMutex);
+  uint64_t memory = GetHashMapMemorySize(GCallstacks);
+  for (const auto& it : GCallstacks) {
+    if (it.second != nullptr) {
+      memory += GetMemorySize(*it.second);
+    }
+  }
+  GCallstacksMemory.Set(memory);
 }
 
 //-----------------------------------------------------------------------------
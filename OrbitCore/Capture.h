@@ -4,11 +4,23 @@
 #pragma once
 
 #include <chrono>
+#include <map>
 #include <string>
 
 #include "LinuxTracingSession.h"
+#include "BranchProfile.h"
 #include "CallstackTypes.h"
+#include "CaptureOverview.h"
+#include "ClockSync.h"
+#include "FunctionSampler.h"
+#include "FunctionStatsChanges.h"
+#include "InstrumentedCallTree.h"
+#include "LockContentionProfile.h"
+#include "LogBuffer.h"
+#include "MemoryAccounting.h"
+#include "OffCpuProfile.h"
 #include "OrbitType.h"
+#include "PageFaultProfile.h"
 #include "Threading.h"
 
 class Process;
@@ -47,7 +59,17 @@ struct Capture {
   static void RegisterZoneName(DWORD64 a_ID, char* a_Name);
   static void AddCallstack(CallStack& a_CallStack);
   static std::shared_ptr<CallStack> GetCallstack(CallstackID a_ID);
+  // Counts the memory of GCallstacks again, once replaced, e.g. by a loaded
+  // capture.
+  static void UpdateCallstacksMemory();
   static void CheckForUnrealSupport();
+  // The clock of each source of the capture, e.g., the address of the
+  // service, to the clock of the UI, as estimated by ClockSync.
+  static void SetClockCorrection(const std::string& source,
+                                 const ClockCorrection& correction);
+  static std::map<std::string, ClockCorrection> GetClockCorrections();
+  static void SetClockCorrections(
+      std::map<std::string, ClockCorrection> corrections);
   static void PreSave();
 
   typedef void (*LoadPdbAsyncFunc)(const std::vector<std::string>& a_Modules);
@@ -81,6 +103,7 @@ struct Capture {
   static uint32_t GFunctionIndex;
   static uint32_t GNumInstalledHooks;
   static bool GHasContextSwitches;
+  static bool GHasThreadStates;
 
   static Timer GTestTimer;
   static ULONG64 GMainFrameFunction;
@@ -88,6 +111,17 @@ struct Capture {
   static ULONG64 GNumLinuxEvents;
   static ULONG64 GNumProfileEvents;
   static std::shared_ptr<SamplingProfiler> GSamplingProfiler;
+  // Blocked time of the threads of the current capture, see OffCpuProfile.
+  static OffCpuProfile GOffCpuProfile;
+  // Page faults of the threads of the current capture, see PageFaultProfile.
+  static PageFaultProfile GPageFaultProfile;
+  static LockContentionProfile GLockContentionProfile;
+  // Branches sampled during the current capture, see BranchProfile.
+  static BranchProfile GBranchProfile;
+  // Calls of the instrumented functions of the current capture, by path.
+  static InstrumentedCallTree GInstrumentedCallTree;
+  // Activity over the whole current capture, for its minimap.
+  static CaptureOverview GCaptureOverview;
   static std::shared_ptr<Process> GTargetProcess;
   static std::shared_ptr<Session> GSessionPresets;
   static std::shared_ptr<CallStack> GSelectedCallstack;
@@ -95,15 +129,29 @@ struct Capture {
   static std::map<uint64_t, Function*> GSelectedFunctionsMap;
   static std::map<uint64_t, Function*> GVisibleFunctionsMap;
   static std::unordered_map<ULONG64, ULONG64> GFunctionCountMap;
+  // Of the functions of GFunctionCountMap, published where their stats are
+  // updated.
+  static FunctionStatsChanges GFunctionStatsChanges;
   static std::vector<ULONG64> GSelectedAddressesByType[Function::NUM_TYPES];
+  // Of the selected functions not recording all their calls.
+  static std::vector<FunctionSamplingPolicy> GSamplingPolicies;
   static std::unordered_map<DWORD64, std::shared_ptr<CallStack> > GCallstacks;
   static std::unordered_map<DWORD64, std::string> GZoneNames;
-  static class TextBox* GSelectedTextBox;
+  // In a TimerChain of the time graph, see TimeGraph::ExpandTimer.
+  static const struct CompactTimer* GSelectedTimer;
   static ThreadID GSelectedThreadId;
   static Timer GCaptureTimer;
   static std::chrono::system_clock::time_point GCaptureTimePoint;
   static Mutex GCallstackMutex;
+  static MemoryAccount GCallstacksMemory;
+  // The log entries of the capture, indexed by time per thread for the log
+  // view and the time graph, guarded by GLogMutex.
+  static LogBuffer GLogBuffer;
+  static Mutex GLogMutex;
   static LoadPdbAsyncFunc GLoadPdbAsync;
+  // Set from the thread receiving the messages, see SetClockCorrection.
+  static std::map<std::string, ClockCorrection> GClockCorrections;
+  static Mutex GClockCorrectionsMutex;
   static bool GUnrealSupported;
 
  private:
@@ -0,0 +1,161 @@
+#include "CaptureFile.h"
+
+#include <OrbitBase/Logging.h>
+
+#include <algorithm>
+#include <cstring>
+
+bool CaptureFileWriter::Open(const std::string& path) {
+  CaptureFileHeader header{CaptureFileHeader::kMagic,
+                           CaptureFileHeader::kVersion};
+  if (!file_.Open(path, file_options_) ||
+      !file_.Write(&header, sizeof(header))) {
+    ERROR("Could not create capture file %s", path.c_str());
+    return false;
+  }
+  num_bytes_ = sizeof(header);
+  return true;
+}
+
+bool CaptureFileWriter::AddMessage(MessageType type, const void* data,
+                                   size_t size, uint64_t begin_time,
+                                   uint64_t end_time) {
+  if (chunk_header_.num_messages == 0) {
+    chunk_header_.begin_time = begin_time;
+    chunk_header_.end_time = end_time;
+  } else {
+    chunk_header_.begin_time = std::min(chunk_header_.begin_time, begin_time);
+    chunk_header_.end_time = std::max(chunk_header_.end_time, end_time);
+  }
+  ++chunk_header_.num_messages;
+
+  CaptureMessageHeader message_header{static_cast<uint32_t>(type),
+                                      static_cast<uint32_t>(size)};
+  chunk_.append(reinterpret_cast<const char*>(&message_header),
+                sizeof(message_header));
+  chunk_.append(static_cast<const char*>(data), size);
+  return chunk_.size() < chunk_size_ || WriteChunk();
+}
+
+bool CaptureFileWriter::Close() {
+  bool success = WriteChunk();
+  return file_.Close() && success;
+}
+
+bool CaptureFileWriter::WriteChunk() {
+  if (chunk_header_.num_messages == 0) {
+    return true;
+  }
+  chunk_header_.magic = CaptureChunkHeader::kMagic;
+  chunk_header_.size = chunk_.size();
+  bool success = file_.Write(&chunk_header_, sizeof(chunk_header_)) &&
+                 file_.Write(chunk_.data(), chunk_.size());
+  // The chunk reaches the file even if the service dies afterwards, unless
+  // with direct I/O, which only writes whole buffers.
+  file_.Flush();
+  num_bytes_ += sizeof(chunk_header_) + chunk_.size();
+  ++num_chunks_;
+
+  chunk_header_ = {};
+  chunk_.clear();
+  if (!success) {
+    ERROR("Could not write capture chunk");
+    return false;
+  }
+  return true;
+}
+
+bool CaptureFileReader::Open(const std::string& path) {
+  chunks_.clear();
+  file_.close();
+  file_.open(path, std::ios::binary);
+  CaptureFileHeader header;
+  if (!file_.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      header.magic != CaptureFileHeader::kMagic ||
+      header.version != CaptureFileHeader::kVersion) {
+    ERROR("%s is not a capture file of this version", path.c_str());
+    return false;
+  }
+
+  file_.seekg(0, std::ios::end);
+  uint64_t file_size = file_.tellg();
+  uint64_t offset = sizeof(header);
+  while (file_size - offset >= sizeof(CaptureChunkHeader)) {
+    Chunk chunk;
+    file_.seekg(offset);
+    if (!file_.read(reinterpret_cast<char*>(&chunk.header),
+                    sizeof(chunk.header)) ||
+        chunk.header.magic != CaptureChunkHeader::kMagic) {
+      break;
+    }
+    chunk.offset = offset + sizeof(chunk.header);
+    if (file_size - chunk.offset < chunk.header.size) {
+      break;
+    }
+    chunks_.push_back(chunk);
+    offset = chunk.offset + chunk.header.size;
+  }
+  if (offset != file_size) {
+    ERROR("Ignoring the end of the truncated capture file %s", path.c_str());
+  }
+  file_.clear();
+  return true;
+}
+
+std::vector<size_t> CaptureFileReader::FindChunks(uint64_t begin_time,
+                                                  uint64_t end_time) const {
+  std::vector<size_t> chunk_indices;
+  for (size_t i = 0; i < chunks_.size(); ++i) {
+    const CaptureChunkHeader& header = chunks_[i].header;
+    if (header.begin_time <= end_time && header.end_time >= begin_time) {
+      chunk_indices.push_back(i);
+    }
+  }
+  return chunk_indices;
+}
+
+bool CaptureFileReader::ForEachMessage(
+    size_t chunk_index,
+    const std::function<void(MessageType type, const char* data,
+                             uint32_t size)>& action) {
+  const Chunk& chunk = chunks_[chunk_index];
+  if (chunk.header.num_messages >
+      chunk.header.size / sizeof(CaptureMessageHeader)) {
+    return false;
+  }
+  buffer_.resize(chunk.header.size);
+  file_.seekg(chunk.offset);
+  if (!file_.read(buffer_.data(), buffer_.size())) {
+    file_.clear();
+    return false;
+  }
+
+  // Validated first, so that nothing of a corrupted chunk is processed.
+  std::vector<CaptureMessageHeader> message_headers;
+  message_headers.reserve(chunk.header.num_messages);
+  size_t offset = 0;
+  for (uint32_t i = 0; i < chunk.header.num_messages; ++i) {
+    CaptureMessageHeader message_header;
+    if (buffer_.size() - offset < sizeof(message_header)) {
+      return false;
+    }
+    memcpy(&message_header, buffer_.data() + offset, sizeof(message_header));
+    offset += sizeof(message_header) + message_header.size;
+    if (offset > buffer_.size()) {
+      return false;
+    }
+    message_headers.push_back(message_header);
+  }
+  if (offset != buffer_.size()) {
+    return false;
+  }
+
+  offset = 0;
+  for (const CaptureMessageHeader& message_header : message_headers) {
+    offset += sizeof(message_header);
+    action(static_cast<MessageType>(message_header.type),
+           buffer_.data() + offset, message_header.size);
+    offset += message_header.size;
+  }
+  return true;
+}
@@ -0,0 +1,132 @@
+#ifndef ORBIT_CORE_CAPTURE_FILE_H_
+#define ORBIT_CORE_CAPTURE_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "AsyncFileWriter.h"
+#include "Message.h"
+
+// Capture recorded by the service to a file on the target, instead of being
+// streamed to the UI, which pulls it later by time range.
+//
+// The file is a CaptureFileHeader followed by chunks, each a
+// CaptureChunkHeader followed by messages. A message is a CaptureMessageHeader
+// followed by the payload the service would have sent with that type. The
+// chunk headers tell the time range of the events of their messages, so that
+// the chunks of a time range are found without reading the messages. A chunk
+// cut short, e.g. because the service was killed, ends the file.
+struct CaptureFileHeader {
+  static constexpr uint32_t kMagic = 0x50414352;
+  static constexpr uint32_t kVersion = 1;
+  uint32_t magic;
+  uint32_t version;
+};
+
+struct CaptureChunkHeader {
+  static constexpr uint32_t kMagic = 0x4b4e4843;
+  uint32_t magic;
+  uint32_t num_messages;
+  // Size of the messages following this header.
+  uint64_t size;
+  // Times of the earliest and latest events of the chunk.
+  uint64_t begin_time;
+  uint64_t end_time;
+};
+
+struct CaptureMessageHeader {
+  uint32_t type;
+  uint32_t size;
+};
+
+// Sent by the service as Msg_CaptureRecordingInfo once a recorded capture has
+// stopped.
+struct CaptureRecordingInfo {
+  uint64_t num_chunks;
+  uint64_t num_bytes;
+  uint64_t begin_time;
+  uint64_t end_time;
+};
+
+// Sent by the UI as Msg_CaptureChunksRequest, for the recorded events between
+// begin_time and end_time.
+struct CaptureChunksRequest {
+  uint64_t begin_time;
+  uint64_t end_time;
+};
+
+// The chunks are written in the background by an AsyncFileWriter, so that
+// recording at the rate of the ring buffers doesn't stall the thread sending
+// the capture on the disk.
+class CaptureFileWriter {
+ public:
+  static constexpr size_t kDefaultChunkSize = 4 * 1024 * 1024;
+
+  explicit CaptureFileWriter(
+      size_t chunk_size = kDefaultChunkSize,
+      AsyncFileWriter::Options file_options = AsyncFileWriter::Options())
+      : chunk_size_(chunk_size), file_options_(file_options) {}
+
+  bool Open(const std::string& path);
+
+  // Adds a message whose events happened between begin_time and end_time to
+  // the current chunk, which is written once it holds chunk_size bytes.
+  // Returns false if writing failed.
+  bool AddMessage(MessageType type, const void* data, size_t size,
+                  uint64_t begin_time, uint64_t end_time);
+
+  // Writes the current chunk.
+  bool Close();
+
+  uint64_t GetNumChunks() const { return num_chunks_; }
+  uint64_t GetNumBytes() const { return num_bytes_; }
+  // See AsyncFileWriter.
+  size_t GetQueueDepth() const { return file_.GetQueueDepth(); }
+  uint64_t GetNumBufferWaits() const { return file_.GetNumBufferWaits(); }
+
+ private:
+  bool WriteChunk();
+
+  size_t chunk_size_;
+  AsyncFileWriter::Options file_options_;
+  AsyncFileWriter file_;
+  CaptureChunkHeader chunk_header_ = {};
+  std::string chunk_;
+  uint64_t num_chunks_ = 0;
+  uint64_t num_bytes_ = 0;
+};
+
+class CaptureFileReader {
+ public:
+  struct Chunk {
+    CaptureChunkHeader header;
+    // Of the first message, in the file.
+    uint64_t offset;
+  };
+
+  // Reads the chunk headers. Returns false if path is not a capture file of
+  // this version.
+  bool Open(const std::string& path);
+
+  const std::vector<Chunk>& GetChunks() const { return chunks_; }
+  // Indices of the chunks with events between begin_time and end_time.
+  std::vector<size_t> FindChunks(uint64_t begin_time, uint64_t end_time) const;
+
+  // Calls action for each message of the chunk, in the order they were added.
+  // Returns false if the chunk can't be read or is corrupted.
+  bool ForEachMessage(
+      size_t chunk_index,
+      const std::function<void(MessageType type, const char* data,
+                               uint32_t size)>& action);
+
+ private:
+  std::ifstream file_;
+  std::vector<Chunk> chunks_;
+  std::vector<char> buffer_;
+};
+
+#endif  // ORBIT_CORE_CAPTURE_FILE_H_
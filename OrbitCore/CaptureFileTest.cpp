@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "CaptureFile.h"
+
+namespace {
+struct ReadMessage {
+  MessageType type;
+  std::string data;
+};
+
+std::string GetTemporaryPath() {
+  return testing::TempDir() + "capture_file_test_" +
+         std::to_string(getpid()) + ".orbitcapture";
+}
+
+std::vector<ReadMessage> ReadChunk(CaptureFileReader* reader, size_t index) {
+  std::vector<ReadMessage> messages;
+  EXPECT_TRUE(reader->ForEachMessage(
+      index, [&](MessageType type, const char* data, uint32_t size) {
+        messages.push_back({type, std::string(data, size)});
+      }));
+  return messages;
+}
+}  // namespace
+
+TEST(CaptureFile, WritesChunksOfAtLeastChunkSize) {
+  std::string path = GetTemporaryPath();
+  // Reached by the first two messages, headers included.
+  CaptureFileWriter writer(/*chunk_size=*/26);
+  ASSERT_TRUE(writer.Open(path));
+  EXPECT_TRUE(writer.AddMessage(Msg_RemoteTimers, "0123456789", 10, 100, 200));
+  EXPECT_TRUE(writer.AddMessage(Msg_RemoteContextSwitches, "", 0, 50, 60));
+  EXPECT_TRUE(writer.AddMessage(Msg_SamplingCallstacks, "abc", 3, 300, 300));
+  EXPECT_TRUE(writer.AddMessage(Msg_RemoteTimers, "de", 2, 400, 500));
+  EXPECT_EQ(writer.GetNumChunks(), 1);
+  ASSERT_TRUE(writer.Close());
+  EXPECT_EQ(writer.GetNumChunks(), 2);
+
+  CaptureFileReader reader;
+  ASSERT_TRUE(reader.Open(path));
+  ASSERT_EQ(reader.GetChunks().size(), 2);
+  EXPECT_EQ(reader.GetChunks()[0].header.num_messages, 2);
+  EXPECT_EQ(reader.GetChunks()[0].header.begin_time, 50);
+  EXPECT_EQ(reader.GetChunks()[0].header.end_time, 200);
+  EXPECT_EQ(reader.GetChunks()[1].header.begin_time, 300);
+  EXPECT_EQ(reader.GetChunks()[1].header.end_time, 500);
+
+  std::vector<ReadMessage> messages = ReadChunk(&reader, 1);
+  ASSERT_EQ(messages.size(), 2);
+  EXPECT_EQ(messages[0].type, Msg_SamplingCallstacks);
+  EXPECT_EQ(messages[0].data, "abc");
+  EXPECT_EQ(messages[1].type, Msg_RemoteTimers);
+  EXPECT_EQ(messages[1].data, "de");
+  messages = ReadChunk(&reader, 0);
+  ASSERT_EQ(messages.size(), 2);
+  EXPECT_EQ(messages[0].data, "0123456789");
+  EXPECT_EQ(messages[1].type, Msg_RemoteContextSwitches);
+  EXPECT_EQ(messages[1].data, "");
+  remove(path.c_str());
+}
+
+TEST(CaptureFile, FindChunksByTimeRange) {
+  std::string path = GetTemporaryPath();
+  CaptureFileWriter writer(/*chunk_size=*/1);
+  ASSERT_TRUE(writer.Open(path));
+  for (uint64_t i = 0; i < 10; ++i) {
+    writer.AddMessage(Msg_RemoteTimers, "x", 1, i * 100, i * 100 + 50);
+  }
+  ASSERT_TRUE(writer.Close());
+
+  CaptureFileReader reader;
+  ASSERT_TRUE(reader.Open(path));
+  EXPECT_EQ(reader.FindChunks(0, 999).size(), 10);
+  EXPECT_EQ(reader.FindChunks(160, 190), std::vector<size_t>{});
+  EXPECT_EQ(reader.FindChunks(150, 250), (std::vector<size_t>{1, 2}));
+  EXPECT_EQ(reader.FindChunks(950, 2000), std::vector<size_t>{9});
+  remove(path.c_str());
+}
+
+TEST(CaptureFile, IgnoresTruncatedChunk) {
+  std::string path = GetTemporaryPath();
+  CaptureFileWriter writer(/*chunk_size=*/1);
+  ASSERT_TRUE(writer.Open(path));
+  writer.AddMessage(Msg_RemoteTimers, "first", 5, 0, 1);
+  writer.AddMessage(Msg_RemoteTimers, "second", 6, 2, 3);
+  ASSERT_TRUE(writer.Close());
+  truncate(path.c_str(), writer.GetNumBytes() - 1);
+
+  CaptureFileReader reader;
+  ASSERT_TRUE(reader.Open(path));
+  ASSERT_EQ(reader.GetChunks().size(), 1);
+  std::vector<ReadMessage> messages = ReadChunk(&reader, 0);
+  ASSERT_EQ(messages.size(), 1);
+  EXPECT_EQ(messages[0].data, "first");
+  remove(path.c_str());
+}
+
+TEST(CaptureFile, RejectsOtherFiles) {
+  std::string path = GetTemporaryPath();
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << "not a capture file";
+  }
+  CaptureFileReader reader;
+  EXPECT_FALSE(reader.Open(path));
+  remove(path.c_str());
+  EXPECT_FALSE(reader.Open(path));
+}
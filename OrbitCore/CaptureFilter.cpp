@@ -0,0 +1,35 @@
+#include "CaptureFilter.h"
+
+#include "Serialization.h"
+
+ORBIT_SERIALIZE(CaptureFilter, 0) {
+  ORBIT_NVP_VAL(0, thread_ids);
+  ORBIT_NVP_VAL(0, function_addresses);
+  ORBIT_NVP_VAL(0, min_timer_duration_ns);
+  ORBIT_NVP_VAL(0, samples_as_histograms);
+}
+
+CaptureEventFilter::CaptureEventFilter(const CaptureFilter& filter)
+    : thread_ids_(filter.thread_ids.begin(), filter.thread_ids.end()),
+      function_addresses_(filter.function_addresses.begin(),
+                          filter.function_addresses.end()),
+      min_timer_duration_ns_(filter.min_timer_duration_ns),
+      samples_as_histograms_(filter.samples_as_histograms) {}
+
+bool CaptureEventFilter::AcceptsTimer(const Timer& timer) const {
+  if (timer.m_Type == Timer::GPU_ACTIVITY ||
+      timer.m_Type == Timer::SERVICE_STATS ||
+      timer.m_Type == Timer::VARIABLE) {
+    return true;
+  }
+  if (!AcceptsThread(timer.m_TID)) {
+    return false;
+  }
+  // Only the timers of instrumented functions, not the introspection scopes.
+  if (timer.m_Type != Timer::NONE) {
+    return true;
+  }
+  return timer.m_End - timer.m_Start >= min_timer_duration_ns_ &&
+         (function_addresses_.empty() ||
+          function_addresses_.contains(timer.m_FunctionAddress));
+}
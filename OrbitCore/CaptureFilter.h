@@ -0,0 +1,66 @@
+#ifndef ORBIT_CORE_CAPTURE_FILTER_H_
+#define ORBIT_CORE_CAPTURE_FILTER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "CallstackTypes.h"
+#include "ScopeTimer.h"
+#include "SerializationMacros.h"
+#include "absl/container/flat_hash_set.h"
+
+// What the client asks the service to send of the next captures, sent
+// serialized as Msg_CaptureFilter before Msg_StartCapture. The service drops
+// the events filtered out before buffering them (see
+// LinuxTracingSession::SetCaptureFilter), which for a focused investigation
+// over a slow link saves most of the traffic of the capture. The default
+// filter keeps everything.
+struct CaptureFilter {
+  // Only the events of these threads are sent, of all threads if empty. The
+  // GPU jobs, the service stats and the tracked variables, which are not on
+  // tracks of threads, are always sent.
+  std::vector<uint32_t> thread_ids;
+  // Only the timers of these functions are sent, of all functions if empty.
+  std::vector<uint64_t> function_addresses;
+  // Timers of functions shorter than this are not sent.
+  uint64_t min_timer_duration_ns = 0;
+  // The samples whose callstack was already sent are counted per thread and
+  // callstack, see SampleCount, instead of being sent one by one. The
+  // sampling report is the same, but the samples lose their time.
+  bool samples_as_histograms = false;
+
+  ORBIT_SERIALIZABLE;
+};
+
+#pragma pack(push, 1)
+// Payload of Msg_SampleHistogram, an array of which counts the samples of each
+// thread and callstack since the previous message.
+struct SampleCount {
+  CallstackID callstack_id = 0;
+  // Of the last of the samples.
+  uint64_t time = 0;
+  ThreadID thread_id = 0;
+  uint32_t count = 0;
+};
+#pragma pack(pop)
+
+// Tells in constant time whether an event passes a CaptureFilter.
+class CaptureEventFilter {
+ public:
+  explicit CaptureEventFilter(const CaptureFilter& filter = CaptureFilter{});
+
+  bool AcceptsThread(uint32_t thread_id) const {
+    return thread_ids_.empty() || thread_ids_.contains(thread_id);
+  }
+  bool AcceptsTimer(const Timer& timer) const;
+  bool HasThreadFilter() const { return !thread_ids_.empty(); }
+  bool SamplesAsHistograms() const { return samples_as_histograms_; }
+
+ private:
+  absl::flat_hash_set<uint32_t> thread_ids_;
+  absl::flat_hash_set<uint64_t> function_addresses_;
+  uint64_t min_timer_duration_ns_;
+  bool samples_as_histograms_;
+};
+
+#endif  // ORBIT_CORE_CAPTURE_FILTER_H_
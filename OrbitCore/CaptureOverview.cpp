@@ -0,0 +1,80 @@
+#include "CaptureOverview.h"
+
+#include <algorithm>
+
+void CaptureOverview::Add(Row row, uint64_t time, uint64_t amount) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  size_t bucket = Reach(time);
+  values_[static_cast<size_t>(row)][bucket].fetch_add(
+      amount, std::memory_order_relaxed);
+}
+
+void CaptureOverview::AddRange(Row row, uint64_t begin, uint64_t end) {
+  if (end <= begin) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock{mutex_};
+  // The end is reached first, for the buckets not to widen in between.
+  Reach(end - 1);
+  size_t first = Reach(begin);
+  uint64_t bucket_ticks = bucket_ticks_;
+  uint64_t bucket_begin = begin_time_ + first * bucket_ticks;
+  for (size_t bucket = first; bucket < kNumBuckets && bucket_begin < end;
+       ++bucket, bucket_begin += bucket_ticks) {
+    // Events before the first bucket are counted in it.
+    uint64_t from = bucket == first ? begin : bucket_begin;
+    uint64_t to = std::min(end, bucket_begin + bucket_ticks);
+    if (to > from) {
+      values_[static_cast<size_t>(row)][bucket].fetch_add(
+          to - from, std::memory_order_relaxed);
+    }
+  }
+}
+
+void CaptureOverview::Clear() {
+  std::lock_guard<std::mutex> lock{mutex_};
+  begin_time_ = 0;
+  bucket_ticks_ = 0;
+  for (auto& row : values_) {
+    for (std::atomic<uint64_t>& value : row) {
+      value.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+uint64_t CaptureOverview::GetMaxValue(Row row) const {
+  uint64_t max_value = 0;
+  for (const std::atomic<uint64_t>& value :
+       values_[static_cast<size_t>(row)]) {
+    max_value = std::max(max_value, value.load(std::memory_order_relaxed));
+  }
+  return max_value;
+}
+
+size_t CaptureOverview::Reach(uint64_t time) {
+  if (bucket_ticks_ == 0) {
+    begin_time_ = time;
+    bucket_ticks_ = kInitialBucketTicks;
+  }
+  if (time < begin_time_) {
+    return 0;
+  }
+  while ((time - begin_time_) / bucket_ticks_ >= kNumBuckets) {
+    Widen();
+  }
+  return (time - begin_time_) / bucket_ticks_;
+}
+
+void CaptureOverview::Widen() {
+  for (auto& row : values_) {
+    for (size_t i = 0; i < kNumBuckets / 2; ++i) {
+      row[i].store(row[2 * i].load(std::memory_order_relaxed) +
+                       row[2 * i + 1].load(std::memory_order_relaxed),
+                   std::memory_order_relaxed);
+    }
+    for (size_t i = kNumBuckets / 2; i < kNumBuckets; ++i) {
+      row[i].store(0, std::memory_order_relaxed);
+    }
+  }
+  bucket_ticks_ = 2 * bucket_ticks_;
+}
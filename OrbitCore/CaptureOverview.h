@@ -0,0 +1,71 @@
+#ifndef ORBIT_CORE_CAPTURE_OVERVIEW_H_
+#define ORBIT_CORE_CAPTURE_OVERVIEW_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// Where the activity of a capture is over its whole duration, for the minimap
+// of the capture window: how much of each kind of activity falls in each of
+// kNumBuckets buckets of time. It is updated as the events are ingested, so
+// showing the whole capture doesn't go through its events, and its memory
+// doesn't grow with the capture. The buckets start at the first event added.
+// An event past the last bucket doubles the width of the buckets, merging
+// them by pairs, as many times as needed. Events before the first one go to
+// the first bucket.
+//
+// Adding is serialized, as samples and timers come from different threads.
+// The values are atomic for the UI to read them without waiting on the
+// writers, which may show a merge half done for a frame.
+class CaptureOverview {
+ public:
+  enum class Row : uint8_t {
+    // Count of the timers of the threads, by start.
+    kTimers,
+    // Count of the sampled callstacks.
+    kSamples,
+    // Time the GPUs are busy, in ticks.
+    kGpu,
+    // Count of the events lost by the tracer.
+    kLostEvents
+  };
+  static constexpr size_t kNumRows = 4;
+  static constexpr size_t kNumBuckets = 512;
+  static constexpr uint64_t kInitialBucketTicks = 1'000'000;
+
+  CaptureOverview() { Clear(); }
+  CaptureOverview(const CaptureOverview&) = delete;
+  CaptureOverview& operator=(const CaptureOverview&) = delete;
+
+  void Add(Row row, uint64_t time, uint64_t amount = 1);
+  // Adds to each bucket the ticks of [begin, end) it covers.
+  void AddRange(Row row, uint64_t begin, uint64_t end);
+  void Clear();
+
+  bool IsEmpty() const { return bucket_ticks_ == 0; }
+  // Of the first bucket.
+  uint64_t GetBeginTime() const { return begin_time_; }
+  uint64_t GetBucketTicks() const { return bucket_ticks_; }
+  uint64_t GetValue(Row row, size_t bucket) const {
+    return values_[static_cast<size_t>(row)][bucket].load(
+        std::memory_order_relaxed);
+  }
+  uint64_t GetMaxValue(Row row) const;
+
+ private:
+  // Sets the first bucket to begin at time if none was added yet, then
+  // widens the buckets until they reach time. Returns the bucket of time.
+  size_t Reach(uint64_t time);
+  void Widen();
+
+  std::mutex mutex_;
+  std::atomic<uint64_t> begin_time_;
+  // 0 until the first event.
+  std::atomic<uint64_t> bucket_ticks_;
+  std::array<std::array<std::atomic<uint64_t>, kNumBuckets>, kNumRows>
+      values_;
+};
+
+#endif  // ORBIT_CORE_CAPTURE_OVERVIEW_H_
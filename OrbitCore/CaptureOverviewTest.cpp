@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+
+#include "CaptureOverview.h"
+
+using Row = CaptureOverview::Row;
+
+TEST(CaptureOverview, BucketsFromTheFirstEvent) {
+  CaptureOverview overview;
+  EXPECT_TRUE(overview.IsEmpty());
+
+  constexpr uint64_t kTicks = CaptureOverview::kInitialBucketTicks;
+  overview.Add(Row::kTimers, 1000);
+  overview.Add(Row::kTimers, 1000 + kTicks - 1);
+  overview.Add(Row::kTimers, 1000 + 3 * kTicks, 5);
+  // Before the first event.
+  overview.Add(Row::kSamples, 10);
+
+  EXPECT_FALSE(overview.IsEmpty());
+  EXPECT_EQ(overview.GetBeginTime(), 1000);
+  EXPECT_EQ(overview.GetBucketTicks(), kTicks);
+  EXPECT_EQ(overview.GetValue(Row::kTimers, 0), 2);
+  EXPECT_EQ(overview.GetValue(Row::kTimers, 3), 5);
+  EXPECT_EQ(overview.GetValue(Row::kSamples, 0), 1);
+  EXPECT_EQ(overview.GetMaxValue(Row::kTimers), 5);
+  EXPECT_EQ(overview.GetMaxValue(Row::kGpu), 0);
+}
+
+TEST(CaptureOverview, WidensTheBucketsToReachLaterEvents) {
+  CaptureOverview overview;
+  constexpr uint64_t kTicks = CaptureOverview::kInitialBucketTicks;
+  constexpr size_t kNumBuckets = CaptureOverview::kNumBuckets;
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    overview.Add(Row::kSamples, i * kTicks);
+  }
+  EXPECT_EQ(overview.GetBucketTicks(), kTicks);
+
+  overview.Add(Row::kSamples, 3 * kNumBuckets * kTicks);
+  EXPECT_EQ(overview.GetBucketTicks(), 4 * kTicks);
+  for (size_t i = 0; i < kNumBuckets / 4; ++i) {
+    EXPECT_EQ(overview.GetValue(Row::kSamples, i), 4);
+  }
+  for (size_t i = kNumBuckets / 4; i < 3 * kNumBuckets / 4; ++i) {
+    EXPECT_EQ(overview.GetValue(Row::kSamples, i), 0);
+  }
+  EXPECT_EQ(overview.GetValue(Row::kSamples, 3 * kNumBuckets / 4), 1);
+}
+
+TEST(CaptureOverview, SplitsRangesOverTheBuckets) {
+  CaptureOverview overview;
+  constexpr uint64_t kTicks = CaptureOverview::kInitialBucketTicks;
+  overview.Add(Row::kTimers, 0);
+  overview.AddRange(Row::kGpu, kTicks / 2, 2 * kTicks + 10);
+  EXPECT_EQ(overview.GetValue(Row::kGpu, 0), kTicks / 2);
+  EXPECT_EQ(overview.GetValue(Row::kGpu, 1), kTicks);
+  EXPECT_EQ(overview.GetValue(Row::kGpu, 2), 10);
+
+  // Widens the buckets first.
+  constexpr uint64_t kEnd = CaptureOverview::kNumBuckets * kTicks + 10;
+  overview.AddRange(Row::kLostEvents, 0, kEnd);
+  EXPECT_EQ(overview.GetBucketTicks(), 2 * kTicks);
+  EXPECT_EQ(overview.GetValue(Row::kGpu, 0), kTicks / 2 + kTicks);
+  EXPECT_EQ(overview.GetValue(Row::kGpu, 1), 10);
+  EXPECT_EQ(overview.GetValue(Row::kLostEvents, 0), 2 * kTicks);
+  EXPECT_EQ(overview.GetValue(Row::kLostEvents, 256), 10);
+
+  overview.Clear();
+  EXPECT_TRUE(overview.IsEmpty());
+  EXPECT_EQ(overview.GetMaxValue(Row::kGpu), 0);
+}
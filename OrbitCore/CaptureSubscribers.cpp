@@ -0,0 +1,127 @@
+#include "CaptureSubscribers.h"
+
+#include <algorithm>
+
+#include "Threading.h"
+
+CaptureSubscriber::CaptureSubscriber(WritePacketFunction write_packet,
+                                     size_t max_queued_bytes)
+    : write_packet_(std::move(write_packet)),
+      max_queued_bytes_(max_queued_bytes),
+      thread_{&CaptureSubscriber::Run, this} {}
+
+CaptureSubscriber::~CaptureSubscriber() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stop_requested_ = true;
+  }
+  packets_available_.notify_one();
+  thread_.join();
+}
+
+bool CaptureSubscriber::Push(const TcpPacket& packet) {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    bool droppable = packet.GetType() != Msg_KeysAndStrings;
+    if (!connected_ ||
+        (droppable &&
+         num_queued_bytes_ + packet.GetSize() > max_queued_bytes_)) {
+      ++num_dropped_packets_;
+      return false;
+    }
+    packets_.push_back(packet);
+    num_queued_bytes_ += packet.GetSize();
+  }
+  packets_available_.notify_one();
+  return true;
+}
+
+void CaptureSubscriber::WaitUntilIdle() {
+  std::unique_lock<std::mutex> lock{mutex_};
+  idle_.wait(lock, [this] {
+    return (packets_.empty() && !writing_) || !connected_;
+  });
+}
+
+void CaptureSubscriber::Run() {
+  SetCurrentThreadName(L"OrbitSubscriber");
+  std::unique_lock<std::mutex> lock{mutex_};
+  while (true) {
+    packets_available_.wait(
+        lock, [this] { return !packets_.empty() || stop_requested_; });
+    if (stop_requested_) break;
+
+    TcpPacket packet = std::move(packets_.front());
+    packets_.pop_front();
+    writing_ = true;
+    lock.unlock();
+    bool written = write_packet_(packet);
+    lock.lock();
+    writing_ = false;
+    num_queued_bytes_ -= packet.GetSize();
+    if (!written) {
+      connected_ = false;
+      num_dropped_packets_ += packets_.size() + 1;
+      packets_.clear();
+      num_queued_bytes_ = 0;
+    }
+    if (packets_.empty()) {
+      idle_.notify_all();
+    }
+  }
+}
+
+bool CaptureSubscribers::IsCaptureData(MessageType type) {
+  return IsBulkMessage(type) || type == Msg_KeysAndStrings;
+}
+
+void CaptureSubscribers::Add(
+    CaptureSubscriber::WritePacketFunction write_packet,
+    size_t max_queued_bytes) {
+  auto subscriber = std::make_unique<CaptureSubscriber>(
+      std::move(write_packet), max_queued_bytes);
+  std::lock_guard<std::mutex> lock{mutex_};
+  for (const TcpPacket& packet : keys_and_strings_packets_) {
+    subscriber->Push(packet);
+  }
+  subscribers_.push_back(std::move(subscriber));
+}
+
+void CaptureSubscribers::Publish(const TcpPacket& packet) {
+  if (!IsCaptureData(packet.GetType())) return;
+
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (packet.GetType() == Msg_KeysAndStrings) {
+    keys_and_strings_packets_.push_back(packet);
+  }
+  for (const std::unique_ptr<CaptureSubscriber>& subscriber : subscribers_) {
+    subscriber->Push(packet);
+  }
+  subscribers_.erase(
+      std::remove_if(subscribers_.begin(), subscribers_.end(),
+                     [](const std::unique_ptr<CaptureSubscriber>& subscriber) {
+                       return !subscriber->IsConnected();
+                     }),
+      subscribers_.end());
+}
+
+size_t CaptureSubscribers::GetNumSubscribers() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return subscribers_.size();
+}
+
+uint64_t CaptureSubscribers::GetNumDroppedPackets() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  uint64_t num_dropped_packets = 0;
+  for (const std::unique_ptr<CaptureSubscriber>& subscriber : subscribers_) {
+    num_dropped_packets += subscriber->GetNumDroppedPackets();
+  }
+  return num_dropped_packets;
+}
+
+void CaptureSubscribers::WaitUntilIdle() {
+  std::lock_guard<std::mutex> lock{mutex_};
+  for (const std::unique_ptr<CaptureSubscriber>& subscriber : subscribers_) {
+    subscriber->WaitUntilIdle();
+  }
+}
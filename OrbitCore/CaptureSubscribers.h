@@ -0,0 +1,95 @@
+#ifndef ORBIT_CORE_CAPTURE_SUBSCRIBERS_H_
+#define ORBIT_CORE_CAPTURE_SUBSCRIBERS_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TcpEntity.h"
+
+// Service side. A client watching the capture of another client, after it
+// sent Msg_SubscribeCapture. The packets are written to the client by a
+// thread of its own, from a queue of at most max_queued_bytes of packets: when
+// the client can't keep up, the capture data that doesn't fit is dropped, so
+// that a slow subscriber never stalls the capture or the other clients. The
+// keys and strings are never dropped, as the events sent after them refer to
+// them.
+class CaptureSubscriber {
+ public:
+  // Writes a packet to the client. Returns false once the connection is lost.
+  using WritePacketFunction = std::function<bool(const TcpPacket&)>;
+
+  CaptureSubscriber(WritePacketFunction write_packet, size_t max_queued_bytes);
+  // Waits for the packet being written, if any. The queued ones are dropped.
+  ~CaptureSubscriber();
+
+  CaptureSubscriber(const CaptureSubscriber&) = delete;
+  CaptureSubscriber& operator=(const CaptureSubscriber&) = delete;
+
+  // Never blocks. Returns false if the packet was dropped.
+  bool Push(const TcpPacket& packet);
+  bool IsConnected() const { return connected_; }
+  uint64_t GetNumDroppedPackets() const { return num_dropped_packets_; }
+  // Returns once all the packets pushed so far have been written, or the
+  // connection is lost.
+  void WaitUntilIdle();
+
+ private:
+  void Run();
+
+  WritePacketFunction write_packet_;
+  size_t max_queued_bytes_;
+
+  std::mutex mutex_;
+  std::condition_variable packets_available_;
+  std::condition_variable idle_;
+  std::deque<TcpPacket> packets_;
+  // Of packets_ and the packet being written.
+  size_t num_queued_bytes_ = 0;
+  bool writing_ = false;
+  bool stop_requested_ = false;
+  std::atomic<bool> connected_ = true;
+  std::atomic<uint64_t> num_dropped_packets_ = 0;
+
+  // Declared last, so that the thread starts after everything else has been
+  // initialized.
+  std::thread thread_;
+};
+
+// Service side. Fans the capture data out to the subscribers. Each packet is
+// encoded once, by the capture thread, and the subscribers only hold
+// references to its payload (see TcpPacket), whichever number of them there
+// is. The packets of keys and strings are also kept for the subscribers that
+// come later, as the service only sends each string once.
+class CaptureSubscribers {
+ public:
+  static constexpr size_t kDefaultMaxQueuedBytes = 64 * 1024 * 1024;
+
+  // The messages that are published to the subscribers.
+  static bool IsCaptureData(MessageType type);
+
+  void Add(CaptureSubscriber::WritePacketFunction write_packet,
+           size_t max_queued_bytes = kDefaultMaxQueuedBytes);
+  // Pushes packet to all the subscribers if it is capture data, and removes
+  // the subscribers whose connection was lost.
+  void Publish(const TcpPacket& packet);
+
+  size_t GetNumSubscribers() const;
+  // Of the current subscribers.
+  uint64_t GetNumDroppedPackets() const;
+  void WaitUntilIdle();
+
+ private:
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<CaptureSubscriber>> subscribers_;
+  std::vector<TcpPacket> keys_and_strings_packets_;
+};
+
+#endif  // ORBIT_CORE_CAPTURE_SUBSCRIBERS_H_
@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "CaptureSubscribers.h"
+
+namespace {
+TcpPacket MakePacket(MessageType type, size_t size) {
+  Message message(type, static_cast<uint32_t>(size));
+  return TcpPacket(message, std::make_shared<std::vector<char>>(size));
+}
+
+// Keeps the packets written to a subscriber.
+class PacketLog {
+ public:
+  CaptureSubscriber::WritePacketFunction GetWritePacketFunction() {
+    return [this](const TcpPacket& packet) {
+      std::lock_guard<std::mutex> lock{mutex_};
+      packets_.push_back(packet);
+      return true;
+    };
+  }
+
+  std::vector<TcpPacket> GetPackets() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return packets_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<TcpPacket> packets_;
+};
+}  // namespace
+
+TEST(CaptureSubscribers, SharesThePayloadsBetweenSubscribers) {
+  PacketLog first_log;
+  PacketLog second_log;
+  CaptureSubscribers subscribers;
+  subscribers.Add(first_log.GetWritePacketFunction());
+  subscribers.Add(second_log.GetWritePacketFunction());
+
+  TcpPacket timers = MakePacket(Msg_RemoteTimers, 100);
+  subscribers.Publish(timers);
+  // Not capture data.
+  subscribers.Publish(MakePacket(Msg_RemoteProcess, 100));
+  subscribers.WaitUntilIdle();
+
+  for (PacketLog* log : {&first_log, &second_log}) {
+    std::vector<TcpPacket> packets = log->GetPackets();
+    ASSERT_EQ(packets.size(), 1);
+    EXPECT_EQ(packets[0].GetType(), Msg_RemoteTimers);
+    EXPECT_EQ(packets[0].GetPayload(), timers.GetPayload());
+  }
+}
+
+TEST(CaptureSubscribers, SlowSubscribersDropPacketsWithoutBlocking) {
+  constexpr size_t kPacketSize = 1000;
+  constexpr size_t kNumPackets = 100;
+  std::promise<void> unblock;
+  std::shared_future<void> unblocked = unblock.get_future().share();
+  PacketLog slow_log;
+  auto write_to_slow_log = slow_log.GetWritePacketFunction();
+  PacketLog fast_log;
+  // With the header and the footer.
+  size_t queued_packet_size =
+      MakePacket(Msg_SamplingCallstacks, kPacketSize).GetSize();
+
+  CaptureSubscribers subscribers;
+  subscribers.Add(
+      [&](const TcpPacket& packet) {
+        unblocked.wait();
+        return write_to_slow_log(packet);
+      },
+      /*max_queued_bytes=*/10 * queued_packet_size);
+  subscribers.Add(fast_log.GetWritePacketFunction());
+  for (size_t i = 0; i < kNumPackets; ++i) {
+    subscribers.Publish(MakePacket(Msg_SamplingCallstacks, kPacketSize));
+  }
+  // The strings are never dropped.
+  subscribers.Publish(MakePacket(Msg_KeysAndStrings, kPacketSize));
+  EXPECT_GT(subscribers.GetNumDroppedPackets(), 0);
+
+  unblock.set_value();
+  subscribers.WaitUntilIdle();
+  EXPECT_EQ(fast_log.GetPackets().size(), kNumPackets + 1);
+  std::vector<TcpPacket> slow_packets = slow_log.GetPackets();
+  // The packet being written counts in the queued bytes.
+  EXPECT_EQ(slow_packets.size(), 11);
+  EXPECT_EQ(slow_packets.size() + subscribers.GetNumDroppedPackets(),
+            kNumPackets + 1);
+  EXPECT_EQ(slow_packets.back().GetType(), Msg_KeysAndStrings);
+}
+
+TEST(CaptureSubscribers, LateSubscribersReceiveTheStringsFirst) {
+  CaptureSubscribers subscribers;
+  subscribers.Publish(MakePacket(Msg_KeysAndStrings, 10));
+  subscribers.Publish(MakePacket(Msg_RemoteTimers, 10));
+  subscribers.Publish(MakePacket(Msg_KeysAndStrings, 20));
+
+  PacketLog log;
+  subscribers.Add(log.GetWritePacketFunction());
+  subscribers.Publish(MakePacket(Msg_RemoteTimers, 30));
+  subscribers.WaitUntilIdle();
+
+  std::vector<TcpPacket> packets = log.GetPackets();
+  ASSERT_EQ(packets.size(), 3);
+  EXPECT_EQ(packets[0].GetPayloadSize(), 10);
+  EXPECT_EQ(packets[1].GetPayloadSize(), 20);
+  EXPECT_EQ(packets[2].GetType(), Msg_RemoteTimers);
+}
+
+TEST(CaptureSubscribers, RemovesDisconnectedSubscribers) {
+  CaptureSubscribers subscribers;
+  subscribers.Add([](const TcpPacket&) { return false; });
+  ASSERT_EQ(subscribers.GetNumSubscribers(), 1);
+  subscribers.Publish(MakePacket(Msg_RemoteTimers, 10));
+  subscribers.WaitUntilIdle();
+  subscribers.Publish(MakePacket(Msg_RemoteTimers, 10));
+  EXPECT_EQ(subscribers.GetNumSubscribers(), 0);
+}
@@ -0,0 +1,334 @@
+#include "CaptureSummary.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <utility>
+
+#include "CallstackTypes.h"
+#include "ClockSync.h"
+#include "FrameIndex.h"
+#include "OrbitBase/Logging.h"
+#include "OrbitFunction.h"
+#include "ParallelFor.h"
+#include "SamplingProfiler.h"
+#include "ScopeTimer.h"
+#include "Serialization.h"
+#include "TimerChunkFile.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_format.h"
+
+// The header of a capture saved by CaptureSerializer, which serializes the
+// same fields in the same order.
+struct SavedCaptureHeader {
+  std::string m_CaptureName;
+  int m_Version = 0;
+  int m_TimerVersion = 0;
+  int m_NumTimers = 0;
+  int m_SizeOfTimer = 0;
+  std::map<std::string, ClockCorrection> m_ClockCorrections;
+
+  ORBIT_SERIALIZABLE;
+};
+
+ORBIT_SERIALIZE(SavedCaptureHeader, 1) {
+  ORBIT_NVP_VAL(0, m_CaptureName);
+  ORBIT_NVP_VAL(0, m_Version);
+  ORBIT_NVP_VAL(0, m_TimerVersion);
+  ORBIT_NVP_VAL(0, m_NumTimers);
+  ORBIT_NVP_VAL(0, m_SizeOfTimer);
+  ORBIT_NVP_VAL(1, m_ClockCorrections);
+}
+
+namespace {
+// Since version 4, the sections are each a size followed by their own
+// archive, in this order, see CaptureSerializer::Section.
+constexpr int kFirstVersionWithSizedSections = 4;
+constexpr size_t kFunctionsSection = 0;
+constexpr size_t kSamplingProfilerSection = 4;
+
+// Whether the time graph counts the timer as a call of its function, see
+// TimeGraph::ProcessTimer.
+bool IsFunctionCall(const Timer& timer) {
+  switch (timer.m_Type) {
+    case Timer::ALLOC:
+    case Timer::FREE:
+    case Timer::VARIABLE:
+    case Timer::FILE_IO:
+    case Timer::PAGE_FAULT:
+    case Timer::LOCK_WAIT:
+      return false;
+    default:
+      return timer.m_FunctionAddress > 0;
+  }
+}
+
+// Of the timers of a chunk.
+struct ChunkStats {
+  absl::flat_hash_map<uint64_t, FunctionStats> functions;
+  // Starts of the calls to the frame function, by thread.
+  absl::flat_hash_map<ThreadID, std::vector<uint64_t>> frame_starts;
+};
+
+void SummarizeTimers(TimerChunkReader* reader, uint64_t frame_address,
+                     bool parallel,
+                     absl::flat_hash_map<uint64_t, FunctionStats>* functions,
+                     FunctionStats* frames, uint64_t* num_frame_spikes) {
+  const size_t num_chunks = reader->GetChunks().size();
+  std::vector<ChunkStats> chunk_stats(num_chunks);
+  auto summarize_chunk = [&](size_t index) {
+    std::vector<Timer> timers;
+    if (!reader->ReadChunk(index, &timers)) {
+      ERROR("Could not read timer chunk %zu", index);
+      return;
+    }
+    ChunkStats& stats = chunk_stats[index];
+    for (const Timer& timer : timers) {
+      if (!IsFunctionCall(timer)) continue;
+      stats.functions[timer.m_FunctionAddress].Update(timer);
+      if (timer.m_FunctionAddress == frame_address) {
+        stats.frame_starts[timer.m_TID].push_back(timer.m_Start);
+      }
+    }
+  };
+  if (parallel) {
+    ParallelFor(num_chunks, summarize_chunk);
+  } else {
+    for (size_t i = 0; i < num_chunks; ++i) summarize_chunk(i);
+  }
+
+  absl::flat_hash_map<ThreadID, std::vector<uint64_t>> frame_starts;
+  for (ChunkStats& stats : chunk_stats) {
+    for (const auto& pair : stats.functions) {
+      (*functions)[pair.first].Add(pair.second);
+    }
+    for (auto& pair : stats.frame_starts) {
+      std::vector<uint64_t>& starts = frame_starts[pair.first];
+      starts.insert(starts.end(), pair.second.begin(), pair.second.end());
+    }
+  }
+
+  // The frames are those of the thread calling the frame function first.
+  const std::vector<uint64_t>* first_starts = nullptr;
+  uint64_t first_start = UINT64_MAX;
+  for (const auto& pair : frame_starts) {
+    uint64_t start = *std::min_element(pair.second.begin(), pair.second.end());
+    if (start < first_start) {
+      first_start = start;
+      first_starts = &pair.second;
+    }
+  }
+  if (first_starts == nullptr) return;
+  FrameIndex frame_index;
+  frame_index.Build(*first_starts);
+  for (size_t frame = 0; frame < frame_index.GetNumFrames(); ++frame) {
+    Timer timer;
+    timer.m_Start = frame_index.GetFrameStart(frame);
+    timer.m_End = frame_index.GetFrameEnd(frame);
+    frames->Update(timer);
+    if (frame_index.IsSpike(frame)) ++*num_frame_spikes;
+  }
+}
+
+// Reads the section at index, from the sections following the header.
+bool ReadSection(std::ifstream* file, size_t index, std::string* section) {
+  for (size_t i = 0; i <= index; ++i) {
+    uint64_t size = 0;
+    file->read(reinterpret_cast<char*>(&size), sizeof(size));
+    if (!*file) return false;
+    if (i < index) {
+      file->seekg(size, std::ios::cur);
+    } else {
+      section->resize(size);
+      file->read(&(*section)[0], size);
+    }
+  }
+  return static_cast<bool>(*file);
+}
+
+double GetIncreasePercent(double baseline, double current) {
+  return baseline > 0 ? 100.0 * (current - baseline) / baseline : 0.0;
+}
+}  // namespace
+
+bool SummarizeCapture(const std::string& file_name,
+                      const CaptureSummaryOptions& options,
+                      CaptureSummary* summary) {
+  std::ifstream file(file_name, std::ios::binary);
+  if (file.fail()) {
+    ERROR("Could not open capture %s", file_name.c_str());
+    return false;
+  }
+  *summary = CaptureSummary();
+  summary->file_name = file_name;
+
+  SavedCaptureHeader header;
+  std::vector<Function> functions;
+  std::shared_ptr<SamplingProfiler> profiler;
+  cereal::BinaryInputArchive archive(file);
+  archive(header);
+  if (header.m_Version >= kFirstVersionWithSizedSections) {
+    std::streampos sections_begin = file.tellg();
+    std::string section;
+    if (!ReadSection(&file, kFunctionsSection, &section)) {
+      ERROR("Truncated capture %s", file_name.c_str());
+      return false;
+    }
+    {
+      std::istringstream stream(section);
+      cereal::BinaryInputArchive section_archive(stream);
+      section_archive(functions);
+    }
+    file.seekg(sections_begin);
+    if (ReadSection(&file, kSamplingProfilerSection, &section)) {
+      std::istringstream stream(section);
+      cereal::BinaryInputArchive section_archive(stream);
+      section_archive(profiler);
+    }
+  } else {
+    // The functions are still first, but the other sections can't be
+    // skipped without decoding them.
+    archive(functions);
+  }
+
+  // The functions of the timers are the addresses they are selected with.
+  absl::flat_hash_map<uint64_t, const Function*> function_of_address;
+  uint64_t frame_address = 0;
+  for (const Function& function : functions) {
+    function_of_address.emplace(function.GetVirtualAddress(), &function);
+    if (!options.frame_function.empty() &&
+        function.PrettyName() == options.frame_function) {
+      frame_address = function.GetVirtualAddress();
+    }
+  }
+
+  TimerChunkReader reader;
+  if (header.m_Version >= 3 && reader.Open(file_name)) {
+    summary->num_timers = reader.GetNumTimers();
+    absl::flat_hash_map<uint64_t, FunctionStats> stats;
+    SummarizeTimers(&reader, frame_address, options.parallel, &stats,
+                    &summary->frames, &summary->num_frame_spikes);
+    for (const auto& pair : stats) {
+      auto it = function_of_address.find(pair.first);
+      std::string name = it != function_of_address.end()
+                             ? it->second->PrettyName()
+                             : absl::StrFormat("0x%x", pair.first);
+      summary->functions.push_back({std::move(name), pair.first, pair.second});
+    }
+  } else {
+    for (const Function& function : functions) {
+      if (function.Stats() != nullptr && function.Stats()->m_Count > 0) {
+        summary->functions.push_back({function.PrettyName(),
+                                      function.GetVirtualAddress(),
+                                      *function.Stats()});
+      }
+    }
+  }
+  std::sort(summary->functions.begin(), summary->functions.end(),
+            [](const FunctionTimings& a, const FunctionTimings& b) {
+              return a.name < b.name;
+            });
+
+  if (profiler != nullptr) {
+    const ThreadSampleData& samples = profiler->GetSummary();
+    summary->num_samples = samples.m_NumSamples;
+    for (const SampledFunction& function : samples.m_SampleReport) {
+      if (summary->sampled_functions.size() == options.max_sampled_functions) {
+        break;
+      }
+      summary->sampled_functions.push_back(
+          {ws2s(function.m_Name), function.m_Exclusive, function.m_Inclusive});
+    }
+  }
+  return true;
+}
+
+std::vector<Regression> FindRegressions(
+    const CaptureSummary& baseline, const CaptureSummary& current,
+    const RegressionThresholds& thresholds) {
+  std::vector<Regression> regressions;
+  auto check_increase = [&](const std::string& kind, const std::string& name,
+                            const std::string& metric, double baseline_value,
+                            double current_value) {
+    if (GetIncreasePercent(baseline_value, current_value) >
+        thresholds.max_increase_percent) {
+      regressions.push_back(
+          {kind, name, metric, baseline_value, current_value});
+    }
+  };
+
+  for (const TimingDiff& diff :
+       DiffFunctionTimings(baseline.functions, current.functions)) {
+    if (diff.p_value >= thresholds.significance_level || diff.shift <= 0) {
+      continue;
+    }
+    check_increase("function", diff.name, "median ms",
+                   diff.baseline.GetPercentileMs(0.5),
+                   diff.comparison.GetPercentileMs(0.5));
+    check_increase("function", diff.name, "p95 ms",
+                   diff.baseline.GetPercentileMs(0.95),
+                   diff.comparison.GetPercentileMs(0.95));
+  }
+
+  if (baseline.frames.m_Count > 0 && current.frames.m_Count > 0) {
+    check_increase("frames", "", "median ms",
+                   baseline.frames.GetPercentileMs(0.5),
+                   current.frames.GetPercentileMs(0.5));
+    check_increase("frames", "", "p95 ms",
+                   baseline.frames.GetPercentileMs(0.95),
+                   current.frames.GetPercentileMs(0.95));
+  }
+
+  absl::flat_hash_map<std::string, float> baseline_exclusive;
+  for (const SampledFunctionSummary& function : baseline.sampled_functions) {
+    baseline_exclusive[function.name] = function.exclusive;
+  }
+  for (const SampledFunctionSummary& function : current.sampled_functions) {
+    auto it = baseline_exclusive.find(function.name);
+    float baseline_value = it != baseline_exclusive.end() ? it->second : 0.f;
+    if (function.exclusive - baseline_value >
+        thresholds.max_exclusive_increase) {
+      regressions.push_back({"sampling", function.name, "exclusive %",
+                             baseline_value, function.exclusive});
+    }
+  }
+  return regressions;
+}
+
+bool SaveCaptureSummary(const CaptureSummary& summary,
+                        const std::string& file_name) {
+  std::ofstream file(file_name);
+  if (file.fail()) return false;
+  {
+    cereal::JSONOutputArchive archive(file);
+    archive(cereal::make_nvp("CaptureSummary", summary));
+  }
+  return static_cast<bool>(file);
+}
+
+bool LoadCaptureSummary(const std::string& file_name,
+                        CaptureSummary* summary) {
+  std::ifstream file(file_name);
+  if (file.fail()) return false;
+  cereal::JSONInputArchive archive(file);
+  archive(cereal::make_nvp("CaptureSummary", *summary));
+  return true;
+}
+
+ORBIT_SERIALIZE(SampledFunctionSummary, 0) {
+  ORBIT_NVP_VAL(0, name);
+  ORBIT_NVP_VAL(0, exclusive);
+  ORBIT_NVP_VAL(0, inclusive);
+}
+
+ORBIT_SERIALIZE(CaptureSummary, 0) {
+  ORBIT_NVP_VAL(0, file_name);
+  ORBIT_NVP_VAL(0, num_timers);
+  ORBIT_NVP_VAL(0, functions);
+  ORBIT_NVP_VAL(0, frames);
+  ORBIT_NVP_VAL(0, num_frame_spikes);
+  ORBIT_NVP_VAL(0, num_samples);
+  ORBIT_NVP_VAL(0, sampled_functions);
+}
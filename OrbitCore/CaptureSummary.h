@@ -0,0 +1,86 @@
+#ifndef ORBIT_CORE_CAPTURE_SUMMARY_H_
+#define ORBIT_CORE_CAPTURE_SUMMARY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "FunctionStats.h"
+#include "SerializationMacros.h"
+#include "TimerDiff.h"
+
+// Share of the samples of a function, in percents.
+struct SampledFunctionSummary {
+  std::string name;
+  float exclusive = 0.f;
+  float inclusive = 0.f;
+
+  ORBIT_SERIALIZABLE;
+};
+
+// What automated checks compare of a capture saved by CaptureSerializer,
+// e.g. nightly captures against those of a known good build. Computed
+// without the UI or the globals of Capture, so that captures are summarized
+// in parallel, and saved as JSON.
+struct CaptureSummary {
+  std::string file_name;
+  uint64_t num_timers = 0;
+  // Of the instrumented functions called, from their timers if the capture
+  // has some, from the stats saved with the functions otherwise.
+  std::vector<FunctionTimings> functions;
+  // Durations of the frames of the frame function, on the first thread
+  // calling it, see FrameIndex.
+  FunctionStats frames;
+  uint64_t num_frame_spikes = 0;
+  uint64_t num_samples = 0;
+  // Of all threads, by decreasing inclusive share.
+  std::vector<SampledFunctionSummary> sampled_functions;
+
+  ORBIT_SERIALIZABLE;
+};
+
+struct CaptureSummaryOptions {
+  // Pretty name of the main frame function, none if empty.
+  std::string frame_function;
+  size_t max_sampled_functions = 100;
+  // Whether the timer chunks are decompressed on all cores. Off when the
+  // captures themselves are summarized in parallel.
+  bool parallel = true;
+};
+
+// Returns false if file_name isn't a capture saved by CaptureSerializer.
+bool SummarizeCapture(const std::string& file_name,
+                      const CaptureSummaryOptions& options,
+                      CaptureSummary* summary);
+
+// When a change between a baseline and a current summary fails the check.
+struct RegressionThresholds {
+  // Of the shift of the durations of a function, see TimingDiff::p_value.
+  double significance_level = 0.01;
+  // Of the median or the 95th percentile of the durations of a significantly
+  // shifted function, or of the frames.
+  double max_increase_percent = 5.0;
+  // Of the exclusive share of the samples of a function, in percent points.
+  float max_exclusive_increase = 1.f;
+};
+
+struct Regression {
+  // "function", "frames" or "sampling".
+  std::string kind;
+  std::string name;
+  // Of the durations in milliseconds, or of the shares in percents.
+  std::string metric;
+  double baseline = 0.0;
+  double current = 0.0;
+};
+
+std::vector<Regression> FindRegressions(const CaptureSummary& baseline,
+                                        const CaptureSummary& current,
+                                        const RegressionThresholds& thresholds);
+
+bool SaveCaptureSummary(const CaptureSummary& summary,
+                        const std::string& file_name);
+bool LoadCaptureSummary(const std::string& file_name, CaptureSummary* summary);
+
+#endif  // ORBIT_CORE_CAPTURE_SUMMARY_H_
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "CaptureSummary.h"
+#include "ScopeTimer.h"
+
+namespace {
+FunctionStats MakeStats(TickType duration, int count) {
+  FunctionStats stats;
+  for (int i = 0; i < count; ++i) {
+    Timer timer;
+    timer.m_Start = 0;
+    timer.m_End = duration;
+    stats.Update(timer);
+  }
+  return stats;
+}
+}  // namespace
+
+TEST(CaptureSummary, FindsRegressionsAboveThresholds) {
+  CaptureSummary baseline;
+  baseline.functions = {{"Stable", 1, MakeStats(1000, 500)},
+                        {"Slower", 2, MakeStats(1000, 500)},
+                        {"Faster", 3, MakeStats(2000, 500)}};
+  baseline.frames = MakeStats(16000, 100);
+  baseline.sampled_functions = {{"Hot", 10.f, 20.f}, {"Cold", 1.f, 2.f}};
+
+  CaptureSummary current = baseline;
+  current.functions[1].stats = MakeStats(2000, 500);
+  current.functions[2].stats = MakeStats(1000, 500);
+  current.sampled_functions = {{"Hot", 10.5f, 21.f}, {"Cold", 3.f, 4.f}};
+
+  std::vector<Regression> regressions =
+      FindRegressions(baseline, current, RegressionThresholds());
+  ASSERT_EQ(regressions.size(), 3);
+  EXPECT_EQ(regressions[0].kind, "function");
+  EXPECT_EQ(regressions[0].name, "Slower");
+  EXPECT_EQ(regressions[0].metric, "median ms");
+  EXPECT_GT(regressions[0].current, regressions[0].baseline);
+  EXPECT_EQ(regressions[1].name, "Slower");
+  EXPECT_EQ(regressions[1].metric, "p95 ms");
+  EXPECT_EQ(regressions[2].kind, "sampling");
+  EXPECT_EQ(regressions[2].name, "Cold");
+
+  current.frames = MakeStats(20000, 100);
+  regressions = FindRegressions(baseline, current, RegressionThresholds());
+  ASSERT_EQ(regressions.size(), 5);
+  EXPECT_EQ(regressions[2].kind, "frames");
+}
+
+TEST(CaptureSummary, SavesAndLoadsAsJson) {
+  CaptureSummary summary;
+  summary.file_name = "capture.orbit";
+  summary.num_timers = 42;
+  summary.functions = {{"Function", 0x1234, MakeStats(1000, 3)}};
+  summary.frames = MakeStats(16000, 2);
+  summary.num_samples = 100;
+  summary.sampled_functions = {{"Hot", 10.f, 20.f}};
+
+  std::string file_name = testing::TempDir() + "capture_summary.json";
+  ASSERT_TRUE(SaveCaptureSummary(summary, file_name));
+  CaptureSummary loaded;
+  ASSERT_TRUE(LoadCaptureSummary(file_name, &loaded));
+  std::remove(file_name.c_str());
+
+  EXPECT_EQ(loaded.file_name, summary.file_name);
+  EXPECT_EQ(loaded.num_timers, 42);
+  ASSERT_EQ(loaded.functions.size(), 1);
+  EXPECT_EQ(loaded.functions[0].name, "Function");
+  EXPECT_EQ(loaded.functions[0].address, 0x1234);
+  EXPECT_EQ(loaded.functions[0].stats.m_Count, 3);
+  EXPECT_EQ(loaded.functions[0].stats.m_Histogram.GetTotalCount(), 3);
+  EXPECT_EQ(loaded.frames.m_Count, 2);
+  EXPECT_EQ(loaded.num_samples, 100);
+  ASSERT_EQ(loaded.sampled_functions.size(), 1);
+  EXPECT_EQ(loaded.sampled_functions[0].name, "Hot");
+  EXPECT_FLOAT_EQ(loaded.sampled_functions[0].inclusive, 20.f);
+}
+
+TEST(CaptureSummary, FailsOnMissingCapture) {
+  CaptureSummary summary;
+  EXPECT_FALSE(SummarizeCapture(testing::TempDir() + "missing.orbit",
+                                CaptureSummaryOptions(), &summary));
+}
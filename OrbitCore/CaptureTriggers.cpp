@@ -0,0 +1,195 @@
+#include "CaptureTriggers.h"
+
+#include <OrbitBase/Logging.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "Utils.h"
+#include "absl/base/casts.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/strip.h"
+
+namespace {
+// Named like in TracerThread::ReportStatsIfTimerElapsed and
+// ConnectionManager::RecordSenderStatsIfWindowElapsed.
+constexpr const char* kLostEventsStat = "lost/s";
+constexpr const char* kDroppedEventsStat = "session dropped events";
+
+// Splits on the commas outside of template arguments, which function names
+// can have.
+std::vector<std::string> SplitTriggers(const std::string& text) {
+  std::vector<std::string> parts(1);
+  int depth = 0;
+  for (char c : text) {
+    if (c == '<') {
+      ++depth;
+    } else if (c == '>' && depth > 0) {
+      --depth;
+    } else if (c == ',' && depth == 0) {
+      parts.emplace_back();
+      continue;
+    }
+    parts.back() += c;
+  }
+  return parts;
+}
+
+// Splits "<name>><threshold>" on the last '>', the name possibly ending with
+// template arguments.
+bool SplitThreshold(absl::string_view text, std::string* name,
+                    double* threshold) {
+  size_t separator = text.rfind('>');
+  if (separator == absl::string_view::npos) {
+    return false;
+  }
+  *name = std::string(absl::StripAsciiWhitespace(text.substr(0, separator)));
+  absl::string_view value =
+      absl::StripAsciiWhitespace(text.substr(separator + 1));
+  return !name->empty() && absl::SimpleAtod(value, threshold) &&
+         *threshold >= 0;
+}
+}  // namespace
+
+std::optional<std::vector<CaptureTrigger>> ParseCaptureTriggers(
+    const std::string& text,
+    const std::function<std::optional<uint64_t>(const std::string& name)>&
+        get_function_address) {
+  std::vector<CaptureTrigger> triggers;
+  for (const std::string& part : SplitTriggers(text)) {
+    absl::string_view trigger_text = absl::StripAsciiWhitespace(part);
+    if (trigger_text.empty()) {
+      continue;
+    }
+    if (trigger_text == "lost") {
+      triggers.push_back({CaptureTrigger::kLostEvents, 0, 0});
+      continue;
+    }
+
+    CaptureTrigger::Type type = CaptureTrigger::kFunctionDuration;
+    if (absl::ConsumePrefix(&trigger_text, "frame:")) {
+      type = CaptureTrigger::kFrameTime;
+    }
+    std::string name;
+    double threshold;
+    if (!SplitThreshold(trigger_text, &name, &threshold)) {
+      ERROR("Invalid capture trigger \"%s\"", part.c_str());
+      return std::nullopt;
+    }
+    if (type == CaptureTrigger::kFunctionDuration && name == "lost") {
+      triggers.push_back({CaptureTrigger::kLostEvents, 0,
+                          static_cast<uint64_t>(threshold)});
+      continue;
+    }
+    std::optional<uint64_t> address = get_function_address(name);
+    if (!address.has_value()) {
+      ERROR("No instrumented function \"%s\" for capture trigger",
+            name.c_str());
+      return std::nullopt;
+    }
+    triggers.push_back({type, address.value(),
+                        static_cast<uint64_t>(std::llround(threshold * 1e6))});
+  }
+  return triggers;
+}
+
+CaptureTriggers::CaptureTriggers(const std::vector<CaptureTrigger>& triggers,
+                                 uint64_t min_interval_ns)
+    : lost_key_(StringHash(kLostEventsStat)),
+      dropped_key_(StringHash(kDroppedEventsStat)),
+      min_interval_ns_(min_interval_ns) {
+  for (const CaptureTrigger& trigger : triggers) {
+    if (trigger.type == CaptureTrigger::kLostEvents) {
+      max_lost_per_s_ = has_lost_trigger_ ? std::min(max_lost_per_s_,
+                                                     double(trigger.threshold))
+                                          : trigger.threshold;
+      has_lost_trigger_ = true;
+      continue;
+    }
+    auto [it, inserted] = function_indices_.try_emplace(
+        trigger.function_address, static_cast<uint32_t>(functions_.size()));
+    if (inserted) {
+      functions_.push_back({trigger.function_address});
+    }
+    FunctionTriggers& function = functions_[it->second];
+    if (trigger.type == CaptureTrigger::kFunctionDuration) {
+      function.max_duration_ns =
+          std::min(function.max_duration_ns, trigger.threshold);
+    } else {
+      function.max_frame_ns =
+          std::min(function.max_frame_ns, trigger.threshold);
+    }
+  }
+}
+
+bool CaptureTriggers::OnTimer(const Timer& timer, std::string* reason) {
+  switch (timer.m_Type) {
+    case Timer::NONE:
+      return OnFunctionTimer(timer, reason);
+    case Timer::SERVICE_STATS:
+      return has_lost_trigger_ && OnServiceStat(timer, reason);
+    default:
+      return false;
+  }
+}
+
+bool CaptureTriggers::OnFunctionTimer(const Timer& timer, std::string* reason) {
+  auto it = function_indices_.find(timer.m_FunctionAddress);
+  if (it == function_indices_.end()) {
+    return false;
+  }
+  FunctionTriggers& function = functions_[it->second];
+  uint64_t duration_ns = timer.m_End - timer.m_Start;
+  if (duration_ns > function.max_duration_ns && Fire(timer.m_End)) {
+    *reason = absl::StrFormat("call to %#x of %.3f ms", function.address,
+                              duration_ns * 1e-6);
+    return true;
+  }
+  // The timers of different threads aren't in order: only later begins count.
+  uint64_t last_begin = function.last_begin;
+  if (timer.m_Start <= last_begin) {
+    return false;
+  }
+  function.last_begin = timer.m_Start;
+  uint64_t frame_ns = timer.m_Start - last_begin;
+  if (last_begin != 0 && frame_ns > function.max_frame_ns &&
+      Fire(timer.m_Start)) {
+    *reason = absl::StrFormat("frame of %.3f ms between calls to %#x",
+                              frame_ns * 1e-6, function.address);
+    return true;
+  }
+  return false;
+}
+
+bool CaptureTriggers::OnServiceStat(const Timer& timer, std::string* reason) {
+  uint64_t key = timer.m_UserData[0];
+  if (key != lost_key_ && key != dropped_key_) {
+    return false;
+  }
+  double value = absl::bit_cast<double>(timer.m_UserData[1]);
+  if (key == lost_key_) {
+    if (value > max_lost_per_s_ && Fire(timer.m_End)) {
+      *reason = absl::StrFormat("%.0f events lost per second", value);
+      return true;
+    }
+    return false;
+  }
+  // A count since the capture started.
+  double num_dropped = value - num_dropped_;
+  num_dropped_ = std::max(num_dropped_, value);
+  if (num_dropped > 0 && Fire(timer.m_End)) {
+    *reason = absl::StrFormat("%.0f events dropped", num_dropped);
+    return true;
+  }
+  return false;
+}
+
+bool CaptureTriggers::Fire(uint64_t time) {
+  if (last_fire_time_.has_value() &&
+      time < last_fire_time_.value() + min_interval_ns_) {
+    return false;
+  }
+  last_fire_time_ = time;
+  return true;
+}
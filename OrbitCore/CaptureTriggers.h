@@ -0,0 +1,83 @@
+#ifndef ORBIT_CORE_CAPTURE_TRIGGERS_H_
+#define ORBIT_CORE_CAPTURE_TRIGGERS_H_
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "ScopeTimer.h"
+#include "absl/container/flat_hash_map.h"
+
+#pragma pack(push, 1)
+// The payload of Msg_CaptureTriggers is an array of these, sent by the UI
+// with Msg_FlightRecorderRequest: the conditions on which the service sends
+// the window of its flight recorder on its own, see FlightRecorder.h.
+struct CaptureTrigger {
+  enum Type : uint32_t {
+    // A call to function_address lasting more than threshold.
+    kFunctionDuration,
+    // More than threshold between the begins of two calls to
+    // function_address, e.g. the function presenting the frames.
+    kFrameTime,
+    // More than threshold events per second lost by the tracer, or any event
+    // dropped by the service. function_address is unused.
+    kLostEvents,
+  };
+  Type type;
+  uint64_t function_address;
+  uint64_t threshold;
+};
+#pragma pack(pop)
+
+// Parses triggers like GParams.m_FlightRecorderTriggers, comma-separated:
+// "<function>><ms>" for kFunctionDuration, "frame:<function>><ms>" for
+// kFrameTime, and "lost" or "lost><events per second>" for kLostEvents. The
+// functions are looked up by name with get_function_address. Returns nullopt,
+// after logging why, if one can't be parsed or its function isn't found.
+std::optional<std::vector<CaptureTrigger>> ParseCaptureTriggers(
+    const std::string& text,
+    const std::function<std::optional<uint64_t>(const std::string& name)>&
+        get_function_address);
+
+// Evaluates the triggers on the timers the service sends, in constant time
+// per timer: the thresholds of the functions with triggers are in a flat
+// array, their indices found by address, and all other timers are skipped
+// after that single lookup. Once a trigger fires, the others are ignored for
+// min_interval_ns, so that a burst of slow calls makes a single snapshot.
+class CaptureTriggers {
+ public:
+  CaptureTriggers(const std::vector<CaptureTrigger>& triggers,
+                  uint64_t min_interval_ns);
+
+  // Returns whether timer fires a trigger, then describing it in reason.
+  bool OnTimer(const Timer& timer, std::string* reason);
+
+  bool IsEmpty() const { return functions_.empty() && !has_lost_trigger_; }
+
+ private:
+  struct FunctionTriggers {
+    uint64_t address;
+    uint64_t max_duration_ns = std::numeric_limits<uint64_t>::max();
+    uint64_t max_frame_ns = std::numeric_limits<uint64_t>::max();
+    uint64_t last_begin = 0;
+  };
+
+  bool OnFunctionTimer(const Timer& timer, std::string* reason);
+  bool OnServiceStat(const Timer& timer, std::string* reason);
+  bool Fire(uint64_t time);
+
+  absl::flat_hash_map<uint64_t, uint32_t> function_indices_;
+  std::vector<FunctionTriggers> functions_;
+  bool has_lost_trigger_ = false;
+  double max_lost_per_s_ = 0;
+  uint64_t lost_key_;
+  uint64_t dropped_key_;
+  double num_dropped_ = 0;
+  uint64_t min_interval_ns_;
+  std::optional<uint64_t> last_fire_time_;
+};
+
+#endif  // ORBIT_CORE_CAPTURE_TRIGGERS_H_
@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "CaptureTriggers.h"
+#include "Utils.h"
+#include "absl/base/casts.h"
+
+namespace {
+constexpr uint64_t kUpdate = 0x100;
+constexpr uint64_t kPresent = 0x200;
+constexpr uint64_t kMs = 1'000'000;
+
+std::optional<uint64_t> GetFunctionAddress(const std::string& name) {
+  if (name == "Update") return kUpdate;
+  if (name == "Present<Vulkan, 2>") return kPresent;
+  return std::nullopt;
+}
+
+Timer MakeFunctionTimer(uint64_t address, uint64_t start, uint64_t end) {
+  Timer timer;
+  timer.m_Start = start;
+  timer.m_End = end;
+  timer.m_FunctionAddress = address;
+  return timer;
+}
+
+Timer MakeStatTimer(const std::string& name, double value, uint64_t end) {
+  Timer timer;
+  timer.m_Type = Timer::SERVICE_STATS;
+  timer.m_Start = end - 1;
+  timer.m_End = end;
+  timer.m_UserData[0] = StringHash(name);
+  timer.m_UserData[1] = absl::bit_cast<uint64_t>(value);
+  return timer;
+}
+}  // namespace
+
+TEST(CaptureTriggers, ParsesTriggers) {
+  std::optional<std::vector<CaptureTrigger>> triggers = ParseCaptureTriggers(
+      "Update>5, frame:Present<Vulkan, 2>>33.3,lost,lost>100",
+      &GetFunctionAddress);
+  ASSERT_TRUE(triggers.has_value());
+  ASSERT_EQ(triggers->size(), 4);
+  EXPECT_EQ((*triggers)[0].type, CaptureTrigger::kFunctionDuration);
+  EXPECT_EQ((*triggers)[0].function_address, kUpdate);
+  EXPECT_EQ((*triggers)[0].threshold, 5 * kMs);
+  EXPECT_EQ((*triggers)[1].type, CaptureTrigger::kFrameTime);
+  EXPECT_EQ((*triggers)[1].function_address, kPresent);
+  EXPECT_EQ((*triggers)[1].threshold, 33'300'000);
+  EXPECT_EQ((*triggers)[2].type, CaptureTrigger::kLostEvents);
+  EXPECT_EQ((*triggers)[3].threshold, 100);
+
+  EXPECT_TRUE(ParseCaptureTriggers("", &GetFunctionAddress)->empty());
+  EXPECT_FALSE(ParseCaptureTriggers("Draw>5", &GetFunctionAddress));
+  EXPECT_FALSE(ParseCaptureTriggers("Update", &GetFunctionAddress));
+  EXPECT_FALSE(ParseCaptureTriggers("Update>x", &GetFunctionAddress));
+}
+
+TEST(CaptureTriggers, FiresOnSlowCallsAndFrames) {
+  CaptureTriggers triggers(
+      {{CaptureTrigger::kFunctionDuration, kUpdate, 5 * kMs},
+       {CaptureTrigger::kFrameTime, kPresent, 20 * kMs}},
+      /*min_interval_ns=*/100 * kMs);
+  std::string reason;
+  EXPECT_FALSE(triggers.OnTimer(MakeFunctionTimer(kUpdate, 0, 4 * kMs),
+                                &reason));
+  EXPECT_FALSE(triggers.OnTimer(MakeFunctionTimer(0x300, 0, 50 * kMs),
+                                &reason));
+  EXPECT_TRUE(triggers.OnTimer(MakeFunctionTimer(kUpdate, 0, 6 * kMs),
+                               &reason));
+  EXPECT_FALSE(reason.empty());
+  // Within the interval of the last one.
+  EXPECT_FALSE(triggers.OnTimer(
+      MakeFunctionTimer(kUpdate, 50 * kMs, 60 * kMs), &reason));
+
+  for (uint64_t frame = 1; frame < 10; ++frame) {
+    uint64_t begin = 200 * kMs + frame * 16 * kMs;
+    EXPECT_FALSE(triggers.OnTimer(
+        MakeFunctionTimer(kPresent, begin, begin + kMs), &reason));
+  }
+  EXPECT_TRUE(triggers.OnTimer(
+      MakeFunctionTimer(kPresent, 400 * kMs, 401 * kMs), &reason));
+}
+
+TEST(CaptureTriggers, FiresOnLostEvents) {
+  CaptureTriggers triggers({{CaptureTrigger::kLostEvents, 0, 10}},
+                           /*min_interval_ns=*/0);
+  std::string reason;
+  EXPECT_FALSE(triggers.OnTimer(MakeStatTimer("lost/s", 5, 100), &reason));
+  EXPECT_FALSE(triggers.OnTimer(MakeStatTimer("samples/s", 50, 100), &reason));
+  EXPECT_TRUE(triggers.OnTimer(MakeStatTimer("lost/s", 50, 200), &reason));
+
+  EXPECT_TRUE(triggers.OnTimer(
+      MakeStatTimer("session dropped events", 3, 300), &reason));
+  // Still 3 since the capture started.
+  EXPECT_FALSE(triggers.OnTimer(
+      MakeStatTimer("session dropped events", 3, 400), &reason));
+  EXPECT_FALSE(triggers.IsEmpty());
+  EXPECT_TRUE(CaptureTriggers({}, 0).IsEmpty());
+}
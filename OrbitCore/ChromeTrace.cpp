@@ -0,0 +1,438 @@
+#include "ChromeTrace.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "absl/strings/str_format.h"
+
+namespace {
+constexpr size_t kBlockSize = 1024 * 1024;
+
+uint64_t NsFromMicros(double micros) {
+  return micros > 0 ? static_cast<uint64_t>(std::llround(micros * 1000)) : 0;
+}
+
+void AppendUtf8(uint32_t code, std::string* text) {
+  if (code < 0x80) {
+    text->push_back(static_cast<char>(code));
+  } else if (code < 0x800) {
+    text->push_back(static_cast<char>(0xC0 | code >> 6));
+    text->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+  } else if (code < 0x10000) {
+    text->push_back(static_cast<char>(0xE0 | code >> 12));
+    text->push_back(static_cast<char>(0x80 | (code >> 6 & 0x3F)));
+    text->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+  } else {
+    text->push_back(static_cast<char>(0xF0 | code >> 18));
+    text->push_back(static_cast<char>(0x80 | (code >> 12 & 0x3F)));
+    text->push_back(static_cast<char>(0x80 | (code >> 6 & 0x3F)));
+    text->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+  }
+}
+
+// The characters of a JSON stream, read a block at a time.
+class JsonInput {
+ public:
+  explicit JsonInput(std::istream* stream) : stream_(stream) {}
+
+  // The next character that isn't white space, which is left to read, -1 at
+  // the end of the stream.
+  int Peek();
+  // Reads c if it is the next character that isn't white space.
+  bool Consume(char c);
+
+  bool ReadString(std::string* value);
+  bool ReadNumber(double* value);
+  // Of any type, nested values included.
+  bool SkipValue();
+
+ private:
+  int Get();
+  bool ReadHex4(uint32_t* value);
+  bool Fill();
+
+  std::istream* stream_;
+  std::string buffer_;
+  size_t pos_ = 0;
+};
+
+int JsonInput::Peek() {
+  while (pos_ < buffer_.size() || Fill()) {
+    char c = buffer_[pos_];
+    if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+      return static_cast<unsigned char>(c);
+    }
+    ++pos_;
+  }
+  return -1;
+}
+
+bool JsonInput::Consume(char c) {
+  if (Peek() != static_cast<unsigned char>(c)) return false;
+  ++pos_;
+  return true;
+}
+
+int JsonInput::Get() {
+  if (pos_ == buffer_.size() && !Fill()) return -1;
+  return static_cast<unsigned char>(buffer_[pos_++]);
+}
+
+bool JsonInput::Fill() {
+  buffer_.resize(kBlockSize);
+  stream_->read(&buffer_[0], buffer_.size());
+  buffer_.resize(stream_->gcount());
+  pos_ = 0;
+  return !buffer_.empty();
+}
+
+bool JsonInput::ReadHex4(uint32_t* value) {
+  *value = 0;
+  for (int i = 0; i < 4; ++i) {
+    int c = Get();
+    uint32_t digit;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      digit = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      digit = c - 'A' + 10;
+    } else {
+      return false;
+    }
+    *value = *value << 4 | digit;
+  }
+  return true;
+}
+
+bool JsonInput::ReadString(std::string* value) {
+  value->clear();
+  if (!Consume('"')) return false;
+  while (pos_ < buffer_.size() || Fill()) {
+    // Runs of plain characters are copied at once.
+    size_t end = pos_;
+    while (end < buffer_.size() && buffer_[end] != '"' &&
+           buffer_[end] != '\\') {
+      ++end;
+    }
+    value->append(buffer_, pos_, end - pos_);
+    pos_ = end;
+    if (pos_ == buffer_.size()) continue;
+
+    if (buffer_[pos_++] == '"') return true;
+    int escaped = Get();
+    switch (escaped) {
+      case '"':
+      case '\\':
+      case '/':
+        value->push_back(static_cast<char>(escaped));
+        break;
+      case 'b':
+        value->push_back('\b');
+        break;
+      case 'f':
+        value->push_back('\f');
+        break;
+      case 'n':
+        value->push_back('\n');
+        break;
+      case 'r':
+        value->push_back('\r');
+        break;
+      case 't':
+        value->push_back('\t');
+        break;
+      case 'u': {
+        uint32_t code;
+        if (!ReadHex4(&code)) return false;
+        // Characters past the first plane are pairs of surrogates.
+        if (code >= 0xD800 && code < 0xDC00) {
+          uint32_t low;
+          if (Get() != '\\' || Get() != 'u' || !ReadHex4(&low) ||
+              low < 0xDC00 || low >= 0xE000) {
+            return false;
+          }
+          code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        }
+        AppendUtf8(code, value);
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+  return false;
+}
+
+bool JsonInput::ReadNumber(double* value) {
+  std::string text;
+  Peek();
+  while (pos_ < buffer_.size() || Fill()) {
+    char c = buffer_[pos_];
+    if (!((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' ||
+          c == 'e' || c == 'E')) {
+      break;
+    }
+    text.push_back(c);
+    ++pos_;
+  }
+  if (text.empty()) return false;
+  char* end;
+  *value = std::strtod(text.c_str(), &end);
+  return end == text.c_str() + text.size();
+}
+
+bool JsonInput::SkipValue() {
+  std::string scratch;
+  int depth = 0;
+  do {
+    int c = Peek();
+    if (c == '"') {
+      if (!ReadString(&scratch)) return false;
+    } else if (c == '{' || c == '[') {
+      ++pos_;
+      ++depth;
+    } else if (c == '}' || c == ']') {
+      if (depth == 0) return false;
+      ++pos_;
+      --depth;
+    } else if (c == ',' || c == ':') {
+      if (depth == 0) return false;
+      ++pos_;
+    } else {
+      // A number, true, false or null.
+      size_t length = 0;
+      while (pos_ < buffer_.size() || Fill()) {
+        char next = buffer_[pos_];
+        if (!((next >= '0' && next <= '9') || (next >= 'a' && next <= 'z') ||
+              next == '-' || next == '+' || next == '.' || next == 'E')) {
+          break;
+        }
+        ++pos_;
+        ++length;
+      }
+      if (length == 0) return false;
+    }
+  } while (depth > 0);
+  return true;
+}
+
+// The fields of an event that are read, the others being skipped.
+struct ChromeEvent {
+  std::string phase;
+  std::string name;
+  double timestamp = 0;
+  double duration = 0;
+  uint32_t tid = 0;
+  // "name" of "args", that of the thread for thread_name events.
+  std::string arg_name;
+};
+
+class ChromeTraceReader {
+ public:
+  ChromeTraceReader(std::istream* stream, TraceEventVisitor* visitor)
+      : input_(stream), visitor_(visitor) {}
+
+  bool Read();
+
+ private:
+  static constexpr uint64_t kNotEnded = std::numeric_limits<uint64_t>::max();
+
+  // A scope open on a thread: a duration event not ended yet, or a complete
+  // event that may contain the next events.
+  struct OpenScope {
+    uint64_t start_ns;
+    uint64_t end_ns;
+    std::string name;
+  };
+
+  bool ReadEvents();
+  bool ReadEvent();
+  bool ReadArgs();
+  void OnEvent();
+
+  JsonInput input_;
+  TraceEventVisitor* visitor_;
+  ChromeEvent event_;
+  std::string key_;
+  std::unordered_map<uint32_t, std::vector<OpenScope>> open_scopes_;
+};
+
+bool ChromeTraceReader::Read() {
+  if (input_.Peek() == '[') return ReadEvents();
+
+  if (!input_.Consume('{')) return false;
+  if (input_.Consume('}')) return true;
+  do {
+    if (!input_.ReadString(&key_) || !input_.Consume(':')) return false;
+    bool valid = key_ == "traceEvents" ? ReadEvents() : input_.SkipValue();
+    if (!valid) return false;
+  } while (input_.Consume(','));
+  return input_.Consume('}');
+}
+
+bool ChromeTraceReader::ReadEvents() {
+  if (!input_.Consume('[')) return false;
+  if (input_.Consume(']')) return true;
+  do {
+    if (input_.Peek() == -1) return true;
+    if (!ReadEvent()) return false;
+    OnEvent();
+  } while (input_.Consume(','));
+  return input_.Peek() == -1 || input_.Consume(']');
+}
+
+bool ChromeTraceReader::ReadEvent() {
+  event_.phase.clear();
+  event_.name.clear();
+  event_.timestamp = 0;
+  event_.duration = 0;
+  event_.tid = 0;
+  event_.arg_name.clear();
+
+  if (!input_.Consume('{')) return false;
+  if (input_.Consume('}')) return true;
+  do {
+    if (!input_.ReadString(&key_) || !input_.Consume(':')) return false;
+    bool valid;
+    if (key_ == "ph") {
+      valid = input_.ReadString(&event_.phase);
+    } else if (key_ == "name") {
+      valid = input_.ReadString(&event_.name);
+    } else if (key_ == "ts") {
+      valid = input_.ReadNumber(&event_.timestamp);
+    } else if (key_ == "dur") {
+      valid = input_.ReadNumber(&event_.duration);
+    } else if (key_ == "tid" && input_.Peek() != '"') {
+      double tid;
+      valid = input_.ReadNumber(&tid);
+      event_.tid = static_cast<uint32_t>(tid);
+    } else if (key_ == "args" && input_.Peek() == '{') {
+      valid = ReadArgs();
+    } else {
+      valid = input_.SkipValue();
+    }
+    if (!valid) return false;
+  } while (input_.Consume(','));
+  return input_.Consume('}');
+}
+
+bool ChromeTraceReader::ReadArgs() {
+  if (!input_.Consume('{')) return false;
+  if (input_.Consume('}')) return true;
+  do {
+    if (!input_.ReadString(&key_) || !input_.Consume(':')) return false;
+    bool valid = key_ == "name" && input_.Peek() == '"'
+                     ? input_.ReadString(&event_.arg_name)
+                     : input_.SkipValue();
+    if (!valid) return false;
+  } while (input_.Consume(','));
+  return input_.Consume('}');
+}
+
+void ChromeTraceReader::OnEvent() {
+  if (event_.phase.size() != 1) return;
+  uint32_t tid = event_.tid;
+  uint64_t timestamp = NsFromMicros(event_.timestamp);
+  char phase = event_.phase[0];
+  if (phase == 'M') {
+    if (event_.name == "thread_name") {
+      visitor_->OnThreadName(tid, event_.arg_name);
+    }
+    return;
+  }
+  if (phase != 'B' && phase != 'E' && phase != 'X') return;
+
+  // Complete events that ended are closed by the next event of the thread.
+  std::vector<OpenScope>& scopes = open_scopes_[tid];
+  while (!scopes.empty() && scopes.back().end_ns != kNotEnded &&
+         scopes.back().end_ns <= timestamp) {
+    scopes.pop_back();
+  }
+
+  TraceScope scope;
+  scope.tid = tid;
+  if (phase == 'B') {
+    scopes.push_back({timestamp, kNotEnded, event_.name});
+  } else if (phase == 'E') {
+    if (scopes.empty() || scopes.back().end_ns != kNotEnded) return;
+    OpenScope begin = std::move(scopes.back());
+    scopes.pop_back();
+    scope.depth = static_cast<uint32_t>(scopes.size());
+    scope.start_ns = begin.start_ns;
+    scope.end_ns = timestamp;
+    scope.name = begin.name;
+    visitor_->OnScope(scope);
+  } else {
+    scope.depth = static_cast<uint32_t>(scopes.size());
+    scope.start_ns = timestamp;
+    scope.end_ns = timestamp + NsFromMicros(event_.duration);
+    scope.name = event_.name;
+    visitor_->OnScope(scope);
+    scopes.push_back({scope.start_ns, scope.end_ns, std::string()});
+  }
+}
+
+std::string Quote(std::string_view text) {
+  std::string quoted = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      quoted.push_back('\\');
+      quoted.push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      quoted += absl::StrFormat("\\u%04x", static_cast<int>(c));
+    } else {
+      quoted.push_back(c);
+    }
+  }
+  quoted.push_back('"');
+  return quoted;
+}
+
+// Exactly, as the microseconds of the format with three decimals.
+std::string MicrosText(uint64_t ns) {
+  return absl::StrFormat("%u.%03u", ns / 1000, ns % 1000);
+}
+}  // namespace
+
+bool ReadChromeTrace(std::istream* stream, TraceEventVisitor* visitor) {
+  ChromeTraceReader reader(stream, visitor);
+  return reader.Read();
+}
+
+ChromeTraceWriter::ChromeTraceWriter(std::ostream* stream) : stream_(stream) {
+  *stream_ << "{\"traceEvents\":[";
+}
+
+void ChromeTraceWriter::AddThreadName(uint32_t pid, uint32_t tid,
+                                      std::string_view name) {
+  AddEvent(absl::StrFormat(
+      "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%u,\"tid\":%u,"
+      "\"args\":{\"name\":%s}}",
+      pid, tid, Quote(name)));
+}
+
+void ChromeTraceWriter::AddScope(uint32_t pid, const TraceScope& scope) {
+  AddEvent(absl::StrFormat(
+      "{\"ph\":\"X\",\"name\":%s,\"pid\":%u,\"tid\":%u,\"ts\":%s,"
+      "\"dur\":%s}",
+      Quote(scope.name), pid, scope.tid, MicrosText(scope.start_ns),
+      MicrosText(scope.end_ns - scope.start_ns)));
+}
+
+void ChromeTraceWriter::AddContextSwitch(uint32_t /*pid*/,
+                                         const ContextSwitch& /*switch*/) {}
+
+bool ChromeTraceWriter::Close() {
+  *stream_ << "\n],\"displayTimeUnit\":\"ns\"}\n";
+  stream_->flush();
+  return stream_->good();
+}
+
+void ChromeTraceWriter::AddEvent(const std::string& event) {
+  *stream_ << (has_events_ ? ",\n" : "\n") << event;
+  has_events_ = true;
+}
@@ -0,0 +1,42 @@
+#ifndef ORBIT_CORE_CHROME_TRACE_H_
+#define ORBIT_CORE_CHROME_TRACE_H_
+
+#include <istream>
+#include <ostream>
+#include <string>
+
+#include "TraceEvents.h"
+
+// The JSON trace event format of chrome://tracing, also read by Perfetto:
+// https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+//
+// Reads the duration (B and E), complete (X) and thread_name metadata (M)
+// events of either an array of events or an object with "traceEvents", one
+// event at a time from a block of the file, so that memory is bounded by the
+// scopes open at once whatever the size of the trace. The scopes of a thread
+// must be in the order they start, as the format requires. Returns false if
+// the JSON is malformed, after visiting the events before the error. A
+// truncated array of events is valid, as in the format.
+bool ReadChromeTrace(std::istream* stream, TraceEventVisitor* visitor);
+
+// Writes scopes as complete events and thread names as metadata events. The
+// format has no context switches, which are left out.
+class ChromeTraceWriter : public TraceEventWriter {
+ public:
+  explicit ChromeTraceWriter(std::ostream* stream);
+
+  void AddThreadName(uint32_t pid, uint32_t tid,
+                     std::string_view name) override;
+  void AddScope(uint32_t pid, const TraceScope& scope) override;
+  void AddContextSwitch(uint32_t pid,
+                        const ContextSwitch& context_switch) override;
+  bool Close() override;
+
+ private:
+  void AddEvent(const std::string& event);
+
+  std::ostream* stream_;
+  bool has_events_ = false;
+};
+
+#endif  // ORBIT_CORE_CHROME_TRACE_H_
@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ChromeTrace.h"
+
+namespace {
+struct Scope {
+  uint32_t tid;
+  uint32_t depth;
+  uint64_t start_ns;
+  uint64_t end_ns;
+  std::string name;
+};
+
+class CollectingVisitor : public TraceEventVisitor {
+ public:
+  void OnThreadName(uint32_t tid, std::string_view name) override {
+    thread_names.emplace_back(tid, std::string(name));
+  }
+  void OnScope(const TraceScope& scope) override {
+    scopes.push_back({scope.tid, scope.depth, scope.start_ns, scope.end_ns,
+                      std::string(scope.name)});
+  }
+
+  std::vector<std::pair<uint32_t, std::string>> thread_names;
+  std::vector<Scope> scopes;
+};
+
+bool Read(const std::string& json, CollectingVisitor* visitor) {
+  std::istringstream stream(json);
+  return ReadChromeTrace(&stream, visitor);
+}
+}  // namespace
+
+TEST(ChromeTrace, ReadsDurationAndCompleteEvents) {
+  CollectingVisitor visitor;
+  ASSERT_TRUE(Read(R"({"traceEvents": [
+      {"ph": "B", "name": "Frame", "pid": 1, "tid": 7, "ts": 10},
+      {"ph": "X", "name": "Draw \"all\"", "tid": 7, "ts": 11.5, "dur": 2,
+       "args": {"n": [1, {"x": null}]}},
+      {"ph": "E", "tid": 7, "ts": 20},
+      {"ph": "M", "name": "thread_name", "tid": 7,
+       "args": {"name": "Renderé"}},
+      {"ph": "i", "name": "Ignored", "tid": 7, "ts": 30}
+    ], "displayTimeUnit": "ns"})",
+                   &visitor));
+
+  ASSERT_EQ(visitor.scopes.size(), 2);
+  EXPECT_EQ(visitor.scopes[0].name, "Draw \"all\"");
+  EXPECT_EQ(visitor.scopes[0].depth, 1);
+  EXPECT_EQ(visitor.scopes[0].start_ns, 11500);
+  EXPECT_EQ(visitor.scopes[0].end_ns, 13500);
+  EXPECT_EQ(visitor.scopes[1].name, "Frame");
+  EXPECT_EQ(visitor.scopes[1].depth, 0);
+  EXPECT_EQ(visitor.scopes[1].start_ns, 10000);
+  EXPECT_EQ(visitor.scopes[1].end_ns, 20000);
+
+  ASSERT_EQ(visitor.thread_names.size(), 1);
+  EXPECT_EQ(visitor.thread_names[0].first, 7);
+  EXPECT_EQ(visitor.thread_names[0].second, "Render\xC3\xA9");
+}
+
+TEST(ChromeTrace, ReadsTruncatedArray) {
+  CollectingVisitor visitor;
+  EXPECT_TRUE(Read(R"([{"ph": "X", "name": "A", "tid": 1, "ts": 1, "dur": 1},
+                       {"ph": "X", "name": "B", "tid": 1, "ts": 3, "dur": 1},
+                   )",
+                   &visitor));
+  EXPECT_EQ(visitor.scopes.size(), 2);
+}
+
+TEST(ChromeTrace, FailsOnMalformedJson) {
+  CollectingVisitor visitor;
+  EXPECT_FALSE(Read(R"([{"ph": "X", "name": "A", "tid": 1, "ts": 1, "dur": 1},
+                        {"ph": "X", "name": "B" "tid": 1}])",
+                    &visitor));
+  EXPECT_EQ(visitor.scopes.size(), 1);
+  EXPECT_FALSE(Read(R"({"traceEvents": 3})", &visitor));
+}
+
+TEST(ChromeTrace, RoundTrips) {
+  std::stringstream stream;
+  ChromeTraceWriter writer(&stream);
+  writer.AddThreadName(1, 7, "Main\t\"thread\"");
+  writer.AddScope(1, {7, 0, 1000, 9001, "Outer"});
+  writer.AddScope(1, {7, 0, 2000, 3000, "Inner"});
+  writer.AddContextSwitch(1, ContextSwitch(ContextSwitch::In));
+  ASSERT_TRUE(writer.Close());
+
+  CollectingVisitor visitor;
+  ASSERT_TRUE(ReadChromeTrace(&stream, &visitor));
+  ASSERT_EQ(visitor.thread_names.size(), 1);
+  EXPECT_EQ(visitor.thread_names[0].second, "Main\t\"thread\"");
+  ASSERT_EQ(visitor.scopes.size(), 2);
+  EXPECT_EQ(visitor.scopes[0].name, "Outer");
+  EXPECT_EQ(visitor.scopes[0].depth, 0);
+  EXPECT_EQ(visitor.scopes[0].start_ns, 1000);
+  EXPECT_EQ(visitor.scopes[0].end_ns, 9001);
+  EXPECT_EQ(visitor.scopes[1].name, "Inner");
+  EXPECT_EQ(visitor.scopes[1].depth, 1);
+  EXPECT_EQ(visitor.scopes[1].start_ns, 2000);
+  EXPECT_EQ(visitor.scopes[1].end_ns, 3000);
+}
@@ -0,0 +1,117 @@
+#include "ClockSync.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Serialization.h"
+
+namespace {
+// The round trips delayed by more than twice the shortest delay, plus this
+// for the jitter of the shortest ones, are not used for the estimate.
+constexpr uint64_t kDelaySlackNs = 10'000;
+}  // namespace
+
+uint64_t ClockCorrection::ToReference(uint64_t source_ns) const {
+  // Differences are taken modulo 2^64, so that they can be negative.
+  auto delta_ns = static_cast<int64_t>(source_ns - source_ns_);
+  if (rate_ == 1.0) {
+    return reference_ns_ + static_cast<uint64_t>(delta_ns);
+  }
+  return reference_ns_ + static_cast<uint64_t>(std::llround(delta_ns * rate_));
+}
+
+uint64_t ClockCorrection::ToSource(uint64_t reference_ns) const {
+  auto delta_ns = static_cast<int64_t>(reference_ns - reference_ns_);
+  if (rate_ == 1.0) {
+    return source_ns_ + static_cast<uint64_t>(delta_ns);
+  }
+  return source_ns_ + static_cast<uint64_t>(std::llround(delta_ns / rate_));
+}
+
+void ClockSync::AddRoundTrip(const ClockSyncProbe& probe,
+                             uint64_t client_receive_ns) {
+  if (client_receive_ns < probe.client_send_ns ||
+      probe.source_send_ns < probe.source_receive_ns) {
+    return;
+  }
+  uint64_t round_trip_ns = client_receive_ns - probe.client_send_ns;
+  uint64_t source_ns = probe.source_send_ns - probe.source_receive_ns;
+  if (source_ns > round_trip_ns) {
+    return;
+  }
+
+  RoundTrip round_trip;
+  round_trip.client_ns = probe.client_send_ns + round_trip_ns / 2;
+  round_trip.source_ns = probe.source_receive_ns + source_ns / 2;
+  round_trip.delay_ns = round_trip_ns - source_ns;
+  round_trips_.push_back(round_trip);
+  if (round_trips_.size() > kMaxRoundTrips) {
+    round_trips_.pop_front();
+  }
+}
+
+ClockCorrection ClockSync::GetCorrection() const {
+  if (round_trips_.empty()) {
+    return ClockCorrection{};
+  }
+
+  const RoundTrip& fastest = *std::min_element(
+      round_trips_.begin(), round_trips_.end(),
+      [](const RoundTrip& lhs, const RoundTrip& rhs) {
+        return lhs.delay_ns < rhs.delay_ns;
+      });
+  std::vector<RoundTrip> accurate;
+  for (const RoundTrip& round_trip : round_trips_) {
+    if (round_trip.delay_ns <= 2 * fastest.delay_ns + kDelaySlackNs) {
+      accurate.push_back(round_trip);
+    }
+  }
+
+  // Offset only, from the fastest round trip.
+  ClockCorrection offset_only{fastest.source_ns, fastest.client_ns, 1.0};
+  if (accurate.back().client_ns - accurate.front().client_ns <
+      kMinDriftSpanNs) {
+    return offset_only;
+  }
+
+  // Least squares fit of the client clock over the source clock, relative to
+  // the first accurate round trip to keep the precision of the doubles.
+  const RoundTrip& origin = accurate.front();
+  double mean_source = 0;
+  double mean_client = 0;
+  for (const RoundTrip& round_trip : accurate) {
+    mean_source +=
+        static_cast<int64_t>(round_trip.source_ns - origin.source_ns);
+    mean_client +=
+        static_cast<int64_t>(round_trip.client_ns - origin.client_ns);
+  }
+  mean_source /= accurate.size();
+  mean_client /= accurate.size();
+  double covariance = 0;
+  double variance = 0;
+  for (const RoundTrip& round_trip : accurate) {
+    double source =
+        static_cast<int64_t>(round_trip.source_ns - origin.source_ns) -
+        mean_source;
+    double client =
+        static_cast<int64_t>(round_trip.client_ns - origin.client_ns) -
+        mean_client;
+    covariance += source * client;
+    variance += source * source;
+  }
+  double rate = covariance / variance;
+  if (!(std::abs(rate - 1.0) <= kMaxDrift)) {
+    return offset_only;
+  }
+  return ClockCorrection{
+      origin.source_ns + static_cast<uint64_t>(std::llround(mean_source)),
+      origin.client_ns + static_cast<uint64_t>(std::llround(mean_client)),
+      rate};
+}
+
+ORBIT_SERIALIZE(ClockCorrection, 0) {
+  ORBIT_NVP_VAL(0, source_ns_);
+  ORBIT_NVP_VAL(0, reference_ns_);
+  ORBIT_NVP_VAL(0, rate_);
+}
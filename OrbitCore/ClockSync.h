@@ -0,0 +1,94 @@
+#ifndef ORBIT_CORE_CLOCK_SYNC_H_
+#define ORBIT_CORE_CLOCK_SYNC_H_
+
+#include <cstdint>
+#include <deque>
+
+#include "SerializationMacros.h"
+#include "absl/types/span.h"
+
+// The payload of Msg_ClockSync, one round trip between the UI and a service:
+// the UI sends it with client_send_ns, and the service sends it back with the
+// other two, all in the OrbitTicks of their machine.
+struct ClockSyncProbe {
+  uint64_t client_send_ns = 0;
+  uint64_t source_receive_ns = 0;
+  uint64_t source_send_ns = 0;
+};
+
+// Maps the timestamps of a source, e.g., the events of a service, to a
+// reference clock, e.g., the one of the UI, as the linear function
+// reference = reference_ns + (source - source_ns) * rate. The default one is
+// the identity.
+class ClockCorrection {
+ public:
+  ClockCorrection() = default;
+  ClockCorrection(uint64_t source_ns, uint64_t reference_ns, double rate)
+      : source_ns_(source_ns), reference_ns_(reference_ns), rate_(rate) {}
+
+  uint64_t ToReference(uint64_t source_ns) const;
+  uint64_t ToSource(uint64_t reference_ns) const;
+  // In bulk, e.g., on a batch of events as it is ingested: get_timestamp
+  // returns a reference to the timestamp of an event, which is corrected in
+  // place.
+  template <typename T, typename GetTimestamp>
+  void ToReference(absl::Span<T> events, GetTimestamp get_timestamp) const {
+    if (IsIdentity()) return;
+    for (T& event : events) {
+      uint64_t& timestamp = get_timestamp(event);
+      timestamp = ToReference(timestamp);
+    }
+  }
+
+  bool IsIdentity() const {
+    return source_ns_ == reference_ns_ && rate_ == 1.0;
+  }
+  uint64_t GetSourceNs() const { return source_ns_; }
+  uint64_t GetReferenceNs() const { return reference_ns_; }
+  double GetRate() const { return rate_; }
+
+  ORBIT_SERIALIZABLE;
+
+ private:
+  uint64_t source_ns_ = 0;
+  uint64_t reference_ns_ = 0;
+  double rate_ = 1.0;
+};
+
+// Estimates the ClockCorrection from a source to the clock of the UI from the
+// round trips of Msg_ClockSync, like NTP: each round trip bounds the offset
+// between the clocks by half its network delay, so only the round trips with
+// the shortest delays are kept to estimate it. Once they span
+// kMinDriftSpanNs, the drift of the clocks is estimated too, by a linear fit
+// of the offsets over time. Only the last kMaxRoundTrips are kept, for the
+// estimate to follow the drift.
+class ClockSync {
+ public:
+  static constexpr size_t kMaxRoundTrips = 64;
+  static constexpr uint64_t kMinDriftSpanNs = 1'000'000'000;
+  // Rates further from 1, i.e., drifts over 1000 ppm, are taken to be
+  // errors of the fit rather than drift.
+  static constexpr double kMaxDrift = 1e-3;
+  // Sent when connecting, before the one sent every couple of seconds.
+  static constexpr size_t kNumProbesOnConnect = 8;
+
+  // Ignores the round trips whose timestamps are not in order.
+  void AddRoundTrip(const ClockSyncProbe& probe, uint64_t client_receive_ns);
+  size_t GetNumRoundTrips() const { return round_trips_.size(); }
+
+  // The identity without any round trip.
+  ClockCorrection GetCorrection() const;
+
+ private:
+  struct RoundTrip {
+    // Midpoints of the round trip on each clock, i.e., the same instant
+    // within delay_ns / 2.
+    uint64_t client_ns;
+    uint64_t source_ns;
+    uint64_t delay_ns;
+  };
+
+  std::deque<RoundTrip> round_trips_;
+};
+
+#endif  // ORBIT_CORE_CLOCK_SYNC_H_
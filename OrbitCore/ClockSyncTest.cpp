@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "ClockSync.h"
+
+namespace {
+// A round trip at client time client_ns, to a source whose clock is
+// source(client) = client * rate + offset_ns, taking delay_ns each way.
+ClockSyncProbe MakeProbe(uint64_t client_ns, uint64_t delay_ns,
+                         int64_t offset_ns, double rate,
+                         uint64_t* client_receive_ns) {
+  auto to_source = [&](uint64_t ns) {
+    return static_cast<uint64_t>(ns * rate + offset_ns);
+  };
+  ClockSyncProbe probe;
+  probe.client_send_ns = client_ns;
+  probe.source_receive_ns = to_source(client_ns + delay_ns);
+  probe.source_send_ns = to_source(client_ns + delay_ns + 1000);
+  *client_receive_ns = client_ns + 2 * delay_ns + 1000;
+  return probe;
+}
+}  // namespace
+
+TEST(ClockCorrection, DefaultIsIdentity) {
+  ClockCorrection correction;
+  EXPECT_TRUE(correction.IsIdentity());
+  EXPECT_EQ(correction.ToReference(12345), 12345);
+  EXPECT_EQ(correction.ToSource(12345), 12345);
+}
+
+TEST(ClockCorrection, AppliesOffsetAndRateInBulk) {
+  ClockCorrection correction{1000, 5000, 2.0};
+  EXPECT_EQ(correction.ToReference(1500), 6000);
+  EXPECT_EQ(correction.ToReference(900), 4800);
+  EXPECT_EQ(correction.ToSource(6000), 1500);
+
+  struct Event {
+    uint64_t time;
+  };
+  std::vector<Event> events{{1000}, {1100}};
+  correction.ToReference(absl::MakeSpan(events),
+                         [](Event& event) -> uint64_t& { return event.time; });
+  EXPECT_EQ(events[0].time, 5000);
+  EXPECT_EQ(events[1].time, 5200);
+}
+
+TEST(ClockSync, EstimatesTheOffsetFromTheFastestRoundTrips) {
+  ClockSync clock_sync;
+  EXPECT_TRUE(clock_sync.GetCorrection().IsIdentity());
+
+  constexpr int64_t kOffsetNs = -400'000;
+  uint64_t client_receive_ns;
+  // Queued behind other messages one way, which skews its offset.
+  ClockSyncProbe slow = MakeProbe(1'000'000, 0, kOffsetNs, 1.0,
+                                  &client_receive_ns);
+  clock_sync.AddRoundTrip(slow, client_receive_ns + 5'000'000);
+  ClockSyncProbe fast = MakeProbe(2'000'000, 50'000, kOffsetNs, 1.0,
+                                  &client_receive_ns);
+  clock_sync.AddRoundTrip(fast, client_receive_ns);
+  // Not in order: ignored.
+  clock_sync.AddRoundTrip(fast, fast.client_send_ns - 1);
+  EXPECT_EQ(clock_sync.GetNumRoundTrips(), 2);
+
+  ClockCorrection correction = clock_sync.GetCorrection();
+  EXPECT_EQ(correction.GetRate(), 1.0);
+  EXPECT_EQ(correction.ToReference(3'000'000 + kOffsetNs), 3'000'000);
+}
+
+TEST(ClockSync, EstimatesTheDrift) {
+  ClockSync clock_sync;
+  constexpr double kRate = 1.0001;
+  constexpr int64_t kOffsetNs = 7'000'000'000;
+  for (uint64_t i = 0; i < 20; ++i) {
+    uint64_t client_receive_ns;
+    ClockSyncProbe probe = MakeProbe(i * 500'000'000, 40'000 + i % 3 * 1000,
+                                     kOffsetNs, kRate, &client_receive_ns);
+    clock_sync.AddRoundTrip(probe, client_receive_ns);
+  }
+
+  ClockCorrection correction = clock_sync.GetCorrection();
+  EXPECT_NEAR(correction.GetRate(), 1 / kRate, 1e-6);
+  uint64_t client_ns = 20'000'000'000;
+  uint64_t source_ns = static_cast<uint64_t>(client_ns * kRate + kOffsetNs);
+  EXPECT_NEAR(static_cast<double>(correction.ToReference(source_ns)),
+              static_cast<double>(client_ns), 5'000);
+}
@@ -0,0 +1,75 @@
+#include "CompactTimer.h"
+
+TimerTables::TimerTables() {
+  // The ids 0 of the function address 0 and the callstack hash 0.
+  function_addresses_.push_back(0);
+  function_ids_[0] = 0;
+  callstack_hashes_.push_back(0);
+  callstack_ids_[0] = 0;
+}
+
+CompactTimer TimerTables::Compact(const Timer& timer) {
+  CompactTimer compact;
+  compact.m_Start = timer.m_Start;
+  compact.m_TID = timer.m_TID;
+  compact.m_Depth = timer.m_Depth;
+  compact.m_SessionID = timer.m_SessionID;
+  compact.m_Type = timer.m_Type;
+  compact.m_Processor = timer.m_Processor;
+
+  auto function_id = function_ids_.find(timer.m_FunctionAddress);
+  if (function_id != function_ids_.end()) {
+    compact.m_FunctionId = function_id->second;
+  } else {
+    compact.m_FunctionId =
+        function_addresses_.push_back(timer.m_FunctionAddress);
+    absl::MutexLock lock(&function_ids_mutex_);
+    function_ids_[timer.m_FunctionAddress] = compact.m_FunctionId;
+  }
+
+  auto callstack_id = callstack_ids_.find(timer.m_CallstackHash);
+  if (callstack_id != callstack_ids_.end()) {
+    compact.m_CallstackId = callstack_id->second;
+  } else {
+    compact.m_CallstackId = callstack_hashes_.push_back(timer.m_CallstackHash);
+    callstack_ids_[timer.m_CallstackHash] = compact.m_CallstackId;
+  }
+
+  bool is_long = timer.m_End < timer.m_Start ||
+                 timer.m_End - timer.m_Start >= CompactTimer::kLongDuration;
+  compact.m_Duration =
+      is_long ? CompactTimer::kLongDuration
+              : static_cast<uint32_t>(timer.m_End - timer.m_Start);
+  if (is_long || timer.m_UserData[0] != 0 || timer.m_UserData[1] != 0) {
+    Extra extra{{timer.m_UserData[0], timer.m_UserData[1]}, timer.m_End};
+    compact.m_ExtraId = extras_.push_back(extra) + 1;
+  } else {
+    compact.m_ExtraId = 0;
+  }
+  return compact;
+}
+
+Timer TimerTables::Expand(const CompactTimer& compact) const {
+  Timer timer;
+  timer.m_TID = compact.m_TID;
+  timer.m_Depth = compact.m_Depth;
+  timer.m_SessionID = compact.m_SessionID;
+  timer.m_Type = compact.m_Type;
+  timer.m_Processor = compact.m_Processor;
+  timer.m_CallstackHash = GetCallstackHash(compact);
+  timer.m_FunctionAddress = GetFunctionAddress(compact);
+  timer.m_Start = compact.m_Start;
+  timer.m_End = GetEnd(compact);
+  if (compact.m_ExtraId != 0) {
+    const Extra& extra = extras_[compact.m_ExtraId - 1];
+    timer.m_UserData[0] = extra.user_data[0];
+    timer.m_UserData[1] = extra.user_data[1];
+  }
+  return timer;
+}
+
+uint32_t TimerTables::FindFunctionId(uint64_t address) const {
+  absl::MutexLock lock(&function_ids_mutex_);
+  auto it = function_ids_.find(address);
+  return it != function_ids_.end() ? it->second : 0;
+}
@@ -0,0 +1,164 @@
+#ifndef ORBIT_CORE_COMPACT_TIMER_H_
+#define ORBIT_CORE_COMPACT_TIMER_H_
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+
+#include "ScopeTimer.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
+// A Timer as the time graph stores it, in 32 bytes instead of 56. What
+// repeats across timers or is rarely set is kept out of line in the
+// TimerTables the timer was compacted with: the function address and the
+// callstack hash are replaced by ids, and the user data is only stored when
+// set. The duration takes 32 bits, and only a duration that doesn't fit, or
+// an end before the start, is stored out of line with the user data.
+//
+// The fields have the names of those of Timer they keep. Timers are only
+// converted to and from Timer where they enter and leave the time graph,
+// see TimerTables::Compact and TimerTables::Expand.
+struct CompactTimer {
+  static constexpr uint32_t kLongDuration = UINT32_MAX;
+
+  bool IsType(Timer::Type a_Type) const { return m_Type == a_Type; }
+  bool IsCoreActivity() const { return m_Type == Timer::CORE_ACTIVITY; }
+
+  TickType m_Start;
+  // m_End - m_Start, or kLongDuration if the end is in the extra.
+  uint32_t m_Duration;
+  uint32_t m_TID;
+  // Ids in the tables: the function id 0 is the address 0, and the callstack
+  // id 0 the hash 0.
+  uint32_t m_FunctionId;
+  uint32_t m_CallstackId;
+  // 1 + the index of the user data and long end of the timer, 0 if it has
+  // neither.
+  uint32_t m_ExtraId;
+  uint8_t m_Depth;
+  uint8_t m_SessionID;
+  Timer::Type m_Type;
+  uint8_t m_Processor;
+};
+static_assert(sizeof(CompactTimer) == 32, "CompactTimer is to stay compact");
+
+// An array only appended to, by one thread at a time, while other threads
+// read the items already appended. The items are in chunks that never move,
+// found from a fixed two level directory, so reading an item takes no lock.
+template <typename T>
+class AppendOnlyArray {
+ public:
+  AppendOnlyArray() = default;
+  AppendOnlyArray(const AppendOnlyArray&) = delete;
+  AppendOnlyArray& operator=(const AppendOnlyArray&) = delete;
+  ~AppendOnlyArray() { Clear(); }
+
+  uint32_t size() const { return size_.load(std::memory_order_acquire); }
+
+  // Appends item and returns its index.
+  uint32_t push_back(const T& item) {
+    uint32_t index = size_.load(std::memory_order_relaxed);
+    assert(index < UINT32_MAX);
+    std::atomic<Directory*>& directory =
+        directories_[index >> kDirectoryShift];
+    if (directory.load(std::memory_order_relaxed) == nullptr) {
+      directory.store(new Directory(), std::memory_order_release);
+    }
+    Directory& chunks = *directory.load(std::memory_order_relaxed);
+    std::atomic<Chunk*>& chunk =
+        chunks[(index >> kChunkBits) & (kDirectorySize - 1)];
+    if (chunk.load(std::memory_order_relaxed) == nullptr) {
+      chunk.store(new Chunk(), std::memory_order_release);
+    }
+    (*chunk.load(std::memory_order_relaxed))[index & (kChunkSize - 1)] = item;
+    size_.store(index + 1, std::memory_order_release);
+    return index;
+  }
+
+  // index must be below a size() read before.
+  const T& operator[](uint32_t index) const {
+    const Directory* directory =
+        directories_[index >> kDirectoryShift].load(std::memory_order_acquire);
+    const Chunk* chunk =
+        (*directory)[(index >> kChunkBits) & (kDirectorySize - 1)].load(
+            std::memory_order_acquire);
+    return (*chunk)[index & (kChunkSize - 1)];
+  }
+
+  // Not while the array is read.
+  void Clear() {
+    for (std::atomic<Directory*>& directory : directories_) {
+      Directory* chunks = directory.exchange(nullptr);
+      if (chunks == nullptr) continue;
+      for (std::atomic<Chunk*>& chunk : *chunks) {
+        delete chunk.load();
+      }
+      delete chunks;
+    }
+    size_ = 0;
+  }
+
+ private:
+  static constexpr uint32_t kChunkBits = 12;
+  static constexpr uint32_t kChunkSize = 1 << kChunkBits;
+  static constexpr uint32_t kDirectoryBits = 10;
+  static constexpr uint32_t kDirectorySize = 1 << kDirectoryBits;
+  static constexpr uint32_t kDirectoryShift = kChunkBits + kDirectoryBits;
+  using Chunk = std::array<T, kChunkSize>;
+  using Directory = std::array<std::atomic<Chunk*>, kDirectorySize>;
+
+  std::array<std::atomic<Directory*>, (1 << (32 - kDirectoryShift))>
+      directories_ = {};
+  std::atomic<uint32_t> size_ = 0;
+};
+
+// What the CompactTimers compacted with it keep out of line. Timers are
+// compacted by a single thread at a time, e.g. the one processing them, while
+// other threads expand the timers already compacted.
+class TimerTables {
+ public:
+  TimerTables();
+  TimerTables(const TimerTables&) = delete;
+  TimerTables& operator=(const TimerTables&) = delete;
+
+  CompactTimer Compact(const Timer& timer);
+  Timer Expand(const CompactTimer& compact) const;
+
+  TickType GetEnd(const CompactTimer& timer) const {
+    return timer.m_Duration != CompactTimer::kLongDuration
+               ? timer.m_Start + timer.m_Duration
+               : extras_[timer.m_ExtraId - 1].end;
+  }
+  uint64_t GetFunctionAddress(const CompactTimer& timer) const {
+    return GetFunctionAddress(timer.m_FunctionId);
+  }
+  uint64_t GetFunctionAddress(uint32_t function_id) const {
+    return function_addresses_[function_id];
+  }
+  uint64_t GetCallstackHash(const CompactTimer& timer) const {
+    return callstack_hashes_[timer.m_CallstackId];
+  }
+  // Id of the function at address, 0 if no timer of it was compacted.
+  uint32_t FindFunctionId(uint64_t address) const;
+
+ private:
+  struct Extra {
+    uint64_t user_data[2];
+    TickType end;
+  };
+
+  AppendOnlyArray<uint64_t> function_addresses_;
+  AppendOnlyArray<uint64_t> callstack_hashes_;
+  AppendOnlyArray<Extra> extras_;
+  // Only written by Compact, which reads them without the lock, as no other
+  // thread writes them.
+  mutable absl::Mutex function_ids_mutex_;
+  absl::flat_hash_map<uint64_t, uint32_t> function_ids_;
+  // Only used by Compact.
+  absl::flat_hash_map<uint64_t, uint32_t> callstack_ids_;
+};
+
+#endif  // ORBIT_CORE_COMPACT_TIMER_H_
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "CompactTimer.h"
+
+namespace {
+Timer MakeTimer(uint64_t start, uint64_t end, uint64_t function_address,
+                uint64_t callstack_hash = 0) {
+  Timer timer;
+  timer.m_TID = 42;
+  timer.m_Depth = 3;
+  timer.m_SessionID = 1;
+  timer.m_Type = Timer::ZONE;
+  timer.m_Processor = 7;
+  timer.m_Start = start;
+  timer.m_End = end;
+  timer.m_FunctionAddress = function_address;
+  timer.m_CallstackHash = callstack_hash;
+  return timer;
+}
+
+void ExpectEqual(const Timer& actual, const Timer& expected) {
+  EXPECT_EQ(actual.m_TID, expected.m_TID);
+  EXPECT_EQ(actual.m_Depth, expected.m_Depth);
+  EXPECT_EQ(actual.m_SessionID, expected.m_SessionID);
+  EXPECT_EQ(actual.m_Type, expected.m_Type);
+  EXPECT_EQ(actual.m_Processor, expected.m_Processor);
+  EXPECT_EQ(actual.m_CallstackHash, expected.m_CallstackHash);
+  EXPECT_EQ(actual.m_FunctionAddress, expected.m_FunctionAddress);
+  EXPECT_EQ(actual.m_UserData[0], expected.m_UserData[0]);
+  EXPECT_EQ(actual.m_UserData[1], expected.m_UserData[1]);
+  EXPECT_EQ(actual.m_Start, expected.m_Start);
+  EXPECT_EQ(actual.m_End, expected.m_End);
+}
+}  // namespace
+
+TEST(CompactTimer, ExpandsToTheTimerCompacted) {
+  TimerTables tables;
+  std::vector<Timer> timers;
+  timers.push_back(MakeTimer(1000, 1500, 0x7f0000001000, 0xabc));
+  timers.push_back(MakeTimer(2000, 2000, 0));
+  Timer with_user_data = MakeTimer(3000, 3100, 0x7f0000001000);
+  with_user_data.m_UserData[0] = 12;
+  with_user_data.m_UserData[1] = ~0ULL;
+  timers.push_back(with_user_data);
+  // Durations that don't fit in 32 bits, and an end before the start.
+  timers.push_back(MakeTimer(4000, 4000 + (1ULL << 32), 0x7f0000002000));
+  timers.push_back(MakeTimer(5000, 5000 + CompactTimer::kLongDuration, 0));
+  timers.push_back(MakeTimer(~0ULL, 0, 0));
+
+  std::vector<CompactTimer> compacts;
+  for (const Timer& timer : timers) {
+    compacts.push_back(tables.Compact(timer));
+  }
+  for (size_t i = 0; i < timers.size(); ++i) {
+    ExpectEqual(tables.Expand(compacts[i]), timers[i]);
+    EXPECT_EQ(tables.GetEnd(compacts[i]), timers[i].m_End);
+    EXPECT_EQ(tables.GetFunctionAddress(compacts[i]),
+              timers[i].m_FunctionAddress);
+    EXPECT_EQ(tables.GetCallstackHash(compacts[i]), timers[i].m_CallstackHash);
+  }
+}
+
+TEST(CompactTimer, StoresOnlyWhatIsUsedOutOfLine) {
+  TimerTables tables;
+  CompactTimer first = tables.Compact(MakeTimer(0, 10, 0x1000, 0xabc));
+  CompactTimer second = tables.Compact(MakeTimer(20, 30, 0x1000, 0xabc));
+  CompactTimer other = tables.Compact(MakeTimer(40, 50, 0x2000));
+  EXPECT_EQ(first.m_FunctionId, second.m_FunctionId);
+  EXPECT_EQ(first.m_CallstackId, second.m_CallstackId);
+  EXPECT_NE(first.m_FunctionId, other.m_FunctionId);
+  EXPECT_EQ(other.m_CallstackId, 0);
+  EXPECT_EQ(first.m_ExtraId, 0);
+  EXPECT_EQ(first.m_Duration, 10);
+
+  Timer long_timer = MakeTimer(0, 1ULL << 40, 0x1000);
+  CompactTimer compact = tables.Compact(long_timer);
+  EXPECT_EQ(compact.m_Duration, CompactTimer::kLongDuration);
+  EXPECT_NE(compact.m_ExtraId, 0);
+}
+
+TEST(CompactTimer, FindsTheIdsOfFunctions) {
+  TimerTables tables;
+  EXPECT_EQ(tables.FindFunctionId(0x1000), 0);
+  CompactTimer compact = tables.Compact(MakeTimer(0, 10, 0x1000));
+  EXPECT_EQ(tables.FindFunctionId(0x1000), compact.m_FunctionId);
+  EXPECT_NE(compact.m_FunctionId, 0);
+  EXPECT_EQ(tables.FindFunctionId(0), 0);
+}
+
+TEST(CompactTimer, KeepsManyValuesOutOfLine) {
+  TimerTables tables;
+  // More than a chunk of the arrays of the tables.
+  std::vector<CompactTimer> compacts;
+  for (uint64_t i = 0; i < 10000; ++i) {
+    Timer timer = MakeTimer(i, i + 1, 0x1000 + i, i);
+    timer.m_UserData[0] = i;
+    compacts.push_back(tables.Compact(timer));
+  }
+  for (uint64_t i = 0; i < compacts.size(); ++i) {
+    Timer timer = tables.Expand(compacts[i]);
+    EXPECT_EQ(timer.m_FunctionAddress, 0x1000 + i);
+    EXPECT_EQ(timer.m_CallstackHash, i);
+    EXPECT_EQ(timer.m_UserData[0], i);
+  }
+}
+
+TEST(AppendOnlyArray, KeepsItemsInPlace) {
+  AppendOnlyArray<uint64_t> array;
+  EXPECT_EQ(array.push_back(5), 0);
+  const uint64_t* first = &array[0];
+  for (uint64_t i = 1; i < 5000; ++i) {
+    EXPECT_EQ(array.push_back(i * 2), i);
+  }
+  EXPECT_EQ(array.size(), 5000);
+  EXPECT_EQ(first, &array[0]);
+  EXPECT_EQ(array[4999], 9998);
+  array.Clear();
+  EXPECT_EQ(array.size(), 0);
+}
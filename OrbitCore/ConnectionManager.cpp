@@ -5,35 +5,94 @@
 #include "ConnectionManager.h"
 
 #include "Capture.h"
+#include "CaptureFile.h"
+#include "CaptureFilter.h"
 #include "ContextSwitch.h"
+#include "ContinuousProfile.h"
+#include "CoreActivity.h"
 #include "CoreApp.h"
 #include "EventBuffer.h"
+#include "FlatCallstacks.h"
 #include "Introspection.h"
 #include "KeyAndString.h"
 #include "LinuxCallstackEvent.h"
 #include "LinuxSymbol.h"
+#include "MemoryAccounting.h"
+#include "OrbitBase/Logging.h"
 #include "OrbitBase/Tracing.h"
 #include "OrbitFunction.h"
 #include "OrbitModule.h"
+#include "ParallelFor.h"
 #include "Params.h"
 #include "ProcessUtils.h"
+#include "Profiling.h"
 #include "SamplingProfiler.h"
 #include "Serialization.h"
 #include "TcpClient.h"
 #include "TcpServer.h"
 #include "TestRemoteMessages.h"
+#include "ThreadStateTimeline.h"
+#include "TimerBatch.h"
 #include "TimerManager.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 
 #if __linux__
+#include "EventTracer.h"
+#include "LinuxTracingHandler.h"
 #include "LinuxUtils.h"
-#include "OrbitLinuxTracing/OrbitTracing.h"
 #endif
 
+#include <algorithm>
+#include <csignal>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <streambuf>
 
+namespace {
+// Streams of the messages decoded on the TcpClient workers. Hashed callstacks
+// refer to callstacks received before them: both share a stream.
+enum MessageStream : uint32_t {
+  kTimersStream,
+  kCallstacksStream,
+  kContextSwitchesStream,
+  kThreadStateChangesStream,
+};
+
+// On the target, where recorded captures are written.
+constexpr const char* kCaptureRecordingDirectory = "/var/tmp";
+
+// The continuous profiling thread only wakes up about once a second: the
+// samples are few, and counted by the session until then.
+constexpr uint64_t kContinuousProfilingMaxDelayMs = 1000;
+
+// Set by SIGUSR2, to dump the flight recorder of the service.
+std::atomic<bool> flight_recorder_signaled = false;
+
+void OnFlightRecorderSignal(int /*signal*/) { flight_recorder_signaled = true; }
+
+struct TimeRange {
+  uint64_t begin = std::numeric_limits<uint64_t>::max();
+  uint64_t end = 0;
+};
+
+template <typename T, typename GetTime>
+TimeRange GetTimeRange(const std::vector<T>& events, GetTime get_time) {
+  TimeRange time_range;
+  for (const T& event : events) {
+    uint64_t time = get_time(event);
+    time_range.begin = std::min(time_range.begin, time);
+    time_range.end = std::max(time_range.end, time);
+  }
+  return time_range;
+}
+}  // namespace
+
 ConnectionManager::ConnectionManager()
     : exit_requested_(false),
       is_service_(false),
@@ -42,6 +101,7 @@ ConnectionManager::ConnectionManager()
 ConnectionManager::~ConnectionManager() {
   StopThread();
   StopCaptureAsRemote();
+  StopContinuousProfilingAsRemote();
 }
 
 void ConnectionManager::StopThread() {
@@ -57,23 +117,58 @@ ConnectionManager& ConnectionManager::Get() {
   return instance;
 }
 
-void ConnectionManager::ConnectToRemote(std::string remote_address) {
+void ConnectionManager::ConnectToRemote(std::string remote_address,
+                                        bool watch_only) {
   remote_address_ = remote_address;
+  watch_only_ = watch_only;
   StopThread();
   SetupClientCallbacks();
   thread_ = std::make_unique<std::thread>(
       &ConnectionManager::ConnectionThreadWorker, this);
 }
 
+void ConnectionManager::AddRemoteHost(std::string address, uint32_t pid) {
+  auto host_index = static_cast<uint32_t>(hosts_.size() + 1);
+  if (host_index > kMaxHostIndex) {
+    ERROR("Too many hosts, not connecting to %s", address.c_str());
+    return;
+  }
+  hosts_.push_back(
+      std::make_unique<HostConnection>(host_index, std::move(address), pid));
+}
+
+void ConnectionManager::StartCaptureOnHosts() {
+  for (std::unique_ptr<HostConnection>& host : hosts_) {
+    host->StartCapture();
+  }
+}
+
+void ConnectionManager::StopCaptureOnHosts() {
+  for (std::unique_ptr<HostConnection>& host : hosts_) {
+    host->StopCapture();
+  }
+}
+
+std::string ConnectionManager::GetHostLabel(uint32_t host_index) const {
+  if (host_index == 0 || host_index > hosts_.size()) {
+    return "";
+  }
+  return hosts_[host_index - 1]->GetAddress();
+}
+
 void ConnectionManager::InitAsService() {
 #if __linux__
   GParams.m_TrackContextSwitches = true;
+  GParams.m_TrackThreadStates = true;
+#endif
+
+#if __linux__
+  signal(SIGUSR2, &OnFlightRecorderSignal);
 #endif
 
   is_service_ = true;
   string_manager_ = std::make_shared<StringManager>();
   tracing_session_.SetStringManager(string_manager_);
-  SetupIntrospection();
   SetupServerCallbacks();
   thread_ = std::make_unique<std::thread>(
       &ConnectionManager::RemoteThreadWorker, this);
@@ -116,43 +211,332 @@ void ConnectionManager::SetSelectedFunctionsOnRemote(const Message& a_Msg) {
 }
 
 void ConnectionManager::ServerCaptureThreadWorker() {
+#if __linux__
+  // Like the threads of the Tracer, not to compete with the target.
+  LinuxTracing::Tracer::PlaceCurrentThread(
+      LinuxTracingHandler::GetThreadPlacement());
+#endif
+  stats_window_begin_ns_ = OrbitTicks();
+  sent_bytes_ = 0;
+  sending_ns_ = 0;
   while (Capture::IsCapturing()) {
-    OrbitSleepMs(20);
+    tracing_session_.WaitForFlush();
+    SendRecordedEvents();
+    SendFlightRecorderWindowIfRequested();
+    RecordSenderStatsIfWindowElapsed();
+  }
+  // Events recorded since the last flush.
+  SendRecordedEvents();
+  SendFlightRecorderWindowIfRequested();
 
-    std::vector<Timer> timers;
-    if (tracing_session_.ReadAllTimers(&timers)) {
-      Message Msg(Msg_RemoteTimers);
-      GTcpServer->Send(Msg, timers);
-    }
+  LinuxTracingSession::LaneStats lane_stats = tracing_session_.GetLaneStats();
+  if (lane_stats.num_waits > 0) {
+    PRINT("Recording threads waited for the sender %lu times, %lu events "
+          "dropped\n",
+          lane_stats.num_waits, lane_stats.num_dropped);
+  }
+  LOG("Memory at the end of the capture:\n%s",
+      MemoryAccounting::GetReport().c_str());
+}
+
+void ConnectionManager::SendCaptureData(MessageType type, std::string&& data,
+                                        uint64_t begin_time,
+                                        uint64_t end_time) {
+  sent_bytes_ += data.size();
+  if (flight_recorder_ != nullptr) {
+    flight_recorder_->AddMessage(type, data.data(), data.size(), begin_time,
+                                 end_time);
+  } else if (capture_writer_ == nullptr) {
+    GTcpServer->SendBytes(type, std::move(data));
+  } else if (!capture_writer_->AddMessage(type, data.data(), data.size(),
+                                          begin_time, end_time)) {
+    ERROR("Could not record the capture, streaming the rest of it");
+    capture_writer_ = nullptr;
+  }
+}
+
+template <typename T>
+void ConnectionManager::SendCaptureData(MessageType type,
+                                        std::vector<T>&& events,
+                                        uint64_t begin_time,
+                                        uint64_t end_time) {
+  sent_bytes_ += events.size() * sizeof(T);
+  if (flight_recorder_ != nullptr) {
+    flight_recorder_->AddMessage(type, events.data(), events.size() * sizeof(T),
+                                 begin_time, end_time);
+  } else if (capture_writer_ == nullptr) {
+    Message msg(type);
+    GTcpServer->Send(msg, std::move(events));
+  } else if (!capture_writer_->AddMessage(type, events.data(),
+                                          events.size() * sizeof(T),
+                                          begin_time, end_time)) {
+    ERROR("Could not record the capture, streaming the rest of it");
+    capture_writer_ = nullptr;
+  }
+}
+
+void ConnectionManager::RecordSenderStatsIfWindowElapsed() {
+  constexpr uint64_t kStatsWindowNs = 1'000'000'000;
+  uint64_t now_ns = OrbitTicks();
+  uint64_t window_ns = now_ns - stats_window_begin_ns_;
+  if (window_ns < kStatsWindowNs) return;
 
-    std::vector<LinuxCallstackEvent> callstacks;
-    if (tracing_session_.ReadAllCallstacks(&callstacks)) {
-      std::string message_data = SerializeObjectBinary(callstacks);
-      GTcpServer->Send(Msg_SamplingCallstacks, message_data.c_str(),
-                       message_data.size());
+  LinuxTracingSession::LaneStats lane_stats = tracing_session_.GetLaneStats();
+  auto record = [&](const std::string& name, double value) {
+    tracing_session_.RecordServiceStat(name, value, stats_window_begin_ns_,
+                                       now_ns);
+  };
+  record("sender MB/s", 1e3 * sent_bytes_ / window_ns);
+  record("sender busy %", 100.0 * sending_ns_ / window_ns);
+  record("session lanes", lane_stats.num_lanes);
+  record("session buffered events", lane_stats.num_unflushed);
+  record("session dropped events", lane_stats.num_dropped);
+  if (capture_writer_ != nullptr) {
+    // Buffers being written, and waits for one to be written: the disk not
+    // keeping up.
+    record("recording queue depth", capture_writer_->GetQueueDepth());
+    record("recording buffer waits", capture_writer_->GetNumBufferWaits());
+  }
+  // Of the structures of the service, to find which one grows.
+  for (size_t i = 0; i < MemoryAccounting::kNumSubsystems; ++i) {
+    auto subsystem = static_cast<MemorySubsystem>(i);
+    const char* name = MemoryAccounting::GetName(subsystem);
+    record(absl::StrFormat("memory %s MB", name),
+           MemoryAccounting::GetBytes(subsystem) / (1024.0 * 1024.0));
+  }
+
+  stats_window_begin_ns_ = now_ns;
+  sent_bytes_ = 0;
+  sending_ns_ = 0;
+}
+
+void ConnectionManager::SendRecordedEvents() {
+  uint64_t begin_ns = OrbitTicks();
+
+  // Sent before the events using them, and streamed even when the capture is
+  // recorded: the client keeps them for all the captures that follow. The
+  // symbols of the kernel frames are read first and sent after the strings,
+  // which then include their names, like the names of the threads.
+  std::vector<KernelFrameSymbol> kernel_frame_symbols;
+  bool has_kernel_frame_symbols =
+      tracing_session_.ReadAllKernelFrameSymbols(&kernel_frame_symbols);
+  std::vector<ThreadNameKey> thread_names;
+  bool has_thread_names = tracing_session_.ReadAllThreadNames(&thread_names);
+  std::vector<KeyAndString> keys_and_strings;
+  if (tracing_session_.ReadAllKeysAndStrings(&keys_and_strings)) {
+    std::string data = EncodeKeysAndStrings(keys_and_strings);
+    sent_bytes_ += data.size();
+    GTcpServer->SendBytes(Msg_KeysAndStrings, std::move(data));
+  }
+  if (has_kernel_frame_symbols) {
+    sent_bytes_ += kernel_frame_symbols.size() * sizeof(KernelFrameSymbol);
+    GTcpServer->Send(Msg_KernelFrameSymbols, std::move(kernel_frame_symbols));
+  }
+  if (has_thread_names) {
+    sent_bytes_ += thread_names.size() * sizeof(ThreadNameKey);
+    GTcpServer->Send(Msg_ThreadNames, std::move(thread_names));
+  }
+
+  std::vector<Timer> timers;
+  if (tracing_session_.ReadAllTimers(&timers)) {
+    if (capture_triggers_ != nullptr) {
+      EvaluateCaptureTriggers(timers);
     }
+    TimeRange time_range =
+        GetTimeRange(timers, [](const Timer& timer) { return timer.m_Start; });
+    SendCaptureData(Msg_RemoteTimers, EncodeTimerBatch(timers),
+                    time_range.begin, time_range.end);
+  }
+
+  // Hashed callstacks only refer to callstacks recorded before them, so read
+  // them first and send them last: the client then always receives the
+  // frames of a callstack before its first hashed sample.
+  std::vector<CallstackEvent> hashed_callstacks;
+  bool has_hashed_callstacks =
+      tracing_session_.ReadAllHashedCallstacks(&hashed_callstacks);
+
+  std::vector<LinuxCallstackEvent> callstacks;
+  if (tracing_session_.ReadAllCallstacks(&callstacks)) {
+    TimeRange time_range =
+        GetTimeRange(callstacks, [](const LinuxCallstackEvent& event) {
+          return event.m_time;
+        });
+    SendCaptureData(Msg_SamplingCallstacks, EncodeFlatCallstacks(callstacks),
+                    time_range.begin, time_range.end);
+  }
+
+  if (has_hashed_callstacks) {
+    TimeRange time_range =
+        GetTimeRange(hashed_callstacks, [](const CallstackEvent& event) {
+          return static_cast<uint64_t>(event.m_Time);
+        });
+    SendCaptureData(Msg_SamplingHashedCallstacks,
+                    EncodeFlatHashedCallstacks(hashed_callstacks),
+                    time_range.begin, time_range.end);
+  }
+
+  std::vector<SampleCount> sample_histogram;
+  if (tracing_session_.ReadSampleHistogram(&sample_histogram)) {
+    TimeRange time_range =
+        GetTimeRange(sample_histogram, [](const SampleCount& sample_count) {
+          return sample_count.time;
+        });
+    SendCaptureData(Msg_SampleHistogram, std::move(sample_histogram),
+                    time_range.begin, time_range.end);
+  }
+
+  // Counted by the tracer over the last half second or so.
+  std::vector<BranchCount> branch_counts;
+  if (tracing_session_.ReadBranchCounts(&branch_counts)) {
+    SendCaptureData(Msg_BranchCounts, std::move(branch_counts), begin_ns,
+                    begin_ns);
+  }
+
+  std::vector<OffCpuCallstackEvent> off_cpu_callstacks;
+  if (tracing_session_.ReadAllOffCpuCallstacks(&off_cpu_callstacks)) {
+    TimeRange time_range = GetTimeRange(
+        off_cpu_callstacks,
+        [](const OffCpuCallstackEvent& event) { return event.m_Event.m_time; });
+    SendCaptureData(Msg_OffCpuCallstacks,
+                    EncodeFlatOffCpuCallstacks(off_cpu_callstacks),
+                    time_range.begin, time_range.end);
+  }
+
+  std::vector<CoreActivity> core_activities;
+  if (tracing_session_.ReadAllCoreActivities(&core_activities)) {
+    TimeRange time_range =
+        GetTimeRange(core_activities, [](const CoreActivity& core_activity) {
+          return core_activity.begin_time;
+        });
+    SendCaptureData(Msg_RemoteCoreActivities,
+                    EncodeCoreActivities(core_activities), time_range.begin,
+                    time_range.end);
+  }
+
+  std::vector<ThreadStateChange> thread_state_changes;
+  if (tracing_session_.ReadAllThreadStateChanges(&thread_state_changes)) {
+    TimeRange time_range = GetTimeRange(
+        thread_state_changes,
+        [](const ThreadStateChange& change) { return change.time; });
+    SendCaptureData(Msg_RemoteThreadStateChanges,
+                    std::move(thread_state_changes), time_range.begin,
+                    time_range.end);
+  }
+
+  sending_ns_ += OrbitTicks() - begin_ns;
+}
 
-    std::vector<CallstackEvent> hashed_callstacks;
-    if (tracing_session_.ReadAllHashedCallstacks(&hashed_callstacks)) {
-      std::string message_data = SerializeObjectBinary(hashed_callstacks);
-      GTcpServer->Send(Msg_SamplingHashedCallstacks, message_data.c_str(),
-                       message_data.size());
+void ConnectionManager::StartCaptureRecording(uint32_t pid) {
+  recorded_capture_path_ = absl::StrFormat(
+      "%s/orbit-capture-%u-%s.orbitcapture", kCaptureRecordingDirectory, pid,
+      absl::FormatTime("%Y%m%d-%H%M%S", absl::Now(), absl::LocalTimeZone()));
+  AsyncFileWriter::Options file_options;
+  file_options.direct_io = GParams.m_RecordCaptureDirectIo;
+  capture_writer_ = std::make_unique<CaptureFileWriter>(
+      CaptureFileWriter::kDefaultChunkSize, file_options);
+  if (!capture_writer_->Open(recorded_capture_path_)) {
+    capture_writer_ = nullptr;
+    recorded_capture_path_.clear();
+    return;
+  }
+  PRINT("Recording the capture to %s\n", recorded_capture_path_.c_str());
+}
+
+void ConnectionManager::SendRecordedCaptureInfo() {
+  sent_recorded_chunks_.clear();
+  if (!recorded_capture_reader_.Open(recorded_capture_path_)) {
+    return;
+  }
+
+  // From the file rather than the writer: recording may have failed midway.
+  const std::vector<CaptureFileReader::Chunk>& chunks =
+      recorded_capture_reader_.GetChunks();
+  sent_recorded_chunks_.assign(chunks.size(), false);
+  CaptureRecordingInfo info;
+  info.num_chunks = chunks.size();
+  info.num_bytes = 0;
+  info.begin_time = std::numeric_limits<uint64_t>::max();
+  info.end_time = 0;
+  for (const CaptureFileReader::Chunk& chunk : chunks) {
+    info.num_bytes += chunk.header.size;
+    info.begin_time = std::min(info.begin_time, chunk.header.begin_time);
+    info.end_time = std::max(info.end_time, chunk.header.end_time);
+  }
+  GTcpServer->Send(Msg_CaptureRecordingInfo, info);
+}
+
+void ConnectionManager::SendRecordedChunks(
+    const CaptureChunksRequest& request) {
+  for (size_t index : recorded_capture_reader_.FindChunks(request.begin_time,
+                                                          request.end_time)) {
+    if (sent_recorded_chunks_[index]) {
+      continue;
+    }
+    sent_recorded_chunks_[index] = true;
+    if (!recorded_capture_reader_.ForEachMessage(
+            index, [](MessageType type, const char* data, uint32_t size) {
+              GTcpServer->Send(type, data, size);
+            })) {
+      ERROR("Could not read chunk %lu of %s", index,
+            recorded_capture_path_.c_str());
     }
+  }
+}
+
+void ConnectionManager::RequestFlightRecorderDump() {
+  GTcpClient->Send(Msg_FlightRecorderDump);
+}
+
+void ConnectionManager::RequestIntelPtWindow(uint64_t function_address,
+                                             uint64_t duration_ns) {
+  Message msg(Msg_IntelPtRequest);
+  msg.m_Header.m_GenericHeader.m_Address = function_address;
+  GTcpClient->Send(msg, &duration_ns, sizeof(duration_ns));
+}
 
-    std::vector<ContextSwitch> context_switches;
-    if (tracing_session_.ReadAllContextSwitches(&context_switches)) {
-      Message Msg(Msg_RemoteContextSwitches);
-      GTcpServer->Send(Msg, context_switches);
+void ConnectionManager::DumpFlightRecorder() {
+  flight_recorder_dump_requested_ = true;
+  tracing_session_.WakeUpReader();
+}
+
+void ConnectionManager::EvaluateCaptureTriggers(
+    const std::vector<Timer>& timers) {
+  std::string reason;
+  for (const Timer& timer : timers) {
+    if (capture_triggers_->OnTimer(timer, &reason)) {
+      PRINT("Capture trigger fired: %s\n", reason.c_str());
+      // Sent once these timers are recorded.
+      flight_recorder_dump_requested_ = true;
     }
   }
 }
 
-void ConnectionManager::SetupIntrospection() {
+void ConnectionManager::SendFlightRecorderWindowIfRequested() {
+  bool signaled = flight_recorder_signaled.exchange(false);
+  bool requested = flight_recorder_dump_requested_.exchange(false);
+  if (flight_recorder_ == nullptr || (!signaled && !requested)) {
+    return;
+  }
+  PRINT("Sending the flight recorder window of %lu bytes from %lu\n",
+        flight_recorder_->GetNumBytes(), flight_recorder_->GetBeginTime());
+  flight_recorder_->Dump(
+      [this](MessageType type, const char* data, uint32_t size) {
+        GTcpServer->Send(type, data, size);
+      });
+}
+
+void ConnectionManager::StartIntrospection() {
+#if __linux__ && ORBIT_TRACING_ENABLED
+  // The scopes of the service are recorded while it captures only, they cost
+  // a test of a flag otherwise.
+  orbit::tracing::SetListener(
+      std::make_unique<orbit::introspection::Listener>(&tracing_session_));
+#endif  // ORBIT_TRACING_ENABLED
+}
+
+void ConnectionManager::StopIntrospection() {
 #if __linux__ && ORBIT_TRACING_ENABLED
-  // Setup introspection handler.
-  auto handler =
-      std::make_unique<orbit::introspection::Handler>(&tracing_session_);
-  LinuxTracing::SetOrbitTracingHandler(std::move(handler));
+  orbit::tracing::SetListener(nullptr);
 #endif  // ORBIT_TRACING_ENABLED
 }
 
@@ -165,7 +549,24 @@ void ConnectionManager::StartCaptureAsRemote(uint32_t pid) {
   }
   Capture::SetTargetProcess(process);
   tracing_session_.Reset();
+  if (flight_recorder_settings_.has_value()) {
+    flight_recorder_ = std::make_unique<FlightRecorder>(
+        flight_recorder_settings_->window_ns,
+        flight_recorder_settings_->max_bytes);
+    if (!next_capture_triggers_.empty()) {
+      // A snapshot per window at most.
+      capture_triggers_ = std::make_unique<CaptureTriggers>(
+          next_capture_triggers_, flight_recorder_settings_->window_ns);
+    }
+    flight_recorder_settings_.reset();
+    flight_recorder_dump_requested_ = false;
+  } else if (record_next_capture_) {
+    StartCaptureRecording(pid);
+  }
+  record_next_capture_ = false;
+  next_capture_triggers_.clear();
   Capture::StartCapture(&tracing_session_);
+  StartIntrospection();
   server_capture_thread_ = std::make_unique<std::thread>(
       &ConnectionManager::ServerCaptureThreadWorker, this);
 }
@@ -176,13 +577,200 @@ void ConnectionManager::StopCaptureAsRemote() {
   // when it is false. StopCapture should be called before joining
   // the thread.
   Capture::StopCapture();
+  StopIntrospection();
+  tracing_session_.WakeUpReader();
   server_capture_thread_->join();
   server_capture_thread_ = nullptr;
+  flight_recorder_ = nullptr;
+  capture_triggers_ = nullptr;
+
+  if (capture_writer_ != nullptr) {
+    capture_writer_->Close();
+    capture_writer_ = nullptr;
+  }
+  if (!recorded_capture_path_.empty()) {
+    SendRecordedCaptureInfo();
+  }
+}
+
+void ConnectionManager::PullRecordedCapture(uint64_t begin_time,
+                                            uint64_t end_time) {
+  CaptureChunksRequest request{begin_time, end_time};
+  GTcpClient->Send(Msg_CaptureChunksRequest, request);
+}
+
+void ConnectionManager::StartContinuousProfilingAsRemote(
+    uint32_t pid, const ContinuousProfilingSettings& settings) {
+#if __linux__
+  StopContinuousProfilingAsRemote();
+  continuous_process_ = process_list_.GetProcess(pid);
+  if (!continuous_process_) {
+    PRINT("Process not found (pid=%d)\n", pid);
+    return;
+  }
+
+  continuous_profile_ = std::make_unique<ContinuousProfile>(
+      settings.window_duration_ns, settings.max_memory_bytes, OrbitTicks());
+  continuous_session_ = std::make_unique<LinuxTracingSession>(nullptr);
+  CaptureFilter filter;
+  filter.samples_as_histograms = true;
+  continuous_session_->SetCaptureFilter(filter);
+  LinuxTracingSession::FlushPolicy flush_policy;
+  flush_policy.max_delay_ms = kContinuousProfilingMaxDelayMs;
+  continuous_session_->SetFlushPolicy(flush_policy);
+
+  // Neither the selected functions nor the sampling policies of the captures
+  // apply: nothing is instrumented.
+  continuous_handler_ = std::make_unique<LinuxTracingHandler>(
+      continuous_session_.get(), continuous_process_.get(),
+      &continuous_selected_functions_, std::vector<FunctionSamplingPolicy>{},
+      &continuous_num_context_switches_);
+  continuous_handler_->SetSamplingOnly(settings.sampling_frequency);
+  continuous_handler_->Start();
+
+  continuous_profiling_ = true;
+  continuous_thread_ = std::make_unique<std::thread>(
+      &ConnectionManager::ContinuousProfilingThreadWorker, this);
+  PRINT("Continuous profiling of pid %u at %.1f Hz\n", pid,
+        settings.sampling_frequency);
+#endif
+}
+
+void ConnectionManager::StopContinuousProfilingAsRemote() {
+#if __linux__
+  if (continuous_thread_ == nullptr) {
+    return;
+  }
+  continuous_handler_->Stop();
+  continuous_profiling_ = false;
+  continuous_session_->WakeUpReader();
+  continuous_thread_->join();
+  continuous_thread_ = nullptr;
+  continuous_handler_ = nullptr;
+  continuous_session_ = nullptr;
+  continuous_process_ = nullptr;
+
+  ContinuousProfile::Stats stats = continuous_profile_->GetStats();
+  PRINT("Continuous profiling stopped: %lu windows (%s) kept, %lu evicted, "
+        "%lu callstacks, %lu samples dropped\n",
+        stats.num_windows, GetPrettySize(stats.num_bytes).c_str(),
+        stats.num_evicted_windows, stats.num_callstacks,
+        stats.num_dropped_samples);
+#endif
+}
+
+void ConnectionManager::ContinuousProfilingThreadWorker() {
+  while (continuous_profiling_) {
+    continuous_session_->WaitForFlush();
+    AddToContinuousProfile();
+  }
+  // Samples recorded since the last flush.
+  AddToContinuousProfile();
+}
+
+void ConnectionManager::AddToContinuousProfile() {
+  // As in SendRecordedEvents, counts only refer to callstacks recorded before
+  // them: read them first, add them last.
+  std::vector<SampleCount> sample_histogram;
+  continuous_session_->ReadSampleHistogram(&sample_histogram);
+  std::vector<CallstackEvent> hashed_callstacks;
+  continuous_session_->ReadAllHashedCallstacks(&hashed_callstacks);
+
+  std::vector<LinuxCallstackEvent> callstacks;
+  continuous_session_->ReadAllCallstacks(&callstacks);
+  for (LinuxCallstackEvent& event : callstacks) {
+    CallstackID id = event.m_CS.Hash();
+    continuous_profile_->AddCallstack(id, std::move(event.m_CS.m_Data));
+    continuous_profile_->AddSamples(event.m_time, event.m_CS.m_ThreadId, id,
+                                    1);
+  }
+  for (const CallstackEvent& event : hashed_callstacks) {
+    continuous_profile_->AddSamples(event.m_Time, event.m_TID, event.m_Id, 1);
+  }
+  for (const SampleCount& sample_count : sample_histogram) {
+    continuous_profile_->AddSamples(sample_count.time, sample_count.thread_id,
+                                    sample_count.callstack_id,
+                                    sample_count.count);
+  }
+
+  // Nothing else is traced but the stats of the tracer, which are dropped.
+  std::vector<Timer> timers;
+  continuous_session_->ReadAllTimers(&timers);
+  std::vector<KeyAndString> keys_and_strings;
+  continuous_session_->ReadAllKeysAndStrings(&keys_and_strings);
+
+  continuous_profile_->Update(OrbitTicks());
+}
+
+void ConnectionManager::StartContinuousProfiling(
+    uint32_t pid, const ContinuousProfilingSettings& settings) {
+  Message msg(Msg_StartContinuousProfiling);
+  msg.m_Header.m_GenericHeader.m_Address = pid;
+  GTcpClient->Send(msg, &settings, sizeof(settings));
+}
+
+void ConnectionManager::StopContinuousProfiling() {
+  GTcpClient->Send(Msg_StopContinuousProfiling);
+}
+
+void ConnectionManager::RequestContinuousWindows() {
+  GTcpClient->Send(Msg_ContinuousWindowsRequest);
+}
+
+void ConnectionManager::PullContinuousWindow(uint64_t begin_time) {
+  Message msg(Msg_ContinuousWindowRequest);
+  msg.m_Header.m_GenericHeader.m_Address = begin_time;
+  GTcpClient->Send(msg);
+}
+
+void ConnectionManager::ProcessContinuousWindow(const char* data,
+                                                size_t size) {
+  ProfileWindow window;
+  if (!DecodeProfileWindow(data, size, &window)) {
+    ERROR("Invalid continuous profile window of size %lu", size);
+    return;
+  }
+
+  std::vector<CallStack> callstacks;
+  callstacks.reserve(window.callstacks.size());
+  for (auto& [id, frames] : window.callstacks) {
+    CallStack& cs = callstacks.emplace_back();
+    cs.m_Hash = id;
+    cs.m_Depth = frames.size();
+    cs.m_Data = std::move(frames);
+  }
+  // As for Msg_SampleHistogram, each count is expanded back into samples.
+  std::vector<CallstackEvent> events;
+  for (const SampleCount& sample_count : window.sample_counts) {
+    events.insert(events.end(), sample_count.count,
+                  CallstackEvent(sample_count.time, sample_count.callstack_id,
+                                 sample_count.thread_id));
+  }
+  std::stable_sort(events.begin(), events.end(),
+                   [](const CallstackEvent& a, const CallstackEvent& b) {
+                     return a.m_Time < b.m_Time;
+                   });
+  GCoreApp->ProcessSamplingCallStacks(events, absl::MakeSpan(callstacks));
 }
 
 void ConnectionManager::Stop() { exit_requested_ = true; }
 
 void ConnectionManager::SetupServerCallbacks() {
+  // Answered right away, on the thread receiving the messages, for the
+  // timestamps to be as close as possible to the network.
+  GTcpServer->AddCallback(Msg_ClockSync, [](const Message& msg) {
+    uint64_t receive_ns = OrbitTicks();
+    if (msg.m_Size != sizeof(ClockSyncProbe)) {
+      ERROR("Invalid clock sync probe of size %u", msg.m_Size);
+      return;
+    }
+    ClockSyncProbe probe;
+    memcpy(&probe, msg.GetData(), sizeof(probe));
+    probe.source_receive_ns = receive_ns;
+    probe.source_send_ns = OrbitTicks();
+    GTcpServer->Send(Msg_ClockSync, probe);
+  });
+
   GTcpServer->AddMainThreadCallback(
       Msg_RemoteSelectedFunctionsMap,
       [this](const Message& a_Msg) { SetSelectedFunctionsOnRemote(a_Msg); });
@@ -197,12 +785,130 @@ void ConnectionManager::SetupServerCallbacks() {
   GTcpServer->AddMainThreadCallback(
       Msg_StopCapture, [this](const Message&) { StopCaptureAsRemote(); });
 
+  GTcpServer->AddMainThreadCallback(
+      Msg_FunctionSamplingPolicies, [](const Message& msg) {
+        const auto* policies =
+            reinterpret_cast<const FunctionSamplingPolicy*>(msg.GetData());
+        Capture::GSamplingPolicies.assign(
+            policies, policies + msg.m_Size / sizeof(FunctionSamplingPolicy));
+      });
+
+  GTcpServer->AddMainThreadCallback(
+      Msg_CaptureFilter, [this](const Message& msg) {
+        CaptureFilter filter;
+        std::istringstream buffer(std::string(msg.m_Data, msg.m_Size));
+        cereal::BinaryInputArchive input_archive(buffer);
+        input_archive(filter);
+        tracing_session_.SetCaptureFilter(filter);
+      });
+
+  GTcpServer->AddMainThreadCallback(
+      Msg_CaptureRecordingRequest,
+      [this](const Message&) { record_next_capture_ = true; });
+
+  GTcpServer->AddMainThreadCallback(
+      Msg_FlightRecorderRequest, [this](const Message& msg) {
+        if (msg.m_Size != sizeof(FlightRecorderSettings)) {
+          ERROR("Invalid flight recorder settings of size %u", msg.m_Size);
+          return;
+        }
+        FlightRecorderSettings settings;
+        memcpy(&settings, msg.GetData(), sizeof(settings));
+        flight_recorder_settings_ = settings;
+      });
+
+  GTcpServer->AddMainThreadCallback(
+      Msg_CaptureTriggers, [this](const Message& msg) {
+        const auto* triggers =
+            reinterpret_cast<const CaptureTrigger*>(msg.GetData());
+        next_capture_triggers_.assign(
+            triggers, triggers + msg.m_Size / sizeof(CaptureTrigger));
+      });
+
+  GTcpServer->AddMainThreadCallback(
+      Msg_FlightRecorderDump, [this](const Message&) { DumpFlightRecorder(); });
+
+  GTcpServer->AddMainThreadCallback(Msg_IntelPtRequest, [](const Message& msg) {
+    if (msg.m_Size != sizeof(uint64_t)) {
+      ERROR("Invalid Intel PT request of size %u", msg.m_Size);
+      return;
+    }
+    uint64_t duration_ns;
+    memcpy(&duration_ns, msg.GetData(), sizeof(duration_ns));
+#if __linux__
+    GEventTracer.TraceWithIntelPt(msg.m_Header.m_GenericHeader.m_Address,
+                                  duration_ns);
+#endif
+  });
+
+  GTcpServer->AddMainThreadCallback(
+      Msg_CaptureChunksRequest, [this](const Message& msg) {
+        if (msg.m_Size != sizeof(CaptureChunksRequest)) {
+          ERROR("Invalid capture chunks request of size %u", msg.m_Size);
+          return;
+        }
+        CaptureChunksRequest request;
+        memcpy(&request, msg.GetData(), sizeof(request));
+        SendRecordedChunks(request);
+      });
+
+  GTcpServer->AddMainThreadCallback(
+      Msg_StartContinuousProfiling, [this](const Message& msg) {
+        if (msg.m_Size != sizeof(ContinuousProfilingSettings)) {
+          ERROR("Invalid continuous profiling settings of size %u",
+                msg.m_Size);
+          return;
+        }
+        uint32_t pid =
+            static_cast<uint32_t>(msg.m_Header.m_GenericHeader.m_Address);
+        ContinuousProfilingSettings settings;
+        memcpy(&settings, msg.GetData(), sizeof(settings));
+        StartContinuousProfilingAsRemote(pid, settings);
+      });
+
+  GTcpServer->AddMainThreadCallback(
+      Msg_StopContinuousProfiling,
+      [this](const Message&) { StopContinuousProfilingAsRemote(); });
+
+  GTcpServer->AddMainThreadCallback(
+      Msg_ContinuousWindowsRequest, [this](const Message&) {
+        std::vector<ContinuousWindowInfo> infos;
+        if (continuous_profile_ != nullptr) {
+          // Closes the window in progress if the target stopped sampling.
+          continuous_profile_->Update(OrbitTicks());
+          infos = continuous_profile_->GetWindowInfos();
+        }
+        GTcpServer->Send(Msg_ContinuousWindows, std::move(infos));
+      });
+
+  GTcpServer->AddMainThreadCallback(
+      Msg_ContinuousWindowRequest, [this](const Message& msg) {
+        uint64_t begin_time = msg.m_Header.m_GenericHeader.m_Address;
+        std::optional<std::string> window;
+        if (continuous_profile_ != nullptr) {
+          window = continuous_profile_->GetWindow(begin_time);
+        }
+        if (!window.has_value()) {
+          ERROR("No continuous profile window begins at %lu", begin_time);
+          return;
+        }
+        GTcpServer->SendBytes(Msg_ContinuousWindow, std::move(window.value()));
+      });
+
+  GTcpServer->AddMainThreadCallback(
+      Msg_RemoteProcessListRequest,
+      [this](const Message&) { full_process_list_requested_ = true; });
+
   GTcpServer->AddMainThreadCallback(
       Msg_RemoteProcessRequest, [this](const Message& msg) {
         uint32_t pid =
             static_cast<uint32_t>(msg.m_Header.m_GenericHeader.m_Address);
 
         SendRemoteProcess(GTcpServer, pid);
+#if __linux__
+        // The process is selected, a capture of it is likely to follow.
+        LinuxTracingHandler::Prewarm(pid);
+#endif
       });
 
   GTcpServer->AddMainThreadCallback(
@@ -219,28 +925,75 @@ void ConnectionManager::SetupServerCallbacks() {
 
         Capture::SetTargetProcess(process);
 
-        std::vector<ModuleDebugInfo> remoteModuleDebugInfo;
         std::vector<std::string> modules;
 
         std::istringstream buffer(std::string(msg.m_Data, msg.m_Size));
         cereal::BinaryInputArchive inputAr(buffer);
         inputAr(modules);
 
-        for (std::string& module : modules) {
-          ModuleDebugInfo moduleDebugInfo;
-          moduleDebugInfo.m_Name = module;
-          process->FillModuleDebugInfo(moduleDebugInfo);
-          remoteModuleDebugInfo.push_back(moduleDebugInfo);
-        }
+        // The modules are loaded in parallel, and sent in one message each,
+        // for the client to load and cache each module as soon as it
+        // arrives rather than after all of them.
+        ParallelFor(modules.size(), [&](size_t index) {
+          std::vector<ModuleDebugInfo> remoteModuleDebugInfo(1);
+          remoteModuleDebugInfo[0].m_Name = modules[index];
+          process->FillModuleDebugInfo(remoteModuleDebugInfo[0]);
 
-        // Send data back
-        std::string messageData = SerializeObjectBinary(remoteModuleDebugInfo);
-        GTcpServer->Send(Msg_RemoteModuleDebugInfo, (void*)messageData.data(),
-                         messageData.size());
+          // Send data back
+          std::string messageData =
+              SerializeObjectBinary(remoteModuleDebugInfo);
+          GTcpServer->Send(Msg_RemoteModuleDebugInfo,
+                           (void*)messageData.data(), messageData.size());
+        });
       });
 }
 
 void ConnectionManager::SetupClientCallbacks() {
+  GTcpClient->AddCallback(Msg_ClockSync, [this](const Message& a_Msg) {
+    uint64_t receive_ns = OrbitTicks();
+    if (a_Msg.m_Size != sizeof(ClockSyncProbe)) {
+      ERROR("Invalid clock sync probe of size %u", a_Msg.m_Size);
+      return;
+    }
+    ClockSyncProbe probe;
+    memcpy(&probe, a_Msg.GetData(), sizeof(probe));
+    ClockCorrection correction;
+    {
+      absl::MutexLock lock(&clock_sync_mutex_);
+      clock_sync_.AddRoundTrip(probe, receive_ns);
+      correction = clock_sync_.GetCorrection();
+    }
+    Capture::SetClockCorrection(remote_address_, correction);
+  });
+
+  GTcpClient->AddMainThreadCallback(
+      Msg_CaptureRecordingInfo, [this](const Message& a_Msg) {
+        if (a_Msg.m_Size != sizeof(CaptureRecordingInfo)) {
+          ERROR("Invalid capture recording info of size %u", a_Msg.m_Size);
+          return;
+        }
+        memcpy(&recorded_capture_info_, a_Msg.GetData(),
+               sizeof(recorded_capture_info_));
+        PRINT("The service recorded %lu chunks (%s) of capture\n",
+              recorded_capture_info_.num_chunks,
+              GetPrettySize(recorded_capture_info_.num_bytes).c_str());
+      });
+
+  GTcpClient->AddMainThreadCallback(
+      Msg_ContinuousWindows, [this](const Message& a_Msg) {
+        const auto* infos =
+            reinterpret_cast<const ContinuousWindowInfo*>(a_Msg.GetData());
+        continuous_window_infos_.assign(
+            infos, infos + a_Msg.m_Size / sizeof(ContinuousWindowInfo));
+        PRINT("The service holds %lu windows of continuous profile\n",
+              continuous_window_infos_.size());
+      });
+
+  GTcpClient->AddWorkerCallback(
+      Msg_ContinuousWindow, kCallstacksStream, [this](const Message& a_Msg) {
+        ProcessContinuousWindow(a_Msg.GetData(), a_Msg.m_Size);
+      });
+
   GTcpClient->AddMainThreadCallback(Msg_RemotePerf, [=](const Message& a_Msg) {
     PRINT_VAR(a_Msg.m_Size);
     std::string msgStr(a_Msg.m_Data, a_Msg.m_Size);
@@ -265,13 +1018,25 @@ void ConnectionManager::SetupClientCallbacks() {
     GCoreApp->ProcessSamplingCallStack(data);
   });
 
-  GTcpClient->AddCallback(Msg_RemoteTimers, [=](const Message& a_Msg) {
-    uint32_t numTimers = (uint32_t)a_Msg.m_Size / sizeof(Timer);
-    Timer* timers = (Timer*)a_Msg.GetData();
-    for (uint32_t i = 0; i < numTimers; ++i) {
-      GTimerManager->Add(timers[i]);
-    }
-  });
+  GTcpClient->AddWorkerCallback(
+      Msg_RemoteTimers, kTimersStream, [=](const Message& a_Msg) {
+        if (!GTimerManager->AddEncodedTimers(a_Msg.GetData(), a_Msg.m_Size)) {
+          ERROR("Invalid timers message of size %u", a_Msg.m_Size);
+        }
+      });
+
+  GTcpClient->AddWorkerCallback(
+      Msg_KeysAndStrings, kTimersStream, [=](const Message& a_Msg) {
+        std::vector<KeyAndString> keys_and_strings;
+        if (!DecodeKeysAndStrings(a_Msg.GetData(), a_Msg.m_Size,
+                                  &keys_and_strings)) {
+          ERROR("Invalid strings message of size %u", a_Msg.m_Size);
+          return;
+        }
+        for (const KeyAndString& key_and_string : keys_and_strings) {
+          GCoreApp->AddKeyAndString(key_and_string.key, key_and_string.str);
+        }
+      });
 
   GTcpClient->AddCallback(Msg_KeyAndString, [=](const Message& a_Msg) {
     KeyAndString key_and_string;
@@ -281,6 +1046,33 @@ void ConnectionManager::SetupClientCallbacks() {
     GCoreApp->AddKeyAndString(key_and_string.key, key_and_string.str);
   });
 
+  // Not a worker callback: this runs once the strings sent before, with the
+  // names of the symbols, were added.
+  GTcpClient->AddCallback(Msg_KernelFrameSymbols, [=](const Message& a_Msg) {
+    size_t num_symbols = a_Msg.m_Size / sizeof(KernelFrameSymbol);
+    const auto* symbols =
+        reinterpret_cast<const KernelFrameSymbol*>(a_Msg.GetData());
+    for (size_t i = 0; i < num_symbols; ++i) {
+      GCoreApp->AddKernelFrameSymbol(symbols[i]);
+    }
+  });
+
+  // Also not a worker callback, for the same reason.
+  GTcpClient->AddCallback(Msg_ThreadNames, [=](const Message& a_Msg) {
+    size_t num_thread_names = a_Msg.m_Size / sizeof(ThreadNameKey);
+    const auto* thread_names =
+        reinterpret_cast<const ThreadNameKey*>(a_Msg.GetData());
+    for (size_t i = 0; i < num_thread_names; ++i) {
+      GCoreApp->AddThreadName(thread_names[i]);
+    }
+  });
+
+  GTcpClient->AddCallback(Msg_BranchCounts, [=](const Message& a_Msg) {
+    Capture::GBranchProfile.AddCounts(
+        reinterpret_cast<const BranchCount*>(a_Msg.GetData()),
+        a_Msg.m_Size / sizeof(BranchCount));
+  });
+
   GTcpClient->AddCallback(Msg_RemoteCallStack, [=](const Message& a_Msg) {
     CallStack stack;
     std::istringstream buffer(std::string(a_Msg.m_Data, a_Msg.m_Size));
@@ -299,49 +1091,149 @@ void ConnectionManager::SetupClientCallbacks() {
     GCoreApp->AddSymbol(symbol.m_Address, symbol.m_Module, symbol.m_Name);
   });
 
-  GTcpClient->AddCallback(Msg_RemoteContextSwitches, [=](const Message& a_Msg) {
-    uint32_t num_context_switches =
-        (uint32_t)a_Msg.m_Size / sizeof(ContextSwitch);
-    ContextSwitch* context_switches = (ContextSwitch*)a_Msg.GetData();
-    for (uint32_t i = 0; i < num_context_switches; i++) {
-      GCoreApp->ProcessContextSwitch(context_switches[i]);
-    }
-  });
+  GTcpClient->AddWorkerCallback(
+      Msg_RemoteCoreActivities, kContextSwitchesStream,
+      [=](const Message& a_Msg) {
+        if (!GTimerManager->AddEncodedCoreActivities(a_Msg.GetData(),
+                                                     a_Msg.m_Size)) {
+          ERROR("Invalid core activities message of size %u", a_Msg.m_Size);
+        }
+      });
 
-  GTcpClient->AddCallback(Msg_SamplingCallstacks, [=](const Message& a_Msg) {
-    const char* a_Data = a_Msg.GetData();
-    size_t a_Size = a_Msg.m_Size;
-    std::istringstream buffer(std::string(a_Data, a_Size));
-    cereal::BinaryInputArchive inputAr(buffer);
-    std::vector<LinuxCallstackEvent> call_stacks;
-    inputAr(call_stacks);
+  // Sent by older services, and found in the captures they recorded.
+  GTcpClient->AddWorkerCallback(
+      Msg_RemoteContextSwitches, kContextSwitchesStream,
+      [=](const Message& a_Msg) {
+        uint32_t num_context_switches =
+            (uint32_t)a_Msg.m_Size / sizeof(ContextSwitch);
+        ContextSwitch* context_switches = (ContextSwitch*)a_Msg.GetData();
+        for (uint32_t i = 0; i < num_context_switches; i++) {
+          GCoreApp->ProcessContextSwitch(context_switches[i]);
+        }
+      });
 
-    for (auto& cs : call_stacks) {
-      GCoreApp->ProcessSamplingCallStack(cs);
-    }
-  });
+  GTcpClient->AddWorkerCallback(
+      Msg_RemoteThreadStateChanges, kThreadStateChangesStream,
+      [=](const Message& a_Msg) {
+        uint32_t num_thread_state_changes =
+            (uint32_t)a_Msg.m_Size / sizeof(ThreadStateChange);
+        const auto* thread_state_changes =
+            reinterpret_cast<const ThreadStateChange*>(a_Msg.GetData());
+        for (uint32_t i = 0; i < num_thread_state_changes; i++) {
+          GCoreApp->ProcessThreadStateChange(thread_state_changes[i]);
+        }
+      });
 
-  GTcpClient->AddCallback(
-      Msg_SamplingHashedCallstacks, [=](const Message& a_Msg) {
-        const char* a_Data = a_Msg.GetData();
-        size_t a_Size = a_Msg.m_Size;
-        std::istringstream buffer(std::string(a_Data, a_Size));
-        cereal::BinaryInputArchive inputAr(buffer);
-        std::vector<CallstackEvent> call_stacks;
-        inputAr(call_stacks);
+  GTcpClient->AddWorkerCallback(
+      Msg_SamplingCallstacks, kCallstacksStream, [=](const Message& a_Msg) {
+        std::optional<FlatCallstacksView> view =
+            FlatCallstacksView::Create(a_Msg.GetData(), a_Msg.m_Size);
+        if (!view.has_value()) {
+          ERROR("Invalid callstacks message of size %u", a_Msg.m_Size);
+          return;
+        }
+
+        std::vector<CallstackEvent> events;
+        events.reserve(view->size());
+        std::vector<CallStack> newCallstacks;
+        absl::flat_hash_set<CallstackID> ids;
+        view->ForEachCallstack(
+            [&](size_t index, absl::Span<const uint64_t> frames) {
+              CallstackID id = view->GetId(index);
+              ThreadID tid = view->GetThreadId(index);
+              events.emplace_back(view->GetTime(index), id, tid);
+              if (!ids.insert(id).second) {
+                return;
+              }
+              CallStack& cs = newCallstacks.emplace_back();
+              cs.m_Hash = id;
+              cs.m_ThreadId = tid;
+              cs.m_Depth = frames.size();
+              cs.m_Data.assign(frames.begin(), frames.end());
+            });
+        GCoreApp->ProcessSamplingCallStacks(events,
+                                            absl::MakeSpan(newCallstacks));
+      });
+
+  GTcpClient->AddWorkerCallback(
+      Msg_SamplingHashedCallstacks, kCallstacksStream,
+      [=](const Message& a_Msg) {
+        std::optional<FlatHashedCallstacksView> view =
+            FlatHashedCallstacksView::Create(a_Msg.GetData(), a_Msg.m_Size);
+        if (!view.has_value()) {
+          ERROR("Invalid hashed callstacks message of size %u", a_Msg.m_Size);
+          return;
+        }
+
+        std::vector<CallstackEvent> events;
+        events.reserve(view->size());
+        for (size_t i = 0; i < view->size(); ++i) {
+          events.emplace_back(view->GetTime(i), view->GetId(i),
+                              view->GetThreadId(i));
+        }
+        GCoreApp->ProcessSamplingCallStacks(events, {});
+      });
+
+  GTcpClient->AddWorkerCallback(
+      Msg_SampleHistogram, kCallstacksStream, [=](const Message& a_Msg) {
+        size_t num_sample_counts = a_Msg.m_Size / sizeof(SampleCount);
+        const auto* sample_counts =
+            reinterpret_cast<const SampleCount*>(a_Msg.GetData());
+        // Each count is expanded back into samples, at the time of the last
+        // one, for the sampling report to count them.
+        std::vector<CallstackEvent> events;
+        for (size_t i = 0; i < num_sample_counts; ++i) {
+          const SampleCount& sample_count = sample_counts[i];
+          events.insert(events.end(), sample_count.count,
+                        CallstackEvent(sample_count.time,
+                                       sample_count.callstack_id,
+                                       sample_count.thread_id));
+        }
+        std::stable_sort(events.begin(), events.end(),
+                         [](const CallstackEvent& a, const CallstackEvent& b) {
+                           return a.m_Time < b.m_Time;
+                         });
+        GCoreApp->ProcessSamplingCallStacks(events, {});
+      });
 
-        for (auto& cs : call_stacks) {
-          GCoreApp->ProcessHashedSamplingCallStack(cs);
+  GTcpClient->AddWorkerCallback(
+      Msg_OffCpuCallstacks, kCallstacksStream, [=](const Message& a_Msg) {
+        std::optional<FlatOffCpuCallstacksView> view =
+            FlatOffCpuCallstacksView::Create(a_Msg.GetData(), a_Msg.m_Size);
+        if (!view.has_value()) {
+          ERROR("Invalid off-CPU callstacks message of size %u", a_Msg.m_Size);
+          return;
         }
+
+        const FlatCallstacksView& callstacks_view = view->GetCallstacks();
+        std::vector<CallStack> callstacks;
+        std::vector<uint64_t> durations_ns;
+        callstacks.reserve(callstacks_view.size());
+        durations_ns.reserve(callstacks_view.size());
+        callstacks_view.ForEachCallstack(
+            [&](size_t index, absl::Span<const uint64_t> frames) {
+              CallStack& cs = callstacks.emplace_back();
+              cs.m_Hash = callstacks_view.GetId(index);
+              cs.m_ThreadId = callstacks_view.GetThreadId(index);
+              cs.m_Depth = frames.size();
+              cs.m_Data.assign(frames.begin(), frames.end());
+              durations_ns.push_back(view->GetDurationNs(index));
+            });
+        GCoreApp->ProcessOffCpuCallstacks(callstacks, durations_ns);
       });
 }
 
 void ConnectionManager::SendProcesses(TcpEntity* tcp_entity) {
   process_list_.Refresh();
   process_list_.UpdateCpuTimes();
-  std::string process_data = SerializeObjectHumanReadable(process_list_);
-  tcp_entity->Send(Msg_RemoteProcessList, process_data.data(),
-                   process_data.size());
+  if (full_process_list_requested_.exchange(false)) {
+    process_list_differ_.Reset();
+  }
+  ProcessListDiff diff = process_list_differ_.Update(process_list_);
+  if (diff.IsFull() || !diff.IsEmpty()) {
+    tcp_entity->SendBytes(Msg_RemoteProcessListDiff,
+                          SerializeObjectBinary(diff));
+  }
 }
 
 void ConnectionManager::SendRemoteProcess(TcpEntity* tcp_entity, uint32_t pid) {
@@ -357,14 +1249,44 @@ void ConnectionManager::SendRemoteProcess(TcpEntity* tcp_entity, uint32_t pid) {
   }
 }
 
+void ConnectionManager::SendClockSyncProbe() {
+  ClockSyncProbe probe;
+  probe.client_send_ns = OrbitTicks();
+  GTcpClient->Send(Msg_ClockSync, probe);
+}
+
 void ConnectionManager::ConnectionThreadWorker() {
   while (!exit_requested_) {
     if (!GTcpClient->IsValid()) {
       GTcpClient->Connect(remote_address_);
       GTcpClient->Start();
+      {
+        // The round trips of the previous connection may be to another
+        // instance of the service.
+        absl::MutexLock lock(&clock_sync_mutex_);
+        clock_sync_ = ClockSync{};
+      }
+      // A few round trips right away, for a first estimate of the offset.
+      for (size_t i = 0; i < ClockSync::kNumProbesOnConnect; ++i) {
+        SendClockSyncProbe();
+      }
+      if (watch_only_) {
+        // Before any other message, which would make this client the one
+        // controlling the capture.
+        GTcpClient->Send(Msg_SubscribeCapture);
+      } else {
+        // Asked for first: the service ignores the compression request if it
+        // could open the shared memory.
+        if (GTcpClient->IsLocalConnection()) {
+          GTcpClient->RequestSharedMemory();
+        }
+        if (GParams.m_CompressRemoteTraffic) {
+          GTcpClient->RequestCompression();
+        }
+      }
     } else {
-      // std::string msg("Hello from dev machine");
-      // GTcpClient->Send(msg);
+      // Then one at a time, for the estimate to follow the drift.
+      SendClockSyncProbe();
     }
 
     Sleep(2000);
@@ -4,16 +4,29 @@
 #pragma once
 
 #include <atomic>
+#include <map>
 #include <memory>
+#include <optional>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include "CaptureFile.h"
+#include "CaptureTriggers.h"
+#include "ClockSync.h"
+#include "ContinuousProfile.h"
+#include "FlightRecorder.h"
+#include "HostConnection.h"
 #include "LinuxTracingSession.h"
 #include "Message.h"
+#include "ProcessListDiff.h"
 #include "ProcessUtils.h"
 #include "StringManager.h"
 #include "TcpEntity.h"
+#include "absl/synchronization/mutex.h"
+
+class Function;
+class LinuxTracingHandler;
 
 // TODO: This class is used in both - client and server side,
 // this should probably be reworked and separated into 2 distinct classes
@@ -24,32 +37,156 @@ class ConnectionManager {
   static ConnectionManager& Get();
   void Init();
   void InitAsService();
-  void ConnectToRemote(std::string a_RemoteAddress);
+  // With watch_only, the client only receives the capture data of the capture
+  // another client controls, see TcpServer::AddCaptureSubscriber.
+  void ConnectToRemote(std::string a_RemoteAddress, bool watch_only = false);
   void SetSelectedFunctionsOnRemote(const Message& a_Msg);
   bool IsService() const { return is_service_; }
   void StartCaptureAsRemote(uint32_t pid);
   void StopCaptureAsRemote();
   void Stop();
 
+  // Client side: the capture the service recorded to a file on the target,
+  // when GParams.m_RecordCaptureOnService was set, see CaptureFile.h.
+  const CaptureRecordingInfo& GetRecordedCaptureInfo() const {
+    return recorded_capture_info_;
+  }
+  // Asks the service for the recorded events between begin_time and end_time,
+  // which are then received like the events of a live capture. Each chunk of
+  // the recording is only sent once.
+  void PullRecordedCapture(uint64_t begin_time, uint64_t end_time);
+
+  // Client side: asks the service to send the last seconds of the capture its
+  // flight recorder holds, see GParams.m_FlightRecorderWindowMs. They are
+  // received like the events of a live capture.
+  void RequestFlightRecorderDump();
+  // Service side: the same, from any thread of the service. SIGUSR2 also
+  // triggers it, though only once the capture has events to read.
+  void DumpFlightRecorder();
+
+  // Client side: asks the service to trace the calls to the function at
+  // function_address with Intel Processor Trace during the next duration_ns
+  // of the capture, see LinuxTracing::Tracer::TraceWithIntelPt. The calls
+  // are received like the ones of the selected functions.
+  void RequestIntelPtWindow(uint64_t function_address, uint64_t duration_ns);
+
+  // Client side: the continuous profiling mode of the service, which samples
+  // the process at a low frequency until stopped, independently of the
+  // captures, and keeps the profile as rolling windows, see ContinuousProfile.
+  void StartContinuousProfiling(uint32_t pid,
+                                const ContinuousProfilingSettings& settings);
+  void StopContinuousProfiling();
+  // The windows are listed by the service as Msg_ContinuousWindows, then
+  // available from GetContinuousWindowInfos.
+  void RequestContinuousWindows();
+  const std::vector<ContinuousWindowInfo>& GetContinuousWindowInfos() const {
+    return continuous_window_infos_;
+  }
+  // The samples of the window are received like the samples of a capture.
+  void PullContinuousWindow(uint64_t begin_time);
+
+  // Client side: captures the process pid on the service at address along
+  // with the one of ConnectToRemote, on the same timeline, see
+  // HostConnection. Only called on the main thread, before capturing.
+  void AddRemoteHost(std::string address, uint32_t pid);
+  void StartCaptureOnHosts();
+  void StopCaptureOnHosts();
+  // What the tracks of the host are prefixed with, empty for the host of
+  // ConnectToRemote.
+  std::string GetHostLabel(uint32_t host_index) const;
+
  private:
   void ConnectionThreadWorker();
   void RemoteThreadWorker();
   void ServerCaptureThreadWorker();
+  void SendRecordedEvents();
+  // Service side. Records statistics of the sender as service stats, see
+  // LinuxTracingSession::RecordServiceStat, about once a second.
+  void RecordSenderStatsIfWindowElapsed();
+  void SendCaptureData(MessageType type, std::string&& data,
+                       uint64_t begin_time, uint64_t end_time);
+  template <typename T>
+  void SendCaptureData(MessageType type, std::vector<T>&& events,
+                       uint64_t begin_time, uint64_t end_time);
+  void StartCaptureRecording(uint32_t pid);
+  void SendRecordedCaptureInfo();
+  void SendRecordedChunks(const CaptureChunksRequest& request);
+  void EvaluateCaptureTriggers(const std::vector<Timer>& timers);
+  void SendFlightRecorderWindowIfRequested();
+  void StartContinuousProfilingAsRemote(
+      uint32_t pid, const ContinuousProfilingSettings& settings);
+  void StopContinuousProfilingAsRemote();
+  void ContinuousProfilingThreadWorker();
+  void AddToContinuousProfile();
+  void ProcessContinuousWindow(const char* data, size_t size);
 
   void StopThread();
   void SetupClientCallbacks();
   void SetupServerCallbacks();
-  void SetupIntrospection();
+  void StartIntrospection();
+  void StopIntrospection();
   void SendProcesses(TcpEntity* tcp_entity);
   void SendRemoteProcess(TcpEntity* tcp_entity, uint32_t pid);
+  void SendClockSyncProbe();
 
   ProcessList process_list_;
+  // Service side. The process list goes to the client as diffs, the whole
+  // list when it asks with Msg_RemoteProcessListRequest.
+  ProcessListDiffer process_list_differ_;
+  std::atomic<bool> full_process_list_requested_ = false;
   LinuxTracingSession tracing_session_;
   std::shared_ptr<StringManager> string_manager_;
 
   std::unique_ptr<std::thread> thread_;
   std::unique_ptr<std::thread> server_capture_thread_;
+
+  // Service side. Set by Msg_CaptureRecordingRequest, for the next capture.
+  bool record_next_capture_ = false;
+  // Only accessed by the capture thread while capturing.
+  std::unique_ptr<CaptureFileWriter> capture_writer_;
+  std::string recorded_capture_path_;
+  CaptureFileReader recorded_capture_reader_;
+  std::vector<bool> sent_recorded_chunks_;
+  // Service side. Set by Msg_FlightRecorderRequest, for the next capture,
+  // whose data then goes to flight_recorder_ instead of being sent. Only
+  // accessed by the capture thread while capturing, and discarded after.
+  std::optional<FlightRecorderSettings> flight_recorder_settings_;
+  std::unique_ptr<FlightRecorder> flight_recorder_;
+  std::atomic<bool> flight_recorder_dump_requested_ = false;
+  // Set by Msg_CaptureTriggers, for the next flight recorder, whose window is
+  // then also sent when capture_triggers_ fire on the events it records.
+  std::vector<CaptureTrigger> next_capture_triggers_;
+  std::unique_ptr<CaptureTriggers> capture_triggers_;
+  // Only accessed by the capture thread, since the last sender stats.
+  uint64_t stats_window_begin_ns_ = 0;
+  uint64_t sent_bytes_ = 0;
+  uint64_t sending_ns_ = 0;
+
+  // Service side. The continuous profiling session has its own tracing
+  // session, which aggregates the samples into histograms, and its own
+  // thread, which feeds the profile. The profile stays after stopping, for
+  // its windows to be pulled.
+  std::shared_ptr<Process> continuous_process_;
+  std::unique_ptr<LinuxTracingSession> continuous_session_;
+  std::unique_ptr<LinuxTracingHandler> continuous_handler_;
+  // Always empty, for the handler.
+  std::map<uint64_t, Function*> continuous_selected_functions_;
+  uint64_t continuous_num_context_switches_ = 0;
+  std::unique_ptr<ContinuousProfile> continuous_profile_;
+  std::unique_ptr<std::thread> continuous_thread_;
+  std::atomic<bool> continuous_profiling_ = false;
+
+  // Client side.
+  CaptureRecordingInfo recorded_capture_info_ = {};
+  std::vector<ContinuousWindowInfo> continuous_window_infos_;
+  // Only accessed on the main thread. hosts_[i] is host i + 1.
+  std::vector<std::unique_ptr<HostConnection>> hosts_;
+  // From the round trips of Msg_ClockSync, answered on the receiving thread.
+  absl::Mutex clock_sync_mutex_;
+  ClockSync clock_sync_ ABSL_GUARDED_BY(clock_sync_mutex_);
+
   std::string remote_address_;
+  bool watch_only_ = false;
   std::atomic<bool> exit_requested_;
   bool is_service_;
 };
@@ -0,0 +1,264 @@
+#include "ContinuousProfile.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+
+#include "OrbitBase/Logging.h"
+#include "Varint.h"
+
+namespace {
+constexpr uint64_t kProfileWindowVersion = 1;
+constexpr int kCompressionLevel = 6;
+// Way more than a window of hours of samples, for a corrupted size not to be
+// allocated.
+constexpr uint64_t kMaxDecodedWindowSize = 1024 * 1024 * 1024;
+// Of the callstacks kept, besides their frames.
+constexpr uint64_t kCallstackOverheadBytes = 64;
+
+uint64_t GetCallstackBytes(const std::vector<uint64_t>& frames) {
+  return kCallstackOverheadBytes + frames.size() * sizeof(uint64_t);
+}
+}  // namespace
+
+std::string EncodeProfileWindow(const ProfileWindow& window) {
+  std::string raw;
+  WriteVarint(kProfileWindowVersion, &raw);
+  WriteVarint(window.begin_time, &raw);
+  WriteVarint(window.end_time - window.begin_time, &raw);
+
+  absl::flat_hash_map<CallstackID, uint64_t> indices;
+  WriteVarint(window.callstacks.size(), &raw);
+  for (const auto& [id, frames] : window.callstacks) {
+    indices.emplace(id, indices.size());
+    WriteVarint(id, &raw);
+    WriteVarint(frames.size(), &raw);
+    uint64_t previous_frame = 0;
+    for (uint64_t frame : frames) {
+      WriteVarint(ZigZagEncode(frame - previous_frame), &raw);
+      previous_frame = frame;
+    }
+  }
+
+  WriteVarint(window.sample_counts.size(), &raw);
+  for (const SampleCount& sample_count : window.sample_counts) {
+    WriteVarint(indices.at(sample_count.callstack_id), &raw);
+    WriteVarint(sample_count.thread_id, &raw);
+    WriteVarint(sample_count.count, &raw);
+    WriteVarint(ZigZagEncode(sample_count.time - window.begin_time), &raw);
+  }
+
+  std::string output;
+  WriteVarint(raw.size(), &output);
+  size_t header_size = output.size();
+  uLongf compressed_size = compressBound(raw.size());
+  output.resize(header_size + compressed_size);
+  if (compress2(reinterpret_cast<Bytef*>(output.data() + header_size),
+                &compressed_size, reinterpret_cast<const Bytef*>(raw.data()),
+                raw.size(), kCompressionLevel) != Z_OK) {
+    ERROR("Could not compress a profile window of %zu bytes", raw.size());
+    return std::string();
+  }
+  output.resize(header_size + compressed_size);
+  return output;
+}
+
+bool DecodeProfileWindow(const void* data, size_t size, ProfileWindow* window) {
+  VarintReader compressed_reader(data, size);
+  uint64_t raw_size;
+  if (!compressed_reader.ReadVarint(&raw_size) ||
+      raw_size > kMaxDecodedWindowSize) {
+    return false;
+  }
+  const uint8_t* compressed;
+  size_t compressed_size = compressed_reader.remaining();
+  compressed_reader.ReadBytes(compressed_size, &compressed);
+  std::string raw(raw_size, '\0');
+  uLongf decompressed_size = raw_size;
+  if (uncompress(reinterpret_cast<Bytef*>(raw.data()), &decompressed_size,
+                 compressed, compressed_size) != Z_OK ||
+      decompressed_size != raw_size) {
+    return false;
+  }
+
+  VarintReader reader(raw.data(), raw.size());
+  uint64_t version;
+  uint64_t duration;
+  uint64_t num_callstacks;
+  if (!reader.ReadVarint(&version) || version != kProfileWindowVersion ||
+      !reader.ReadVarint(&window->begin_time) ||
+      !reader.ReadVarint(&duration) || !reader.ReadVarint(&num_callstacks) ||
+      num_callstacks > reader.remaining()) {
+    return false;
+  }
+  window->end_time = window->begin_time + duration;
+
+  window->callstacks.clear();
+  std::vector<CallstackID> ids;
+  ids.reserve(num_callstacks);
+  for (uint64_t i = 0; i < num_callstacks; ++i) {
+    uint64_t id;
+    uint64_t depth;
+    if (!reader.ReadVarint(&id) || !reader.ReadVarint(&depth) ||
+        depth > reader.remaining()) {
+      return false;
+    }
+    std::vector<uint64_t>& frames = window->callstacks[id];
+    frames.resize(depth);
+    uint64_t previous_frame = 0;
+    for (uint64_t& frame : frames) {
+      uint64_t difference;
+      if (!reader.ReadVarint(&difference)) {
+        return false;
+      }
+      frame = previous_frame + ZigZagDecode(difference);
+      previous_frame = frame;
+    }
+    ids.push_back(id);
+  }
+
+  uint64_t num_sample_counts;
+  if (!reader.ReadVarint(&num_sample_counts) ||
+      num_sample_counts > reader.remaining()) {
+    return false;
+  }
+  window->sample_counts.resize(num_sample_counts);
+  for (SampleCount& sample_count : window->sample_counts) {
+    uint32_t index;
+    uint64_t thread_id;
+    uint64_t count;
+    uint64_t time_offset;
+    if (!reader.ReadIndex(ids.size(), &index) ||
+        !reader.ReadVarint(&thread_id) || !reader.ReadVarint(&count) ||
+        !reader.ReadVarint(&time_offset)) {
+      return false;
+    }
+    sample_count.callstack_id = ids[index];
+    sample_count.thread_id = static_cast<ThreadID>(thread_id);
+    sample_count.count = static_cast<uint32_t>(count);
+    sample_count.time = window->begin_time + ZigZagDecode(time_offset);
+  }
+  return reader.remaining() == 0;
+}
+
+ContinuousProfile::ContinuousProfile(uint64_t window_duration_ns,
+                                     uint64_t max_memory_bytes,
+                                     uint64_t begin_time)
+    : window_duration_ns_(std::max<uint64_t>(window_duration_ns, 1)),
+      max_memory_bytes_(max_memory_bytes),
+      window_begin_(begin_time) {}
+
+void ContinuousProfile::AddCallstack(CallstackID id,
+                                     std::vector<uint64_t> frames) {
+  absl::MutexLock lock(&mutex_);
+  if (callstacks_.contains(id)) {
+    return;
+  }
+  uint64_t bytes = GetCallstackBytes(frames);
+  if (callstacks_bytes_ + bytes > max_memory_bytes_ / 4) {
+    // Its samples are then dropped in AddSamples.
+    return;
+  }
+  callstacks_bytes_ += bytes;
+  callstacks_.emplace(id, std::move(frames));
+  EvictWindows();
+}
+
+void ContinuousProfile::AddSamples(uint64_t time, ThreadID thread_id,
+                                   CallstackID id, uint32_t count) {
+  absl::MutexLock lock(&mutex_);
+  CloseWindowsBefore(time);
+  if (!callstacks_.contains(id)) {
+    num_dropped_samples_ += count;
+    return;
+  }
+  SampleCount& sample_count = sample_counts_[{thread_id, id}];
+  sample_count.callstack_id = id;
+  sample_count.thread_id = thread_id;
+  sample_count.time = std::max(sample_count.time, time);
+  sample_count.count += count;
+  num_window_samples_ += count;
+}
+
+void ContinuousProfile::Update(uint64_t now) {
+  absl::MutexLock lock(&mutex_);
+  CloseWindowsBefore(now);
+}
+
+void ContinuousProfile::CloseWindowsBefore(uint64_t time) {
+  if (time < window_begin_ + window_duration_ns_) {
+    return;
+  }
+  uint64_t window_end = window_begin_ + window_duration_ns_;
+
+  // Empty windows, e.g. while the target sleeps, are not kept.
+  if (!sample_counts_.empty()) {
+    ProfileWindow window;
+    window.begin_time = window_begin_;
+    window.end_time = window_end;
+    window.sample_counts.reserve(sample_counts_.size());
+    for (const auto& [key, sample_count] : sample_counts_) {
+      window.sample_counts.push_back(sample_count);
+      window.callstacks.try_emplace(sample_count.callstack_id,
+                                    callstacks_.at(sample_count.callstack_id));
+    }
+
+    Window& closed = windows_.emplace_back();
+    closed.data = EncodeProfileWindow(window);
+    closed.info.begin_time = window.begin_time;
+    closed.info.end_time = window.end_time;
+    closed.info.num_samples = num_window_samples_;
+    closed.info.num_bytes = closed.data.size();
+    windows_bytes_ += closed.data.size();
+  }
+  sample_counts_.clear();
+  num_window_samples_ = 0;
+
+  // Windows stay aligned on the first one, skipping the empty ones.
+  window_begin_ = window_end + (time - window_end) / window_duration_ns_ *
+                                   window_duration_ns_;
+  EvictWindows();
+}
+
+void ContinuousProfile::EvictWindows() {
+  while (!windows_.empty() &&
+         windows_bytes_ + callstacks_bytes_ > max_memory_bytes_) {
+    windows_bytes_ -= windows_.front().data.size();
+    windows_.pop_front();
+    ++num_evicted_windows_;
+  }
+}
+
+std::vector<ContinuousWindowInfo> ContinuousProfile::GetWindowInfos() const {
+  absl::MutexLock lock(&mutex_);
+  std::vector<ContinuousWindowInfo> infos;
+  infos.reserve(windows_.size());
+  for (const Window& window : windows_) {
+    infos.push_back(window.info);
+  }
+  return infos;
+}
+
+std::optional<std::string> ContinuousProfile::GetWindow(
+    uint64_t begin_time) const {
+  absl::MutexLock lock(&mutex_);
+  auto it = std::lower_bound(windows_.begin(), windows_.end(), begin_time,
+                             [](const Window& window, uint64_t time) {
+                               return window.info.begin_time < time;
+                             });
+  if (it == windows_.end() || it->info.begin_time != begin_time) {
+    return std::nullopt;
+  }
+  return it->data;
+}
+
+ContinuousProfile::Stats ContinuousProfile::GetStats() const {
+  absl::MutexLock lock(&mutex_);
+  Stats stats;
+  stats.num_windows = windows_.size();
+  stats.num_evicted_windows = num_evicted_windows_;
+  stats.num_callstacks = callstacks_.size();
+  stats.num_dropped_samples = num_dropped_samples_;
+  stats.num_bytes = windows_bytes_ + callstacks_bytes_;
+  return stats;
+}
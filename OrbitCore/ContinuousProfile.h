@@ -0,0 +1,119 @@
+#ifndef ORBIT_CORE_CONTINUOUS_PROFILE_H_
+#define ORBIT_CORE_CONTINUOUS_PROFILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "CallstackTypes.h"
+#include "CaptureFilter.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
+#pragma pack(push, 1)
+// Payload of Msg_StartContinuousProfiling, whose generic header holds the pid
+// of the target.
+struct ContinuousProfilingSettings {
+  // Low enough for the target to barely notice, e.g. about 1% of overhead.
+  double sampling_frequency = 19.0;
+  uint64_t window_duration_ns = 60'000'000'000;
+  // Of the windows and the frames of their callstacks, kept on the service.
+  uint64_t max_memory_bytes = 64 * 1024 * 1024;
+};
+
+// Payload of Msg_ContinuousWindows, an array of which describes the windows
+// the service still holds, oldest first. A window is pulled with
+// Msg_ContinuousWindowRequest, whose generic header holds its begin_time.
+struct ContinuousWindowInfo {
+  uint64_t begin_time;
+  uint64_t end_time;
+  uint64_t num_samples;
+  // Encoded and compressed.
+  uint64_t num_bytes;
+};
+#pragma pack(pop)
+
+// The samples of a window of time, counted per thread and callstack, with the
+// frames of these callstacks, so that each window can be loaded on its own.
+struct ProfileWindow {
+  uint64_t begin_time = 0;
+  uint64_t end_time = 0;
+  absl::flat_hash_map<CallstackID, std::vector<uint64_t>> callstacks;
+  // The time of each count is the time of its last sample.
+  std::vector<SampleCount> sample_counts;
+};
+
+// Payload of Msg_ContinuousWindow: the window as varints, frames of a
+// callstack as differences from the previous frame, compressed with zlib.
+std::string EncodeProfileWindow(const ProfileWindow& window);
+// Returns false if the data is invalid, in which case window is left in an
+// unspecified state.
+bool DecodeProfileWindow(const void* data, size_t size, ProfileWindow* window);
+
+// The profile of the continuous profiling mode of the service, which samples
+// the target at a low frequency for hours. Samples are counted per thread and
+// callstack into rolling windows of window_duration_ns, and each window is
+// encoded and compressed when it closes, for the client to pull it later.
+// Windows are evicted oldest first to keep the memory held under
+// max_memory_bytes. The frames of each callstack are only received once, see
+// LinuxTracingHandler, so they are kept for the whole session, up to a
+// quarter of the budget: samples of new callstacks past that are dropped.
+// Thread-safe.
+class ContinuousProfile {
+ public:
+  ContinuousProfile(uint64_t window_duration_ns, uint64_t max_memory_bytes,
+                    uint64_t begin_time);
+
+  // The frames of a callstack, before its first samples.
+  void AddCallstack(CallstackID id, std::vector<uint64_t> frames);
+  // Closes the windows elapsed before time first.
+  void AddSamples(uint64_t time, ThreadID thread_id, CallstackID id,
+                  uint32_t count);
+  // Closes the window in progress if it ended before now.
+  void Update(uint64_t now);
+
+  std::vector<ContinuousWindowInfo> GetWindowInfos() const;
+  // The encoded window that began at begin_time, if it wasn't evicted.
+  std::optional<std::string> GetWindow(uint64_t begin_time) const;
+
+  struct Stats {
+    uint64_t num_windows = 0;
+    uint64_t num_evicted_windows = 0;
+    uint64_t num_callstacks = 0;
+    uint64_t num_dropped_samples = 0;
+    // Of the windows and the frames of the callstacks.
+    uint64_t num_bytes = 0;
+  };
+  Stats GetStats() const;
+
+ private:
+  struct Window {
+    ContinuousWindowInfo info;
+    std::string data;
+  };
+
+  void CloseWindowsBefore(uint64_t time) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void EvictWindows() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const uint64_t window_duration_ns_;
+  const uint64_t max_memory_bytes_;
+
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<CallstackID, std::vector<uint64_t>> callstacks_
+      ABSL_GUARDED_BY(mutex_);
+  uint64_t callstacks_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Of the window in progress, by thread and callstack.
+  uint64_t window_begin_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<std::pair<ThreadID, CallstackID>, SampleCount>
+      sample_counts_ ABSL_GUARDED_BY(mutex_);
+  uint64_t num_window_samples_ ABSL_GUARDED_BY(mutex_) = 0;
+  std::deque<Window> windows_ ABSL_GUARDED_BY(mutex_);
+  uint64_t windows_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  uint64_t num_evicted_windows_ ABSL_GUARDED_BY(mutex_) = 0;
+  uint64_t num_dropped_samples_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+#endif  // ORBIT_CORE_CONTINUOUS_PROFILE_H_
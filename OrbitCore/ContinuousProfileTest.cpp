@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "ContinuousProfile.h"
+
+namespace {
+constexpr uint64_t kWindowNs = 1000;
+
+uint64_t CountSamples(const ProfileWindow& window) {
+  uint64_t num_samples = 0;
+  for (const SampleCount& sample_count : window.sample_counts) {
+    num_samples += sample_count.count;
+  }
+  return num_samples;
+}
+}  // namespace
+
+TEST(ContinuousProfile, EncodedWindowsDecodeToTheSameWindow) {
+  ProfileWindow window;
+  window.begin_time = 1'000'000'000;
+  window.end_time = 1'060'000'000;
+  window.callstacks[42] = {0x7f0000001000, 0x7f0000000800, 0x400000};
+  window.callstacks[7] = {};
+  window.sample_counts.push_back({42, 1'059'000'000, 10, 3});
+  // Late samples can be older than the window.
+  window.sample_counts.push_back({7, 999'999'000, 11, 1});
+
+  std::string data = EncodeProfileWindow(window);
+  ASSERT_FALSE(data.empty());
+  ProfileWindow decoded;
+  ASSERT_TRUE(DecodeProfileWindow(data.data(), data.size(), &decoded));
+  EXPECT_EQ(decoded.begin_time, window.begin_time);
+  EXPECT_EQ(decoded.end_time, window.end_time);
+  EXPECT_EQ(decoded.callstacks, window.callstacks);
+  ASSERT_EQ(decoded.sample_counts.size(), 2);
+  for (size_t i = 0; i < 2; ++i) {
+    EXPECT_EQ(decoded.sample_counts[i].callstack_id,
+              window.sample_counts[i].callstack_id);
+    EXPECT_EQ(decoded.sample_counts[i].time, window.sample_counts[i].time);
+    EXPECT_EQ(decoded.sample_counts[i].thread_id,
+              window.sample_counts[i].thread_id);
+    EXPECT_EQ(decoded.sample_counts[i].count, window.sample_counts[i].count);
+  }
+
+  EXPECT_FALSE(DecodeProfileWindow(data.data(), data.size() - 1, &decoded));
+}
+
+TEST(ContinuousProfile, CountsSamplesIntoRollingWindows) {
+  ContinuousProfile profile(kWindowNs, 1024 * 1024, 0);
+  profile.AddCallstack(1, {0x1000, 0x2000});
+  profile.AddCallstack(2, {0x3000});
+  profile.AddSamples(100, 10, 1, 1);
+  profile.AddSamples(200, 10, 1, 2);
+  profile.AddSamples(300, 11, 2, 1);
+  // Closes the first window. The next one, empty, is not kept.
+  profile.AddSamples(2500, 10, 2, 1);
+  // Samples of unknown callstacks are dropped.
+  profile.AddSamples(2600, 10, 3, 1);
+  profile.Update(3000);
+
+  std::vector<ContinuousWindowInfo> infos = profile.GetWindowInfos();
+  ASSERT_EQ(infos.size(), 2);
+  EXPECT_EQ(infos[0].begin_time, 0);
+  EXPECT_EQ(infos[0].end_time, 1000);
+  EXPECT_EQ(infos[0].num_samples, 4);
+  EXPECT_EQ(infos[1].begin_time, 2000);
+  EXPECT_EQ(infos[1].num_samples, 1);
+  EXPECT_EQ(profile.GetStats().num_dropped_samples, 1);
+
+  std::optional<std::string> data = profile.GetWindow(0);
+  ASSERT_TRUE(data.has_value());
+  EXPECT_EQ(data->size(), infos[0].num_bytes);
+  ProfileWindow window;
+  ASSERT_TRUE(DecodeProfileWindow(data->data(), data->size(), &window));
+  EXPECT_EQ(CountSamples(window), 4);
+  EXPECT_EQ(window.sample_counts.size(), 2);
+  EXPECT_EQ(window.callstacks.size(), 2);
+
+  // Only the callstacks sampled in the window are in it.
+  data = profile.GetWindow(2000);
+  ASSERT_TRUE(data.has_value());
+  ASSERT_TRUE(DecodeProfileWindow(data->data(), data->size(), &window));
+  ASSERT_EQ(window.callstacks.size(), 1);
+  EXPECT_TRUE(window.callstacks.contains(2));
+
+  EXPECT_FALSE(profile.GetWindow(1000).has_value());
+}
+
+TEST(ContinuousProfile, EvictsTheOldestWindowsPastTheMemoryBudget) {
+  constexpr uint64_t kMaxMemoryBytes = 64 * 1024;
+  ContinuousProfile profile(kWindowNs, kMaxMemoryBytes, 0);
+  for (CallstackID id = 1; id <= 100; ++id) {
+    profile.AddCallstack(id, {0x1000 * id, 0x2000 * id, 0x3000 * id});
+  }
+  for (uint64_t time = 0; time < 1000 * kWindowNs; time += 10) {
+    profile.AddSamples(time, time % 7, 1 + time % 100, 1);
+  }
+  profile.Update(1000 * kWindowNs);
+
+  ContinuousProfile::Stats stats = profile.GetStats();
+  EXPECT_LE(stats.num_bytes, kMaxMemoryBytes);
+  EXPECT_GT(stats.num_evicted_windows, 0);
+  EXPECT_EQ(stats.num_windows + stats.num_evicted_windows, 1000);
+  EXPECT_EQ(stats.num_callstacks, 100);
+
+  // The most recent windows are kept.
+  std::vector<ContinuousWindowInfo> infos = profile.GetWindowInfos();
+  ASSERT_FALSE(infos.empty());
+  EXPECT_EQ(infos.back().begin_time, 999 * kWindowNs);
+  EXPECT_FALSE(profile.GetWindow(0).has_value());
+}
+
+TEST(ContinuousProfile, BoundsTheMemoryOfTheCallstacks) {
+  ContinuousProfile profile(kWindowNs, 64 * 1024, 0);
+  std::vector<uint64_t> frames(100, 0x1000);
+  for (CallstackID id = 1; id <= 1000; ++id) {
+    profile.AddCallstack(id, frames);
+  }
+  ContinuousProfile::Stats stats = profile.GetStats();
+  EXPECT_GT(stats.num_callstacks, 0);
+  EXPECT_LT(stats.num_callstacks, 1000);
+  EXPECT_LE(stats.num_bytes, 16 * 1024);
+}
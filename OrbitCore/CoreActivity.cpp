@@ -0,0 +1,139 @@
+#include "CoreActivity.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Message.h"
+#include "Varint.h"
+
+namespace {
+// Smallest encoding of an activity: a byte for each of the four varints.
+constexpr size_t kMinEncodedActivitySize = 4;
+}  // namespace
+
+Timer MakeCoreActivityTimer(const CoreActivity& activity) {
+  Timer timer;
+  timer.m_Start = activity.begin_time;
+  timer.m_End = activity.end_time;
+  timer.m_TID = activity.tid;
+  timer.m_Processor = static_cast<int8_t>(activity.core);
+  timer.m_SessionID = Message::GSessionID;
+  timer.SetType(Timer::CORE_ACTIVITY);
+  return timer;
+}
+
+void ContextSwitchPairer::AddSwitchIn(uint32_t tid, uint16_t core,
+                                      uint64_t time) {
+  std::deque<SwitchIn>& pending = pending_switches_in_[core];
+  auto it = std::upper_bound(
+      pending.begin(), pending.end(), time,
+      [](uint64_t switch_time, const SwitchIn& switch_in) {
+        return switch_time < switch_in.time;
+      });
+  pending.insert(it, SwitchIn{time, tid});
+  if (pending.size() > kMaxPendingSwitchesIn) {
+    pending.pop_front();
+  }
+}
+
+std::optional<CoreActivity> ContextSwitchPairer::AddSwitchOut(uint32_t tid,
+                                                              uint16_t core,
+                                                              uint64_t time) {
+  std::deque<SwitchIn>& pending = pending_switches_in_[core];
+  auto it = std::upper_bound(
+      pending.begin(), pending.end(), time,
+      [](uint64_t switch_time, const SwitchIn& switch_in) {
+        return switch_time < switch_in.time;
+      });
+  if (it == pending.begin()) {
+    return std::nullopt;
+  }
+  SwitchIn switch_in = *std::prev(it);
+  // The switches in before this one lost their switch out.
+  pending.erase(pending.begin(), it);
+  if (switch_in.tid != tid) {
+    return std::nullopt;
+  }
+  return CoreActivity{switch_in.time, time, tid, core};
+}
+
+std::string EncodeCoreActivities(const std::vector<CoreActivity>& activities) {
+  std::string output;
+  output.reserve(sizeof(CoreActivityBatchHeader) + 10 * activities.size());
+  CoreActivityBatchHeader header{CoreActivityBatchHeader::kVersion,
+                                 static_cast<uint32_t>(activities.size())};
+  output.append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  for (const CoreActivity& activity : activities) {
+    WriteVarint(activity.core, &output);
+  }
+  for (const CoreActivity& activity : activities) {
+    WriteVarint(activity.tid, &output);
+  }
+  for (const CoreActivity& activity : activities) {
+    WriteVarint(activity.end_time - activity.begin_time, &output);
+  }
+  absl::flat_hash_map<uint16_t, uint64_t> previous_ends;
+  for (const CoreActivity& activity : activities) {
+    uint64_t& previous_end = previous_ends[activity.core];
+    WriteVarint(ZigZagEncode(activity.begin_time - previous_end), &output);
+    previous_end = activity.end_time;
+  }
+  return output;
+}
+
+bool DecodeCoreActivities(const void* data, size_t size,
+                          std::vector<CoreActivity>* activities) {
+  CoreActivityBatchHeader header;
+  if (size < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  VarintReader reader(static_cast<const char*>(data) + sizeof(header),
+                      size - sizeof(header));
+  size_t num_activities = header.num_activities;
+  // Also guards the allocation below against corrupted sizes.
+  if (header.version != CoreActivityBatchHeader::kVersion ||
+      num_activities > reader.remaining() / kMinEncodedActivitySize) {
+    return false;
+  }
+
+  std::vector<CoreActivity> decoded(num_activities);
+  for (CoreActivity& activity : decoded) {
+    uint64_t value;
+    if (!reader.ReadVarint(&value) || value > UINT16_MAX) {
+      return false;
+    }
+    activity.core = static_cast<uint16_t>(value);
+  }
+  for (CoreActivity& activity : decoded) {
+    uint64_t value;
+    if (!reader.ReadVarint(&value)) {
+      return false;
+    }
+    activity.tid = static_cast<uint32_t>(value);
+  }
+  // The durations, kept in end_time until the begins are known.
+  for (CoreActivity& activity : decoded) {
+    if (!reader.ReadVarint(&activity.end_time)) {
+      return false;
+    }
+  }
+  absl::flat_hash_map<uint16_t, uint64_t> previous_ends;
+  for (CoreActivity& activity : decoded) {
+    uint64_t value;
+    if (!reader.ReadVarint(&value)) {
+      return false;
+    }
+    uint64_t& previous_end = previous_ends[activity.core];
+    activity.begin_time = previous_end + ZigZagDecode(value);
+    activity.end_time += activity.begin_time;
+    previous_end = activity.end_time;
+  }
+  if (reader.remaining() != 0) {
+    return false;
+  }
+
+  activities->insert(activities->end(), decoded.begin(), decoded.end());
+  return true;
+}
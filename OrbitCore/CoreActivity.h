@@ -0,0 +1,73 @@
+#ifndef ORBIT_CORE_CORE_ACTIVITY_H_
+#define ORBIT_CORE_CORE_ACTIVITY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "ScopeTimer.h"
+#include "absl/container/flat_hash_map.h"
+
+// A thread running on a core, from its switch in to its switch out. The
+// service pairs the context switches into these and sends them instead of the
+// switches, as Msg_RemoteCoreActivities, and the client shows them as
+// Timer::CORE_ACTIVITY timers, which hold the occupancy of both the cores and
+// the threads.
+struct CoreActivity {
+  uint64_t begin_time;
+  uint64_t end_time;
+  uint32_t tid;
+  uint16_t core;
+};
+
+Timer MakeCoreActivityTimer(const CoreActivity& activity);
+
+// Pairs the context switches of each core into CoreActivity.
+// The switches in and out don't have to be added in the order they happened:
+// BatchingTracerListener hands over the switches in of a period before its
+// switches out. A switch out is paired with the latest switch in of its core
+// that happened before it. Switches whose pair was lost are dropped.
+class ContextSwitchPairer {
+ public:
+  void AddSwitchIn(uint32_t tid, uint16_t core, uint64_t time);
+  // Returns the activity that the switch ends, if its switch in is known.
+  std::optional<CoreActivity> AddSwitchOut(uint32_t tid, uint16_t core,
+                                           uint64_t time);
+  void Clear() { pending_switches_in_.clear(); }
+
+  // Switches in kept per core while waiting for their switch out.
+  static constexpr size_t kMaxPendingSwitchesIn = 64;
+
+ private:
+  struct SwitchIn {
+    uint64_t time;
+    uint32_t tid;
+  };
+  // In time order.
+  absl::flat_hash_map<uint16_t, std::deque<SwitchIn>> pending_switches_in_;
+};
+
+// Compact encoding of the batches of Msg_RemoteCoreActivities, about a fourth
+// of the size of the two ContextSwitch structs they replace:
+// - a header with the version and the number of activities;
+// - the cores and the thread ids, as varints;
+// - the duration of each activity, as a varint, and its begin, as a zigzag
+//   varint delta from the end of the previous activity of the same core.
+// The order of the activities is preserved.
+struct CoreActivityBatchHeader {
+  static constexpr uint32_t kVersion = 1;
+  uint32_t version;
+  uint32_t num_activities;
+};
+
+std::string EncodeCoreActivities(const std::vector<CoreActivity>& activities);
+
+// Appends the decoded activities to activities. Returns false, and leaves
+// activities unchanged, if data is not a valid encoding of this version.
+bool DecodeCoreActivities(const void* data, size_t size,
+                          std::vector<CoreActivity>* activities);
+
+#endif  // ORBIT_CORE_CORE_ACTIVITY_H_
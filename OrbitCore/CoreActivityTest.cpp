@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "CoreActivity.h"
+
+namespace {
+void ExpectEqual(const CoreActivity& actual, const CoreActivity& expected) {
+  EXPECT_EQ(actual.begin_time, expected.begin_time);
+  EXPECT_EQ(actual.end_time, expected.end_time);
+  EXPECT_EQ(actual.tid, expected.tid);
+  EXPECT_EQ(actual.core, expected.core);
+}
+}  // namespace
+
+TEST(ContextSwitchPairer, PairsSwitchesOfEachCore) {
+  ContextSwitchPairer pairer;
+  pairer.AddSwitchIn(10, 0, 100);
+  pairer.AddSwitchIn(20, 1, 110);
+
+  std::optional<CoreActivity> activity = pairer.AddSwitchOut(20, 1, 150);
+  ASSERT_TRUE(activity.has_value());
+  ExpectEqual(activity.value(), CoreActivity{110, 150, 20, 1});
+
+  activity = pairer.AddSwitchOut(10, 0, 200);
+  ASSERT_TRUE(activity.has_value());
+  ExpectEqual(activity.value(), CoreActivity{100, 200, 10, 0});
+
+  // Already paired.
+  EXPECT_FALSE(pairer.AddSwitchOut(10, 0, 210).has_value());
+}
+
+TEST(ContextSwitchPairer, SwitchesInBeforeSwitchesOut) {
+  // As handed over by BatchingTracerListener.
+  ContextSwitchPairer pairer;
+  pairer.AddSwitchIn(10, 0, 100);
+  pairer.AddSwitchIn(20, 0, 300);
+
+  std::optional<CoreActivity> activity = pairer.AddSwitchOut(10, 0, 200);
+  ASSERT_TRUE(activity.has_value());
+  ExpectEqual(activity.value(), CoreActivity{100, 200, 10, 0});
+
+  activity = pairer.AddSwitchOut(20, 0, 400);
+  ASSERT_TRUE(activity.has_value());
+  ExpectEqual(activity.value(), CoreActivity{300, 400, 20, 0});
+}
+
+TEST(ContextSwitchPairer, DropsSwitchesWithoutPair) {
+  ContextSwitchPairer pairer;
+  EXPECT_FALSE(pairer.AddSwitchOut(10, 0, 50).has_value());
+
+  // The switch out of thread 10 was lost.
+  pairer.AddSwitchIn(10, 0, 100);
+  pairer.AddSwitchIn(20, 0, 200);
+  std::optional<CoreActivity> activity = pairer.AddSwitchOut(20, 0, 300);
+  ASSERT_TRUE(activity.has_value());
+  ExpectEqual(activity.value(), CoreActivity{200, 300, 20, 0});
+  EXPECT_FALSE(pairer.AddSwitchOut(10, 0, 400).has_value());
+
+  // The switch in of thread 30 was lost.
+  pairer.AddSwitchIn(40, 0, 500);
+  EXPECT_FALSE(pairer.AddSwitchOut(30, 0, 600).has_value());
+  EXPECT_FALSE(pairer.AddSwitchOut(40, 0, 700).has_value());
+}
+
+TEST(ContextSwitchPairer, Clear) {
+  ContextSwitchPairer pairer;
+  pairer.AddSwitchIn(10, 0, 100);
+  pairer.Clear();
+  EXPECT_FALSE(pairer.AddSwitchOut(10, 0, 200).has_value());
+}
+
+TEST(CoreActivity, MakeCoreActivityTimer) {
+  Timer timer = MakeCoreActivityTimer(CoreActivity{100, 200, 10, 3});
+  EXPECT_EQ(timer.m_Type, Timer::CORE_ACTIVITY);
+  EXPECT_EQ(timer.m_Start, 100);
+  EXPECT_EQ(timer.m_End, 200);
+  EXPECT_EQ(timer.m_TID, 10);
+  EXPECT_EQ(timer.m_Processor, 3);
+}
+
+TEST(CoreActivity, RoundTrip) {
+  std::vector<CoreActivity> activities = {
+      {1'000'000, 1'000'500, 10, 0},
+      {1'000'100, 1'000'900, 20, 127},
+      {1'000'600, 1'000'700, 30, 0},
+      // Overlapping with the previous activity of the core.
+      {1'000'650, 1'000'800, 10, 0},
+      {0, ~0ULL, ~0U, UINT16_MAX},
+  };
+  std::string data = EncodeCoreActivities(activities);
+
+  std::vector<CoreActivity> decoded = {{1, 2, 3, 4}};
+  ASSERT_TRUE(DecodeCoreActivities(data.data(), data.size(), &decoded));
+  ASSERT_EQ(decoded.size(), activities.size() + 1);
+  for (size_t i = 0; i < activities.size(); ++i) {
+    ExpectEqual(decoded[i + 1], activities[i]);
+  }
+}
+
+TEST(CoreActivity, IsSmallerThanContextSwitches) {
+  std::vector<CoreActivity> activities;
+  for (uint64_t i = 0; i < 1000; ++i) {
+    activities.push_back(CoreActivity{1'000'000'000 + 10'000 * i,
+                                      1'000'000'000 + 10'000 * i + 5'000,
+                                      static_cast<uint32_t>(1000 + i % 7),
+                                      static_cast<uint16_t>(i % 128)});
+  }
+  std::string data = EncodeCoreActivities(activities);
+  EXPECT_LT(data.size(), activities.size() * 2 * 19 / 4);
+}
+
+TEST(CoreActivity, Empty) {
+  std::string data = EncodeCoreActivities({});
+  std::vector<CoreActivity> decoded;
+  ASSERT_TRUE(DecodeCoreActivities(data.data(), data.size(), &decoded));
+  EXPECT_TRUE(decoded.empty());
+}
+
+TEST(CoreActivity, RejectsCorruptedData) {
+  std::vector<CoreActivity> activities = {{100, 200, 10, 0},
+                                          {300, 400, 20, 1}};
+  std::string data = EncodeCoreActivities(activities);
+  std::vector<CoreActivity> decoded;
+
+  EXPECT_FALSE(DecodeCoreActivities(data.data(), 4, &decoded));
+  for (size_t size = sizeof(CoreActivityBatchHeader); size < data.size();
+       ++size) {
+    EXPECT_FALSE(DecodeCoreActivities(data.data(), size, &decoded));
+  }
+  std::string longer = data + "x";
+  EXPECT_FALSE(DecodeCoreActivities(longer.data(), longer.size(), &decoded));
+
+  std::string other_version = data;
+  other_version[0] = 2;
+  EXPECT_FALSE(DecodeCoreActivities(other_version.data(),
+                                    other_version.size(), &decoded));
+  EXPECT_TRUE(decoded.empty());
+}
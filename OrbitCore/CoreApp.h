@@ -9,6 +9,7 @@
 #include <vector>
 
 #include "BaseTypes.h"
+#include "absl/types/span.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -18,7 +19,10 @@ class Timer;
 class LinuxCallstackEvent;
 struct CallStack;
 struct ContextSwitch;
+struct ThreadStateChange;
 struct CallstackEvent;
+struct KernelFrameSymbol;
+struct ThreadNameKey;
 
 class CoreApp {
  public:
@@ -39,11 +43,24 @@ class CoreApp {
   virtual void ProcessSamplingCallStack(LinuxCallstackEvent& /*a_CS*/) {}
   virtual void ProcessHashedSamplingCallStack(CallstackEvent& /*a_CallStack*/) {
   }
+  // Samples of a message at once, with the callstacks they are the first
+  // samples of.
+  virtual void ProcessSamplingCallStacks(
+      absl::Span<const CallstackEvent> /*a_Events*/,
+      absl::Span<CallStack> /*a_NewCallStacks*/) {}
+  // Callstacks at which threads blocked, with how long they stayed blocked.
+  virtual void ProcessOffCpuCallstacks(
+      absl::Span<const CallStack> /*a_CallStacks*/,
+      absl::Span<const uint64_t> /*a_DurationsNs*/) {}
   virtual void ProcessCallStack(CallStack& /*a_CallStack*/) {}
   virtual void ProcessContextSwitch(const ContextSwitch& /*a_ContextSwitch*/) {}
+  virtual void ProcessThreadStateChange(
+      const ThreadStateChange& /*thread_state_change*/) {}
   virtual void AddSymbol(uint64_t /*a_Address*/,
                          const std::string& /*a_Module*/,
                          const std::string& /*a_Name*/) {}
+  virtual void AddKernelFrameSymbol(const KernelFrameSymbol& /*symbol*/) {}
+  virtual void AddThreadName(const ThreadNameKey& /*thread_name*/) {}
   virtual void AddKeyAndString(uint64_t key, std::string_view str) {}
   virtual const std::unordered_map<DWORD64, std::shared_ptr<class Rule> >*
   GetRules() {
@@ -0,0 +1,118 @@
+#include "CounterSeries.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+void Merge(const CounterSeries::Range& range, CounterSeries::Range* result) {
+  result->min = std::min(result->min, range.min);
+  result->max = std::max(result->max, range.max);
+}
+}  // namespace
+
+void CounterSeries::Add(uint64_t time, double value) {
+  if (times_.empty() || time >= times_.back()) {
+    times_.push_back(time);
+    values_.push_back(value);
+    UpdateBlocks(times_.size() - 1);
+    return;
+  }
+
+  // After the values of the same time, which keep their order.
+  size_t index =
+      std::upper_bound(times_.begin(), times_.end(), time) - times_.begin();
+  times_.insert(times_.begin() + index, time);
+  values_.insert(values_.begin() + index, value);
+  UpdateBlocks(index);
+}
+
+void CounterSeries::Clear() {
+  times_.clear();
+  values_.clear();
+  levels_.clear();
+}
+
+size_t CounterSeries::GetLevelSize(size_t level) const {
+  return level == 0 ? values_.size() : levels_[level - 1].size();
+}
+
+CounterSeries::Range CounterSeries::GetLevelRange(size_t level,
+                                                  size_t index) const {
+  if (level == 0) return {values_[index], values_[index]};
+  return levels_[level - 1][index];
+}
+
+void CounterSeries::UpdateBlocks(size_t first_value) {
+  size_t first = first_value;
+  for (size_t level = 1; GetLevelSize(level - 1) > kBlockSize; ++level) {
+    if (levels_.size() < level) levels_.emplace_back();
+    std::vector<Range>& blocks = levels_[level - 1];
+    first /= kBlockSize;
+    blocks.resize(first);
+
+    size_t below_size = GetLevelSize(level - 1);
+    for (size_t block = first; block * kBlockSize < below_size; ++block) {
+      size_t begin = block * kBlockSize;
+      size_t end = std::min(begin + kBlockSize, below_size);
+      Range range = GetLevelRange(level - 1, begin);
+      for (size_t i = begin + 1; i < end; ++i) {
+        Merge(GetLevelRange(level - 1, i), &range);
+      }
+      blocks.push_back(range);
+    }
+  }
+}
+
+std::pair<size_t, size_t> CounterSeries::GetValuesInRange(
+    uint64_t min_time, uint64_t max_time) const {
+  size_t first =
+      std::lower_bound(times_.begin(), times_.end(), min_time) - times_.begin();
+  size_t last =
+      std::upper_bound(times_.begin(), times_.end(), max_time) - times_.begin();
+  return {first, std::max(first, last)};
+}
+
+CounterSeries::Range CounterSeries::GetRange(size_t first, size_t last) const {
+  Range range{std::numeric_limits<double>::infinity(),
+              -std::numeric_limits<double>::infinity()};
+  // The partial blocks at both ends are merged at their level, the whole
+  // blocks between them one level up.
+  for (size_t level = 0; first < last; ++level) {
+    if (level == levels_.size() || last - first <= kBlockSize) {
+      for (size_t i = first; i < last; ++i) {
+        Merge(GetLevelRange(level, i), &range);
+      }
+      break;
+    }
+    for (; first < last && first % kBlockSize != 0; ++first) {
+      Merge(GetLevelRange(level, first), &range);
+    }
+    for (; last > first && last % kBlockSize != 0; --last) {
+      Merge(GetLevelRange(level, last - 1), &range);
+    }
+    first /= kBlockSize;
+    last /= kBlockSize;
+  }
+  return range;
+}
+
+CounterSeries::Range CounterSeries::GetRange() const {
+  return empty() ? Range{} : GetRange(0, size());
+}
+
+std::vector<CounterSeries::Column> CounterSeries::GetColumns(
+    uint64_t min_time, uint64_t max_time, uint64_t ticks_per_column) const {
+  std::pair<size_t, size_t> values = GetValuesInRange(min_time, max_time);
+  ticks_per_column = std::max<uint64_t>(ticks_per_column, 1);
+  std::vector<Column> columns;
+  for (size_t i = values.first; i < values.second;) {
+    uint64_t column_end = times_[i] + ticks_per_column;
+    size_t next = std::lower_bound(times_.begin() + i + 1,
+                                   times_.begin() + values.second,
+                                   column_end) -
+                  times_.begin();
+    columns.push_back({times_[i], times_[next - 1], GetRange(i, next)});
+    i = next;
+  }
+  return columns;
+}
@@ -0,0 +1,70 @@
+#ifndef ORBIT_CORE_COUNTER_SERIES_H_
+#define ORBIT_CORE_COUNTER_SERIES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// The values of a tracked variable over time, as plotted on a counter track.
+// The values are kept sorted by time, with the min and max of each block of
+// kBlockSize values, of each block of kBlockSize of these blocks, and so on.
+// The min and max of any range of values are then found in
+// O(kBlockSize * log n), so that a view of millions of values is decimated
+// into a min and a max per pixel column without going through all of them.
+// Not thread-safe.
+class CounterSeries {
+ public:
+  static constexpr size_t kBlockSize = 16;
+
+  struct Range {
+    double min = 0;
+    double max = 0;
+  };
+
+  // The values of the columns of GetColumns.
+  struct Column {
+    // Of the first and the last value of the column.
+    uint64_t begin_time = 0;
+    uint64_t end_time = 0;
+    Range range;
+  };
+
+  // Values are expected mostly in order of time: a value added before the
+  // last one costs updating the blocks after it.
+  void Add(uint64_t time, double value);
+  void Clear();
+
+  size_t size() const { return times_.size(); }
+  bool empty() const { return times_.empty(); }
+  uint64_t GetTime(size_t index) const { return times_[index]; }
+  double GetValue(size_t index) const { return values_[index]; }
+
+  // The values in [min_time, max_time], as [first, last).
+  std::pair<size_t, size_t> GetValuesInRange(uint64_t min_time,
+                                             uint64_t max_time) const;
+  // Of the values [first, last), which is not empty.
+  Range GetRange(size_t first, size_t last) const;
+  // Of all the values, {0, 0} if there are none.
+  Range GetRange() const;
+  // The values in [min_time, max_time], by columns starting at a value and
+  // spanning ticks_per_column, so that there are at most as many columns as
+  // there are pixel columns in the view.
+  std::vector<Column> GetColumns(uint64_t min_time, uint64_t max_time,
+                                 uint64_t ticks_per_column) const;
+
+ private:
+  // Recomputes the blocks of the values from first_value on, and adds the
+  // levels of blocks needed for the values added.
+  void UpdateBlocks(size_t first_value);
+  size_t GetLevelSize(size_t level) const;
+  Range GetLevelRange(size_t level, size_t index) const;
+
+  std::vector<uint64_t> times_;
+  std::vector<double> values_;
+  // Level l + 1 has the ranges of the blocks of level l, level 0 being the
+  // values themselves.
+  std::vector<std::vector<Range>> levels_;
+};
+
+#endif  // ORBIT_CORE_COUNTER_SERIES_H_
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "CounterSeries.h"
+
+namespace {
+CounterSeries::Range BruteForceRange(const CounterSeries& series, size_t first,
+                                     size_t last) {
+  CounterSeries::Range range{series.GetValue(first), series.GetValue(first)};
+  for (size_t i = first; i < last; ++i) {
+    range.min = std::min(range.min, series.GetValue(i));
+    range.max = std::max(range.max, series.GetValue(i));
+  }
+  return range;
+}
+}  // namespace
+
+TEST(CounterSeries, KeepsValuesSortedByTime) {
+  CounterSeries series;
+  series.Add(100, 1.0);
+  series.Add(300, 3.0);
+  series.Add(200, 2.0);
+  series.Add(300, 4.0);
+  ASSERT_EQ(series.size(), 4);
+  EXPECT_EQ(series.GetTime(1), 200);
+  EXPECT_EQ(series.GetValue(2), 3.0);
+  EXPECT_EQ(series.GetValue(3), 4.0);
+
+  using ValueRange = std::pair<size_t, size_t>;
+  EXPECT_EQ(series.GetValuesInRange(150, 300), (ValueRange{1, 4}));
+  EXPECT_EQ(series.GetValuesInRange(400, 500), (ValueRange{4, 4}));
+  CounterSeries::Range range = series.GetRange();
+  EXPECT_EQ(range.min, 1.0);
+  EXPECT_EQ(range.max, 4.0);
+}
+
+TEST(CounterSeries, RangesOfManyValuesMatchBruteForce) {
+  std::mt19937 random(42);
+  std::uniform_real_distribution<double> value(-1000.0, 1000.0);
+  CounterSeries series;
+  for (uint64_t i = 0; i < 20'000; ++i) {
+    // Every 100th value comes late.
+    uint64_t time = i % 100 == 99 ? 10 * (i - 50) + 5 : 10 * i;
+    series.Add(time, value(random));
+  }
+  for (size_t i = 1; i < series.size(); ++i) {
+    ASSERT_LE(series.GetTime(i - 1), series.GetTime(i));
+  }
+
+  std::uniform_int_distribution<size_t> index(0, series.size() - 1);
+  for (int i = 0; i < 1000; ++i) {
+    size_t first = index(random);
+    size_t last = std::min(first + 1 + index(random) % 5000, series.size());
+    CounterSeries::Range range = series.GetRange(first, last);
+    CounterSeries::Range expected = BruteForceRange(series, first, last);
+    ASSERT_EQ(range.min, expected.min) << first << " " << last;
+    ASSERT_EQ(range.max, expected.max) << first << " " << last;
+  }
+}
+
+TEST(CounterSeries, ColumnsDecimateTheValuesOfTheView) {
+  CounterSeries series;
+  for (uint64_t i = 0; i < 1'000'000; ++i) {
+    series.Add(i, std::sin(i * 0.001));
+  }
+
+  std::vector<CounterSeries::Column> columns =
+      series.GetColumns(100'000, 199'999, 1000);
+  ASSERT_EQ(columns.size(), 100);
+  for (const CounterSeries::Column& column : columns) {
+    EXPECT_EQ(column.end_time - column.begin_time, 999);
+    // The time of each value is its index.
+    CounterSeries::Range expected =
+        BruteForceRange(series, column.begin_time, column.end_time + 1);
+    EXPECT_EQ(column.range.min, expected.min);
+    EXPECT_EQ(column.range.max, expected.max);
+  }
+  // Columns start at a value: the gaps without values have none.
+  series.Add(5'000'000, 2.0);
+  columns = series.GetColumns(999'500, 10'000'000, 1000);
+  ASSERT_EQ(columns.size(), 2);
+  EXPECT_EQ(columns[1].begin_time, 5'000'000);
+  EXPECT_EQ(columns[1].range.max, 2.0);
+}
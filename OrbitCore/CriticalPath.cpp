@@ -0,0 +1,27 @@
+#include "CriticalPath.h"
+
+#include <algorithm>
+
+std::vector<CriticalPathSegment> ComputeCriticalPath(
+    uint32_t thread_id, uint64_t begin, uint64_t end,
+    const GetThreadStateBefore& get_thread_state_before) {
+  std::vector<CriticalPathSegment> path;
+  uint64_t time = end;
+  // Each slice starts strictly before time, so time decreases at each step.
+  while (time > begin) {
+    std::optional<ThreadStateTimeline::Slice> slice =
+        get_thread_state_before(thread_id, time);
+    if (!slice.has_value()) {
+      break;
+    }
+    uint64_t segment_begin = std::max(slice->begin, begin);
+    path.push_back({thread_id, segment_begin, time, slice->state});
+    time = segment_begin;
+    if (slice->state == ThreadStateChange::kRunnable &&
+        slice->waker_thread_id != 0) {
+      thread_id = slice->waker_thread_id;
+    }
+  }
+  std::reverse(path.begin(), path.end());
+  return path;
+}
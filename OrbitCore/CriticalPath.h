@@ -0,0 +1,41 @@
+#ifndef ORBIT_CORE_CRITICAL_PATH_H_
+#define ORBIT_CORE_CRITICAL_PATH_H_
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "ThreadStateTimeline.h"
+
+// A part of a critical path: thread_id was in state in [begin, end), and what
+// the path ends with waited for it.
+struct CriticalPathSegment {
+  uint32_t thread_id;
+  uint64_t begin;
+  uint64_t end;
+  ThreadStateChange::State state;
+};
+
+// The state of thread_id right before time, as ThreadStateTimeline::
+// GetSliceBefore, or std::nullopt if unknown, e.g., for a thread that was not
+// traced.
+using GetThreadStateBefore =
+    std::function<std::optional<ThreadStateTimeline::Slice>(uint32_t thread_id,
+                                                            uint64_t time)>;
+
+// The critical path of what thread_id did in [begin, end): walking back in
+// time from end, the time thread_id spent running or waiting for a core is on
+// the path, and when it was made runnable by a wakeup, the path follows the
+// waker from the time of the wakeup on, as the time thread_id spent blocked
+// before was spent waiting for the waker. A blocked slice whose wakeup has no
+// known waker stays on the path as blocked time. The path stops at begin, or
+// where the state of the thread it follows is unknown.
+// Each step is a lookup of the state of one thread, so the cost only depends
+// on the length of the path and, logarithmically, on the number of state
+// changes. Returns the segments in order of time.
+std::vector<CriticalPathSegment> ComputeCriticalPath(
+    uint32_t thread_id, uint64_t begin, uint64_t end,
+    const GetThreadStateBefore& get_thread_state_before);
+
+#endif  // ORBIT_CORE_CRITICAL_PATH_H_
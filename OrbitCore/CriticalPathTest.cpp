@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <vector>
+
+#include "CriticalPath.h"
+
+namespace {
+class Timelines {
+ public:
+  void Add(uint32_t thread_id, uint64_t time, ThreadStateChange::State state,
+           uint32_t waker_thread_id = 0) {
+    ThreadStateChange change;
+    change.time = time;
+    change.thread_id = thread_id;
+    change.waker_thread_id = waker_thread_id;
+    change.state = state;
+    timelines_[thread_id].Add(change);
+  }
+
+  std::vector<CriticalPathSegment> Compute(uint32_t thread_id, uint64_t begin,
+                                           uint64_t end) const {
+    return ComputeCriticalPath(
+        thread_id, begin, end,
+        [this](uint32_t thread_id, uint64_t time)
+            -> std::optional<ThreadStateTimeline::Slice> {
+          auto it = timelines_.find(thread_id);
+          if (it == timelines_.end()) return std::nullopt;
+          return it->second.GetSliceBefore(time);
+        });
+  }
+
+ private:
+  std::map<uint32_t, ThreadStateTimeline> timelines_;
+};
+
+void ExpectSegment(const CriticalPathSegment& segment, uint32_t thread_id,
+                   uint64_t begin, uint64_t end,
+                   ThreadStateChange::State state) {
+  EXPECT_EQ(segment.thread_id, thread_id);
+  EXPECT_EQ(segment.begin, begin);
+  EXPECT_EQ(segment.end, end);
+  EXPECT_EQ(segment.state, state);
+}
+}  // namespace
+
+TEST(CriticalPath, FollowsWakers) {
+  Timelines timelines;
+  // 1 blocks at 100 until 3 wakes it up at 300. 3 was itself blocked until 2
+  // woke it up at 200.
+  timelines.Add(1, 0, ThreadStateChange::kRunning);
+  timelines.Add(1, 100, ThreadStateChange::kInterruptibleSleep);
+  timelines.Add(1, 300, ThreadStateChange::kRunnable, 3);
+  timelines.Add(1, 320, ThreadStateChange::kRunning);
+  timelines.Add(2, 0, ThreadStateChange::kRunning);
+  timelines.Add(3, 0, ThreadStateChange::kInterruptibleSleep);
+  timelines.Add(3, 200, ThreadStateChange::kRunnable, 2);
+  timelines.Add(3, 210, ThreadStateChange::kRunning);
+
+  std::vector<CriticalPathSegment> path = timelines.Compute(1, 50, 400);
+  ASSERT_EQ(path.size(), 5);
+  ExpectSegment(path[0], 2, 50, 200, ThreadStateChange::kRunning);
+  ExpectSegment(path[1], 3, 200, 210, ThreadStateChange::kRunnable);
+  ExpectSegment(path[2], 3, 210, 300, ThreadStateChange::kRunning);
+  ExpectSegment(path[3], 1, 300, 320, ThreadStateChange::kRunnable);
+  ExpectSegment(path[4], 1, 320, 400, ThreadStateChange::kRunning);
+}
+
+TEST(CriticalPath, StaysOnPreemptedAndUnknownWakeups) {
+  Timelines timelines;
+  timelines.Add(1, 0, ThreadStateChange::kRunning);
+  timelines.Add(1, 100, ThreadStateChange::kUninterruptibleSleep);
+  timelines.Add(1, 200, ThreadStateChange::kRunnable);
+  timelines.Add(1, 250, ThreadStateChange::kRunning);
+
+  std::vector<CriticalPathSegment> path = timelines.Compute(1, 0, 300);
+  ASSERT_EQ(path.size(), 4);
+  ExpectSegment(path[0], 1, 0, 100, ThreadStateChange::kRunning);
+  ExpectSegment(path[1], 1, 100, 200,
+                ThreadStateChange::kUninterruptibleSleep);
+  ExpectSegment(path[2], 1, 200, 250, ThreadStateChange::kRunnable);
+  ExpectSegment(path[3], 1, 250, 300, ThreadStateChange::kRunning);
+}
+
+TEST(CriticalPath, StopsAtUntracedWakers) {
+  Timelines timelines;
+  timelines.Add(1, 0, ThreadStateChange::kInterruptibleSleep);
+  timelines.Add(1, 100, ThreadStateChange::kRunnable, 7);
+  timelines.Add(1, 110, ThreadStateChange::kRunning);
+
+  std::vector<CriticalPathSegment> path = timelines.Compute(1, 0, 200);
+  ASSERT_EQ(path.size(), 2);
+  ExpectSegment(path[0], 1, 100, 110, ThreadStateChange::kRunnable);
+  ExpectSegment(path[1], 1, 110, 200, ThreadStateChange::kRunning);
+
+  EXPECT_TRUE(timelines.Compute(2, 0, 200).empty());
+}
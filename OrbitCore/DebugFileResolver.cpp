@@ -0,0 +1,163 @@
+#include "DebugFileResolver.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <set>
+#include <utility>
+
+#include "ElfFile.h"
+#include "Path.h"
+#include "PrintVar.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+
+namespace {
+// The build ids being downloaded, by any resolver.
+std::mutex downloads_mutex;
+std::condition_variable download_done;
+std::set<std::string> downloads;
+
+bool IsDebugFileFor(const ElfFile* file, const std::string& build_id) {
+  return file != nullptr && file->HasSymtab() &&
+         file->GetBuildId() == build_id;
+}
+
+std::unique_ptr<ElfFile> OpenDebugFile(const std::string& path,
+                                       const std::string& build_id) {
+  if (!Path::FileExists(path)) {
+    return nullptr;
+  }
+  std::unique_ptr<ElfFile> file = ElfFile::Create(path);
+  if (!IsDebugFileFor(file.get(), build_id)) {
+    return nullptr;
+  }
+  return file;
+}
+
+std::string WithTrailingSlash(const std::string& directory) {
+  if (directory.empty() || directory.back() == '/') {
+    return directory;
+  }
+  return directory + "/";
+}
+
+// The build id and the paths end up in a shell command.
+bool IsSafeForShell(const std::string& value) {
+  return value.find('\'') == std::string::npos;
+}
+}  // namespace
+
+DebugFileResolver::DebugFileResolver(std::vector<std::string> directories,
+                                     std::vector<std::string> servers,
+                                     std::string cache_directory)
+    : directories_(std::move(directories)),
+      servers_(std::move(servers)),
+      cache_directory_(WithTrailingSlash(cache_directory)) {}
+
+std::unique_ptr<ElfFile> DebugFileResolver::Resolve(
+    const std::string& module_path, const std::string& build_id) const {
+  if (build_id.empty()) {
+    return nullptr;
+  }
+
+  std::vector<std::string> paths = {cache_directory_ + build_id + ".debug"};
+  std::string module_directory = Path::GetDirectory(module_path);
+  std::string name = Path::StripExtension(Path::GetFileName(module_path));
+  std::vector<std::string> directories = {module_directory,
+                                          module_directory + "debug_symbols/"};
+  for (const std::string& directory : directories_) {
+    directories.push_back(WithTrailingSlash(directory));
+  }
+  for (const std::string& directory : directories) {
+    paths.push_back(directory + name + ".debug");
+    paths.push_back(directory + name + ".elf.debug");
+    paths.push_back(directory + ".build-id/" + GetBuildIdPath(build_id));
+  }
+  for (const std::string& path : paths) {
+    std::unique_ptr<ElfFile> file = OpenDebugFile(path, build_id);
+    if (file != nullptr) {
+      return file;
+    }
+  }
+
+  if (servers_.empty()) {
+    return nullptr;
+  }
+  {
+    std::unique_lock<std::mutex> lock(downloads_mutex);
+    if (downloads.count(build_id) != 0) {
+      download_done.wait(lock, [&] { return downloads.count(build_id) == 0; });
+      lock.unlock();
+      return OpenDebugFile(paths[0], build_id);
+    }
+    downloads.insert(build_id);
+  }
+  std::unique_ptr<ElfFile> file = Download(build_id);
+  {
+    std::lock_guard<std::mutex> lock(downloads_mutex);
+    downloads.erase(build_id);
+  }
+  download_done.notify_all();
+  return file;
+}
+
+std::unique_ptr<ElfFile> DebugFileResolver::Download(
+    const std::string& build_id) const {
+  std::string path = cache_directory_ + build_id + ".debug";
+  std::string temp_path = path + ".tmp";
+  if (build_id.find_first_not_of("0123456789abcdef") != std::string::npos ||
+      !IsSafeForShell(cache_directory_)) {
+    return nullptr;
+  }
+
+  for (std::string server : servers_) {
+    if (!IsSafeForShell(server)) {
+      PRINT(absl::StrFormat("Ignoring symbol server \"%s\"\n", server));
+      continue;
+    }
+    while (!server.empty() && server.back() == '/') {
+      server.pop_back();
+    }
+    std::string url = server + "/buildid/" + build_id + "/debuginfo";
+    std::string command = absl::StrFormat(
+        "curl --silent --fail --location --output '%s' '%s'", temp_path, url);
+    if (std::system(command.c_str()) != 0) {
+      std::remove(temp_path.c_str());
+      continue;
+    }
+    if (OpenDebugFile(temp_path, build_id) == nullptr) {
+      PRINT(absl::StrFormat("Invalid debug file for %s from %s\n", build_id,
+                            server));
+      std::remove(temp_path.c_str());
+      continue;
+    }
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+      std::remove(temp_path.c_str());
+      return nullptr;
+    }
+    return OpenDebugFile(path, build_id);
+  }
+  return nullptr;
+}
+
+std::string DebugFileResolver::GetBuildIdPath(const std::string& build_id) {
+  if (build_id.size() <= 2) {
+    return build_id + ".debug";
+  }
+  return build_id.substr(0, 2) + "/" + build_id.substr(2) + ".debug";
+}
+
+std::vector<std::string> DebugFileResolver::ParseList(
+    const std::string& list) {
+  std::vector<std::string> result;
+  for (absl::string_view item : absl::StrSplit(list, ',')) {
+    item = absl::StripAsciiWhitespace(item);
+    if (!item.empty()) {
+      result.emplace_back(item);
+    }
+  }
+  return result;
+}
@@ -0,0 +1,50 @@
+#ifndef ORBIT_CORE_DEBUG_FILE_RESOLVER_H_
+#define ORBIT_CORE_DEBUG_FILE_RESOLVER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class ElfFile;
+
+// Finds the separate debug file of a stripped module by its build id: in the
+// symbol cache first, then next to the module, then in each of directories,
+// both as <directory>/<module name>.debug and as in the .build-id layout of
+// /usr/lib/debug, see GetBuildIdPath, then on each of servers. Servers are
+// debuginfod servers, or any URL curl can fetch from with the same layout,
+// queried at <server>/buildid/<build id>/debuginfo. A download is streamed to
+// the symbol cache under the build id, next to its final name, and only
+// renamed to it once complete and checked, so that every module of the same
+// build then finds it there. A file is only returned if it has a symbol table
+// and the build id of the module.
+//
+// Resolve is meant to be called for several modules at the same time, their
+// symbols then becoming available as each one is found rather than after all
+// of them. Only one of concurrent calls for the same build id downloads it,
+// the others wait for it.
+class DebugFileResolver {
+ public:
+  DebugFileResolver(std::vector<std::string> directories,
+                    std::vector<std::string> servers,
+                    std::string cache_directory);
+
+  // Returns nullptr if no debug file is found for the module at module_path,
+  // or if build_id is empty.
+  std::unique_ptr<ElfFile> Resolve(const std::string& module_path,
+                                   const std::string& build_id) const;
+
+  // The path of the debug file for build_id under the .build-id directory,
+  // e.g., "ab/cdef0123.debug" for "abcdef0123".
+  static std::string GetBuildIdPath(const std::string& build_id);
+  // Splits a comma-separated list of directories or servers.
+  static std::vector<std::string> ParseList(const std::string& list);
+
+ private:
+  std::unique_ptr<ElfFile> Download(const std::string& build_id) const;
+
+  std::vector<std::string> directories_;
+  std::vector<std::string> servers_;
+  std::string cache_directory_;
+};
+
+#endif  // ORBIT_CORE_DEBUG_FILE_RESOLVER_H_
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DebugFileResolver.h"
+#include "ElfFile.h"
+#include "Path.h"
+
+namespace {
+std::string GetTestDataPath(const std::string& name) {
+  return Path::GetExecutablePath() + "testdata/" + name;
+}
+
+void CopyFile(const std::string& from, const std::string& to) {
+  std::ifstream input(from, std::ios::binary);
+  std::ofstream output(to, std::ios::binary | std::ios::trunc);
+  output << input.rdbuf();
+}
+}  // namespace
+
+TEST(DebugFileResolver, GetBuildIdPath) {
+  EXPECT_EQ(DebugFileResolver::GetBuildIdPath("abcdef0123"),
+            "ab/cdef0123.debug");
+}
+
+TEST(DebugFileResolver, ParseList) {
+  EXPECT_TRUE(DebugFileResolver::ParseList("").empty());
+  EXPECT_EQ(DebugFileResolver::ParseList(" /usr/lib/debug, ,/opt/debug "),
+            (std::vector<std::string>{"/usr/lib/debug", "/opt/debug"}));
+}
+
+TEST(DebugFileResolver, FindsDebugFileNextToModule) {
+  const std::string module_path = GetTestDataPath("no_symbols_elf");
+  std::string build_id = ElfFile::Create(module_path)->GetBuildId();
+  ASSERT_FALSE(build_id.empty());
+
+  DebugFileResolver resolver({}, {}, testing::TempDir());
+  std::unique_ptr<ElfFile> file = resolver.Resolve(module_path, build_id);
+  ASSERT_NE(file, nullptr);
+  EXPECT_EQ(file->GetFilePath(), GetTestDataPath("no_symbols_elf.debug"));
+
+  EXPECT_EQ(resolver.Resolve(module_path, "0123"), nullptr);
+  EXPECT_EQ(resolver.Resolve(module_path, ""), nullptr);
+}
+
+TEST(DebugFileResolver, FindsDebugFileByBuildId) {
+  std::string build_id =
+      ElfFile::Create(GetTestDataPath("no_symbols_elf"))->GetBuildId();
+  ASSERT_GT(build_id.size(), 2);
+
+  // The module isn't next to its debug file, which has another name.
+  std::string directory = testing::TempDir() + "DebugFileResolverTest/";
+  std::string build_id_directory =
+      directory + ".build-id/" + build_id.substr(0, 2) + "/";
+  Path::MakeDir(directory);
+  Path::MakeDir(directory + ".build-id/");
+  Path::MakeDir(build_id_directory);
+  std::string debug_path =
+      directory + ".build-id/" + DebugFileResolver::GetBuildIdPath(build_id);
+  CopyFile(GetTestDataPath("no_symbols_elf.debug"), debug_path);
+
+  DebugFileResolver resolver({directory}, {}, testing::TempDir());
+  std::unique_ptr<ElfFile> file =
+      resolver.Resolve("/nonexistent/no_symbols_elf", build_id);
+  ASSERT_NE(file, nullptr);
+  EXPECT_EQ(file->GetFilePath(), debug_path);
+
+  DebugFileResolver other_resolver({}, {}, testing::TempDir());
+  EXPECT_EQ(other_resolver.Resolve("/nonexistent/no_symbols_elf", build_id),
+            nullptr);
+  std::remove(debug_path.c_str());
+}
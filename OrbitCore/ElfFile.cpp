@@ -1,13 +1,18 @@
 #include "ElfFile.h"
 
+#include <algorithm>
+#include <iterator>
 #include <string_view>
 #include <vector>
 
 #include "OrbitFunction.h"
+#include "ParallelFor.h"
 #include "Path.h"
 #include "PrintVar.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
+#include "llvm/DebugInfo/DWARF/DWARFContext.h"
 #include "llvm/Demangle/Demangle.h"
 #include "llvm/Object/ELFObjectFile.h"
 #include "llvm/Object/ObjectFile.h"
@@ -27,6 +32,7 @@ class ElfFileImpl : public ElfFile {
   bool HasSymtab() const override;
   std::string GetBuildId() const override;
   std::string GetFilePath() const override;
+  bool GetLineTable(LineTable* line_table) const override;
 
  private:
   void InitSections();
@@ -118,7 +124,6 @@ bool ElfFileImpl<ElfT>::GetFunctions(Pdb* pdb,
   if (!has_symtab_section_) {
     return false;
   }
-  bool function_added = false;
 
   std::optional<uint64_t> load_bias_optional = GetLoadBias();
   if (!load_bias_optional) {
@@ -127,37 +132,73 @@ bool ElfFileImpl<ElfT>::GetFunctions(Pdb* pdb,
 
   uint64_t load_bias = load_bias_optional.value();
 
+  // Reading the symbol table is cheap, demangling the names is not: the
+  // function symbols are listed first, then demangled and made functions in
+  // as many shards as there are cores. The names point into the mapped file.
+  struct FunctionSymbol {
+    llvm::StringRef name;
+    uint64_t address;
+    uint64_t size;
+  };
+  std::vector<FunctionSymbol> symbols;
   for (const llvm::object::ELFSymbolRef& symbol_ref : object_file_->symbols()) {
     if ((symbol_ref.getFlags() & llvm::object::BasicSymbolRef::SF_Undefined) !=
         0) {
       continue;
     }
 
-    std::string name = symbol_ref.getName() ? symbol_ref.getName().get() : "";
-    std::string pretty_name = llvm::demangle(name);
+    llvm::StringRef name;
+    llvm::Expected<llvm::StringRef> name_or_error = symbol_ref.getName();
+    if (name_or_error) {
+      name = name_or_error.get();
+    } else {
+      llvm::consumeError(name_or_error.takeError());
+    }
 
     // Unknown type - skip and generate a warning
-    if (!symbol_ref.getType()) {
+    llvm::Expected<llvm::object::SymbolRef::Type> type = symbol_ref.getType();
+    if (!type) {
+      llvm::consumeError(type.takeError());
       PRINT(
           absl::StrFormat("WARNING: Type is not set for symbol \"%s\" in "
                           "\"%s\", skipping.",
-                          name, file_path_));
+                          name.str(), file_path_));
       continue;
     }
 
     // Limit list of symbols to functions. Ignore sections and variables.
-    if (symbol_ref.getType().get() != llvm::object::SymbolRef::ST_Function) {
+    if (type.get() != llvm::object::SymbolRef::ST_Function) {
       continue;
     }
 
-    functions->emplace_back(name, pretty_name, Path::GetFileName(file_path_),
-                            symbol_ref.getValue(), symbol_ref.getSize(),
-                            load_bias, pdb);
+    symbols.push_back({name, symbol_ref.getValue(), symbol_ref.getSize()});
+  }
 
-    function_added = true;
+  const std::string file_name = Path::GetFileName(file_path_);
+  size_t num_shards = std::min(symbols.size(), GetNumWorkers());
+  std::vector<std::vector<Function>> shard_functions(num_shards);
+  ParallelFor(num_shards, [&](size_t shard) {
+    size_t begin = shard * symbols.size() / num_shards;
+    size_t end = (shard + 1) * symbols.size() / num_shards;
+    std::vector<Function>& shard_function = shard_functions[shard];
+    shard_function.reserve(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+      const FunctionSymbol& symbol = symbols[i];
+      std::string name = symbol.name.str();
+      std::string pretty_name = llvm::demangle(name);
+      shard_function.emplace_back(name, pretty_name, file_name, symbol.address,
+                                  symbol.size, load_bias, pdb);
+    }
+  });
+
+  // The functions are moved in the order of the symbol table, all at once.
+  functions->reserve(functions->size() + symbols.size());
+  for (std::vector<Function>& shard_function : shard_functions) {
+    std::move(shard_function.begin(), shard_function.end(),
+              std::back_inserter(*functions));
   }
 
-  return function_added;
+  return !symbols.empty();
 }
 
 template <typename ElfT>
@@ -207,9 +248,55 @@ std::string ElfFileImpl<ElfT>::GetFilePath() const {
   return file_path_;
 }
 
+template <typename ElfT>
+bool ElfFileImpl<ElfT>::GetLineTable(LineTable* line_table) const {
+  std::unique_ptr<llvm::DWARFContext> context =
+      llvm::DWARFContext::create(*object_file_);
+  std::vector<LineTable::Row> rows;
+  std::vector<std::string> files;
+  absl::flat_hash_map<std::string, uint32_t> file_ids;
+  for (const std::unique_ptr<llvm::DWARFUnit>& unit :
+       context->compile_units()) {
+    const llvm::DWARFDebugLine::LineTable* unit_table =
+        context->getLineTableForUnit(unit.get());
+    if (unit_table == nullptr) {
+      continue;
+    }
+
+    // Each unit numbers its own files, several units share most headers.
+    absl::flat_hash_map<uint64_t, uint32_t> unit_file_ids;
+    for (const llvm::DWARFDebugLine::Row& row : unit_table->Rows) {
+      auto [unit_file_it, inserted] = unit_file_ids.try_emplace(row.File, 0);
+      if (inserted) {
+        std::string file_name;
+        unit_table->getFileNameByIndex(
+            row.File, unit->getCompilationDir(),
+            llvm::DILineInfoSpecifier::FileLineInfoKind::AbsoluteFilePath,
+            file_name);
+        auto [file_it, is_new_file] =
+            file_ids.try_emplace(file_name, files.size());
+        if (is_new_file) {
+          files.push_back(std::move(file_name));
+        }
+        unit_file_it->second = file_it->second;
+      }
+      uint32_t line = row.EndSequence ? 0 : row.Line;
+      rows.push_back({row.Address.Address, unit_file_it->second, line});
+    }
+  }
+
+  if (rows.empty()) {
+    return false;
+  }
+  line_table->Build(std::move(rows), std::move(files));
+  return true;
+}
+
 }  // namespace
 
 std::unique_ptr<ElfFile> ElfFile::Create(const std::string& file_path) {
+  // The file is mapped rather than read, into a MemoryBuffer without null
+  // terminator, so that only the pages of the sections used are loaded.
   llvm::Expected<llvm::object::OwningBinary<llvm::object::ObjectFile>>
       object_file_or_error =
           llvm::object::ObjectFile::createObjectFile(file_path);
@@ -4,6 +4,7 @@
 #include <optional>
 #include <vector>
 
+#include "LineTable.h"
 #include "OrbitFunction.h"
 #include "Pdb.h"
 #include "llvm/Object/Binary.h"
@@ -35,6 +36,9 @@ class ElfFile {
   virtual bool HasSymtab() const = 0;
   virtual std::string GetBuildId() const = 0;
   virtual std::string GetFilePath() const = 0;
+  // Decodes the DWARF line tables of all compile units into line_table, with
+  // the same addresses as the functions. Returns false if there are none.
+  virtual bool GetLineTable(LineTable* line_table) const = 0;
 
   static std::unique_ptr<ElfFile> Create(const std::string& file_path);
 };
@@ -116,3 +116,27 @@ TEST(ElfFile, GetFilePath) {
 
   EXPECT_EQ(hello_world->GetFilePath(), hello_world_path);
 }
+
+TEST(ElfFile, GetLineTable) {
+  std::string executable_path = Path::GetExecutablePath();
+  std::string debug_path = executable_path + "/testdata/no_symbols_elf.debug";
+
+  auto elf_file = ElfFile::Create(debug_path);
+  ASSERT_NE(elf_file, nullptr);
+  LineTable line_table;
+  ASSERT_TRUE(elf_file->GetLineTable(&line_table));
+
+  const LineTable::Row* row = line_table.Find(0x4012a1);
+  ASSERT_NE(row, nullptr);
+  EXPECT_THAT(line_table.GetFile(row->file_id),
+              testing::EndsWith("hellocpp/main.cpp"));
+  EXPECT_EQ(row->line, 10);
+  row = line_table.Find(0x401298);
+  ASSERT_NE(row, nullptr);
+  EXPECT_EQ(row->line, 9);
+
+  auto hello_world =
+      ElfFile::Create(executable_path + "/testdata/hello_world_elf");
+  ASSERT_NE(hello_world, nullptr);
+  EXPECT_FALSE(hello_world->GetLineTable(&line_table));
+}
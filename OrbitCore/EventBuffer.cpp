@@ -19,19 +19,65 @@ EventTracer GEventTracer;
 void EventBuffer::Print() {
   PRINT("Orbit Callstack Events:");
 
-  size_t numCallstacks = 0;
-  for (auto& pair : m_CallstackEvents) {
-    std::map<long long, CallstackEvent>& callstacks = pair.second;
-    numCallstacks += callstacks.size();
-  }
-
+  size_t numCallstacks = GetNumEvents();
   PRINT_VAR(numCallstacks);
 
-  for (auto& pair : m_CallstackEvents) {
-    ThreadID threadID = pair.first;
-    std::map<long long, CallstackEvent>& callstacks = pair.second;
+  ForEachThread([](ThreadID threadID, const CallstackEventColumns& callstacks) {
     PRINT_VAR(threadID);
     PRINT_VAR(callstacks.size());
+  });
+}
+
+//-----------------------------------------------------------------------------
+void EventBuffer::AddCallstackEvent(long long a_Time, CallstackID a_CSHash,
+                                    ThreadID a_TID) {
+  auto it = m_CallstackEvents.find(a_TID);
+  if (it == m_CallstackEvents.end()) {
+    ScopeLock lock(m_Mutex);
+    it = m_CallstackEvents.try_emplace(a_TID).first;
+  }
+  if (!it->second.Add(a_Time, a_CSHash)) {
+    ++m_NumLateEvents;
+    return;
+  }
+  Capture::GCaptureOverview.Add(CaptureOverview::Row::kSamples, a_Time);
+  RegisterTime(a_Time);
+}
+
+//-----------------------------------------------------------------------------
+void EventBuffer::AddCallstackEvents(
+    absl::Span<const CallstackEvent> a_Events) {
+  long long minTime = LLONG_MAX;
+  long long maxTime = 0;
+  auto it = m_CallstackEvents.end();
+  for (const CallstackEvent& event : a_Events) {
+    if (it == m_CallstackEvents.end() || it->first != event.m_TID) {
+      it = m_CallstackEvents.find(event.m_TID);
+      if (it == m_CallstackEvents.end()) {
+        ScopeLock lock(m_Mutex);
+        it = m_CallstackEvents.try_emplace(event.m_TID).first;
+      }
+    }
+    if (!it->second.Add(event.m_Time, event.m_Id)) {
+      ++m_NumLateEvents;
+      continue;
+    }
+    Capture::GCaptureOverview.Add(CaptureOverview::Row::kSamples,
+                                  event.m_Time);
+    if (event.m_Time > maxTime) maxTime = event.m_Time;
+    if (event.m_Time > 0 && event.m_Time < minTime) minTime = event.m_Time;
+  }
+  RegisterTime(maxTime);
+  if (minTime != LLONG_MAX) RegisterTime(minTime);
+}
+
+//-----------------------------------------------------------------------------
+void EventBuffer::ForEachThread(
+    const std::function<void(ThreadID, const CallstackEventColumns&)>&
+        a_Action) {
+  ScopeLock lock(m_Mutex);
+  for (const auto& pair : m_CallstackEvents) {
+    a_Action(pair.first, pair.second);
   }
 }
 
@@ -39,27 +85,86 @@ void EventBuffer::Print() {
 std::vector<CallstackEvent> EventBuffer::GetCallstackEvents(
     long long a_TimeBegin, long long a_TimeEnd, ThreadID a_ThreadId /*= 0*/) {
   std::vector<CallstackEvent> callstackEvents;
-  for (auto& pair : m_CallstackEvents) {
-    ThreadID threadID = pair.first;
-    std::map<long long, CallstackEvent>& callstacks = pair.second;
-
-    if (a_ThreadId == 0 || threadID == a_ThreadId) {
-      for (auto it = callstacks.lower_bound(a_TimeBegin);
-           it != callstacks.end(); ++it) {
-        long long time = it->first;
-        if (time < a_TimeEnd) {
-          callstackEvents.push_back(it->second);
+  ForEachThread(
+      [&](ThreadID threadID, const CallstackEventColumns& callstacks) {
+        if (a_ThreadId == 0 || threadID == a_ThreadId) {
+          callstacks.ForEachEvent(
+              a_TimeBegin, a_TimeEnd, [&](int64_t time, CallstackID id) {
+                callstackEvents.emplace_back(time, id, threadID);
+              });
         }
-      }
-    }
-  }
+      });
 
   return callstackEvents;
 }
 
+//-----------------------------------------------------------------------------
+std::map<ThreadID, CallstackCounts> EventBuffer::GetCallstackCounts(
+    long long a_TimeBegin, long long a_TimeEnd, ThreadID a_ThreadId /*= 0*/) {
+  std::map<ThreadID, CallstackCounts> callstackCounts;
+  ForEachThread(
+      [&](ThreadID threadID, const CallstackEventColumns& callstacks) {
+        if (a_ThreadId == 0 || threadID == a_ThreadId) {
+          CallstackCounts counts;
+          callstacks.CountCallstacks(a_TimeBegin, a_TimeEnd, &counts);
+          if (!counts.empty()) {
+            callstackCounts[threadID] = std::move(counts);
+          }
+        }
+      });
+
+  return callstackCounts;
+}
+
+//-----------------------------------------------------------------------------
+size_t EventBuffer::GetNumThreads() {
+  ScopeLock lock(m_Mutex);
+  return m_CallstackEvents.size();
+}
+
+//-----------------------------------------------------------------------------
+size_t EventBuffer::GetNumEvents() {
+  size_t numEvents = 0;
+  ForEachThread([&](ThreadID, const CallstackEventColumns& callstacks) {
+    numEvents += callstacks.size();
+  });
+
+  return numEvents;
+}
+
+//-----------------------------------------------------------------------------
+size_t EventBuffer::GetMemorySize() {
+  size_t memorySize = 0;
+  ForEachThread([&](ThreadID, const CallstackEventColumns& callstacks) {
+    memorySize += callstacks.GetMemorySize();
+  });
+
+  return memorySize;
+}
+
 //-----------------------------------------------------------------------------
 ORBIT_SERIALIZE(EventBuffer, 0) {
-  ORBIT_NVP_VAL(0, m_CallstackEvents);
+  // Saved as per thread maps, as before samples were stored in columns.
+  std::map<ThreadID, std::map<long long, CallstackEvent> > callstackEvents;
+  if (Archive::is_saving::value) {
+    ForEachThread([&](ThreadID threadID, const CallstackEventColumns& events) {
+      std::map<long long, CallstackEvent>& threadEvents =
+          callstackEvents[threadID];
+      events.ForEachEvent(
+          INT64_MIN, INT64_MAX, [&](int64_t time, CallstackID id) {
+            threadEvents[time] = CallstackEvent(time, id, threadID);
+          });
+    });
+  }
+  a_Archive(cereal::make_nvp("m_CallstackEvents", callstackEvents));
+  if (Archive::is_loading::value) {
+    Reset();
+    for (const auto& pair : callstackEvents) {
+      for (const auto& eventPair : pair.second) {
+        AddCallstackEvent(eventPair.first, eventPair.second.m_Id, pair.first);
+      }
+    }
+  }
 
   long long maxTime = m_MaxTime;
   ORBIT_NVP_VAL(0, maxTime);
@@ -85,11 +190,19 @@ void EventTracer::Start(uint32_t a_PID, LinuxTracingSession* session) {
   Capture::GSamplingProfiler->StartCapture();
 
   m_LinuxTracer = std::make_shared<LinuxTracingHandler>(
-      Capture::GSamplingProfiler.get(), session, Capture::GTargetProcess.get(),
-      &Capture::GSelectedFunctionsMap, &Capture::GNumContextSwitches);
+      session, Capture::GTargetProcess.get(), &Capture::GSelectedFunctionsMap,
+      Capture::GSamplingPolicies, &Capture::GNumContextSwitches);
   m_LinuxTracer->Start();
 }
 
+//-----------------------------------------------------------------------------
+void EventTracer::TraceWithIntelPt(uint64_t function_address,
+                                   uint64_t duration_ns) {
+  if (m_LinuxTracer) {
+    m_LinuxTracer->TraceWithIntelPt(function_address, duration_ns);
+  }
+}
+
 //-----------------------------------------------------------------------------
 void EventTracer::Stop() {
   if (m_LinuxTracer) {
@@ -102,14 +215,4 @@ void EventTracer::Stop() {
   }
 }
 
-//-----------------------------------------------------------------------------
-size_t EventBuffer::GetNumEvents() const {
-  size_t numEvents = 0;
-  for (auto& pair : m_CallstackEvents) {
-    numEvents += pair.second.size();
-  }
-
-  return numEvents;
-}
-
 #endif
@@ -3,12 +3,17 @@
 //-----------------------------------
 #pragma once
 
+#include <functional>
+#include <map>
 #include <set>
+#include <vector>
 
 #include "BlockChain.h"
 #include "Callstack.h"
+#include "CallstackEventColumns.h"
 #include "Core.h"
 #include "SerializationMacros.h"
+#include "absl/types/span.h"
 
 #ifdef __linux
 #include "LinuxUtils.h"
@@ -26,24 +31,35 @@ struct CallstackEvent {
 };
 
 //-----------------------------------------------------------------------------
+// Sampled callstacks of each thread, stored in time order as columns. Samples
+// are added by a single thread, which only takes the mutex for the first
+// sample of each thread.
 class EventBuffer {
  public:
   EventBuffer() : m_MaxTime(0), m_MinTime(LLONG_MAX) {}
   ~EventBuffer() {}
 
   void Print();
+  // Not to be called while samples are added.
   void Reset() {
+    ScopeLock lock(m_Mutex);
     m_CallstackEvents.clear();
+    m_NumLateEvents = 0;
     m_MinTime = LLONG_MAX;
     m_MaxTime = 0;
   }
-  std::map<ThreadID, std::map<long long, CallstackEvent> >& GetCallstacks() {
-    return m_CallstackEvents;
-  }
+  // Calls a_Action(threadId, columns) for each thread with samples.
+  void ForEachThread(
+      const std::function<void(ThreadID, const CallstackEventColumns&)>&
+          a_Action);
   Mutex& GetMutex() { return m_Mutex; }
   std::vector<CallstackEvent> GetCallstackEvents(long long a_TimeBegin,
                                                  long long a_TimeEnd,
                                                  ThreadID a_ThreadId = 0);
+  // Number of samples of each callstack per thread, from a_TimeBegin to
+  // a_TimeEnd. Unlike GetCallstackEvents, doesn't go through each sample.
+  std::map<ThreadID, CallstackCounts> GetCallstackCounts(
+      long long a_TimeBegin, long long a_TimeEnd, ThreadID a_ThreadId = 0);
   long long GetMaxTime() const { return m_MaxTime; }
   long long GetMinTime() const { return m_MinTime; }
   bool HasEvent() {
@@ -55,9 +71,12 @@ class EventBuffer {
     return m_CallstackEvents.find(a_TID) != m_CallstackEvents.end();
   }
 
-#ifdef __linux__
-  size_t GetNumEvents() const;
-#endif
+  size_t GetNumThreads();
+  size_t GetNumEvents();
+  // Samples dropped because they were older than the previous sample of
+  // their thread.
+  uint64_t GetNumLateEvents() const { return m_NumLateEvents; }
+  size_t GetMemorySize();
 
   //-----------------------------------------------------------------------------
   void RegisterTime(long long a_Time) {
@@ -65,21 +84,20 @@ class EventBuffer {
     if (a_Time > 0 && a_Time < m_MinTime) m_MinTime = a_Time;
   }
 
-  //-----------------------------------------------------------------------------
   void AddCallstackEvent(long long a_Time, CallstackID a_CSHash,
-                         ThreadID a_TID) {
-    ScopeLock lock(m_Mutex);
-    std::map<long long, CallstackEvent>& threadMap = m_CallstackEvents[a_TID];
-    threadMap[a_Time] = CallstackEvent(a_Time, a_CSHash, a_TID);
-    RegisterTime(a_Time);
-  }
+                         ThreadID a_TID);
+  // Same as adding each of a_Events in turn, with the threads looked up once
+  // per run of samples of the same thread and the time range updated once.
+  void AddCallstackEvents(absl::Span<const CallstackEvent> a_Events);
 
   ORBIT_SERIALIZABLE;
 
  private:
   Mutex m_Mutex;
-  std::map<ThreadID, std::map<long long, CallstackEvent> > m_CallstackEvents;
+  // Only changed by the thread adding samples, under the mutex, so that
+  // thread can look threads up without locking. Columns never move.
+  std::map<ThreadID, CallstackEventColumns> m_CallstackEvents;
+  std::atomic<uint64_t> m_NumLateEvents = 0;
   std::atomic<long long> m_MaxTime;
   std::atomic<long long> m_MinTime;
 };
-
@@ -9,6 +9,9 @@
 
 #include "EventCallbacks.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "Capture.h"
 #include "ContextSwitch.h"
 #include "EventClasses.h"
@@ -18,6 +21,7 @@
 #include "OrbitProcess.h"
 #include "SamplingProfiler.h"
 #include "TimerManager.h"
+#include "absl/container/flat_hash_set.h"
 
 //-----------------------------------------------------------------------------
 std::unordered_map<ULONG64, EventTracing::EventCallback> GEventCallbacks;
@@ -26,6 +30,30 @@ std::unordered_map<uint32_t, uint32_t> GThreadToProcessMap;
 std::unordered_map<ULONG64, ULONG> GEventCountByProviderId;
 bool GOutputEvent = false;
 
+//-----------------------------------------------------------------------------
+// Events of interest decoded by the ETW consumer thread, the only one to touch
+// the batch while tracing. The batch is handed to the capture once per ETW
+// buffer, so that the sampling profiler is locked once per batch rather than
+// once per sample and the event buffer appends runs of samples per thread.
+namespace {
+constexpr size_t kMaxBatchSize = 4096;
+
+struct EventBatch {
+  std::vector<ContextSwitch> m_ContextSwitches;
+  std::vector<CallstackEvent> m_CallstackEvents;
+  // Callstacks the sampling profiler doesn't have yet.
+  std::vector<CallStack> m_NewCallstacks;
+  // Callstacks handed to the sampling profiler since the capture started.
+  absl::flat_hash_set<CallstackID> m_KnownCallstacks;
+
+  size_t Size() const {
+    return m_ContextSwitches.size() + m_CallstackEvents.size();
+  }
+};
+
+EventBatch GEventBatch;
+}  // namespace
+
 //-----------------------------------------------------------------------------
 void EventTracing::Reset();
 bool IsTargetProcessThread(uint32_t a_ThreadId);
@@ -226,32 +254,76 @@ void EventTracing::CallbackStackWalk(PEVENT_RECORD a_EventRecord,
       int stackDepth = (a_EventRecord->UserDataLength -
                         (sizeof(StackWalk_Event) - sizeof(event->Stack1))) /
                        sizeof(ULONG64);
+      stackDepth = std::min(stackDepth, ORBIT_STACK_SIZE);
 
       CallStack CS;
       CS.m_Depth = stackDepth;
       CS.m_ThreadId = event->StackThread;
-      size_t numBytes =
-          std::min(stackDepth, ORBIT_STACK_SIZE) * sizeof(ULONG64);
       CS.m_Data.resize(stackDepth);
-      memcpy(CS.m_Data.data(), &event->Stack1, numBytes);
+      memcpy(CS.m_Data.data(), &event->Stack1, stackDepth * sizeof(ULONG64));
 
-      Capture::GSamplingProfiler->AddCallStack(CS);
-      GEventTracer.GetEventBuffer().AddCallstackEvent(
-          a_EventRecord->EventHeader.TimeStamp.QuadPart, CS.Hash(),
-          CS.m_ThreadId);
+      // Timestamped like the sampled event the stack was walked for.
+      CallstackEvent callstackEvent(event->EventTimeStamp, CS.Hash(),
+                                    CS.m_ThreadId);
+      if (GEventBatch.m_KnownCallstacks.insert(callstackEvent.m_Id).second) {
+        GEventBatch.m_NewCallstacks.push_back(std::move(CS));
+      }
+      GEventBatch.m_CallstackEvents.push_back(callstackEvent);
+      if (GEventBatch.Size() >= kMaxBatchSize) {
+        FlushBatch();
+      }
     }
   }
 }
 
+//-----------------------------------------------------------------------------
+ULONG WINAPI EventTracing::BufferCallback(PEVENT_TRACE_LOGFILE a_LogFile) {
+  FlushBatch();
+  return TRUE;
+}
+
+//-----------------------------------------------------------------------------
+void EventTracing::FlushBatch() {
+  EventBatch& batch = GEventBatch;
+  for (const ContextSwitch& contextSwitch : batch.m_ContextSwitches) {
+    GTimerManager->Add(contextSwitch);
+  }
+
+  std::shared_ptr<SamplingProfiler> profiler = Capture::GSamplingProfiler;
+  if (profiler != nullptr && !batch.m_CallstackEvents.empty()) {
+    // Samples of a thread stay in time order, in runs per thread.
+    std::stable_sort(batch.m_CallstackEvents.begin(),
+                     batch.m_CallstackEvents.end(),
+                     [](const CallstackEvent& a, const CallstackEvent& b) {
+                       return a.m_TID < b.m_TID;
+                     });
+    profiler->AddCallStacks(batch.m_CallstackEvents,
+                            absl::MakeSpan(batch.m_NewCallstacks));
+    GEventTracer.GetEventBuffer().AddCallstackEvents(batch.m_CallstackEvents);
+  }
+
+  batch.m_ContextSwitches.clear();
+  batch.m_CallstackEvents.clear();
+  batch.m_NewCallstacks.clear();
+}
+
 //-----------------------------------------------------------------------------
 void EventTracing::Reset() {
   Init();
   GThreadToProcessMap.clear();
+  GEventBatch.m_ContextSwitches.clear();
+  GEventBatch.m_CallstackEvents.clear();
+  GEventBatch.m_NewCallstacks.clear();
+  GEventBatch.m_KnownCallstacks.clear();
 }
 
 //-----------------------------------------------------------------------------
 inline bool IsTargetProcessThread(uint32_t a_ThreadId) {
-  return GThreadToProcessMap[a_ThreadId] == Capture::GTargetProcess->GetID();
+  // Looked up without inserting, as most threads switched are of other
+  // processes.
+  auto it = GThreadToProcessMap.find(a_ThreadId);
+  return it != GThreadToProcessMap.end() &&
+         it->second == Capture::GTargetProcess->GetID();
 }
 
 //-----------------------------------------------------------------------------
@@ -263,23 +335,26 @@ inline void ProcessContextSwitch(PEVENT_RECORD a_EventRecord) {
   CSwitch* switchEvent = (CSwitch*)a_EventRecord->UserData;
 
   ++Capture::GNumContextSwitches;
-  DWORD processId = Capture::GTargetProcess->GetID();
-  if (GThreadToProcessMap[switchEvent->NewThreadId] == processId) {
-    ContextSwitch CS(ContextSwitch::In);
+  if (IsTargetProcessThread(switchEvent->NewThreadId)) {
+    ContextSwitch& CS =
+        GEventBatch.m_ContextSwitches.emplace_back(ContextSwitch::In);
     CS.m_ThreadId = switchEvent->NewThreadId;
     CS.m_Time = CycleTime;
     CS.m_ProcessorIndex = ProcessorIndex;
     CS.m_ProcessorNumber = ProcessorNumber;
-    GTimerManager->Add(CS);
   }
 
-  if (GThreadToProcessMap[switchEvent->OldThreadId] == processId) {
-    ContextSwitch CS(ContextSwitch::Out);
+  if (IsTargetProcessThread(switchEvent->OldThreadId)) {
+    ContextSwitch& CS =
+        GEventBatch.m_ContextSwitches.emplace_back(ContextSwitch::Out);
     CS.m_ThreadId = switchEvent->OldThreadId;
     CS.m_Time = CycleTime;
     CS.m_ProcessorIndex = ProcessorIndex;
     CS.m_ProcessorNumber = ProcessorNumber;
-    GTimerManager->Add(CS);
+  }
+
+  if (GEventBatch.Size() >= kMaxBatchSize) {
+    EventTracing::FlushBatch();
   }
 }
 
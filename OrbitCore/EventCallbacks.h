@@ -26,6 +26,10 @@ void CallbackTcpIp(PEVENT_RECORD a_EventRecord, UCHAR a_Opcode);
 void CallbackThread(PEVENT_RECORD a_EventRecord, UCHAR a_Opcode);
 void CallbackUdpIp(PEVENT_RECORD a_EventRecord, UCHAR a_Opcode);
 void CallbackStackWalk(PEVENT_RECORD a_EventRecord, UCHAR a_Opcode);
+// Called by ETW after the events of each buffer were delivered.
+ULONG WINAPI BufferCallback(PEVENT_TRACE_LOGFILE a_LogFile);
+// Hands the events decoded since the last flush to the capture.
+void FlushBatch();
 void Init();
 void Reset();
 }  // namespace EventTracing
\ No newline at end of file
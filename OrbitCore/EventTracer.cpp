@@ -31,7 +31,12 @@ EventTracer GEventTracer;
 EventTracer::EventTracer() : m_SessionProperties(nullptr), m_IsTracing(false) {}
 
 //-----------------------------------------------------------------------------
-EventTracer::~EventTracer() { CleanupTrace(); }
+EventTracer::~EventTracer() {
+  CleanupTrace();
+  if (m_ConsumerThread != nullptr) {
+    m_ConsumerThread->join();
+  }
+}
 
 //-----------------------------------------------------------------------------
 VOID WINAPI EventRecordCallback(_In_ PEVENT_RECORD pEventRecord) {}
@@ -39,10 +44,13 @@ VOID WINAPI EventRecordCallback(_In_ PEVENT_RECORD pEventRecord) {}
 //-----------------------------------------------------------------------------
 void EventTracer::EventTracerThread() {
   SetCurrentThreadName(L"EventTracer");
+  // Real-time sessions drop the events of buffers not consumed in time.
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
   ULONG error = ProcessTrace(&m_TraceHandle, 1, 0, 0);
   if (error != ERROR_SUCCESS) {
     PrintLastError();
   }
+  EventTracing::FlushBatch();
 }
 
 //-----------------------------------------------------------------------------
@@ -90,7 +98,9 @@ void EventTracer::Start() {
 
     m_SessionProperties->EnableFlags = EVENT_TRACE_FLAG_THREAD;  // ThreadGuid
 
-    if (GParams.m_TrackSamplingEvents) {
+    m_IsWalkingThreads =
+        GParams.m_TrackSamplingEvents && !GParams.m_UseKernelStackWalk;
+    if (GParams.m_TrackSamplingEvents && !m_IsWalkingThreads) {
       m_SessionProperties->EnableFlags |=
           EVENT_TRACE_FLAG_PROFILE;  // PerfInfoGuid
     }
@@ -124,6 +134,14 @@ void EventTracer::Start() {
   Capture::GSamplingProfiler->StartCapture();
   m_IsTracing = true;
 
+  if (m_IsWalkingThreads) {
+    // Processes the samples itself once stopped.
+    std::thread thread([profiler = Capture::GSamplingProfiler]() {
+      profiler->SampleThreadsAsync();
+    });
+    thread.detach();
+  }
+
   if (ControlTrace(0, KERNEL_LOGGER_NAME, m_SessionProperties,
                    EVENT_TRACE_CONTROL_STOP) != ERROR_SUCCESS) {
     PrintLastError();
@@ -136,7 +154,9 @@ void EventTracer::Start() {
     return;
   }
 
-  SetupStackTracing();
+  if (!m_IsWalkingThreads) {
+    SetupStackTracing();
+  }
 
   static EVENT_TRACE_LOGFILE LogFile = {0};
   LogFile.LoggerName = KERNEL_LOGGER_NAME;
@@ -145,6 +165,8 @@ void EventTracer::Start() {
        PROCESS_TRACE_MODE_RAW_TIMESTAMP);
 
   LogFile.EventRecordCallback = (PEVENT_RECORD_CALLBACK)EventTracing::Callback;
+  LogFile.BufferCallback =
+      (PEVENT_TRACE_BUFFER_CALLBACK)EventTracing::BufferCallback;
 
   m_TraceHandle = OpenTrace(&LogFile);
   if (m_TraceHandle == 0) {
@@ -152,19 +174,27 @@ void EventTracer::Start() {
     return;
   }
 
-  std::thread* thread = new std::thread([&]() { EventTracerThread(); });
-  thread->detach();
+  m_ConsumerThread =
+      std::make_unique<std::thread>([this]() { EventTracerThread(); });
 }
 
 //-----------------------------------------------------------------------------
 void EventTracer::Stop() {
   CleanupTrace();
+  // The consumer returns once it delivered the last events of the session,
+  // which must reach the sampling profiler before it processes the samples.
+  if (m_ConsumerThread != nullptr) {
+    m_ConsumerThread->join();
+    m_ConsumerThread.reset();
+  }
 
   if (m_IsTracing) {
     m_IsTracing = false;
     if (Capture::GSamplingProfiler) {
       Capture::GSamplingProfiler->StopCapture();
-      Capture::GSamplingProfiler->ProcessSamplesAsync();
+      if (!m_IsWalkingThreads) {
+        Capture::GSamplingProfiler->ProcessSamplesAsync();
+      }
     }
   }
 
@@ -7,6 +7,9 @@
 
 #include <evntrace.h>
 
+#include <memory>
+#include <thread>
+
 #include "Core.h"
 #include "EventBuffer.h"
 #include "EventGuid.h"
@@ -22,6 +25,8 @@ class EventTracer {
   void Stop();
 
   void CleanupTrace();
+  // Real-time consumer of the session, decoding its events in batches until
+  // the session stops.
   void EventTracerThread();
   void SetSamplingFrequency(float a_Frequency = 1000.f /*Hertz*/);
   void SetupStackTracing();
@@ -35,6 +40,10 @@ class EventTracer {
   std::atomic<bool> m_IsTracing;
   _EVENT_TRACE_PROPERTIES* m_SessionProperties;
   EventBuffer m_EventBuffer;
+  std::unique_ptr<std::thread> m_ConsumerThread;
+  // Whether samples are taken by suspending and walking the threads of the
+  // target, when GParams.m_UseKernelStackWalk is off.
+  bool m_IsWalkingThreads = false;
 };
 
 extern EventTracer GEventTracer;
@@ -48,6 +57,8 @@ class EventTracer {
   EventBuffer m_EventBuffer;
   void Start(uint32_t a_PID, LinuxTracingSession* session);
   void Stop();
+  // See LinuxTracingHandler::TraceWithIntelPt.
+  void TraceWithIntelPt(uint64_t function_address, uint64_t duration_ns);
 
  private:
   // TODO: Fix circular dependencies in header files.
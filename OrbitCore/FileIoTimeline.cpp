@@ -0,0 +1,96 @@
+#include "FileIoTimeline.h"
+
+#include <algorithm>
+#include <optional>
+
+#include "absl/base/casts.h"
+
+const char* GetFileIoSyscallName(FileIo::Syscall syscall) {
+  switch (syscall) {
+    case FileIo::kRead:
+      return "read";
+    case FileIo::kWrite:
+      return "write";
+    case FileIo::kPread:
+      return "pread";
+    case FileIo::kPwrite:
+      return "pwrite";
+    case FileIo::kFsync:
+      return "fsync";
+    case FileIo::kOpenat:
+      return "openat";
+  }
+  return "";
+}
+
+Timer MakeFileIoTimer(uint32_t thread_id, const FileIo& file_io) {
+  Timer timer;
+  timer.m_Type = Timer::FILE_IO;
+  timer.m_TID = thread_id;
+  timer.m_Start = file_io.begin;
+  timer.m_End = file_io.end;
+  timer.m_Processor = file_io.syscall;
+  timer.m_UserData[0] = absl::bit_cast<uint64_t>(int64_t{file_io.fd});
+  timer.m_UserData[1] = absl::bit_cast<uint64_t>(file_io.result);
+  return timer;
+}
+
+FileIo FileIoFromTimer(const Timer& timer) {
+  FileIo file_io;
+  file_io.begin = timer.m_Start;
+  file_io.end = timer.m_End;
+  file_io.syscall = static_cast<FileIo::Syscall>(timer.m_Processor);
+  file_io.fd =
+      static_cast<int32_t>(absl::bit_cast<int64_t>(timer.m_UserData[0]));
+  file_io.result = absl::bit_cast<int64_t>(timer.m_UserData[1]);
+  return file_io;
+}
+
+void FileIoTimeline::Add(const FileIo& file_io) {
+  if (file_ios_.empty() || file_ios_.back().begin <= file_io.begin) {
+    file_ios_.push_back(file_io);
+    return;
+  }
+  auto it = std::upper_bound(file_ios_.begin(), file_ios_.end(), file_io.begin,
+                             [](uint64_t begin, const FileIo& other) {
+                               return begin < other.begin;
+                             });
+  file_ios_.insert(it, file_io);
+}
+
+void FileIoTimeline::ForEachSpanInRange(
+    uint64_t begin, uint64_t end, uint64_t min_gap,
+    const std::function<void(const Span&)>& action) const {
+  // Start from the last I/O that begins before begin, as it can still be on.
+  auto it = std::upper_bound(file_ios_.begin(), file_ios_.end(), begin,
+                             [](uint64_t time, const FileIo& file_io) {
+                               return time < file_io.begin;
+                             });
+  if (it != file_ios_.begin()) {
+    --it;
+  }
+
+  std::optional<Span> span;
+  for (; it != file_ios_.end() && it->begin < end; ++it) {
+    if (it->end < begin) {
+      continue;
+    }
+    uint64_t num_bytes = it->result > 0 && it->syscall != FileIo::kOpenat
+                             ? static_cast<uint64_t>(it->result)
+                             : 0;
+    if (span.has_value() && it->begin < span->end + min_gap) {
+      span->end = std::max(span->end, it->end);
+      span->has_single_syscall &= it->syscall == span->syscall;
+      ++span->num_file_ios;
+      span->num_bytes += num_bytes;
+      continue;
+    }
+    if (span.has_value()) {
+      action(span.value());
+    }
+    span = Span{it->begin, it->end, it->syscall, true, 1, num_bytes, *it};
+  }
+  if (span.has_value()) {
+    action(span.value());
+  }
+}
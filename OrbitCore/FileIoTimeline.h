@@ -0,0 +1,79 @@
+#ifndef ORBIT_CORE_FILE_IO_TIMELINE_H_
+#define ORBIT_CORE_FILE_IO_TIMELINE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "ScopeTimer.h"
+
+// A file I/O syscall of a thread, sent from the service to the client as a
+// Timer::FILE_IO timer.
+struct FileIo {
+  // Same as LinuxTracing::FileIoSyscall.
+  enum Syscall : uint8_t {
+    kRead,
+    kWrite,
+    kPread,
+    kPwrite,
+    kFsync,
+    kOpenat,
+  };
+
+  uint64_t begin = 0;
+  uint64_t end = 0;
+  Syscall syscall = kRead;
+  // The file descriptor opened, for kOpenat, or -1 if it failed.
+  int32_t fd = -1;
+  // The bytes transferred, or the negated errno if the syscall failed.
+  int64_t result = 0;
+};
+
+const char* GetFileIoSyscallName(FileIo::Syscall syscall);
+
+// The syscall is in m_Processor, the fd and the result are the bits of
+// m_UserData[0] and m_UserData[1].
+Timer MakeFileIoTimer(uint32_t thread_id, const FileIo& file_io);
+FileIo FileIoFromTimer(const Timer& timer);
+
+// The file I/O syscalls of a thread, in order of time. The syscalls of a
+// thread don't overlap, so those of a range of time are found by a binary
+// search, and those closer than a pixel are merged into a single span, so
+// that hundreds of thousands of them per second are drawn as a few
+// thousand quads.
+class FileIoTimeline {
+ public:
+  struct Span {
+    uint64_t begin;
+    uint64_t end;
+    // The syscall of the first I/O of the span.
+    FileIo::Syscall syscall;
+    // Whether all the I/Os of the span are of syscall.
+    bool has_single_syscall;
+    size_t num_file_ios;
+    // The bytes transferred by the I/Os of the span that succeeded.
+    uint64_t num_bytes;
+    // The first I/O of the span.
+    FileIo first_file_io;
+  };
+
+  // I/Os are expected in order of time: one that begins before the last one
+  // is inserted in order.
+  void Add(const FileIo& file_io);
+
+  // Calls action for each span of the I/Os overlapping [begin, end), in order
+  // of time. An I/O that begins less than min_gap after the end of the span
+  // before it is merged into that span.
+  void ForEachSpanInRange(uint64_t begin, uint64_t end, uint64_t min_gap,
+                          const std::function<void(const Span&)>& action)
+      const;
+
+  size_t GetNumFileIos() const { return file_ios_.size(); }
+  void Clear() { file_ios_.clear(); }
+
+ private:
+  std::vector<FileIo> file_ios_;
+};
+
+#endif  // ORBIT_CORE_FILE_IO_TIMELINE_H_
@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "FileIoTimeline.h"
+
+namespace {
+FileIo MakeFileIo(uint64_t begin, uint64_t end, FileIo::Syscall syscall,
+                  int64_t result) {
+  FileIo file_io;
+  file_io.begin = begin;
+  file_io.end = end;
+  file_io.syscall = syscall;
+  file_io.fd = 3;
+  file_io.result = result;
+  return file_io;
+}
+
+std::vector<FileIoTimeline::Span> GetSpans(const FileIoTimeline& timeline,
+                                           uint64_t begin, uint64_t end,
+                                           uint64_t min_gap) {
+  std::vector<FileIoTimeline::Span> spans;
+  timeline.ForEachSpanInRange(
+      begin, end, min_gap,
+      [&spans](const FileIoTimeline::Span& span) { spans.push_back(span); });
+  return spans;
+}
+}  // namespace
+
+TEST(FileIoTimeline, FileIoTimerRoundTrip) {
+  FileIo file_io = MakeFileIo(100, 200, FileIo::kPwrite, -28);
+  file_io.fd = -1;
+  Timer timer = MakeFileIoTimer(42, file_io);
+  EXPECT_EQ(timer.m_Type, Timer::FILE_IO);
+  EXPECT_EQ(timer.m_TID, 42);
+  EXPECT_EQ(timer.m_FunctionAddress, 0);
+
+  FileIo decoded = FileIoFromTimer(timer);
+  EXPECT_EQ(decoded.begin, 100);
+  EXPECT_EQ(decoded.end, 200);
+  EXPECT_EQ(decoded.syscall, FileIo::kPwrite);
+  EXPECT_EQ(decoded.fd, -1);
+  EXPECT_EQ(decoded.result, -28);
+}
+
+TEST(FileIoTimeline, ForEachSpanInRange) {
+  FileIoTimeline timeline;
+  timeline.Add(MakeFileIo(100, 150, FileIo::kRead, 10));
+  timeline.Add(MakeFileIo(200, 250, FileIo::kWrite, 20));
+  timeline.Add(MakeFileIo(300, 350, FileIo::kRead, 30));
+
+  std::vector<FileIoTimeline::Span> spans = GetSpans(timeline, 120, 300, 0);
+  ASSERT_EQ(spans.size(), 2);
+  EXPECT_EQ(spans[0].begin, 100);
+  EXPECT_EQ(spans[0].end, 150);
+  EXPECT_EQ(spans[0].num_file_ios, 1);
+  EXPECT_EQ(spans[0].num_bytes, 10);
+  EXPECT_EQ(spans[1].begin, 200);
+  EXPECT_EQ(spans[1].syscall, FileIo::kWrite);
+
+  EXPECT_TRUE(GetSpans(timeline, 160, 190, 0).empty());
+  EXPECT_EQ(GetSpans(timeline, 0, 1000, 0).size(), 3);
+}
+
+TEST(FileIoTimeline, MergesCloseFileIos) {
+  FileIoTimeline timeline;
+  timeline.Add(MakeFileIo(100, 110, FileIo::kRead, 4096));
+  timeline.Add(MakeFileIo(115, 120, FileIo::kRead, 4096));
+  timeline.Add(MakeFileIo(125, 130, FileIo::kRead, -11));
+  timeline.Add(MakeFileIo(200, 210, FileIo::kRead, 4096));
+  timeline.Add(MakeFileIo(212, 220, FileIo::kFsync, 0));
+
+  std::vector<FileIoTimeline::Span> spans = GetSpans(timeline, 0, 1000, 10);
+  ASSERT_EQ(spans.size(), 2);
+  EXPECT_EQ(spans[0].begin, 100);
+  EXPECT_EQ(spans[0].end, 130);
+  EXPECT_EQ(spans[0].num_file_ios, 3);
+  EXPECT_EQ(spans[0].num_bytes, 8192);
+  EXPECT_TRUE(spans[0].has_single_syscall);
+  EXPECT_EQ(spans[1].begin, 200);
+  EXPECT_EQ(spans[1].end, 220);
+  EXPECT_EQ(spans[1].num_file_ios, 2);
+  EXPECT_FALSE(spans[1].has_single_syscall);
+}
+
+TEST(FileIoTimeline, AddOutOfOrder) {
+  FileIoTimeline timeline;
+  timeline.Add(MakeFileIo(300, 350, FileIo::kRead, 1));
+  timeline.Add(MakeFileIo(100, 150, FileIo::kOpenat, 5));
+  timeline.Add(MakeFileIo(200, 250, FileIo::kRead, 2));
+  EXPECT_EQ(timeline.GetNumFileIos(), 3);
+
+  std::vector<FileIoTimeline::Span> spans = GetSpans(timeline, 0, 1000, 0);
+  ASSERT_EQ(spans.size(), 3);
+  EXPECT_EQ(spans[0].syscall, FileIo::kOpenat);
+  // The fd returned by openat is not a byte count.
+  EXPECT_EQ(spans[0].num_bytes, 0);
+  EXPECT_EQ(spans[1].begin, 200);
+  EXPECT_EQ(spans[2].begin, 300);
+}
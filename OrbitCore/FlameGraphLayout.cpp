@@ -0,0 +1,70 @@
+#include "FlameGraphLayout.h"
+
+#include <algorithm>
+
+std::vector<FlameGraphFrame> LayoutFlameGraph(
+    const CallstackTree& tree, absl::Span<const uint64_t> inclusive_counts,
+    CallstackTree::NodeId focus, float width, float min_width) {
+  std::vector<FlameGraphFrame> frames;
+  if (focus >= tree.size() || focus >= inclusive_counts.size() ||
+      inclusive_counts[focus] == 0) {
+    return frames;
+  }
+
+  for (CallstackTree::NodeId id = focus; id != CallstackTree::kRootId;) {
+    id = tree.GetParent(id);
+    frames.push_back({id, tree.GetDepth(id), 0.f, width, inclusive_counts[id]});
+  }
+  const size_t focus_index = frames.size();
+  frames.push_back(
+      {focus, tree.GetDepth(focus), 0.f, width, inclusive_counts[focus]});
+  const float scale = width / static_cast<float>(inclusive_counts[focus]);
+
+  // Frames are expanded in the order they are laid out, one depth at a time.
+  std::vector<CallstackTree::NodeId> children;
+  for (size_t i = focus_index; i < frames.size(); ++i) {
+    const FlameGraphFrame frame = frames[i];
+    if (frame.node == CallstackTree::kInvalidId) {
+      continue;
+    }
+    children.clear();
+    for (CallstackTree::NodeId child = tree.GetFirstChild(frame.node);
+         child != CallstackTree::kInvalidId;
+         child = tree.GetNextSibling(child)) {
+      if (inclusive_counts[child] > 0) {
+        children.push_back(child);
+      }
+    }
+    std::sort(children.begin(), children.end(),
+              [&tree](CallstackTree::NodeId a, CallstackTree::NodeId b) {
+                return tree.GetAddress(a) < tree.GetAddress(b);
+              });
+
+    FlameGraphFrame merged;
+    merged.depth = frame.depth + 1;
+    float x = frame.x;
+    for (CallstackTree::NodeId child : children) {
+      uint64_t count = inclusive_counts[child];
+      float child_width = static_cast<float>(count) * scale;
+      if (child_width < min_width) {
+        if (merged.count == 0) {
+          merged.x = x;
+        }
+        merged.width += child_width;
+        merged.count += count;
+      } else {
+        if (merged.count > 0) {
+          frames.push_back(merged);
+          merged.width = 0.f;
+          merged.count = 0;
+        }
+        frames.push_back({child, merged.depth, x, child_width, count});
+      }
+      x += child_width;
+    }
+    if (merged.count > 0) {
+      frames.push_back(merged);
+    }
+  }
+  return frames;
+}
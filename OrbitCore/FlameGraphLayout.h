@@ -0,0 +1,31 @@
+#ifndef ORBIT_CORE_FLAME_GRAPH_LAYOUT_H_
+#define ORBIT_CORE_FLAME_GRAPH_LAYOUT_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "CallstackTree.h"
+#include "absl/types/span.h"
+
+// Frame of a flame graph: a node of a call tree at its depth, as wide as its
+// share of the samples of the node in focus.
+struct FlameGraphFrame {
+  // kInvalidId for a frame merging callees too narrow to be drawn one by one.
+  CallstackTree::NodeId node = CallstackTree::kInvalidId;
+  uint32_t depth = 0;
+  float x = 0.f;
+  float width = 0.f;
+  uint64_t count = 0;
+};
+
+// Lays out the frames of tree, with inclusive_counts per node, for a graph
+// width wide. The focus spans the whole width, above its callers, which span
+// it too. Runs of callees narrower than min_width are merged into a single
+// frame that isn't descended into, so that the number of frames depends on
+// the width of the graph rather than on the size of the tree. Callees are
+// laid out by address, so that frames keep their place as samples arrive.
+std::vector<FlameGraphFrame> LayoutFlameGraph(
+    const CallstackTree& tree, absl::Span<const uint64_t> inclusive_counts,
+    CallstackTree::NodeId focus, float width, float min_width);
+
+#endif  // ORBIT_CORE_FLAME_GRAPH_LAYOUT_H_
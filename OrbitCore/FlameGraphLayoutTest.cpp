@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include <utility>
+#include <vector>
+
+#include "CallstackTree.h"
+#include "FlameGraphLayout.h"
+
+namespace {
+std::vector<uint64_t> CountSamples(
+    const CallstackTree& tree,
+    const std::vector<std::pair<CallstackTree::NodeId, uint64_t>>& samples) {
+  std::vector<uint64_t> counts(tree.size());
+  for (const auto& [id, count] : samples) {
+    counts[id] += count;
+  }
+  return tree.ComputeInclusiveCounts(std::move(counts));
+}
+}  // namespace
+
+TEST(FlameGraphLayout, LaysOutCalleesByShare) {
+  CallstackTree tree;
+  // Innermost frames first.
+  CallstackTree::NodeId a = tree.Intern(std::vector<uint64_t>{1});
+  CallstackTree::NodeId ac = tree.Intern(std::vector<uint64_t>{3, 1});
+  CallstackTree::NodeId ab = tree.Intern(std::vector<uint64_t>{2, 1});
+  std::vector<uint64_t> counts =
+      CountSamples(tree, {{a, 2}, {ab, 3}, {ac, 5}});
+
+  std::vector<FlameGraphFrame> frames = LayoutFlameGraph(
+      tree, counts, CallstackTree::kRootId, /*width=*/100.f, /*min_width=*/1.f);
+  ASSERT_EQ(frames.size(), 4);
+  EXPECT_EQ(frames[0].node, CallstackTree::kRootId);
+  EXPECT_EQ(frames[0].count, 10);
+  EXPECT_EQ(frames[1].node, a);
+  EXPECT_EQ(frames[1].depth, 1);
+  EXPECT_FLOAT_EQ(frames[1].width, 100.f);
+  // By address rather than by node.
+  EXPECT_EQ(frames[2].node, ab);
+  EXPECT_FLOAT_EQ(frames[2].x, 0.f);
+  EXPECT_FLOAT_EQ(frames[2].width, 30.f);
+  EXPECT_EQ(frames[3].node, ac);
+  EXPECT_EQ(frames[3].depth, 2);
+  EXPECT_FLOAT_EQ(frames[3].x, 30.f);
+  EXPECT_FLOAT_EQ(frames[3].width, 50.f);
+}
+
+TEST(FlameGraphLayout, MergesNarrowCallees) {
+  CallstackTree tree;
+  std::vector<std::pair<CallstackTree::NodeId, uint64_t>> samples;
+  samples.emplace_back(tree.Intern(std::vector<uint64_t>{1}), 50);
+  for (uint64_t address = 2; address < 12; ++address) {
+    samples.emplace_back(tree.Intern(std::vector<uint64_t>{address}), 1);
+    // Never laid out, as its caller is merged.
+    tree.Intern(std::vector<uint64_t>{100, address});
+  }
+  samples.emplace_back(tree.Intern(std::vector<uint64_t>{200}), 40);
+  std::vector<uint64_t> counts = CountSamples(tree, samples);
+
+  std::vector<FlameGraphFrame> frames =
+      LayoutFlameGraph(tree, counts, CallstackTree::kRootId, 100.f, 2.f);
+  ASSERT_EQ(frames.size(), 4);
+  EXPECT_EQ(tree.GetAddress(frames[1].node), 1);
+  EXPECT_EQ(frames[2].node, CallstackTree::kInvalidId);
+  EXPECT_EQ(frames[2].count, 10);
+  EXPECT_FLOAT_EQ(frames[2].x, 50.f);
+  EXPECT_FLOAT_EQ(frames[2].width, 10.f);
+  EXPECT_EQ(tree.GetAddress(frames[3].node), 200);
+  EXPECT_FLOAT_EQ(frames[3].x, 60.f);
+
+  // Wide enough once the graph is.
+  frames = LayoutFlameGraph(tree, counts, CallstackTree::kRootId, 1000.f, 2.f);
+  EXPECT_EQ(frames.size(), 13);
+}
+
+TEST(FlameGraphLayout, SpansFocusAndCallers) {
+  CallstackTree tree;
+  CallstackTree::NodeId ab = tree.Intern(std::vector<uint64_t>{2, 1});
+  CallstackTree::NodeId abc = tree.Intern(std::vector<uint64_t>{3, 2, 1});
+  CallstackTree::NodeId d = tree.Intern(std::vector<uint64_t>{4});
+  std::vector<uint64_t> counts = CountSamples(tree, {{abc, 1}, {d, 3}});
+
+  std::vector<FlameGraphFrame> frames =
+      LayoutFlameGraph(tree, counts, ab, 100.f, 1.f);
+  ASSERT_EQ(frames.size(), 4);
+  // Callers first, innermost first.
+  EXPECT_EQ(frames[0].node, tree.GetParent(ab));
+  EXPECT_EQ(frames[1].node, CallstackTree::kRootId);
+  EXPECT_EQ(frames[1].count, 4);
+  EXPECT_EQ(frames[2].node, ab);
+  EXPECT_EQ(frames[3].node, abc);
+  for (const FlameGraphFrame& frame : frames) {
+    EXPECT_FLOAT_EQ(frame.width, 100.f);
+  }
+
+  EXPECT_TRUE(LayoutFlameGraph(tree, {}, ab, 100.f, 1.f).empty());
+  EXPECT_TRUE(LayoutFlameGraph(tree, counts, CallstackTree::kInvalidId, 100.f,
+                               1.f)
+                  .empty());
+}
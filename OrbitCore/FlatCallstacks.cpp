@@ -0,0 +1,195 @@
+#include "FlatCallstacks.h"
+
+#include <cstring>
+
+#include "EventBuffer.h"
+#include "LinuxCallstackEvent.h"
+
+// The columns are written and read with the host's byte order. All the
+// platforms Orbit runs on are little-endian.
+
+namespace {
+template <typename T>
+char* WriteColumn(char* output, const std::vector<T>& column) {
+  memcpy(output, column.data(), column.size() * sizeof(T));
+  return output + column.size() * sizeof(T);
+}
+
+template <typename T>
+absl::Span<const T> ReadColumn(const char** input, size_t size) {
+  absl::Span<const T> column(reinterpret_cast<const T*>(*input), size);
+  *input += size * sizeof(T);
+  return column;
+}
+
+// Returns the header if data starts with a header of the current version and
+// is suitably aligned to be read in place.
+std::optional<FlatCallstacksHeader> ReadHeader(const void* data, size_t size) {
+  if (size < sizeof(FlatCallstacksHeader) ||
+      reinterpret_cast<uintptr_t>(data) % alignof(uint64_t) != 0) {
+    return std::nullopt;
+  }
+  FlatCallstacksHeader header;
+  memcpy(&header, data, sizeof(header));
+  if (header.version != FlatCallstacksHeader::kVersion) {
+    return std::nullopt;
+  }
+  return header;
+}
+}  // namespace
+
+std::string EncodeFlatCallstacks(
+    const std::vector<LinuxCallstackEvent>& callstacks) {
+  std::vector<uint64_t> times;
+  std::vector<uint64_t> ids;
+  std::vector<uint64_t> frames;
+  std::vector<uint32_t> thread_ids;
+  std::vector<uint32_t> depths;
+  times.reserve(callstacks.size());
+  ids.reserve(callstacks.size());
+  thread_ids.reserve(callstacks.size());
+  depths.reserve(callstacks.size());
+  for (const LinuxCallstackEvent& callstack : callstacks) {
+    times.push_back(callstack.m_time);
+    ids.push_back(callstack.m_CS.m_Hash);
+    thread_ids.push_back(callstack.m_CS.m_ThreadId);
+    depths.push_back(callstack.m_CS.m_Data.size());
+    frames.insert(frames.end(), callstack.m_CS.m_Data.begin(),
+                  callstack.m_CS.m_Data.end());
+  }
+
+  FlatCallstacksHeader header{FlatCallstacksHeader::kVersion,
+                              static_cast<uint32_t>(callstacks.size()),
+                              frames.size()};
+  std::string data(sizeof(header) +
+                       callstacks.size() * (2 * sizeof(uint64_t) +
+                                            2 * sizeof(uint32_t)) +
+                       frames.size() * sizeof(uint64_t),
+                   '\0');
+  char* output = data.data();
+  memcpy(output, &header, sizeof(header));
+  output += sizeof(header);
+  output = WriteColumn(output, times);
+  output = WriteColumn(output, ids);
+  output = WriteColumn(output, frames);
+  output = WriteColumn(output, thread_ids);
+  WriteColumn(output, depths);
+  return data;
+}
+
+std::string EncodeFlatHashedCallstacks(
+    const std::vector<CallstackEvent>& callstacks) {
+  FlatCallstacksHeader header{FlatCallstacksHeader::kVersion,
+                              static_cast<uint32_t>(callstacks.size()), 0};
+  std::string data(sizeof(header) + callstacks.size() * (2 * sizeof(uint64_t) +
+                                                         sizeof(uint32_t)),
+                   '\0');
+  char* output = data.data();
+  memcpy(output, &header, sizeof(header));
+  output += sizeof(header);
+
+  // Written column by column directly, as there are no variable-size fields.
+  auto* times = reinterpret_cast<uint64_t*>(output);
+  auto* ids = times + callstacks.size();
+  auto* thread_ids = reinterpret_cast<uint32_t*>(ids + callstacks.size());
+  for (size_t i = 0; i < callstacks.size(); ++i) {
+    times[i] = callstacks[i].m_Time;
+    ids[i] = callstacks[i].m_Id;
+    thread_ids[i] = callstacks[i].m_TID;
+  }
+  return data;
+}
+
+std::string EncodeFlatOffCpuCallstacks(
+    const std::vector<OffCpuCallstackEvent>& callstacks) {
+  std::vector<LinuxCallstackEvent> events;
+  std::vector<uint64_t> durations_ns;
+  events.reserve(callstacks.size());
+  durations_ns.reserve(callstacks.size());
+  for (const OffCpuCallstackEvent& callstack : callstacks) {
+    events.push_back(callstack.m_Event);
+    durations_ns.push_back(callstack.m_DurationNs);
+  }
+  std::string data = EncodeFlatCallstacks(events);
+  size_t callstacks_size = data.size();
+  data.resize(callstacks_size + durations_ns.size() * sizeof(uint64_t));
+  WriteColumn(data.data() + callstacks_size, durations_ns);
+  return data;
+}
+
+std::optional<FlatCallstacksView> FlatCallstacksView::Create(const void* data,
+                                                             size_t size) {
+  std::optional<FlatCallstacksHeader> header = ReadHeader(data, size);
+  if (!header.has_value()) {
+    return std::nullopt;
+  }
+  size_t n = header->num_callstacks;
+  if (size != sizeof(FlatCallstacksHeader) +
+                  n * (2 * sizeof(uint64_t) + 2 * sizeof(uint32_t)) +
+                  header->num_frames * sizeof(uint64_t)) {
+    return std::nullopt;
+  }
+
+  FlatCallstacksView view;
+  const char* input =
+      static_cast<const char*>(data) + sizeof(FlatCallstacksHeader);
+  view.times_ = ReadColumn<uint64_t>(&input, n);
+  view.ids_ = ReadColumn<uint64_t>(&input, n);
+  view.frames_ = ReadColumn<uint64_t>(&input, header->num_frames);
+  view.thread_ids_ = ReadColumn<uint32_t>(&input, n);
+  view.depths_ = ReadColumn<uint32_t>(&input, n);
+
+  uint64_t total_depth = 0;
+  for (uint32_t depth : view.depths_) {
+    total_depth += depth;
+  }
+  if (total_depth != header->num_frames) {
+    return std::nullopt;
+  }
+  return view;
+}
+
+std::optional<FlatHashedCallstacksView> FlatHashedCallstacksView::Create(
+    const void* data, size_t size) {
+  std::optional<FlatCallstacksHeader> header = ReadHeader(data, size);
+  if (!header.has_value()) {
+    return std::nullopt;
+  }
+  size_t n = header->num_callstacks;
+  if (header->num_frames != 0 ||
+      size != sizeof(FlatCallstacksHeader) +
+                  n * (2 * sizeof(uint64_t) + sizeof(uint32_t))) {
+    return std::nullopt;
+  }
+
+  FlatHashedCallstacksView view;
+  const char* input =
+      static_cast<const char*>(data) + sizeof(FlatCallstacksHeader);
+  view.times_ = ReadColumn<uint64_t>(&input, n);
+  view.ids_ = ReadColumn<uint64_t>(&input, n);
+  view.thread_ids_ = ReadColumn<uint32_t>(&input, n);
+  return view;
+}
+
+std::optional<FlatOffCpuCallstacksView> FlatOffCpuCallstacksView::Create(
+    const void* data, size_t size) {
+  std::optional<FlatCallstacksHeader> header = ReadHeader(data, size);
+  if (!header.has_value()) {
+    return std::nullopt;
+  }
+  size_t durations_size = header->num_callstacks * sizeof(uint64_t);
+  if (size < durations_size) {
+    return std::nullopt;
+  }
+  size_t callstacks_size = size - durations_size;
+  std::optional<FlatCallstacksView> callstacks =
+      FlatCallstacksView::Create(data, callstacks_size);
+  if (!callstacks.has_value()) {
+    return std::nullopt;
+  }
+
+  FlatOffCpuCallstacksView view{callstacks.value()};
+  const char* input = static_cast<const char*>(data) + callstacks_size;
+  view.durations_ns_ = ReadColumn<uint64_t>(&input, header->num_callstacks);
+  return view;
+}
@@ -0,0 +1,111 @@
+#ifndef ORBIT_CORE_FLAT_CALLSTACKS_H_
+#define ORBIT_CORE_FLAT_CALLSTACKS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "CallstackTypes.h"
+#include "absl/types/span.h"
+
+class LinuxCallstackEvent;
+struct CallstackEvent;
+struct OffCpuCallstackEvent;
+
+// Flat encodings of the batches of callstacks sent from the service, for
+// Msg_SamplingCallstacks, Msg_SamplingHashedCallstacks and
+// Msg_OffCpuCallstacks. Unlike cereal
+// archives, they are read in place: a view only checks the sizes and then
+// points into the message payload, which has to be 8-byte aligned (message
+// payloads are).
+//
+// Both start with a FlatCallstacksHeader, followed by little-endian columns,
+// the 64-bit ones first so that every column is naturally aligned:
+// - callstacks: uint64_t times[n], uint64_t ids[n], uint64_t frames[f],
+//   uint32_t thread_ids[n], uint32_t depths[n];
+// - hashed callstacks: uint64_t times[n], uint64_t ids[n],
+//   uint32_t thread_ids[n];
+// - off-CPU callstacks: the columns of callstacks, then
+//   uint64_t durations[n], which stays aligned as the two 32-bit columns
+//   before it take 8 * n bytes.
+// The frames of all callstacks are concatenated, in order.
+struct FlatCallstacksHeader {
+  static constexpr uint32_t kVersion = 1;
+  uint32_t version;
+  uint32_t num_callstacks;
+  uint64_t num_frames;
+};
+
+std::string EncodeFlatCallstacks(
+    const std::vector<LinuxCallstackEvent>& callstacks);
+std::string EncodeFlatHashedCallstacks(
+    const std::vector<CallstackEvent>& callstacks);
+std::string EncodeFlatOffCpuCallstacks(
+    const std::vector<OffCpuCallstackEvent>& callstacks);
+
+class FlatCallstacksView {
+ public:
+  // Returns nullopt if data is not a valid encoding of this version.
+  static std::optional<FlatCallstacksView> Create(const void* data,
+                                                  size_t size);
+
+  size_t size() const { return times_.size(); }
+  uint64_t GetTime(size_t index) const { return times_[index]; }
+  CallstackID GetId(size_t index) const { return ids_[index]; }
+  ThreadID GetThreadId(size_t index) const { return thread_ids_[index]; }
+
+  // Calls callback(index, frames) for each callstack, in order. Frames are
+  // looked up sequentially, as they are only delimited by the depths.
+  template <typename Callback>
+  void ForEachCallstack(Callback&& callback) const {
+    size_t frames_offset = 0;
+    for (size_t i = 0; i < size(); ++i) {
+      callback(i, frames_.subspan(frames_offset, depths_[i]));
+      frames_offset += depths_[i];
+    }
+  }
+
+ private:
+  absl::Span<const uint64_t> times_;
+  absl::Span<const uint64_t> ids_;
+  absl::Span<const uint64_t> frames_;
+  absl::Span<const uint32_t> thread_ids_;
+  absl::Span<const uint32_t> depths_;
+};
+
+class FlatHashedCallstacksView {
+ public:
+  static std::optional<FlatHashedCallstacksView> Create(const void* data,
+                                                        size_t size);
+
+  size_t size() const { return times_.size(); }
+  uint64_t GetTime(size_t index) const { return times_[index]; }
+  CallstackID GetId(size_t index) const { return ids_[index]; }
+  ThreadID GetThreadId(size_t index) const { return thread_ids_[index]; }
+
+ private:
+  absl::Span<const uint64_t> times_;
+  absl::Span<const uint64_t> ids_;
+  absl::Span<const uint32_t> thread_ids_;
+};
+
+class FlatOffCpuCallstacksView {
+ public:
+  static std::optional<FlatOffCpuCallstacksView> Create(const void* data,
+                                                        size_t size);
+
+  // The times are when the threads were switched out.
+  const FlatCallstacksView& GetCallstacks() const { return callstacks_; }
+  uint64_t GetDurationNs(size_t index) const { return durations_ns_[index]; }
+
+ private:
+  explicit FlatOffCpuCallstacksView(FlatCallstacksView callstacks)
+      : callstacks_(callstacks) {}
+
+  FlatCallstacksView callstacks_;
+  absl::Span<const uint64_t> durations_ns_;
+};
+
+#endif  // ORBIT_CORE_FLAT_CALLSTACKS_H_
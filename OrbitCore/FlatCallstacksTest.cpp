@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "EventBuffer.h"
+#include "FlatCallstacks.h"
+#include "LinuxCallstackEvent.h"
+
+namespace {
+LinuxCallstackEvent MakeCallstack(uint64_t time, CallstackID id, ThreadID tid,
+                                  std::vector<uint64_t> frames) {
+  LinuxCallstackEvent callstack;
+  callstack.m_time = time;
+  callstack.m_CS.m_Hash = id;
+  callstack.m_CS.m_ThreadId = tid;
+  callstack.m_CS.m_Depth = frames.size();
+  callstack.m_CS.m_Data = std::move(frames);
+  return callstack;
+}
+
+// Message payloads are 8-byte aligned, std::string data is not necessarily.
+std::vector<uint64_t> Align(const std::string& data) {
+  std::vector<uint64_t> aligned((data.size() + 7) / 8);
+  memcpy(aligned.data(), data.data(), data.size());
+  return aligned;
+}
+}  // namespace
+
+TEST(FlatCallstacks, CallstacksRoundTrip) {
+  std::vector<LinuxCallstackEvent> callstacks;
+  callstacks.push_back(MakeCallstack(10, 1, 100, {0x10, 0x20, 0x30}));
+  callstacks.push_back(MakeCallstack(20, 2, 200, {}));
+  callstacks.push_back(MakeCallstack(30, 3, 300, {0x40}));
+  std::string data = EncodeFlatCallstacks(callstacks);
+  std::vector<uint64_t> aligned = Align(data);
+
+  std::optional<FlatCallstacksView> view =
+      FlatCallstacksView::Create(aligned.data(), data.size());
+  ASSERT_TRUE(view.has_value());
+  ASSERT_EQ(view->size(), 3);
+  std::vector<std::vector<uint64_t>> frames;
+  view->ForEachCallstack([&](size_t index, absl::Span<const uint64_t> span) {
+    EXPECT_EQ(view->GetTime(index), callstacks[index].m_time);
+    EXPECT_EQ(view->GetId(index), callstacks[index].m_CS.m_Hash);
+    EXPECT_EQ(view->GetThreadId(index), callstacks[index].m_CS.m_ThreadId);
+    frames.emplace_back(span.begin(), span.end());
+  });
+  ASSERT_EQ(frames.size(), 3);
+  for (size_t i = 0; i < frames.size(); ++i) {
+    EXPECT_EQ(frames[i], callstacks[i].m_CS.m_Data);
+  }
+}
+
+TEST(FlatCallstacks, HashedCallstacksRoundTrip) {
+  std::vector<CallstackEvent> callstacks = {{10, 1, 100}, {20, 2, 200}};
+  std::string data = EncodeFlatHashedCallstacks(callstacks);
+  std::vector<uint64_t> aligned = Align(data);
+
+  std::optional<FlatHashedCallstacksView> view =
+      FlatHashedCallstacksView::Create(aligned.data(), data.size());
+  ASSERT_TRUE(view.has_value());
+  ASSERT_EQ(view->size(), 2);
+  for (size_t i = 0; i < view->size(); ++i) {
+    EXPECT_EQ(view->GetTime(i), callstacks[i].m_Time);
+    EXPECT_EQ(view->GetId(i), callstacks[i].m_Id);
+    EXPECT_EQ(view->GetThreadId(i), callstacks[i].m_TID);
+  }
+}
+
+TEST(FlatCallstacks, OffCpuCallstacksRoundTrip) {
+  std::vector<OffCpuCallstackEvent> callstacks;
+  callstacks.push_back({MakeCallstack(10, 1, 100, {0x10, 0x20}), 5000});
+  callstacks.push_back({MakeCallstack(20, 2, 200, {0x30}), 70});
+  std::string data = EncodeFlatOffCpuCallstacks(callstacks);
+  std::vector<uint64_t> aligned = Align(data);
+
+  std::optional<FlatOffCpuCallstacksView> view =
+      FlatOffCpuCallstacksView::Create(aligned.data(), data.size());
+  ASSERT_TRUE(view.has_value());
+  ASSERT_EQ(view->GetCallstacks().size(), 2);
+  view->GetCallstacks().ForEachCallstack(
+      [&](size_t index, absl::Span<const uint64_t> frames) {
+        const LinuxCallstackEvent& event = callstacks[index].m_Event;
+        EXPECT_EQ(view->GetCallstacks().GetTime(index), event.m_time);
+        EXPECT_EQ(view->GetCallstacks().GetThreadId(index),
+                  event.m_CS.m_ThreadId);
+        EXPECT_EQ(std::vector<uint64_t>(frames.begin(), frames.end()),
+                  event.m_CS.m_Data);
+        EXPECT_EQ(view->GetDurationNs(index), callstacks[index].m_DurationNs);
+      });
+
+  EXPECT_FALSE(FlatOffCpuCallstacksView::Create(aligned.data(),
+                                                data.size() - sizeof(uint64_t))
+                   .has_value());
+}
+
+TEST(FlatCallstacks, EmptyBatch) {
+  std::string data = EncodeFlatCallstacks({});
+  std::vector<uint64_t> aligned = Align(data);
+  std::optional<FlatCallstacksView> view =
+      FlatCallstacksView::Create(aligned.data(), data.size());
+  ASSERT_TRUE(view.has_value());
+  EXPECT_EQ(view->size(), 0);
+}
+
+TEST(FlatCallstacks, RejectsTruncatedData) {
+  std::string data =
+      EncodeFlatCallstacks({MakeCallstack(10, 1, 100, {0x10, 0x20})});
+  std::vector<uint64_t> aligned = Align(data);
+  for (size_t size : {size_t{0}, sizeof(FlatCallstacksHeader),
+                      data.size() - 1}) {
+    EXPECT_FALSE(FlatCallstacksView::Create(aligned.data(), size).has_value());
+  }
+
+  std::string hashed_data = EncodeFlatHashedCallstacks({{10, 1, 100}});
+  std::vector<uint64_t> hashed_aligned = Align(hashed_data);
+  EXPECT_FALSE(FlatHashedCallstacksView::Create(hashed_aligned.data(),
+                                                hashed_data.size() - 4)
+                   .has_value());
+}
+
+TEST(FlatCallstacks, RejectsInconsistentDepths) {
+  std::string data =
+      EncodeFlatCallstacks({MakeCallstack(10, 1, 100, {0x10, 0x20})});
+  std::vector<uint64_t> aligned = Align(data);
+  // The single depth is the last column.
+  uint32_t depth = 3;
+  memcpy(reinterpret_cast<char*>(aligned.data()) + data.size() - sizeof(depth),
+         &depth, sizeof(depth));
+  EXPECT_FALSE(
+      FlatCallstacksView::Create(aligned.data(), data.size()).has_value());
+}
+
+TEST(FlatCallstacks, RejectsOtherVersion) {
+  std::string data = EncodeFlatHashedCallstacks({{10, 1, 100}});
+  std::vector<uint64_t> aligned = Align(data);
+  uint32_t version = FlatCallstacksHeader::kVersion + 1;
+  memcpy(aligned.data(), &version, sizeof(version));
+  EXPECT_FALSE(FlatHashedCallstacksView::Create(aligned.data(), data.size())
+                   .has_value());
+}
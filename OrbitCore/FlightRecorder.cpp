@@ -0,0 +1,91 @@
+#include "FlightRecorder.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "CaptureFile.h"
+
+FlightRecorder::FlightRecorder(uint64_t window_ns, uint64_t max_bytes,
+                               size_t chunk_size)
+    : window_ns_(window_ns), max_bytes_(max_bytes), chunk_size_(chunk_size) {}
+
+void FlightRecorder::AddMessage(MessageType type, const void* data,
+                                size_t size, uint64_t begin_time,
+                                uint64_t end_time) {
+  if (current_.data.empty()) {
+    current_.begin_time = begin_time;
+    current_.end_time = end_time;
+  } else {
+    current_.begin_time = std::min(current_.begin_time, begin_time);
+    current_.end_time = std::max(current_.end_time, end_time);
+  }
+  latest_time_ = std::max(latest_time_, end_time);
+
+  CaptureMessageHeader header{static_cast<uint32_t>(type),
+                              static_cast<uint32_t>(size)};
+  current_.data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  current_.data.append(static_cast<const char*>(data), size);
+  if (current_.data.size() >= chunk_size_) {
+    CloseCurrentChunk();
+    DiscardOldChunks();
+  }
+}
+
+void FlightRecorder::CloseCurrentChunk() {
+  num_bytes_ += current_.data.size();
+  chunks_.push_back(std::move(current_));
+  current_ = Chunk();
+  current_.data.swap(spare_buffer_);
+  current_.data.reserve(chunk_size_);
+}
+
+void FlightRecorder::DiscardOldChunks() {
+  uint64_t window_begin = latest_time_ > window_ns_ ? latest_time_ - window_ns_
+                                                    : 0;
+  // The chunk being filled is at most chunk_size more.
+  while (!chunks_.empty() && (chunks_.front().end_time < window_begin ||
+                              num_bytes_ + chunk_size_ > max_bytes_)) {
+    num_bytes_ -= chunks_.front().data.size();
+    RecycleBuffer(&chunks_.front().data);
+    chunks_.pop_front();
+  }
+}
+
+void FlightRecorder::RecycleBuffer(std::string* buffer) {
+  if (spare_buffer_.capacity() < buffer->capacity()) {
+    buffer->clear();
+    spare_buffer_.swap(*buffer);
+  }
+}
+
+void FlightRecorder::Dump(
+    const std::function<void(MessageType type, const char* data,
+                             uint32_t size)>& action) {
+  if (!current_.data.empty()) {
+    CloseCurrentChunk();
+  }
+  for (Chunk& chunk : chunks_) {
+    const char* data = chunk.data.data();
+    const char* end = data + chunk.data.size();
+    while (data < end) {
+      CaptureMessageHeader header;
+      std::memcpy(&header, data, sizeof(header));
+      data += sizeof(header);
+      action(static_cast<MessageType>(header.type), data, header.size);
+      data += header.size;
+    }
+    RecycleBuffer(&chunk.data);
+  }
+  chunks_.clear();
+  num_bytes_ = 0;
+}
+
+uint64_t FlightRecorder::GetBeginTime() const {
+  uint64_t begin_time = current_.data.empty() ? 0 : current_.begin_time;
+  for (const Chunk& chunk : chunks_) {
+    if (begin_time == 0 || chunk.begin_time < begin_time) {
+      begin_time = chunk.begin_time;
+    }
+  }
+  return begin_time;
+}
@@ -0,0 +1,79 @@
+#ifndef ORBIT_CORE_FLIGHT_RECORDER_H_
+#define ORBIT_CORE_FLIGHT_RECORDER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+
+#include "Message.h"
+
+#pragma pack(push, 1)
+// Payload of Msg_FlightRecorderRequest, sent by the UI before
+// Msg_StartCapture for the service to keep the last window_ns of the capture
+// in memory instead of streaming it, until Msg_FlightRecorderDump.
+struct FlightRecorderSettings {
+  uint64_t window_ns;
+  uint64_t max_bytes;
+};
+#pragma pack(pop)
+
+// Ring of the messages the service would have sent for a capture, so that it
+// can run indefinitely and send only its last seconds when triggered, e.g.
+// right after a hitch.
+//
+// Messages are encoded like in a capture file, see CaptureFile.h, into chunks
+// of about chunk_size bytes. Once a chunk is full, the oldest chunks whose
+// events all precede the window, or beyond max_bytes, are discarded whole, in
+// constant time per chunk, their buffers being reused for the next chunks. The
+// memory thus stays about max_bytes however long the capture runs.
+class FlightRecorder {
+ public:
+  static constexpr size_t kDefaultChunkSize = 1024 * 1024;
+
+  FlightRecorder(uint64_t window_ns, uint64_t max_bytes,
+                 size_t chunk_size = kDefaultChunkSize);
+
+  // Adds a message whose events happened between begin_time and end_time.
+  void AddMessage(MessageType type, const void* data, size_t size,
+                  uint64_t begin_time, uint64_t end_time);
+
+  // Calls action for each message kept, in the order they were added, then
+  // discards them: the next dump only has the messages added after this one.
+  void Dump(const std::function<void(MessageType type, const char* data,
+                                     uint32_t size)>& action);
+
+  // Of the messages kept, headers included.
+  uint64_t GetNumBytes() const { return num_bytes_ + current_.data.size(); }
+  size_t GetNumChunks() const {
+    return chunks_.size() + (current_.data.empty() ? 0 : 1);
+  }
+  // Of the earliest event kept, 0 if none.
+  uint64_t GetBeginTime() const;
+
+ private:
+  struct Chunk {
+    uint64_t begin_time = 0;
+    uint64_t end_time = 0;
+    std::string data;
+  };
+
+  void CloseCurrentChunk();
+  void DiscardOldChunks();
+  void RecycleBuffer(std::string* buffer);
+
+  uint64_t window_ns_;
+  uint64_t max_bytes_;
+  size_t chunk_size_;
+  // Closed chunks, oldest first.
+  std::deque<Chunk> chunks_;
+  Chunk current_;
+  uint64_t num_bytes_ = 0;
+  // Of the latest event added.
+  uint64_t latest_time_ = 0;
+  // Buffer of a discarded chunk, for the next one.
+  std::string spare_buffer_;
+};
+
+#endif  // ORBIT_CORE_FLIGHT_RECORDER_H_
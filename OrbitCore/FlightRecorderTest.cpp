@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "FlightRecorder.h"
+
+namespace {
+struct DumpedMessage {
+  MessageType type;
+  std::string data;
+};
+
+std::vector<DumpedMessage> Dump(FlightRecorder* recorder) {
+  std::vector<DumpedMessage> messages;
+  recorder->Dump([&](MessageType type, const char* data, uint32_t size) {
+    messages.push_back({type, std::string(data, size)});
+  });
+  return messages;
+}
+}  // namespace
+
+TEST(FlightRecorder, DumpsMessagesInOrderOnce) {
+  FlightRecorder recorder(/*window_ns=*/1000, /*max_bytes=*/1024);
+  recorder.AddMessage(Msg_RemoteTimers, "abc", 3, 100, 200);
+  recorder.AddMessage(Msg_SamplingCallstacks, "", 0, 150, 150);
+  recorder.AddMessage(Msg_RemoteCoreActivities, "de", 2, 50, 300);
+  EXPECT_EQ(recorder.GetBeginTime(), 50);
+
+  std::vector<DumpedMessage> messages = Dump(&recorder);
+  ASSERT_EQ(messages.size(), 3);
+  EXPECT_EQ(messages[0].type, Msg_RemoteTimers);
+  EXPECT_EQ(messages[0].data, "abc");
+  EXPECT_EQ(messages[1].type, Msg_SamplingCallstacks);
+  EXPECT_EQ(messages[1].data, "");
+  EXPECT_EQ(messages[2].data, "de");
+
+  EXPECT_EQ(recorder.GetNumBytes(), 0);
+  recorder.AddMessage(Msg_RemoteTimers, "f", 1, 400, 500);
+  messages = Dump(&recorder);
+  ASSERT_EQ(messages.size(), 1);
+  EXPECT_EQ(messages[0].data, "f");
+}
+
+TEST(FlightRecorder, DiscardsChunksBeforeTheWindow) {
+  // A chunk per message, headers included.
+  FlightRecorder recorder(/*window_ns=*/100, /*max_bytes=*/1024,
+                          /*chunk_size=*/8);
+  for (uint64_t time = 0; time < 1000; time += 10) {
+    recorder.AddMessage(Msg_RemoteTimers, &time, sizeof(time), time,
+                        time + 5);
+  }
+
+  std::vector<DumpedMessage> messages = Dump(&recorder);
+  // The chunks that end at most 100 ns before the last event, at 995.
+  ASSERT_EQ(messages.size(), 11);
+  uint64_t first_time;
+  std::memcpy(&first_time, messages[0].data.data(), sizeof(first_time));
+  EXPECT_EQ(first_time, 890);
+}
+
+TEST(FlightRecorder, StaysWithinMaxBytes) {
+  FlightRecorder recorder(/*window_ns=*/1'000'000'000, /*max_bytes=*/256,
+                          /*chunk_size=*/64);
+  std::string payload(40, 'x');
+  for (uint64_t time = 0; time < 10'000; ++time) {
+    recorder.AddMessage(Msg_RemoteTimers, payload.data(), payload.size(),
+                        time, time);
+    EXPECT_LE(recorder.GetNumBytes(), 256);
+  }
+  EXPECT_GT(recorder.GetNumChunks(), 1);
+  EXPECT_FALSE(Dump(&recorder).empty());
+}
@@ -0,0 +1,95 @@
+#include "FrameIndex.h"
+
+#include <algorithm>
+
+void FrameIndex::AddFrameStart(uint64_t start) {
+  if (starts_.empty() || start > starts_.back()) {
+    starts_.push_back(start);
+    if (starts_.size() >= 2) UpdateSpikes(GetNumFrames() - 1);
+    return;
+  }
+
+  auto it = std::lower_bound(starts_.begin(), starts_.end(), start);
+  if (*it == start) return;
+  size_t index = it - starts_.begin();
+  starts_.insert(it, start);
+  // The frame that was split, and the windows of the frames after it.
+  UpdateSpikes(index > 0 ? index - 1 : 0);
+}
+
+void FrameIndex::Build(std::vector<uint64_t> starts) {
+  std::sort(starts.begin(), starts.end());
+  starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+  starts_ = std::move(starts);
+  spikes_.clear();
+  UpdateSpikes(0);
+}
+
+void FrameIndex::Clear() {
+  starts_.clear();
+  spikes_.clear();
+}
+
+std::optional<size_t> FrameIndex::GetFrameAt(uint64_t tick) const {
+  if (GetNumFrames() == 0 || tick < starts_.front() || tick >= starts_.back()) {
+    return std::nullopt;
+  }
+  auto it = std::upper_bound(starts_.begin(), starts_.end(), tick);
+  return (it - starts_.begin()) - 1;
+}
+
+std::pair<size_t, size_t> FrameIndex::GetFramesInRange(uint64_t min,
+                                                       uint64_t max) const {
+  size_t num_frames = GetNumFrames();
+  // Frame i ends after min when start i + 1 does.
+  size_t first = std::upper_bound(starts_.begin(), starts_.end(), min) -
+                 starts_.begin();
+  first = std::min(first > 0 ? first - 1 : 0, num_frames);
+  size_t last = std::upper_bound(starts_.begin(), starts_.end(), max) -
+                starts_.begin();
+  last = std::min(last, num_frames);
+  return {first, std::max(first, last)};
+}
+
+std::vector<size_t> FrameIndex::GetWorstFrames(size_t count) const {
+  std::vector<size_t> frames(GetNumFrames());
+  for (size_t i = 0; i < frames.size(); ++i) frames[i] = i;
+  count = std::min(count, frames.size());
+  std::partial_sort(frames.begin(), frames.begin() + count, frames.end(),
+                    [this](size_t a, size_t b) {
+                      uint64_t duration_a = GetFrameDuration(a);
+                      uint64_t duration_b = GetFrameDuration(b);
+                      return duration_a != duration_b ? duration_a > duration_b
+                                                      : a < b;
+                    });
+  frames.resize(count);
+  return frames;
+}
+
+std::vector<size_t> FrameIndex::GetSpikes() const {
+  std::vector<size_t> spikes;
+  for (size_t i = 0; i < spikes_.size(); ++i) {
+    if (spikes_[i]) spikes.push_back(i);
+  }
+  return spikes;
+}
+
+void FrameIndex::UpdateSpikes(size_t first_frame) {
+  size_t num_frames = GetNumFrames();
+  spikes_.resize(num_frames);
+  for (size_t frame = first_frame; frame < num_frames; ++frame) {
+    size_t window_begin = frame > spike_window_ ? frame - spike_window_ : 0;
+    if (window_begin == frame) {
+      spikes_[frame] = false;
+      continue;
+    }
+
+    window_.clear();
+    for (size_t i = window_begin; i < frame; ++i) {
+      window_.push_back(GetFrameDuration(i));
+    }
+    auto median = window_.begin() + window_.size() / 2;
+    std::nth_element(window_.begin(), median, window_.end());
+    spikes_[frame] = GetFrameDuration(frame) > spike_factor_ * *median;
+  }
+}
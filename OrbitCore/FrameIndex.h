@@ -0,0 +1,63 @@
+#ifndef ORBIT_CORE_FRAME_INDEX_H_
+#define ORBIT_CORE_FRAME_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// The frames of a game loop, from the starts of the calls to its main frame
+// function: frame i lasts from start i to start i + 1, so the last start only
+// ends the frame before it. The starts are kept sorted, so that the frame of a
+// time, and the frames of a time range, are found in O(log n).
+// A frame is a spike when it lasts more than spike_factor times the median of
+// the spike_window frames before it. Spikes are flagged as frames are added,
+// which costs O(spike_window) per frame added in order. Not thread-safe.
+class FrameIndex {
+ public:
+  static constexpr double kDefaultSpikeFactor = 1.5;
+  static constexpr size_t kDefaultSpikeWindow = 32;
+
+  explicit FrameIndex(double spike_factor = kDefaultSpikeFactor,
+                      size_t spike_window = kDefaultSpikeWindow)
+      : spike_factor_(spike_factor), spike_window_(spike_window) {}
+
+  // Starts are expected mostly in order. A start already added is ignored.
+  void AddFrameStart(uint64_t start);
+  // Replaces the frames by those of starts, in any order.
+  void Build(std::vector<uint64_t> starts);
+  void Clear();
+
+  size_t GetNumFrames() const {
+    return starts_.size() < 2 ? 0 : starts_.size() - 1;
+  }
+  uint64_t GetFrameStart(size_t frame) const { return starts_[frame]; }
+  uint64_t GetFrameEnd(size_t frame) const { return starts_[frame + 1]; }
+  uint64_t GetFrameDuration(size_t frame) const {
+    return GetFrameEnd(frame) - GetFrameStart(frame);
+  }
+  bool IsSpike(size_t frame) const { return spikes_[frame]; }
+
+  // The frame that tick is in, nullopt if it is before the first frame or
+  // after the last one.
+  std::optional<size_t> GetFrameAt(uint64_t tick) const;
+  // The frames overlapping [min, max], as [first, last).
+  std::pair<size_t, size_t> GetFramesInRange(uint64_t min, uint64_t max) const;
+  // The count longest frames, longest first.
+  std::vector<size_t> GetWorstFrames(size_t count) const;
+  std::vector<size_t> GetSpikes() const;
+
+ private:
+  // Flags the spikes of the frames from first_frame on.
+  void UpdateSpikes(size_t first_frame);
+
+  double spike_factor_;
+  size_t spike_window_;
+  std::vector<uint64_t> starts_;
+  std::vector<bool> spikes_;
+  // The durations of the window of the frame whose spike is updated.
+  std::vector<uint64_t> window_;
+};
+
+#endif  // ORBIT_CORE_FRAME_INDEX_H_
@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "FrameIndex.h"
+
+namespace {
+using FrameRange = std::pair<size_t, size_t>;
+}  // namespace
+
+TEST(FrameIndex, FindsTheFrameOfATick) {
+  FrameIndex index;
+  for (uint64_t start : {100, 200, 350, 400}) {
+    index.AddFrameStart(start);
+  }
+  ASSERT_EQ(index.GetNumFrames(), 3);
+  EXPECT_EQ(index.GetFrameDuration(1), 150);
+
+  EXPECT_FALSE(index.GetFrameAt(99).has_value());
+  EXPECT_EQ(index.GetFrameAt(100), 0);
+  EXPECT_EQ(index.GetFrameAt(199), 0);
+  EXPECT_EQ(index.GetFrameAt(200), 1);
+  EXPECT_EQ(index.GetFrameAt(399), 2);
+  // The last start only ends the frame before it.
+  EXPECT_FALSE(index.GetFrameAt(400).has_value());
+
+  EXPECT_EQ(index.GetFramesInRange(0, 1000), (FrameRange{0, 3}));
+  EXPECT_EQ(index.GetFramesInRange(250, 360), (FrameRange{1, 3}));
+  EXPECT_EQ(index.GetFramesInRange(500, 600), (FrameRange{3, 3}));
+}
+
+TEST(FrameIndex, SortsStartsAddedOutOfOrder) {
+  FrameIndex index;
+  for (uint64_t start : {100, 300, 200, 300, 0}) {
+    index.AddFrameStart(start);
+  }
+  ASSERT_EQ(index.GetNumFrames(), 3);
+  for (size_t i = 0; i < index.GetNumFrames(); ++i) {
+    EXPECT_EQ(index.GetFrameStart(i), i * 100);
+    EXPECT_EQ(index.GetFrameDuration(i), 100);
+  }
+}
+
+TEST(FrameIndex, WorstFrames) {
+  FrameIndex index;
+  index.Build({0, 10, 40, 45, 65, 75});
+  EXPECT_EQ(index.GetWorstFrames(3), (std::vector<size_t>{1, 3, 0}));
+  EXPECT_EQ(index.GetWorstFrames(10).size(), 5);
+}
+
+TEST(FrameIndex, SpikesAreLongerThanTheMedianOfTheFramesBefore) {
+  FrameIndex index(/*spike_factor=*/1.5, /*spike_window=*/4);
+  std::vector<uint64_t> durations = {16, 17, 16, 40, 16, 17, 16, 26, 16};
+  uint64_t start = 0;
+  index.AddFrameStart(start);
+  for (uint64_t duration : durations) {
+    start += duration;
+    index.AddFrameStart(start);
+  }
+  // The first frame has no frames before it. The median ignores the spike of
+  // 40, so that the frame of 26 after it is one too.
+  EXPECT_EQ(index.GetSpikes(), (std::vector<size_t>{3, 7}));
+
+  // Splitting the spike in two updates the frames after it.
+  index.AddFrameStart(index.GetFrameStart(3) + 20);
+  EXPECT_EQ(index.GetSpikes(), (std::vector<size_t>{8}));
+}
+
+TEST(FrameIndex, BuildsLargeIndices) {
+  constexpr uint64_t kNumStarts = 100'001;
+  std::vector<uint64_t> starts;
+  for (uint64_t i = 0; i < kNumStarts; ++i) {
+    // Every 1000th frame is twice as long as the others.
+    starts.push_back(i * 1000 + (i / 1000) * 1000);
+  }
+  FrameIndex index;
+  index.Build(starts);
+  ASSERT_EQ(index.GetNumFrames(), kNumStarts - 1);
+  EXPECT_EQ(index.GetSpikes().size(), 100);
+  EXPECT_EQ(index.GetFrameAt(starts[5000] + 1), 5000);
+}
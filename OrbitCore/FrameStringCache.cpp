@@ -0,0 +1,89 @@
+#include "FrameStringCache.h"
+
+#include <algorithm>
+
+#include "Callstack.h"
+
+namespace {
+uint32_t GetNumFrames(const CallStack& callstack) {
+  return std::min<uint32_t>(callstack.m_Depth, callstack.m_Data.size());
+}
+}  // namespace
+
+std::string FrameStringCache::GetAddressString(uint64_t address,
+                                               FrameDisplay display) {
+  absl::MutexLock lock(&mutex_);
+  return strings_[GetId(address, display)];
+}
+
+std::string FrameStringCache::GetFrameString(const CallStack& callstack,
+                                             uint32_t index,
+                                             FrameDisplay display) {
+  absl::MutexLock lock(&mutex_);
+  const std::vector<uint32_t>& ids = GetFrameIds(callstack, display);
+  return index < ids.size() ? strings_[ids[index]] : std::string();
+}
+
+std::string FrameStringCache::GetCallstackString(const CallStack& callstack,
+                                                 FrameDisplay display) {
+  absl::MutexLock lock(&mutex_);
+  std::string result;
+  for (uint32_t id : GetFrameIds(callstack, display)) {
+    result += strings_[id];
+    result += '\n';
+  }
+  return result;
+}
+
+void FrameStringCache::Clear() {
+  absl::MutexLock lock(&mutex_);
+  callstacks_.clear();
+  ids_.clear();
+  interned_.clear();
+  strings_.clear();
+}
+
+size_t FrameStringCache::GetNumStrings() const {
+  absl::MutexLock lock(&mutex_);
+  return strings_.size();
+}
+
+uint32_t FrameStringCache::GetId(uint64_t address, FrameDisplay display) {
+  auto id_it = ids_.find(std::make_pair(address, display));
+  if (id_it != ids_.end()) {
+    return id_it->second;
+  }
+
+  std::string str = resolver_(address, display);
+  auto interned_it = interned_.find(str);
+  uint32_t id;
+  if (interned_it != interned_.end()) {
+    id = interned_it->second;
+  } else {
+    id = static_cast<uint32_t>(strings_.size());
+    strings_.push_back(std::move(str));
+    interned_.emplace(strings_.back(), id);
+  }
+  ids_.emplace(std::make_pair(address, display), id);
+  return id;
+}
+
+const std::vector<uint32_t>& FrameStringCache::GetFrameIds(
+    const CallStack& callstack, FrameDisplay display) {
+  std::vector<uint32_t>* ids = &uncached_ids_;
+  if (callstack.m_Hash != 0) {
+    auto [it, inserted] =
+        callstacks_.try_emplace(std::make_pair(callstack.m_Hash, display));
+    if (!inserted) {
+      return it->second;
+    }
+    ids = &it->second;
+  }
+
+  uint32_t num_frames = GetNumFrames(callstack);
+  ids->resize(num_frames);
+  for (uint32_t i = 0; i < num_frames; ++i) {
+    (*ids)[i] = GetId(callstack.m_Data[i], display);
+  }
+  return *ids;
+}
@@ -0,0 +1,69 @@
+#ifndef ORBIT_CORE_FRAME_STRING_CACHE_H_
+#define ORBIT_CORE_FRAME_STRING_CACHE_H_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CallstackTypes.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+
+struct CallStack;
+
+// What is shown of a frame of a callstack.
+enum class FrameDisplay : uint8_t { kName, kModule, kFile };
+
+// The strings shown for the frames of callstacks, e.g. by the callstack views
+// and tooltips, which would otherwise look up the function of each frame and
+// format it whenever they are refreshed. Each string is resolved once per
+// address and display, then interned: the frames of the same function share
+// it. A callstack is cached as the ids of the strings of its frames, so that
+// showing it again is only a lookup. Clear once the symbols change.
+class FrameStringCache {
+ public:
+  using Resolver =
+      std::function<std::string(uint64_t address, FrameDisplay display)>;
+
+  explicit FrameStringCache(Resolver resolver)
+      : resolver_(std::move(resolver)) {}
+
+  std::string GetAddressString(uint64_t address, FrameDisplay display);
+  // Of the frame at index in callstack, empty if there is none.
+  std::string GetFrameString(const CallStack& callstack, uint32_t index,
+                             FrameDisplay display);
+  // The strings of the frames of callstack, one per line.
+  std::string GetCallstackString(const CallStack& callstack,
+                                 FrameDisplay display);
+
+  void Clear();
+  // Distinct strings.
+  size_t GetNumStrings() const;
+
+ private:
+  uint32_t GetId(uint64_t address, FrameDisplay display)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  const std::vector<uint32_t>& GetFrameIds(const CallStack& callstack,
+                                           FrameDisplay display)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  Resolver resolver_;
+  mutable absl::Mutex mutex_;
+  // Never moved, for interned_ to refer to them.
+  std::deque<std::string> strings_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<absl::string_view, uint32_t> interned_
+      ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<std::pair<uint64_t, FrameDisplay>, uint32_t> ids_
+      ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<std::pair<CallstackID, FrameDisplay>,
+                      std::vector<uint32_t>>
+      callstacks_ ABSL_GUARDED_BY(mutex_);
+  // For the callstacks without a hash, which aren't cached.
+  std::vector<uint32_t> uncached_ids_ ABSL_GUARDED_BY(mutex_);
+};
+
+#endif  // ORBIT_CORE_FRAME_STRING_CACHE_H_
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Callstack.h"
+#include "FrameStringCache.h"
+#include "absl/strings/str_format.h"
+
+namespace {
+CallStack MakeCallStack(CallstackID hash, std::vector<uint64_t> frames) {
+  CallStack callstack;
+  callstack.m_Hash = hash;
+  callstack.m_Depth = frames.size();
+  callstack.m_Data = std::move(frames);
+  return callstack;
+}
+}  // namespace
+
+TEST(FrameStringCache, ResolvesEachAddressOnce) {
+  int num_resolved = 0;
+  // Functions of 0x100 bytes.
+  FrameStringCache cache([&](uint64_t address, FrameDisplay display) {
+    ++num_resolved;
+    return absl::StrFormat("%s%x", display == FrameDisplay::kName ? "f" : "m",
+                           address >> 8);
+  });
+
+  CallStack callstack = MakeCallStack(1, {0x110, 0x120, 0x210});
+  EXPECT_EQ(cache.GetCallstackString(callstack, FrameDisplay::kName),
+            "f1\nf1\nf2\n");
+  EXPECT_EQ(num_resolved, 3);
+  EXPECT_EQ(cache.GetNumStrings(), 2);
+
+  EXPECT_EQ(cache.GetFrameString(callstack, 2, FrameDisplay::kName), "f2");
+  EXPECT_EQ(cache.GetFrameString(callstack, 3, FrameDisplay::kName), "");
+  EXPECT_EQ(cache.GetAddressString(0x120, FrameDisplay::kName), "f1");
+  EXPECT_EQ(num_resolved, 3);
+
+  EXPECT_EQ(cache.GetFrameString(callstack, 0, FrameDisplay::kModule), "m1");
+  EXPECT_EQ(num_resolved, 6);
+}
+
+TEST(FrameStringCache, ClearResolvesAgain) {
+  std::string name = "before";
+  FrameStringCache cache(
+      [&](uint64_t /*address*/, FrameDisplay /*display*/) { return name; });
+
+  CallStack callstack = MakeCallStack(1, {0x100});
+  EXPECT_EQ(cache.GetFrameString(callstack, 0, FrameDisplay::kName),
+            "before");
+  name = "after";
+  EXPECT_EQ(cache.GetFrameString(callstack, 0, FrameDisplay::kName),
+            "before");
+  cache.Clear();
+  EXPECT_EQ(cache.GetFrameString(callstack, 0, FrameDisplay::kName), "after");
+}
+
+TEST(FrameStringCache, CallstacksWithoutHash) {
+  FrameStringCache cache([](uint64_t address, FrameDisplay /*display*/) {
+    return absl::StrFormat("%x", address);
+  });
+  EXPECT_EQ(cache.GetCallstackString(MakeCallStack(0, {0x1, 0x2}),
+                                     FrameDisplay::kName),
+            "1\n2\n");
+  EXPECT_EQ(cache.GetCallstackString(MakeCallStack(0, {0x3}),
+                                     FrameDisplay::kName),
+            "3\n");
+}
@@ -0,0 +1,106 @@
+#include "FunctionAddressIndex.h"
+
+#include <algorithm>
+
+namespace {
+// Stores sorted[index...] in the subtree of tree rooted at k, the children of
+// tree[k] being tree[2k] and tree[2k + 1], and ranks[k] the index in sorted
+// of tree[k]. Returns the index of the first value not stored.
+size_t FillTree(const std::vector<uint64_t>& sorted, size_t index, size_t k,
+                std::vector<uint64_t>* tree, std::vector<uint32_t>* ranks) {
+  if (k < tree->size()) {
+    index = FillTree(sorted, index, 2 * k, tree, ranks);
+    (*tree)[k] = sorted[index];
+    (*ranks)[k] = static_cast<uint32_t>(index);
+    index = FillTree(sorted, index + 1, 2 * k + 1, tree, ranks);
+  }
+  return index;
+}
+
+size_t GetCacheSlot(uint64_t address, size_t cache_size) {
+  // Nearby addresses, as those of a loop, share a slot. Multiplying spreads
+  // the functions of a module over the slots.
+  uint64_t hash = (address >> 4) * 0x9E3779B97F4A7C15ULL;
+  return static_cast<size_t>(hash >> 32) & (cache_size - 1);
+}
+}  // namespace
+
+FunctionAddressIndex::FunctionAddressIndex() { Clear(); }
+
+void FunctionAddressIndex::Build(
+    std::vector<std::pair<uint64_t, Function*>> functions) {
+  std::stable_sort(
+      functions.begin(), functions.end(),
+      [](const auto& a, const auto& b) { return a.first < b.first; });
+  auto same_start = [](const auto& a, const auto& b) {
+    return a.first == b.first;
+  };
+  functions.erase(
+      std::unique(functions.begin(), functions.end(), same_start),
+      functions.end());
+
+  starts_.clear();
+  functions_.clear();
+  starts_.reserve(functions.size());
+  functions_.reserve(functions.size());
+  for (const auto& [start, function] : functions) {
+    starts_.push_back(start);
+    functions_.push_back(function);
+  }
+
+  tree_starts_.assign(starts_.size() + 1, 0);
+  tree_ranks_.assign(starts_.size() + 1, kNotFound);
+  FillTree(starts_, 0, 1, &tree_starts_, &tree_ranks_);
+
+  for (std::atomic<uint32_t>& slot : cache_) {
+    slot.store(kNotFound, std::memory_order_relaxed);
+  }
+}
+
+Function* FunctionAddressIndex::GetFunctionContaining(uint64_t address) const {
+  uint32_t rank = GetRankContaining(address);
+  return rank != kNotFound ? functions_[rank] : nullptr;
+}
+
+Function* FunctionAddressIndex::GetFunctionStartingAt(uint64_t address) const {
+  uint32_t rank = GetRankContaining(address);
+  return rank != kNotFound && starts_[rank] == address ? functions_[rank]
+                                                       : nullptr;
+}
+
+uint32_t FunctionAddressIndex::GetRankContaining(uint64_t address) const {
+  if (starts_.empty()) {
+    return kNotFound;
+  }
+
+  std::atomic<uint32_t>& slot = cache_[GetCacheSlot(address, kCacheSize)];
+  uint32_t rank = slot.load(std::memory_order_relaxed);
+  if (Contains(rank, address)) {
+    return rank;
+  }
+
+  rank = Search(address);
+  if (rank != kNotFound) {
+    slot.store(rank, std::memory_order_relaxed);
+  }
+  return rank;
+}
+
+uint32_t FunctionAddressIndex::Search(uint64_t address) const {
+  // Walks down to a leaf, the comparison giving the next child, to the right
+  // while the starts are at or before address.
+  size_t num_starts = starts_.size();
+  size_t k = 1;
+  while (k <= num_starts) {
+    k = 2 * k + (tree_starts_[k] <= address);
+  }
+  // The first start after address is where the walk last went left: drop the
+  // moves to the right after it, then the move to the left.
+  while (k & 1) {
+    k >>= 1;
+  }
+  k >>= 1;
+
+  size_t first_after = k == 0 ? num_starts : tree_ranks_[k];
+  return first_after == 0 ? kNotFound : static_cast<uint32_t>(first_after - 1);
+}
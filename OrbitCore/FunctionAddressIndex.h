@@ -0,0 +1,67 @@
+#ifndef ORBIT_CORE_FUNCTION_ADDRESS_INDEX_H_
+#define ORBIT_CORE_FUNCTION_ADDRESS_INDEX_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class Function;
+
+// Finds the function containing an address, that is the function with the
+// latest start at or before it, among the functions of a module. This runs
+// for each timer and each sampled frame, so the start addresses are kept in
+// a flat array:
+// - in Eytzinger order, the order of a breadth first walk of the binary
+//   search tree, so that a search goes through the array front to back and
+//   the first levels of all searches share cache lines;
+// - searched without branches on the comparisons, which mispredict half the
+//   time;
+// - behind a small direct-mapped cache of the functions recently found, as
+//   the same addresses come again and again.
+// Built once, then searched from any number of threads.
+class FunctionAddressIndex {
+ public:
+  FunctionAddressIndex();
+
+  // Replaces the functions indexed. If several functions start at the same
+  // address, the first one is kept.
+  void Build(std::vector<std::pair<uint64_t, Function*>> functions);
+  void Clear() { Build({}); }
+
+  // Function with the latest start at or before address, nullptr if none.
+  Function* GetFunctionContaining(uint64_t address) const;
+  // Function starting at address, nullptr if none.
+  Function* GetFunctionStartingAt(uint64_t address) const;
+
+  size_t size() const { return starts_.size(); }
+  bool empty() const { return starts_.empty(); }
+
+ private:
+  static constexpr size_t kCacheSize = 1024;
+  static constexpr uint32_t kNotFound = ~0u;
+
+  // Rank, in order of start, of the function containing address, kNotFound
+  // if none.
+  uint32_t GetRankContaining(uint64_t address) const;
+  uint32_t Search(uint64_t address) const;
+  bool Contains(uint32_t rank, uint64_t address) const {
+    return rank < starts_.size() && starts_[rank] <= address &&
+           (rank + 1 == starts_.size() || address < starts_[rank + 1]);
+  }
+
+  // In order of start.
+  std::vector<uint64_t> starts_;
+  std::vector<Function*> functions_;
+  // The starts in Eytzinger order, from index 1, and their ranks.
+  std::vector<uint64_t> tree_starts_;
+  std::vector<uint32_t> tree_ranks_;
+  // Ranks of recently found functions, by a hash of the address. A slot is
+  // only used if its function contains the address: racing threads can
+  // only make each other miss.
+  mutable std::array<std::atomic<uint32_t>, kCacheSize> cache_;
+};
+
+#endif  // ORBIT_CORE_FUNCTION_ADDRESS_INDEX_H_
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+
+#include "FunctionAddressIndex.h"
+
+namespace {
+// The index never dereferences the functions.
+Function* FakeFunction(uintptr_t id) {
+  return reinterpret_cast<Function*>(id * 8);
+}
+}  // namespace
+
+TEST(FunctionAddressIndex, EmptyFindsNothing) {
+  FunctionAddressIndex index;
+  EXPECT_TRUE(index.empty());
+  EXPECT_EQ(index.GetFunctionContaining(0x1000), nullptr);
+  EXPECT_EQ(index.GetFunctionStartingAt(0x1000), nullptr);
+}
+
+TEST(FunctionAddressIndex, FindsFunctionStartingAtOrBefore) {
+  FunctionAddressIndex index;
+  index.Build({{0x300, FakeFunction(3)},
+               {0x100, FakeFunction(1)},
+               {0x200, FakeFunction(2)}});
+  EXPECT_EQ(index.size(), 3u);
+
+  EXPECT_EQ(index.GetFunctionContaining(0x0ff), nullptr);
+  EXPECT_EQ(index.GetFunctionContaining(0x100), FakeFunction(1));
+  EXPECT_EQ(index.GetFunctionContaining(0x1ff), FakeFunction(1));
+  EXPECT_EQ(index.GetFunctionContaining(0x200), FakeFunction(2));
+  EXPECT_EQ(index.GetFunctionContaining(0x2ff), FakeFunction(2));
+  EXPECT_EQ(index.GetFunctionContaining(0x300), FakeFunction(3));
+  EXPECT_EQ(index.GetFunctionContaining(~0ULL), FakeFunction(3));
+  // Again, from the cache.
+  EXPECT_EQ(index.GetFunctionContaining(0x1ff), FakeFunction(1));
+  EXPECT_EQ(index.GetFunctionContaining(0x0ff), nullptr);
+
+  EXPECT_EQ(index.GetFunctionStartingAt(0x200), FakeFunction(2));
+  EXPECT_EQ(index.GetFunctionStartingAt(0x201), nullptr);
+  EXPECT_EQ(index.GetFunctionStartingAt(0x0ff), nullptr);
+}
+
+TEST(FunctionAddressIndex, KeepsFirstFunctionOfDuplicateStart) {
+  FunctionAddressIndex index;
+  index.Build({{0x100, FakeFunction(1)},
+               {0x100, FakeFunction(2)},
+               {0x80, FakeFunction(3)}});
+  EXPECT_EQ(index.size(), 2u);
+  EXPECT_EQ(index.GetFunctionStartingAt(0x100), FakeFunction(1));
+}
+
+TEST(FunctionAddressIndex, BuildReplacesFunctions) {
+  FunctionAddressIndex index;
+  index.Build({{0x100, FakeFunction(1)}});
+  EXPECT_EQ(index.GetFunctionContaining(0x180), FakeFunction(1));
+  index.Build({{0x200, FakeFunction(2)}});
+  EXPECT_EQ(index.GetFunctionContaining(0x180), nullptr);
+  EXPECT_EQ(index.GetFunctionContaining(0x280), FakeFunction(2));
+  index.Clear();
+  EXPECT_EQ(index.GetFunctionContaining(0x280), nullptr);
+}
+
+TEST(FunctionAddressIndex, MatchesMapUpperBound) {
+  std::mt19937_64 random(42);
+  for (size_t num_functions : {1, 2, 3, 7, 8, 9, 100, 1000, 4097}) {
+    std::map<uint64_t, Function*> map;
+    std::vector<std::pair<uint64_t, Function*>> functions;
+    for (size_t i = 0; i < num_functions; ++i) {
+      uint64_t start = 0x10000 + random() % (num_functions * 64);
+      functions.emplace_back(start, FakeFunction(i + 1));
+      map.emplace(start, FakeFunction(i + 1));
+    }
+    FunctionAddressIndex index;
+    index.Build(functions);
+    ASSERT_EQ(index.size(), map.size());
+
+    for (int i = 0; i < 10000; ++i) {
+      uint64_t address = 0x10000 - 64 + random() % (num_functions * 64 + 128);
+      auto it = map.upper_bound(address);
+      Function* expected = it == map.begin() ? nullptr : std::prev(it)->second;
+      ASSERT_EQ(index.GetFunctionContaining(address), expected)
+          << num_functions << " functions, address " << address;
+    }
+  }
+}
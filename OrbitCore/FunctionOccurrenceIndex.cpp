@@ -0,0 +1,99 @@
+#include "FunctionOccurrenceIndex.h"
+
+#include <algorithm>
+
+void FunctionOccurrenceIndex::Add(
+    const std::vector<const CompactTimer*>& timers) {
+  absl::MutexLock lock(&mutex_);
+  for (const CompactTimer* timer : timers) {
+    Occurrences& occurrences = occurrences_[timer->m_FunctionId];
+    Occurrence occurrence{timer->m_Start, timer};
+    if (occurrences.empty() || occurrences.back() < occurrence) {
+      occurrences.push_back(occurrence);
+    } else {
+      // E.g. recursive calls, which end, and are added, in reverse order.
+      occurrences.insert(std::upper_bound(occurrences.begin(),
+                                          occurrences.end(), occurrence),
+                         occurrence);
+    }
+  }
+}
+
+void FunctionOccurrenceIndex::Clear() {
+  absl::MutexLock lock(&mutex_);
+  occurrences_.clear();
+}
+
+size_t FunctionOccurrenceIndex::GetNumOccurrences(uint32_t function_id) const {
+  absl::MutexLock lock(&mutex_);
+  auto it = occurrences_.find(function_id);
+  return it != occurrences_.end() ? it->second.size() : 0;
+}
+
+const CompactTimer* FunctionOccurrenceIndex::FindPrevious(
+    const CompactTimer& timer) const {
+  absl::MutexLock lock(&mutex_);
+  auto it = occurrences_.find(timer.m_FunctionId);
+  if (it == occurrences_.end()) return nullptr;
+  const Occurrences& occurrences = it->second;
+  auto previous = std::lower_bound(occurrences.begin(), occurrences.end(),
+                                   Occurrence{timer.m_Start, &timer});
+  return previous != occurrences.begin() ? (previous - 1)->timer : nullptr;
+}
+
+const CompactTimer* FunctionOccurrenceIndex::FindNext(
+    const CompactTimer& timer) const {
+  absl::MutexLock lock(&mutex_);
+  auto it = occurrences_.find(timer.m_FunctionId);
+  if (it == occurrences_.end()) return nullptr;
+  const Occurrences& occurrences = it->second;
+  auto next = std::upper_bound(occurrences.begin(), occurrences.end(),
+                               Occurrence{timer.m_Start, &timer});
+  return next != occurrences.end() ? next->timer : nullptr;
+}
+
+std::pair<FunctionOccurrenceIndex::Occurrences::const_iterator,
+          FunctionOccurrenceIndex::Occurrences::const_iterator>
+FunctionOccurrenceIndex::GetRange(const Occurrences& occurrences, uint64_t min,
+                                  uint64_t max) {
+  auto by_start = [](const Occurrence& occurrence, uint64_t start) {
+    return occurrence.start < start;
+  };
+  auto first = std::lower_bound(occurrences.begin(), occurrences.end(), min,
+                                by_start);
+  auto last = max < UINT64_MAX ? std::lower_bound(first, occurrences.end(),
+                                                  max + 1, by_start)
+                               : occurrences.end();
+  return {first, last};
+}
+
+std::vector<const CompactTimer*> FunctionOccurrenceIndex::GetOccurrences(
+    uint32_t function_id, uint64_t min, uint64_t max) const {
+  std::vector<const CompactTimer*> timers;
+  absl::MutexLock lock(&mutex_);
+  auto it = occurrences_.find(function_id);
+  if (it == occurrences_.end()) return timers;
+  auto range = GetRange(it->second, min, max);
+  for (auto occurrence = range.first; occurrence != range.second;
+       ++occurrence) {
+    timers.push_back(occurrence->timer);
+  }
+  return timers;
+}
+
+FunctionStats FunctionOccurrenceIndex::GetStats(const TimerTables& tables,
+                                                uint32_t function_id,
+                                                uint64_t min,
+                                                uint64_t max) const {
+  FunctionStats stats;
+  stats.m_Address = tables.GetFunctionAddress(function_id);
+  absl::MutexLock lock(&mutex_);
+  auto it = occurrences_.find(function_id);
+  if (it == occurrences_.end()) return stats;
+  auto range = GetRange(it->second, min, max);
+  for (auto occurrence = range.first; occurrence != range.second;
+       ++occurrence) {
+    stats.Update(tables.Expand(*occurrence->timer));
+  }
+  return stats;
+}
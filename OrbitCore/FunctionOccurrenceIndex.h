@@ -0,0 +1,63 @@
+#ifndef ORBIT_CORE_FUNCTION_OCCURRENCE_INDEX_H_
+#define ORBIT_CORE_FUNCTION_OCCURRENCE_INDEX_H_
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "CompactTimer.h"
+#include "FunctionStats.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
+// The calls of each function across all threads and depths, in start order,
+// so that going from a call to the next or previous one, or going through the
+// calls of a time range, costs O(log n + k) instead of a scan of all the
+// timers. The timers are not copied: they must stay where they were added,
+// e.g. in their TimerChain, until Clear. Timers are added by batches, by the
+// thread processing them, while others read the index. Functions are
+// identified by their id in the TimerTables of the timers.
+class FunctionOccurrenceIndex {
+ public:
+  // Timers of a function are expected mostly in start order.
+  void Add(const std::vector<const CompactTimer*>& timers);
+  void Clear();
+
+  size_t GetNumOccurrences(uint32_t function_id) const;
+  // The calls of the function of timer right before and after it, nullptr if
+  // there is none. Calls starting at the same time are ordered by address.
+  const CompactTimer* FindPrevious(const CompactTimer& timer) const;
+  const CompactTimer* FindNext(const CompactTimer& timer) const;
+  // The calls of function_id starting in [min, max], in start order.
+  std::vector<const CompactTimer*> GetOccurrences(uint32_t function_id,
+                                                  uint64_t min,
+                                                  uint64_t max) const;
+  // Of the calls GetOccurrences returns, whose durations are read from
+  // tables.
+  FunctionStats GetStats(const TimerTables& tables, uint32_t function_id,
+                         uint64_t min, uint64_t max) const;
+
+ private:
+  struct Occurrence {
+    // Copied from the timer, so that searching doesn't read the timers.
+    uint64_t start;
+    const CompactTimer* timer;
+
+    bool operator<(const Occurrence& other) const {
+      return start != other.start ? start < other.start
+                                  : std::less<>()(timer, other.timer);
+    }
+  };
+  using Occurrences = std::vector<Occurrence>;
+
+  // Calls starting in [min, max] of occurrences, as [first, last).
+  static std::pair<Occurrences::const_iterator, Occurrences::const_iterator>
+  GetRange(const Occurrences& occurrences, uint64_t min, uint64_t max);
+
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<uint32_t, Occurrences> occurrences_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+#endif  // ORBIT_CORE_FUNCTION_OCCURRENCE_INDEX_H_
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "FunctionOccurrenceIndex.h"
+
+namespace {
+// Keeps the timers where they were added, as their chains do.
+class Timers {
+ public:
+  const CompactTimer* Add(uint64_t function_address, uint64_t start,
+                          uint64_t end, uint32_t tid = 1) {
+    Timer timer;
+    timer.m_FunctionAddress = function_address;
+    timer.m_Start = start;
+    timer.m_End = end;
+    timer.m_TID = tid;
+    return &timers_.emplace_back(tables_.Compact(timer));
+  }
+  uint32_t GetFunctionId(uint64_t function_address) const {
+    return tables_.FindFunctionId(function_address);
+  }
+  const TimerTables& GetTables() const { return tables_; }
+
+ private:
+  TimerTables tables_;
+  std::deque<CompactTimer> timers_;
+};
+}  // namespace
+
+TEST(FunctionOccurrenceIndex, NavigatesBetweenCallsOfAFunction) {
+  Timers timers;
+  const CompactTimer* a0 = timers.Add(0xa, 100, 200, 1);
+  const CompactTimer* b0 = timers.Add(0xb, 150, 160, 2);
+  const CompactTimer* a1 = timers.Add(0xa, 300, 400, 2);
+  const CompactTimer* a2 = timers.Add(0xa, 500, 600, 1);
+  FunctionOccurrenceIndex index;
+  index.Add({a0, b0, a1});
+  index.Add({a2});
+
+  EXPECT_EQ(index.GetNumOccurrences(timers.GetFunctionId(0xa)), 3);
+  EXPECT_EQ(index.GetNumOccurrences(timers.GetFunctionId(0xc)), 0);
+  EXPECT_EQ(index.FindNext(*a0), a1);
+  EXPECT_EQ(index.FindNext(*a1), a2);
+  EXPECT_EQ(index.FindNext(*a2), nullptr);
+  EXPECT_EQ(index.FindPrevious(*a2), a1);
+  EXPECT_EQ(index.FindPrevious(*a0), nullptr);
+  EXPECT_EQ(index.FindNext(*b0), nullptr);
+}
+
+TEST(FunctionOccurrenceIndex, SortsCallsAddedOutOfOrder) {
+  Timers timers;
+  // A recursive call ends, and is added, before its caller.
+  const CompactTimer* inner = timers.Add(0xa, 110, 150);
+  const CompactTimer* outer = timers.Add(0xa, 100, 200);
+  // Calls starting at the same time on two threads.
+  const CompactTimer* first = timers.Add(0xa, 300, 400, 1);
+  const CompactTimer* second = timers.Add(0xa, 300, 350, 2);
+  FunctionOccurrenceIndex index;
+  index.Add({inner, outer, second, first});
+
+  std::vector<const CompactTimer*> expected = {outer, inner, first, second};
+  if (std::less<>()(second, first)) std::swap(expected[2], expected[3]);
+  EXPECT_EQ(index.GetOccurrences(timers.GetFunctionId(0xa), 0, UINT64_MAX),
+            expected);
+  EXPECT_EQ(index.FindNext(*expected[2]), expected[3]);
+  EXPECT_EQ(index.FindPrevious(*expected[3]), expected[2]);
+}
+
+TEST(FunctionOccurrenceIndex, CallsAndStatsOfATimeRange) {
+  Timers timers;
+  FunctionOccurrenceIndex index;
+  std::vector<const CompactTimer*> added;
+  for (uint64_t i = 0; i < 10; ++i) {
+    added.push_back(timers.Add(0xa, i * 1000, i * 1000 + 100 * (i + 1)));
+  }
+  index.Add(added);
+
+  // Calls starting in [2000, 4000].
+  EXPECT_EQ(index.GetOccurrences(timers.GetFunctionId(0xa), 1500, 4000),
+            (std::vector<const CompactTimer*>{added[2], added[3], added[4]}));
+  EXPECT_TRUE(
+      index.GetOccurrences(timers.GetFunctionId(0xa), 4001, 4999).empty());
+  FunctionStats stats = index.GetStats(timers.GetTables(),
+                                       timers.GetFunctionId(0xa), 1500, 4000);
+  EXPECT_EQ(stats.m_Count, 3);
+  EXPECT_EQ(index
+                .GetStats(timers.GetTables(), timers.GetFunctionId(0xb), 0,
+                          UINT64_MAX)
+                .m_Count,
+            0);
+
+  index.Clear();
+  EXPECT_EQ(index.GetNumOccurrences(timers.GetFunctionId(0xa)), 0);
+}
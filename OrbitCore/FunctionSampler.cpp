@@ -0,0 +1,75 @@
+#include "FunctionSampler.h"
+
+#include <algorithm>
+
+FunctionSampler::FunctionSampler(
+    const std::vector<FunctionSamplingPolicy>& policies) {
+  for (const FunctionSamplingPolicy& function : policies) {
+    if (function.policy.mode == SamplingPolicy::kAll) {
+      continue;
+    }
+    FunctionState& state = functions_[function.function_address];
+    state.policy = function.policy;
+    state.policy.parameter = std::max<uint32_t>(state.policy.parameter, 1);
+    state.stats.m_Address = function.function_address;
+  }
+}
+
+bool FunctionSampler::AddTimer(const Timer& timer) {
+  auto it = functions_.find(timer.m_FunctionAddress);
+  if (it == functions_.end()) {
+    return true;
+  }
+
+  if (window_start_ == 0) {
+    window_start_ = timer.m_End;
+  }
+  FunctionState& state = it->second;
+  state.stats.Update(timer);
+  switch (state.policy.mode) {
+    case SamplingPolicy::kEveryNth:
+      return state.num_calls++ % state.policy.parameter == 0;
+    case SamplingPolicy::kReservoir: {
+      // Algorithm R: the n-th call of the window replaces a random one of the
+      // k timers kept with probability k/n.
+      if (state.reservoir.size() < state.policy.parameter) {
+        state.reservoir.push_back(timer);
+      } else {
+        uint64_t index = NextRandom() % state.stats.m_Count;
+        if (index < state.reservoir.size()) {
+          state.reservoir[index] = timer;
+        }
+      }
+      return false;
+    }
+    case SamplingPolicy::kAggregate:
+      return false;
+    default:
+      return true;
+  }
+}
+
+void FunctionSampler::Flush(std::vector<Timer>* timers,
+                            std::vector<FunctionStats>* stats) {
+  for (auto& pair : functions_) {
+    FunctionState& state = pair.second;
+    if (state.stats.m_Count == 0) {
+      continue;
+    }
+    timers->insert(timers->end(), state.reservoir.begin(),
+                   state.reservoir.end());
+    state.reservoir.clear();
+    stats->push_back(state.stats);
+    state.stats.Reset();
+    state.stats.m_Address = pair.first;
+  }
+  window_start_ = 0;
+}
+
+uint64_t FunctionSampler::NextRandom() {
+  // xorshift64, good enough to pick timers and cheap enough for the hooks.
+  random_state_ ^= random_state_ << 13;
+  random_state_ ^= random_state_ >> 7;
+  random_state_ ^= random_state_ << 17;
+  return random_state_;
+}
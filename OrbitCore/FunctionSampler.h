@@ -0,0 +1,84 @@
+#ifndef ORBIT_CORE_FUNCTION_SAMPLER_H_
+#define ORBIT_CORE_FUNCTION_SAMPLER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "FunctionStats.h"
+#include "Profiling.h"
+#include "ScopeTimer.h"
+#include "absl/container/flat_hash_map.h"
+
+// How the calls of an instrumented function are recorded. Functions called
+// too often for a timer per call to be sent, hot leaf functions in
+// particular, only have some of their calls recorded, or none, while the
+// FunctionStats of all their calls are still sent.
+struct SamplingPolicy {
+  enum Mode : uint32_t {
+    // A timer per call, the default.
+    kAll,
+    // The timer of one call every `parameter` calls.
+    kEveryNth,
+    // The timers of `parameter` calls of each window, picked uniformly at
+    // random among the calls of the window.
+    kReservoir,
+    // No timer, only the stats of the calls.
+    kAggregate,
+  };
+
+  Mode mode = kAll;
+  uint32_t parameter = 0;
+};
+
+// Payload of Msg_FunctionSamplingPolicies, an array of which lists the
+// instrumented functions not recording all their calls.
+struct FunctionSamplingPolicy {
+  uint64_t function_address;
+  SamplingPolicy policy;
+};
+
+// Applies the sampling policies of the functions to the timers of their calls
+// and aggregates the stats of all the calls of sampled functions, to be sent
+// once per window, as Msg_FunctionStats. Not thread-safe: the Windows hooks
+// have one per thread.
+class FunctionSampler {
+ public:
+  // Window of the reservoirs, and period at which the stats are sent.
+  static constexpr TickType kWindowNs = 100 * 1000 * 1000;
+
+  FunctionSampler() = default;
+  explicit FunctionSampler(const std::vector<FunctionSamplingPolicy>& policies);
+
+  // Whether all the calls of all the functions are recorded.
+  bool IsEmpty() const { return functions_.empty(); }
+
+  // Accounts for a call. Returns whether its timer is recorded now. The
+  // timers kept in reservoirs are only returned by Flush.
+  bool AddTimer(const Timer& timer);
+
+  // Whether the current window, started by the first call after the last
+  // Flush, ended at time.
+  bool IsFlushDue(TickType time) const {
+    return window_start_ != 0 && time >= window_start_ + kWindowNs;
+  }
+
+  // Appends the timers picked by the reservoirs and the stats of the calls of
+  // the window to timers and stats, then starts a new window.
+  void Flush(std::vector<Timer>* timers, std::vector<FunctionStats>* stats);
+
+ private:
+  struct FunctionState {
+    SamplingPolicy policy;
+    uint64_t num_calls = 0;
+    FunctionStats stats;
+    std::vector<Timer> reservoir;
+  };
+
+  uint64_t NextRandom();
+
+  absl::flat_hash_map<uint64_t, FunctionState> functions_;
+  TickType window_start_ = 0;
+  uint64_t random_state_ = 0x9e3779b97f4a7c15;
+};
+
+#endif  // ORBIT_CORE_FUNCTION_SAMPLER_H_
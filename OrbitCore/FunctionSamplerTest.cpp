@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "FunctionSampler.h"
+
+namespace {
+constexpr uint64_t kAllAddress = 0x1000;
+constexpr uint64_t kEveryNthAddress = 0x2000;
+constexpr uint64_t kReservoirAddress = 0x3000;
+constexpr uint64_t kAggregateAddress = 0x4000;
+
+Timer MakeTimer(uint64_t function_address, TickType start, TickType end) {
+  Timer timer;
+  timer.m_FunctionAddress = function_address;
+  timer.m_Start = start;
+  timer.m_End = end;
+  return timer;
+}
+
+FunctionSampler MakeSampler() {
+  return FunctionSampler(
+      {{kAllAddress, {SamplingPolicy::kAll, 0}},
+       {kEveryNthAddress, {SamplingPolicy::kEveryNth, 3}},
+       {kReservoirAddress, {SamplingPolicy::kReservoir, 2}},
+       {kAggregateAddress, {SamplingPolicy::kAggregate, 0}}});
+}
+}  // namespace
+
+TEST(FunctionSampler, RecordsAllCallsWithoutPolicies) {
+  FunctionSampler sampler({{kAllAddress, {SamplingPolicy::kAll, 0}}});
+  EXPECT_TRUE(sampler.IsEmpty());
+  EXPECT_TRUE(sampler.AddTimer(MakeTimer(kAllAddress, 0, 10)));
+  EXPECT_FALSE(sampler.IsFlushDue(FunctionSampler::kWindowNs * 2));
+}
+
+TEST(FunctionSampler, RecordsEveryNthCall) {
+  FunctionSampler sampler = MakeSampler();
+  EXPECT_FALSE(sampler.IsEmpty());
+  std::vector<bool> recorded;
+  for (TickType i = 0; i < 7; ++i) {
+    recorded.push_back(sampler.AddTimer(MakeTimer(kEveryNthAddress, i, i)));
+  }
+  EXPECT_EQ(recorded, std::vector<bool>({true, false, false, true, false,
+                                         false, true}));
+  EXPECT_TRUE(sampler.AddTimer(MakeTimer(kAllAddress, 0, 10)));
+}
+
+TEST(FunctionSampler, AggregatesTheStatsOfAllCalls) {
+  FunctionSampler sampler = MakeSampler();
+  for (TickType i = 1; i <= 10; ++i) {
+    EXPECT_FALSE(sampler.AddTimer(
+        MakeTimer(kAggregateAddress, 100, 100 + i * 1000 * 1000)));
+  }
+  // The window starts at the end of the first call.
+  TickType window_start = 100 + 1000 * 1000;
+  TickType window_end = window_start + FunctionSampler::kWindowNs;
+  EXPECT_FALSE(sampler.IsFlushDue(window_end - 1));
+  EXPECT_TRUE(sampler.IsFlushDue(window_end));
+
+  std::vector<Timer> timers;
+  std::vector<FunctionStats> stats;
+  sampler.Flush(&timers, &stats);
+  EXPECT_TRUE(timers.empty());
+  ASSERT_EQ(stats.size(), 1);
+  EXPECT_EQ(stats[0].m_Address, kAggregateAddress);
+  EXPECT_EQ(stats[0].m_Count, 10);
+  EXPECT_DOUBLE_EQ(stats[0].m_TotalTimeMs, 55);
+  EXPECT_DOUBLE_EQ(stats[0].m_MinMs, 1);
+  EXPECT_DOUBLE_EQ(stats[0].m_MaxMs, 10);
+
+  // A new window starts empty.
+  EXPECT_FALSE(sampler.IsFlushDue(FunctionSampler::kWindowNs * 10));
+  stats.clear();
+  sampler.Flush(&timers, &stats);
+  EXPECT_TRUE(stats.empty());
+}
+
+TEST(FunctionSampler, KeepsAReservoirOfCallsPerWindow) {
+  FunctionSampler sampler = MakeSampler();
+  for (TickType i = 0; i < 1000; ++i) {
+    EXPECT_FALSE(sampler.AddTimer(MakeTimer(kReservoirAddress, i, i + 1)));
+  }
+
+  std::vector<Timer> timers;
+  std::vector<FunctionStats> stats;
+  sampler.Flush(&timers, &stats);
+  ASSERT_EQ(timers.size(), 2);
+  EXPECT_NE(timers[0].m_Start, timers[1].m_Start);
+  for (const Timer& timer : timers) {
+    EXPECT_EQ(timer.m_FunctionAddress, kReservoirAddress);
+    EXPECT_LT(timer.m_Start, 1000);
+  }
+  ASSERT_EQ(stats.size(), 1);
+  EXPECT_EQ(stats[0].m_Count, 1000);
+
+  timers.clear();
+  EXPECT_FALSE(sampler.AddTimer(MakeTimer(kReservoirAddress, 5000, 5001)));
+  sampler.Flush(&timers, &stats);
+  ASSERT_EQ(timers.size(), 1);
+  EXPECT_EQ(timers[0].m_Start, 5000);
+}
@@ -1,5 +1,7 @@
 #include "FunctionStats.h"
 
+#include <algorithm>
+
 #include "Core.h"
 #include "ScopeTimer.h"
 #include "Serialization.h"
@@ -24,14 +26,54 @@ void FunctionStats::Update(const Timer& a_Timer) {
   m_AverageTimeMs = m_TotalTimeMs / (double)m_Count;
   UpdateMax(m_MaxMs, elapsedMillis);
   UpdateMin(m_MinMs, elapsedMillis);
+  m_Histogram.Add((uint64_t)(a_Timer.ElapsedMicros() * 1000.0));
+}
+
+//-----------------------------------------------------------------------------
+void FunctionStats::Add(const FunctionStats& a_Stats) {
+  // The calls are joined with their on-CPU time after they are counted.
+  m_OnCpuCount += a_Stats.m_OnCpuCount;
+  m_OnCpuWallTimeMs += a_Stats.m_OnCpuWallTimeMs;
+  m_OnCpuTimeMs += a_Stats.m_OnCpuTimeMs;
+  if (a_Stats.m_Count == 0) return;
+  m_Count += a_Stats.m_Count;
+  m_TotalTimeMs += a_Stats.m_TotalTimeMs;
+  m_AverageTimeMs = m_TotalTimeMs / (double)m_Count;
+  UpdateMax(m_MaxMs, a_Stats.m_MaxMs);
+  UpdateMin(m_MinMs, a_Stats.m_MinMs);
+  m_Histogram.Merge(a_Stats.m_Histogram);
+}
+
+//-----------------------------------------------------------------------------
+double FunctionStats::GetPercentileMs(double a_Quantile) const {
+  if (m_Count == 0) return 0;
+  double percentileMs = m_Histogram.GetPercentileNs(a_Quantile) * 0.000001;
+  return std::clamp(percentileMs, m_MinMs, m_MaxMs);
+}
+
+//-----------------------------------------------------------------------------
+void FunctionStats::AddOnCpuTime(uint64_t a_WallNs, uint64_t a_OnCpuNs) {
+  ++m_OnCpuCount;
+  m_OnCpuWallTimeMs += a_WallNs * 0.000001;
+  m_OnCpuTimeMs += a_OnCpuNs * 0.000001;
+}
+
+//-----------------------------------------------------------------------------
+double FunctionStats::GetOnCpuRatio() const {
+  if (m_OnCpuWallTimeMs <= 0) return 0;
+  return m_OnCpuTimeMs / m_OnCpuWallTimeMs;
 }
 
 //-----------------------------------------------------------------------------
-ORBIT_SERIALIZE(FunctionStats, 0) {
+ORBIT_SERIALIZE(FunctionStats, 2) {
   ORBIT_NVP_VAL(0, m_Address);
   ORBIT_NVP_VAL(0, m_Count);
   ORBIT_NVP_VAL(0, m_TotalTimeMs);
   ORBIT_NVP_VAL(0, m_AverageTimeMs);
   ORBIT_NVP_VAL(0, m_MinMs);
   ORBIT_NVP_VAL(0, m_MaxMs);
+  ORBIT_NVP_VAL(1, m_Histogram);
+  ORBIT_NVP_VAL(2, m_OnCpuCount);
+  ORBIT_NVP_VAL(2, m_OnCpuWallTimeMs);
+  ORBIT_NVP_VAL(2, m_OnCpuTimeMs);
 }
\ No newline at end of file
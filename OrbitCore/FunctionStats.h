@@ -6,6 +6,7 @@
 #include <memory>
 
 #include "BaseTypes.h"
+#include "LatencyHistogram.h"
 #include "SerializationMacros.h"
 
 //-----------------------------------------------------------------------------
@@ -13,6 +14,18 @@ struct FunctionStats {
   FunctionStats() { Reset(); }
   void Reset() { memset(this, 0, sizeof(*this)); }
   void Update(const class Timer& a_Timer);
+  // Adds the timers counted by a_Stats, as if Update had been called with
+  // them.
+  void Add(const FunctionStats& a_Stats);
+  // Duration that a_Quantile, in [0, 1], of the calls don't exceed, from the
+  // histogram and within the durations seen, 0 without calls.
+  double GetPercentileMs(double a_Quantile) const;
+  // Adds a call joined with the time its thread ran on a core, see
+  // OnCpuTimeJoiner.
+  void AddOnCpuTime(uint64_t a_WallNs, uint64_t a_OnCpuNs);
+  // The part of the time of the joined calls spent on a core, 0 without
+  // joined calls.
+  double GetOnCpuRatio() const;
 
   uint64_t m_Address;
   uint64_t m_Count;
@@ -20,6 +33,12 @@ struct FunctionStats {
   double m_AverageTimeMs;
   double m_MinMs;
   double m_MaxMs;
+  LatencyHistogram m_Histogram;
+  // Of the calls joined with the time their thread ran on a core, which can
+  // lag behind m_Count, or stay at 0 without context switches.
+  uint64_t m_OnCpuCount;
+  double m_OnCpuWallTimeMs;
+  double m_OnCpuTimeMs;
 
   ORBIT_SERIALIZABLE;
 };
\ No newline at end of file
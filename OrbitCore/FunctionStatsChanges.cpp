@@ -0,0 +1,24 @@
+#include "FunctionStatsChanges.h"
+
+#include <utility>
+
+void FunctionStatsChanges::Add(const std::vector<uint64_t>& addresses) {
+  absl::MutexLock lock(&mutex_);
+  addresses_.insert(addresses.begin(), addresses.end());
+}
+
+void FunctionStatsChanges::Take(absl::flat_hash_set<uint64_t>* addresses) {
+  addresses->clear();
+  absl::MutexLock lock(&mutex_);
+  std::swap(addresses_, *addresses);
+}
+
+bool FunctionStatsChanges::IsEmpty() const {
+  absl::MutexLock lock(&mutex_);
+  return addresses_.empty();
+}
+
+void FunctionStatsChanges::Clear() {
+  absl::MutexLock lock(&mutex_);
+  addresses_.clear();
+}
@@ -0,0 +1,29 @@
+#ifndef ORBIT_CORE_FUNCTION_STATS_CHANGES_H_
+#define ORBIT_CORE_FUNCTION_STATS_CHANGES_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
+
+// Addresses of the functions whose stats changed since they were last taken,
+// so that the live functions view only updates the rows that changed, and
+// nothing at all while no stats change. The threads updating the stats add
+// to one set while the view works on the other: taking the changes swaps the
+// sets, so that neither waits for more than the swap.
+class FunctionStatsChanges {
+ public:
+  void Add(const std::vector<uint64_t>& addresses);
+  // Replaces *addresses with the addresses added since the previous call.
+  // The set passed in is reused for the next changes.
+  void Take(absl::flat_hash_set<uint64_t>* addresses);
+  bool IsEmpty() const;
+  void Clear();
+
+ private:
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_set<uint64_t> addresses_ ABSL_GUARDED_BY(mutex_);
+};
+
+#endif  // ORBIT_CORE_FUNCTION_STATS_CHANGES_H_
@@ -0,0 +1,27 @@
+#include <gtest/gtest.h>
+
+#include "FunctionStatsChanges.h"
+
+TEST(FunctionStatsChanges, TakesTheChangesSinceThePreviousTake) {
+  FunctionStatsChanges changes;
+  EXPECT_TRUE(changes.IsEmpty());
+  changes.Add({0x10, 0x20});
+  changes.Add({0x20, 0x30});
+  EXPECT_FALSE(changes.IsEmpty());
+
+  absl::flat_hash_set<uint64_t> addresses = {0x40};
+  changes.Take(&addresses);
+  EXPECT_EQ(addresses, (absl::flat_hash_set<uint64_t>{0x10, 0x20, 0x30}));
+  EXPECT_TRUE(changes.IsEmpty());
+
+  changes.Add({0x50});
+  changes.Take(&addresses);
+  EXPECT_EQ(addresses, (absl::flat_hash_set<uint64_t>{0x50}));
+}
+
+TEST(FunctionStatsChanges, Clear) {
+  FunctionStatsChanges changes;
+  changes.Add({0x10});
+  changes.Clear();
+  EXPECT_TRUE(changes.IsEmpty());
+}
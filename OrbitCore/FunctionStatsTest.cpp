@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include "FunctionStats.h"
+#include "ScopeTimer.h"
+
+namespace {
+Timer MakeTimer(TickType start, TickType end) {
+  Timer timer;
+  timer.m_Start = start;
+  timer.m_End = end;
+  return timer;
+}
+}  // namespace
+
+TEST(FunctionStats, AddMatchesUpdatingWithEachTimer) {
+  Timer timers[] = {MakeTimer(0, 3000), MakeTimer(5000, 6000),
+                    MakeTimer(7000, 15000), MakeTimer(20000, 22000)};
+
+  FunctionStats expected;
+  for (const Timer& timer : timers) {
+    expected.Update(timer);
+  }
+
+  FunctionStats first;
+  first.Update(timers[0]);
+  first.Update(timers[1]);
+  FunctionStats second;
+  second.Update(timers[2]);
+  second.Update(timers[3]);
+  FunctionStats stats;
+  stats.Add(first);
+  stats.Add(second);
+
+  EXPECT_EQ(stats.m_Count, expected.m_Count);
+  EXPECT_DOUBLE_EQ(stats.m_TotalTimeMs, expected.m_TotalTimeMs);
+  EXPECT_DOUBLE_EQ(stats.m_AverageTimeMs, expected.m_AverageTimeMs);
+  EXPECT_DOUBLE_EQ(stats.m_MinMs, expected.m_MinMs);
+  EXPECT_DOUBLE_EQ(stats.m_MaxMs, expected.m_MaxMs);
+}
+
+TEST(FunctionStats, AddingEmptyStatsChangesNothing) {
+  FunctionStats stats;
+  stats.Update(MakeTimer(0, 1000));
+  FunctionStats before = stats;
+  stats.Add(FunctionStats());
+
+  EXPECT_EQ(stats.m_Count, before.m_Count);
+  EXPECT_DOUBLE_EQ(stats.m_TotalTimeMs, before.m_TotalTimeMs);
+  EXPECT_DOUBLE_EQ(stats.m_MinMs, before.m_MinMs);
+}
+
+TEST(FunctionStats, PercentilesAreWithinTheDurationsSeen) {
+  FunctionStats stats;
+  EXPECT_DOUBLE_EQ(stats.GetPercentileMs(0.5), 0);
+
+  // Ticks are nanoseconds.
+  for (TickType duration = 1; duration <= 100; ++duration) {
+    stats.Update(MakeTimer(0, duration * 10'000));
+  }
+  for (double quantile : {0.0, 0.5, 1.0}) {
+    EXPECT_GE(stats.GetPercentileMs(quantile), stats.m_MinMs);
+    EXPECT_LE(stats.GetPercentileMs(quantile), stats.m_MaxMs);
+  }
+  EXPECT_NEAR(stats.GetPercentileMs(0.99), 0.99,
+              0.99 / LatencyHistogram::kNumSubBuckets);
+}
+
+TEST(FunctionStats, OnCpuTimeIsAddedWithoutCalls) {
+  FunctionStats stats;
+  stats.Update(MakeTimer(0, 4'000'000));
+  EXPECT_DOUBLE_EQ(stats.GetOnCpuRatio(), 0);
+
+  // Joined after the calls were counted.
+  FunctionStats joined;
+  joined.AddOnCpuTime(4'000'000, 1'000'000);
+  stats.Add(joined);
+
+  EXPECT_EQ(stats.m_Count, 1);
+  EXPECT_EQ(stats.m_OnCpuCount, 1);
+  EXPECT_DOUBLE_EQ(stats.m_OnCpuTimeMs, 1);
+  EXPECT_DOUBLE_EQ(stats.GetOnCpuRatio(), 0.25);
+}
@@ -0,0 +1,110 @@
+#include "GpuJobCallstackPairer.h"
+
+#include <algorithm>
+
+namespace {
+// The waiting jobs and callstacks are only checked for expiration this often,
+// as most are paired as soon as their pair is added.
+constexpr uint64_t kCheckPeriodNs = GpuJobCallstackPairer::kMaxWaitNs / 10;
+}  // namespace
+
+std::vector<GpuJobCallstackPairer::PairedJob> GpuJobCallstackPairer::AddJob(
+    const LinuxTracing::GpuJob& job) {
+  std::vector<PairedJob> released;
+  last_event_ns_ = std::max(last_event_ns_, job.GetDmaFenceSignaledTimeNs());
+
+  Key key{job.GetTid(), job.GetAmdgpuCsIoctlTimeNs()};
+  auto callstack_it = waiting_callstacks_.find(key);
+  auto last_callstack_it = last_callstack_ns_per_thread_.find(key.first);
+  if (callstack_it != waiting_callstacks_.end()) {
+    released.push_back(PairedJob{job, callstack_it->second});
+    waiting_callstacks_.erase(callstack_it);
+  } else if (last_callstack_it != last_callstack_ns_per_thread_.end() &&
+             last_callstack_it->second > key.second) {
+    released.push_back(PairedJob{job, 0});
+  } else {
+    waiting_jobs_per_thread_[key.first].insert_or_assign(key.second, job);
+  }
+
+  ReleaseJobsDoneWaiting(&released);
+  return released;
+}
+
+std::vector<GpuJobCallstackPairer::PairedJob>
+GpuJobCallstackPairer::AddCallstack(pid_t tid, uint64_t timestamp_ns,
+                                    CallstackID callstack_id) {
+  std::vector<PairedJob> released;
+  last_event_ns_ = std::max(last_event_ns_, timestamp_ns);
+  uint64_t& last_callstack_ns = last_callstack_ns_per_thread_[tid];
+  last_callstack_ns = std::max(last_callstack_ns, timestamp_ns);
+
+  bool paired = false;
+  auto jobs_it = waiting_jobs_per_thread_.find(tid);
+  if (jobs_it != waiting_jobs_per_thread_.end()) {
+    std::map<uint64_t, LinuxTracing::GpuJob>& jobs = jobs_it->second;
+    // The callstacks of the earlier submissions of the thread were lost.
+    auto job_it = jobs.begin();
+    for (; job_it != jobs.end() && job_it->first < timestamp_ns; ++job_it) {
+      released.push_back(PairedJob{job_it->second, 0});
+    }
+    if (job_it != jobs.end() && job_it->first == timestamp_ns) {
+      released.push_back(PairedJob{job_it->second, callstack_id});
+      paired = true;
+      ++job_it;
+    }
+    jobs.erase(jobs.begin(), job_it);
+    if (jobs.empty()) {
+      waiting_jobs_per_thread_.erase(jobs_it);
+    }
+  }
+  if (!paired) {
+    waiting_callstacks_.insert_or_assign(Key{tid, timestamp_ns}, callstack_id);
+  }
+
+  ReleaseJobsDoneWaiting(&released);
+  return released;
+}
+
+std::vector<GpuJobCallstackPairer::PairedJob> GpuJobCallstackPairer::Flush() {
+  std::vector<PairedJob> released;
+  for (const auto& [tid, jobs] : waiting_jobs_per_thread_) {
+    for (const auto& [submission_ns, job] : jobs) {
+      released.push_back(PairedJob{job, 0});
+    }
+  }
+  waiting_jobs_per_thread_.clear();
+  waiting_callstacks_.clear();
+  return released;
+}
+
+void GpuJobCallstackPairer::ReleaseJobsDoneWaiting(
+    std::vector<PairedJob>* released) {
+  if (last_event_ns_ < next_check_ns_) {
+    return;
+  }
+  next_check_ns_ = last_event_ns_ + kCheckPeriodNs;
+
+  for (auto jobs_it = waiting_jobs_per_thread_.begin();
+       jobs_it != waiting_jobs_per_thread_.end();) {
+    std::map<uint64_t, LinuxTracing::GpuJob>& jobs = jobs_it->second;
+    auto job_it = jobs.begin();
+    for (; job_it != jobs.end() && job_it->first + kMaxWaitNs < last_event_ns_;
+         ++job_it) {
+      released->push_back(PairedJob{job_it->second, 0});
+    }
+    jobs.erase(jobs.begin(), job_it);
+    if (jobs.empty()) {
+      waiting_jobs_per_thread_.erase(jobs_it++);
+    } else {
+      ++jobs_it;
+    }
+  }
+  for (auto it = waiting_callstacks_.begin();
+       it != waiting_callstacks_.end();) {
+    if (it->first.second + kMaxWaitNs < last_event_ns_) {
+      waiting_callstacks_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
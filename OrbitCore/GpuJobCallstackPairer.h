@@ -0,0 +1,56 @@
+#ifndef ORBIT_CORE_GPU_JOB_CALLSTACK_PAIRER_H_
+#define ORBIT_CORE_GPU_JOB_CALLSTACK_PAIRER_H_
+
+#include <OrbitLinuxTracing/Events.h>
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "CallstackTypes.h"
+#include "absl/container/flat_hash_map.h"
+
+// Pairs the GpuJobs with the callstacks of their submissions (see
+// LinuxTracing::Tracer::SetTraceGpuSubmissionCallstacks), by the thread and
+// the time of amdgpu_cs_ioctl they both carry. They are reported by different
+// threads of the tracer, in either order, so each waits for the other. As the
+// callstacks of a thread are reported in order, a job is released without a
+// callstack once a later callstack of its thread is added. Jobs of other
+// processes, whose stacks are not unwound, and callstacks whose job was lost
+// are released after kMaxWaitNs, in the time of the events added since.
+class GpuJobCallstackPairer {
+ public:
+  struct PairedJob {
+    LinuxTracing::GpuJob job;
+    // 0 if the job has no callstack.
+    CallstackID callstack_id;
+  };
+
+  static constexpr uint64_t kMaxWaitNs = 1'000'000'000;
+
+  // Both return the jobs that are done waiting, in no particular order.
+  std::vector<PairedJob> AddJob(const LinuxTracing::GpuJob& job);
+  std::vector<PairedJob> AddCallstack(pid_t tid, uint64_t timestamp_ns,
+                                      CallstackID callstack_id);
+  // Releases all the jobs still waiting, e.g., at the end of the capture.
+  std::vector<PairedJob> Flush();
+
+ private:
+  // The thread and the time of the submission.
+  using Key = std::pair<pid_t, uint64_t>;
+
+  void ReleaseJobsDoneWaiting(std::vector<PairedJob>* released);
+
+  // By thread, then by time of submission.
+  absl::flat_hash_map<pid_t, std::map<uint64_t, LinuxTracing::GpuJob>>
+      waiting_jobs_per_thread_;
+  absl::flat_hash_map<Key, CallstackID> waiting_callstacks_;
+  absl::flat_hash_map<pid_t, uint64_t> last_callstack_ns_per_thread_;
+  // The latest time of the events added, and when the waiting jobs and
+  // callstacks are next checked against it.
+  uint64_t last_event_ns_ = 0;
+  uint64_t next_check_ns_ = 0;
+};
+
+#endif  // ORBIT_CORE_GPU_JOB_CALLSTACK_PAIRER_H_
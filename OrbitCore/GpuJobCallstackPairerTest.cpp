@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "GpuJobCallstackPairer.h"
+
+namespace {
+LinuxTracing::GpuJob MakeJob(pid_t tid, uint64_t cs_ioctl_time_ns,
+                             uint64_t dma_fence_signaled_time_ns) {
+  return LinuxTracing::GpuJob{tid,
+                              /*context=*/1,
+                              /*seqno=*/2,
+                              "gfx",
+                              /*depth=*/0,
+                              cs_ioctl_time_ns,
+                              cs_ioctl_time_ns + 10,
+                              cs_ioctl_time_ns + 20,
+                              dma_fence_signaled_time_ns};
+}
+}  // namespace
+
+TEST(GpuJobCallstackPairer, PairsInEitherOrder) {
+  GpuJobCallstackPairer pairer;
+  EXPECT_TRUE(pairer.AddCallstack(10, 100, 0xabc).empty());
+  std::vector<GpuJobCallstackPairer::PairedJob> released =
+      pairer.AddJob(MakeJob(10, 100, 500));
+  ASSERT_EQ(released.size(), 1);
+  EXPECT_EQ(released[0].job.GetAmdgpuCsIoctlTimeNs(), 100);
+  EXPECT_EQ(released[0].callstack_id, 0xabc);
+
+  EXPECT_TRUE(pairer.AddJob(MakeJob(20, 200, 600)).empty());
+  released = pairer.AddCallstack(20, 200, 0xdef);
+  ASSERT_EQ(released.size(), 1);
+  EXPECT_EQ(released[0].job.GetTid(), 20);
+  EXPECT_EQ(released[0].callstack_id, 0xdef);
+
+  EXPECT_TRUE(pairer.Flush().empty());
+}
+
+TEST(GpuJobCallstackPairer, ReleasesJobsWhoseCallstackWasLost) {
+  GpuJobCallstackPairer pairer;
+  EXPECT_TRUE(pairer.AddJob(MakeJob(10, 100, 500)).empty());
+  // A later callstack of the same thread: the one at 100 won't come.
+  std::vector<GpuJobCallstackPairer::PairedJob> released =
+      pairer.AddCallstack(10, 300, 0xabc);
+  ASSERT_EQ(released.size(), 1);
+  EXPECT_EQ(released[0].job.GetAmdgpuCsIoctlTimeNs(), 100);
+  EXPECT_EQ(released[0].callstack_id, 0);
+
+  // Already known when the job comes.
+  released = pairer.AddJob(MakeJob(10, 200, 600));
+  ASSERT_EQ(released.size(), 1);
+  EXPECT_EQ(released[0].callstack_id, 0);
+}
+
+TEST(GpuJobCallstackPairer, ReleasesJobsOfOtherProcessesAfterMaxWait) {
+  GpuJobCallstackPairer pairer;
+  EXPECT_TRUE(pairer.AddJob(MakeJob(10, 100, 500)).empty());
+
+  uint64_t later_ns = 100 + GpuJobCallstackPairer::kMaxWaitNs + 1;
+  std::vector<GpuJobCallstackPairer::PairedJob> released =
+      pairer.AddJob(MakeJob(20, later_ns, later_ns + 100));
+  ASSERT_EQ(released.size(), 1);
+  EXPECT_EQ(released[0].job.GetTid(), 10);
+  EXPECT_EQ(released[0].callstack_id, 0);
+
+  released = pairer.Flush();
+  ASSERT_EQ(released.size(), 1);
+  EXPECT_EQ(released[0].job.GetTid(), 20);
+}
@@ -0,0 +1,41 @@
+#ifndef ORBIT_CORE_HASH_JOIN_H_
+#define ORBIT_CORE_HASH_JOIN_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "ParallelFor.h"
+
+// The values of index for those of keys it has, in the order of keys: a join
+// of keys with an index built beforehand, e.g. the function hashes a session
+// saved for a module with the hashes of the names of the functions of the
+// module. Many keys are probed in parallel, a shard of them per worker, and
+// the index is only read.
+template <typename Map>
+std::vector<typename Map::mapped_type> HashJoin(
+    const Map& index, const std::vector<typename Map::key_type>& keys) {
+  // Below this, probing is faster than starting threads.
+  constexpr size_t kMinKeysPerShard = 1024;
+  size_t num_shards =
+      std::clamp<size_t>(keys.size() / kMinKeysPerShard, 1, GetNumWorkers());
+
+  std::vector<std::vector<typename Map::mapped_type>> shards(num_shards);
+  ParallelFor(num_shards, [&](size_t shard) {
+    size_t begin = shard * keys.size() / num_shards;
+    size_t end = (shard + 1) * keys.size() / num_shards;
+    for (size_t i = begin; i < end; ++i) {
+      auto it = index.find(keys[i]);
+      if (it != index.end()) {
+        shards[shard].push_back(it->second);
+      }
+    }
+  });
+
+  std::vector<typename Map::mapped_type> values = std::move(shards[0]);
+  for (size_t shard = 1; shard < num_shards; ++shard) {
+    values.insert(values.end(), shards[shard].begin(), shards[shard].end());
+  }
+  return values;
+}
+
+#endif  // ORBIT_CORE_HASH_JOIN_H_
@@ -0,0 +1,27 @@
+#include <gtest/gtest.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "HashJoin.h"
+
+TEST(HashJoin, FindsTheValuesOfTheKeysInTheIndex) {
+  std::unordered_map<uint64_t, int> index = {{1, 10}, {2, 20}, {3, 30}};
+  EXPECT_EQ(HashJoin(index, {3, 4, 1}), (std::vector<int>{30, 10}));
+  EXPECT_TRUE(HashJoin(index, {}).empty());
+  EXPECT_TRUE(HashJoin(std::unordered_map<uint64_t, int>(), {1}).empty());
+}
+
+TEST(HashJoin, KeepsTheOrderOfManyKeys) {
+  std::unordered_map<uint64_t, uint64_t> index;
+  for (uint64_t i = 0; i < 10000; i += 2) {
+    index[i] = i * 3;
+  }
+  std::vector<uint64_t> keys;
+  std::vector<uint64_t> expected;
+  for (uint64_t i = 20000; i-- > 0;) {
+    keys.push_back(i);
+    if (i < 10000 && i % 2 == 0) expected.push_back(i * 3);
+  }
+  EXPECT_EQ(HashJoin(index, keys), expected);
+}
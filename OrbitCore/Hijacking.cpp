@@ -4,7 +4,11 @@
 
 #include <intrin.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <iostream>
+#include <mutex>
 #include <unordered_set>
 #include <vector>
 
@@ -13,6 +17,7 @@
 #include "Callstack.h"
 #include "Context.h"
 #include "Core.h"
+#include "FunctionSampler.h"
 #include "Message.h"
 #include "MinHook.h"
 #include "OrbitAsm.h"
@@ -21,12 +26,66 @@
 #include "ScopeTimer.h"
 #include "TcpClient.h"
 #include "TimerManager.h"
+#include "UnrealObjectNames.h"
 
 // clang-format off
 #include "Hijacking.h"
 // clang-format on
 
 const unsigned int MAX_DEPTH = 64;
+// Callstacks the process remembers having sent, a power of 2.
+const unsigned int NUM_SENT_CALLSTACK_SLOTS = 64 * 1024;
+// Slots probed for a callstack before giving up and sending it again.
+const unsigned int MAX_SENT_CALLSTACK_PROBES = 16;
+// Functions whose callstacks can be tracked, a power of 2.
+const unsigned int NUM_CALLSTACK_FUNCTION_SLOTS = 4096;
+// Hooks enabled per suspension of the threads of the process. Enabling a hook
+// checks the instruction pointer of every suspended thread against every
+// hook, so a suspension per batch keeps each pause of the process short
+// while sparing a suspension per hook.
+const uint32_t HOOK_BATCH_SIZE = 256;
+// Names of UObjects are sent in batches of about this many bytes, or once the
+// first name of the batch is this old.
+const size_t UOBJECT_NAME_BATCH_BYTES = 4096;
+const TickType UOBJECT_NAME_BATCH_NS = 10 * 1000 * 1000;
+
+//-----------------------------------------------------------------------------
+// Stack of the hooked calls of a thread, in place up to MAX_DEPTH entries so
+// that the hooks don't allocate, on the heap beyond, for deep recursions.
+template <class T>
+class ShadowStack {
+ public:
+  __forceinline T& push_back() {
+    if (m_Size >= MAX_DEPTH) {
+      m_Overflow.emplace_back();
+    }
+    T& item = (*this)[m_Size++];
+    item = T();
+    return item;
+  }
+
+  __forceinline void push_back(const T& a_Item) { push_back() = a_Item; }
+
+  __forceinline void pop_back() {
+    if (--m_Size >= MAX_DEPTH) {
+      m_Overflow.pop_back();
+    }
+  }
+
+  __forceinline T& back() { return (*this)[m_Size - 1]; }
+
+  __forceinline T& operator[](uint32_t a_Index) {
+    return a_Index < MAX_DEPTH ? m_Items[a_Index]
+                               : m_Overflow[a_Index - MAX_DEPTH];
+  }
+
+  uint32_t size() const { return m_Size; }
+
+ private:
+  T m_Items[MAX_DEPTH];
+  std::vector<T> m_Overflow;
+  uint32_t m_Size = 0;
+};
 
 //-----------------------------------------------------------------------------
 struct ContextScope {
@@ -45,25 +104,77 @@ struct ContextScope {
 #define SSE_SCOPE
 #endif
 
+//-----------------------------------------------------------------------------
+// Callstacks sent in each session, shared by all the threads so that each is
+// sent once per process rather than once per thread: an open addressing
+// table inserted into without locking. Keys are salted with the session, so
+// that a callstack remembered from the previous session is sent again. When
+// the probed slots are all taken, the callstack is sent again, a harmless
+// duplicate.
+class SentCallstackSet {
+ public:
+  // Whether a_Hash was sent already in a_SessionId, remembering it if not.
+  __forceinline bool CheckAndInsert(CallstackID a_Hash, uint32_t a_SessionId) {
+    CallstackID key = a_Hash ^ (a_SessionId * 0x9e3779b97f4a7c15ull);
+    if (key == 0) key = 1;
+
+    uint32_t index = uint32_t(key);
+    for (uint32_t i = 0; i < MAX_SENT_CALLSTACK_PROBES; ++i, ++index) {
+      std::atomic<CallstackID>& slot =
+          m_Slots[index & (NUM_SENT_CALLSTACK_SLOTS - 1)];
+      CallstackID value = slot.load(std::memory_order_relaxed);
+      if (value == 0 &&
+          slot.compare_exchange_strong(value, key, std::memory_order_relaxed)) {
+        return false;
+      }
+      if (value == key) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Frees the slots of the callstacks of previous sessions, once per session.
+  void ClearForSession(uint32_t a_SessionId) {
+    if (m_SessionID.exchange(a_SessionId) != a_SessionId) {
+      for (std::atomic<CallstackID>& slot : m_Slots) {
+        slot.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+
+ private:
+  std::atomic<CallstackID> m_Slots[NUM_SENT_CALLSTACK_SLOTS] = {};
+  std::atomic<uint32_t> m_SessionID = uint32_t(-1);
+};
+
+SentCallstackSet GSentCallstacks;
+SentUObjectSet GSentUObjects;
+
+// The batch of UObject names not sent yet, taken by FlushUObjectNames. Only
+// objects not sent yet get there, the lock is rarely taken once the actors
+// of the game were hit.
+std::mutex GUObjectNamesMutex;
+std::string GUObjectNames;
+// When the first name of the batch was added, 0 if it is empty.
+std::atomic<TickType> GUObjectNamesBeginTick;
+
 //-----------------------------------------------------------------------------
 struct ThreadLocalData {
   ThreadLocalData() {
-    m_Timers.reserve(MAX_DEPTH);
-    m_ReturnAdresses.reserve(MAX_DEPTH);
-    m_Contexts.reserve(MAX_DEPTH);
-    m_SentCallstacks.reserve(1024);
     m_SessionID = -1;
     m_ThreadID = GetCurrentThreadId();
     m_ThreadName = GetCurrentThreadName();
     m_ZoneStack = 0;
+    m_WalkedFrames.reserve(4 * ORBIT_STACK_SIZE);
     SendThreadInfo();
   }
 
   __forceinline void CheckSessionId() {
     if (m_SessionID != Message::GSessionID) {
-      m_SentCallstacks.clear();
+      GSentCallstacks.ClearForSession(Message::GSessionID);
+      GSentUObjects.ClearForSession(Message::GSessionID);
       m_SentLiterals.clear();
-      m_SentActorNames.clear();
       m_SessionID = Message::GSessionID;
       Timer::ClearThreadDepthTLS();
       m_ZoneStack = 0;
@@ -80,13 +191,51 @@ struct ThreadLocalData {
     }
   }
 
+  // Remembers the callstack walked by the current hooked call, the innermost,
+  // so that the calls it makes can reuse it.
+  void PushWalkedCall(DWORD64 a_Rsp, const CallStackPOD& a_Callstack,
+                      const CallstackHashState& a_OuterHash) {
+    WalkedCall& call = m_WalkedCalls.push_back();
+    call.m_OuterHash = a_OuterHash;
+    call.m_ReturnAddressIndex = m_ReturnAdresses.size() - 1;
+    call.m_Rsp = a_Rsp;
+    call.m_Begin = uint32_t(m_WalkedFrames.size());
+    call.m_Depth = a_Callstack.m_Depth;
+    m_WalkedFrames.insert(m_WalkedFrames.end(), a_Callstack.m_Data,
+                          a_Callstack.m_Data + a_Callstack.m_Depth);
+  }
+
+  // Forgets the callstacks of the hooked calls that returned, now that a new
+  // call takes the place a_ReturnAddressIndex in m_ReturnAdresses.
+  __forceinline void PopWalkedCalls(uint32_t a_ReturnAddressIndex) {
+    while (m_WalkedCalls.size() > 0 &&
+           m_WalkedCalls.back().m_ReturnAddressIndex >= a_ReturnAddressIndex) {
+      m_WalkedFrames.resize(m_WalkedCalls.back().m_Begin);
+      m_WalkedCalls.pop_back();
+    }
+  }
+
+  // Hooked call still running whose callstack was walked.
+  struct WalkedCall {
+    uint32_t m_ReturnAddressIndex;
+    DWORD64 m_Rsp;
+    // Of its frames in m_WalkedFrames.
+    uint32_t m_Begin;
+    int m_Depth;
+    // Hash state of its frames but the innermost, which are those its calls
+    // copy.
+    CallstackHashState m_OuterHash;
+  };
+
   std::string m_ThreadName;
-  std::vector<ReturnAddress> m_ReturnAdresses;
-  std::vector<Timer> m_Timers;
-  std::vector<const Context*> m_Contexts;
-  std::unordered_set<CallstackID> m_SentCallstacks;
+  ShadowStack<ReturnAddress> m_ReturnAdresses;
+  ShadowStack<Timer> m_Timers;
+  ShadowStack<const Context*> m_Contexts;
+  ShadowStack<WalkedCall> m_WalkedCalls;
+  std::vector<DWORD64> m_WalkedFrames;
+  FunctionSampler m_Sampler;
+  uint32_t m_SamplingPoliciesVersion = 0;
   std::unordered_set<char*> m_SentLiterals;
-  std::unordered_set<char*> m_SentActorNames;
   uint32_t m_SessionID;
   uint32_t m_ThreadID;
   int m_ZoneStack;
@@ -117,6 +266,7 @@ void* EpilogEmpty();
 void* EpilogZoneStop();
 void* EpilogAlloc();
 
+__forceinline bool NeedsCallstack(void* a_OriginalFunctionAddress);
 __forceinline CallstackID SendCallstack(void* a_OriginalFunctionAddress,
                                         void** a_ReturnAddressLocation);
 __forceinline void PushReturnAddress(void** a_ReturnAddress);
@@ -142,9 +292,22 @@ __forceinline void SendContext(const Context* a_Context,
 __forceinline void SetOriginalReturnAddresses();
 __forceinline void SetOverridenReturnAddresses();
 __forceinline void SendUObjectName(void* a_UnrealActor);
+__forceinline void FlushUObjectNamesIfDue();
+__forceinline void AddTimer(const Timer& a_Timer);
+void FlushSampler();
 
 std::unordered_map<ULONG64, FunctionArgInfo> m_FunctionArgsMap;
-std::unordered_set<ULONG64> m_SendCallstacks;
+// Functions whose callstacks are collected, set by TrackCallstack: an open
+// addressing table of their addresses, read by the hooks without locking.
+// Callstacks are collected for all functions while it is empty, or if it got
+// full.
+std::atomic<ULONG64> m_CallstackFunctions[NUM_CALLSTACK_FUNCTION_SLOTS];
+std::atomic<uint32_t> m_NumCallstackFunctions;
+std::atomic<bool> m_CallstackFunctionsFull;
+// Copied by each thread into its FunctionSampler when the version changes.
+std::mutex m_SamplingPoliciesMutex;
+std::vector<FunctionSamplingPolicy> m_SamplingPolicies;
+std::atomic<uint32_t> m_SamplingPoliciesVersion;
 OrbitUnrealInfo m_UnrealInfo;
 
 // On Win64, epilog context is at 40 bytes: 8 bytes (return address) + 32 bytes
@@ -158,30 +321,55 @@ struct HijackManager {
 HijackManager GHijackManager;
 }  // namespace Hijacking
 
+//-----------------------------------------------------------------------------
+__forceinline bool Hijacking::NeedsCallstack(void* a_OriginalFunctionAddress) {
+  if (m_NumCallstackFunctions.load(std::memory_order_relaxed) == 0 ||
+      m_CallstackFunctionsFull.load(std::memory_order_relaxed)) {
+    return true;
+  }
+
+  ULONG64 address = reinterpret_cast<ULONG64>(a_OriginalFunctionAddress);
+  for (uint32_t i = uint32_t(address >> 4);; ++i) {
+    ULONG64 slot =
+        m_CallstackFunctions[i & (NUM_CALLSTACK_FUNCTION_SLOTS - 1)].load(
+            std::memory_order_relaxed);
+    if (slot == address) return true;
+    if (slot == 0) return false;
+  }
+}
+
 //-----------------------------------------------------------------------------
 __forceinline CallstackID Hijacking::SendCallstack(
     void* a_OriginalFunctionAddress, void** a_ReturnAddressLocation) {
-  /*bool needsCallstack = m_SendCallstacks.find( reinterpret_cast<ULONG64>(
-  a_OriginalFunctionAddress ) ) != m_SendCallstacks.end(); if( needsCallstack
-  )*/
-  {
-    SetOriginalReturnAddresses();
-    CallStackPOD cs = CallStackPOD::Walk((DWORD64)a_OriginalFunctionAddress,
-                                         (DWORD64)a_ReturnAddressLocation);
-    SetOverridenReturnAddresses();
-
-    // Send callstack once (*per thread* for now, we should have a concurrent
-    // set or hashmap...)
-    if (TlsData->m_SentCallstacks.find(cs.m_Hash) ==
-        TlsData->m_SentCallstacks.end()) {
-      TlsData->m_SentCallstacks.insert(cs.m_Hash);
-      GTcpClient->Send(Msg_Callstack, (void*)&cs, cs.GetSizeInBytes());
-    }
+  if (!NeedsCallstack(a_OriginalFunctionAddress)) {
+    return 0;
+  }
+
+  // The frames above the innermost enclosing call that walked its callstack
+  // are the same as in its callstack.
+  SetOriginalReturnAddresses();
+  CallStackPOD cs;
+  CallstackHashState outerHash;
+  if (TlsData->m_WalkedCalls.size() > 0) {
+    const ThreadLocalData::WalkedCall& caller = TlsData->m_WalkedCalls.back();
+    cs = CallStackPOD::Walk((DWORD64)a_OriginalFunctionAddress,
+                            (DWORD64)a_ReturnAddressLocation,
+                            &TlsData->m_WalkedFrames[caller.m_Begin],
+                            caller.m_Depth, caller.m_Rsp, caller.m_OuterHash,
+                            &outerHash);
+  } else {
+    cs = CallStackPOD::Walk((DWORD64)a_OriginalFunctionAddress,
+                            (DWORD64)a_ReturnAddressLocation, nullptr, 0, 0,
+                            CallstackHashState(), &outerHash);
+  }
+  SetOverridenReturnAddresses();
+  TlsData->PushWalkedCall((DWORD64)a_ReturnAddressLocation, cs, outerHash);
 
-    return cs.m_Hash;
+  if (!GSentCallstacks.CheckAndInsert(cs.m_Hash, TlsData->m_SessionID)) {
+    GTcpClient->Send(Msg_Callstack, (void*)&cs, cs.GetSizeInBytes());
   }
 
-  // return 0;
+  return cs.m_Hash;
 }
 
 //-----------------------------------------------------------------------------
@@ -193,12 +381,12 @@ void Hijacking::Prolog(void* a_OriginalFunctionAddress, Context* a_Context,
   PushContext(a_Context, a_OriginalFunctionAddress);
   PushReturnAddress(&a_Context->m_RET.m_Ptr);
 
-  TlsData->m_Timers.push_back(Timer());
-  TlsData->m_Timers.back().m_FunctionAddress =
+  Timer& timer = TlsData->m_Timers.push_back();
+  timer.m_FunctionAddress =
       reinterpret_cast<ULONG64>(a_OriginalFunctionAddress);
-  TlsData->m_Timers.back().m_CallstackHash =
+  timer.m_CallstackHash =
       SendCallstack(a_OriginalFunctionAddress, &a_Context->m_RET.m_Ptr);
-  TlsData->m_Timers.back().Start();
+  timer.Start();
 }
 
 //-----------------------------------------------------------------------------
@@ -212,12 +400,12 @@ void Hijacking::PrologZoneStart(void* a_OriginalFunctionAddress,
 
   ++TlsData->m_ZoneStack;
 
-  TlsData->m_Timers.push_back(Timer());
-  TlsData->m_Timers.back().m_FunctionAddress =
+  Timer& timer = TlsData->m_Timers.push_back();
+  timer.m_FunctionAddress =
       reinterpret_cast<ULONG64>(a_OriginalFunctionAddress);
-  TlsData->m_Timers.back().m_CallstackHash =
+  timer.m_CallstackHash =
       SendCallstack(a_OriginalFunctionAddress, &a_Context->m_RET.m_Ptr);
-  TlsData->m_Timers.back().Start();
+  timer.Start();
 }
 
 //-----------------------------------------------------------------------------
@@ -275,7 +463,7 @@ void Hijacking::PrologSendData(void* a_OriginalFunctionAddress,
 
   entry.m_CallstackHash =
       SendCallstack(a_OriginalFunctionAddress, &a_Context->m_RET.m_Ptr);
-  GTcpClient->Send(entry);
+  GTimerManager->AddUserData(entry);
 }
 
 typedef void* (*GetDisplayNameEntryFunction)(void*);
@@ -297,8 +485,7 @@ void Hijacking::PrologUnrealActor(void* a_OriginalFunctionAddress,
 #endif
   SendUObjectName(uobject);
 
-  TlsData->m_Timers.push_back(Timer());
-  Timer& timer = TlsData->m_Timers.back();
+  Timer& timer = TlsData->m_Timers.push_back();
   timer.m_Type = Timer::UNREAL_OBJECT;
   timer.m_FunctionAddress =
       reinterpret_cast<ULONG64>(a_OriginalFunctionAddress);
@@ -311,36 +498,54 @@ void Hijacking::PrologUnrealActor(void* a_OriginalFunctionAddress,
 #define NAME_WIDE_MASK 0x1
 //-----------------------------------------------------------------------------
 __forceinline void Hijacking::SendUObjectName(void* a_UObject) {
-  if (a_UObject) {
-    void* FName = (char*)a_UObject + m_UnrealInfo.m_UobjectNameOffset;
-    void* Entry = GetDisplayNameEntry(FName);
-    char* actorName = (char*)Entry + m_UnrealInfo.m_EntryNameOffset;
-
-    if (TlsData->m_SentActorNames.find(actorName) ==
-        TlsData->m_SentActorNames.end()) {
-      int Index = *(int*)((char*)Entry + m_UnrealInfo.m_EntryIndexOffset);
-      bool IsWide = (Index & NAME_WIDE_MASK);
-
-      if (IsWide) {
-        wchar_t* actorNameW = (wchar_t*)actorName;
-        size_t numChars = wcslen(actorNameW) + 1;
-        Message msg(Msg_OrbitUnrealObject, (int)(numChars * sizeof(wchar_t)),
-                    (char*)actorNameW);
-        msg.m_Header.m_UnrealObjectHeader.m_WideStr = true;
-        msg.m_Header.m_UnrealObjectHeader.m_Ptr = (DWORD64)a_UObject;
-        msg.m_Header.m_UnrealObjectHeader.m_StrSize = (uint32_t)numChars;
-        GTcpClient->Send(msg);
-      } else {
-        size_t numChars = strlen(actorName) + 1;
-        Message msg(Msg_OrbitUnrealObject, (int)numChars, actorName);
-        msg.m_Header.m_UnrealObjectHeader.m_WideStr = false;
-        msg.m_Header.m_UnrealObjectHeader.m_Ptr = (DWORD64)a_UObject;
-        msg.m_Header.m_UnrealObjectHeader.m_StrSize = (uint32_t)numChars;
-        GTcpClient->Send(msg);
-      }
+  if (!a_UObject || GSentUObjects.CheckAndInsert((DWORD64)a_UObject)) {
+    FlushUObjectNamesIfDue();
+    return;
+  }
+
+  void* FName = (char*)a_UObject + m_UnrealInfo.m_UobjectNameOffset;
+  void* Entry = GetDisplayNameEntry(FName);
+  char* actorName = (char*)Entry + m_UnrealInfo.m_EntryNameOffset;
+  int Index = *(int*)((char*)Entry + m_UnrealInfo.m_EntryIndexOffset);
+  bool IsWide = (Index & NAME_WIDE_MASK);
+  size_t numBytes = IsWide ? wcslen((wchar_t*)actorName) * sizeof(wchar_t)
+                           : strlen(actorName);
 
-      TlsData->m_SentActorNames.insert(actorName);
+  size_t batchSize;
+  {
+    std::lock_guard<std::mutex> lock(GUObjectNamesMutex);
+    if (GUObjectNames.empty()) {
+      GUObjectNamesBeginTick = OrbitTicks();
     }
+    EncodeUObjectName((DWORD64)a_UObject, actorName, (uint32_t)numBytes,
+                      IsWide, &GUObjectNames);
+    batchSize = GUObjectNames.size();
+  }
+  if (batchSize >= UOBJECT_NAME_BATCH_BYTES) {
+    FlushUObjectNames();
+  } else {
+    FlushUObjectNamesIfDue();
+  }
+}
+
+//-----------------------------------------------------------------------------
+__forceinline void Hijacking::FlushUObjectNamesIfDue() {
+  TickType beginTick = GUObjectNamesBeginTick.load(std::memory_order_relaxed);
+  if (beginTick != 0 && OrbitTicks() - beginTick >= UOBJECT_NAME_BATCH_NS) {
+    FlushUObjectNames();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void Hijacking::FlushUObjectNames() {
+  std::string names;
+  {
+    std::lock_guard<std::mutex> lock(GUObjectNamesMutex);
+    names.swap(GUObjectNames);
+    GUObjectNamesBeginTick = 0;
+  }
+  if (!names.empty()) {
+    GTcpClient->Send(Msg_OrbitUnrealObjects, names.data(), names.size());
   }
 }
 
@@ -353,8 +558,7 @@ void Hijacking::PrologFree(void* a_OriginalFunctionAddress, Context* a_Context,
   PushContext(a_Context, a_OriginalFunctionAddress);
   PushReturnAddress(&a_Context->m_RET.m_Ptr);
 
-  TlsData->m_Timers.push_back(Timer());
-  Timer& timer = TlsData->m_Timers.back();
+  Timer& timer = TlsData->m_Timers.push_back();
   timer.m_FunctionAddress =
       reinterpret_cast<ULONG64>(a_OriginalFunctionAddress);
   timer.m_CallstackHash =
@@ -378,7 +582,8 @@ __forceinline void Hijacking::SetOriginalReturnAddresses() {
 
   void* lastWritten = nullptr;
 
-  for (ReturnAddress& ret : TlsData->m_ReturnAdresses) {
+  for (uint32_t i = 0; i < TlsData->m_ReturnAdresses.size(); ++i) {
+    ReturnAddress& ret = TlsData->m_ReturnAdresses[i];
     ret.m_EpilogAddress = *ret.m_AddressOfReturnAddress;
 
     if (ret.m_AddressOfReturnAddress != lastWritten) {
@@ -392,7 +597,8 @@ __forceinline void Hijacking::SetOriginalReturnAddresses() {
 __forceinline void Hijacking::SetOverridenReturnAddresses() {
   void* lastWritten = nullptr;
 
-  for (ReturnAddress& ret : TlsData->m_ReturnAdresses) {
+  for (uint32_t i = 0; i < TlsData->m_ReturnAdresses.size(); ++i) {
+    ReturnAddress& ret = TlsData->m_ReturnAdresses[i];
     if (ret.m_AddressOfReturnAddress != lastWritten) {
       *ret.m_AddressOfReturnAddress = ret.m_EpilogAddress;
       lastWritten = ret.m_AddressOfReturnAddress;
@@ -400,6 +606,42 @@ __forceinline void Hijacking::SetOverridenReturnAddresses() {
   }
 }
 
+//-----------------------------------------------------------------------------
+__forceinline void Hijacking::AddTimer(const Timer& a_Timer) {
+  if (TlsData->m_SamplingPoliciesVersion != m_SamplingPoliciesVersion) {
+    std::lock_guard<std::mutex> lock(m_SamplingPoliciesMutex);
+    TlsData->m_Sampler = FunctionSampler(m_SamplingPolicies);
+    TlsData->m_SamplingPoliciesVersion = m_SamplingPoliciesVersion;
+  }
+
+  FunctionSampler& sampler = TlsData->m_Sampler;
+  if (sampler.IsEmpty() || sampler.AddTimer(a_Timer)) {
+    GTimerManager->Add(a_Timer);
+  }
+  if (sampler.IsFlushDue(a_Timer.m_End)) {
+    FlushSampler();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void Hijacking::FlushSampler() {
+  std::vector<Timer> timers;
+  std::vector<FunctionStats> stats;
+  TlsData->m_Sampler.Flush(&timers, &stats);
+  GTimerManager->Add(timers.data(), timers.size());
+  if (!stats.empty()) {
+    GTcpClient->Send(Msg_FunctionStats, stats);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void Hijacking::SetSamplingPolicies(const FunctionSamplingPolicy* a_Policies,
+                                    uint32_t a_NumPolicies) {
+  std::lock_guard<std::mutex> lock(m_SamplingPoliciesMutex);
+  m_SamplingPolicies.assign(a_Policies, a_Policies + a_NumPolicies);
+  ++m_SamplingPoliciesVersion;
+}
+
 //-----------------------------------------------------------------------------
 void* Hijacking::Epilog() {
   SSE_SCOPE;
@@ -408,7 +650,7 @@ void* Hijacking::Epilog() {
   timer.Stop();
 
   // Send timer
-  GTimerManager->Add(timer);
+  AddTimer(timer);
 
   // Pop timer
   TlsData->m_Timers.pop_back();
@@ -529,10 +771,10 @@ void* Hijacking::EpilogAlloc() {
 //-----------------------------------------------------------------------------
 __forceinline void Hijacking::PushReturnAddress(
     void** a_AddressOfReturnAddress) {
-  ReturnAddress returnAddress;
+  TlsData->PopWalkedCalls(TlsData->m_ReturnAdresses.size());
+  ReturnAddress& returnAddress = TlsData->m_ReturnAdresses.push_back();
   returnAddress.m_AddressOfReturnAddress = a_AddressOfReturnAddress;
   returnAddress.m_OriginalReturnAddress = *a_AddressOfReturnAddress;
-  TlsData->m_ReturnAdresses.push_back(returnAddress);
 }
 
 //-----------------------------------------------------------------------------
@@ -682,8 +924,26 @@ bool Hijacking::EnableHook(void* a_FunctionAddress) {
 }
 
 //-----------------------------------------------------------------------------
-void Hijacking::EnableHooks(DWORD64* a_Addresses, uint32_t a_NumAddresses) {
-  MH_EnableHooks(a_Addresses, a_NumAddresses, true);
+void Hijacking::EnableHooks(
+    const DWORD64* a_Addresses, uint32_t a_NumAddresses,
+    const std::function<void(uint32_t)>& a_OnBatchEnabled) {
+  for (uint32_t begin = 0; begin < a_NumAddresses; begin += HOOK_BATCH_SIZE) {
+    uint32_t end = std::min(begin + HOOK_BATCH_SIZE, a_NumAddresses);
+    uint32_t numQueued = 0;
+    for (uint32_t i = begin; i < end; ++i) {
+      if (MH_QueueEnableHook((void*)a_Addresses[i]) == MH_OK) {
+        ++numQueued;
+      }
+    }
+
+    if (MH_ApplyQueued() != MH_OK) {
+      OutputDebugStringA("Orbit: Failed to enable a batch of hooks\n");
+      numQueued = 0;
+    }
+    if (a_OnBatchEnabled) {
+      a_OnBatchEnabled(numQueued);
+    }
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -755,7 +1015,11 @@ bool Hijacking::ThawMainThread(OrbitWaitLoop* a_WaitLoop) {
 //-----------------------------------------------------------------------------
 void Hijacking::ClearFunctionArguments() {
   m_FunctionArgsMap.clear();
-  m_SendCallstacks.clear();
+  m_NumCallstackFunctions = 0;
+  m_CallstackFunctionsFull = false;
+  for (std::atomic<ULONG64>& slot : m_CallstackFunctions) {
+    slot.store(0, std::memory_order_relaxed);
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -766,7 +1030,23 @@ void Hijacking::SetFunctionArguments(ULONG64 a_FunctionAddress,
 
 //-----------------------------------------------------------------------------
 void Hijacking::TrackCallstack(ULONG64 a_FunctionAddress) {
-  m_SendCallstacks.insert(a_FunctionAddress);
+  // Kept at most half full, for the probes of the hooks to stay short.
+  if (a_FunctionAddress == 0 ||
+      m_NumCallstackFunctions >= NUM_CALLSTACK_FUNCTION_SLOTS / 2) {
+    m_CallstackFunctionsFull = true;
+    return;
+  }
+
+  for (uint32_t i = uint32_t(a_FunctionAddress >> 4);; ++i) {
+    std::atomic<ULONG64>& slot =
+        m_CallstackFunctions[i & (NUM_CALLSTACK_FUNCTION_SLOTS - 1)];
+    ULONG64 expected = 0;
+    if (slot.compare_exchange_strong(expected, a_FunctionAddress)) {
+      ++m_NumCallstackFunctions;
+      return;
+    }
+    if (expected == a_FunctionAddress) return;
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -3,8 +3,11 @@
 //-----------------------------------
 #pragma once
 
+#include <functional>
+
 struct OrbitWaitLoop;
 struct FunctionArgInfo;
+struct FunctionSamplingPolicy;
 struct OrbitUnrealInfo;
 
 namespace Hijacking {
@@ -20,7 +23,12 @@ bool CreateFreeHook(void* a_FunctionAddress);
 bool CreateHook(void* a_FunctionAddress, void* a_PrologCallback,
                 void* a_EpilogCallback);
 bool EnableHook(void* a_FunctionAddress);
-void EnableHooks(DWORD64* a_Addresses, uint32_t a_NumAddresses);
+// Enables the created hooks of a_Addresses in batches, suspending the threads
+// of the process once per batch rather than once per hook. Calls
+// a_OnBatchEnabled with the number of hooks enabled by each batch.
+void EnableHooks(
+    const DWORD64* a_Addresses, uint32_t a_NumAddresses,
+    const std::function<void(uint32_t)>& a_OnBatchEnabled = nullptr);
 bool DisableHook(void* a_FunctionAddress);
 bool DisableAllHooks();
 bool SuspendBusyLoopThread(OrbitWaitLoop* a_WaitLoop);
@@ -30,7 +38,14 @@ void ClearFunctionArguments();
 void SetFunctionArguments(ULONG64 a_FunctionAddress,
                           const FunctionArgInfo& a_Args);
 void TrackCallstack(ULONG64 a_FunctionAddress);
+// Replaces the sampling policies of the hooked functions, which the threads
+// apply from their next call.
+void SetSamplingPolicies(const FunctionSamplingPolicy* a_Policies,
+                         uint32_t a_NumPolicies);
 void SetUnrealInfo(OrbitUnrealInfo& a_UnrealInfo);
+// Sends the names of the UObjects hit by the Unreal actor hooks that are
+// still batched, e.g. when the capture stops.
+void FlushUObjectNames();
 }  // namespace Hijacking
 
 //-----------------------------------------------------------------------------
@@ -0,0 +1,161 @@
+#include "HostConnection.h"
+
+#include <cstring>
+#include <vector>
+
+#include "BaseTypes.h"
+#include "Capture.h"
+#include "CoreApp.h"
+#include "KeyAndString.h"
+#include "LinuxSymbol.h"
+#include "OrbitBase/Logging.h"
+#include "Params.h"
+#include "Profiling.h"
+#include "TimerBatch.h"
+#include "TimerManager.h"
+
+namespace {
+// Strings and thread names share the stream of the timers they name.
+enum MessageStream : uint32_t {
+  kTimersStream,
+};
+}  // namespace
+
+void AdoptHostTimers(uint32_t host_index, const ClockCorrection& correction,
+                     absl::Span<Timer> timers) {
+  for (Timer& timer : timers) {
+    timer.m_TID = MakeHostThreadId(host_index, timer.m_TID);
+    if (!correction.IsIdentity()) {
+      timer.m_Start = correction.ToReference(timer.m_Start);
+      timer.m_End = correction.ToReference(timer.m_End);
+    }
+  }
+}
+
+HostConnection::HostConnection(uint32_t host_index, std::string address,
+                               uint32_t pid)
+    : host_index_(host_index), address_(std::move(address)), pid_(pid) {
+  CHECK(host_index_ > 0 && host_index_ <= kMaxHostIndex);
+  SetupCallbacks();
+  thread_ = std::thread(&HostConnection::ConnectionThreadWorker, this);
+}
+
+HostConnection::~HostConnection() {
+  exit_requested_ = true;
+  thread_.join();
+  client_.Stop();
+}
+
+void HostConnection::StartCapture() {
+  if (!client_.IsValid()) {
+    ERROR("Not connected to host %s", address_.c_str());
+    return;
+  }
+  Message msg(Msg_StartCapture);
+  msg.m_Header.m_GenericHeader.m_Address = pid_;
+  client_.Send(msg);
+}
+
+void HostConnection::StopCapture() {
+  if (client_.IsValid()) {
+    client_.Send(Msg_StopCapture);
+  }
+}
+
+ClockCorrection HostConnection::GetCorrection() {
+  absl::MutexLock lock(&clock_sync_mutex_);
+  return correction_;
+}
+
+void HostConnection::SetupCallbacks() {
+  client_.AddCallback(Msg_ClockSync, [this](const Message& msg) {
+    uint64_t receive_ns = OrbitTicks();
+    if (msg.m_Size != sizeof(ClockSyncProbe)) {
+      ERROR("Invalid clock sync probe of size %u", msg.m_Size);
+      return;
+    }
+    ClockSyncProbe probe;
+    memcpy(&probe, msg.GetData(), sizeof(probe));
+    ClockCorrection correction;
+    {
+      absl::MutexLock lock(&clock_sync_mutex_);
+      clock_sync_.AddRoundTrip(probe, receive_ns);
+      correction_ = clock_sync_.GetCorrection();
+      correction = correction_;
+    }
+    Capture::SetClockCorrection(address_, correction);
+  });
+
+  client_.AddWorkerCallback(
+      Msg_RemoteTimers, kTimersStream, [this](const Message& msg) {
+        // Reused across the batches decoded by a worker.
+        thread_local std::vector<Timer> timers;
+        timers.clear();
+        if (!DecodeTimerBatch(msg.GetData(), msg.m_Size, &timers)) {
+          ERROR("Invalid timers message of size %u from host %s", msg.m_Size,
+                address_.c_str());
+          return;
+        }
+        AdoptHostTimers(host_index_, GetCorrection(), absl::MakeSpan(timers));
+        GTimerManager->Add(timers.data(), timers.size());
+      });
+
+  // Keys are hashes of the strings, so the ones of all hosts can share the
+  // string manager.
+  client_.AddWorkerCallback(
+      Msg_KeysAndStrings, kTimersStream, [](const Message& msg) {
+        std::vector<KeyAndString> keys_and_strings;
+        if (!DecodeKeysAndStrings(msg.GetData(), msg.m_Size,
+                                  &keys_and_strings)) {
+          ERROR("Invalid strings message of size %u", msg.m_Size);
+          return;
+        }
+        for (const KeyAndString& key_and_string : keys_and_strings) {
+          GCoreApp->AddKeyAndString(key_and_string.key, key_and_string.str);
+        }
+      });
+
+  client_.AddCallback(Msg_ThreadNames, [this](const Message& msg) {
+    ClockCorrection correction = GetCorrection();
+    size_t num_thread_names = msg.m_Size / sizeof(ThreadNameKey);
+    const auto* thread_names =
+        reinterpret_cast<const ThreadNameKey*>(msg.GetData());
+    for (size_t i = 0; i < num_thread_names; ++i) {
+      ThreadNameKey thread_name = thread_names[i];
+      thread_name.thread_id =
+          MakeHostThreadId(host_index_, thread_name.thread_id);
+      thread_name.time = correction.ToReference(thread_name.time);
+      GCoreApp->AddThreadName(thread_name);
+    }
+  });
+}
+
+void HostConnection::SendClockSyncProbe() {
+  ClockSyncProbe probe;
+  probe.client_send_ns = OrbitTicks();
+  client_.Send(Msg_ClockSync, probe);
+}
+
+void HostConnection::ConnectionThreadWorker() {
+  while (!exit_requested_) {
+    if (!client_.IsValid()) {
+      client_.Connect(address_);
+      client_.Start();
+      {
+        absl::MutexLock lock(&clock_sync_mutex_);
+        clock_sync_ = ClockSync{};
+        correction_ = ClockCorrection{};
+      }
+      for (size_t i = 0; i < ClockSync::kNumProbesOnConnect; ++i) {
+        SendClockSyncProbe();
+      }
+      if (GParams.m_CompressRemoteTraffic) {
+        client_.RequestCompression();
+      }
+    } else {
+      SendClockSyncProbe();
+    }
+
+    Sleep(2000);
+  }
+}
@@ -0,0 +1,79 @@
+#ifndef ORBIT_CORE_HOST_CONNECTION_H_
+#define ORBIT_CORE_HOST_CONNECTION_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "CallstackTypes.h"
+#include "ClockSync.h"
+#include "ScopeTimer.h"
+#include "TcpClient.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+
+// Host 0 is the service of GTcpClient, the further hosts are numbered from 1.
+// The index of the host goes in the bits of the thread ids above the largest
+// pid of Linux, 2^22, so that the threads of the hosts never collide.
+constexpr uint32_t kHostIndexShift = 24;
+constexpr uint32_t kMaxHostIndex = (1u << (32 - kHostIndexShift)) - 1;
+
+inline ThreadID MakeHostThreadId(uint32_t host_index, ThreadID tid) {
+  return (host_index << kHostIndexShift) | tid;
+}
+inline uint32_t GetHostIndex(ThreadID tid) { return tid >> kHostIndexShift; }
+inline ThreadID GetLocalThreadId(ThreadID tid) {
+  return tid & ((1u << kHostIndexShift) - 1);
+}
+
+// Moves the timers received from host_index to the clock of the UI, with the
+// correction of the host, and to the thread ids of the host.
+void AdoptHostTimers(uint32_t host_index, const ClockCorrection& correction,
+                     absl::Span<Timer> timers);
+
+// Client side. A connection to a further service, usually on another host,
+// whose capture is shown on the timeline along with the one of GTcpClient,
+// e.g., the server of a game along with its client. Its messages are decoded
+// by the workers of its own TcpClient, in parallel to the ones of the other
+// hosts, and its timers, named scopes, GPU jobs and statistics, are added to
+// GTimerManager once corrected by AdoptHostTimers. The clock correction is
+// estimated from the round trips of Msg_ClockSync, like ConnectionManager
+// does for GTcpClient.
+class HostConnection {
+ public:
+  // pid is the process to capture on the host.
+  HostConnection(uint32_t host_index, std::string address, uint32_t pid);
+  ~HostConnection();
+
+  HostConnection(const HostConnection&) = delete;
+  HostConnection& operator=(const HostConnection&) = delete;
+
+  uint32_t GetHostIndex() const { return host_index_; }
+  const std::string& GetAddress() const { return address_; }
+
+  // Sent along with the start and stop of the capture of GTcpClient, without
+  // selected functions: the host sends what it traces of the process anyway.
+  void StartCapture();
+  void StopCapture();
+
+ private:
+  void SetupCallbacks();
+  void ConnectionThreadWorker();
+  void SendClockSyncProbe();
+  ClockCorrection GetCorrection();
+
+  const uint32_t host_index_;
+  const std::string address_;
+  const uint32_t pid_;
+  TcpClient client_;
+
+  absl::Mutex clock_sync_mutex_;
+  ClockSync clock_sync_ ABSL_GUARDED_BY(clock_sync_mutex_);
+  ClockCorrection correction_ ABSL_GUARDED_BY(clock_sync_mutex_);
+
+  std::atomic<bool> exit_requested_ = false;
+  std::thread thread_;
+};
+
+#endif  // ORBIT_CORE_HOST_CONNECTION_H_
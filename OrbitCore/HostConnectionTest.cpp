@@ -0,0 +1,38 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "HostConnection.h"
+
+TEST(HostConnection, TagsThreadIdsWithTheHost) {
+  constexpr ThreadID kMaxLinuxPid = 1u << 22;
+  ThreadID tid = MakeHostThreadId(3, kMaxLinuxPid);
+  EXPECT_EQ(GetHostIndex(tid), 3);
+  EXPECT_EQ(GetLocalThreadId(tid), kMaxLinuxPid);
+
+  ThreadID last_tid = MakeHostThreadId(kMaxHostIndex, 42);
+  EXPECT_EQ(GetHostIndex(last_tid), kMaxHostIndex);
+  EXPECT_EQ(GetLocalThreadId(last_tid), 42);
+
+  EXPECT_EQ(GetHostIndex(42), 0);
+  EXPECT_EQ(MakeHostThreadId(0, 42), 42);
+}
+
+TEST(HostConnection, AdoptsTheTimersOfTheHost) {
+  std::vector<Timer> timers(2);
+  timers[0].m_TID = 10;
+  timers[0].m_Start = 1000;
+  timers[0].m_End = 1500;
+  timers[1].m_TID = 11;
+  timers[1].m_Start = 2000;
+  timers[1].m_End = 2000;
+
+  AdoptHostTimers(2, ClockCorrection{1000, 50'000, 1.0},
+                  absl::MakeSpan(timers));
+  EXPECT_EQ(timers[0].m_TID, MakeHostThreadId(2, 10));
+  EXPECT_EQ(timers[0].m_Start, 50'000);
+  EXPECT_EQ(timers[0].m_End, 50'500);
+  EXPECT_EQ(timers[1].m_TID, MakeHostThreadId(2, 11));
+  EXPECT_EQ(timers[1].m_Start, 51'000);
+  EXPECT_EQ(timers[1].m_End, 51'000);
+}
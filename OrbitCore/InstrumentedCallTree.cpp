@@ -0,0 +1,157 @@
+#include "InstrumentedCallTree.h"
+
+#include <algorithm>
+
+void InstrumentedCallTree::AddTimer(uint32_t tid, uint64_t begin, uint64_t end,
+                                    uint8_t depth, uint64_t function_address) {
+  std::vector<PendingCall>& pending = pending_per_thread_[tid];
+  PendingCall call{begin, end, function_address, 0, 0};
+  // The callees are the last calls of pending that the call contains, with
+  // their own callees before them.
+  size_t index = pending.size();
+  while (index > 0) {
+    const PendingCall& callee = pending[index - 1];
+    if (callee.begin < begin || callee.end > end) {
+      break;
+    }
+    call.callees_ns += callee.end - callee.begin;
+    index -= callee.num_descendants + 1;
+  }
+  call.num_descendants = static_cast<uint32_t>(pending.size() - index);
+  pending.push_back(call);
+
+  if (depth == 0) {
+    AddOutermostCall(pending);
+    // The calls left before it lost their callers.
+    pending.clear();
+  } else if (pending.size() > kMaxPendingCallsPerThread) {
+    size_t num_dropped = pending.size() / 2;
+    pending.erase(pending.begin(), pending.begin() + num_dropped);
+    // The calls that lost some of their callees only keep the others.
+    for (size_t i = 0; i < pending.size(); ++i) {
+      pending[i].num_descendants =
+          std::min(pending[i].num_descendants, static_cast<uint32_t>(i));
+    }
+  }
+}
+
+void InstrumentedCallTree::AddOutermostCall(
+    const std::vector<PendingCall>& pending) {
+  absl::MutexLock lock(&mutex_);
+  // Top-down, so that the path of each call is known from its caller's.
+  stack_.clear();
+  stack_.emplace_back(pending.size() - 1, kRootId);
+  while (!stack_.empty()) {
+    auto [index, parent] = stack_.back();
+    stack_.pop_back();
+    const PendingCall& call = pending[index];
+    NodeId id = paths_.InternChild(parent, call.function_address);
+    if (stats_.size() < paths_.size()) {
+      stats_.resize(paths_.size());
+    }
+    uint64_t duration_ns = call.end - call.begin;
+    PathStats& stats = stats_[id];
+    ++stats.count;
+    stats.inclusive_ns += duration_ns;
+    stats.exclusive_ns += duration_ns - std::min(duration_ns, call.callees_ns);
+    stats.max_ns = std::max(stats.max_ns, duration_ns);
+    stats.histogram.Add(duration_ns);
+    ++num_calls_;
+    if (parent == kRootId) {
+      total_ns_ += duration_ns;
+    }
+
+    size_t first_descendant = index - call.num_descendants;
+    for (size_t callee = index; callee > first_descendant;
+         callee -= pending[callee - 1].num_descendants + 1) {
+      stack_.emplace_back(callee - 1, id);
+    }
+  }
+}
+
+InstrumentedCallTree::Node InstrumentedCallTree::MakeNode(NodeId id) const {
+  const PathStats& stats = stats_[id];
+  auto percentile = [&stats](double quantile) {
+    return std::min(stats.histogram.GetPercentileNs(quantile), stats.max_ns);
+  };
+  return Node{id,
+              paths_.GetAddress(id),
+              stats.count,
+              stats.inclusive_ns,
+              stats.exclusive_ns,
+              stats.max_ns,
+              percentile(0.5),
+              percentile(0.9),
+              percentile(0.99),
+              paths_.GetFirstChild(id) != CallstackTree::kInvalidId};
+}
+
+std::vector<InstrumentedCallTree::Node> InstrumentedCallTree::GetChildren(
+    NodeId id) const {
+  std::vector<Node> children;
+  absl::MutexLock lock(&mutex_);
+  if (id >= paths_.size()) {
+    return children;
+  }
+  for (NodeId child = paths_.GetFirstChild(id);
+       child != CallstackTree::kInvalidId;
+       child = paths_.GetNextSibling(child)) {
+    children.push_back(MakeNode(child));
+  }
+  std::sort(children.begin(), children.end(),
+            [](const Node& a, const Node& b) {
+              return a.inclusive_ns > b.inclusive_ns;
+            });
+  return children;
+}
+
+std::vector<std::vector<InstrumentedCallTree::NodeId>>
+InstrumentedCallTree::FindPaths(const absl::flat_hash_set<uint64_t>& addresses,
+                                size_t max_paths) const {
+  std::vector<std::vector<NodeId>> paths;
+  if (addresses.empty()) {
+    return paths;
+  }
+  absl::MutexLock lock(&mutex_);
+  for (NodeId id = kRootId + 1; id < paths_.size(); ++id) {
+    if (paths.size() >= max_paths) {
+      break;
+    }
+    if (!addresses.contains(paths_.GetAddress(id))) {
+      continue;
+    }
+    std::vector<NodeId>& path = paths.emplace_back();
+    for (NodeId node = id; node != kRootId; node = paths_.GetParent(node)) {
+      path.push_back(node);
+    }
+    std::reverse(path.begin(), path.end());
+  }
+  return paths;
+}
+
+uint64_t InstrumentedCallTree::GetFunctionAddress(NodeId id) const {
+  if (id == kRootId) {
+    return 0;
+  }
+  absl::MutexLock lock(&mutex_);
+  return paths_.GetAddress(id);
+}
+
+uint64_t InstrumentedCallTree::GetTotalNs() const {
+  absl::MutexLock lock(&mutex_);
+  return total_ns_;
+}
+
+uint64_t InstrumentedCallTree::GetNumCalls() const {
+  absl::MutexLock lock(&mutex_);
+  return num_calls_;
+}
+
+void InstrumentedCallTree::Clear() {
+  pending_per_thread_.clear();
+  absl::MutexLock lock(&mutex_);
+  paths_.Clear();
+  stats_.clear();
+  num_calls_ = 0;
+  total_ns_ = 0;
+}
@@ -0,0 +1,107 @@
+#ifndef ORBIT_CORE_INSTRUMENTED_CALL_TREE_H_
+#define ORBIT_CORE_INSTRUMENTED_CALL_TREE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "CallstackTree.h"
+#include "LatencyHistogram.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
+
+// Top-down call tree of the instrumented functions, merged across threads:
+// a node is a path of nested calls from an outermost instrumented call, with
+// the count, the inclusive and exclusive time and the percentiles of the
+// calls along that path.
+//
+// The timers of a thread come as the calls end, so callees before their
+// callers. They are kept per thread in post-order, each with the number of
+// its descendants, and a timer takes the ones it contains as its callees.
+// Once an outermost call (of depth 0) ends, its paths are known, and its
+// calls are added to the tree in a single pass over them. The tree thus
+// grows during the capture, as outermost calls end.
+class InstrumentedCallTree {
+ public:
+  using NodeId = CallstackTree::NodeId;
+  static constexpr NodeId kRootId = CallstackTree::kRootId;
+
+  struct Node {
+    NodeId id;
+    uint64_t function_address;
+    uint64_t count;
+    uint64_t inclusive_ns;
+    uint64_t exclusive_ns;
+    uint64_t max_ns;
+    // Of the inclusive times.
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    bool has_children;
+  };
+
+  // Only called by one thread at a time, with the timers of each thread in
+  // order of their end.
+  void AddTimer(uint32_t tid, uint64_t begin, uint64_t end, uint8_t depth,
+                uint64_t function_address);
+
+  // The children of id, by decreasing inclusive time. kRootId for the
+  // outermost calls.
+  std::vector<Node> GetChildren(NodeId id) const;
+  // The paths to the nodes of the functions in addresses, each from the
+  // outermost call to the matching one, at most max_paths of them. Scans all
+  // the nodes, so better not called on the UI thread for large trees.
+  std::vector<std::vector<NodeId>> FindPaths(
+      const absl::flat_hash_set<uint64_t>& addresses, size_t max_paths) const;
+  // Of the node id, 0 for kRootId.
+  uint64_t GetFunctionAddress(NodeId id) const;
+  // The time of all the outermost calls added.
+  uint64_t GetTotalNs() const;
+  // The number of calls added to the tree, to tell when it changed.
+  uint64_t GetNumCalls() const;
+  // Not while timers are added.
+  void Clear();
+
+  // Calls kept per thread while their outermost call runs. The oldest half
+  // is dropped beyond that, the paths of their callers being lost.
+  static constexpr size_t kMaxPendingCallsPerThread = 1 << 20;
+
+ private:
+  struct PendingCall {
+    uint64_t begin;
+    uint64_t end;
+    uint64_t function_address;
+    uint64_t callees_ns;
+    // The calls before this one in post-order that it contains.
+    uint32_t num_descendants;
+  };
+  struct PathStats {
+    uint64_t count = 0;
+    uint64_t inclusive_ns = 0;
+    uint64_t exclusive_ns = 0;
+    uint64_t max_ns = 0;
+    LatencyHistogram histogram;
+  };
+
+  // Adds the calls of the outermost call at the back of pending.
+  void AddOutermostCall(const std::vector<PendingCall>& pending)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  Node MakeNode(NodeId id) const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Only used by the thread adding the timers.
+  absl::flat_hash_map<uint32_t, std::vector<PendingCall>> pending_per_thread_;
+  // Reused by AddOutermostCall: post-order index and parent node of calls.
+  std::vector<std::pair<size_t, NodeId>> stack_;
+
+  mutable absl::Mutex mutex_;
+  CallstackTree paths_ ABSL_GUARDED_BY(mutex_);
+  // Indexed by node id. A deque, as the histograms are large to move.
+  std::deque<PathStats> stats_ ABSL_GUARDED_BY(mutex_);
+  uint64_t num_calls_ ABSL_GUARDED_BY(mutex_) = 0;
+  uint64_t total_ns_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+#endif  // ORBIT_CORE_INSTRUMENTED_CALL_TREE_H_
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "InstrumentedCallTree.h"
+
+namespace {
+constexpr uint64_t kMain = 0x100;
+constexpr uint64_t kUpdate = 0x200;
+constexpr uint64_t kDraw = 0x300;
+}  // namespace
+
+TEST(InstrumentedCallTree, MergesPathsAcrossThreads) {
+  InstrumentedCallTree tree;
+  // Thread 1: main [0, 100) calls update [10, 40), which calls draw
+  // [20, 30), then draw [50, 70). The calls come as they end.
+  tree.AddTimer(1, 20, 30, 2, kDraw);
+  tree.AddTimer(1, 10, 40, 1, kUpdate);
+  tree.AddTimer(1, 50, 70, 1, kDraw);
+  // Thread 2, interleaved: main [5, 25) calls update [10, 20).
+  tree.AddTimer(2, 10, 20, 1, kUpdate);
+  EXPECT_TRUE(tree.GetChildren(InstrumentedCallTree::kRootId).empty());
+  tree.AddTimer(2, 5, 25, 0, kMain);
+  tree.AddTimer(1, 0, 100, 0, kMain);
+
+  EXPECT_EQ(tree.GetNumCalls(), 6);
+  EXPECT_EQ(tree.GetTotalNs(), 120);
+  std::vector<InstrumentedCallTree::Node> roots =
+      tree.GetChildren(InstrumentedCallTree::kRootId);
+  ASSERT_EQ(roots.size(), 1);
+  EXPECT_EQ(roots[0].function_address, kMain);
+  EXPECT_EQ(roots[0].count, 2);
+  EXPECT_EQ(roots[0].inclusive_ns, 120);
+  EXPECT_EQ(roots[0].exclusive_ns, 120 - 30 - 20 - 10);
+  EXPECT_EQ(roots[0].max_ns, 100);
+  EXPECT_TRUE(roots[0].has_children);
+
+  // By decreasing inclusive time.
+  std::vector<InstrumentedCallTree::Node> callees =
+      tree.GetChildren(roots[0].id);
+  ASSERT_EQ(callees.size(), 2);
+  EXPECT_EQ(callees[0].function_address, kUpdate);
+  EXPECT_EQ(callees[0].count, 2);
+  EXPECT_EQ(callees[0].inclusive_ns, 40);
+  EXPECT_EQ(callees[0].exclusive_ns, 30);
+  EXPECT_EQ(callees[1].function_address, kDraw);
+  EXPECT_EQ(callees[1].inclusive_ns, 20);
+  EXPECT_FALSE(callees[1].has_children);
+
+  std::vector<InstrumentedCallTree::Node> nested =
+      tree.GetChildren(callees[0].id);
+  ASSERT_EQ(nested.size(), 1);
+  EXPECT_EQ(nested[0].function_address, kDraw);
+  EXPECT_EQ(nested[0].inclusive_ns, 10);
+  EXPECT_LE(nested[0].p99_ns, nested[0].max_ns);
+}
+
+TEST(InstrumentedCallTree, DropsCallsWhoseCallerWasLost) {
+  InstrumentedCallTree tree;
+  // The caller of this one was lost.
+  tree.AddTimer(1, 0, 10, 1, kDraw);
+  tree.AddTimer(1, 20, 30, 1, kUpdate);
+  tree.AddTimer(1, 15, 40, 0, kMain);
+
+  std::vector<InstrumentedCallTree::Node> roots =
+      tree.GetChildren(InstrumentedCallTree::kRootId);
+  ASSERT_EQ(roots.size(), 1);
+  std::vector<InstrumentedCallTree::Node> callees =
+      tree.GetChildren(roots[0].id);
+  ASSERT_EQ(callees.size(), 1);
+  EXPECT_EQ(callees[0].function_address, kUpdate);
+  EXPECT_EQ(tree.GetNumCalls(), 2);
+
+  tree.Clear();
+  EXPECT_EQ(tree.GetNumCalls(), 0);
+  EXPECT_TRUE(tree.GetChildren(InstrumentedCallTree::kRootId).empty());
+}
+
+TEST(InstrumentedCallTree, FindsPathsToFunctions) {
+  InstrumentedCallTree tree;
+  tree.AddTimer(1, 10, 20, 1, kDraw);
+  tree.AddTimer(1, 5, 30, 1, kUpdate);
+  tree.AddTimer(1, 0, 40, 0, kMain);
+  tree.AddTimer(2, 0, 10, 0, kDraw);
+
+  std::vector<std::vector<InstrumentedCallTree::NodeId>> paths =
+      tree.FindPaths({kDraw}, 10);
+  ASSERT_EQ(paths.size(), 2);
+  std::sort(paths.begin(), paths.end(),
+            [](const auto& a, const auto& b) { return a.size() < b.size(); });
+  ASSERT_EQ(paths[0].size(), 1);
+  EXPECT_EQ(tree.GetChildren(InstrumentedCallTree::kRootId).size(), 2);
+  // main, update, draw.
+  ASSERT_EQ(paths[1].size(), 3);
+  std::vector<InstrumentedCallTree::Node> callees =
+      tree.GetChildren(paths[1][1]);
+  ASSERT_EQ(callees.size(), 1);
+  EXPECT_EQ(callees[0].function_address, kDraw);
+  EXPECT_EQ(callees[0].id, paths[1][2]);
+
+  EXPECT_EQ(tree.FindPaths({kDraw}, 1).size(), 1);
+  EXPECT_TRUE(tree.FindPaths({}, 10).empty());
+}
@@ -2,57 +2,62 @@
 
 #if ORBIT_TRACING_ENABLED
 
-#include <memory>
 #include <vector>
 
-#include "CoreApp.h"
-#include "OrbitBase/Tracing.h"
-#include "PrintVar.h"
+#include "Message.h"
 #include "Utils.h"
-
-#ifdef _WIN32
-namespace orbit {
-namespace tracing {
-
-// Instanciate tracing handler. On Linux, see OrbitTracing.cpp.
-std::unique_ptr<Handler> GHandler;
-
-}  // namespace tracing
-}  // namespace orbit
-#endif
+#include "absl/base/casts.h"
 
 namespace orbit {
 namespace introspection {
 
-thread_local std::vector<Scope> scopes;
-
-Handler::Handler(LinuxTracingSession* tracing_session)
+Listener::Listener(LinuxTracingSession* tracing_session)
     : tracing_session_(tracing_session) {}
 
-void Handler::Begin(const char* name) {
-  scopes.emplace_back(Scope{Timer(), name});
-  scopes.back().timer_.Start();
+uint64_t Listener::GetNameKey(const char* name) {
+  auto [name_key, is_new_name] = name_keys_.try_emplace(name, 0);
+  if (is_new_name) {
+    name_key->second = StringHash(name);
+    tracing_session_->SendKeyAndString(name_key->second, name);
+  }
+  return name_key->second;
 }
 
-void Handler::End() {
-  Scope& scope = scopes.back();
-
-  scope.timer_.Stop();
-  scope.timer_.m_Type = Timer::INTROSPECTION;
-  scope.timer_.m_Depth = scopes.size() - 1;
-
-  uint64_t hash = StringHash(scope.name_);
-  tracing_session_->SendKeyAndString(hash, scope.name_);
-  scope.timer_.m_UserData[0] = hash;
-
-  tracing_session_->RecordTimer(std::move(scope.timer_));
-
-  scopes.pop_back();
+void Listener::OnScopes(const orbit::tracing::ScopeEvent* events,
+                        size_t count) {
+  uint32_t tid = GetCurrentThreadId();
+  std::vector<Timer> timers(count);
+  for (size_t i = 0; i < count; ++i) {
+    const orbit::tracing::ScopeEvent& event = events[i];
+    Timer& timer = timers[i];
+    timer.m_TID = tid;
+    timer.m_Type = Timer::INTROSPECTION;
+    timer.m_Depth = static_cast<uint8_t>(event.depth);
+    timer.m_SessionID = Message::GSessionID;
+    timer.m_Start = event.begin_ns;
+    timer.m_End = event.end_ns;
+    timer.m_UserData[0] = GetNameKey(event.name);
+  }
+  tracing_session_->RecordTimers(std::move(timers));
 }
 
-void Handler::Track(const char* name, int) {}
-
-void Handler::Track(const char* name, float) {}
+void Listener::OnVariables(const orbit::tracing::VariableEvent* events,
+                           size_t count) {
+  uint32_t tid = GetCurrentThreadId();
+  std::vector<Timer> timers(count);
+  for (size_t i = 0; i < count; ++i) {
+    const orbit::tracing::VariableEvent& event = events[i];
+    Timer& timer = timers[i];
+    timer.m_TID = tid;
+    timer.m_Type = Timer::VARIABLE;
+    timer.m_SessionID = Message::GSessionID;
+    timer.m_Start = event.timestamp_ns;
+    timer.m_End = event.timestamp_ns;
+    timer.m_UserData[0] = GetNameKey(event.name);
+    timer.m_UserData[1] = absl::bit_cast<uint64_t>(event.value);
+  }
+  tracing_session_->RecordTimers(std::move(timers));
+}
 
 }  // namespace introspection
 }  // namespace orbit
@@ -1,6 +1,8 @@
 #ifndef ORBIT_CORE_INTROSPECTION_H_
 #define ORBIT_CORE_INTROSPECTION_H_
 
+#include <unordered_map>
+
 #include "OrbitBase/Tracing.h"
 
 #include "LinuxTracingSession.h"
@@ -12,22 +14,25 @@
 namespace orbit {
 namespace introspection {
 
-class Handler : public orbit::tracing::Handler {
+// Records the scopes of Orbit itself as INTROSPECTION timers of the session,
+// named by the key of their name, and its tracked variables as VARIABLE
+// timers.
+class Listener : public orbit::tracing::Listener {
  public:
-  explicit Handler(LinuxTracingSession* tracing_session);
+  explicit Listener(LinuxTracingSession* tracing_session);
 
-  void Begin(const char* name) final;
-  void End() final;
-  void Track(const char* name, int) final;
-  void Track(const char* name, float) final;
+  void OnScopes(const orbit::tracing::ScopeEvent* events,
+                size_t count) final;
+  void OnVariables(const orbit::tracing::VariableEvent* events,
+                   size_t count) final;
 
  private:
-  LinuxTracingSession* tracing_session_;
-};
+  uint64_t GetNameKey(const char* name);
 
-struct Scope {
-  Timer timer_;
-  std::string name_;
+  LinuxTracingSession* tracing_session_;
+  // By the address of the name, a literal, so that each is hashed and sent
+  // once.
+  std::unordered_map<const char*, uint64_t> name_keys_;
 };
 
 }  // namespace introspection
@@ -0,0 +1,104 @@
+#include "KernelSymbols.h"
+
+#include <OrbitBase/Logging.h>
+
+#include <algorithm>
+#include <charconv>
+
+#include "ProcFsReader.h"
+
+namespace {
+// The next field of line after *begin, separated by spaces or tabs.
+std::string_view NextField(std::string_view line, size_t* begin) {
+  constexpr std::string_view kSeparators = " \t";
+  size_t field_begin = std::min(line.find_first_not_of(kSeparators, *begin),
+                                line.size());
+  size_t field_end =
+      std::min(line.find_first_of(kSeparators, field_begin), line.size());
+  *begin = field_end;
+  return line.substr(field_begin, field_end - field_begin);
+}
+}  // namespace
+
+KernelSymbols KernelSymbols::Parse(std::string_view kallsyms) {
+  KernelSymbols kernel_symbols;
+  // Each line is "address type name", followed by "\t[module]" for the
+  // symbols of modules.
+  size_t line_begin = 0;
+  while (line_begin < kallsyms.size()) {
+    size_t line_end =
+        std::min(kallsyms.find('\n', line_begin), kallsyms.size());
+    std::string_view line =
+        kallsyms.substr(line_begin, line_end - line_begin);
+    line_begin = line_end + 1;
+
+    size_t field_begin = 0;
+    std::string_view address_field = NextField(line, &field_begin);
+    std::string_view type = NextField(line, &field_begin);
+    std::string_view name = NextField(line, &field_begin);
+    std::string_view module = NextField(line, &field_begin);
+    if (name.empty() || (type != "t" && type != "T")) {
+      continue;
+    }
+    uint64_t address = 0;
+    auto [end, error] =
+        std::from_chars(address_field.data(),
+                        address_field.data() + address_field.size(), address,
+                        16);
+    if (error != std::errc() || address == 0) {
+      continue;
+    }
+
+    Symbol symbol;
+    symbol.address = address;
+    symbol.name_offset = kernel_symbols.names_.size();
+    kernel_symbols.names_.append(name);
+    if (!module.empty()) {
+      kernel_symbols.names_.append(" ");
+      kernel_symbols.names_.append(module);
+    }
+    symbol.name_size = kernel_symbols.names_.size() - symbol.name_offset;
+    kernel_symbols.symbols_.push_back(symbol);
+  }
+
+  std::stable_sort(kernel_symbols.symbols_.begin(),
+                   kernel_symbols.symbols_.end(),
+                   [](const Symbol& lhs, const Symbol& rhs) {
+                     return lhs.address < rhs.address;
+                   });
+  kernel_symbols.symbols_.shrink_to_fit();
+  return kernel_symbols;
+}
+
+const KernelSymbols& KernelSymbols::Get() {
+  static const KernelSymbols kernel_symbols = [] {
+    ProcFsReader reader;
+    std::optional<std::string_view> kallsyms =
+        reader.ReadFile("/proc/kallsyms");
+    if (!kallsyms.has_value()) {
+      ERROR("Could not read /proc/kallsyms: kernel frames stay unnamed");
+      return KernelSymbols{};
+    }
+    KernelSymbols symbols = Parse(*kallsyms);
+    if (symbols.IsEmpty()) {
+      ERROR("No address in /proc/kallsyms (kernel.kptr_restrict?): kernel "
+            "frames stay unnamed");
+    } else {
+      LOG("Loaded %lu kernel symbols", symbols.symbols_.size());
+    }
+    return symbols;
+  }();
+  return kernel_symbols;
+}
+
+const KernelSymbols::Symbol* KernelSymbols::Find(uint64_t address) const {
+  // Most addresses looked up are of user space, way below.
+  if (symbols_.empty() || address < symbols_.front().address) {
+    return nullptr;
+  }
+  auto it = std::upper_bound(symbols_.begin(), symbols_.end(), address,
+                             [](uint64_t address, const Symbol& symbol) {
+                               return address < symbol.address;
+                             });
+  return &*(it - 1);
+}
@@ -0,0 +1,47 @@
+#ifndef ORBIT_CORE_KERNEL_SYMBOLS_H_
+#define ORBIT_CORE_KERNEL_SYMBOLS_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The functions of the kernel and of its modules, from /proc/kallsyms, in a
+// flat table sorted by address, to name the kernel frames of the callstacks
+// on the service: the client can't read the kernel symbols of the target's
+// machine.
+class KernelSymbols {
+ public:
+  struct Symbol {
+    uint64_t address;
+    uint32_t name_offset;
+    uint32_t name_size;
+  };
+
+  // Only keeps the text symbols of the content of /proc/kallsyms. Those of
+  // modules are named "function [module]", like perf does.
+  static KernelSymbols Parse(std::string_view kallsyms);
+
+  // Read from /proc/kallsyms on the first call: OrbitService calls it at
+  // startup. Empty if the file can't be read, or if it has no addresses
+  // because of kernel.kptr_restrict.
+  static const KernelSymbols& Get();
+
+  bool IsEmpty() const { return symbols_.empty(); }
+
+  // The function containing address, i.e., the last symbol at or before it.
+  // nullptr for addresses below the kernel's. As kallsyms has no sizes, the
+  // addresses past the last function still get it.
+  const Symbol* Find(uint64_t address) const;
+  std::string_view GetName(const Symbol& symbol) const {
+    return std::string_view(names_).substr(symbol.name_offset,
+                                           symbol.name_size);
+  }
+
+ private:
+  std::vector<Symbol> symbols_;
+  // The names of all symbols, one after the other.
+  std::string names_;
+};
+
+#endif  // ORBIT_CORE_KERNEL_SYMBOLS_H_
@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+
+#include "KernelSymbols.h"
+
+TEST(KernelSymbols, FindsTheFunctionOfAnAddress) {
+  KernelSymbols kernel_symbols = KernelSymbols::Parse(
+      "ffffffff81000100 T second\n"
+      "ffffffff81000000 T first\n"
+      "ffffffff81200000 D some_data\n"
+      "ffffffffc0001000 t module_function\t[some_module]\n");
+  ASSERT_FALSE(kernel_symbols.IsEmpty());
+
+  EXPECT_EQ(kernel_symbols.Find(0x7f0000001000), nullptr);
+  EXPECT_EQ(kernel_symbols.Find(0xffffffff80ffffff), nullptr);
+
+  const KernelSymbols::Symbol* symbol =
+      kernel_symbols.Find(0xffffffff81000000);
+  ASSERT_NE(symbol, nullptr);
+  EXPECT_EQ(symbol->address, 0xffffffff81000000);
+  EXPECT_EQ(kernel_symbols.GetName(*symbol), "first");
+
+  symbol = kernel_symbols.Find(0xffffffff81000180);
+  ASSERT_NE(symbol, nullptr);
+  EXPECT_EQ(symbol->address, 0xffffffff81000100);
+  EXPECT_EQ(kernel_symbols.GetName(*symbol), "second");
+
+  // Data symbols are not functions.
+  symbol = kernel_symbols.Find(0xffffffff81200010);
+  ASSERT_NE(symbol, nullptr);
+  EXPECT_EQ(kernel_symbols.GetName(*symbol), "second");
+
+  symbol = kernel_symbols.Find(0xffffffffc0001040);
+  ASSERT_NE(symbol, nullptr);
+  EXPECT_EQ(kernel_symbols.GetName(*symbol), "module_function [some_module]");
+}
+
+TEST(KernelSymbols, IsEmptyWithoutAddresses) {
+  // What unprivileged users read with kernel.kptr_restrict.
+  KernelSymbols kernel_symbols = KernelSymbols::Parse(
+      "0000000000000000 T first\n"
+      "0000000000000000 T second\n");
+  EXPECT_TRUE(kernel_symbols.IsEmpty());
+  EXPECT_EQ(kernel_symbols.Find(0xffffffff81000000), nullptr);
+}
+
+TEST(KernelSymbols, LoadsProcKallsyms) {
+  // Whether it has addresses depends on the privileges of the test.
+  const KernelSymbols& kernel_symbols = KernelSymbols::Get();
+  EXPECT_EQ(&kernel_symbols, &KernelSymbols::Get());
+}
@@ -0,0 +1,45 @@
+#include "KeyAndString.h"
+
+#include <cstring>
+
+std::string EncodeKeysAndStrings(
+    const std::vector<KeyAndString>& keys_and_strings) {
+  std::string output;
+  for (const KeyAndString& key_and_string : keys_and_strings) {
+    auto size = static_cast<uint32_t>(key_and_string.str.size());
+    output.append(reinterpret_cast<const char*>(&key_and_string.key),
+                  sizeof(key_and_string.key));
+    output.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    output.append(key_and_string.str);
+  }
+  return output;
+}
+
+bool DecodeKeysAndStrings(const void* data, size_t size,
+                          std::vector<KeyAndString>* keys_and_strings) {
+  const char* bytes = static_cast<const char*>(data);
+  std::vector<KeyAndString> decoded;
+  size_t offset = 0;
+  while (offset < size) {
+    KeyAndString key_and_string;
+    uint32_t string_size;
+    if (size - offset < sizeof(key_and_string.key) + sizeof(string_size)) {
+      return false;
+    }
+    memcpy(&key_and_string.key, bytes + offset, sizeof(key_and_string.key));
+    offset += sizeof(key_and_string.key);
+    memcpy(&string_size, bytes + offset, sizeof(string_size));
+    offset += sizeof(string_size);
+    if (size - offset < string_size) {
+      return false;
+    }
+    key_and_string.str.assign(bytes + offset, string_size);
+    offset += string_size;
+    decoded.push_back(std::move(key_and_string));
+  }
+
+  keys_and_strings->insert(keys_and_strings->end(),
+                           std::make_move_iterator(decoded.begin()),
+                           std::make_move_iterator(decoded.end()));
+  return true;
+}
@@ -1,7 +1,10 @@
 #ifndef ORBIT_CORE_KEY_AND_STRING_H_
 #define ORBIT_CORE_KEY_AND_STRING_H_
 
+#include <cstddef>
 #include <string>
+#include <vector>
+
 #include "Serialization.h"
 #include "SerializationMacros.h"
 
@@ -17,4 +20,15 @@ ORBIT_SERIALIZE(KeyAndString, 0) {
   ORBIT_NVP_VAL(0, str);
 }
 
+// Payload of Msg_KeysAndStrings, which carries all the strings the service
+// discovered since its previous flush: for each string, its key, its size as a
+// uint32_t and its characters.
+std::string EncodeKeysAndStrings(
+    const std::vector<KeyAndString>& keys_and_strings);
+
+// Appends the decoded strings to keys_and_strings. Returns false, and leaves
+// keys_and_strings unchanged, if data is not a valid encoding.
+bool DecodeKeysAndStrings(const void* data, size_t size,
+                          std::vector<KeyAndString>* keys_and_strings);
+
 #endif 
@@ -0,0 +1,36 @@
+#include "KeyAndString.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+TEST(KeyAndString, EncodesAndDecodes) {
+  std::vector<KeyAndString> keys_and_strings = {
+      {1, "one"}, {0xffffffffffffffff, ""}, {3, std::string("a\0b", 3)}};
+  std::string data = EncodeKeysAndStrings(keys_and_strings);
+
+  std::vector<KeyAndString> decoded = {{7, "seven"}};
+  ASSERT_TRUE(DecodeKeysAndStrings(data.data(), data.size(), &decoded));
+  ASSERT_EQ(decoded.size(), 4);
+  EXPECT_EQ(decoded[0].key, 7);
+  for (size_t i = 0; i < keys_and_strings.size(); ++i) {
+    EXPECT_EQ(decoded[i + 1].key, keys_and_strings[i].key);
+    EXPECT_EQ(decoded[i + 1].str, keys_and_strings[i].str);
+  }
+
+  EXPECT_TRUE(DecodeKeysAndStrings(nullptr, 0, &decoded));
+  EXPECT_EQ(decoded.size(), 4);
+}
+
+TEST(KeyAndString, RejectsTruncatedData) {
+  std::string data = EncodeKeysAndStrings({{1, "one"}, {2, "two"}});
+  for (size_t size = 1; size < data.size(); ++size) {
+    if (size == data.size() / 2) {
+      continue;
+    }
+    std::vector<KeyAndString> decoded;
+    EXPECT_FALSE(DecodeKeysAndStrings(data.data(), size, &decoded)) << size;
+    EXPECT_TRUE(decoded.empty());
+  }
+}
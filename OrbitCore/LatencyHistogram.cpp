@@ -0,0 +1,81 @@
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Serialization.h"
+
+#ifdef _WIN32
+#include <intrin.h>
+#endif
+
+namespace {
+// Position of the highest bit set of a non-zero value.
+uint32_t GetHighestBit(uint64_t value) {
+#ifdef _WIN32
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return index;
+#else
+  return 63 - __builtin_clzll(value);
+#endif
+}
+}  // namespace
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    uint64_t count = uint64_t{counts_[i]} + other.counts_[i];
+    counts_[i] = static_cast<uint32_t>(std::min<uint64_t>(count, UINT32_MAX));
+  }
+}
+
+uint64_t LatencyHistogram::GetTotalCount() const {
+  uint64_t total = 0;
+  for (uint32_t count : counts_) {
+    total += count;
+  }
+  return total;
+}
+
+uint64_t LatencyHistogram::GetPercentileNs(double quantile) const {
+  uint64_t total = GetTotalCount();
+  if (total == 0) return 0;
+  // The rank of the duration, from 1.
+  double clamped = std::clamp(quantile, 0.0, 1.0);
+  auto rank = static_cast<uint64_t>(std::ceil(clamped * (double)total));
+  rank = std::max<uint64_t>(rank, 1);
+
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    cumulative += counts_[i];
+    if (cumulative >= rank) {
+      uint64_t lower = GetBucketLowerBoundNs(i);
+      return lower + (GetBucketUpperBoundNs(i) - lower) / 2;
+    }
+  }
+  return GetBucketLowerBoundNs(kNumBuckets - 1);
+}
+
+size_t LatencyHistogram::GetBucketIndex(uint64_t duration_ns) {
+  if (duration_ns < kNumSubBuckets) return duration_ns;
+  if (duration_ns >> kMaxExponent != 0) return kNumBuckets - 1;
+  // The highest bit set is at least kSubBucketBits.
+  uint32_t shift = GetHighestBit(duration_ns) - kSubBucketBits;
+  uint64_t sub_bucket = (duration_ns >> shift) - kNumSubBuckets;
+  return (shift + 1) * kNumSubBuckets + sub_bucket;
+}
+
+uint64_t LatencyHistogram::GetBucketLowerBoundNs(size_t index) {
+  if (index < kNumSubBuckets) return index;
+  uint64_t shift = index / kNumSubBuckets - 1;
+  uint64_t sub_bucket = index % kNumSubBuckets;
+  return (kNumSubBuckets + sub_bucket) << shift;
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBoundNs(size_t index) {
+  if (index < kNumSubBuckets) return index + 1;
+  uint64_t shift = index / kNumSubBuckets - 1;
+  return GetBucketLowerBoundNs(index) + (uint64_t{1} << shift);
+}
+
+ORBIT_SERIALIZE(LatencyHistogram, 0) { ORBIT_NVP_VAL(0, counts_); }
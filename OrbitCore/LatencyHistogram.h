@@ -0,0 +1,48 @@
+#ifndef ORBIT_CORE_LATENCY_HISTOGRAM_H_
+#define ORBIT_CORE_LATENCY_HISTOGRAM_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "SerializationMacros.h"
+
+// Counts of durations in buckets whose width grows with the duration, as in
+// HDR histograms: durations below kNumSubBuckets ns have a bucket each, and
+// each power of two above is split in kNumSubBuckets buckets, so that a
+// percentile is within 1/kNumSubBuckets of the exact value. Durations of
+// 2^kMaxExponent ns (about 18 minutes) and more are counted in the last
+// bucket. It is plain data, so that FunctionStats can be reset, copied and
+// sent as is, and adding a duration is a single increment.
+class LatencyHistogram {
+ public:
+  static constexpr uint32_t kSubBucketBits = 3;
+  static constexpr uint32_t kNumSubBuckets = 1 << kSubBucketBits;
+  static constexpr uint32_t kMaxExponent = 40;
+  static constexpr size_t kNumBuckets =
+      kNumSubBuckets * (kMaxExponent - kSubBucketBits + 1);
+
+  void Add(uint64_t duration_ns) {
+    uint32_t& count = counts_[GetBucketIndex(duration_ns)];
+    // Saturates rather than wrapping around.
+    if (count != UINT32_MAX) ++count;
+  }
+  void Merge(const LatencyHistogram& other);
+
+  uint64_t GetTotalCount() const;
+  uint32_t GetBucketCount(size_t index) const { return counts_[index]; }
+  // The duration that a_Quantile, in [0, 1], of the durations don't exceed,
+  // as the middle of its bucket. 0 if the histogram is empty.
+  uint64_t GetPercentileNs(double quantile) const;
+
+  static size_t GetBucketIndex(uint64_t duration_ns);
+  // The durations of the bucket at index are in [lower bound, upper bound).
+  static uint64_t GetBucketLowerBoundNs(size_t index);
+  static uint64_t GetBucketUpperBoundNs(size_t index);
+
+  ORBIT_SERIALIZABLE;
+
+ private:
+  uint32_t counts_[kNumBuckets] = {};
+};
+
+#endif  // ORBIT_CORE_LATENCY_HISTOGRAM_H_
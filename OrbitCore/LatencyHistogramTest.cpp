@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+
+#include "LatencyHistogram.h"
+
+TEST(LatencyHistogram, BucketsCoverAllDurations) {
+  EXPECT_EQ(LatencyHistogram::GetBucketIndex(0), 0);
+  EXPECT_EQ(LatencyHistogram::GetBucketLowerBoundNs(0), 0);
+  for (size_t i = 1; i < LatencyHistogram::kNumBuckets; ++i) {
+    uint64_t lower = LatencyHistogram::GetBucketLowerBoundNs(i);
+    EXPECT_EQ(lower, LatencyHistogram::GetBucketUpperBoundNs(i - 1));
+    EXPECT_EQ(LatencyHistogram::GetBucketIndex(lower), i);
+    EXPECT_EQ(LatencyHistogram::GetBucketIndex(lower - 1), i - 1);
+  }
+  EXPECT_EQ(LatencyHistogram::GetBucketIndex(UINT64_MAX),
+            LatencyHistogram::kNumBuckets - 1);
+}
+
+TEST(LatencyHistogram, BucketsAreNarrowRelativeToTheirDurations) {
+  for (size_t i = LatencyHistogram::kNumSubBuckets;
+       i < LatencyHistogram::kNumBuckets; ++i) {
+    uint64_t lower = LatencyHistogram::GetBucketLowerBoundNs(i);
+    uint64_t width = LatencyHistogram::GetBucketUpperBoundNs(i) - lower;
+    EXPECT_LE(width * LatencyHistogram::kNumSubBuckets, lower);
+  }
+}
+
+TEST(LatencyHistogram, Percentiles) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(histogram.GetPercentileNs(0.5), 0);
+
+  // 1 to 1000 us.
+  for (uint64_t i = 1; i <= 1000; ++i) {
+    histogram.Add(i * 1000);
+  }
+  EXPECT_EQ(histogram.GetTotalCount(), 1000);
+  for (double quantile : {0.5, 0.9, 0.99, 0.999}) {
+    double expected = quantile * 1000 * 1000;
+    double actual = histogram.GetPercentileNs(quantile);
+    EXPECT_NEAR(actual, expected,
+                expected / LatencyHistogram::kNumSubBuckets);
+  }
+}
+
+TEST(LatencyHistogram, MergeMatchesAddingEachDuration) {
+  LatencyHistogram expected;
+  LatencyHistogram first;
+  LatencyHistogram second;
+  for (uint64_t duration : {3, 70, 5000, 5001, 123456}) {
+    expected.Add(duration);
+    (duration % 2 == 0 ? first : second).Add(duration);
+  }
+  first.Merge(second);
+  for (size_t i = 0; i < LatencyHistogram::kNumBuckets; ++i) {
+    EXPECT_EQ(first.GetBucketCount(i), expected.GetBucketCount(i));
+  }
+}
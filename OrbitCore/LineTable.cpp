@@ -0,0 +1,46 @@
+#include "LineTable.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+bool IsSameLine(const LineTable::Row& a, const LineTable::Row& b) {
+  return a.file_id == b.file_id && a.line == b.line;
+}
+}  // namespace
+
+void LineTable::Build(std::vector<Row> rows, std::vector<std::string> files) {
+  std::stable_sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+    return a.address < b.address;
+  });
+
+  rows_.clear();
+  for (const Row& row : rows) {
+    if (!rows_.empty() && rows_.back().address == row.address) {
+      rows_.pop_back();
+    }
+    if (!rows_.empty() && IsSameLine(rows_.back(), row)) {
+      continue;
+    }
+    rows_.push_back(row);
+  }
+  rows_.shrink_to_fit();
+  files_ = std::move(files);
+}
+
+void LineTable::Clear() {
+  rows_.clear();
+  rows_.shrink_to_fit();
+  files_.clear();
+}
+
+const LineTable::Row* LineTable::Find(uint64_t address) const {
+  auto it = std::upper_bound(
+      rows_.begin(), rows_.end(), address,
+      [](uint64_t address, const Row& row) { return address < row.address; });
+  if (it == rows_.begin()) {
+    return nullptr;
+  }
+  --it;
+  return it->line != 0 ? &*it : nullptr;
+}
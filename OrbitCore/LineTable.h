@@ -0,0 +1,40 @@
+#ifndef ORBIT_CORE_LINE_TABLE_H_
+#define ORBIT_CORE_LINE_TABLE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Source lines of the code of a module, decoded once from its debug info so
+// that each query is a binary search. A row gives the line of the code from
+// its address up to the address of the next row. Rows following each other
+// with the same line are merged, which leaves a few rows per line.
+class LineTable {
+ public:
+  struct Row {
+    uint64_t address;
+    uint32_t file_id;
+    // 0 for code of no line, e.g. past the end of a sequence of rows.
+    uint32_t line;
+  };
+
+  // Replaces the rows, given in any order. file_ids are indices in files. Of
+  // rows with the same address, the last one is kept.
+  void Build(std::vector<Row> rows, std::vector<std::string> files);
+  void Clear();
+
+  // Row of the line of the code at address, nullptr if there is none.
+  const Row* Find(uint64_t address) const;
+  const std::string& GetFile(uint32_t file_id) const {
+    return files_[file_id];
+  }
+
+  size_t GetNumRows() const { return rows_.size(); }
+  bool empty() const { return rows_.empty(); }
+
+ private:
+  std::vector<Row> rows_;
+  std::vector<std::string> files_;
+};
+
+#endif  // ORBIT_CORE_LINE_TABLE_H_
@@ -0,0 +1,41 @@
+#include <gtest/gtest.h>
+
+#include "LineTable.h"
+
+TEST(LineTable, FindsLineOfLatestRowAtOrBeforeAddress) {
+  LineTable table;
+  table.Build({{0x120, 1, 12}, {0x100, 0, 10}, {0x110, 0, 11}, {0x130, 0, 0}},
+              {"a.cpp", "b.h"});
+
+  EXPECT_EQ(table.Find(0xff), nullptr);
+  const LineTable::Row* row = table.Find(0x100);
+  ASSERT_NE(row, nullptr);
+  EXPECT_EQ(table.GetFile(row->file_id), "a.cpp");
+  EXPECT_EQ(row->line, 10);
+  row = table.Find(0x11f);
+  ASSERT_NE(row, nullptr);
+  EXPECT_EQ(row->line, 11);
+  row = table.Find(0x12f);
+  ASSERT_NE(row, nullptr);
+  EXPECT_EQ(table.GetFile(row->file_id), "b.h");
+  EXPECT_EQ(row->line, 12);
+  EXPECT_EQ(table.Find(0x130), nullptr);
+  EXPECT_EQ(table.Find(0x1000), nullptr);
+}
+
+TEST(LineTable, MergesRowsOfTheSameLine) {
+  LineTable table;
+  table.Build({{0x100, 0, 10}, {0x104, 0, 10}, {0x108, 0, 11}, {0x10c, 0, 11}},
+              {"a.cpp"});
+  EXPECT_EQ(table.GetNumRows(), 2);
+  ASSERT_NE(table.Find(0x106), nullptr);
+  EXPECT_EQ(table.Find(0x106)->line, 10);
+}
+
+TEST(LineTable, KeepsLastRowOfAnAddress) {
+  // The end of a sequence and the start of the next one.
+  LineTable table;
+  table.Build({{0x100, 0, 10}, {0x110, 0, 0}, {0x110, 0, 20}}, {"a.cpp"});
+  ASSERT_NE(table.Find(0x110), nullptr);
+  EXPECT_EQ(table.Find(0x110)->line, 20);
+}
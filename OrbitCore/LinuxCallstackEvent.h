@@ -24,4 +24,12 @@ class LinuxCallstackEvent {
   void Clear();
 
   ORBIT_SERIALIZABLE;
+};
+
+//-----------------------------------------------------------------------------
+// A callstack at which a thread blocked, m_time being when it was switched
+// out, and for how long it stayed off the cores.
+struct OffCpuCallstackEvent {
+  LinuxCallstackEvent m_Event;
+  uint64_t m_DurationNs = 0;
 };
\ No newline at end of file
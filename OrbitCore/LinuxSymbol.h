@@ -3,6 +3,7 @@
 //-----------------------------------
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 #include "Serialization.h"
@@ -26,3 +27,23 @@ ORBIT_SERIALIZE(LinuxSymbol, 0) {
   ORBIT_NVP_VAL(0, m_Line);
   ORBIT_NVP_VAL(0, m_Address);
 }
+
+//-----------------------------------------------------------------------------
+// The payload of Msg_KernelFrameSymbols is an array of these: the service
+// names the kernel frames of the callstacks with KernelSymbols, and sends the
+// names themselves as strings, in Msg_KeysAndStrings.
+struct KernelFrameSymbol {
+  uint64_t address;
+  uint64_t function_address;
+  uint64_t name_key;
+};
+
+// The payload of Msg_ThreadNames is an array of these, sorted by time: the
+// thread is named by the string of name_key, sent before, from time on. The
+// names are only sent when they change, so that short-lived threads keep the
+// name they had.
+struct ThreadNameKey {
+  uint64_t time;
+  uint32_t thread_id;
+  uint64_t name_key;
+};
@@ -0,0 +1,267 @@
+#include <gtest/gtest.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CoreActivity.h"
+#include "FlatCallstacks.h"
+#include "KeyAndString.h"
+#include "LatencyHistogram.h"
+#include "LinuxTracingHandler.h"
+#include "LinuxTracingSession.h"
+#include "OrbitProcess.h"
+#include "Profiling.h"
+#include "TcpServer.h"
+#include "TimerBatch.h"
+#include "Utils.h"
+#include "absl/base/casts.h"
+#include "absl/strings/str_format.h"
+
+// End-to-end benchmark of the capture pipeline of OrbitService: OrbitTest
+// workloads are traced by a LinuxTracingHandler, whose session is drained and
+// encoded like ConnectionManager does, but into a null sink rather than sent
+// to the client. Needs the permissions of OrbitService, and is disabled by
+// default, run with:
+//   sudo OrbitCoreTests --gtest_also_run_disabled_tests \
+//       --gtest_filter='LinuxTracingBenchmark.*'
+
+namespace {
+struct Workload {
+  std::string name;
+  uint32_t num_threads;
+  uint32_t recurse_depth;
+  uint32_t sleep_us;
+  uint32_t mmaps_per_s;
+};
+
+constexpr std::chrono::seconds kCaptureDuration{5};
+
+// Runs OrbitTest with the parameters of a workload, until destroyed: OrbitTest
+// exits once its standard input is closed.
+class OrbitTestProcess {
+ public:
+  explicit OrbitTestProcess(const Workload& workload);
+  ~OrbitTestProcess();
+
+  OrbitTestProcess(const OrbitTestProcess&) = delete;
+  OrbitTestProcess& operator=(const OrbitTestProcess&) = delete;
+
+  pid_t GetPid() const { return pid_; }
+
+ private:
+  pid_t pid_ = -1;
+  int stdin_fd_ = -1;
+};
+
+OrbitTestProcess::OrbitTestProcess(const Workload& workload) {
+  std::vector<std::string> args = {
+      "OrbitTest", std::to_string(workload.num_threads),
+      std::to_string(workload.recurse_depth), std::to_string(workload.sleep_us),
+      std::to_string(workload.mmaps_per_s)};
+  int fds[2];
+  if (pipe(fds) != 0) return;
+
+  pid_ = fork();
+  if (pid_ == 0) {
+    dup2(fds[0], STDIN_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    execl(ORBIT_TEST_PATH, args[0].c_str(), args[1].c_str(), args[2].c_str(),
+          args[3].c_str(), args[4].c_str(), nullptr);
+    _exit(1);
+  }
+  close(fds[0]);
+  stdin_fd_ = fds[1];
+}
+
+OrbitTestProcess::~OrbitTestProcess() {
+  if (stdin_fd_ >= 0) close(stdin_fd_);
+  if (pid_ > 0) waitpid(pid_, nullptr, 0);
+}
+
+// Reads the events of a session and encodes them like
+// ConnectionManager::SendRecordedEvents, then drops them. The latency of an
+// event is from its end to when it is read.
+class NullSink {
+ public:
+  explicit NullSink(LinuxTracingSession* session) : session_(session) {}
+
+  // Until stop is set and the reader is woken up.
+  void Run(const std::atomic<bool>* stop);
+
+  uint64_t GetNumEvents() const { return num_events_; }
+  uint64_t GetNumBytes() const { return num_bytes_; }
+  // Events lost by the tracer, from its "lost/s" statistic.
+  double GetNumLostEvents() const { return num_lost_events_; }
+  const LatencyHistogram& GetLatency() const { return latency_; }
+
+ private:
+  void Drain();
+  void Count(uint64_t time_ns, uint64_t now_ns) {
+    ++num_events_;
+    latency_.Add(now_ns > time_ns ? now_ns - time_ns : 0);
+  }
+
+  LinuxTracingSession* session_;
+  uint64_t num_events_ = 0;
+  uint64_t num_bytes_ = 0;
+  double num_lost_events_ = 0;
+  LatencyHistogram latency_;
+};
+
+void NullSink::Run(const std::atomic<bool>* stop) {
+  while (!*stop) {
+    session_->WaitForFlush();
+    Drain();
+  }
+  Drain();
+}
+
+void NullSink::Drain() {
+  static const uint64_t kLostKey = StringHash("lost/s");
+  uint64_t now_ns = OrbitTicks();
+
+  std::vector<KeyAndString> keys_and_strings;
+  if (session_->ReadAllKeysAndStrings(&keys_and_strings)) {
+    num_bytes_ += EncodeKeysAndStrings(keys_and_strings).size();
+  }
+
+  std::vector<Timer> timers;
+  if (session_->ReadAllTimers(&timers)) {
+    num_bytes_ += EncodeTimerBatch(timers).size();
+    for (const Timer& timer : timers) {
+      if (timer.m_Type != Timer::SERVICE_STATS) {
+        Count(timer.m_End, now_ns);
+      } else if (timer.m_UserData[0] == kLostKey) {
+        double lost_per_s = absl::bit_cast<double>(timer.m_UserData[1]);
+        num_lost_events_ += lost_per_s * (timer.m_End - timer.m_Start) / 1e9;
+      }
+    }
+  }
+
+  std::vector<LinuxCallstackEvent> callstacks;
+  if (session_->ReadAllCallstacks(&callstacks)) {
+    num_bytes_ += EncodeFlatCallstacks(callstacks).size();
+    for (const LinuxCallstackEvent& event : callstacks) {
+      Count(event.m_time, now_ns);
+    }
+  }
+
+  std::vector<CallstackEvent> hashed_callstacks;
+  if (session_->ReadAllHashedCallstacks(&hashed_callstacks)) {
+    num_bytes_ += EncodeFlatHashedCallstacks(hashed_callstacks).size();
+    for (const CallstackEvent& event : hashed_callstacks) {
+      Count(event.m_Time, now_ns);
+    }
+  }
+
+  std::vector<OffCpuCallstackEvent> off_cpu_callstacks;
+  if (session_->ReadAllOffCpuCallstacks(&off_cpu_callstacks)) {
+    num_bytes_ += EncodeFlatOffCpuCallstacks(off_cpu_callstacks).size();
+    for (const OffCpuCallstackEvent& event : off_cpu_callstacks) {
+      Count(event.m_Event.m_time, now_ns);
+    }
+  }
+
+  std::vector<CoreActivity> core_activities;
+  if (session_->ReadAllCoreActivities(&core_activities)) {
+    num_bytes_ += EncodeCoreActivities(core_activities).size();
+    for (const CoreActivity& activity : core_activities) {
+      Count(activity.end_time, now_ns);
+    }
+  }
+
+  std::vector<ThreadStateChange> thread_state_changes;
+  if (session_->ReadAllThreadStateChanges(&thread_state_changes)) {
+    num_bytes_ += thread_state_changes.size() * sizeof(ThreadStateChange);
+    for (const ThreadStateChange& change : thread_state_changes) {
+      Count(change.time, now_ns);
+    }
+  }
+}
+
+uint64_t GetCpuTimeNs(const rusage& usage) {
+  auto to_ns = [](const timeval& time) {
+    return time.tv_sec * 1'000'000'000ull + time.tv_usec * 1'000ull;
+  };
+  return to_ns(usage.ru_utime) + to_ns(usage.ru_stime);
+}
+
+void RunWorkload(const Workload& workload) {
+  OrbitTestProcess process(workload);
+  ASSERT_GT(process.GetPid(), 0);
+  // Lets OrbitTest start its threads.
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  Process target;
+  target.SetID(process.GetPid());
+  std::map<uint64_t, Function*> no_selected_functions;
+  uint64_t num_context_switches = 0;
+  LinuxTracingSession session(nullptr);
+  LinuxTracingHandler handler(&session, &target, &no_selected_functions, {},
+                              &num_context_switches);
+  NullSink sink(&session);
+  std::atomic<bool> stop = false;
+  std::thread sink_thread([&sink, &stop] { sink.Run(&stop); });
+
+  // The tracer, the handler and the sink all run in this process.
+  rusage usage_begin;
+  getrusage(RUSAGE_SELF, &usage_begin);
+  uint64_t begin_ns = OrbitTicks();
+  handler.Start();
+  std::this_thread::sleep_for(kCaptureDuration);
+  handler.Stop();
+  stop = true;
+  session.WakeUpReader();
+  sink_thread.join();
+  uint64_t duration_ns = OrbitTicks() - begin_ns;
+  rusage usage_end;
+  getrusage(RUSAGE_SELF, &usage_end);
+
+  double duration_s = duration_ns / 1e9;
+  const LatencyHistogram& latency = sink.GetLatency();
+  absl::PrintF(
+      "%-16s %12.0f %8.2f %10.0f %10u %7.1f %9.2f %9.2f %9.2f\n",
+      workload.name, sink.GetNumEvents() / duration_s,
+      sink.GetNumBytes() / duration_s / 1e6, sink.GetNumLostEvents(),
+      session.GetLaneStats().num_dropped,
+      100.0 * (GetCpuTimeNs(usage_end) - GetCpuTimeNs(usage_begin)) /
+          duration_ns,
+      latency.GetPercentileNs(0.5) / 1e6, latency.GetPercentileNs(0.99) / 1e6,
+      latency.GetPercentileNs(1.0) / 1e6);
+  EXPECT_GT(sink.GetNumEvents(), 0);
+}
+}  // namespace
+
+TEST(LinuxTracingBenchmark, DISABLED_OrbitTestWorkloads) {
+  const std::vector<Workload> workloads = {
+      {"idle", 1, 1, 100'000, 0},
+      {"default", 10, 10, 100'000, 0},
+      {"high call rate", 10, 10, 100, 0},
+      {"many threads", 100, 10, 1'000, 0},
+      {"deep stacks", 10, 100, 1'000, 0},
+      {"mmap churn", 10, 10, 1'000, 1'000},
+  };
+
+  // The handler sends the symbols it finds to the client directly: they are
+  // only queued, as the server is not started.
+  TcpServer null_server;
+  TcpServer* previous_server = GTcpServer;
+  GTcpServer = &null_server;
+
+  absl::PrintF("%-16s %12s %8s %10s %10s %7s %9s %9s %9s\n", "workload",
+               "events/s", "MB/s", "lost", "dropped", "cpu %", "p50 ms",
+               "p99 ms", "max ms");
+  for (const Workload& workload : workloads) {
+    RunWorkload(workload);
+  }
+
+  GTcpServer = previous_server;
+}
@@ -1,45 +1,276 @@
 #include "LinuxTracingHandler.h"
 
+#include <OrbitBase/Logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 #include <functional>
+#include <map>
 #include <optional>
 
 #include "Callstack.h"
-#include "ContextSwitch.h"
+#include "CoreActivity.h"
+#include "KernelSymbols.h"
 #include "OrbitModule.h"
 #include "Params.h"
 #include "Path.h"
 #include "Pdb.h"
+#include "PmuCounters.h"
 #include "TcpServer.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
 #include "llvm/Demangle/Demangle.h"
 
+namespace {
+// Parses a comma-separated list of counters, e.g., "cycles,instructions".
+// Unknown names are skipped.
+std::vector<LinuxTracing::PmuCounter> ParsePmuCounters(
+    const std::string& pmu_counter_names) {
+  static const std::map<std::string, LinuxTracing::PmuCounter, std::less<>>
+      kPmuCountersByName{
+          {"cycles", LinuxTracing::PmuCounter::kCycles},
+          {"instructions", LinuxTracing::PmuCounter::kInstructions},
+          {"llc-misses", LinuxTracing::PmuCounter::kLlcMisses},
+          {"branch-misses", LinuxTracing::PmuCounter::kBranchMisses}};
+  std::vector<LinuxTracing::PmuCounter> pmu_counters;
+  for (absl::string_view name : absl::StrSplit(
+           pmu_counter_names, absl::ByChar(','), absl::SkipWhitespace())) {
+    auto it = kPmuCountersByName.find(name);
+    if (it == kPmuCountersByName.end()) {
+      ERROR("Unknown PMU counter \"%s\"", std::string(name).c_str());
+      continue;
+    }
+    if (std::find(pmu_counters.begin(), pmu_counters.end(), it->second) ==
+        pmu_counters.end()) {
+      pmu_counters.push_back(it->second);
+    }
+  }
+  return pmu_counters;
+}
+
+// Parses a list of cpus and ranges of cpus, e.g., "0-3,8". Invalid entries
+// are skipped.
+std::vector<int> ParseCpus(const std::string& cpu_list) {
+  std::vector<int> cpus;
+  for (absl::string_view range :
+       absl::StrSplit(cpu_list, absl::ByChar(','), absl::SkipWhitespace())) {
+    std::pair<absl::string_view, absl::string_view> bounds =
+        absl::StrSplit(range, absl::MaxSplits('-', 1));
+    int first;
+    int last;
+    if (!absl::SimpleAtoi(bounds.first, &first) ||
+        !absl::SimpleAtoi(bounds.second.empty() ? bounds.first : bounds.second,
+                          &last) ||
+        first < 0 || last < first) {
+      ERROR("Invalid cpus \"%s\"", std::string(range).c_str());
+      continue;
+    }
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+// Parses the comma-separated thread ids of m_SampledThreads and patterns of
+// m_SampledThreadNames. Invalid thread ids are skipped.
+LinuxTracing::ThreadSelection GetSampledThreads() {
+  LinuxTracing::ThreadSelection sampled_threads;
+  for (absl::string_view tid_str : absl::StrSplit(
+           GParams.m_SampledThreads, absl::ByChar(','),
+           absl::SkipWhitespace())) {
+    pid_t tid;
+    if (!absl::SimpleAtoi(tid_str, &tid) || tid <= 0) {
+      ERROR("Invalid thread id \"%s\"", std::string(tid_str).c_str());
+      continue;
+    }
+    sampled_threads.tids.push_back(tid);
+  }
+  for (absl::string_view pattern :
+       absl::StrSplit(GParams.m_SampledThreadNames, absl::ByChar(','),
+                      absl::SkipWhitespace())) {
+    sampled_threads.name_patterns.emplace_back(
+        absl::StripAsciiWhitespace(pattern));
+  }
+  return sampled_threads;
+}
+}  // namespace
+
+LinuxTracing::ThreadPlacement LinuxTracingHandler::GetThreadPlacement() {
+  LinuxTracing::ThreadPlacement thread_placement;
+  thread_placement.cpus = ParseCpus(GParams.m_ServiceCpus);
+  if (GParams.m_ServiceSchedulingPolicy == "batch") {
+    thread_placement.policy = LinuxTracing::ThreadPlacement::Policy::kBatch;
+  } else if (GParams.m_ServiceSchedulingPolicy == "idle") {
+    thread_placement.policy = LinuxTracing::ThreadPlacement::Policy::kIdle;
+  } else if (!GParams.m_ServiceSchedulingPolicy.empty()) {
+    ERROR("Unknown scheduling policy \"%s\"",
+          GParams.m_ServiceSchedulingPolicy.c_str());
+  }
+  thread_placement.nice = GParams.m_ServiceNice;
+  thread_placement.numa_local_readers = GParams.m_NumaLocalReaders;
+  return thread_placement;
+}
+
 void LinuxTracingHandler::Start() {
   pid_t pid = target_process_->GetID();
 
-  double sampling_frequency = DEFAULT_SAMPLING_FREQUENCY;
+  bool sampling_only = sampling_only_frequency_.has_value();
+  double sampling_frequency =
+      sampling_only_frequency_.value_or(DEFAULT_SAMPLING_FREQUENCY);
+
+  // With PMU counters, the selected functions are recorded with them instead
+  // of with their callstack.
+  if (!sampling_only) {
+    pmu_counters_ = ParsePmuCounters(GParams.m_PmuCounters);
+  }
+  LinuxTracing::Function::RecordingMode recording_mode =
+      pmu_counters_.empty()
+          ? LinuxTracing::Function::RecordingMode::kTimingAndCallstack
+          : LinuxTracing::Function::RecordingMode::kTimingAndPmuCounters;
+
+  if (!sampling_only && GParams.m_AutoInstrumentFunctions > 0) {
+    if (selected_function_map_->empty()) {
+      // Tracer::AddInstrumentedFunction needs their ring buffers.
+      ERROR("Auto-instrumentation needs a function selected");
+    } else {
+      absl::MutexLock lock(&auto_instrumentation_mutex_);
+      auto_instrumentation_.emplace(
+          GParams.m_AutoInstrumentFunctions,
+          GParams.m_AutoInstrumentationMaxOverheadPercent);
+      auto_instrumentation_candidates_.clear();
+    }
+  }
 
   std::vector<LinuxTracing::Function> selected_functions;
   selected_functions.reserve(selected_function_map_->size());
   for (const auto& function : *selected_function_map_) {
     selected_functions.emplace_back(
         function.second->GetPdb()->GetLoadedModuleName(),
-        function.second->Offset(), function.second->GetVirtualAddress());
+        function.second->Offset(), function.second->GetVirtualAddress(),
+        recording_mode);
   }
 
-  tracer_ = std::make_unique<LinuxTracing::Tracer>(pid, sampling_frequency,
-                                                   selected_functions);
+  std::vector<pid_t> pids{pid};
+  if (!GParams.m_TracedCgroupPath.empty()) {
+    std::vector<pid_t> cgroup_pids =
+        LinuxTracing::Tracer::ListCgroupProcesses(GParams.m_TracedCgroupPath);
+    for (pid_t cgroup_pid : cgroup_pids) {
+      if (cgroup_pid != pid) pids.push_back(cgroup_pid);
+    }
+  }
+
+  tracer_ = std::make_unique<LinuxTracing::Tracer>(
+      std::move(pids), sampling_frequency, std::move(selected_functions));
 
   tracer_->SetListener(this);
 
-  tracer_->SetTraceContextSwitches(GParams.m_TrackContextSwitches);
+  tracer_->SetTraceContextSwitches(!sampling_only &&
+                                   GParams.m_TrackContextSwitches);
+  tracer_->SetTraceThreadStates(!sampling_only && GParams.m_TrackThreadStates);
+  tracer_->SetTraceOffCpuCallstacks(!sampling_only &&
+                                    GParams.m_TrackOffCpuCallstacks);
+  tracer_->SetTraceSystemWideScheduling(!sampling_only &&
+                                        GParams.m_SystemWideScheduling);
   tracer_->SetTraceCallstacks(true);
-  tracer_->SetTraceInstrumentedFunctions(true);
+  tracer_->SetBpfStackAggregation(GParams.m_BpfStackAggregation);
+  tracer_->SetTraceInstrumentedFunctions(!sampling_only);
+  tracer_->SetBpfFunctionCalls(GParams.m_BpfFunctionCalls);
+  tracer_->SetTraceFileIo(!sampling_only && GParams.m_TrackFileIo);
+  tracer_->SetPageFaultSamplingPeriod(
+      sampling_only ? 0 : GParams.m_PageFaultSamplingPeriod);
+  tracer_->SetHeapSamplingInterval(
+      sampling_only ? 0 : GParams.m_HeapSamplingIntervalBytes);
+  tracer_->SetLockWaitThresholdNs(
+      sampling_only ? 0 : GParams.m_LockWaitThresholdNs);
+  LinuxTracing::BranchSampling branch_sampling =
+      GParams.m_BranchSamplingAllBranches
+          ? LinuxTracing::BranchSampling::kAllBranches
+          : LinuxTracing::BranchSampling::kCalls;
+  tracer_->SetBranchSampling(
+      sampling_only || GParams.m_BranchSamplingPeriod == 0
+          ? LinuxTracing::BranchSampling::kNone
+          : branch_sampling,
+      GParams.m_BranchSamplingPeriod);
+  tracer_->SetPmuCounters(pmu_counters_);
+  tracer_->SetSampledThreads(GetSampledThreads());
+  bool trace_gpu_submission_callstacks =
+      !sampling_only && GParams.m_TrackGpuDriverEvents &&
+      GParams.m_TrackGpuSubmissionCallstacks;
+  tracer_->SetTraceGpuDriverEvents(!sampling_only &&
+                                   GParams.m_TrackGpuDriverEvents);
+  tracer_->SetTraceGpuSubmissionCallstacks(trace_gpu_submission_callstacks);
+  if (trace_gpu_submission_callstacks) {
+    absl::MutexLock lock(&gpu_jobs_mutex_);
+    gpu_job_callstack_pairer_.emplace();
+  }
+  tracer_->SetRecordFilePath(GParams.m_PerfRecordFilePath);
+  tracer_->SetThreadPlacement(GetThreadPlacement());
 
   tracer_->Start();
 }
 
+void LinuxTracingHandler::TraceWithIntelPt(uint64_t function_address,
+                                           uint64_t duration_ns) {
+  if (tracer_ == nullptr) {
+    ERROR("Intel PT needs a capture in progress");
+    return;
+  }
+  // The trace is filtered to the code of the function.
+  Function* function =
+      target_process_->GetFunctionFromAddress(function_address);
+  if (function == nullptr || function->Size() == 0) {
+    ERROR("Cannot trace function at %#lx with Intel PT", function_address);
+    return;
+  }
+  PRINT("Tracing %s with Intel PT for %.1f ms\n",
+        function->PrettyName().c_str(), duration_ns / 1e6);
+  LinuxTracing::Function traced_function(
+      function->GetPdb()->GetLoadedModuleName(), function->Offset(),
+      function_address, LinuxTracing::Function::RecordingMode::kTimingOnly);
+  tracer_->TraceWithIntelPt(std::move(traced_function), function->Size(),
+                            duration_ns);
+}
+
+void LinuxTracingHandler::Prewarm(pid_t pid) {
+  // The functions are not selected yet, they only matter for the sizes of the
+  // ring buffers with a memory budget.
+  LinuxTracing::Tracer tracer{pid, DEFAULT_SAMPLING_FREQUENCY, {}};
+  tracer.SetTraceContextSwitches(GParams.m_TrackContextSwitches);
+  tracer.SetTraceThreadStates(GParams.m_TrackThreadStates);
+  tracer.SetTraceOffCpuCallstacks(GParams.m_TrackOffCpuCallstacks);
+  tracer.SetTraceCallstacks(true);
+  tracer.SetBpfStackAggregation(GParams.m_BpfStackAggregation);
+  tracer.SetTraceFileIo(GParams.m_TrackFileIo);
+  tracer.SetTraceGpuDriverEvents(GParams.m_TrackGpuDriverEvents);
+  tracer.SetTraceGpuSubmissionCallstacks(
+      GParams.m_TrackGpuSubmissionCallstacks);
+  tracer.Prewarm();
+}
+
 void LinuxTracingHandler::Stop() {
   tracer_->Stop();
   tracer_.reset();
+
+  {
+    absl::MutexLock lock(&auto_instrumentation_mutex_);
+    auto_instrumentation_.reset();
+  }
+
+  {
+    absl::MutexLock lock(&sampler_mutex_);
+    FlushSampler();
+  }
+
+  // The jobs still waiting for the callstack of their submission.
+  absl::MutexLock lock(&gpu_jobs_mutex_);
+  if (gpu_job_callstack_pairer_.has_value()) {
+    for (const auto& paired_job : gpu_job_callstack_pairer_->Flush()) {
+      RecordGpuJob(paired_job.job, paired_job.callstack_id);
+    }
+  }
 }
 
 void LinuxTracingHandler::OnTid(pid_t tid) {
@@ -51,49 +282,132 @@ void LinuxTracingHandler::OnTid(pid_t tid) {
 }
 
 void LinuxTracingHandler::ProcessCallstackEvent(LinuxCallstackEvent&& event) {
-  CallStack cs = event.m_CS;
-  if (sampling_profiler_->HasCallStack(cs.Hash())) {
-    CallstackEvent hashed_callstack;
-    hashed_callstack.m_Id = cs.m_Hash;
-    hashed_callstack.m_TID = cs.m_ThreadId;
-    hashed_callstack.m_Time = event.m_time;
-
-    session_->RecordHashedCallstack(std::move(hashed_callstack));
+  CallstackID id = event.m_CS.Hash();
+  if (!sent_callstack_ids_.insert(id).second) {
+    session_->RecordHashedCallstack(
+        CallstackEvent(event.m_time, id, event.m_CS.m_ThreadId));
   } else {
     session_->RecordCallstack(std::move(event));
   }
+}
 
-  // TODO: Is this needed for the case when the call stack already cached?
-  sampling_profiler_->AddCallStack(cs);
+void LinuxTracingHandler::ProcessCallstackEvent(
+    LinuxCallstackEvent&& event, std::vector<CallstackEvent>* hashed_callstacks,
+    std::vector<LinuxCallstackEvent>* callstacks) {
+  CallstackID id = event.m_CS.Hash();
+  if (!sent_callstack_ids_.insert(id).second) {
+    hashed_callstacks->emplace_back(event.m_time, id, event.m_CS.m_ThreadId);
+  } else {
+    callstacks->push_back(std::move(event));
+  }
 }
 
 void LinuxTracingHandler::OnContextSwitchIn(
     const LinuxTracing::ContextSwitchIn& context_switch_in) {
   ++(*num_context_switches_);
-
-  ContextSwitch context_switch(ContextSwitch::In);
-  context_switch.m_ThreadId = context_switch_in.GetTid();
-  context_switch.m_Time = context_switch_in.GetTimestampNs();
-  context_switch.m_ProcessorIndex = context_switch_in.GetCore();
-  context_switch.m_ProcessorNumber = context_switch_in.GetCore();
-
-  session_->RecordContextSwitch(std::move(context_switch));
+  absl::MutexLock lock(&context_switch_mutex_);
+  context_switch_pairer_.AddSwitchIn(context_switch_in.GetTid(),
+                                     context_switch_in.GetCore(),
+                                     context_switch_in.GetTimestampNs());
 }
 
 void LinuxTracingHandler::OnContextSwitchOut(
     const LinuxTracing::ContextSwitchOut& context_switch_out) {
   ++(*num_context_switches_);
+  std::optional<CoreActivity> core_activity;
+  {
+    absl::MutexLock lock(&context_switch_mutex_);
+    core_activity = context_switch_pairer_.AddSwitchOut(
+        context_switch_out.GetTid(), context_switch_out.GetCore(),
+        context_switch_out.GetTimestampNs());
+  }
+  if (core_activity.has_value()) {
+    session_->RecordCoreActivity(std::move(core_activity.value()));
+  }
+}
 
-  ContextSwitch context_switch(ContextSwitch::Out);
-  context_switch.m_ThreadId = context_switch_out.GetTid();
-  context_switch.m_Time = context_switch_out.GetTimestampNs();
-  context_switch.m_ProcessorIndex = context_switch_out.GetCore();
-  context_switch.m_ProcessorNumber = context_switch_out.GetCore();
+void LinuxTracingHandler::OnContextSwitchesIn(
+    absl::Span<const LinuxTracing::ContextSwitchIn> context_switches_in) {
+  *num_context_switches_ += context_switches_in.size();
+  absl::MutexLock lock(&context_switch_mutex_);
+  for (const auto& context_switch_in : context_switches_in) {
+    context_switch_pairer_.AddSwitchIn(context_switch_in.GetTid(),
+                                       context_switch_in.GetCore(),
+                                       context_switch_in.GetTimestampNs());
+  }
+}
 
-  session_->RecordContextSwitch(std::move(context_switch));
+void LinuxTracingHandler::OnContextSwitchesOut(
+    absl::Span<const LinuxTracing::ContextSwitchOut> context_switches_out) {
+  *num_context_switches_ += context_switches_out.size();
+  std::vector<CoreActivity> core_activities;
+  core_activities.reserve(context_switches_out.size());
+  {
+    absl::MutexLock lock(&context_switch_mutex_);
+    for (const auto& context_switch_out : context_switches_out) {
+      std::optional<CoreActivity> core_activity =
+          context_switch_pairer_.AddSwitchOut(
+              context_switch_out.GetTid(), context_switch_out.GetCore(),
+              context_switch_out.GetTimestampNs());
+      if (core_activity.has_value()) {
+        core_activities.push_back(core_activity.value());
+      }
+    }
+  }
+  session_->RecordCoreActivities(std::move(core_activities));
 }
 
-void LinuxTracingHandler::OnCallstack(
+ThreadStateChange LinuxTracingHandler::MakeThreadStateChange(
+    const LinuxTracing::ThreadStateChange& thread_state_change) {
+  ThreadStateChange change;
+  change.time = thread_state_change.GetTimestampNs();
+  change.thread_id = thread_state_change.GetTid();
+  change.waker_thread_id = std::max(thread_state_change.GetWakerTid(), 0);
+  change.state =
+      static_cast<ThreadStateChange::State>(thread_state_change.GetState());
+  return change;
+}
+
+void LinuxTracingHandler::OnThreadStateChange(
+    const LinuxTracing::ThreadStateChange& thread_state_change) {
+  session_->RecordThreadStateChange(MakeThreadStateChange(thread_state_change));
+}
+
+void LinuxTracingHandler::OnThreadStateChanges(
+    absl::Span<const LinuxTracing::ThreadStateChange> thread_state_changes) {
+  std::vector<ThreadStateChange> changes;
+  changes.reserve(thread_state_changes.size());
+  for (const auto& thread_state_change : thread_state_changes) {
+    changes.push_back(MakeThreadStateChange(thread_state_change));
+  }
+  session_->RecordThreadStateChanges(std::move(changes));
+}
+
+Timer LinuxTracingHandler::MakeTimer(const LinuxTracing::FileIo& file_io) {
+  FileIo timer_file_io;
+  timer_file_io.begin = file_io.GetBeginTimestampNs();
+  timer_file_io.end = file_io.GetEndTimestampNs();
+  timer_file_io.syscall = static_cast<FileIo::Syscall>(file_io.GetSyscall());
+  timer_file_io.fd = file_io.GetFd();
+  timer_file_io.result = file_io.GetResult();
+  return MakeFileIoTimer(file_io.GetTid(), timer_file_io);
+}
+
+void LinuxTracingHandler::OnFileIo(const LinuxTracing::FileIo& file_io) {
+  session_->RecordTimer(MakeTimer(file_io));
+}
+
+void LinuxTracingHandler::OnFileIos(
+    absl::Span<const LinuxTracing::FileIo> file_ios) {
+  std::vector<Timer> timers;
+  timers.reserve(file_ios.size());
+  for (const auto& file_io : file_ios) {
+    timers.push_back(MakeTimer(file_io));
+  }
+  session_->RecordTimers(std::move(timers));
+}
+
+LinuxCallstackEvent LinuxTracingHandler::MakeCallstackEvent(
     const LinuxTracing::Callstack& callstack) {
   CallStack cs;
   cs.m_ThreadId = callstack.GetTid();
@@ -119,16 +433,201 @@ void LinuxTracingHandler::OnCallstack(
       target_process_->AddSymbol(address, symbol);
     }
 
+    if (frame.GetFunctionName().empty()) {
+      NameKernelFrame(address);
+    }
+
     cs.m_Data.push_back(address);
   }
 
   cs.m_Depth = cs.m_Data.size();
 
-  ProcessCallstackEvent({"", callstack.GetTimestampNs(), 1, cs});
+  return {"", callstack.GetTimestampNs(), 1, cs};
 }
 
-void LinuxTracingHandler::OnFunctionCall(
-    const LinuxTracing::FunctionCall& function_call) {
+void LinuxTracingHandler::NameKernelFrame(uint64_t address) {
+  if (named_kernel_frames_.contains(address)) {
+    return;
+  }
+  const KernelSymbols& kernel_symbols = KernelSymbols::Get();
+  const KernelSymbols::Symbol* symbol = kernel_symbols.Find(address);
+  if (symbol == nullptr) {
+    return;
+  }
+  named_kernel_frames_.insert(address);
+  std::string name{kernel_symbols.GetName(*symbol)};
+  uint64_t name_key = StringHash(name);
+  session_->SendKeyAndString(name_key, name);
+  new_kernel_frame_symbols_.push_back(
+      KernelFrameSymbol{address, symbol->address, name_key});
+}
+
+void LinuxTracingHandler::SendNewKernelFrameSymbols() {
+  if (!new_kernel_frame_symbols_.empty()) {
+    session_->SendKernelFrameSymbols(std::move(new_kernel_frame_symbols_));
+    new_kernel_frame_symbols_.clear();
+  }
+}
+
+void LinuxTracingHandler::OnCallstack(
+    const LinuxTracing::Callstack& callstack) {
+  AddAutoInstrumentationSamples(absl::MakeConstSpan(&callstack, 1));
+  ProcessCallstackEvent(MakeCallstackEvent(callstack));
+  SendNewKernelFrameSymbols();
+}
+
+void LinuxTracingHandler::OnCallstacks(
+    absl::Span<const LinuxTracing::Callstack> callstacks) {
+  AddAutoInstrumentationSamples(callstacks);
+  std::vector<CallstackEvent> hashed_callstack_events;
+  std::vector<LinuxCallstackEvent> callstack_events;
+  for (const auto& callstack : callstacks) {
+    ProcessCallstackEvent(MakeCallstackEvent(callstack),
+                          &hashed_callstack_events, &callstack_events);
+  }
+  // Full callstacks are recorded first, as hashed ones can refer to them.
+  if (!callstack_events.empty()) {
+    session_->RecordCallstacks(std::move(callstack_events));
+  }
+  if (!hashed_callstack_events.empty()) {
+    session_->RecordHashedCallstacks(std::move(hashed_callstack_events));
+  }
+  SendNewKernelFrameSymbols();
+}
+
+void LinuxTracingHandler::OnOffCpuCallstack(
+    const LinuxTracing::OffCpuCallstack& off_cpu_callstack) {
+  // Always sent with their frames: they are much rarer than the samples.
+  OffCpuCallstackEvent event;
+  event.m_Event = MakeCallstackEvent(off_cpu_callstack.GetCallstack());
+  event.m_Event.m_CS.Hash();
+  event.m_DurationNs = off_cpu_callstack.GetEndTimestampNs() -
+                       off_cpu_callstack.GetBeginTimestampNs();
+  session_->RecordOffCpuCallstack(std::move(event));
+  SendNewKernelFrameSymbols();
+}
+
+CallstackID LinuxTracingHandler::SendRemoteCallstackOnce(
+    const LinuxTracing::Callstack& callstack) {
+  CallStack cs = MakeCallstackEvent(callstack).m_CS;
+  CallstackID id = cs.Hash();
+  if (sent_remote_callstack_ids_.insert(id).second) {
+    std::string message_data = SerializeObjectHumanReadable(cs);
+    GTcpServer->Send(Msg_RemoteCallStack, message_data.c_str(),
+                     message_data.size());
+  }
+  SendNewKernelFrameSymbols();
+  return id;
+}
+
+void LinuxTracingHandler::OnGpuSubmissionCallstack(
+    const LinuxTracing::Callstack& callstack) {
+  CallstackID id = SendRemoteCallstackOnce(callstack);
+
+  absl::MutexLock lock(&gpu_jobs_mutex_);
+  if (!gpu_job_callstack_pairer_.has_value()) {
+    return;
+  }
+  for (const auto& paired_job : gpu_job_callstack_pairer_->AddCallstack(
+           callstack.GetTid(), callstack.GetTimestampNs(), id)) {
+    RecordGpuJob(paired_job.job, paired_job.callstack_id);
+  }
+}
+
+void LinuxTracingHandler::OnPageFault(
+    const LinuxTracing::PageFault& page_fault) {
+  Timer timer;
+  timer.m_TID = page_fault.GetTid();
+  timer.m_Start = page_fault.GetTimestampNs();
+  timer.m_End = timer.m_Start;
+  timer.m_Type = Timer::PAGE_FAULT;
+  timer.m_UserData[0] = page_fault.IsMajor() ? 1 : 0;
+  // Every major fault is sampled, one in the period of the minor ones.
+  timer.m_UserData[1] = page_fault.IsMajor()
+                            ? 1
+                            : std::max<uint64_t>(
+                                  GParams.m_PageFaultSamplingPeriod, 1);
+  timer.m_CallstackHash = SendRemoteCallstackOnce(page_fault.GetCallstack());
+  session_->RecordTimer(std::move(timer));
+}
+
+void LinuxTracingHandler::OnHeapAllocation(
+    const LinuxTracing::HeapAllocation& heap_allocation) {
+  Timer timer;
+  timer.m_TID = heap_allocation.GetTid();
+  timer.m_Start = heap_allocation.GetTimestampNs();
+  timer.m_End = timer.m_Start;
+  timer.m_Type = Timer::ALLOC;
+  timer.m_UserData[0] = heap_allocation.GetAddress();
+  // An allocation of size bytes is sampled with probability
+  // 1 - exp(-size / interval): weighting it by the inverse makes the bytes of
+  // the MemoryTracker unbiased estimates of the bytes of the target.
+  uint64_t size = heap_allocation.GetSize();
+  double interval = GParams.m_HeapSamplingIntervalBytes;
+  double probability =
+      interval > 0 ? -std::expm1(-static_cast<double>(size) / interval) : 1;
+  timer.m_UserData[1] =
+      probability > 0 ? std::llround(size / probability) : size;
+  if (!heap_allocation.GetCallstack().GetFrames().empty()) {
+    timer.m_CallstackHash =
+        SendRemoteCallstackOnce(heap_allocation.GetCallstack());
+  }
+  session_->RecordTimer(std::move(timer));
+}
+
+void LinuxTracingHandler::OnHeapFree(const LinuxTracing::HeapFree& heap_free) {
+  Timer timer;
+  timer.m_TID = heap_free.GetTid();
+  timer.m_Start = heap_free.GetTimestampNs();
+  timer.m_End = timer.m_Start;
+  timer.m_Type = Timer::FREE;
+  timer.m_UserData[0] = heap_free.GetAddress();
+  session_->RecordTimer(std::move(timer));
+}
+
+void LinuxTracingHandler::OnLockWait(const LinuxTracing::LockWait& lock_wait) {
+  Timer timer;
+  timer.m_TID = lock_wait.GetTid();
+  timer.m_Start = lock_wait.GetBeginTimestampNs();
+  timer.m_End = lock_wait.GetEndTimestampNs();
+  timer.m_Type = Timer::LOCK_WAIT;
+  timer.m_UserData[0] = lock_wait.GetLockAddress();
+  if (!lock_wait.GetCallstack().GetFrames().empty()) {
+    timer.m_CallstackHash = SendRemoteCallstackOnce(lock_wait.GetCallstack());
+  }
+  session_->RecordTimer(std::move(timer));
+}
+
+void LinuxTracingHandler::OnBranchCounts(
+    const LinuxTracing::BranchCounts& branch_counts) {
+  std::vector<BranchCount> counts;
+  counts.reserve(branch_counts.GetBranches().size() +
+                 branch_counts.GetRanges().size());
+  for (const LinuxTracing::BranchCounts::Count& branch :
+       branch_counts.GetBranches()) {
+    counts.push_back(BranchCount{BranchCount::kBranch, branch.from, branch.to,
+                                 branch.count});
+  }
+  for (const LinuxTracing::BranchCounts::Count& range :
+       branch_counts.GetRanges()) {
+    counts.push_back(
+        BranchCount{BranchCount::kRange, range.from, range.to, range.count});
+  }
+  session_->RecordBranchCounts(std::move(counts));
+}
+
+void LinuxTracingHandler::OnThreadName(
+    const LinuxTracing::ThreadName& thread_name) {
+  // The names are interned: each is only sent once, over all threads.
+  uint64_t name_key = StringHash(thread_name.GetName());
+  session_->SendKeyAndString(name_key, thread_name.GetName());
+  session_->SendThreadName(
+      ThreadNameKey{thread_name.GetTimestampNs(),
+                    static_cast<uint32_t>(thread_name.GetTid()), name_key});
+}
+
+Timer LinuxTracingHandler::MakeTimer(
+    const LinuxTracing::FunctionCall& function_call) const {
   Timer timer;
   timer.m_TID = function_call.GetTid();
   timer.m_Start = function_call.GetBeginTimestampNs();
@@ -136,7 +635,80 @@ void LinuxTracingHandler::OnFunctionCall(
   timer.m_Depth = static_cast<uint8_t>(function_call.GetDepth());
   timer.m_FunctionAddress = function_call.GetVirtualAddress();
 
-  session_->RecordTimer(std::move(timer));
+  if (function_call.GetPmuCounters().has_value()) {
+    const LinuxTracing::PmuCounterValues& values =
+        function_call.GetPmuCounters().value();
+    PmuCounters pmu_counters;
+    for (LinuxTracing::PmuCounter counter : pmu_counters_) {
+      uint64_t value = values[static_cast<size_t>(counter)];
+      switch (counter) {
+        case LinuxTracing::PmuCounter::kCycles:
+          pmu_counters.cycles = value;
+          break;
+        case LinuxTracing::PmuCounter::kInstructions:
+          pmu_counters.instructions = value;
+          break;
+        case LinuxTracing::PmuCounter::kLlcMisses:
+          pmu_counters.llc_misses = value;
+          break;
+        case LinuxTracing::PmuCounter::kBranchMisses:
+          pmu_counters.branch_misses = value;
+          break;
+      }
+    }
+    SetTimerPmuCounters(pmu_counters, &timer);
+  }
+  return timer;
+}
+
+void LinuxTracingHandler::OnFunctionCall(
+    const LinuxTracing::FunctionCall& function_call) {
+  AddAutoInstrumentationCalls(absl::MakeConstSpan(&function_call, 1));
+  Timer timer = MakeTimer(function_call);
+  absl::MutexLock lock(&sampler_mutex_);
+  if (sampler_.IsEmpty()) {
+    session_->RecordTimer(std::move(timer));
+    return;
+  }
+  if (sampler_.AddTimer(timer)) {
+    session_->RecordTimer(Timer(timer));
+  }
+  if (sampler_.IsFlushDue(timer.m_End)) {
+    FlushSampler();
+  }
+}
+
+void LinuxTracingHandler::OnFunctionCalls(
+    absl::Span<const LinuxTracing::FunctionCall> function_calls) {
+  AddAutoInstrumentationCalls(function_calls);
+  std::vector<Timer> timers;
+  timers.reserve(function_calls.size());
+  absl::MutexLock lock(&sampler_mutex_);
+  for (const auto& function_call : function_calls) {
+    Timer timer = MakeTimer(function_call);
+    if (sampler_.IsEmpty() || sampler_.AddTimer(timer)) {
+      timers.push_back(timer);
+    }
+  }
+  if (!timers.empty()) {
+    session_->RecordTimers(std::move(timers));
+  }
+  if (!function_calls.empty() &&
+      sampler_.IsFlushDue(function_calls.back().GetEndTimestampNs())) {
+    FlushSampler();
+  }
+}
+
+void LinuxTracingHandler::FlushSampler() {
+  std::vector<Timer> timers;
+  std::vector<FunctionStats> stats;
+  sampler_.Flush(&timers, &stats);
+  if (!timers.empty()) {
+    session_->RecordTimers(std::move(timers));
+  }
+  if (!stats.empty()) {
+    GTcpServer->Send(Msg_FunctionStats, std::move(stats));
+  }
 }
 
 pid_t LinuxTracingHandler::TimelineToThreadId(const std::string_view timeline) {
@@ -153,6 +725,18 @@ pid_t LinuxTracingHandler::TimelineToThreadId(const std::string_view timeline) {
 
 void LinuxTracingHandler::OnGpuJob(
     const LinuxTracing::GpuJob& gpu_job) {
+  absl::MutexLock lock(&gpu_jobs_mutex_);
+  if (!gpu_job_callstack_pairer_.has_value()) {
+    RecordGpuJob(gpu_job, 0);
+    return;
+  }
+  for (const auto& paired_job : gpu_job_callstack_pairer_->AddJob(gpu_job)) {
+    RecordGpuJob(paired_job.job, paired_job.callstack_id);
+  }
+}
+
+void LinuxTracingHandler::RecordGpuJob(const LinuxTracing::GpuJob& gpu_job,
+                                       CallstackID callstack_id) {
   Timer timer_user_to_sched;
   timer_user_to_sched.m_TID = TimelineToThreadId(gpu_job.GetTimeline());
   timer_user_to_sched.m_Start = gpu_job.GetAmdgpuCsIoctlTimeNs();
@@ -169,6 +753,7 @@ void LinuxTracingHandler::OnGpuJob(
   timer_user_to_sched.m_UserData[1] = timeline_hash;
 
   timer_user_to_sched.m_Type = Timer::GPU_ACTIVITY;
+  timer_user_to_sched.m_CallstackHash = callstack_id;
   session_->RecordTimer(std::move(timer_user_to_sched));
 
   Timer timer_sched_to_start;
@@ -185,6 +770,7 @@ void LinuxTracingHandler::OnGpuJob(
   timer_sched_to_start.m_UserData[1] = timeline_hash;
 
   timer_sched_to_start.m_Type = Timer::GPU_ACTIVITY;
+  timer_sched_to_start.m_CallstackHash = callstack_id;
   session_->RecordTimer(std::move(timer_sched_to_start));
 
   Timer timer_start_to_finish;
@@ -200,5 +786,129 @@ void LinuxTracingHandler::OnGpuJob(
   timer_start_to_finish.m_UserData[1] = timeline_hash;
 
   timer_start_to_finish.m_Type = Timer::GPU_ACTIVITY;
+  timer_start_to_finish.m_CallstackHash = callstack_id;
   session_->RecordTimer(std::move(timer_start_to_finish));
 }
+
+void LinuxTracingHandler::AddAutoInstrumentationSamples(
+    absl::Span<const LinuxTracing::Callstack> callstacks) {
+  absl::MutexLock lock(&auto_instrumentation_mutex_);
+  if (!auto_instrumentation_.has_value()) {
+    return;
+  }
+  for (const LinuxTracing::Callstack& callstack : callstacks) {
+    if (callstack.GetFrames().empty()) {
+      continue;
+    }
+    Function* function = target_process_->GetFunctionFromAddress(
+        callstack.GetFrames().front().GetPc(), /*a_IsExact=*/false);
+    if (function == nullptr) {
+      continue;
+    }
+    uint64_t address = function->GetVirtualAddress();
+    auto_instrumentation_candidates_.try_emplace(address, function);
+    auto_instrumentation_->AddSample(address);
+  }
+}
+
+void LinuxTracingHandler::AddAutoInstrumentationCalls(
+    absl::Span<const LinuxTracing::FunctionCall> function_calls) {
+  absl::MutexLock lock(&auto_instrumentation_mutex_);
+  if (!auto_instrumentation_.has_value()) {
+    return;
+  }
+  for (const LinuxTracing::FunctionCall& function_call : function_calls) {
+    auto_instrumentation_->AddCall(function_call.GetVirtualAddress());
+  }
+}
+
+void LinuxTracingHandler::UpdateAutoInstrumentation(uint64_t now_ns) {
+  absl::MutexLock lock(&auto_instrumentation_mutex_);
+  if (!auto_instrumentation_.has_value() || tracer_ == nullptr) {
+    return;
+  }
+  AutoInstrumentation::Changes changes = auto_instrumentation_->Update(now_ns);
+  auto make_function = [this](uint64_t address) {
+    Function* function = auto_instrumentation_candidates_.at(address);
+    return LinuxTracing::Function(
+        function->GetPdb()->GetLoadedModuleName(), function->Offset(),
+        address, LinuxTracing::Function::RecordingMode::kTimingOnly);
+  };
+  for (uint64_t address : changes.removed) {
+    PRINT("Auto-instrumentation: removing %s\n",
+          auto_instrumentation_candidates_.at(address)->PrettyName().c_str());
+    tracer_->RemoveInstrumentedFunction(make_function(address));
+  }
+  for (uint64_t address : changes.added) {
+    // The functions the user selected already are.
+    if (selected_function_map_->count(address) > 0) {
+      continue;
+    }
+    PRINT("Auto-instrumentation: adding %s\n",
+          auto_instrumentation_candidates_.at(address)->PrettyName().c_str());
+    tracer_->AddInstrumentedFunction(make_function(address));
+  }
+  session_->RecordServiceStat(
+      "auto-instrumented functions",
+      auto_instrumentation_->GetInstrumented().size(), now_ns - 1, now_ns);
+  session_->RecordServiceStat("auto-instrumentation overhead %",
+                              auto_instrumentation_->GetOverheadPercent(),
+                              now_ns - 1, now_ns);
+}
+
+void LinuxTracingHandler::OnTracerStats(
+    const LinuxTracing::TracerStats& tracer_stats) {
+  UpdateAutoInstrumentation(tracer_stats.GetEndTimestampNs());
+  for (const auto& [name, value] : tracer_stats.GetValues()) {
+    session_->RecordServiceStat(name, value,
+                                tracer_stats.GetBeginTimestampNs(),
+                                tracer_stats.GetEndTimestampNs());
+  }
+}
+
+void LinuxTracingHandler::OnProcessCpuTimes(
+    const LinuxTracing::ProcessCpuTimes& process_cpu_times) {
+  uint64_t begin_ns = process_cpu_times.GetBeginTimestampNs();
+  uint64_t end_ns = process_cpu_times.GetEndTimestampNs();
+  double percent_per_ns = 100.0 / (end_ns - begin_ns);
+
+  std::vector<std::pair<pid_t, uint64_t>> cpu_times_ns =
+      process_cpu_times.GetCpuTimesNs();
+  size_t num_reported = std::min(cpu_times_ns.size(), kMaxProcessCpuTimeTracks);
+  std::partial_sort(cpu_times_ns.begin(), cpu_times_ns.begin() + num_reported,
+                    cpu_times_ns.end(), [](const auto& lhs, const auto& rhs) {
+                      return lhs.second > rhs.second;
+                    });
+
+  // The stats are shown as one track per name, so each process only gets its
+  // own track while it is among the busiest.
+  for (size_t i = 0; i < num_reported; ++i) {
+    const auto& [pid, cpu_time_ns] = cpu_times_ns[i];
+    std::string name =
+        absl::StrFormat("cpu %% %s [%d]", GetProcessName(pid), pid);
+    session_->RecordServiceStat(name, cpu_time_ns * percent_per_ns, begin_ns,
+                                end_ns);
+  }
+  uint64_t other_cpu_time_ns = 0;
+  for (size_t i = num_reported; i < cpu_times_ns.size(); ++i) {
+    other_cpu_time_ns += cpu_times_ns[i].second;
+  }
+  session_->RecordServiceStat("cpu % other processes",
+                              other_cpu_time_ns * percent_per_ns, begin_ns,
+                              end_ns);
+}
+
+const std::string& LinuxTracingHandler::GetProcessName(pid_t pid) {
+  auto it = process_names_.find(pid);
+  if (it != process_names_.end()) {
+    return it->second;
+  }
+  // The process can already have exited, and its pid been reused by the time
+  // the name is read, which is rare enough to be ignored.
+  std::string name;
+  std::ifstream comm(absl::StrFormat("/proc/%d/comm", pid));
+  if (!std::getline(comm, name) || name.empty()) {
+    name = "?";
+  }
+  return process_names_.emplace(pid, std::move(name)).first->second;
+}
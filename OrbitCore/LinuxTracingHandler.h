@@ -4,27 +4,36 @@
 #include <OrbitLinuxTracing/Tracer.h>
 #include <OrbitLinuxTracing/TracerListener.h>
 
-#include "ContextSwitch.h"
+#include <optional>
+
+#include "AutoInstrumentation.h"
+#include "CoreActivity.h"
+#include "FileIoTimeline.h"
+#include "FunctionSampler.h"
+#include "GpuJobCallstackPairer.h"
 #include "LinuxCallstackEvent.h"
+#include "LinuxSymbol.h"
 #include "LinuxTracingSession.h"
 #include "OrbitProcess.h"
-#include "SamplingProfiler.h"
 #include "ScopeTimer.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/synchronization/mutex.h"
 
 class LinuxTracingHandler : LinuxTracing::TracerListener {
  public:
   static constexpr double DEFAULT_SAMPLING_FREQUENCY = 1000.0;
 
-  LinuxTracingHandler(SamplingProfiler* sampling_profiler,
-                      LinuxTracingSession* session, Process* target_process,
-                      std::map<uint64_t, Function*>* selected_function_map,
-                      uint64_t* num_context_switches)
-      : sampling_profiler_(sampling_profiler),
-        session_(session),
+  LinuxTracingHandler(
+      LinuxTracingSession* session, Process* target_process,
+      std::map<uint64_t, Function*>* selected_function_map,
+      const std::vector<FunctionSamplingPolicy>& sampling_policies,
+      uint64_t* num_context_switches)
+      : session_(session),
         target_process_(target_process),
         selected_function_map_(selected_function_map),
-        num_context_switches_(num_context_switches) {}
+        num_context_switches_(num_context_switches),
+        sampler_(sampling_policies) {}
 
   ~LinuxTracingHandler() override = default;
   LinuxTracingHandler(const LinuxTracingHandler&) = delete;
@@ -32,29 +41,161 @@ class LinuxTracingHandler : LinuxTracing::TracerListener {
   LinuxTracingHandler(LinuxTracingHandler&&) = default;
   LinuxTracingHandler& operator=(LinuxTracingHandler&&) = default;
 
+  // Only the callstacks are then sampled, at sampling_frequency: no function
+  // is instrumented, and neither the scheduling nor the PMU counters are
+  // traced. For the continuous profiling mode, see ContinuousProfile. Has to
+  // be called before Start.
+  void SetSamplingOnly(double sampling_frequency) {
+    sampling_only_frequency_ = sampling_frequency;
+  }
+
   void Start();
 
   void Stop();
 
+  // Traces the calls to the function at function_address, selected or not,
+  // with Intel Processor Trace during the next duration_ns, see
+  // LinuxTracing::Tracer::TraceWithIntelPt. The calls are recorded like the
+  // ones of the selected functions.
+  void TraceWithIntelPt(uint64_t function_address, uint64_t duration_ns);
+
+  // Prewarms the perf_event_open ring buffers of a capture of pid with the
+  // current GParams, e.g. as soon as the process is selected, so that Start
+  // doesn't have to open them. See LinuxTracing::Tracer::Prewarm.
+  static void Prewarm(pid_t pid);
+
+  // Where the threads of the service run during a capture, from GParams.
+  static LinuxTracing::ThreadPlacement GetThreadPlacement();
+
   void OnTid(pid_t tid) override;
   void OnContextSwitchIn(
       const LinuxTracing::ContextSwitchIn& context_switch_in) override;
   void OnContextSwitchOut(
       const LinuxTracing::ContextSwitchOut& context_switch_out) override;
+  void OnThreadStateChange(
+      const LinuxTracing::ThreadStateChange& thread_state_change) override;
   void OnCallstack(const LinuxTracing::Callstack& callstack) override;
   void OnFunctionCall(const LinuxTracing::FunctionCall& function_call) override;
   void OnGpuJob(const LinuxTracing::GpuJob& gpu_job) override;
+  void OnTracerStats(const LinuxTracing::TracerStats& tracer_stats) override;
+  void OnProcessCpuTimes(
+      const LinuxTracing::ProcessCpuTimes& process_cpu_times) override;
+  void OnOffCpuCallstack(
+      const LinuxTracing::OffCpuCallstack& off_cpu_callstack) override;
+  void OnGpuSubmissionCallstack(
+      const LinuxTracing::Callstack& callstack) override;
+  void OnThreadName(const LinuxTracing::ThreadName& thread_name) override;
+  void OnFileIo(const LinuxTracing::FileIo& file_io) override;
+  void OnPageFault(const LinuxTracing::PageFault& page_fault) override;
+  void OnHeapAllocation(
+      const LinuxTracing::HeapAllocation& heap_allocation) override;
+  void OnHeapFree(const LinuxTracing::HeapFree& heap_free) override;
+  void OnLockWait(const LinuxTracing::LockWait& lock_wait) override;
+  void OnBranchCounts(
+      const LinuxTracing::BranchCounts& branch_counts) override;
+
+  void OnContextSwitchesIn(
+      absl::Span<const LinuxTracing::ContextSwitchIn> context_switches_in)
+      override;
+  void OnContextSwitchesOut(
+      absl::Span<const LinuxTracing::ContextSwitchOut> context_switches_out)
+      override;
+  void OnCallstacks(
+      absl::Span<const LinuxTracing::Callstack> callstacks) override;
+  void OnFunctionCalls(
+      absl::Span<const LinuxTracing::FunctionCall> function_calls) override;
+  void OnThreadStateChanges(
+      absl::Span<const LinuxTracing::ThreadStateChange> thread_state_changes)
+      override;
+  void OnFileIos(absl::Span<const LinuxTracing::FileIo> file_ios) override;
 
  private:
   void ProcessCallstackEvent(LinuxCallstackEvent&& event);
+  // Like ProcessCallstackEvent, but only adds the event to either
+  // hashed_callstacks or callstacks, to be recorded later as a batch.
+  void ProcessCallstackEvent(LinuxCallstackEvent&& event,
+                             std::vector<CallstackEvent>* hashed_callstacks,
+                             std::vector<LinuxCallstackEvent>* callstacks);
+  LinuxCallstackEvent MakeCallstackEvent(
+      const LinuxTracing::Callstack& callstack);
+  // Frames without a function name are of the kernel when KernelSymbols
+  // finds them. Their names are sent once per address, in batches by
+  // SendNewKernelFrameSymbols.
+  void NameKernelFrame(uint64_t address);
+  // Sends the frames of callstack with Msg_RemoteCallStack the first time,
+  // and returns its id, which timers then refer to.
+  CallstackID SendRemoteCallstackOnce(const LinuxTracing::Callstack& callstack);
+  void SendNewKernelFrameSymbols();
+  Timer MakeTimer(const LinuxTracing::FunctionCall& function_call) const;
+  // The timers of the job, which show callstack_id when selected, unless 0.
+  void RecordGpuJob(const LinuxTracing::GpuJob& gpu_job,
+                    CallstackID callstack_id)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(gpu_jobs_mutex_);
+  // Sends the stats and the reservoir timers of the sampled functions.
+  void FlushSampler() ABSL_EXCLUSIVE_LOCKS_REQUIRED(sampler_mutex_);
+  static Timer MakeTimer(const LinuxTracing::FileIo& file_io);
+  static ThreadStateChange MakeThreadStateChange(
+      const LinuxTracing::ThreadStateChange& thread_state_change);
+  const std::string& GetProcessName(pid_t pid);
+  void AddAutoInstrumentationSamples(
+      absl::Span<const LinuxTracing::Callstack> callstacks);
+  void AddAutoInstrumentationCalls(
+      absl::Span<const LinuxTracing::FunctionCall> function_calls);
+  // Instruments and uninstruments functions as auto_instrumentation_ picks
+  // them, once per tracer stats.
+  void UpdateAutoInstrumentation(uint64_t now_ns);
 
-  SamplingProfiler* sampling_profiler_;
   LinuxTracingSession* session_;
   Process* target_process_;
   std::map<uint64_t, Function*>* selected_function_map_;
   uint64_t* num_context_switches_;
 
+  // Context switches are sent to the client as the activities of the cores
+  // they delimit.
+  absl::Mutex context_switch_mutex_;
+  ContextSwitchPairer context_switch_pairer_
+      ABSL_GUARDED_BY(context_switch_mutex_);
+
   std::unique_ptr<LinuxTracing::Tracer> tracer_;
+  std::optional<double> sampling_only_frequency_;
+  // Parsed from GParams.m_PmuCounters, only written by Start.
+  std::vector<LinuxTracing::PmuCounter> pmu_counters_;
+
+  // The processes with the most cpu time in each bucket reported by
+  // OnProcessCpuTimes get their own track, the others are summed.
+  static constexpr size_t kMaxProcessCpuTimeTracks = 8;
+  // Read from /proc once per process, only used by OnProcessCpuTimes. The
+  // track names that contain them are also only sent to the client once.
+  absl::flat_hash_map<pid_t, std::string> process_names_;
+
+  absl::Mutex sampler_mutex_;
+  FunctionSampler sampler_ ABSL_GUARDED_BY(sampler_mutex_);
+
+  // With GParams.m_AutoInstrumentFunctions, only set by Start.
+  absl::Mutex auto_instrumentation_mutex_;
+  std::optional<AutoInstrumentation> auto_instrumentation_
+      ABSL_GUARDED_BY(auto_instrumentation_mutex_);
+  // The functions of the innermost frames sampled, by address.
+  absl::flat_hash_map<uint64_t, Function*> auto_instrumentation_candidates_
+      ABSL_GUARDED_BY(auto_instrumentation_mutex_);
+
+  // Ids of the callstacks whose frames were already sent to the client: later
+  // samples with the same callstack are only sent as (time, tid, id).
+  absl::flat_hash_set<CallstackID> sent_callstack_ids_;
+
+  absl::flat_hash_set<uint64_t> named_kernel_frames_;
+  std::vector<KernelFrameSymbol> new_kernel_frame_symbols_;
+
+  // The jobs come from the thread reading the tracepoints, their callstacks
+  // from the threads unwinding.
+  absl::Mutex gpu_jobs_mutex_;
+  // Only set with GParams.m_TrackGpuSubmissionCallstacks.
+  std::optional<GpuJobCallstackPairer> gpu_job_callstack_pairer_
+      ABSL_GUARDED_BY(gpu_jobs_mutex_);
+  // The callstacks of submissions, page faults and heap allocations are sent
+  // to the client once, with Msg_RemoteCallStack, and then referred to by
+  // their id.
+  absl::flat_hash_set<CallstackID> sent_remote_callstack_ids_;
 
   pid_t TimelineToThreadId(const std::string_view timeline);
   absl::flat_hash_map<std::string, pid_t> timeline_to_thread_id_;
@@ -1,32 +1,294 @@
 #include "LinuxTracingSession.h"
 
+#include <OrbitBase/Logging.h>
+
+#include <algorithm>
+#include <chrono>
 #include <utility>
 
-#include "KeyAndString.h"
 #include "TcpServer.h"
+#include "Utils.h"
+#include "absl/base/casts.h"
+#include "absl/time/clock.h"
+
+namespace {
+std::atomic<uint64_t> next_session_id = 1;
+}  // namespace
 
 LinuxTracingSession::LinuxTracingSession(TcpServer* tcp_server)
-    : tcp_server_(tcp_server) {}
+    : id_(next_session_id++), tcp_server_(tcp_server) {}
+
+LinuxTracingSession::Lane* LinuxTracingSession::GetLaneOfCurrentThread() {
+  // Only take lanes_mutex_ the first time a thread records into a session.
+  thread_local uint64_t cached_session_id = 0;
+  thread_local Lane* cached_lane = nullptr;
+  if (cached_session_id == id_) {
+    return cached_lane;
+  }
+
+  absl::MutexLock lock(&lanes_mutex_);
+  std::unique_ptr<Lane>& lane = lanes_[std::this_thread::get_id()];
+  if (lane == nullptr) {
+    lane = std::make_unique<Lane>();
+  }
+  cached_session_id = id_;
+  cached_lane = lane.get();
+  return cached_lane;
+}
+
+std::vector<LinuxTracingSession::Lane*> LinuxTracingSession::GetLanes() {
+  absl::MutexLock lock(&lanes_mutex_);
+  std::vector<Lane*> lanes;
+  lanes.reserve(lanes_.size());
+  for (const auto& [thread_id, lane] : lanes_) {
+    lanes.push_back(lane.get());
+  }
+  return lanes;
+}
+
+template <typename T>
+void LinuxTracingSession::Push(Lane* lane, SpscQueue<T>* queue, T&& event) {
+  if (queue->TryPush(std::move(event))) {
+    OnEventPushed(lane);
+    return;
+  }
+  if (lane->dropping) {
+    ++lane->num_dropped;
+    return;
+  }
+
+  ++lane->num_waits;
+  RequestFlush();
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(kMaxProducerWaitMs);
+  while (!queue->TryPush(std::move(event))) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      // Don't wait again until the reader has drained the lane, in case it
+      // is not running at all.
+      lane->dropping = true;
+      ++lane->num_dropped;
+      return;
+    }
+    std::this_thread::yield();
+  }
+  OnEventPushed(lane);
+}
+
+void LinuxTracingSession::OnEventPushed(Lane* lane) {
+  // As the reader resets num_unflushed with a read-modify-write too, either
+  // it reads this event in its current pass, or this is the first unflushed
+  // event of the lane for the next pass.
+  size_t num_unflushed = ++lane->num_unflushed;
+  if (num_unflushed == 1) {
+    OnFirstUnflushedEvent();
+  }
+  if (num_unflushed == flush_batch_size_) {
+    RequestFlush();
+  }
+}
+
+void LinuxTracingSession::OnFirstUnflushedEvent() {
+  absl::MutexLock lock(&flush_mutex_);
+  // The first event of another lane might have been first.
+  if (!has_unflushed_events_) {
+    first_unflushed_event_time_ = absl::Now();
+    has_unflushed_events_ = true;
+  }
+}
+
+void LinuxTracingSession::RequestFlush() {
+  absl::MutexLock lock(&flush_mutex_);
+  flush_requested_ = true;
+}
+
+void LinuxTracingSession::WakeUpReader() { RequestFlush(); }
+
+bool LinuxTracingSession::IsFlushRequestedOrHasUnflushedEvents() {
+  return flush_requested_ || has_unflushed_events_;
+}
+
+void LinuxTracingSession::SetFlushPolicy(const FlushPolicy& flush_policy) {
+  CHECK(flush_policy.batch_size > 0 &&
+        flush_policy.batch_size < kLaneCapacity);
+  flush_batch_size_ = flush_policy.batch_size;
+  flush_max_delay_ms_ = flush_policy.max_delay_ms;
+}
+
+void LinuxTracingSession::WaitForFlush() {
+  WaitForFlushDue();
+  ResetUnflushedEventCounts();
+}
+
+void LinuxTracingSession::WaitForFlushDue() {
+  absl::MutexLock lock(&flush_mutex_);
+  flush_mutex_.Await(absl::Condition(
+      this, &LinuxTracingSession::IsFlushRequestedOrHasUnflushedEvents));
+  if (!flush_requested_) {
+    absl::Time deadline = first_unflushed_event_time_ +
+                          absl::Milliseconds(flush_max_delay_ms_.load());
+    flush_mutex_.AwaitWithDeadline(absl::Condition(&flush_requested_),
+                                   deadline);
+  }
+
+  flush_requested_ = false;
+  has_unflushed_events_ = false;
+}
+
+void LinuxTracingSession::ResetUnflushedEventCounts() {
+  // Everything recorded until now is about to be read. Events recorded from
+  // now on but read in the same pass at most cause an early wake-up.
+  for (Lane* lane : GetLanes()) {
+    lane->num_unflushed.exchange(0);
+  }
+}
 
-void LinuxTracingSession::RecordContextSwitch(ContextSwitch&& context_switch) {
-  absl::MutexLock lock(&context_switch_buffer_mutex_);
-  context_switch_buffer_.push_back(std::move(context_switch));
+void LinuxTracingSession::RecordCoreActivity(CoreActivity&& core_activity) {
+  if (!filter_.AcceptsThread(core_activity.tid)) return;
+  Lane* lane = GetLaneOfCurrentThread();
+  Push(lane, &lane->core_activities, std::move(core_activity));
+}
+
+void LinuxTracingSession::RecordThreadStateChange(
+    ThreadStateChange&& thread_state_change) {
+  if (!filter_.AcceptsThread(thread_state_change.thread_id)) return;
+  Lane* lane = GetLaneOfCurrentThread();
+  Push(lane, &lane->thread_state_changes, std::move(thread_state_change));
 }
 
 void LinuxTracingSession::RecordTimer(Timer&& timer) {
-  absl::MutexLock lock(&timer_buffer_mutex_);
-  timer_buffer_.push_back(std::move(timer));
+  if (!filter_.AcceptsTimer(timer)) return;
+  Lane* lane = GetLaneOfCurrentThread();
+  Push(lane, &lane->timers, std::move(timer));
 }
 
 void LinuxTracingSession::RecordCallstack(LinuxCallstackEvent&& event) {
-  absl::MutexLock lock(&callstack_buffer_mutex_);
-  callstack_buffer_.push_back(std::move(event));
+  RecordCallstack(GetLaneOfCurrentThread(), std::move(event));
 }
 
 void LinuxTracingSession::RecordHashedCallstack(
     CallstackEvent&& hashed_call_stack) {
-  absl::MutexLock lock(&hashed_callstack_buffer_mutex_);
-  hashed_callstack_buffer_.push_back(std::move(hashed_call_stack));
+  RecordHashedCallstack(GetLaneOfCurrentThread(),
+                        std::move(hashed_call_stack));
+}
+
+void LinuxTracingSession::RecordOffCpuCallstack(
+    OffCpuCallstackEvent&& event) {
+  if (!filter_.AcceptsThread(event.m_Event.m_CS.m_ThreadId)) return;
+  Lane* lane = GetLaneOfCurrentThread();
+  Push(lane, &lane->off_cpu_callstacks, std::move(event));
+}
+
+void LinuxTracingSession::RecordCoreActivities(
+    std::vector<CoreActivity>&& core_activities) {
+  Lane* lane = GetLaneOfCurrentThread();
+  for (CoreActivity& core_activity : core_activities) {
+    if (!filter_.AcceptsThread(core_activity.tid)) continue;
+    Push(lane, &lane->core_activities, std::move(core_activity));
+  }
+}
+
+void LinuxTracingSession::RecordThreadStateChanges(
+    std::vector<ThreadStateChange>&& thread_state_changes) {
+  Lane* lane = GetLaneOfCurrentThread();
+  for (ThreadStateChange& thread_state_change : thread_state_changes) {
+    if (!filter_.AcceptsThread(thread_state_change.thread_id)) continue;
+    Push(lane, &lane->thread_state_changes, std::move(thread_state_change));
+  }
+}
+
+void LinuxTracingSession::RecordTimers(std::vector<Timer>&& timers) {
+  Lane* lane = GetLaneOfCurrentThread();
+  for (Timer& timer : timers) {
+    if (!filter_.AcceptsTimer(timer)) continue;
+    Push(lane, &lane->timers, std::move(timer));
+  }
+}
+
+void LinuxTracingSession::RecordCallstacks(
+    std::vector<LinuxCallstackEvent>&& events) {
+  Lane* lane = GetLaneOfCurrentThread();
+  for (LinuxCallstackEvent& event : events) {
+    RecordCallstack(lane, std::move(event));
+  }
+}
+
+void LinuxTracingSession::RecordHashedCallstacks(
+    std::vector<CallstackEvent>&& events) {
+  Lane* lane = GetLaneOfCurrentThread();
+  for (CallstackEvent& event : events) {
+    RecordHashedCallstack(lane, std::move(event));
+  }
+}
+
+void LinuxTracingSession::RecordCallstack(Lane* lane,
+                                          LinuxCallstackEvent&& event) {
+  if (!filter_.AcceptsThread(event.m_CS.m_ThreadId)) {
+    KeepFilteredOutCallstack(std::move(event));
+    return;
+  }
+  Push(lane, &lane->callstacks, std::move(event));
+}
+
+void LinuxTracingSession::RecordHashedCallstack(Lane* lane,
+                                                CallstackEvent&& event) {
+  if (!filter_.AcceptsThread(event.m_TID)) return;
+  if (has_filtered_out_callstacks_) {
+    std::optional<LinuxCallstackEvent> callstack =
+        TakeFilteredOutCallstack(event);
+    if (callstack.has_value()) {
+      Push(lane, &lane->callstacks, std::move(callstack.value()));
+      return;
+    }
+  }
+  if (filter_.SamplesAsHistograms()) {
+    AddToSampleHistogram(event);
+    // Counts as an event for the flush policy, the histogram being read with
+    // the lanes.
+    OnEventPushed(lane);
+    return;
+  }
+  Push(lane, &lane->hashed_callstacks, std::move(event));
+}
+
+void LinuxTracingSession::KeepFilteredOutCallstack(
+    LinuxCallstackEvent&& event) {
+  absl::MutexLock lock(&filter_mutex_);
+  CallstackID id = event.m_CS.Hash();
+  filtered_out_callstacks_.try_emplace(id, std::move(event.m_CS));
+  has_filtered_out_callstacks_ = true;
+}
+
+std::optional<LinuxCallstackEvent>
+LinuxTracingSession::TakeFilteredOutCallstack(const CallstackEvent& event) {
+  absl::MutexLock lock(&filter_mutex_);
+  auto it = filtered_out_callstacks_.find(event.m_Id);
+  if (it == filtered_out_callstacks_.end()) {
+    return std::nullopt;
+  }
+  LinuxCallstackEvent callstack;
+  callstack.m_time = event.m_Time;
+  callstack.m_numCallstacks = 1;
+  callstack.m_CS = std::move(it->second);
+  callstack.m_CS.m_ThreadId = event.m_TID;
+  filtered_out_callstacks_.erase(it);
+  return callstack;
+}
+
+void LinuxTracingSession::AddToSampleHistogram(const CallstackEvent& event) {
+  absl::MutexLock lock(&histogram_mutex_);
+  SampleCount& sample_count = sample_histogram_[{event.m_TID, event.m_Id}];
+  sample_count.callstack_id = event.m_Id;
+  sample_count.thread_id = event.m_TID;
+  sample_count.time = std::max(sample_count.time,
+                               static_cast<uint64_t>(event.m_Time));
+  ++sample_count.count;
+}
+
+void LinuxTracingSession::SetCaptureFilter(const CaptureFilter& filter) {
+  filter_ = CaptureEventFilter(filter);
+  absl::MutexLock lock(&filter_mutex_);
+  filtered_out_callstacks_.clear();
+  has_filtered_out_callstacks_ = false;
 }
 
 void LinuxTracingSession::SetStringManager(
@@ -36,85 +298,214 @@ void LinuxTracingSession::SetStringManager(
 
 void LinuxTracingSession::SendKeyAndString(
     uint64_t key, const std::string& str) {
-  KeyAndString key_and_string;
-  key_and_string.key = key;
-  key_and_string.str = str;
-  // TODO: This is not atomic, we might end up sending multiple keys
-  // maybe change it to AddIfDoesNotExists()
-  if (!string_manager_->Exists(key)) {
-    std::string message_data = SerializeObjectBinary(key_and_string);
-    // TODO: Remove networking from here.
-    tcp_server_->Send(Msg_KeyAndString, message_data.c_str(),
-                     message_data.size());
-    string_manager_->Add(key, str);
-  }
-}
-
-bool LinuxTracingSession::ReadAllContextSwitches(
-    std::vector<ContextSwitch>* buffer) {
-  absl::MutexLock lock(&context_switch_buffer_mutex_);
-  if (context_switch_buffer_.empty()) {
-    return false;
+  // Only one of the threads adding a new key queues it, and known keys don't
+  // take any lock.
+  if (string_manager_->Add(key, str)) {
+    absl::MutexLock lock(&strings_mutex_);
+    new_strings_.push_back(KeyAndString{key, str});
   }
+}
+
+void LinuxTracingSession::SendKernelFrameSymbols(
+    std::vector<KernelFrameSymbol>&& symbols) {
+  absl::MutexLock lock(&strings_mutex_);
+  new_kernel_frame_symbols_.insert(new_kernel_frame_symbols_.end(),
+                                   symbols.begin(), symbols.end());
+}
 
-  *buffer = std::move(context_switch_buffer_);
-  context_switch_buffer_.clear();
+void LinuxTracingSession::SendThreadName(const ThreadNameKey& thread_name) {
+  absl::MutexLock lock(&strings_mutex_);
+  new_thread_names_.push_back(thread_name);
+}
+
+void LinuxTracingSession::RecordServiceStat(const std::string& name,
+                                            double value, uint64_t begin_ns,
+                                            uint64_t end_ns) {
+  uint64_t key = StringHash(name);
+  SendKeyAndString(key, name);
+
+  Timer timer;
+  {
+    absl::MutexLock lock(&service_stats_mutex_);
+    timer.m_TID =
+        service_stat_thread_ids_
+            .try_emplace(key, kFirstServiceStatThreadId +
+                                  service_stat_thread_ids_.size())
+            .first->second;
+  }
+  timer.m_Type = Timer::SERVICE_STATS;
+  timer.m_Start = begin_ns;
+  timer.m_End = end_ns;
+  timer.m_UserData[0] = key;
+  timer.m_UserData[1] = absl::bit_cast<uint64_t>(value);
+  RecordTimer(std::move(timer));
+}
+
+void LinuxTracingSession::RecordBranchCounts(
+    std::vector<BranchCount>&& branch_counts) {
+  absl::MutexLock lock(&branch_counts_mutex_);
+  if (branch_counts_.empty()) {
+    branch_counts_ = std::move(branch_counts);
+  } else {
+    branch_counts_.insert(branch_counts_.end(), branch_counts.begin(),
+                          branch_counts.end());
+  }
+}
+
+bool LinuxTracingSession::ReadAllKeysAndStrings(
+    std::vector<KeyAndString>* buffer) {
+  absl::MutexLock lock(&strings_mutex_);
+  if (new_strings_.empty()) {
+    return false;
+  }
+  buffer->insert(buffer->end(), std::make_move_iterator(new_strings_.begin()),
+                 std::make_move_iterator(new_strings_.end()));
+  new_strings_.clear();
   return true;
 }
 
-bool LinuxTracingSession::ReadAllTimers(std::vector<Timer>* buffer) {
-  absl::MutexLock lock(&timer_buffer_mutex_);
-  if (timer_buffer_.empty()) {
+bool LinuxTracingSession::ReadAllKernelFrameSymbols(
+    std::vector<KernelFrameSymbol>* buffer) {
+  absl::MutexLock lock(&strings_mutex_);
+  if (new_kernel_frame_symbols_.empty()) {
     return false;
   }
+  buffer->insert(buffer->end(), new_kernel_frame_symbols_.begin(),
+                 new_kernel_frame_symbols_.end());
+  new_kernel_frame_symbols_.clear();
+  return true;
+}
 
-  *buffer = std::move(timer_buffer_);
-  timer_buffer_.clear();
+bool LinuxTracingSession::ReadAllThreadNames(
+    std::vector<ThreadNameKey>* buffer) {
+  absl::MutexLock lock(&strings_mutex_);
+  if (new_thread_names_.empty()) {
+    return false;
+  }
+  // The tracer reports the renames of different cores out of order.
+  std::stable_sort(new_thread_names_.begin(), new_thread_names_.end(),
+                   [](const ThreadNameKey& lhs, const ThreadNameKey& rhs) {
+                     return lhs.time < rhs.time;
+                   });
+  buffer->insert(buffer->end(), new_thread_names_.begin(),
+                 new_thread_names_.end());
+  new_thread_names_.clear();
   return true;
 }
 
-bool LinuxTracingSession::ReadAllCallstacks(
-    std::vector<LinuxCallstackEvent>* buffer) {
-  absl::MutexLock lock(&callstack_buffer_mutex_);
-  if (callstack_buffer_.empty()) {
+template <typename T>
+bool LinuxTracingSession::ReadAll(SpscQueue<T> Lane::*queue,
+                                  std::vector<T>* buffer) {
+  absl::MutexLock lock(&read_mutex_);
+  std::vector<T> events;
+  for (Lane* lane : GetLanes()) {
+    (lane->*queue).PopAll(&events);
+    lane->dropping = false;
+  }
+  if (events.empty()) {
     return false;
   }
 
-  *buffer = std::move(callstack_buffer_);
-  callstack_buffer_.clear();
+  *buffer = std::move(events);
   return true;
 }
 
+bool LinuxTracingSession::ReadAllCoreActivities(
+    std::vector<CoreActivity>* buffer) {
+  return ReadAll(&Lane::core_activities, buffer);
+}
+
+bool LinuxTracingSession::ReadAllThreadStateChanges(
+    std::vector<ThreadStateChange>* buffer) {
+  return ReadAll(&Lane::thread_state_changes, buffer);
+}
+
+bool LinuxTracingSession::ReadAllTimers(std::vector<Timer>* buffer) {
+  return ReadAll(&Lane::timers, buffer);
+}
+
+bool LinuxTracingSession::ReadAllCallstacks(
+    std::vector<LinuxCallstackEvent>* buffer) {
+  return ReadAll(&Lane::callstacks, buffer);
+}
+
 bool LinuxTracingSession::ReadAllHashedCallstacks(
     std::vector<CallstackEvent>* buffer) {
-  absl::MutexLock lock(&hashed_callstack_buffer_mutex_);
-  if (hashed_callstack_buffer_.empty()) {
+  return ReadAll(&Lane::hashed_callstacks, buffer);
+}
+
+bool LinuxTracingSession::ReadAllOffCpuCallstacks(
+    std::vector<OffCpuCallstackEvent>* buffer) {
+  return ReadAll(&Lane::off_cpu_callstacks, buffer);
+}
+
+bool LinuxTracingSession::ReadBranchCounts(std::vector<BranchCount>* buffer) {
+  absl::MutexLock lock(&branch_counts_mutex_);
+  if (branch_counts_.empty()) {
     return false;
   }
+  buffer->clear();
+  buffer->swap(branch_counts_);
+  return true;
+}
 
-  *buffer = std::move(hashed_callstack_buffer_);
-  hashed_callstack_buffer_.clear();
+bool LinuxTracingSession::ReadSampleHistogram(
+    std::vector<SampleCount>* buffer) {
+  absl::MutexLock lock(&histogram_mutex_);
+  if (sample_histogram_.empty()) {
+    return false;
+  }
+  buffer->clear();
+  buffer->reserve(sample_histogram_.size());
+  for (const auto& [key, sample_count] : sample_histogram_) {
+    buffer->push_back(sample_count);
+  }
+  sample_histogram_.clear();
   return true;
 }
 
 void LinuxTracingSession::Reset() {
+  std::vector<CoreActivity> core_activities;
+  std::vector<ThreadStateChange> thread_state_changes;
+  std::vector<Timer> timers;
+  std::vector<LinuxCallstackEvent> callstacks;
+  std::vector<CallstackEvent> hashed_callstacks;
+  std::vector<OffCpuCallstackEvent> off_cpu_callstacks;
+  ReadAllCoreActivities(&core_activities);
+  ReadAllThreadStateChanges(&thread_state_changes);
+  ReadAllTimers(&timers);
+  ReadAllCallstacks(&callstacks);
+  ReadAllHashedCallstacks(&hashed_callstacks);
+  ReadAllOffCpuCallstacks(&off_cpu_callstacks);
+  std::vector<SampleCount> sample_histogram;
+  ReadSampleHistogram(&sample_histogram);
+  std::vector<BranchCount> branch_counts;
+  ReadBranchCounts(&branch_counts);
   {
-    absl::MutexLock lock(&context_switch_buffer_mutex_);
-    context_switch_buffer_.clear();
+    // The callstack ids are only known to the capture that sent them.
+    absl::MutexLock lock(&filter_mutex_);
+    filtered_out_callstacks_.clear();
+    has_filtered_out_callstacks_ = false;
   }
 
-  {
-    absl::MutexLock lock(&timer_buffer_mutex_);
-    timer_buffer_.clear();
+  for (Lane* lane : GetLanes()) {
+    lane->num_unflushed = 0;
+    lane->num_waits = 0;
+    lane->num_dropped = 0;
   }
 
-  {
-    absl::MutexLock lock(&callstack_buffer_mutex_);
-    callstack_buffer_.clear();
-  }
+  absl::MutexLock lock(&flush_mutex_);
+  flush_requested_ = false;
+  has_unflushed_events_ = false;
+}
 
-  {
-    absl::MutexLock lock(&hashed_callstack_buffer_mutex_);
-    hashed_callstack_buffer_.clear();
+LinuxTracingSession::LaneStats LinuxTracingSession::GetLaneStats() {
+  LaneStats stats;
+  for (Lane* lane : GetLanes()) {
+    stats.num_waits += lane->num_waits;
+    stats.num_dropped += lane->num_dropped;
+    stats.num_unflushed += lane->num_unflushed;
+    ++stats.num_lanes;
   }
+  return stats;
 }
@@ -1,57 +1,231 @@
 #ifndef ORBIT_CORE_LINUX_TRACING_SESSION_H_
 #define ORBIT_CORE_LINUX_TRACING_SESSION_H_
 
-#include "ContextSwitch.h"
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "BranchProfile.h"
+#include "CaptureFilter.h"
+#include "CoreActivity.h"
 #include "EventBuffer.h"
+#include "KeyAndString.h"
 #include "LinuxCallstackEvent.h"
+#include "LinuxSymbol.h"
 #include "ScopeTimer.h"
+#include "SpscQueue.h"
 #include "StringManager.h"
 #include "TcpServer.h"
+#include "ThreadStateTimeline.h"
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 
 // This class stores information about tracing session
 // and provides thread-safe access and record functions.
+//
+// Each thread recording events gets its own lane of lock-free single-producer
+// single-consumer queues, so that producers never contend with each other nor
+// with the thread reading the events. Lanes are bounded: when a queue is full,
+// the producer waits for the reader to drain it, and after
+// kMaxProducerWaitMs it drops events until the reader catches up.
+//
+// Instead of polling, the reader waits in WaitForFlush until the events are
+// due to be read according to the FlushPolicy: once a lane holds batch_size
+// events, or once the oldest unread event is max_delay_ms old. Producers only
+// signal the reader for the first event after a read and when a lane reaches
+// batch_size, not for every event.
+//
+// The events that don't pass the CaptureFilter are dropped when recorded,
+// before taking any room in the lanes.
 class LinuxTracingSession {
  public:
   explicit LinuxTracingSession(TcpServer* tcp_server);
   LinuxTracingSession(const LinuxTracingSession&) = delete;
   LinuxTracingSession& operator=(const LinuxTracingSession&) = delete;
 
-  void RecordContextSwitch(ContextSwitch&& context_switch);
+  void RecordCoreActivity(CoreActivity&& core_activity);
+  void RecordThreadStateChange(ThreadStateChange&& thread_state_change);
   void RecordTimer(Timer&& timer);
   void RecordCallstack(LinuxCallstackEvent&& event);
   void RecordHashedCallstack(CallstackEvent&& event);
+  void RecordOffCpuCallstack(OffCpuCallstackEvent&& event);
+
+  // Like the functions above, for a whole batch at once.
+  void RecordCoreActivities(std::vector<CoreActivity>&& core_activities);
+  void RecordThreadStateChanges(
+      std::vector<ThreadStateChange>&& thread_state_changes);
+  void RecordTimers(std::vector<Timer>&& timers);
+  void RecordCallstacks(std::vector<LinuxCallstackEvent>&& events);
+  void RecordHashedCallstacks(std::vector<CallstackEvent>&& events);
+
+  // Only to be called while no events are recorded, between captures.
+  void SetCaptureFilter(const CaptureFilter& filter);
 
   void SetStringManager(std::shared_ptr<StringManager> string_manager);
+  // Queues the string to be sent with the recorded events, unless its key was
+  // already queued before.
   void SendKeyAndString(uint64_t hash, const std::string& name);
+  // Queues the symbols of kernel frames to be sent with the recorded events.
+  // The strings of their names have to be sent before.
+  void SendKernelFrameSymbols(std::vector<KernelFrameSymbol>&& symbols);
+  // Queues the new name of a thread, whose string has to be sent before.
+  void SendThreadName(const ThreadNameKey& thread_name);
+
+  // Records the value of a statistic of the service over [begin_ns, end_ns)
+  // as a Timer::SERVICE_STATS timer, on a track of its own per name.
+  void RecordServiceStat(const std::string& name, double value,
+                         uint64_t begin_ns, uint64_t end_ns);
+  // Queues the branches counted by the tracer since its previous counts.
+  void RecordBranchCounts(std::vector<BranchCount>&& branch_counts);
+  // Thread ids of the tracks of the statistics. Like the GPU timelines, they
+  // are not of actual threads.
+  static constexpr uint32_t kFirstServiceStatThreadId = 200000;
 
   // These move the content of corresponding buffer to
   // the output vector. They return true if the buffer
-  // is not empty.
-  bool ReadAllContextSwitches(std::vector<ContextSwitch>* buffer);
+  // is not empty. Events recorded by the same thread keep their order.
+  bool ReadAllCoreActivities(std::vector<CoreActivity>* buffer);
+  bool ReadAllThreadStateChanges(std::vector<ThreadStateChange>* buffer);
   bool ReadAllTimers(std::vector<Timer>* buffer);
   bool ReadAllCallstacks(std::vector<LinuxCallstackEvent>* buffer);
   bool ReadAllHashedCallstacks(std::vector<CallstackEvent>* buffer);
+  bool ReadAllOffCpuCallstacks(std::vector<OffCpuCallstackEvent>* buffer);
+  // The samples counted instead of being recorded as hashed callstacks, with
+  // CaptureFilter::samples_as_histograms.
+  bool ReadSampleHistogram(std::vector<SampleCount>* buffer);
+  bool ReadBranchCounts(std::vector<BranchCount>* buffer);
+  // Not cleared by Reset: the keys stay known by the string manager.
+  bool ReadAllKeysAndStrings(std::vector<KeyAndString>* buffer);
+  // Also not cleared by Reset. Read before the strings, which then include
+  // the names of these symbols.
+  bool ReadAllKernelFrameSymbols(std::vector<KernelFrameSymbol>* buffer);
+  // Also not cleared by Reset, sorted by time. Read before the strings too.
+  bool ReadAllThreadNames(std::vector<ThreadNameKey>* buffer);
 
   void Reset();
 
+  struct FlushPolicy {
+    // Number of events recorded by a thread, of all kinds, that makes the
+    // reader wake up. Has to be lower than kLaneCapacity.
+    size_t batch_size = 4 * 1024;
+    // Maximum time for which a recorded event is left unread.
+    uint64_t max_delay_ms = 20;
+  };
+  void SetFlushPolicy(const FlushPolicy& flush_policy);
+
+  // Only called by the reader. Blocks until the events recorded so far are
+  // due to be read, or until WakeUpReader is called. Without events, it keeps
+  // waiting.
+  void WaitForFlush();
+  void WakeUpReader();
+
+  struct LaneStats {
+    // Number of events for which the producer found its queue full and had to
+    // wait for the reader.
+    uint64_t num_waits = 0;
+    // Number of events dropped because the reader didn't keep up.
+    uint64_t num_dropped = 0;
+    uint64_t num_lanes = 0;
+    // Events recorded since the reader last woke up, over all lanes.
+    uint64_t num_unflushed = 0;
+  };
+  // Sum over all lanes since the last Reset.
+  LaneStats GetLaneStats();
+
+  // Capacity of each queue of each lane. The slots are allocated when a thread
+  // first records into the session, a few MB per thread.
+  static constexpr size_t kLaneCapacity = 16 * 1024;
+  static constexpr uint64_t kMaxProducerWaitMs = 10;
+
  private:
   // Buffering data to send large messages instead of small ones.
-  absl::Mutex context_switch_buffer_mutex_;
-  std::vector<ContextSwitch> context_switch_buffer_;
+  struct Lane {
+    SpscQueue<CoreActivity> core_activities{kLaneCapacity};
+    SpscQueue<ThreadStateChange> thread_state_changes{kLaneCapacity};
+    SpscQueue<Timer> timers{kLaneCapacity};
+    SpscQueue<LinuxCallstackEvent> callstacks{kLaneCapacity};
+    SpscQueue<CallstackEvent> hashed_callstacks{kLaneCapacity};
+    SpscQueue<OffCpuCallstackEvent> off_cpu_callstacks{kLaneCapacity};
+    // Events recorded since the reader last woke up.
+    std::atomic<size_t> num_unflushed = 0;
+    std::atomic<uint64_t> num_waits = 0;
+    std::atomic<uint64_t> num_dropped = 0;
+    // Set by the producer when it gave up waiting, cleared by the reader.
+    std::atomic<bool> dropping = false;
+  };
+
+  Lane* GetLaneOfCurrentThread();
+  std::vector<Lane*> GetLanes();
+
+  template <typename T>
+  void Push(Lane* lane, SpscQueue<T>* queue, T&& event);
+  void RecordCallstack(Lane* lane, LinuxCallstackEvent&& event);
+  void RecordHashedCallstack(Lane* lane, CallstackEvent&& event);
+  // The callstacks of the threads filtered out are kept, as the hashed
+  // callstacks of the other threads can refer to them. The first such hashed
+  // callstack is then recorded as a full callstack instead.
+  void KeepFilteredOutCallstack(LinuxCallstackEvent&& event);
+  std::optional<LinuxCallstackEvent> TakeFilteredOutCallstack(
+      const CallstackEvent& event);
+  void AddToSampleHistogram(const CallstackEvent& event);
+  void OnEventPushed(Lane* lane);
+  void OnFirstUnflushedEvent();
+  void RequestFlush();
+  bool IsFlushRequestedOrHasUnflushedEvents()
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(flush_mutex_);
+  void WaitForFlushDue();
+  void ResetUnflushedEventCounts();
+  template <typename T>
+  bool ReadAll(SpscQueue<T> Lane::*queue, std::vector<T>* buffer);
 
-  absl::Mutex timer_buffer_mutex_;
-  std::vector<Timer> timer_buffer_;
+  // Identifies this session in the thread-local lane caches.
+  const uint64_t id_;
 
-  absl::Mutex callstack_buffer_mutex_;
-  std::vector<LinuxCallstackEvent> callstack_buffer_;
+  absl::Mutex lanes_mutex_;
+  // Lanes are only destroyed with the session, as producers keep pointers.
+  std::unordered_map<std::thread::id, std::unique_ptr<Lane>> lanes_;
 
-  absl::Mutex hashed_callstack_buffer_mutex_;
-  std::vector<CallstackEvent> hashed_callstack_buffer_;
+  // Ensures a single consumer at a time for the queues of the lanes.
+  absl::Mutex read_mutex_;
+
+  std::atomic<size_t> flush_batch_size_ = FlushPolicy{}.batch_size;
+  std::atomic<uint64_t> flush_max_delay_ms_ = FlushPolicy{}.max_delay_ms;
+  absl::Mutex flush_mutex_;
+  // Set by the first event recorded in each lane after the reader woke up,
+  // so that only that event takes flush_mutex_.
+  bool has_unflushed_events_ ABSL_GUARDED_BY(flush_mutex_) = false;
+  absl::Time first_unflushed_event_time_ ABSL_GUARDED_BY(flush_mutex_);
+  bool flush_requested_ ABSL_GUARDED_BY(flush_mutex_) = false;
+
+  CaptureEventFilter filter_;
+  absl::Mutex filter_mutex_;
+  absl::flat_hash_map<CallstackID, CallStack> filtered_out_callstacks_
+      ABSL_GUARDED_BY(filter_mutex_);
+  // Whether filtered_out_callstacks_ is not empty, so that recording a hashed
+  // callstack only takes filter_mutex_ when a thread filter is in use.
+  std::atomic<bool> has_filtered_out_callstacks_ = false;
+  absl::Mutex histogram_mutex_;
+  absl::flat_hash_map<std::pair<ThreadID, CallstackID>, SampleCount>
+      sample_histogram_ ABSL_GUARDED_BY(histogram_mutex_);
+  absl::Mutex branch_counts_mutex_;
+  std::vector<BranchCount> branch_counts_ ABSL_GUARDED_BY(branch_counts_mutex_);
 
   TcpServer* tcp_server_;
   std::shared_ptr<StringManager> string_manager_;
+  absl::Mutex strings_mutex_;
+  std::vector<KeyAndString> new_strings_ ABSL_GUARDED_BY(strings_mutex_);
+  std::vector<KernelFrameSymbol> new_kernel_frame_symbols_
+      ABSL_GUARDED_BY(strings_mutex_);
+  std::vector<ThreadNameKey> new_thread_names_ ABSL_GUARDED_BY(strings_mutex_);
+
+  absl::Mutex service_stats_mutex_;
+  absl::flat_hash_map<uint64_t, uint32_t> service_stat_thread_ids_
+      ABSL_GUARDED_BY(service_stats_mutex_);
 };
 
 #endif  // ORBIT_CORE_LINUX_TRACING_SESSION_H_
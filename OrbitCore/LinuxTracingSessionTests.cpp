@@ -3,14 +3,23 @@
 #include <gmock/gmock-matchers.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <chrono>
+#include <thread>
 #include <utility>
 
+#include "absl/base/casts.h"
+
 TEST(LinuxTracingSession, Empty) {
   LinuxTracingSession session(nullptr);
 
-  std::vector<ContextSwitch> context_switches;
-  EXPECT_FALSE(session.ReadAllContextSwitches(&context_switches));
-  EXPECT_TRUE(context_switches.empty());
+  std::vector<CoreActivity> core_activities;
+  EXPECT_FALSE(session.ReadAllCoreActivities(&core_activities));
+  EXPECT_TRUE(core_activities.empty());
+
+  std::vector<ThreadStateChange> thread_state_changes;
+  EXPECT_FALSE(session.ReadAllThreadStateChanges(&thread_state_changes));
+  EXPECT_TRUE(thread_state_changes.empty());
 
   std::vector<Timer> timers;
   EXPECT_FALSE(session.ReadAllTimers(&timers));
@@ -25,70 +34,78 @@ TEST(LinuxTracingSession, Empty) {
   EXPECT_TRUE(hashed_callstacks.empty());
 }
 
-TEST(LinuxTracingSession, ContextSwitches) {
+TEST(LinuxTracingSession, CoreActivities) {
   LinuxTracingSession session(nullptr);
 
-  {
-    ContextSwitch context_switch;
-    context_switch.m_ThreadId = 1;
-    context_switch.m_Type = ContextSwitch::Out;
-    context_switch.m_Time = 87;
-    context_switch.m_ProcessorIndex = 7;
-    context_switch.m_ProcessorNumber = 8;
-
-    session.RecordContextSwitch(std::move(context_switch));
-  }
+  session.RecordCoreActivity(CoreActivity{78, 87, 1, 7});
+  session.RecordCoreActivity(CoreActivity{80, 90, 2, 17});
 
-  {
-    ContextSwitch context_switch;
+  std::vector<CoreActivity> core_activities;
+  EXPECT_TRUE(session.ReadAllCoreActivities(&core_activities));
+  EXPECT_FALSE(session.ReadAllCoreActivities(&core_activities));
 
-    context_switch.m_ThreadId = 2;
-    context_switch.m_Type = ContextSwitch::In;
-    context_switch.m_Time = 78;
-    context_switch.m_ProcessorIndex = 17;
-    context_switch.m_ProcessorNumber = 18;
+  ASSERT_EQ(core_activities.size(), 2);
 
-    session.RecordContextSwitch(std::move(context_switch));
-  }
+  EXPECT_EQ(core_activities[0].begin_time, 78);
+  EXPECT_EQ(core_activities[0].end_time, 87);
+  EXPECT_EQ(core_activities[0].tid, 1);
+  EXPECT_EQ(core_activities[0].core, 7);
+
+  EXPECT_EQ(core_activities[1].begin_time, 80);
+  EXPECT_EQ(core_activities[1].end_time, 90);
+  EXPECT_EQ(core_activities[1].tid, 2);
+  EXPECT_EQ(core_activities[1].core, 17);
 
-  std::vector<ContextSwitch> context_switches;
-  EXPECT_TRUE(session.ReadAllContextSwitches(&context_switches));
-  EXPECT_FALSE(session.ReadAllContextSwitches(&context_switches));
+  session.RecordCoreActivities({CoreActivity{180, 187, 12, 27}});
 
-  EXPECT_EQ(context_switches.size(), 2);
+  // Check that the vector is reset, even if it was not empty
+  EXPECT_TRUE(session.ReadAllCoreActivities(&core_activities));
+  EXPECT_FALSE(session.ReadAllCoreActivities(&core_activities));
 
-  EXPECT_EQ(context_switches[0].m_ThreadId, 1);
-  EXPECT_EQ(context_switches[0].m_Time, 87);
-  EXPECT_EQ(context_switches[0].m_ProcessorIndex, 7);
-  EXPECT_EQ(context_switches[0].m_ProcessorNumber, 8);
+  ASSERT_EQ(core_activities.size(), 1);
 
-  EXPECT_EQ(context_switches[1].m_ThreadId, 2);
-  EXPECT_EQ(context_switches[1].m_Time, 78);
-  EXPECT_EQ(context_switches[1].m_ProcessorIndex, 17);
-  EXPECT_EQ(context_switches[1].m_ProcessorNumber, 18);
+  EXPECT_EQ(core_activities[0].begin_time, 180);
+  EXPECT_EQ(core_activities[0].end_time, 187);
+  EXPECT_EQ(core_activities[0].tid, 12);
+  EXPECT_EQ(core_activities[0].core, 27);
+}
+
+TEST(LinuxTracingSession, ThreadStateChanges) {
+  LinuxTracingSession session(nullptr);
 
   {
-    ContextSwitch context_switch;
+    ThreadStateChange thread_state_change;
+    thread_state_change.time = 11;
+    thread_state_change.thread_id = 1;
+    thread_state_change.waker_thread_id = 2;
+    thread_state_change.state = ThreadStateChange::kRunnable;
+
+    session.RecordThreadStateChange(std::move(thread_state_change));
+  }
 
-    context_switch.m_ThreadId = 12;
-    context_switch.m_Type = ContextSwitch::Out;
-    context_switch.m_Time = 187;
-    context_switch.m_ProcessorIndex = 27;
-    context_switch.m_ProcessorNumber = 28;
+  {
+    ThreadStateChange thread_state_change;
+    thread_state_change.time = 12;
+    thread_state_change.thread_id = 1;
+    thread_state_change.state = ThreadStateChange::kRunning;
 
-    session.RecordContextSwitch(std::move(context_switch));
+    session.RecordThreadStateChange(std::move(thread_state_change));
   }
 
-  // Check that the vector is reset, even if it was not empty
-  EXPECT_TRUE(session.ReadAllContextSwitches(&context_switches));
-  EXPECT_FALSE(session.ReadAllContextSwitches(&context_switches));
+  std::vector<ThreadStateChange> thread_state_changes;
+  EXPECT_TRUE(session.ReadAllThreadStateChanges(&thread_state_changes));
+  EXPECT_FALSE(session.ReadAllThreadStateChanges(&thread_state_changes));
 
-  EXPECT_EQ(context_switches.size(), 1);
+  ASSERT_EQ(thread_state_changes.size(), 2);
 
-  EXPECT_EQ(context_switches[0].m_ThreadId, 12);
-  EXPECT_EQ(context_switches[0].m_Time, 187);
-  EXPECT_EQ(context_switches[0].m_ProcessorIndex, 27);
-  EXPECT_EQ(context_switches[0].m_ProcessorNumber, 28);
+  EXPECT_EQ(thread_state_changes[0].time, 11);
+  EXPECT_EQ(thread_state_changes[0].thread_id, 1);
+  EXPECT_EQ(thread_state_changes[0].waker_thread_id, 2);
+  EXPECT_EQ(thread_state_changes[0].state, ThreadStateChange::kRunnable);
+
+  EXPECT_EQ(thread_state_changes[1].time, 12);
+  EXPECT_EQ(thread_state_changes[1].waker_thread_id, 0);
+  EXPECT_EQ(thread_state_changes[1].state, ThreadStateChange::kRunning);
 }
 
 TEST(LinuxTracingSession, Timers) {
@@ -301,19 +318,132 @@ TEST(LinuxTracingSession, HashedCallstacks) {
   EXPECT_EQ(callstacks[0].m_TID, 33);
 }
 
+TEST(LinuxTracingSession, Batches) {
+  LinuxTracingSession session(nullptr);
+
+  session.RecordHashedCallstack(CallstackEvent(11, 12, 13));
+  session.RecordHashedCallstacks(
+      {CallstackEvent(21, 22, 23), CallstackEvent(31, 32, 33)});
+  session.RecordHashedCallstacks({});
+
+  std::vector<CallstackEvent> callstacks;
+  EXPECT_TRUE(session.ReadAllHashedCallstacks(&callstacks));
+  ASSERT_EQ(callstacks.size(), 3);
+  EXPECT_EQ(callstacks[0].m_Time, 11);
+  EXPECT_EQ(callstacks[1].m_Time, 21);
+  EXPECT_EQ(callstacks[2].m_Time, 31);
+
+  std::vector<Timer> timers(2);
+  timers[0].m_Start = 100;
+  timers[1].m_Start = 200;
+  session.RecordTimers(std::move(timers));
+
+  std::vector<Timer> read_timers;
+  EXPECT_TRUE(session.ReadAllTimers(&read_timers));
+  ASSERT_EQ(read_timers.size(), 2);
+  EXPECT_EQ(read_timers[0].m_Start, 100);
+  EXPECT_EQ(read_timers[1].m_Start, 200);
+  EXPECT_FALSE(session.ReadAllTimers(&read_timers));
+}
+
+TEST(LinuxTracingSession, EventsFromSeveralThreads) {
+  LinuxTracingSession session(nullptr);
+
+  session.RecordHashedCallstack(CallstackEvent(11, 12, 13));
+  std::thread other_thread([&session] {
+    session.RecordHashedCallstack(CallstackEvent(21, 22, 23));
+    session.RecordHashedCallstack(CallstackEvent(31, 32, 33));
+  });
+  other_thread.join();
+
+  std::vector<CallstackEvent> callstacks;
+  EXPECT_TRUE(session.ReadAllHashedCallstacks(&callstacks));
+  ASSERT_EQ(callstacks.size(), 3);
+  std::sort(callstacks.begin(), callstacks.end(),
+            [](const CallstackEvent& lhs, const CallstackEvent& rhs) {
+              return lhs.m_Time < rhs.m_Time;
+            });
+  EXPECT_EQ(callstacks[0].m_Time, 11);
+  EXPECT_EQ(callstacks[1].m_Time, 21);
+  EXPECT_EQ(callstacks[2].m_Time, 31);
+}
+
+TEST(LinuxTracingSession, DropsEventsWhenLaneIsFull) {
+  LinuxTracingSession session(nullptr);
+
+  std::vector<CallstackEvent> events(LinuxTracingSession::kLaneCapacity);
+  session.RecordHashedCallstacks(std::move(events));
+  EXPECT_EQ(session.GetLaneStats().num_waits, 0);
+
+  // Nobody reads the events: the first one waits and is dropped, the
+  // following ones are dropped right away.
+  session.RecordHashedCallstack(CallstackEvent(11, 12, 13));
+  session.RecordHashedCallstack(CallstackEvent(21, 22, 23));
+  EXPECT_EQ(session.GetLaneStats().num_waits, 1);
+  EXPECT_EQ(session.GetLaneStats().num_dropped, 2);
+
+  std::vector<CallstackEvent> callstacks;
+  EXPECT_TRUE(session.ReadAllHashedCallstacks(&callstacks));
+  EXPECT_EQ(callstacks.size(), LinuxTracingSession::kLaneCapacity);
+
+  session.RecordHashedCallstack(CallstackEvent(31, 32, 33));
+  EXPECT_TRUE(session.ReadAllHashedCallstacks(&callstacks));
+  ASSERT_EQ(callstacks.size(), 1);
+  EXPECT_EQ(callstacks[0].m_Time, 31);
+
+  session.Reset();
+  EXPECT_EQ(session.GetLaneStats().num_dropped, 0);
+}
+
+TEST(LinuxTracingSession, WaitForFlushReturnsAtBatchSize) {
+  LinuxTracingSession session(nullptr);
+  session.SetFlushPolicy({/*batch_size=*/3, /*max_delay_ms=*/60 * 60 * 1000});
+
+  std::thread producer([&session] {
+    session.RecordHashedCallstack(CallstackEvent(11, 12, 13));
+    session.RecordTimers(std::vector<Timer>(2));
+  });
+  session.WaitForFlush();
+  producer.join();
+
+  std::vector<CallstackEvent> callstacks;
+  EXPECT_TRUE(session.ReadAllHashedCallstacks(&callstacks));
+  std::vector<Timer> timers;
+  EXPECT_TRUE(session.ReadAllTimers(&timers));
+  EXPECT_EQ(timers.size(), 2);
+}
+
+TEST(LinuxTracingSession, WaitForFlushReturnsAfterMaxDelay) {
+  constexpr uint64_t kMaxDelayMs = 50;
+  LinuxTracingSession session(nullptr);
+  session.SetFlushPolicy({/*batch_size=*/1000, kMaxDelayMs});
+
+  auto start = std::chrono::steady_clock::now();
+  session.RecordHashedCallstack(CallstackEvent(11, 12, 13));
+  session.WaitForFlush();
+  EXPECT_GE(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(kMaxDelayMs));
+
+  std::vector<CallstackEvent> callstacks;
+  EXPECT_TRUE(session.ReadAllHashedCallstacks(&callstacks));
+  EXPECT_EQ(callstacks.size(), 1);
+}
+
+TEST(LinuxTracingSession, WakeUpReaderWithoutEvents) {
+  LinuxTracingSession session(nullptr);
+
+  std::thread other_thread([&session] { session.WakeUpReader(); });
+  session.WaitForFlush();
+  other_thread.join();
+
+  std::vector<CallstackEvent> callstacks;
+  EXPECT_FALSE(session.ReadAllHashedCallstacks(&callstacks));
+}
+
 TEST(LinuxTracingSession, Reset) {
   LinuxTracingSession session(nullptr);
 
-  {
-    ContextSwitch context_switch;
-    context_switch.m_ThreadId = 1;
-    context_switch.m_Type = ContextSwitch::Out;
-    context_switch.m_Time = 87;
-    context_switch.m_ProcessorIndex = 7;
-    context_switch.m_ProcessorNumber = 8;
-
-    session.RecordContextSwitch(std::move(context_switch));
-  }
+  session.RecordCoreActivity(CoreActivity{78, 87, 1, 7});
 
   {
     Timer timer;
@@ -347,10 +477,12 @@ TEST(LinuxTracingSession, Reset) {
 
   session.RecordHashedCallstack(CallstackEvent(11, 12, 13));
 
+  session.RecordThreadStateChange(ThreadStateChange{});
+
   session.Reset();
 
-  std::vector<ContextSwitch> context_switches;
-  EXPECT_FALSE(session.ReadAllContextSwitches(&context_switches));
+  std::vector<CoreActivity> core_activities;
+  EXPECT_FALSE(session.ReadAllCoreActivities(&core_activities));
 
   std::vector<Timer> timers;
   EXPECT_FALSE(session.ReadAllTimers(&timers));
@@ -360,4 +492,223 @@ TEST(LinuxTracingSession, Reset) {
 
   std::vector<CallstackEvent> hashed_callstacks;
   EXPECT_FALSE(session.ReadAllHashedCallstacks(&hashed_callstacks));
+
+  std::vector<ThreadStateChange> thread_state_changes;
+  EXPECT_FALSE(session.ReadAllThreadStateChanges(&thread_state_changes));
+}
+
+TEST(LinuxTracingSession, KeysAndStrings) {
+  LinuxTracingSession session(nullptr);
+  session.SetStringManager(std::make_shared<StringManager>());
+
+  session.SendKeyAndString(1, "one");
+  session.SendKeyAndString(2, "two");
+  session.SendKeyAndString(1, "one");
+
+  std::vector<KeyAndString> keys_and_strings;
+  EXPECT_TRUE(session.ReadAllKeysAndStrings(&keys_and_strings));
+  ASSERT_EQ(keys_and_strings.size(), 2);
+  EXPECT_EQ(keys_and_strings[0].key, 1);
+  EXPECT_EQ(keys_and_strings[0].str, "one");
+  EXPECT_EQ(keys_and_strings[1].key, 2);
+  EXPECT_EQ(keys_and_strings[1].str, "two");
+
+  // Strings already sent are not sent again, not even after a reset.
+  session.Reset();
+  session.SendKeyAndString(2, "two");
+  keys_and_strings.clear();
+  EXPECT_FALSE(session.ReadAllKeysAndStrings(&keys_and_strings));
+  EXPECT_TRUE(keys_and_strings.empty());
+}
+
+TEST(LinuxTracingSession, KernelFrameSymbols) {
+  LinuxTracingSession session(nullptr);
+  session.SetStringManager(std::make_shared<StringManager>());
+
+  session.SendKeyAndString(1, "schedule");
+  session.SendKernelFrameSymbols({{0xffffffff81000010, 0xffffffff81000000, 1},
+                                  {0xffffffff81000020, 0xffffffff81000000, 1}});
+
+  std::vector<KernelFrameSymbol> symbols;
+  EXPECT_TRUE(session.ReadAllKernelFrameSymbols(&symbols));
+  ASSERT_EQ(symbols.size(), 2);
+  EXPECT_EQ(symbols[0].address, 0xffffffff81000010);
+  EXPECT_EQ(symbols[1].function_address, 0xffffffff81000000);
+  EXPECT_EQ(symbols[1].name_key, 1);
+  symbols.clear();
+  EXPECT_FALSE(session.ReadAllKernelFrameSymbols(&symbols));
+
+  // Their names are read afterwards.
+  std::vector<KeyAndString> keys_and_strings;
+  EXPECT_TRUE(session.ReadAllKeysAndStrings(&keys_and_strings));
+  ASSERT_EQ(keys_and_strings.size(), 1);
+  EXPECT_EQ(keys_and_strings[0].str, "schedule");
+}
+
+TEST(LinuxTracingSession, ThreadNamesAreReadInTimeOrder) {
+  LinuxTracingSession session(nullptr);
+  session.SetStringManager(std::make_shared<StringManager>());
+
+  session.SendThreadName({300, 10, 2});
+  session.SendThreadName({100, 10, 1});
+  session.SendThreadName({200, 11, 1});
+
+  std::vector<ThreadNameKey> thread_names;
+  EXPECT_TRUE(session.ReadAllThreadNames(&thread_names));
+  ASSERT_EQ(thread_names.size(), 3);
+  EXPECT_EQ(thread_names[0].time, 100);
+  EXPECT_EQ(thread_names[1].thread_id, 11);
+  EXPECT_EQ(thread_names[2].name_key, 2);
+  thread_names.clear();
+  EXPECT_FALSE(session.ReadAllThreadNames(&thread_names));
+}
+
+TEST(LinuxTracingSession, ServiceStats) {
+  LinuxTracingSession session(nullptr);
+  session.SetStringManager(std::make_shared<StringManager>());
+
+  session.RecordServiceStat("events/s", 1500.0, 100, 200);
+  session.RecordServiceStat("buffered events", 3.0, 100, 200);
+  session.RecordServiceStat("events/s", 0.25, 200, 300);
+
+  std::vector<Timer> timers;
+  EXPECT_TRUE(session.ReadAllTimers(&timers));
+  ASSERT_EQ(timers.size(), 3);
+  for (const Timer& timer : timers) {
+    EXPECT_EQ(timer.m_Type, Timer::SERVICE_STATS);
+  }
+  // One track per statistic.
+  EXPECT_EQ(timers[0].m_TID, timers[2].m_TID);
+  EXPECT_NE(timers[0].m_TID, timers[1].m_TID);
+  EXPECT_GE(timers[0].m_TID, LinuxTracingSession::kFirstServiceStatThreadId);
+  EXPECT_GE(timers[1].m_TID, LinuxTracingSession::kFirstServiceStatThreadId);
+
+  EXPECT_EQ(timers[0].m_Start, 100);
+  EXPECT_EQ(timers[0].m_End, 200);
+  EXPECT_EQ(absl::bit_cast<double>(timers[0].m_UserData[1]), 1500.0);
+  EXPECT_EQ(absl::bit_cast<double>(timers[2].m_UserData[1]), 0.25);
+  EXPECT_EQ(timers[0].m_UserData[0], timers[2].m_UserData[0]);
+
+  // The names are sent once.
+  std::vector<KeyAndString> keys_and_strings;
+  EXPECT_TRUE(session.ReadAllKeysAndStrings(&keys_and_strings));
+  ASSERT_EQ(keys_and_strings.size(), 2);
+  EXPECT_EQ(keys_and_strings[0].key, timers[0].m_UserData[0]);
+  EXPECT_EQ(keys_and_strings[0].str, "events/s");
+  EXPECT_EQ(keys_and_strings[1].key, timers[1].m_UserData[0]);
+  EXPECT_EQ(keys_and_strings[1].str, "buffered events");
+}
+
+TEST(LinuxTracingSession, CaptureFilterDropsEventsOfOtherThreads) {
+  LinuxTracingSession session(nullptr);
+  CaptureFilter filter;
+  filter.thread_ids = {1};
+  session.SetCaptureFilter(filter);
+
+  session.RecordCoreActivities(
+      {CoreActivity{10, 20, 1, 0}, CoreActivity{10, 20, 2, 1}});
+  session.RecordThreadStateChange(ThreadStateChange{30, 2});
+  Timer gpu_timer;
+  gpu_timer.m_Type = Timer::GPU_ACTIVITY;
+  gpu_timer.m_TID = 100000;
+  session.RecordTimer(std::move(gpu_timer));
+
+  std::vector<CoreActivity> core_activities;
+  EXPECT_TRUE(session.ReadAllCoreActivities(&core_activities));
+  ASSERT_EQ(core_activities.size(), 1);
+  EXPECT_EQ(core_activities[0].tid, 1);
+  std::vector<ThreadStateChange> thread_state_changes;
+  EXPECT_FALSE(session.ReadAllThreadStateChanges(&thread_state_changes));
+  // GPU jobs are not on tracks of threads.
+  std::vector<Timer> timers;
+  EXPECT_TRUE(session.ReadAllTimers(&timers));
+}
+
+TEST(LinuxTracingSession, CaptureFilterKeepsCallstacksOfOtherThreads) {
+  LinuxTracingSession session(nullptr);
+  CaptureFilter filter;
+  filter.thread_ids = {1};
+  session.SetCaptureFilter(filter);
+
+  LinuxCallstackEvent event;
+  event.m_time = 100;
+  event.m_CS.m_ThreadId = 2;
+  event.m_CS.m_Data = {0x10, 0x20};
+  event.m_CS.m_Depth = 2;
+  CallstackID id = event.m_CS.Hash();
+  session.RecordCallstack(std::move(event));
+  std::vector<LinuxCallstackEvent> callstacks;
+  EXPECT_FALSE(session.ReadAllCallstacks(&callstacks));
+
+  // The first sample of the callstack on thread 1 carries its frames, as they
+  // were never sent.
+  session.RecordHashedCallstacks(
+      {CallstackEvent(200, id, 2), CallstackEvent(300, id, 1),
+       CallstackEvent(400, id, 1)});
+  EXPECT_TRUE(session.ReadAllCallstacks(&callstacks));
+  ASSERT_EQ(callstacks.size(), 1);
+  EXPECT_EQ(callstacks[0].m_time, 300);
+  EXPECT_EQ(callstacks[0].m_CS.m_ThreadId, 1);
+  EXPECT_EQ(callstacks[0].m_CS.m_Data, (std::vector<uint64_t>{0x10, 0x20}));
+  std::vector<CallstackEvent> hashed_callstacks;
+  EXPECT_TRUE(session.ReadAllHashedCallstacks(&hashed_callstacks));
+  ASSERT_EQ(hashed_callstacks.size(), 1);
+  EXPECT_EQ(hashed_callstacks[0].m_Time, 400);
+}
+
+TEST(LinuxTracingSession, CaptureFilterOfTimers) {
+  LinuxTracingSession session(nullptr);
+  CaptureFilter filter;
+  filter.function_addresses = {0x100, 0x200};
+  filter.min_timer_duration_ns = 50;
+  session.SetCaptureFilter(filter);
+
+  auto make_timer = [](uint64_t function_address, uint64_t duration) {
+    Timer timer;
+    timer.m_FunctionAddress = function_address;
+    timer.m_Start = 1000;
+    timer.m_End = 1000 + duration;
+    return timer;
+  };
+  session.RecordTimers({make_timer(0x100, 60), make_timer(0x100, 40),
+                        make_timer(0x300, 60), make_timer(0x200, 50)});
+  Timer introspection_timer = make_timer(0, 1);
+  introspection_timer.m_Type = Timer::INTROSPECTION;
+  session.RecordTimer(std::move(introspection_timer));
+
+  std::vector<Timer> timers;
+  EXPECT_TRUE(session.ReadAllTimers(&timers));
+  ASSERT_EQ(timers.size(), 3);
+  EXPECT_EQ(timers[0].m_FunctionAddress, 0x100);
+  EXPECT_EQ(timers[1].m_FunctionAddress, 0x200);
+  EXPECT_EQ(timers[2].m_Type, Timer::INTROSPECTION);
+}
+
+TEST(LinuxTracingSession, SamplesAsHistograms) {
+  LinuxTracingSession session(nullptr);
+  CaptureFilter filter;
+  filter.samples_as_histograms = true;
+  session.SetCaptureFilter(filter);
+
+  session.RecordHashedCallstacks(
+      {CallstackEvent(100, 7, 1), CallstackEvent(200, 7, 1),
+       CallstackEvent(300, 7, 2), CallstackEvent(400, 8, 1)});
+  std::vector<CallstackEvent> hashed_callstacks;
+  EXPECT_FALSE(session.ReadAllHashedCallstacks(&hashed_callstacks));
+
+  std::vector<SampleCount> sample_histogram;
+  EXPECT_TRUE(session.ReadSampleHistogram(&sample_histogram));
+  std::sort(sample_histogram.begin(), sample_histogram.end(),
+            [](const SampleCount& a, const SampleCount& b) {
+              return a.time < b.time;
+            });
+  ASSERT_EQ(sample_histogram.size(), 3);
+  EXPECT_EQ(sample_histogram[0].callstack_id, 7);
+  EXPECT_EQ(sample_histogram[0].thread_id, 1);
+  EXPECT_EQ(sample_histogram[0].count, 2);
+  EXPECT_EQ(sample_histogram[0].time, 200);
+  EXPECT_EQ(sample_histogram[1].thread_id, 2);
+  EXPECT_EQ(sample_histogram[1].count, 1);
+  EXPECT_EQ(sample_histogram[2].callstack_id, 8);
+  EXPECT_FALSE(session.ReadSampleHistogram(&sample_histogram));
 }
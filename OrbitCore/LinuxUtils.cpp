@@ -20,41 +20,57 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstdlib>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <sstream>
 #include <string>
 
 #include "Callstack.h"
 #include "Capture.h"
 #include "ConnectionManager.h"
+#include "ElfFile.h"
 #include "EventBuffer.h"
 #include "OrbitModule.h"
 #include "OrbitProcess.h"
 #include "Path.h"
 #include "PrintVar.h"
+#include "ProcFsReader.h"
 #include "SamplingProfiler.h"
 #include "ScopeTimer.h"
 #include "TcpClient.h"
 #include "Utils.h"
 #include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
 
 namespace LinuxUtils {
 
+namespace {
+// Keeps the CPU times of the processes from one call of GetCpuUtilization to
+// the next, to compute the usage in between.
+absl::Mutex cpu_utilization_mutex;
+ProcFsReader cpu_utilization_reader ABSL_GUARDED_BY(cpu_utilization_mutex);
+}  // namespace
+
 //-----------------------------------------------------------------------------
 std::vector<std::string> ListModules(pid_t a_PID) {
   std::vector<std::string> modules;
-  // TODO: we should read the file directly instead or memory map it.
-  std::string result =
-      ExecuteCommand(absl::StrFormat("cat /proc/%u/maps", a_PID).c_str());
-
-  std::stringstream ss(result);
-  std::string line;
-  while (std::getline(ss, line, '\n')) {
-    modules.push_back(line);
+  static thread_local ProcFsReader reader;
+  std::optional<std::string_view> maps =
+      reader.ReadFile(absl::StrFormat("/proc/%u/maps", a_PID));
+  if (!maps.has_value()) {
+    return modules;
+  }
+
+  size_t begin = 0;
+  while (begin < maps->size()) {
+    size_t end = std::min(maps->find('\n', begin), maps->size());
+    modules.emplace_back(maps->substr(begin, end - begin));
+    begin = end + 1;
   }
 
   return modules;
@@ -96,8 +112,19 @@ void ListModules(pid_t a_PID,
       auto addresses = Tokenize(tokens[0], "-");
       if (addresses.size() == 2) {
         auto iter = modules.find(moduleName);
-        std::shared_ptr<Module> module =
-            (iter == modules.end()) ? std::make_shared<Module>() : iter->second;
+        std::shared_ptr<Module> module;
+        if (iter != modules.end()) {
+          module = iter->second;
+        } else {
+          module = std::make_shared<Module>();
+          // Identifies the module's symbols across processes and sessions.
+          if (Path::FileExists(moduleName)) {
+            std::unique_ptr<ElfFile> elf_file = ElfFile::Create(moduleName);
+            if (elf_file != nullptr) {
+              module->m_DebugSignature = elf_file->GetBuildId();
+            }
+          }
+        }
 
         uint64_t start = std::stoull(addresses[0], nullptr, 16);
         uint64_t end = std::stoull(addresses[1], nullptr, 16);
@@ -134,30 +161,12 @@ uint32_t GetPID(const char* a_Name) {
 
 //-----------------------------------------------------------------------------
 std::unordered_map<uint32_t, float> GetCpuUtilization() {
-  std::unordered_map<uint32_t, float> processMap;
-  std::string result = ExecuteCommand(
-      "top -b -n 1 | sed -n '8, 1000{s/^ *//;s/ *$//;s/  */,/gp;};1000q'");
-  std::stringstream ss(result);
-  std::string line;
-
-  while (std::getline(ss, line, '\n')) {
-    auto tokens = Tokenize(line, ",");
-    if (tokens.size() > 8) {
-      uint32_t pid = atoi(tokens[0].c_str());
-      float cpu = atof(tokens[8].c_str());
-      processMap[pid] = cpu;
-    }
-  }
-
-  return processMap;
+  absl::MutexLock lock(&cpu_utilization_mutex);
+  return cpu_utilization_reader.GetCpuUtilization();
 }
 
 //-----------------------------------------------------------------------------
-bool Is64Bit(pid_t a_PID) {
-  std::string result =
-      ExecuteCommand(absl::StrFormat("file -L /proc/%u/exe", a_PID).c_str());
-  return Contains(result, "64-bit");
-}
+bool Is64Bit(pid_t a_PID) { return ProcFsReader::Is64Bit(a_PID); }
 
 //-----------------------------------------------------------------------------
 double GetSecondsFromNanos(uint64_t a_Nanos) {
@@ -0,0 +1,83 @@
+#include "LiveAllocationTable.h"
+
+#include <utility>
+
+void LiveAllocationTable::Insert(uint64_t address, uint64_t size,
+                                 uint32_t site_index) {
+  if (address == 0) {
+    return;
+  }
+  // At most 3/4 full, past which probes get long.
+  if ((size_ + 1) * 4 > entries_.size() * 3) {
+    Grow();
+  }
+
+  Entry& entry = entries_[FindSlot(address)];
+  if (entry.address == 0) {
+    ++size_;
+  }
+  entry = {address, size, site_index};
+}
+
+std::optional<LiveAllocationTable::Entry> LiveAllocationTable::Remove(
+    uint64_t address) {
+  if (address == 0 || size_ == 0) {
+    return std::nullopt;
+  }
+  size_t slot = FindSlot(address);
+  if (entries_[slot].address == 0) {
+    return std::nullopt;
+  }
+
+  Entry removed = entries_[slot];
+  --size_;
+  // Moves back the entries of the run after the slot that can go there, so
+  // that every entry stays reachable from its home slot without gaps.
+  size_t mask = entries_.size() - 1;
+  size_t empty = slot;
+  for (size_t next = (slot + 1) & mask; entries_[next].address != 0;
+       next = (next + 1) & mask) {
+    size_t home = GetHomeSlot(entries_[next].address);
+    // Whether home is cyclically in (empty, next], in which case the entry
+    // must stay after empty.
+    bool stays = empty <= next ? (empty < home && home <= next)
+                               : (empty < home || home <= next);
+    if (!stays) {
+      entries_[empty] = entries_[next];
+      empty = next;
+    }
+  }
+  entries_[empty] = {};
+  return removed;
+}
+
+void LiveAllocationTable::Clear() {
+  entries_.clear();
+  entries_.shrink_to_fit();
+  size_ = 0;
+}
+
+size_t LiveAllocationTable::GetHomeSlot(uint64_t address) const {
+  // Fibonacci hashing, as allocations are aligned and their low bits carry
+  // little information.
+  return (address * 0x9e3779b97f4a7c15ull) >> 32 & (entries_.size() - 1);
+}
+
+size_t LiveAllocationTable::FindSlot(uint64_t address) const {
+  size_t mask = entries_.size() - 1;
+  size_t slot = GetHomeSlot(address);
+  while (entries_[slot].address != 0 && entries_[slot].address != address) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+void LiveAllocationTable::Grow() {
+  std::vector<Entry> entries = std::move(entries_);
+  entries_.assign(entries.empty() ? kMinCapacity : entries.size() * 2, Entry{});
+  for (const Entry& entry : entries) {
+    if (entry.address != 0) {
+      entries_[FindSlot(entry.address)] = entry;
+    }
+  }
+}
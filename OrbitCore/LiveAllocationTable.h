@@ -0,0 +1,45 @@
+#ifndef ORBIT_CORE_LIVE_ALLOCATION_TABLE_H_
+#define ORBIT_CORE_LIVE_ALLOCATION_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Live allocations of the target by address: their size and the call site
+// that made them. There can be millions, each added and removed once, so they
+// are kept in a flat open addressing table with linear probing, 24 bytes per
+// slot, rather than in nodes of a map. Removal shifts the following entries
+// back instead of leaving tombstones, so that probes stay short however many
+// allocations come and go. Address 0 marks empty slots.
+class LiveAllocationTable {
+ public:
+  struct Entry {
+    uint64_t address;
+    uint64_t size;
+    uint32_t site_index;
+  };
+
+  // Adds an allocation, replacing the one at the same address if any.
+  void Insert(uint64_t address, uint64_t size, uint32_t site_index);
+  // Removes the allocation at address and returns it, nullopt if none.
+  std::optional<Entry> Remove(uint64_t address);
+  void Clear();
+
+  size_t size() const { return size_; }
+  // Of the slots, for the memory used.
+  size_t capacity() const { return entries_.size(); }
+
+ private:
+  static constexpr size_t kMinCapacity = 1024;
+
+  size_t GetHomeSlot(uint64_t address) const;
+  // Slot of address, or the empty slot where it would go.
+  size_t FindSlot(uint64_t address) const;
+  void Grow();
+
+  std::vector<Entry> entries_;
+  size_t size_ = 0;
+};
+
+#endif  // ORBIT_CORE_LIVE_ALLOCATION_TABLE_H_
@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <unordered_map>
+
+#include "LiveAllocationTable.h"
+
+TEST(LiveAllocationTable, InsertsReplacesAndRemoves) {
+  LiveAllocationTable table;
+  EXPECT_FALSE(table.Remove(0x1000).has_value());
+
+  table.Insert(0x1000, 16, 1);
+  table.Insert(0x2000, 32, 2);
+  table.Insert(0x1000, 64, 3);
+  EXPECT_EQ(table.size(), 2);
+
+  std::optional<LiveAllocationTable::Entry> entry = table.Remove(0x1000);
+  ASSERT_TRUE(entry.has_value());
+  EXPECT_EQ(entry->size, 64);
+  EXPECT_EQ(entry->site_index, 3);
+  EXPECT_FALSE(table.Remove(0x1000).has_value());
+  EXPECT_EQ(table.size(), 1);
+
+  table.Insert(0, 8, 4);
+  EXPECT_EQ(table.size(), 1);
+
+  table.Clear();
+  EXPECT_EQ(table.size(), 0);
+  EXPECT_FALSE(table.Remove(0x2000).has_value());
+}
+
+TEST(LiveAllocationTable, MatchesAMapUnderChurn) {
+  LiveAllocationTable table;
+  std::unordered_map<uint64_t, uint64_t> expected;
+  std::mt19937_64 random(42);
+  for (int i = 0; i < 200000; ++i) {
+    // Few distinct addresses, so that removals hit runs of collisions.
+    uint64_t address = (random() % 5000 + 1) * 16;
+    if (random() % 3 != 0) {
+      uint64_t size = random() % 1000;
+      table.Insert(address, size, static_cast<uint32_t>(size));
+      expected[address] = size;
+    } else {
+      std::optional<LiveAllocationTable::Entry> entry = table.Remove(address);
+      auto it = expected.find(address);
+      ASSERT_EQ(entry.has_value(), it != expected.end());
+      if (entry.has_value()) {
+        EXPECT_EQ(entry->size, it->second);
+        expected.erase(it);
+      }
+    }
+    ASSERT_EQ(table.size(), expected.size());
+  }
+
+  for (const auto& [address, size] : expected) {
+    std::optional<LiveAllocationTable::Entry> entry = table.Remove(address);
+    ASSERT_TRUE(entry.has_value());
+    EXPECT_EQ(entry->size, size);
+  }
+  EXPECT_EQ(table.size(), 0);
+}
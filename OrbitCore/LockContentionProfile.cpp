@@ -0,0 +1,58 @@
+#include "LockContentionProfile.h"
+
+#include <algorithm>
+
+void LockContentionProfile::AddLockWait(uint64_t lock_address, CallstackID id,
+                                        uint64_t wait_ns) {
+  absl::MutexLock lock(&mutex_);
+  Entry& entry = entries_[{lock_address, id}];
+  entry.lock_address = lock_address;
+  entry.callstack_id = id;
+  ++entry.count;
+  entry.total_wait_ns += wait_ns;
+  entry.max_wait_ns = std::max(entry.max_wait_ns, wait_ns);
+  ++wait_count_;
+}
+
+std::vector<LockContentionProfile::Entry> LockContentionProfile::GetEntries()
+    const {
+  std::vector<Entry> entries;
+  {
+    absl::MutexLock lock(&mutex_);
+    entries.reserve(entries_.size());
+    for (const auto& [key, entry] : entries_) {
+      entries.push_back(entry);
+    }
+  }
+  std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+    return a.total_wait_ns > b.total_wait_ns;
+  });
+  return entries;
+}
+
+uint64_t LockContentionProfile::GetWaitCount() const {
+  absl::MutexLock lock(&mutex_);
+  return wait_count_;
+}
+
+void LockContentionProfile::Clear() {
+  absl::MutexLock lock(&mutex_);
+  entries_.clear();
+  wait_count_ = 0;
+}
+
+size_t LockContentionProfile::FindCallSiteFrame(
+    const CallStack& callstack,
+    const std::function<uint64_t(uint64_t)>& get_module_base) {
+  size_t depth = std::min<size_t>(callstack.m_Depth, callstack.m_Data.size());
+  if (depth == 0) {
+    return 0;
+  }
+  uint64_t locking_module_base = get_module_base(callstack.m_Data[0]);
+  for (size_t i = 1; i < depth; ++i) {
+    if (get_module_base(callstack.m_Data[i]) != locking_module_base) {
+      return i;
+    }
+  }
+  return 0;
+}
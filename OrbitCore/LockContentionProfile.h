@@ -0,0 +1,52 @@
+#ifndef ORBIT_CORE_LOCK_CONTENTION_PROFILE_H_
+#define ORBIT_CORE_LOCK_CONTENTION_PROFILE_H_
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "Callstack.h"
+#include "CallstackTypes.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
+// Long lock waits of the threads of the target during a capture, per lock
+// address and per callstack that waited, from the Timer::LOCK_WAIT timers of
+// the service (see Params::m_LockWaitThresholdNs). As for PageFaultProfile,
+// the callstacks are only looked up when the report is shown.
+class LockContentionProfile {
+ public:
+  struct Entry {
+    uint64_t lock_address = 0;
+    CallstackID callstack_id = 0;
+    uint64_t count = 0;
+    uint64_t total_wait_ns = 0;
+    uint64_t max_wait_ns = 0;
+  };
+
+  void AddLockWait(uint64_t lock_address, CallstackID id, uint64_t wait_ns);
+  // By decreasing total wait.
+  std::vector<Entry> GetEntries() const;
+  // The number of waits added since the last Clear, to tell when the entries
+  // changed.
+  uint64_t GetWaitCount() const;
+  bool IsEmpty() const { return GetWaitCount() == 0; }
+  void Clear();
+
+  // The frame of callstack that called into the locking code: the first one
+  // outside the module of the innermost frame, which made the futex syscall
+  // from libc or libpthread, with get_module_base giving the base address of
+  // the module of an address. 0 if all frames are in that module.
+  static size_t FindCallSiteFrame(
+      const CallStack& callstack,
+      const std::function<uint64_t(uint64_t)>& get_module_base);
+
+ private:
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<std::pair<uint64_t, CallstackID>, Entry> entries_
+      ABSL_GUARDED_BY(mutex_);
+  uint64_t wait_count_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+#endif  // ORBIT_CORE_LOCK_CONTENTION_PROFILE_H_
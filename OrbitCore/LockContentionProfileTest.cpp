@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+
+#include "LockContentionProfile.h"
+
+TEST(LockContentionProfile, AggregatesWaitsPerLockAndCallstack) {
+  LockContentionProfile profile;
+  EXPECT_TRUE(profile.IsEmpty());
+
+  constexpr uint64_t kLock = 0x7f0000001000;
+  constexpr uint64_t kOtherLock = 0x7f0000002000;
+  constexpr CallstackID kId = 0x1234;
+  profile.AddLockWait(kLock, kId, 1000);
+  profile.AddLockWait(kLock, kId, 5000);
+  profile.AddLockWait(kOtherLock, kId, 2000);
+
+  EXPECT_FALSE(profile.IsEmpty());
+  EXPECT_EQ(profile.GetWaitCount(), 3);
+  std::vector<LockContentionProfile::Entry> entries = profile.GetEntries();
+  ASSERT_EQ(entries.size(), 2);
+  EXPECT_EQ(entries[0].lock_address, kLock);
+  EXPECT_EQ(entries[0].callstack_id, kId);
+  EXPECT_EQ(entries[0].count, 2);
+  EXPECT_EQ(entries[0].total_wait_ns, 6000);
+  EXPECT_EQ(entries[0].max_wait_ns, 5000);
+  EXPECT_EQ(entries[1].lock_address, kOtherLock);
+  EXPECT_EQ(entries[1].total_wait_ns, 2000);
+
+  profile.Clear();
+  EXPECT_TRUE(profile.IsEmpty());
+  EXPECT_TRUE(profile.GetEntries().empty());
+}
+
+TEST(LockContentionProfile, FindsTheFirstFrameOutsideTheLockingModule) {
+  // libpthread at 0x1000, the executable at 0x8000.
+  auto get_module_base = [](uint64_t address) -> uint64_t {
+    return address >= 0x8000 ? 0x8000 : 0x1000;
+  };
+  CallStack callstack;
+  callstack.m_Data = {0x1100, 0x1200, 0x8100, 0x8200};
+  callstack.m_Depth = 4;
+  EXPECT_EQ(LockContentionProfile::FindCallSiteFrame(callstack,
+                                                     get_module_base),
+            2);
+
+  callstack.m_Data = {0x1100, 0x1200};
+  callstack.m_Depth = 2;
+  EXPECT_EQ(LockContentionProfile::FindCallSiteFrame(callstack,
+                                                     get_module_base),
+            0);
+
+  callstack.m_Data.clear();
+  callstack.m_Depth = 0;
+  EXPECT_EQ(LockContentionProfile::FindCallSiteFrame(callstack,
+                                                     get_module_base),
+            0);
+}
@@ -0,0 +1,163 @@
+#include "LogBuffer.h"
+
+#include <algorithm>
+#include <cctype>
+
+LogBuffer::LogBuffer(size_t max_entries, bool index_trigrams)
+    : max_chunks_(std::max<size_t>(
+          (max_entries + kEntriesPerChunk - 1) / kEntriesPerChunk, 1)),
+      index_trigrams_(index_trigrams) {}
+
+uint64_t LogBuffer::Add(uint64_t time, uint64_t callstack_hash,
+                        uint32_t thread_id, std::string_view text) {
+  if (chunks_.empty() || chunks_.back().entries.size() == kEntriesPerChunk) {
+    if (!chunks_.empty() && index_trigrams_) {
+      IndexTrigrams(&chunks_.back());
+    }
+    if (chunks_.size() == max_chunks_) {
+      begin_id_ += chunks_.front().entries.size();
+      chunks_.pop_front();
+      for (auto it = thread_ids_.begin(); it != thread_ids_.end();) {
+        std::deque<uint64_t>& ids = it->second;
+        while (!ids.empty() && ids.front() < begin_id_) {
+          ids.pop_front();
+        }
+        if (ids.empty()) {
+          thread_ids_.erase(it++);
+        } else {
+          ++it;
+        }
+      }
+    }
+    chunks_.emplace_back();
+    chunks_.back().entries.reserve(kEntriesPerChunk);
+  }
+
+  Chunk& chunk = chunks_.back();
+  chunk.entries.push_back(EntryInfo{time, callstack_hash, thread_id,
+                                    static_cast<uint32_t>(chunk.text.size())});
+  chunk.text.append(text);
+  for (char c : text) {
+    chunk.lower_text.push_back(
+        static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+  }
+  thread_ids_[thread_id].push_back(end_id_);
+  return end_id_++;
+}
+
+void LogBuffer::Clear() {
+  chunks_.clear();
+  thread_ids_.clear();
+  begin_id_ = end_id_;
+}
+
+std::string_view LogBuffer::Chunk::GetText(const std::string& arena,
+                                           size_t index) const {
+  size_t begin = entries[index].offset;
+  size_t end =
+      index + 1 < entries.size() ? entries[index + 1].offset : arena.size();
+  return std::string_view(arena.data() + begin, end - begin);
+}
+
+LogBuffer::Entry LogBuffer::Get(uint64_t id) const {
+  // Only the last chunk isn't full.
+  size_t index = id - begin_id_;
+  const Chunk& chunk = chunks_[index / kEntriesPerChunk];
+  size_t index_in_chunk = index % kEntriesPerChunk;
+  const EntryInfo& info = chunk.entries[index_in_chunk];
+  return Entry{info.time, info.callstack_hash, info.thread_id,
+               chunk.GetText(chunk.text, index_in_chunk)};
+}
+
+void LogBuffer::IndexTrigrams(Chunk* chunk) const {
+  const std::string& text = chunk->lower_text;
+  std::vector<uint32_t>& trigrams = chunk->trigrams;
+  for (size_t i = 0; i < chunk->entries.size(); ++i) {
+    size_t begin = chunk->entries[i].offset;
+    size_t end = i + 1 < chunk->entries.size() ? chunk->entries[i + 1].offset
+                                               : text.size();
+    // The trigrams spanning two lines are not listed.
+    for (size_t j = begin; j + 3 <= end; ++j) {
+      trigrams.push_back(GetTrigram(&text[j]));
+    }
+  }
+  std::sort(trigrams.begin(), trigrams.end());
+  trigrams.erase(std::unique(trigrams.begin(), trigrams.end()),
+                 trigrams.end());
+  trigrams.shrink_to_fit();
+  chunk->has_trigrams = true;
+}
+
+bool LogBuffer::Chunk::MayContain(
+    const std::vector<std::string>& tokens) const {
+  if (!has_trigrams) return true;
+  for (const std::string& token : tokens) {
+    for (size_t i = 0; i + 3 <= token.size(); ++i) {
+      if (!std::binary_search(trigrams.begin(), trigrams.end(),
+                              GetTrigram(&token[i]))) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool LogBuffer::ContainsAll(std::string_view text,
+                            const std::vector<std::string>& tokens) {
+  for (const std::string& token : tokens) {
+    if (text.find(token) == std::string_view::npos) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void LogBuffer::Find(const std::vector<std::string>& tokens, uint64_t begin,
+                     uint64_t end, std::vector<uint64_t>* matches) const {
+  begin = std::max(begin, begin_id_);
+  end = std::min(end, end_id_);
+  while (begin < end) {
+    size_t index = begin - begin_id_;
+    const Chunk& chunk = chunks_[index / kEntriesPerChunk];
+    size_t first = index % kEntriesPerChunk;
+    size_t last = std::min<size_t>(chunk.entries.size(), first + end - begin);
+    if (tokens.empty() || chunk.MayContain(tokens)) {
+      for (size_t i = first; i < last; ++i) {
+        if (ContainsAll(chunk.GetText(chunk.lower_text, i), tokens)) {
+          matches->push_back(begin + (i - first));
+        }
+      }
+    }
+    begin += last - first;
+  }
+}
+
+bool LogBuffer::Matches(uint64_t id,
+                        const std::vector<std::string>& tokens) const {
+  size_t index = id - begin_id_;
+  const Chunk& chunk = chunks_[index / kEntriesPerChunk];
+  return ContainsAll(chunk.GetText(chunk.lower_text, index % kEntriesPerChunk),
+                     tokens);
+}
+
+std::vector<uint64_t> LogBuffer::FindInTimeRange(uint32_t thread_id,
+                                                 uint64_t min_time,
+                                                 uint64_t max_time) const {
+  std::vector<uint64_t> ids;
+  ForEachInTimeRange(thread_id, min_time, max_time,
+                     [&ids](uint64_t id) { ids.push_back(id); });
+  if (thread_id == 0) {
+    std::sort(ids.begin(), ids.end());
+  }
+  return ids;
+}
+
+std::vector<uint32_t> LogBuffer::GetThreadIds() const {
+  std::vector<uint32_t> thread_ids;
+  thread_ids.reserve(thread_ids_.size());
+  for (const auto& pair : thread_ids_) {
+    thread_ids.push_back(pair.first);
+  }
+  std::sort(thread_ids.begin(), thread_ids.end());
+  return thread_ids;
+}
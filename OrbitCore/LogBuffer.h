@@ -0,0 +1,153 @@
+#ifndef ORBIT_CORE_LOG_BUFFER_H_
+#define ORBIT_CORE_LOG_BUFFER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+
+// The log lines of a capture, e.g. from OutputDebugString, which a game can
+// emit by tens of thousands per second. Lines are stored in chunks of
+// kEntriesPerChunk, their texts one after the other in the arena of their
+// chunk, and only the last chunks up to max_entries lines are kept: once
+// full, the oldest chunk is dropped as a whole, so memory stays bounded and
+// no line is ever moved. Lines get increasing ids, which stay valid until
+// they are dropped.
+//
+// Filtering is case-insensitive substring matching of all the tokens. The
+// lowercased text is kept next to the text, and with the trigram index
+// enabled, each full chunk lists the trigrams its lines contain: a chunk
+// missing one of the trigrams of a token is skipped without looking at its
+// lines.
+//
+// The ids of the lines of each thread are also listed, in the order they
+// were added, which is the order of their times: the lines of a thread in a
+// time window, e.g. the selection of the time graph or what it shows of a
+// thread track, are found by binary search.
+class LogBuffer {
+ public:
+  static constexpr size_t kEntriesPerChunk = 4096;
+  static constexpr size_t kDefaultMaxEntries = 1024 * 1024;
+
+  struct Entry {
+    uint64_t time = 0;
+    uint64_t callstack_hash = 0;
+    uint32_t thread_id = 0;
+    std::string_view text;
+  };
+
+  explicit LogBuffer(size_t max_entries = kDefaultMaxEntries,
+                     bool index_trigrams = true);
+
+  // Adds a line and returns its id.
+  uint64_t Add(uint64_t time, uint64_t callstack_hash, uint32_t thread_id,
+               std::string_view text);
+  void Clear();
+
+  // The ids of the lines kept are [begin_id(), end_id()).
+  uint64_t begin_id() const { return begin_id_; }
+  uint64_t end_id() const { return end_id_; }
+  size_t size() const { return end_id_ - begin_id_; }
+  bool empty() const { return end_id_ == begin_id_; }
+  bool Contains(uint64_t id) const { return id >= begin_id_ && id < end_id_; }
+  // The line id, which must be kept. Its text is valid until it is dropped.
+  Entry Get(uint64_t id) const;
+
+  // Appends to matches, in increasing order, the ids in [begin, end) of the
+  // kept lines containing all the tokens, which must be lowercase. Lines
+  // added later are matched by calling it again from the previous end.
+  void Find(const std::vector<std::string>& tokens, uint64_t begin,
+            uint64_t end, std::vector<uint64_t>* matches) const;
+  // Whether the kept line id contains all the tokens, which must be
+  // lowercase.
+  bool Matches(uint64_t id, const std::vector<std::string>& tokens) const;
+
+  // Calls callback(id) for the kept lines of thread_id, or of all threads if
+  // it is 0, with a time in [min_time, max_time], in increasing order of id
+  // for each thread.
+  template <typename Callback>
+  void ForEachInTimeRange(uint32_t thread_id, uint64_t min_time,
+                          uint64_t max_time, Callback&& callback) const;
+  // The ids ForEachInTimeRange visits, in increasing order.
+  std::vector<uint64_t> FindInTimeRange(uint32_t thread_id, uint64_t min_time,
+                                        uint64_t max_time) const;
+  std::vector<uint32_t> GetThreadIds() const;
+
+ private:
+  struct EntryInfo {
+    uint64_t time;
+    uint64_t callstack_hash;
+    uint32_t thread_id;
+    uint32_t offset;
+  };
+  struct Chunk {
+    std::string text;
+    // Same offsets as text.
+    std::string lower_text;
+    std::vector<EntryInfo> entries;
+    // Sorted, once the chunk is full and if trigrams are indexed.
+    std::vector<uint32_t> trigrams;
+    bool has_trigrams = false;
+
+    std::string_view GetText(const std::string& arena, size_t index) const;
+    bool MayContain(const std::vector<std::string>& tokens) const;
+  };
+
+  static uint32_t GetTrigram(const char* text) {
+    return static_cast<uint8_t>(text[0]) |
+           static_cast<uint8_t>(text[1]) << 8 |
+           static_cast<uint8_t>(text[2]) << 16;
+  }
+  static bool ContainsAll(std::string_view text,
+                          const std::vector<std::string>& tokens);
+  void IndexTrigrams(Chunk* chunk) const;
+  uint64_t GetTime(uint64_t id) const { return Get(id).time; }
+  template <typename Callback>
+  void ForEachInTimeRange(const std::deque<uint64_t>& ids, uint64_t min_time,
+                          uint64_t max_time, Callback&& callback) const;
+
+  size_t max_chunks_;
+  bool index_trigrams_;
+  std::deque<Chunk> chunks_;
+  // Ids of the lines of each thread, in increasing order. The dropped ones
+  // are removed with their chunk.
+  absl::flat_hash_map<uint32_t, std::deque<uint64_t>> thread_ids_;
+  uint64_t begin_id_ = 0;
+  uint64_t end_id_ = 0;
+};
+
+template <typename Callback>
+void LogBuffer::ForEachInTimeRange(const std::deque<uint64_t>& ids,
+                                   uint64_t min_time, uint64_t max_time,
+                                   Callback&& callback) const {
+  auto it = std::partition_point(ids.begin(), ids.end(), [&](uint64_t id) {
+    return GetTime(id) < min_time;
+  });
+  for (; it != ids.end(); ++it) {
+    if (GetTime(*it) > max_time) break;
+    callback(*it);
+  }
+}
+
+template <typename Callback>
+void LogBuffer::ForEachInTimeRange(uint32_t thread_id, uint64_t min_time,
+                                   uint64_t max_time,
+                                   Callback&& callback) const {
+  if (thread_id != 0) {
+    auto it = thread_ids_.find(thread_id);
+    if (it != thread_ids_.end()) {
+      ForEachInTimeRange(it->second, min_time, max_time, callback);
+    }
+    return;
+  }
+  for (const auto& pair : thread_ids_) {
+    ForEachInTimeRange(pair.second, min_time, max_time, callback);
+  }
+}
+
+#endif  // ORBIT_CORE_LOG_BUFFER_H_
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "LogBuffer.h"
+
+namespace {
+std::vector<uint64_t> Find(const LogBuffer& buffer,
+                           const std::vector<std::string>& tokens) {
+  std::vector<uint64_t> matches;
+  buffer.Find(tokens, buffer.begin_id(), buffer.end_id(), &matches);
+  return matches;
+}
+}  // namespace
+
+TEST(LogBuffer, KeepsEntries) {
+  LogBuffer buffer;
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_EQ(buffer.Add(10, 20, 30, "Hello World"), 0);
+  EXPECT_EQ(buffer.Add(11, 21, 31, ""), 1);
+  EXPECT_EQ(buffer.Add(12, 22, 32, "bye"), 2);
+  EXPECT_EQ(buffer.size(), 3);
+
+  LogBuffer::Entry entry = buffer.Get(0);
+  EXPECT_EQ(entry.time, 10);
+  EXPECT_EQ(entry.callstack_hash, 20);
+  EXPECT_EQ(entry.thread_id, 30);
+  EXPECT_EQ(entry.text, "Hello World");
+  EXPECT_EQ(buffer.Get(1).text, "");
+  EXPECT_EQ(buffer.Get(2).text, "bye");
+}
+
+TEST(LogBuffer, FindsEntriesContainingAllTokens) {
+  LogBuffer buffer;
+  buffer.Add(0, 0, 0, "Loading Level A");
+  buffer.Add(0, 0, 0, "loaded texture");
+  buffer.Add(0, 0, 0, "level B");
+  EXPECT_EQ(Find(buffer, {"load"}), (std::vector<uint64_t>{0, 1}));
+  EXPECT_EQ(Find(buffer, {"level", "load"}), (std::vector<uint64_t>{0}));
+  EXPECT_EQ(Find(buffer, {}), (std::vector<uint64_t>{0, 1, 2}));
+  EXPECT_TRUE(Find(buffer, {"sound"}).empty());
+}
+
+TEST(LogBuffer, FindsIncrementally) {
+  LogBuffer buffer;
+  buffer.Add(0, 0, 0, "a match");
+  std::vector<uint64_t> matches;
+  uint64_t end = buffer.end_id();
+  buffer.Find({"match"}, 0, end, &matches);
+  buffer.Add(0, 0, 0, "no");
+  buffer.Add(0, 0, 0, "another match");
+  buffer.Find({"match"}, end, buffer.end_id(), &matches);
+  EXPECT_EQ(matches, (std::vector<uint64_t>{0, 2}));
+}
+
+TEST(LogBuffer, DropsOldestChunks) {
+  LogBuffer buffer(2 * LogBuffer::kEntriesPerChunk);
+  size_t num_entries = 3 * LogBuffer::kEntriesPerChunk + 5;
+  for (size_t i = 0; i < num_entries; ++i) {
+    buffer.Add(i, 0, 0, "line " + std::to_string(i));
+  }
+  EXPECT_EQ(buffer.end_id(), num_entries);
+  EXPECT_EQ(buffer.begin_id(), 2 * LogBuffer::kEntriesPerChunk);
+  EXPECT_FALSE(buffer.Contains(buffer.begin_id() - 1));
+  EXPECT_EQ(buffer.Get(buffer.begin_id()).time, buffer.begin_id());
+  EXPECT_EQ(buffer.Get(num_entries - 1).text,
+            "line " + std::to_string(num_entries - 1));
+
+  // Ids that were dropped are not matched.
+  std::vector<uint64_t> matches;
+  buffer.Find({"line 1"}, 0, num_entries, &matches);
+  ASSERT_FALSE(matches.empty());
+  EXPECT_GE(matches.front(), buffer.begin_id());
+}
+
+TEST(LogBuffer, SkipsChunksWithoutTheTrigrams) {
+  for (bool index_trigrams : {false, true}) {
+    LogBuffer buffer(LogBuffer::kDefaultMaxEntries, index_trigrams);
+    for (size_t i = 0; i < 2 * LogBuffer::kEntriesPerChunk; ++i) {
+      buffer.Add(0, 0, 0, i == 5 ? "Rare Event" : "common");
+    }
+    EXPECT_EQ(Find(buffer, {"rare ev"}), (std::vector<uint64_t>{5}));
+    // Trigrams spanning two lines are not a match.
+    EXPECT_TRUE(Find(buffer, {"commonc"}).empty());
+  }
+}
+
+TEST(LogBuffer, ClearKeepsIdsIncreasing) {
+  LogBuffer buffer;
+  buffer.Add(0, 0, 0, "a");
+  buffer.Add(0, 0, 0, "b");
+  buffer.Clear();
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_EQ(buffer.Add(0, 0, 0, "c"), 2);
+  EXPECT_EQ(Find(buffer, {"c"}), (std::vector<uint64_t>{2}));
+}
+
+TEST(LogBuffer, FindsEntriesOfAThreadInATimeRange) {
+  LogBuffer buffer;
+  buffer.Add(10, 0, 1, "a");
+  buffer.Add(15, 0, 2, "b");
+  buffer.Add(20, 0, 1, "c");
+  buffer.Add(25, 0, 2, "d");
+  buffer.Add(30, 0, 1, "e");
+  EXPECT_EQ(buffer.FindInTimeRange(1, 15, 30), (std::vector<uint64_t>{2, 4}));
+  EXPECT_EQ(buffer.FindInTimeRange(2, 0, 20), (std::vector<uint64_t>{1}));
+  EXPECT_EQ(buffer.FindInTimeRange(0, 15, 25),
+            (std::vector<uint64_t>{1, 2, 3}));
+  EXPECT_TRUE(buffer.FindInTimeRange(3, 0, 100).empty());
+  EXPECT_TRUE(buffer.FindInTimeRange(1, 31, 100).empty());
+  EXPECT_EQ(buffer.GetThreadIds(), (std::vector<uint32_t>{1, 2}));
+}
+
+TEST(LogBuffer, TimeRangesSkipDroppedEntries) {
+  LogBuffer buffer(LogBuffer::kEntriesPerChunk);
+  size_t num_entries = LogBuffer::kEntriesPerChunk + 1;
+  for (size_t i = 0; i < num_entries; ++i) {
+    buffer.Add(i, 0, i == 0 ? 2 : 1, "");
+  }
+  EXPECT_EQ(buffer.FindInTimeRange(0, 0, num_entries),
+            (std::vector<uint64_t>{num_entries - 1}));
+  EXPECT_EQ(buffer.GetThreadIds(), (std::vector<uint32_t>{1}));
+}
+
+TEST(LogBuffer, MatchesAnEntry) {
+  LogBuffer buffer;
+  buffer.Add(0, 0, 0, "Frame Done");
+  EXPECT_TRUE(buffer.Matches(0, {"frame", "done"}));
+  EXPECT_TRUE(buffer.Matches(0, {}));
+  EXPECT_FALSE(buffer.Matches(0, {"frame", "start"}));
+}
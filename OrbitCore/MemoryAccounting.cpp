@@ -0,0 +1,118 @@
+#include "MemoryAccounting.h"
+
+#include <array>
+
+#include "Utils.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+
+namespace {
+std::atomic<int64_t> g_bytes[MemoryAccounting::kNumSubsystems];
+std::atomic<uint64_t> g_budgets[MemoryAccounting::kNumSubsystems];
+
+constexpr const char* kNames[MemoryAccounting::kNumSubsystems] = {
+    "other",      "thread_tracks", "event_buffer",  "sampling_profiler",
+    "callstacks", "batcher",       "string_manager"};
+
+size_t GetIndex(MemorySubsystem subsystem) {
+  return static_cast<size_t>(subsystem);
+}
+}  // namespace
+
+namespace MemoryAccounting {
+void Add(MemorySubsystem subsystem, int64_t bytes) {
+  g_bytes[GetIndex(subsystem)].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+uint64_t GetBytes(MemorySubsystem subsystem) {
+  int64_t bytes = g_bytes[GetIndex(subsystem)].load(std::memory_order_relaxed);
+  return bytes > 0 ? static_cast<uint64_t>(bytes) : 0;
+}
+
+uint64_t GetTotalBytes() {
+  uint64_t total = 0;
+  for (size_t i = 0; i < kNumSubsystems; ++i) {
+    total += GetBytes(static_cast<MemorySubsystem>(i));
+  }
+  return total;
+}
+
+const char* GetName(MemorySubsystem subsystem) {
+  return kNames[GetIndex(subsystem)];
+}
+
+void SetBudget(MemorySubsystem subsystem, uint64_t bytes) {
+  g_budgets[GetIndex(subsystem)].store(bytes, std::memory_order_relaxed);
+}
+
+uint64_t GetBudget(MemorySubsystem subsystem) {
+  return g_budgets[GetIndex(subsystem)].load(std::memory_order_relaxed);
+}
+
+void ClearBudgets() {
+  for (size_t i = 0; i < kNumSubsystems; ++i) {
+    SetBudget(static_cast<MemorySubsystem>(i), 0);
+  }
+}
+
+bool SetBudgets(const std::string& budgets) {
+  std::array<uint64_t, kNumSubsystems> parsed = {};
+  for (absl::string_view entry :
+       absl::StrSplit(budgets, ',', absl::SkipWhitespace())) {
+    std::pair<absl::string_view, absl::string_view> name_and_mb =
+        absl::StrSplit(entry, absl::MaxSplits('=', 1));
+    absl::string_view name = absl::StripAsciiWhitespace(name_and_mb.first);
+    uint64_t mb = 0;
+    if (!absl::SimpleAtoi(name_and_mb.second, &mb)) {
+      return false;
+    }
+    size_t index = 0;
+    while (index < kNumSubsystems && name != kNames[index]) {
+      ++index;
+    }
+    if (index == kNumSubsystems) {
+      return false;
+    }
+    parsed[index] = mb * 1024 * 1024;
+  }
+
+  for (size_t i = 0; i < kNumSubsystems; ++i) {
+    SetBudget(static_cast<MemorySubsystem>(i), parsed[i]);
+  }
+  return true;
+}
+
+std::vector<MemorySubsystem> GetOverBudget() {
+  std::vector<MemorySubsystem> over_budget;
+  for (size_t i = 0; i < kNumSubsystems; ++i) {
+    auto subsystem = static_cast<MemorySubsystem>(i);
+    uint64_t budget = GetBudget(subsystem);
+    if (budget != 0 && GetBytes(subsystem) > budget) {
+      over_budget.push_back(subsystem);
+    }
+  }
+  return over_budget;
+}
+
+std::string GetReport() {
+  std::string report;
+  for (size_t i = 0; i < kNumSubsystems; ++i) {
+    auto subsystem = static_cast<MemorySubsystem>(i);
+    uint64_t bytes = GetBytes(subsystem);
+    if (bytes == 0) {
+      continue;
+    }
+    uint64_t budget = GetBudget(subsystem);
+    absl::StrAppendFormat(&report, "%s: %s", kNames[i], GetPrettySize(bytes));
+    if (budget != 0) {
+      absl::StrAppendFormat(&report, " of %s", GetPrettySize(budget));
+    }
+    report += "\n";
+  }
+  absl::StrAppendFormat(&report, "total: %s\n",
+                        GetPrettySize(GetTotalBytes()));
+  return report;
+}
+}  // namespace MemoryAccounting
@@ -0,0 +1,100 @@
+#ifndef ORBIT_CORE_MEMORY_ACCOUNTING_H_
+#define ORBIT_CORE_MEMORY_ACCOUNTING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The structures that hold most of the memory of a capture. Their bytes are
+// counted by the containers themselves, as they allocate and free, so that
+// which of them grows is known at any time rather than after the fact.
+enum class MemorySubsystem : uint32_t {
+  kOther,
+  kThreadTracks,
+  kEventBuffer,
+  kSamplingProfiler,
+  kCallstacks,
+  kBatcher,
+  kStringManager,
+  kNumSubsystems
+};
+
+// Process-wide byte counters, one per subsystem, updated with relaxed
+// atomics: cheap enough to be updated for each allocation of a block, and
+// read once per tick to be shown or logged.
+namespace MemoryAccounting {
+constexpr size_t kNumSubsystems =
+    static_cast<size_t>(MemorySubsystem::kNumSubsystems);
+
+void Add(MemorySubsystem subsystem, int64_t bytes);
+uint64_t GetBytes(MemorySubsystem subsystem);
+uint64_t GetTotalBytes();
+// E.g., "thread_tracks", also the name of its budget.
+const char* GetName(MemorySubsystem subsystem);
+
+// A budget of 0 bytes is no budget.
+void SetBudget(MemorySubsystem subsystem, uint64_t bytes);
+uint64_t GetBudget(MemorySubsystem subsystem);
+void ClearBudgets();
+// Sets the budgets of a comma-separated list of <name>=<megabytes>, e.g.,
+// "thread_tracks=2048,callstacks=512". Returns false, and sets none of them,
+// if an entry isn't valid.
+bool SetBudgets(const std::string& budgets);
+// The subsystems using more than their budget.
+std::vector<MemorySubsystem> GetOverBudget();
+
+// One line per subsystem using memory, with its budget if any.
+std::string GetReport();
+}  // namespace MemoryAccounting
+
+// The bytes of one container, added to the counter of its subsystem and
+// removed from it when the account is destroyed, so that a container only
+// has to report its allocations and frees.
+class MemoryAccount {
+ public:
+  explicit MemoryAccount(MemorySubsystem subsystem = MemorySubsystem::kOther)
+      : subsystem_(subsystem) {}
+  ~MemoryAccount() { MemoryAccounting::Add(subsystem_, -GetSigned()); }
+
+  MemoryAccount(const MemoryAccount&) = delete;
+  MemoryAccount& operator=(const MemoryAccount&) = delete;
+
+  void Add(int64_t bytes) {
+    bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    MemoryAccounting::Add(subsystem_, bytes);
+  }
+  void Set(uint64_t bytes) {
+    int64_t previous = bytes_.exchange(static_cast<int64_t>(bytes),
+                                       std::memory_order_relaxed);
+    MemoryAccounting::Add(subsystem_, static_cast<int64_t>(bytes) - previous);
+  }
+  // Moves the bytes counted so far to subsystem. Not to be called while
+  // bytes are added.
+  void SetSubsystem(MemorySubsystem subsystem) {
+    MemoryAccounting::Add(subsystem_, -GetSigned());
+    subsystem_ = subsystem;
+    MemoryAccounting::Add(subsystem_, GetSigned());
+  }
+
+  uint64_t GetBytes() const { return static_cast<uint64_t>(GetSigned()); }
+  MemorySubsystem GetSubsystem() const { return subsystem_; }
+
+ private:
+  int64_t GetSigned() const { return bytes_.load(std::memory_order_relaxed); }
+
+  MemorySubsystem subsystem_;
+  std::atomic<int64_t> bytes_ = 0;
+};
+
+// Estimate of the bytes of a hash map, std or absl: a pointer per bucket and,
+// per entry, the entry and a pointer, which is the node of the std maps and
+// about the empty slots of the absl ones.
+template <typename Map>
+uint64_t GetHashMapMemorySize(const Map& map) {
+  return map.bucket_count() * sizeof(void*) +
+         map.size() * (sizeof(typename Map::value_type) + sizeof(void*));
+}
+
+#endif  // ORBIT_CORE_MEMORY_ACCOUNTING_H_
@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include "BlockChain.h"
+#include "MemoryAccounting.h"
+
+TEST(MemoryAccounting, AccountAddsToItsSubsystem) {
+  uint64_t batcher = MemoryAccounting::GetBytes(MemorySubsystem::kBatcher);
+  uint64_t callstacks =
+      MemoryAccounting::GetBytes(MemorySubsystem::kCallstacks);
+  {
+    MemoryAccount account(MemorySubsystem::kBatcher);
+    account.Add(1000);
+    account.Add(-200);
+    EXPECT_EQ(account.GetBytes(), 800);
+    EXPECT_EQ(MemoryAccounting::GetBytes(MemorySubsystem::kBatcher),
+              batcher + 800);
+
+    account.Set(300);
+    EXPECT_EQ(MemoryAccounting::GetBytes(MemorySubsystem::kBatcher),
+              batcher + 300);
+
+    account.SetSubsystem(MemorySubsystem::kCallstacks);
+    EXPECT_EQ(MemoryAccounting::GetBytes(MemorySubsystem::kBatcher), batcher);
+    EXPECT_EQ(MemoryAccounting::GetBytes(MemorySubsystem::kCallstacks),
+              callstacks + 300);
+  }
+  EXPECT_EQ(MemoryAccounting::GetBytes(MemorySubsystem::kCallstacks),
+            callstacks);
+}
+
+TEST(MemoryAccounting, BlockChainCountsItsBlocks) {
+  using Chain = BlockChain<uint64_t, 1024>;
+  constexpr uint64_t kBlockBytes = sizeof(Block<uint64_t, 1024>);
+  uint64_t bytes = MemoryAccounting::GetBytes(MemorySubsystem::kThreadTracks);
+  {
+    auto chain = std::make_unique<Chain>();
+    chain->SetMemorySubsystem(MemorySubsystem::kThreadTracks);
+    EXPECT_EQ(MemoryAccounting::GetBytes(MemorySubsystem::kThreadTracks),
+              bytes + kBlockBytes);
+
+    for (uint64_t i = 0; i < 3000; ++i) {
+      chain->push_back(i);
+    }
+    EXPECT_EQ(MemoryAccounting::GetBytes(MemorySubsystem::kThreadTracks),
+              bytes + 3 * kBlockBytes);
+
+    chain->clear();
+    EXPECT_EQ(MemoryAccounting::GetBytes(MemorySubsystem::kThreadTracks),
+              bytes + kBlockBytes);
+  }
+  EXPECT_EQ(MemoryAccounting::GetBytes(MemorySubsystem::kThreadTracks), bytes);
+}
+
+TEST(MemoryAccounting, Budgets) {
+  EXPECT_TRUE(MemoryAccounting::SetBudgets(" batcher=1, string_manager=2"));
+  EXPECT_EQ(MemoryAccounting::GetBudget(MemorySubsystem::kBatcher),
+            1024 * 1024);
+  EXPECT_EQ(MemoryAccounting::GetBudget(MemorySubsystem::kStringManager),
+            2 * 1024 * 1024);
+  EXPECT_EQ(MemoryAccounting::GetBudget(MemorySubsystem::kCallstacks), 0);
+
+  EXPECT_FALSE(MemoryAccounting::SetBudgets("batcher=1,unknown=2"));
+  EXPECT_FALSE(MemoryAccounting::SetBudgets("batcher"));
+  EXPECT_EQ(MemoryAccounting::GetBudget(MemorySubsystem::kBatcher),
+            1024 * 1024);
+
+  {
+    MemoryAccount account(MemorySubsystem::kBatcher);
+    account.Add(2 * 1024 * 1024);
+    EXPECT_EQ(MemoryAccounting::GetOverBudget(),
+              std::vector<MemorySubsystem>{MemorySubsystem::kBatcher});
+  }
+  EXPECT_TRUE(MemoryAccounting::GetOverBudget().empty());
+
+  MemoryAccounting::ClearBudgets();
+  EXPECT_EQ(MemoryAccounting::GetBudget(MemorySubsystem::kStringManager), 0);
+}
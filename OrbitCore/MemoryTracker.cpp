@@ -4,6 +4,8 @@
 
 #include "MemoryTracker.h"
 
+#include <algorithm>
+
 #include "Callstack.h"
 #include "Capture.h"
 #include "Log.h"
@@ -18,58 +20,108 @@ MemoryTracker::MemoryTracker()
 void MemoryTracker::ProcessAlloc(const Timer& a_Timer) {
   DWORD64 address = a_Timer.m_UserData[0];
   DWORD64 size = a_Timer.m_UserData[1];
+  uint32_t siteIndex = GetSiteIndex(a_Timer.m_CallstackHash);
+
+  // An address allocated again without a free in between, the free was
+  // missed.
+  std::optional<LiveAllocationTable::Entry> previous =
+      m_LiveAllocs.Remove(address);
+  if (previous) {
+    AllocationSite& previousSite = m_Sites[previous->site_index];
+    --previousSite.m_NumLiveAllocs;
+    previousSite.m_NumLiveBytes -= previous->size;
+    m_NumLiveBytes -= previous->size;
+  }
 
-  m_LiveAllocs[address] = a_Timer;
+  m_LiveAllocs.Insert(address, size, siteIndex);
+  AllocationSite& site = m_Sites[siteIndex];
+  ++site.m_NumAllocs;
+  site.m_NumAllocatedBytes += size;
+  ++site.m_NumLiveAllocs;
+  site.m_NumLiveBytes += size;
   m_NumAllocatedBytes += size;
   m_NumLiveBytes += size;
-
-  /*PRINT_VAR((void*)address);
-  PRINT_VAR(size);*/
+  UpdateTimeline(a_Timer.m_Start);
 }
 
 //-----------------------------------------------------------------------------
 void MemoryTracker::ProcessFree(const Timer& a_Timer) {
   DWORD64 address = a_Timer.m_UserData[0];
-  Timer& timer = m_LiveAllocs[address];
-  DWORD64 freedSize = timer.m_UserData[1];
+  std::optional<LiveAllocationTable::Entry> alloc =
+      m_LiveAllocs.Remove(address);
+  if (!alloc) {
+    // Allocated before the capture started.
+    return;
+  }
 
-  m_LiveAllocs.erase(address);
-  m_NumFreedBytes += freedSize;
-  m_NumLiveBytes -= freedSize;
+  AllocationSite& site = m_Sites[alloc->site_index];
+  --site.m_NumLiveAllocs;
+  site.m_NumLiveBytes -= alloc->size;
+  m_NumFreedBytes += alloc->size;
+  m_NumLiveBytes -= alloc->size;
+  UpdateTimeline(a_Timer.m_Start);
+}
+
+//-----------------------------------------------------------------------------
+uint32_t MemoryTracker::GetSiteIndex(CallstackID a_CallstackId) {
+  auto it = m_SiteIndices.find(a_CallstackId);
+  if (it != m_SiteIndices.end()) {
+    return it->second;
+  }
 
-  // PRINT_VAR(freedSize);
+  uint32_t index = (uint32_t)m_Sites.size();
+  m_Sites.emplace_back();
+  m_Sites.back().m_CallstackId = a_CallstackId;
+  m_SiteIndices[a_CallstackId] = index;
+  return index;
 }
 
 //-----------------------------------------------------------------------------
-void MemoryTracker::DumpReport() {
-  DWORD64 NumLiveBytes = 0;
-  std::unordered_map<CallstackID, DWORD64> callstackToBytes;
-  for (auto& pair : m_LiveAllocs) {
-    Timer& timer = pair.second;
-    DWORD64 size = timer.m_UserData[1];
-    CallstackID id = timer.m_CallstackHash;
-    callstackToBytes[id] += size;
-    NumLiveBytes += size;
+void MemoryTracker::UpdateTimeline(TickType a_Time) {
+  if (!m_LiveBytesTimeline.empty() &&
+      a_Time < m_LiveBytesTimeline.back().m_Time + kTimelinePeriodNs) {
+    LiveBytesSample& sample = m_LiveBytesTimeline.back();
+    sample.m_NumLiveBytes = std::max(sample.m_NumLiveBytes, m_NumLiveBytes);
+    return;
   }
+  m_LiveBytesTimeline.push_back({a_Time, m_NumLiveBytes});
+}
 
-  std::multimap<DWORD64, CallstackID> bytesToCallstack;
-  for (auto& pair : callstackToBytes) {
-    bytesToCallstack.insert(std::make_pair(pair.second, pair.first));
+//-----------------------------------------------------------------------------
+std::vector<AllocationSite> MemoryTracker::GetTopSites(
+    size_t a_MaxSites) const {
+  std::vector<AllocationSite> sites;
+  for (const AllocationSite& site : m_Sites) {
+    if (site.m_NumLiveBytes > 0) {
+      sites.push_back(site);
+    }
   }
 
+  auto moreLiveBytes = [](const AllocationSite& a, const AllocationSite& b) {
+    return a.m_NumLiveBytes > b.m_NumLiveBytes;
+  };
+  size_t numSites = std::min(a_MaxSites, sites.size());
+  std::partial_sort(sites.begin(), sites.begin() + numSites, sites.end(),
+                    moreLiveBytes);
+  sites.resize(numSites);
+  return sites;
+}
+
+//-----------------------------------------------------------------------------
+void MemoryTracker::DumpReport() {
   if (m_NumAllocatedBytes) {
-    ORBIT_VIZ(absl::StrFormat("NumLiveBytes: %llu\n", NumLiveBytes));
+    ORBIT_VIZ(absl::StrFormat("NumLiveBytes: %llu\n", m_NumLiveBytes));
   }
 
-  for (auto rit = bytesToCallstack.rbegin(); rit != bytesToCallstack.rend();
-       ++rit) {
-    CallstackID id = rit->second;
-    std::shared_ptr<CallStack> callstack = Capture::GetCallstack(id);
+  for (const AllocationSite& site : GetTopSites(m_Sites.size())) {
+    std::shared_ptr<CallStack> callstack =
+        Capture::GetCallstack(site.m_CallstackId);
 
-    DWORD64 numBytes = rit->first;
-    DWORD64 cid = id;
-    std::string msg = absl::StrFormat("Callstack[%llu] allocated %llu bytes\n",
-                                      cid, numBytes);
+    std::string msg = absl::StrFormat(
+        "Callstack[%llu] has %llu live bytes in %llu allocations, of %llu "
+        "bytes in %llu allocations\n",
+        site.m_CallstackId, site.m_NumLiveBytes, site.m_NumLiveAllocs,
+        site.m_NumAllocatedBytes, site.m_NumAllocs);
     ORBIT_VIZ(msg);
     if (callstack) {
       ORBIT_VIZ(callstack->GetString());
@@ -80,7 +132,10 @@ void MemoryTracker::DumpReport() {
 
 //-----------------------------------------------------------------------------
 void MemoryTracker::Clear() {
-  m_LiveAllocs.clear();
+  m_LiveAllocs.Clear();
+  m_Sites.clear();
+  m_SiteIndices.clear();
+  m_LiveBytesTimeline.clear();
   m_NumAllocatedBytes = 0;
   m_NumFreedBytes = 0;
   m_NumLiveBytes = 0;
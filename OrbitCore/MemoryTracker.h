@@ -4,13 +4,36 @@
 #pragma once
 
 #include <unordered_map>
+#include <vector>
 
+#include "CallstackTypes.h"
 #include "Core.h"
+#include "LiveAllocationTable.h"
 #include "ScopeTimer.h"
 
-class Function;
+//-----------------------------------------------------------------------------
+// Allocations of the target aggregated by the callstack that made them.
+struct AllocationSite {
+  CallstackID m_CallstackId = 0;
+  DWORD64 m_NumAllocs = 0;
+  DWORD64 m_NumAllocatedBytes = 0;
+  DWORD64 m_NumLiveAllocs = 0;
+  DWORD64 m_NumLiveBytes = 0;
+};
+
+//-----------------------------------------------------------------------------
+struct LiveBytesSample {
+  TickType m_Time;
+  // Highest number of live bytes over the sample period.
+  DWORD64 m_NumLiveBytes;
+};
+
+//-----------------------------------------------------------------------------
 class MemoryTracker {
  public:
+  // Period of the samples of the live bytes timeline.
+  static constexpr TickType kTimelinePeriodNs = 1000 * 1000;
+
   MemoryTracker();
   void ProcessAlloc(const Timer& a_Timer);
   void ProcessFree(const Timer& a_Timer);
@@ -20,9 +43,23 @@ class MemoryTracker {
   DWORD64 NumAllocatedBytes() const { return m_NumAllocatedBytes; }
   DWORD64 NumFreedBytes() const { return m_NumFreedBytes; }
   DWORD64 NumLiveBytes() const { return m_NumLiveBytes; }
+  size_t NumLiveAllocs() const { return m_LiveAllocs.size(); }
+
+  const std::vector<AllocationSite>& GetSites() const { return m_Sites; }
+  // Sites with live bytes, most live bytes first, at most a_MaxSites.
+  std::vector<AllocationSite> GetTopSites(size_t a_MaxSites) const;
+  const std::vector<LiveBytesSample>& GetLiveBytesTimeline() const {
+    return m_LiveBytesTimeline;
+  }
 
  protected:
-  std::unordered_map<DWORD64, Timer> m_LiveAllocs;
+  uint32_t GetSiteIndex(CallstackID a_CallstackId);
+  void UpdateTimeline(TickType a_Time);
+
+  LiveAllocationTable m_LiveAllocs;
+  std::vector<AllocationSite> m_Sites;
+  std::unordered_map<CallstackID, uint32_t> m_SiteIndices;
+  std::vector<LiveBytesSample> m_LiveBytesTimeline;
   DWORD64 m_NumAllocatedBytes;
   DWORD64 m_NumFreedBytes;
   DWORD64 m_NumLiveBytes;
@@ -27,6 +27,7 @@ void Message::Dump() {
 
   PRINT_VAR(sizeof(MessageGeneric));
   PRINT_VAR(sizeof(DataTransferHeader));
+  PRINT_VAR(sizeof(WatchedDataHeader));
   PRINT_VAR(sizeof(ArgTrackingHeader));
   PRINT_VAR(sizeof(UnrealObjectHeader));
 }
\ No newline at end of file
@@ -69,6 +69,42 @@ enum MessageType : int16_t {
   Msg_SamplingCallstacks,
   Msg_SamplingHashedCallstacks,
   Msg_KeyAndString,
+  Msg_RemoteThreadStateChanges,
+  Msg_CompressionRequest,
+  Msg_CompressionEnabled,
+  Msg_SharedMemoryRequest,
+  Msg_SharedMemoryEnabled,
+  Msg_CaptureRecordingRequest,
+  Msg_CaptureRecordingInfo,
+  Msg_CaptureChunksRequest,
+  Msg_KeysAndStrings,
+  Msg_FunctionSamplingPolicies,
+  Msg_FunctionStats,
+  Msg_RemoteProcessListDiff,
+  Msg_RemoteProcessListRequest,
+  Msg_RemoteCoreActivities,
+  Msg_OffCpuCallstacks,
+  Msg_SubscribeCapture,
+  Msg_CaptureFilter,
+  Msg_SampleHistogram,
+  Msg_UserDataBatch,
+  Msg_StartContinuousProfiling,
+  Msg_StopContinuousProfiling,
+  Msg_ContinuousWindowsRequest,
+  Msg_ContinuousWindows,
+  Msg_ContinuousWindowRequest,
+  Msg_ContinuousWindow,
+  Msg_GetWatchedData,
+  Msg_WatchedData,
+  Msg_KernelFrameSymbols,
+  Msg_ThreadNames,
+  Msg_ClockSync,
+  Msg_FlightRecorderRequest,
+  Msg_FlightRecorderDump,
+  Msg_CaptureTriggers,
+  Msg_BranchCounts,
+  Msg_IntelPtRequest,
+  Msg_OrbitUnrealObjects,
 };
 
 //-----------------------------------------------------------------------------
@@ -83,6 +119,14 @@ struct DataTransferHeader {
   DataType m_Type;
 };
 
+//-----------------------------------------------------------------------------
+// Msg_GetWatchedData carries the WatchedRanges to read, and Msg_WatchedData
+// the delta of what they hold, see WatchedMemory.h.
+struct WatchedDataHeader {
+  uint32_t m_LayoutId;
+  bool m_Full;
+};
+
 //-----------------------------------------------------------------------------
 struct ArgTrackingHeader {
   uint64_t m_Function;
@@ -111,6 +155,7 @@ class Message {
   union Header {
     MessageGeneric m_GenericHeader;
     DataTransferHeader m_DataTransferHeader;
+    WatchedDataHeader m_WatchedDataHeader;
     ArgTrackingHeader m_ArgTrackingHeader;
     UnrealObjectHeader m_UnrealObjectHeader;
   };
@@ -0,0 +1,73 @@
+#include "MessageWorkerPool.h"
+
+#include <OrbitBase/Logging.h>
+
+#include "Threading.h"
+
+MessageWorkerPool::MessageWorkerPool(size_t thread_count) {
+  CHECK(thread_count > 0);
+  workers_.reserve(thread_count);
+  for (size_t i = 0; i < thread_count; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+}
+
+MessageWorkerPool::~MessageWorkerPool() { workers_.clear(); }
+
+void MessageWorkerPool::Post(uint32_t stream, std::function<void()> task) {
+  workers_[stream % workers_.size()]->Push(std::move(task));
+}
+
+void MessageWorkerPool::WaitUntilIdle() {
+  for (std::unique_ptr<Worker>& worker : workers_) {
+    worker->WaitUntilIdle();
+  }
+}
+
+MessageWorkerPool::Worker::~Worker() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stop_requested_ = true;
+  }
+  tasks_available_.notify_one();
+  thread_.join();
+}
+
+void MessageWorkerPool::Worker::Push(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    tasks_.push_back(std::move(task));
+    ++num_pending_tasks_;
+  }
+  tasks_available_.notify_one();
+}
+
+void MessageWorkerPool::Worker::WaitUntilIdle() {
+  std::unique_lock<std::mutex> lock{mutex_};
+  idle_.wait(lock, [this] { return num_pending_tasks_ == 0; });
+}
+
+void MessageWorkerPool::Worker::Run() {
+  SetCurrentThreadName(L"OrbitMsgWorker");
+  std::deque<std::function<void()>> tasks;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      num_pending_tasks_ -= tasks.size();
+      tasks.clear();
+      if (num_pending_tasks_ == 0) {
+        idle_.notify_all();
+      }
+      tasks_available_.wait(
+          lock, [this] { return !tasks_.empty() || stop_requested_; });
+      if (tasks_.empty()) {
+        return;
+      }
+      // Take all the pending tasks at once to lock only once per batch.
+      tasks.swap(tasks_);
+    }
+    for (std::function<void()>& task : tasks) {
+      task();
+    }
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef ORBIT_CORE_MESSAGE_WORKER_POOL_H_
+#define ORBIT_CORE_MESSAGE_WORKER_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs the decoding of received messages off the thread reading the socket.
+// Tasks are posted to a stream: the tasks of a stream run in the order in
+// which they were posted, on the same worker, while different streams can run
+// concurrently on different workers.
+class MessageWorkerPool {
+ public:
+  explicit MessageWorkerPool(size_t thread_count);
+  // Waits for all the posted tasks to be completed.
+  ~MessageWorkerPool();
+
+  MessageWorkerPool(const MessageWorkerPool&) = delete;
+  MessageWorkerPool& operator=(const MessageWorkerPool&) = delete;
+
+  void Post(uint32_t stream, std::function<void()> task);
+
+  // Returns once all the tasks posted so far have been completed.
+  void WaitUntilIdle();
+
+ private:
+  class Worker {
+   public:
+    Worker() : thread_{&Worker::Run, this} {}
+    ~Worker();
+
+    Worker(const Worker&) = delete;
+    Worker& operator=(const Worker&) = delete;
+
+    void Push(std::function<void()> task);
+    void WaitUntilIdle();
+
+   private:
+    void Run();
+
+    std::mutex mutex_;
+    std::condition_variable tasks_available_;
+    std::condition_variable idle_;
+    std::deque<std::function<void()>> tasks_;
+    // Tasks pushed and not completed yet, including the ones running.
+    size_t num_pending_tasks_ = 0;
+    bool stop_requested_ = false;
+
+    // Declared last, so that the thread starts after everything else has been
+    // initialized.
+    std::thread thread_;
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+};
+
+#endif  // ORBIT_CORE_MESSAGE_WORKER_POOL_H_
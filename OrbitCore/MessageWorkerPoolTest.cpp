@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <vector>
+
+#include "MessageWorkerPool.h"
+
+TEST(MessageWorkerPool, TasksOfAStreamRunInOrder) {
+  constexpr uint32_t kNumStreams = 5;
+  constexpr int kNumTasksPerStream = 1000;
+  std::mutex mutex;
+  std::vector<std::vector<int>> executed(kNumStreams);
+
+  MessageWorkerPool pool(2);
+  for (int i = 0; i < kNumTasksPerStream; ++i) {
+    for (uint32_t stream = 0; stream < kNumStreams; ++stream) {
+      pool.Post(stream, [&, stream, i] {
+        std::lock_guard<std::mutex> lock{mutex};
+        executed[stream].push_back(i);
+      });
+    }
+  }
+  pool.WaitUntilIdle();
+
+  for (const std::vector<int>& stream_executed : executed) {
+    ASSERT_EQ(stream_executed.size(), kNumTasksPerStream);
+    for (int i = 0; i < kNumTasksPerStream; ++i) {
+      EXPECT_EQ(stream_executed[i], i);
+    }
+  }
+}
+
+TEST(MessageWorkerPool, StreamsRunConcurrently) {
+  std::promise<void> second_stream_ran;
+  std::atomic<bool> first_stream_done = false;
+
+  MessageWorkerPool pool(2);
+  // Would deadlock if the streams were processed on the same thread.
+  pool.Post(0, [&] {
+    second_stream_ran.get_future().wait();
+    first_stream_done = true;
+  });
+  pool.Post(1, [&] { second_stream_ran.set_value(); });
+  pool.WaitUntilIdle();
+
+  EXPECT_TRUE(first_stream_done);
+}
+
+TEST(MessageWorkerPool, DestructorCompletesPostedTasks) {
+  std::atomic<int> num_executed = 0;
+  {
+    MessageWorkerPool pool(3);
+    for (uint32_t i = 0; i < 100; ++i) {
+      pool.Post(i, [&] { ++num_executed; });
+    }
+  }
+  EXPECT_EQ(num_executed, 100);
+}
+
+TEST(MessageWorkerPool, WaitUntilIdleWithoutTasks) {
+  MessageWorkerPool pool(1);
+  pool.WaitUntilIdle();
+  pool.Post(0, [] {});
+  pool.WaitUntilIdle();
+  pool.WaitUntilIdle();
+}
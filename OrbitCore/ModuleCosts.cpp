@@ -0,0 +1,84 @@
+#include "ModuleCosts.h"
+
+#include <algorithm>
+#include <utility>
+
+void ModuleCosts::SetModules(std::vector<ModuleRange> modules) {
+  std::sort(modules.begin(), modules.end(),
+            [](const ModuleRange& a, const ModuleRange& b) {
+              return a.start < b.start;
+            });
+  modules_ = std::move(modules);
+  costs_.assign(modules_.size(), Cost());
+  num_samples_ = 0;
+  callstack_modules_.clear();
+  cache_.fill(kNoModule);
+}
+
+uint32_t ModuleCosts::GetModuleIndex(uint64_t address) {
+  uint64_t page = address >> kPageShift;
+  uint32_t& slot = cache_[(page * 0x9E3779B97F4A7C15ULL >> 32) % kCacheSize];
+  if (Contains(slot, address)) {
+    return slot;
+  }
+
+  auto it = std::upper_bound(
+      modules_.begin(), modules_.end(), address,
+      [](uint64_t a, const ModuleRange& range) { return a < range.start; });
+  if (it == modules_.begin()) {
+    return kNoModule;
+  }
+  auto index = static_cast<uint32_t>(it - modules_.begin() - 1);
+  if (!Contains(index, address)) {
+    return kNoModule;
+  }
+  slot = index;
+  return index;
+}
+
+void ModuleCosts::AddCallstack(CallstackID id,
+                               const std::vector<uint64_t>& frames) {
+  auto [it, inserted] = callstack_modules_.try_emplace(id);
+  if (!inserted || frames.empty()) {
+    return;
+  }
+  std::vector<uint32_t>& modules = it->second;
+  modules.push_back(GetModuleIndex(frames[0]));
+  for (uint64_t address : frames) {
+    uint32_t index = GetModuleIndex(address);
+    if (index != kNoModule &&
+        std::find(modules.begin() + 1, modules.end(), index) ==
+            modules.end()) {
+      modules.push_back(index);
+    }
+  }
+}
+
+void ModuleCosts::AddSamples(CallstackID id, unsigned int count) {
+  auto it = callstack_modules_.find(id);
+  if (it == callstack_modules_.end()) {
+    return;
+  }
+  num_samples_ += count;
+  const std::vector<uint32_t>& modules = it->second;
+  if (modules.empty()) {
+    return;
+  }
+  if (modules[0] != kNoModule) {
+    costs_[modules[0]].exclusive += count;
+  }
+  for (size_t i = 1; i < modules.size(); ++i) {
+    costs_[modules[i]].inclusive += count;
+  }
+}
+
+absl::flat_hash_map<uint64_t, ModuleCosts::Cost> ModuleCosts::GetCosts()
+    const {
+  absl::flat_hash_map<uint64_t, Cost> costs;
+  for (size_t i = 0; i < modules_.size(); ++i) {
+    if (costs_[i].inclusive > 0) {
+      costs.emplace(modules_[i].start, costs_[i]);
+    }
+  }
+  return costs;
+}
@@ -0,0 +1,73 @@
+#ifndef ORBIT_CORE_MODULE_COSTS_H_
+#define ORBIT_CORE_MODULE_COSTS_H_
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "CallstackTypes.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
+
+// Samples by module, e.g. to tell how much of the time goes to libc, a driver
+// or the engine without adding up their functions. A sample is exclusive to
+// the module of its innermost frame, and inclusive to each module among its
+// frames, once. The modules of a callstack are only looked up the first time
+// it is sampled. An address is looked up in a flat array of the modules'
+// ranges, behind a direct-mapped cache by page, as the samples keep hitting
+// the same code. Not thread safe.
+class ModuleCosts {
+ public:
+  struct ModuleRange {
+    uint64_t start;
+    uint64_t end;
+  };
+  struct Cost {
+    unsigned int inclusive = 0;
+    unsigned int exclusive = 0;
+  };
+
+  ModuleCosts() { Clear(); }
+
+  // Replaces the modules, which must not overlap, and clears the counts.
+  void SetModules(std::vector<ModuleRange> modules);
+  void Clear() { SetModules({}); }
+
+  bool HasCallstack(CallstackID id) const {
+    return callstack_modules_.contains(id);
+  }
+  // Looks up the modules of the frames of a callstack, innermost first.
+  void AddCallstack(CallstackID id, const std::vector<uint64_t>& frames);
+  // Counts samples of a callstack added with AddCallstack, ignored otherwise.
+  void AddSamples(CallstackID id, unsigned int count);
+
+  unsigned int GetNumSamples() const { return num_samples_; }
+  // By start of the modules sampled.
+  absl::flat_hash_map<uint64_t, Cost> GetCosts() const;
+
+  // Index in modules_ of the module containing address, kNoModule if none.
+  uint32_t GetModuleIndex(uint64_t address);
+
+  static constexpr uint32_t kNoModule = ~0u;
+
+ private:
+  static constexpr size_t kCacheSize = 256;
+  static constexpr uint64_t kPageShift = 12;
+
+  bool Contains(uint32_t index, uint64_t address) const {
+    return index < modules_.size() && modules_[index].start <= address &&
+           address < modules_[index].end;
+  }
+
+  // By start.
+  std::vector<ModuleRange> modules_;
+  std::vector<Cost> costs_;
+  unsigned int num_samples_ = 0;
+  // Module of the innermost frame of each callstack, then the distinct
+  // modules of all its frames.
+  absl::flat_hash_map<CallstackID, std::vector<uint32_t>> callstack_modules_;
+  // Module of an address recently looked up, by a hash of its page.
+  std::array<uint32_t, kCacheSize> cache_;
+};
+
+#endif  // ORBIT_CORE_MODULE_COSTS_H_
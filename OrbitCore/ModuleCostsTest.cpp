@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+
+#include "ModuleCosts.h"
+
+TEST(ModuleCosts, FindsModuleOfAddress) {
+  ModuleCosts costs;
+  costs.SetModules({{0x3000, 0x4000}, {0x1000, 0x2000}});
+  EXPECT_EQ(costs.GetModuleIndex(0x1000), 0);
+  EXPECT_EQ(costs.GetModuleIndex(0x1fff), 0);
+  // Served from the cache.
+  EXPECT_EQ(costs.GetModuleIndex(0x1ff0), 0);
+  EXPECT_EQ(costs.GetModuleIndex(0x3500), 1);
+  EXPECT_EQ(costs.GetModuleIndex(0x500), ModuleCosts::kNoModule);
+  EXPECT_EQ(costs.GetModuleIndex(0x2000), ModuleCosts::kNoModule);
+  EXPECT_EQ(costs.GetModuleIndex(0x4000), ModuleCosts::kNoModule);
+}
+
+TEST(ModuleCosts, CountsInclusiveAndExclusive) {
+  ModuleCosts costs;
+  costs.SetModules({{0x1000, 0x2000}, {0x3000, 0x4000}});
+
+  // Innermost in the second module, called through the first one twice.
+  costs.AddCallstack(1, {0x3100, 0x1100, 0x1200});
+  // Innermost outside of any module.
+  costs.AddCallstack(2, {0x9000, 0x1100});
+  costs.AddSamples(1, 3);
+  costs.AddSamples(2, 1);
+  costs.AddSamples(1, 1);
+  // Unknown callstack.
+  costs.AddSamples(3, 10);
+
+  EXPECT_EQ(costs.GetNumSamples(), 5);
+  absl::flat_hash_map<uint64_t, ModuleCosts::Cost> by_module =
+      costs.GetCosts();
+  ASSERT_EQ(by_module.size(), 2);
+  EXPECT_EQ(by_module[0x1000].inclusive, 5);
+  EXPECT_EQ(by_module[0x1000].exclusive, 0);
+  EXPECT_EQ(by_module[0x3000].inclusive, 4);
+  EXPECT_EQ(by_module[0x3000].exclusive, 4);
+
+  costs.SetModules({{0x1000, 0x2000}});
+  EXPECT_EQ(costs.GetNumSamples(), 0);
+  EXPECT_FALSE(costs.HasCallstack(1));
+  EXPECT_TRUE(costs.GetCosts().empty());
+}
@@ -4,16 +4,29 @@
 
 #include "ModuleManager.h"
 
+#include <algorithm>
+#include <thread>
+
 #include "Capture.h"
 #include "CoreApp.h"
 #include "OrbitModule.h"
 #include "OrbitProcess.h"
+#include "OrbitSession.h"
+#include "Path.h"
+#include "SamplingProfiler.h"
 #include "Tcp.h"
 #include "TcpServer.h"
 #include "absl/strings/str_format.h"
 
 ModuleManager GModuleManager;
 
+namespace {
+std::vector<uint64_t> GetSampledAddresses() {
+  std::shared_ptr<SamplingProfiler> profiler = Capture::GSamplingProfiler;
+  return profiler ? profiler->GetSampledAddresses() : std::vector<uint64_t>();
+}
+}  // namespace
+
 //-----------------------------------------------------------------------------
 ModuleManager::ModuleManager() { GPdbDbg = std::make_shared<Pdb>(); }
 
@@ -22,10 +35,14 @@ ModuleManager::~ModuleManager() {}
 
 //-----------------------------------------------------------------------------
 void ModuleManager::Init() {
-  if (GTcpServer)
+  if (GTcpServer) {
     GTcpServer->AddCallback(Msg_SetData, [=](const Message& a_Msg) {
       this->OnReceiveMessage(a_Msg);
     });
+    GTcpServer->AddCallback(Msg_WatchedData, [](const Message& a_Msg) {
+      Capture::GTargetProcess->OnWatchedData(a_Msg);
+    });
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -65,14 +82,12 @@ void ModuleManager::LoadPdbAsync(const std::shared_ptr<Module>& a_Module,
     if (a_Module->m_FoundPdb || loadExports) {
       const std::string& pdbName =
           loadExports ? a_Module->m_FullName : a_Module->m_PdbName;
+      std::vector<uint64_t> sampledAddresses = GetSampledAddresses();
+      ScopeLock lock(m_Mutex);
       m_UserCompletionCallback = a_CompletionCallback;
-
-      GPdbDbg = a_Module->m_Pdb;
-      if (GPdbDbg) {
-        // This function should probably be called something like SetBaseAddress
-        GPdbDbg->SetMainModule(a_Module->m_AddressStart);
-        GPdbDbg->LoadPdbAsync(pdbName.c_str(), [&]() { this->OnPdbLoaded(); });
-      }
+      m_SampledAddresses = std::move(sampledAddresses);
+      Enqueue(a_Module, pdbName);
+      StartWorkers();
     }
   }
 }
@@ -80,54 +95,200 @@ void ModuleManager::LoadPdbAsync(const std::shared_ptr<Module>& a_Module,
 //-----------------------------------------------------------------------------
 void ModuleManager::LoadPdbAsync(const std::vector<std::string> a_Modules,
                                  std::function<void()> a_CompletionCallback) {
+  std::vector<uint64_t> sampledAddresses = GetSampledAddresses();
+  ScopeLock lock(m_Mutex);
   m_UserCompletionCallback = a_CompletionCallback;
-  m_ModulesQueue = a_Modules;
-  DequeueAndLoad();
-}
-
-//-----------------------------------------------------------------------------
-void ModuleManager::DequeueAndLoad() {
-  std::shared_ptr<Module> module = nullptr;
-
-  while (module == nullptr && !m_ModulesQueue.empty()) {
-    std::string pdbName = m_ModulesQueue.back();
-    m_ModulesQueue.pop_back();
-
-    module = Capture::GTargetProcess->FindModule(Path::GetFileName(pdbName));
+  m_SampledAddresses = std::move(sampledAddresses);
+  for (const std::string& name : a_Modules) {
+    std::shared_ptr<Module> module =
+        Capture::GTargetProcess->FindModule(Path::GetFileName(name));
     if (module) {
-      GPdbDbg = module->m_Pdb;
       if (module->m_PdbName.empty()) {
         module->m_PdbName = module->m_FullName;
       }
-
-      pdbName = module->m_PdbName;
-      GPdbDbg->LoadPdbAsync(pdbName.c_str(), [&]() { this->OnPdbLoaded(); });
-      return;
+      Enqueue(module, module->m_PdbName);
     }
   }
 
   // No module was found, call user callback
-  m_UserCompletionCallback();
+  if (m_NumModulesToLoad == 0) {
+    m_UserCompletionCallback();
+    return;
+  }
+  StartWorkers();
+}
+
+//-----------------------------------------------------------------------------
+void ModuleManager::LoadTypesAndGlobalsAsync(
+    std::function<void()> a_LoadedCallback) {
+  std::vector<std::shared_ptr<Module>> modules;
+  {
+    ScopeLock lock(Capture::GTargetProcess->GetDataMutex());
+    for (auto& pair : Capture::GTargetProcess->GetModules()) {
+      std::shared_ptr<Module>& module = pair.second;
+      if (module->GetLoaded() && module->m_Pdb &&
+          !module->m_Pdb->AreTypesAndGlobalsLoaded()) {
+        modules.push_back(module);
+      }
+    }
+  }
+
+  ScopeLock lock(m_Mutex);
+  m_TypesAndGlobalsCallback = a_LoadedCallback;
+  for (const std::shared_ptr<Module>& module : modules) {
+    Enqueue(module, module->m_PdbName, /*a_TypesAndGlobals=*/true);
+  }
+  StartWorkers();
+}
+
+//-----------------------------------------------------------------------------
+void ModuleManager::Enqueue(const std::shared_ptr<Module>& a_Module,
+                            const std::string& a_PdbName,
+                            bool a_TypesAndGlobals) {
+  for (const QueuedModule& queued : m_ModulesQueue) {
+    if (queued.m_Module == a_Module &&
+        queued.m_TypesAndGlobals == a_TypesAndGlobals) {
+      return;
+    }
+  }
+  QueuedModule queued;
+  queued.m_Module = a_Module;
+  queued.m_PdbName = a_PdbName;
+  queued.m_TypesAndGlobals = a_TypesAndGlobals;
+  if (a_TypesAndGlobals) {
+    // Requested by the user, who is waiting for them.
+    queued.m_Priority = SELECTED;
+  } else {
+    queued.m_Priority = GetPriority(*a_Module, a_PdbName);
+    ++m_NumModulesToLoad;
+    m_IsLoading = true;
+  }
+  m_ModulesQueue.push_back(std::move(queued));
 }
 
 //-----------------------------------------------------------------------------
-void ModuleManager::OnPdbLoaded() {
-  std::shared_ptr<Pdb> lastPdb = GPdbDbg;
-  AddPdb(lastPdb);
+ModuleManager::Priority ModuleManager::GetPriority(
+    const Module& a_Module, const std::string& a_PdbName) {
+  std::shared_ptr<Session> session = Capture::GSessionPresets;
+  if (session != nullptr &&
+      (session->m_Modules.count(a_Module.m_Name) > 0 ||
+       session->m_Modules.count(Path::GetFileName(a_PdbName)) > 0)) {
+    return SELECTED;
+  }
+
+  auto it = std::lower_bound(m_SampledAddresses.begin(),
+                             m_SampledAddresses.end(), a_Module.m_AddressStart);
+  if (it != m_SampledAddresses.end() && *it < a_Module.m_AddressEnd) {
+    return SAMPLED;
+  }
+  return LOW;
+}
 
-  if (!m_ModulesQueue.empty()) {
-    // Start loading next pdb on other thread
-    DequeueAndLoad();
+//-----------------------------------------------------------------------------
+void ModuleManager::StartWorkers() {
+  while (m_NumWorkers < std::min(kMaxNumWorkers, m_ModulesQueue.size())) {
+    ++m_NumWorkers;
+    std::thread(&ModuleManager::DequeueAndLoad, this).detach();
   }
+}
+
+//-----------------------------------------------------------------------------
+void ModuleManager::DequeueAndLoad() {
+  SetCurrentThreadName(L"ModuleLoader");
+  while (true) {
+    QueuedModule queued;
+    {
+      ScopeLock lock(m_Mutex);
+      if (m_ModulesQueue.empty()) {
+        --m_NumWorkers;
+        return;
+      }
+      // The first of the modules of highest priority.
+      auto it = std::max_element(m_ModulesQueue.begin(), m_ModulesQueue.end(),
+                                 [](const QueuedModule& a_Lhs,
+                                    const QueuedModule& a_Rhs) {
+                                   return a_Lhs.m_Priority < a_Rhs.m_Priority;
+                                 });
+      queued = std::move(*it);
+      m_ModulesQueue.erase(it);
+    }
 
+    std::shared_ptr<Pdb> pdb = queued.m_Module->m_Pdb;
+    // Types and globals requested again while being loaded are only added
+    // once.
+    bool loadedTypesAndGlobals = false;
+    if (pdb) {
 #ifdef _WIN32
-  // Apply presets on last pdb
-  lastPdb->ApplyPresets();
+      GPdbDbg = pdb;
 #endif
+      if (queued.m_TypesAndGlobals) {
+        loadedTypesAndGlobals = pdb->LoadTypesAndGlobals();
+      } else {
+        // This function should probably be called something like
+        // SetBaseAddress
+        pdb->SetMainModule(queued.m_Module->m_AddressStart);
+        pdb->LoadPdb(queued.m_PdbName.c_str());
+      }
+    }
+
+    ScopeLock lock(m_Mutex);
+    if (loadedTypesAndGlobals) {
+      m_LoadedTypesAndGlobals.push_back(queued.m_Module);
+    } else if (!queued.m_TypesAndGlobals) {
+      m_LoadedModules.push_back(queued.m_Module);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void ModuleManager::Update() {
+  std::vector<std::shared_ptr<Module>> loadedModules;
+  std::vector<std::shared_ptr<Module>> loadedTypesAndGlobals;
+  bool isDone = false;
+  {
+    ScopeLock lock(m_Mutex);
+    loadedModules.swap(m_LoadedModules);
+    loadedTypesAndGlobals.swap(m_LoadedTypesAndGlobals);
+    m_NumModulesToLoad -= loadedModules.size();
+    isDone = m_IsLoading && m_NumModulesToLoad == 0;
+    if (isDone) {
+      m_IsLoading = false;
+    }
+  }
 
-  if (m_ModulesQueue.empty()) {
+  for (const std::shared_ptr<Module>& module : loadedModules) {
+    OnPdbLoaded(module);
+  }
+  if (isDone && m_UserCompletionCallback) {
     m_UserCompletionCallback();
   }
+
+  for (const std::shared_ptr<Module>& module : loadedTypesAndGlobals) {
+    if (module->m_Pdb) {
+      module->m_Pdb->ProcessTypesAndGlobals();
+    }
+  }
+  if (!loadedTypesAndGlobals.empty() && m_TypesAndGlobalsCallback) {
+    m_TypesAndGlobalsCallback();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void ModuleManager::OnPdbLoaded(const std::shared_ptr<Module>& a_Module) {
+  std::shared_ptr<Pdb> pdb = a_Module->m_Pdb;
+  if (!pdb) return;
+  AddPdb(pdb);
+
+  // The functions of the session loaded are selected as soon as their module
+  // is, instead of once all are.
+  pdb->ApplyPresets();
+
+  // Only the frames of the module are resolved again.
+  std::shared_ptr<SamplingProfiler> profiler = Capture::GSamplingProfiler;
+  if (profiler) {
+    profiler->ResolveAddressesInRange(a_Module->m_AddressStart,
+                                      a_Module->m_AddressEnd);
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -5,9 +5,18 @@
 
 #include "Core.h"
 #include "Pdb.h"
+#include "Threading.h"
 
 struct Module;
 
+//-----------------------------------------------------------------------------
+// Loads the symbols of modules on a few worker threads. Modules queued
+// together are loaded most useful first: those with functions selected in
+// the session, then those with sampled addresses. Once a module is loaded,
+// on the main thread, its sampled addresses are resolved again, and once all
+// are loaded the completion callback is called. Types and globals are only
+// loaded on request, after the functions, as they are rarely needed and take
+// most of the time of loading large pdbs.
 class ModuleManager {
  public:
   ModuleManager();
@@ -19,16 +28,54 @@ class ModuleManager {
                     std::function<void()> a_CompletionCallback);
   void LoadPdbAsync(const std::vector<std::string> a_Modules,
                     std::function<void()> a_CompletionCallback);
+  // Loads the types and globals of the modules loaded so far, calling
+  // a_LoadedCallback on the main thread each time those of some modules are
+  // added to the process.
+  void LoadTypesAndGlobalsAsync(std::function<void()> a_LoadedCallback);
+  // Handles the modules loaded since the previous call. Called on the main
+  // thread.
+  void Update();
 
  protected:
+  enum Priority { LOW, SAMPLED, SELECTED };
+  struct QueuedModule {
+    std::shared_ptr<Module> m_Module;
+    std::string m_PdbName;
+    Priority m_Priority = LOW;
+    // Of the module, already loaded, rather than its functions.
+    bool m_TypesAndGlobals = false;
+  };
+
+  // Needs m_Mutex locked.
+  void Enqueue(const std::shared_ptr<Module>& a_Module,
+               const std::string& a_PdbName, bool a_TypesAndGlobals = false);
+  Priority GetPriority(const Module& a_Module, const std::string& a_PdbName);
+  // Needs m_Mutex locked.
+  void StartWorkers();
   void DequeueAndLoad();
-  void OnPdbLoaded();
-  void ApplyPresets(std::shared_ptr<Pdb>& a_Pdb);
+  void OnPdbLoaded(const std::shared_ptr<Module>& a_Module);
   void AddPdb(const std::shared_ptr<Pdb>& a_Pdb);
 
  protected:
+#ifdef _WIN32
+  // DIA and DbgHelp are not thread-safe.
+  static constexpr size_t kMaxNumWorkers = 1;
+#else
+  static constexpr size_t kMaxNumWorkers = 4;
+#endif
+
   std::function<void()> m_UserCompletionCallback;
-  std::vector<std::string> m_ModulesQueue;
+  std::function<void()> m_TypesAndGlobalsCallback;
+  Mutex m_Mutex;
+  std::vector<QueuedModule> m_ModulesQueue;
+  std::vector<std::shared_ptr<Module>> m_LoadedModules;
+  std::vector<std::shared_ptr<Module>> m_LoadedTypesAndGlobals;
+  // Queued, being loaded, or loaded but not handled by Update yet.
+  size_t m_NumModulesToLoad = 0;
+  size_t m_NumWorkers = 0;
+  bool m_IsLoading = false;
+  // Sorted, of the samples when the modules were queued.
+  std::vector<uint64_t> m_SampledAddresses;
 };
 
 extern ModuleManager GModuleManager;
@@ -0,0 +1,47 @@
+#include "OffCpuProfile.h"
+
+#include "SamplingProfiler.h"
+
+void OffCpuProfile::AddCallstack(const CallStack& callstack,
+                                 uint64_t duration_ns) {
+  absl::MutexLock lock(&mutex_);
+  callstacks_.try_emplace(callstack.m_Hash, callstack);
+  durations_ns_[{callstack.m_ThreadId, callstack.m_Hash}] += duration_ns;
+}
+
+uint64_t OffCpuProfile::GetDurationNs(ThreadID tid, CallstackID id) const {
+  absl::MutexLock lock(&mutex_);
+  auto it = durations_ns_.find({tid, id});
+  return it != durations_ns_.end() ? it->second : 0;
+}
+
+bool OffCpuProfile::IsEmpty() const {
+  absl::MutexLock lock(&mutex_);
+  return durations_ns_.empty();
+}
+
+void OffCpuProfile::Clear() {
+  absl::MutexLock lock(&mutex_);
+  callstacks_.clear();
+  durations_ns_.clear();
+}
+
+std::shared_ptr<SamplingProfiler> OffCpuProfile::MakeSamplingProfiler(
+    const std::shared_ptr<Process>& process) const {
+  auto profiler = std::make_shared<SamplingProfiler>(process);
+  profiler->SetIsLinuxPerf(true);
+  profiler->SetState(SamplingProfiler::Sampling);
+  {
+    absl::MutexLock lock(&mutex_);
+    for (const auto& [tid_and_id, duration_ns] : durations_ns_) {
+      // Rounded up, so that short waits still show.
+      auto count = static_cast<unsigned int>(
+          (duration_ns + kSampleDurationNs - 1) / kSampleDurationNs);
+      CallStack callstack = callstacks_.at(tid_and_id.second);
+      callstack.m_ThreadId = tid_and_id.first;
+      profiler->AddCallStackSamples(callstack, tid_and_id.first, count);
+    }
+  }
+  profiler->ProcessSamples();
+  return profiler;
+}
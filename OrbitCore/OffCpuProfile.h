@@ -0,0 +1,43 @@
+#ifndef ORBIT_CORE_OFF_CPU_PROFILE_H_
+#define ORBIT_CORE_OFF_CPU_PROFILE_H_
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "Callstack.h"
+#include "CallstackTypes.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
+class Process;
+class SamplingProfiler;
+
+// Time the threads of the target spent blocked during a capture, per thread
+// and per callstack at which they blocked, from the off-CPU callstacks
+// recorded by the service (see Params::m_TrackOffCpuCallstacks).
+class OffCpuProfile {
+ public:
+  // In the reports, blocked time is counted in samples of this duration.
+  static constexpr uint64_t kSampleDurationNs = 10'000;
+
+  void AddCallstack(const CallStack& callstack, uint64_t duration_ns);
+  uint64_t GetDurationNs(ThreadID tid, CallstackID id) const;
+  bool IsEmpty() const;
+  void Clear();
+
+  // A processed profiler whose samples are the blocked time of each thread
+  // and callstack, to show as a SamplingReport: its percentages are shares
+  // of the blocked time.
+  std::shared_ptr<SamplingProfiler> MakeSamplingProfiler(
+      const std::shared_ptr<Process>& process) const;
+
+ private:
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<CallstackID, CallStack> callstacks_
+      ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<std::pair<ThreadID, CallstackID>, uint64_t>
+      durations_ns_ ABSL_GUARDED_BY(mutex_);
+};
+
+#endif  // ORBIT_CORE_OFF_CPU_PROFILE_H_
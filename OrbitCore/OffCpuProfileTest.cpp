@@ -0,0 +1,35 @@
+#include <gtest/gtest.h>
+
+#include "OffCpuProfile.h"
+
+namespace {
+CallStack MakeCallstack(ThreadID tid, std::vector<uint64_t> frames) {
+  CallStack callstack;
+  callstack.m_ThreadId = tid;
+  callstack.m_Depth = frames.size();
+  callstack.m_Data = std::move(frames);
+  callstack.Hash();
+  return callstack;
+}
+}  // namespace
+
+TEST(OffCpuProfile, SumsDurationsPerThreadAndCallstack) {
+  OffCpuProfile profile;
+  EXPECT_TRUE(profile.IsEmpty());
+
+  CallStack callstack = MakeCallstack(10, {0x10, 0x20});
+  profile.AddCallstack(callstack, 1000);
+  profile.AddCallstack(callstack, 500);
+  profile.AddCallstack(MakeCallstack(20, {0x10, 0x20}), 300);
+  profile.AddCallstack(MakeCallstack(10, {0x30}), 7);
+
+  EXPECT_FALSE(profile.IsEmpty());
+  EXPECT_EQ(profile.GetDurationNs(10, callstack.m_Hash), 1500);
+  EXPECT_EQ(profile.GetDurationNs(20, callstack.m_Hash), 300);
+  EXPECT_EQ(profile.GetDurationNs(10, MakeCallstack(10, {0x30}).m_Hash), 7);
+  EXPECT_EQ(profile.GetDurationNs(30, callstack.m_Hash), 0);
+
+  profile.Clear();
+  EXPECT_TRUE(profile.IsEmpty());
+  EXPECT_EQ(profile.GetDurationNs(10, callstack.m_Hash), 0);
+}
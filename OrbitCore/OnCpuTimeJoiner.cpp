@@ -0,0 +1,138 @@
+#include "OnCpuTimeJoiner.h"
+
+#include <algorithm>
+
+void OnCpuTimeJoiner::AddActivity(uint32_t tid, uint64_t begin, uint64_t end) {
+  if (end <= begin) {
+    return;
+  }
+  std::vector<Activity>& activities = threads_[tid].activities;
+  if (activities.empty() || begin >= activities.back().end) {
+    uint64_t on_cpu_before =
+        activities.empty() ? 0
+                           : activities.back().on_cpu_before +
+                                 activities.back().end -
+                                 activities.back().begin;
+    activities.push_back({begin, end, on_cpu_before});
+    return;
+  }
+
+  // Late: inserted in place, clipped to its neighbours, and the sums after
+  // it recomputed.
+  auto it = std::upper_bound(
+      activities.begin(), activities.end(), begin,
+      [](uint64_t time, const Activity& activity) {
+        return time < activity.begin;
+      });
+  if (it != activities.begin()) {
+    begin = std::max(begin, std::prev(it)->end);
+  }
+  if (it != activities.end()) {
+    end = std::min(end, it->begin);
+  }
+  if (end <= begin) {
+    return;
+  }
+  size_t index = it - activities.begin();
+  activities.insert(it, {begin, end, 0});
+  for (size_t i = index; i < activities.size(); ++i) {
+    activities[i].on_cpu_before =
+        i == 0 ? 0
+               : activities[i - 1].on_cpu_before + activities[i - 1].end -
+                     activities[i - 1].begin;
+  }
+}
+
+void OnCpuTimeJoiner::AddTimer(uint32_t tid, uint64_t begin, uint64_t end,
+                               uint64_t function_address, uint64_t key) {
+  std::vector<PendingTimer>& pending_timers = threads_[tid].pending_timers;
+  if (pending_timers.size() >= kMaxPendingTimersPerThread) {
+    // Half at once, so that dropping costs constant time per timer.
+    pending_timers.erase(
+        pending_timers.begin(),
+        pending_timers.begin() + kMaxPendingTimersPerThread / 2);
+  }
+  pending_timers.push_back({begin, end, function_address, key});
+}
+
+void OnCpuTimeJoiner::Join(std::vector<JoinedTimer>* joined) {
+  for (auto& pair : threads_) {
+    JoinThread(&pair.second, joined);
+  }
+}
+
+void OnCpuTimeJoiner::JoinThread(ThreadData* thread,
+                                 std::vector<JoinedTimer>* joined) {
+  const std::vector<Activity>& activities = thread->activities;
+  if (activities.empty() || thread->pending_timers.empty()) {
+    return;
+  }
+
+  // The thread ran until the end of its last activity: the timers that ended
+  // by then are covered.
+  uint64_t known_until = activities.back().end;
+  uint64_t known_from = activities.front().begin;
+  ready_timers_.clear();
+  size_t num_pending = 0;
+  for (const PendingTimer& timer : thread->pending_timers) {
+    if (timer.end > known_until) {
+      thread->pending_timers[num_pending++] = timer;
+    } else if (timer.begin >= known_from) {
+      ready_timers_.push_back(timer);
+    }
+  }
+  thread->pending_timers.resize(num_pending);
+  if (ready_timers_.empty()) {
+    return;
+  }
+
+  // The on-CPU time of a timer is that of the thread up to its end minus that
+  // up to its begin. Both are accumulated in on_cpu_ns, in modular
+  // arithmetic, as the bounds are visited in order of time.
+  size_t first = joined->size();
+  bounds_.clear();
+  for (uint32_t i = 0; i < ready_timers_.size(); ++i) {
+    const PendingTimer& timer = ready_timers_[i];
+    joined->push_back(
+        {timer.key, timer.function_address, timer.end - timer.begin, 0});
+    bounds_.push_back({timer.begin, i, false});
+    bounds_.push_back({timer.end, i, true});
+  }
+  std::sort(bounds_.begin(), bounds_.end(),
+            [](const Bound& a, const Bound& b) { return a.time < b.time; });
+
+  // The first activity that doesn't end by the earliest bound.
+  size_t activity_index =
+      std::upper_bound(activities.begin(), activities.end(),
+                       bounds_.front().time,
+                       [](uint64_t time, const Activity& activity) {
+                         return time < activity.end;
+                       }) -
+      activities.begin();
+  const Activity& last = activities.back();
+  uint64_t total_on_cpu = last.on_cpu_before + last.end - last.begin;
+  for (const Bound& bound : bounds_) {
+    while (activity_index < activities.size() &&
+           activities[activity_index].end <= bound.time) {
+      ++activity_index;
+    }
+    uint64_t on_cpu_until = total_on_cpu;
+    if (activity_index < activities.size()) {
+      const Activity& activity = activities[activity_index];
+      on_cpu_until = activity.on_cpu_before +
+                     (bound.time > activity.begin ? bound.time - activity.begin
+                                                  : 0);
+    }
+    uint64_t& on_cpu_ns = (*joined)[first + bound.index].on_cpu_ns;
+    on_cpu_ns = bound.is_end ? on_cpu_ns + on_cpu_until
+                             : on_cpu_ns - on_cpu_until;
+  }
+}
+
+size_t OnCpuTimeJoiner::GetNumPendingTimers() const {
+  size_t num_pending = 0;
+  for (const auto& pair : threads_) {
+    num_pending += pair.second.pending_timers.size();
+  }
+  return num_pending;
+}
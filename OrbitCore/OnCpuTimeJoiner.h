@@ -0,0 +1,85 @@
+#ifndef ORBIT_CORE_ON_CPU_TIME_JOINER_H_
+#define ORBIT_CORE_ON_CPU_TIME_JOINER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+
+// Splits the wall time of the timers of function calls into the time their
+// thread ran on a core and the time it was descheduled, from the activities
+// of the thread on the cores (see CoreActivity).
+//
+// The activities of each thread are kept with the running sum of their
+// durations, so that the on-CPU time of a thread up to any time is that of
+// the activity at that time plus the sum before it. A timer is only joined
+// once the activities of its thread are known past its end; the timers that
+// are ready are then joined together, in a single pass over the activities
+// of their thread from the earliest of their bounds, rather than with a
+// search per timer.
+class OnCpuTimeJoiner {
+ public:
+  struct JoinedTimer {
+    // As passed to AddTimer.
+    uint64_t key;
+    uint64_t function_address;
+    uint64_t wall_ns;
+    uint64_t on_cpu_ns;
+  };
+
+  // The activities of a thread are expected mostly in order of time. One
+  // that comes after the timers it overlaps were joined is only counted for
+  // the timers joined after it.
+  void AddActivity(uint32_t tid, uint64_t begin, uint64_t end);
+  // key identifies the timer for the caller, it is only passed back.
+  void AddTimer(uint32_t tid, uint64_t begin, uint64_t end,
+                uint64_t function_address, uint64_t key);
+
+  // Appends the timers ready to be joined to joined, and forgets them. The
+  // timers that started before the first activity of their thread are
+  // dropped, as their on-CPU time is unknown.
+  void Join(std::vector<JoinedTimer>* joined);
+
+  size_t GetNumPendingTimers() const;
+  void Clear() { threads_.clear(); }
+
+  // Timers kept per thread while waiting for its activities, the oldest are
+  // dropped beyond that, e.g. when context switches are not traced.
+  static constexpr size_t kMaxPendingTimersPerThread = 64 * 1024;
+
+ private:
+  struct Activity {
+    uint64_t begin;
+    uint64_t end;
+    // The sum of the durations of the activities before this one.
+    uint64_t on_cpu_before;
+  };
+  struct PendingTimer {
+    uint64_t begin;
+    uint64_t end;
+    uint64_t function_address;
+    uint64_t key;
+  };
+  struct ThreadData {
+    // In order of time, without overlaps.
+    std::vector<Activity> activities;
+    std::vector<PendingTimer> pending_timers;
+  };
+  // A bound of a timer to join: the on-CPU time of the thread up to time is
+  // added to or subtracted from the timer at index.
+  struct Bound {
+    uint64_t time;
+    uint32_t index;
+    bool is_end;
+  };
+
+  void JoinThread(ThreadData* thread, std::vector<JoinedTimer>* joined);
+
+  absl::flat_hash_map<uint32_t, ThreadData> threads_;
+  // Reused across calls to Join.
+  std::vector<PendingTimer> ready_timers_;
+  std::vector<Bound> bounds_;
+};
+
+#endif  // ORBIT_CORE_ON_CPU_TIME_JOINER_H_
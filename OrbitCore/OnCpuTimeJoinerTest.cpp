@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "OnCpuTimeJoiner.h"
+
+namespace {
+constexpr uint32_t kTid = 42;
+
+std::vector<OnCpuTimeJoiner::JoinedTimer> Join(OnCpuTimeJoiner* joiner) {
+  std::vector<OnCpuTimeJoiner::JoinedTimer> joined;
+  joiner->Join(&joined);
+  std::sort(joined.begin(), joined.end(),
+            [](const OnCpuTimeJoiner::JoinedTimer& a,
+               const OnCpuTimeJoiner::JoinedTimer& b) {
+              return a.key < b.key;
+            });
+  return joined;
+}
+}  // namespace
+
+TEST(OnCpuTimeJoiner, SplitsNestedTimers) {
+  OnCpuTimeJoiner joiner;
+  joiner.AddActivity(kTid, 0, 100);
+  joiner.AddActivity(kTid, 150, 200);
+  joiner.AddActivity(kTid + 1, 100, 150);
+  // Nested timers come by end: the outer one, descheduled in [100, 150), ends
+  // last.
+  joiner.AddTimer(kTid, 20, 40, 0x10, 1);
+  joiner.AddTimer(kTid, 90, 160, 0x20, 2);
+  joiner.AddTimer(kTid, 10, 190, 0x30, 3);
+  // Not known to have run until its end yet.
+  joiner.AddTimer(kTid, 195, 210, 0x10, 4);
+
+  std::vector<OnCpuTimeJoiner::JoinedTimer> joined = Join(&joiner);
+  ASSERT_EQ(joined.size(), 3);
+  EXPECT_EQ(joined[0].function_address, 0x10);
+  EXPECT_EQ(joined[0].wall_ns, 20);
+  EXPECT_EQ(joined[0].on_cpu_ns, 20);
+  EXPECT_EQ(joined[1].wall_ns, 70);
+  EXPECT_EQ(joined[1].on_cpu_ns, 20);
+  EXPECT_EQ(joined[2].wall_ns, 180);
+  EXPECT_EQ(joined[2].on_cpu_ns, 130);
+  EXPECT_EQ(joiner.GetNumPendingTimers(), 1);
+
+  joiner.AddActivity(kTid, 190, 300);
+  joined = Join(&joiner);
+  ASSERT_EQ(joined.size(), 1);
+  EXPECT_EQ(joined[0].key, 4);
+  EXPECT_EQ(joined[0].on_cpu_ns, 15);
+  EXPECT_EQ(joiner.GetNumPendingTimers(), 0);
+}
+
+TEST(OnCpuTimeJoiner, InsertsLateActivities) {
+  OnCpuTimeJoiner joiner;
+  joiner.AddActivity(kTid, 0, 10);
+  joiner.AddActivity(kTid, 50, 60);
+  joiner.AddActivity(kTid, 20, 30);
+  // Overlapping its neighbours, clipped to [30, 50).
+  joiner.AddActivity(kTid, 25, 55);
+  joiner.AddTimer(kTid, 5, 60, 0x10, 1);
+
+  std::vector<OnCpuTimeJoiner::JoinedTimer> joined = Join(&joiner);
+  ASSERT_EQ(joined.size(), 1);
+  EXPECT_EQ(joined[0].on_cpu_ns, 5 + 10 + 20 + 10);
+}
+
+TEST(OnCpuTimeJoiner, DropsTimersWithoutActivities) {
+  OnCpuTimeJoiner joiner;
+  joiner.AddActivity(kTid, 100, 200);
+  // Started before the thread was seen on a core.
+  joiner.AddTimer(kTid, 50, 150, 0x10, 1);
+  EXPECT_TRUE(Join(&joiner).empty());
+  EXPECT_EQ(joiner.GetNumPendingTimers(), 0);
+
+  for (size_t i = 0; i <= OnCpuTimeJoiner::kMaxPendingTimersPerThread; ++i) {
+    joiner.AddTimer(kTid + 1, i, i + 1, 0x10, i);
+  }
+  EXPECT_LE(joiner.GetNumPendingTimers(),
+            OnCpuTimeJoiner::kMaxPendingTimersPerThread);
+  EXPECT_TRUE(Join(&joiner).empty());
+}
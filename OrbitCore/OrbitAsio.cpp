@@ -4,7 +4,10 @@
 
 #include "OrbitAsio.h"
 
+#include <thread>
+
 #include "Tcp.h"
+#include "Threading.h"
 #include "VariableTracing.h"
 
 //-----------------------------------------------------------------------------
@@ -13,5 +16,31 @@ TcpService::TcpService() { m_IoService = new asio::io_service(); }
 //-----------------------------------------------------------------------------
 TcpService::~TcpService() { PRINT_FUNC; }
 
+//-----------------------------------------------------------------------------
+void TcpService::Run(size_t a_NumThreads, const wchar_t* a_ThreadName) {
+  // Keeps the threads running while there is nothing to read or write.
+  m_Work = std::make_unique<asio::io_context::work>(*m_IoService);
+  for (size_t i = 0; i < a_NumThreads; ++i) {
+    std::thread t([this, a_ThreadName]() {
+      SetCurrentThreadName(a_ThreadName);
+      m_IoService->run();
+    });
+    t.detach();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void TcpService::Stop() {
+  m_Work = nullptr;
+  m_IoService->stop();
+}
+
 //-----------------------------------------------------------------------------
 TcpSocket::~TcpSocket() { PRINT_FUNC; }
+
+//-----------------------------------------------------------------------------
+void TcpSocket::SetSocket(tcp::socket* a_Socket,
+                          asio::io_context& a_IoContext) {
+  m_Socket = a_Socket;
+  m_Strand = std::make_unique<asio::io_context::strand>(a_IoContext);
+}
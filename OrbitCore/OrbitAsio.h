@@ -3,16 +3,30 @@
 //-----------------------------------
 #pragma once
 
+#include <memory>
+
 #include "asio.hpp"
 
 using namespace asio::ip;
 
 //-----------------------------------------------------------------------------
+// The io_context of a TcpEntity, run by a pool of threads. The handlers of a
+// connection are serialized by its strand, see TcpSocket, so that different
+// connections are served in parallel.
 class TcpService {
  public:
   TcpService();
   ~TcpService();
+
+  // Runs the io_context on a_NumThreads detached threads until Stop.
+  void Run(size_t a_NumThreads, const wchar_t* a_ThreadName);
+  // Doesn't wait for the threads, so it can be called from one of them.
+  void Stop();
+
   asio::io_context* m_IoService;
+
+ private:
+  std::unique_ptr<asio::io_context::work> m_Work;
 };
 
 //-----------------------------------------------------------------------------
@@ -21,5 +35,10 @@ class TcpSocket {
   TcpSocket() : m_Socket(nullptr) {}
   TcpSocket(tcp::socket* a_Socket) : m_Socket(a_Socket){};
   ~TcpSocket();
+  // Also creates the strand of a_Socket.
+  void SetSocket(tcp::socket* a_Socket, asio::io_context& a_IoContext);
   tcp::socket* m_Socket;
-};
\ No newline at end of file
+  // Reads and writes of the socket, and the callbacks of the messages read,
+  // only run on this strand.
+  std::unique_ptr<asio::io_context::strand> m_Strand;
+};
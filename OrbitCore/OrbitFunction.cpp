@@ -144,6 +144,12 @@ void Function::UpdateStats(const Timer& timer) {
   }
 }
 
+void Function::UpdateStats(const FunctionStats& stats) {
+  if (stats_ != nullptr) {
+    stats_->Add(stats);
+  }
+}
+
 void Function::GetDisassembly() {
   if (pdb_ && Capture::Connect()) {
     Message msg(Msg_GetData);
@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "BaseTypes.h"
+#include "FunctionSampler.h"
 #include "FunctionStats.h"
 #include "OrbitDbgHelp.h"
 #include "SerializationMacros.h"
@@ -65,6 +66,10 @@ class Function {
     INDEX,
     SIZE,
     CALL_CONV,
+    TIME_P50,
+    TIME_P90,
+    TIME_P99,
+    TIME_P99_9,
     NUM_EXPOSED_MEMBERS
   };
 
@@ -111,6 +116,9 @@ class Function {
     calling_convention_ = calling_convention;
   }
   void SetOrbitType(OrbitType type) { type_ = type; }
+  void SetSamplingPolicy(const SamplingPolicy& policy) {
+    sampling_policy_ = policy;
+  }
   void SetPdb(Pdb* pdb) { pdb_ = pdb; }
 
   const std::string& Name() const { return name_; }
@@ -122,6 +130,12 @@ class Function {
     return pretty_name_lower_;
   }
   OrbitType GetOrbitType() const { return type_; }
+  const SamplingPolicy& GetSamplingPolicy() const { return sampling_policy_; }
+  // Whether not all the calls are recorded, in which case the stats are sent
+  // by the target rather than computed from the timers.
+  bool IsSampled() const {
+    return sampling_policy_.mode != SamplingPolicy::kAll;
+  }
   uint32_t Line() const { return line_; }
   uint64_t Size() const { return size_; }
   const std::string& Probe() const { return probe_; }
@@ -133,6 +147,7 @@ class Function {
   bool IsMemberFunction();
   uint64_t Hash() const { return StringHash(pretty_name_); }
   void UpdateStats(const Timer& timer);
+  void UpdateStats(const FunctionStats& stats);
   bool Hookable();
   void Select();
   void PreHook();
@@ -183,5 +198,6 @@ class Function {
   Pdb* pdb_ = nullptr;
   OrbitType type_ = NONE;
   std::shared_ptr<FunctionStats> stats_;
+  SamplingPolicy sampling_policy_;
   bool selected_ = false;
 };
@@ -99,5 +99,6 @@ void Orbit::Stop() {
 
 #ifdef _WIN32
   Hijacking::DisableAllHooks();
+  Hijacking::FlushUObjectNames();
 #endif
 }
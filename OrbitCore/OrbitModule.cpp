@@ -4,7 +4,10 @@
 
 #include "OrbitModule.h"
 
+#include <algorithm>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "Core.h"
 #include "Pdb.h"
@@ -13,13 +16,20 @@
 
 #ifndef WIN32
 #include "Capture.h"
+#include "DebugFileResolver.h"
 #include "ElfFile.h"
+#include "HashJoin.h"
 #include "LinuxUtils.h"
 #include "OrbitProcess.h"
+#include "OrbitSession.h"
 #include "OrbitUnreal.h"
+#include "ParallelFor.h"
 #include "Params.h"
 #include "Path.h"
+#include "SamplingProfiler.h"
 #include "ScopeTimer.h"
+#include "SymbolCacheFile.h"
+#include "Utils.h"
 #endif
 
 //-----------------------------------------------------------------------------
@@ -119,40 +129,17 @@ std::unique_ptr<ElfFile> FindSymbols(const std::string& module_path) {
     return module_elf_file;
   }
 
-  // Look for .debug files associated with passed in module name
-  // TODO: .debug file might not have same name as module, maybe there is a good
-  //       way of searching files based on buildId
-
-  std::string dir = Path::GetDirectory(module_path);
-  std::string file = Path::StripExtension(Path::GetFileName(module_path));
-
-  std::vector<std::string> search_directories = {
-      dir, dir + "debug_symbols/", Path::GetHome(), "/home/cloudcast/"};
-  std::vector<std::string> symbol_file_extensions = {".debug", ".elf.debug"};
-
-  std::vector<std::string> search_file_paths;
-  for (const auto& directory : search_directories) {
-    for (const auto& file_extension : symbol_file_extensions) {
-      search_file_paths.emplace_back(directory + file + file_extension);
-    }
+  std::vector<std::string> directories = {Path::GetHome(),
+                                         "/home/cloudcast/"};
+  for (std::string& directory :
+       DebugFileResolver::ParseList(GParams.m_DebugDirectories)) {
+    directories.push_back(std::move(directory));
   }
-
-  for (const auto& symbols_file_path : search_file_paths) {
-    if (!Path::FileExists(symbols_file_path)) continue;
-
-    std::unique_ptr<ElfFile> symbols_file = ElfFile::Create(symbols_file_path);
-    if (symbols_file == nullptr) continue;
-
-    if (!symbols_file->HasSymtab()) continue;
-
-    std::string module_build_id = module_elf_file->GetBuildId();
-    if (module_build_id != "" &&
-        module_build_id == symbols_file->GetBuildId()) {
-      return symbols_file;
-    }
-  }
-
-  return nullptr;
+  DebugFileResolver resolver(
+      std::move(directories),
+      DebugFileResolver::ParseList(GParams.m_SymbolServers),
+      Path::GetCachePath());
+  return resolver.Resolve(module_path, module_elf_file->GetBuildId());
 }
 
 bool Pdb::LoadFunctions(const char* file_name) {
@@ -177,27 +164,123 @@ bool Pdb::LoadFunctions(const char* file_name) {
   }
 
   load_bias_ = load_bias.value();
+  build_id_ = elf_file->GetBuildId();
+
+  // Builds without an id can't be told apart, they are never cached.
+  std::string cached_pdb =
+      build_id_.empty() ? "" : Path::GetCachePath() + GetCachedName();
+  if (cached_pdb.empty() || !Load(cached_pdb)) {
+    if (!elf_file->GetFunctions(this, &m_Functions)) {
+      PRINT(
+          absl::StrFormat("Unable to load functions from \"%s\"", m_FileName));
+      return false;
+    }
+    if (!cached_pdb.empty()) {
+      Save();
+    }
+  }
 
-  if (!elf_file->GetFunctions(this, &m_Functions)) {
-    PRINT(absl::StrFormat("Unable to load functions from \"%s\"", m_FileName));
-    return false;
+  // Symbols without debug info have no line table.
+  {
+    SCOPE_TIMER_LOG(absl::StrFormat("Loading line table of %s", m_FileName));
+    elf_file->GetLineTable(&line_table_);
   }
 
   // For uprobes we need a function to be in the .text segment (why?)
   // TODO: Shouldn't m_Functions be limited to the list of functions referencing
   // .text segment?
-  for (auto& function : m_Functions) {
-    // Check if function is in .text segment
-    if (!elf_file->IsAddressInTextSection(function.Address())) {
-      continue;
+  size_t num_shards = std::min(m_Functions.size(), GetNumWorkers());
+  ParallelFor(num_shards, [&](size_t shard) {
+    size_t begin = shard * m_Functions.size() / num_shards;
+    size_t end = (shard + 1) * m_Functions.size() / num_shards;
+    for (size_t i = begin; i < end; ++i) {
+      Function& function = m_Functions[i];
+      // Check if function is in .text segment
+      if (!elf_file->IsAddressInTextSection(function.Address())) {
+        continue;
+      }
+
+      function.SetProbe(m_FileName + ":" + function.Name());
     }
+  });
 
-    function.SetProbe(m_FileName + ":" + function.Name());
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+std::string Pdb::GetCachedName() {
+  return GetCachedKey() + "_" + m_Name + ".sym";
+}
+
+//-----------------------------------------------------------------------------
+std::string Pdb::GetCachedKey() { return build_id_; }
+
+//-----------------------------------------------------------------------------
+bool Pdb::Load(const std::string& a_CachedPdb) {
+  std::unique_ptr<SymbolCacheFile> cache =
+      SymbolCacheFile::Open(a_CachedPdb, GetCachedKey());
+  if (cache == nullptr || cache->GetNumFunctions() == 0) {
+    return false;
   }
 
+  SCOPE_TIMER_LOG(absl::StrFormat("Loading %s", a_CachedPdb));
+  load_bias_ = cache->GetLoadBias();
+  std::string file = Path::GetFileName(m_FileName);
+  m_Functions.reserve(m_Functions.size() + cache->GetNumFunctions());
+  for (size_t i = 0; i < cache->GetNumFunctions(); ++i) {
+    SymbolCacheFile::Symbol symbol = cache->GetFunction(i);
+    m_Functions.emplace_back(symbol.name, symbol.pretty_name, file,
+                             symbol.address, symbol.size, load_bias_, this);
+  }
   return true;
 }
 
+//-----------------------------------------------------------------------------
+void Pdb::Save() {
+  std::string fullName = Path::GetCachePath() + GetCachedName();
+  SCOPE_TIMER_LOG(absl::StrFormat("Saving %s", fullName));
+  SymbolCacheFile::Write(fullName, GetCachedKey(), load_bias_, m_Functions);
+}
+
+//-----------------------------------------------------------------------------
+bool Pdb::LoadFromCache(const std::string& file_name,
+                        const std::string& build_id) {
+  if (build_id.empty()) {
+    return false;
+  }
+  m_FileName = file_name;
+  m_Name = Path::GetFileName(file_name);
+  build_id_ = build_id;
+  return Load(Path::GetCachePath() + GetCachedName());
+}
+
+//-----------------------------------------------------------------------------
+bool Pdb::LoadFromCacheData(const std::string& file_name,
+                            const std::string& build_id,
+                            std::string_view data) {
+  if (build_id.empty() || !SymbolCacheFile::IsValid(data, build_id)) {
+    return false;
+  }
+  m_FileName = file_name;
+  m_Name = Path::GetFileName(file_name);
+  build_id_ = build_id;
+  std::string cached_pdb = Path::GetCachePath() + GetCachedName();
+  return SymbolCacheFile::WriteData(cached_pdb, data) && Load(cached_pdb);
+}
+
+//-----------------------------------------------------------------------------
+void Pdb::SaveToCache(const std::string& file_name,
+                      const std::string& build_id) {
+  if (build_id.empty() || m_Functions.empty()) {
+    return;
+  }
+  m_FileName = file_name;
+  m_Name = Path::GetFileName(file_name);
+  build_id_ = build_id;
+  Save();
+}
+
+//-----------------------------------------------------------------------------
 bool Pdb::LoadPdb(const char* file_name) {
   if (!LoadFunctions(file_name)) {
     return false;
@@ -261,9 +344,12 @@ void Pdb::ProcessData() {
 //-----------------------------------------------------------------------------
 void Pdb::PopulateFunctionMap() {
   SCOPE_TIMER_LOG("Pdb::PopulateFunctionMap");
+  std::vector<std::pair<uint64_t, Function*>> functions;
+  functions.reserve(m_Functions.size());
   for (Function& function : m_Functions) {
-    m_FunctionMap.insert(std::make_pair(function.Address(), &function));
+    functions.emplace_back(function.Address(), &function);
   }
+  m_FunctionIndex.Build(std::move(functions));
 }
 
 //-----------------------------------------------------------------------------
@@ -273,44 +359,74 @@ void Pdb::PopulateStringFunctionMap() {
     m_StringFunctionMap.reserve(unsigned(1.5f * (float)m_Functions.size()));
   }
 
+  // Hashing the names is most of the work, the inserts are cheap.
+  std::vector<uint64_t> hashes(m_Functions.size());
+  size_t num_shards = std::min(m_Functions.size(), GetNumWorkers());
+  ParallelFor(num_shards, [&](size_t shard) {
+    size_t begin = shard * m_Functions.size() / num_shards;
+    size_t end = (shard + 1) * m_Functions.size() / num_shards;
+    for (size_t i = begin; i < end; ++i) {
+      hashes[i] = m_Functions[i].Hash();
+    }
+  });
+
   {
     // SCOPE_TIMER_LOG("Map inserts");
-    for (Function& Function : m_Functions) {
-      m_StringFunctionMap[Function.Hash()] = &Function;
+    for (size_t i = 0; i < m_Functions.size(); ++i) {
+      m_StringFunctionMap[hashes[i]] = &m_Functions[i];
     }
   }
 }
 
 //-----------------------------------------------------------------------------
-Function* Pdb::GetFunctionFromExactAddress(uint64_t a_Address) {
-  uint64_t function_address = a_Address - (uint64_t)GetHModule() + load_bias_;
-  auto it = m_FunctionMap.find(function_address);
-  return (it != m_FunctionMap.end()) ? it->second : nullptr;
+void Pdb::ApplyPresets() {
+  std::shared_ptr<Session> session = Capture::GSessionPresets;
+  if (session == nullptr) return;
+
+  auto it = session->m_Modules.find(Path::GetFileName(m_Name));
+  if (it == session->m_Modules.end()) return;
+
+  SCOPE_TIMER_LOG(absl::StrFormat("Pdb::ApplyPresets - %s", m_Name.c_str()));
+  std::vector<Function*> functions =
+      HashJoin(m_StringFunctionMap, it->second.m_FunctionHashes);
+  for (Function* function : functions) {
+    function->Select();
+  }
 }
 
 //-----------------------------------------------------------------------------
-Function* Pdb::GetFunctionFromProgramCounter(uint64_t a_Address) {
-  if (m_FunctionMap.empty()) {
-    return nullptr;
+bool Pdb::LineInfoFromAddress(uint64_t a_Address, LineInfo& o_LineInfo) {
+  uint64_t address = a_Address - (uint64_t)GetHModule() + load_bias_;
+  const LineTable::Row* row = line_table_.Find(address);
+  if (row == nullptr) {
+    return false;
   }
 
-  uint64_t relative_address = a_Address - (uint64_t)GetHModule() + load_bias_;
-  auto it = m_FunctionMap.upper_bound(relative_address);
+  o_LineInfo.m_Address = a_Address;
+  o_LineInfo.m_File = s2ws(line_table_.GetFile(row->file_id));
+  o_LineInfo.m_Line = row->line;
+  return true;
+}
 
-  if (it == m_FunctionMap.begin()) {
-    return nullptr;
-  }
+//-----------------------------------------------------------------------------
+Function* Pdb::GetFunctionFromExactAddress(uint64_t a_Address) {
+  uint64_t function_address = a_Address - (uint64_t)GetHModule() + load_bias_;
+  return m_FunctionIndex.GetFunctionStartingAt(function_address);
+}
 
-  --it;
-  return it->second;
+//-----------------------------------------------------------------------------
+Function* Pdb::GetFunctionFromProgramCounter(uint64_t a_Address) {
+  uint64_t relative_address = a_Address - (uint64_t)GetHModule() + load_bias_;
+  return m_FunctionIndex.GetFunctionContaining(relative_address);
 }
 
 #endif
 
 //-----------------------------------------------------------------------------
-ORBIT_SERIALIZE(ModuleDebugInfo, 0) {
+ORBIT_SERIALIZE(ModuleDebugInfo, 1) {
   ORBIT_NVP_VAL(0, m_Pid);
   ORBIT_NVP_VAL(0, m_Name);
   ORBIT_NVP_VAL(0, m_Functions);
   ORBIT_NVP_VAL(0, load_bias);
+  ORBIT_NVP_VAL(1, m_SymbolCache);
 }
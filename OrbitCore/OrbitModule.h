@@ -58,5 +58,9 @@ struct ModuleDebugInfo {
   std::string m_Name;
   std::vector<Function> m_Functions;
   uint64_t load_bias;
+  // The functions as the data of a SymbolCacheFile keyed by the build id of
+  // the module, m_Functions then being empty. Much smaller than the
+  // serialized functions, the client caches it as is.
+  std::string m_SymbolCache;
   ORBIT_SERIALIZABLE;
 };
@@ -6,16 +6,21 @@
 
 #include <utility>
 
+#include "Capture.h"
 #include "Core.h"
 #include "Injection.h"
 #include "OrbitModule.h"
 #include "OrbitSession.h"
 #include "OrbitThread.h"
 #include "OrbitType.h"
+#include "ParallelFor.h"
 #include "Path.h"
 #include "Pdb.h"
 #include "ScopeTimer.h"
 #include "Serialization.h"
+#include "SymbolCacheFile.h"
+#include "TcpServer.h"
+#include "Variable.h"
 
 #ifdef _WIN32
 #include <tlhelp32.h>
@@ -100,15 +105,48 @@ void Process::SetID(DWORD a_ID) {
 //-----------------------------------------------------------------------------
 void Process::ListModules() {
   SCOPE_TIMER_LOG("ListModules");
+  SetModules(FindModules(m_Modules));
+}
 
-  ClearTransients();
-
+//-----------------------------------------------------------------------------
+std::map<uint64_t, std::shared_ptr<Module> > Process::FindModules(
+    const std::map<uint64_t, std::shared_ptr<Module> >& a_Known) const {
+  std::map<uint64_t, std::shared_ptr<Module> > modules;
 #ifdef _WIN32
-  SymUtils::ListModules(m_Handle, m_Modules);
+  SymUtils::ListModules(m_Handle, modules);
 #else
-  LinuxUtils::ListModules(m_ID, m_Modules);
+  LinuxUtils::ListModules(m_ID, modules);
 #endif
 
+  std::vector<Module*> newModules;
+  for (auto& pair : modules) {
+    Module& module = *pair.second;
+    auto known = a_Known.find(pair.first);
+    if (known != a_Known.end() &&
+        known->second->m_FullName == module.m_FullName) {
+      module.m_FoundPdb = known->second->m_FoundPdb;
+      module.m_PdbName = known->second->m_PdbName;
+      module.m_PdbSize = known->second->m_PdbSize;
+    } else {
+      newModules.push_back(&module);
+    }
+  }
+
+#ifdef _WIN32
+  // Each is a few file system accesses, possibly to network drives.
+  ParallelFor(newModules.size(), [&](size_t a_Index) {
+    SymUtils::FindPdb(*newModules[a_Index]);
+  });
+#endif
+  return modules;
+}
+
+//-----------------------------------------------------------------------------
+void Process::SetModules(
+    std::map<uint64_t, std::shared_ptr<Module> > a_Modules) {
+  ClearTransients();
+  m_Modules = std::move(a_Modules);
+
   for (auto& pair : m_Modules) {
     std::shared_ptr<Module>& module = pair.second;
     std::string name = ToLower(module->m_Name);
@@ -131,10 +169,21 @@ void Process::ClearTransients() {
 
 //-----------------------------------------------------------------------------
 void Process::EnumerateThreads() {
-  m_Threads.clear();
-  m_ThreadIds.clear();
+  ThreadList known;
+  known.m_Threads = m_Threads;
+  known.m_Names = m_ThreadNames;
+  SetThreads(FindThreads(known));
+}
 
+//-----------------------------------------------------------------------------
+Process::ThreadList Process::FindThreads(const ThreadList& a_Known) const {
+  ThreadList threads;
 #ifdef _WIN32
+  std::unordered_map<DWORD, std::shared_ptr<Thread> > known;
+  for (const std::shared_ptr<Thread>& thread : a_Known.m_Threads) {
+    known[thread->m_TID] = thread;
+  }
+
   // https://blogs.msdn.microsoft.com/oldnewthing/20060223-14/?p=32173/
   HANDLE h = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, m_ID);
   if (h != INVALID_HANDLE_VALUE) {
@@ -142,22 +191,28 @@ void Process::EnumerateThreads() {
     te.dwSize = sizeof(te);
     if (Thread32First(h, &te)) {
       do {
+        // The snapshot has the threads of all processes: only those of this
+        // one are opened, and only once.
         if (te.dwSize >= FIELD_OFFSET(THREADENTRY32, th32OwnerProcessID) +
-                             sizeof(te.th32OwnerProcessID)) {
-          HANDLE thandle;
-          { thandle = OpenThread(THREAD_ALL_ACCESS, FALSE, te.th32ThreadID); }
-
-          if (thandle == NULL) {
-            // ORBIT_LOG(GetLastErrorAsString());
-            continue;
-          }
-
-          if (te.th32OwnerProcessID == m_ID) {
-            std::shared_ptr<Thread> thread = std::make_shared<Thread>();
-            thread->m_Handle = thandle;
-            thread->m_TID = te.th32ThreadID;
-            m_ThreadNames[thread->m_TID] = GetThreadName(thandle);
-            m_Threads.push_back(thread);
+                             sizeof(te.th32OwnerProcessID) &&
+            te.th32OwnerProcessID == m_ID) {
+          DWORD tid = te.th32ThreadID;
+          auto it = known.find(tid);
+          if (it != known.end()) {
+            threads.m_Threads.push_back(it->second);
+            auto name = a_Known.m_Names.find(tid);
+            if (name != a_Known.m_Names.end()) {
+              threads.m_Names[tid] = name->second;
+            }
+          } else {
+            HANDLE thandle = OpenThread(THREAD_ALL_ACCESS, FALSE, tid);
+            if (thandle != NULL) {
+              std::shared_ptr<Thread> thread = std::make_shared<Thread>();
+              thread->m_Handle = thandle;
+              thread->m_TID = tid;
+              threads.m_Names[tid] = GetThreadName(thandle);
+              threads.m_Threads.push_back(thread);
+            }
           }
         }
         te.dwSize = sizeof(te);
@@ -166,11 +221,22 @@ void Process::EnumerateThreads() {
 
     CloseHandle(h);
   }
+#else
+  UNUSED(a_Known);
+#endif
+  return threads;
+}
 
+//-----------------------------------------------------------------------------
+void Process::SetThreads(ThreadList a_Threads) {
+  m_Threads = std::move(a_Threads.m_Threads);
+  m_ThreadIds.clear();
   for (std::shared_ptr<Thread>& thread : m_Threads) {
     m_ThreadIds.insert(thread->m_TID);
   }
-#endif
+  for (auto& pair : a_Threads.m_Names) {
+    m_ThreadNames[pair.first] = std::move(pair.second);
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -303,15 +369,10 @@ std::shared_ptr<OrbitDiaSymbol> Process::SymbolFromAddress(DWORD64 a_Address) {
 
 //-----------------------------------------------------------------------------
 bool Process::LineInfoFromAddress(DWORD64 a_Address, LineInfo& o_LineInfo) {
-#ifdef _WIN32
   std::shared_ptr<Module> module = GetModuleFromAddress(a_Address);
   if (module && module->m_Pdb) {
     return module->m_Pdb->LineInfoFromAddress(a_Address, o_LineInfo);
   }
-#else
-  UNUSED(a_Address);
-  UNUSED(o_LineInfo);
-#endif
 
   return false;
 }
@@ -324,8 +385,41 @@ void Process::SaveSession() {}
 
 //-----------------------------------------------------------------------------
 void Process::RefreshWatchedVariables() {
-  for (std::shared_ptr<Variable> var : m_WatchedVariables) {
-    var->SyncValue();
+  if (!Capture::Connect()) return;
+
+  std::vector<WatchedRange> ranges;
+  for (const std::shared_ptr<Variable>& var : m_WatchedVariables) {
+    ranges.push_back({var->GetRemoteAddress(), var->m_Size});
+  }
+
+  Message msg(Msg_GetWatchedData);
+  std::vector<WatchedRange> coalesced;
+  {
+    ScopeLock lock(m_WatchedMemoryMutex);
+    m_WatchedMemory.SetRanges(ranges);
+    msg.m_Header.m_WatchedDataHeader.m_LayoutId =
+        m_WatchedMemory.GetLayoutId();
+    msg.m_Header.m_WatchedDataHeader.m_Full = m_WatchedMemory.NeedsFullRead();
+    coalesced = m_WatchedMemory.GetRanges();
+  }
+  GTcpServer->Send(msg, std::move(coalesced));
+}
+
+//-----------------------------------------------------------------------------
+void Process::OnWatchedData(const Message& a_Message) {
+  ScopeLock lock(m_WatchedMemoryMutex);
+  const WatchedDataHeader& header = a_Message.GetHeader().m_WatchedDataHeader;
+  if (!m_WatchedMemory.ApplyDelta(header.m_LayoutId, a_Message.GetData(),
+                                  a_Message.m_Size)) {
+    return;
+  }
+
+  for (const std::shared_ptr<Variable>& var : m_WatchedVariables) {
+    const char* data =
+        m_WatchedMemory.GetChanged(var->GetRemoteAddress(), var->m_Size);
+    if (data != nullptr) {
+      var->ReceiveValue(data, var->m_Size);
+    }
   }
 }
 
@@ -408,8 +502,17 @@ void Process::FillModuleDebugInfo(ModuleDebugInfo& a_ModuleDebugInfo) {
     module->LoadDebugInfo();
     const std::string& moduleName = module->m_FullName;
     module->m_Pdb->LoadPdb(moduleName.c_str());
-    a_ModuleDebugInfo.m_Functions = module->m_Pdb->GetFunctions();
+    const std::vector<Function>& functions = module->m_Pdb->GetFunctions();
     a_ModuleDebugInfo.load_bias = module->m_Pdb->GetLoadBias();
+    // Without a build id, the client couldn't tell the build apart.
+    const std::string key = module->m_Pdb->GetCachedKey();
+    if (!key.empty()) {
+      a_ModuleDebugInfo.m_SymbolCache = SymbolCacheFile::Encode(
+          key, a_ModuleDebugInfo.load_bias, functions);
+    }
+    if (a_ModuleDebugInfo.m_SymbolCache.empty()) {
+      a_ModuleDebugInfo.m_Functions = functions;
+    }
   } else {
     PRINT_VAR(a_ModuleDebugInfo.m_Name);
     for (auto& pair : m_NameToModuleMap) {
@@ -15,6 +15,7 @@
 #include "ScopeTimer.h"
 #include "SerializationMacros.h"
 #include "Threading.h"
+#include "WatchedMemory.h"
 #include "absl/container/flat_hash_map.h"
 
 #ifdef __linux__
@@ -23,6 +24,7 @@
 
 class Function;
 class Type;
+class Message;
 class Variable;
 class Thread;
 class Session;
@@ -41,6 +43,21 @@ class Process {
   void LoadDebugInfo();
   void ListModules();
   void EnumerateThreads();
+  // ListModules in two steps, the first of which, taking most of the time,
+  // can run on another thread: FindModules lists the modules without adding
+  // them, and only looks for the pdbs of those not in a_Known at the same
+  // address, of which it copies what was found. SetModules adds them.
+  std::map<uint64_t, std::shared_ptr<Module> > FindModules(
+      const std::map<uint64_t, std::shared_ptr<Module> >& a_Known) const;
+  void SetModules(std::map<uint64_t, std::shared_ptr<Module> > a_Modules);
+  // Same for EnumerateThreads: the threads of a_Known still running are kept
+  // as they are, with their handle and name.
+  struct ThreadList {
+    std::vector<std::shared_ptr<Thread> > m_Threads;
+    std::map<uint32_t, std::string> m_Names;
+  };
+  ThreadList FindThreads(const ThreadList& a_Known) const;
+  void SetThreads(ThreadList a_Threads);
   void UpdateCpuTime();
   void UpdateThreadUsage();
   void SortThreadsByUsage();
@@ -57,8 +74,13 @@ class Process {
   std::string GetThreadNameFromTID(DWORD a_ThreadId) {
     return m_ThreadNames[a_ThreadId];
   }
+  const std::map<uint32_t, std::string>& GetThreadNames() const {
+    return m_ThreadNames;
+  }
   void AddModule(std::shared_ptr<Module>& a_Module);
   void FindPdbs(const std::vector<std::string>& a_SearchLocations);
+  // Loads the symbols of the module a_ModuleDebugInfo.m_Name. Can be called
+  // for different modules concurrently.
   void FillModuleDebugInfo(ModuleDebugInfo& a_ModuleDebugInfo);
 
   static bool IsElevated(HANDLE a_Process);
@@ -93,8 +115,10 @@ class Process {
 #ifdef _WIN32
   std::shared_ptr<OrbitDiaSymbol> SymbolFromAddress(DWORD64 a_Address);
 #endif
-  std::shared_ptr<LinuxSymbol> LinuxSymbolFromAddress(uint64_t a_Address) {
-    return m_Symbols[a_Address];
+  std::shared_ptr<LinuxSymbol> LinuxSymbolFromAddress(
+      uint64_t a_Address) const {
+    auto it = m_Symbols.find(a_Address);
+    return it != m_Symbols.end() ? it->second : nullptr;
   }
   void AddSymbol(uint64_t a_Address, std::shared_ptr<LinuxSymbol> a_Symbol);
   bool HasSymbol(uint64_t a_Address) const {
@@ -117,7 +141,10 @@ class Process {
   const std::vector<std::shared_ptr<Variable> >& GetWatchedVariables() {
     return m_WatchedVariables;
   }
+  // Reads all the watched variables with a single Msg_GetWatchedData.
   void RefreshWatchedVariables();
+  // Updates the watched variables that changed from a Msg_WatchedData.
+  void OnWatchedData(const Message& a_Message);
   void ClearWatchedVariables();
 
   void AddType(Type& a_Type);
@@ -165,6 +192,9 @@ class Process {
   std::vector<Type*> m_Types;
   std::vector<Variable*> m_Globals;
   std::vector<std::shared_ptr<Variable> > m_WatchedVariables;
+  // Requests are sent from the main thread, replies received on the server's.
+  Mutex m_WatchedMemoryMutex;
+  WatchedMemory m_WatchedMemory;
 
   std::unordered_set<uint64_t> m_UniqueTypeHash;
 
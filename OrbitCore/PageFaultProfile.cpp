@@ -0,0 +1,68 @@
+#include "PageFaultProfile.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "SamplingProfiler.h"
+
+void PageFaultProfile::AddPageFaults(ThreadID tid, CallstackID id, bool major,
+                                     uint64_t count) {
+  absl::MutexLock lock(&mutex_);
+  Counts& counts = counts_[{tid, id}];
+  counts.all += count;
+  if (major) {
+    counts.major += count;
+  }
+}
+
+uint64_t PageFaultProfile::GetCount(ThreadID tid, CallstackID id) const {
+  absl::MutexLock lock(&mutex_);
+  auto it = counts_.find({tid, id});
+  return it != counts_.end() ? it->second.all : 0;
+}
+
+uint64_t PageFaultProfile::GetMajorCount(ThreadID tid, CallstackID id) const {
+  absl::MutexLock lock(&mutex_);
+  auto it = counts_.find({tid, id});
+  return it != counts_.end() ? it->second.major : 0;
+}
+
+bool PageFaultProfile::IsEmpty() const {
+  absl::MutexLock lock(&mutex_);
+  return counts_.empty();
+}
+
+void PageFaultProfile::Clear() {
+  absl::MutexLock lock(&mutex_);
+  counts_.clear();
+}
+
+std::shared_ptr<SamplingProfiler> PageFaultProfile::MakeSamplingProfiler(
+    const std::shared_ptr<Process>& process, bool major_only,
+    const std::function<std::shared_ptr<CallStack>(CallstackID)>&
+        get_callstack) const {
+  auto profiler = std::make_shared<SamplingProfiler>(process);
+  profiler->SetIsLinuxPerf(true);
+  profiler->SetState(SamplingProfiler::Sampling);
+  {
+    absl::MutexLock lock(&mutex_);
+    for (const auto& [tid_and_id, counts] : counts_) {
+      uint64_t count = major_only ? counts.major : counts.all;
+      if (count == 0) {
+        continue;
+      }
+      std::shared_ptr<CallStack> callstack = get_callstack(tid_and_id.second);
+      if (callstack == nullptr) {
+        continue;
+      }
+      CallStack thread_callstack = *callstack;
+      thread_callstack.m_ThreadId = tid_and_id.first;
+      profiler->AddCallStackSamples(
+          thread_callstack, tid_and_id.first,
+          static_cast<unsigned int>(std::min<uint64_t>(
+              count, std::numeric_limits<unsigned int>::max())));
+    }
+  }
+  profiler->ProcessSamples();
+  return profiler;
+}
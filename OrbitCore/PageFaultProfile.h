@@ -0,0 +1,51 @@
+#ifndef ORBIT_CORE_PAGE_FAULT_PROFILE_H_
+#define ORBIT_CORE_PAGE_FAULT_PROFILE_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "Callstack.h"
+#include "CallstackTypes.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
+class Process;
+class SamplingProfiler;
+
+// Page faults of the threads of the target during a capture, per thread and
+// per callstack that faulted, from the Timer::PAGE_FAULT timers of the service
+// (see Params::m_PageFaultSamplingPeriod). The timers only carry the id of
+// their callstack, whose frames can arrive later, so the callstacks are only
+// looked up when the profile is made.
+class PageFaultProfile {
+ public:
+  // count is the number of faults the sample stands for.
+  void AddPageFaults(ThreadID tid, CallstackID id, bool major, uint64_t count);
+  uint64_t GetCount(ThreadID tid, CallstackID id) const;
+  uint64_t GetMajorCount(ThreadID tid, CallstackID id) const;
+  bool IsEmpty() const;
+  void Clear();
+
+  // A processed profiler whose samples are the faults of each thread and
+  // callstack, or only the major ones, to show as a SamplingReport: its
+  // percentages are shares of the faults. The callstacks that get_callstack
+  // doesn't know yet are left out.
+  std::shared_ptr<SamplingProfiler> MakeSamplingProfiler(
+      const std::shared_ptr<Process>& process, bool major_only,
+      const std::function<std::shared_ptr<CallStack>(CallstackID)>&
+          get_callstack) const;
+
+ private:
+  struct Counts {
+    uint64_t all = 0;
+    uint64_t major = 0;
+  };
+
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<std::pair<ThreadID, CallstackID>, Counts> counts_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+#endif  // ORBIT_CORE_PAGE_FAULT_PROFILE_H_
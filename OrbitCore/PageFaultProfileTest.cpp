@@ -0,0 +1,28 @@
+#include <gtest/gtest.h>
+
+#include "PageFaultProfile.h"
+
+TEST(PageFaultProfile, SumsCountsPerThreadAndCallstack) {
+  PageFaultProfile profile;
+  EXPECT_TRUE(profile.IsEmpty());
+
+  constexpr CallstackID kId = 0x1234;
+  constexpr CallstackID kOtherId = 0x5678;
+  profile.AddPageFaults(10, kId, /*major=*/false, 100);
+  profile.AddPageFaults(10, kId, /*major=*/true, 1);
+  profile.AddPageFaults(20, kId, /*major=*/false, 100);
+  profile.AddPageFaults(10, kOtherId, /*major=*/true, 1);
+
+  EXPECT_FALSE(profile.IsEmpty());
+  EXPECT_EQ(profile.GetCount(10, kId), 101);
+  EXPECT_EQ(profile.GetMajorCount(10, kId), 1);
+  EXPECT_EQ(profile.GetCount(20, kId), 100);
+  EXPECT_EQ(profile.GetMajorCount(20, kId), 0);
+  EXPECT_EQ(profile.GetCount(10, kOtherId), 1);
+  EXPECT_EQ(profile.GetMajorCount(10, kOtherId), 1);
+  EXPECT_EQ(profile.GetCount(30, kId), 0);
+
+  profile.Clear();
+  EXPECT_TRUE(profile.IsEmpty());
+  EXPECT_EQ(profile.GetCount(10, kId), 0);
+}
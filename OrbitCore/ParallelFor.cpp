@@ -0,0 +1,27 @@
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+size_t GetNumWorkers() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ParallelFor(size_t count, const std::function<void(size_t)>& work) {
+  std::atomic<size_t> next_index = 0;
+  auto worker = [&] {
+    for (size_t i = next_index++; i < count; i = next_index++) {
+      work(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < std::min(count, GetNumWorkers()); ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
@@ -0,0 +1,15 @@
+#ifndef ORBIT_CORE_PARALLEL_FOR_H_
+#define ORBIT_CORE_PARALLEL_FOR_H_
+
+#include <cstddef>
+#include <functional>
+
+// Number of threads ParallelFor runs the work on at most, one per core.
+size_t GetNumWorkers();
+
+// Calls work for each index in [0, count), from up to one thread per core,
+// and returns when all calls are done. The calling thread takes part. Meant
+// for a few large items, typically one shard of the data per worker.
+void ParallelFor(size_t count, const std::function<void(size_t)>& work);
+
+#endif  // ORBIT_CORE_PARALLEL_FOR_H_
@@ -0,0 +1,22 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <vector>
+
+#include "ParallelFor.h"
+
+TEST(ParallelFor, CallsWorkOnceForEachIndex) {
+  std::vector<std::atomic<int>> calls(1000);
+  ParallelFor(calls.size(), [&](size_t i) { ++calls[i]; });
+  for (const std::atomic<int>& count : calls) {
+    EXPECT_EQ(count, 1);
+  }
+}
+
+TEST(ParallelFor, DoesNothingWithoutWork) {
+  bool called = false;
+  ParallelFor(0, [&](size_t) { called = true; });
+  EXPECT_FALSE(called);
+}
+
+TEST(ParallelFor, HasAtLeastOneWorker) { EXPECT_GE(GetNumWorkers(), 1); }
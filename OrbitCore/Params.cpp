@@ -20,6 +20,28 @@ Params::Params()
     : m_LoadTypeInfo(true),
       m_SendCallStacks(true),
       m_TrackContextSwitches(true),
+      m_TrackThreadStates(false),
+      m_TrackOffCpuCallstacks(false),
+      m_BpfStackAggregation(false),
+      m_BpfFunctionCalls(false),
+      m_TrackFileIo(false),
+      m_PageFaultSamplingPeriod(0),
+      m_HeapSamplingIntervalBytes(0),
+      m_LockWaitThresholdNs(0),
+      m_BranchSamplingPeriod(0),
+      m_BranchSamplingAllBranches(false),
+      m_IntelPtWindowMs(100),
+      m_ServiceNice(0),
+      m_NumaLocalReaders(false),
+      m_TrackGpuDriverEvents(false),
+      m_TrackGpuSubmissionCallstacks(false),
+      m_AutoInstrumentFunctions(0),
+      m_AutoInstrumentationMaxOverheadPercent(2.0),
+      m_CompressRemoteTraffic(true),
+      m_RecordCaptureOnService(false),
+      m_RecordCaptureDirectIo(false),
+      m_FlightRecorderWindowMs(0),
+      m_FlightRecorderMaxMb(256),
       m_TrackSamplingEvents(true),
       m_UnrealSupport(true),
       m_UnitySupport(true),
@@ -30,13 +52,15 @@ Params::Params()
       m_AutoReleasePdb(false),
       m_BpftraceCallstacks(false),
       m_SystemWideScheduling(true),
+      m_UseKernelStackWalk(true),
       m_MaxNumTimers(1000000),
+      m_TimerMemoryBudgetMb(0),
       m_FontSize(14.f),
       m_Port(44766),
       m_NumBytesAssembly(1024),
       m_DiffArgs("%1 %2") {}
 
-ORBIT_SERIALIZE(Params, 16) {
+ORBIT_SERIALIZE(Params, 43) {
   ORBIT_NVP_VAL(0, m_LoadTypeInfo);
   ORBIT_NVP_VAL(0, m_SendCallStacks);
   ORBIT_NVP_VAL(0, m_MaxNumTimers);
@@ -61,6 +85,42 @@ ORBIT_SERIALIZE(Params, 16) {
   ORBIT_NVP_VAL(13, m_ProcessFilter);
   ORBIT_NVP_VAL(14, m_BpftraceCallstacks);
   ORBIT_NVP_VAL(15, m_SystemWideScheduling);
+  ORBIT_NVP_VAL(17, m_TrackThreadStates);
+  ORBIT_NVP_VAL(18, m_CompressRemoteTraffic);
+  ORBIT_NVP_VAL(19, m_RecordCaptureOnService);
+  ORBIT_NVP_VAL(20, m_TimerMemoryBudgetMb);
+  ORBIT_NVP_VAL(21, m_UseKernelStackWalk);
+  ORBIT_NVP_VAL(22, m_PmuCounters);
+  ORBIT_NVP_VAL(23, m_TrackOffCpuCallstacks);
+  ORBIT_NVP_VAL(24, m_PerfRecordFilePath);
+  ORBIT_NVP_VAL(25, m_TracedCgroupPath);
+  ORBIT_NVP_VAL(26, m_CaptureFilter);
+  ORBIT_NVP_VAL(27, m_BpfStackAggregation);
+  ORBIT_NVP_VAL(28, m_BpfFunctionCalls);
+  ORBIT_NVP_VAL(29, m_TrackGpuDriverEvents);
+  ORBIT_NVP_VAL(29, m_TrackGpuSubmissionCallstacks);
+  ORBIT_NVP_VAL(30, m_TrackFileIo);
+  ORBIT_NVP_VAL(31, m_HeapSamplingIntervalBytes);
+  ORBIT_NVP_VAL(32, m_PageFaultSamplingPeriod);
+  ORBIT_NVP_VAL(33, m_LockWaitThresholdNs);
+  ORBIT_NVP_VAL(34, m_FlightRecorderWindowMs);
+  ORBIT_NVP_VAL(34, m_FlightRecorderMaxMb);
+  ORBIT_NVP_VAL(35, m_FlightRecorderTriggers);
+  ORBIT_NVP_VAL(36, m_AutoInstrumentFunctions);
+  ORBIT_NVP_VAL(36, m_AutoInstrumentationMaxOverheadPercent);
+  ORBIT_NVP_VAL(37, m_BranchSamplingPeriod);
+  ORBIT_NVP_VAL(37, m_BranchSamplingAllBranches);
+  ORBIT_NVP_VAL(38, m_IntelPtWindowMs);
+  ORBIT_NVP_VAL(39, m_ServiceCpus);
+  ORBIT_NVP_VAL(39, m_ServiceSchedulingPolicy);
+  ORBIT_NVP_VAL(39, m_ServiceNice);
+  ORBIT_NVP_VAL(39, m_NumaLocalReaders);
+  ORBIT_NVP_VAL(40, m_RecordCaptureDirectIo);
+  ORBIT_NVP_VAL(41, m_DebugDirectories);
+  ORBIT_NVP_VAL(41, m_SymbolServers);
+  ORBIT_NVP_VAL(42, m_MemoryBudgets);
+  ORBIT_NVP_VAL(43, m_SampledThreads);
+  ORBIT_NVP_VAL(43, m_SampledThreadNames);
 }
 
 //-----------------------------------------------------------------------------
@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "BaseTypes.h"
+#include "CaptureFilter.h"
 #include "SerializationMacros.h"
 
 struct Params {
@@ -21,6 +22,74 @@ struct Params {
   bool m_LoadTypeInfo;
   bool m_SendCallStacks;
   bool m_TrackContextSwitches;
+  bool m_TrackThreadStates;
+  // On Linux, whether the callstacks at which the threads of the target block
+  // are recorded, with how long they stay blocked, for the off-CPU report.
+  bool m_TrackOffCpuCallstacks;
+  // On Linux, whether the sampled callstacks are counted in the kernel by an
+  // eBPF program instead of being sent one by one, for targets built with
+  // frame pointers.
+  bool m_BpfStackAggregation;
+  // On Linux, whether the entries and returns of the functions instrumented
+  // for their timing only are paired in the kernel by eBPF programs.
+  bool m_BpfFunctionCalls;
+  // On Linux, whether the read, write, pread, pwrite, fsync and openat
+  // syscalls of the target are traced, for the file I/O track of its threads.
+  bool m_TrackFileIo;
+  // On Linux, one in this many minor page faults of the target, and every
+  // major one, is recorded with its callstack, for the page fault track of
+  // its threads and the page fault report. 0 disables page fault sampling.
+  uint64_t m_PageFaultSamplingPeriod;
+  // On Linux, the mean number of bytes allocated by each thread of the
+  // target between two heap allocations sampled with their callstack, for
+  // the memory tracker. 0 disables heap sampling.
+  uint64_t m_HeapSamplingIntervalBytes;
+  // On Linux, the futex waits of the target lasting at least this many
+  // nanoseconds are recorded with the lock address and their callstack, for
+  // the lock contention report. 0 disables lock contention tracing.
+  uint64_t m_LockWaitThresholdNs;
+  // On Linux, when not 0, one in this many taken branches of the target is
+  // sampled with the last branch records of the core, for the call counts in
+  // the call tree and the branch counts in the disassembly, see BranchProfile.
+  // Only calls are sampled, unless m_BranchSamplingAllBranches, which also
+  // tells how often each instruction runs. Needs cores with LBR.
+  uint64_t m_BranchSamplingPeriod;
+  bool m_BranchSamplingAllBranches;
+  // On Linux, how long the calls to a function are traced with Intel
+  // Processor Trace when requested from the functions list during a capture.
+  uint32_t m_IntelPtWindowMs;
+  // On Linux, the nice value of the threads of the service during a capture,
+  // see m_ServiceCpus.
+  int32_t m_ServiceNice;
+  // On Linux, whether each thread reading the ring buffers of the service
+  // runs on the NUMA node of the cores whose ring buffers it reads.
+  bool m_NumaLocalReaders;
+  // On Linux, whether the jobs submitted to AMD GPUs are traced from the
+  // tracepoints of the driver, and whether each job of the target is shown
+  // with the callstack of its submission.
+  bool m_TrackGpuDriverEvents;
+  bool m_TrackGpuSubmissionCallstacks;
+  // On Linux, when not 0, the service instruments up to this many of the
+  // functions with the most exclusive samples on its own during the capture,
+  // for their timing only, see AutoInstrumentation. Those whose calls would
+  // cost more than m_AutoInstrumentationMaxOverheadPercent of a core are
+  // removed. At least one function has to be selected.
+  uint64_t m_AutoInstrumentFunctions;
+  double m_AutoInstrumentationMaxOverheadPercent;
+  bool m_CompressRemoteTraffic;
+  bool m_RecordCaptureOnService;
+  // On Linux, whether the service writes recorded captures with O_DIRECT,
+  // bypassing the page cache, which then doesn't compete with the target for
+  // memory at high rates.
+  bool m_RecordCaptureDirectIo;
+  // On Linux, when not 0, the service keeps the last this many milliseconds
+  // of remote captures in memory, within m_FlightRecorderMaxMb, and only
+  // sends them when asked to, e.g. with 'T' in the capture window or SIGUSR2.
+  uint64_t m_FlightRecorderWindowMs;
+  uint64_t m_FlightRecorderMaxMb;
+  // The conditions on which the service then sends that window on its own,
+  // see ParseCaptureTriggers, e.g. "Update>16,frame:Present>33,lost".
+  std::string m_FlightRecorderTriggers;
   bool m_TrackSamplingEvents;
   bool m_UnrealSupport;
   bool m_UnitySupport;
@@ -32,7 +101,14 @@ struct Params {
   bool m_BpftraceCallstacks;
   bool m_SystemWideScheduling;
   bool m_UseBpftrace;
+  // On Windows, whether sampled callstacks are walked by the kernel and
+  // reported as ETW StackWalk events, rather than by suspending the threads
+  // of the target and walking their stacks from Orbit.
+  bool m_UseKernelStackWalk;
   int m_MaxNumTimers;
+  // Memory the timers of a capture may take before the oldest are spilled to
+  // disk, unlimited if 0.
+  int m_TimerMemoryBudgetMb;
   float m_FontSize;
   int m_Port;
   uint64_t m_NumBytesAssembly;
@@ -44,6 +120,43 @@ struct Params {
   std::string m_Arguments;
   std::string m_WorkingDirectory;
   std::string m_ProcessFilter;
+  // On Linux, the hardware performance counters recorded for each call to the
+  // selected functions, comma-separated among "cycles", "instructions",
+  // "llc-misses" and "branch-misses". None if empty.
+  std::string m_PmuCounters;
+  // On Linux, the file the service writes the raw perf_event_open records of
+  // the capture to, to process them again offline with OrbitPerfReplay. None
+  // if empty.
+  std::string m_PerfRecordFilePath;
+  // On Linux, a cgroup, e.g., "/sys/fs/cgroup/system.slice/foo.service",
+  // whose processes are traced together with the target process, in the same
+  // capture. Their threads are shown as threads of the target process. None
+  // if empty.
+  std::string m_TracedCgroupPath;
+  // On Linux, the cpus the threads of the service run on during a capture,
+  // e.g., "0-3,8", to keep them off the cores of the target. Any if empty.
+  std::string m_ServiceCpus;
+  // On Linux, the only threads of the target sampled, e.g., "1234,1240", and
+  // the shell wildcard patterns of the names of the others sampled,
+  // e.g., "Render*,Audio*", see LinuxTracing::ThreadSelection. All the
+  // threads if both are empty.
+  std::string m_SampledThreads;
+  std::string m_SampledThreadNames;
+  // On Linux, the scheduling policy of the threads of the service during a
+  // capture, "batch" or "idle". The default one if empty.
+  std::string m_ServiceSchedulingPolicy;
+  // On Linux, where the separate debug files of stripped modules are looked
+  // for besides next to the modules, see DebugFileResolver: comma-separated
+  // directories, e.g., "/usr/lib/debug", and comma-separated URLs of
+  // debuginfod servers, e.g., "https://debuginfod.elfutils.org".
+  std::string m_DebugDirectories;
+  std::string m_SymbolServers;
+  // Memory each subsystem may take during a capture before it is stopped,
+  // e.g., "thread_tracks=4096,callstacks=512" in MB, see
+  // MemoryAccounting::SetBudgets. Unlimited if empty.
+  std::string m_MemoryBudgets;
+  // On Linux, what the service sends of the events of remote captures.
+  CaptureFilter m_CaptureFilter;
 
   ORBIT_SERIALIZABLE;
 };
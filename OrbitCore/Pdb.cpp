@@ -13,6 +13,7 @@
 #include "Capture.h"
 #include "Core.h"
 #include "DiaManager.h"
+#include "HashJoin.h"
 #include "Log.h"
 #include "ObjectCount.h"
 #include "OrbitSession.h"
@@ -140,7 +141,8 @@ void Pdb::Clear() {
   m_Types.clear();
   m_Globals.clear();
   m_TypeMap.clear();
-  m_FunctionMap.clear();
+  m_FunctionIndex.Clear();
+  m_TypesAndGlobalsLoaded = false;
   m_FileName = "";
 }
 
@@ -207,7 +209,10 @@ bool Pdb::Load(const std::string& a_CachedPdb) {
 //-----------------------------------------------------------------------------
 void Pdb::Update() {
   if (m_FinishedLoading) {
-    m_LoadingCompleteCallback();
+    // Not set when loaded synchronously, by the ModuleManager.
+    if (m_LoadingCompleteCallback) {
+      m_LoadingCompleteCallback();
+    }
     m_FinishedLoading = false;
     Print();
 
@@ -499,22 +504,32 @@ bool Pdb::LoadDataFromPdb() {
 bool Pdb::LoadPdbDia() {
   if (m_DiaGlobalSymbol) {
     Reserve();
-    auto group =
-        oqpi_tk::make_parallel_group<oqpi::task_type::waitable>("Fork");
-    group->addTask(oqpi_tk::make_task_item("DumpAllFunctions", DumpAllFunctions,
-                                           m_DiaGlobalSymbol));
-    group->addTask(
-        oqpi_tk::make_task_item("DumpTypes", DumpTypes, m_DiaGlobalSymbol));
-    group->addTask(oqpi_tk::make_task_item(
-        "HookDumpAllGlobals", OrbitDumpAllGlobals, m_DiaGlobalSymbol));
-    oqpi_tk::schedule_task(oqpi::task_handle(group)).wait();
-
+    DumpAllFunctions(m_DiaGlobalSymbol);
     return true;
   }
 
   return false;
 }
 
+//-----------------------------------------------------------------------------
+bool Pdb::LoadTypesAndGlobals() {
+  if (m_TypesAndGlobalsLoaded || !m_DiaGlobalSymbol) {
+    return false;
+  }
+
+  SCOPE_TIMER_LOG(
+      absl::StrFormat("Pdb::LoadTypesAndGlobals for %s", m_Name.c_str()));
+  auto group = oqpi_tk::make_parallel_group<oqpi::task_type::waitable>("Fork");
+  group->addTask(
+      oqpi_tk::make_task_item("DumpTypes", DumpTypes, m_DiaGlobalSymbol));
+  group->addTask(oqpi_tk::make_task_item(
+      "HookDumpAllGlobals", OrbitDumpAllGlobals, m_DiaGlobalSymbol));
+  oqpi_tk::schedule_task(oqpi::task_handle(group)).wait();
+
+  m_TypesAndGlobalsLoaded = true;
+  return true;
+}
+
 //-----------------------------------------------------------------------------
 void Pdb::LoadPdbAsync(const char* a_PdbName,
                        std::function<void()> a_CompletionCallback) {
@@ -534,9 +549,12 @@ void Pdb::PopulateFunctionMap() {
   SCOPE_TIMER_LOG(
       absl::StrFormat("Pdb::PopulateFunctionMap for %s", m_FileName.c_str()));
 
+  std::vector<std::pair<uint64_t, Function*>> functions;
+  functions.reserve(m_Functions.size());
   for (Function& Function : m_Functions) {
-    m_FunctionMap.insert(std::make_pair(Function.Address(), &Function));
+    functions.emplace_back(Function.Address(), &Function);
   }
+  m_FunctionIndex.Build(std::move(functions));
 
   m_IsPopulatingFunctionMap = false;
 }
@@ -587,15 +605,10 @@ void Pdb::ApplyPresets() {
 
     auto it = Capture::GSessionPresets->m_Modules.find(pdbName);
     if (it != Capture::GSessionPresets->m_Modules.end()) {
-      SessionModule& a_Module = it->second;
-
-      for (uint64_t hash : a_Module.m_FunctionHashes) {
-        PRINT_VAR(hash);
-        auto fit = m_StringFunctionMap.find(hash);
-        if (fit != m_StringFunctionMap.end()) {
-          Function* function = fit->second;
-          function->Select();
-        }
+      std::vector<Function*> functions =
+          HashJoin(m_StringFunctionMap, it->second.m_FunctionHashes);
+      for (Function* function : functions) {
+        function->Select();
       }
     }
   }
@@ -604,26 +617,13 @@ void Pdb::ApplyPresets() {
 //-----------------------------------------------------------------------------
 Function* Pdb::GetFunctionFromExactAddress(uint64_t a_Address) {
   uint64_t address = a_Address - (uint64_t)GetHModule() + load_bias_;
-
-  if (m_FunctionMap.find(address) != m_FunctionMap.end()) {
-    return m_FunctionMap[address];
-  }
-
-  return nullptr;
+  return m_FunctionIndex.GetFunctionStartingAt(address);
 }
 
 //-----------------------------------------------------------------------------
 Function* Pdb::GetFunctionFromProgramCounter(uint64_t a_Address) {
   uint64_t address = a_Address - (uint64_t)GetHModule() + load_bias_;
-
-  auto it = m_FunctionMap.upper_bound(address);
-  if (!m_FunctionMap.empty() && it != m_FunctionMap.begin()) {
-    --it;
-    Function* func = it->second;
-    return func;
-  }
-
-  return nullptr;
+  return m_FunctionIndex.GetFunctionContaining(address);
 }
 
 //-----------------------------------------------------------------------------
@@ -705,7 +705,6 @@ void Pdb::ProcessData() {
   ScopeLock lock(Capture::GTargetProcess->GetDataMutex());
 
   auto& functions = Capture::GTargetProcess->GetFunctions();
-  auto& globals = Capture::GTargetProcess->GetGlobals();
 
   functions.reserve(functions.size() + m_Functions.size());
 
@@ -722,12 +721,25 @@ void Pdb::ProcessData() {
     }
   }
 
+  PopulateFunctionMap();
+  PopulateStringFunctionMap();
+  // TODO: parallelize: PopulateStringFunctionMap();
+}
+
+//-----------------------------------------------------------------------------
+void Pdb::ProcessTypesAndGlobals() {
+  SCOPE_TIMER_LOG(
+      absl::StrFormat("Pdb::ProcessTypesAndGlobals for %s", m_Name.c_str()));
+
+  ScopeLock lock(Capture::GTargetProcess->GetDataMutex());
+
   for (Type& type : m_Types) {
     type.m_Pdb = this;
     Capture::GTargetProcess->AddType(type);
     GOrbitUnreal.OnTypeAdded(&type);
   }
 
+  auto& globals = Capture::GTargetProcess->GetGlobals();
   for (Variable& var : m_Globals) {
     var.m_Pdb = this;
     globals.push_back(&var);
@@ -736,10 +748,6 @@ void Pdb::ProcessData() {
   for (auto& it : m_TypeMap) {
     it.second.m_Pdb = this;
   }
-
-  PopulateFunctionMap();
-  PopulateStringFunctionMap();
-  // TODO: parallelize: PopulateStringFunctionMap();
 }
 
 //-----------------------------------------------------------------------------
@@ -5,9 +5,12 @@
 
 #include <atomic>
 #include <functional>
+#include <string_view>
 #include <thread>
 #include <vector>
 
+#include "FunctionAddressIndex.h"
+#include "LineTable.h"
 #include "OrbitDbgHelp.h"
 #include "OrbitType.h"
 #include "Variable.h"
@@ -37,7 +40,14 @@ class Pdb {
                             std::function<void()> a_CompletionCallback);
 
   bool LoadDataFromPdb();
+  // Loads the functions only.
   bool LoadPdbDia();
+  // Loads the types and globals, on a module loading thread, once the
+  // functions are loaded. They take most of the time of loading large pdbs
+  // and are only loaded when the user asks for them. Returns false if they
+  // were loaded already.
+  bool LoadTypesAndGlobals();
+  bool AreTypesAndGlobalsLoaded() const { return m_TypesAndGlobalsLoaded; }
   bool LoadLinuxDebugSymbols(const char* a_PdbName);
   void Update();
   void AddFunction(Function& a_Function);
@@ -84,6 +94,13 @@ class Pdb {
   std::string GetCachedKey();
   bool Load(const std::string& a_CachedPdb);
   void Save();
+  // Symbols of remote modules are only cached on Linux.
+  bool LoadFromCache(const std::string&, const std::string&) { return false; }
+  bool LoadFromCacheData(const std::string&, const std::string&,
+                         std::string_view) {
+    return false;
+  }
+  void SaveToCache(const std::string&, const std::string&) {}
 
   bool IsLoading() const { return m_IsLoading; }
 
@@ -101,6 +118,8 @@ class Pdb {
 
   std::shared_ptr<OrbitDiaSymbol> GetDiaSymbolFromId(ULONG a_Id);
   void ProcessData();
+  // Adds the types and globals to the process, from the main thread.
+  void ProcessTypesAndGlobals();
 
  protected:
   void SendStatusToUi();
@@ -112,6 +131,7 @@ class Pdb {
   std::atomic<bool> m_IsLoading;
   std::atomic<bool> m_IsPopulatingFunctionMap;
   std::atomic<bool> m_IsPopulatingFunctionStringMap;
+  std::atomic<bool> m_TypesAndGlobalsLoaded{false};
   std::function<void()> m_LoadingCompleteCallback;
   uint64_t m_MainModule;
   uint64_t load_bias_ = 0;
@@ -129,7 +149,7 @@ class Pdb {
   std::vector<Variable> m_Globals;
   IMAGEHLP_MODULE64 m_ModuleInfo;
   std::unordered_map<ULONG, Type> m_TypeMap;
-  std::map<uint64_t, Function*> m_FunctionMap;
+  FunctionAddressIndex m_FunctionIndex;
   std::unordered_map<unsigned long long, Function*> m_StringFunctionMap;
   Timer* m_LoadTimer;
 
@@ -157,6 +177,9 @@ class Pdb {
     return true;
   }  // This shouldn't do anything on Linux.
   bool LoadPdbDia() { return false; }
+  // Types and globals are not loaded on Linux.
+  bool LoadTypesAndGlobals() { return false; }
+  bool AreTypesAndGlobalsLoaded() const { return true; }
   bool LoadFunctions(const char* file_name);
   void Update() {}
   void AddFunction(Function& a_Function) { m_Functions.push_back(a_Function); }
@@ -205,6 +228,14 @@ class Pdb {
   std::string GetCachedKey();
   bool Load(const std::string& a_CachedPdb);
   void Save();
+  // Symbols of the module file_name of a remote process, cached under its
+  // build id so that they are received from the service only once.
+  bool LoadFromCache(const std::string& file_name, const std::string& build_id);
+  // Same, for symbols received as the data of a symbol cache, which is
+  // written to the cache first.
+  bool LoadFromCacheData(const std::string& file_name,
+                         const std::string& build_id, std::string_view data);
+  void SaveToCache(const std::string& file_name, const std::string& build_id);
 
   bool IsLoading() const { return m_IsLoading; }
 
@@ -213,6 +244,7 @@ class Pdb {
 
   IDiaSymbol* GetDiaSymbolFromId(ULONG a_Id);
   void ProcessData();
+  void ProcessTypesAndGlobals() {}
 
  protected:
   void SendStatusToUi();
@@ -225,6 +257,8 @@ class Pdb {
   std::function<void()> m_LoadingCompleteCallback;
   uint64_t m_MainModule = 0;
   uint64_t load_bias_ = 0;
+  // Of the ELF file the symbols are loaded from, the key of their cache.
+  std::string build_id_;
   float m_LastLoadTime = 0;
   std::vector<Variable> m_WatchedVariables;
   std::set<std::string> m_ArgumentRegisters;
@@ -238,7 +272,8 @@ class Pdb {
   std::vector<Type> m_Types;
   std::vector<Variable> m_Globals;
   std::unordered_map<ULONG, Type> m_TypeMap;
-  std::map<uint64_t, Function*> m_FunctionMap;
+  FunctionAddressIndex m_FunctionIndex;
+  LineTable line_table_;
   std::unordered_map<unsigned long long, Function*> m_StringFunctionMap;
   Timer* m_LoadTimer = nullptr;
 };
@@ -0,0 +1,620 @@
+#include "PerfettoTrace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <optional>
+
+#include "absl/strings/str_format.h"
+
+namespace {
+enum WireType : uint32_t {
+  kVarint = 0,
+  kFixed64 = 1,
+  kLengthDelimited = 2,
+  kFixed32 = 5,
+};
+
+// Field numbers, by message.
+constexpr uint32_t kTracePacket = 1;
+constexpr uint32_t kPacketFtraceEvents = 1;
+constexpr uint32_t kPacketTimestamp = 8;
+constexpr uint32_t kPacketSequenceId = 10;
+constexpr uint32_t kPacketTrackEvent = 11;
+constexpr uint32_t kPacketInternedData = 12;
+constexpr uint32_t kPacketSequenceFlags = 13;
+constexpr uint32_t kPacketTrackDescriptor = 60;
+constexpr uint32_t kTrackEventType = 9;
+constexpr uint32_t kTrackEventNameIid = 10;
+constexpr uint32_t kTrackEventTrackUuid = 11;
+constexpr uint32_t kTrackEventName = 23;
+constexpr uint32_t kTrackDescriptorUuid = 1;
+constexpr uint32_t kTrackDescriptorThread = 4;
+constexpr uint32_t kThreadDescriptorPid = 1;
+constexpr uint32_t kThreadDescriptorTid = 2;
+constexpr uint32_t kThreadDescriptorName = 5;
+constexpr uint32_t kInternedDataEventNames = 2;
+constexpr uint32_t kEventNameIid = 1;
+constexpr uint32_t kEventNameName = 2;
+constexpr uint32_t kFtraceBundleCpu = 1;
+constexpr uint32_t kFtraceBundleEvent = 2;
+constexpr uint32_t kFtraceEventTimestamp = 1;
+constexpr uint32_t kFtraceEventPid = 2;
+constexpr uint32_t kFtraceEventSchedSwitch = 4;
+constexpr uint32_t kSchedSwitchPrevComm = 1;
+constexpr uint32_t kSchedSwitchPrevPid = 2;
+constexpr uint32_t kSchedSwitchNextComm = 5;
+constexpr uint32_t kSchedSwitchNextPid = 6;
+
+// TrackEvent.Type.
+constexpr uint64_t kSliceBegin = 1;
+constexpr uint64_t kSliceEnd = 2;
+// TracePacket.SequenceFlags.
+constexpr uint64_t kIncrementalStateCleared = 1;
+constexpr uint64_t kNeedsIncrementalState = 2;
+
+// Of the packets written, all of one sequence.
+constexpr uint64_t kSequenceId = 1;
+// Larger packets are taken for corruption rather than allocated.
+constexpr uint64_t kMaxPacketSize = 256 * 1024 * 1024;
+
+uint64_t GetThreadTrackUuid(uint32_t tid) { return uint64_t{1} << 32 | tid; }
+
+void AppendVarint(uint64_t value, std::string* message) {
+  while (value >= 0x80) {
+    message->push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  message->push_back(static_cast<char>(value));
+}
+
+void AppendTag(uint32_t field, WireType type, std::string* message) {
+  AppendVarint(uint64_t{field} << 3 | type, message);
+}
+
+void AppendVarintField(uint32_t field, uint64_t value, std::string* message) {
+  AppendTag(field, kVarint, message);
+  AppendVarint(value, message);
+}
+
+void AppendBytesField(uint32_t field, std::string_view bytes,
+                      std::string* message) {
+  AppendTag(field, kLengthDelimited, message);
+  AppendVarint(bytes.size(), message);
+  message->append(bytes.data(), bytes.size());
+}
+
+struct ProtoField {
+  uint32_t number;
+  WireType type;
+  // Of varint and fixed fields.
+  uint64_t value;
+  // Of length-delimited fields.
+  std::string_view bytes;
+};
+
+// The fields of an encoded message, in order.
+class ProtoDecoder {
+ public:
+  explicit ProtoDecoder(std::string_view message) : data_(message) {}
+
+  // False at the end of the message, or if it is malformed.
+  bool Next(ProtoField* field);
+  bool IsValid() const { return valid_; }
+
+ private:
+  bool ReadVarint(uint64_t* value);
+
+  std::string_view data_;
+  bool valid_ = true;
+};
+
+bool ProtoDecoder::ReadVarint(uint64_t* value) {
+  *value = 0;
+  for (int shift = 0; shift < 64 && !data_.empty(); shift += 7) {
+    uint8_t byte = static_cast<uint8_t>(data_[0]);
+    data_.remove_prefix(1);
+    *value |= uint64_t{byte & 0x7Fu} << shift;
+    if ((byte & 0x80) == 0) return true;
+  }
+  return false;
+}
+
+bool ProtoDecoder::Next(ProtoField* field) {
+  if (!valid_ || data_.empty()) return false;
+  uint64_t tag;
+  valid_ = ReadVarint(&tag);
+  if (!valid_) return false;
+  field->number = static_cast<uint32_t>(tag >> 3);
+  field->type = static_cast<WireType>(tag & 7);
+  field->value = 0;
+  field->bytes = {};
+  switch (field->type) {
+    case kVarint:
+      valid_ = ReadVarint(&field->value);
+      break;
+    case kFixed64:
+    case kFixed32: {
+      size_t size = field->type == kFixed64 ? 8 : 4;
+      valid_ = data_.size() >= size;
+      if (valid_) {
+        memcpy(&field->value, data_.data(), size);
+        data_.remove_prefix(size);
+      }
+      break;
+    }
+    case kLengthDelimited: {
+      uint64_t size;
+      valid_ = ReadVarint(&size) && size <= data_.size();
+      if (valid_) {
+        field->bytes = data_.substr(0, size);
+        data_.remove_prefix(size);
+      }
+      break;
+    }
+    default:
+      valid_ = false;
+  }
+  return valid_;
+}
+
+class PerfettoTraceReader {
+ public:
+  PerfettoTraceReader(std::istream* stream, TraceEventVisitor* visitor)
+      : stream_(stream), visitor_(visitor) {}
+
+  bool Read();
+
+ private:
+  struct OpenSlice {
+    uint64_t start_ns;
+    std::string name;
+  };
+
+  bool ReadVarint(uint64_t* value);
+  bool ReadPacket(std::string_view packet);
+  bool ReadInternedData(uint32_t sequence_id, std::string_view data);
+  bool ReadTrackDescriptor(std::string_view descriptor);
+  bool ReadTrackEvent(uint32_t sequence_id, uint64_t timestamp,
+                      std::string_view event);
+  bool ReadFtraceEvents(std::string_view bundle);
+  uint32_t GetTid(uint64_t track_uuid) const;
+
+  std::istream* stream_;
+  TraceEventVisitor* visitor_;
+  std::string packet_;
+  // Per sequence, by interning id.
+  std::unordered_map<uint32_t, std::unordered_map<uint64_t, std::string>>
+      event_names_;
+  std::unordered_map<uint64_t, uint32_t> track_tids_;
+  // Per track, innermost last.
+  std::unordered_map<uint64_t, std::vector<OpenSlice>> open_slices_;
+};
+
+bool PerfettoTraceReader::Read() {
+  while (stream_->peek() != std::istream::traits_type::eof()) {
+    uint64_t tag;
+    if (!ReadVarint(&tag)) return false;
+    uint64_t value;
+    switch (tag & 7) {
+      case kVarint:
+        if (!ReadVarint(&value)) return false;
+        break;
+      case kFixed64:
+      case kFixed32:
+        stream_->ignore((tag & 7) == kFixed64 ? 8 : 4);
+        break;
+      case kLengthDelimited: {
+        uint64_t size;
+        if (!ReadVarint(&size) || size > kMaxPacketSize) return false;
+        if ((tag >> 3) != kTracePacket) {
+          stream_->ignore(size);
+          break;
+        }
+        packet_.resize(size);
+        stream_->read(&packet_[0], size);
+        if (static_cast<uint64_t>(stream_->gcount()) != size ||
+            !ReadPacket(packet_)) {
+          return false;
+        }
+        break;
+      }
+      default:
+        return false;
+    }
+    if (!stream_->good()) return false;
+  }
+  return true;
+}
+
+bool PerfettoTraceReader::ReadVarint(uint64_t* value) {
+  *value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    int byte = stream_->get();
+    if (byte == std::istream::traits_type::eof()) return false;
+    *value |= uint64_t{byte & 0x7Fu} << shift;
+    if ((byte & 0x80) == 0) return true;
+  }
+  return false;
+}
+
+bool PerfettoTraceReader::ReadPacket(std::string_view packet) {
+  uint64_t timestamp = 0;
+  uint32_t sequence_id = 0;
+  uint64_t sequence_flags = 0;
+  std::optional<std::string_view> track_event;
+  std::optional<std::string_view> interned_data;
+  std::optional<std::string_view> track_descriptor;
+  std::optional<std::string_view> ftrace_events;
+
+  ProtoDecoder decoder(packet);
+  ProtoField field;
+  while (decoder.Next(&field)) {
+    bool is_message = field.type == kLengthDelimited;
+    switch (field.number) {
+      case kPacketTimestamp:
+        timestamp = field.value;
+        break;
+      case kPacketSequenceId:
+        sequence_id = static_cast<uint32_t>(field.value);
+        break;
+      case kPacketSequenceFlags:
+        sequence_flags = field.value;
+        break;
+      case kPacketTrackEvent:
+        if (is_message) track_event = field.bytes;
+        break;
+      case kPacketInternedData:
+        if (is_message) interned_data = field.bytes;
+        break;
+      case kPacketTrackDescriptor:
+        if (is_message) track_descriptor = field.bytes;
+        break;
+      case kPacketFtraceEvents:
+        if (is_message) ftrace_events = field.bytes;
+        break;
+      default:
+        break;
+    }
+  }
+  if (!decoder.IsValid()) return false;
+
+  // Interned data of the packet that clears the state is of the new state.
+  if ((sequence_flags & kIncrementalStateCleared) != 0) {
+    event_names_.erase(sequence_id);
+  }
+  if (interned_data.has_value() &&
+      !ReadInternedData(sequence_id, *interned_data)) {
+    return false;
+  }
+  if (track_descriptor.has_value() &&
+      !ReadTrackDescriptor(*track_descriptor)) {
+    return false;
+  }
+  if (track_event.has_value() &&
+      !ReadTrackEvent(sequence_id, timestamp, *track_event)) {
+    return false;
+  }
+  if (ftrace_events.has_value() && !ReadFtraceEvents(*ftrace_events)) {
+    return false;
+  }
+  return true;
+}
+
+bool PerfettoTraceReader::ReadInternedData(uint32_t sequence_id,
+                                           std::string_view data) {
+  ProtoDecoder decoder(data);
+  ProtoField field;
+  while (decoder.Next(&field)) {
+    if (field.number != kInternedDataEventNames ||
+        field.type != kLengthDelimited) {
+      continue;
+    }
+    uint64_t iid = 0;
+    std::string_view name;
+    ProtoDecoder event_name(field.bytes);
+    ProtoField event_name_field;
+    while (event_name.Next(&event_name_field)) {
+      if (event_name_field.number == kEventNameIid) {
+        iid = event_name_field.value;
+      } else if (event_name_field.number == kEventNameName) {
+        name = event_name_field.bytes;
+      }
+    }
+    if (!event_name.IsValid()) return false;
+    event_names_[sequence_id][iid] = std::string(name);
+  }
+  return decoder.IsValid();
+}
+
+bool PerfettoTraceReader::ReadTrackDescriptor(std::string_view descriptor) {
+  uint64_t uuid = 0;
+  std::optional<std::string_view> thread;
+  ProtoDecoder decoder(descriptor);
+  ProtoField field;
+  while (decoder.Next(&field)) {
+    if (field.number == kTrackDescriptorUuid) {
+      uuid = field.value;
+    } else if (field.number == kTrackDescriptorThread &&
+               field.type == kLengthDelimited) {
+      thread = field.bytes;
+    }
+  }
+  if (!decoder.IsValid()) return false;
+  if (!thread.has_value()) return true;
+
+  uint32_t tid = 0;
+  std::string_view name;
+  ProtoDecoder thread_decoder(*thread);
+  while (thread_decoder.Next(&field)) {
+    if (field.number == kThreadDescriptorTid) {
+      tid = static_cast<uint32_t>(field.value);
+    } else if (field.number == kThreadDescriptorName) {
+      name = field.bytes;
+    }
+  }
+  if (!thread_decoder.IsValid()) return false;
+  track_tids_[uuid] = tid;
+  if (!name.empty()) {
+    visitor_->OnThreadName(tid, name);
+  }
+  return true;
+}
+
+bool PerfettoTraceReader::ReadTrackEvent(uint32_t sequence_id,
+                                         uint64_t timestamp,
+                                         std::string_view event) {
+  uint64_t type = 0;
+  uint64_t name_iid = 0;
+  uint64_t track_uuid = 0;
+  std::optional<std::string_view> name;
+  ProtoDecoder decoder(event);
+  ProtoField field;
+  while (decoder.Next(&field)) {
+    switch (field.number) {
+      case kTrackEventType:
+        type = field.value;
+        break;
+      case kTrackEventNameIid:
+        name_iid = field.value;
+        break;
+      case kTrackEventTrackUuid:
+        track_uuid = field.value;
+        break;
+      case kTrackEventName:
+        name = field.bytes;
+        break;
+      default:
+        break;
+    }
+  }
+  if (!decoder.IsValid()) return false;
+
+  if (type == kSliceBegin) {
+    OpenSlice slice{timestamp, std::string(name.value_or(""))};
+    if (!name.has_value()) {
+      const auto& names = event_names_[sequence_id];
+      auto it = names.find(name_iid);
+      if (it != names.end()) slice.name = it->second;
+    }
+    open_slices_[track_uuid].push_back(std::move(slice));
+  } else if (type == kSliceEnd) {
+    std::vector<OpenSlice>& slices = open_slices_[track_uuid];
+    // Ends of slices that began before the trace are dropped.
+    if (slices.empty()) return true;
+    OpenSlice slice = std::move(slices.back());
+    slices.pop_back();
+
+    TraceScope scope;
+    scope.tid = GetTid(track_uuid);
+    scope.depth = static_cast<uint32_t>(slices.size());
+    scope.start_ns = slice.start_ns;
+    scope.end_ns = timestamp;
+    scope.name = slice.name;
+    visitor_->OnScope(scope);
+  }
+  return true;
+}
+
+bool PerfettoTraceReader::ReadFtraceEvents(std::string_view bundle) {
+  uint16_t cpu = 0;
+  ProtoDecoder decoder(bundle);
+  ProtoField field;
+  while (decoder.Next(&field)) {
+    if (field.number == kFtraceBundleCpu) {
+      cpu = static_cast<uint16_t>(field.value);
+    }
+  }
+  if (!decoder.IsValid()) return false;
+
+  decoder = ProtoDecoder(bundle);
+  while (decoder.Next(&field)) {
+    if (field.number != kFtraceBundleEvent || field.type != kLengthDelimited) {
+      continue;
+    }
+    uint64_t timestamp = 0;
+    std::optional<std::string_view> sched_switch;
+    ProtoDecoder event(field.bytes);
+    ProtoField event_field;
+    while (event.Next(&event_field)) {
+      if (event_field.number == kFtraceEventTimestamp) {
+        timestamp = event_field.value;
+      } else if (event_field.number == kFtraceEventSchedSwitch &&
+                 event_field.type == kLengthDelimited) {
+        sched_switch = event_field.bytes;
+      }
+    }
+    if (!event.IsValid()) return false;
+    if (!sched_switch.has_value()) continue;
+
+    uint32_t prev_pid = 0;
+    uint32_t next_pid = 0;
+    ProtoDecoder switch_decoder(*sched_switch);
+    while (switch_decoder.Next(&event_field)) {
+      if (event_field.number == kSchedSwitchPrevPid) {
+        prev_pid = static_cast<uint32_t>(event_field.value);
+      } else if (event_field.number == kSchedSwitchNextPid) {
+        next_pid = static_cast<uint32_t>(event_field.value);
+      }
+    }
+    if (!switch_decoder.IsValid()) return false;
+
+    // The idle thread of the core, pid 0, isn't one of the trace.
+    for (ContextSwitch::SwitchType type :
+         {ContextSwitch::Out, ContextSwitch::In}) {
+      uint32_t tid = type == ContextSwitch::Out ? prev_pid : next_pid;
+      if (tid == 0) continue;
+      ContextSwitch context_switch(type);
+      context_switch.m_ThreadId = tid;
+      context_switch.m_Time = timestamp;
+      context_switch.m_ProcessorIndex = cpu;
+      context_switch.m_ProcessorNumber = static_cast<uint8_t>(cpu);
+      visitor_->OnContextSwitch(context_switch);
+    }
+  }
+  return decoder.IsValid();
+}
+
+uint32_t PerfettoTraceReader::GetTid(uint64_t track_uuid) const {
+  auto it = track_tids_.find(track_uuid);
+  return it != track_tids_.end() ? it->second
+                                 : static_cast<uint32_t>(track_uuid);
+}
+}  // namespace
+
+bool ReadPerfettoTrace(std::istream* stream, TraceEventVisitor* visitor) {
+  PerfettoTraceReader reader(stream, visitor);
+  return reader.Read();
+}
+
+PerfettoTraceWriter::PerfettoTraceWriter(std::ostream* stream)
+    : stream_(stream) {}
+
+void PerfettoTraceWriter::AddThreadName(uint32_t pid, uint32_t tid,
+                                        std::string_view name) {
+  thread_names_[tid] = std::string(name);
+  thread_tracks_.insert(tid);
+  AddThreadTrack(pid, tid, name);
+}
+
+void PerfettoTraceWriter::AddScope(uint32_t pid, const TraceScope& scope) {
+  if (thread_tracks_.insert(scope.tid).second) {
+    AddThreadTrack(pid, scope.tid, "");
+  }
+  AddSliceEnds(scope.tid, scope.start_ns);
+
+  auto [name_id, is_new_name] =
+      name_ids_.try_emplace(std::string(scope.name), name_ids_.size() + 1);
+  AppendVarintField(kPacketTimestamp, scope.start_ns, &packet_);
+  if (is_new_name) {
+    std::string event_name;
+    AppendVarintField(kEventNameIid, name_id->second, &event_name);
+    AppendBytesField(kEventNameName, scope.name, &event_name);
+    std::string interned_data;
+    AppendBytesField(kInternedDataEventNames, event_name, &interned_data);
+    AppendBytesField(kPacketInternedData, interned_data, &packet_);
+  }
+  std::string track_event;
+  AppendVarintField(kTrackEventType, kSliceBegin, &track_event);
+  AppendVarintField(kTrackEventTrackUuid, GetThreadTrackUuid(scope.tid),
+                    &track_event);
+  AppendVarintField(kTrackEventNameIid, name_id->second, &track_event);
+  AppendBytesField(kPacketTrackEvent, track_event, &packet_);
+  WritePacket();
+
+  // Within the enclosing slice, for the ends to be in order.
+  std::vector<uint64_t>& ends = slice_ends_[scope.tid];
+  ends.push_back(ends.empty() ? scope.end_ns
+                              : std::min(scope.end_ns, ends.back()));
+}
+
+void PerfettoTraceWriter::AddContextSwitch(
+    uint32_t /*pid*/, const ContextSwitch& context_switch) {
+  if (context_switch.m_Type == ContextSwitch::Invalid) return;
+  bool is_out = context_switch.m_Type == ContextSwitch::Out;
+  uint32_t tid = context_switch.m_ThreadId;
+  uint32_t prev_pid = is_out ? tid : 0;
+  uint32_t next_pid = is_out ? 0 : tid;
+  std::string idle_name =
+      absl::StrFormat("swapper/%u", context_switch.m_ProcessorIndex);
+  auto it = thread_names_.find(tid);
+  std::string_view name = it != thread_names_.end() ? it->second : "";
+
+  std::string sched_switch;
+  AppendBytesField(kSchedSwitchPrevComm, is_out ? name : idle_name,
+                   &sched_switch);
+  AppendVarintField(kSchedSwitchPrevPid, prev_pid, &sched_switch);
+  AppendBytesField(kSchedSwitchNextComm, is_out ? idle_name : name,
+                   &sched_switch);
+  AppendVarintField(kSchedSwitchNextPid, next_pid, &sched_switch);
+  std::string event;
+  AppendVarintField(kFtraceEventTimestamp, context_switch.m_Time, &event);
+  AppendVarintField(kFtraceEventPid, prev_pid, &event);
+  AppendBytesField(kFtraceEventSchedSwitch, sched_switch, &event);
+  std::string bundle;
+  AppendVarintField(kFtraceBundleCpu, context_switch.m_ProcessorIndex,
+                    &bundle);
+  AppendBytesField(kFtraceBundleEvent, event, &bundle);
+  AppendBytesField(kPacketFtraceEvents, bundle, &packet_);
+  WritePacket();
+}
+
+bool PerfettoTraceWriter::Close() {
+  for (auto& [tid, ends] : slice_ends_) {
+    AddSliceEnds(tid, std::numeric_limits<uint64_t>::max());
+  }
+  stream_->flush();
+  return stream_->good();
+}
+
+void PerfettoTraceWriter::AddThreadTrack(uint32_t pid, uint32_t tid,
+                                         std::string_view name) {
+  std::string thread;
+  AppendVarintField(kThreadDescriptorPid, pid, &thread);
+  AppendVarintField(kThreadDescriptorTid, tid, &thread);
+  if (!name.empty()) {
+    AppendBytesField(kThreadDescriptorName, name, &thread);
+  }
+  std::string descriptor;
+  AppendVarintField(kTrackDescriptorUuid, GetThreadTrackUuid(tid),
+                    &descriptor);
+  AppendBytesField(kTrackDescriptorThread, thread, &descriptor);
+  AppendBytesField(kPacketTrackDescriptor, descriptor, &packet_);
+  WritePacket();
+}
+
+void PerfettoTraceWriter::AddSliceEnds(uint32_t tid, uint64_t time) {
+  std::vector<uint64_t>& ends = slice_ends_[tid];
+  while (!ends.empty() && ends.back() <= time) {
+    AddSliceEnd(tid, ends.back());
+    ends.pop_back();
+  }
+}
+
+void PerfettoTraceWriter::AddSliceEnd(uint32_t tid, uint64_t time) {
+  AppendVarintField(kPacketTimestamp, time, &packet_);
+  std::string track_event;
+  AppendVarintField(kTrackEventType, kSliceEnd, &track_event);
+  AppendVarintField(kTrackEventTrackUuid, GetThreadTrackUuid(tid),
+                    &track_event);
+  AppendBytesField(kPacketTrackEvent, track_event, &packet_);
+  WritePacket();
+}
+
+void PerfettoTraceWriter::WritePacket() {
+  // The first packet of the sequence starts its interned names.
+  AppendVarintField(kPacketSequenceId, kSequenceId, &packet_);
+  AppendVarintField(kPacketSequenceFlags,
+                    wrote_first_packet_
+                        ? kNeedsIncrementalState
+                        : kIncrementalStateCleared | kNeedsIncrementalState,
+                    &packet_);
+  wrote_first_packet_ = true;
+
+  std::string header;
+  AppendTag(kTracePacket, kLengthDelimited, &header);
+  AppendVarint(packet_.size(), &header);
+  stream_->write(header.data(), header.size());
+  stream_->write(packet_.data(), packet_.size());
+  packet_.clear();
+}
@@ -0,0 +1,59 @@
+#ifndef ORBIT_CORE_PERFETTO_TRACE_H_
+#define ORBIT_CORE_PERFETTO_TRACE_H_
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "TraceEvents.h"
+
+// The protobuf trace format of Perfetto, a Trace message of TracePackets:
+// https://perfetto.dev/docs/reference/trace-packet-proto
+//
+// Only its wire format is needed for the few messages used, which are
+// encoded and decoded here rather than with generated code:
+// - track descriptors of threads, for their names;
+// - track events of slices, begins and ends, with names interned or not;
+// - sched_switch ftrace events, for context switches.
+//
+// Reads one packet at a time, so that memory is bounded by the largest
+// packet, the interned names and the open slices whatever the size of the
+// trace. Returns false if the trace is malformed, after visiting the events
+// before the error.
+bool ReadPerfettoTrace(std::istream* stream, TraceEventVisitor* visitor);
+
+// Writes the scopes of each thread as slices on a track of the thread, their
+// names interned, and each context switch as the sched_switch from or to the
+// idle thread of its core.
+class PerfettoTraceWriter : public TraceEventWriter {
+ public:
+  explicit PerfettoTraceWriter(std::ostream* stream);
+
+  void AddThreadName(uint32_t pid, uint32_t tid,
+                     std::string_view name) override;
+  void AddScope(uint32_t pid, const TraceScope& scope) override;
+  void AddContextSwitch(uint32_t pid,
+                        const ContextSwitch& context_switch) override;
+  bool Close() override;
+
+ private:
+  void AddThreadTrack(uint32_t pid, uint32_t tid, std::string_view name);
+  // Of the scopes of the thread that end by time.
+  void AddSliceEnds(uint32_t tid, uint64_t time);
+  void AddSliceEnd(uint32_t tid, uint64_t time);
+  void WritePacket();
+
+  std::ostream* stream_;
+  std::string packet_;
+  bool wrote_first_packet_ = false;
+  std::unordered_set<uint32_t> thread_tracks_;
+  std::unordered_map<uint32_t, std::string> thread_names_;
+  std::unordered_map<std::string, uint64_t> name_ids_;
+  // Per thread, the ends of its open slices, innermost last.
+  std::unordered_map<uint32_t, std::vector<uint64_t>> slice_ends_;
+};
+
+#endif  // ORBIT_CORE_PERFETTO_TRACE_H_
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "PerfettoTrace.h"
+
+namespace {
+struct Scope {
+  uint32_t tid;
+  uint32_t depth;
+  uint64_t start_ns;
+  uint64_t end_ns;
+  std::string name;
+};
+
+class CollectingVisitor : public TraceEventVisitor {
+ public:
+  void OnThreadName(uint32_t tid, std::string_view name) override {
+    thread_names.emplace_back(tid, std::string(name));
+  }
+  void OnScope(const TraceScope& scope) override {
+    scopes.push_back({scope.tid, scope.depth, scope.start_ns, scope.end_ns,
+                      std::string(scope.name)});
+  }
+  void OnContextSwitch(const ContextSwitch& context_switch) override {
+    context_switches.push_back(context_switch);
+  }
+
+  std::vector<std::pair<uint32_t, std::string>> thread_names;
+  std::vector<Scope> scopes;
+  std::vector<ContextSwitch> context_switches;
+};
+
+ContextSwitch MakeContextSwitch(ContextSwitch::SwitchType type, uint32_t tid,
+                                uint64_t time, uint16_t cpu) {
+  ContextSwitch context_switch(type);
+  context_switch.m_ThreadId = tid;
+  context_switch.m_Time = time;
+  context_switch.m_ProcessorIndex = cpu;
+  context_switch.m_ProcessorNumber = static_cast<uint8_t>(cpu);
+  return context_switch;
+}
+
+std::string WriteTrace() {
+  std::stringstream stream;
+  PerfettoTraceWriter writer(&stream);
+  writer.AddThreadName(1, 7, "Main");
+  writer.AddScope(1, {7, 0, 1000, 9000, "Frame"});
+  writer.AddScope(1, {7, 0, 2000, 3000, "Draw"});
+  writer.AddScope(1, {7, 0, 4000, 5000, "Draw"});
+  writer.AddScope(1, {8, 0, 1500, 2500, "Worker"});
+  writer.AddContextSwitch(1, MakeContextSwitch(ContextSwitch::In, 7, 500, 3));
+  writer.AddContextSwitch(1,
+                          MakeContextSwitch(ContextSwitch::Out, 7, 9500, 3));
+  EXPECT_TRUE(writer.Close());
+  return stream.str();
+}
+}  // namespace
+
+TEST(PerfettoTrace, RoundTrips) {
+  std::istringstream stream(WriteTrace());
+  CollectingVisitor visitor;
+  ASSERT_TRUE(ReadPerfettoTrace(&stream, &visitor));
+
+  ASSERT_EQ(visitor.thread_names.size(), 1);
+  EXPECT_EQ(visitor.thread_names[0].first, 7);
+  EXPECT_EQ(visitor.thread_names[0].second, "Main");
+
+  ASSERT_EQ(visitor.scopes.size(), 4);
+  std::sort(visitor.scopes.begin(), visitor.scopes.end(),
+            [](const Scope& a, const Scope& b) {
+              return std::tie(a.tid, a.start_ns) < std::tie(b.tid, b.start_ns);
+            });
+  EXPECT_EQ(visitor.scopes[0].name, "Frame");
+  EXPECT_EQ(visitor.scopes[0].depth, 0);
+  EXPECT_EQ(visitor.scopes[0].end_ns, 9000);
+  EXPECT_EQ(visitor.scopes[1].name, "Draw");
+  EXPECT_EQ(visitor.scopes[1].depth, 1);
+  EXPECT_EQ(visitor.scopes[1].start_ns, 2000);
+  EXPECT_EQ(visitor.scopes[1].end_ns, 3000);
+  EXPECT_EQ(visitor.scopes[2].name, "Draw");
+  EXPECT_EQ(visitor.scopes[2].start_ns, 4000);
+  EXPECT_EQ(visitor.scopes[3].name, "Worker");
+  EXPECT_EQ(visitor.scopes[3].tid, 8);
+  EXPECT_EQ(visitor.scopes[3].depth, 0);
+
+  ASSERT_EQ(visitor.context_switches.size(), 2);
+  EXPECT_EQ(visitor.context_switches[0].m_Type, ContextSwitch::In);
+  EXPECT_EQ(visitor.context_switches[0].m_ThreadId, 7);
+  EXPECT_EQ(visitor.context_switches[0].m_Time, 500);
+  EXPECT_EQ(visitor.context_switches[0].m_ProcessorIndex, 3);
+  EXPECT_EQ(visitor.context_switches[1].m_Type, ContextSwitch::Out);
+  EXPECT_EQ(visitor.context_switches[1].m_Time, 9500);
+}
+
+TEST(PerfettoTrace, FailsOnTruncatedTrace) {
+  std::string trace = WriteTrace();
+  std::istringstream stream(trace.substr(0, trace.size() - 3));
+  CollectingVisitor visitor;
+  EXPECT_FALSE(ReadPerfettoTrace(&stream, &visitor));
+  EXPECT_EQ(visitor.thread_names.size(), 1);
+}
+
+TEST(PerfettoTrace, FailsOnMalformedPacket) {
+  // A packet of 2 bytes, a track event whose length is past its end.
+  std::istringstream stream(std::string("\x0A\x02\x5A\x05", 4));
+  CollectingVisitor visitor;
+  EXPECT_FALSE(ReadPerfettoTrace(&stream, &visitor));
+}
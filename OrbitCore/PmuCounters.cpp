@@ -0,0 +1,78 @@
+#include "PmuCounters.h"
+
+#include <cmath>
+#include <vector>
+
+#include "absl/base/casts.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+
+namespace {
+// A count is stored as the float of count + 1, so that 0 means not recorded.
+uint32_t EncodeCount(const std::optional<uint64_t>& count) {
+  if (!count.has_value()) {
+    return 0;
+  }
+  return absl::bit_cast<uint32_t>(static_cast<float>(count.value()) + 1.f);
+}
+
+std::optional<uint64_t> DecodeCount(uint32_t bits) {
+  if (bits == 0) {
+    return std::nullopt;
+  }
+  float count = absl::bit_cast<float>(bits) - 1.f;
+  return count > 0.f ? static_cast<uint64_t>(std::llround(count)) : 0;
+}
+
+uint64_t Pack(uint32_t low, uint32_t high) {
+  return static_cast<uint64_t>(high) << 32 | low;
+}
+}  // namespace
+
+void SetTimerPmuCounters(const PmuCounters& pmu_counters, Timer* timer) {
+  timer->m_UserData[0] = Pack(EncodeCount(pmu_counters.cycles),
+                              EncodeCount(pmu_counters.instructions));
+  timer->m_UserData[1] = Pack(EncodeCount(pmu_counters.llc_misses),
+                              EncodeCount(pmu_counters.branch_misses));
+}
+
+std::optional<PmuCounters> GetTimerPmuCounters(const Timer& timer) {
+  if (timer.m_UserData[0] == 0 && timer.m_UserData[1] == 0) {
+    return std::nullopt;
+  }
+  PmuCounters pmu_counters;
+  pmu_counters.cycles =
+      DecodeCount(static_cast<uint32_t>(timer.m_UserData[0]));
+  pmu_counters.instructions =
+      DecodeCount(static_cast<uint32_t>(timer.m_UserData[0] >> 32));
+  pmu_counters.llc_misses =
+      DecodeCount(static_cast<uint32_t>(timer.m_UserData[1]));
+  pmu_counters.branch_misses =
+      DecodeCount(static_cast<uint32_t>(timer.m_UserData[1] >> 32));
+  return pmu_counters;
+}
+
+std::string PmuCountersToString(const PmuCounters& pmu_counters) {
+  std::vector<std::string> parts;
+  if (pmu_counters.cycles.has_value() &&
+      pmu_counters.instructions.has_value() && pmu_counters.cycles > 0u) {
+    parts.push_back(absl::StrFormat(
+        "IPC %.2f", static_cast<double>(pmu_counters.instructions.value()) /
+                        pmu_counters.cycles.value()));
+  } else if (pmu_counters.cycles.has_value()) {
+    parts.push_back(
+        absl::StrFormat("cycles %u", pmu_counters.cycles.value()));
+  } else if (pmu_counters.instructions.has_value()) {
+    parts.push_back(absl::StrFormat("instructions %u",
+                                    pmu_counters.instructions.value()));
+  }
+  if (pmu_counters.llc_misses.has_value()) {
+    parts.push_back(
+        absl::StrFormat("LLC misses %u", pmu_counters.llc_misses.value()));
+  }
+  if (pmu_counters.branch_misses.has_value()) {
+    parts.push_back(absl::StrFormat("branch misses %u",
+                                    pmu_counters.branch_misses.value()));
+  }
+  return absl::StrJoin(parts, ", ");
+}
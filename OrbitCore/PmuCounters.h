@@ -0,0 +1,30 @@
+#ifndef ORBIT_CORE_PMU_COUNTERS_H_
+#define ORBIT_CORE_PMU_COUNTERS_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "ScopeTimer.h"
+
+// The counts of the hardware performance counters during a function call,
+// see LinuxTracing::Tracer::SetPmuCounters. Only the counters that were
+// recorded have a value.
+struct PmuCounters {
+  std::optional<uint64_t> cycles;
+  std::optional<uint64_t> instructions;
+  std::optional<uint64_t> llc_misses;
+  std::optional<uint64_t> branch_misses;
+};
+
+// The counters are kept in the m_UserData of the timers of function calls,
+// which is otherwise unused, each as the bits of a float, so they lose
+// precision above 2^24.
+void SetTimerPmuCounters(const PmuCounters& pmu_counters, Timer* timer);
+// std::nullopt if no counter was recorded for the timer.
+std::optional<PmuCounters> GetTimerPmuCounters(const Timer& timer);
+
+// E.g., "IPC 1.52, LLC misses 1203, branch misses 87".
+std::string PmuCountersToString(const PmuCounters& pmu_counters);
+
+#endif  // ORBIT_CORE_PMU_COUNTERS_H_
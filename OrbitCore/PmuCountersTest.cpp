@@ -0,0 +1,35 @@
+#include "PmuCounters.h"
+
+#include <gtest/gtest.h>
+
+TEST(PmuCounters, TimerWithoutCounters) {
+  Timer timer;
+  EXPECT_FALSE(GetTimerPmuCounters(timer).has_value());
+}
+
+TEST(PmuCounters, StoresCountersInTimer) {
+  PmuCounters pmu_counters;
+  pmu_counters.cycles = 1000;
+  pmu_counters.instructions = 1520;
+  pmu_counters.branch_misses = 0;
+  Timer timer;
+  SetTimerPmuCounters(pmu_counters, &timer);
+
+  std::optional<PmuCounters> stored = GetTimerPmuCounters(timer);
+  ASSERT_TRUE(stored.has_value());
+  EXPECT_EQ(stored->cycles, 1000u);
+  EXPECT_EQ(stored->instructions, 1520u);
+  EXPECT_FALSE(stored->llc_misses.has_value());
+  EXPECT_EQ(stored->branch_misses, 0u);
+  EXPECT_EQ(PmuCountersToString(stored.value()), "IPC 1.52, branch misses 0");
+}
+
+TEST(PmuCounters, LargeCountsLosePrecision) {
+  PmuCounters pmu_counters;
+  pmu_counters.cycles = 123'456'789'012;
+  Timer timer;
+  SetTimerPmuCounters(pmu_counters, &timer);
+
+  uint64_t cycles = GetTimerPmuCounters(timer)->cycles.value();
+  EXPECT_NEAR(static_cast<double>(cycles), 123'456'789'012.0, 1e5);
+}
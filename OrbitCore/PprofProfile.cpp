@@ -0,0 +1,229 @@
+#include "PprofProfile.h"
+
+#include <zlib.h>
+
+#include <utility>
+
+namespace {
+enum WireType : uint32_t {
+  kVarint = 0,
+  kLengthDelimited = 2,
+};
+
+// Field numbers, by message.
+constexpr uint32_t kProfileSampleType = 1;
+constexpr uint32_t kProfileSample = 2;
+constexpr uint32_t kProfileMapping = 3;
+constexpr uint32_t kProfileLocation = 4;
+constexpr uint32_t kProfileFunction = 5;
+constexpr uint32_t kProfileStringTable = 6;
+constexpr uint32_t kValueTypeType = 1;
+constexpr uint32_t kValueTypeUnit = 2;
+constexpr uint32_t kSampleLocationId = 1;
+constexpr uint32_t kSampleValue = 2;
+constexpr uint32_t kSampleLabel = 3;
+constexpr uint32_t kLabelKey = 1;
+constexpr uint32_t kLabelNum = 3;
+constexpr uint32_t kMappingId = 1;
+constexpr uint32_t kMappingMemoryStart = 2;
+constexpr uint32_t kMappingMemoryLimit = 3;
+constexpr uint32_t kMappingFileOffset = 4;
+constexpr uint32_t kMappingFilename = 5;
+constexpr uint32_t kMappingBuildId = 6;
+constexpr uint32_t kMappingHasFunctions = 7;
+constexpr uint32_t kLocationId = 1;
+constexpr uint32_t kLocationMappingId = 2;
+constexpr uint32_t kLocationAddress = 3;
+constexpr uint32_t kLocationLine = 4;
+constexpr uint32_t kLineFunctionId = 1;
+constexpr uint32_t kLineLine = 2;
+constexpr uint32_t kFunctionId = 1;
+constexpr uint32_t kFunctionName = 2;
+constexpr uint32_t kFunctionSystemName = 3;
+constexpr uint32_t kFunctionFilename = 4;
+
+// Compressed once this much is pending.
+constexpr size_t kChunkSize = 256 * 1024;
+constexpr int kCompressionLevel = 6;
+// Of deflateInit2, for a gzip header and trailer rather than zlib's.
+constexpr int kGzipWindowBits = 15 + 16;
+constexpr int kMemoryLevel = 8;
+
+void AppendVarint(uint64_t value, std::string* message) {
+  while (value >= 0x80) {
+    message->push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  message->push_back(static_cast<char>(value));
+}
+
+void AppendTag(uint32_t field, WireType type, std::string* message) {
+  AppendVarint(uint64_t{field} << 3 | type, message);
+}
+
+void AppendVarintField(uint32_t field, uint64_t value, std::string* message) {
+  AppendTag(field, kVarint, message);
+  AppendVarint(value, message);
+}
+
+void AppendBytesField(uint32_t field, std::string_view bytes,
+                      std::string* message) {
+  AppendTag(field, kLengthDelimited, message);
+  AppendVarint(bytes.size(), message);
+  message->append(bytes.data(), bytes.size());
+}
+}  // namespace
+
+PprofWriter::PprofWriter(std::ostream* stream, LocationResolver resolver)
+    : stream_(stream),
+      resolver_(std::move(resolver)),
+      zstream_(std::make_unique<z_stream_s>()) {
+  deflateInit2(zstream_.get(), kCompressionLevel, Z_DEFLATED, kGzipWindowBits,
+               kMemoryLevel, Z_DEFAULT_STRATEGY);
+  // The string table starts with the empty string.
+  InternString("");
+  thread_id_key_ = InternString("thread_id");
+
+  message_.clear();
+  AppendVarintField(kValueTypeType, InternString("samples"), &message_);
+  AppendVarintField(kValueTypeUnit, InternString("count"), &message_);
+  AppendBytesField(kProfileSampleType, message_, &pending_);
+}
+
+PprofWriter::~PprofWriter() {
+  Close();
+  deflateEnd(zstream_.get());
+}
+
+uint64_t PprofWriter::InternString(std::string_view value) {
+  auto [it, inserted] =
+      string_ids_.try_emplace(std::string(value), string_ids_.size());
+  if (inserted) {
+    AppendBytesField(kProfileStringTable, value, &pending_);
+  }
+  return it->second;
+}
+
+void PprofWriter::AddMapping(const PprofMapping& mapping) {
+  uint64_t id = mappings_.size() + 1;
+  mappings_[mapping.memory_start] = {id, mapping.memory_limit};
+
+  uint64_t file_name = InternString(mapping.file_name);
+  uint64_t build_id = InternString(mapping.build_id);
+  message_.clear();
+  AppendVarintField(kMappingId, id, &message_);
+  AppendVarintField(kMappingMemoryStart, mapping.memory_start, &message_);
+  AppendVarintField(kMappingMemoryLimit, mapping.memory_limit, &message_);
+  AppendVarintField(kMappingFileOffset, mapping.file_offset, &message_);
+  AppendVarintField(kMappingFilename, file_name, &message_);
+  AppendVarintField(kMappingBuildId, build_id, &message_);
+  AppendVarintField(kMappingHasFunctions, 1, &message_);
+  AppendBytesField(kProfileMapping, message_, &pending_);
+}
+
+uint64_t PprofWriter::FindMapping(uint64_t address) const {
+  auto it = mappings_.upper_bound(address);
+  if (it == mappings_.begin()) return 0;
+  --it;
+  return address < it->second.second ? it->second.first : 0;
+}
+
+uint64_t PprofWriter::InternFunction(const PprofLocation& location) {
+  // Functions of the same name in different files are distinct.
+  std::string key = location.function_name;
+  key.push_back('\0');
+  key += location.file_name;
+  auto [it, inserted] =
+      function_ids_.try_emplace(std::move(key), function_ids_.size() + 1);
+  if (inserted) {
+    uint64_t name = InternString(location.function_name);
+    uint64_t file_name = InternString(location.file_name);
+    message_.clear();
+    AppendVarintField(kFunctionId, it->second, &message_);
+    AppendVarintField(kFunctionName, name, &message_);
+    AppendVarintField(kFunctionSystemName, name, &message_);
+    AppendVarintField(kFunctionFilename, file_name, &message_);
+    AppendBytesField(kProfileFunction, message_, &pending_);
+  }
+  return it->second;
+}
+
+uint64_t PprofWriter::InternLocation(uint64_t address) {
+  auto [it, inserted] =
+      location_ids_.try_emplace(address, location_ids_.size() + 1);
+  if (!inserted) return it->second;
+
+  uint64_t id = it->second;
+  PprofLocation location = resolver_(address);
+  uint64_t function_id = location.function_name.empty()
+                             ? 0
+                             : InternFunction(location);
+  std::string line;
+  AppendVarintField(kLineFunctionId, function_id, &line);
+  AppendVarintField(kLineLine, location.line, &line);
+
+  // InternFunction used message_.
+  message_.clear();
+  AppendVarintField(kLocationId, id, &message_);
+  AppendVarintField(kLocationMappingId, FindMapping(address), &message_);
+  AppendVarintField(kLocationAddress, address, &message_);
+  if (function_id != 0) {
+    AppendBytesField(kLocationLine, line, &message_);
+  }
+  AppendBytesField(kProfileLocation, message_, &pending_);
+  return id;
+}
+
+void PprofWriter::AddSample(absl::Span<const uint64_t> frames, uint64_t count,
+                            uint32_t tid) {
+  if (closed_ || count == 0) return;
+
+  // Locations are written first, as they are interned into message_.
+  packed_.clear();
+  for (uint64_t address : frames) {
+    AppendVarint(InternLocation(address), &packed_);
+  }
+  message_.clear();
+  AppendBytesField(kSampleLocationId, packed_, &message_);
+  packed_.clear();
+  AppendVarint(count, &packed_);
+  AppendBytesField(kSampleValue, packed_, &message_);
+  packed_.clear();
+  AppendVarintField(kLabelKey, thread_id_key_, &packed_);
+  AppendVarintField(kLabelNum, tid, &packed_);
+  AppendBytesField(kSampleLabel, packed_, &message_);
+  AppendBytesField(kProfileSample, message_, &pending_);
+
+  if (pending_.size() >= kChunkSize) {
+    Deflate(/*finish=*/false);
+  }
+}
+
+void PprofWriter::Deflate(bool finish) {
+  z_stream_s* stream = zstream_.get();
+  stream->next_in = reinterpret_cast<Bytef*>(pending_.data());
+  stream->avail_in = static_cast<uInt>(pending_.size());
+  int result = Z_OK;
+  do {
+    compressed_.resize(kChunkSize);
+    stream->next_out = reinterpret_cast<Bytef*>(compressed_.data());
+    stream->avail_out = static_cast<uInt>(compressed_.size());
+    result = deflate(stream, finish ? Z_FINISH : Z_NO_FLUSH);
+    if (result == Z_STREAM_ERROR) {
+      failed_ = true;
+      break;
+    }
+    stream_->write(compressed_.data(), compressed_.size() - stream->avail_out);
+  } while (stream->avail_out == 0 || (finish && result != Z_STREAM_END));
+  pending_.clear();
+  if (!*stream_) failed_ = true;
+}
+
+bool PprofWriter::Close() {
+  if (!closed_) {
+    closed_ = true;
+    Deflate(/*finish=*/true);
+    stream_->flush();
+  }
+  return !failed_ && static_cast<bool>(*stream_);
+}
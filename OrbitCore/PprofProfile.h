@@ -0,0 +1,88 @@
+#ifndef ORBIT_CORE_PPROF_PROFILE_H_
+#define ORBIT_CORE_PPROF_PROFILE_H_
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
+
+struct z_stream_s;
+
+// The gzipped protobuf profile format of pprof:
+// https://github.com/google/pprof/blob/master/proto/profile.proto
+//
+// The Profile message is written as the samples are added, its fields being
+// in no particular order in the wire format: each location, function and
+// string is written once, when a sample first uses it, and everything goes
+// through a single gzip stream. Memory is thus bounded by the distinct
+// addresses and names, whatever the number of samples.
+
+// What a frame's address resolves to.
+struct PprofLocation {
+  std::string function_name;
+  std::string file_name;
+  uint32_t line = 0;
+};
+
+struct PprofMapping {
+  uint64_t memory_start = 0;
+  uint64_t memory_limit = 0;
+  uint64_t file_offset = 0;
+  std::string file_name;
+  std::string build_id;
+};
+
+class PprofWriter {
+ public:
+  using LocationResolver = std::function<PprofLocation(uint64_t address)>;
+
+  PprofWriter(std::ostream* stream, LocationResolver resolver);
+  ~PprofWriter();
+  PprofWriter(const PprofWriter&) = delete;
+  PprofWriter& operator=(const PprofWriter&) = delete;
+
+  // The modules, for pprof to tell the binary of each address. Mappings must
+  // not overlap and are to be added before the samples in them.
+  void AddMapping(const PprofMapping& mapping);
+  // count samples of the callstack of frames, innermost first, on thread tid.
+  void AddSample(absl::Span<const uint64_t> frames, uint64_t count,
+                 uint32_t tid);
+  // Returns false if writing to the stream failed at any point.
+  bool Close();
+
+ private:
+  uint64_t InternString(std::string_view value);
+  uint64_t InternLocation(uint64_t address);
+  uint64_t InternFunction(const PprofLocation& location);
+  uint64_t FindMapping(uint64_t address) const;
+  // Compresses the fields appended to pending_ and writes what zlib outputs,
+  // everything up to the gzip trailer with finish.
+  void Deflate(bool finish);
+
+  std::ostream* stream_;
+  LocationResolver resolver_;
+  std::unique_ptr<z_stream_s> zstream_;
+  std::string pending_;
+  std::string compressed_;
+  bool closed_ = false;
+  bool failed_ = false;
+
+  std::unordered_map<std::string, uint64_t> string_ids_;
+  absl::flat_hash_map<uint64_t, uint64_t> location_ids_;
+  std::unordered_map<std::string, uint64_t> function_ids_;
+  // By memory_start, the id and memory_limit of each mapping.
+  std::map<uint64_t, std::pair<uint64_t, uint64_t>> mappings_;
+  uint64_t thread_id_key_ = 0;
+  // Scratch buffers of the messages being encoded.
+  std::string message_;
+  std::string packed_;
+};
+
+#endif  // ORBIT_CORE_PPROF_PROFILE_H_
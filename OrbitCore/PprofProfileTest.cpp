@@ -0,0 +1,172 @@
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include <cstdint>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "PprofProfile.h"
+
+namespace {
+std::string Gunzip(const std::string& data) {
+  z_stream stream{};
+  inflateInit2(&stream, 15 + 16);
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  std::string output;
+  char buffer[4096];
+  int result = Z_OK;
+  while (result == Z_OK) {
+    stream.next_out = reinterpret_cast<Bytef*>(buffer);
+    stream.avail_out = sizeof(buffer);
+    result = inflate(&stream, Z_NO_FLUSH);
+    output.append(buffer, sizeof(buffer) - stream.avail_out);
+  }
+  inflateEnd(&stream);
+  EXPECT_EQ(result, Z_STREAM_END);
+  return output;
+}
+
+uint64_t ReadVarint(std::string_view* data) {
+  uint64_t value = 0;
+  for (int shift = 0; !data->empty(); shift += 7) {
+    uint8_t byte = static_cast<uint8_t>(data->front());
+    data->remove_prefix(1);
+    value |= uint64_t{byte & 0x7Fu} << shift;
+    if ((byte & 0x80) == 0) break;
+  }
+  return value;
+}
+
+// The varint fields and the length-delimited fields of a message, by number,
+// the only wire types of the profiles written.
+struct Message {
+  std::multimap<uint32_t, uint64_t> varints;
+  std::multimap<uint32_t, std::string_view> bytes;
+
+  explicit Message(std::string_view data) {
+    while (!data.empty()) {
+      uint64_t tag = ReadVarint(&data);
+      uint64_t value = ReadVarint(&data);
+      if ((tag & 7) == 0) {
+        varints.emplace(tag >> 3, value);
+      } else {
+        bytes.emplace(tag >> 3, data.substr(0, value));
+        data.remove_prefix(value);
+      }
+    }
+  }
+  uint64_t Varint(uint32_t field) const { return varints.find(field)->second; }
+  std::vector<std::string_view> All(uint32_t field) const {
+    std::vector<std::string_view> result;
+    auto range = bytes.equal_range(field);
+    for (auto it = range.first; it != range.second; ++it) {
+      result.push_back(it->second);
+    }
+    return result;
+  }
+};
+
+std::vector<uint64_t> ReadPacked(std::string_view data) {
+  std::vector<uint64_t> values;
+  while (!data.empty()) values.push_back(ReadVarint(&data));
+  return values;
+}
+}  // namespace
+
+TEST(PprofWriter, WritesSamplesWithTheirLocationsAndFunctions) {
+  std::ostringstream stream;
+  int num_resolved = 0;
+  {
+    PprofWriter writer(&stream, [&num_resolved](uint64_t address) {
+      ++num_resolved;
+      PprofLocation location;
+      location.function_name = address < 0x1100 ? "leaf" : "main";
+      location.file_name = "main.cpp";
+      location.line = static_cast<uint32_t>(address & 0xFF);
+      return location;
+    });
+    writer.AddMapping({0x1000, 0x2000, 0, "/bin/game", "abcdef"});
+    writer.AddSample({0x1010, 0x1200}, 3, 42);
+    writer.AddSample({0x1020, 0x1200}, 5, 43);
+    writer.AddSample({0x3000}, 1, 42);
+    EXPECT_TRUE(writer.Close());
+  }
+  // Once per distinct address.
+  EXPECT_EQ(num_resolved, 4);
+
+  std::string data = Gunzip(stream.str());
+  Message profile(data);
+  std::vector<std::string_view> strings = profile.All(6);
+  ASSERT_FALSE(strings.empty());
+  EXPECT_EQ(strings[0], "");
+  auto string_at = [&strings](uint64_t index) {
+    return std::string(strings.at(index));
+  };
+
+  Message sample_type(profile.All(1).at(0));
+  EXPECT_EQ(string_at(sample_type.Varint(1)), "samples");
+
+  Message mapping(profile.All(3).at(0));
+  EXPECT_EQ(string_at(mapping.Varint(5)), "/bin/game");
+  EXPECT_EQ(string_at(mapping.Varint(6)), "abcdef");
+
+  std::map<uint64_t, std::string> function_names;
+  for (std::string_view data : profile.All(5)) {
+    Message function(data);
+    function_names[function.Varint(1)] = string_at(function.Varint(2));
+  }
+  EXPECT_EQ(function_names.size(), 2);
+
+  struct Location {
+    uint64_t mapping_id;
+    uint64_t address;
+    std::string function_name;
+  };
+  std::map<uint64_t, Location> locations;
+  for (std::string_view data : profile.All(4)) {
+    Message location(data);
+    Message line(location.All(4).at(0));
+    locations[location.Varint(1)] = {location.Varint(2), location.Varint(3),
+                                     function_names[line.Varint(1)]};
+  }
+  ASSERT_EQ(locations.size(), 4);
+
+  std::vector<std::string_view> samples = profile.All(2);
+  ASSERT_EQ(samples.size(), 3);
+  Message sample(samples[1]);
+  std::vector<uint64_t> location_ids = ReadPacked(sample.All(1).at(0));
+  ASSERT_EQ(location_ids.size(), 2);
+  EXPECT_EQ(locations[location_ids[0]].address, 0x1020);
+  EXPECT_EQ(locations[location_ids[0]].function_name, "leaf");
+  EXPECT_EQ(locations[location_ids[0]].mapping_id, 1);
+  EXPECT_EQ(locations[location_ids[1]].function_name, "main");
+  EXPECT_EQ(ReadPacked(sample.All(2).at(0)), std::vector<uint64_t>{5});
+  Message label(sample.All(3).at(0));
+  EXPECT_EQ(string_at(label.Varint(1)), "thread_id");
+  EXPECT_EQ(label.Varint(3), 43);
+
+  Message unmapped(samples[2]);
+  location_ids = ReadPacked(unmapped.All(1).at(0));
+  EXPECT_EQ(locations[location_ids[0]].mapping_id, 0);
+}
+
+TEST(PprofWriter, StreamsLargeProfilesInChunks) {
+  std::ostringstream stream;
+  PprofWriter writer(&stream, [](uint64_t) { return PprofLocation{"f"}; });
+  size_t compressed_size = 0;
+  for (uint64_t i = 0; i < 200'000; ++i) {
+    writer.AddSample({i % 1000, i % 7}, 1, static_cast<uint32_t>(i % 3));
+    if (i == 100'000) compressed_size = stream.str().size();
+  }
+  // Written while samples are still added.
+  EXPECT_GT(compressed_size, 0);
+  ASSERT_TRUE(writer.Close());
+
+  Message profile(Gunzip(stream.str()));
+  EXPECT_EQ(profile.All(2).size(), 200'000);
+  EXPECT_EQ(profile.All(4).size(), 1000);
+  EXPECT_EQ(profile.All(5).size(), 1);
+}
@@ -0,0 +1,178 @@
+#include "ProcFsReader.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+
+namespace {
+constexpr size_t kMinBufferSize = 16 * 1024;
+constexpr uint64_t kNsPerSecond = 1000 * 1000 * 1000;
+
+uint64_t GetBootTimeNs() {
+  timespec time;
+  clock_gettime(CLOCK_BOOTTIME, &time);
+  return uint64_t(time.tv_sec) * kNsPerSecond + time.tv_nsec;
+}
+}  // namespace
+
+std::optional<std::string_view> ProcFsReader::ReadFile(
+    const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return std::nullopt;
+  }
+
+  // Files of /proc have no size to query, so they are read until the end,
+  // in a single read when the buffer is large enough, which it grows to be.
+  if (buffer_.size() < kMinBufferSize) {
+    buffer_.resize(kMinBufferSize);
+  }
+  size_t size = 0;
+  while (true) {
+    if (size == buffer_.size()) {
+      buffer_.resize(buffer_.size() * 2);
+    }
+    ssize_t num_read = read(fd, buffer_.data() + size, buffer_.size() - size);
+    if (num_read < 0 && errno == EINTR) {
+      continue;
+    }
+    if (num_read < 0) {
+      close(fd);
+      return std::nullopt;
+    }
+    if (num_read == 0) {
+      break;
+    }
+    size += num_read;
+  }
+
+  close(fd);
+  return std::string_view(buffer_.data(), size);
+}
+
+std::unordered_map<uint32_t, float> ProcFsReader::GetCpuUtilization() {
+  std::unordered_map<uint32_t, float> cpu_utilization;
+  DIR* proc_dir = opendir("/proc");
+  if (proc_dir == nullptr) {
+    return cpu_utilization;
+  }
+
+  const uint64_t ticks_per_second = sysconf(_SC_CLK_TCK);
+  const uint64_t now_ns = GetBootTimeNs();
+  absl::flat_hash_map<uint32_t, uint64_t> cpu_ticks;
+  while (dirent* entry = readdir(proc_dir)) {
+    uint32_t pid;
+    if (!absl::SimpleAtoi(entry->d_name, &pid)) {
+      continue;
+    }
+    std::optional<std::string_view> contents =
+        ReadFile(absl::StrFormat("/proc/%u/stat", pid));
+    if (!contents.has_value()) {
+      continue;
+    }
+    std::optional<ProcessStat> stat = ParseStat(*contents);
+    if (!stat.has_value()) {
+      continue;
+    }
+
+    uint64_t used_ticks = stat->cpu_ticks;
+    uint64_t start_ns = stat->start_ticks * kNsPerSecond / ticks_per_second;
+    uint64_t elapsed_ns = now_ns > start_ns ? now_ns - start_ns : 0;
+    auto previous = previous_cpu_ticks_.find(pid);
+    // Fewer ticks than before is another process with the same pid.
+    if (previous != previous_cpu_ticks_.end() &&
+        previous->second <= stat->cpu_ticks) {
+      used_ticks = stat->cpu_ticks - previous->second;
+      elapsed_ns = now_ns - previous_time_ns_;
+    }
+
+    float usage = 0.f;
+    if (elapsed_ns > 0) {
+      usage = 100.f * used_ticks * kNsPerSecond /
+              (float(ticks_per_second) * elapsed_ns);
+    }
+    cpu_utilization[pid] = usage;
+    cpu_ticks[pid] = stat->cpu_ticks;
+  }
+  closedir(proc_dir);
+
+  previous_cpu_ticks_ = std::move(cpu_ticks);
+  previous_time_ns_ = now_ns;
+  return cpu_utilization;
+}
+
+bool ProcFsReader::Is64Bit(pid_t pid) {
+  int fd = open(absl::StrFormat("/proc/%d/exe", pid).c_str(),
+                O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  char header[5];
+  ssize_t num_read = pread(fd, header, sizeof(header), 0);
+  close(fd);
+  if (num_read != sizeof(header)) {
+    return false;
+  }
+  return IsElf64(std::string_view(header, sizeof(header))).value_or(false);
+}
+
+std::optional<ProcFsReader::ProcessStat> ProcFsReader::ParseStat(
+    std::string_view stat) {
+  // The name of the executable, second, is in parentheses and can contain
+  // spaces and parentheses itself, so the fields are counted from the last
+  // parenthesis, after which is the third field.
+  size_t name_end = stat.rfind(')');
+  if (name_end == std::string_view::npos) {
+    return std::nullopt;
+  }
+  constexpr size_t kUserTimeField = 14;
+  constexpr size_t kSystemTimeField = 15;
+  constexpr size_t kStartTimeField = 22;
+  uint64_t user_ticks = 0;
+  uint64_t system_ticks = 0;
+  uint64_t start_ticks = 0;
+  size_t num_parsed = 0;
+  size_t begin = name_end + 1;
+  for (size_t field = 3; field <= kStartTimeField; ++field) {
+    begin = stat.find_first_not_of(' ', begin);
+    if (begin == std::string_view::npos) break;
+    size_t end = std::min(stat.find(' ', begin), stat.size());
+    uint64_t* value = field == kUserTimeField     ? &user_ticks
+                      : field == kSystemTimeField ? &system_ticks
+                      : field == kStartTimeField  ? &start_ticks
+                                                  : nullptr;
+    if (value != nullptr) {
+      std::from_chars_result result =
+          std::from_chars(stat.data() + begin, stat.data() + end, *value);
+      if (result.ec != std::errc()) {
+        return std::nullopt;
+      }
+      ++num_parsed;
+    }
+    begin = end;
+  }
+  if (num_parsed != 3) {
+    return std::nullopt;
+  }
+  return ProcessStat{user_ticks + system_ticks, start_ticks};
+}
+
+std::optional<bool> ProcFsReader::IsElf64(std::string_view header) {
+  constexpr size_t kClassIndex = 4;
+  constexpr char kClass32 = 1;
+  constexpr char kClass64 = 2;
+  if (header.size() <= kClassIndex || header.substr(0, 4) != "\x7f" "ELF") {
+    return std::nullopt;
+  }
+  if (header[kClassIndex] == kClass64) return true;
+  if (header[kClassIndex] == kClass32) return false;
+  return std::nullopt;
+}
@@ -0,0 +1,49 @@
+#ifndef ORBIT_CORE_PROC_FS_READER_H_
+#define ORBIT_CORE_PROC_FS_READER_H_
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "absl/container/flat_hash_map.h"
+
+// Reads the files of /proc with plain reads into a buffer reused from one
+// file to the next, rather than through commands run in a shell, so that the
+// processes of a busy machine can be listed at a high refresh rate. Not
+// thread-safe.
+class ProcFsReader {
+ public:
+  // Fields of /proc/[pid]/stat, in clock ticks.
+  struct ProcessStat {
+    // Time spent running, in user and kernel mode.
+    uint64_t cpu_ticks;
+    // Since boot.
+    uint64_t start_ticks;
+  };
+
+  // Contents of path, read whole. Valid until the next read, nullopt if the
+  // file can't be read.
+  std::optional<std::string_view> ReadFile(const std::string& path);
+
+  // CPU usage of each process, in percent of a core, since the previous call
+  // for the processes it saw, since they started for the others.
+  std::unordered_map<uint32_t, float> GetCpuUtilization();
+
+  // Whether the executable of pid is a 64-bit ELF file, from its header.
+  static bool Is64Bit(pid_t pid);
+
+  static std::optional<ProcessStat> ParseStat(std::string_view stat);
+  // Of the first bytes of an ELF file, nullopt if they aren't of one.
+  static std::optional<bool> IsElf64(std::string_view header);
+
+ private:
+  std::string buffer_;
+  absl::flat_hash_map<uint32_t, uint64_t> previous_cpu_ticks_;
+  uint64_t previous_time_ns_ = 0;
+};
+
+#endif  // ORBIT_CORE_PROC_FS_READER_H_
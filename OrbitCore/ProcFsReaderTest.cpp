@@ -0,0 +1,40 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "ProcFsReader.h"
+
+TEST(ProcFsReader, ParsesStat) {
+  std::optional<ProcFsReader::ProcessStat> stat = ProcFsReader::ParseStat(
+      "1234 (a (weird) name) S 1 1234 1234 0 -1 4194560 100 0 0 0 "
+      "25 17 0 0 20 0 1 0 5000 1000000 200 18446744073709551615\n");
+  ASSERT_TRUE(stat.has_value());
+  EXPECT_EQ(stat->cpu_ticks, 42);
+  EXPECT_EQ(stat->start_ticks, 5000);
+
+  EXPECT_FALSE(ProcFsReader::ParseStat("1234 (name) S 1 2 3").has_value());
+  EXPECT_FALSE(ProcFsReader::ParseStat("").has_value());
+}
+
+TEST(ProcFsReader, ChecksElfClass) {
+  EXPECT_EQ(ProcFsReader::IsElf64(std::string("\x7f" "ELF\x02", 5)), true);
+  EXPECT_EQ(ProcFsReader::IsElf64(std::string("\x7f" "ELF\x01", 5)), false);
+  EXPECT_FALSE(ProcFsReader::IsElf64("#!/bin").has_value());
+  EXPECT_FALSE(ProcFsReader::IsElf64("\x7f" "EL").has_value());
+  EXPECT_EQ(ProcFsReader::Is64Bit(getpid()), sizeof(void*) == 8);
+}
+
+TEST(ProcFsReader, ReadsTheFilesOfProc) {
+  ProcFsReader reader;
+  std::optional<std::string_view> maps = reader.ReadFile("/proc/self/maps");
+  ASSERT_TRUE(maps.has_value());
+  EXPECT_NE(maps->find('\n'), std::string_view::npos);
+  EXPECT_FALSE(reader.ReadFile("/proc/self/does_not_exist").has_value());
+
+  std::unordered_map<uint32_t, float> usage = reader.GetCpuUtilization();
+  ASSERT_EQ(usage.count(getpid()), 1);
+  EXPECT_GE(usage[getpid()], 0.f);
+  usage = reader.GetCpuUtilization();
+  EXPECT_EQ(usage.count(getpid()), 1);
+}
@@ -0,0 +1,109 @@
+#include "ProcessInfoLoader.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "OrbitModule.h"
+#include "ScopeTimer.h"
+
+ProcessInfoLoader GProcessInfoLoader;
+
+void ProcessInfoLoader::ListAsync(const std::shared_ptr<Process>& a_Process) {
+  uint64_t generation;
+  {
+    ScopeLock lock(m_Mutex);
+    uint32_t processId = a_Process->GetID();
+    generation = m_Generations[processId];
+    auto it = m_Listing.find(processId);
+    if (it != m_Listing.end() && it->second == generation) return;
+    m_Listing[processId] = generation;
+  }
+  std::thread(&ProcessInfoLoader::ListOnWorker, this, a_Process,
+              GetKnown(*a_Process), generation)
+      .detach();
+}
+
+void ProcessInfoLoader::List(const std::shared_ptr<Process>& a_Process) {
+  SCOPE_TIMER_LOG("ProcessInfoLoader::List");
+  Listing listed = Find(*a_Process, GetKnown(*a_Process));
+  {
+    ScopeLock lock(m_Mutex);
+    uint32_t processId = a_Process->GetID();
+    ++m_Generations[processId];
+    m_Listed.erase(
+        std::remove_if(m_Listed.begin(), m_Listed.end(),
+                       [processId](const auto& a_Listed) {
+                         return a_Listed.first->GetID() == processId;
+                       }),
+        m_Listed.end());
+    Keep(processId, listed);
+  }
+  ScopeLock lock(a_Process->GetDataMutex());
+  a_Process->SetModules(std::move(listed.m_Modules));
+  a_Process->SetThreads(std::move(listed.m_Threads));
+}
+
+void ProcessInfoLoader::Update() {
+  std::vector<std::pair<std::shared_ptr<Process>, Listing>> listed;
+  {
+    ScopeLock lock(m_Mutex);
+    listed.swap(m_Listed);
+  }
+
+  for (auto& pair : listed) {
+    const std::shared_ptr<Process>& process = pair.first;
+    {
+      ScopeLock lock(process->GetDataMutex());
+      process->SetModules(std::move(pair.second.m_Modules));
+      process->SetThreads(std::move(pair.second.m_Threads));
+    }
+    if (m_ListedCallback) {
+      m_ListedCallback(process);
+    }
+  }
+}
+
+ProcessInfoLoader::Listing ProcessInfoLoader::GetKnown(
+    const Process& a_Process) {
+  ScopeLock lock(m_Mutex);
+  auto it = m_Listings.find(a_Process.GetID());
+  // Process ids are reused.
+  if (it == m_Listings.end() ||
+      it->second.m_ProcessName != a_Process.GetFullName()) {
+    return Listing();
+  }
+  return it->second;
+}
+
+ProcessInfoLoader::Listing ProcessInfoLoader::Find(const Process& a_Process,
+                                                   const Listing& a_Known) {
+  Listing listed;
+  listed.m_ProcessName = a_Process.GetFullName();
+  listed.m_Modules = a_Process.FindModules(a_Known.m_Modules);
+  listed.m_Threads = a_Process.FindThreads(a_Known.m_Threads);
+  return listed;
+}
+
+void ProcessInfoLoader::Keep(uint32_t a_ProcessId, const Listing& a_Listed) {
+  Listing& kept = m_Listings[a_ProcessId];
+  kept = a_Listed;
+  for (auto& pair : kept.m_Modules) {
+    pair.second = std::make_shared<Module>(*pair.second);
+    // Only what was found of the module is kept, not its symbols.
+    pair.second->m_Pdb = nullptr;
+  }
+}
+
+void ProcessInfoLoader::ListOnWorker(std::shared_ptr<Process> a_Process,
+                                     Listing a_Known, uint64_t a_Generation) {
+  SetCurrentThreadName(L"ProcessInfoLoader");
+  SCOPE_TIMER_LOG("ProcessInfoLoader::ListOnWorker");
+  Listing listed = Find(*a_Process, a_Known);
+
+  ScopeLock lock(m_Mutex);
+  uint32_t processId = a_Process->GetID();
+  if (m_Generations[processId] != a_Generation) return;
+  m_Listing.erase(processId);
+  Keep(processId, listed);
+  m_Listed.emplace_back(std::move(a_Process), std::move(listed));
+}
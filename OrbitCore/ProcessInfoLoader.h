@@ -0,0 +1,71 @@
+#ifndef ORBIT_CORE_PROCESS_INFO_LOADER_H_
+#define ORBIT_CORE_PROCESS_INFO_LOADER_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "OrbitProcess.h"
+#include "Threading.h"
+
+struct Module;
+
+// Lists the modules and threads of processes on worker threads, so that
+// selecting a process doesn't wait for them, e.g. for the pdbs of hundreds
+// of modules to be looked for. The last listing of each process is kept by
+// process id, and listing it again only looks for the pdbs of the modules
+// that are new and opens the threads that are new. What is listed is set on
+// the process on the main thread, by Update.
+class ProcessInfoLoader {
+ public:
+  using ListedCallback = std::function<void(const std::shared_ptr<Process>&)>;
+
+  // Lists the modules and threads of a_Process, unless they are being listed
+  // already since it was last listed on the main thread.
+  void ListAsync(const std::shared_ptr<Process>& a_Process);
+  // Lists them on the calling thread, the main one, and sets them right
+  // away, e.g. for a session to find its modules. A listing of a_Process by
+  // a worker, not set yet, is then dropped.
+  void List(const std::shared_ptr<Process>& a_Process);
+  // Sets the modules and threads listed since the previous call on their
+  // process, calling the listed callback for each. Called on the main
+  // thread.
+  void Update();
+  void SetListedCallback(ListedCallback a_Callback) {
+    m_ListedCallback = std::move(a_Callback);
+  }
+
+ protected:
+  struct Listing {
+    std::string m_ProcessName;
+    std::map<uint64_t, std::shared_ptr<Module>> m_Modules;
+    Process::ThreadList m_Threads;
+  };
+
+  // What was listed last for a_Process, if it is the same process.
+  Listing GetKnown(const Process& a_Process);
+  static Listing Find(const Process& a_Process, const Listing& a_Known);
+  // Needs m_Mutex locked.
+  void Keep(uint32_t a_ProcessId, const Listing& a_Listed);
+  void ListOnWorker(std::shared_ptr<Process> a_Process, Listing a_Known,
+                    uint64_t a_Generation);
+
+  ListedCallback m_ListedCallback;
+  Mutex m_Mutex;
+  // By process id, copies of what was listed last, as the modules set on
+  // processes change on the main thread.
+  std::unordered_map<uint32_t, Listing> m_Listings;
+  // By process id, of the listings on workers, which are dropped if the
+  // process is listed again on the main thread meanwhile.
+  std::unordered_map<uint32_t, uint64_t> m_Generations;
+  // By process id, the generation of the listing on a worker, if any.
+  std::unordered_map<uint32_t, uint64_t> m_Listing;
+  std::vector<std::pair<std::shared_ptr<Process>, Listing>> m_Listed;
+};
+
+extern ProcessInfoLoader GProcessInfoLoader;
+
+#endif  // ORBIT_CORE_PROCESS_INFO_LOADER_H_
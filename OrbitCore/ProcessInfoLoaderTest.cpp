@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "OrbitProcess.h"
+#include "ProcessInfoLoader.h"
+
+namespace {
+// Calls Update until a_Done or about ten seconds passed.
+template <typename Predicate>
+void UpdateUntil(ProcessInfoLoader* a_Loader, Predicate a_Done) {
+  for (int i = 0; i < 1000 && !a_Done(); ++i) {
+    a_Loader->Update();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
+}  // namespace
+
+TEST(ProcessInfoLoader, ListsTheModulesOfAProcess) {
+  ProcessInfoLoader loader;
+  std::shared_ptr<Process> listed;
+  loader.SetListedCallback(
+      [&](const std::shared_ptr<Process>& a_Process) { listed = a_Process; });
+  auto process = std::make_shared<Process>(getpid());
+  loader.ListAsync(process);
+  EXPECT_TRUE(process->GetModules().empty());
+
+  UpdateUntil(&loader, [&] { return listed != nullptr; });
+  ASSERT_EQ(listed, process);
+  EXPECT_FALSE(process->GetModules().empty());
+}
+
+TEST(ProcessInfoLoader, DropsWhatWasListedBeforeListingOnTheMainThread) {
+  ProcessInfoLoader loader;
+  int numListed = 0;
+  loader.SetListedCallback(
+      [&](const std::shared_ptr<Process>&) { ++numListed; });
+  auto process = std::make_shared<Process>(getpid());
+  loader.ListAsync(process);
+  loader.List(process);
+  EXPECT_FALSE(process->GetModules().empty());
+
+  // Listed again, the worker above being done or dropped.
+  loader.ListAsync(process);
+  UpdateUntil(&loader, [&] { return numListed > 0; });
+  EXPECT_EQ(numListed, 1);
+}
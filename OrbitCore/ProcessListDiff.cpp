@@ -0,0 +1,66 @@
+#include "ProcessListDiff.h"
+
+#include <cmath>
+#include <utility>
+
+#include "Serialization.h"
+
+ProcessListDiff ProcessListDiffer::Update(const ProcessList& process_list) {
+  ProcessListDiff diff;
+  if (sent_full_list_) {
+    diff.m_BaseGeneration = generation_;
+  } else {
+    sent_processes_.clear();
+  }
+
+  absl::flat_hash_map<uint32_t, SentProcess> processes;
+  processes.reserve(process_list.m_Processes.size());
+  for (const std::shared_ptr<Process>& process : process_list.m_Processes) {
+    uint32_t pid = process->GetID();
+    float cpu_usage = static_cast<float>(process->GetCpuUsage());
+    auto sent = sent_processes_.find(pid);
+    if (sent == sent_processes_.end() || sent->second.process != process) {
+      diff.m_AddedProcesses.push_back(process);
+    } else if (std::fabs(cpu_usage - sent->second.cpu_usage) >=
+               kMinCpuUsageChange) {
+      diff.m_CpuUsages.push_back({pid, cpu_usage});
+    } else {
+      // What the client has, for small changes to add up until sent.
+      cpu_usage = sent->second.cpu_usage;
+    }
+    if (sent != sent_processes_.end()) {
+      sent_processes_.erase(sent);
+    }
+    processes[pid] = {process, cpu_usage};
+  }
+
+  // The processes that were sent and aren't in the list anymore.
+  if (sent_full_list_) {
+    for (const auto& [pid, sent] : sent_processes_) {
+      diff.m_RemovedPids.push_back(pid);
+    }
+  }
+  sent_processes_ = std::move(processes);
+
+  if (!sent_full_list_ || !diff.IsEmpty()) {
+    ++generation_;
+  }
+  diff.m_Generation = generation_;
+  sent_full_list_ = true;
+  return diff;
+}
+
+void ProcessListDiffer::Reset() { sent_full_list_ = false; }
+
+ORBIT_SERIALIZE(ProcessCpuUsage, 0) {
+  ORBIT_NVP_VAL(0, m_Pid);
+  ORBIT_NVP_VAL(0, m_CpuUsage);
+}
+
+ORBIT_SERIALIZE(ProcessListDiff, 0) {
+  ORBIT_NVP_VAL(0, m_BaseGeneration);
+  ORBIT_NVP_VAL(0, m_Generation);
+  ORBIT_NVP_VAL(0, m_AddedProcesses);
+  ORBIT_NVP_VAL(0, m_RemovedPids);
+  ORBIT_NVP_VAL(0, m_CpuUsages);
+}
@@ -0,0 +1,65 @@
+#ifndef ORBIT_CORE_PROCESS_LIST_DIFF_H_
+#define ORBIT_CORE_PROCESS_LIST_DIFF_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ProcessUtils.h"
+#include "SerializationMacros.h"
+#include "absl/container/flat_hash_map.h"
+
+struct ProcessCpuUsage {
+  uint32_t m_Pid = 0;
+  float m_CpuUsage = 0.f;
+
+  ORBIT_SERIALIZABLE;
+};
+
+// Changes of the process list of the service since the one the client has,
+// keyed by pid. Applies to the list of generation m_BaseGeneration only, or
+// to none when it is 0, in which case m_AddedProcesses is the whole list.
+struct ProcessListDiff {
+  uint64_t m_BaseGeneration = 0;
+  uint64_t m_Generation = 0;
+  // Also replaces the process of the same pid, if any.
+  std::vector<std::shared_ptr<Process>> m_AddedProcesses;
+  std::vector<uint32_t> m_RemovedPids;
+  std::vector<ProcessCpuUsage> m_CpuUsages;
+
+  bool IsFull() const { return m_BaseGeneration == 0; }
+  bool IsEmpty() const {
+    return m_AddedProcesses.empty() && m_RemovedPids.empty() &&
+           m_CpuUsages.empty();
+  }
+
+  ORBIT_SERIALIZABLE;
+};
+
+// Service side: what changed in a process list since the previous diff, so
+// that a few dozen bytes go over the wire every refresh rather than the
+// whole serialized list. Only remembers the pid, process and CPU usage sent.
+class ProcessListDiffer {
+ public:
+  // Changes of process_list since the previous call, the whole list on the
+  // first call and after Reset.
+  ProcessListDiff Update(const ProcessList& process_list);
+  // For the next diff to be full, when the client lost track of the list.
+  void Reset();
+
+ private:
+  // Smaller CPU usage changes, in percent, aren't worth sending.
+  static constexpr float kMinCpuUsageChange = 0.05f;
+
+  struct SentProcess {
+    // Held so that a new process can't take its address.
+    std::shared_ptr<Process> process;
+    float cpu_usage;
+  };
+
+  uint64_t generation_ = 0;
+  bool sent_full_list_ = false;
+  absl::flat_hash_map<uint32_t, SentProcess> sent_processes_;
+};
+
+#endif  // ORBIT_CORE_PROCESS_LIST_DIFF_H_
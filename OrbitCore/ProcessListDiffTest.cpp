@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+
+#include "ProcessListDiff.h"
+
+namespace {
+std::shared_ptr<Process> AddProcess(ProcessList* process_list, uint32_t pid,
+                                    float cpu_usage) {
+  auto process = std::make_shared<Process>();
+  process->SetID(pid);
+  process->SetCpuUsage(cpu_usage);
+  process_list->m_Processes.push_back(process);
+  process_list->m_ProcessesMap[pid] = process;
+  return process;
+}
+
+void RemoveProcess(ProcessList* process_list, uint32_t pid) {
+  auto& processes = process_list->m_Processes;
+  processes.erase(std::remove_if(processes.begin(), processes.end(),
+                                 [pid](const std::shared_ptr<Process>& p) {
+                                   return p->GetID() == pid;
+                                 }),
+                  processes.end());
+  process_list->m_ProcessesMap.erase(pid);
+}
+}  // namespace
+
+TEST(ProcessListDiffer, SendsTheWholeListFirst) {
+  ProcessList process_list;
+  AddProcess(&process_list, 1, 10.f);
+  AddProcess(&process_list, 2, 20.f);
+
+  ProcessListDiffer differ;
+  ProcessListDiff diff = differ.Update(process_list);
+  EXPECT_TRUE(diff.IsFull());
+  EXPECT_EQ(diff.m_Generation, 1);
+  EXPECT_EQ(diff.m_AddedProcesses.size(), 2);
+  EXPECT_TRUE(diff.m_RemovedPids.empty());
+  EXPECT_TRUE(diff.m_CpuUsages.empty());
+
+  diff = differ.Update(process_list);
+  EXPECT_TRUE(diff.IsEmpty());
+  EXPECT_EQ(diff.m_BaseGeneration, 1);
+  EXPECT_EQ(diff.m_Generation, 1);
+
+  differ.Reset();
+  diff = differ.Update(process_list);
+  EXPECT_TRUE(diff.IsFull());
+  EXPECT_EQ(diff.m_Generation, 2);
+  EXPECT_EQ(diff.m_AddedProcesses.size(), 2);
+}
+
+TEST(ProcessListDiffer, SendsAddedRemovedAndChangedProcesses) {
+  ProcessList process_list;
+  AddProcess(&process_list, 1, 10.f);
+  std::shared_ptr<Process> process_2 = AddProcess(&process_list, 2, 20.f);
+  AddProcess(&process_list, 3, 30.f);
+
+  ProcessListDiffer differ;
+  differ.Update(process_list);
+
+  RemoveProcess(&process_list, 1);
+  AddProcess(&process_list, 4, 40.f);
+  process_2->SetCpuUsage(25.f);
+  // Another process with the pid of one that was sent.
+  RemoveProcess(&process_list, 3);
+  std::shared_ptr<Process> process_3 = AddProcess(&process_list, 3, 30.f);
+
+  ProcessListDiff diff = differ.Update(process_list);
+  EXPECT_EQ(diff.m_BaseGeneration, 1);
+  EXPECT_EQ(diff.m_Generation, 2);
+  ASSERT_EQ(diff.m_AddedProcesses.size(), 2);
+  EXPECT_EQ(diff.m_AddedProcesses[0]->GetID(), 4);
+  EXPECT_EQ(diff.m_AddedProcesses[1], process_3);
+  ASSERT_EQ(diff.m_RemovedPids.size(), 1);
+  EXPECT_EQ(diff.m_RemovedPids[0], 1);
+  ASSERT_EQ(diff.m_CpuUsages.size(), 1);
+  EXPECT_EQ(diff.m_CpuUsages[0].m_Pid, 2);
+  EXPECT_EQ(diff.m_CpuUsages[0].m_CpuUsage, 25.f);
+}
+
+TEST(ProcessListDiffer, AccumulatesSmallCpuUsageChanges) {
+  ProcessList process_list;
+  std::shared_ptr<Process> process = AddProcess(&process_list, 1, 10.f);
+
+  ProcessListDiffer differ;
+  differ.Update(process_list);
+
+  process->SetCpuUsage(10.03f);
+  EXPECT_TRUE(differ.Update(process_list).IsEmpty());
+
+  process->SetCpuUsage(10.06f);
+  ProcessListDiff diff = differ.Update(process_list);
+  ASSERT_EQ(diff.m_CpuUsages.size(), 1);
+  EXPECT_FLOAT_EQ(diff.m_CpuUsages[0].m_CpuUsage, 10.06f);
+}
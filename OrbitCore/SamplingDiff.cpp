@@ -0,0 +1,145 @@
+#include "SamplingDiff.h"
+
+#include <cmath>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+
+namespace {
+using NodeId = CallstackTree::NodeId;
+
+uint64_t& GetSide(SampleCountDiff* counts, bool baseline) {
+  return baseline ? counts->baseline : counts->comparison;
+}
+
+// Adds the nodes of side to the call paths of diff, and its samples to those
+// of the paths and of the functions it calls.
+void AddSide(const SampledCallTreeView& side, bool baseline,
+             absl::flat_hash_map<std::string, uint32_t>* function_ids,
+             SamplingDiff* diff) {
+  const CallstackTree& tree = side.tree;
+  absl::Span<const uint64_t> counts = side.inclusive_counts;
+  if (counts.size() < tree.size()) {
+    return;
+  }
+
+  // Names are only looked up once per address.
+  absl::flat_hash_map<uint64_t, uint32_t> function_of_address;
+  std::vector<NodeId> path_of_node(tree.size(), CallstackTree::kRootId);
+  for (NodeId id = CallstackTree::kRootId + 1; id < tree.size(); ++id) {
+    uint64_t address = tree.GetAddress(id);
+    auto [it, inserted] = function_of_address.try_emplace(address, 0);
+    if (inserted) {
+      std::string name = side.name_of_address(address);
+      auto [id_it, new_function] = function_ids->try_emplace(
+          name, static_cast<uint32_t>(diff->functions.size()));
+      if (new_function) {
+        diff->functions.emplace_back();
+        diff->functions.back().name = std::move(name);
+      }
+      it->second = id_it->second;
+      FunctionDiff& function = diff->functions[it->second];
+      uint64_t& function_address =
+          baseline ? function.baseline_address : function.comparison_address;
+      if (function_address == 0) {
+        function_address = address;
+      }
+    }
+    path_of_node[id] =
+        diff->paths.InternChild(path_of_node[tree.GetParent(id)], it->second);
+  }
+
+  // Samples of which a node is the innermost frame: its inclusive samples
+  // but those of its callees.
+  std::vector<uint64_t> exclusive(counts.begin(), counts.begin() + tree.size());
+  for (NodeId id = tree.size() - 1; id != CallstackTree::kRootId; --id) {
+    exclusive[tree.GetParent(id)] -= counts[id];
+  }
+
+  diff->path_counts.resize(diff->paths.size());
+  for (NodeId id = CallstackTree::kRootId; id < tree.size(); ++id) {
+    GetSide(&diff->path_counts[path_of_node[id]], baseline) += counts[id];
+    if (id != CallstackTree::kRootId) {
+      uint64_t function = diff->paths.GetAddress(path_of_node[id]);
+      GetSide(&diff->functions[function].exclusive, baseline) += exclusive[id];
+    }
+  }
+  (baseline ? diff->num_baseline_samples : diff->num_comparison_samples) =
+      counts[CallstackTree::kRootId];
+}
+
+// Inclusive samples of functions, from those of the call paths. Only the
+// outermost call of a recursive function counts its samples.
+void CountInclusiveSamples(SamplingDiff* diff) {
+  const CallstackTree& paths = diff->paths;
+  std::vector<uint32_t> num_calls_on_path(diff->functions.size());
+  // Depth first, with a second visit of each path once its callees are done.
+  std::vector<std::pair<NodeId, bool>> stack;
+  for (NodeId child = paths.GetFirstChild(CallstackTree::kRootId);
+       child != CallstackTree::kInvalidId;
+       child = paths.GetNextSibling(child)) {
+    stack.emplace_back(child, false);
+  }
+  while (!stack.empty()) {
+    auto [id, done] = stack.back();
+    stack.pop_back();
+    uint64_t function = paths.GetAddress(id);
+    if (done) {
+      --num_calls_on_path[function];
+      continue;
+    }
+
+    if (num_calls_on_path[function]++ == 0) {
+      FunctionDiff& function_diff = diff->functions[function];
+      function_diff.inclusive.baseline += diff->path_counts[id].baseline;
+      function_diff.inclusive.comparison += diff->path_counts[id].comparison;
+    }
+    stack.emplace_back(id, true);
+    for (NodeId child = paths.GetFirstChild(id);
+         child != CallstackTree::kInvalidId;
+         child = paths.GetNextSibling(child)) {
+      stack.emplace_back(child, false);
+    }
+  }
+}
+}  // namespace
+
+SamplingDiff DiffSampledCallTrees(const SampledCallTreeView& baseline,
+                                  const SampledCallTreeView& comparison) {
+  SamplingDiff diff;
+  absl::flat_hash_map<std::string, uint32_t> function_ids;
+  AddSide(baseline, /*baseline=*/true, &function_ids, &diff);
+  AddSide(comparison, /*baseline=*/false, &function_ids, &diff);
+  diff.path_counts.resize(diff.paths.size());
+  CountInclusiveSamples(&diff);
+  return diff;
+}
+
+float GetPercentDelta(const SampleCountDiff& counts, uint64_t num_baseline,
+                      uint64_t num_comparison) {
+  double baseline =
+      num_baseline > 0 ? static_cast<double>(counts.baseline) / num_baseline
+                       : 0.0;
+  double comparison =
+      num_comparison > 0
+          ? static_cast<double>(counts.comparison) / num_comparison
+          : 0.0;
+  return static_cast<float>(100.0 * (comparison - baseline));
+}
+
+float GetSignificance(const SampleCountDiff& counts, uint64_t num_baseline,
+                      uint64_t num_comparison) {
+  if (num_baseline == 0 || num_comparison == 0) {
+    return 0.f;
+  }
+  double baseline = static_cast<double>(counts.baseline) / num_baseline;
+  double comparison = static_cast<double>(counts.comparison) / num_comparison;
+  double pooled = static_cast<double>(counts.baseline + counts.comparison) /
+                  (num_baseline + num_comparison);
+  double variance = pooled * (1.0 - pooled) *
+                    (1.0 / num_baseline + 1.0 / num_comparison);
+  if (variance <= 0.0) {
+    return 0.f;
+  }
+  return static_cast<float>((comparison - baseline) / std::sqrt(variance));
+}
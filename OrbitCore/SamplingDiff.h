@@ -0,0 +1,65 @@
+#ifndef ORBIT_CORE_SAMPLING_DIFF_H_
+#define ORBIT_CORE_SAMPLING_DIFF_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "CallstackTree.h"
+#include "absl/types/span.h"
+
+// Samples of a call tree, with inclusive_counts per node, whose addresses are
+// those of functions. name_of_address names the function at an address: the
+// two sides of a diff are aligned by name, so that captures of the same build
+// line up even if their modules weren't loaded at the same addresses.
+struct SampledCallTreeView {
+  const CallstackTree& tree;
+  absl::Span<const uint64_t> inclusive_counts;
+  std::function<std::string(uint64_t)> name_of_address;
+};
+
+// Samples of a function, or of a call path, in a baseline and a comparison.
+struct SampleCountDiff {
+  uint64_t baseline = 0;
+  uint64_t comparison = 0;
+};
+
+struct FunctionDiff {
+  std::string name;
+  // One of the addresses of the function on each side, 0 if never sampled.
+  uint64_t baseline_address = 0;
+  uint64_t comparison_address = 0;
+  // Samples with the function anywhere on the stack, counted once however
+  // often it recurses.
+  SampleCountDiff inclusive;
+  // Samples with the function as the innermost frame.
+  SampleCountDiff exclusive;
+};
+
+// Diff of two sampled call trees, per function and per call path.
+struct SamplingDiff {
+  uint64_t num_baseline_samples = 0;
+  uint64_t num_comparison_samples = 0;
+  std::vector<FunctionDiff> functions;
+  // Call paths of both sides, whose addresses are indices of functions.
+  CallstackTree paths;
+  // Per node of paths, inclusive.
+  std::vector<SampleCountDiff> path_counts;
+};
+
+// Costs O(nodes of both trees), however many samples they were built from.
+SamplingDiff DiffSampledCallTrees(const SampledCallTreeView& baseline,
+                                  const SampledCallTreeView& comparison);
+
+// Difference of the shares of the samples, comparison minus baseline, in
+// percents.
+float GetPercentDelta(const SampleCountDiff& counts, uint64_t num_baseline,
+                      uint64_t num_comparison);
+// z-score of the difference of the shares, from a two-proportion z-test: a
+// magnitude above 2 is unlikely to be sampling noise. 0 if either side has no
+// samples.
+float GetSignificance(const SampleCountDiff& counts, uint64_t num_baseline,
+                      uint64_t num_comparison);
+
+#endif  // ORBIT_CORE_SAMPLING_DIFF_H_
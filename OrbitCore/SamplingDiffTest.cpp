@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CallstackTree.h"
+#include "SamplingDiff.h"
+
+namespace {
+struct SampledTree {
+  CallstackTree tree;
+  std::vector<uint64_t> inclusive_counts;
+
+  // Frames are innermost first.
+  void AddSamples(const std::vector<uint64_t>& frames, uint64_t count) {
+    CallstackTree::NodeId id = tree.Intern(frames);
+    inclusive_counts.resize(tree.size());
+    inclusive_counts[id] += count;
+  }
+
+  SampledCallTreeView GetView(uint64_t address_offset) {
+    inclusive_counts = tree.ComputeInclusiveCounts(inclusive_counts);
+    return {tree, inclusive_counts, [address_offset](uint64_t address) {
+              return std::to_string(address - address_offset);
+            }};
+  }
+};
+
+const FunctionDiff* FindFunction(const SamplingDiff& diff,
+                                 const std::string& name) {
+  for (const FunctionDiff& function : diff.functions) {
+    if (function.name == name) {
+      return &function;
+    }
+  }
+  return nullptr;
+}
+}  // namespace
+
+TEST(SamplingDiff, AlignsFunctionsByName) {
+  SampledTree baseline;
+  baseline.AddSamples({2, 1}, 6);
+  baseline.AddSamples({3, 1}, 4);
+  // Loaded elsewhere in the comparison.
+  SampledTree comparison;
+  comparison.AddSamples({1002, 1001}, 2);
+  comparison.AddSamples({1003, 1001}, 8);
+  comparison.AddSamples({1004}, 10);
+
+  SamplingDiff diff =
+      DiffSampledCallTrees(baseline.GetView(0), comparison.GetView(1000));
+  EXPECT_EQ(diff.num_baseline_samples, 10);
+  EXPECT_EQ(diff.num_comparison_samples, 20);
+  ASSERT_EQ(diff.functions.size(), 4);
+
+  const FunctionDiff* function = FindFunction(diff, "1");
+  ASSERT_NE(function, nullptr);
+  EXPECT_EQ(function->baseline_address, 1);
+  EXPECT_EQ(function->comparison_address, 1001);
+  EXPECT_EQ(function->inclusive.baseline, 10);
+  EXPECT_EQ(function->inclusive.comparison, 10);
+  EXPECT_EQ(function->exclusive.baseline, 0);
+  EXPECT_FLOAT_EQ(GetPercentDelta(function->inclusive, 10, 20), -50.f);
+
+  function = FindFunction(diff, "3");
+  ASSERT_NE(function, nullptr);
+  EXPECT_EQ(function->exclusive.baseline, 4);
+  EXPECT_EQ(function->exclusive.comparison, 8);
+  EXPECT_FLOAT_EQ(GetPercentDelta(function->exclusive, 10, 20), 0.f);
+
+  function = FindFunction(diff, "4");
+  ASSERT_NE(function, nullptr);
+  EXPECT_EQ(function->baseline_address, 0);
+  EXPECT_EQ(function->inclusive.comparison, 10);
+
+  // Call paths of both sides are shared: the root, 1, 1>2, 1>3 and 4.
+  EXPECT_EQ(diff.paths.size(), 5);
+  ASSERT_EQ(diff.path_counts.size(), 5);
+  EXPECT_EQ(diff.path_counts[CallstackTree::kRootId].baseline, 10);
+  EXPECT_EQ(diff.path_counts[CallstackTree::kRootId].comparison, 20);
+}
+
+TEST(SamplingDiff, CountsRecursionOnce) {
+  SampledTree baseline;
+  baseline.AddSamples({1, 2, 1}, 3);
+  baseline.AddSamples({1}, 1);
+  SampledTree comparison;
+
+  SamplingDiff diff =
+      DiffSampledCallTrees(baseline.GetView(0), comparison.GetView(0));
+  const FunctionDiff* function = FindFunction(diff, "1");
+  ASSERT_NE(function, nullptr);
+  EXPECT_EQ(function->inclusive.baseline, 4);
+  EXPECT_EQ(function->exclusive.baseline, 4);
+  function = FindFunction(diff, "2");
+  ASSERT_NE(function, nullptr);
+  EXPECT_EQ(function->inclusive.baseline, 3);
+  EXPECT_EQ(function->exclusive.baseline, 0);
+  EXPECT_EQ(diff.num_comparison_samples, 0);
+}
+
+TEST(SamplingDiff, Significance) {
+  // No difference.
+  EXPECT_FLOAT_EQ(GetSignificance({50, 100}, 1000, 2000), 0.f);
+  // 5% against 10% of 1000 samples each.
+  float z = GetSignificance({50, 100}, 1000, 1000);
+  EXPECT_GT(z, 4.f);
+  EXPECT_LT(z, 4.5f);
+  EXPECT_FLOAT_EQ(GetSignificance({100, 50}, 1000, 1000), -z);
+  // Too few samples to tell.
+  EXPECT_LT(GetSignificance({1, 2}, 100, 100), 1.f);
+  EXPECT_FLOAT_EQ(GetSignificance({0, 10}, 0, 100), 0.f);
+}
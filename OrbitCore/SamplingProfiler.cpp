@@ -4,9 +4,15 @@
 
 #include "SamplingProfiler.h"
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <map>
 #include <memory>
+#include <optional>
 #include <set>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "Capture.h"
@@ -14,8 +20,13 @@
 #include "Log.h"
 #include "OrbitModule.h"
 #include "OrbitThread.h"
+#include "ParallelFor.h"
 #include "Params.h"
 #include "Serialization.h"
+#include "SymbolCache.h"
+#include "ThreadSamplingScheduler.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 
 #ifdef _WIN32
 #include <dia2.h>
@@ -25,16 +36,120 @@
 
 double GThreadUsageSamplePeriodMs = 200.0;
 
+namespace {
+using ThreadAndCallstack = std::pair<ThreadID, CallstackID>;
+using SampleCounts = absl::flat_hash_map<ThreadAndCallstack, unsigned int>;
+
+// Counts the samples of each thread and callstack. The blocks are split in as
+// many shards as there are cores, each counted in its own map.
+template <uint32_t BlockSize>
+std::vector<SampleCounts> CountSamples(
+    const BlockChain<CallstackEvent, BlockSize>& a_Samples) {
+  std::vector<const Block<CallstackEvent, BlockSize>*> blocks;
+  for (const Block<CallstackEvent, BlockSize>* block = a_Samples.m_Root;
+       block != nullptr && block->m_Size > 0; block = block->m_Next) {
+    blocks.push_back(block);
+  }
+
+  size_t num_shards = std::min(blocks.size(), GetNumWorkers());
+  std::vector<SampleCounts> shard_counts(num_shards);
+  ParallelFor(num_shards, [&](size_t shard) {
+    SampleCounts& counts = shard_counts[shard];
+    size_t begin = shard * blocks.size() / num_shards;
+    size_t end = (shard + 1) * blocks.size() / num_shards;
+    for (size_t i = begin; i < end; ++i) {
+      const Block<CallstackEvent, BlockSize>* block = blocks[i];
+      for (uint32_t j = 0; j < block->m_Size; ++j) {
+        const CallstackEvent& sample = block->m_Data[j];
+        ++counts[{sample.m_TID, sample.m_Id}];
+      }
+    }
+  });
+  return shard_counts;
+}
+
+std::shared_ptr<CallStack> MakeCallStack(const CallstackTree& a_Tree,
+                                         CallstackTree::NodeId a_Id) {
+  std::shared_ptr<CallStack> callstack = std::make_shared<CallStack>();
+  callstack->m_Data = a_Tree.GetFrames(a_Id);
+  callstack->m_Depth = callstack->m_Data.size();
+  return callstack;
+}
+
+// Frames are innermost first.
+SampledAddresses MakeSampledAddresses(std::vector<uint64_t> a_Frames) {
+  SampledAddresses addresses;
+  if (a_Frames.empty()) {
+    return addresses;
+  }
+  addresses.m_Leaf = a_Frames[0];
+  addresses.m_Unique = std::move(a_Frames);
+  std::sort(addresses.m_Unique.begin(), addresses.m_Unique.end());
+  addresses.m_Unique.erase(
+      std::unique(addresses.m_Unique.begin(), addresses.m_Unique.end()),
+      addresses.m_Unique.end());
+  return addresses;
+}
+
+void CountAddresses(
+    const absl::flat_hash_map<CallstackID, SampledAddresses>& a_Addresses,
+    ThreadSampleData* a_ThreadSampleData) {
+  a_ThreadSampleData->m_AddressCount.clear();
+  a_ThreadSampleData->m_ExclusiveCount.clear();
+  a_ThreadSampleData->m_AddressCountSorted.clear();
+
+  for (const auto& stackCountIt : a_ThreadSampleData->m_CallstackCount) {
+    auto addressesIt = a_Addresses.find(stackCountIt.first);
+    if (addressesIt == a_Addresses.end()) {
+      continue;
+    }
+    const SampledAddresses& addresses = addressesIt->second;
+    const unsigned int callstackCount = stackCountIt.second;
+    a_ThreadSampleData->m_ExclusiveCount[addresses.m_Leaf] += callstackCount;
+    for (uint64_t address : addresses.m_Unique) {
+      a_ThreadSampleData->m_AddressCount[address] += callstackCount;
+    }
+  }
+
+  // sort thread addresses by count
+  for (const auto& addressCountIt : a_ThreadSampleData->m_AddressCount) {
+    a_ThreadSampleData->m_AddressCountSorted.insert(
+        std::make_pair(addressCountIt.second, addressCountIt.first));
+  }
+}
+
+// Addresses of the resolved callstacks sampled on the thread.
+absl::flat_hash_map<CallstackID, SampledAddresses> GetThreadSampledAddresses(
+    const ThreadSampleData& a_ThreadSampleData,
+    const CallstackTree& a_ResolvedTree,
+    const std::unordered_map<CallstackID, CallstackTree::NodeId>&
+        a_RawToResolvedMap) {
+  absl::flat_hash_map<CallstackID, SampledAddresses> sampledAddresses;
+  for (const auto& countIt : a_ThreadSampleData.m_CallstackCount) {
+    auto nodeIt = a_RawToResolvedMap.find(countIt.first);
+    if (nodeIt == a_RawToResolvedMap.end() ||
+        nodeIt->second == CallstackTree::kRootId) {
+      continue;
+    }
+    sampledAddresses[countIt.first] =
+        MakeSampledAddresses(a_ResolvedTree.GetFrames(nodeIt->second));
+  }
+  return sampledAddresses;
+}
+}  // namespace
+
 //-----------------------------------------------------------------------------
 SamplingProfiler::SamplingProfiler(const std::shared_ptr<Process>& a_Process,
                                    bool) {
   m_Process = a_Process;
+  m_Callstacks.SetMemorySubsystem(MemorySubsystem::kSamplingProfiler);
   m_State = SamplingState::Idle;
 }
 
 //-----------------------------------------------------------------------------
 SamplingProfiler::SamplingProfiler() {
   m_Process = std::make_shared<Process>();
+  m_Callstacks.SetMemorySubsystem(MemorySubsystem::kSamplingProfiler);
   m_State = SamplingState::Idle;
 }
 
@@ -51,6 +166,13 @@ void SamplingProfiler::StartCapture() {
   m_SamplingTimer.Start();
   m_ThreadUsageTimer.Start();
 
+  std::vector<ModuleCosts::ModuleRange> moduleRanges = GetModuleRanges();
+  {
+    absl::MutexLock lock(&m_LiveMutex);
+    m_LiveAddresses.clear();
+    m_LiveCounts.clear();
+    m_ModuleCosts.SetModules(std::move(moduleRanges));
+  }
   m_State = Sampling;
 }
 
@@ -63,6 +185,11 @@ void SamplingProfiler::SampleThreadsAsync() {
   SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
   ReserveThreadData();
 
+  // Only threads that ran since their previous sample are suspended and
+  // walked, each at a period that keeps the cost of walking within budget.
+  ThreadSamplingScheduler scheduler(m_PeriodMs, m_OverheadBudget);
+  Timer walkTimer;
+
   while (m_State != PendingStop) {
     if (m_ThreadUsageTimer.QueryMillis() > GThreadUsageSamplePeriodMs) {
       GetThreadsUsage();
@@ -71,16 +198,41 @@ void SamplingProfiler::SampleThreadsAsync() {
 
     ++Capture::GNumSamplingTicks;
 
+    double now = m_SamplingTimer.QueryMillis();
     for (const auto& thread : m_Process->GetThreads()) {
-      DWORD result = SuspendThread(thread->m_Handle);
-      if (result != (DWORD)-1) {
+      ULONG64 cycles = 0;
+      QueryThreadCycleTime(thread->m_Handle, &cycles);
+      ThreadSamplingScheduler::Sample sample =
+          scheduler.Schedule(thread->m_TID, now, cycles);
+
+      CallstackID callstack = 0;
+      if (sample.decision == ThreadSamplingScheduler::Decision::kRepeat) {
+        callstack = scheduler.GetLastCallstack(thread->m_TID);
+      } else if (sample.decision == ThreadSamplingScheduler::Decision::kWalk) {
+        DWORD result = SuspendThread(thread->m_Handle);
+        if (result == (DWORD)-1) {
+          continue;
+        }
+        walkTimer.Start();
         int prev_priority = GetThreadPriority(thread->m_Handle);
         SetThreadPriority(thread->m_Handle, THREAD_PRIORITY_TIME_CRITICAL);
-        GetThreadCallstack(thread.get());
+        callstack = GetThreadCallstack(thread.get());
         SetThreadPriority(thread->m_Handle, prev_priority);
-
         ResumeThread(thread->m_Handle);
-        ++Capture::GNumSamples;
+        scheduler.OnWalked(thread->m_TID, walkTimer.QueryMillis(), callstack);
+        // The walk added the first of the samples.
+        if (callstack != 0) {
+          --sample.weight;
+          ++Capture::GNumSamples;
+        }
+      }
+
+      if (callstack != 0) {
+        CallstackEvent event(0, callstack, thread->m_TID);
+        for (uint32_t i = 0; i < sample.weight; ++i) {
+          AddHashedCallStack(event);
+          ++Capture::GNumSamples;
+        }
       }
     }
 
@@ -129,8 +281,21 @@ void SamplingProfiler::FireDoneProcessingCallbacks() {
 //-----------------------------------------------------------------------------
 std::multimap<int, CallstackID> SamplingProfiler::GetCallStacksFromAddress(
     uint64_t a_Addr, ThreadID a_TID, int& o_NumCallstacks) {
-  std::set<CallstackID>& callstacks = m_FunctionToCallstacks[a_Addr];
-  return m_ThreadSampleData[a_TID].SortCallstacks(callstacks, o_NumCallstacks);
+  absl::ReaderMutexLock lock(&m_ReportMutex);
+  // A subset never locks its source, so taking both locks is fine.
+  std::optional<absl::ReaderMutexLock> sourceLock;
+  if (m_Source != nullptr) {
+    sourceLock.emplace(&m_Source->m_ReportMutex);
+  }
+  const auto& functionToCallstacks = GetTables().m_FunctionToCallstacks;
+  auto callstacksIt = functionToCallstacks.find(a_Addr);
+  auto dataIt = m_ThreadSampleData.find(a_TID);
+  if (callstacksIt == functionToCallstacks.end() ||
+      dataIt == m_ThreadSampleData.end()) {
+    o_NumCallstacks = 0;
+    return {};
+  }
+  return dataIt->second.SortCallstacks(callstacksIt->second, o_NumCallstacks);
 }
 
 //-----------------------------------------------------------------------------
@@ -147,20 +312,431 @@ void SamplingProfiler::AddCallStack(CallStack& a_CallStack) {
 
 //-----------------------------------------------------------------------------
 void SamplingProfiler::AddHashedCallStack(CallstackEvent& a_CallStack) {
-  if (!HasCallStack(a_CallStack.m_Id)) {
-    PRINT(
-        "Error: Callstacks can only be added by hash when they are already "
-        "present.\n");
+  AddCallStacks(absl::MakeConstSpan(&a_CallStack, 1), {});
+}
+
+//-----------------------------------------------------------------------------
+void SamplingProfiler::AddCallStacks(
+    absl::Span<const CallstackEvent> a_Events,
+    absl::Span<CallStack> a_NewCallStacks) {
+  {
+    absl::MutexLock lock(&m_CallstacksMutex);
+    for (CallStack& callstack : a_NewCallStacks) {
+      auto [it, inserted] = m_UniqueCallstacks.try_emplace(callstack.Hash());
+      if (inserted) {
+        it->second = m_CallstackTree.Intern(absl::MakeConstSpan(
+            callstack.m_Data.data(), callstack.m_Depth));
+      }
+    }
+    for (const CallstackEvent& event : a_Events) {
+      if (!m_UniqueCallstacks.contains(event.m_Id)) {
+        PRINT(
+            "Error: Callstacks can only be added by hash when they are "
+            "already present.\n");
+      }
+    }
+    m_Callstacks.push_back(a_Events.data(), (uint32_t)a_Events.size());
+  }
+  if (m_State == Sampling) {
+    CountLiveSamples(a_Events);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void SamplingProfiler::CountLiveSamples(
+    absl::Span<const CallstackEvent> a_Events) {
+  absl::MutexLock lock(&m_LiveMutex);
+  // Looked up again whenever the thread changes, as adding a thread can move
+  // the counts of the others.
+  ThreadID tid = 0;
+  LiveThreadCounts* threadCounts = nullptr;
+  LiveThreadCounts* summaryCounts = nullptr;
+  for (const CallstackEvent& event : a_Events) {
+    auto addressesIt = m_LiveAddresses.find(event.m_Id);
+    if (addressesIt == m_LiveAddresses.end()) {
+      std::shared_ptr<CallStack> callstack = GetCallStack(event.m_Id);
+      if (callstack == nullptr) {
+        continue;
+      }
+      m_ModuleCosts.AddCallstack(event.m_Id, callstack->m_Data);
+      addressesIt =
+          m_LiveAddresses
+              .emplace(event.m_Id,
+                       MakeSampledAddresses(std::move(callstack->m_Data)))
+              .first;
+    }
+
+    if (threadCounts == nullptr || event.m_TID != tid) {
+      tid = event.m_TID;
+      threadCounts = &m_LiveCounts[tid];
+      summaryCounts = m_GenerateSummary ? &m_LiveCounts[0] : nullptr;
+    }
+
+    const SampledAddresses& addresses = addressesIt->second;
+    auto count = [&addresses, &event](LiveThreadCounts* a_Counts) {
+      ++a_Counts->m_NumSamples;
+      ++a_Counts->m_Callstacks[event.m_Id];
+      if (addresses.m_Unique.empty()) {
+        return;
+      }
+      ++a_Counts->m_Exclusive[addresses.m_Leaf];
+      for (uint64_t address : addresses.m_Unique) {
+        ++a_Counts->m_Inclusive[address];
+      }
+    };
+    count(threadCounts);
+    if (summaryCounts != nullptr) {
+      count(summaryCounts);
+    }
+    m_ModuleCosts.AddSamples(event.m_Id, 1);
+  }
+}
+
+//-----------------------------------------------------------------------------
+absl::flat_hash_map<uint64_t, ModuleCosts::Cost>
+SamplingProfiler::GetModuleCosts(unsigned int* o_NumSamples) const {
+  absl::ReaderMutexLock lock(&m_LiveMutex);
+  *o_NumSamples = m_ModuleCosts.GetNumSamples();
+  return m_ModuleCosts.GetCosts();
+}
+
+//-----------------------------------------------------------------------------
+std::vector<ModuleCosts::ModuleRange> SamplingProfiler::GetModuleRanges()
+    const {
+  std::vector<ModuleCosts::ModuleRange> ranges;
+  if (m_Process == nullptr) {
+    return ranges;
+  }
+  ScopeLock lock(m_Process->GetDataMutex());
+  for (const auto& moduleIt : m_Process->GetModules()) {
+    const Module& module = *moduleIt.second;
+    if (module.m_AddressEnd > module.m_AddressStart) {
+      ranges.push_back({module.m_AddressStart, module.m_AddressEnd});
+    }
   }
+  return ranges;
+}
+
+//-----------------------------------------------------------------------------
+void SamplingProfiler::CountModuleCosts(
+    const std::unordered_map<ThreadID, ThreadSampleData>& a_Data) {
+  ModuleCosts moduleCosts;
+  moduleCosts.SetModules(GetModuleRanges());
+  for (const auto& dataIt : a_Data) {
+    // The summary, if any, counts the samples of the other threads again.
+    if (dataIt.first == 0) {
+      continue;
+    }
+    for (const auto& countIt : dataIt.second.m_CallstackCount) {
+      if (!moduleCosts.HasCallstack(countIt.first)) {
+        std::shared_ptr<CallStack> callstack = GetCallStack(countIt.first);
+        if (callstack == nullptr) {
+          continue;
+        }
+        moduleCosts.AddCallstack(countIt.first, callstack->m_Data);
+      }
+      moduleCosts.AddSamples(countIt.first, countIt.second);
+    }
+  }
+
+  absl::MutexLock lock(&m_LiveMutex);
+  m_ModuleCosts = std::move(moduleCosts);
+}
+
+//-----------------------------------------------------------------------------
+std::vector<ThreadID> SamplingProfiler::GetLiveThreadIds() const {
+  std::vector<ThreadID> threadIds;
+  {
+    absl::ReaderMutexLock lock(&m_LiveMutex);
+    for (const auto& it : m_LiveCounts) {
+      threadIds.push_back(it.first);
+    }
+  }
+  std::sort(threadIds.begin(), threadIds.end());
+  return threadIds;
+}
+
+//-----------------------------------------------------------------------------
+std::vector<SampledFunction> SamplingProfiler::GetLiveSampledFunctions(
+    ThreadID a_TID) {
+  ThreadSampleData threadSampleData;
+  std::vector<std::pair<uint64_t, unsigned int>> inclusive;
+  std::vector<std::pair<uint64_t, unsigned int>> exclusive;
+  {
+    absl::ReaderMutexLock lock(&m_LiveMutex);
+    auto it = m_LiveCounts.find(a_TID);
+    if (it == m_LiveCounts.end()) {
+      return {};
+    }
+    threadSampleData.m_NumSamples = it->second.m_NumSamples;
+    inclusive.assign(it->second.m_Inclusive.begin(),
+                     it->second.m_Inclusive.end());
+    exclusive.assign(it->second.m_Exclusive.begin(),
+                     it->second.m_Exclusive.end());
+  }
+
+  // Resolved outside of the lock, so that samples keep being counted.
   ScopeLock lock(m_Mutex);
-  m_Callstacks.push_back(a_CallStack);
+  std::unordered_map<uint64_t, unsigned int>& inclusiveCount =
+      threadSampleData.m_AddressCount;
+  std::unordered_map<uint64_t, unsigned int>& exclusiveCount =
+      threadSampleData.m_ExclusiveCount;
+  for (const auto& addressCount : inclusive) {
+    inclusiveCount[GetFunctionAddress(addressCount.first)] +=
+        addressCount.second;
+  }
+  for (const auto& addressCount : exclusive) {
+    exclusiveCount[GetFunctionAddress(addressCount.first)] +=
+        addressCount.second;
+  }
+  for (const auto& addressCountIt : inclusiveCount) {
+    threadSampleData.m_AddressCountSorted.insert(
+        std::make_pair(addressCountIt.second, addressCountIt.first));
+  }
+
+  OutputStats(&threadSampleData);
+  return std::move(threadSampleData.m_SampleReport);
+}
+
+//-----------------------------------------------------------------------------
+uint64_t SamplingProfiler::GetFunctionAddress(uint64_t a_Address) {
+  if (m_ExactAddresses.find(a_Address) == m_ExactAddresses.end()) {
+    AddAddress(a_Address);
+  }
+  auto it = m_ExactAddresses.find(a_Address);
+  return it != m_ExactAddresses.end() ? it->second : a_Address;
+}
+
+//-----------------------------------------------------------------------------
+std::vector<SampledFunction> SamplingProfiler::GetSampledFunctions(
+    ThreadID a_TID) {
+  absl::MutexLock lock(&m_ReportMutex);
+  auto dataIt = m_ThreadSampleData.find(a_TID);
+  if (dataIt == m_ThreadSampleData.end()) {
+    return {};
+  }
+  ThreadSampleData& threadSampleData = dataIt->second;
+  if (!threadSampleData.m_HasReport) {
+    absl::flat_hash_map<CallstackID, SampledAddresses> sampledAddresses;
+    {
+      std::optional<absl::ReaderMutexLock> sourceLock;
+      if (m_Source != nullptr) {
+        sourceLock.emplace(&m_Source->m_ReportMutex);
+      }
+      const SamplingProfiler& tables = GetTables();
+      sampledAddresses = GetThreadSampledAddresses(
+          threadSampleData, tables.m_ResolvedCallstackTree,
+          tables.m_RawToResolvedMap);
+    }
+    CountAddresses(sampledAddresses, &threadSampleData);
+    OutputStats(&threadSampleData);
+    threadSampleData.m_HasReport = true;
+  }
+  return threadSampleData.m_SampleReport;
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<SampledCallTree> SamplingProfiler::GetCallTree(
+    ThreadID a_TID) {
+  auto callTree = std::make_shared<SampledCallTree>();
+  absl::ReaderMutexLock lock(&m_ReportMutex);
+  auto dataIt = m_ThreadSampleData.find(a_TID);
+  if (dataIt == m_ThreadSampleData.end()) {
+    return callTree;
+  }
+
+  std::optional<absl::ReaderMutexLock> sourceLock;
+  if (m_Source != nullptr) {
+    sourceLock.emplace(&m_Source->m_ReportMutex);
+  }
+  const SamplingProfiler& tables = GetTables();
+  callTree->m_Tree = tables.m_ResolvedCallstackTree;
+  std::vector<uint64_t> counts(callTree->m_Tree.size());
+  for (const auto& countIt : dataIt->second.m_CallstackCount) {
+    auto nodeIt = tables.m_RawToResolvedMap.find(countIt.first);
+    if (nodeIt != tables.m_RawToResolvedMap.end()) {
+      counts[nodeIt->second] += countIt.second;
+    }
+  }
+  callTree->m_InclusiveCounts =
+      callTree->m_Tree.ComputeInclusiveCounts(std::move(counts));
+  return callTree;
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<SampledCallTree> SamplingProfiler::GetLiveCallTree(
+    ThreadID a_TID) {
+  auto callTree = std::make_shared<SampledCallTree>();
+  std::vector<std::pair<CallstackID, unsigned int>> callstackCounts;
+  {
+    absl::ReaderMutexLock lock(&m_LiveMutex);
+    auto it = m_LiveCounts.find(a_TID);
+    if (it == m_LiveCounts.end()) {
+      return callTree;
+    }
+    callstackCounts.assign(it->second.m_Callstacks.begin(),
+                           it->second.m_Callstacks.end());
+  }
+
+  absl::MutexLock treeLock(&m_LiveCallTreeMutex);
+  if (m_LiveRawToResolvedNodes.empty()) {
+    m_LiveCallTree.Clear();
+    m_LiveRawToResolvedNodes.push_back(CallstackTree::kRootId);
+  }
+
+  // Only the new nodes are copied out of the raw tree, and they are resolved
+  // outside of its lock, so that samples keep being added meanwhile.
+  std::vector<std::pair<CallstackTree::NodeId, uint64_t>> newNodes;
+  std::vector<std::pair<CallstackTree::NodeId, unsigned int>> nodeCounts;
+  {
+    absl::ReaderMutexLock lock(&m_CallstacksMutex);
+    for (CallstackTree::NodeId id = m_LiveRawToResolvedNodes.size();
+         id < m_CallstackTree.size(); ++id) {
+      newNodes.emplace_back(m_CallstackTree.GetParent(id),
+                            m_CallstackTree.GetAddress(id));
+    }
+    for (const auto& countIt : callstackCounts) {
+      auto nodeIt = m_UniqueCallstacks.find(countIt.first);
+      if (nodeIt != m_UniqueCallstacks.end()) {
+        nodeCounts.emplace_back(nodeIt->second, countIt.second);
+      }
+    }
+  }
+
+  {
+    ScopeLock lock(m_Mutex);
+    absl::flat_hash_set<uint64_t> uniqueAddresses;
+    for (const auto& node : newNodes) {
+      if (m_ExactAddresses.find(node.second) == m_ExactAddresses.end()) {
+        uniqueAddresses.insert(node.second);
+      }
+    }
+    std::vector<uint64_t> addresses(uniqueAddresses.begin(),
+                                    uniqueAddresses.end());
+    std::sort(addresses.begin(), addresses.end());
+    ResolveAddresses(addresses);
+
+    for (const auto& node : newNodes) {
+      m_LiveRawToResolvedNodes.push_back(m_LiveCallTree.InternChild(
+          m_LiveRawToResolvedNodes[node.first],
+          GetFunctionAddress(node.second)));
+    }
+  }
+
+  callTree->m_Tree = m_LiveCallTree;
+  std::vector<uint64_t> counts(callTree->m_Tree.size());
+  for (const auto& nodeCount : nodeCounts) {
+    counts[m_LiveRawToResolvedNodes[nodeCount.first]] += nodeCount.second;
+  }
+  callTree->m_InclusiveCounts =
+      callTree->m_Tree.ComputeInclusiveCounts(std::move(counts));
+  return callTree;
 }
 
 //-----------------------------------------------------------------------------
 void SamplingProfiler::AddUniqueCallStack(CallStack& a_CallStack) {
-  ScopeLock lock(m_Mutex);
-  m_UniqueCallstacks[a_CallStack.Hash()] =
-      std::make_shared<CallStack>(a_CallStack);
+  CallstackID hash = a_CallStack.Hash();
+  absl::MutexLock lock(&m_CallstacksMutex);
+  m_UniqueCallstacks[hash] = m_CallstackTree.Intern(
+      absl::MakeConstSpan(a_CallStack.m_Data).subspan(0, a_CallStack.m_Depth));
+}
+
+//-----------------------------------------------------------------------------
+void SamplingProfiler::AddCallStackSamples(CallStack& a_CallStack,
+                                           ThreadID a_TID,
+                                           unsigned int a_Count) {
+  CallstackID hash = a_CallStack.Hash();
+  if (!HasCallStack(hash)) {
+    AddUniqueCallStack(a_CallStack);
+  }
+  absl::MutexLock lock(&m_CallstacksMutex);
+  m_CallstackCounts[{a_TID, hash}] += a_Count;
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<SamplingProfiler> SamplingProfiler::MakeSubsetProfiler(
+    const std::shared_ptr<SamplingProfiler>& a_Source,
+    const std::map<ThreadID, CallstackCounts>& a_Counts,
+    bool a_GenerateSummary, const std::atomic<bool>& a_Cancelled) {
+  auto profiler = std::make_shared<SamplingProfiler>(a_Source->m_Process);
+  profiler->m_Source = a_Source;
+  profiler->m_IsLinuxPerf = a_Source->m_IsLinuxPerf;
+  profiler->m_LoadedFromFile = a_Source->m_LoadedFromFile;
+  profiler->m_GenerateSummary = a_GenerateSummary;
+  profiler->m_State = Processing;
+
+  std::unordered_map<ThreadID, ThreadSampleData> threadSampleData;
+  uint32_t numSamples = 0;
+  for (const auto& [threadID, counts] : a_Counts) {
+    for (const auto& [callstackID, count] : counts) {
+      ThreadSampleData& data = threadSampleData[threadID];
+      data.m_NumSamples += count;
+      data.m_CallstackCount[callstackID] += count;
+      if (a_GenerateSummary) {
+        ThreadSampleData& dataAll = threadSampleData[0];
+        dataAll.m_NumSamples += count;
+        dataAll.m_CallstackCount[callstackID] += count;
+      }
+      numSamples += count;
+    }
+  }
+  if (a_Cancelled) {
+    return nullptr;
+  }
+
+  // Only the callstacks received since a_Source was last processed, e.g.
+  // during a capture, are resolved. Only the summary is reported now, the
+  // threads on demand.
+  for (auto& dataIt : threadSampleData) {
+    dataIt.second.ComputeAverageThreadUsage();
+  }
+  auto summaryIt = threadSampleData.find(0);
+  absl::flat_hash_map<CallstackID, SampledAddresses> sampledAddresses;
+  {
+    absl::ReaderMutexLock callstacks_lock(&a_Source->m_CallstacksMutex);
+    absl::MutexLock report_lock(&a_Source->m_ReportMutex);
+    a_Source->ProcessAddresses();
+    if (summaryIt != threadSampleData.end()) {
+      sampledAddresses = GetThreadSampledAddresses(
+          summaryIt->second, a_Source->m_ResolvedCallstackTree,
+          a_Source->m_RawToResolvedMap);
+    }
+  }
+  if (a_Cancelled) {
+    return nullptr;
+  }
+
+  if (summaryIt != threadSampleData.end()) {
+    CountAddresses(sampledAddresses, &summaryIt->second);
+    profiler->OutputStats(&summaryIt->second);
+    summaryIt->second.m_HasReport = true;
+  }
+
+  {
+    absl::MutexLock lock(&profiler->m_ReportMutex);
+    profiler->m_ThreadSampleData.swap(threadSampleData);
+  }
+  profiler->SortByThreadUsage();
+  profiler->m_NumSamples = numSamples;
+  profiler->m_State = DoneProcessing;
+  return profiler;
+}
+
+//-----------------------------------------------------------------------------
+const std::shared_ptr<CallStack> SamplingProfiler::GetCallStack(
+    CallstackID a_ID) {
+  if (m_Source != nullptr) {
+    return m_Source->GetCallStack(a_ID);
+  }
+  absl::ReaderMutexLock lock(&m_CallstacksMutex);
+  auto it = m_UniqueCallstacks.find(a_ID);
+  if (it == m_UniqueCallstacks.end()) {
+    return nullptr;
+  }
+  std::shared_ptr<CallStack> callstack =
+      MakeCallStack(m_CallstackTree, it->second);
+  callstack->m_Hash = a_ID;
+  return callstack;
 }
 
 //-----------------------------------------------------------------------------
@@ -186,6 +762,7 @@ SamplingProfiler::GetSortedCallstacksFromAddress(uint64_t a_Addr,
 
 //-----------------------------------------------------------------------------
 void SamplingProfiler::SortByThreadUsage() {
+  absl::MutexLock lock(&m_ReportMutex);
   m_SortedThreadSampleData.clear();
   m_SortedThreadSampleData.reserve(m_ThreadSampleData.size());
 
@@ -206,6 +783,7 @@ void SamplingProfiler::SortByThreadUsage() {
 
 //-----------------------------------------------------------------------------
 void SamplingProfiler::SortByThreadID() {
+  absl::MutexLock lock(&m_ReportMutex);
   m_SortedThreadSampleData.clear();
   m_SortedThreadSampleData.reserve(m_ThreadSampleData.size());
 
@@ -222,6 +800,9 @@ void SamplingProfiler::SortByThreadID() {
 
 //-----------------------------------------------------------------------------
 bool SamplingProfiler::GetLineInfo(uint64_t a_Address, LineInfo& a_LineInfo) {
+  if (m_Source != nullptr) {
+    return m_Source->GetLineInfo(a_Address, a_LineInfo);
+  }
   auto it = m_AddressToLineInfo.find(a_Address);
   if (it != m_AddressToLineInfo.end()) {
     a_LineInfo = it->second;
@@ -234,15 +815,13 @@ bool SamplingProfiler::GetLineInfo(uint64_t a_Address, LineInfo& a_LineInfo) {
 
 //-----------------------------------------------------------------------------
 void SamplingProfiler::Print() {
+  absl::ReaderMutexLock callstacks_lock(&m_CallstacksMutex);
   ScopeLock lock(m_Mutex);
   for (auto& pair : m_UniqueCallstacks) {
-    std::shared_ptr<CallStack> callstack = pair.second;
-    if (callstack) {
-      PRINT_VAR((void*)callstack->m_Hash);
-      PRINT_VAR(callstack->m_Depth);
-      for (uint32_t i = 0; i < callstack->m_Depth; ++i) {
-        PRINT("%s\n", m_AddressToSymbol[callstack->m_Data[i]].c_str());
-      }
+    PRINT_VAR((void*)pair.first);
+    PRINT_VAR(m_CallstackTree.GetDepth(pair.second));
+    for (uint64_t address : m_CallstackTree.GetFrames(pair.second)) {
+      PRINT("%s\n", m_AddressToSymbol[address].c_str());
     }
   }
 }
@@ -256,74 +835,109 @@ void SamplingProfiler::ProcessSamplesAsync() {
 
 //-----------------------------------------------------------------------------
 void SamplingProfiler::ProcessSamples() {
-  ScopeLock lock(m_Mutex);
-
   m_State = Processing;
 
-  // Unique call stacks and per thread data
-  for (const CallstackEvent& callstack : m_Callstacks) {
-    if (!HasCallStack(callstack.m_Id)) {
-      PRINT("Error: Processed unknown callstack!\n");
-    }
-
-    ThreadSampleData& threadSampleData = m_ThreadSampleData[callstack.m_TID];
-    threadSampleData.m_NumSamples++;
-    threadSampleData.m_CallstackCount[callstack.m_Id]++;
-
-    if (m_GenerateSummary) {
-      ThreadSampleData& threadSampleDataAll = m_ThreadSampleData[0];
-      threadSampleDataAll.m_NumSamples++;
-      threadSampleDataAll.m_CallstackCount[callstack.m_Id]++;
-    }
+  // The report is built aside, so that the UI can keep reading the previous
+  // one until the new one is published.
+  std::unordered_map<ThreadID, ThreadSampleData> threadSampleData;
+  {
+    absl::ReaderMutexLock lock(&m_ReportMutex);
+    threadSampleData = m_ThreadSampleData;
   }
 
-  ProcessAddresses();
-
-  for (auto& dataIt : m_ThreadSampleData) {
-    ThreadSampleData& threadSampleData = dataIt.second;
-
-    threadSampleData.ComputeAverageThreadUsage();
-
-    // Address count per sample per thread
-    for (auto& stackCountIt : threadSampleData.m_CallstackCount) {
-      const CallstackID callstackID = stackCountIt.first;
-      const unsigned int callstackCount = stackCountIt.second;
-
-      CallstackID resolvedCallstackID = m_RawToResolvedMap[callstackID];
-      std::shared_ptr<CallStack>& callstack =
-          m_UniqueResolvedCallstacks[resolvedCallstackID];
-
-      // exclusive stat
-      threadSampleData.m_ExclusiveCount[callstack->m_Data[0]] += callstackCount;
+  absl::flat_hash_map<CallstackID, SampledAddresses> sampledAddresses;
+  auto summaryIt = threadSampleData.end();
+  uint32_t numSamples = 0;
+  {
+    absl::ReaderMutexLock callstacks_lock(&m_CallstacksMutex);
+    numSamples = m_Callstacks.size();
+
+    // Per thread data, merged from the counts of each shard
+    auto addCounts = [&](const SampleCounts& a_Counts) {
+      for (const auto& countIt : a_Counts) {
+        const ThreadID threadID = countIt.first.first;
+        const CallstackID callstackID = countIt.first.second;
+        if (m_UniqueCallstacks.find(callstackID) == m_UniqueCallstacks.end()) {
+          PRINT("Error: Processed unknown callstack!\n");
+        }
 
-      std::set<uint64_t> uniqueAddresses;
-      for (uint32_t i = 0; i < callstack->m_Depth; ++i) {
-        uniqueAddresses.insert(callstack->m_Data[i]);
-      }
+        ThreadSampleData& data = threadSampleData[threadID];
+        data.m_NumSamples += countIt.second;
+        data.m_CallstackCount[callstackID] += countIt.second;
 
-      for (uint64_t address : uniqueAddresses) {
-        threadSampleData.m_AddressCount[address] += callstackCount;
+        if (m_GenerateSummary) {
+          ThreadSampleData& dataAll = threadSampleData[0];
+          dataAll.m_NumSamples += countIt.second;
+          dataAll.m_CallstackCount[callstackID] += countIt.second;
+        }
       }
+    };
+    for (const SampleCounts& counts : CountSamples(m_Callstacks)) {
+      addCounts(counts);
+    }
+    addCounts(m_CallstackCounts);
+    for (const auto& countIt : m_CallstackCounts) {
+      numSamples += countIt.second;
+    }
+    // The counts changed: the reports of the previous processing are stale.
+    for (auto& dataIt : threadSampleData) {
+      dataIt.second.ComputeAverageThreadUsage();
+      dataIt.second.ClearReport();
     }
+    summaryIt = threadSampleData.find(0);
+
+    absl::MutexLock report_lock(&m_ReportMutex);
+    ProcessAddresses();
+    uint64_t mapsMemory = GetMapsMemorySize();
+    for (const auto& dataIt : threadSampleData) {
+      mapsMemory += GetHashMapMemorySize(dataIt.second.m_CallstackCount) +
+                    GetHashMapMemorySize(dataIt.second.m_AddressCount) +
+                    GetHashMapMemorySize(dataIt.second.m_ExclusiveCount);
+    }
+    m_MapsMemory.Set(mapsMemory);
 
-    // sort thread addresses by count
-    for (auto& addressCountIt : threadSampleData.m_AddressCount) {
-      const uint64_t address = addressCountIt.first;
-      const unsigned int count = addressCountIt.second;
-      threadSampleData.m_AddressCountSorted.insert(
-          std::make_pair(count, address));
+    if (summaryIt != threadSampleData.end()) {
+      sampledAddresses = GetThreadSampledAddresses(
+          summaryIt->second, m_ResolvedCallstackTree, m_RawToResolvedMap);
     }
   }
 
-  SortByThreadUsage();
+  // Only the summary is reported now: with many threads, most of their
+  // reports are never looked at. See GetSampledFunctions.
+  if (summaryIt != threadSampleData.end()) {
+    CountAddresses(sampledAddresses, &summaryIt->second);
+    OutputStats(&summaryIt->second);
+    summaryIt->second.m_HasReport = true;
+  }
 
-  OutputStats();
+  CountModuleCosts(threadSampleData);
+  {
+    absl::MutexLock lock(&m_ReportMutex);
+    m_ThreadSampleData.swap(threadSampleData);
+  }
+  // The previous report stays alive until then, for the sorted pointers.
+  SortByThreadUsage();
 
-  m_NumSamples = m_Callstacks.size();
-  m_Callstacks.clear();
+  {
+    absl::MutexLock lock(&m_CallstacksMutex);
+    m_Callstacks.clear();
+    m_CallstackCounts.clear();
+  }
+  m_NumSamples = numSamples;
   m_State = DoneProcessing;
 }
 
+//-----------------------------------------------------------------------------
+uint64_t SamplingProfiler::GetMapsMemorySize() const {
+  return GetHashMapMemorySize(m_UniqueCallstacks) +
+         GetHashMapMemorySize(m_RawToResolvedMap) +
+         GetHashMapMemorySize(m_FunctionToCallstacks) +
+         GetHashMapMemorySize(m_ExactAddresses) +
+         GetHashMapMemorySize(m_AddressToSymbol) +
+         GetHashMapMemorySize(m_AddressToLineInfo) +
+         GetHashMapMemorySize(m_FileNames);
+}
+
 //-----------------------------------------------------------------------------
 void ThreadSampleData::ComputeAverageThreadUsage() {
   m_AverageThreadUsage = 0.f;
@@ -337,9 +951,18 @@ void ThreadSampleData::ComputeAverageThreadUsage() {
   }
 }
 
+//-----------------------------------------------------------------------------
+void ThreadSampleData::ClearReport() {
+  m_AddressCount.clear();
+  m_ExclusiveCount.clear();
+  m_AddressCountSorted.clear();
+  m_SampleReport.clear();
+  m_HasReport = false;
+}
+
 //-----------------------------------------------------------------------------
 std::multimap<int, CallstackID> ThreadSampleData::SortCallstacks(
-    const std::set<CallstackID>& a_CallStacks, int& o_TotalCallStacks) {
+    const std::set<CallstackID>& a_CallStacks, int& o_TotalCallStacks) const {
   std::multimap<int, CallstackID> sortedCallstacks;
   int numCallstacks = 0;
   for (CallstackID id : a_CallStacks) {
@@ -358,35 +981,319 @@ std::multimap<int, CallstackID> ThreadSampleData::SortCallstacks(
 //-----------------------------------------------------------------------------
 void SamplingProfiler::ProcessAddresses() {
   ScopeLock lock(m_Mutex);
+
+  // Nodes are appended after their parent: the ones not processed yet are
+  // those of the new callstacks, and come after their callers.
+  if (m_RawToResolvedNodes.empty()) {
+    m_RawToResolvedNodes.push_back(CallstackTree::kRootId);
+  }
+  const CallstackTree::NodeId firstNewNode = m_RawToResolvedNodes.size();
+  const CallstackTree::NodeId numNodes = m_CallstackTree.size();
+
+  // Addresses of the new callstacks are resolved all at once, sorted so that
+  // each worker looks up neighbouring symbols of the same modules.
+  absl::flat_hash_set<uint64_t> uniqueAddresses;
+  for (CallstackTree::NodeId id = firstNewNode; id < numNodes; ++id) {
+    uint64_t address = m_CallstackTree.GetAddress(id);
+    if (m_ExactAddresses.find(address) == m_ExactAddresses.end()) {
+      uniqueAddresses.insert(address);
+    }
+  }
+  std::vector<uint64_t> addresses(uniqueAddresses.begin(),
+                                  uniqueAddresses.end());
+  std::sort(addresses.begin(), addresses.end());
+  ResolveAddresses(addresses);
+
+  // The resolved node of a frame is the child for the frame's function of
+  // the resolved node of its caller.
+  for (CallstackTree::NodeId id = firstNewNode; id < numNodes; ++id) {
+    uint64_t address = m_CallstackTree.GetAddress(id);
+    auto addrIt = m_ExactAddresses.find(address);
+    if (addrIt != m_ExactAddresses.end()) {
+      address = addrIt->second;
+    }
+    CallstackTree::NodeId resolvedParent =
+        m_RawToResolvedNodes[m_CallstackTree.GetParent(id)];
+    m_RawToResolvedNodes.push_back(
+        m_ResolvedCallstackTree.InternChild(resolvedParent, address));
+  }
+
   for (const auto& it : m_UniqueCallstacks) {
     CallstackID rawCallstackId = it.first;
-    const std::shared_ptr<CallStack> callstack = it.second;
-    CallStack ResolvedCallstack = *callstack;
+    if (m_RawToResolvedMap.find(rawCallstackId) != m_RawToResolvedMap.end()) {
+      continue;
+    }
+    CallstackTree::NodeId resolvedId = m_RawToResolvedNodes[it.second];
+    m_RawToResolvedMap[rawCallstackId] = resolvedId;
+    for (CallstackTree::NodeId id = resolvedId; id != CallstackTree::kRootId;
+         id = m_ResolvedCallstackTree.GetParent(id)) {
+      m_FunctionToCallstacks[m_ResolvedCallstackTree.GetAddress(id)].insert(
+          rawCallstackId);
+    }
+  }
+}
 
-    for (uint32_t i = 0; i < callstack->m_Depth; ++i) {
-      uint64_t addr = callstack->m_Data[i];
+//-----------------------------------------------------------------------------
+void SamplingProfiler::ResolveAddresses(
+    const std::vector<uint64_t>& a_Addresses) {
+  ScopeLock lock(m_Mutex);
+#ifdef _WIN32
+  // DbgHelp and DIA are not thread-safe.
+  if (!m_IsLinuxPerf) {
+    for (uint64_t address : a_Addresses) {
+      AddAddress(address);
+    }
+    return;
+  }
+#endif
 
-      if (m_ExactAddresses.find(addr) == m_ExactAddresses.end()) {
-        AddAddress(addr);
+  std::vector<LinuxAddressInfo> infos(a_Addresses.size());
+  size_t numShards = std::min(a_Addresses.size(), GetNumWorkers());
+  ParallelFor(numShards, [&](size_t shard) {
+    size_t begin = shard * a_Addresses.size() / numShards;
+    size_t end = (shard + 1) * a_Addresses.size() / numShards;
+    for (size_t i = begin; i < end; ++i) {
+      infos[i] = ResolveLinuxAddress(a_Addresses[i]);
+    }
+  });
+
+  for (size_t i = 0; i < a_Addresses.size(); ++i) {
+    StoreLinuxAddress(a_Addresses[i], infos[i]);
+  }
+}
+
+//-----------------------------------------------------------------------------
+std::vector<uint64_t> SamplingProfiler::GetSampledAddresses() {
+  ScopeLock lock(m_Mutex);
+  std::vector<uint64_t> addresses;
+  addresses.reserve(m_ExactAddresses.size());
+  for (const auto& pair : m_ExactAddresses) {
+    addresses.push_back(pair.first);
+  }
+  std::sort(addresses.begin(), addresses.end());
+  return addresses;
+}
+
+//-----------------------------------------------------------------------------
+absl::flat_hash_map<CallstackID, unsigned int>
+SamplingProfiler::GetAllCallstackCounts() {
+  absl::flat_hash_map<CallstackID, unsigned int> callstackCounts;
+  {
+    absl::ReaderMutexLock lock(&m_ReportMutex);
+    for (const auto& dataIt : m_ThreadSampleData) {
+      // The summary adds up the samples of the other threads.
+      if (dataIt.first == 0) continue;
+      for (const auto& countIt : dataIt.second.m_CallstackCount) {
+        callstackCounts[countIt.first] += countIt.second;
       }
+    }
+  }
+
+  absl::ReaderMutexLock lock(&m_CallstacksMutex);
+  for (const auto& countIt : m_CallstackCounts) {
+    callstackCounts[countIt.first.second] += countIt.second;
+  }
+  for (const CallstackEvent& event : m_Callstacks) {
+    ++callstackCounts[event.m_Id];
+  }
+  return callstackCounts;
+}
+
+//-----------------------------------------------------------------------------
+absl::flat_hash_map<uint64_t, unsigned int>
+SamplingProfiler::GetExactAddressCounts(uint64_t a_Begin, uint64_t a_End) {
+  absl::flat_hash_map<CallstackID, unsigned int> callstackCounts =
+      GetAllCallstackCounts();
+
+  absl::flat_hash_map<uint64_t, unsigned int> addressCounts;
+  absl::ReaderMutexLock lock(&m_CallstacksMutex);
+  for (const auto& countIt : callstackCounts) {
+    auto nodeIt = m_UniqueCallstacks.find(countIt.first);
+    if (nodeIt == m_UniqueCallstacks.end() ||
+        nodeIt->second == CallstackTree::kRootId) {
+      continue;
+    }
+    uint64_t address = m_CallstackTree.GetAddress(nodeIt->second);
+    if (address >= a_Begin && address < a_End) {
+      addressCounts[address] += countIt.second;
+    }
+  }
+  return addressCounts;
+}
+
+//-----------------------------------------------------------------------------
+SourceLineCounts SamplingProfiler::GetSourceLineCounts(
+    const std::wstring& a_File) {
+  absl::flat_hash_map<CallstackID, unsigned int> callstackCounts =
+      GetAllCallstackCounts();
+
+  // Counts by exact address first, so that each address sampled is only
+  // looked up once in the line infos.
+  SourceLineCounts lineCounts;
+  absl::flat_hash_map<uint64_t, SourceLineCount> addressCounts;
+  {
+    absl::ReaderMutexLock lock(&m_CallstacksMutex);
+    for (const auto& countIt : callstackCounts) {
+      lineCounts.m_NumSamples += countIt.second;
+      auto nodeIt = m_UniqueCallstacks.find(countIt.first);
+      if (nodeIt == m_UniqueCallstacks.end() ||
+          nodeIt->second == CallstackTree::kRootId) {
+        continue;
+      }
+      SampledAddresses addresses =
+          MakeSampledAddresses(m_CallstackTree.GetFrames(nodeIt->second));
+      addressCounts[addresses.m_Leaf].m_Exclusive += countIt.second;
+      for (uint64_t address : addresses.m_Unique) {
+        addressCounts[address].m_Inclusive += countIt.second;
+      }
+    }
+  }
 
-      auto addrIt = m_ExactAddresses.find(addr);
-      if (addrIt != m_ExactAddresses.end()) {
-        const uint64_t& functionAddr = addrIt->second;
-        ResolvedCallstack.m_Data[i] = functionAddr;
-        m_FunctionToCallstacks[functionAddr].insert(rawCallstackId);
+  const uint64_t fileHash = StringHash(a_File);
+  SamplingProfiler& tables = GetTables();
+  ScopeLock lock(tables.m_Mutex);
+  for (const auto& addressIt : addressCounts) {
+    auto lineIt = tables.m_AddressToLineInfo.find(addressIt.first);
+    if (lineIt == tables.m_AddressToLineInfo.end() ||
+        lineIt->second.m_FileNameHash != fileHash) {
+      continue;
+    }
+    SourceLineCount& count = lineCounts.m_Lines[lineIt->second.m_Line];
+    count.m_Exclusive += addressIt.second.m_Exclusive;
+    count.m_Inclusive += addressIt.second.m_Inclusive;
+  }
+  return lineCounts;
+}
+
+//-----------------------------------------------------------------------------
+void SamplingProfiler::VisitCallstackCounts(
+    const CallstackCountVisitor& a_Visitor) {
+  absl::flat_hash_map<std::pair<ThreadID, CallstackID>, unsigned int> counts;
+  {
+    absl::ReaderMutexLock lock(&m_ReportMutex);
+    for (const auto& dataIt : m_ThreadSampleData) {
+      // The summary adds up the samples of the other threads.
+      if (dataIt.first == 0) continue;
+      for (const auto& countIt : dataIt.second.m_CallstackCount) {
+        counts[{dataIt.first, countIt.first}] += countIt.second;
       }
     }
+  }
+  {
+    absl::ReaderMutexLock lock(&m_CallstacksMutex);
+    for (const auto& countIt : m_CallstackCounts) {
+      counts[countIt.first] += countIt.second;
+    }
+    for (const CallstackEvent& event : m_Callstacks) {
+      ++counts[{event.m_TID, event.m_Id}];
+    }
+  }
 
-    CallstackID resolvedCallstackId = ResolvedCallstack.Hash();
-    if (m_UniqueResolvedCallstacks.find(resolvedCallstackId) ==
-        m_UniqueResolvedCallstacks.end()) {
-      m_UniqueResolvedCallstacks[resolvedCallstackId] =
-          std::make_shared<CallStack>(ResolvedCallstack);
+  std::vector<uint64_t> frames;
+  for (const auto& countIt : counts) {
+    {
+      absl::ReaderMutexLock lock(&m_CallstacksMutex);
+      auto nodeIt = m_UniqueCallstacks.find(countIt.first.second);
+      if (nodeIt == m_UniqueCallstacks.end() ||
+          nodeIt->second == CallstackTree::kRootId) {
+        continue;
+      }
+      frames = m_CallstackTree.GetFrames(nodeIt->second);
     }
+    a_Visitor(countIt.first.first, frames, countIt.second);
+  }
+}
 
-    m_RawToResolvedMap[rawCallstackId] = resolvedCallstackId;
+//-----------------------------------------------------------------------------
+void SamplingProfiler::ResolveAddressesInRange(uint64_t a_Begin,
+                                               uint64_t a_End) {
+  ScopeLock lock(m_Mutex);
+  std::vector<uint64_t> addresses;
+  for (const auto& pair : m_ExactAddresses) {
+    if (pair.first >= a_Begin && pair.first < a_End) {
+      addresses.push_back(pair.first);
+    }
   }
+  std::sort(addresses.begin(), addresses.end());
+  ResolveAddresses(addresses);
+}
+
+//-----------------------------------------------------------------------------
+SamplingProfiler::LinuxAddressInfo SamplingProfiler::ResolveLinuxAddress(
+    uint64_t a_Address) const {
+  LinuxAddressInfo info;
+  // TODO: find function start address
+  info.m_FunctionAddress = a_Address;
+
+  std::shared_ptr<Module> module = m_Process->GetModuleFromAddress(a_Address);
+  if (module != nullptr && module->ContainsAddress(a_Address) &&
+      module->m_Pdb != nullptr) {
+    info.m_HasLineInfo =
+        module->m_Pdb->LineInfoFromAddress(a_Address, info.m_LineInfo);
+  }
+  if (module != nullptr && module->ContainsAddress(a_Address) &&
+      !module->m_DebugSignature.empty()) {
+    std::optional<SymbolCache::Entry> entry = SymbolCache::Get().Find(
+        module->m_DebugSignature, a_Address - module->m_AddressStart);
+    if (entry.has_value()) {
+      info.m_FunctionAddress = module->m_AddressStart + entry->function_offset;
+      info.m_Name = std::move(entry->function_name);
+      info.m_IsResolved = true;
+      info.m_IsCached = true;
+      return info;
+    }
+    info.m_Module = std::move(module);
+  }
+
+  std::shared_ptr<LinuxSymbol> symbol =
+      m_Process->LinuxSymbolFromAddress(a_Address);
+  if (symbol == nullptr || Contains(symbol->m_Name, "[unknown]")) {
+    Function* function = m_Process->GetFunctionFromAddress(a_Address, false);
+    if (function) {
+      info.m_Name = function->PrettyName();
+      info.m_IsResolved = true;
+      info.m_UnknownSymbol = std::move(symbol);
+    }
+  } else {
+    info.m_Name = symbol->m_Name;
+    info.m_IsResolved = true;
+    // Only the symbols of kernel frames come with their function's address.
+    if (symbol->m_Address != 0) {
+      info.m_FunctionAddress = symbol->m_Address;
+    }
+  }
+  return info;
+}
+
+//-----------------------------------------------------------------------------
+void SamplingProfiler::StoreLinuxAddress(uint64_t a_Address,
+                                         const LinuxAddressInfo& a_Info) {
+  m_ExactAddresses[a_Address] = a_Info.m_FunctionAddress;
+  m_AddressToSymbol[a_Address] = s2ws(a_Info.m_Name);
+  if (a_Info.m_UnknownSymbol != nullptr) {
+    a_Info.m_UnknownSymbol->m_Name = a_Info.m_Name;
+  }
+  if (a_Info.m_HasLineInfo) {
+    StoreLineInfo(a_Address, a_Info.m_LineInfo);
+  }
+  // Unresolved addresses aren't cached: their symbols might come later.
+  if (a_Info.m_IsResolved && !a_Info.m_IsCached && a_Info.m_Module != nullptr) {
+    SymbolCache::Get().Add(
+        a_Info.m_Module->m_DebugSignature,
+        a_Address - a_Info.m_Module->m_AddressStart,
+        {a_Info.m_FunctionAddress - a_Info.m_Module->m_AddressStart,
+         a_Info.m_Name});
+  }
+}
+
+//-----------------------------------------------------------------------------
+void SamplingProfiler::StoreLineInfo(uint64_t a_Address, LineInfo a_LineInfo) {
+  // File names are stored once, the line infos only keep their hash.
+  uint64_t hash = StringHash(a_LineInfo.m_File);
+  a_LineInfo.m_FileNameHash = hash;
+  m_FileNames[hash] = std::move(a_LineInfo.m_File);
+  a_LineInfo.m_File = L"";
+  m_AddressToLineInfo[a_Address] = std::move(a_LineInfo);
 }
 
 //-----------------------------------------------------------------------------
@@ -431,80 +1338,54 @@ void SamplingProfiler::AddAddress(uint64_t a_Address) {
 
     LineInfo lineInfo;
     if (SymUtils::GetLineInfo(a_Address, lineInfo)) {
-      uint64_t hash = StringHash(lineInfo.m_File);
-      lineInfo.m_FileNameHash = hash;
-      m_FileNames[hash] = lineInfo.m_File;
-      lineInfo.m_File = L"";
-      m_AddressToLineInfo[a_Address] = lineInfo;
+      StoreLineInfo(a_Address, std::move(lineInfo));
     }
   } else
 #endif
   {
-    // TODO: find function start address
-    m_ExactAddresses[a_Address] =
-        /*symbol_info->Address ? symbol_info->Address :*/ a_Address;
-    std::shared_ptr<LinuxSymbol> symbol =
-        m_Process->LinuxSymbolFromAddress(a_Address);
-    std::string symbolName = "???";
-
-    if (symbol == nullptr || Contains(symbol->m_Name, "[unknown]")) {
-      Function* function = m_Process->GetFunctionFromAddress(a_Address, false);
-      if (function) {
-        symbolName = function->PrettyName();
-        if (symbol) {
-          symbol->m_Name = symbolName;
-        }
-      }
-    } else {
-      symbolName = symbol->m_Name;
-    }
-    m_AddressToSymbol[(uint64_t)a_Address] = s2ws(symbolName);
+    StoreLinuxAddress(a_Address, ResolveLinuxAddress(a_Address));
   }
 }
 
 //-----------------------------------------------------------------------------
-void SamplingProfiler::OutputStats() {
-  for (auto& dataIt : m_ThreadSampleData) {
-    ThreadID threadID = dataIt.first;
-    ThreadSampleData& threadSampleData = dataIt.second;
-    std::vector<SampledFunction>& sampleReport =
-        threadSampleData.m_SampleReport;
-
-    ORBIT_LOGV(threadID);
-    ORBIT_LOGV(threadSampleData.m_NumSamples);
-
-    for (std::multimap<unsigned int, uint64_t>::reverse_iterator sortedIt =
-             threadSampleData.m_AddressCountSorted.rbegin();
-         sortedIt != threadSampleData.m_AddressCountSorted.rend(); ++sortedIt) {
-      int numOccurences = sortedIt->first;
-      uint64_t address = sortedIt->second;
-      float prct =
-          100.f * ((float)numOccurences) / (float)threadSampleData.m_NumSamples;
-
-      SampledFunction function;
-      function.m_Name = m_AddressToSymbol[address].c_str();
-      function.m_Inclusive = prct;
-      function.m_Exclusive = 0.f;
-      auto it = threadSampleData.m_ExclusiveCount.find(address);
-      if (it != threadSampleData.m_ExclusiveCount.end()) {
-        function.m_Exclusive =
-            100.f * (float)it->second / (float)threadSampleData.m_NumSamples;
-      }
-      function.m_Address = address;
+void SamplingProfiler::OutputStats(ThreadSampleData* a_ThreadSampleData) {
+  SamplingProfiler& tables = GetTables();
+  ScopeLock lock(tables.m_Mutex);
+  ThreadSampleData& threadSampleData = *a_ThreadSampleData;
+  std::vector<SampledFunction>& sampleReport = threadSampleData.m_SampleReport;
+  sampleReport.clear();
+
+  for (std::multimap<unsigned int, uint64_t>::reverse_iterator sortedIt =
+           threadSampleData.m_AddressCountSorted.rbegin();
+       sortedIt != threadSampleData.m_AddressCountSorted.rend(); ++sortedIt) {
+    int numOccurences = sortedIt->first;
+    uint64_t address = sortedIt->second;
+    float prct =
+        100.f * ((float)numOccurences) / (float)threadSampleData.m_NumSamples;
+
+    SampledFunction function;
+    function.m_Name = tables.m_AddressToSymbol[address].c_str();
+    function.m_Inclusive = prct;
+    function.m_Exclusive = 0.f;
+    auto it = threadSampleData.m_ExclusiveCount.find(address);
+    if (it != threadSampleData.m_ExclusiveCount.end()) {
+      function.m_Exclusive =
+          100.f * (float)it->second / (float)threadSampleData.m_NumSamples;
+    }
+    function.m_Address = address;
 
-      std::shared_ptr<Module> module = m_Process->GetModuleFromAddress(address);
-      function.m_Module = module ? s2ws(module->m_Name) : L"unknown module";
+    std::shared_ptr<Module> module = m_Process->GetModuleFromAddress(address);
+    function.m_Module = module ? s2ws(module->m_Name) : L"unknown module";
 
-      const LineInfo& lineInfo = m_AddressToLineInfo[address];
-      function.m_Line = lineInfo.m_Line;
-      function.m_File = lineInfo.m_File;
-      sampleReport.push_back(function);
-    }
+    const LineInfo& lineInfo = tables.m_AddressToLineInfo[address];
+    function.m_Line = lineInfo.m_Line;
+    function.m_File = lineInfo.m_File;
+    sampleReport.push_back(function);
   }
 }
 
 //-----------------------------------------------------------------------------
-void SamplingProfiler::GetThreadCallstack(Thread* a_Thread) {
+CallstackID SamplingProfiler::GetThreadCallstack(Thread* a_Thread) {
 #ifdef _WIN32
   StackFrame frame(a_Thread->m_Handle);
 
@@ -521,14 +1402,19 @@ void SamplingProfiler::GetThreadCallstack(Thread* a_Thread) {
     frame.m_Callstack.m_Depth = depth;
     frame.m_Callstack.m_ThreadId = a_Thread->m_TID;
     AddCallStack(frame.m_Callstack);
+    return frame.m_Callstack.Hash();
   }
 #else
   UNUSED(a_Thread);
 #endif
+  return 0;
 }
 
 //-----------------------------------------------------------------------------
 std::wstring SamplingProfiler::GetSymbolFromAddress(uint64_t a_Address) {
+  if (m_Source != nullptr) {
+    return m_Source->GetSymbolFromAddress(a_Address);
+  }
   ScopeLock lock(m_Mutex);
 
   auto it = m_AddressToSymbol.find(a_Address);
@@ -588,9 +1474,47 @@ ORBIT_SERIALIZE_WSTRING(SamplingProfiler, 1) {
   ORBIT_NVP_VAL(0, m_PeriodMs);
   ORBIT_NVP_VAL(0, m_NumSamples);
   ORBIT_NVP_DEBUG(0, m_ThreadSampleData);
-  ORBIT_NVP_DEBUG(0, m_UniqueCallstacks);
-  ORBIT_NVP_DEBUG(0, m_UniqueResolvedCallstacks);
-  ORBIT_NVP_DEBUG(0, m_RawToResolvedMap);
+
+  // Callstacks are saved whole, as they were before being interned in trees.
+  std::unordered_map<CallstackID, std::shared_ptr<CallStack>> uniqueCallstacks;
+  std::unordered_map<CallstackID, std::shared_ptr<CallStack>>
+      uniqueResolvedCallstacks;
+  std::unordered_map<CallstackID, CallstackID> rawToResolvedMap;
+  if (Archive::is_saving::value) {
+    for (const auto& it : m_UniqueCallstacks) {
+      uniqueCallstacks[it.first] = MakeCallStack(m_CallstackTree, it.second);
+      uniqueCallstacks[it.first]->m_Hash = it.first;
+    }
+    for (const auto& it : m_RawToResolvedMap) {
+      std::shared_ptr<CallStack> callstack =
+          MakeCallStack(m_ResolvedCallstackTree, it.second);
+      rawToResolvedMap[it.first] = callstack->Hash();
+      uniqueResolvedCallstacks[callstack->m_Hash] = std::move(callstack);
+    }
+  }
+  ORBIT_NVP_DEBUG(0, uniqueCallstacks);
+  ORBIT_NVP_DEBUG(0, uniqueResolvedCallstacks);
+  ORBIT_NVP_DEBUG(0, rawToResolvedMap);
+  if (Archive::is_loading::value) {
+    m_CallstackTree.Clear();
+    m_UniqueCallstacks.clear();
+    for (auto& it : uniqueCallstacks) {
+      AddUniqueCallStack(*it.second);
+    }
+    m_ResolvedCallstackTree.Clear();
+    m_RawToResolvedNodes.clear();
+    m_RawToResolvedMap.clear();
+    for (const auto& it : rawToResolvedMap) {
+      auto callstackIt = uniqueResolvedCallstacks.find(it.second);
+      if (callstackIt == uniqueResolvedCallstacks.end()) {
+        continue;
+      }
+      const CallStack& callstack = *callstackIt->second;
+      m_RawToResolvedMap[it.first] = m_ResolvedCallstackTree.Intern(
+          absl::MakeConstSpan(callstack.m_Data).subspan(0, callstack.m_Depth));
+    }
+  }
+
   ORBIT_NVP_DEBUG(0, m_FunctionToCallstacks);
   ORBIT_NVP_DEBUG(0, m_ExactAddresses);
   ORBIT_NVP_DEBUG(0, m_AddressToSymbol);
@@ -5,13 +5,21 @@
 
 #include "BlockChain.h"
 #include "Callstack.h"
+#include "CallstackTree.h"
 #include "Core.h"
 #include "EventBuffer.h"
+#include "MemoryAccounting.h"
+#include "ModuleCosts.h"
 #include "Pdb.h"
 #include "SerializationMacros.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
 
 class Process;
 class Thread;
+struct LinuxSymbol;
+struct Module;
 
 //-----------------------------------------------------------------------------
 struct SampledFunction {
@@ -46,14 +54,21 @@ struct LineInfo {
 struct ThreadSampleData {
   ThreadSampleData() { m_ThreadUsage.push_back(0); }
   void ComputeAverageThreadUsage();
+  // Clears the counts by address and the report, e.g. once the callstack
+  // counts changed.
+  void ClearReport();
   std::multimap<int, CallstackID> SortCallstacks(
-      const std::set<CallstackID>& a_CallStacks, int& o_TotalCallStacks);
+      const std::set<CallstackID>& a_CallStacks, int& o_TotalCallStacks) const;
   std::unordered_map<CallstackID, unsigned int> m_CallstackCount;
   std::unordered_map<uint64_t, unsigned int> m_AddressCount;
   std::unordered_map<uint64_t, unsigned int> m_ExclusiveCount;
   std::multimap<unsigned int, uint64_t> m_AddressCountSorted;
   unsigned int m_NumSamples = 0;
   std::vector<SampledFunction> m_SampleReport;
+  // Whether the counts by address and m_SampleReport are computed from the
+  // callstack counts. Only the summary's are computed when processing the
+  // samples, the others on demand, see SamplingProfiler::GetSampledFunctions.
+  bool m_HasReport = false;
   std::vector<float> m_ThreadUsage;
   float m_AverageThreadUsage = 0;
   ThreadID m_TID = 0;
@@ -77,6 +92,38 @@ struct SortedCallstackReport {
   ORBIT_SERIALIZABLE;
 };
 
+//-----------------------------------------------------------------------------
+// Addresses of a callstack, as counted for each of its samples.
+struct SampledAddresses {
+  uint64_t m_Leaf = 0;
+  // Recursive functions are only counted once per sample.
+  std::vector<uint64_t> m_Unique;
+};
+
+//-----------------------------------------------------------------------------
+// Samples of a thread aggregated over the callstacks of functions: a node
+// per distinct chain of calls, with the number of samples it was on.
+struct SampledCallTree {
+  CallstackTree m_Tree;
+  // Per node. The root's count is the number of samples.
+  std::vector<uint64_t> m_InclusiveCounts;
+};
+
+//-----------------------------------------------------------------------------
+struct SourceLineCount {
+  unsigned int m_Exclusive = 0;
+  unsigned int m_Inclusive = 0;
+};
+
+//-----------------------------------------------------------------------------
+// Samples of the lines of a source file, e.g. for the heat of the code view.
+struct SourceLineCounts {
+  // By line, from 1. Only lines sampled.
+  absl::flat_hash_map<uint32_t, SourceLineCount> m_Lines;
+  // All samples, on the file or not.
+  unsigned int m_NumSamples = 0;
+};
+
 //-----------------------------------------------------------------------------
 class SamplingProfiler {
  public:
@@ -95,15 +142,33 @@ class SamplingProfiler {
 
   void AddCallStack(CallStack& a_CallStack);
   void AddHashedCallStack(CallstackEvent& a_CallStack);
+  // Adds the callstacks of a_NewCallStacks that aren't present yet, then the
+  // samples of a_Events, locking once for the whole batch rather than once
+  // per sample.
+  void AddCallStacks(absl::Span<const CallstackEvent> a_Events,
+                     absl::Span<CallStack> a_NewCallStacks);
   void AddUniqueCallStack(CallStack& a_CallStack);
+  // Adds a_Count samples of a_CallStack at once, e.g. all those of a time
+  // range. They aren't part of the live report.
+  void AddCallStackSamples(CallStack& a_CallStack, ThreadID a_TID,
+                           unsigned int a_Count);
 
-  const std::shared_ptr<CallStack> GetCallStack(CallstackID a_ID) {
-    ScopeLock lock(m_Mutex);
-    return m_UniqueCallstacks[a_ID];
-  }
+  // Processed profiler of the samples of a_Counts, e.g. those of a selection,
+  // whose callstacks were added to a_Source. Callstacks aren't copied nor
+  // resolved again: only the callstacks that a_Source hasn't processed yet
+  // are, in a_Source, and the returned profiler looks callstacks, symbols
+  // and line infos up in a_Source. Returns nullptr if a_Cancelled was set
+  // before it was done.
+  static std::shared_ptr<SamplingProfiler> MakeSubsetProfiler(
+      const std::shared_ptr<SamplingProfiler>& a_Source,
+      const std::map<ThreadID, CallstackCounts>& a_Counts,
+      bool a_GenerateSummary, const std::atomic<bool>& a_Cancelled);
+
+  // Copy of the callstack, rebuilt from the callstack tree.
+  const std::shared_ptr<CallStack> GetCallStack(CallstackID a_ID);
 
   inline bool HasCallStack(CallstackID a_ID) {
-    ScopeLock lock(m_Mutex);
+    absl::ReaderMutexLock lock(&m_CallstacksMutex);
     auto it = m_UniqueCallstacks.find(a_ID);
     return it != m_UniqueCallstacks.end();
   }
@@ -122,9 +187,15 @@ class SamplingProfiler {
   };
   SamplingState GetState() const { return m_State; }
   void SetState(SamplingState a_State) { m_State = a_State; }
+  // Only to be read once processing is done. The reports of the threads
+  // other than the summary are only computed by GetSampledFunctions.
   const std::vector<ThreadSampleData*>& GetThreadSampleData() const {
     return m_SortedThreadSampleData;
   }
+  // Report of the processed samples of a_TID, 0 for the summary. Computed the
+  // first time a thread is asked for, e.g. when its tab is opened, then kept
+  // until the samples are processed again.
+  std::vector<SampledFunction> GetSampledFunctions(ThreadID a_TID);
   void SetLoadedFromFile(bool a_Value = true) { m_LoadedFromFile = a_Value; }
   void SetIsLinuxPerf(bool a_Value = true) { m_IsLinuxPerf = a_Value; }
 
@@ -136,6 +207,7 @@ class SamplingProfiler {
       std::unordered_map<uint64_t, SampledFunction>& a_SelectedFunctions);
   void SetGenerateSummary(bool a_Value) { m_GenerateSummary = a_Value; }
   bool GetGenerateSummary() const { return m_GenerateSummary; }
+  void SetOverheadBudget(float a_Budget) { m_OverheadBudget = a_Budget; }
   void SortByThreadUsage();
   void SortByThreadID();
   bool GetLineInfo(uint64_t a_Address, LineInfo& a_LineInfo);
@@ -146,44 +218,171 @@ class SamplingProfiler {
   void AddAddress(uint64_t a_Address);
 
   std::wstring GetSymbolFromAddress(uint64_t a_Address);
+  // Sorted addresses of the frames resolved so far.
+  std::vector<uint64_t> GetSampledAddresses();
+  // Samples by exact address of their innermost frame, for the addresses in
+  // [a_Begin, a_End), e.g. the instructions of a function. Counts both the
+  // processed samples and those received since.
+  absl::flat_hash_map<uint64_t, unsigned int> GetExactAddressCounts(
+      uint64_t a_Begin, uint64_t a_End);
+  // Samples per line of the source file a_File, rolled up from the exact
+  // addresses sampled whose line is known. A sample is inclusive to a line
+  // once per distinct address of its callstack on that line. Counts both the
+  // processed samples and those received since.
+  SourceLineCounts GetSourceLineCounts(const std::wstring& a_File);
+  // Calls a_Visitor with the frames of each callstack sampled, innermost
+  // first, and its number of samples on a thread, e.g. to export them.
+  // Counts both the processed samples and those received since. The
+  // callstacks aren't locked during the calls.
+  using CallstackCountVisitor = std::function<void(
+      ThreadID, absl::Span<const uint64_t> /*frames*/, unsigned int)>;
+  void VisitCallstackCounts(const CallstackCountVisitor& a_Visitor);
+  // Resolves again the addresses in [a_Begin, a_End) resolved so far, e.g.
+  // once the symbols of their module are loaded. Reports built afterwards
+  // use the new symbols.
+  void ResolveAddressesInRange(uint64_t a_Begin, uint64_t a_End);
   const ThreadSampleData& GetSummary() { return m_ThreadSampleData[0]; }
 
+  // Report of the samples received so far, while sampling. Samples are
+  // counted as they arrive, so a snapshot only costs as much as the number
+  // of distinct addresses. Until the capture is processed, a function
+  // recursing through different call sites can be counted more than once in
+  // the inclusive percentage of a sample.
+  std::vector<ThreadID> GetLiveThreadIds() const;
+  std::vector<SampledFunction> GetLiveSampledFunctions(ThreadID a_TID);
+  // Samples of all threads by start address of module, counted as they
+  // arrive while sampling, then recounted from the processed samples.
+  absl::flat_hash_map<uint64_t, ModuleCosts::Cost> GetModuleCosts(
+      unsigned int* o_NumSamples) const;
+
+  // Call tree of the processed samples of a_TID, 0 for the summary.
+  std::shared_ptr<SampledCallTree> GetCallTree(ThreadID a_TID);
+  // Call tree of the samples received so far, while sampling. The live tree
+  // of functions is only extended with the callstacks that are new since
+  // the previous snapshot, whose addresses are resolved all at once.
+  std::shared_ptr<SampledCallTree> GetLiveCallTree(ThreadID a_TID);
+
   ORBIT_SERIALIZABLE;
 
  protected:
   void ReserveThreadData();
   void SampleThreadsAsync();
-  void GetThreadCallstack(Thread* a_Thread);
+  // Returns the id of the callstack added, 0 if the walk failed.
+  CallstackID GetThreadCallstack(Thread* a_Thread);
   void GetThreadsUsage();
+  // Needs m_CallstacksMutex locked for reading and m_ReportMutex for writing.
   void ProcessAddresses();
-  void OutputStats();
+  // Same locks as ProcessAddresses.
+  uint64_t GetMapsMemorySize() const;
+  void ResolveAddresses(const std::vector<uint64_t>& a_Addresses);
+
+  // Resolution of a Linux address, computed without changing the profiler or
+  // the process, so that addresses can be resolved in parallel.
+  struct LinuxAddressInfo {
+    uint64_t m_FunctionAddress = 0;
+    std::string m_Name = "???";
+    bool m_IsResolved = false;
+    bool m_IsCached = false;
+    // Module with a build id, to cache the resolution for.
+    std::shared_ptr<Module> m_Module;
+    // Symbol named "[unknown]", to rename with m_Name.
+    std::shared_ptr<LinuxSymbol> m_UnknownSymbol;
+    bool m_HasLineInfo = false;
+    LineInfo m_LineInfo;
+  };
+  LinuxAddressInfo ResolveLinuxAddress(uint64_t a_Address) const;
+  void StoreLinuxAddress(uint64_t a_Address, const LinuxAddressInfo& a_Info);
+  // Needs m_Mutex locked.
+  void StoreLineInfo(uint64_t a_Address, LineInfo a_LineInfo);
+  // Needs m_Mutex locked.
+  uint64_t GetFunctionAddress(uint64_t a_Address);
+  void OutputStats(ThreadSampleData* a_ThreadSampleData);
+  // The profiler holding the callstacks and symbols: a_Source for a subset.
+  SamplingProfiler& GetTables() { return m_Source ? *m_Source : *this; }
+  void CountLiveSamples(absl::Span<const CallstackEvent> a_Events);
+  // Samples by callstack, of all threads, processed or not.
+  absl::flat_hash_map<CallstackID, unsigned int> GetAllCallstackCounts();
+  std::vector<ModuleCosts::ModuleRange> GetModuleRanges() const;
+  void CountModuleCosts(
+      const std::unordered_map<ThreadID, ThreadSampleData>& a_Data);
 
  protected:
   std::shared_ptr<Process> m_Process;
+  // Set for the profilers made by MakeSubsetProfiler.
+  std::shared_ptr<SamplingProfiler> m_Source;
   std::unique_ptr<std::thread> m_SamplingThread;
   std::atomic<SamplingState> m_State;
-  BlockChain<CallstackEvent, 16 * 1024> m_Callstacks;
+  // Guards the samples and their callstacks, which are read for each sample
+  // during processing and by the UI.
+  mutable absl::Mutex m_CallstacksMutex;
+  BlockChain<CallstackEvent, 16 * 1024> m_Callstacks
+      ABSL_GUARDED_BY(m_CallstacksMutex);
+  // Samples added by count, per thread and callstack.
+  absl::flat_hash_map<std::pair<ThreadID, CallstackID>, unsigned int>
+      m_CallstackCounts ABSL_GUARDED_BY(m_CallstacksMutex);
   Timer m_SamplingTimer;
   Timer m_ThreadUsageTimer;
   int m_PeriodMs = 1;
+  // Share of the time the sampling thread may spend walking stacks, which
+  // lengthens the sampling period of threads that are expensive to walk.
+  float m_OverheadBudget = 0.05f;
   float m_SampleTimeSeconds = FLT_MAX;
   bool m_GenerateSummary = true;
+  // Guards the symbols.
   Mutex m_Mutex;
   int m_NumSamples = 0;
   bool m_LoadedFromFile = false;
   bool m_IsLinuxPerf = false;
 
-  std::unordered_map<ThreadID, ThreadSampleData> m_ThreadSampleData;
-  std::unordered_map<CallstackID, std::shared_ptr<CallStack>>
-      m_UniqueCallstacks;
-  std::unordered_map<CallstackID, std::shared_ptr<CallStack>>
-      m_UniqueResolvedCallstacks;
-  std::unordered_map<CallstackID, CallstackID> m_RawToResolvedMap;
-  std::unordered_map<uint64_t, std::set<CallstackID>> m_FunctionToCallstacks;
+  // Distinct callstacks, as nodes of the callstack tree.
+  CallstackTree m_CallstackTree ABSL_GUARDED_BY(m_CallstacksMutex);
+  absl::flat_hash_map<CallstackID, CallstackTree::NodeId> m_UniqueCallstacks
+      ABSL_GUARDED_BY(m_CallstacksMutex);
+
+  // Guards the report, which the UI reads while samples are processed. The
+  // report is only locked for writing when publishing the results.
+  mutable absl::Mutex m_ReportMutex;
+  std::unordered_map<ThreadID, ThreadSampleData> m_ThreadSampleData
+      ABSL_GUARDED_BY(m_ReportMutex);
+  // Callstacks of functions rather than addresses. Resolved nodes are
+  // indexed by node of m_CallstackTree, up to the nodes processed so far.
+  CallstackTree m_ResolvedCallstackTree ABSL_GUARDED_BY(m_ReportMutex);
+  std::vector<CallstackTree::NodeId> m_RawToResolvedNodes
+      ABSL_GUARDED_BY(m_ReportMutex);
+  std::unordered_map<CallstackID, CallstackTree::NodeId> m_RawToResolvedMap
+      ABSL_GUARDED_BY(m_ReportMutex);
+  std::unordered_map<uint64_t, std::set<CallstackID>> m_FunctionToCallstacks
+      ABSL_GUARDED_BY(m_ReportMutex);
   std::unordered_map<uint64_t, uint64_t> m_ExactAddresses;
   std::unordered_map<uint64_t, std::wstring> m_AddressToSymbol;
   std::unordered_map<uint64_t, LineInfo> m_AddressToLineInfo;
   std::unordered_map<uint64_t, std::wstring> m_FileNames;
   std::vector<ProcessingDoneCallback> m_Callbacks;
-  std::vector<ThreadSampleData*> m_SortedThreadSampleData;
+  std::vector<ThreadSampleData*> m_SortedThreadSampleData
+      ABSL_GUARDED_BY(m_ReportMutex);
+
+  // Counted by raw address while sampling, reset on each capture.
+  struct LiveThreadCounts {
+    unsigned int m_NumSamples = 0;
+    absl::flat_hash_map<uint64_t, unsigned int> m_Inclusive;
+    absl::flat_hash_map<uint64_t, unsigned int> m_Exclusive;
+    absl::flat_hash_map<CallstackID, unsigned int> m_Callstacks;
+  };
+  mutable absl::Mutex m_LiveMutex;
+  absl::flat_hash_map<CallstackID, SampledAddresses> m_LiveAddresses
+      ABSL_GUARDED_BY(m_LiveMutex);
+  absl::flat_hash_map<ThreadID, LiveThreadCounts> m_LiveCounts
+      ABSL_GUARDED_BY(m_LiveMutex);
+  ModuleCosts m_ModuleCosts ABSL_GUARDED_BY(m_LiveMutex);
+
+  // Callstacks of functions of the live call trees. Resolved nodes are
+  // indexed by node of m_CallstackTree, up to the nodes resolved so far.
+  absl::Mutex m_LiveCallTreeMutex;
+  CallstackTree m_LiveCallTree ABSL_GUARDED_BY(m_LiveCallTreeMutex);
+  std::vector<CallstackTree::NodeId> m_LiveRawToResolvedNodes
+      ABSL_GUARDED_BY(m_LiveCallTreeMutex);
+
+  // Estimated bytes of the maps of the processed samples, updated once they
+  // are processed. The samples are counted by m_Callstacks.
+  MemoryAccount m_MapsMemory{MemorySubsystem::kSamplingProfiler};
 };
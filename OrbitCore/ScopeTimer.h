@@ -63,6 +63,26 @@ class Timer {
     FREE,
     INTROSPECTION,
     GPU_ACTIVITY,
+    // A statistic of OrbitService over [m_Start, m_End), named by the key in
+    // m_UserData[0], its value the bits of the double in m_UserData[1].
+    SERVICE_STATS,
+    // A value of a variable tracked with ORBIT_TRACK at m_Start, named by the
+    // key in m_UserData[0], its value the bits of the double in
+    // m_UserData[1]. Plotted on a counter track per name, not on the track of
+    // m_TID.
+    VARIABLE,
+    // A file I/O syscall of m_TID, see MakeFileIoTimer. Drawn on the file I/O
+    // track of the thread, not with its timers.
+    FILE_IO,
+    // A sampled page fault of m_TID at m_Start, with the callstack that
+    // faulted. m_UserData[0] is 1 for a major fault, m_UserData[1] the number
+    // of faults the sample stands for. Drawn on the page fault track of the
+    // thread and counted in Capture::GPageFaultProfile.
+    PAGE_FAULT,
+    // A wait of m_TID on the lock at address m_UserData[0] over
+    // [m_Start, m_End), with the callstack of the thread when it ended.
+    // Counted in Capture::GLockContentionProfile.
+    LOCK_WAIT,
   };
 
   Type GetType() const { return m_Type; }
@@ -0,0 +1,241 @@
+#include "SharedMemoryRing.h"
+
+#include <OrbitBase/Logging.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <new>
+
+#include "absl/strings/str_format.h"
+
+// Lives at the beginning of the segment, followed by the data.
+struct SharedMemoryRing::Control {
+  static constexpr uint32_t kMagic = 0x4f524252;
+  static constexpr uint32_t kVersion = 1;
+
+  uint32_t magic;
+  uint32_t version;
+  uint64_t capacity;
+  std::atomic<uint32_t> closed;
+  // Set by a side before it waits on its semaphore, and cleared by the other
+  // side when it posts it: the semaphores are only posted when needed.
+  std::atomic<uint32_t> consumer_waiting;
+  std::atomic<uint32_t> producer_waiting;
+  sem_t data_available;
+  sem_t space_available;
+  // Total number of bytes written and read so far, on their own cache lines.
+  alignas(64) std::atomic<uint64_t> write_position;
+  alignas(64) std::atomic<uint64_t> read_position;
+};
+
+namespace {
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "Atomics are shared between processes");
+
+constexpr size_t kDataOffset = (sizeof(SharedMemoryRing::Control) + 63) & ~63;
+
+void WaitFor(sem_t* semaphore, uint32_t timeout_ms) {
+  timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += timeout_ms / 1000;
+  deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L) {
+    ++deadline.tv_sec;
+    deadline.tv_nsec -= 1000000000L;
+  }
+  while (sem_timedwait(semaphore, &deadline) != 0 && errno == EINTR) {
+  }
+}
+}  // namespace
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::Create(size_t capacity) {
+  CHECK(capacity > 0);
+  static std::atomic<uint32_t> next_id = 0;
+  std::string name = absl::StrFormat("/orbit-%d-%u", getpid(), next_id++);
+  int fd =
+      shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+  if (fd < 0) {
+    ERROR("Creating shared memory %s: %s", name.c_str(), strerror(errno));
+    return nullptr;
+  }
+  size_t mapping_size = kDataOffset + capacity;
+  void* mapping = MAP_FAILED;
+  if (ftruncate(fd, mapping_size) == 0) {
+    mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fd, 0);
+  }
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    ERROR("Mapping shared memory %s: %s", name.c_str(), strerror(errno));
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+
+  auto* control = new (mapping) Control();
+  control->magic = Control::kMagic;
+  control->version = Control::kVersion;
+  control->capacity = capacity;
+  sem_init(&control->data_available, /*pshared=*/1, 0);
+  sem_init(&control->space_available, /*pshared=*/1, 0);
+  return std::unique_ptr<SharedMemoryRing>(new SharedMemoryRing(
+      std::move(name), mapping, mapping_size, /*is_linked=*/true));
+}
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::Open(
+    const std::string& name) {
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    ERROR("Opening shared memory %s: %s", name.c_str(), strerror(errno));
+    return nullptr;
+  }
+  struct stat file_stat;
+  void* mapping = MAP_FAILED;
+  if (fstat(fd, &file_stat) == 0 &&
+      static_cast<size_t>(file_stat.st_size) > kDataOffset) {
+    mapping = mmap(nullptr, file_stat.st_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    ERROR("Mapping shared memory %s", name.c_str());
+    return nullptr;
+  }
+
+  size_t mapping_size = file_stat.st_size;
+  const auto* control = static_cast<const Control*>(mapping);
+  if (control->magic != Control::kMagic ||
+      control->version != Control::kVersion ||
+      control->capacity != mapping_size - kDataOffset) {
+    ERROR("Shared memory %s is not a ring of this version", name.c_str());
+    munmap(mapping, mapping_size);
+    return nullptr;
+  }
+  return std::unique_ptr<SharedMemoryRing>(
+      new SharedMemoryRing(name, mapping, mapping_size, /*is_linked=*/false));
+}
+
+SharedMemoryRing::SharedMemoryRing(std::string name, void* mapping,
+                                   size_t mapping_size, bool is_linked)
+    : name_(std::move(name)),
+      mapping_(mapping),
+      mapping_size_(mapping_size),
+      control_(static_cast<Control*>(mapping)),
+      data_(static_cast<char*>(mapping) + kDataOffset),
+      capacity_(mapping_size - kDataOffset),
+      is_linked_(is_linked) {}
+
+SharedMemoryRing::~SharedMemoryRing() {
+  Unlink();
+  munmap(mapping_, mapping_size_);
+}
+
+void SharedMemoryRing::Unlink() {
+  if (is_linked_) {
+    shm_unlink(name_.c_str());
+    is_linked_ = false;
+  }
+}
+
+size_t SharedMemoryRing::Write(const void* data, size_t size,
+                               uint32_t timeout_ms) {
+  uint64_t write_position = control_->write_position.load();
+  size_t free_space = capacity_ - (write_position - control_->read_position);
+  if (free_space == 0 && !IsClosed()) {
+    control_->producer_waiting = 1;
+    free_space = capacity_ - (write_position - control_->read_position);
+    if (free_space == 0) {
+      WaitFor(&control_->space_available, timeout_ms);
+      free_space = capacity_ - (write_position - control_->read_position);
+    }
+  }
+  size = std::min(size, free_space);
+  if (size == 0 || IsClosed()) {
+    return 0;
+  }
+
+  size_t offset = write_position % capacity_;
+  size_t first_part_size = std::min(size, capacity_ - offset);
+  memcpy(data_ + offset, data, first_part_size);
+  memcpy(data_, static_cast<const char*>(data) + first_part_size,
+         size - first_part_size);
+  // Sequentially consistent with the check of consumer_waiting, so that
+  // either the consumer sees the new bytes or we see that it is waiting.
+  control_->write_position = write_position + size;
+  if (control_->consumer_waiting.exchange(0) != 0) {
+    sem_post(&control_->data_available);
+  }
+  return size;
+}
+
+bool SharedMemoryRing::Read(std::vector<char>* output, uint32_t timeout_ms) {
+  uint64_t read_position = control_->read_position.load();
+  // Checked first: all bytes written before the ring was closed are visible.
+  bool was_closed = IsClosed();
+  uint64_t write_position = control_->write_position;
+  if (write_position == read_position) {
+    if (was_closed) {
+      return false;
+    }
+    control_->consumer_waiting = 1;
+    write_position = control_->write_position;
+    if (write_position == read_position) {
+      WaitFor(&control_->data_available, timeout_ms);
+      write_position = control_->write_position;
+    }
+    if (write_position == read_position) {
+      return true;
+    }
+  }
+
+  size_t size = write_position - read_position;
+  size_t offset = read_position % capacity_;
+  size_t first_part_size = std::min(size, capacity_ - offset);
+  size_t output_size = output->size();
+  output->resize(output_size + size);
+  memcpy(output->data() + output_size, data_ + offset, first_part_size);
+  memcpy(output->data() + output_size + first_part_size, data_,
+         size - first_part_size);
+  control_->read_position = write_position;
+  if (control_->producer_waiting.exchange(0) != 0) {
+    sem_post(&control_->space_available);
+  }
+  return true;
+}
+
+void SharedMemoryRing::Close() {
+  control_->closed = 1;
+  sem_post(&control_->data_available);
+  sem_post(&control_->space_available);
+}
+
+bool SharedMemoryRing::IsClosed() const { return control_->closed != 0; }
+
+#else
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::Create(size_t) {
+  return nullptr;
+}
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::Open(const std::string&) {
+  return nullptr;
+}
+
+// Never constructed.
+SharedMemoryRing::~SharedMemoryRing() {}
+void SharedMemoryRing::Unlink() {}
+size_t SharedMemoryRing::Write(const void*, size_t, uint32_t) { return 0; }
+bool SharedMemoryRing::Read(std::vector<char>*, uint32_t) { return false; }
+void SharedMemoryRing::Close() {}
+bool SharedMemoryRing::IsClosed() const { return true; }
+
+#endif
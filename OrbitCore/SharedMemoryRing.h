@@ -0,0 +1,76 @@
+#ifndef ORBIT_CORE_SHARED_MEMORY_RING_H_
+#define ORBIT_CORE_SHARED_MEMORY_RING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Byte ring buffer in a POSIX shared memory segment, with one producer process
+// and one consumer process. It replaces the socket for the packets sent by the
+// service when the UI runs on the same host: the packets are written to the
+// ring exactly as they would be to the socket, without any system call while
+// the consumer keeps up.
+//
+// Once a shared memory has been negotiated on a connection (the client creates
+// a ring and sends its name in Msg_SharedMemoryRequest, the service opens it
+// and answers with a raw Msg_SharedMemoryEnabled), every following packet the
+// service sends on that connection goes through the ring. Messages from the
+// client keep using the socket, which also still signals disconnection.
+//
+// Only implemented on Linux: elsewhere, Create and Open return nullptr and the
+// connection stays on the socket.
+class SharedMemoryRing {
+ public:
+  static constexpr size_t kDefaultCapacity = 32 * 1024 * 1024;
+  // Layout of the beginning of the segment, shared by both processes.
+  struct Control;
+
+  // Creates a new segment with a unique name, for the consumer.
+  static std::unique_ptr<SharedMemoryRing> Create(
+      size_t capacity = kDefaultCapacity);
+  // Maps the segment created under name, for the producer.
+  static std::unique_ptr<SharedMemoryRing> Open(const std::string& name);
+
+  ~SharedMemoryRing();
+  SharedMemoryRing(const SharedMemoryRing&) = delete;
+  SharedMemoryRing& operator=(const SharedMemoryRing&) = delete;
+
+  const std::string& GetName() const { return name_; }
+  size_t GetCapacity() const { return capacity_; }
+
+  // Removes the name of the segment, which is destroyed once both sides have
+  // unmapped it. Called as soon as the producer has opened it, so that it is
+  // not leaked if either process dies.
+  void Unlink();
+
+  // Producer: writes as much of data as fits, waiting up to timeout_ms for
+  // the consumer to make room if the ring is full. Returns the number of bytes
+  // written, 0 on timeout or once the ring is closed.
+  size_t Write(const void* data, size_t size, uint32_t timeout_ms);
+
+  // Consumer: appends all the bytes available to output, waiting up to
+  // timeout_ms for the producer if there are none. Returns false once the
+  // ring is closed and all its bytes have been read.
+  bool Read(std::vector<char>* output, uint32_t timeout_ms);
+
+  // Either side: wakes up the other one and makes it stop waiting.
+  void Close();
+  bool IsClosed() const;
+
+ private:
+  SharedMemoryRing(std::string name, void* mapping, size_t mapping_size,
+                   bool is_linked);
+
+  std::string name_;
+  void* mapping_;
+  size_t mapping_size_;
+  Control* control_;
+  char* data_;
+  size_t capacity_;
+  // Whether this side created the name and has not unlinked it yet.
+  bool is_linked_;
+};
+
+#endif  // ORBIT_CORE_SHARED_MEMORY_RING_H_
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "SharedMemoryRing.h"
+
+#ifdef __linux__
+
+TEST(SharedMemoryRing, OpenSeesWrittenBytes) {
+  std::unique_ptr<SharedMemoryRing> consumer = SharedMemoryRing::Create(64);
+  ASSERT_NE(consumer, nullptr);
+  std::unique_ptr<SharedMemoryRing> producer =
+      SharedMemoryRing::Open(consumer->GetName());
+  ASSERT_NE(producer, nullptr);
+  EXPECT_EQ(producer->GetCapacity(), 64);
+
+  EXPECT_EQ(producer->Write("abc", 3, 0), 3);
+  EXPECT_EQ(producer->Write("de", 2, 0), 2);
+  std::vector<char> output;
+  ASSERT_TRUE(consumer->Read(&output, 0));
+  EXPECT_EQ(std::string(output.begin(), output.end()), "abcde");
+}
+
+TEST(SharedMemoryRing, WriteStopsWhenFullAndWraps) {
+  std::unique_ptr<SharedMemoryRing> consumer = SharedMemoryRing::Create(8);
+  ASSERT_NE(consumer, nullptr);
+  std::unique_ptr<SharedMemoryRing> producer =
+      SharedMemoryRing::Open(consumer->GetName());
+  ASSERT_NE(producer, nullptr);
+
+  EXPECT_EQ(producer->Write("0123456789", 10, 0), 8);
+  EXPECT_EQ(producer->Write("x", 1, 0), 0);
+  std::vector<char> output;
+  ASSERT_TRUE(consumer->Read(&output, 0));
+  EXPECT_EQ(std::string(output.begin(), output.end()), "01234567");
+
+  EXPECT_EQ(producer->Write("89abcd", 6, 0), 6);
+  ASSERT_TRUE(consumer->Read(&output, 0));
+  EXPECT_EQ(std::string(output.begin(), output.end()), "0123456789abcd");
+}
+
+TEST(SharedMemoryRing, TransfersAcrossThreads) {
+  std::unique_ptr<SharedMemoryRing> consumer = SharedMemoryRing::Create(1000);
+  ASSERT_NE(consumer, nullptr);
+  std::unique_ptr<SharedMemoryRing> producer =
+      SharedMemoryRing::Open(consumer->GetName());
+  ASSERT_NE(producer, nullptr);
+  consumer->Unlink();
+
+  std::vector<char> input(1'000'000);
+  std::iota(input.begin(), input.end(), 0);
+  std::thread producer_thread([&] {
+    size_t offset = 0;
+    while (offset < input.size()) {
+      offset += producer->Write(input.data() + offset,
+                                std::min<size_t>(333, input.size() - offset),
+                                /*timeout_ms=*/100);
+    }
+    producer->Close();
+  });
+
+  std::vector<char> output;
+  while (consumer->Read(&output, /*timeout_ms=*/100)) {
+  }
+  producer_thread.join();
+  EXPECT_EQ(output, input);
+}
+
+TEST(SharedMemoryRing, CloseWakesUpReader) {
+  std::unique_ptr<SharedMemoryRing> consumer = SharedMemoryRing::Create(64);
+  ASSERT_NE(consumer, nullptr);
+  std::thread closer([&] { consumer->Close(); });
+  std::vector<char> output;
+  while (consumer->Read(&output, /*timeout_ms=*/60'000)) {
+  }
+  closer.join();
+  EXPECT_TRUE(output.empty());
+  EXPECT_TRUE(consumer->IsClosed());
+}
+
+TEST(SharedMemoryRing, OpenFailsOnceUnlinked) {
+  std::unique_ptr<SharedMemoryRing> consumer = SharedMemoryRing::Create(64);
+  ASSERT_NE(consumer, nullptr);
+  consumer->Unlink();
+  EXPECT_EQ(SharedMemoryRing::Open(consumer->GetName()), nullptr);
+  EXPECT_EQ(SharedMemoryRing::Open("/orbit-does-not-exist"), nullptr);
+}
+
+#endif
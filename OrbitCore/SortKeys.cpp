@@ -0,0 +1,173 @@
+#include "SortKeys.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <numeric>
+
+#include "ParallelFor.h"
+
+namespace {
+// Smallest number of elements worth a worker.
+constexpr size_t kMinShardSize = 32 * 1024;
+constexpr int kDigitBits = 8;
+constexpr size_t kNumBuckets = size_t(1) << kDigitBits;
+// Moves per element ResortByKeys makes at most before falling back to a full
+// sort.
+constexpr size_t kMaxResortMovesPerElement = 4;
+
+struct KeyedIndex {
+  uint64_t key;
+  uint32_t index;
+};
+
+size_t GetNumShards(size_t size) {
+  return std::max<size_t>(1, std::min(GetNumWorkers(), size / kMinShardSize));
+}
+
+size_t GetShardBegin(size_t shard, size_t num_shards, size_t size) {
+  return shard * size / num_shards;
+}
+}  // namespace
+
+uint64_t SortKeyFromInt(int64_t value) {
+  return static_cast<uint64_t>(value) ^ (uint64_t(1) << 63);
+}
+
+uint64_t SortKeyFromDouble(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  // Negative values order the other way around.
+  return (bits >> 63) != 0 ? ~bits : bits | (uint64_t(1) << 63);
+}
+
+std::vector<uint64_t> RankStrings(
+    const std::vector<std::string_view>& strings) {
+  size_t size = strings.size();
+  std::vector<uint32_t> order(size);
+  std::iota(order.begin(), order.end(), 0);
+  auto less = [&strings](uint32_t a, uint32_t b) {
+    return strings[a] < strings[b];
+  };
+
+  // Sorts shards in parallel, then merges them pairwise.
+  size_t num_shards = GetNumShards(size);
+  auto shard_begin = [&](size_t shard) {
+    return order.begin() + GetShardBegin(shard, num_shards, size);
+  };
+  ParallelFor(num_shards, [&](size_t shard) {
+    std::sort(shard_begin(shard), shard_begin(shard + 1), less);
+  });
+  for (size_t width = 1; width < num_shards; width *= 2) {
+    size_t num_merges = (num_shards + 2 * width - 1) / (2 * width);
+    ParallelFor(num_merges, [&](size_t merge) {
+      size_t first = merge * 2 * width;
+      size_t middle = std::min(first + width, num_shards);
+      size_t last = std::min(first + 2 * width, num_shards);
+      std::inplace_merge(shard_begin(first), shard_begin(middle),
+                         shard_begin(last), less);
+    });
+  }
+
+  std::vector<uint64_t> ranks(size);
+  uint64_t rank = 0;
+  for (size_t i = 0; i < size; ++i) {
+    if (i > 0 && strings[order[i]] != strings[order[i - 1]]) {
+      ++rank;
+    }
+    ranks[order[i]] = rank;
+  }
+  return ranks;
+}
+
+void SortByKeys(const std::vector<uint64_t>& keys, bool ascending,
+                std::vector<uint32_t>* indices) {
+  size_t size = indices->size();
+  if (size < 2) {
+    return;
+  }
+
+  // Descending is ascending on the complemented keys, which keeps it stable.
+  std::vector<KeyedIndex> items(size);
+  uint64_t common_ones = ~uint64_t(0);
+  uint64_t any_ones = 0;
+  for (size_t i = 0; i < size; ++i) {
+    uint32_t index = (*indices)[i];
+    uint64_t key = ascending ? keys[index] : ~keys[index];
+    items[i] = {key, index};
+    common_ones &= key;
+    any_ones |= key;
+  }
+  uint64_t varying_bits = common_ones ^ any_ones;
+
+  // Least significant digit first, skipping the digits all keys share. Each
+  // shard counts and scatters its own range, its elements going after those of
+  // the previous shards in each bucket.
+  size_t num_shards = GetNumShards(size);
+  std::vector<std::array<size_t, kNumBuckets>> offsets(num_shards);
+  std::vector<KeyedIndex> buffer(size);
+  for (int shift = 0; shift < 64; shift += kDigitBits) {
+    if (((varying_bits >> shift) & (kNumBuckets - 1)) == 0) {
+      continue;
+    }
+    auto digit = [shift](const KeyedIndex& item) {
+      return (item.key >> shift) & (kNumBuckets - 1);
+    };
+
+    ParallelFor(num_shards, [&](size_t shard) {
+      std::array<size_t, kNumBuckets>& counts = offsets[shard];
+      counts.fill(0);
+      size_t end = GetShardBegin(shard + 1, num_shards, size);
+      for (size_t i = GetShardBegin(shard, num_shards, size); i < end; ++i) {
+        ++counts[digit(items[i])];
+      }
+    });
+    size_t offset = 0;
+    for (size_t bucket = 0; bucket < kNumBuckets; ++bucket) {
+      for (size_t shard = 0; shard < num_shards; ++shard) {
+        size_t count = offsets[shard][bucket];
+        offsets[shard][bucket] = offset;
+        offset += count;
+      }
+    }
+    ParallelFor(num_shards, [&](size_t shard) {
+      std::array<size_t, kNumBuckets>& next = offsets[shard];
+      size_t end = GetShardBegin(shard + 1, num_shards, size);
+      for (size_t i = GetShardBegin(shard, num_shards, size); i < end; ++i) {
+        buffer[next[digit(items[i])]++] = items[i];
+      }
+    });
+    items.swap(buffer);
+  }
+
+  for (size_t i = 0; i < size; ++i) {
+    (*indices)[i] = items[i].index;
+  }
+}
+
+void ResortByKeys(const std::vector<uint64_t>& keys, bool ascending,
+                  std::vector<uint32_t>* indices) {
+  auto before = [&keys, ascending](uint32_t a, uint32_t b) {
+    return ascending ? keys[a] < keys[b] : keys[a] > keys[b];
+  };
+
+  // Insertion sort, which costs the distance the elements move, within a
+  // budget.
+  size_t size = indices->size();
+  size_t budget = kMaxResortMovesPerElement * size;
+  uint32_t* data = indices->data();
+  for (size_t i = 1; i < size; ++i) {
+    uint32_t index = data[i];
+    size_t j = i;
+    for (; j > 0 && before(index, data[j - 1]); --j) {
+      if (budget == 0) {
+        data[j] = index;
+        SortByKeys(keys, ascending, indices);
+        return;
+      }
+      --budget;
+      data[j] = data[j - 1];
+    }
+    data[j] = index;
+  }
+}
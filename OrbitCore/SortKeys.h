@@ -0,0 +1,31 @@
+#ifndef ORBIT_CORE_SORT_KEYS_H_
+#define ORBIT_CORE_SORT_KEYS_H_
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Sorting of the rows of the data views by integer keys: each element gets a
+// uint64_t that orders like the value of the sorted column, computed once per
+// sort or cached for the columns that don't change, rather than compared
+// through the elements on each comparison.
+
+// Keys ordered like the values.
+uint64_t SortKeyFromInt(int64_t value);
+uint64_t SortKeyFromDouble(double value);
+
+// Ranks of strings: keys ordered like the strings, equal for equal strings.
+std::vector<uint64_t> RankStrings(const std::vector<std::string_view>& strings);
+
+// Stably sorts indices by keys[index], with a radix sort, in parallel for
+// large inputs.
+void SortByKeys(const std::vector<uint64_t>& keys, bool ascending,
+                std::vector<uint32_t>* indices);
+
+// Same as SortByKeys, but patches the order in place when indices is still
+// close to sorted, typically sorted by a previous version of the same keys of
+// which only a few changed. Falls back to SortByKeys otherwise.
+void ResortByKeys(const std::vector<uint64_t>& keys, bool ascending,
+                  std::vector<uint32_t>* indices);
+
+#endif  // ORBIT_CORE_SORT_KEYS_H_
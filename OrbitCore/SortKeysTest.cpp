@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "SortKeys.h"
+
+namespace {
+std::vector<uint32_t> Iota(size_t size) {
+  std::vector<uint32_t> indices(size);
+  std::iota(indices.begin(), indices.end(), 0);
+  return indices;
+}
+
+std::vector<uint32_t> StableSorted(const std::vector<uint64_t>& keys,
+                                   bool ascending,
+                                   std::vector<uint32_t> indices) {
+  std::stable_sort(indices.begin(), indices.end(),
+                   [&](uint32_t a, uint32_t b) {
+                     return ascending ? keys[a] < keys[b] : keys[a] > keys[b];
+                   });
+  return indices;
+}
+
+std::vector<uint64_t> RandomKeys(size_t size, uint64_t max_key) {
+  std::mt19937_64 random(size);
+  std::uniform_int_distribution<uint64_t> distribution(0, max_key);
+  std::vector<uint64_t> keys(size);
+  for (uint64_t& key : keys) {
+    key = distribution(random);
+  }
+  return keys;
+}
+}  // namespace
+
+TEST(SortKeys, KeysOrderLikeValues) {
+  EXPECT_LT(SortKeyFromInt(-5), SortKeyFromInt(-1));
+  EXPECT_LT(SortKeyFromInt(-1), SortKeyFromInt(0));
+  EXPECT_LT(SortKeyFromInt(0), SortKeyFromInt(3));
+  EXPECT_LT(SortKeyFromDouble(-2.5), SortKeyFromDouble(-0.5));
+  EXPECT_LT(SortKeyFromDouble(-0.5), SortKeyFromDouble(0.0));
+  EXPECT_LT(SortKeyFromDouble(0.0), SortKeyFromDouble(0.25));
+  EXPECT_LT(SortKeyFromDouble(0.25), SortKeyFromDouble(1e10));
+}
+
+TEST(SortKeys, RanksStrings) {
+  std::vector<std::string_view> strings = {"b", "a", "c", "a", ""};
+  std::vector<uint64_t> ranks = RankStrings(strings);
+  EXPECT_EQ(ranks, std::vector<uint64_t>({2, 1, 3, 1, 0}));
+}
+
+TEST(SortKeys, RanksManyStrings) {
+  std::vector<std::string> strings;
+  for (uint64_t key : RandomKeys(200 * 1000, 50 * 1000)) {
+    strings.push_back(std::to_string(key));
+  }
+  std::vector<std::string_view> views(strings.begin(), strings.end());
+  std::vector<uint64_t> ranks = RankStrings(views);
+  for (size_t i = 1; i < strings.size(); ++i) {
+    EXPECT_EQ(ranks[i - 1] < ranks[i], strings[i - 1] < strings[i]);
+    EXPECT_EQ(ranks[i - 1] == ranks[i], strings[i - 1] == strings[i]);
+  }
+}
+
+TEST(SortKeys, SortsStably) {
+  for (size_t size : {0, 1, 100, 300 * 1000}) {
+    std::vector<uint64_t> keys = RandomKeys(size, size / 4);
+    for (bool ascending : {true, false}) {
+      std::vector<uint32_t> indices = Iota(size);
+      SortByKeys(keys, ascending, &indices);
+      EXPECT_EQ(indices, StableSorted(keys, ascending, Iota(size)));
+    }
+  }
+}
+
+TEST(SortKeys, SortsSubsetOfIndices) {
+  std::vector<uint64_t> keys = {5, ~uint64_t(0), 1, 3, uint64_t(1) << 40};
+  std::vector<uint32_t> indices = {4, 1, 3, 0};
+  SortByKeys(keys, true, &indices);
+  EXPECT_EQ(indices, std::vector<uint32_t>({3, 0, 4, 1}));
+}
+
+TEST(SortKeys, ResortsAfterChanges) {
+  // Distinct keys, as the order of equal keys depends on the previous order.
+  const size_t kSize = 10 * 1000;
+  std::vector<uint64_t> keys = RandomKeys(kSize, uint64_t(1) << 60);
+  std::vector<uint32_t> indices = Iota(kSize);
+  SortByKeys(keys, false, &indices);
+
+  // A few changed keys are patched in.
+  keys[7] = keys[indices[0]] + 1;
+  keys[42] = keys[indices[kSize / 2]] + 1;
+  ResortByKeys(keys, false, &indices);
+  EXPECT_EQ(indices, StableSorted(keys, false, Iota(kSize)));
+
+  // Keys that all changed still get sorted.
+  keys = RandomKeys(kSize + 1, uint64_t(1) << 60);
+  keys.resize(kSize);
+  ResortByKeys(keys, false, &indices);
+  EXPECT_EQ(indices, StableSorted(keys, false, Iota(kSize)));
+}
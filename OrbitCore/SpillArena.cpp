@@ -0,0 +1,171 @@
+#include "SpillArena.h"
+
+#include <OrbitBase/Logging.h>
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#endif
+
+SpillArena::SpillArena(const std::string& directory, size_t budget_bytes)
+    : budget_bytes_(budget_bytes) {
+#ifdef __linux__
+  page_size_ = sysconf(_SC_PAGESIZE);
+  std::string path = directory + "/orbit-spill-XXXXXX";
+  fd_ = mkstemp(&path[0]);
+  if (fd_ < 0) {
+    ERROR("Could not create spill file in %s, blocks stay on the heap",
+          directory.c_str());
+    return;
+  }
+  // Only the mapping keeps the file, which goes away with the arena.
+  unlink(path.c_str());
+#else
+  (void)directory;
+#endif
+}
+
+SpillArena::~SpillArena() {
+#ifdef __linux__
+  absl::MutexLock lock(&mutex_);
+  for (const Segment& segment : segments_) {
+    munmap(segment.data, std::max(segment.used, kSegmentSize));
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+#endif
+}
+
+size_t SpillArena::RoundToPages(size_t size) const {
+  return (size + page_size_ - 1) / page_size_ * page_size_;
+}
+
+void* SpillArena::Allocate(size_t size) {
+  if (!IsFileBacked()) {
+    return ::operator new(size);
+  }
+
+  size = RoundToPages(size);
+  absl::MutexLock lock(&mutex_);
+  void* block = nullptr;
+  std::vector<void*>& free_blocks = free_blocks_[size];
+  if (!free_blocks.empty()) {
+    block = free_blocks.back();
+    free_blocks.pop_back();
+  } else {
+    block = AllocateInFile(size);
+    if (block == nullptr) {
+      return ::operator new(size);
+    }
+  }
+  block_states_[block] = BlockState::kWriting;
+  num_resident_bytes_ += size;
+  return block;
+}
+
+void* SpillArena::AllocateInFile(size_t size) {
+#ifdef __linux__
+  if (segments_.empty() || kSegmentSize - segments_.back().used < size) {
+    // Blocks larger than a segment get a segment of their own.
+    size_t segment_size = std::max(size, kSegmentSize);
+    off_t offset = 0;
+    for (const Segment& segment : segments_) {
+      offset += std::max(segment.used, kSegmentSize);
+    }
+    if (ftruncate(fd_, offset + segment_size) != 0) {
+      ERROR("Could not grow spill file");
+      return nullptr;
+    }
+    void* data = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd_, offset);
+    if (data == MAP_FAILED) {
+      ERROR("Could not map spill file");
+      return nullptr;
+    }
+    segments_.push_back({static_cast<char*>(data), 0});
+  }
+
+  Segment& segment = segments_.back();
+  void* block = segment.data + segment.used;
+  segment.used += size;
+  return block;
+#else
+  (void)size;
+  return nullptr;
+#endif
+}
+
+void SpillArena::Free(void* block, size_t size) {
+  absl::MutexLock lock(&mutex_);
+  auto it = block_states_.find(block);
+  if (it == block_states_.end()) {
+    // On the heap, because the arena has no file or the file got full.
+    ::operator delete(block);
+    return;
+  }
+
+  size = RoundToPages(size);
+  if (it->second == BlockState::kSpilled) {
+    num_spilled_bytes_ -= size;
+  } else {
+    num_resident_bytes_ -= size;
+  }
+  block_states_.erase(it);
+#ifdef __linux__
+  madvise(block, size, MADV_DONTNEED);
+#endif
+  free_blocks_[size].push_back(block);
+}
+
+void SpillArena::OnBlockFull(void* block, size_t size) {
+  absl::MutexLock lock(&mutex_);
+  auto it = block_states_.find(block);
+  if (it == block_states_.end()) {
+    return;
+  }
+
+  size = RoundToPages(size);
+  if (it->second == BlockState::kSpilled) {
+    // Written again after having been spilled, e.g. by BlockChain::Reset.
+    num_spilled_bytes_ -= size;
+    num_resident_bytes_ += size;
+  }
+  it->second = BlockState::kFull;
+  full_blocks_.emplace_back(block, size);
+  SpillOverBudget();
+}
+
+void SpillArena::SpillOverBudget() {
+  while (num_resident_bytes_ > budget_bytes_ && !full_blocks_.empty()) {
+    auto [block, size] = full_blocks_.front();
+    full_blocks_.pop_front();
+    auto it = block_states_.find(block);
+    if (it == block_states_.end() || it->second != BlockState::kFull) {
+      continue;
+    }
+
+#ifdef __linux__
+    // Written back first, so that dropping the pages loses nothing.
+    msync(block, size, MS_ASYNC);
+    madvise(block, size, MADV_DONTNEED);
+#endif
+    it->second = BlockState::kSpilled;
+    num_resident_bytes_ -= size;
+    num_spilled_bytes_ += size;
+  }
+}
+
+size_t SpillArena::GetNumResidentBytes() const {
+  absl::MutexLock lock(&mutex_);
+  return num_resident_bytes_;
+}
+
+size_t SpillArena::GetNumSpilledBytes() const {
+  absl::MutexLock lock(&mutex_);
+  return num_spilled_bytes_;
+}
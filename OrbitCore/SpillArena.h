@@ -0,0 +1,70 @@
+#ifndef ORBIT_CORE_SPILL_ARENA_H_
+#define ORBIT_CORE_SPILL_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BlockChain.h"
+#include "absl/synchronization/mutex.h"
+
+// Blocks allocated in a file mapped in memory, so that the full blocks beyond
+// a budget of resident bytes are dropped from memory, oldest first, and read
+// back by the kernel when accessed again, at the same address. This bounds the
+// memory of a capture by the budget rather than by its length, without the
+// readers of the blocks knowing. The file is deleted as soon as it is created.
+// Without such files (other than Linux, or if creating the file failed),
+// blocks are on the heap and are never spilled.
+class SpillArena : public BlockAllocator {
+ public:
+  // Size of the parts of the file mapped at once.
+  static constexpr size_t kSegmentSize = 64 * 1024 * 1024;
+
+  // Creates the file in directory.
+  SpillArena(const std::string& directory, size_t budget_bytes);
+  ~SpillArena() override;
+  SpillArena(const SpillArena&) = delete;
+  SpillArena& operator=(const SpillArena&) = delete;
+
+  void* Allocate(size_t size) override;
+  void Free(void* block, size_t size) override;
+  void OnBlockFull(void* block, size_t size) override;
+
+  bool IsFileBacked() const { return fd_ >= 0; }
+  // Of the blocks allocated, not counting those spilled.
+  size_t GetNumResidentBytes() const;
+  size_t GetNumSpilledBytes() const;
+
+ private:
+  struct Segment {
+    char* data;
+    size_t used;
+  };
+
+  enum class BlockState { kWriting, kFull, kSpilled };
+
+  size_t RoundToPages(size_t size) const;
+  void* AllocateInFile(size_t size) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void SpillOverBudget() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const size_t budget_bytes_;
+  size_t page_size_ = 4096;
+  int fd_ = -1;
+
+  mutable absl::Mutex mutex_;
+  std::vector<Segment> segments_ ABSL_GUARDED_BY(mutex_);
+  // Freed blocks, by size, for the next allocations.
+  std::unordered_map<size_t, std::vector<void*>> free_blocks_
+      ABSL_GUARDED_BY(mutex_);
+  std::unordered_map<void*, BlockState> block_states_ ABSL_GUARDED_BY(mutex_);
+  // Full blocks still in memory, oldest first. May hold blocks freed or
+  // spilled since, skipped when found.
+  std::deque<std::pair<void*, size_t>> full_blocks_ ABSL_GUARDED_BY(mutex_);
+  size_t num_resident_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  size_t num_spilled_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+#endif  // ORBIT_CORE_SPILL_ARENA_H_
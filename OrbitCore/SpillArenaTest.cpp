@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "BlockChain.h"
+#include "SpillArena.h"
+
+namespace {
+constexpr size_t kBlockSize = 3 * 4096;
+}  // namespace
+
+TEST(SpillArena, SpillsOldestFullBlocksOverBudget) {
+  SpillArena arena(testing::TempDir(), /*budget_bytes=*/2 * kBlockSize);
+  if (!arena.IsFileBacked()) {
+    GTEST_SKIP() << "No spill file on this platform";
+  }
+
+  std::vector<char*> blocks;
+  for (int i = 0; i < 4; ++i) {
+    char* block = static_cast<char*>(arena.Allocate(kBlockSize));
+    memset(block, 'a' + i, kBlockSize);
+    arena.OnBlockFull(block, kBlockSize);
+    blocks.push_back(block);
+  }
+  EXPECT_EQ(arena.GetNumResidentBytes(), 2 * kBlockSize);
+  EXPECT_EQ(arena.GetNumSpilledBytes(), 2 * kBlockSize);
+
+  // Spilled blocks read back the same.
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(blocks[i][0], 'a' + i);
+    EXPECT_EQ(blocks[i][kBlockSize - 1], 'a' + i);
+  }
+
+  for (char* block : blocks) {
+    arena.Free(block, kBlockSize);
+  }
+  EXPECT_EQ(arena.GetNumResidentBytes(), 0);
+  EXPECT_EQ(arena.GetNumSpilledBytes(), 0);
+
+  // Freed blocks are reused.
+  void* block = arena.Allocate(kBlockSize);
+  EXPECT_NE(std::find(blocks.begin(), blocks.end(), block), blocks.end());
+  arena.Free(block, kBlockSize);
+}
+
+TEST(SpillArena, HoldsTheBlocksOfChains) {
+  auto arena = std::make_shared<SpillArena>(testing::TempDir(),
+                                            /*budget_bytes=*/0);
+  const uint32_t kNumItems = 10 * 1000;
+  {
+    BlockChain<uint64_t, 1024> chain(arena);
+    for (uint64_t i = 0; i < kNumItems; ++i) {
+      chain.push_back(i);
+    }
+    if (arena->IsFileBacked()) {
+      EXPECT_GT(arena->GetNumSpilledBytes(), 0);
+    }
+
+    uint64_t expected = 0;
+    for (uint64_t item : chain) {
+      EXPECT_EQ(item, expected++);
+    }
+    EXPECT_EQ(expected, kNumItems);
+  }
+  EXPECT_EQ(arena->GetNumResidentBytes(), 0);
+  EXPECT_EQ(arena->GetNumSpilledBytes(), 0);
+}
@@ -0,0 +1,56 @@
+#ifndef ORBIT_CORE_SPSC_QUEUE_H_
+#define ORBIT_CORE_SPSC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free queue with a single producer thread and a single consumer
+// thread. The slots are allocated upfront, so pushing never allocates.
+template <typename T>
+class SpscQueue {
+ public:
+  explicit SpscQueue(size_t capacity)
+      : slots_(std::make_unique<T[]>(capacity)), capacity_(capacity) {}
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  // Only called by the producer. Returns false if the queue is full, in which
+  // case value is left untouched.
+  bool TryPush(T&& value) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == capacity_) {
+      return false;
+    }
+    slots_[tail % capacity_] = std::move(value);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Only called by the consumer. Moves all the elements pushed so far to the
+  // end of buffer and returns how many there were.
+  size_t PopAll(std::vector<T>* buffer) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    for (size_t i = head; i != tail; ++i) {
+      buffer->push_back(std::move(slots_[i % capacity_]));
+    }
+    head_.store(tail, std::memory_order_release);
+    return tail - head;
+  }
+
+  size_t GetCapacity() const { return capacity_; }
+
+ private:
+  std::unique_ptr<T[]> slots_;
+  size_t capacity_;
+  // Written by the consumer only. On its own cache line so that the producer
+  // and consumer don't invalidate each other's.
+  alignas(64) std::atomic<size_t> head_ = 0;
+  // Written by the producer only.
+  alignas(64) std::atomic<size_t> tail_ = 0;
+};
+
+#endif  // ORBIT_CORE_SPSC_QUEUE_H_
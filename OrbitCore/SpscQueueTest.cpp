@@ -0,0 +1,70 @@
+#include <gmock/gmock-matchers.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "SpscQueue.h"
+
+TEST(SpscQueue, PushAndPopAll) {
+  SpscQueue<std::string> queue(4);
+  std::vector<std::string> buffer;
+  EXPECT_EQ(queue.PopAll(&buffer), 0);
+
+  EXPECT_TRUE(queue.TryPush("a"));
+  EXPECT_TRUE(queue.TryPush("b"));
+  EXPECT_EQ(queue.PopAll(&buffer), 2);
+  EXPECT_THAT(buffer, testing::ElementsAre("a", "b"));
+
+  // Elements are appended to the buffer.
+  EXPECT_TRUE(queue.TryPush("c"));
+  EXPECT_EQ(queue.PopAll(&buffer), 1);
+  EXPECT_THAT(buffer, testing::ElementsAre("a", "b", "c"));
+}
+
+TEST(SpscQueue, TryPushFailsWhenFull) {
+  SpscQueue<std::string> queue(2);
+  EXPECT_TRUE(queue.TryPush("a"));
+  EXPECT_TRUE(queue.TryPush("b"));
+
+  std::string value = "c";
+  EXPECT_FALSE(queue.TryPush(std::move(value)));
+  EXPECT_EQ(value, "c");
+
+  std::vector<std::string> buffer;
+  EXPECT_EQ(queue.PopAll(&buffer), 2);
+
+  // The slots are reused after wrapping around.
+  EXPECT_TRUE(queue.TryPush(std::move(value)));
+  EXPECT_TRUE(queue.TryPush("d"));
+  EXPECT_FALSE(queue.TryPush("e"));
+  buffer.clear();
+  EXPECT_EQ(queue.PopAll(&buffer), 2);
+  EXPECT_THAT(buffer, testing::ElementsAre("c", "d"));
+}
+
+TEST(SpscQueue, ConcurrentProducerAndConsumer) {
+  constexpr int kNumValues = 100000;
+  SpscQueue<int> queue(64);
+
+  std::thread producer([&queue] {
+    for (int i = 0; i < kNumValues; ++i) {
+      int value = i;
+      while (!queue.TryPush(std::move(value))) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  std::vector<int> buffer;
+  while (buffer.size() < kNumValues) {
+    queue.PopAll(&buffer);
+  }
+  producer.join();
+
+  for (int i = 0; i < kNumValues; ++i) {
+    ASSERT_EQ(buffer[i], i);
+  }
+}
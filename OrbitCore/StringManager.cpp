@@ -1,26 +1,86 @@
 #include "StringManager.h"
 
-StringManager::StringManager() {}
+namespace {
+constexpr size_t kInitialCapacity = 256;
+
+// Spreads keys that are small or share their low bits over the table.
+size_t GetSlotIndex(uint64_t key, size_t mask) {
+  return ((key * 0x9e3779b97f4a7c15) >> 32) & mask;
+}
+}  // namespace
+
+StringManager::StringManager() {
+  tables_.push_back(std::make_unique<Table>(kInitialCapacity));
+  memory_account_.Add(sizeof(Table) + kInitialCapacity * sizeof(Slot));
+  table_ = tables_.back().get();
+}
+
 StringManager::~StringManager() {}
 
-void StringManager::Add(uint64_t key, const std::string_view str) {
+bool StringManager::Add(uint64_t key, const std::string_view str) {
+  // Most strings are added over and over again: don't lock for those.
+  if (Find(key) != nullptr) {
+    return false;
+  }
+
   std::lock_guard<std::mutex> lock(mutex_);
-  if (key_to_string_.count(key) == 0) {
-    key_to_string_.emplace(key, str);
+  if (Find(key) != nullptr) {
+    return false;
+  }
+  Table* table = tables_.back().get();
+  // Keep the table at most half full, for short probe sequences.
+  if (2 * (strings_.size() + 1) > table->mask + 1) {
+    auto new_table = std::make_unique<Table>(2 * (table->mask + 1));
+    for (size_t i = 0; i <= table->mask; ++i) {
+      const Slot& slot = table->slots[i];
+      const std::string* slot_str = slot.str.load(std::memory_order_relaxed);
+      if (slot_str != nullptr) {
+        Insert(new_table.get(), slot.key.load(std::memory_order_relaxed),
+               slot_str);
+      }
+    }
+    memory_account_.Add(sizeof(Table) + (new_table->mask + 1) * sizeof(Slot));
+    table = new_table.get();
+    tables_.push_back(std::move(new_table));
+    table_.store(table, std::memory_order_release);
   }
+  strings_.emplace_back(str);
+  memory_account_.Add(sizeof(std::string) + str.size());
+  Insert(table, key, &strings_.back());
+  return true;
 }
 
-std::optional<std::string> StringManager::Get(uint64_t key) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  auto it = key_to_string_.find(key);
-  if (it != key_to_string_.end()) {
-    return it->second;
+std::optional<std::string> StringManager::Get(uint64_t key) const {
+  const std::string* str = Find(key);
+  if (str != nullptr) {
+    return *str;
   } else {
     return std::optional<std::string>{};
   }
 }
 
-bool StringManager::Exists(uint64_t key) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  return key_to_string_.count(key) > 0;
+bool StringManager::Exists(uint64_t key) const { return Find(key) != nullptr; }
+
+const std::string* StringManager::Find(uint64_t key) const {
+  const Table* table = table_.load(std::memory_order_acquire);
+  for (size_t i = GetSlotIndex(key, table->mask);; i = (i + 1) & table->mask) {
+    const Slot& slot = table->slots[i];
+    const std::string* str = slot.str.load(std::memory_order_acquire);
+    if (str == nullptr) {
+      return nullptr;
+    }
+    if (slot.key.load(std::memory_order_relaxed) == key) {
+      return str;
+    }
+  }
+}
+
+void StringManager::Insert(Table* table, uint64_t key, const std::string* str) {
+  size_t i = GetSlotIndex(key, table->mask);
+  while (table->slots[i].str.load(std::memory_order_relaxed) != nullptr) {
+    i = (i + 1) & table->mask;
+  }
+  table->slots[i].key.store(key, std::memory_order_relaxed);
+  // Publishes the key and the string to Find.
+  table->slots[i].str.store(str, std::memory_order_release);
 }
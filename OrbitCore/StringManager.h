@@ -1,22 +1,54 @@
 #ifndef ORBIT_CORE_STRING_MANAGER_H_
 #define ORBIT_CORE_STRING_MANAGER_H_
 
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
-#include "absl/container/flat_hash_map.h"
+#include <string_view>
+#include <vector>
 
+#include "MemoryAccounting.h"
+
+// Strings by key, e.g. the names of scopes and GPU timelines by hash. Reads,
+// which happen for each timer drawn, are lock-free: strings are stored in an
+// open-addressing table of atomic slots, and only writers take a lock. When
+// the table grows, the previous ones are kept alive for the readers still
+// using them, which costs at most as much memory as the current table.
 class StringManager {
  public:
   StringManager();
   ~StringManager();
 
-  void Add(uint64_t key, const std::string_view str);
-  std::optional<std::string> Get(uint64_t key);
-  bool Exists(uint64_t key);
-private:
-  absl::flat_hash_map<uint64_t, std::string> key_to_string_;
+  // Returns false, and keeps the previous string, if key already exists.
+  bool Add(uint64_t key, std::string_view str);
+  std::optional<std::string> Get(uint64_t key) const;
+  bool Exists(uint64_t key) const;
+
+ private:
+  // A slot is used once str is set. key is written before str.
+  struct Slot {
+    std::atomic<uint64_t> key;
+    std::atomic<const std::string*> str;
+  };
+  struct Table {
+    explicit Table(size_t capacity)
+        : mask(capacity - 1), slots(new Slot[capacity]()) {}
+    size_t mask;
+    std::unique_ptr<Slot[]> slots;
+  };
+
+  const std::string* Find(uint64_t key) const;
+  static void Insert(Table* table, uint64_t key, const std::string* str);
+
+  std::atomic<Table*> table_;
   std::mutex mutex_;
+  // The last table is the current one.
+  std::vector<std::unique_ptr<Table>> tables_;
+  std::deque<std::string> strings_;
+  MemoryAccount memory_account_{MemorySubsystem::kStringManager};
 };
 
 #endif
@@ -2,6 +2,11 @@
 
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
 TEST(StringManager, Exists) {
   StringManager string_manager;
   string_manager.Add(0, "test1");
@@ -23,3 +28,52 @@ TEST(StringManager, Get) {
   EXPECT_EQ("test1", string_manager.Get(0).value_or(""));
   EXPECT_FALSE(string_manager.Get(1).has_value());
 }
+
+TEST(StringManager, AddReturnsWhetherKeyIsNew) {
+  StringManager string_manager;
+  EXPECT_TRUE(string_manager.Add(0, "test1"));
+  EXPECT_FALSE(string_manager.Add(0, "test2"));
+  EXPECT_TRUE(string_manager.Add(1, "test2"));
+}
+
+TEST(StringManager, Grows) {
+  StringManager string_manager;
+  for (uint64_t key = 0; key < 10000; ++key) {
+    EXPECT_TRUE(string_manager.Add(key << 32, std::to_string(key)));
+  }
+  for (uint64_t key = 0; key < 10000; ++key) {
+    EXPECT_EQ(string_manager.Get(key << 32).value_or(""), std::to_string(key));
+  }
+  EXPECT_FALSE(string_manager.Exists(10000ull << 32));
+}
+
+TEST(StringManager, ReadsWhileAdding) {
+  constexpr uint64_t kNumKeys = 10000;
+  StringManager string_manager;
+  std::atomic<uint64_t> num_added = 0;
+  std::thread writer([&] {
+    for (uint64_t key = 0; key < kNumKeys; ++key) {
+      string_manager.Add(key, std::to_string(key));
+      num_added.store(key + 1, std::memory_order_release);
+    }
+  });
+
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back([&] {
+      uint64_t added;
+      do {
+        added = num_added.load(std::memory_order_acquire);
+        for (uint64_t key = 0; key < added; key += 97) {
+          EXPECT_EQ(string_manager.Get(key).value_or(""),
+                    std::to_string(key));
+        }
+      } while (added < kNumKeys);
+    });
+  }
+
+  writer.join();
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+}
@@ -0,0 +1,33 @@
+#include "SymbolCache.h"
+
+#include <utility>
+
+SymbolCache& SymbolCache::Get() {
+  static SymbolCache instance;
+  return instance;
+}
+
+std::optional<SymbolCache::Entry> SymbolCache::Find(
+    const std::string& build_id, uint64_t offset) const {
+  absl::ReaderMutexLock lock(&mutex_);
+  auto module_it = modules_.find(build_id);
+  if (module_it == modules_.end()) {
+    return std::nullopt;
+  }
+  auto entry_it = module_it->second.find(offset);
+  if (entry_it == module_it->second.end()) {
+    return std::nullopt;
+  }
+  return entry_it->second;
+}
+
+void SymbolCache::Add(const std::string& build_id, uint64_t offset,
+                      Entry entry) {
+  absl::MutexLock lock(&mutex_);
+  modules_[build_id].insert_or_assign(offset, std::move(entry));
+}
+
+void SymbolCache::Clear() {
+  absl::MutexLock lock(&mutex_);
+  modules_.clear();
+}
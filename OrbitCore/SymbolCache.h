@@ -0,0 +1,35 @@
+#ifndef ORBIT_CORE_SYMBOL_CACHE_H_
+#define ORBIT_CORE_SYMBOL_CACHE_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
+// Functions of the sampled addresses of each module, by build id, kept for
+// the whole session: the addresses of a binary captured again don't need to
+// be resolved again. Addresses are offsets from the start of the module, so
+// that they don't depend on where it is loaded.
+class SymbolCache {
+ public:
+  struct Entry {
+    uint64_t function_offset;
+    std::string function_name;
+  };
+
+  static SymbolCache& Get();
+
+  std::optional<Entry> Find(const std::string& build_id,
+                            uint64_t offset) const;
+  void Add(const std::string& build_id, uint64_t offset, Entry entry);
+  void Clear();
+
+ private:
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, absl::flat_hash_map<uint64_t, Entry>>
+      modules_ ABSL_GUARDED_BY(mutex_);
+};
+
+#endif  // ORBIT_CORE_SYMBOL_CACHE_H_
@@ -0,0 +1,204 @@
+#include "SymbolCacheFile.h"
+
+#include <OrbitBase/Logging.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#include "OrbitFunction.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// Appends value to strings, returning its offset.
+uint32_t AddString(std::string* strings, std::string_view value) {
+  uint32_t offset = static_cast<uint32_t>(strings->size());
+  strings->append(value.data(), value.size());
+  return offset;
+}
+}  // namespace
+
+bool SymbolCacheFile::Write(const std::string& path, const std::string& key,
+                            uint64_t load_bias,
+                            const std::vector<Function>& functions) {
+  std::string data = Encode(key, load_bias, functions);
+  if (data.empty()) {
+    ERROR("Too many symbols to cache in %s", path.c_str());
+    return false;
+  }
+  return WriteData(path, data);
+}
+
+std::string SymbolCacheFile::Encode(const std::string& key,
+                                    uint64_t load_bias,
+                                    const std::vector<Function>& functions) {
+  std::string strings;
+  AddString(&strings, key);
+  std::vector<SymbolCacheFileFunction> records;
+  records.reserve(functions.size());
+  for (const Function& function : functions) {
+    SymbolCacheFileFunction record;
+    record.address = function.Address();
+    record.size = function.Size();
+    record.name_offset = AddString(&strings, function.Name());
+    record.name_size = static_cast<uint32_t>(function.Name().size());
+    if (function.PrettyName() == function.Name()) {
+      record.pretty_name_offset = record.name_offset;
+    } else {
+      record.pretty_name_offset = AddString(&strings, function.PrettyName());
+    }
+    record.pretty_name_size =
+        static_cast<uint32_t>(function.PrettyName().size());
+    records.push_back(record);
+    if (strings.size() > std::numeric_limits<uint32_t>::max()) {
+      return "";
+    }
+  }
+
+  SymbolCacheFileHeader header = {};
+  header.magic = SymbolCacheFileHeader::kMagic;
+  header.version = SymbolCacheFileHeader::kVersion;
+  header.num_functions = records.size();
+  header.strings_size = strings.size();
+  header.key_size = static_cast<uint32_t>(key.size());
+  header.load_bias = load_bias;
+
+  std::string data;
+  data.reserve(sizeof(header) +
+               records.size() * sizeof(SymbolCacheFileFunction) +
+               strings.size());
+  data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  data.append(reinterpret_cast<const char*>(records.data()),
+              records.size() * sizeof(SymbolCacheFileFunction));
+  data.append(strings);
+  return data;
+}
+
+bool SymbolCacheFile::WriteData(const std::string& path,
+                                std::string_view data) {
+  std::string temp_path = path + ".tmp";
+  {
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), data.size());
+    if (!file) {
+      ERROR("Could not write symbol cache %s", temp_path.c_str());
+      file.close();
+      std::remove(temp_path.c_str());
+      return false;
+    }
+  }
+  if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+    ERROR("Could not write symbol cache %s", path.c_str());
+    std::remove(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool SymbolCacheFile::IsValid(std::string_view data, const std::string& key) {
+  const size_t size = data.size();
+  if (size < sizeof(SymbolCacheFileHeader)) return false;
+  SymbolCacheFileHeader header;
+  memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != SymbolCacheFileHeader::kMagic ||
+      header.version != SymbolCacheFileHeader::kVersion) {
+    return false;
+  }
+  uint64_t max_functions = (size - sizeof(SymbolCacheFileHeader)) /
+                           sizeof(SymbolCacheFileFunction);
+  if (header.num_functions > max_functions ||
+      header.strings_size !=
+          size - sizeof(SymbolCacheFileHeader) -
+              header.num_functions * sizeof(SymbolCacheFileFunction)) {
+    return false;
+  }
+
+  const char* functions = data.data() + sizeof(SymbolCacheFileHeader);
+  const char* strings =
+      functions + header.num_functions * sizeof(SymbolCacheFileFunction);
+  if (header.key_size != key.size() || key.size() > header.strings_size ||
+      memcmp(strings, key.data(), key.size()) != 0) {
+    return false;
+  }
+  for (uint64_t i = 0; i < header.num_functions; ++i) {
+    // Received data might not be aligned for the records.
+    SymbolCacheFileFunction function;
+    memcpy(&function, functions + i * sizeof(function), sizeof(function));
+    if (uint64_t{function.name_offset} + function.name_size >
+            header.strings_size ||
+        uint64_t{function.pretty_name_offset} + function.pretty_name_size >
+            header.strings_size) {
+      return false;
+    }
+  }
+  return true;
+}
+
+SymbolCacheFile::Symbol SymbolCacheFile::GetFunction(size_t index) const {
+  const SymbolCacheFileFunction& record = functions_[index];
+  Symbol symbol;
+  symbol.name =
+      std::string_view(strings_ + record.name_offset, record.name_size);
+  symbol.pretty_name = std::string_view(strings_ + record.pretty_name_offset,
+                                        record.pretty_name_size);
+  symbol.address = record.address;
+  symbol.size = record.size;
+  return symbol;
+}
+
+SymbolCacheFile::SymbolCacheFile(void* mapping, size_t mapping_size)
+    : mapping_(mapping), mapping_size_(mapping_size) {
+  const auto* header = static_cast<const SymbolCacheFileHeader*>(mapping);
+  functions_ = reinterpret_cast<const SymbolCacheFileFunction*>(header + 1);
+  load_bias_ = header->load_bias;
+  num_functions_ = header->num_functions;
+  strings_ = reinterpret_cast<const char*>(functions_ + num_functions_);
+}
+
+#ifdef __linux__
+
+std::unique_ptr<SymbolCacheFile> SymbolCacheFile::Open(
+    const std::string& path, const std::string& key) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat file_stat;
+  void* mapping = MAP_FAILED;
+  if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+    mapping = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return nullptr;
+  }
+
+  size_t mapping_size = file_stat.st_size;
+  std::string_view data(static_cast<const char*>(mapping), mapping_size);
+  if (!IsValid(data, key)) {
+    munmap(mapping, mapping_size);
+    return nullptr;
+  }
+  return std::unique_ptr<SymbolCacheFile>(
+      new SymbolCacheFile(mapping, mapping_size));
+}
+
+SymbolCacheFile::~SymbolCacheFile() { munmap(mapping_, mapping_size_); }
+
+#else
+
+std::unique_ptr<SymbolCacheFile> SymbolCacheFile::Open(const std::string&,
+                                                       const std::string&) {
+  return nullptr;
+}
+
+SymbolCacheFile::~SymbolCacheFile() {}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef ORBIT_CORE_SYMBOL_CACHE_FILE_H_
+#define ORBIT_CORE_SYMBOL_CACHE_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Function;
+
+// Functions of a module saved to disk under a key identifying its build, the
+// build id of an ELF file, so that loading the same build again needs neither
+// reading its symbol table nor demangling, nor receiving them again from the
+// service for the modules of a remote process. The file is used in place once
+// mapped: a SymbolCacheFileHeader, an array of SymbolCacheFileFunction in the
+// order the functions were loaded, then the strings they point into. The key
+// is the first string. The same bytes are what the service sends for the
+// functions of a module, which the client then writes to its own cache as is.
+struct SymbolCacheFileHeader {
+  static constexpr uint32_t kMagic = 0x4d59534f;
+  static constexpr uint32_t kVersion = 2;
+  uint32_t magic;
+  uint32_t version;
+  uint64_t num_functions;
+  uint64_t strings_size;
+  uint32_t key_size;
+  uint32_t reserved;
+  uint64_t load_bias;
+};
+
+struct SymbolCacheFileFunction {
+  uint64_t address;
+  uint64_t size;
+  // Offsets in the strings. A pretty name equal to the name is not repeated.
+  uint32_t name_offset;
+  uint32_t name_size;
+  uint32_t pretty_name_offset;
+  uint32_t pretty_name_size;
+};
+
+// Only implemented on Linux: elsewhere, Open returns nullptr.
+class SymbolCacheFile {
+ public:
+  struct Symbol {
+    std::string_view name;
+    std::string_view pretty_name;
+    uint64_t address;
+    uint64_t size;
+  };
+
+  // Writes functions under key to path. The file is written next to path
+  // then renamed, so that a reader never sees it half written.
+  static bool Write(const std::string& path, const std::string& key,
+                    uint64_t load_bias, const std::vector<Function>& functions);
+  // The contents of the file Write writes, empty if the functions can't be
+  // cached.
+  static std::string Encode(const std::string& key, uint64_t load_bias,
+                            const std::vector<Function>& functions);
+  // Writes data, as returned by Encode, to path the way Write does.
+  static bool WriteData(const std::string& path, std::string_view data);
+  // Whether data is a whole cache of this version for key, with all its
+  // strings inside it.
+  static bool IsValid(std::string_view data, const std::string& key);
+  // Maps the file at path. Returns nullptr if there is none, or if it is not
+  // a cache of this version for key.
+  static std::unique_ptr<SymbolCacheFile> Open(const std::string& path,
+                                               const std::string& key);
+
+  ~SymbolCacheFile();
+  SymbolCacheFile(const SymbolCacheFile&) = delete;
+  SymbolCacheFile& operator=(const SymbolCacheFile&) = delete;
+
+  uint64_t GetLoadBias() const { return load_bias_; }
+  size_t GetNumFunctions() const { return num_functions_; }
+  // The names point into the mapping, valid as long as this is.
+  Symbol GetFunction(size_t index) const;
+
+ private:
+  SymbolCacheFile(void* mapping, size_t mapping_size);
+
+  void* mapping_;
+  size_t mapping_size_;
+  uint64_t load_bias_;
+  const SymbolCacheFileFunction* functions_;
+  size_t num_functions_;
+  const char* strings_;
+};
+
+#endif  // ORBIT_CORE_SYMBOL_CACHE_FILE_H_
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "OrbitFunction.h"
+#include "Pdb.h"
+#include "SymbolCacheFile.h"
+
+#ifdef __linux__
+
+namespace {
+std::string GetTestPath(const std::string& name) {
+  return testing::TempDir() + "SymbolCacheFileTest_" + name + ".sym";
+}
+
+std::vector<Function> MakeFunctions(Pdb* pdb) {
+  std::vector<Function> functions;
+  functions.emplace_back("main", "main", "hello", 0x1135, 35, 0, pdb);
+  functions.emplace_back("_ZN3foo3barEv", "foo::bar()", "hello", 0x1100, 16,
+                         0, pdb);
+  return functions;
+}
+}  // namespace
+
+TEST(SymbolCacheFile, OpenSeesWrittenFunctions) {
+  Pdb pdb;
+  std::string path = GetTestPath("Written");
+  ASSERT_TRUE(SymbolCacheFile::Write(path, "build-id", 0x1000,
+                                     MakeFunctions(&pdb)));
+
+  std::unique_ptr<SymbolCacheFile> cache =
+      SymbolCacheFile::Open(path, "build-id");
+  ASSERT_NE(cache, nullptr);
+  EXPECT_EQ(cache->GetLoadBias(), 0x1000);
+  ASSERT_EQ(cache->GetNumFunctions(), 2);
+  SymbolCacheFile::Symbol symbol = cache->GetFunction(0);
+  EXPECT_EQ(symbol.name, "main");
+  EXPECT_EQ(symbol.pretty_name, "main");
+  EXPECT_EQ(symbol.address, 0x1135);
+  EXPECT_EQ(symbol.size, 35);
+  symbol = cache->GetFunction(1);
+  EXPECT_EQ(symbol.name, "_ZN3foo3barEv");
+  EXPECT_EQ(symbol.pretty_name, "foo::bar()");
+  EXPECT_EQ(symbol.address, 0x1100);
+  EXPECT_EQ(symbol.size, 16);
+  std::remove(path.c_str());
+}
+
+TEST(SymbolCacheFile, OpenRejectsOtherKey) {
+  Pdb pdb;
+  std::string path = GetTestPath("OtherKey");
+  ASSERT_TRUE(SymbolCacheFile::Write(path, "build-id", 0x1000,
+                                     MakeFunctions(&pdb)));
+  EXPECT_EQ(SymbolCacheFile::Open(path, "other-build-id"), nullptr);
+  std::remove(path.c_str());
+}
+
+TEST(SymbolCacheFile, OpenRejectsMissingAndTruncatedFiles) {
+  Pdb pdb;
+  std::string path = GetTestPath("Truncated");
+  EXPECT_EQ(SymbolCacheFile::Open(path, "build-id"), nullptr);
+
+  ASSERT_TRUE(SymbolCacheFile::Write(path, "build-id", 0x1000,
+                                     MakeFunctions(&pdb)));
+  std::string contents;
+  {
+    std::ifstream file(path, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(file),
+                    std::istreambuf_iterator<char>());
+  }
+  {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(contents.data(), contents.size() - 1);
+  }
+  EXPECT_EQ(SymbolCacheFile::Open(path, "build-id"), nullptr);
+  std::remove(path.c_str());
+}
+
+TEST(SymbolCacheFile, EncodedDataIsValidAndWritable) {
+  Pdb pdb;
+  std::string data =
+      SymbolCacheFile::Encode("build-id", 0x1000, MakeFunctions(&pdb));
+  EXPECT_TRUE(SymbolCacheFile::IsValid(data, "build-id"));
+  EXPECT_FALSE(SymbolCacheFile::IsValid(data, "other-build-id"));
+  EXPECT_FALSE(SymbolCacheFile::IsValid(
+      std::string_view(data).substr(0, data.size() - 1), "build-id"));
+
+  std::string path = GetTestPath("Encoded");
+  ASSERT_TRUE(SymbolCacheFile::WriteData(path, data));
+  std::unique_ptr<SymbolCacheFile> cache =
+      SymbolCacheFile::Open(path, "build-id");
+  ASSERT_NE(cache, nullptr);
+  ASSERT_EQ(cache->GetNumFunctions(), 2);
+  EXPECT_EQ(cache->GetFunction(1).pretty_name, "foo::bar()");
+  std::remove(path.c_str());
+}
+
+#endif
@@ -0,0 +1,36 @@
+#include "SymbolCache.h"
+
+#include <gtest/gtest.h>
+
+#include <optional>
+
+TEST(SymbolCache, FindsAddedEntries) {
+  SymbolCache cache;
+  EXPECT_FALSE(cache.Find("build_id", 0x10).has_value());
+
+  cache.Add("build_id", 0x10, {0x8, "foo"});
+  cache.Add("build_id", 0x20, {0x18, "bar"});
+  std::optional<SymbolCache::Entry> entry = cache.Find("build_id", 0x10);
+  ASSERT_TRUE(entry.has_value());
+  EXPECT_EQ(entry->function_offset, 0x8);
+  EXPECT_EQ(entry->function_name, "foo");
+  entry = cache.Find("build_id", 0x20);
+  ASSERT_TRUE(entry.has_value());
+  EXPECT_EQ(entry->function_name, "bar");
+  EXPECT_FALSE(cache.Find("build_id", 0x18).has_value());
+}
+
+TEST(SymbolCache, KeepsModulesApart) {
+  SymbolCache cache;
+  cache.Add("first", 0x10, {0x10, "foo"});
+  cache.Add("second", 0x10, {0x0, "bar"});
+  EXPECT_EQ(cache.Find("first", 0x10)->function_name, "foo");
+  EXPECT_EQ(cache.Find("second", 0x10)->function_name, "bar");
+  EXPECT_FALSE(cache.Find("third", 0x10).has_value());
+
+  cache.Add("first", 0x10, {0x0, "baz"});
+  EXPECT_EQ(cache.Find("first", 0x10)->function_name, "baz");
+
+  cache.Clear();
+  EXPECT_FALSE(cache.Find("first", 0x10).has_value());
+}
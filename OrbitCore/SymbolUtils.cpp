@@ -62,16 +62,6 @@ void SymUtils::ListModules(
     module->m_AddressEnd =
         (DWORD64)moduleInfo.lpBaseOfDll + moduleInfo.SizeOfImage;
     module->m_EntryPoint = (DWORD64)moduleInfo.EntryPoint;
-
-    std::string filePath = module->m_FullName;
-    Replace(filePath, ".exe", ".pdb");
-    Replace(filePath, ".dll", ".pdb");
-    if (Path::FileExists(filePath)) {
-      module->m_FoundPdb = true;
-      module->m_PdbSize = Path::FileSize(filePath);
-      module->m_PdbName = filePath;
-    }
-
     module->m_ModuleHandle = hModule;
 
     if (module->m_AddressStart != 0) {
@@ -80,6 +70,18 @@ void SymUtils::ListModules(
   }
 }
 
+//-----------------------------------------------------------------------------
+void SymUtils::FindPdb(Module& a_Module) {
+  std::string filePath = a_Module.m_FullName;
+  Replace(filePath, ".exe", ".pdb");
+  Replace(filePath, ".dll", ".pdb");
+  if (Path::FileExists(filePath)) {
+    a_Module.m_FoundPdb = true;
+    a_Module.m_PdbSize = Path::FileSize(filePath);
+    a_Module.m_PdbName = filePath;
+  }
+}
+
 //-----------------------------------------------------------------------------
 bool SymUtils::GetLineInfo(DWORD64 a_Address, LineInfo& o_LineInfo) {
   std::shared_ptr<Process> process = Capture::GTargetProcess;
@@ -15,6 +15,8 @@ struct SymUtils {
   static void ListModules(
       HANDLE a_ProcessHandle,
       std::map<DWORD64, std::shared_ptr<Module> >& o_ModuleMap);
+  // Looks for the pdb next to the module, see Process::FindModules.
+  static void FindPdb(Module& a_Module);
   static bool GetLineInfo(DWORD64 a_Address, LineInfo& o_LineInfo);
 };
 
@@ -1,60 +1,83 @@
 #include "Systrace.h"
 
 #include <fstream>
+#include <iterator>
+#include <optional>
+#include <string_view>
 
 #include "Capture.h"
+#include "ChromeTrace.h"
+#include "OrbitBase/Logging.h"
+#include "PerfettoTrace.h"
 #include "PrintVar.h"
 #include "Profiling.h"
 #include "ScopeTimer.h"
+#include "SystraceParser.h"
 
-//-----------------------------------------------------------------------------
-bool ShouldIgnore(const std::string& line) {
-  return StartsWith(line, "#") || Contains(line, "<script class=") ||
-         Contains(line, "</script>") || Contains(line, "<!-- ");
-}
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
-//-----------------------------------------------------------------------------
-bool IsBegin(const std::string& line) {
-  return Contains(line, "tracing_mark_write: B");
-}
+namespace {
+// The contents of a file, mapped where mmap is available, read otherwise.
+class FileContents {
+ public:
+  explicit FileContents(const char* a_FilePath);
+  ~FileContents();
+  FileContents(const FileContents&) = delete;
+  FileContents& operator=(const FileContents&) = delete;
 
-//-----------------------------------------------------------------------------
-bool IsEnd(const std::string& line) {
-  return Contains(line, "tracing_mark_write: E");
-}
+  std::string_view Get() const { return m_Contents; }
 
-//-----------------------------------------------------------------------------
-bool IsTraceBegin(const std::string& line) {
-  return Contains(line, "<!-- BEGIN TRACE -->");
-}
+ private:
+  std::string_view m_Contents;
+#ifdef __linux__
+  void* m_Mapping = MAP_FAILED;
+#else
+  std::string m_Buffer;
+#endif
+};
 
-//-----------------------------------------------------------------------------
-bool IsTraceEnd(const std::string& line) {
-  return Contains(line, "<!-- END TRACE -->");
-}
-
-//-----------------------------------------------------------------------------
-std::string GetThreadName(const std::string& a_Line) {
-  auto tokens = Tokenize(a_Line, "(");
-  return tokens.size() ? tokens[0] : "unknown-thread-name";
+#ifdef __linux__
+FileContents::FileContents(const char* a_FilePath) {
+  int fd = open(a_FilePath, O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+    m_Mapping =
+        mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (m_Mapping == MAP_FAILED) {
+    return;
+  }
+  madvise(m_Mapping, fileStat.st_size, MADV_WILLNEED);
+  m_Contents = std::string_view(static_cast<const char*>(m_Mapping),
+                                fileStat.st_size);
 }
 
-//-----------------------------------------------------------------------------
-std::string GetTimeStamp(const std::string& a_Line) {
-  auto tokens = Tokenize(a_Line, "]");
-  if (tokens.size() > 1) {
-    tokens = Tokenize(tokens[1]);
-    if (tokens.size() > 1) return tokens[1];
+FileContents::~FileContents() {
+  if (m_Mapping != MAP_FAILED) {
+    munmap(m_Mapping, m_Contents.size());
   }
-  return "0";
 }
-
-//-----------------------------------------------------------------------------
-std::string GetFunction(const std::string& a_Line) {
-  auto tokens = Tokenize(a_Line, "|");
-  return tokens.size() ? tokens.back() : "unknown-function";
+#else
+FileContents::FileContents(const char* a_FilePath) {
+  std::ifstream file(a_FilePath, std::ios::binary);
+  m_Buffer.assign(std::istreambuf_iterator<char>(file),
+                  std::istreambuf_iterator<char>());
+  m_Contents = m_Buffer;
 }
 
+FileContents::~FileContents() {}
+#endif
+}  // namespace
+
 //-----------------------------------------------------------------------------
 DWORD Systrace::GetThreadId(const std::string& a_ThreadName) {
   auto it = m_ThreadIDs.find(a_ThreadName);
@@ -76,23 +99,6 @@ uint64_t Systrace::ProcessString(const std::string& a_String) {
   return hash;
 }
 
-//-----------------------------------------------------------------------------
-uint64_t Systrace::ProcessFunctionName(const std::string& a_String) {
-  std::vector<std::string> tokens = Tokenize(a_String, "|");
-  if (tokens.size()) {
-    const std::string& function = tokens.back();
-    uint64_t hash = ProcessString(function);
-    Function func;
-    func.SetAddress(hash);
-    func.SetName(function);
-    func.SetPrettyName(function);
-    m_Functions.push_back(func);
-    return hash;
-  }
-
-  return 0;
-}
-
 //-----------------------------------------------------------------------------
 const std::string& Systrace::GetFunctionName(uint64_t a_ID) const {
   static std::string defaultName = "";
@@ -111,45 +117,13 @@ void Systrace::UpdateMinMax(const Timer& a_Timer) {
 Systrace::Systrace(const char* a_FilePath, uint64_t a_TimeOffsetNs) {
   SCOPE_TIMER_LOG("Systrace Parsing");
   m_Name = a_FilePath;
-  std::ifstream infile(a_FilePath);
-  std::string line;
   m_TimeOffsetNs = a_TimeOffsetNs;
-  bool foundBegin = false;
-  while (std::getline(infile, line)) {
-    if (IsTraceBegin(line)) foundBegin = true;
-    if (!foundBegin) continue;
-    if (IsTraceEnd(line)) break;
-
-    bool isBegin = IsBegin(line);
-    bool isEnd = IsEnd(line);
-    if (isBegin || isEnd) {
-      const std::string& threadName = GetThreadName(line);
-      const std::string& timestamp = GetTimeStamp(line);
-
-      if (isBegin) {
-        Timer timer;
-        timer.m_TID = GetThreadId(threadName);
-        timer.m_Start = TicksFromMicroseconds(GetMicros(timestamp) +
-                                              m_TimeOffsetNs * 0.001);
-
-        timer.m_Depth = (uint8_t)m_TimerStacks[threadName].size();
-        const std::string& function = GetFunction(line);
-        timer.m_FunctionAddress = ProcessFunctionName(function);
-        m_TimerStacks[threadName].push_back(timer);
-      }
-
-      if (isEnd) {
-        std::vector<Timer>& timers = m_TimerStacks[threadName];
-        if (timers.size()) {
-          Timer& timer = timers.back();
-          timer.m_End = TicksFromMicroseconds(GetMicros(timestamp) +
-                                              m_TimeOffsetNs * 0.001);
-          m_Timers.push_back(timer);
-          UpdateMinMax(timer);
-          timers.pop_back();
-        }
-      }
-    }
+  std::optional<TraceFormat> format = GetTraceFormat(a_FilePath);
+  if (!format.has_value()) {
+    ParseHtml(a_FilePath);
+  } else if (!ReadTrace(a_FilePath, *format)) {
+    ERROR("Reading trace %s, keeping the events before the error",
+          a_FilePath);
   }
 
   {
@@ -163,9 +137,142 @@ Systrace::Systrace(const char* a_FilePath, uint64_t a_TimeOffsetNs) {
   {
     SCOPE_TIMER_LOG("Update Timers");
     for (auto& timer : m_Timers) {
-      m_FunctionMap[timer.m_FunctionAddress]->UpdateStats(timer);
+      auto it = m_FunctionMap.find(timer.m_FunctionAddress);
+      if (it != m_FunctionMap.end()) {
+        it->second->UpdateStats(timer);
+      }
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void Systrace::ParseHtml(const char* a_FilePath) {
+  FileContents contents(a_FilePath);
+  SystraceParser parser;
+  parser.Parse(contents.Get());
+
+  std::vector<uint64_t> functionHashes;
+  functionHashes.reserve(parser.function_names().size());
+  for (std::string_view name : parser.function_names()) {
+    std::string function(name);
+    uint64_t hash = ProcessString(function);
+    Function func;
+    func.SetAddress(hash);
+    func.SetName(function);
+    func.SetPrettyName(function);
+    m_Functions.push_back(func);
+    functionHashes.push_back(hash);
+  }
+
+  const std::vector<std::vector<SystraceParser::Scope>>& scopes =
+      parser.scopes();
+  size_t numTimers = 0;
+  for (const std::vector<SystraceParser::Scope>& threadScopes : scopes) {
+    numTimers += threadScopes.size();
+  }
+  m_Timers.reserve(numTimers);
+
+  double offsetMicros = m_TimeOffsetNs * 0.001;
+  for (size_t i = 0; i < scopes.size(); ++i) {
+    if (scopes[i].empty()) continue;
+    DWORD tid = GetThreadId(std::string(parser.thread_names()[i]));
+    for (const SystraceParser::Scope& scope : scopes[i]) {
+      Timer timer;
+      timer.m_TID = tid;
+      timer.m_Start = TicksFromMicroseconds(scope.begin_micros + offsetMicros);
+      timer.m_End = TicksFromMicroseconds(scope.end_micros + offsetMicros);
+      timer.m_Depth = (uint8_t)scope.depth;
+      timer.m_FunctionAddress = functionHashes[scope.function_index];
+      m_Timers.push_back(timer);
+      UpdateMinMax(timer);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Scopes of a trace as timers of their functions, on the threads of the
+// trace, and the time each thread ran on a core as a CORE_ACTIVITY timer.
+class Systrace::TraceCollector : public TraceEventVisitor {
+ public:
+  explicit TraceCollector(Systrace* a_Systrace) : m_Systrace(a_Systrace) {}
+
+  void OnThreadName(uint32_t a_TID, std::string_view a_Name) override {
+    std::string name(a_Name);
+    m_Systrace->m_ThreadIDs[name] = a_TID;
+    m_Systrace->m_ThreadNames[a_TID] = std::move(name);
+  }
+
+  void OnScope(const TraceScope& a_Scope) override {
+    Timer timer;
+    timer.m_TID = a_Scope.tid;
+    timer.m_Start = a_Scope.start_ns + m_Systrace->m_TimeOffsetNs;
+    timer.m_End = a_Scope.end_ns + m_Systrace->m_TimeOffsetNs;
+    timer.m_Depth = (uint8_t)a_Scope.depth;
+    timer.m_FunctionAddress = GetFunctionAddress(a_Scope.name);
+    AddTimer(timer);
+  }
+
+  void OnContextSwitch(const ContextSwitch& a_CS) override {
+    if (a_CS.m_Type == ContextSwitch::In) {
+      m_LastSwitchIns[a_CS.m_ProcessorIndex] = a_CS;
+      return;
     }
+    auto it = m_LastSwitchIns.find(a_CS.m_ProcessorIndex);
+    if (it == m_LastSwitchIns.end() ||
+        it->second.m_ThreadId != a_CS.m_ThreadId) {
+      return;
+    }
+    Timer timer;
+    timer.m_TID = a_CS.m_ThreadId;
+    timer.m_Start = it->second.m_Time + m_Systrace->m_TimeOffsetNs;
+    timer.m_End = a_CS.m_Time + m_Systrace->m_TimeOffsetNs;
+    timer.m_Processor = (int8_t)a_CS.m_ProcessorIndex;
+    timer.SetType(Timer::CORE_ACTIVITY);
+    AddTimer(timer);
+    m_LastSwitchIns.erase(it);
+  }
+
+ private:
+  uint64_t GetFunctionAddress(std::string_view a_Name) {
+    std::string name(a_Name);
+    auto it = m_FunctionAddresses.find(name);
+    if (it != m_FunctionAddresses.end()) return it->second;
+
+    uint64_t hash = m_Systrace->ProcessString(name);
+    Function func;
+    func.SetAddress(hash);
+    func.SetName(name);
+    func.SetPrettyName(name);
+    m_Systrace->m_Functions.push_back(func);
+    m_FunctionAddresses.emplace(std::move(name), hash);
+    return hash;
+  }
+
+  void AddTimer(const Timer& a_Timer) {
+    m_Systrace->m_Timers.push_back(a_Timer);
+    m_Systrace->UpdateMinMax(a_Timer);
+  }
+
+  Systrace* m_Systrace;
+  std::unordered_map<std::string, uint64_t> m_FunctionAddresses;
+  std::unordered_map<uint16_t, ContextSwitch> m_LastSwitchIns;
+};
+
+//-----------------------------------------------------------------------------
+bool Systrace::ReadTrace(const char* a_FilePath, TraceFormat a_Format) {
+  std::ifstream file(a_FilePath, std::ios::binary);
+  if (!file) {
+    ERROR("Could not open %s", a_FilePath);
+    return false;
+  }
+  TraceCollector collector(this);
+  switch (a_Format) {
+    case TraceFormat::kChromeJson:
+      return ReadChromeTrace(&file, &collector);
+    case TraceFormat::kPerfetto:
+      return ReadPerfettoTrace(&file, &collector);
   }
+  return false;
 }
 
 //-----------------------------------------------------------------------------
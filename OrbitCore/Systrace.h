@@ -11,6 +11,7 @@
 #include "Core.h"
 #include "OrbitFunction.h"
 #include "ScopeTimer.h"
+#include "TraceEvents.h"
 
 class Systrace {
  public:
@@ -32,12 +33,16 @@ class Systrace {
  protected:
   DWORD GetThreadId(const std::string& a_ThreadName);
   uint64_t ProcessString(const std::string& a_String);
-  uint64_t ProcessFunctionName(const std::string& a_String);
   void UpdateMinMax(const Timer& a_Timer);
 
  private:
+  class TraceCollector;
+
+  void ParseHtml(const char* a_FilePath);
+  // Of the formats of TraceEvents.h.
+  bool ReadTrace(const char* a_FilePath, TraceFormat a_Format);
+
   std::vector<Timer> m_Timers;
-  std::map<std::string, std::vector<Timer>> m_TimerStacks;
   std::map<std::string, DWORD> m_ThreadIDs;
   std::unordered_map<DWORD, std::string> m_ThreadNames;
   std::unordered_map<uint64_t, std::string> m_StringMap;
@@ -0,0 +1,201 @@
+#include "SystraceParser.h"
+
+#include <charconv>
+#include <unordered_map>
+
+#include "ParallelFor.h"
+
+namespace {
+constexpr std::string_view kTraceBegin = "<!-- BEGIN TRACE -->";
+constexpr std::string_view kTraceEnd = "<!-- END TRACE -->";
+constexpr std::string_view kMarkWrite = "tracing_mark_write: ";
+
+using NameIndices = std::unordered_map<std::string_view, uint32_t>;
+
+uint32_t Intern(std::string_view name, NameIndices* indices,
+                std::vector<std::string_view>* names) {
+  auto [it, inserted] =
+      indices->try_emplace(name, static_cast<uint32_t>(names->size()));
+  if (inserted) {
+    names->push_back(name);
+  }
+  return it->second;
+}
+}  // namespace
+
+struct SystraceParser::Event {
+  uint64_t micros;
+  uint32_t thread_index;
+  // Of begin events only.
+  uint32_t function_index;
+  bool is_begin;
+};
+
+struct SystraceParser::Chunk {
+  std::string_view text;
+  std::vector<Event> events;
+  // Of this chunk, which the indices of its events refer to until interned.
+  std::vector<std::string_view> thread_names;
+  std::vector<std::string_view> function_names;
+  // Per thread, the number of events of this chunk, then where they go
+  // among the events of all chunks grouped by thread.
+  std::vector<size_t> thread_offsets;
+};
+
+void SystraceParser::Parse(std::string_view text, size_t chunk_size) {
+  thread_names_.clear();
+  function_names_.clear();
+  scopes_.clear();
+
+  // From the line after the begin marker to the line of the end marker.
+  size_t begin = text.find(kTraceBegin);
+  if (begin == std::string_view::npos) return;
+  begin = text.find('\n', begin);
+  if (begin == std::string_view::npos) return;
+  ++begin;
+  size_t end = text.find(kTraceEnd, begin);
+  end = end == std::string_view::npos ? text.size() : text.rfind('\n', end) + 1;
+
+  std::vector<Chunk> chunks;
+  while (begin < end) {
+    size_t chunk_end = end;
+    if (end - begin > chunk_size) {
+      chunk_end = text.find('\n', begin + chunk_size - 1);
+      chunk_end = chunk_end >= end ? end : chunk_end + 1;
+    }
+    chunks.push_back(Chunk{text.substr(begin, chunk_end - begin)});
+    begin = chunk_end;
+  }
+
+  ParallelFor(chunks.size(), [&](size_t i) { ParseChunk(&chunks[i]); });
+  InternNames(&chunks);
+  MatchScopes(&chunks);
+}
+
+uint64_t SystraceParser::ParseMicros(std::string_view line) {
+  // "<thread>-<tid> (<pid>) [<cpu>] <flags> <seconds>.<micros>: ..."
+  size_t cpu_end = line.find(']');
+  if (cpu_end == std::string_view::npos) return 0;
+  size_t flags = line.find_first_not_of(' ', cpu_end + 1);
+  if (flags == std::string_view::npos) return 0;
+  size_t time = line.find_first_not_of(' ', line.find(' ', flags));
+  if (time == std::string_view::npos) return 0;
+  std::string_view timestamp =
+      line.substr(time, line.find(' ', time) - time);
+
+  size_t dot = timestamp.find('.');
+  if (dot == std::string_view::npos) return 0;
+  uint64_t seconds = 0;
+  uint64_t micros = 0;
+  std::from_chars(timestamp.data(), timestamp.data() + dot, seconds);
+  std::from_chars(timestamp.data() + dot + 1,
+                  timestamp.data() + timestamp.size(), micros);
+  return seconds * 1000000 + micros;
+}
+
+void SystraceParser::ParseChunk(Chunk* chunk) {
+  NameIndices thread_indices;
+  NameIndices function_indices;
+  std::string_view text = chunk->text;
+  size_t begin = 0;
+  while (begin < text.size()) {
+    size_t end = text.find('\n', begin);
+    if (end == std::string_view::npos) end = text.size();
+    std::string_view line = text.substr(begin, end - begin);
+    begin = end + 1;
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+    size_t mark = line.find(kMarkWrite);
+    if (mark == std::string_view::npos) continue;
+    size_t type = mark + kMarkWrite.size();
+    if (type >= line.size() || (line[type] != 'B' && line[type] != 'E')) {
+      continue;
+    }
+
+    Event event;
+    event.micros = ParseMicros(line);
+    event.thread_index = Intern(line.substr(0, line.find('(')),
+                                &thread_indices, &chunk->thread_names);
+    event.is_begin = line[type] == 'B';
+    event.function_index = 0;
+    if (event.is_begin) {
+      // "B|<pid>|<function>", the function being all of a bare "B".
+      event.function_index = Intern(line.substr(line.rfind('|') + 1),
+                                    &function_indices, &chunk->function_names);
+    }
+    chunk->events.push_back(event);
+  }
+}
+
+void SystraceParser::InternNames(std::vector<Chunk>* chunks) {
+  // Names are few, so this serial part is short.
+  NameIndices thread_indices;
+  NameIndices function_indices;
+  std::vector<std::vector<uint32_t>> thread_maps(chunks->size());
+  std::vector<std::vector<uint32_t>> function_maps(chunks->size());
+  for (size_t i = 0; i < chunks->size(); ++i) {
+    for (std::string_view name : (*chunks)[i].thread_names) {
+      thread_maps[i].push_back(
+          Intern(name, &thread_indices, &thread_names_));
+    }
+    for (std::string_view name : (*chunks)[i].function_names) {
+      function_maps[i].push_back(
+          Intern(name, &function_indices, &function_names_));
+    }
+  }
+
+  ParallelFor(chunks->size(), [&](size_t i) {
+    Chunk& chunk = (*chunks)[i];
+    chunk.thread_offsets.assign(thread_names_.size(), 0);
+    for (Event& event : chunk.events) {
+      event.thread_index = thread_maps[i][event.thread_index];
+      if (event.is_begin) {
+        event.function_index = function_maps[i][event.function_index];
+      }
+      ++chunk.thread_offsets[event.thread_index];
+    }
+  });
+}
+
+void SystraceParser::MatchScopes(std::vector<Chunk>* chunks) {
+  // Events grouped by thread, in the order of the file within a thread.
+  size_t num_threads = thread_names_.size();
+  std::vector<size_t> thread_begins(num_threads + 1);
+  size_t num_events = 0;
+  for (size_t thread = 0; thread < num_threads; ++thread) {
+    thread_begins[thread] = num_events;
+    for (Chunk& chunk : *chunks) {
+      size_t count = chunk.thread_offsets[thread];
+      chunk.thread_offsets[thread] = num_events;
+      num_events += count;
+    }
+  }
+  thread_begins[num_threads] = num_events;
+
+  std::vector<Event> events(num_events);
+  ParallelFor(chunks->size(), [&](size_t i) {
+    Chunk& chunk = (*chunks)[i];
+    for (const Event& event : chunk.events) {
+      events[chunk.thread_offsets[event.thread_index]++] = event;
+    }
+    std::vector<Event>().swap(chunk.events);
+  });
+
+  scopes_.resize(num_threads);
+  ParallelFor(num_threads, [&](size_t thread) {
+    std::vector<Scope> stack;
+    for (size_t i = thread_begins[thread]; i < thread_begins[thread + 1]; ++i) {
+      const Event& event = events[i];
+      if (event.is_begin) {
+        stack.push_back({event.micros, 0, event.function_index,
+                         static_cast<uint32_t>(stack.size())});
+      } else if (!stack.empty()) {
+        // Ends without a begin, from before the trace started, are dropped.
+        Scope scope = stack.back();
+        stack.pop_back();
+        scope.end_micros = event.micros;
+        scopes_[thread].push_back(scope);
+      }
+    }
+  });
+}
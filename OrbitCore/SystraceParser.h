@@ -0,0 +1,56 @@
+#ifndef ORBIT_CORE_SYSTRACE_PARSER_H_
+#define ORBIT_CORE_SYSTRACE_PARSER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Scopes of the tracing_mark_write events of an atrace file, between its
+// BEGIN TRACE and END TRACE markers. Gigabytes of trace are parsed at about
+// the speed they are read: the text is split into chunks of whole lines,
+// parsed in parallel without copying a string, with thread and function names
+// interned to indices; then the begin and end events of each thread are
+// matched, threads in parallel. Names are views of the parsed text, which
+// must outlive the parser.
+class SystraceParser {
+ public:
+  struct Scope {
+    uint64_t begin_micros;
+    uint64_t end_micros;
+    uint32_t function_index;
+    // Number of enclosing scopes on the thread.
+    uint32_t depth;
+  };
+
+  static constexpr size_t kDefaultChunkSize = 8 * 1024 * 1024;
+
+  void Parse(std::string_view text, size_t chunk_size = kDefaultChunkSize);
+
+  // By index, in order of first event.
+  const std::vector<std::string_view>& thread_names() const {
+    return thread_names_;
+  }
+  const std::vector<std::string_view>& function_names() const {
+    return function_names_;
+  }
+  // By thread index, in the order they end.
+  const std::vector<std::vector<Scope>>& scopes() const { return scopes_; }
+
+  // The time of a line, in microseconds, 0 if it has none.
+  static uint64_t ParseMicros(std::string_view line);
+
+ private:
+  struct Event;
+  struct Chunk;
+
+  static void ParseChunk(Chunk* chunk);
+  void InternNames(std::vector<Chunk>* chunks);
+  void MatchScopes(std::vector<Chunk>* chunks);
+
+  std::vector<std::string_view> thread_names_;
+  std::vector<std::string_view> function_names_;
+  std::vector<std::vector<Scope>> scopes_;
+};
+
+#endif  // ORBIT_CORE_SYSTRACE_PARSER_H_
@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "SystraceParser.h"
+
+namespace {
+const char kTrace[] =
+    "<html>\n"
+    "  <!-- BEGIN TRACE -->\n"
+    "# tracer: nop\n"
+    "  RenderThread-1234  ( 1200) [001] ...1  100.000010: "
+    "tracing_mark_write: E\n"
+    "  RenderThread-1234  ( 1200) [001] ...1  100.000020: "
+    "tracing_mark_write: B|1200|DrawFrame\n"
+    "     Main-1200  ( 1200) [000] ...1  100.000025: "
+    "tracing_mark_write: B|1200|Choreographer#doFrame\n"
+    "  RenderThread-1234  ( 1200) [001] ...1  100.000030: "
+    "tracing_mark_write: B|1200|flush commands\r\n"
+    "  RenderThread-1234  ( 1200) [001] ...1  100.000040: "
+    "sched_switch: prev_comm=RenderThread\n"
+    "  RenderThread-1234  ( 1200) [001] ...1  100.000050: "
+    "tracing_mark_write: E|1200\n"
+    "     Main-1200  ( 1200) [000] ...1  100.000055: "
+    "tracing_mark_write: B|1200|DrawFrame\n"
+    "  RenderThread-1234  ( 1200) [001] ...1  101.000060: "
+    "tracing_mark_write: E|1200\n"
+    "     Main-1200  ( 1200) [000] ...1  101.000065: "
+    "tracing_mark_write: E|1200\n"
+    "  <!-- END TRACE -->\n"
+    "     Main-1200  ( 1200) [000] ...1  102.000000: "
+    "tracing_mark_write: E|1200\n"
+    "</html>\n";
+
+void ExpectScope(const SystraceParser::Scope& scope, uint64_t begin_micros,
+                 uint64_t end_micros, const std::string& function,
+                 uint32_t depth, const SystraceParser& parser) {
+  EXPECT_EQ(scope.begin_micros, begin_micros);
+  EXPECT_EQ(scope.end_micros, end_micros);
+  EXPECT_EQ(parser.function_names()[scope.function_index], function);
+  EXPECT_EQ(scope.depth, depth);
+}
+}  // namespace
+
+TEST(SystraceParser, ParsesMicros) {
+  EXPECT_EQ(SystraceParser::ParseMicros(
+                "  a-1 ( 1) [001] d..2  12.345678: sched_switch: x"),
+            12345678);
+  EXPECT_EQ(SystraceParser::ParseMicros("no cpu"), 0);
+  EXPECT_EQ(SystraceParser::ParseMicros("a-1 ( 1) [001] ...1 12: x"), 0);
+}
+
+TEST(SystraceParser, MatchesScopesPerThread) {
+  // From one line per chunk to a single chunk, which must parse the same.
+  for (size_t chunk_size : {1, 64, 1 << 20}) {
+    SystraceParser parser;
+    parser.Parse(kTrace, chunk_size);
+
+    ASSERT_EQ(parser.thread_names().size(), 2);
+    EXPECT_EQ(parser.thread_names()[0], "  RenderThread-1234  ");
+    EXPECT_EQ(parser.thread_names()[1], "     Main-1200  ");
+    ASSERT_EQ(parser.function_names().size(), 3);
+
+    ASSERT_EQ(parser.scopes().size(), 2);
+    const std::vector<SystraceParser::Scope>& render = parser.scopes()[0];
+    ASSERT_EQ(render.size(), 2);
+    ExpectScope(render[0], 100000030, 100000050, "flush commands", 1, parser);
+    ExpectScope(render[1], 100000020, 101000060, "DrawFrame", 0, parser);
+
+    const std::vector<SystraceParser::Scope>& main = parser.scopes()[1];
+    ASSERT_EQ(main.size(), 1);
+    ExpectScope(main[0], 100000055, 101000065, "DrawFrame", 1, parser);
+  }
+}
+
+TEST(SystraceParser, NeedsTheBeginMarker) {
+  SystraceParser parser;
+  parser.Parse(
+      "  a-1 ( 1) [001] ...1 1.000001: tracing_mark_write: B|1|f\n"
+      "  a-1 ( 1) [001] ...1 1.000002: tracing_mark_write: E|1\n");
+  EXPECT_TRUE(parser.thread_names().empty());
+  EXPECT_TRUE(parser.scopes().empty());
+}
@@ -21,11 +21,13 @@ tcp_server::tcp_server(asio::io_service& io_service, unsigned short port)
 
 void tcp_server::Disconnect() {
   PRINT_FUNC;
+  std::lock_guard<std::mutex> lock(connection_mutex_);
   connection_ = nullptr;
 }
 
 void tcp_server::RegisterConnection(std::shared_ptr<TcpConnection> connection) {
   PRINT_FUNC;
+  std::lock_guard<std::mutex> lock(connection_mutex_);
   connection_ = connection;
 }
 
@@ -57,18 +59,18 @@ void tcp_server::handle_accept(std::shared_ptr<TcpConnection> new_connection,
 }
 
 void TcpConnection::ReadMessage() {
-  asio::async_read(socket_, asio::buffer(&message_, sizeof(Message)),
-                   [this](asio::error_code ec, std::size_t /*length*/) {
-                     if (!ec) {
-                       num_bytes_received_ += sizeof(Message);
-                       ReadPayload();
-                     } else {
-                       PRINT_VAR(ec.message());
-                       socket_.close();
-                     }
-                   }
-
-  );
+  asio::async_read(
+      socket_, asio::buffer(&message_, sizeof(Message)),
+      asio::bind_executor(*wrapped_socket_.m_Strand,
+                          [this](asio::error_code ec, std::size_t /*length*/) {
+                            if (!ec) {
+                              num_bytes_received_ += sizeof(Message);
+                              ReadPayload();
+                            } else {
+                              PRINT_VAR(ec.message());
+                              socket_.close();
+                            }
+                          }));
 }
 
 void TcpConnection::ResetStats() { num_bytes_received_ = 0; }
@@ -104,8 +106,10 @@ void TcpConnection::handle_request_line(asio::error_code ec,
     } else {
       asio::async_read_until(
           socket_, stream_buf_, "\r\n",
-          std::bind(&TcpConnection::handle_request_line, this,
-                    std::placeholders::_1, std::placeholders::_2));
+          asio::bind_executor(
+              *wrapped_socket_.m_Strand,
+              std::bind(&TcpConnection::handle_request_line, this,
+                        std::placeholders::_1, std::placeholders::_2)));
     }
   } else {
     PRINT_VAR(ec.message());
@@ -133,8 +137,10 @@ void TcpConnection::SendWebsocketResponse() {
 void TcpConnection::ReadWebsocketHandshake() {
   asio::async_read_until(
       socket_, stream_buf_, "\r\n",
-      std::bind(&TcpConnection::handle_request_line, this,
-                std::placeholders::_1, std::placeholders::_2));
+      asio::bind_executor(
+          *wrapped_socket_.m_Strand,
+          std::bind(&TcpConnection::handle_request_line, this,
+                    std::placeholders::_1, std::placeholders::_2)));
 }
 
 void TcpConnection::ReadPayload() {
@@ -152,17 +158,18 @@ void TcpConnection::ReadPayload() {
     payload_.resize(message_.m_Size);
     asio::async_read(
         socket_, asio::buffer(payload_.data(), message_.m_Size),
-
-        [this](asio::error_code ec, std::size_t bytes_transferred) {
-          if (!ec) {
-            num_bytes_received_ += bytes_transferred;
-            message_.m_Data = payload_.data();
-            ReadFooter();
-          } else {
-            PRINT_VAR(ec.message());
-            socket_.close();
-          }
-        });
+        asio::bind_executor(
+            *wrapped_socket_.m_Strand,
+            [this](asio::error_code ec, std::size_t bytes_transferred) {
+              if (!ec) {
+                num_bytes_received_ += bytes_transferred;
+                message_.m_Data = payload_.data();
+                ReadFooter();
+              } else {
+                PRINT_VAR(ec.message());
+                socket_.close();
+              }
+            }));
   }
 }
 
@@ -176,6 +183,13 @@ void TcpConnection::ReadFooter() {
 }
 
 void TcpConnection::DecodeMessage(Message& a_Message) {
+  if (a_Message.GetType() == Msg_SubscribeCapture && !is_capture_subscriber_) {
+    is_capture_subscriber_ = true;
+    GTcpServer->AddCaptureSubscriber(shared_from_this());
+  }
+  if (is_capture_subscriber_) {
+    return;
+  }
   GTcpServer->GetServer()->RegisterConnection(
       this->shared_from_this());  // TODO:
   GTcpServer->Receive(a_Message);
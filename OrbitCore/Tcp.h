@@ -12,6 +12,7 @@
 #include <asio.hpp>
 #include <ctime>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <unordered_set>
 
@@ -32,7 +33,11 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
 
   TcpSocket& GetSocket() { return wrapped_socket_; }
 
-  void start() { ReadMessage(); }
+  // The messages of a connection are read and decoded on its strand, those
+  // of different connections possibly in parallel.
+  void start() {
+    asio::post(*wrapped_socket_.m_Strand, [this]() { ReadMessage(); });
+  }
 
   void ReadMessage();
   void ReadPayload();
@@ -48,9 +53,9 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
 
  private:
   TcpConnection(asio::io_service& io_service)
-      : socket_(io_service),
-        wrapped_socket_(&socket_),
-        num_bytes_received_(0) {}
+      : socket_(io_service), num_bytes_received_(0) {
+    wrapped_socket_.SetSocket(&socket_, io_service);
+  }
   // handle_write() is responsible for any further actions
   // for this client connection.
   void handle_write(const asio::error_code& /*error*/,
@@ -66,6 +71,8 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
   asio::streambuf stream_buf_;
   std::string web_socket_key_;
   uint64_t num_bytes_received_;
+  // Only accessed by the thread reading the socket.
+  bool is_capture_subscriber_ = false;
 };
 
 //-----------------------------------------------------------------------------
@@ -75,17 +82,21 @@ class tcp_server : public std::enable_shared_from_this<tcp_server> {
   ~tcp_server();
 
   void Disconnect();
-  bool HasConnection() { return connection_ != nullptr; }
+  bool HasConnection() { return GetConnection() != nullptr; }
+  // The connection stays alive in connections_set_.
   TcpSocket* GetSocket() {
-    return connection_ != nullptr ? &connection_->GetSocket() : nullptr;
+    std::shared_ptr<TcpConnection> connection = GetConnection();
+    return connection != nullptr ? &connection->GetSocket() : nullptr;
   }
   void RegisterConnection(std::shared_ptr<TcpConnection> connection);
   ULONG64 GetNumBytesReceived() {
-    return connection_ != nullptr ? connection_->GetNumBytesReceived() : 0;
+    std::shared_ptr<TcpConnection> connection = GetConnection();
+    return connection != nullptr ? connection->GetNumBytesReceived() : 0;
   }
   void ResetStats() {
-    if (connection_ != nullptr) {
-      connection_->ResetStats();
+    std::shared_ptr<TcpConnection> connection = GetConnection();
+    if (connection != nullptr) {
+      connection->ResetStats();
     }
   }
 
@@ -94,7 +105,14 @@ class tcp_server : public std::enable_shared_from_this<tcp_server> {
   void handle_accept(std::shared_ptr<TcpConnection> new_connection,
                      const asio::error_code& error);
 
+  std::shared_ptr<TcpConnection> GetConnection() {
+    std::lock_guard<std::mutex> lock(connection_mutex_);
+    return connection_;
+  }
+
   tcp::acceptor acceptor_;
+  // Registered from the strands of the connections, read from any thread.
+  std::mutex connection_mutex_;
   std::shared_ptr<TcpConnection> connection_;
   // Is this here to keep them alive until server is destroyed?
   // This is not really used for anything else.
@@ -121,11 +139,6 @@ class SharedConstBuffer {
     buffer_ = asio::buffer(*data_);
   }
 
-  explicit SharedConstBuffer(TcpPacket& packet) {
-    data_ = packet.Data();
-    buffer_ = asio::buffer(*data_);
-  }
-
   // Implement the ConstBufferSequence requirements.
   typedef asio::const_buffer value_type;
   typedef const asio::const_buffer* const_iterator;
@@ -12,8 +12,10 @@
 
 #include "BaseTypes.h"
 #include "Core.h"
+#include "FunctionSampler.h"
 #include "Hijacking.h"
 #include "Log.h"
+#include "OrbitBase/Logging.h"
 #include "OrbitLib.h"
 #include "OrbitType.h"
 #include "Tcp.h"
@@ -33,7 +35,7 @@ TcpClient::TcpClient() {}
 TcpClient::TcpClient(const std::string& a_Host) { Connect(a_Host); }
 
 //-----------------------------------------------------------------------------
-TcpClient::~TcpClient() {}
+TcpClient::~TcpClient() { StopReadingSharedMemory(); }
 
 //-----------------------------------------------------------------------------
 void TcpClient::Connect(const std::string& a_Host) {
@@ -43,8 +45,15 @@ void TcpClient::Connect(const std::string& a_Host) {
   std::string& host = vec[0];
   std::string& port = vec[1];
 
-  m_TcpService->m_IoService = new asio::io_service();
-  m_TcpSocket->m_Socket = new tcp::socket(*m_TcpService->m_IoService);
+  m_IsCompressed = false;
+  m_Decompressor.Reset();
+  m_DecompressedPackets.clear();
+  StopReadingSharedMemory();
+  m_IsLocalConnection = false;
+
+  m_TcpService = new TcpService();
+  m_TcpSocket->SetSocket(new tcp::socket(*m_TcpService->m_IoService),
+                         *m_TcpService->m_IoService);
 
   asio::ip::tcp::socket& socket = *m_TcpSocket->m_Socket;
   asio::ip::tcp::resolver resolver(*m_TcpService->m_IoService);
@@ -67,44 +76,55 @@ void TcpClient::Connect(const std::string& a_Host) {
     return;
   }
 
+  asio::error_code endpoint_error;
+  tcp::endpoint endpoint = socket.remote_endpoint(endpoint_error);
+  m_IsLocalConnection = !endpoint_error && endpoint.address().is_loopback();
   m_IsValid = true;
 }
 
+//-----------------------------------------------------------------------------
+void TcpClient::RequestSharedMemory() {
+  m_SharedMemoryRing = SharedMemoryRing::Create();
+  if (m_SharedMemoryRing != nullptr) {
+    Send(Msg_SharedMemoryRequest, m_SharedMemoryRing->GetName());
+  }
+}
+
 //-----------------------------------------------------------------------------
 void TcpClient::Start() {
   TcpEntity::Start();
 
   PRINT_FUNC;
   OutputDebugStringW(L"TcpClient::Start()\n");
-  std::thread t([&]() { this->ClientThread(); });
-  t.detach();
 
   std::string msg("Hello from TcpClient");
   this->Send(msg);
 
-  ReadMessage();
-}
-
-//-----------------------------------------------------------------------------
-void TcpClient::ClientThread() {
-  SetCurrentThreadName(L"OrbitTcpClient");
-  OutputDebugStringW(L"io_service started...\n");
-  asio::io_service::work work(*m_TcpService->m_IoService);
-  m_TcpService->m_IoService->run();
-  OutputDebugStringW(L"io_service ended...\n");
+  // The socket is read and written on its strand, see TcpSocket.
+  asio::post(*m_TcpSocket->m_Strand, [this]() { ReadMessage(); });
 }
 
 //-----------------------------------------------------------------------------
 void TcpClient::ReadMessage() {
+  if (m_IsSharedMemory) {
+    WaitForDisconnection();
+    return;
+  }
+  if (m_IsCompressed) {
+    ReadFrameHeader();
+    return;
+  }
+
   asio::async_read(
       *m_TcpSocket->m_Socket, asio::buffer(&m_Message, sizeof(Message)),
-      [this](const asio::error_code& ec, size_t) {
-        if (!ec) {
-          ReadPayload();
-        } else {
-          OnError(ec);
-        }
-      });
+      asio::bind_executor(*m_TcpSocket->m_Strand,
+                          [this](const asio::error_code& ec, size_t) {
+                            if (!ec) {
+                              ReadPayload();
+                            } else {
+                              OnError(ec);
+                            }
+                          }));
 }
 
 //-----------------------------------------------------------------------------
@@ -114,17 +134,19 @@ void TcpClient::ReadPayload() {
     ReadFooter();
   } else {
     m_Payload.resize(m_Message.m_Size);
-    asio::async_read(*m_TcpSocket->m_Socket,
-                     asio::buffer(m_Payload.data(), m_Message.m_Size),
-
-                     [this](asio::error_code ec, std::size_t /*length*/) {
-                       if (!ec) {
-                         m_Message.m_Data = m_Payload.data();
-                         ReadFooter();
-                       } else {
-                         OnError(ec);
-                       }
-                     });
+    asio::async_read(
+        *m_TcpSocket->m_Socket,
+        asio::buffer(m_Payload.data(), m_Message.m_Size),
+        asio::bind_executor(
+            *m_TcpSocket->m_Strand,
+            [this](asio::error_code ec, std::size_t /*length*/) {
+              if (!ec) {
+                m_Message.m_Data = m_Payload.data();
+                ReadFooter();
+              } else {
+                OnError(ec);
+              }
+            }));
   }
 }
 
@@ -133,12 +155,143 @@ void TcpClient::ReadFooter() {
   unsigned int footer = 0;
   asio::read(*m_TcpSocket->m_Socket, asio::buffer(&footer, 4));
   assert(footer == MAGIC_FOOT_MSG);
+  uint64_t packet_size = sizeof(Message) + m_Message.m_Size + sizeof(footer);
+  m_NumCompressedBytesReceived += packet_size;
+  m_NumRawBytesReceived += packet_size;
+  if (m_Message.GetType() == Msg_CompressionEnabled) {
+    m_Decompressor.Reset();
+    m_IsCompressed = true;
+  } else if (m_Message.GetType() == Msg_SharedMemoryEnabled &&
+             m_SharedMemoryRing != nullptr) {
+    // The service has it mapped, it will be freed once both sides unmap it.
+    m_SharedMemoryRing->Unlink();
+    m_IsSharedMemory = true;
+    m_SharedMemoryReader = std::thread([this] { ReadSharedMemory(); });
+  }
   DecodeMessage(m_Message);
   ReadMessage();
 }
 
+//-----------------------------------------------------------------------------
+void TcpClient::ReadFrameHeader() {
+  asio::async_read(*m_TcpSocket->m_Socket,
+                   asio::buffer(&m_FrameSize, sizeof(m_FrameSize)),
+                   asio::bind_executor(
+                       *m_TcpSocket->m_Strand,
+                       [this](const asio::error_code& ec, size_t) {
+                         if (!ec) {
+                           ReadFrame();
+                         } else {
+                           OnError(ec);
+                         }
+                       }));
+}
+
+//-----------------------------------------------------------------------------
+void TcpClient::ReadFrame() {
+  m_Frame.resize(m_FrameSize);
+  asio::async_read(
+      *m_TcpSocket->m_Socket, asio::buffer(m_Frame.data(), m_Frame.size()),
+      asio::bind_executor(
+          *m_TcpSocket->m_Strand, [this](const asio::error_code& ec, size_t) {
+            if (ec) {
+              OnError(ec);
+              return;
+            }
+            m_NumCompressedBytesReceived +=
+                kCompressedFrameHeaderSize + m_Frame.size();
+            if (!m_Decompressor.DecompressFrame(
+                    m_Frame.data(), m_Frame.size(), &m_DecompressedPackets)) {
+              OnError(asio::error::invalid_argument);
+              return;
+            }
+            DecodePackets(&m_DecompressedPackets);
+            ReadFrameHeader();
+          }));
+}
+
+//-----------------------------------------------------------------------------
+void TcpClient::DecodePackets(std::vector<char>* a_Packets) {
+  size_t offset = 0;
+  while (a_Packets->size() - offset >= sizeof(Message)) {
+    memcpy(&m_Message, a_Packets->data() + offset, sizeof(Message));
+    size_t packet_size = sizeof(Message) + m_Message.m_Size + 4;
+    if (a_Packets->size() - offset < packet_size) {
+      break;
+    }
+
+    // Copied so that the payload is aligned like in the raw path.
+    const char* payload = a_Packets->data() + offset + sizeof(Message);
+    m_Payload.assign(payload, payload + m_Message.m_Size);
+    m_Message.m_Data = m_Message.m_Size > 0 ? m_Payload.data() : nullptr;
+
+    unsigned int footer = 0;
+    memcpy(&footer, payload + m_Message.m_Size, sizeof(footer));
+    assert(footer == MAGIC_FOOT_MSG);
+
+    m_NumRawBytesReceived += packet_size;
+    DecodeMessage(m_Message);
+    offset += packet_size;
+  }
+  a_Packets->erase(a_Packets->begin(), a_Packets->begin() + offset);
+}
+
+//-----------------------------------------------------------------------------
+void TcpClient::WaitForDisconnection() {
+  asio::async_read(
+      *m_TcpSocket->m_Socket, asio::buffer(&m_DisconnectionByte, 1),
+      asio::bind_executor(
+          *m_TcpSocket->m_Strand, [this](const asio::error_code& ec, size_t) {
+            if (ec) {
+              OnError(ec);
+              return;
+            }
+            ERROR("Unexpected data on a shared memory connection");
+            WaitForDisconnection();
+          }));
+}
+
+//-----------------------------------------------------------------------------
+void TcpClient::ReadSharedMemory() {
+  SetCurrentThreadName(L"OrbitShmReader");
+  size_t num_pending_bytes = 0;
+  while (m_SharedMemoryRing->Read(&m_SharedMemoryPackets,
+                                  /*timeout_ms=*/100)) {
+    m_NumCompressedBytesReceived +=
+        m_SharedMemoryPackets.size() - num_pending_bytes;
+    DecodePackets(&m_SharedMemoryPackets);
+    num_pending_bytes = m_SharedMemoryPackets.size();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void TcpClient::StopReadingSharedMemory() {
+  if (m_SharedMemoryReader.joinable()) {
+    // Whatever the service wrote before is still decoded.
+    m_SharedMemoryRing->Close();
+    m_SharedMemoryReader.join();
+  }
+  m_SharedMemoryRing = nullptr;
+  m_SharedMemoryPackets.clear();
+  m_IsSharedMemory = false;
+}
+
+//-----------------------------------------------------------------------------
+std::vector<std::string> TcpClient::GetStats() {
+  std::vector<std::string> stats;
+  stats.push_back(absl::StrFormat(
+      "Bytes received = %s (%s uncompressed%s)\n",
+      GetPrettySize(m_NumCompressedBytesReceived),
+      GetPrettySize(m_NumRawBytesReceived),
+      m_IsSharedMemory ? ", shared memory"
+                       : m_IsCompressed ? "" : ", compression off"));
+  return stats;
+}
+
 //-----------------------------------------------------------------------------
 void TcpClient::OnError(const std::error_code& ec) {
+  // Decodes the packets left in the ring before the disconnection.
+  StopReadingSharedMemory();
   if ((ec == asio::error::eof) || (ec == asio::error::connection_reset)) {
     Message msg(Msg_Unload);
     DecodeMessage(msg);
@@ -150,6 +303,26 @@ void TcpClient::OnError(const std::error_code& ec) {
   Stop();
 }
 
+//-----------------------------------------------------------------------------
+// Creates the hooks of the functions of a Msg_FunctionHook* message, then
+// enables them in batches, reporting the progress with Msg_NumInstalledHooks
+// once per batch.
+static void InstallHooks(const Message& a_Message, const char* a_Kind,
+                         bool (*a_CreateHook)(void*)) {
+  const ULONG64* addresses = (const ULONG64*)a_Message.GetData();
+  uint32_t numAddresses = (uint32_t)a_Message.m_Size / sizeof(ULONG64);
+  std::string dbgMsg = absl::StrFormat("Hooking %u %sfunctions\n",
+                                       numAddresses, a_Kind);
+  OutputDebugStringA(dbgMsg.c_str());
+  for (uint32_t i = 0; i < numAddresses; ++i) {
+    a_CreateHook((void*)addresses[i]);
+  }
+
+  Hijacking::EnableHooks(addresses, numAddresses, [](uint32_t a_NumEnabled) {
+    GTcpClient->Send(Msg_NumInstalledHooks, a_NumEnabled);
+  });
+}
+
 //-----------------------------------------------------------------------------
 void TcpClient::DecodeMessage(Message& a_Message) {
   Callback(a_Message);
@@ -185,6 +358,22 @@ void TcpClient::DecodeMessage(Message& a_Message) {
       Send(msg, buffer);
       break;
     }
+    case Msg_GetWatchedData: {
+      const WatchedDataHeader& header = MessageHeader.m_WatchedDataHeader;
+      const WatchedRange* ranges = (const WatchedRange*)a_Message.GetData();
+      size_t numRanges = a_Message.m_Size / sizeof(WatchedRange);
+      std::vector<char> delta = m_WatchedMemoryReader.Read(
+          ranges, numRanges, header.m_Full,
+          [](uint64_t a_Address, uint64_t a_Size, char* a_Buffer) {
+            if (!IsBadReadPtr((void*)a_Address, a_Size)) {
+              memcpy(a_Buffer, (void*)a_Address, a_Size);
+            }
+          });
+      Message msg(Msg_WatchedData);
+      msg.m_Header.m_WatchedDataHeader = header;
+      Send(msg, std::move(delta));
+      break;
+    }
     case Msg_NewSession:
       Message::GSessionID = a_Message.m_SessionID;
       break;
@@ -194,127 +383,33 @@ void TcpClient::DecodeMessage(Message& a_Message) {
     case Msg_StopCapture:
       Orbit::Stop();
       break;
-    case Msg_FunctionHook: {
-      ULONG64* addresses = (ULONG64*)a_Message.GetData();
-      uint32_t numAddresses = (uint32_t)a_Message.m_Size / sizeof(ULONG64);
-      for (uint32_t i = 0; i < numAddresses; ++i) {
-        void* address = (void*)addresses[i];
-        std::string dbgMsg =
-            absl::StrFormat("Hooking function at address: %p\n", address);
-        OutputDebugStringA(dbgMsg.c_str());
-        Hijacking::CreateHook(address);
-        GTcpClient->Send(Msg_NumInstalledHooks, i + 1);
-      }
-
-      Hijacking::EnableHooks(addresses, numAddresses);
-
+    case Msg_FunctionHook:
+      InstallHooks(a_Message, "", &Hijacking::CreateHook);
       break;
-    }
-    case Msg_FunctionHookZoneStart: {
-      ULONG64* addresses = (ULONG64*)a_Message.GetData();
-      uint32_t numAddresses = (uint32_t)a_Message.m_Size / sizeof(ULONG64);
-      for (uint32_t i = 0; i < numAddresses; ++i) {
-        void* address = (void*)addresses[i];
-        std::string dbgMsg =
-            absl::StrFormat("Hooking zone function at address: %p\n", address);
-        OutputDebugStringA(dbgMsg.c_str());
-        Hijacking::CreateZoneStartHook(address);
-      }
-
-      Hijacking::EnableHooks(addresses, numAddresses);
-
+    case Msg_FunctionHookZoneStart:
+      InstallHooks(a_Message, "zone ", &Hijacking::CreateZoneStartHook);
       break;
-    }
-    case Msg_FunctionHookZoneStop: {
-      ULONG64* addresses = (ULONG64*)a_Message.GetData();
-      uint32_t numAddresses = (uint32_t)a_Message.m_Size / sizeof(ULONG64);
-      for (uint32_t i = 0; i < numAddresses; ++i) {
-        void* address = (void*)addresses[i];
-        std::string dbgMsg =
-            absl::StrFormat("Hooking zone function at address: %p\n", address);
-        OutputDebugStringA(dbgMsg.c_str());
-        Hijacking::CreateZoneStopHook(address);
-      }
-
-      Hijacking::EnableHooks(addresses, numAddresses);
-
+    case Msg_FunctionHookZoneStop:
+      InstallHooks(a_Message, "zone ", &Hijacking::CreateZoneStopHook);
       break;
-    }
-    case Msg_FunctionHookOutputDebugString: {
-      ULONG64* addresses = (ULONG64*)a_Message.GetData();
-      uint32_t numAddresses = (uint32_t)a_Message.m_Size / sizeof(ULONG64);
-      for (uint32_t i = 0; i < numAddresses; ++i) {
-        void* address = (void*)addresses[i];
-        std::string dbgMsg = absl::StrFormat(
-            "Hooking OutputDebugString function at address: %p\n", address);
-        OutputDebugStringA(dbgMsg.c_str());
-        Hijacking::CreateOutputDebugStringHook(address);
-      }
-
-      Hijacking::EnableHooks(addresses, numAddresses);
-
+    case Msg_FunctionHookOutputDebugString:
+      InstallHooks(a_Message, "OutputDebugString ",
+                   &Hijacking::CreateOutputDebugStringHook);
       break;
-    }
-    case Msg_FunctionHookUnrealActor: {
-      ULONG64* addresses = (ULONG64*)a_Message.GetData();
-      uint32_t numAddresses = (uint32_t)a_Message.m_Size / sizeof(ULONG64);
-      for (uint32_t i = 0; i < numAddresses; ++i) {
-        void* address = (void*)addresses[i];
-        std::string dbgMsg = absl::StrFormat(
-            "Hooking Unreal Actor function at address: %p\n", address);
-        OutputDebugStringA(dbgMsg.c_str());
-        Hijacking::CreateUnrealActorHook(address);
-      }
-
-      Hijacking::EnableHooks(addresses, numAddresses);
-
+    case Msg_FunctionHookUnrealActor:
+      InstallHooks(a_Message, "Unreal Actor ",
+                   &Hijacking::CreateUnrealActorHook);
       break;
-    }
-    case Msg_FunctionHookOrbitData: {
-      ULONG64* addresses = (ULONG64*)a_Message.GetData();
-      uint32_t numAddresses = (uint32_t)a_Message.m_Size / sizeof(ULONG64);
-      for (uint32_t i = 0; i < numAddresses; ++i) {
-        void* address = (void*)addresses[i];
-        std::string dbgMsg = absl::StrFormat(
-            "Hooking OrbitSendData function at address: %p\n", address);
-        OutputDebugStringA(dbgMsg.c_str());
-        Hijacking::CreateSendDataHook(address);
-      }
-
-      Hijacking::EnableHooks(addresses, numAddresses);
-
+    case Msg_FunctionHookOrbitData:
+      InstallHooks(a_Message, "OrbitSendData ",
+                   &Hijacking::CreateSendDataHook);
       break;
-    }
-    case Msg_FunctionHookAlloc: {
-      ULONG64* addresses = (ULONG64*)a_Message.GetData();
-      uint32_t numAddresses = (uint32_t)a_Message.m_Size / sizeof(ULONG64);
-      for (uint32_t i = 0; i < numAddresses; ++i) {
-        void* address = (void*)addresses[i];
-        std::string dbgMsg =
-            absl::StrFormat("Hooking Alloc function at address: %p\n", address);
-        OutputDebugStringA(dbgMsg.c_str());
-        Hijacking::CreateAllocHook(address);
-      }
-
-      Hijacking::EnableHooks(addresses, numAddresses);
-
+    case Msg_FunctionHookAlloc:
+      InstallHooks(a_Message, "Alloc ", &Hijacking::CreateAllocHook);
       break;
-    }
-    case Msg_FunctionHookFree: {
-      ULONG64* addresses = (ULONG64*)a_Message.GetData();
-      uint32_t numAddresses = (uint32_t)a_Message.m_Size / sizeof(ULONG64);
-      for (uint32_t i = 0; i < numAddresses; ++i) {
-        void* address = (void*)addresses[i];
-        std::string dbgMsg =
-            absl::StrFormat("Hooking Free function at address: %p\n", address);
-        OutputDebugStringA(dbgMsg.c_str());
-        Hijacking::CreateFreeHook(address);
-      }
-
-      Hijacking::EnableHooks(addresses, numAddresses);
-
+    case Msg_FunctionHookFree:
+      InstallHooks(a_Message, "Free ", &Hijacking::CreateFreeHook);
       break;
-    }
     case Msg_FunctionHookRealloc: {
       // ULONG64* addresses = (ULONG64*)a_Message.GetData();
       // int numAddresses = a_Message.m_Size / sizeof( ULONG64 );
@@ -340,6 +435,12 @@ void TcpClient::DecodeMessage(Message& a_Message) {
       Hijacking::ClearFunctionArguments();
       break;
     }
+    case Msg_FunctionSamplingPolicies: {
+      Hijacking::SetSamplingPolicies(
+          (const FunctionSamplingPolicy*)a_Message.GetData(),
+          a_Message.m_Size / sizeof(FunctionSamplingPolicy));
+      break;
+    }
     case Msg_CallstackTracking: {
       ULONG64* addresses = (ULONG64*)a_Message.GetData();
       uint32_t numAddresses = (uint32_t)a_Message.m_Size / sizeof(ULONG64);
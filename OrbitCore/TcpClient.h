@@ -3,9 +3,14 @@
 //-----------------------------------
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include "TcpEntity.h"
+#include "WatchedMemory.h"
 
 class TcpClient : public TcpEntity {
  public:
@@ -16,11 +21,26 @@ class TcpClient : public TcpEntity {
   void Connect(const std::string& a_Host);
   void Start() override;
 
+  // Asks the service to compress the packets it sends on this connection.
+  void RequestCompression() { Send(Msg_CompressionRequest); }
+  // Asks the service to send its packets through a shared memory ring instead
+  // of the socket, see SharedMemoryRing.h. Only possible on a local
+  // connection.
+  void RequestSharedMemory();
+  // Whether the service runs on this host, as far as the connection tells.
+  bool IsLocalConnection() const { return m_IsLocalConnection; }
+  std::vector<std::string> GetStats();
+
  protected:
-  void ClientThread();
   void ReadMessage();
   void ReadPayload();
   void ReadFooter();
+  void ReadFrameHeader();
+  void ReadFrame();
+  void DecodePackets(std::vector<char>* a_Packets);
+  void WaitForDisconnection();
+  void ReadSharedMemory();
+  void StopReadingSharedMemory();
   void DecodeMessage(Message& a_Message);
   void OnError(const std::error_code& ec);
   virtual TcpSocket* GetSocket() override final { return m_TcpSocket; }
@@ -28,6 +48,30 @@ class TcpClient : public TcpEntity {
  private:
   Message m_Message;
   std::vector<char> m_Payload;
+
+  // Set once Msg_CompressionEnabled is received: from then on, the service
+  // only sends compressed frames, see TcpCompression.h.
+  std::atomic<bool> m_IsCompressed = false;
+  StreamDecompressor m_Decompressor;
+  uint32_t m_FrameSize = 0;
+  std::vector<char> m_Frame;
+  std::vector<char> m_DecompressedPackets;
+
+  std::atomic<bool> m_IsLocalConnection = false;
+  // Once Msg_SharedMemoryEnabled is received, the service sends all its
+  // packets through the ring, which is read on its own thread. The socket is
+  // then only read to detect the disconnection.
+  std::unique_ptr<SharedMemoryRing> m_SharedMemoryRing;
+  std::atomic<bool> m_IsSharedMemory = false;
+  std::thread m_SharedMemoryReader;
+  std::vector<char> m_SharedMemoryPackets;
+  char m_DisconnectionByte = 0;
+
+  // What the watched variables held when last read, see WatchedMemory.h.
+  WatchedMemoryReader m_WatchedMemoryReader;
+
+  std::atomic<uint64_t> m_NumCompressedBytesReceived = 0;
+  std::atomic<uint64_t> m_NumRawBytesReceived = 0;
 };
 
 extern std::unique_ptr<TcpClient> GTcpClient;
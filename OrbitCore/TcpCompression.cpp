@@ -0,0 +1,100 @@
+#include "TcpCompression.h"
+
+#include <zlib.h>
+
+#include <cstring>
+
+namespace {
+// Favor speed: the point is to save bandwidth on slow links without making
+// the sender thread the bottleneck.
+constexpr int kCompressionLevel = Z_BEST_SPEED;
+constexpr size_t kOutputChunkSize = 64 * 1024;
+}  // namespace
+
+StreamCompressor::StreamCompressor() : stream_(std::make_unique<z_stream>()) {
+  deflateInit(stream_.get(), kCompressionLevel);
+}
+
+StreamCompressor::~StreamCompressor() { deflateEnd(stream_.get()); }
+
+void StreamCompressor::Reset() { deflateReset(stream_.get()); }
+
+bool StreamCompressor::CompressFrame(const void* data, size_t size,
+                                     std::vector<char>* frame) {
+  BeginFrame(frame);
+  return Compress(data, size, frame) && EndFrame(frame);
+}
+
+void StreamCompressor::BeginFrame(std::vector<char>* frame) {
+  frame_begin_ = frame->size();
+  frame->resize(frame_begin_ + kCompressedFrameHeaderSize);
+}
+
+bool StreamCompressor::Compress(const void* data, size_t size,
+                                std::vector<char>* frame) {
+  if (size == 0) {
+    return true;
+  }
+  stream_->next_in = static_cast<Bytef*>(const_cast<void*>(data));
+  stream_->avail_in = static_cast<uInt>(size);
+  return Deflate(Z_NO_FLUSH, frame);
+}
+
+bool StreamCompressor::EndFrame(std::vector<char>* frame) {
+  stream_->next_in = nullptr;
+  stream_->avail_in = 0;
+  if (!Deflate(Z_SYNC_FLUSH, frame)) {
+    return false;
+  }
+
+  uint32_t compressed_size = static_cast<uint32_t>(
+      frame->size() - frame_begin_ - kCompressedFrameHeaderSize);
+  memcpy(frame->data() + frame_begin_, &compressed_size,
+         sizeof(compressed_size));
+  return true;
+}
+
+bool StreamCompressor::Deflate(int flush, std::vector<char>* frame) {
+  // Deflate is done with the input, or the flush, once it leaves space in
+  // the output.
+  do {
+    size_t offset = frame->size();
+    frame->resize(offset + kOutputChunkSize);
+    stream_->next_out = reinterpret_cast<Bytef*>(frame->data() + offset);
+    stream_->avail_out = kOutputChunkSize;
+    int result = deflate(stream_.get(), flush);
+    frame->resize(frame->size() - stream_->avail_out);
+    if (result != Z_OK && result != Z_BUF_ERROR) {
+      frame->resize(frame_begin_);
+      return false;
+    }
+  } while (stream_->avail_out == 0);
+  return true;
+}
+
+StreamDecompressor::StreamDecompressor()
+    : stream_(std::make_unique<z_stream>()) {
+  inflateInit(stream_.get());
+}
+
+StreamDecompressor::~StreamDecompressor() { inflateEnd(stream_.get()); }
+
+void StreamDecompressor::Reset() { inflateReset(stream_.get()); }
+
+bool StreamDecompressor::DecompressFrame(const void* data, size_t size,
+                                         std::vector<char>* output) {
+  stream_->next_in = static_cast<Bytef*>(const_cast<void*>(data));
+  stream_->avail_in = static_cast<uInt>(size);
+  do {
+    size_t offset = output->size();
+    output->resize(offset + kOutputChunkSize);
+    stream_->next_out = reinterpret_cast<Bytef*>(output->data() + offset);
+    stream_->avail_out = kOutputChunkSize;
+    int result = inflate(stream_.get(), Z_SYNC_FLUSH);
+    output->resize(output->size() - stream_->avail_out);
+    if (result != Z_OK && result != Z_BUF_ERROR) {
+      return false;
+    }
+  } while (stream_->avail_in > 0 || stream_->avail_out == 0);
+  return true;
+}
@@ -0,0 +1,65 @@
+#ifndef ORBIT_CORE_TCP_COMPRESSION_H_
+#define ORBIT_CORE_TCP_COMPRESSION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct z_stream_s;
+
+// Once compression has been negotiated on a connection (Msg_CompressionRequest
+// from the client, answered by a raw Msg_CompressionEnabled from the service),
+// every following packet of that connection is sent as a frame: a uint32_t
+// size followed by the compressed bytes of the packet. All frames of a
+// connection belong to a single zlib stream, flushed at the end of each frame,
+// so that repeated content across packets compresses well while every frame
+// can be decompressed as soon as it is received.
+constexpr size_t kCompressedFrameHeaderSize = sizeof(uint32_t);
+
+class StreamCompressor {
+ public:
+  StreamCompressor();
+  ~StreamCompressor();
+  StreamCompressor(const StreamCompressor&) = delete;
+  StreamCompressor& operator=(const StreamCompressor&) = delete;
+
+  // Starts a new stream, for a new connection.
+  void Reset();
+
+  // Appends a whole frame (header included) with the compressed data to
+  // frame. Returns false on failure.
+  bool CompressFrame(const void* data, size_t size, std::vector<char>* frame);
+
+  // Same as CompressFrame, for data in several pieces: BeginFrame, then
+  // Compress for each piece, then EndFrame, all with the same frame.
+  void BeginFrame(std::vector<char>* frame);
+  bool Compress(const void* data, size_t size, std::vector<char>* frame);
+  bool EndFrame(std::vector<char>* frame);
+
+ private:
+  bool Deflate(int flush, std::vector<char>* frame);
+
+  std::unique_ptr<z_stream_s> stream_;
+  size_t frame_begin_ = 0;
+};
+
+class StreamDecompressor {
+ public:
+  StreamDecompressor();
+  ~StreamDecompressor();
+  StreamDecompressor(const StreamDecompressor&) = delete;
+  StreamDecompressor& operator=(const StreamDecompressor&) = delete;
+
+  void Reset();
+
+  // Appends the decompressed content of a frame, without its header, to
+  // output. Returns false if the data is corrupted.
+  bool DecompressFrame(const void* data, size_t size,
+                       std::vector<char>* output);
+
+ private:
+  std::unique_ptr<z_stream_s> stream_;
+};
+
+#endif  // ORBIT_CORE_TCP_COMPRESSION_H_
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "TcpCompression.h"
+
+namespace {
+std::vector<char> DecompressFrames(const std::vector<char>& frames,
+                                   StreamDecompressor* decompressor) {
+  std::vector<char> output;
+  size_t offset = 0;
+  while (offset < frames.size()) {
+    uint32_t size;
+    memcpy(&size, frames.data() + offset, sizeof(size));
+    offset += kCompressedFrameHeaderSize;
+    EXPECT_TRUE(
+        decompressor->DecompressFrame(frames.data() + offset, size, &output));
+    offset += size;
+  }
+  return output;
+}
+}  // namespace
+
+TEST(TcpCompression, FramesRoundTrip) {
+  std::string first_packet = "first packet";
+  // Larger than the output chunks, and very compressible.
+  std::string second_packet(1024 * 1024, 'x');
+
+  StreamCompressor compressor;
+  std::vector<char> frames;
+  ASSERT_TRUE(compressor.CompressFrame(first_packet.data(), first_packet.size(),
+                                       &frames));
+  ASSERT_TRUE(compressor.CompressFrame(second_packet.data(),
+                                       second_packet.size(), &frames));
+  EXPECT_LT(frames.size(), second_packet.size() / 100);
+
+  StreamDecompressor decompressor;
+  std::vector<char> output = DecompressFrames(frames, &decompressor);
+  EXPECT_EQ(std::string(output.begin(), output.end()),
+            first_packet + second_packet);
+}
+
+TEST(TcpCompression, EachFrameDecompressesOnArrival) {
+  StreamCompressor compressor;
+  StreamDecompressor decompressor;
+  for (std::string packet : {"abc", "abcabc", ""}) {
+    std::vector<char> frame;
+    ASSERT_TRUE(compressor.CompressFrame(packet.data(), packet.size(), &frame));
+    std::vector<char> output = DecompressFrames(frame, &decompressor);
+    EXPECT_EQ(std::string(output.begin(), output.end()), packet);
+  }
+}
+
+TEST(TcpCompression, FrameInSeveralPieces) {
+  StreamCompressor compressor;
+  std::vector<char> frame;
+  compressor.BeginFrame(&frame);
+  ASSERT_TRUE(compressor.Compress("header", 6, &frame));
+  ASSERT_TRUE(compressor.Compress("", 0, &frame));
+  ASSERT_TRUE(compressor.Compress("payload", 7, &frame));
+  ASSERT_TRUE(compressor.EndFrame(&frame));
+
+  StreamDecompressor decompressor;
+  std::vector<char> output = DecompressFrames(frame, &decompressor);
+  EXPECT_EQ(std::string(output.begin(), output.end()), "headerpayload");
+}
+
+TEST(TcpCompression, ResetStartsNewStream) {
+  StreamCompressor compressor;
+  std::vector<char> frame;
+  ASSERT_TRUE(compressor.CompressFrame("abc", 3, &frame));
+
+  compressor.Reset();
+  frame.clear();
+  ASSERT_TRUE(compressor.CompressFrame("def", 3, &frame));
+
+  StreamDecompressor decompressor;
+  std::vector<char> output = DecompressFrames(frame, &decompressor);
+  EXPECT_EQ(std::string(output.begin(), output.end()), "def");
+}
+
+TEST(TcpCompression, CorruptedFrameFails) {
+  std::vector<char> garbage(16, '\xff');
+  StreamDecompressor decompressor;
+  std::vector<char> output;
+  EXPECT_FALSE(
+      decompressor.DecompressFrame(garbage.data(), garbage.size(), &output));
+}
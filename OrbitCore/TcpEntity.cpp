@@ -8,10 +8,40 @@
 
 #include "TcpEntity.h"
 
+#include <array>
+#include <utility>
+
 #include "Core.h"
 #include "Log.h"
+#include "OrbitBase/Logging.h"
 #include "Tcp.h"
 
+//-----------------------------------------------------------------------------
+bool IsBulkMessage(MessageType type) {
+  switch (type) {
+    case Msg_Timer:
+    case Msg_RemoteTimers:
+    case Msg_SamplingCallstacks:
+    case Msg_SamplingHashedCallstacks:
+    case Msg_RemoteContextSwitches:
+    case Msg_RemoteCoreActivities:
+    case Msg_RemoteThreadStateChanges:
+    case Msg_OffCpuCallstacks:
+    case Msg_SampleHistogram:
+    case Msg_UserDataBatch:
+    case Msg_ContinuousWindow:
+      return true;
+    default:
+      return false;
+  }
+}
+
+namespace {
+// How long the sender waits for room in the ring before checking whether the
+// connection is still alive.
+constexpr uint32_t kSharedMemoryWriteTimeoutMs = 100;
+}  // namespace
+
 //-----------------------------------------------------------------------------
 TcpEntity::TcpEntity()
     : m_NumQueuedEntries(0),
@@ -31,7 +61,10 @@ TcpEntity::~TcpEntity() {}
 void TcpEntity::Start() {
   PRINT_FUNC;
   m_ExitRequested = false;
-  m_SenderThread = new std::thread([&]() { SendData(); });
+  // A chain cut short by Stop never ended.
+  m_IsWriting = false;
+  m_TcpService->Run(kNumIoThreads, L"OrbitTcpIo");
+  StartWriting();
 }
 
 //-----------------------------------------------------------------------------
@@ -39,27 +72,37 @@ void TcpEntity::Stop() {
   PRINT_FUNC;
   m_ExitRequested = true;
 
-  m_ConditionVariable.signal();
-  if (m_SenderThread != nullptr) {
-    m_SenderThread->join();
-  }
-
   if (m_TcpSocket && m_TcpSocket->m_Socket) {
     if (m_TcpSocket->m_Socket->is_open()) {
       m_TcpSocket->m_Socket->close();
     }
   }
   if (m_TcpService && m_TcpService->m_IoService) {
-    m_TcpService->m_IoService->stop();
+    m_TcpService->Stop();
   }
 }
 
 //-----------------------------------------------------------------------------
 void TcpEntity::SendMsg(Message& a_Message, const void* a_Payload) {
-  TcpPacket buffer(a_Message, a_Payload);
-  m_SendQueue.enqueue(buffer);
+  SendPacket(TcpPacket(a_Message, a_Payload));
+}
+
+//-----------------------------------------------------------------------------
+void TcpEntity::SendPacket(TcpPacket&& packet) {
+  PublishPacket(packet);
+  if (IsBulkMessage(packet.GetType())) {
+    m_BulkSendQueue.enqueue(std::move(packet));
+  } else {
+    m_ControlSendQueue.enqueue(std::move(packet));
+  }
   ++m_NumQueuedEntries;
-  m_ConditionVariable.signal();
+  StartWriting();
+}
+
+//-----------------------------------------------------------------------------
+bool TcpEntity::DequeuePacket(TcpPacket* packet) {
+  return m_ControlSendQueue.try_dequeue(*packet) ||
+         m_BulkSendQueue.try_dequeue(*packet);
 }
 
 //-----------------------------------------------------------------------------
@@ -67,11 +110,14 @@ void TcpEntity::FlushSendQueue() {
   m_FlushRequested = true;
 
   const size_t numItems = 4096;
-  TcpPacket Timers[numItems];
+  std::vector<TcpPacket> packets(numItems);
   m_NumFlushedItems = 0;
 
   while (!m_ExitRequested) {
-    size_t numDequeued = m_SendQueue.try_dequeue_bulk(Timers, numItems);
+    size_t numDequeued =
+        m_ControlSendQueue.try_dequeue_bulk(packets.begin(), numItems);
+    numDequeued += m_BulkSendQueue.try_dequeue_bulk(
+        packets.begin() + numDequeued, numItems - numDequeued);
 
     if (numDequeued == 0) break;
 
@@ -80,39 +126,210 @@ void TcpEntity::FlushSendQueue() {
   }
 
   m_FlushRequested = false;
-  m_ConditionVariable.signal();
+  StartWriting();
 }
 
 //-----------------------------------------------------------------------------
-void TcpEntity::SendData() {
-  SetCurrentThreadName(L"TcpSender");
+void TcpEntity::StartWriting() {
+  // Most packets are queued while the chain runs, which then writes them.
+  if (!m_IsValid || m_ExitRequested || m_FlushRequested || m_IsWriting ||
+      m_IsWriting.exchange(true)) {
+    return;
+  }
 
-  while (!m_ExitRequested) {
-    // Wait for non-empty queue
-    while ((!m_IsValid || m_NumQueuedEntries <= 0) && !m_ExitRequested) {
-      m_ConditionVariable.wait();
+  TcpSocket* socket = GetSocket();
+  if (socket == nullptr || socket->m_Socket == nullptr ||
+      socket->m_Strand == nullptr) {
+    // Nobody to send them to.
+    TcpPacket packet;
+    while (DequeuePacket(&packet)) {
+      --m_NumQueuedEntries;
+      ORBIT_ERROR;
     }
+    StopWriting();
+    return;
+  }
+  asio::post(*socket->m_Strand, [this, socket]() { WriteNext(socket); });
+}
 
-    // Send messages
-    TcpPacket buffer;
-    while (m_IsValid && !m_ExitRequested && !m_FlushRequested &&
-           m_SendQueue.try_dequeue(buffer)) {
-      --m_NumQueuedEntries;
-      TcpSocket* socket = GetSocket();
-      if (socket && socket->m_Socket && socket->m_Socket->is_open()) {
-        asio::write(*socket->m_Socket, SharedConstBuffer(buffer));
-      } else {
-        ORBIT_ERROR;
+//-----------------------------------------------------------------------------
+void TcpEntity::WriteNext(TcpSocket* socket) {
+  // Control messages first.
+  if (!m_IsValid || m_ExitRequested || m_FlushRequested ||
+      !DequeuePacket(&m_WritePacket)) {
+    StopWriting();
+    return;
+  }
+  --m_NumQueuedEntries;
+  if (!socket->m_Socket->is_open()) {
+    ORBIT_ERROR;
+    StopWriting();
+    return;
+  }
+
+  if (socket == m_SharedMemorySocket) {
+    SendSharedMemory(socket, m_WritePacket);
+    // Posted rather than called, for the strand to read meanwhile.
+    asio::post(*socket->m_Strand, [this, socket]() { WriteNext(socket); });
+    return;
+  }
+
+  auto on_written = asio::bind_executor(
+      *socket->m_Strand,
+      [this, socket](const std::error_code& error, size_t num_bytes) {
+        OnPacketWritten(socket, error, num_bytes);
+      });
+  if (socket == m_CompressedSocket) {
+    if (!CompressPacket(m_WritePacket)) {
+      ORBIT_ERROR;
+      asio::post(*socket->m_Strand, [this, socket]() { WriteNext(socket); });
+      return;
+    }
+    asio::async_write(*socket->m_Socket, asio::buffer(m_CompressedFrame),
+                      std::move(on_written));
+    return;
+  }
+  std::array<asio::const_buffer, 3> buffers = {
+      asio::buffer(&m_WritePacket.GetHeader(), sizeof(Message)),
+      asio::buffer(m_WritePacket.GetPayload(), m_WritePacket.GetPayloadSize()),
+      asio::buffer(&TcpPacket::kFooter, sizeof(TcpPacket::kFooter))};
+  asio::async_write(*socket->m_Socket, buffers, std::move(on_written));
+}
+
+//-----------------------------------------------------------------------------
+void TcpEntity::OnPacketWritten(TcpSocket* socket, const std::error_code& error,
+                                size_t num_bytes) {
+  if (error) {
+    ERROR("Writing to the socket: %s", error.message().c_str());
+    StopWriting();
+    return;
+  }
+  m_NumRawBytesSent += m_WritePacket.GetSize();
+  m_NumCompressedBytesSent += num_bytes;
+
+  // The acknowledgement itself is sent raw, all following packets are
+  // compressed.
+  if (socket != m_CompressedSocket) {
+    if (m_WritePacket.GetType() == Msg_CompressionEnabled) {
+      m_Compressor.Reset();
+      m_CompressedSocket = socket;
+    } else if (m_WritePacket.GetType() == Msg_SharedMemoryEnabled) {
+      if (m_SharedMemoryRing != nullptr) {
+        m_SharedMemoryRing->Close();
       }
+      ScopeLock lock(m_SharedMemoryMutex);
+      m_SharedMemoryRing = std::move(m_PendingSharedMemoryRing);
+      m_SharedMemorySocket = socket;
     }
   }
+  WriteNext(socket);
+}
+
+//-----------------------------------------------------------------------------
+void TcpEntity::StopWriting() {
+  m_IsWriting = false;
+  // Packets queued after the last one was dequeued, by threads which saw the
+  // chain running.
+  if (m_NumQueuedEntries > 0) {
+    StartWriting();
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool TcpEntity::CompressPacket(const TcpPacket& packet) {
+  m_CompressedFrame.clear();
+  m_Compressor.BeginFrame(&m_CompressedFrame);
+  if (!m_Compressor.Compress(&packet.GetHeader(), sizeof(Message),
+                             &m_CompressedFrame) ||
+      !m_Compressor.Compress(packet.GetPayload(), packet.GetPayloadSize(),
+                             &m_CompressedFrame) ||
+      !m_Compressor.Compress(&TcpPacket::kFooter, sizeof(TcpPacket::kFooter),
+                             &m_CompressedFrame) ||
+      !m_Compressor.EndFrame(&m_CompressedFrame)) {
+    return false;
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void TcpEntity::SendSharedMemory(TcpSocket* socket, TcpPacket& packet) {
+  // The client has gone away, nobody reads the ring anymore.
+  if (m_SharedMemoryRing->IsClosed()) {
+    return;
+  }
+
+  std::array<std::pair<const void*, size_t>, 3> pieces = {
+      {{&packet.GetHeader(), sizeof(Message)},
+       {packet.GetPayload(), packet.GetPayloadSize()},
+       {&TcpPacket::kFooter, sizeof(TcpPacket::kFooter)}}};
+  for (const auto& [data, size] : pieces) {
+    size_t num_written = 0;
+    while (num_written < size) {
+      if (m_ExitRequested || m_SharedMemoryRing->IsClosed() ||
+          !socket->m_Socket->is_open()) {
+        ERROR("Shared memory connection lost");
+        m_SharedMemoryRing->Close();
+        return;
+      }
+      num_written += m_SharedMemoryRing->Write(
+          static_cast<const char*>(data) + num_written, size - num_written,
+          kSharedMemoryWriteTimeoutMs);
+    }
+  }
+  m_NumRawBytesSent += packet.GetSize();
+  m_NumCompressedBytesSent += packet.GetSize();
+}
+
+//-----------------------------------------------------------------------------
+bool TcpEntity::AcceptSharedMemory(const std::string& a_Name) {
+  std::unique_ptr<SharedMemoryRing> ring = SharedMemoryRing::Open(a_Name);
+  if (ring == nullptr) {
+    return false;
+  }
+  {
+    ScopeLock lock(m_SharedMemoryMutex);
+    m_PendingSharedMemoryRing = std::move(ring);
+  }
+  m_SharedMemoryRequestSocket = GetSocket();
+  // The ring is used by the write chain right after this is sent.
+  Send(Msg_SharedMemoryEnabled);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void TcpEntity::AddWorkerCallback(MessageType a_MsgType, uint32_t a_Stream,
+                                  MsgCallback a_Callback) {
+  if (m_WorkerPool == nullptr) {
+    m_WorkerPool = std::make_unique<MessageWorkerPool>(kNumMessageWorkers);
+  }
+  WorkerCallbacks& worker_callbacks = m_WorkerCallbacks[a_MsgType];
+  worker_callbacks.m_Stream = a_Stream;
+  worker_callbacks.m_Callbacks.push_back(std::move(a_Callback));
 }
 
 //-----------------------------------------------------------------------------
 void TcpEntity::Callback(const Message& a_Message) {
   MessageType type = a_Message.GetType();
+  // Worker threads
+  const auto& worker_pair = m_WorkerCallbacks.find(type);
+  if (worker_pair != m_WorkerCallbacks.end()) {
+    // The payload of a_Message is only valid until we return.
+    auto message_owner = std::make_shared<MessageOwner>(a_Message);
+    const WorkerCallbacks* worker_callbacks = &worker_pair->second;
+    m_WorkerPool->Post(worker_callbacks->m_Stream,
+                       [worker_callbacks, message_owner] {
+                         for (const MsgCallback& callback :
+                              worker_callbacks->m_Callbacks) {
+                           callback(*message_owner);
+                         }
+                       });
+  }
+
   // Non main thread
   std::vector<MsgCallback>& callbacks = m_Callbacks[type];
+  if (!callbacks.empty() && m_WorkerPool != nullptr) {
+    m_WorkerPool->WaitUntilIdle();
+  }
   for (MsgCallback& callback : callbacks) {
     callback(a_Message);
   }
@@ -4,44 +4,75 @@
 #pragma once
 
 #include <atomic>
+#include <memory>
+#include <system_error>
 #include <type_traits>
 #include <unordered_map>
 #include <vector>
 
-#include "../OrbitPlugin/OrbitUserData.h"
 #include "Message.h"
+#include "MessageWorkerPool.h"
+#include "SharedMemoryRing.h"
+#include "TcpCompression.h"
 #include "TcpForward.h"
 #include "Threading.h"
 #include "Utils.h"
 
+// Messages that can be large and are sent continuously during a capture.
+bool IsBulkMessage(MessageType type);
+
 //-----------------------------------------------------------------------------
+// A message as queued for the write chain. The header is stored inline and
+// the payload is either copied or moved in by the Send overloads taking
+// ownership. The header, payload and footer are written to the socket as a
+// single gather write, without being assembled into one buffer.
 class TcpPacket {
  public:
+  static constexpr uint32_t kFooter = MAGIC_FOOT_MSG;
+
   TcpPacket() {}
   explicit TcpPacket(const Message& a_Message, const void* a_Payload)
-      : m_Data(new std::vector<char>()) {
-    m_Data->resize(sizeof(Message) + a_Message.m_Size + 4);
-    memcpy(m_Data->data(), &a_Message, sizeof(Message));
-
+      : m_Header(a_Message) {
+    if (a_Message.m_Size == 0) {
+      return;
+    }
+    auto payload = std::make_shared<std::vector<char>>(a_Message.m_Size);
     if (a_Payload) {
-      memcpy(m_Data->data() + sizeof(Message), a_Payload, a_Message.m_Size);
+      memcpy(payload->data(), a_Payload, a_Message.m_Size);
     }
-
-    // Footer
-    const unsigned int footer = MAGIC_FOOT_MSG;
-    memcpy(m_Data->data() + sizeof(Message) + a_Message.m_Size, &footer, 4);
+    m_Payload = payload->data();
+    m_PayloadOwner = std::move(payload);
   }
 
+  // Takes ownership of the payload, which is not copied. Container is a
+  // contiguous container whose data() holds at least a_Message.m_Size bytes.
+  template <typename Container>
+  TcpPacket(const Message& a_Message, std::shared_ptr<Container> a_Payload)
+      : m_Header(a_Message),
+        m_Payload(a_Payload->data()),
+        m_PayloadOwner(std::move(a_Payload)) {}
+
   void Dump() const {
-    std::cout << "TcpPacket [" << std::dec << (uint32_t)m_Data->size()
+    std::cout << "TcpPacket [" << std::dec << (uint32_t)GetSize()
               << " bytes]" << std::endl;
-    PrintBuffer(m_Data->data(), (uint32_t)m_Data->size());
+    PrintBuffer(&m_Header, sizeof(Message));
+    if (m_Payload != nullptr) {
+      PrintBuffer(m_Payload, m_Header.m_Size);
+    }
   }
 
-  std::shared_ptr<std::vector<char>> Data() { return m_Data; };
+  const Message& GetHeader() const { return m_Header; }
+  const void* GetPayload() const { return m_Payload; }
+  uint32_t GetPayloadSize() const { return m_Payload ? m_Header.m_Size : 0; }
+  size_t GetSize() const {
+    return sizeof(Message) + GetPayloadSize() + sizeof(kFooter);
+  }
+  MessageType GetType() const { return m_Header.GetType(); }
 
  private:
-  std::shared_ptr<std::vector<char>> m_Data;
+  Message m_Header;
+  const void* m_Payload = nullptr;
+  std::shared_ptr<const void> m_PayloadOwner;
 };
 
 //-----------------------------------------------------------------------------
@@ -63,7 +94,6 @@ class TcpEntity {
   inline void Send(Message& a_Message);
   inline void Send(const std::string& a_String);
   inline void Send(OrbitLogEntry& a_Entry);
-  inline void Send(Orbit::UserData& a_Entry);
   inline void Send(MessageType type, const void* data, size_t size);
   inline void Send(Message& message, const void* data, size_t size);
 
@@ -71,6 +101,14 @@ class TcpEntity {
   void Send(Message& a_Message, const std::vector<T>& a_Vector);
   template <class T>
   void Send(MessageType a_Type, const std::vector<T>& a_Vector);
+  // These take ownership of the payload instead of copying it.
+  template <class T>
+  void Send(Message& a_Message, std::vector<T>&& a_Vector);
+  template <class T>
+  void Send(MessageType a_Type, std::vector<T>&& a_Vector);
+  // Sends the bytes of data, without a null terminator, e.g. serialized
+  // objects.
+  inline void SendBytes(MessageType type, std::string&& data);
   template <class T>
   void Send(Message& a_Message, const T& a_Item);
   template <class T>
@@ -89,21 +127,60 @@ class TcpEntity {
   void AddMainThreadCallback(MessageType a_MsgType, MsgCallback a_Callback) {
     m_MainThreadCallbacks[a_MsgType].push_back(a_Callback);
   }
+  // The callbacks of messages of a_MsgType run on a worker thread instead of
+  // the thread reading the socket. Messages of the same stream are processed
+  // in the order they were received, messages of different streams possibly
+  // concurrently. Messages with regular callbacks are only processed once all
+  // the messages received before them have been.
+  void AddWorkerCallback(MessageType a_MsgType, uint32_t a_Stream,
+                         MsgCallback a_Callback);
   void Callback(const Message& a_Message);
   void ProcessMainThreadCallbacks();
   bool IsValid() const { return m_IsValid; }
 
+  uint64_t GetNumRawBytesSent() const { return m_NumRawBytesSent; }
+  uint64_t GetNumCompressedBytesSent() const {
+    return m_NumCompressedBytesSent;
+  }
+
  protected:
   void SendMsg(Message& a_Message, const void* a_Payload);
+  void SendPacket(TcpPacket&& packet);
+  // Called with every packet before it is queued.
+  virtual void PublishPacket(const TcpPacket& /*packet*/) {}
+  bool DequeuePacket(TcpPacket* packet);
   virtual TcpSocket* GetSocket() = 0;
-  void SendData();
+  // The queued packets are written by a chain of asynchronous writes on the
+  // strand of the socket, one packet after the other, which ends when the
+  // queues are empty. This starts one unless it is running.
+  void StartWriting();
+  void WriteNext(TcpSocket* socket);
+  void OnPacketWritten(TcpSocket* socket, const std::error_code& error,
+                       size_t num_bytes);
+  void StopWriting();
+  // Into m_CompressedFrame.
+  bool CompressPacket(const TcpPacket& packet);
+  // Blocks the I/O thread until the packet fits in the ring.
+  void SendSharedMemory(TcpSocket* socket, TcpPacket& packet);
+  // Opens the ring the client asked for in Msg_SharedMemoryRequest and answers
+  // with Msg_SharedMemoryEnabled. Returns false, and the connection stays on
+  // the socket, if the ring can't be opened, e.g. if the client is not on
+  // this host after all.
+  bool AcceptSharedMemory(const std::string& a_Name);
+  bool UsesSharedMemory(TcpSocket* socket) const {
+    return socket == m_SharedMemoryRequestSocket;
+  }
 
  protected:
   TcpService* m_TcpService;
   TcpSocket* m_TcpSocket;
-  std::thread* m_SenderThread = nullptr;
-  AutoResetEvent m_ConditionVariable;
-  LockFreeQueue<TcpPacket> m_SendQueue;
+  // Threads running the io_context of m_TcpService.
+  static constexpr size_t kNumIoThreads = 4;
+  // Packets of the capture data messages go to the bulk queue, all others to
+  // the control queue, which the write chain always drains first: a control
+  // packet waits for at most the one bulk packet being written.
+  LockFreeQueue<TcpPacket> m_ControlSendQueue;
+  LockFreeQueue<TcpPacket> m_BulkSendQueue;
   std::atomic<uint32_t> m_NumQueuedEntries;
   std::atomic<bool> m_ExitRequested;
   std::atomic<bool> m_FlushRequested;
@@ -111,8 +188,39 @@ class TcpEntity {
   Mutex m_Mutex;
   std::atomic<bool> m_IsValid;
 
+  // Whether a write chain is running. The members below are only accessed by
+  // the write chain, which only runs on one strand at a time.
+  std::atomic<bool> m_IsWriting = false;
+  // Being written.
+  TcpPacket m_WritePacket;
+  // Packets are compressed on the socket for which Msg_CompressionEnabled was
+  // sent, see TcpCompression.h.
+  TcpSocket* m_CompressedSocket = nullptr;
+  StreamCompressor m_Compressor;
+  std::vector<char> m_CompressedFrame;
+  std::atomic<uint64_t> m_NumRawBytesSent = 0;
+  std::atomic<uint64_t> m_NumCompressedBytesSent = 0;
+
+  // Handed over to the write chain when it sends Msg_SharedMemoryEnabled.
+  // From then on, the packets of that socket go through the ring instead,
+  // see SharedMemoryRing.h.
+  Mutex m_SharedMemoryMutex;
+  std::unique_ptr<SharedMemoryRing> m_PendingSharedMemoryRing;
+  std::atomic<TcpSocket*> m_SharedMemoryRequestSocket = nullptr;
+  // Only accessed by the write chain.
+  TcpSocket* m_SharedMemorySocket = nullptr;
+  std::unique_ptr<SharedMemoryRing> m_SharedMemoryRing;
+
   std::unordered_map<int, std::vector<MsgCallback>> m_Callbacks;
   std::unordered_map<int, std::vector<MsgCallback>> m_MainThreadCallbacks;
+
+  struct WorkerCallbacks {
+    uint32_t m_Stream = 0;
+    std::vector<MsgCallback> m_Callbacks;
+  };
+  static constexpr size_t kNumMessageWorkers = 4;
+  std::unordered_map<int, WorkerCallbacks> m_WorkerCallbacks;
+  std::unique_ptr<MessageWorkerPool> m_WorkerPool;
   std::vector<std::shared_ptr<MessageOwner>> m_MainThreadMessages;
 };
 
@@ -134,41 +242,13 @@ inline void TcpEntity::Send(const std::string& a_String) {
 
 //-----------------------------------------------------------------------------
 void TcpEntity::Send(OrbitLogEntry& a_Entry) {
-  char stackBuffer[1024];
-  uint32_t entrySize = (uint32_t)a_Entry.GetBufferSize();
-  bool needsAlloc = entrySize > 1024;
-  char* buffer = !needsAlloc ? stackBuffer : new char[entrySize];
+  auto buffer = std::make_shared<std::vector<char>>(a_Entry.GetBufferSize());
+  memcpy(buffer->data(), &a_Entry, a_Entry.GetSizeWithoutString());
+  memcpy(buffer->data() + a_Entry.GetSizeWithoutString(),
+         a_Entry.m_Text.c_str(), a_Entry.GetStringSize());
 
-  memcpy(buffer, &a_Entry, a_Entry.GetSizeWithoutString());
-  memcpy(buffer + a_Entry.GetSizeWithoutString(), a_Entry.m_Text.c_str(),
-         a_Entry.GetStringSize());
-
-  Message msg(Msg_OrbitLog, entrySize);
-  SendMsg(msg, buffer);
-
-  if (needsAlloc) {
-    delete buffer;
-  }
-}
-
-//-----------------------------------------------------------------------------
-void TcpEntity::Send(Orbit::UserData& a_UserData) {
-  Message msg(Msg_UserData);
-  msg.m_Size = sizeof(Orbit::UserData) + a_UserData.m_NumBytes;
-
-  char stackBuffer[1024];
-  bool needsAlloc = msg.m_Size > 1024;
-  char* buffer = !needsAlloc ? stackBuffer : new char[msg.m_Size];
-
-  memcpy(buffer, &a_UserData, sizeof(Orbit::UserData));
-  memcpy(buffer + sizeof(Orbit::UserData), a_UserData.m_Data,
-         a_UserData.m_NumBytes);
-
-  SendMsg(msg, buffer);
-
-  if (needsAlloc) {
-    delete buffer;
-  }
+  Message msg(Msg_OrbitLog, (uint32_t)buffer->size());
+  SendPacket(TcpPacket(msg, std::move(buffer)));
 }
 
 //-----------------------------------------------------------------------------
@@ -185,6 +265,27 @@ void TcpEntity::Send(MessageType a_Type, const std::vector<T>& a_Vector) {
   Send(msg, a_Vector);
 }
 
+//-----------------------------------------------------------------------------
+template <class T>
+void TcpEntity::Send(Message& a_Message, std::vector<T>&& a_Vector) {
+  a_Message.m_Size = (uint32_t)a_Vector.size() * sizeof(T);
+  SendPacket(TcpPacket(
+      a_Message, std::make_shared<std::vector<T>>(std::move(a_Vector))));
+}
+
+//-----------------------------------------------------------------------------
+template <class T>
+void TcpEntity::Send(MessageType a_Type, std::vector<T>&& a_Vector) {
+  Message msg(a_Type);
+  Send(msg, std::move(a_Vector));
+}
+
+//-----------------------------------------------------------------------------
+void TcpEntity::SendBytes(MessageType type, std::string&& data) {
+  Message msg(type, (uint32_t)data.size());
+  SendPacket(TcpPacket(msg, std::make_shared<std::string>(std::move(data))));
+}
+
 //-----------------------------------------------------------------------------
 template <class T>
 void TcpEntity::Send(Message& a_Message, const T& a_Item) {
@@ -4,7 +4,10 @@
 
 #include "TcpServer.h"
 
-#include <thread>
+#include <array>
+#include <cstring>
+#include <utility>
+#include <vector>
 
 #include "Callstack.h"
 #include "Capture.h"
@@ -12,12 +15,14 @@
 #include "Context.h"
 #include "Core.h"
 #include "Log.h"
+#include "OrbitBase/Logging.h"
 #include "OrbitAsio.h"
 #include "OrbitProcess.h"
 #include "OrbitUnreal.h"
 #include "SamplingProfiler.h"
 #include "Tcp.h"
 #include "TimerManager.h"
+#include "UnrealObjectNames.h"
 #include "VariableTracing.h"
 
 TcpServer* GTcpServer;
@@ -43,19 +48,15 @@ TcpServer::~TcpServer() { delete m_TcpServer; }
 
 //-----------------------------------------------------------------------------
 void TcpServer::Start(unsigned short a_Port) {
-  TcpEntity::Start();
-
   PRINT_FUNC;
   m_TcpService = new TcpService();
   m_TcpServer = new tcp_server(*m_TcpService->m_IoService, a_Port);
 
   PRINT_VAR(a_Port);
 
-  std::thread t([&]() { this->ServerThread(); });
-  t.detach();
-
   m_StatTimer.Start();
   m_IsValid = true;
+  TcpEntity::Start();
 }
 
 //-----------------------------------------------------------------------------
@@ -92,6 +93,37 @@ TcpSocket* TcpServer::GetSocket() {
   return m_TcpServer != nullptr ? m_TcpServer->GetSocket() : nullptr;
 }
 
+//-----------------------------------------------------------------------------
+void TcpServer::AddCaptureSubscriber(
+    std::shared_ptr<TcpConnection> connection) {
+  PRINT_FUNC;
+  // A client that controlled the capture only watches it from now on.
+  if (m_TcpServer != nullptr &&
+      m_TcpServer->GetSocket() == &connection->GetSocket()) {
+    m_TcpServer->Disconnect();
+  }
+  // Written raw: compression and shared memory are only negotiated with the
+  // controlling client.
+  m_CaptureSubscribers.Add([connection](const TcpPacket& packet) {
+    tcp::socket* socket = connection->GetSocket().m_Socket;
+    if (socket == nullptr || !socket->is_open()) {
+      return false;
+    }
+    std::array<asio::const_buffer, 3> buffers = {
+        asio::buffer(&packet.GetHeader(), sizeof(Message)),
+        asio::buffer(packet.GetPayload(), packet.GetPayloadSize()),
+        asio::buffer(&TcpPacket::kFooter, sizeof(TcpPacket::kFooter))};
+    asio::error_code error;
+    asio::write(*socket, buffers, error);
+    return !error;
+  });
+}
+
+//-----------------------------------------------------------------------------
+void TcpServer::PublishPacket(const TcpPacket& packet) {
+  m_CaptureSubscribers.Publish(packet);
+}
+
 //-----------------------------------------------------------------------------
 void TcpServer::Receive(const Message& a_Message) {
   const Message::Header& MessageHeader = a_Message.GetHeader();
@@ -136,7 +168,8 @@ void TcpServer::Receive(const Message& a_Message) {
       m_NumTargetFlushedTcpPackets = *((uint32_t*)a_Message.GetData());
       break;
     case Msg_NumInstalledHooks:
-      Capture::GNumInstalledHooks = *((uint32_t*)a_Message.GetData());
+      // Sent once per batch of hooks enabled.
+      Capture::GNumInstalledHooks += *((uint32_t*)a_Message.GetData());
       break;
     case Msg_Callstack: {
       CallStackPOD* callstackPOD = (CallStackPOD*)a_Message.GetData();
@@ -161,6 +194,31 @@ void TcpServer::Receive(const Message& a_Message) {
 
       break;
     }
+    case Msg_OrbitUnrealObjects: {
+      std::vector<std::pair<uint64_t, std::wstring>> names;
+      if (!DecodeUObjectNames(a_Message.GetData(), a_Message.m_Size, &names)) {
+        ERROR("Invalid Unreal object names of size %u", a_Message.m_Size);
+        break;
+      }
+      for (auto& name : names) {
+        GOrbitUnreal.GetObjectNames()[name.first] = std::move(name.second);
+      }
+      break;
+    }
+    case Msg_CompressionRequest:
+      // Pointless on top of a shared memory, which the client asks for first.
+      if (!UsesSharedMemory(GetSocket())) {
+        // Compression starts on the sender thread right after this is sent.
+        Send(Msg_CompressionEnabled);
+      }
+      break;
+    case Msg_SharedMemoryRequest: {
+      const char* name = a_Message.GetData();
+      if (name != nullptr && a_Message.m_Size > 0) {
+        AcceptSharedMemory(std::string(name, strnlen(name, a_Message.m_Size)));
+      }
+      break;
+    }
     case Msg_ThreadInfo: {
       std::string threadName(a_Message.GetData());
       Capture::GTargetProcess->SetThreadName(a_Message.m_ThreadId, threadName);
@@ -248,10 +306,3 @@ void TcpServer::Disconnect() {
 bool TcpServer::HasConnection() {
   return m_TcpServer != nullptr && m_TcpServer->HasConnection();
 }
-
-//-----------------------------------------------------------------------------
-void TcpServer::ServerThread() {
-  PRINT_FUNC;
-  SetCurrentThreadName(L"TcpServer");
-  m_TcpService->m_IoService->run();
-}
@@ -4,8 +4,10 @@
 #pragma once
 
 #include <functional>
+#include <memory>
 #include <unordered_map>
 
+#include "CaptureSubscribers.h"
 #include "Core.h"
 #include "ScopeTimer.h"
 #include "TcpEntity.h"
@@ -39,6 +41,15 @@ class TcpServer : public TcpEntity {
 
   bool IsLocalConnection();
 
+  // Service side. From now on, the capture data is also sent to connection,
+  // which only watches the capture: its other messages are ignored, as the
+  // answers would go to the client controlling the capture. See
+  // CaptureSubscribers.
+  void AddCaptureSubscriber(std::shared_ptr<class TcpConnection> connection);
+  size_t GetNumCaptureSubscribers() const {
+    return m_CaptureSubscribers.GetNumSubscribers();
+  }
+
   class tcp_server* GetServer() {
     return m_TcpServer;
   }
@@ -48,12 +59,13 @@ class TcpServer : public TcpEntity {
 
  protected:
   class TcpSocket* GetSocket() override final;
-  void ServerThread();
+  void PublishPacket(const TcpPacket& packet) override;
 
  private:
   class tcp_server* m_TcpServer = nullptr;
   StrCallback m_UiCallback;
   moodycamel::ConcurrentQueue<std::wstring> m_UiLockFreeQueue;
+  CaptureSubscribers m_CaptureSubscribers;
 
   Timer m_StatTimer;
   ULONG64 m_LastNumMessages;
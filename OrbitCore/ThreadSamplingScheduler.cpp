@@ -0,0 +1,74 @@
+#include "ThreadSamplingScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Weight of the latest walk in the moving average of the cost of walks.
+constexpr double kWalkCostSmoothing = 0.25;
+}  // namespace
+
+ThreadSamplingScheduler::Sample ThreadSamplingScheduler::Schedule(
+    uint32_t tid, double now_ms, uint64_t cycles) {
+  ThreadState& state = threads_[tid];
+  Sample sample;
+  bool idle = false;
+  if (!state.sampled) {
+    state.sampled = true;
+    sample.weight = 1;
+  } else {
+    idle = cycles == state.last_cycles && state.last_callstack != 0;
+    double period_ms = idle ? min_period_ms_ : GetPeriodMs(state);
+    double elapsed_ms = now_ms - state.last_sample_ms;
+    if (elapsed_ms < period_ms) {
+      return sample;
+    }
+    sample.weight = std::max<uint32_t>(
+        1, static_cast<uint32_t>(std::lround(elapsed_ms / min_period_ms_)));
+  }
+  sample.decision = idle ? Decision::kRepeat : Decision::kWalk;
+
+  if (state.running != !idle) {
+    state.running = !idle;
+    if (idle) {
+      --num_running_threads_;
+    } else {
+      ++num_running_threads_;
+    }
+  }
+  state.last_cycles = cycles;
+  state.last_sample_ms = now_ms;
+  return sample;
+}
+
+void ThreadSamplingScheduler::OnWalked(uint32_t tid, double walk_ms,
+                                       uint64_t callstack_id) {
+  ThreadState& state = threads_[tid];
+  state.walk_ms = state.walk_ms == 0.0
+                      ? walk_ms
+                      : state.walk_ms +
+                            kWalkCostSmoothing * (walk_ms - state.walk_ms);
+  if (callstack_id != 0) {
+    state.last_callstack = callstack_id;
+  }
+}
+
+uint64_t ThreadSamplingScheduler::GetLastCallstack(uint32_t tid) const {
+  auto it = threads_.find(tid);
+  return it != threads_.end() ? it->second.last_callstack : 0;
+}
+
+double ThreadSamplingScheduler::GetPeriodMs(uint32_t tid) const {
+  auto it = threads_.find(tid);
+  return it != threads_.end() ? GetPeriodMs(it->second) : min_period_ms_;
+}
+
+double ThreadSamplingScheduler::GetPeriodMs(const ThreadState& state) const {
+  if (overhead_budget_ <= 0.0) {
+    return min_period_ms_;
+  }
+  // Each of the running threads gets an equal share of the budget.
+  double num_threads = std::max<uint32_t>(1, num_running_threads_);
+  return std::max(min_period_ms_,
+                  state.walk_ms * num_threads / overhead_budget_);
+}
@@ -0,0 +1,68 @@
+#ifndef ORBIT_CORE_THREAD_SAMPLING_SCHEDULER_H_
+#define ORBIT_CORE_THREAD_SAMPLING_SCHEDULER_H_
+
+#include <cstdint>
+
+#include "absl/container/flat_hash_map.h"
+
+// Decides which threads the sampler walks on each of its ticks, so that
+// sampling a process with hundreds of threads doesn't stall it:
+// - a thread that hasn't run since its previous sample, as told by its cycle
+//   counter, is still where it was and is counted with its previous callstack
+//   without being suspended;
+// - each thread that runs is walked at most once per its own period, which
+//   grows with the measured cost of walking it so that walking all running
+//   threads takes at most overhead_budget of the time.
+// Samples of threads sampled less often than min_period_ms are weighted by
+// the periods they stand for, so that threads compare fairly in reports.
+class ThreadSamplingScheduler {
+ public:
+  enum class Decision {
+    // Not due yet.
+    kSkip,
+    // Idle since its previous sample, to count with its previous callstack.
+    kRepeat,
+    // To suspend and walk.
+    kWalk
+  };
+  struct Sample {
+    Decision decision = Decision::kSkip;
+    // Number of samples the sample counts for.
+    uint32_t weight = 0;
+  };
+
+  ThreadSamplingScheduler(double min_period_ms, double overhead_budget)
+      : min_period_ms_(min_period_ms), overhead_budget_(overhead_budget) {}
+
+  // Decides whether to sample tid at now_ms, cycles being the value of its
+  // cycle counter.
+  Sample Schedule(uint32_t tid, double now_ms, uint64_t cycles);
+  // Reports that walking tid, as decided by Schedule, took walk_ms and gave
+  // callstack_id, 0 if the walk failed.
+  void OnWalked(uint32_t tid, double walk_ms, uint64_t callstack_id);
+
+  // Callstack of the previous walk of tid, to count on kRepeat.
+  uint64_t GetLastCallstack(uint32_t tid) const;
+  double GetPeriodMs(uint32_t tid) const;
+  uint32_t GetNumRunningThreads() const { return num_running_threads_; }
+
+ private:
+  struct ThreadState {
+    uint64_t last_cycles = 0;
+    uint64_t last_callstack = 0;
+    double last_sample_ms = 0.0;
+    // Moving average of the cost of a walk.
+    double walk_ms = 0.0;
+    bool sampled = false;
+    bool running = false;
+  };
+
+  double GetPeriodMs(const ThreadState& state) const;
+
+  double min_period_ms_;
+  double overhead_budget_;
+  absl::flat_hash_map<uint32_t, ThreadState> threads_;
+  uint32_t num_running_threads_ = 0;
+};
+
+#endif  // ORBIT_CORE_THREAD_SAMPLING_SCHEDULER_H_
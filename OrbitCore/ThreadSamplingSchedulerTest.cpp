@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+
+#include "ThreadSamplingScheduler.h"
+
+using Decision = ThreadSamplingScheduler::Decision;
+
+TEST(ThreadSamplingScheduler, RepeatsIdleThreads) {
+  ThreadSamplingScheduler scheduler(1.0, 0.1);
+  EXPECT_EQ(scheduler.Schedule(1, 0.0, 100).decision, Decision::kWalk);
+  scheduler.OnWalked(1, 0.001, 42);
+
+  // Not due before the minimum period.
+  EXPECT_EQ(scheduler.Schedule(1, 0.5, 100).decision, Decision::kSkip);
+  ThreadSamplingScheduler::Sample sample = scheduler.Schedule(1, 1.0, 100);
+  EXPECT_EQ(sample.decision, Decision::kRepeat);
+  EXPECT_EQ(sample.weight, 1);
+  EXPECT_EQ(scheduler.GetLastCallstack(1), 42);
+  EXPECT_EQ(scheduler.GetNumRunningThreads(), 0);
+
+  // Running again.
+  EXPECT_EQ(scheduler.Schedule(1, 2.0, 200).decision, Decision::kWalk);
+  EXPECT_EQ(scheduler.GetNumRunningThreads(), 1);
+}
+
+TEST(ThreadSamplingScheduler, WalksThreadsWithoutCallstack) {
+  ThreadSamplingScheduler scheduler(1.0, 0.1);
+  EXPECT_EQ(scheduler.Schedule(1, 0.0, 100).decision, Decision::kWalk);
+  scheduler.OnWalked(1, 0.001, 0);
+  EXPECT_EQ(scheduler.Schedule(1, 1.0, 100).decision, Decision::kWalk);
+}
+
+TEST(ThreadSamplingScheduler, AdaptsPeriodsToBudget) {
+  ThreadSamplingScheduler scheduler(1.0, 0.1);
+  for (uint32_t tid = 1; tid <= 10; ++tid) {
+    scheduler.Schedule(tid, 0.0, 100);
+    scheduler.OnWalked(tid, 0.05, tid);
+  }
+  EXPECT_EQ(scheduler.GetNumRunningThreads(), 10);
+  // Ten threads of 0.05ms each within 10% of the time.
+  EXPECT_DOUBLE_EQ(scheduler.GetPeriodMs(1), 5.0);
+
+  EXPECT_EQ(scheduler.Schedule(1, 4.0, 200).decision, Decision::kSkip);
+  ThreadSamplingScheduler::Sample sample = scheduler.Schedule(1, 5.0, 200);
+  EXPECT_EQ(sample.decision, Decision::kWalk);
+  // Stands for the samples of the periods it skipped.
+  EXPECT_EQ(sample.weight, 5);
+
+  // Cheap threads are sampled at the minimum period.
+  scheduler.OnWalked(2, 0.0001, 2);
+  scheduler.OnWalked(2, 0.0001, 2);
+  EXPECT_LT(scheduler.GetPeriodMs(2), scheduler.GetPeriodMs(1));
+  EXPECT_DOUBLE_EQ(ThreadSamplingScheduler(1.0, 0.1).GetPeriodMs(3), 1.0);
+}
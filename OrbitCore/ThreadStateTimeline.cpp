@@ -0,0 +1,69 @@
+#include "ThreadStateTimeline.h"
+
+#include <algorithm>
+
+void ThreadStateTimeline::Add(const ThreadStateChange& change) {
+  if (!changes_.empty() && (changes_.back().state == change.state ||
+                            changes_.back().time > change.time)) {
+    return;
+  }
+  changes_.push_back(change);
+}
+
+void ThreadStateTimeline::ForEachSliceInRange(
+    uint64_t begin, uint64_t end,
+    const std::function<void(const Slice&)>& action) const {
+  // Start from the last change before begin, as that state is still current.
+  auto it = std::upper_bound(
+      changes_.begin(), changes_.end(), begin,
+      [](uint64_t time, const ThreadStateChange& change) {
+        return time < change.time;
+      });
+  if (it != changes_.begin()) {
+    --it;
+  }
+
+  for (; it != changes_.end() && it->time < end; ++it) {
+    auto next_it = std::next(it);
+    uint64_t slice_end = next_it != changes_.end() ? next_it->time : end;
+    if (slice_end <= begin) {
+      continue;
+    }
+    action({std::max(it->time, begin), std::min(slice_end, end), it->state,
+            it->waker_thread_id});
+  }
+}
+
+std::optional<ThreadStateTimeline::Slice> ThreadStateTimeline::GetSliceBefore(
+    uint64_t time) const {
+  auto it = std::lower_bound(
+      changes_.begin(), changes_.end(), time,
+      [](const ThreadStateChange& change, uint64_t time) {
+        return change.time < time;
+      });
+  if (it == changes_.begin()) {
+    return std::nullopt;
+  }
+  --it;
+  return Slice{it->time, time, it->state, it->waker_thread_id};
+}
+
+std::vector<uint64_t> ThreadStateTimeline::ComputeLatencyToRunHistogram(
+    uint64_t bucket_width_ns, size_t bucket_count) const {
+  std::vector<uint64_t> histogram(bucket_count, 0);
+  if (bucket_width_ns == 0 || bucket_count == 0) {
+    return histogram;
+  }
+
+  for (size_t i = 1; i < changes_.size(); ++i) {
+    const ThreadStateChange& previous = changes_[i - 1];
+    const ThreadStateChange& current = changes_[i];
+    if (previous.state != ThreadStateChange::kRunnable ||
+        current.state != ThreadStateChange::kRunning) {
+      continue;
+    }
+    uint64_t bucket = (current.time - previous.time) / bucket_width_ns;
+    ++histogram[std::min<uint64_t>(bucket, bucket_count - 1)];
+  }
+  return histogram;
+}
@@ -0,0 +1,73 @@
+#ifndef ORBIT_CORE_THREAD_STATE_TIMELINE_H_
+#define ORBIT_CORE_THREAD_STATE_TIMELINE_H_
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#pragma pack(push, 1)
+// Sent as it is from the service to the client, like ContextSwitch.
+struct ThreadStateChange {
+  // Same as LinuxTracing::ThreadState.
+  enum State : uint8_t {
+    kRunning,
+    kRunnable,
+    kInterruptibleSleep,
+    kUninterruptibleSleep,
+    kStopped,
+    kTraced,
+    kDead,
+    kZombie,
+    kParked,
+    kIdle,
+  };
+
+  uint64_t time = 0;
+  uint32_t thread_id = 0;
+  // The thread that made this thread runnable, or 0 if unknown.
+  uint32_t waker_thread_id = 0;
+  State state = kRunning;
+};
+#pragma pack(pop)
+
+// The scheduling states of a thread over time, stored as the compact stream of
+// its state changes rather than as intervals: each state lasts until the next
+// change.
+class ThreadStateTimeline {
+ public:
+  struct Slice {
+    uint64_t begin;
+    uint64_t end;
+    ThreadStateChange::State state;
+    uint32_t waker_thread_id;
+  };
+
+  // Changes are expected in order of time. A change to the current state, or
+  // older than the last change, is ignored.
+  void Add(const ThreadStateChange& change);
+
+  // Calls action for each slice overlapping [begin, end), clipped to it. The
+  // last state lasts until end.
+  void ForEachSliceInRange(uint64_t begin, uint64_t end,
+                           const std::function<void(const Slice&)>& action)
+      const;
+
+  // The slice in effect right before time, from the last change before time
+  // and clipped to end at time. std::nullopt if there is no such change.
+  std::optional<Slice> GetSliceBefore(uint64_t time) const;
+
+  // Bucket i counts the times the thread waited between i * bucket_width_ns
+  // (included) and (i + 1) * bucket_width_ns (excluded) to run after becoming
+  // runnable. The last bucket also counts all longer waits.
+  std::vector<uint64_t> ComputeLatencyToRunHistogram(uint64_t bucket_width_ns,
+                                                     size_t bucket_count) const;
+
+  size_t GetNumChanges() const { return changes_.size(); }
+  void Clear() { changes_.clear(); }
+
+ private:
+  std::vector<ThreadStateChange> changes_;
+};
+
+#endif  // ORBIT_CORE_THREAD_STATE_TIMELINE_H_
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "ThreadStateTimeline.h"
+
+namespace {
+ThreadStateChange MakeChange(uint64_t time, ThreadStateChange::State state) {
+  ThreadStateChange change;
+  change.time = time;
+  change.thread_id = 42;
+  change.state = state;
+  return change;
+}
+
+std::vector<ThreadStateTimeline::Slice> GetSlices(
+    const ThreadStateTimeline& timeline, uint64_t begin, uint64_t end) {
+  std::vector<ThreadStateTimeline::Slice> slices;
+  timeline.ForEachSliceInRange(
+      begin, end, [&slices](const ThreadStateTimeline::Slice& slice) {
+        slices.push_back(slice);
+      });
+  return slices;
+}
+}  // namespace
+
+TEST(ThreadStateTimeline, AddIgnoresRepeatedStates) {
+  ThreadStateTimeline timeline;
+  timeline.Add(MakeChange(100, ThreadStateChange::kRunning));
+  timeline.Add(MakeChange(200, ThreadStateChange::kRunning));
+  timeline.Add(MakeChange(300, ThreadStateChange::kInterruptibleSleep));
+  timeline.Add(MakeChange(250, ThreadStateChange::kRunnable));
+  EXPECT_EQ(timeline.GetNumChanges(), 2);
+}
+
+TEST(ThreadStateTimeline, ForEachSliceInRange) {
+  ThreadStateTimeline timeline;
+  timeline.Add(MakeChange(100, ThreadStateChange::kRunning));
+  timeline.Add(MakeChange(200, ThreadStateChange::kInterruptibleSleep));
+  timeline.Add(MakeChange(300, ThreadStateChange::kRunnable));
+  timeline.Add(MakeChange(400, ThreadStateChange::kRunning));
+
+  std::vector<ThreadStateTimeline::Slice> slices =
+      GetSlices(timeline, 150, 350);
+  ASSERT_EQ(slices.size(), 3);
+  EXPECT_EQ(slices[0].begin, 150);
+  EXPECT_EQ(slices[0].end, 200);
+  EXPECT_EQ(slices[0].state, ThreadStateChange::kRunning);
+  EXPECT_EQ(slices[1].begin, 200);
+  EXPECT_EQ(slices[1].end, 300);
+  EXPECT_EQ(slices[1].state, ThreadStateChange::kInterruptibleSleep);
+  EXPECT_EQ(slices[2].begin, 300);
+  EXPECT_EQ(slices[2].end, 350);
+  EXPECT_EQ(slices[2].state, ThreadStateChange::kRunnable);
+
+  // The last state lasts until the end of the range.
+  slices = GetSlices(timeline, 500, 600);
+  ASSERT_EQ(slices.size(), 1);
+  EXPECT_EQ(slices[0].begin, 500);
+  EXPECT_EQ(slices[0].end, 600);
+  EXPECT_EQ(slices[0].state, ThreadStateChange::kRunning);
+
+  EXPECT_TRUE(GetSlices(timeline, 0, 100).empty());
+}
+
+TEST(ThreadStateTimeline, GetSliceBefore) {
+  ThreadStateTimeline timeline;
+  timeline.Add(MakeChange(100, ThreadStateChange::kRunning));
+  timeline.Add(MakeChange(200, ThreadStateChange::kInterruptibleSleep));
+
+  EXPECT_FALSE(timeline.GetSliceBefore(100).has_value());
+  std::optional<ThreadStateTimeline::Slice> slice =
+      timeline.GetSliceBefore(200);
+  ASSERT_TRUE(slice.has_value());
+  EXPECT_EQ(slice->begin, 100);
+  EXPECT_EQ(slice->end, 200);
+  EXPECT_EQ(slice->state, ThreadStateChange::kRunning);
+  slice = timeline.GetSliceBefore(250);
+  ASSERT_TRUE(slice.has_value());
+  EXPECT_EQ(slice->begin, 200);
+  EXPECT_EQ(slice->end, 250);
+  EXPECT_EQ(slice->state, ThreadStateChange::kInterruptibleSleep);
+}
+
+TEST(ThreadStateTimeline, ComputeLatencyToRunHistogram) {
+  ThreadStateTimeline timeline;
+  timeline.Add(MakeChange(0, ThreadStateChange::kRunnable));
+  timeline.Add(MakeChange(5, ThreadStateChange::kRunning));
+  timeline.Add(MakeChange(10, ThreadStateChange::kRunnable));
+  timeline.Add(MakeChange(25, ThreadStateChange::kRunning));
+  timeline.Add(MakeChange(30, ThreadStateChange::kUninterruptibleSleep));
+  timeline.Add(MakeChange(40, ThreadStateChange::kRunning));
+  timeline.Add(MakeChange(50, ThreadStateChange::kRunnable));
+  timeline.Add(MakeChange(1050, ThreadStateChange::kRunning));
+
+  EXPECT_EQ(timeline.ComputeLatencyToRunHistogram(10, 3),
+            (std::vector<uint64_t>{1, 1, 1}));
+}
@@ -0,0 +1,120 @@
+#include "TickToWorld.h"
+
+#include "OrbitBase/Logging.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define ORBIT_TICK_TO_WORLD_AVX2 1
+#endif
+
+namespace {
+// The batch as affine functions of the ticks relative to starts[0].
+struct Coefficients {
+  TickType base_tick;
+  double base_x;
+  double world_per_tick;
+  double pixels_per_tick;
+};
+
+Coefficients GetCoefficients(const TickToWorld& transform,
+                             TickType base_tick) {
+  double normalized_per_tick = 0.001 * transform.inv_time_window;
+  Coefficients coefficients;
+  coefficients.base_tick = base_tick;
+  coefficients.base_x =
+      transform.world_start_x +
+      (MicroSecondsFromTicks(transform.session_min_tick, base_tick) -
+       transform.min_time_us) *
+          transform.inv_time_window * transform.world_width;
+  coefficients.world_per_tick = normalized_per_tick * transform.world_width;
+  coefficients.pixels_per_tick = normalized_per_tick * transform.canvas_width;
+  return coefficients;
+}
+
+void TransformScalar(const Coefficients& coefficients, const TickType* starts,
+                     const TickType* ends, size_t begin, size_t size,
+                     float* xs, float* widths, uint8_t* wider_than_pixel) {
+  for (size_t i = begin; i < size; ++i) {
+    auto start = static_cast<double>(
+        static_cast<int64_t>(starts[i] - coefficients.base_tick));
+    auto length = static_cast<double>(ends[i] - starts[i]);
+    xs[i] = static_cast<float>(coefficients.base_x +
+                               start * coefficients.world_per_tick);
+    widths[i] = static_cast<float>(length * coefficients.world_per_tick);
+    wider_than_pixel[i] = length * coefficients.pixels_per_tick > 1;
+  }
+}
+
+#ifdef ORBIT_TICK_TO_WORLD_AVX2
+// AVX2 has no conversion of 64 bit integers to doubles: integers within
+// 2^51 are added to the bits of 2^52 + 2^51, whose mantissa they then are.
+__attribute__((target("avx2"))) inline __m256d ToDouble(__m256i values) {
+  const __m256d kMagic = _mm256_set1_pd(6755399441055744.0);
+  return _mm256_sub_pd(
+      _mm256_castsi256_pd(
+          _mm256_add_epi64(values, _mm256_castpd_si256(kMagic))),
+      kMagic);
+}
+
+// Returns the number of timers transformed, a multiple of 4.
+__attribute__((target("avx2"))) size_t TransformAvx2(
+    const Coefficients& coefficients, const TickType* starts,
+    const TickType* ends, size_t size, float* xs, float* widths,
+    uint8_t* wider_than_pixel) {
+  const __m256i base_tick =
+      _mm256_set1_epi64x(static_cast<int64_t>(coefficients.base_tick));
+  const __m256d base_x = _mm256_set1_pd(coefficients.base_x);
+  const __m256d world_per_tick = _mm256_set1_pd(coefficients.world_per_tick);
+  const __m256d pixels_per_tick = _mm256_set1_pd(coefficients.pixels_per_tick);
+  const __m256d one = _mm256_set1_pd(1.0);
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    __m256i start_ticks = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(starts + i));
+    __m256i end_ticks =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ends + i));
+    __m256d start = ToDouble(_mm256_sub_epi64(start_ticks, base_tick));
+    __m256d length = ToDouble(_mm256_sub_epi64(end_ticks, start_ticks));
+
+    __m256d x = _mm256_add_pd(base_x, _mm256_mul_pd(start, world_per_tick));
+    __m256d width = _mm256_mul_pd(length, world_per_tick);
+    _mm_storeu_ps(xs + i, _mm256_cvtpd_ps(x));
+    _mm_storeu_ps(widths + i, _mm256_cvtpd_ps(width));
+
+    int mask = _mm256_movemask_pd(_mm256_cmp_pd(
+        _mm256_mul_pd(length, pixels_per_tick), one, _CMP_GT_OQ));
+    for (size_t lane = 0; lane < 4; ++lane) {
+      wider_than_pixel[i + lane] = (mask >> lane) & 1;
+    }
+  }
+  return i;
+}
+
+bool HasAvx2() {
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  return has_avx2;
+}
+#endif  // ORBIT_TICK_TO_WORLD_AVX2
+}  // namespace
+
+void TransformTicksToWorld(const TickToWorld& transform,
+                           absl::Span<const TickType> starts,
+                           absl::Span<const TickType> ends,
+                           absl::Span<float> xs, absl::Span<float> widths,
+                           absl::Span<uint8_t> wider_than_pixel) {
+  size_t size = starts.size();
+  CHECK(ends.size() == size && xs.size() == size && widths.size() == size &&
+        wider_than_pixel.size() == size);
+  if (size == 0) return;
+
+  Coefficients coefficients = GetCoefficients(transform, starts[0]);
+  size_t begin = 0;
+#ifdef ORBIT_TICK_TO_WORLD_AVX2
+  if (HasAvx2()) {
+    begin = TransformAvx2(coefficients, starts.data(), ends.data(), size,
+                          xs.data(), widths.data(), wider_than_pixel.data());
+  }
+#endif
+  TransformScalar(coefficients, starts.data(), ends.data(), begin, size,
+                  xs.data(), widths.data(), wider_than_pixel.data());
+}
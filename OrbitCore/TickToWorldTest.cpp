@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "TickToWorld.h"
+
+namespace {
+// As TimeGraph computed it, one timer at a time.
+float ReferenceX(const TickToWorld& transform, TickType tick) {
+  double us = MicroSecondsFromTicks(transform.session_min_tick, tick) -
+              transform.min_time_us;
+  return float(transform.world_start_x +
+               us * transform.inv_time_window * transform.world_width);
+}
+}  // namespace
+
+TEST(TickToWorld, MatchesTheTransformOfEachTimer) {
+  TickToWorld transform;
+  transform.session_min_tick = 1'000'000'000'000;
+  transform.min_time_us = 2'500'000;
+  transform.inv_time_window = 1.0 / 40'000;
+  transform.world_start_x = -120.f;
+  transform.world_width = 1600.f;
+  transform.canvas_width = 1600;
+
+  // Not a multiple of the vector width, and not sorted, for the scalar tail
+  // and the timers before starts[0].
+  std::mt19937_64 random(42);
+  std::uniform_int_distribution<uint64_t> offset(0, 60'000'000);
+  std::uniform_int_distribution<uint64_t> duration(0, 100'000);
+  std::vector<TickType> starts;
+  std::vector<TickType> ends;
+  for (int i = 0; i < 103; ++i) {
+    TickType start =
+        transform.session_min_tick + 2'480'000'000 + offset(random);
+    starts.push_back(start);
+    ends.push_back(start + duration(random));
+  }
+
+  size_t size = starts.size();
+  std::vector<float> xs(size);
+  std::vector<float> widths(size);
+  std::vector<uint8_t> wider_than_pixel(size);
+  TransformTicksToWorld(transform, starts, ends, absl::MakeSpan(xs),
+                        absl::MakeSpan(widths),
+                        absl::MakeSpan(wider_than_pixel));
+
+  for (size_t i = 0; i < size; ++i) {
+    float x = ReferenceX(transform, starts[i]);
+    float width = ReferenceX(transform, ends[i]) - x;
+    EXPECT_NEAR(xs[i], x, 1e-3) << i;
+    EXPECT_NEAR(widths[i], width, 1e-3) << i;
+    // A pixel is 25 us wide.
+    EXPECT_EQ(wider_than_pixel[i], ends[i] - starts[i] > 25'000) << i;
+  }
+}
+
+TEST(TickToWorld, TransformsEmptyBatches) {
+  TickToWorld transform;
+  TransformTicksToWorld(transform, {}, {}, {}, {}, {});
+}
@@ -0,0 +1,237 @@
+#include "TimerBatch.h"
+
+#include <cstring>
+
+#include "Varint.h"
+#include "absl/container/flat_hash_map.h"
+
+namespace {
+// Smallest encoding of a timer: the one-byte fields plus a byte for each of
+// the seven varints.
+constexpr size_t kMinEncodedTimerSize = 4 + 7;
+
+// Assigns indices to values in order of first use.
+template <typename T>
+class Dictionary {
+ public:
+  uint32_t GetIndex(T value) {
+    auto [it, inserted] = indices_.try_emplace(value, values_.size());
+    if (inserted) {
+      values_.push_back(value);
+    }
+    return it->second;
+  }
+  const std::vector<T>& values() const { return values_; }
+
+ private:
+  absl::flat_hash_map<T, uint32_t> indices_;
+  std::vector<T> values_;
+};
+}  // namespace
+
+std::string EncodeTimerBatch(const std::vector<Timer>& timers) {
+  size_t num_timers = timers.size();
+  Dictionary<uint32_t> thread_ids;
+  Dictionary<uint64_t> functions;
+  Dictionary<uint64_t> callstacks;
+  std::vector<uint32_t> thread_indices(num_timers);
+  std::vector<uint32_t> function_indices(num_timers);
+  std::vector<uint32_t> callstack_indices(num_timers);
+  for (size_t i = 0; i < num_timers; ++i) {
+    thread_indices[i] = thread_ids.GetIndex(timers[i].m_TID);
+    function_indices[i] = functions.GetIndex(timers[i].m_FunctionAddress);
+    callstack_indices[i] = callstacks.GetIndex(timers[i].m_CallstackHash);
+  }
+
+  std::string output;
+  output.reserve(sizeof(TimerBatchHeader) + 16 * num_timers);
+  TimerBatchHeader header{TimerBatchHeader::kVersion,
+                          static_cast<uint32_t>(num_timers)};
+  output.append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  WriteVarint(thread_ids.values().size(), &output);
+  for (uint32_t thread_id : thread_ids.values()) {
+    WriteVarint(thread_id, &output);
+  }
+  // Functions of the same module are close to each other.
+  WriteVarint(functions.values().size(), &output);
+  uint64_t previous_function = 0;
+  for (uint64_t function : functions.values()) {
+    WriteVarint(ZigZagEncode(function - previous_function), &output);
+    previous_function = function;
+  }
+  // Hashes don't get any smaller as varints.
+  WriteVarint(callstacks.values().size(), &output);
+  output.append(reinterpret_cast<const char*>(callstacks.values().data()),
+                callstacks.values().size() * sizeof(uint64_t));
+
+  size_t bytes_offset = output.size();
+  output.resize(bytes_offset + 4 * num_timers);
+  char* depths = &output[bytes_offset];
+  char* session_ids = depths + num_timers;
+  char* types = session_ids + num_timers;
+  char* processors = types + num_timers;
+  for (size_t i = 0; i < num_timers; ++i) {
+    depths[i] = timers[i].m_Depth;
+    session_ids[i] = timers[i].m_SessionID;
+    types[i] = timers[i].m_Type;
+    processors[i] = timers[i].m_Processor;
+  }
+
+  for (uint32_t index : thread_indices) {
+    WriteVarint(index, &output);
+  }
+  for (uint32_t index : function_indices) {
+    WriteVarint(index, &output);
+  }
+  for (uint32_t index : callstack_indices) {
+    WriteVarint(index, &output);
+  }
+
+  std::vector<uint64_t> previous_starts(thread_ids.values().size(), 0);
+  for (size_t i = 0; i < num_timers; ++i) {
+    uint64_t& previous_start = previous_starts[thread_indices[i]];
+    WriteVarint(ZigZagEncode(timers[i].m_Start - previous_start), &output);
+    previous_start = timers[i].m_Start;
+  }
+  for (const Timer& timer : timers) {
+    WriteVarint(ZigZagEncode(timer.m_End - timer.m_Start), &output);
+  }
+
+  for (const Timer& timer : timers) {
+    WriteVarint(timer.m_UserData[0], &output);
+  }
+  for (const Timer& timer : timers) {
+    WriteVarint(timer.m_UserData[1], &output);
+  }
+  return output;
+}
+
+bool DecodeTimerBatch(const void* data, size_t size,
+                      std::vector<Timer>* timers) {
+  TimerBatchHeader header;
+  if (size < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  VarintReader reader(static_cast<const char*>(data) + sizeof(header),
+                size - sizeof(header));
+  size_t num_timers = header.num_timers;
+  // Also guards the allocations below against corrupted sizes.
+  if (header.version != TimerBatchHeader::kVersion ||
+      num_timers > reader.remaining() / kMinEncodedTimerSize) {
+    return false;
+  }
+
+  uint64_t num_thread_ids;
+  if (!reader.ReadVarint(&num_thread_ids) ||
+      num_thread_ids > reader.remaining()) {
+    return false;
+  }
+  std::vector<uint32_t> thread_ids(num_thread_ids);
+  for (uint32_t& thread_id : thread_ids) {
+    uint64_t value;
+    if (!reader.ReadVarint(&value)) {
+      return false;
+    }
+    thread_id = static_cast<uint32_t>(value);
+  }
+
+  uint64_t num_functions;
+  if (!reader.ReadVarint(&num_functions) ||
+      num_functions > reader.remaining()) {
+    return false;
+  }
+  std::vector<uint64_t> functions(num_functions);
+  uint64_t previous_function = 0;
+  for (uint64_t& function : functions) {
+    uint64_t value;
+    if (!reader.ReadVarint(&value)) {
+      return false;
+    }
+    function = previous_function + ZigZagDecode(value);
+    previous_function = function;
+  }
+
+  uint64_t num_callstacks;
+  const uint8_t* callstack_bytes;
+  if (!reader.ReadVarint(&num_callstacks) ||
+      num_callstacks > reader.remaining() / sizeof(uint64_t) ||
+      !reader.ReadBytes(num_callstacks * sizeof(uint64_t), &callstack_bytes)) {
+    return false;
+  }
+  std::vector<uint64_t> callstacks(num_callstacks);
+  if (num_callstacks > 0) {
+    memcpy(callstacks.data(), callstack_bytes,
+           num_callstacks * sizeof(uint64_t));
+  }
+
+  std::vector<Timer> decoded(num_timers);
+  const uint8_t* bytes;
+  if (!reader.ReadBytes(4 * num_timers, &bytes)) {
+    return false;
+  }
+  for (size_t i = 0; i < num_timers; ++i) {
+    decoded[i].m_Depth = bytes[i];
+    decoded[i].m_SessionID = bytes[num_timers + i];
+    decoded[i].m_Type = static_cast<Timer::Type>(bytes[2 * num_timers + i]);
+    decoded[i].m_Processor = bytes[3 * num_timers + i];
+  }
+
+  std::vector<uint32_t> thread_indices(num_timers);
+  for (size_t i = 0; i < num_timers; ++i) {
+    if (!reader.ReadIndex(thread_ids.size(), &thread_indices[i])) {
+      return false;
+    }
+    decoded[i].m_TID = thread_ids[thread_indices[i]];
+  }
+  for (Timer& timer : decoded) {
+    uint32_t index;
+    if (!reader.ReadIndex(functions.size(), &index)) {
+      return false;
+    }
+    timer.m_FunctionAddress = functions[index];
+  }
+  for (Timer& timer : decoded) {
+    uint32_t index;
+    if (!reader.ReadIndex(callstacks.size(), &index)) {
+      return false;
+    }
+    timer.m_CallstackHash = callstacks[index];
+  }
+
+  std::vector<uint64_t> previous_starts(thread_ids.size(), 0);
+  for (size_t i = 0; i < num_timers; ++i) {
+    uint64_t value;
+    if (!reader.ReadVarint(&value)) {
+      return false;
+    }
+    uint64_t& previous_start = previous_starts[thread_indices[i]];
+    decoded[i].m_Start = previous_start + ZigZagDecode(value);
+    previous_start = decoded[i].m_Start;
+  }
+  for (Timer& timer : decoded) {
+    uint64_t value;
+    if (!reader.ReadVarint(&value)) {
+      return false;
+    }
+    timer.m_End = timer.m_Start + ZigZagDecode(value);
+  }
+
+  // Timer is packed: don't read into its fields through pointers.
+  for (int user_data_index : {0, 1}) {
+    for (Timer& timer : decoded) {
+      uint64_t value;
+      if (!reader.ReadVarint(&value)) {
+        return false;
+      }
+      timer.m_UserData[user_data_index] = value;
+    }
+  }
+  if (reader.remaining() != 0) {
+    return false;
+  }
+
+  timers->insert(timers->end(), decoded.begin(), decoded.end());
+  return true;
+}
@@ -0,0 +1,38 @@
+#ifndef ORBIT_CORE_TIMER_BATCH_H_
+#define ORBIT_CORE_TIMER_BATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ScopeTimer.h"
+
+// Compact encoding of the batches of timers sent from the service as
+// Msg_RemoteTimers, about a quarter of the size of the raw Timer structs.
+//
+// The timers are stored column by column, so that each column is encoded and
+// decoded by its own tight loop:
+// - a header with the version and the number of timers;
+// - dictionaries of the thread ids, function addresses and callstack hashes,
+//   in order of first use, as these repeat heavily within a batch;
+// - the one-byte fields (depth, session id, type, processor), as raw bytes;
+// - the indices into the dictionaries, as varints;
+// - the start of each timer, as a zigzag varint delta from the start of the
+//   previous timer of the same thread, and its duration;
+// - the user data, as varints.
+// The order of the timers is preserved.
+struct TimerBatchHeader {
+  static constexpr uint32_t kVersion = 1;
+  uint32_t version;
+  uint32_t num_timers;
+};
+
+std::string EncodeTimerBatch(const std::vector<Timer>& timers);
+
+// Appends the decoded timers to timers. Returns false, and leaves timers
+// unchanged, if data is not a valid encoding of this version.
+bool DecodeTimerBatch(const void* data, size_t size,
+                      std::vector<Timer>* timers);
+
+#endif  // ORBIT_CORE_TIMER_BATCH_H_
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "TimerBatch.h"
+
+namespace {
+Timer MakeTimer(uint32_t tid, uint64_t start, uint64_t end,
+                uint64_t function_address) {
+  Timer timer;
+  timer.m_TID = tid;
+  timer.m_Start = start;
+  timer.m_End = end;
+  timer.m_FunctionAddress = function_address;
+  return timer;
+}
+
+void ExpectEqual(const Timer& actual, const Timer& expected) {
+  EXPECT_EQ(actual.m_TID, expected.m_TID);
+  EXPECT_EQ(actual.m_Depth, expected.m_Depth);
+  EXPECT_EQ(actual.m_SessionID, expected.m_SessionID);
+  EXPECT_EQ(actual.m_Type, expected.m_Type);
+  EXPECT_EQ(actual.m_Processor, expected.m_Processor);
+  EXPECT_EQ(actual.m_CallstackHash, expected.m_CallstackHash);
+  EXPECT_EQ(actual.m_FunctionAddress, expected.m_FunctionAddress);
+  EXPECT_EQ(actual.m_UserData[0], expected.m_UserData[0]);
+  EXPECT_EQ(actual.m_UserData[1], expected.m_UserData[1]);
+  EXPECT_EQ(actual.m_Start, expected.m_Start);
+  EXPECT_EQ(actual.m_End, expected.m_End);
+}
+
+std::vector<Timer> MakeTimers() {
+  std::vector<Timer> timers;
+  timers.push_back(MakeTimer(10, 1000, 1500, 0x7f0000001000));
+  timers.push_back(MakeTimer(20, 900, 950, 0x7f0000002000));
+  // Not monotonic within a thread, and ending before its start.
+  timers.push_back(MakeTimer(10, 800, 700, 0x7f0000001000));
+  timers.push_back(MakeTimer(10, ~0ULL, 0, 0));
+
+  Timer& timer = timers.back();
+  timer.m_Depth = 3;
+  timer.m_SessionID = 4;
+  timer.SetType(Timer::INTROSPECTION);
+  timer.m_Processor = 5;
+  timer.m_CallstackHash = 0xfedcba9876543210;
+  timer.m_UserData[0] = 42;
+  timer.m_UserData[1] = ~0ULL;
+  return timers;
+}
+}  // namespace
+
+TEST(TimerBatch, RoundTrip) {
+  std::vector<Timer> timers = MakeTimers();
+  std::string data = EncodeTimerBatch(timers);
+
+  std::vector<Timer> decoded;
+  ASSERT_TRUE(DecodeTimerBatch(data.data(), data.size(), &decoded));
+  ASSERT_EQ(decoded.size(), timers.size());
+  for (size_t i = 0; i < timers.size(); ++i) {
+    ExpectEqual(decoded[i], timers[i]);
+  }
+}
+
+TEST(TimerBatch, AppendsToTimers) {
+  std::string data = EncodeTimerBatch(MakeTimers());
+  std::vector<Timer> decoded(1);
+  ASSERT_TRUE(DecodeTimerBatch(data.data(), data.size(), &decoded));
+  EXPECT_EQ(decoded.size(), MakeTimers().size() + 1);
+}
+
+TEST(TimerBatch, EmptyBatch) {
+  std::string data = EncodeTimerBatch({});
+  std::vector<Timer> decoded;
+  EXPECT_TRUE(DecodeTimerBatch(data.data(), data.size(), &decoded));
+  EXPECT_TRUE(decoded.empty());
+}
+
+TEST(TimerBatch, SmallerThanRawTimers) {
+  // Typical batch: a few threads calling a few functions in sequence.
+  std::vector<Timer> timers;
+  uint64_t time = 1'000'000'000'000;
+  for (int i = 0; i < 1000; ++i) {
+    time += 1000 + i % 7;
+    timers.push_back(
+        MakeTimer(100 + i % 4, time, time + 500, 0x7f0000001000 + i % 16));
+  }
+  std::string data = EncodeTimerBatch(timers);
+  EXPECT_LT(data.size(), timers.size() * sizeof(Timer) / 4);
+}
+
+TEST(TimerBatch, RejectsTruncatedData) {
+  std::string data = EncodeTimerBatch(MakeTimers());
+  for (size_t size = 0; size < data.size(); ++size) {
+    std::vector<Timer> decoded;
+    EXPECT_FALSE(DecodeTimerBatch(data.data(), size, &decoded));
+    EXPECT_TRUE(decoded.empty());
+  }
+}
+
+TEST(TimerBatch, RejectsOtherVersion) {
+  std::string data = EncodeTimerBatch(MakeTimers());
+  uint32_t version = TimerBatchHeader::kVersion + 1;
+  memcpy(data.data(), &version, sizeof(version));
+  std::vector<Timer> decoded;
+  EXPECT_FALSE(DecodeTimerBatch(data.data(), data.size(), &decoded));
+}
@@ -0,0 +1,189 @@
+#include "TimerChunkFile.h"
+
+#include <OrbitBase/Logging.h>
+#include <zlib.h>
+
+#include <algorithm>
+
+#include "ParallelFor.h"
+
+namespace {
+// Timers compress well even at the fastest level, which keeps saving fast.
+constexpr int kCompressionLevel = Z_BEST_SPEED;
+}  // namespace
+
+bool TimerChunkWriter::AddTimer(const Timer& timer) {
+  std::vector<Timer>& timers = chunks_[timer.m_TID];
+  timers.push_back(timer);
+  if (timers.size() < timers_per_chunk_) {
+    return true;
+  }
+  pending_chunks_.push_back({timer.m_TID, std::move(timers), {}});
+  timers.clear();
+  return pending_chunks_.size() < GetNumWorkers() || WritePendingChunks();
+}
+
+bool TimerChunkWriter::Close() {
+  // In order of thread, for the same content to give the same file.
+  std::vector<uint32_t> thread_ids;
+  for (const auto& pair : chunks_) {
+    thread_ids.push_back(pair.first);
+  }
+  std::sort(thread_ids.begin(), thread_ids.end());
+  for (uint32_t thread_id : thread_ids) {
+    std::vector<Timer>& timers = chunks_[thread_id];
+    if (!timers.empty()) {
+      pending_chunks_.push_back({thread_id, std::move(timers), {}});
+    }
+  }
+  chunks_.clear();
+  if (!WritePendingChunks()) {
+    return false;
+  }
+
+  TimerChunkFooter footer = {};
+  footer.magic = TimerChunkFooter::kMagic;
+  footer.version = TimerChunkFooter::kVersion;
+  footer.num_chunks = index_.size();
+  footer.index_offset = stream_->tellp();
+  footer.timer_size = sizeof(Timer);
+  stream_->write(reinterpret_cast<const char*>(index_.data()),
+                 index_.size() * sizeof(TimerChunkIndexEntry));
+  stream_->write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+  stream_->flush();
+  if (!*stream_) {
+    ERROR("Could not write the timer index");
+    return false;
+  }
+  return true;
+}
+
+bool TimerChunkWriter::WritePendingChunks() {
+  std::vector<char> compressed(pending_chunks_.size());
+  ParallelFor(pending_chunks_.size(), [&](size_t i) {
+    PendingChunk& chunk = pending_chunks_[i];
+    uLong size = chunk.timers.size() * sizeof(Timer);
+    uLongf compressed_size = compressBound(size);
+    chunk.compressed.resize(compressed_size);
+    compressed[i] =
+        compress2(chunk.compressed.data(), &compressed_size,
+                  reinterpret_cast<const Bytef*>(chunk.timers.data()), size,
+                  kCompressionLevel) == Z_OK;
+    chunk.compressed.resize(compressed_size);
+  });
+
+  for (size_t i = 0; i < pending_chunks_.size(); ++i) {
+    const PendingChunk& chunk = pending_chunks_[i];
+    if (!compressed[i]) {
+      ERROR("Could not compress %zu timers", chunk.timers.size());
+      return false;
+    }
+
+    TimerChunkIndexEntry entry = {};
+    entry.offset = stream_->tellp();
+    entry.compressed_size = static_cast<uint32_t>(chunk.compressed.size());
+    entry.num_timers = static_cast<uint32_t>(chunk.timers.size());
+    entry.thread_id = chunk.thread_id;
+    entry.begin_time = chunk.timers.front().m_Start;
+    entry.end_time = chunk.timers.front().m_End;
+    for (const Timer& timer : chunk.timers) {
+      entry.begin_time = std::min<uint64_t>(entry.begin_time, timer.m_Start);
+      entry.end_time = std::max<uint64_t>(entry.end_time, timer.m_End);
+    }
+    stream_->write(reinterpret_cast<const char*>(chunk.compressed.data()),
+                   chunk.compressed.size());
+    if (!*stream_) {
+      ERROR("Could not write timer chunk");
+      return false;
+    }
+    index_.push_back(entry);
+  }
+  pending_chunks_.clear();
+  return true;
+}
+
+bool TimerChunkReader::Open(const std::string& path) {
+  absl::MutexLock lock(&file_mutex_);
+  chunks_.clear();
+  num_timers_ = 0;
+  file_.close();
+  file_.open(path, std::ios::binary);
+
+  TimerChunkFooter footer;
+  file_.seekg(0, std::ios::end);
+  uint64_t file_size = file_.tellg();
+  if (!file_ || file_size < sizeof(footer)) {
+    ERROR("%s has no timer chunks", path.c_str());
+    return false;
+  }
+  file_.seekg(file_size - sizeof(footer));
+  uint64_t index_size = 0;
+  if (!file_.read(reinterpret_cast<char*>(&footer), sizeof(footer)) ||
+      footer.magic != TimerChunkFooter::kMagic ||
+      footer.version != TimerChunkFooter::kVersion ||
+      footer.timer_size != sizeof(Timer) ||
+      footer.index_offset > file_size - sizeof(footer) ||
+      (index_size = file_size - sizeof(footer) - footer.index_offset) !=
+          footer.num_chunks * sizeof(TimerChunkIndexEntry)) {
+    ERROR("%s has no timer chunks of this version", path.c_str());
+    file_.clear();
+    return false;
+  }
+
+  chunks_.resize(footer.num_chunks);
+  file_.seekg(footer.index_offset);
+  if (!file_.read(reinterpret_cast<char*>(chunks_.data()), index_size)) {
+    ERROR("Could not read the timer index of %s", path.c_str());
+    chunks_.clear();
+    file_.clear();
+    return false;
+  }
+  for (const TimerChunkIndexEntry& chunk : chunks_) {
+    if (chunk.offset > footer.index_offset ||
+        footer.index_offset - chunk.offset < chunk.compressed_size) {
+      ERROR("%s has a corrupted timer index", path.c_str());
+      chunks_.clear();
+      return false;
+    }
+    num_timers_ += chunk.num_timers;
+  }
+  return true;
+}
+
+std::vector<size_t> TimerChunkReader::FindChunks(uint64_t begin_time,
+                                                 uint64_t end_time) const {
+  std::vector<size_t> chunk_indices;
+  for (size_t i = 0; i < chunks_.size(); ++i) {
+    const TimerChunkIndexEntry& chunk = chunks_[i];
+    if (chunk.begin_time <= end_time && chunk.end_time >= begin_time) {
+      chunk_indices.push_back(i);
+    }
+  }
+  return chunk_indices;
+}
+
+bool TimerChunkReader::ReadChunk(size_t chunk_index,
+                                 std::vector<Timer>* timers) {
+  const TimerChunkIndexEntry& chunk = chunks_[chunk_index];
+  std::vector<unsigned char> compressed(chunk.compressed_size);
+  {
+    absl::MutexLock lock(&file_mutex_);
+    file_.seekg(chunk.offset);
+    if (!file_.read(reinterpret_cast<char*>(compressed.data()),
+                    compressed.size())) {
+      file_.clear();
+      return false;
+    }
+  }
+
+  // Decompressed outside of the lock, the expensive part.
+  timers->resize(chunk.num_timers);
+  uLongf size = chunk.num_timers * sizeof(Timer);
+  if (uncompress(reinterpret_cast<Bytef*>(timers->data()), &size,
+                 compressed.data(), compressed.size()) != Z_OK ||
+      size != chunk.num_timers * sizeof(Timer)) {
+    timers->clear();
+    return false;
+  }
+  return true;
+}
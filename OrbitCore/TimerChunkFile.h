@@ -0,0 +1,107 @@
+#ifndef ORBIT_CORE_TIMER_CHUNK_FILE_H_
+#define ORBIT_CORE_TIMER_CHUNK_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ScopeTimer.h"
+#include "absl/synchronization/mutex.h"
+
+// Timers of a saved capture, stored as zlib-compressed chunks, each holding
+// the timers of one thread over a window of time, followed by an index of the
+// chunks and a TimerChunkFooter that locates the index. The footer ends the
+// file, so the timers can follow any other content, e.g. the rest of the
+// capture, and the chunks of a time range are found from the index alone,
+// then decompressed independently, in parallel.
+struct TimerChunkIndexEntry {
+  // Of the compressed timers, in the file.
+  uint64_t offset;
+  uint32_t compressed_size;
+  uint32_t num_timers;
+  uint32_t thread_id;
+  uint32_t reserved;
+  // Earliest start and latest end of the timers of the chunk.
+  uint64_t begin_time;
+  uint64_t end_time;
+};
+
+struct TimerChunkFooter {
+  static constexpr uint32_t kMagic = 0x524d4954;
+  static constexpr uint32_t kVersion = 1;
+  uint32_t magic;
+  uint32_t version;
+  uint64_t num_chunks;
+  uint64_t index_offset;
+  uint32_t timer_size;
+  uint32_t reserved;
+};
+
+class TimerChunkWriter {
+ public:
+  static constexpr size_t kDefaultTimersPerChunk = 64 * 1024;
+
+  // Writes to stream, from its current position, which must stay valid until
+  // Close.
+  explicit TimerChunkWriter(std::ostream* stream,
+                            size_t timers_per_chunk = kDefaultTimersPerChunk)
+      : stream_(stream), timers_per_chunk_(timers_per_chunk) {}
+
+  // Adds a timer to the chunk of its thread, which is compressed and written
+  // once it holds timers_per_chunk timers, along with other full chunks on
+  // worker threads. Returns false if writing failed.
+  bool AddTimer(const Timer& timer);
+
+  // Writes the chunks still being filled, then the index and the footer.
+  bool Close();
+
+  // Of the chunks written so far.
+  uint64_t GetNumChunks() const { return index_.size(); }
+
+ private:
+  struct PendingChunk {
+    uint32_t thread_id;
+    std::vector<Timer> timers;
+    std::vector<unsigned char> compressed;
+  };
+
+  // Compresses the pending chunks in parallel, then writes them in order.
+  bool WritePendingChunks();
+
+  std::ostream* stream_;
+  size_t timers_per_chunk_;
+  std::unordered_map<uint32_t, std::vector<Timer>> chunks_;
+  std::vector<PendingChunk> pending_chunks_;
+  std::vector<TimerChunkIndexEntry> index_;
+};
+
+class TimerChunkReader {
+ public:
+  // Reads the footer and the index at the end of path. Returns false if path
+  // doesn't end with timer chunks of this version.
+  bool Open(const std::string& path);
+
+  const std::vector<TimerChunkIndexEntry>& GetChunks() const {
+    return chunks_;
+  }
+  uint64_t GetNumTimers() const { return num_timers_; }
+  // Indices of the chunks with timers between begin_time and end_time.
+  std::vector<size_t> FindChunks(uint64_t begin_time, uint64_t end_time) const;
+
+  // Replaces timers with those of the chunk, in the order they were added.
+  // Can be called from several threads at once. Returns false if the chunk
+  // can't be read or is corrupted.
+  bool ReadChunk(size_t chunk_index, std::vector<Timer>* timers);
+
+ private:
+  absl::Mutex file_mutex_;
+  std::ifstream file_ ABSL_GUARDED_BY(file_mutex_);
+  std::vector<TimerChunkIndexEntry> chunks_;
+  uint64_t num_timers_ = 0;
+};
+
+#endif  // ORBIT_CORE_TIMER_CHUNK_FILE_H_
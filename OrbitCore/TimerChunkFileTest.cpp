@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "TimerChunkFile.h"
+
+namespace {
+std::string GetTemporaryPath() {
+  return testing::TempDir() + "timer_chunk_file_test_" +
+         std::to_string(getpid()) + ".orbit";
+}
+
+Timer MakeTimer(uint32_t thread_id, TickType start, TickType end) {
+  Timer timer;
+  timer.m_TID = thread_id;
+  timer.m_Start = start;
+  timer.m_End = end;
+  return timer;
+}
+}  // namespace
+
+TEST(TimerChunkFile, WritesChunksPerThreadAfterOtherContent) {
+  std::string path = GetTemporaryPath();
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << "other content";
+    TimerChunkWriter writer(&file, /*timers_per_chunk=*/2);
+    EXPECT_TRUE(writer.AddTimer(MakeTimer(1, 100, 200)));
+    EXPECT_TRUE(writer.AddTimer(MakeTimer(2, 150, 160)));
+    EXPECT_TRUE(writer.AddTimer(MakeTimer(1, 300, 400)));
+    EXPECT_TRUE(writer.AddTimer(MakeTimer(1, 500, 600)));
+    ASSERT_TRUE(writer.Close());
+    EXPECT_EQ(writer.GetNumChunks(), 3);
+  }
+
+  TimerChunkReader reader;
+  ASSERT_TRUE(reader.Open(path));
+  ASSERT_EQ(reader.GetChunks().size(), 3);
+  EXPECT_EQ(reader.GetNumTimers(), 4);
+  EXPECT_EQ(reader.GetChunks()[0].thread_id, 1);
+  EXPECT_EQ(reader.GetChunks()[0].begin_time, 100);
+  EXPECT_EQ(reader.GetChunks()[0].end_time, 400);
+  EXPECT_EQ(reader.GetChunks()[1].thread_id, 1);
+  EXPECT_EQ(reader.GetChunks()[2].thread_id, 2);
+  EXPECT_EQ(reader.FindChunks(410, 550), std::vector<size_t>({1}));
+  EXPECT_EQ(reader.FindChunks(155, 170), std::vector<size_t>({0, 2}));
+
+  std::vector<Timer> timers;
+  ASSERT_TRUE(reader.ReadChunk(0, &timers));
+  ASSERT_EQ(timers.size(), 2);
+  EXPECT_EQ(timers[0].m_Start, 100);
+  EXPECT_EQ(timers[1].m_Start, 300);
+  ASSERT_TRUE(reader.ReadChunk(2, &timers));
+  ASSERT_EQ(timers.size(), 1);
+  EXPECT_EQ(timers[0].m_TID, 2);
+  EXPECT_EQ(timers[0].m_End, 160);
+
+  std::ifstream file(path, std::ios::binary);
+  std::string prefix(13, '\0');
+  file.read(&prefix[0], prefix.size());
+  EXPECT_EQ(prefix, "other content");
+  remove(path.c_str());
+}
+
+TEST(TimerChunkFile, KeepsTheOrderOfManyChunks) {
+  std::string path = GetTemporaryPath();
+  const uint32_t kNumThreads = 5;
+  const uint32_t kNumTimersPerThread = 1000;
+  {
+    std::ofstream file(path, std::ios::binary);
+    TimerChunkWriter writer(&file, /*timers_per_chunk=*/10);
+    for (uint32_t i = 0; i < kNumTimersPerThread; ++i) {
+      for (uint32_t thread_id = 0; thread_id < kNumThreads; ++thread_id) {
+        EXPECT_TRUE(writer.AddTimer(MakeTimer(thread_id, i, i + 1)));
+      }
+    }
+    ASSERT_TRUE(writer.Close());
+  }
+
+  TimerChunkReader reader;
+  ASSERT_TRUE(reader.Open(path));
+  EXPECT_EQ(reader.GetNumTimers(), kNumThreads * kNumTimersPerThread);
+  std::vector<TickType> next_start(kNumThreads, 0);
+  std::vector<Timer> timers;
+  for (size_t i = 0; i < reader.GetChunks().size(); ++i) {
+    ASSERT_TRUE(reader.ReadChunk(i, &timers));
+    for (const Timer& timer : timers) {
+      ASSERT_EQ(timer.m_TID, reader.GetChunks()[i].thread_id);
+      EXPECT_EQ(timer.m_Start, next_start[timer.m_TID]++);
+    }
+  }
+  remove(path.c_str());
+}
+
+TEST(TimerChunkFile, WritesEmptyIndex) {
+  std::string path = GetTemporaryPath();
+  {
+    std::ofstream file(path, std::ios::binary);
+    TimerChunkWriter writer(&file);
+    ASSERT_TRUE(writer.Close());
+  }
+
+  TimerChunkReader reader;
+  ASSERT_TRUE(reader.Open(path));
+  EXPECT_TRUE(reader.GetChunks().empty());
+  remove(path.c_str());
+}
+
+TEST(TimerChunkFile, RejectsFilesWithoutFooter) {
+  std::string path = GetTemporaryPath();
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << std::string(100, 'x');
+  }
+
+  TimerChunkReader reader;
+  EXPECT_FALSE(reader.Open(path));
+  EXPECT_FALSE(reader.Open(path + ".missing"));
+  remove(path.c_str());
+}
@@ -0,0 +1,94 @@
+#include "TimerDiff.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Serialization.h"
+#include "Utils.h"
+#include "absl/container/flat_hash_map.h"
+
+std::vector<TimingDiff> DiffFunctionTimings(
+    absl::Span<const FunctionTimings> baseline,
+    absl::Span<const FunctionTimings> comparison) {
+  std::vector<TimingDiff> diffs;
+  absl::flat_hash_map<uint64_t, size_t> diff_of_name;
+  auto add_side = [&](absl::Span<const FunctionTimings> side,
+                      bool is_baseline) {
+    for (const FunctionTimings& function : side) {
+      if (function.stats.m_Count == 0) continue;
+      auto [it, inserted] =
+          diff_of_name.try_emplace(StringHash(function.name), diffs.size());
+      if (inserted) {
+        diffs.emplace_back();
+        diffs.back().name = function.name;
+      }
+      TimingDiff& diff = diffs[it->second];
+      // The same function can be listed more than once, e.g. if its module
+      // was loaded twice.
+      (is_baseline ? diff.baseline : diff.comparison).Add(function.stats);
+      (is_baseline ? diff.baseline_address : diff.comparison_address) =
+          function.address;
+    }
+  };
+  add_side(baseline, true);
+  add_side(comparison, false);
+
+  for (TimingDiff& diff : diffs) {
+    diff.shift = GetDurationShift(diff.baseline.m_Histogram,
+                                  diff.comparison.m_Histogram);
+    diff.p_value = GetShiftPValue(diff.shift, diff.baseline.m_Count,
+                                  diff.comparison.m_Count);
+  }
+  return diffs;
+}
+
+double GetDurationShift(const LatencyHistogram& baseline,
+                        const LatencyHistogram& comparison) {
+  uint64_t num_baseline = baseline.GetTotalCount();
+  uint64_t num_comparison = comparison.GetTotalCount();
+  if (num_baseline == 0 || num_comparison == 0) return 0.0;
+
+  uint64_t cumulative_baseline = 0;
+  uint64_t cumulative_comparison = 0;
+  double shift = 0.0;
+  for (size_t i = 0; i < LatencyHistogram::kNumBuckets; ++i) {
+    cumulative_baseline += baseline.GetBucketCount(i);
+    cumulative_comparison += comparison.GetBucketCount(i);
+    double difference =
+        static_cast<double>(cumulative_baseline) / num_baseline -
+        static_cast<double>(cumulative_comparison) / num_comparison;
+    if (std::abs(difference) > std::abs(shift)) {
+      shift = difference;
+    }
+  }
+  return shift;
+}
+
+double GetShiftPValue(double shift, uint64_t num_baseline,
+                      uint64_t num_comparison) {
+  if (num_baseline == 0 || num_comparison == 0) return 1.0;
+  double n = static_cast<double>(num_baseline) * num_comparison /
+             (static_cast<double>(num_baseline) + num_comparison);
+  // With Stephens' correction for small samples.
+  double sqrt_n = std::sqrt(n);
+  double lambda = (sqrt_n + 0.12 + 0.11 / sqrt_n) * std::abs(shift);
+  if (lambda < 0.2) return 1.0;
+
+  // Q(lambda) = 2 * sum over k >= 1 of (-1)^(k-1) * exp(-2 k^2 lambda^2),
+  // whose terms vanish quickly for lambda >= 0.2.
+  double sum = 0.0;
+  double sign = 1.0;
+  for (int k = 1; k <= 100; ++k) {
+    double term = sign * std::exp(-2.0 * k * k * lambda * lambda);
+    sum += term;
+    if (std::abs(term) < 1e-12) break;
+    sign = -sign;
+  }
+  return std::clamp(2.0 * sum, 0.0, 1.0);
+}
+
+ORBIT_SERIALIZE(FunctionTimings, 0) {
+  ORBIT_NVP_VAL(0, name);
+  ORBIT_NVP_VAL(0, address);
+  ORBIT_NVP_VAL(0, stats);
+}
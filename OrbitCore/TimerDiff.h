@@ -0,0 +1,55 @@
+#ifndef ORBIT_CORE_TIMER_DIFF_H_
+#define ORBIT_CORE_TIMER_DIFF_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "FunctionStats.h"
+#include "SerializationMacros.h"
+#include "absl/types/span.h"
+
+// Calls of an instrumented function in a capture, as summarized by its stats:
+// diffing them needs neither side's timers.
+struct FunctionTimings {
+  std::string name;
+  uint64_t address = 0;
+  FunctionStats stats;
+
+  ORBIT_SERIALIZABLE;
+};
+
+// Durations of a function in a baseline and a comparison capture.
+struct TimingDiff {
+  std::string name;
+  // 0 on the side the function wasn't called on.
+  uint64_t baseline_address = 0;
+  uint64_t comparison_address = 0;
+  FunctionStats baseline;
+  FunctionStats comparison;
+  // Largest difference between the fractions of the calls that took at most
+  // a given duration, baseline minus comparison, from the histograms: in
+  // [-1, 1], positive if the comparison is slower.
+  double shift = 0.0;
+  // Probability of a shift at least as large if both sides had the same
+  // distribution of durations, from a two-sample Kolmogorov-Smirnov test. 1
+  // if either side has no calls.
+  double p_value = 1.0;
+};
+
+// Aligns the functions of both sides by the hash of their names, so that
+// captures of different builds line up, and compares the distributions of
+// their durations. Costs O(functions * LatencyHistogram::kNumBuckets),
+// however many calls were made.
+std::vector<TimingDiff> DiffFunctionTimings(
+    absl::Span<const FunctionTimings> baseline,
+    absl::Span<const FunctionTimings> comparison);
+
+// See TimingDiff::shift. Durations in the same bucket count as equal.
+double GetDurationShift(const LatencyHistogram& baseline,
+                        const LatencyHistogram& comparison);
+// See TimingDiff::p_value, from the asymptotic distribution of the statistic.
+double GetShiftPValue(double shift, uint64_t num_baseline,
+                      uint64_t num_comparison);
+
+#endif  // ORBIT_CORE_TIMER_DIFF_H_
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "ScopeTimer.h"
+#include "TimerDiff.h"
+
+namespace {
+FunctionTimings MakeTimings(const std::string& name, uint64_t address,
+                            const std::vector<TickType>& durations_us) {
+  FunctionTimings timings;
+  timings.name = name;
+  timings.address = address;
+  for (TickType duration : durations_us) {
+    Timer timer;
+    timer.m_Start = 0;
+    timer.m_End = duration;
+    timings.stats.Update(timer);
+  }
+  return timings;
+}
+
+const TimingDiff* FindDiff(const std::vector<TimingDiff>& diffs,
+                           const std::string& name) {
+  for (const TimingDiff& diff : diffs) {
+    if (diff.name == name) {
+      return &diff;
+    }
+  }
+  return nullptr;
+}
+}  // namespace
+
+TEST(TimerDiff, AlignsFunctionsByName) {
+  std::vector<FunctionTimings> baseline = {
+      MakeTimings("A", 0x100, {10, 20}), MakeTimings("B", 0x200, {30})};
+  std::vector<FunctionTimings> comparison = {
+      MakeTimings("C", 0x1300, {40}), MakeTimings("A", 0x1100, {10}),
+      MakeTimings("D", 0x1400, {})};
+  std::vector<TimingDiff> diffs = DiffFunctionTimings(baseline, comparison);
+  // D was never called.
+  ASSERT_EQ(diffs.size(), 3);
+
+  const TimingDiff* a = FindDiff(diffs, "A");
+  ASSERT_NE(a, nullptr);
+  EXPECT_EQ(a->baseline_address, 0x100);
+  EXPECT_EQ(a->comparison_address, 0x1100);
+  EXPECT_EQ(a->baseline.m_Count, 2);
+  EXPECT_EQ(a->comparison.m_Count, 1);
+
+  const TimingDiff* b = FindDiff(diffs, "B");
+  ASSERT_NE(b, nullptr);
+  EXPECT_EQ(b->comparison_address, 0);
+  EXPECT_EQ(b->comparison.m_Count, 0);
+  EXPECT_DOUBLE_EQ(b->p_value, 1.0);
+
+  const TimingDiff* c = FindDiff(diffs, "C");
+  ASSERT_NE(c, nullptr);
+  EXPECT_EQ(c->baseline_address, 0);
+}
+
+TEST(TimerDiff, FlagsShiftedDistributions) {
+  std::vector<TickType> fast(500, 100);
+  std::vector<TickType> slow(500, 200);
+  std::vector<TickType> mixed;
+  for (int i = 0; i < 250; ++i) {
+    mixed.push_back(100);
+    mixed.push_back(200);
+  }
+
+  std::vector<TimingDiff> diffs =
+      DiffFunctionTimings({MakeTimings("Same", 1, mixed),
+                           MakeTimings("Slower", 2, fast)},
+                          {MakeTimings("Same", 1, mixed),
+                           MakeTimings("Slower", 2, slow)});
+
+  const TimingDiff* same = FindDiff(diffs, "Same");
+  ASSERT_NE(same, nullptr);
+  EXPECT_DOUBLE_EQ(same->shift, 0.0);
+  EXPECT_DOUBLE_EQ(same->p_value, 1.0);
+
+  const TimingDiff* slower = FindDiff(diffs, "Slower");
+  ASSERT_NE(slower, nullptr);
+  EXPECT_DOUBLE_EQ(slower->shift, 1.0);
+  EXPECT_LT(slower->p_value, 1e-6);
+}
+
+TEST(TimerDiff, PValueDecreasesWithTheNumberOfCalls) {
+  double few = GetShiftPValue(0.2, 20, 20);
+  double many = GetShiftPValue(0.2, 2000, 2000);
+  EXPECT_GT(few, 0.05);
+  EXPECT_LT(many, 0.001);
+  EXPECT_DOUBLE_EQ(GetShiftPValue(-0.2, 20, 20), few);
+  EXPECT_DOUBLE_EQ(GetShiftPValue(0.5, 0, 20), 1.0);
+}
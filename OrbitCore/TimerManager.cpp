@@ -4,22 +4,34 @@
 
 #include "TimerManager.h"
 
+#include "CoreActivity.h"
 #include "Message.h"
 #include "OrbitLib.h"
 #include "Params.h"
 #include "TcpClient.h"
 #include "TcpForward.h"
 #include "Threading.h"
+#include "TimerBatch.h"
 
 #ifdef _WIN32
 #include <direct.h>
 #endif
 
+#include <algorithm>
+
 std::unique_ptr<TimerManager> GTimerManager;
 
+namespace {
+std::atomic<uint64_t> GNextTimerManagerId = 1;
+// Timers dequeued at once from the shared queue, and sent per message.
+constexpr size_t kTimerBulkSize = 4096;
+}  // namespace
+
 //-----------------------------------------------------------------------------
 TimerManager::TimerManager(bool a_IsClient)
-    : m_LockFreeQueue(65534), m_IsClient(a_IsClient) {
+    : m_LockFreeQueue(65534),
+      m_IsClient(a_IsClient),
+      m_Id(GNextTimerManagerId++) {
   m_Paused = false;
   m_IsFull = false;
   m_IsRecording = false;
@@ -77,17 +89,11 @@ void TimerManager::StopClient() {
 void TimerManager::FlushQueue() {
   m_FlushRequested = true;
 
-  const size_t numTimers = 4096;
-  Timer Timers[numTimers];
+  std::vector<Timer> timers;
   m_NumFlushedTimers = 0;
 
-  while (!m_ExitRequested) {
-    size_t numDequeued = m_LockFreeQueue.try_dequeue_bulk(Timers, numTimers);
-
-    if (numDequeued == 0) break;
-
-    m_NumQueuedEntries -= (int)numDequeued;
-    m_NumFlushedTimers += (int)numDequeued;
+  while (!m_ExitRequested && DequeueTimers(&timers)) {
+    m_NumFlushedTimers += (int)timers.size();
 
     if (m_IsClient) {
       int numEntries = m_NumFlushedTimers;
@@ -117,27 +123,23 @@ void TimerManager::ConsumeTimers() {
   SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
 #endif
 
-  Timer Timer;
+  std::vector<Timer> timers;
 
   while (!m_ExitRequested) {
     m_ConditionVariable.wait();
 
-    while (!m_ExitRequested && !m_FlushRequested &&
-           m_LockFreeQueue.try_dequeue(Timer)) {
-      --m_NumQueuedEntries;
-      --m_NumQueuedTimers;
-
-      // if( Timer.m_SessionID == Message::GSessionID ) // TODO: re-enable
-      // check.
-      {
+    while (!m_ExitRequested && !m_FlushRequested && DequeueTimers(&timers)) {
+      for (Timer& Timer : timers) {
+        // if( Timer.m_SessionID == Message::GSessionID ) // TODO: re-enable
+        // check.
         for (TimerAddedCallback& Callback : m_TimerAddedCallbacks) {
           Callback(Timer);
         }
       }
-      /*else
-      {
-          ++m_NumTimersFromPreviousSession;
-      }*/
+    }
+
+    for (TimersConsumedCallback& Callback : m_TimersConsumedCallbacks) {
+      Callback();
     }
   }
 }
@@ -146,43 +148,158 @@ void TimerManager::ConsumeTimers() {
 void TimerManager::SendTimers() {
   SetCurrentThreadName(L"OrbitSendTimers");
 
-  constexpr size_t numTimers = 4096;
-
-  Timer timers[numTimers];
+  std::vector<Timer> timers;
 
   while (!m_ExitRequested) {
-    Message Msg(Msg_Timer);
-
-    // Wait for non-empty queue
-    while (m_NumQueuedEntries <= 0 && !m_ExitRequested) {
-      m_ConditionVariable.wait();
-    }
-
-    size_t numDequeued = m_LockFreeQueue.try_dequeue_bulk(timers, numTimers);
-    m_NumQueuedEntries -= (int)numDequeued;
-    m_NumQueuedTimers -= (int)numDequeued;
+    m_ConditionVariable.wait();
 
-    GTcpClient->Send(Msg, timers, numDequeued * sizeof(Timer));
+    while (!m_ExitRequested && DequeueTimers(&timers)) {
+      for (size_t i = 0; i < timers.size(); i += kTimerBulkSize) {
+        size_t numTimers = std::min(kTimerBulkSize, timers.size() - i);
+        Message Msg(Msg_Timer);
+        GTcpClient->Send(Msg, timers.data() + i, numTimers * sizeof(Timer));
+      }
 
-    int numEntries = m_NumQueuedEntries;
-    GTcpClient->Send(Msg_NumQueuedEntries, numEntries);
+      int numEntries = m_NumQueuedEntries;
+      GTcpClient->Send(Msg_NumQueuedEntries, numEntries);
+    }
 
+    Message Msg;
     while (m_LockFreeMessageQueue.try_dequeue(Msg) && !m_ExitRequested) {
       --m_NumQueuedEntries;
       --m_NumQueuedMessages;
       GTcpClient->Send(Msg);
     }
+
+    // The batch holds what was sent while the timers were being sent, so it
+    // grows with the rate of the data.
+    std::vector<char> userData = m_UserDataBatcher.TakeBatch();
+    if (!userData.empty()) {
+      GTcpClient->Send(Msg_UserDataBatch, std::move(userData));
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void TimerManager::AddUserData(const Orbit::UserData& a_Entry) {
+  bool wasEmpty = false;
+  std::vector<char> batch = m_UserDataBatcher.Add(a_Entry, &wasEmpty);
+  if (!batch.empty()) {
+    GTcpClient->Send(Msg_UserDataBatch, std::move(batch));
+  } else if (wasEmpty) {
+    m_ConditionVariable.signal();
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool TimerManager::DequeueTimers(std::vector<Timer>* a_Timers) {
+  a_Timers->clear();
+  std::vector<ThreadBuffer*> buffers;
+  {
+    std::lock_guard<std::mutex> lock(m_ThreadBuffersMutex);
+    buffers.reserve(m_ThreadBuffers.size());
+    for (const auto& pair : m_ThreadBuffers) {
+      buffers.push_back(pair.second.get());
+    }
   }
+
+  std::lock_guard<std::mutex> lock(m_DequeueMutex);
+  for (ThreadBuffer* buffer : buffers) {
+    // Reset before reading, so that a timer added meanwhile is either read
+    // now or signals the consumer again.
+    buffer->m_NumUnconsumed.exchange(0);
+    buffer->m_Timers.PopAll(a_Timers);
+  }
+
+  size_t numBuffered = a_Timers->size();
+  a_Timers->resize(numBuffered + kTimerBulkSize);
+  size_t numDequeued = m_LockFreeQueue.try_dequeue_bulk(
+      a_Timers->data() + numBuffered, kTimerBulkSize);
+  a_Timers->resize(numBuffered + numDequeued);
+  m_NumQueuedEntries -= (int)numDequeued;
+  m_NumQueuedTimers -= (int)numDequeued;
+  return !a_Timers->empty();
+}
+
+//-----------------------------------------------------------------------------
+TimerManager::ThreadBuffer* TimerManager::GetBufferOfCurrentThread() {
+  // Only take m_ThreadBuffersMutex the first time a thread adds a timer.
+  thread_local uint64_t cachedManagerId = 0;
+  thread_local ThreadBuffer* cachedBuffer = nullptr;
+  if (cachedManagerId == m_Id) {
+    return cachedBuffer;
+  }
+
+  std::lock_guard<std::mutex> lock(m_ThreadBuffersMutex);
+  std::unique_ptr<ThreadBuffer>& buffer =
+      m_ThreadBuffers[std::this_thread::get_id()];
+  if (buffer == nullptr) {
+    buffer = std::make_unique<ThreadBuffer>();
+  }
+  cachedManagerId = m_Id;
+  cachedBuffer = buffer.get();
+  return cachedBuffer;
 }
 
 //-----------------------------------------------------------------------------
 void TimerManager::Add(const Timer& a_Timer) {
-  if (m_IsRecording) {
-    m_LockFreeQueue.enqueue(a_Timer);
+  if (!m_IsRecording) {
+    return;
+  }
+
+  ThreadBuffer* buffer = GetBufferOfCurrentThread();
+  Timer timer = a_Timer;
+  if (buffer->m_Timers.TryPush(std::move(timer))) {
+    // Only the first timer since the consumer last read the buffer wakes it.
+    if (++buffer->m_NumUnconsumed == 1) {
+      m_ConditionVariable.signal();
+    }
+    return;
+  }
+
+  // The consumer is behind, don't drop the timer.
+  m_LockFreeQueue.enqueue(a_Timer);
+  m_ConditionVariable.signal();
+  ++m_NumQueuedEntries;
+  ++m_NumQueuedTimers;
+}
+
+//-----------------------------------------------------------------------------
+void TimerManager::Add(const Timer* a_Timers, size_t a_NumTimers) {
+  if (m_IsRecording && a_NumTimers > 0) {
+    m_LockFreeQueue.enqueue_bulk(a_Timers, a_NumTimers);
     m_ConditionVariable.signal();
-    ++m_NumQueuedEntries;
-    ++m_NumQueuedTimers;
+    m_NumQueuedEntries += (int)a_NumTimers;
+    m_NumQueuedTimers += (int)a_NumTimers;
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool TimerManager::AddEncodedTimers(const void* a_Data, size_t a_Size) {
+  // Reused across the batches decoded by a thread.
+  thread_local std::vector<Timer> timers;
+  timers.clear();
+  if (!DecodeTimerBatch(a_Data, a_Size, &timers)) {
+    return false;
   }
+  Add(timers.data(), timers.size());
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool TimerManager::AddEncodedCoreActivities(const void* a_Data, size_t a_Size) {
+  thread_local std::vector<CoreActivity> core_activities;
+  thread_local std::vector<Timer> timers;
+  core_activities.clear();
+  if (!DecodeCoreActivities(a_Data, a_Size, &core_activities)) {
+    return false;
+  }
+  timers.clear();
+  for (const CoreActivity& core_activity : core_activities) {
+    timers.push_back(MakeCoreActivityTimer(core_activity));
+  }
+  Add(timers.data(), timers.size());
+  return true;
 }
 
 //-----------------------------------------------------------------------------
@@ -199,3 +316,10 @@ void TimerManager::Add(const Message& a_Message) {
 void TimerManager::Add(const ContextSwitch& a_CS) {
   if (m_ContextSwitchAddedCallback) m_ContextSwitchAddedCallback(a_CS);
 }
+
+//-----------------------------------------------------------------------------
+void TimerManager::Add(const ThreadStateChange& thread_state_change) {
+  if (m_ThreadStateChangeAddedCallback) {
+    m_ThreadStateChangeAddedCallback(thread_state_change);
+  }
+}
@@ -6,6 +6,8 @@
 #include <atomic>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -13,11 +15,14 @@
 #include "Message.h"
 #include "Profiling.h"
 #include "ScopeTimer.h"
+#include "SpscQueue.h"
 #include "Threading.h"
+#include "UserDataBatch.h"
 
 class TcpClient;
 class Message;
 struct ContextSwitch;
+struct ThreadStateChange;
 
 //-----------------------------------------------------------------------------
 class TimerManager {
@@ -32,12 +37,29 @@ class TimerManager {
   void StartClient();
   void StopClient();
 
+  // Adds a timer to the buffer of the calling thread, or to the shared queue
+  // if that buffer is full, so that threads adding timers at once don't
+  // contend on the shared queue.
   void Add(const Timer& a_Timer);
+  void Add(const Timer* a_Timers, size_t a_NumTimers);
+  // Adds the timers of a batch encoded with EncodeTimerBatch. Returns false if
+  // the batch is corrupted.
+  bool AddEncodedTimers(const void* a_Data, size_t a_Size);
+  // Adds the Timer::CORE_ACTIVITY timers of a batch encoded with
+  // EncodeCoreActivities. Returns false if the batch is corrupted.
+  bool AddEncodedCoreActivities(const void* a_Data, size_t a_Size);
   void Add(const Message& a_Message);
   void Add(const ContextSwitch& a_CS);
+  void Add(const ThreadStateChange& thread_state_change);
+  // The entries of OrbitSendData are sent in batches as Msg_UserDataBatch,
+  // by the sender thread, or right away by the caller filling a batch.
+  void AddUserData(const Orbit::UserData& a_Entry);
 
   void ConsumeTimers();
   void SendTimers();
+  // Replaces a_Timers with those of the thread buffers and the next ones of
+  // the shared queue. Returns false if there were none.
+  bool DequeueTimers(std::vector<Timer>* a_Timers);
   bool HasQueuedEntries() const { return m_NumQueuedEntries > 0; }
   void FlushQueue();
 
@@ -49,6 +71,7 @@ class TimerManager {
   std::atomic<bool> m_IsRecording;
   std::atomic<bool> m_ExitRequested;
   std::atomic<bool> m_FlushRequested;
+  // Of the shared queues, not counting the timers of the thread buffers.
   std::atomic<int> m_NumQueuedEntries;
   std::atomic<int> m_NumQueuedTimers;
   std::atomic<int> m_NumQueuedMessages;
@@ -61,13 +84,44 @@ class TimerManager {
   LockFreeQueue<Message> m_LockFreeMessageQueue;
   std::thread* m_ConsumerThread = nullptr;
   bool m_IsClient = false;
+  UserDataBatcher m_UserDataBatcher;
 
   typedef std::function<void(Timer&)> TimerAddedCallback;
   std::vector<TimerAddedCallback> m_TimerAddedCallbacks;
 
+  // Called by the consumer thread each time it has emptied the queue.
+  typedef std::function<void()> TimersConsumedCallback;
+  std::vector<TimersConsumedCallback> m_TimersConsumedCallbacks;
+
   typedef std::function<void(const struct ContextSwitch&)>
       ContextSwitchAddedCallback;
   ContextSwitchAddedCallback m_ContextSwitchAddedCallback;
+
+  typedef std::function<void(const struct ThreadStateChange&)>
+      ThreadStateChangeAddedCallback;
+  ThreadStateChangeAddedCallback m_ThreadStateChangeAddedCallback;
+
+  // Capacity of the timer buffer of each thread, allocated when the thread
+  // first adds a timer.
+  static constexpr size_t kThreadBufferCapacity = 4096;
+
+ private:
+  struct ThreadBuffer {
+    SpscQueue<Timer> m_Timers{kThreadBufferCapacity};
+    // Timers added since the consumer last emptied the buffer.
+    std::atomic<size_t> m_NumUnconsumed = 0;
+  };
+
+  ThreadBuffer* GetBufferOfCurrentThread();
+
+  // Identifies this manager in the thread-local buffer caches.
+  const uint64_t m_Id;
+  std::mutex m_ThreadBuffersMutex;
+  // Buffers are only destroyed with the manager, as threads keep pointers.
+  std::unordered_map<std::thread::id, std::unique_ptr<ThreadBuffer>>
+      m_ThreadBuffers;
+  // Ensures a single consumer at a time for the thread buffers.
+  std::mutex m_DequeueMutex;
 };
 
 //-----------------------------------------------------------------------------
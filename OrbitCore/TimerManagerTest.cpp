@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "TimerManager.h"
+
+namespace {
+Timer MakeTimer(uint32_t thread_id, TickType start) {
+  Timer timer;
+  timer.m_TID = thread_id;
+  timer.m_Start = start;
+  timer.m_End = start + 1;
+  return timer;
+}
+}  // namespace
+
+TEST(TimerManager, DequeuesTheTimersOfEachThreadInOrder) {
+  TimerManager manager;
+  manager.m_IsRecording = true;
+  const uint32_t kNumThreads = 4;
+  // Beyond the buffer of each thread, so that some go to the shared queue.
+  const uint32_t kNumTimersPerThread = TimerManager::kThreadBufferCapacity + 10;
+  std::vector<std::thread> threads;
+  for (uint32_t thread_id = 0; thread_id < kNumThreads; ++thread_id) {
+    threads.emplace_back([&manager, thread_id, kNumTimersPerThread] {
+      for (uint32_t i = 0; i < kNumTimersPerThread; ++i) {
+        manager.Add(MakeTimer(thread_id, i));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<uint32_t> num_timers(kNumThreads, 0);
+  std::vector<Timer> timers;
+  while (manager.DequeueTimers(&timers)) {
+    for (const Timer& timer : timers) {
+      ASSERT_LT(timer.m_TID, kNumThreads);
+      ++num_timers[timer.m_TID];
+    }
+  }
+  EXPECT_EQ(num_timers,
+            std::vector<uint32_t>(kNumThreads, kNumTimersPerThread));
+  EXPECT_EQ(manager.m_NumQueuedTimers, 0);
+}
+
+TEST(TimerManager, ConsumesTimersAddedFromManyThreads) {
+  TimerManager manager;
+  std::atomic<uint32_t> num_consumed = 0;
+  manager.m_TimerAddedCallbacks.push_back([&](Timer&) { ++num_consumed; });
+  manager.StartRecording();
+
+  const uint32_t kNumThreads = 8;
+  const uint32_t kNumTimersPerThread = 10000;
+  std::vector<std::thread> threads;
+  for (uint32_t thread_id = 0; thread_id < kNumThreads; ++thread_id) {
+    threads.emplace_back([&manager, thread_id, kNumTimersPerThread] {
+      for (uint32_t i = 0; i < kNumTimersPerThread; ++i) {
+        manager.Add(MakeTimer(thread_id, i));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (num_consumed < kNumThreads * kNumTimersPerThread &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(num_consumed, kNumThreads * kNumTimersPerThread);
+  manager.Stop();
+}
@@ -0,0 +1,64 @@
+#ifndef ORBIT_CORE_TRACE_EVENTS_H_
+#define ORBIT_CORE_TRACE_EVENTS_H_
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "ContextSwitch.h"
+
+// Formats of the traces of other tools that Orbit reads and writes, see
+// ChromeTrace.h and PerfettoTrace.h.
+enum class TraceFormat { kChromeJson, kPerfetto };
+
+// From the extension of file_name: .json, or .pftrace and .perfetto-trace.
+inline std::optional<TraceFormat> GetTraceFormat(std::string_view file_name) {
+  auto ends_with = [file_name](std::string_view suffix) {
+    return file_name.size() >= suffix.size() &&
+           file_name.substr(file_name.size() - suffix.size()) == suffix;
+  };
+  if (ends_with(".json")) return TraceFormat::kChromeJson;
+  if (ends_with(".pftrace") || ends_with(".perfetto-trace")) {
+    return TraceFormat::kPerfetto;
+  }
+  return std::nullopt;
+}
+
+// A scope of a thread, a Timer with a name rather than a function.
+struct TraceScope {
+  uint32_t tid = 0;
+  // Number of enclosing scopes on the thread.
+  uint32_t depth = 0;
+  uint64_t start_ns = 0;
+  uint64_t end_ns = 0;
+  std::string_view name;
+};
+
+// Receives the events of a trace as it is read, in the order of the file.
+// Views are valid for the duration of the call only.
+class TraceEventVisitor {
+ public:
+  virtual ~TraceEventVisitor() = default;
+  virtual void OnThreadName(uint32_t /*tid*/, std::string_view /*name*/) {}
+  // Not necessarily in the order the scopes start.
+  virtual void OnScope(const TraceScope& /*scope*/) {}
+  virtual void OnContextSwitch(const ContextSwitch& /*context_switch*/) {}
+};
+
+// Writes the events of a capture to a trace as they are added.
+class TraceEventWriter {
+ public:
+  virtual ~TraceEventWriter() = default;
+  virtual void AddThreadName(uint32_t pid, uint32_t tid,
+                             std::string_view name) = 0;
+  // The scopes of a thread are added in the order they start, enclosing
+  // scopes before the scopes they contain. depth is ignored.
+  virtual void AddScope(uint32_t pid, const TraceScope& scope) = 0;
+  // Those of a core are added in time order.
+  virtual void AddContextSwitch(uint32_t pid,
+                                const ContextSwitch& context_switch) = 0;
+  // Ends the trace. Returns false if it couldn't be written.
+  virtual bool Close() = 0;
+};
+
+#endif  // ORBIT_CORE_TRACE_EVENTS_H_
@@ -0,0 +1,130 @@
+#include "TrigramIndex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <numeric>
+
+#include "ParallelFor.h"
+
+namespace {
+// Intersecting with a posting list costs about its size, checking the texts
+// about their number times their length: lists this much longer than the
+// candidates are not worth intersecting with.
+constexpr size_t kMaxPostingsPerCandidate = 16;
+// Below this many candidates, checking them isn't worth starting threads.
+constexpr size_t kMinCandidatesPerShard = 16 * 1024;
+}  // namespace
+
+uint32_t TrigramIndex::Add(std::string_view text) {
+  uint32_t id = static_cast<uint32_t>(offsets_.size());
+  size_t offset = arena_.size();
+  offsets_.push_back(offset);
+  for (char c : text) {
+    arena_.push_back(
+        static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+  }
+  arena_.push_back('\0');
+
+  for (size_t i = offset; i + 3 <= offset + text.size(); ++i) {
+    std::vector<uint32_t>& ids = postings_[GetTrigram(&arena_[i])];
+    if (ids.empty() || ids.back() != id) {
+      ids.push_back(id);
+    }
+  }
+  return id;
+}
+
+void TrigramIndex::Clear() {
+  arena_.clear();
+  arena_.shrink_to_fit();
+  offsets_.clear();
+  offsets_.shrink_to_fit();
+  postings_.clear();
+}
+
+std::string_view TrigramIndex::GetText(uint32_t id) const {
+  size_t begin = offsets_[id];
+  size_t end = id + 1 < offsets_.size() ? offsets_[id + 1] : arena_.size();
+  return std::string_view(arena_.data() + begin, end - begin - 1);
+}
+
+bool TrigramIndex::Contains(uint32_t id,
+                            const std::vector<std::string>& tokens) const {
+  std::string_view text = GetText(id);
+  for (const std::string& token : tokens) {
+    if (text.find(token) == std::string_view::npos) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<uint32_t> TrigramIndex::Find(
+    const std::vector<std::string>& tokens,
+    const std::vector<uint32_t>* candidates) const {
+  // Posting lists of the trigrams of the tokens, shortest first.
+  std::vector<const std::vector<uint32_t>*> lists;
+  for (const std::string& token : tokens) {
+    for (size_t i = 0; i + 3 <= token.size(); ++i) {
+      auto it = postings_.find(GetTrigram(&token[i]));
+      if (it == postings_.end()) {
+        return {};
+      }
+      lists.push_back(&it->second);
+    }
+  }
+  std::sort(lists.begin(), lists.end(),
+            [](const std::vector<uint32_t>* a, const std::vector<uint32_t>* b) {
+              return a->size() != b->size() ? a->size() < b->size() : a < b;
+            });
+  lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+
+  std::vector<uint32_t> ids;
+  bool has_ids = candidates != nullptr;
+  if (has_ids) {
+    ids = *candidates;
+  }
+  for (const std::vector<uint32_t>* list : lists) {
+    if (!has_ids) {
+      ids = *list;
+      has_ids = true;
+      continue;
+    }
+    if (list->size() > kMaxPostingsPerCandidate * ids.size()) {
+      break;
+    }
+    std::vector<uint32_t> intersection;
+    std::set_intersection(ids.begin(), ids.end(), list->begin(), list->end(),
+                          std::back_inserter(intersection));
+    ids.swap(intersection);
+  }
+  if (!has_ids) {
+    ids.resize(size());
+    std::iota(ids.begin(), ids.end(), 0);
+  }
+
+  // The candidates only contain the trigrams of the tokens, in any order.
+  size_t num_shards =
+      std::min(GetNumWorkers(), ids.size() / kMinCandidatesPerShard);
+  if (num_shards <= 1) {
+    auto is_not_match = [&](uint32_t id) { return !Contains(id, tokens); };
+    ids.erase(std::remove_if(ids.begin(), ids.end(), is_not_match), ids.end());
+    return ids;
+  }
+
+  std::vector<std::vector<uint32_t>> shard_matches(num_shards);
+  ParallelFor(num_shards, [&](size_t shard) {
+    size_t begin = shard * ids.size() / num_shards;
+    size_t end = (shard + 1) * ids.size() / num_shards;
+    for (size_t i = begin; i < end; ++i) {
+      if (Contains(ids[i], tokens)) {
+        shard_matches[shard].push_back(ids[i]);
+      }
+    }
+  });
+  std::vector<uint32_t> matches;
+  for (const std::vector<uint32_t>& shard_match : shard_matches) {
+    matches.insert(matches.end(), shard_match.begin(), shard_match.end());
+  }
+  return matches;
+}
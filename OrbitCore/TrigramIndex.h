@@ -0,0 +1,54 @@
+#ifndef ORBIT_CORE_TRIGRAM_INDEX_H_
+#define ORBIT_CORE_TRIGRAM_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+
+// Finds the texts containing all of a few substrings, case-insensitively,
+// among hundreds of thousands, e.g. the names of the functions of a process
+// as the user types a filter. The texts are lowercased once into one arena,
+// and the texts containing each trigram, each sequence of three characters,
+// are listed: the candidates for a substring of three characters or more
+// are those containing all of its trigrams, usually a small fraction of the
+// texts, which are then checked, in parallel if there are many. Texts are
+// only added, with increasing ids.
+class TrigramIndex {
+ public:
+  // Adds text and returns its id, the number of texts added before.
+  uint32_t Add(std::string_view text);
+  void Clear();
+
+  size_t size() const { return offsets_.size(); }
+  bool empty() const { return offsets_.empty(); }
+  // Lowercased text of id.
+  std::string_view GetText(uint32_t id) const;
+
+  // Ids of the texts containing all the tokens, which must be lowercase, in
+  // increasing order. If candidates isn't null, only the ids it lists, in
+  // increasing order, are considered: the matches of a shorter filter, to
+  // refine as the filter grows.
+  std::vector<uint32_t> Find(
+      const std::vector<std::string>& tokens,
+      const std::vector<uint32_t>* candidates = nullptr) const;
+
+ private:
+  static uint32_t GetTrigram(const char* text) {
+    return static_cast<uint8_t>(text[0]) |
+           static_cast<uint8_t>(text[1]) << 8 |
+           static_cast<uint8_t>(text[2]) << 16;
+  }
+  bool Contains(uint32_t id, const std::vector<std::string>& tokens) const;
+
+  // The texts one after the other, each followed by a '\0'.
+  std::string arena_;
+  std::vector<size_t> offsets_;
+  // Ids of the texts containing each trigram, in increasing order.
+  absl::flat_hash_map<uint32_t, std::vector<uint32_t>> postings_;
+};
+
+#endif  // ORBIT_CORE_TRIGRAM_INDEX_H_
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "TrigramIndex.h"
+
+namespace {
+TrigramIndex MakeIndex() {
+  TrigramIndex index;
+  index.Add("Foo::Bar() libfoo.so");
+  index.Add("foo::baz() libfoo.so");
+  index.Add("main hello");
+  index.Add("ab");
+  return index;
+}
+}  // namespace
+
+TEST(TrigramIndex, LowercasesTexts) {
+  TrigramIndex index = MakeIndex();
+  EXPECT_EQ(index.size(), 4);
+  EXPECT_EQ(index.GetText(0), "foo::bar() libfoo.so");
+  EXPECT_EQ(index.GetText(3), "ab");
+}
+
+TEST(TrigramIndex, FindsTextsContainingAllTokens) {
+  TrigramIndex index = MakeIndex();
+  EXPECT_EQ(index.Find({"foo"}), (std::vector<uint32_t>{0, 1}));
+  EXPECT_EQ(index.Find({"bar", "libfoo"}), (std::vector<uint32_t>{0}));
+  EXPECT_EQ(index.Find({"hello", "main"}), (std::vector<uint32_t>{2}));
+  EXPECT_TRUE(index.Find({"bar", "hello"}).empty());
+  EXPECT_TRUE(index.Find({"qux"}).empty());
+}
+
+TEST(TrigramIndex, ChecksTokensShorterThanATrigram) {
+  TrigramIndex index = MakeIndex();
+  EXPECT_EQ(index.Find({"b"}), (std::vector<uint32_t>{0, 1, 3}));
+  EXPECT_EQ(index.Find({"ab"}), (std::vector<uint32_t>{3}));
+  EXPECT_EQ(index.Find({}), (std::vector<uint32_t>{0, 1, 2, 3}));
+}
+
+TEST(TrigramIndex, TrigramsInAnyOrderAreNotAMatch) {
+  TrigramIndex index;
+  index.Add("abcxbcd");
+  EXPECT_TRUE(index.Find({"abcd"}).empty());
+  EXPECT_EQ(index.Find({"xbcd"}), (std::vector<uint32_t>{0}));
+}
+
+TEST(TrigramIndex, RefinesCandidates) {
+  TrigramIndex index = MakeIndex();
+  std::vector<uint32_t> candidates = index.Find({"foo"});
+  EXPECT_EQ(index.Find({"foo::baz"}, &candidates),
+            (std::vector<uint32_t>{1}));
+  std::vector<uint32_t> none;
+  EXPECT_TRUE(index.Find({"foo"}, &none).empty());
+}
+
+TEST(TrigramIndex, MatchesAScanOfManyTexts) {
+  TrigramIndex index;
+  std::vector<std::string> texts;
+  for (uint32_t i = 0; i < 100 * 1000; ++i) {
+    texts.push_back("ns" + std::to_string(i % 97) + "::function" +
+                    std::to_string(i));
+    index.Add(texts.back());
+  }
+  std::vector<std::string> tokens = {"ns4", "function12"};
+  std::vector<uint32_t> expected;
+  for (uint32_t i = 0; i < texts.size(); ++i) {
+    if (texts[i].find(tokens[0]) != std::string::npos &&
+        texts[i].find(tokens[1]) != std::string::npos) {
+      expected.push_back(i);
+    }
+  }
+  EXPECT_EQ(index.Find(tokens), expected);
+  EXPECT_EQ(index.Find({"function"}).size(), texts.size());
+}
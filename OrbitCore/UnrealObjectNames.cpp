@@ -0,0 +1,111 @@
+#include "UnrealObjectNames.h"
+
+#include <cstring>
+#include <iterator>
+
+namespace {
+constexpr uint64_t kAddressMask = (uint64_t{1} << 48) - 1;
+
+uint64_t MakeKey(uint64_t uobject, uint32_t generation) {
+  return (uint64_t{generation & 0xffff} << 48) | (uobject & kAddressMask);
+}
+
+uint32_t GetKeyGeneration(uint64_t key) {
+  return static_cast<uint32_t>(key >> 48);
+}
+}  // namespace
+
+bool SentUObjectSet::CheckAndInsert(uint64_t uobject) {
+  const uint32_t generation = GetGeneration();
+  const uint64_t key = MakeKey(uobject, generation);
+
+  // UObjects are aligned, the low bits of their addresses are all the same.
+  uint32_t index =
+      static_cast<uint32_t>(((uobject >> 4) * 0x9e3779b97f4a7c15ull) >> 32);
+  for (uint32_t i = 0; i < kMaxProbes; ++i, ++index) {
+    std::atomic<uint64_t>& slot = slots_[index & (kNumSlots - 1)];
+    uint64_t value = slot.load(std::memory_order_relaxed);
+    if (value == key) {
+      return true;
+    }
+    // The slots of previous generations are free.
+    if (value != 0 && GetKeyGeneration(value) == (generation & 0xffff)) {
+      continue;
+    }
+    if (slot.compare_exchange_strong(value, key, std::memory_order_relaxed)) {
+      if (num_inserted_.fetch_add(1, std::memory_order_relaxed) + 1 >=
+          kNumSlots / 2) {
+        NewGeneration();
+      }
+      return false;
+    }
+    if (value == key) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void SentUObjectSet::NewGeneration() {
+  num_inserted_.store(0, std::memory_order_relaxed);
+  generation_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SentUObjectSet::ClearForSession(uint32_t session_id) {
+  if (session_id_.exchange(session_id) != session_id) {
+    NewGeneration();
+  }
+}
+
+void EncodeUObjectName(uint64_t uobject, const void* name, uint32_t size,
+                       bool wide, std::string* output) {
+  uint8_t is_wide = wide ? 1 : 0;
+  output->append(reinterpret_cast<const char*>(&uobject), sizeof(uobject));
+  output->append(reinterpret_cast<const char*>(&size), sizeof(size));
+  output->append(reinterpret_cast<const char*>(&is_wide), sizeof(is_wide));
+  output->append(static_cast<const char*>(name), size);
+}
+
+bool DecodeUObjectNames(
+    const void* data, size_t size,
+    std::vector<std::pair<uint64_t, std::wstring>>* names) {
+  const char* bytes = static_cast<const char*>(data);
+  std::vector<std::pair<uint64_t, std::wstring>> decoded;
+  size_t offset = 0;
+  while (offset < size) {
+    uint64_t uobject;
+    uint32_t name_size;
+    uint8_t is_wide;
+    if (size - offset < sizeof(uobject) + sizeof(name_size) + sizeof(is_wide)) {
+      return false;
+    }
+    memcpy(&uobject, bytes + offset, sizeof(uobject));
+    offset += sizeof(uobject);
+    memcpy(&name_size, bytes + offset, sizeof(name_size));
+    offset += sizeof(name_size);
+    memcpy(&is_wide, bytes + offset, sizeof(is_wide));
+    offset += sizeof(is_wide);
+    if (size - offset < name_size ||
+        (is_wide != 0 && name_size % sizeof(char16_t) != 0)) {
+      return false;
+    }
+
+    std::wstring name;
+    if (is_wide != 0) {
+      name.resize(name_size / sizeof(char16_t));
+      for (size_t i = 0; i < name.size(); ++i) {
+        char16_t c;
+        memcpy(&c, bytes + offset + i * sizeof(c), sizeof(c));
+        name[i] = static_cast<wchar_t>(c);
+      }
+    } else {
+      name.assign(bytes + offset, bytes + offset + name_size);
+    }
+    offset += name_size;
+    decoded.emplace_back(uobject, std::move(name));
+  }
+
+  names->insert(names->end(), std::make_move_iterator(decoded.begin()),
+                std::make_move_iterator(decoded.end()));
+  return true;
+}
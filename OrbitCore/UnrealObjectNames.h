@@ -0,0 +1,58 @@
+#ifndef ORBIT_CORE_UNREAL_OBJECT_NAMES_H_
+#define ORBIT_CORE_UNREAL_OBJECT_NAMES_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The UObjects whose names the injected dll sent, shared by all the threads
+// so that the name of an actor hit every frame is only sent once: an open
+// addressing table inserted into without locking. Each slot holds the
+// address of an object with the generation it was sent in, in the 16 bits
+// above the 48 of the address. Starting a new generation forgets all the
+// objects at once, their slots being free again, which is done for each
+// session and whenever half of the slots are taken, as objects are
+// destroyed and their addresses reused for others. When the probed slots are
+// all taken, the name is sent again, a harmless duplicate.
+class SentUObjectSet {
+ public:
+  // A power of 2.
+  static constexpr uint32_t kNumSlots = 16 * 1024;
+  static constexpr uint32_t kMaxProbes = 16;
+
+  // Whether the name of uobject, not null, was sent already in the current
+  // generation, remembering it if not.
+  bool CheckAndInsert(uint64_t uobject);
+
+  void NewGeneration();
+  // Starts a new generation once per session.
+  void ClearForSession(uint32_t session_id);
+
+  uint32_t GetGeneration() const {
+    return generation_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<uint64_t> slots_[kNumSlots] = {};
+  std::atomic<uint32_t> generation_ = 1;
+  std::atomic<uint32_t> num_inserted_ = 0;
+  std::atomic<uint32_t> session_id_ = static_cast<uint32_t>(-1);
+};
+
+// Payload of Msg_OrbitUnrealObjects, which carries the names of a batch of
+// UObjects: for each, its address as a uint64_t, the size of its name in
+// bytes as a uint32_t, whether the name is of wchar_t as a uint8_t, then the
+// name, without terminator. Wide names are UTF-16, the wchar_t of Windows.
+void EncodeUObjectName(uint64_t uobject, const void* name, uint32_t size,
+                       bool wide, std::string* output);
+
+// Appends the decoded names to names. Returns false, and leaves names
+// unchanged, if data is not a valid encoding.
+bool DecodeUObjectNames(
+    const void* data, size_t size,
+    std::vector<std::pair<uint64_t, std::wstring>>* names);
+
+#endif  // ORBIT_CORE_UNREAL_OBJECT_NAMES_H_
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "UnrealObjectNames.h"
+
+TEST(SentUObjectSet, RemembersObjectsPerGeneration) {
+  auto sent = std::make_unique<SentUObjectSet>();
+  EXPECT_FALSE(sent->CheckAndInsert(0x7ff612340010));
+  EXPECT_TRUE(sent->CheckAndInsert(0x7ff612340010));
+  EXPECT_FALSE(sent->CheckAndInsert(0x7ff612340020));
+
+  sent->NewGeneration();
+  EXPECT_FALSE(sent->CheckAndInsert(0x7ff612340010));
+  EXPECT_TRUE(sent->CheckAndInsert(0x7ff612340010));
+}
+
+TEST(SentUObjectSet, StartsOneGenerationPerSession) {
+  auto sent = std::make_unique<SentUObjectSet>();
+  sent->ClearForSession(1);
+  EXPECT_FALSE(sent->CheckAndInsert(0x1000));
+  sent->ClearForSession(1);
+  EXPECT_TRUE(sent->CheckAndInsert(0x1000));
+  sent->ClearForSession(2);
+  EXPECT_FALSE(sent->CheckAndInsert(0x1000));
+}
+
+TEST(SentUObjectSet, StartsNewGenerationWhenHalfFull) {
+  auto sent = std::make_unique<SentUObjectSet>();
+  uint32_t generation = sent->GetGeneration();
+  for (uint64_t i = 1; i < SentUObjectSet::kNumSlots / 2; ++i) {
+    sent->CheckAndInsert(i * 0x40);
+  }
+  EXPECT_EQ(sent->GetGeneration(), generation);
+  EXPECT_TRUE(sent->CheckAndInsert(0x40));
+  sent->CheckAndInsert(SentUObjectSet::kNumSlots * 0x40);
+  EXPECT_EQ(sent->GetGeneration(), generation + 1);
+  EXPECT_FALSE(sent->CheckAndInsert(0x40));
+}
+
+TEST(UObjectNames, EncodeDecode) {
+  std::string data;
+  EncodeUObjectName(0x1000, "Actor_1", 7, false, &data);
+  const char16_t wide_name[] = u"Pawn";
+  EncodeUObjectName(0x2000, wide_name, 4 * sizeof(char16_t), true, &data);
+
+  std::vector<std::pair<uint64_t, std::wstring>> names;
+  ASSERT_TRUE(DecodeUObjectNames(data.data(), data.size(), &names));
+  ASSERT_EQ(names.size(), 2);
+  EXPECT_EQ(names[0].first, 0x1000);
+  EXPECT_EQ(names[0].second, L"Actor_1");
+  EXPECT_EQ(names[1].first, 0x2000);
+  EXPECT_EQ(names[1].second, L"Pawn");
+
+  EXPECT_FALSE(DecodeUObjectNames(data.data(), data.size() - 1, &names));
+  EXPECT_EQ(names.size(), 2);
+}
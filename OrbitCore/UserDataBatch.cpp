@@ -0,0 +1,62 @@
+#include "UserDataBatch.h"
+
+#include <cstring>
+#include <utility>
+
+void AppendUserData(const Orbit::UserData& entry, std::vector<char>* batch) {
+  size_t num_bytes = entry.m_NumBytes > 0 ? entry.m_NumBytes : 0;
+  size_t offset = batch->size();
+  batch->resize(offset + sizeof(Orbit::UserData) + num_bytes);
+  Orbit::UserData header = entry;
+  header.m_Data = nullptr;
+  header.m_NumBytes = static_cast<int>(num_bytes);
+  std::memcpy(batch->data() + offset, &header, sizeof(header));
+  if (num_bytes > 0) {
+    std::memcpy(batch->data() + offset + sizeof(header), entry.m_Data,
+                num_bytes);
+  }
+}
+
+bool DecodeUserDataBatch(const void* data, size_t size,
+                         std::vector<Orbit::UserData>* entries) {
+  const char* bytes = static_cast<const char*>(data);
+  size_t num_entries = entries->size();
+  size_t offset = 0;
+  while (offset < size) {
+    Orbit::UserData entry;
+    if (size - offset < sizeof(entry)) break;
+    std::memcpy(&entry, bytes + offset, sizeof(entry));
+    offset += sizeof(entry);
+    if (entry.m_NumBytes < 0 ||
+        static_cast<size_t>(entry.m_NumBytes) > size - offset) {
+      break;
+    }
+    entry.m_Data = const_cast<char*>(bytes + offset);
+    offset += entry.m_NumBytes;
+    entries->push_back(entry);
+  }
+  if (offset != size) {
+    entries->resize(num_entries);
+    return false;
+  }
+  return true;
+}
+
+std::vector<char> UserDataBatcher::Add(const Orbit::UserData& entry,
+                                       bool* was_empty) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  *was_empty = batch_.empty();
+  if (batch_.empty()) {
+    batch_.reserve(kMaxBatchSize);
+  }
+  AppendUserData(entry, &batch_);
+  if (batch_.size() < kMaxBatchSize) {
+    return {};
+  }
+  return std::exchange(batch_, {});
+}
+
+std::vector<char> UserDataBatcher::TakeBatch() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::exchange(batch_, {});
+}
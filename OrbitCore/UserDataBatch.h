@@ -0,0 +1,41 @@
+#ifndef ORBIT_CORE_USER_DATA_BATCH_H_
+#define ORBIT_CORE_USER_DATA_BATCH_H_
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "../OrbitPlugin/OrbitUserData.h"
+
+// Payload of Msg_UserDataBatch: the entries sent with OrbitSendData since the
+// previous batch, each as its Orbit::UserData header, whose m_Data is
+// meaningless, followed by its m_NumBytes bytes. The payloads of a batch
+// share the one buffer, which the plugins read in place, see
+// Orbit::Plugin::ReceiveUserDataBatch.
+void AppendUserData(const Orbit::UserData& entry, std::vector<char>* batch);
+
+// Appends the entries of the batch to entries, their m_Data pointing into
+// data, which must outlive them. Returns false, and leaves entries unchanged,
+// if data is not a valid batch.
+bool DecodeUserDataBatch(const void* data, size_t size,
+                         std::vector<Orbit::UserData>* entries);
+
+// Collects the entries sent from any thread into batches.
+class UserDataBatcher {
+ public:
+  // Batches are handed over once this large, without waiting for TakeBatch.
+  static constexpr size_t kMaxBatchSize = 256 * 1024;
+
+  // Returns the batch to send if entry filled it, an empty one otherwise.
+  // Sets *was_empty if entry started a new batch, for the caller to wake up
+  // the thread calling TakeBatch only once per batch.
+  std::vector<char> Add(const Orbit::UserData& entry, bool* was_empty);
+  // The entries added since the last batch, empty if there are none.
+  std::vector<char> TakeBatch();
+
+ private:
+  std::mutex mutex_;
+  std::vector<char> batch_;
+};
+
+#endif  // ORBIT_CORE_USER_DATA_BATCH_H_
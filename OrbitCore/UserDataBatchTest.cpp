@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "UserDataBatch.h"
+
+namespace {
+Orbit::UserData MakeUserData(uint64_t time, const std::string& bytes) {
+  Orbit::UserData entry;
+  entry.m_Time = time;
+  entry.m_ThreadId = 42;
+  entry.m_NumBytes = static_cast<int>(bytes.size());
+  entry.m_Data = const_cast<char*>(bytes.data());
+  return entry;
+}
+}  // namespace
+
+TEST(UserDataBatch, DecodesEntriesInPlace) {
+  std::string first = "first payload";
+  std::string second;
+  std::vector<char> batch;
+  AppendUserData(MakeUserData(1, first), &batch);
+  AppendUserData(MakeUserData(2, second), &batch);
+
+  std::vector<Orbit::UserData> entries;
+  ASSERT_TRUE(DecodeUserDataBatch(batch.data(), batch.size(), &entries));
+  ASSERT_EQ(entries.size(), 2);
+  EXPECT_EQ(entries[0].m_Time, 1);
+  EXPECT_EQ(entries[0].m_ThreadId, 42);
+  ASSERT_EQ(entries[0].m_NumBytes, first.size());
+  EXPECT_EQ(std::string(static_cast<const char*>(entries[0].m_Data),
+                        entries[0].m_NumBytes),
+            first);
+  // The payloads are not copied out of the batch.
+  EXPECT_GE(static_cast<const char*>(entries[0].m_Data), batch.data());
+  EXPECT_LT(static_cast<const char*>(entries[0].m_Data),
+            batch.data() + batch.size());
+  EXPECT_EQ(entries[1].m_Time, 2);
+  EXPECT_EQ(entries[1].m_NumBytes, 0);
+}
+
+TEST(UserDataBatch, RejectsTruncatedBatches) {
+  std::vector<char> batch;
+  AppendUserData(MakeUserData(1, "payload"), &batch);
+
+  std::vector<Orbit::UserData> entries(1);
+  EXPECT_FALSE(DecodeUserDataBatch(batch.data(), batch.size() - 1, &entries));
+  EXPECT_FALSE(DecodeUserDataBatch(batch.data(), 4, &entries));
+  EXPECT_EQ(entries.size(), 1);
+}
+
+TEST(UserDataBatcher, HandsOverFullBatches) {
+  UserDataBatcher batcher;
+  std::string bytes(1000, 'x');
+  bool was_empty = false;
+  EXPECT_TRUE(batcher.Add(MakeUserData(0, bytes), &was_empty).empty());
+  EXPECT_TRUE(was_empty);
+  EXPECT_TRUE(batcher.Add(MakeUserData(1, bytes), &was_empty).empty());
+  EXPECT_FALSE(was_empty);
+  std::vector<char> batch = batcher.TakeBatch();
+  std::vector<Orbit::UserData> entries;
+  ASSERT_TRUE(DecodeUserDataBatch(batch.data(), batch.size(), &entries));
+  EXPECT_EQ(entries.size(), 2);
+  EXPECT_TRUE(batcher.TakeBatch().empty());
+
+  size_t num_added = 0;
+  for (;;) {
+    ++num_added;
+    batch = batcher.Add(MakeUserData(num_added, bytes), &was_empty);
+    if (!batch.empty()) break;
+  }
+  EXPECT_GE(batch.size(), UserDataBatcher::kMaxBatchSize);
+  entries.clear();
+  ASSERT_TRUE(DecodeUserDataBatch(batch.data(), batch.size(), &entries));
+  EXPECT_EQ(entries.size(), num_added);
+  batcher.Add(MakeUserData(0, bytes), &was_empty);
+  EXPECT_TRUE(was_empty);
+}
@@ -37,8 +37,7 @@ void Variable::SendValue() {
 void Variable::SyncValue() {
   if (Capture::Connect()) {
     Message msg(Msg_GetData);
-    ULONG64 address = (ULONG64)m_Pdb->GetHModule() + (ULONG64)m_Address;
-    msg.m_Header.m_DataTransferHeader.m_Address = address;
+    msg.m_Header.m_DataTransferHeader.m_Address = GetRemoteAddress();
     msg.m_Header.m_DataTransferHeader.m_Type = DataTransferHeader::Data;
     msg.m_Size = m_Size;
     m_SyncTimer->Start();
@@ -46,18 +45,26 @@ void Variable::SyncValue() {
   }
 }
 
+uint64_t Variable::GetRemoteAddress() const {
+  return (ULONG64)m_Pdb->GetHModule() + (ULONG64)m_Address;
+}
+
 void Variable::ReceiveValue(const Message& a_Msg) {
   m_SyncTimer->Stop();
   ORBIT_LOGV(m_SyncTimer->ElapsedMillis());
-  if (a_Msg.m_Size != m_Size) {
+  ReceiveValue(a_Msg.GetData(), a_Msg.m_Size);
+}
+
+void Variable::ReceiveValue(const char* a_Data, uint32_t a_Size) {
+  if (a_Size != m_Size) {
     ORBIT_LOG("Variable::ReceiveValue size mismatch");
   } else {
     if (IsBasicType()) {
-      memcpy(&m_Data, a_Msg.GetData(), m_Size);
+      memcpy(&m_Data, a_Data, m_Size);
       GCoreApp->UpdateVariable(this);
     } else {
       m_RawData.resize(m_Size);
-      memcpy(m_RawData.data(), a_Msg.GetData(), m_Size);
+      memcpy(m_RawData.data(), a_Data, m_Size);
       UpdateFromRaw(m_RawData, m_Address);
     }
   }
@@ -70,6 +70,9 @@ class Variable {
   void SendValue();
   void SyncValue();
   void ReceiveValue(const Message& a_Msg);
+  void ReceiveValue(const char* a_Data, uint32_t a_Size);
+  // Address of the variable in the target.
+  uint64_t GetRemoteAddress() const;
   void UpdateFromRaw(const std::vector<char>& a_RawData, DWORD64 a_BaseAddress);
   void Print();
   void Print(int a_Indent, DWORD64& a_ByteCounter, DWORD64 a_TotalSize);
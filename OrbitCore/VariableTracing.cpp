@@ -14,9 +14,13 @@ VariableTracing& VariableTracing::Get() {
 void VariableTracing::Trace(const char* a_Msg) {
   static size_t maxEntries = 128;
 
-  if (Get().m_Entries.size() < maxEntries) {
+  // Checked again under the lock, but entries past the limit don't take it.
+  if (Get().m_NumEntries < maxEntries) {
     ScopeLock lock(Get().m_Mutex);
-    Get().m_Entries.push_back(a_Msg);
+    if (Get().m_Entries.size() < maxEntries) {
+      Get().m_Entries.push_back(a_Msg);
+      Get().m_NumEntries = Get().m_Entries.size();
+    }
   }
 }
 
@@ -29,6 +33,7 @@ void VariableTracing::ProcessCallbacks() {
   }
 
   Get().m_Entries.clear();
+  Get().m_NumEntries = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -37,4 +42,5 @@ void VariableTracing::AddCallback(TraceCallback a_Callback) {
   ScopeLock lock(Get().m_Mutex);
 
   Get().m_Callbacks.push_back(a_Callback);
+  Get().m_HasCallbacks = true;
 }
@@ -3,11 +3,14 @@
 //-----------------------------------
 #pragma once
 
+#include <atomic>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <type_traits>
 #include <vector>
 
+#include "OrbitBase/Tracing.h"
 #include "PrintVar.h"
 #include "Threading.h"
 
@@ -24,6 +27,11 @@ class VariableTracing {
 
   static void Trace(const char* a_Msg);
   static void ProcessCallbacks();
+  // Whether the entries are shown anywhere, for TraceVar to only format the
+  // values then.
+  static bool HasCallbacks() {
+    return Get().m_HasCallbacks.load(std::memory_order_relaxed);
+  }
 
  protected:
   VariableTracing() {}
@@ -31,12 +39,23 @@ class VariableTracing {
  protected:
   Mutex m_Mutex;
   std::vector<std::string> m_Entries;
+  std::atomic<size_t> m_NumEntries = 0;
   std::vector<TraceCallback> m_Callbacks;
+  std::atomic<bool> m_HasCallbacks = false;
 };
 
 //-----------------------------------------------------------------------------
+// a_VarName is a string literal. Numeric values are also recorded as they are,
+// without formatting or locking, to be plotted on a counter track while Orbit
+// is introspected, see ORBIT_TRACK.
 template <class T>
 inline void TraceVar(const char* a_VarName, const T& a_Value) {
+  if constexpr (std::is_arithmetic_v<T>) {
+    if (orbit::tracing::IsListening()) {
+      orbit::tracing::TrackValue(a_VarName, static_cast<double>(a_Value));
+    }
+  }
+  if (!VariableTracing::HasCallbacks()) return;
   std::stringstream l_StringStream;
   l_StringStream << a_VarName << " = " << a_Value;
   VariableTracing::Trace(l_StringStream.str().c_str());
@@ -44,6 +63,10 @@ inline void TraceVar(const char* a_VarName, const T& a_Value) {
 
 //-----------------------------------------------------------------------------
 inline void TraceVar(const char* a_VarName, float a_Value) {
+  if (orbit::tracing::IsListening()) {
+    orbit::tracing::TrackValue(a_VarName, a_Value);
+  }
+  if (!VariableTracing::HasCallbacks()) return;
   std::stringstream l_StringStream;
   static int precision = 20;
   l_StringStream << a_VarName << " = " << std::setprecision(precision)
@@ -0,0 +1,75 @@
+#ifndef ORBIT_CORE_VARINT_H_
+#define ORBIT_CORE_VARINT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Helpers of the compact encodings of the event batches sent from the
+// service, see TimerBatch.h and CoreActivity.h. Integers are written as
+// little-endian base 128 varints, differences that can be negative as
+// zigzag varints.
+
+inline void WriteVarint(uint64_t value, std::string* output) {
+  while (value >= 0x80) {
+    output->push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  output->push_back(static_cast<char>(value));
+}
+
+inline uint64_t ZigZagEncode(uint64_t difference) {
+  auto value = static_cast<int64_t>(difference);
+  return (difference << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline uint64_t ZigZagDecode(uint64_t value) {
+  return (value >> 1) ^ -(value & 1);
+}
+
+class VarintReader {
+ public:
+  VarintReader(const void* data, size_t size)
+      : current_(static_cast<const uint8_t*>(data)),
+        end_(current_ + size) {}
+
+  size_t remaining() const { return end_ - current_; }
+
+  bool ReadBytes(size_t size, const uint8_t** bytes) {
+    if (remaining() < size) {
+      return false;
+    }
+    *bytes = current_;
+    current_ += size;
+    return true;
+  }
+
+  bool ReadVarint(uint64_t* value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64 && current_ < end_; shift += 7) {
+      uint8_t byte = *current_++;
+      result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        *value = result;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Reads a varint that has to be lower than limit.
+  bool ReadIndex(uint64_t limit, uint32_t* index) {
+    uint64_t value;
+    if (!ReadVarint(&value) || value >= limit) {
+      return false;
+    }
+    *index = static_cast<uint32_t>(value);
+    return true;
+  }
+
+ private:
+  const uint8_t* current_;
+  const uint8_t* end_;
+};
+
+#endif  // ORBIT_CORE_VARINT_H_
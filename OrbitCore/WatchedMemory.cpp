@@ -0,0 +1,167 @@
+#include "WatchedMemory.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace {
+constexpr size_t kRunHeaderSize = 2 * sizeof(uint32_t);
+
+// Unique across processes, so that a late reply for the ranges of a process
+// is not taken for those of another.
+std::atomic<uint32_t> g_next_layout_id = 1;
+
+void AppendRun(const std::vector<char>& memory, size_t begin, size_t end,
+               std::vector<char>* delta) {
+  uint32_t header[2] = {static_cast<uint32_t>(begin),
+                        static_cast<uint32_t>(end - begin)};
+  const char* header_bytes = reinterpret_cast<const char*>(header);
+  delta->insert(delta->end(), header_bytes, header_bytes + kRunHeaderSize);
+  delta->insert(delta->end(), memory.begin() + begin, memory.begin() + end);
+}
+}  // namespace
+
+std::vector<WatchedRange> CoalesceWatchedRanges(
+    std::vector<WatchedRange> ranges, uint64_t max_gap) {
+  std::sort(ranges.begin(), ranges.end(),
+            [](const WatchedRange& a, const WatchedRange& b) {
+              return a.address < b.address;
+            });
+  std::vector<WatchedRange> coalesced;
+  for (const WatchedRange& range : ranges) {
+    if (range.size == 0) continue;
+    if (!coalesced.empty()) {
+      WatchedRange& last = coalesced.back();
+      uint64_t last_end = last.address + last.size;
+      if (range.address <= last_end + max_gap) {
+        last.size = std::max(last_end, range.address + range.size) -
+                    last.address;
+        continue;
+      }
+    }
+    coalesced.push_back(range);
+  }
+  return coalesced;
+}
+
+std::vector<char> EncodeWatchedDelta(const std::vector<char>& previous,
+                                     const std::vector<char>& current) {
+  std::vector<char> delta;
+  if (previous.size() != current.size()) {
+    if (!current.empty()) AppendRun(current, 0, current.size(), &delta);
+    return delta;
+  }
+
+  // Unchanged bytes shorter than a run header are sent within the run.
+  size_t size = current.size();
+  size_t i = 0;
+  while (i < size) {
+    if (previous[i] == current[i]) {
+      ++i;
+      continue;
+    }
+    size_t begin = i;
+    size_t end = i + 1;
+    for (i = end; i < size && i < end + kRunHeaderSize; ++i) {
+      if (previous[i] != current[i]) end = i + 1;
+    }
+    AppendRun(current, begin, end, &delta);
+    i = end;
+  }
+  return delta;
+}
+
+void WatchedMemory::SetRanges(const std::vector<WatchedRange>& ranges) {
+  std::vector<WatchedRange> coalesced = CoalesceWatchedRanges(ranges);
+  bool same = coalesced.size() == ranges_.size() &&
+              std::equal(coalesced.begin(), coalesced.end(), ranges_.begin(),
+                         [](const WatchedRange& a, const WatchedRange& b) {
+                           return a.address == b.address && a.size == b.size;
+                         });
+  if (same) return;
+
+  ranges_ = std::move(coalesced);
+  offsets_.clear();
+  size_t offset = 0;
+  for (const WatchedRange& range : ranges_) {
+    offsets_.push_back(offset);
+    offset += range.size;
+  }
+  memory_.assign(offset, 0);
+  changed_.clear();
+  has_read_ = false;
+  layout_id_ = g_next_layout_id++;
+}
+
+bool WatchedMemory::ApplyDelta(uint32_t layout_id, const char* delta,
+                               size_t size) {
+  if (layout_id != layout_id_) return false;
+
+  std::vector<std::pair<size_t, size_t>> changed;
+  size_t i = 0;
+  while (i < size) {
+    if (size - i < kRunHeaderSize) return false;
+    uint32_t header[2];
+    memcpy(header, delta + i, kRunHeaderSize);
+    i += kRunHeaderSize;
+    size_t offset = header[0];
+    size_t run_size = header[1];
+    if (run_size > size - i || offset > memory_.size() ||
+        run_size > memory_.size() - offset) {
+      return false;
+    }
+    memcpy(memory_.data() + offset, delta + i, run_size);
+    changed.emplace_back(offset, offset + run_size);
+    i += run_size;
+  }
+  changed_ = std::move(changed);
+  has_read_ = true;
+  return true;
+}
+
+size_t WatchedMemory::GetOffset(uint64_t address, uint64_t size) const {
+  auto it = std::upper_bound(
+      ranges_.begin(), ranges_.end(), address,
+      [](uint64_t a, const WatchedRange& range) { return a < range.address; });
+  if (it == ranges_.begin()) return SIZE_MAX;
+  --it;
+  if (address + size > it->address + it->size) return SIZE_MAX;
+  return offsets_[it - ranges_.begin()] + (address - it->address);
+}
+
+const char* WatchedMemory::GetChanged(uint64_t address, uint64_t size) const {
+  size_t offset = GetOffset(address, size);
+  if (offset == SIZE_MAX) return nullptr;
+  // The first run ending after offset is the only one that may overlap.
+  auto run = std::upper_bound(changed_.begin(), changed_.end(), offset,
+                              [](size_t o, const std::pair<size_t, size_t>& r) {
+                                return o < r.second;
+                              });
+  if (run == changed_.end() || run->first >= offset + size) return nullptr;
+  return memory_.data() + offset;
+}
+
+std::vector<char> WatchedMemoryReader::Read(const WatchedRange* ranges,
+                                            size_t num_ranges, bool full,
+                                            const ReadFunction& read) {
+  bool same = num_ranges == ranges_.size() &&
+              std::equal(ranges_.begin(), ranges_.end(), ranges,
+                         [](const WatchedRange& a, const WatchedRange& b) {
+                           return a.address == b.address && a.size == b.size;
+                         });
+  if (!same) ranges_.assign(ranges, ranges + num_ranges);
+  if (!same || full) memory_.clear();
+
+  size_t total_size = 0;
+  for (const WatchedRange& range : ranges_) total_size += range.size;
+  std::vector<char> current(total_size);
+  size_t offset = 0;
+  for (const WatchedRange& range : ranges_) {
+    read(range.address, range.size, current.data() + offset);
+    offset += range.size;
+  }
+
+  std::vector<char> delta = EncodeWatchedDelta(memory_, current);
+  memory_ = std::move(current);
+  return delta;
+}
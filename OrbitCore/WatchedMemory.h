@@ -0,0 +1,86 @@
+#ifndef ORBIT_CORE_WATCHED_MEMORY_H_
+#define ORBIT_CORE_WATCHED_MEMORY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// The memory of the target the watched variables are in. Instead of one
+// Msg_GetData round trip per variable, the variables are coalesced into
+// ranges, all read by a single Msg_GetWatchedData, and the target replies
+// with a Msg_WatchedData holding only the bytes that changed since it last
+// read the same ranges.
+//
+// A delta is a sequence of runs, each a uint32_t offset into the ranges laid
+// out one after the other, a uint32_t size and the size bytes at that
+// offset.
+
+// Sent as is in Msg_GetWatchedData.
+struct WatchedRange {
+  uint64_t address;
+  uint64_t size;
+};
+
+// Ranges of the variables, sorted, with the ranges closer than max_gap
+// merged: reading the bytes in between is cheaper than another range.
+std::vector<WatchedRange> CoalesceWatchedRanges(
+    std::vector<WatchedRange> ranges, uint64_t max_gap = 64);
+
+// The runs of current that differ from previous. A previous of another size
+// was for other ranges, all of current is then sent.
+std::vector<char> EncodeWatchedDelta(const std::vector<char>& previous,
+                                     const std::vector<char>& current);
+
+// The host side, kept by the process the variables are watched in.
+class WatchedMemory {
+ public:
+  // The ranges of the variables, coalesced. Replies for other ranges are
+  // dropped from then on.
+  void SetRanges(const std::vector<WatchedRange>& ranges);
+  const std::vector<WatchedRange>& GetRanges() const { return ranges_; }
+  // Identifies the ranges in requests, and in the replies to them.
+  uint32_t GetLayoutId() const { return layout_id_; }
+  // Until a delta for the ranges is applied, the target is to send all of
+  // them, whatever it read of them before.
+  bool NeedsFullRead() const { return !has_read_; }
+
+  // Applies the delta of a reply, false if it is not for the current ranges
+  // or malformed.
+  bool ApplyDelta(uint32_t layout_id, const char* delta, size_t size);
+  // The bytes at [address, address + size) if any of them changed in the
+  // last delta applied, nullptr otherwise or if they are not watched.
+  const char* GetChanged(uint64_t address, uint64_t size) const;
+
+ private:
+  // Offset of address in the memory, SIZE_MAX if it's not in a range.
+  size_t GetOffset(uint64_t address, uint64_t size) const;
+
+  std::vector<WatchedRange> ranges_;
+  // Offset of each range in memory_.
+  std::vector<size_t> offsets_;
+  std::vector<char> memory_;
+  uint32_t layout_id_ = 0;
+  bool has_read_ = false;
+  // [offset, end) of the runs of the last delta, sorted.
+  std::vector<std::pair<size_t, size_t>> changed_;
+};
+
+// The target side: what it last read, to only send what changed.
+class WatchedMemoryReader {
+ public:
+  using ReadFunction =
+      std::function<void(uint64_t address, uint64_t size, char* buffer)>;
+
+  // Reads the ranges with read, and returns the delta to what was last read
+  // of the same ranges, or all of them if full.
+  std::vector<char> Read(const WatchedRange* ranges, size_t num_ranges,
+                         bool full, const ReadFunction& read);
+
+ private:
+  std::vector<WatchedRange> ranges_;
+  std::vector<char> memory_;
+};
+
+#endif  // ORBIT_CORE_WATCHED_MEMORY_H_
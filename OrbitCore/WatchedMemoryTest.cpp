@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+#include "WatchedMemory.h"
+
+namespace {
+// The memory of a target, at address 0x1000.
+class FakeTarget {
+ public:
+  FakeTarget() : memory_(256, 0) {}
+
+  std::vector<char> Read(const WatchedMemory& watched) {
+    const std::vector<WatchedRange>& ranges = watched.GetRanges();
+    return reader_.Read(ranges.data(), ranges.size(), watched.NeedsFullRead(),
+                        [this](uint64_t address, uint64_t size, char* buffer) {
+                          memcpy(buffer, &memory_[address - 0x1000], size);
+                        });
+  }
+
+  std::vector<char> memory_;
+  WatchedMemoryReader reader_;
+};
+
+bool Apply(WatchedMemory* watched, const std::vector<char>& delta) {
+  return watched->ApplyDelta(watched->GetLayoutId(), delta.data(),
+                             delta.size());
+}
+}  // namespace
+
+TEST(WatchedMemory, CoalescesCloseRanges) {
+  std::vector<WatchedRange> ranges = CoalesceWatchedRanges(
+      {{0x2000, 8}, {0x1000, 4}, {0x1008, 4}, {0x1002, 4}, {0x3000, 0}}, 16);
+  ASSERT_EQ(ranges.size(), 2);
+  EXPECT_EQ(ranges[0].address, 0x1000);
+  EXPECT_EQ(ranges[0].size, 12);
+  EXPECT_EQ(ranges[1].address, 0x2000);
+  EXPECT_EQ(ranges[1].size, 8);
+}
+
+TEST(WatchedMemory, EncodesOnlyTheChangedBytes) {
+  std::vector<char> previous(1000, 0);
+  std::vector<char> current = previous;
+  EXPECT_TRUE(EncodeWatchedDelta(previous, current).empty());
+  current[10] = 1;
+  current[12] = 2;
+  current[500] = 3;
+  // Two runs, the first holding the unchanged byte in between.
+  EXPECT_EQ(EncodeWatchedDelta(previous, current).size(), 2 * 8 + 3 + 1);
+  // All of current if previous is for other ranges.
+  EXPECT_EQ(EncodeWatchedDelta({}, current).size(), 8 + current.size());
+}
+
+TEST(WatchedMemory, UpdatesTheChangedVariables) {
+  FakeTarget target;
+  target.memory_[0] = 1;
+  target.memory_[200] = 2;
+  WatchedMemory watched;
+  watched.SetRanges({{0x1000, 4}, {0x1004, 4}, {0x10c8, 8}});
+  ASSERT_EQ(watched.GetRanges().size(), 2);
+
+  // The first read holds everything.
+  ASSERT_TRUE(Apply(&watched, target.Read(watched)));
+  EXPECT_FALSE(watched.NeedsFullRead());
+  ASSERT_NE(watched.GetChanged(0x1000, 4), nullptr);
+  EXPECT_EQ(*watched.GetChanged(0x1000, 4), 1);
+  EXPECT_EQ(*watched.GetChanged(0x10c8, 8), 2);
+  EXPECT_EQ(watched.GetChanged(0x10f0, 4), nullptr);
+
+  target.memory_[5] = 3;
+  std::vector<char> delta = target.Read(watched);
+  EXPECT_EQ(delta.size(), 8 + 1);
+  ASSERT_TRUE(Apply(&watched, delta));
+  EXPECT_EQ(watched.GetChanged(0x1000, 4), nullptr);
+  EXPECT_EQ(watched.GetChanged(0x10c8, 8), nullptr);
+  ASSERT_NE(watched.GetChanged(0x1004, 4), nullptr);
+  EXPECT_EQ(watched.GetChanged(0x1004, 4)[1], 3);
+
+  ASSERT_TRUE(Apply(&watched, target.Read(watched)));
+  EXPECT_EQ(watched.GetChanged(0x1004, 4), nullptr);
+}
+
+TEST(WatchedMemory, DropsRepliesForOtherRanges) {
+  FakeTarget target;
+  WatchedMemory watched;
+  watched.SetRanges({{0x1000, 4}});
+  uint32_t layout_id = watched.GetLayoutId();
+  std::vector<char> delta = target.Read(watched);
+  watched.SetRanges({{0x1000, 4}});
+  EXPECT_EQ(watched.GetLayoutId(), layout_id);
+  watched.SetRanges({{0x1000, 8}});
+  EXPECT_NE(watched.GetLayoutId(), layout_id);
+  EXPECT_FALSE(watched.ApplyDelta(layout_id, delta.data(), delta.size()));
+  EXPECT_TRUE(watched.NeedsFullRead());
+
+  // Runs out of the ranges are malformed.
+  std::vector<char> bad = target.Read(watched);
+  bad[0] = 100;
+  EXPECT_FALSE(Apply(&watched, bad));
+}
+
+TEST(WatchedMemory, ReadsEverythingForANewHost) {
+  FakeTarget target;
+  target.memory_[0] = 7;
+  WatchedMemory first;
+  first.SetRanges({{0x1000, 4}});
+  ASSERT_TRUE(Apply(&first, target.Read(first)));
+
+  // The target read the same ranges for the first host.
+  WatchedMemory second;
+  second.SetRanges({{0x1000, 4}});
+  ASSERT_TRUE(Apply(&second, target.Read(second)));
+  ASSERT_NE(second.GetChanged(0x1000, 4), nullptr);
+  EXPECT_EQ(*second.GetChanged(0x1000, 4), 7);
+}
@@ -8,7 +8,9 @@
 
 #include "App.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cinttypes>
 #include <cmath>
 #include <fstream>
 #include <thread>
@@ -21,6 +23,7 @@
 #include "Capture.h"
 #include "CaptureSerializer.h"
 #include "CaptureWindow.h"
+#include "ChromeTrace.h"
 #include "ConnectionManager.h"
 #include "Debugger.h"
 #include "DiaManager.h"
@@ -32,10 +35,13 @@
 #include "Injection.h"
 #include "Introspection.h"
 #include "KeyAndString.h"
+#include "LatencyHistogramWindow.h"
 #include "LinuxCallstackEvent.h"
+#include "LinuxSymbol.h"
 #include "LiveFunctionDataView.h"
 #include "Log.h"
 #include "LogDataView.h"
+#include "MemoryAccounting.h"
 #include "MiniDump.h"
 #include "ModuleDataView.h"
 #include "ModuleManager.h"
@@ -43,9 +49,12 @@
 #include "OrbitSession.h"
 #include "Params.h"
 #include "Pdb.h"
+#include "PerfettoTrace.h"
+#include "PprofProfile.h"
 #include "PluginManager.h"
 #include "PrintVar.h"
 #include "ProcessDataView.h"
+#include "ProcessInfoLoader.h"
 #include "RuleEditor.h"
 #include "SamplingProfiler.h"
 #include "SamplingReport.h"
@@ -60,9 +69,12 @@
 #include "TestRemoteMessages.h"
 #include "TextRenderer.h"
 #include "TimerManager.h"
+#include "TraceEvents.h"
 #include "TypeDataView.h"
 #include "Utils.h"
 #include "Version.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
 #include "curl/curl.h"
 
 #define GLUT_DISABLE_ATEXIT_HACK
@@ -72,16 +84,12 @@
 #include "Disassembler.h"
 #endif
 
-#if __linux__
-#include <OrbitLinuxTracing/OrbitTracing.h>
-#endif
-
 class OrbitApp* GOrbitApp;
 float GFontSize;
 bool DoZoom = false;
 
 //-----------------------------------------------------------------------------
-OrbitApp::OrbitApp() {
+OrbitApp::OrbitApp() : m_FrameStrings(&OrbitApp::ResolveFrameString) {
   m_Debugger = nullptr;
 #ifdef _WIN32
   m_Debugger = new Debugger();
@@ -90,6 +98,8 @@ OrbitApp::OrbitApp() {
 
 //-----------------------------------------------------------------------------
 OrbitApp::~OrbitApp() {
+  CancelDisassembly();
+  m_DisassemblyWorker.reset();
 #ifdef _WIN32
   oqpi_tk::stop_scheduler();
   delete m_Debugger;
@@ -111,6 +121,10 @@ std::wstring OrbitApp::FindFile(const std::wstring& a_Caption,
 //-----------------------------------------------------------------------------
 void OrbitApp::SetCommandLineArguments(const std::vector<std::string>& a_Args) {
   m_Arguments = a_Args;
+  // With "watch", only watch the capture of the client controlling the
+  // service given with "gamelet:".
+  bool watch_only =
+      std::find(a_Args.begin(), a_Args.end(), "watch") != a_Args.end();
 
   for (const std::string& arg : a_Args) {
     if (Contains(arg, "gamelet:")) {
@@ -124,13 +138,31 @@ void OrbitApp::SetCommandLineArguments(const std::vector<std::string>& a_Args) {
       GTcpClient->AddMainThreadCallback(
           Msg_RemoteProcessList,
           [=](const Message& a_Msg) { GOrbitApp->OnRemoteProcessList(a_Msg); });
+      GTcpClient->AddMainThreadCallback(
+          Msg_RemoteProcessListDiff, [=](const Message& a_Msg) {
+            GOrbitApp->OnRemoteProcessListDiff(a_Msg);
+          });
       GTcpClient->AddMainThreadCallback(
           Msg_RemoteModuleDebugInfo, [=](const Message& a_Msg) {
             GOrbitApp->OnRemoteModuleDebugInfo(a_Msg);
           });
-      ConnectionManager::Get().ConnectToRemote(address);
+      GTcpClient->AddMainThreadCallback(
+          Msg_FunctionStats,
+          [=](const Message& a_Msg) { GOrbitApp->OnFunctionStats(a_Msg); });
+      ConnectionManager::Get().ConnectToRemote(address, watch_only);
       m_ProcessesDataView->SetIsRemote(true);
       SetIsRemote(true);
+    } else if (absl::StartsWith(arg, "host:")) {
+      // "host:pid@address" also captures the process pid of the service at
+      // address, on the timeline of the one of "gamelet:".
+      std::vector<std::string> vec = Tokenize(Replace(arg, "host:", ""), "@");
+      uint32_t pid = 0;
+      if (vec.size() == 2 && absl::SimpleAtoi(vec[0], &pid)) {
+        ConnectionManager::Get().AddRemoteHost(vec[1], pid);
+      } else {
+        ERROR("Invalid host argument %s, expected host:pid@address",
+              arg.c_str());
+      }
     } else if (Contains(arg, "headless")) {
       SetHeadless(true);
     } else if (Contains(arg, "preset:")) {
@@ -169,6 +201,130 @@ void GetDesktopResolution(int& horizontal, int& vertical) {
 #endif
 }
 
+//-----------------------------------------------------------------------------
+void OrbitApp::ExportTrace(const std::string& file_name) {
+  std::ofstream file(file_name, std::ios::binary);
+  if (!file) {
+    ERROR("Could not create trace %s", file_name.c_str());
+    return;
+  }
+  std::unique_ptr<TraceEventWriter> writer;
+  if (GetTraceFormat(file_name) == TraceFormat::kPerfetto) {
+    writer = std::make_unique<PerfettoTraceWriter>(&file);
+  } else {
+    writer = std::make_unique<ChromeTraceWriter>(&file);
+  }
+
+  std::vector<Timer> scopes;
+  std::vector<Timer> coreActivities;
+  for (const std::shared_ptr<TimerChain>& chain :
+       GCurrentTimeGraph->GetAllTimerChains()) {
+    for (const CompactTimer& timer : *chain) {
+      if (timer.IsType(Timer::CORE_ACTIVITY)) {
+        coreActivities.push_back(chain->Expand(timer));
+      } else if (!timer.IsType(Timer::THREAD_ACTIVITY)) {
+        scopes.push_back(chain->Expand(timer));
+      }
+    }
+  }
+
+  uint32_t pid = 0;
+  if (Capture::GTargetProcess != nullptr) {
+    pid = Capture::GTargetProcess->GetID();
+    for (const auto& pair : Capture::GTargetProcess->GetThreadNames()) {
+      if (!pair.second.empty()) {
+        writer->AddThreadName(pid, pair.first, pair.second);
+      }
+    }
+  }
+
+  // Per thread in start order, enclosing timers first.
+  std::sort(scopes.begin(), scopes.end(), [](const Timer& a, const Timer& b) {
+    if (a.m_TID != b.m_TID) return a.m_TID < b.m_TID;
+    if (a.m_Start != b.m_Start) return a.m_Start < b.m_Start;
+    return a.m_End > b.m_End;
+  });
+  for (const Timer& timer : scopes) {
+    std::string name = GCurrentTimeGraph->GetTimerName(timer);
+    TraceScope scope;
+    scope.tid = timer.m_TID;
+    scope.depth = timer.m_Depth;
+    scope.start_ns = timer.m_Start;
+    scope.end_ns = timer.m_End;
+    scope.name = name;
+    writer->AddScope(pid, scope);
+  }
+
+  std::sort(coreActivities.begin(), coreActivities.end(),
+            [](const Timer& a, const Timer& b) {
+              if (a.m_Processor != b.m_Processor) {
+                return a.m_Processor < b.m_Processor;
+              }
+              return a.m_Start < b.m_Start;
+            });
+  for (const Timer& timer : coreActivities) {
+    ContextSwitch contextSwitch(ContextSwitch::In);
+    contextSwitch.m_ThreadId = timer.m_TID;
+    contextSwitch.m_Time = timer.m_Start;
+    contextSwitch.m_ProcessorIndex = timer.m_Processor;
+    contextSwitch.m_ProcessorNumber = timer.m_Processor;
+    writer->AddContextSwitch(pid, contextSwitch);
+    contextSwitch.m_Type = ContextSwitch::Out;
+    contextSwitch.m_Time = timer.m_End;
+    writer->AddContextSwitch(pid, contextSwitch);
+  }
+
+  if (!writer->Close()) {
+    ERROR("Could not write trace %s", file_name.c_str());
+  }
+}
+
+//-----------------------------------------------------------------------------
+void OrbitApp::ExportProfile(const std::string& file_name) {
+  std::shared_ptr<SamplingProfiler> profiler = Capture::GSamplingProfiler;
+  if (profiler == nullptr) {
+    ERROR("No samples to export to %s", file_name.c_str());
+    return;
+  }
+  std::ofstream file(file_name, std::ios::binary);
+  if (!file) {
+    ERROR("Could not create profile %s", file_name.c_str());
+    return;
+  }
+
+  PprofWriter writer(&file, [&profiler](uint64_t a_Address) {
+    PprofLocation location;
+    location.function_name = ws2s(profiler->GetSymbolFromAddress(a_Address));
+    LineInfo lineInfo;
+    if (profiler->GetLineInfo(a_Address, lineInfo)) {
+      location.file_name = ws2s(lineInfo.m_File);
+      location.line = lineInfo.m_Line;
+    }
+    return location;
+  });
+  if (Capture::GTargetProcess != nullptr) {
+    for (const auto& pair : Capture::GTargetProcess->GetModules()) {
+      const Module& module = *pair.second;
+      PprofMapping mapping;
+      mapping.memory_start = module.m_AddressStart;
+      mapping.memory_limit = module.m_AddressEnd;
+      mapping.file_name = module.m_FullName;
+      mapping.build_id = module.m_DebugSignature;
+      writer.AddMapping(mapping);
+    }
+  }
+
+  profiler->VisitCallstackCounts(
+      [&writer](ThreadID a_TID, absl::Span<const uint64_t> a_Frames,
+                unsigned int a_Count) {
+        writer.AddSample(a_Frames, a_Count, a_TID);
+      });
+
+  if (!writer.Close()) {
+    ERROR("Could not write profile %s", file_name.c_str());
+  }
+}
+
 //-----------------------------------------------------------------------------
 void GLoadPdbAsync(const std::vector<std::string>& a_Modules) {
   GModuleManager.LoadPdbAsync(a_Modules, []() { GOrbitApp->OnPdbLoaded(); });
@@ -178,7 +334,6 @@ void GLoadPdbAsync(const std::vector<std::string>& a_Modules) {
 void OrbitApp::ProcessTimer(const Timer& a_Timer, const std::string&) {
   CHECK(!ConnectionManager::Get().IsService());
   GCurrentTimeGraph->ProcessTimer(a_Timer);
-  ++Capture::GFunctionCountMap[a_Timer.m_FunctionAddress];
 }
 
 //-----------------------------------------------------------------------------
@@ -202,6 +357,27 @@ void OrbitApp::ProcessHashedSamplingCallStack(CallstackEvent& a_CallStack) {
   }
 }
 
+//-----------------------------------------------------------------------------
+void OrbitApp::ProcessSamplingCallStacks(
+    absl::Span<const CallstackEvent> a_Events,
+    absl::Span<CallStack> a_NewCallStacks) {
+  CHECK(!ConnectionManager::Get().IsService());
+
+  Capture::GSamplingProfiler->AddCallStacks(a_Events, a_NewCallStacks);
+  GEventTracer.GetEventBuffer().AddCallstackEvents(a_Events);
+}
+
+//-----------------------------------------------------------------------------
+void OrbitApp::ProcessOffCpuCallstacks(
+    absl::Span<const CallStack> a_CallStacks,
+    absl::Span<const uint64_t> a_DurationsNs) {
+  CHECK(!ConnectionManager::Get().IsService());
+
+  for (size_t i = 0; i < a_CallStacks.size(); ++i) {
+    Capture::GOffCpuProfile.AddCallstack(a_CallStacks[i], a_DurationsNs[i]);
+  }
+}
+
 //-----------------------------------------------------------------------------
 void OrbitApp::ProcessCallStack(CallStack& a_CallStack) {
   if (ConnectionManager::Get().IsService()) {
@@ -226,6 +402,12 @@ void OrbitApp::ProcessContextSwitch(const ContextSwitch& a_ContextSwitch) {
   GTimerManager->Add(a_ContextSwitch);
 }
 
+//-----------------------------------------------------------------------------
+void OrbitApp::ProcessThreadStateChange(
+    const ThreadStateChange& thread_state_change) {
+  GTimerManager->Add(thread_state_change);
+}
+
 //-----------------------------------------------------------------------------
 void OrbitApp::AddSymbol(uint64_t a_Address, const std::string& a_Module,
                          const std::string& a_Name) {
@@ -238,6 +420,34 @@ void OrbitApp::AddSymbol(uint64_t a_Address, const std::string& a_Module,
   Capture::GTargetProcess->AddSymbol(a_Address, symbol);
 }
 //-----------------------------------------------------------------------------
+void OrbitApp::AddKernelFrameSymbol(const KernelFrameSymbol& symbol) {
+  CHECK(!ConnectionManager::Get().IsService());
+
+  std::optional<std::string> name = string_manager_->Get(symbol.name_key);
+  if (!name.has_value()) {
+    ERROR("Unknown name of the kernel frame at 0x%" PRIx64, symbol.address);
+    return;
+  }
+  auto linux_symbol = std::make_shared<LinuxSymbol>();
+  linux_symbol->m_Name = std::move(name.value());
+  linux_symbol->m_Module = "[kernel]";
+  linux_symbol->m_Address = symbol.function_address;
+  Capture::GTargetProcess->AddSymbol(symbol.address, linux_symbol);
+}
+//-----------------------------------------------------------------------------
+void OrbitApp::AddThreadName(const ThreadNameKey& thread_name) {
+  CHECK(!ConnectionManager::Get().IsService());
+
+  std::optional<std::string> name = string_manager_->Get(thread_name.name_key);
+  if (!name.has_value()) {
+    ERROR("Unknown name of thread %u", thread_name.thread_id);
+    return;
+  }
+  // Only the latest name is shown: they come in order.
+  Capture::GTargetProcess->SetThreadName(thread_name.thread_id,
+                                         std::move(name.value()));
+}
+//-----------------------------------------------------------------------------
 void OrbitApp::AddKeyAndString(uint64_t key, std::string_view str) {
   CHECK (!ConnectionManager::Get().IsService());
   {
@@ -274,8 +484,8 @@ void OrbitApp::LoadSystrace(const std::string& a_FileName) {
 
   for (const auto& timer : systrace->GetTimers()) {
     GCurrentTimeGraph->ProcessTimer(timer);
-    ++Capture::GFunctionCountMap[timer.m_FunctionAddress];
   }
+  GCurrentTimeGraph->FlushFunctionStats();
 
   for (const auto& pair : systrace->GetThreadNames()) {
     Capture::GTargetProcess->SetThreadName(pair.first, pair.second);
@@ -300,8 +510,8 @@ void OrbitApp::AppendSystrace(const std::string& a_FileName,
 
   for (const auto& timer : systrace->GetTimers()) {
     GCurrentTimeGraph->ProcessTimer(timer);
-    Capture::GFunctionCountMap[timer.m_FunctionAddress];
   }
+  GCurrentTimeGraph->FlushFunctionStats();
 
   for (const auto& pair : systrace->GetThreadNames()) {
     Capture::GTargetProcess->SetThreadName(pair.first, pair.second);
@@ -323,6 +533,10 @@ bool OrbitApp::Init() {
   Path::Init();
 
   GModuleManager.Init();
+  GProcessInfoLoader.SetListedCallback(
+      [](const std::shared_ptr<Process>& a_Process) {
+        GOrbitApp->OnProcessListed(a_Process);
+      });
   Capture::Init();
   Capture::SetSamplingDoneCallback(&OrbitApp::AddSamplingReport, GOrbitApp);
   Capture::SetLoadPdbAsyncFunc(GLoadPdbAsync);
@@ -356,6 +570,9 @@ void OrbitApp::PostInit() {
     GTcpServer->AddCallback(Msg_MiniDump, [=](const Message& a_Msg) {
       GOrbitApp->OnMiniDump(a_Msg);
     });
+    GTcpServer->AddMainThreadCallback(
+        Msg_FunctionStats,
+        [=](const Message& a_Msg) { GOrbitApp->OnFunctionStats(a_Msg); });
     GTcpServer->Start(Capture::GCapturePort);
   }
 
@@ -541,12 +758,38 @@ void OrbitApp::Disassemble(const std::string& a_FunctionName,
                            DWORD64 a_VirtualAddress, const char* a_MachineCode,
                            size_t a_Size) {
 #ifdef _WIN32
-  Disassembler disasm;
-  disasm.LOGF(absl::StrFormat("asm: /* %s */\n", a_FunctionName.c_str()));
-  const unsigned char* code = (const unsigned char*)a_MachineCode;
-  disasm.Disassemble(code, a_Size, a_VirtualAddress,
-                     Capture::GTargetProcess->GetIs64Bit());
-  SendToUiAsync(disasm.GetResult());
+  if (m_DisassemblyWorker == nullptr) {
+    m_DisassemblyWorker = std::make_unique<MessageWorkerPool>(1);
+  }
+  uint64_t id = ++m_DisassemblyId;
+  std::string code(a_MachineCode, a_Size);
+  bool is64Bit = Capture::GTargetProcess->GetIs64Bit();
+  std::shared_ptr<SamplingProfiler> profiler = Capture::GSamplingProfiler;
+  m_DisassemblyWorker->Post(0, [this, id, a_FunctionName, a_VirtualAddress,
+                                code = std::move(code), is64Bit, profiler] {
+    if (id != m_DisassemblyId) return;
+    Disassembler disasm;
+    if (profiler != nullptr) {
+      disasm.SetHitCounts(profiler->GetExactAddressCounts(
+          a_VirtualAddress, a_VirtualAddress + code.size()));
+    }
+    if (!Capture::GBranchProfile.IsEmpty()) {
+      uint64_t end = a_VirtualAddress + code.size();
+      disasm.SetBranchCounts(
+          Capture::GBranchProfile.GetTakenCounts(a_VirtualAddress, end),
+          Capture::GBranchProfile.GetExecutionCounts(a_VirtualAddress, end));
+    }
+    // The first chunk opens the dialog, the next ones are appended to it.
+    bool isFirstChunk = true;
+    disasm.SetChunkCallback([this, &isFirstChunk](const std::wstring& a_Text) {
+      SendToUiAsync(isFirstChunk ? a_Text : L"asmchunk:" + a_Text);
+      isFirstChunk = false;
+    });
+    disasm.SetCancelCallback([this, id] { return id != m_DisassemblyId; });
+    disasm.LOGF(absl::StrFormat("asm: /* %s */\n", a_FunctionName));
+    disasm.Disassemble(reinterpret_cast<const unsigned char*>(code.data()),
+                       code.size(), a_VirtualAddress, is64Bit);
+  });
 #else
   UNUSED(a_FunctionName);
   UNUSED(a_VirtualAddress);
@@ -595,6 +838,8 @@ void OrbitApp::MainTick() {
 
   GMainTimer.Reset();
   Capture::Update();
+  GModuleManager.Update();
+  GProcessInfoLoader.Update();
 #ifdef WIN32
   GTcpServer->MainThreadTick();
 #endif
@@ -617,6 +862,9 @@ void OrbitApp::MainTick() {
 #endif
   GOrbitApp->CheckForUpdate();
 
+  GOrbitApp->UpdateLiveSamplingReport();
+  GOrbitApp->CheckMemoryBudgets();
+
   ++GOrbitApp->m_NumTicks;
 
   if (DoZoom) {
@@ -709,6 +957,13 @@ void OrbitApp::RegisterRuleEditor(RuleEditor* a_RuleEditor) {
   m_RuleEditor = a_RuleEditor;
 }
 
+//-----------------------------------------------------------------------------
+void OrbitApp::RegisterLatencyHistogramWindow(
+    LatencyHistogramWindow* a_LatencyHistogram) {
+  assert(m_LatencyHistogramWindow == nullptr);
+  m_LatencyHistogramWindow = a_LatencyHistogram;
+}
+
 //-----------------------------------------------------------------------------
 void OrbitApp::NeedsRedraw() {
   m_CaptureWindow->NeedsUpdate();
@@ -725,6 +980,82 @@ void OrbitApp::AddSamplingReport(
   }
 }
 
+//-----------------------------------------------------------------------------
+void OrbitApp::CheckMemoryBudgets() {
+  if (GParams.m_MemoryBudgets != m_MemoryBudgets) {
+    m_MemoryBudgets = GParams.m_MemoryBudgets;
+    if (!MemoryAccounting::SetBudgets(m_MemoryBudgets)) {
+      ERROR("Invalid memory budgets \"%s\"", m_MemoryBudgets.c_str());
+    }
+  }
+  if (!Capture::IsCapturing()) return;
+
+  std::vector<MemorySubsystem> overBudget = MemoryAccounting::GetOverBudget();
+  if (overBudget.empty()) return;
+  for (MemorySubsystem subsystem : overBudget) {
+    ERROR("Memory of %s over its budget, stopping the capture",
+          MemoryAccounting::GetName(subsystem));
+  }
+  LOG("Memory:\n%s", MemoryAccounting::GetReport().c_str());
+  StopCapture();
+}
+
+//-----------------------------------------------------------------------------
+std::string OrbitApp::ResolveFrameString(uint64_t a_Address,
+                                         FrameDisplay a_Display) {
+  std::shared_ptr<Process> process = Capture::GTargetProcess;
+  if (process != nullptr) {
+    ScopeLock lock(process->GetDataMutex());
+    Function* function = process->GetFunctionFromAddress(a_Address, false);
+    if (function != nullptr) {
+      switch (a_Display) {
+        case FrameDisplay::kName:
+          return function->PrettyName();
+        case FrameDisplay::kModule:
+          return function->GetModuleName();
+        case FrameDisplay::kFile:
+          return function->File();
+      }
+    }
+  }
+
+  if (a_Display != FrameDisplay::kName) {
+    return "";
+  }
+  std::shared_ptr<SamplingProfiler> profiler = Capture::GSamplingProfiler;
+  if (profiler != nullptr) {
+    return ws2s(profiler->GetSymbolFromAddress(a_Address));
+  }
+  return absl::StrFormat("0x%llx", a_Address);
+}
+
+//-----------------------------------------------------------------------------
+void OrbitApp::UpdateLiveSamplingReport() {
+  std::shared_ptr<SamplingProfiler> profiler = Capture::GSamplingProfiler;
+  if (profiler == nullptr ||
+      profiler->GetState() != SamplingProfiler::Sampling) {
+    m_LiveSamplingReportThreadIds.clear();
+    m_LiveSamplingReportTimer.Start();
+    return;
+  }
+  if (m_LiveSamplingReportTimer.QueryMillis() <
+      SamplingReport::kLiveUpdatePeriodMs) {
+    return;
+  }
+  m_LiveSamplingReportTimer.Start();
+
+  // The functions of the report's data views then update themselves.
+  std::vector<ThreadID> threadIds = profiler->GetLiveThreadIds();
+  if (threadIds.empty() || threadIds == m_LiveSamplingReportThreadIds) {
+    return;
+  }
+  m_LiveSamplingReportThreadIds = std::move(threadIds);
+  auto report = std::make_shared<SamplingReport>(profiler, /*a_Live=*/true);
+  for (SamplingReportCallback& callback : m_SamplingReportsCallbacks) {
+    callback(report);
+  }
+}
+
 //-----------------------------------------------------------------------------
 void OrbitApp::AddSelectionReport(
     std::shared_ptr<SamplingProfiler>& a_SamplingProfiler) {
@@ -736,6 +1067,41 @@ void OrbitApp::AddSelectionReport(
   }
 }
 
+//-----------------------------------------------------------------------------
+void OrbitApp::SetLogTimeRange(uint64_t a_MinTime, uint64_t a_MaxTime,
+                               ThreadID a_ThreadId) {
+  if (m_Log) {
+    m_Log->SetTimeRange(a_MinTime, a_MaxTime, a_ThreadId);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void OrbitApp::AddOffCpuReport() {
+  if (Capture::GOffCpuProfile.IsEmpty()) {
+    return;
+  }
+  std::shared_ptr<SamplingProfiler> profiler =
+      Capture::GOffCpuProfile.MakeSamplingProfiler(Capture::GTargetProcess);
+  auto report = std::make_shared<SamplingReport>(profiler);
+  for (SamplingReportCallback& callback : m_OffCpuReportCallbacks) {
+    callback(report);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void OrbitApp::AddPageFaultReport() {
+  if (Capture::GPageFaultProfile.IsEmpty()) {
+    return;
+  }
+  std::shared_ptr<SamplingProfiler> profiler =
+      Capture::GPageFaultProfile.MakeSamplingProfiler(
+          Capture::GTargetProcess, /*major_only=*/false, Capture::GetCallstack);
+  auto report = std::make_shared<SamplingReport>(profiler);
+  for (SamplingReportCallback& callback : m_PageFaultReportCallbacks) {
+    callback(report);
+  }
+}
+
 //-----------------------------------------------------------------------------
 void OrbitApp::GoToCode(DWORD64 a_Address) {
   m_CaptureWindow->FindCode(a_Address);
@@ -835,6 +1201,11 @@ void OrbitApp::SetClipboard(const std::wstring& a_Text) {
   if (m_ClipboardCallback) m_ClipboardCallback(a_Text);
 }
 
+//-----------------------------------------------------------------------------
+void OrbitApp::FilterSamplingReport(const std::wstring& a_Filter) {
+  if (m_SamplingReportFilterCallback) m_SamplingReportFilterCallback(a_Filter);
+}
+
 //-----------------------------------------------------------------------------
 void OrbitApp::OnSaveSession(const std::string& file_name) {
   Capture::SaveSession(file_name);
@@ -867,13 +1238,50 @@ void OrbitApp::OnLoadSession(const std::string& file_name) {
 
 //-----------------------------------------------------------------------------
 void OrbitApp::OnSaveCapture(const std::string& file_name) {
+  if (GetTraceFormat(file_name).has_value()) {
+    ExportTrace(file_name);
+    return;
+  }
+  if (absl::EndsWith(file_name, ".pb.gz")) {
+    ExportProfile(file_name);
+    return;
+  }
   CaptureSerializer ar;
   ar.m_TimeGraph = GCurrentTimeGraph;
   ar.Save(s2ws(file_name));
 }
 
+//-----------------------------------------------------------------------------
+std::vector<FunctionTimings> OrbitApp::GetFunctionTimings() {
+  std::vector<FunctionTimings> timings;
+  for (const auto& pair : Capture::GSelectedFunctionsMap) {
+    const Function* function = pair.second;
+    if (function != nullptr && function->Stats() != nullptr) {
+      timings.push_back(
+          {function->PrettyName(), function->Address(), *function->Stats()});
+    }
+  }
+  return timings;
+}
+
+//-----------------------------------------------------------------------------
+bool OrbitApp::LoadTimerDiffBaseline(const std::string& a_FileName) {
+  auto timings = std::make_shared<std::vector<FunctionTimings>>();
+  CaptureSerializer ar;
+  if (!ar.LoadFunctionTimings(s2ws(a_FileName), timings.get())) {
+    ERROR("Could not load the timings of %s", a_FileName.c_str());
+    return false;
+  }
+  SetTimerDiffBaseline(std::move(timings));
+  return true;
+}
+
 //-----------------------------------------------------------------------------
 void OrbitApp::OnLoadCapture(const std::string& file_name) {
+  if (GetTraceFormat(file_name).has_value()) {
+    LoadSystrace(file_name);
+    return;
+  }
   StopCapture();
   Capture::ClearCaptureData();
   GCurrentTimeGraph->Clear();
@@ -894,6 +1302,15 @@ void GLoadPdbAsync(const std::shared_ptr<Module>& a_Module) {
   GModuleManager.LoadPdbAsync(a_Module, []() { GOrbitApp->OnPdbLoaded(); });
 }
 
+//-----------------------------------------------------------------------------
+void OrbitApp::OnProcessListed(const std::shared_ptr<Process>& a_Process) {
+  // The user may have selected another process meanwhile.
+  if (a_Process == Capture::GTargetProcess) {
+    m_ModulesDataView->SetProcess(a_Process);
+    FireRefreshCallbacks();
+  }
+}
+
 //-----------------------------------------------------------------------------
 void OrbitApp::OnDisconnect() { GTcpServer->Send(Msg_Unload); }
 
@@ -913,6 +1330,9 @@ void OrbitApp::LogMsg(const std::wstring& a_Msg) { ORBIT_LOG(a_Msg); }
 
 //-----------------------------------------------------------------------------
 void OrbitApp::FireRefreshCallbacks(DataViewType a_Type) {
+  if (a_Type == DataViewType::ALL) {
+    m_FrameStrings.Clear();
+  }
   for (DataView* panel : m_Panels) {
     if (a_Type == DataViewType::ALL || a_Type == panel->GetType()) {
       panel->OnDataChanged();
@@ -937,6 +1357,7 @@ void OrbitApp::StartCapture() {
   // Tracing session is only needed when StartCapture is
   // running on the service side
   Capture::StartCapture(nullptr /* tracing_session */);
+  ConnectionManager::Get().StartCaptureOnHosts();
 
   if (m_NeedsThawing) {
 #ifdef _WIN32
@@ -948,7 +1369,10 @@ void OrbitApp::StartCapture() {
 
 //-----------------------------------------------------------------------------
 void OrbitApp::StopCapture() {
+  ConnectionManager::Get().StopCaptureOnHosts();
   Capture::StopCapture();
+  AddOffCpuReport();
+  AddPageFaultReport();
 
   FireRefreshCallbacks();
 }
@@ -1028,13 +1452,24 @@ void OrbitApp::LoadModules() {
     if (Capture::IsRemote()) {
       LoadRemoteModules();
     } else {
-      std::shared_ptr<Module> module = m_ModulesToLoad.front();
-      m_ModulesToLoad.pop();
-      GLoadPdbAsync(module);
+      // Queued all at once, for the module manager to load them in
+      // parallel and in order of priority.
+      while (!m_ModulesToLoad.empty()) {
+        GLoadPdbAsync(m_ModulesToLoad.front());
+        m_ModulesToLoad.pop();
+      }
     }
   }
 }
 
+//-----------------------------------------------------------------------------
+void OrbitApp::LoadTypesAndGlobals() {
+  GModuleManager.LoadTypesAndGlobalsAsync([this] {
+    FireRefreshCallbacks(DataViewType::TYPES);
+    FireRefreshCallbacks(DataViewType::GLOBALS);
+  });
+}
+
 //-----------------------------------------------------------------------------
 bool OrbitApp::LoadRemoteModuleLocally(
     std::shared_ptr<struct Module>& a_Module) {
@@ -1059,11 +1494,17 @@ void OrbitApp::LoadRemoteModules() {
   while (!m_ModulesToLoad.empty()) {
     auto module = m_ModulesToLoad.front();
     m_ModulesToLoad.pop();
-    if (!LoadRemoteModuleLocally(module)) {
+    if (!LoadRemoteModuleLocally(module) &&
+        !LoadRemoteModuleFromCache(module)) {
       modules.push_back(module->m_Name);
     }
   }
 
+  if (modules.empty()) {
+    FireRefreshCallbacks();
+    return;
+  }
+
   std::string module_data = SerializeObjectBinary(modules);
   Message msg(Msg_RemoteModuleDebugInfo, module_data.size() + 1,
               module_data.data());
@@ -1072,6 +1513,21 @@ void OrbitApp::LoadRemoteModules() {
   GTcpClient->Send(msg);
 }
 
+//-----------------------------------------------------------------------------
+bool OrbitApp::LoadRemoteModuleFromCache(
+    const std::shared_ptr<struct Module>& a_Module) {
+  a_Module->LoadDebugInfo();  // To allocate m_Pdb - TODO: clean that up
+  if (!a_Module->m_Pdb->LoadFromCache(a_Module->m_FullName,
+                                      a_Module->m_DebugSignature)) {
+    return false;
+  }
+
+  a_Module->m_Pdb->ProcessData();
+  a_Module->m_Pdb->ApplyPresets();
+  a_Module->SetLoaded(true);
+  return true;
+}
+
 //-----------------------------------------------------------------------------
 bool OrbitApp::IsLoading() { return GPdbDbg->IsLoading(); }
 
@@ -1135,6 +1591,25 @@ void OrbitApp::OnMiniDump(const Message& a_Message) {
   GOrbitApp->m_ProcessesDataView->SetRemoteProcess(process);
 }
 
+//-----------------------------------------------------------------------------
+void OrbitApp::OnFunctionStats(const Message& a_Message) {
+  const FunctionStats* stats =
+      reinterpret_cast<const FunctionStats*>(a_Message.GetData());
+  size_t numStats = a_Message.m_Size / sizeof(FunctionStats);
+  std::vector<uint64_t> changed;
+  changed.reserve(numStats);
+  for (size_t i = 0; i < numStats; ++i) {
+    Capture::GFunctionCountMap[stats[i].m_Address] += stats[i].m_Count;
+    Function* func =
+        Capture::GTargetProcess->GetFunctionFromAddress(stats[i].m_Address);
+    if (func != nullptr) {
+      func->UpdateStats(stats[i]);
+    }
+    changed.push_back(stats[i].m_Address);
+  }
+  Capture::GFunctionStatsChanges.Add(changed);
+}
+
 //-----------------------------------------------------------------------------
 void OrbitApp::OnRemoteProcess(const Message& a_Message) {
   std::istringstream buffer(std::string(a_Message.m_Data, a_Message.m_Size));
@@ -1157,6 +1632,21 @@ void OrbitApp::OnRemoteProcessList(const Message& a_Message) {
   GOrbitApp->m_ProcessesDataView->SetRemoteProcessList(remoteProcessList);
 }
 
+//-----------------------------------------------------------------------------
+void OrbitApp::OnRemoteProcessListDiff(const Message& a_Message) {
+  std::istringstream buffer(std::string(a_Message.m_Data, a_Message.m_Size));
+  cereal::BinaryInputArchive inputAr(buffer);
+  ProcessListDiff diff;
+  inputAr(diff);
+  for (std::shared_ptr<Process>& process : diff.m_AddedProcesses) {
+    process->SetIsRemote(true);
+  }
+  if (!m_ProcessesDataView->ApplyRemoteProcessListDiff(diff)) {
+    // A diff was missed, or this is a new connection.
+    GTcpClient->Send(Msg_RemoteProcessListRequest);
+  }
+}
+
 //-----------------------------------------------------------------------------
 void OrbitApp::OnRemoteModuleDebugInfo(const Message& a_Message) {
   std::istringstream buffer(std::string(a_Message.m_Data, a_Message.m_Size));
@@ -1174,12 +1664,24 @@ void OrbitApp::OnRemoteModuleDebugInfo(const Message& a_Message) {
       module->LoadDebugInfo();  // To allocate m_Pdb - TODO: clean that up
       module->m_Pdb->SetLoadBias(moduleInfo.load_bias);
 
-      for (auto& function : moduleInfo.m_Functions) {
-        // Add function to pdb
-        module->m_Pdb->AddFunction(function);
+      if (!moduleInfo.m_SymbolCache.empty()) {
+        if (!module->m_Pdb->LoadFromCacheData(module->m_FullName,
+                                              module->m_DebugSignature,
+                                              moduleInfo.m_SymbolCache)) {
+          ERROR("Invalid symbols received for %s", name.c_str());
+          continue;
+        }
+      } else {
+        for (auto& function : moduleInfo.m_Functions) {
+          // Add function to pdb
+          module->m_Pdb->AddFunction(function);
+        }
+        module->m_Pdb->SaveToCache(module->m_FullName,
+                                   module->m_DebugSignature);
       }
 
       module->m_Pdb->ProcessData();
+      module->m_Pdb->ApplyPresets();
       module->SetLoaded(true);
     }
   }
@@ -1192,3 +1694,10 @@ void OrbitApp::LaunchRuleEditor(Function* a_Function) {
   m_RuleEditor->m_Window.Launch(a_Function);
   SendToUiNow(TEXT("RuleEditor"));
 }
+
+//-----------------------------------------------------------------------------
+void OrbitApp::ShowLatencyHistogram(const Function& a_Function) {
+  if (m_LatencyHistogramWindow != nullptr) {
+    m_LatencyHistogramWindow->SetFunction(a_Function);
+  }
+}
@@ -3,22 +3,30 @@
 //-----------------------------------
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <map>
 #include <memory>
 #include <queue>
 #include <string>
 
+#include "CallstackTypes.h"
 #include "ContextSwitch.h"
 #include "CoreApp.h"
 #include "CrashHandler.h"
 #include "DataViewTypes.h"
+#include "FrameStringCache.h"
 #include "Message.h"
+#include "MessageWorkerPool.h"
+#include "ScopeTimer.h"
 #include "StringManager.h"
+#include "ThreadStateTimeline.h"
 #include "Threading.h"
+#include "TimerDiff.h"
 
 struct CallStack;
 class Process;
+struct SourceLineCounts;
 
 //-----------------------------------------------------------------------------
 class OrbitApp : public CoreApp {
@@ -53,6 +61,8 @@ class OrbitApp : public CoreApp {
   void ToggleCapture();
   void OnDisconnect();
   void OnPdbLoaded();
+  // The modules and threads of a_Process were listed, see ProcessInfoLoader.
+  void OnProcessListed(const std::shared_ptr<Process>& a_Process);
   void LogMsg(const std::wstring& a_Msg) override;
   void SetCallStack(std::shared_ptr<CallStack> a_CallStack);
   void LoadFileMapping();
@@ -67,16 +77,31 @@ class OrbitApp : public CoreApp {
   void UpdateVariable(Variable* a_Variable) override;
   void ClearWatchedVariables();
   void RefreshWatch();
+  // Disassembles the code in the background, annotated with the samples of
+  // its instructions, and streams the result to the UI as "asm:" followed by
+  // "asmchunk:" messages. Cancels the disassembly in progress, if any.
   void Disassemble(const std::string& a_FunctionName, DWORD64 a_VirtualAddress,
                    const char* a_MachineCode, size_t a_Size) override;
+  // E.g. once the dialog showing the disassembly is closed.
+  void CancelDisassembly() { ++m_DisassemblyId; }
   void ProcessTimer(const Timer& a_Timer,
                     const std::string& a_FunctionName) override;
   void ProcessSamplingCallStack(LinuxCallstackEvent& a_CallStack) override;
   void ProcessHashedSamplingCallStack(CallstackEvent& a_CallStack) override;
+  void ProcessSamplingCallStacks(
+      absl::Span<const CallstackEvent> a_Events,
+      absl::Span<CallStack> a_NewCallStacks) override;
+  void ProcessOffCpuCallstacks(
+      absl::Span<const CallStack> a_CallStacks,
+      absl::Span<const uint64_t> a_DurationsNs) override;
   void ProcessCallStack(CallStack& a_CallStack) override;
   void ProcessContextSwitch(const ContextSwitch& a_ContextSwitch) override;
+  void ProcessThreadStateChange(
+      const ThreadStateChange& thread_state_change) override;
   void AddSymbol(uint64_t a_Address, const std::string& a_Module,
                  const std::string& a_Name) override;
+  void AddKernelFrameSymbol(const KernelFrameSymbol& symbol) override;
+  void AddThreadName(const ThreadNameKey& thread_name) override;
   void AddKeyAndString(uint64_t key, std::string_view str) override;
 
   int* GetScreenRes() { return m_ScreenRes; }
@@ -92,6 +117,8 @@ class OrbitApp : public CoreApp {
   void RegisterCaptureWindow(class CaptureWindow* a_Capture);
   void RegisterOutputLog(class LogDataView* a_Log);
   void RegisterRuleEditor(class RuleEditor* a_RuleEditor);
+  void RegisterLatencyHistogramWindow(
+      class LatencyHistogramWindow* a_LatencyHistogram);
 
   void Unregister(class DataView* a_Model);
   bool SelectProcess(const std::string& a_Process);
@@ -103,6 +130,44 @@ class OrbitApp : public CoreApp {
 
   static void AddSelectionReport(
       std::shared_ptr<SamplingProfiler>& a_SamplingProfiler);
+  // Restricts the log to the entries of a_ThreadId, or of all threads if 0,
+  // in [a_MinTime, a_MaxTime].
+  void SetLogTimeRange(uint64_t a_MinTime, uint64_t a_MaxTime,
+                       ThreadID a_ThreadId);
+  // Report of the time the threads spent blocked, at the end of a capture
+  // with off-CPU callstacks.
+  void AddOffCpuReport();
+  // Report of the callstacks that faulted on pages, at the end of a capture
+  // with page fault sampling. Minor faults are weighted by the sampling period.
+  void AddPageFaultReport();
+  // Capture that the sampling diff compares the current one with.
+  void SetSamplingDiffBaseline(std::shared_ptr<SamplingProfiler> a_Profiler) {
+    m_SamplingDiffBaseline = std::move(a_Profiler);
+  }
+  std::shared_ptr<SamplingProfiler> GetSamplingDiffBaseline() const {
+    return m_SamplingDiffBaseline;
+  }
+  // Timings of the functions of a capture that the timer diff compares those
+  // of the current one with.
+  void SetTimerDiffBaseline(
+      std::shared_ptr<const std::vector<FunctionTimings>> a_Timings) {
+    m_TimerDiffBaseline = std::move(a_Timings);
+  }
+  std::shared_ptr<const std::vector<FunctionTimings>> GetTimerDiffBaseline()
+      const {
+    return m_TimerDiffBaseline;
+  }
+  // Of the selected functions of the current capture.
+  static std::vector<FunctionTimings> GetFunctionTimings();
+  // Reads only the function stats of a saved capture, not its timers.
+  bool LoadTimerDiffBaseline(const std::string& a_FileName);
+  // Samples per line of the source file last shown by the code view.
+  void SetSourceLineCounts(std::shared_ptr<const SourceLineCounts> a_Counts) {
+    m_SourceLineCounts = std::move(a_Counts);
+  }
+  std::shared_ptr<const SourceLineCounts> GetSourceLineCounts() const {
+    return m_SourceLineCounts;
+  }
 
   void GoToCode(DWORD64 a_Address);
   void GoToCallstack();
@@ -123,6 +188,12 @@ class OrbitApp : public CoreApp {
   void AddSelectionReportCallback(SamplingReportCallback a_Callback) {
     m_SelectionReportCallbacks.push_back(a_Callback);
   }
+  void AddOffCpuReportCallback(SamplingReportCallback a_Callback) {
+    m_OffCpuReportCallbacks.push_back(a_Callback);
+  }
+  void AddPageFaultReportCallback(SamplingReportCallback a_Callback) {
+    m_PageFaultReportCallbacks.push_back(a_Callback);
+  }
   typedef std::function<void(Variable* a_Variable)> WatchCallback;
   void AddWatchCallback(WatchCallback a_Callback) {
     m_AddToWatchCallbacks.push_back(a_Callback);
@@ -156,6 +227,13 @@ class OrbitApp : public CoreApp {
   void SetClipboardCallback(ClipboardCallback a_Callback) {
     m_ClipboardCallback = a_Callback;
   }
+  typedef std::function<void(const std::wstring&)> SamplingReportFilterCallback;
+  void SetSamplingReportFilterCallback(
+      SamplingReportFilterCallback a_Callback) {
+    m_SamplingReportFilterCallback = a_Callback;
+  }
+  // Filters the functions of the sampling report, e.g. to those of a module.
+  void FilterSamplingReport(const std::wstring& a_Filter);
 
   void SetCommandLineArguments(const std::vector<std::string>& a_Args);
   const std::vector<std::string>& GetCommandLineArguments() {
@@ -172,8 +250,13 @@ class OrbitApp : public CoreApp {
 
   void EnqueueModuleToLoad(const std::shared_ptr<struct Module>& a_Module);
   void LoadModules();
+  // Loads the types and globals of the modules loaded so far, which are not
+  // loaded with their functions, refreshing their views as they come.
+  void LoadTypesAndGlobals();
   void LoadRemoteModules();
   bool LoadRemoteModuleLocally(std::shared_ptr<struct Module>& a_Module);
+  bool LoadRemoteModuleFromCache(
+      const std::shared_ptr<struct Module>& a_Module);
   bool IsLoading();
   void SetTrackContextSwitches(bool a_Value);
   bool GetTrackContextSwitches();
@@ -194,8 +277,13 @@ class OrbitApp : public CoreApp {
   void OnMiniDump(const Message& a_Message);
   void OnRemoteProcess(const Message& a_Message);
   void OnRemoteProcessList(const Message& a_Message);
+  void OnRemoteProcessListDiff(const Message& a_Message);
   void OnRemoteModuleDebugInfo(const Message& a_Message);
+  // Stats of all the calls of the sampled functions, sent by the target.
+  void OnFunctionStats(const Message& a_Message);
   void LaunchRuleEditor(class Function* a_Function);
+  // Shows the durations of the calls to a_Function in the latency tab.
+  void ShowLatencyHistogram(const class Function& a_Function);
   void SetHeadless(bool a_Headless) { m_Headless = a_Headless; }
   bool GetHeadless() const { return m_Headless; }
   void SetIsRemote(bool a_IsRemote) { m_IsRemote = a_IsRemote; }
@@ -203,20 +291,41 @@ class OrbitApp : public CoreApp {
   bool HasTcpServer() const { return !IsRemote(); }
 
   RuleEditor* GetRuleEditor() { return m_RuleEditor; }
+  // The strings of the frames of callstacks, for the views to show them.
+  FrameStringCache& GetFrameStrings() { return m_FrameStrings; }
   const std::unordered_map<DWORD64, std::shared_ptr<class Rule> >* GetRules()
       override;
 
  private:
+  void UpdateLiveSamplingReport();
+  static std::string ResolveFrameString(uint64_t a_Address,
+                                        FrameDisplay a_Display);
+  // Stops the capture if a subsystem takes more memory than its budget in
+  // GParams.m_MemoryBudgets.
+  void CheckMemoryBudgets();
+  // To the trace format of the extension of file_name, see TraceEvents.h.
+  void ExportTrace(const std::string& file_name);
+  // The sampled callstacks and their counts, in the gzipped protobuf format
+  // of pprof, see PprofProfile.h.
+  void ExportProfile(const std::string& file_name);
+
   std::vector<std::string> m_Arguments;
   std::vector<RefreshCallback> m_RefreshCallbacks;
   std::vector<WatchCallback> m_AddToWatchCallbacks;
   std::vector<WatchCallback> m_UpdateWatchCallbacks;
   std::vector<SamplingReportCallback> m_SamplingReportsCallbacks;
   std::vector<SamplingReportCallback> m_SelectionReportCallbacks;
+  std::vector<SamplingReportCallback> m_OffCpuReportCallbacks;
+  std::vector<SamplingReportCallback> m_PageFaultReportCallbacks;
+  // Threads shown by the live sampling report, which is only rebuilt when
+  // new threads are sampled.
+  std::vector<ThreadID> m_LiveSamplingReportThreadIds;
+  Timer m_LiveSamplingReportTimer;
   std::vector<class DataView*> m_Panels;
   FindFileCallback m_FindFileCallback;
   SaveFileCallback m_SaveFileCallback;
   ClipboardCallback m_ClipboardCallback;
+  SamplingReportFilterCallback m_SamplingReportFilterCallback;
   bool m_Headless = false;
   bool m_IsRemote = false;
 
@@ -231,12 +340,16 @@ class OrbitApp : public CoreApp {
   CaptureWindow* m_CaptureWindow = nullptr;
   LogDataView* m_Log = nullptr;
   RuleEditor* m_RuleEditor = nullptr;
+  LatencyHistogramWindow* m_LatencyHistogramWindow = nullptr;
   int m_ScreenRes[2];
   bool m_HasPromptedForUpdate = false;
   bool m_NeedsThawing = false;
   bool m_UnrealEnabled = false;
 
   std::vector<std::shared_ptr<class SamplingReport> > m_SamplingReports;
+  std::shared_ptr<SamplingProfiler> m_SamplingDiffBaseline;
+  std::shared_ptr<const SourceLineCounts> m_SourceLineCounts;
+  std::shared_ptr<const std::vector<FunctionTimings>> m_TimerDiffBaseline;
   std::map<std::wstring, std::wstring> m_FileMapping;
   std::vector<std::string> m_SymbolDirectories;
   std::function<void(const std::wstring&)> m_UiCallback;
@@ -260,8 +373,17 @@ class OrbitApp : public CoreApp {
 
   class Debugger* m_Debugger = nullptr;
   int m_NumTicks = 0;
+  // Of the budgets set, to parse them again only once changed.
+  std::string m_MemoryBudgets;
 
   std::shared_ptr<StringManager> string_manager_ = nullptr;
+  // Cleared with each refresh of all the views, the symbols having changed.
+  FrameStringCache m_FrameStrings;
+
+  // Incremented to cancel the disassembly in progress.
+  std::atomic<uint64_t> m_DisassemblyId = 0;
+  // Created with the first disassembly, runs one at a time.
+  std::unique_ptr<MessageWorkerPool> m_DisassemblyWorker;
 #ifdef _WIN32
   CrashHandler m_CrashHandler;
 #else
@@ -6,14 +6,14 @@
 #include "Core.h"
 
 //-----------------------------------------------------------------------------
-TextBox* Batcher::GetTextBox(PickingID a_ID) {
+const CompactTimer* Batcher::GetTimer(PickingID a_ID) {
   if (a_ID.m_Type == PickingID::BOX) {
-    if (void** textBoxPtr = m_BoxBuffer.m_UserData.SlowAt(a_ID.m_Id)) {
-      return (TextBox*)*textBoxPtr;
+    if (void** timerPtr = m_BoxBuffer.m_UserData.SlowAt(a_ID.m_Id)) {
+      return (const CompactTimer*)*timerPtr;
     }
   } else if (a_ID.m_Type == PickingID::LINE) {
-    if (void** textBoxPtr = m_LineBuffer.m_UserData.SlowAt(a_ID.m_Id)) {
-      return (TextBox*)*textBoxPtr;
+    if (void** timerPtr = m_LineBuffer.m_UserData.SlowAt(a_ID.m_Id)) {
+      return (const CompactTimer*)*timerPtr;
     }
   }
 
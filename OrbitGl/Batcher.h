@@ -8,8 +8,17 @@
 #include "Geometry.h"
 #include "PickingManager.h"
 
+struct CompactTimer;
+
 //-----------------------------------------------------------------------------
 struct LineBuffer {
+  LineBuffer() {
+    m_Lines.SetMemorySubsystem(MemorySubsystem::kBatcher);
+    m_Colors.SetMemorySubsystem(MemorySubsystem::kBatcher);
+    m_PickingColors.SetMemorySubsystem(MemorySubsystem::kBatcher);
+    m_UserData.SetMemorySubsystem(MemorySubsystem::kBatcher);
+  }
+
   inline void Reset() {
     m_Lines.Reset();
     m_Colors.Reset();
@@ -26,6 +35,13 @@ struct LineBuffer {
 
 //-----------------------------------------------------------------------------
 struct BoxBuffer {
+  BoxBuffer() {
+    m_Boxes.SetMemorySubsystem(MemorySubsystem::kBatcher);
+    m_Colors.SetMemorySubsystem(MemorySubsystem::kBatcher);
+    m_PickingColors.SetMemorySubsystem(MemorySubsystem::kBatcher);
+    m_UserData.SetMemorySubsystem(MemorySubsystem::kBatcher);
+  }
+
   inline void Reset() {
     m_Boxes.Reset();
     m_Colors.Reset();
@@ -51,6 +67,7 @@ class Batcher {
     m_LineBuffer.m_Colors.push_back(a_Colors, 2);
     m_LineBuffer.m_PickingColors.push_back_n(pickCol, 2);
     m_LineBuffer.m_UserData.push_back(a_UserData);
+    ++m_Version;
   }
 
   inline void AddBox(const Box& a_Box, Color* a_Colors, PickingID::Type a_Type,
@@ -60,19 +77,25 @@ class Batcher {
     m_BoxBuffer.m_Colors.push_back(a_Colors, 4);
     m_BoxBuffer.m_PickingColors.push_back_n(pickCol, 4);
     m_BoxBuffer.m_UserData.push_back(a_UserData);
+    ++m_Version;
   }
 
   inline void Reset() {
     m_LineBuffer.Reset();
     m_BoxBuffer.Reset();
+    ++m_Version;
   }
 
-  TextBox* GetTextBox(PickingID a_ID);
+  const CompactTimer* GetTimer(PickingID a_ID);
 
   BoxBuffer& GetBoxBuffer() { return m_BoxBuffer; }
   LineBuffer& GetLineBuffer() { return m_LineBuffer; }
+  // Changes whenever the primitives change, for copies of them to know when
+  // they are out of date.
+  uint64_t GetVersion() const { return m_Version; }
 
  protected:
   LineBuffer m_LineBuffer;
   BoxBuffer m_BoxBuffer;
+  uint64_t m_Version = 0;
 };
@@ -8,6 +8,7 @@
 #include "Callstack.h"
 #include "Capture.h"
 #include "Core.h"
+#include "FrameStringCache.h"
 #include "OrbitProcess.h"
 #include "Pdb.h"
 #include "SamplingProfiler.h"
@@ -39,29 +40,36 @@ std::wstring CallStackDataView::GetValue(int a_Row, int a_Column) {
     return L"";
   }
 
+  // The strings of the frames are cached, not to look up their functions
+  // whenever the view is refreshed.
+  FrameStringCache& frameStrings = GOrbitApp->GetFrameStrings();
+  switch (s_HeaderMap[a_Column]) {
+    case Function::INDEX:
+      return s2ws(absl::StrFormat("%d", a_Row));
+    case Function::NAME:
+      return s2ws(frameStrings.GetFrameString(*m_CallStack, a_Row,
+                                              FrameDisplay::kName));
+    case Function::FILE:
+      return s2ws(frameStrings.GetFrameString(*m_CallStack, a_Row,
+                                              FrameDisplay::kFile));
+    case Function::MODULE:
+      return s2ws(frameStrings.GetFrameString(*m_CallStack, a_Row,
+                                              FrameDisplay::kModule));
+    default:
+      break;
+  }
+
   Function& function = GetFunction(a_Row);
 
   std::string value;
 
   switch (s_HeaderMap[a_Column]) {
-    case Function::INDEX:
-      value = absl::StrFormat("%d", a_Row);
-      break;
     case Function::SELECTED:
       value = function.IsSelected() ? "X" : "-";
       break;
-    case Function::NAME:
-      value = function.PrettyName();
-      break;
     case Function::ADDRESS:
       value = absl::StrFormat("0x%llx", function.GetVirtualAddress());
       break;
-    case Function::FILE:
-      value = function.File();
-      break;
-    case Function::MODULE:
-      value = function.GetModuleName();
-      break;
     case Function::LINE:
       value = absl::StrFormat("%i", function.Line());
       break;
@@ -71,6 +79,18 @@ std::wstring CallStackDataView::GetValue(int a_Row, int a_Column) {
     case Function::CALL_CONV:
       value = function.GetCallingConventionString();
       break;
+    case Function::TIME_P50:
+      value = GetPercentileString(function, 0.5);
+      break;
+    case Function::TIME_P90:
+      value = GetPercentileString(function, 0.9);
+      break;
+    case Function::TIME_P99:
+      value = GetPercentileString(function, 0.99);
+      break;
+    case Function::TIME_P99_9:
+      value = GetPercentileString(function, 0.999);
+      break;
     default:
       break;
   }
@@ -85,9 +105,10 @@ void CallStackDataView::OnFilter(const std::wstring& a_Filter) {
   std::vector<uint32_t> indices;
   std::vector<std::wstring> tokens = Tokenize(ToLower(a_Filter));
 
+  FrameStringCache& frameStrings = GOrbitApp->GetFrameStrings();
   for (int i = 0; i < (int)m_CallStack->m_Depth; ++i) {
-    const Function& function = GetFunction(i);
-    std::wstring name = ToLower(s2ws(function.PrettyName()));
+    std::wstring name = ToLower(s2ws(
+        frameStrings.GetFrameString(*m_CallStack, i, FrameDisplay::kName)));
     bool match = true;
 
     for (std::wstring& filterToken : tokens) {
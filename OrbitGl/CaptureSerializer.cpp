@@ -1,27 +1,35 @@
 #include "CaptureSerializer.h"
 
+#include <algorithm>
 #include <fstream>
 #include <memory>
+#include <sstream>
 
 #include "App.h"
 #include "Callstack.h"
 #include "Capture.h"
 #include "Core.h"
 #include "EventTracer.h"
+#include "OrbitBase/Logging.h"
 #include "OrbitModule.h"
 #include "OrbitProcess.h"
+#include "ParallelFor.h"
 #include "Pdb.h"
 #include "PrintVar.h"
 #include "SamplingProfiler.h"
 #include "ScopeTimer.h"
 #include "Serialization.h"
-#include "TextBox.h"
 #include "TimeGraph.h"
+#include "TimerChunkFile.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 
 //-----------------------------------------------------------------------------
 CaptureSerializer::CaptureSerializer() {
-  m_Version = 2;
+  // Since version 3, the timers are compressed chunks indexed at the end of
+  // the file. Since version 4, the other sections are each a size followed
+  // by their own archive, so that they are encoded and decoded in parallel.
+  m_Version = 4;
   m_TimerVersion = Timer::Version;
   m_SizeOfTimer = sizeof(Timer);
 }
@@ -29,13 +37,19 @@ CaptureSerializer::CaptureSerializer() {
 //-----------------------------------------------------------------------------
 void CaptureSerializer::Save(const std::wstring a_FileName) {
   Capture::PreSave();
+  m_NumTimers = m_TimeGraph->GetNumTimers();
+  m_ClockCorrections = Capture::GetClockCorrections();
 
-  std::basic_ostream<char> Stream(&GStreamCounter);
-  cereal::BinaryOutputArchive CountingArchive(Stream);
-  GStreamCounter.Reset();
-  Save(CountingArchive);
-  PRINT_VAR(GStreamCounter.Size());
-  GStreamCounter.Reset();
+  // Sections are independent, each encoded by its own archive on a worker.
+  std::vector<std::string> sections(NUM_SECTIONS);
+  ParallelFor(NUM_SECTIONS, [&](size_t a_Section) {
+    std::ostringstream stream;
+    {
+      cereal::BinaryOutputArchive archive(stream);
+      SaveSection(archive, static_cast<Section>(a_Section));
+    }
+    sections[a_Section] = stream.str();
+  });
 
   // Binary
   m_CaptureName = ws2s(a_FileName);
@@ -43,74 +57,101 @@ void CaptureSerializer::Save(const std::wstring a_FileName) {
   if (!myfile.fail()) {
     SCOPE_TIMER_LOG(
         absl::StrFormat("Saving capture in %s", ws2s(a_FileName).c_str()));
-    cereal::BinaryOutputArchive archive(myfile);
-    Save(archive);
+    // Header
+    {
+      cereal::BinaryOutputArchive archive(myfile);
+      archive(cereal::make_nvp("Capture", *this));
+    }
+
+    std::string sizes;
+    for (const std::string& section : sections) {
+      uint64_t size = section.size();
+      myfile.write(reinterpret_cast<const char*>(&size), sizeof(size));
+      myfile.write(section.data(), section.size());
+      absl::StrAppend(&sizes, sizes.empty() ? "" : ", ", GetPrettySize(size));
+    }
+    PRINT("Capture section sizes: %s\n", sizes.c_str());
+
+    // Timers
+    TimerChunkWriter writer(&myfile);
+    int numWrites = 0;
+    std::vector<std::shared_ptr<TimerChain> > chains =
+        m_TimeGraph->GetAllTimerChains();
+    for (const std::shared_ptr<TimerChain>& chain : chains) {
+      for (const CompactTimer& timer : *chain) {
+        if (++numWrites > m_NumTimers ||
+            !writer.AddTimer(chain->Expand(timer))) {
+          break;
+        }
+      }
+    }
+    writer.Close();
     myfile.close();
   }
 }
 
 //-----------------------------------------------------------------------------
 template <class T>
-void CaptureSerializer::Save(T& a_Archive) {
-  m_NumTimers = m_TimeGraph->GetNumTimers();
-
-  // Header
-  a_Archive(cereal::make_nvp("Capture", *this));
-
-  // Functions
-  {
-    ORBIT_SIZE_SCOPE("Functions");
-    std::vector<Function> functions;
-    for (auto& pair : Capture::GSelectedFunctionsMap) {
-      Function* func = pair.second;
-      if (func) {
-        functions.push_back(*func);
-        functions.back().SetAddress(func->Address());
+void CaptureSerializer::SaveSection(T& a_Archive, Section a_Section) {
+  switch (a_Section) {
+    case FUNCTIONS: {
+      std::vector<Function> functions;
+      for (auto& pair : Capture::GSelectedFunctionsMap) {
+        Function* func = pair.second;
+        if (func) {
+          functions.push_back(*func);
+          functions.back().SetAddress(func->Address());
+        }
       }
+      a_Archive(functions);
+      break;
     }
-
-    a_Archive(functions);
-  }
-
-  // Function Count
-  a_Archive(Capture::GFunctionCountMap);
-
-  // Process
-  {
-    ORBIT_SIZE_SCOPE("Capture::GTargetProcess");
-    a_Archive(Capture::GTargetProcess);
-  }
-
-  // Callstacks
-  {
-    ORBIT_SIZE_SCOPE("Capture::GCallstacks");
-    a_Archive(Capture::GCallstacks);
-  }
-
-  // Sampling profiler
-  {
-    ORBIT_SIZE_SCOPE("SamplingProfiler");
-    a_Archive(Capture::GSamplingProfiler);
-  }
-
-  // Event buffer
-  {
-    ORBIT_SIZE_SCOPE("Event Buffer");
-    a_Archive(GEventTracer.GetEventBuffer());
+    case FUNCTION_COUNT:
+      a_Archive(Capture::GFunctionCountMap);
+      break;
+    case PROCESS:
+      a_Archive(Capture::GTargetProcess);
+      break;
+    case CALLSTACKS:
+      a_Archive(Capture::GCallstacks);
+      break;
+    case SAMPLING_PROFILER:
+      a_Archive(Capture::GSamplingProfiler);
+      break;
+    case EVENT_BUFFER:
+      a_Archive(GEventTracer.GetEventBuffer());
+      break;
+    default:
+      break;
   }
+}
 
-  // Timers
-  int numWrites = 0;
-  std::vector<std::shared_ptr<TimerChain> > chains =
-      m_TimeGraph->GetAllTimerChains();
-  for (const std::shared_ptr<TimerChain>& chain : chains) {
-    for (const TextBox& box : *chain) {
-      a_Archive(cereal::binary_data((char*)&box.GetTimer(), sizeof(Timer)));
-
-      if (++numWrites > m_NumTimers) {
-        return;
-      }
-    }
+//-----------------------------------------------------------------------------
+template <class T>
+void CaptureSerializer::LoadSection(T& a_Archive, Section a_Section,
+                                    LoadedSections* o_Sections) {
+  switch (a_Section) {
+    case FUNCTIONS:
+      a_Archive(o_Sections->m_Functions);
+      break;
+    case FUNCTION_COUNT:
+      a_Archive(o_Sections->m_FunctionCountMap);
+      break;
+    case PROCESS:
+      a_Archive(o_Sections->m_Process);
+      break;
+    case CALLSTACKS:
+      a_Archive(o_Sections->m_Callstacks);
+      break;
+    case SAMPLING_PROFILER:
+      a_Archive(o_Sections->m_SamplingProfiler);
+      break;
+    case EVENT_BUFFER:
+      // Touched by no other section, loaded in place.
+      a_Archive(GEventTracer.GetEventBuffer());
+      break;
+    default:
+      break;
   }
 }
 
@@ -125,13 +166,41 @@ void CaptureSerializer::Load(const std::wstring a_FileName) {
   if (!file.fail()) {
     // header
     cereal::BinaryInputArchive archive(file);
+    // Older captures have none.
+    m_ClockCorrections.clear();
     archive(*this);
+    Capture::SetClockCorrections(std::move(m_ClockCorrections));
+
+    LoadedSections loaded;
+    if (m_Version >= 4) {
+      // Read in order, then decoded in parallel.
+      std::vector<std::string> sections(NUM_SECTIONS);
+      for (std::string& section : sections) {
+        uint64_t size = 0;
+        file.read(reinterpret_cast<char*>(&size), sizeof(size));
+        section.resize(size);
+        file.read(&section[0], size);
+      }
+      if (!file) {
+        ERROR("Truncated capture %s", ws2s(a_FileName).c_str());
+        return;
+      }
+      ParallelFor(NUM_SECTIONS, [&](size_t a_Section) {
+        std::istringstream stream(sections[a_Section]);
+        cereal::BinaryInputArchive sectionArchive(stream);
+        LoadSection(sectionArchive, static_cast<Section>(a_Section), &loaded);
+      });
+    } else {
+      for (int section = 0; section < NUM_SECTIONS; ++section) {
+        LoadSection(archive, static_cast<Section>(section), &loaded);
+      }
+    }
 
     // functions
     std::shared_ptr<Module> module = std::make_shared<Module>();
     Capture::GTargetProcess->AddModule(module);
     module->m_Pdb = std::make_shared<Pdb>(ws2s(a_FileName).c_str());
-    archive(module->m_Pdb->GetFunctions());
+    module->m_Pdb->GetFunctions().swap(loaded.m_Functions);
     module->m_Pdb->ProcessData();
     GPdbDbg = module->m_Pdb;
     Capture::GSelectedFunctionsMap.clear();
@@ -141,28 +210,31 @@ void CaptureSerializer::Load(const std::wstring a_FileName) {
     Capture::GVisibleFunctionsMap = Capture::GSelectedFunctionsMap;
 
     // Function count
-    archive(Capture::GFunctionCountMap);
+    Capture::GFunctionCountMap.swap(loaded.m_FunctionCountMap);
 
     // Process
-    archive(Capture::GTargetProcess);
+    Capture::GTargetProcess = loaded.m_Process;
 
     // Callstacks
-    archive(Capture::GCallstacks);
+    Capture::GCallstacks.swap(loaded.m_Callstacks);
+    Capture::UpdateCallstacksMemory();
 
     // Sampling profiler
-    archive(Capture::GSamplingProfiler);
+    Capture::GSamplingProfiler = loaded.m_SamplingProfiler;
     Capture::GSamplingProfiler->SortByThreadUsage();
     GOrbitApp->AddSamplingReport(Capture::GSamplingProfiler, GOrbitApp);
     Capture::GSamplingProfiler->SetLoadedFromFile(true);
 
-    // Event buffer
-    archive(GEventTracer.GetEventBuffer());
-
     // Timers
-    Timer timer;
-    while (file.read((char*)&timer, sizeof(Timer))) {
-      m_TimeGraph->ProcessTimer(timer);
+    if (m_Version >= 3) {
+      LoadTimers(ws2s(a_FileName));
+    } else {
+      Timer timer;
+      while (file.read((char*)&timer, sizeof(Timer))) {
+        m_TimeGraph->ProcessTimer(timer);
+      }
     }
+    m_TimeGraph->FlushFunctionStats();
 
     GOrbitApp->FireRefreshCallbacks();
   }
@@ -170,10 +242,76 @@ void CaptureSerializer::Load(const std::wstring a_FileName) {
 }
 
 //-----------------------------------------------------------------------------
-ORBIT_SERIALIZE(CaptureSerializer, 0) {
+bool CaptureSerializer::LoadFunctionTimings(
+    const std::wstring& a_FileName, std::vector<FunctionTimings>* o_Timings) {
+  std::ifstream file(ws2s(a_FileName), std::ios::binary);
+  if (file.fail()) {
+    return false;
+  }
+
+  // The functions are the first section, right after the header.
+  std::vector<Function> functions;
+  cereal::BinaryInputArchive archive(file);
+  archive(*this);
+  if (m_Version >= 4) {
+    uint64_t size = 0;
+    file.read(reinterpret_cast<char*>(&size), sizeof(size));
+    std::string section(size, '\0');
+    file.read(&section[0], size);
+    if (!file) {
+      return false;
+    }
+    std::istringstream stream(section);
+    cereal::BinaryInputArchive sectionArchive(stream);
+    sectionArchive(functions);
+  } else {
+    archive(functions);
+  }
+
+  o_Timings->clear();
+  for (const Function& function : functions) {
+    if (function.Stats() != nullptr) {
+      o_Timings->push_back(
+          {function.PrettyName(), function.Address(), *function.Stats()});
+    }
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void CaptureSerializer::LoadTimers(const std::string& a_FileName) {
+  TimerChunkReader reader;
+  if (!reader.Open(a_FileName)) {
+    return;
+  }
+
+  // Chunks are decompressed in parallel, a batch at a time to bound the
+  // memory, while the time graph takes their timers in order.
+  const std::vector<TimerChunkIndexEntry>& chunks = reader.GetChunks();
+  size_t batchSize = GetNumWorkers();
+  std::vector<std::vector<Timer> > timers(batchSize);
+  for (size_t first = 0; first < chunks.size(); first += batchSize) {
+    size_t numChunks = std::min(batchSize, chunks.size() - first);
+    ParallelFor(numChunks, [&](size_t i) {
+      if (!reader.ReadChunk(first + i, &timers[i])) {
+        ERROR("Could not read timer chunk %zu of %s", first + i,
+              a_FileName.c_str());
+      }
+    });
+    for (size_t i = 0; i < numChunks; ++i) {
+      for (Timer& timer : timers[i]) {
+        m_TimeGraph->ProcessTimer(timer);
+      }
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+ORBIT_SERIALIZE(CaptureSerializer, 1) {
   ORBIT_NVP_VAL(0, m_CaptureName);
   ORBIT_NVP_VAL(0, m_Version);
   ORBIT_NVP_VAL(0, m_TimerVersion);
   ORBIT_NVP_VAL(0, m_NumTimers);
   ORBIT_NVP_VAL(0, m_SizeOfTimer);
+  ORBIT_NVP_VAL(1, m_ClockCorrections);
 }
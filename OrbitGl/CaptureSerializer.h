@@ -3,11 +3,18 @@
 //-----------------------------------
 #pragma once
 
+#include <map>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "Callstack.h"
+#include "ClockSync.h"
+#include "OrbitFunction.h"
 #include "OrbitType.h"
 #include "SerializationMacros.h"
+#include "TimerDiff.h"
 
 //-----------------------------------------------------------------------------
 class CaptureSerializer {
@@ -15,9 +22,38 @@ class CaptureSerializer {
   CaptureSerializer();
   void Save(const std::wstring a_FileName);
   void Load(const std::wstring a_FileName);
+  // Reads only the functions of the capture and their stats, not its timers,
+  // e.g. as the baseline of a timer diff. Returns false if the file can't be
+  // read.
+  bool LoadFunctionTimings(const std::wstring& a_FileName,
+                           std::vector<FunctionTimings>* o_Timings);
 
+  // Parts of the capture saved before the timers, in this order.
+  enum Section {
+    FUNCTIONS,
+    FUNCTION_COUNT,
+    PROCESS,
+    CALLSTACKS,
+    SAMPLING_PROFILER,
+    EVENT_BUFFER,
+    NUM_SECTIONS
+  };
+
+  // Sections decoded on workers, applied to the capture once all are loaded.
+  struct LoadedSections {
+    std::vector<Function> m_Functions;
+    std::unordered_map<ULONG64, ULONG64> m_FunctionCountMap;
+    std::shared_ptr<class Process> m_Process;
+    std::unordered_map<DWORD64, std::shared_ptr<CallStack> > m_Callstacks;
+    std::shared_ptr<class SamplingProfiler> m_SamplingProfiler;
+  };
+
+  template <class T>
+  void SaveSection(T& a_Archive, Section a_Section);
   template <class T>
-  void Save(T& a_Archive);
+  void LoadSection(T& a_Archive, Section a_Section,
+                   LoadedSections* o_Sections);
+  void LoadTimers(const std::string& a_FileName);
 
   class TimeGraph* m_TimeGraph;
   class SamplingProfiler* m_SamplingProfiler;
@@ -27,6 +63,8 @@ class CaptureSerializer {
   int m_TimerVersion;
   int m_NumTimers;
   int m_SizeOfTimer;
+  // See Capture::GetClockCorrections.
+  std::map<std::string, ClockCorrection> m_ClockCorrections;
 
   ORBIT_SERIALIZABLE;
 };
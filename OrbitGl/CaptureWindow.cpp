@@ -4,18 +4,25 @@
 
 #include "CaptureWindow.h"
 
+#include <algorithm>
+#include <cfloat>
+
 #include "../OrbitPlugin/OrbitSDK.h"
 #include "App.h"
 #include "Capture.h"
+#include "ConnectionManager.h"
 #include "EventTracer.h"
 #include "GlUtils.h"
+#include "MemoryAccounting.h"
 #include "PluginManager.h"
+#include "SamplingProfiler.h"
 #include "Serialization.h"
 #include "Systrace.h"
 #include "TcpClient.h"
 #include "TcpServer.h"
 #include "TimerManager.h"
 #include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
 
 #ifdef _WIN32
 #include "SymbolUtils.h"
@@ -50,13 +57,18 @@ CaptureWindow::CaptureWindow() {
 
   GTimerManager->m_TimerAddedCallbacks.push_back(
       [=](Timer& a_Timer) { this->OnTimerAdded(a_Timer); });
+  GTimerManager->m_TimersConsumedCallbacks.push_back(
+      [=]() { m_TimeGraph.FlushFunctionStats(); });
   GTimerManager->m_ContextSwitchAddedCallback = [=](const ContextSwitch& a_CS) {
     this->OnContextSwitchAdded(a_CS);
   };
+  GTimerManager->m_ThreadStateChangeAddedCallback =
+      [=](const ThreadStateChange& thread_state_change) {
+        this->OnThreadStateChangeAdded(thread_state_change);
+      };
 
   m_HoverDelayMs = 300;
   m_CanHover = false;
-  m_IsHovering = false;
   ResetHoverTimer();
 
   m_Slider.SetCanvas(this);
@@ -151,6 +163,16 @@ void CaptureWindow::MouseMoved(int a_X, int a_Y, bool a_Left, bool /*a_Right*/,
 
 //-----------------------------------------------------------------------------
 void CaptureWindow::LeftDown(int a_X, int a_Y) {
+  float overviewTop = m_Slider.GetPixelHeight();
+  if (m_DrawOverview && a_Y >= overviewTop &&
+      a_Y < overviewTop + GetOverviewPixelHeight()) {
+    double ratio = (double)a_X / (double)getWidth();
+    m_TimeGraph.JumpTo(
+        m_TimeGraph.GetTickFromUs(ratio * m_TimeGraph.GetSessionTimeSpanUs()));
+    NeedsUpdate();
+    return;
+  }
+
   // Store world clicked pos for panning
   ScreenToWorld(a_X, a_Y, m_WorldClickX, m_WorldClickY);
   m_ScreenClickX = a_X;
@@ -194,7 +216,7 @@ void CaptureWindow::Pick(int a_X, int a_Y) {
 
   PickingID pickId = PickingID::Get(*((uint32_t*)(&pixels[0])));
 
-  Capture::GSelectedTextBox = nullptr;
+  Capture::GSelectedTimer = nullptr;
   Capture::GSelectedThreadId = 0;
 
   Pick(pickId, a_X, a_Y);
@@ -204,47 +226,38 @@ void CaptureWindow::Pick(int a_X, int a_Y) {
 
 //-----------------------------------------------------------------------------
 void CaptureWindow::Pick(PickingID a_PickingID, int a_X, int a_Y) {
-  uint32_t type = a_PickingID.m_Type;
-  uint32_t id = a_PickingID.m_Id;
-
-  switch (type) {
-    case PickingID::BOX: {
-      void** textBoxPtr =
-          m_TimeGraph.GetBatcher().GetBoxBuffer().m_UserData.SlowAt(id);
-      if (textBoxPtr) {
-        TextBox* textBox = (TextBox*)*textBoxPtr;
-        SelectTextBox(textBox);
-      }
-      break;
-    }
-    case PickingID::LINE: {
-      void** textBoxPtr =
-          m_TimeGraph.GetBatcher().GetLineBuffer().m_UserData.SlowAt(id);
-      if (textBoxPtr) {
-        TextBox* textBox = (TextBox*)*textBoxPtr;
-        SelectTextBox(textBox);
-      }
-      break;
+  if (a_PickingID.m_Type == PickingID::PICKABLE) {
+    m_PickingManager.Pick(a_PickingID.m_Id, a_X, a_Y);
+    return;
+  }
+
+  // Timers are not drawn in the picking pass, they are found from the layout.
+  float worldX, worldY;
+  ScreenToWorld(a_X, a_Y, worldX, worldY);
+  if (const CompactTimer* timer = m_TimeGraph.FindTimer(worldX, worldY)) {
+    SelectTimer(timer);
+  } else if (std::optional<size_t> frame =
+                 m_TimeGraph.FindFrame(worldX, worldY)) {
+    m_SelectedFrame = frame;
+    if (m_DoubleClicking) {
+      m_TimeGraph.ZoomFrame(*frame);
     }
-    case PickingID::PICKABLE:
-      m_PickingManager.Pick(a_PickingID.m_Id, a_X, a_Y);
-      break;
   }
 }
 
 //-----------------------------------------------------------------------------
-void CaptureWindow::SelectTextBox(class TextBox* a_TextBox) {
-  Capture::GSelectedTextBox = a_TextBox;
-  Capture::GSelectedThreadId = a_TextBox->GetTimer().m_TID;
-  Capture::GSelectedCallstack =
-      Capture::GetCallstack(a_TextBox->GetTimer().m_CallstackHash);
+void CaptureWindow::SelectTimer(const CompactTimer* a_Timer) {
+  Timer timer = m_TimeGraph.ExpandTimer(*a_Timer);
+  Capture::GSelectedTimer = a_Timer;
+  Capture::GSelectedThreadId = timer.m_TID;
+  m_SelectedFrame.reset();
+  Capture::GSelectedCallstack = Capture::GetCallstack(timer.m_CallstackHash);
   GOrbitApp->SetCallStack(Capture::GSelectedCallstack);
 
-  const Timer& a_Timer = a_TextBox->GetTimer();
-  DWORD64 address = a_Timer.m_FunctionAddress;
-  if (a_Timer.IsType(Timer::ZONE)) {
+  DWORD64 address = timer.m_FunctionAddress;
+  if (timer.IsType(Timer::ZONE)) {
     std::shared_ptr<CallStack> callStack =
-        Capture::GetCallstack(a_Timer.m_CallstackHash);
+        Capture::GetCallstack(timer.m_CallstackHash);
     if (callStack && callStack->m_Depth > 1) {
       address = callStack->m_Data[1];
     }
@@ -252,44 +265,63 @@ void CaptureWindow::SelectTextBox(class TextBox* a_TextBox) {
 
   FindCode(address);
 
-  if (m_DoubleClicking && a_TextBox) {
-    m_TimeGraph.Zoom(a_TextBox);
+  if (m_DoubleClicking) {
+    m_TimeGraph.Zoom(timer);
   }
 }
 
 //-----------------------------------------------------------------------------
 void CaptureWindow::Hover(int a_X, int a_Y) {
-  // 4 bytes per pixel (RGBA), 1x1 bitmap
-  std::vector<unsigned char> pixels(1 * 1 * 4);
-  glReadPixels(a_X, m_MainWindowHeight - a_Y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE,
-               &pixels[0]);
-
-  PickingID pickId = *((PickingID*)(&pixels[0]));
-
-  TextBox* textBox = m_TimeGraph.GetBatcher().GetTextBox(pickId);
-  if (textBox) {
-    if (!textBox->GetTimer().IsType(Timer::CORE_ACTIVITY)) {
-      Function* func =
-          Capture::GSelectedFunctionsMap[textBox->GetTimer().m_FunctionAddress];
-      m_ToolTip =
-          s2ws(absl::StrFormat("%s %s", func ? func->PrettyName().c_str() : "",
-                               textBox->GetText().c_str()));
+  float worldX, worldY;
+  ScreenToWorld(a_X, a_Y, worldX, worldY);
+
+  const CompactTimer* compact = m_TimeGraph.FindTimer(worldX, worldY);
+  if (compact) {
+    if (!compact->IsType(Timer::CORE_ACTIVITY)) {
+      Timer timer = m_TimeGraph.ExpandTimer(*compact);
+      Function* func = Capture::GSelectedFunctionsMap[timer.m_FunctionAddress];
+      std::string onCpu;
+      std::optional<uint64_t> onCpuNs = m_TimeGraph.GetOnCpuTimeNs(compact);
+      if (onCpuNs.has_value() && timer.m_End > timer.m_Start) {
+        onCpu = absl::StrFormat(
+            " (on-CPU %s, %.0f%%)", GetPrettyTime(*onCpuNs * 0.000001),
+            100.0 * *onCpuNs / (timer.m_End - timer.m_Start));
+      }
+      m_ToolTip = s2ws(absl::StrFormat(
+          "%s %s%s", func ? func->PrettyName().c_str() : "",
+          m_TimeGraph.GetTimerText(timer).c_str(), onCpu.c_str()));
       GOrbitApp->SendToUiAsync(L"tooltip:" + m_ToolTip);
       NeedsRedraw();
     }
+  } else if (std::optional<size_t> frame =
+                 m_TimeGraph.FindFrame(worldX, worldY)) {
+    m_ToolTip = s2ws(m_TimeGraph.GetFrameText(*frame));
+    GOrbitApp->SendToUiAsync(L"tooltip:" + m_ToolTip);
+    NeedsRedraw();
   }
 }
 
 //-----------------------------------------------------------------------------
 void CaptureWindow::FindCode(DWORD64 address) {
-#ifdef _WIN32
   SCOPE_TIMER_LOG("FindCode");
 
   LineInfo lineInfo;
+  std::shared_ptr<SamplingProfiler> profiler = Capture::GSamplingProfiler;
+
+#ifdef _WIN32
+  bool found = SymUtils::GetLineInfo(address, lineInfo);
+#else
+  bool found = false;
+#endif
+  if (found || (profiler && profiler->GetLineInfo(address, lineInfo))) {
+    // For the heat of the lines of the file shown.
+    std::shared_ptr<const SourceLineCounts> lineCounts;
+    if (profiler) {
+      lineCounts = std::make_shared<const SourceLineCounts>(
+          profiler->GetSourceLineCounts(lineInfo.m_File));
+    }
+    GOrbitApp->SetSourceLineCounts(std::move(lineCounts));
 
-  if (SymUtils::GetLineInfo(address, lineInfo) ||
-      (Capture::GSamplingProfiler &&
-       Capture::GSamplingProfiler->GetLineInfo(address, lineInfo))) {
     --lineInfo.m_Line;
 
     // File mapping
@@ -301,20 +333,29 @@ void CaptureWindow::FindCode(DWORD64 address) {
 
     if (lineInfo.m_Address != 0) {
       GOrbitApp->SendToUiAsync(
-          Format(L"code^%s^%i", lineInfo.m_File.c_str(), lineInfo.m_Line));
+          Format(L"code^%ls^%i", lineInfo.m_File.c_str(), lineInfo.m_Line));
     }
   }
-#else
-  UNUSED(address);
-#endif
 }
 
 //-----------------------------------------------------------------------------
 void CaptureWindow::PreRender() {
   if (m_CanHover && m_HoverTimer.QueryMillis() > m_HoverDelayMs) {
-    m_IsHovering = true;
-    m_Picking = true;
-    NeedsRedraw();
+    // The hovered timer is found from the layout, no picking pass needed.
+    m_CanHover = false;
+    Hover(m_MousePosX, m_MousePosY);
+    m_HoverTimer.Reset();
+  }
+
+  // The view only changes with the data: while capturing, it follows the
+  // latest data, otherwise new data, e.g. pulled from the service, is shown
+  // where the view is.
+  if (m_TimeGraph.CheckForNewData()) {
+    if (Capture::IsCapturing()) {
+      ZoomAll();
+    } else {
+      NeedsUpdate();
+    }
   }
 
   m_NeedsRedraw = m_NeedsRedraw || m_TimeGraph.IsRedrawNeeded();
@@ -322,19 +363,9 @@ void CaptureWindow::PreRender() {
 
 //-----------------------------------------------------------------------------
 void CaptureWindow::PostRender() {
-  if (m_IsHovering) {
-    m_IsHovering = false;
-    m_CanHover = false;
-    m_Picking = false;
-    m_HoverTimer.Reset();
-
-    Hover(m_MousePosX, m_MousePosY);
-    NeedsUpdate();
-    GlCanvas::Render(m_Width, m_Height);
-    m_HoverTimer.Reset();
-  }
-
   if (m_Picking) {
+    RenderStats::Scope scope(&m_TimeGraph.GetRenderStats(),
+                             RenderStats::PICKING);
     m_Picking = false;
     Pick(m_ScreenClickX, m_ScreenClickY);
     NeedsRedraw();
@@ -543,14 +574,49 @@ void CaptureWindow::KeyPressed(unsigned int a_KeyCode, bool a_Ctrl,
       case 'M':
         m_DrawMemTracker = !m_DrawMemTracker;
         break;
+      case 'U':
+        m_DrawRenderStats = !m_DrawRenderStats;
+        break;
+      case 'V':
+        m_DrawOverview = !m_DrawOverview;
+        NeedsUpdate();
+        break;
+      case 'G':
+        m_TimeGraph.ToggleInstancedTimers();
+        NeedsUpdate();
+        break;
       case 'K':
         SendProcess();
         break;
+      case 'N':
+        m_TimeGraph.ZoomNextWorstFrame();
+        break;
+      case 'R':
+        if (Capture::GSelectedTimer != nullptr) {
+          m_TimeGraph.ComputeCriticalPath(*Capture::GSelectedTimer);
+        } else if (m_SelectedFrame) {
+          m_TimeGraph.ComputeFrameCriticalPath(*m_SelectedFrame);
+        }
+        m_DrawCriticalPath = m_TimeGraph.HasCriticalPath();
+        break;
+      case 'T':
+        if (GParams.m_FlightRecorderWindowMs > 0) {
+          ConnectionManager::Get().RequestFlightRecorderDump();
+        }
+        break;
       case 18:  // Left
-        m_TimeGraph.OnLeft();
+        if (a_Ctrl) {
+          m_TimeGraph.OnPreviousCall();
+        } else {
+          m_TimeGraph.OnLeft();
+        }
         break;
       case 20:  // Right
-        m_TimeGraph.OnRight();
+        if (a_Ctrl) {
+          m_TimeGraph.OnNextCall();
+        } else {
+          m_TimeGraph.OnRight();
+        }
         break;
       case 19:  // Up
         m_TimeGraph.OnUp();
@@ -579,18 +645,17 @@ std::wstring GOTO_SOURCE = L"Go to Source";
 std::vector<std::wstring> CaptureWindow::GetContextMenu() {
   static std::vector<std::wstring> menu = {GOTO_CALLSTACK, GOTO_SOURCE};
   static std::vector<std::wstring> emptyMenu;
-  TextBox* selection = Capture::GSelectedTextBox;
-  return selection && !selection->GetTimer().IsCoreActivity() ? menu
-                                                              : emptyMenu;
+  const CompactTimer* selection = Capture::GSelectedTimer;
+  return selection && !selection->IsCoreActivity() ? menu : emptyMenu;
 }
 
 //-----------------------------------------------------------------------------
 void CaptureWindow::OnContextMenu(const std::wstring& a_Action,
                                   int /*a_MenuIndex*/) {
-  if (Capture::GSelectedTextBox) {
+  if (Capture::GSelectedTimer) {
     if (a_Action == GOTO_SOURCE) {
       GOrbitApp->GoToCode(
-          Capture::GSelectedTextBox->GetTimer().m_FunctionAddress);
+          m_TimeGraph.ExpandTimer(*Capture::GSelectedTimer).m_FunctionAddress);
     } else if (a_Action == GOTO_CALLSTACK) {
       GOrbitApp->GoToCallstack();
     }
@@ -622,10 +687,12 @@ void CaptureWindow::ResetHoverTimer() {
 
 //-----------------------------------------------------------------------------
 void CaptureWindow::Draw() {
+  if (!m_Picking) {
+    m_TimeGraph.GetRenderStats().BeginFrame();
+  }
   m_WorldMaxY = 1.5f * ScreenToWorldHeight((int)m_Slider.GetPixelHeight());
-
-  if (Capture::IsCapturing()) {
-    ZoomAll();
+  if (m_DrawOverview) {
+    m_WorldMaxY += ScreenToWorldHeight((int)GetOverviewPixelHeight());
   }
 
   m_TimeGraph.Draw(m_Picking);
@@ -642,13 +709,14 @@ void CaptureWindow::Draw() {
     Vec2 pos(from, m_WorldTopLeftY - m_WorldHeight);
     Vec2 size(sizex, m_WorldHeight);
 
-    std::string time = GetPrettyTime(micros * 0.001);
+    std::string time = GetPrettyTime(micros * 0.001) +
+                       GetSelectionCallsText(minTime, maxTime);
     TextBox box(pos, size, time, Color(0, 128, 0, 128));
     box.SetTextY(m_SelectStop[1]);
     box.Draw(m_TextRenderer, -FLT_MAX, true, true);
   }
 
-  if (!m_Picking && !m_IsHovering) {
+  if (!m_Picking) {
     DrawStatus();
     RenderTimeBar();
 
@@ -661,6 +729,32 @@ void CaptureWindow::Draw() {
   }
 }
 
+//-----------------------------------------------------------------------------
+const std::string& CaptureWindow::GetSelectionCallsText(TickType a_MinTime,
+                                                        TickType a_MaxTime) {
+  const CompactTimer* selected = Capture::GSelectedTimer;
+  uint64_t function =
+      selected ? m_TimeGraph.GetTimerTables()->GetFunctionAddress(*selected)
+               : 0;
+  if (function != m_SelectionCallsFunction ||
+      a_MinTime != m_SelectionCallsMinTime ||
+      a_MaxTime != m_SelectionCallsMaxTime) {
+    m_SelectionCallsFunction = function;
+    m_SelectionCallsMinTime = a_MinTime;
+    m_SelectionCallsMaxTime = a_MaxTime;
+    m_SelectionCallsText.clear();
+    if (function != 0) {
+      FunctionStats stats =
+          m_TimeGraph.GetFunctionStats(function, a_MinTime, a_MaxTime);
+      m_SelectionCallsText = absl::StrFormat(
+          " - %s: %u calls, avg %s",
+          m_TimeGraph.GetTimerName(m_TimeGraph.ExpandTimer(*selected)),
+          stats.m_Count, GetPrettyTime(stats.m_AverageTimeMs));
+    }
+  }
+  return m_SelectionCallsText;
+}
+
 //-----------------------------------------------------------------------------
 void CaptureWindow::DrawScreenSpace() {
   double timeSpan = m_TimeGraph.GetSessionTimeSpanUs();
@@ -679,6 +773,10 @@ void CaptureWindow::DrawScreenSpace() {
   glVertex3f(0, canvasHeight - height, z);
   glEnd();
 
+  if (m_DrawOverview && !m_Picking) {
+    DrawOverview();
+  }
+
   // Time bar
   if (m_TimeGraph.GetSessionTimeSpanUs() > 0) {
     glColor4ub(70, 70, 70, 200);
@@ -710,6 +808,76 @@ void CaptureWindow::DrawScreenSpace() {
   }
 }
 
+//-----------------------------------------------------------------------------
+float CaptureWindow::GetOverviewPixelHeight() {
+  return CaptureOverview::kNumRows * 0.5f * m_Slider.GetPixelHeight();
+}
+
+//-----------------------------------------------------------------------------
+void CaptureWindow::DrawOverview() {
+  const CaptureOverview& overview = Capture::GCaptureOverview;
+  double timeSpan = m_TimeGraph.GetSessionTimeSpanUs();
+  float width = (float)getWidth();
+  float top = (float)getHeight() - m_Slider.GetPixelHeight();
+  float rowHeight = 0.5f * m_Slider.GetPixelHeight();
+  float z = GlCanvas::Z_VALUE_TEXT_UI_BG;
+
+  // All the quads go in one array, drawn in one call.
+  m_OverviewVertices.clear();
+  m_OverviewColors.clear();
+  auto addQuad = [&](float a_X0, float a_Y0, float a_X1, float a_Y1,
+                     const Color& a_Color) {
+    m_OverviewVertices.push_back(Vec3(a_X0, a_Y0, z));
+    m_OverviewVertices.push_back(Vec3(a_X1, a_Y0, z));
+    m_OverviewVertices.push_back(Vec3(a_X1, a_Y1, z));
+    m_OverviewVertices.push_back(Vec3(a_X0, a_Y1, z));
+    m_OverviewColors.insert(m_OverviewColors.end(), 4, a_Color);
+  };
+
+  float bottom = top - GetOverviewPixelHeight();
+  addQuad(0, bottom, width, top, Color(40, 40, 40, 230));
+
+  if (timeSpan > 0 && !overview.IsEmpty()) {
+    static const Color kRowColors[CaptureOverview::kNumRows] = {
+        Color(87, 166, 74, 255), Color(66, 133, 244, 255),
+        Color(255, 167, 38, 255), Color(219, 68, 55, 255)};
+    double pixelsPerTick = width / (timeSpan * 1000.0);
+    double beginX = ((double)overview.GetBeginTime() -
+                     (double)m_TimeGraph.GetTickFromUs(0)) *
+                    pixelsPerTick;
+    float bucketWidth = (float)(overview.GetBucketTicks() * pixelsPerTick);
+    for (size_t row = 0; row < CaptureOverview::kNumRows; ++row) {
+      auto overviewRow = static_cast<CaptureOverview::Row>(row);
+      uint64_t maxValue = overview.GetMaxValue(overviewRow);
+      if (maxValue == 0) continue;
+      float rowBottom = top - (row + 1) * rowHeight;
+      for (size_t i = 0; i < CaptureOverview::kNumBuckets; ++i) {
+        uint64_t value = overview.GetValue(overviewRow, i);
+        if (value == 0) continue;
+        float x = (float)beginX + i * bucketWidth;
+        float barHeight = rowHeight * value / maxValue;
+        addQuad(x, rowBottom, x + std::max(bucketWidth, 1.f),
+                rowBottom + barHeight, kRowColors[row]);
+      }
+    }
+
+    // The time range of the view.
+    float viewX0 = (float)(m_TimeGraph.GetMinTimeUs() / timeSpan) * width;
+    float viewX1 = (float)(m_TimeGraph.GetMaxTimeUs() / timeSpan) * width;
+    addQuad(viewX0, bottom, std::max(viewX1, viewX0 + 2.f), top,
+            Color(255, 255, 255, 60));
+  }
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  glVertexPointer(3, GL_FLOAT, sizeof(Vec3), m_OverviewVertices.data());
+  glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Color),
+                 m_OverviewColors.data());
+  glDrawArrays(GL_QUADS, 0, (GLsizei)m_OverviewVertices.size());
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+}
+
 //-----------------------------------------------------------------------------
 void CaptureWindow::OnDrag(float a_Ratio) {
   m_TimeGraph.OnDrag(a_Ratio);
@@ -822,6 +990,18 @@ void CaptureWindow::RenderUI() {
     m_StatsWindow.AddLine(VAR_TO_ANSI(m_TimeGraph.GetNumDrawnTextBoxes()));
     m_StatsWindow.AddLine(VAR_TO_ANSI(m_TimeGraph.GetNumTimers()));
     m_StatsWindow.AddLine(VAR_TO_ANSI(m_TimeGraph.GetThreadTotalHeight()));
+    m_StatsWindow.AddLine(
+        "Sampling events memory: " +
+        GetPrettySize(GEventTracer.GetEventBuffer().GetMemorySize()));
+    m_StatsWindow.AddLine(
+        VAR_TO_ANSI(GEventTracer.GetEventBuffer().GetNumLateEvents()));
+    for (size_t i = 0; i < MemoryAccounting::kNumSubsystems; ++i) {
+      auto subsystem = static_cast<MemorySubsystem>(i);
+      uint64_t bytes = MemoryAccounting::GetBytes(subsystem);
+      m_StatsWindow.AddLine(absl::StrFormat(
+          "Memory %s: %s", MemoryAccounting::GetName(subsystem),
+          GetPrettySize(bytes)));
+    }
 
 #ifdef WIN32
     for (std::string& line : GTcpServer->GetStats()) {
@@ -832,9 +1012,14 @@ void CaptureWindow::RenderUI() {
     m_StatsWindow.AddLine(VAR_TO_ANSI(hasConnection));
 #else
     m_StatsWindow.AddLine(
-        VAR_TO_ANSI(GEventTracer.GetEventBuffer().GetCallstacks().size()));
+        VAR_TO_ANSI(GEventTracer.GetEventBuffer().GetNumThreads()));
     m_StatsWindow.AddLine(
         VAR_TO_ANSI(GEventTracer.GetEventBuffer().GetNumEvents()));
+    if (GTcpClient != nullptr) {
+      for (std::string& line : GTcpClient->GetStats()) {
+        m_StatsWindow.AddLine(line);
+      }
+    }
 #endif
 
     m_StatsWindow.Draw("Capture Stats", &m_DrawStats);
@@ -855,10 +1040,26 @@ void CaptureWindow::RenderUI() {
     RenderThreadFilterUi();
   }
 
+  if (m_DrawCriticalPath) {
+    m_CriticalPathWindow.Clear();
+    for (absl::string_view line :
+         absl::StrSplit(m_TimeGraph.GetCriticalPathText(), '\n')) {
+      m_CriticalPathWindow.AddLine(std::string(line));
+    }
+    m_CriticalPathWindow.Draw("Critical Path", &m_DrawCriticalPath);
+    if (!m_DrawCriticalPath) {
+      m_TimeGraph.ClearCriticalPath();
+    }
+  }
+
   if (m_DrawMemTracker && !m_DrawHelp) {
     RenderMemTracker();
   }
 
+  if (m_DrawRenderStats) {
+    RenderStatsUi();
+  }
+
   // Rendering
   glViewport(0, 0, getWidth(), getHeight());
   ImGui::Render();
@@ -869,6 +1070,9 @@ void CaptureWindow::RenderUI() {
 //-----------------------------------------------------------------------------
 void CaptureWindow::RenderText() {
   if (!m_Picking) {
+    // Those of the canvas were displayed before.
+    m_TimeGraph.GetRenderStats().AddNumGlyphs(
+        m_TextRenderer.GetNumCharacters());
     m_TimeGraph.DrawText();
   }
 }
@@ -902,6 +1106,13 @@ void CaptureWindow::RenderHelpUi() {
   ImGui::Text("Time zoom: scroll or CTRL+right-click/drag");
   ImGui::Text("Y axis zoom: CTRL+scroll");
   ImGui::Text("Zoom last 2 seconds: 'A'");
+  ImGui::Text("Draw timers on the GPU: 'G'");
+  ImGui::Text("Zoom on the next longest frame: 'N'");
+  ImGui::Text("Critical path of the selected timer or frame: 'R'");
+  ImGui::Text("Send the flight recorder window of the service: 'T'");
+  ImGui::Text("Previous/next call of the selected function: CTRL+left/right");
+  ImGui::Text("Render stats of this view: 'U'");
+  ImGui::Text("Overview of the whole capture, click to jump: 'V'");
   ImGui::Separator();
   ImGui::Text("Icons:");
 
@@ -969,6 +1180,48 @@ void CaptureWindow::RenderThreadFilterUi() {
   ImGui::PopStyleColor();
 }
 
+//-----------------------------------------------------------------------------
+void CaptureWindow::RenderStatsUi() {
+  float barHeight = m_Slider.GetPixelHeight();
+  ImGui::SetNextWindowPos(ImVec2(0, barHeight * 1.5f),
+                          ImGuiCond_FirstUseEver);
+
+  if (!ImGui::Begin("Render Stats", &m_DrawRenderStats, ImVec2(0, 0), 0.8f,
+                    ImGuiWindowFlags_NoSavedSettings |
+                        ImGuiWindowFlags_AlwaysAutoResize)) {
+    ImGui::End();
+    return;
+  }
+
+  // Of the previous frame, as this one is still being drawn.
+  const RenderStats& stats = m_TimeGraph.GetRenderStats();
+  const RenderStats::Frame& frame = stats.GetLastFrame();
+  double totalMillis = 0;
+  ImGui::Text("%-26s %8s %8s", "", "ms", "max ms");
+  for (int i = 0; i < RenderStats::NUM_SECTIONS; ++i) {
+    auto section = static_cast<RenderStats::Section>(i);
+    ImGui::Text("%-26s %8.3f %8.3f", RenderStats::GetName(section),
+                frame.m_Millis[i], stats.GetMaxMillis(section));
+    if (section != RenderStats::UPDATE_PRIMITIVES_WORKERS) {
+      totalMillis += frame.m_Millis[i];
+    }
+  }
+  ImGui::Text("%-26s %8.3f", "Total on this thread", totalMillis);
+  ImGui::Separator();
+  ImGui::Text("Boxes: %llu", (unsigned long long)frame.m_NumBoxes);
+  ImGui::Text("Lines: %llu", (unsigned long long)frame.m_NumLines);
+  ImGui::Text("Glyphs: %llu", (unsigned long long)frame.m_NumGlyphs);
+  ImGui::Text("Text boxes: %d", m_TimeGraph.GetNumDrawnTextBoxes());
+  ImGui::Text("Uploaded: %s", GetPrettySize(frame.m_NumBytesUploaded).c_str());
+  if (GTimerManager != nullptr) {
+    ImGui::Text("Queued entries: %d",
+                GTimerManager->m_NumQueuedEntries.load());
+    ImGui::Text("Queued timers: %d", GTimerManager->m_NumQueuedTimers.load());
+  }
+
+  ImGui::End();
+}
+
 //-----------------------------------------------------------------------------
 void CaptureWindow::RenderMemTracker() {
   float barHeight = m_Slider.GetPixelHeight();
@@ -1001,6 +1254,34 @@ void CaptureWindow::RenderMemTracker() {
     ImGui::Text("%s", VAR_TO_ANSI(memTracker.NumAllocatedBytes()));
     ImGui::Text("%s", VAR_TO_ANSI(memTracker.NumFreedBytes()));
     ImGui::Text("%s", VAR_TO_ANSI(memTracker.NumLiveBytes()));
+    ImGui::Text("%s", VAR_TO_ANSI(memTracker.NumLiveAllocs()));
+
+    // Live bytes over the capture, the peak of each of a bounded number of
+    // buckets.
+    const std::vector<LiveBytesSample>& timeline =
+        memTracker.GetLiveBytesTimeline();
+    const size_t kMaxPlotPoints = 512;
+    size_t samplesPerPoint = timeline.size() / kMaxPlotPoints + 1;
+    std::vector<float> liveBytes;
+    for (size_t i = 0; i < timeline.size(); i += samplesPerPoint) {
+      DWORD64 peak = 0;
+      for (size_t j = i; j < std::min(i + samplesPerPoint, timeline.size());
+           ++j) {
+        peak = std::max(peak, timeline[j].m_NumLiveBytes);
+      }
+      liveBytes.push_back((float)peak);
+    }
+    if (!liveBytes.empty()) {
+      ImGui::PlotLines("Live bytes", liveBytes.data(), (int)liveBytes.size(),
+                       0, nullptr, 0.f, FLT_MAX, ImVec2(0, 60));
+    }
+
+    for (const AllocationSite& site : memTracker.GetTopSites(5)) {
+      ImGui::Text("Callstack %llu: %llu live bytes in %llu allocations",
+                  (unsigned long long)site.m_CallstackId,
+                  (unsigned long long)site.m_NumLiveBytes,
+                  (unsigned long long)site.m_NumLiveAllocs);
+    }
   }
 
   ImGui::End();
@@ -1143,6 +1424,12 @@ void CaptureWindow::OnContextSwitchAdded(const ContextSwitch& a_CS) {
   m_TimeGraph.AddContextSwitch(a_CS);
 }
 
+//-----------------------------------------------------------------------------
+void CaptureWindow::OnThreadStateChangeAdded(
+    const ThreadStateChange& thread_state_change) {
+  m_TimeGraph.AddThreadStateChange(thread_state_change);
+}
+
 //-----------------------------------------------------------------------------
 void CaptureWindow::SendProcess() {
   if (Capture::GTargetProcess) {
@@ -3,10 +3,14 @@
 //-----------------------------------
 #pragma once
 
+#include <optional>
+#include <vector>
+
 #include "GlCanvas.h"
 #include "GlSlider.h"
 
 struct ContextSwitch;
+struct ThreadStateChange;
 
 class CaptureWindow : public GlCanvas {
  public:
@@ -47,12 +51,17 @@ class CaptureWindow : public GlCanvas {
   void RenderHelpUi();
   void RenderThreadFilterUi();
   void RenderMemTracker();
+  void RenderStatsUi();
   void RenderBar();
   void RenderTimeBar();
+  // The minimap of the whole capture under the top bar, see CaptureOverview.
+  void DrawOverview();
+  float GetOverviewPixelHeight();
   void OnTimerAdded(Timer& a_Timer);
   void OnContextSwitchAdded(const ContextSwitch& a_CS);
+  void OnThreadStateChangeAdded(const ThreadStateChange& thread_state_change);
   void ResetHoverTimer();
-  void SelectTextBox(class TextBox* a_TextBox);
+  void SelectTimer(const CompactTimer* a_Timer);
   void OnDrag(float a_Ratio);
   void OnVerticalDrag(float a_Ratio);
   void NeedsUpdate();
@@ -65,19 +74,36 @@ class CaptureWindow : public GlCanvas {
   void SendProcess();
 
  private:
+  // Calls of the function of the selected timer in the selected time range,
+  // kept until the selection changes.
+  const std::string& GetSelectionCallsText(TickType a_MinTime,
+                                           TickType a_MaxTime);
+
   TimeGraph m_TimeGraph;
   OutputWindow m_StatsWindow;
+  // The critical path of the selected timer, or else of the last frame
+  // clicked, computed with 'R'. Closing its window clears it.
+  OutputWindow m_CriticalPathWindow;
+  bool m_DrawCriticalPath = false;
+  std::optional<size_t> m_SelectedFrame;
   Timer m_HoverTimer;
   std::wstring m_ToolTip;
   int m_HoverDelayMs;
-  bool m_IsHovering;
   bool m_CanHover;
   bool m_DrawHelp;
   bool m_DrawFilter;
   bool m_DrawMemTracker;
   bool m_FirstHelpDraw;
   bool m_DrawStats;
+  bool m_DrawRenderStats = false;
+  bool m_DrawOverview = false;
+  std::vector<Vec3> m_OverviewVertices;
+  std::vector<Color> m_OverviewColors;
   GlSlider m_Slider;
   GlSlider m_VerticalSlider;
   int m_ProcessX;
+  uint64_t m_SelectionCallsFunction = 0;
+  TickType m_SelectionCallsMinTime = 0;
+  TickType m_SelectionCallsMaxTime = 0;
+  std::string m_SelectionCallsText;
 };
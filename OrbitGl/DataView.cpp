@@ -13,14 +13,17 @@
 #include "GlobalDataView.h"
 #include "LiveFunctionDataView.h"
 #include "Log.h"
+#include "LockContentionDataView.h"
 #include "LogDataView.h"
 #include "ModuleDataView.h"
 #include "OrbitType.h"
 #include "Params.h"
 #include "Pdb.h"
 #include "ProcessDataView.h"
+#include "SamplingDiffDataView.h"
 #include "SamplingReportDataView.h"
 #include "SessionsDataView.h"
+#include "TimerDiffDataView.h"
 #include "TypeDataView.h"
 
 //-----------------------------------------------------------------------------
@@ -30,6 +33,30 @@ DataView::~DataView() {
   }
 }
 
+//-----------------------------------------------------------------------------
+const std::vector<uint64_t>& DataView::GetCachedSortKeys(
+    int a_Column, size_t a_NumElements,
+    const std::function<std::vector<uint64_t>()>& a_GetKeys) {
+  if (a_Column >= (int)m_CachedSortKeys.size()) {
+    m_CachedSortKeys.resize(a_Column + 1);
+  }
+  std::vector<uint64_t>& keys = m_CachedSortKeys[a_Column];
+  if (keys.size() != a_NumElements) {
+    keys = a_GetKeys();
+  }
+  return keys;
+}
+
+//-----------------------------------------------------------------------------
+void DataView::SortIndices(const std::vector<uint64_t>& a_Keys,
+                           bool a_Ascending, bool a_Incremental) {
+  if (a_Incremental) {
+    ResortByKeys(a_Keys, a_Ascending, &m_Indices);
+  } else {
+    SortByKeys(a_Keys, a_Ascending, &m_Indices);
+  }
+}
+
 //-----------------------------------------------------------------------------
 DataView* DataView::Create(DataViewType a_Type) {
   DataView* model = nullptr;
@@ -64,6 +91,15 @@ DataView* DataView::Create(DataViewType a_Type) {
     case DataViewType::LOG:
       model = new LogDataView();
       break;
+    case DataViewType::SAMPLING_DIFF:
+      model = new SamplingDiffDataView();
+      break;
+    case DataViewType::LOCK_CONTENTION:
+      model = new LockContentionDataView();
+      break;
+    case DataViewType::TIMER_DIFF:
+      model = new TimerDiffDataView();
+      break;
     default:
       break;
   }
@@ -3,10 +3,13 @@
 //-----------------------------------
 #pragma once
 
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "DataViewTypes.h"
+#include "SortKeys.h"
 
 //-----------------------------------------------------------------------------
 class DataView {
@@ -42,6 +45,8 @@ class DataView {
   virtual void OnSelect(int /*a_Index*/) {}
   virtual int GetSelectedIndex() { return m_SelectedIndex; }
   virtual void OnDataChanged() {}
+  // Called when the view becomes visible, to load what it shows on demand.
+  virtual void OnShown() {}
   virtual void OnTimer() {}
   virtual bool WantsDisplayColor() { return false; }
   virtual bool GetDisplayColor(int /*a_Row*/, int /*a_Column*/,
@@ -65,6 +70,38 @@ class DataView {
   DataViewType GetType() const { return m_Type; }
 
  protected:
+  // Sort keys of a_Elements, a_Key(element) for each, as uint64_t ordered
+  // like the values (see SortKeys.h).
+  template <class T, class KeyFunc>
+  static std::vector<uint64_t> GetSortKeys(const std::vector<T>& a_Elements,
+                                           KeyFunc&& a_Key) {
+    std::vector<uint64_t> keys(a_Elements.size());
+    for (size_t i = 0; i < a_Elements.size(); ++i) {
+      keys[i] = a_Key(a_Elements[i]);
+    }
+    return keys;
+  }
+  // Same for a_String(element), a string, ranked.
+  template <class T, class StringFunc>
+  static std::vector<uint64_t> GetStringSortKeys(
+      const std::vector<T>& a_Elements, StringFunc&& a_String) {
+    std::vector<std::string_view> strings(a_Elements.size());
+    for (size_t i = 0; i < a_Elements.size(); ++i) {
+      strings[i] = a_String(a_Elements[i]);
+    }
+    return RankStrings(strings);
+  }
+  // Sort keys of a_Column cached until ClearCachedSortKeys or a change of the
+  // number of elements, for the columns whose values don't change.
+  const std::vector<uint64_t>& GetCachedSortKeys(
+      int a_Column, size_t a_NumElements,
+      const std::function<std::vector<uint64_t>()>& a_GetKeys);
+  void ClearCachedSortKeys() { m_CachedSortKeys.clear(); }
+  // Sorts m_Indices by a_Keys[index]. An incremental sort patches the
+  // previous order, for keys of which few changed since it was sorted.
+  void SortIndices(const std::vector<uint64_t>& a_Keys, bool a_Ascending,
+                   bool a_Incremental = false);
+
   std::vector<uint32_t> m_Indices;
   std::vector<bool> m_SortingToggles;
   int m_LastSortedColumn;
@@ -72,4 +109,7 @@ class DataView {
   int m_UpdatePeriodMs;
   int m_SelectedIndex;
   DataViewType m_Type;
+
+ private:
+  std::vector<std::vector<uint64_t>> m_CachedSortKeys;
 };
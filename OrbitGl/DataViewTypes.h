@@ -16,6 +16,9 @@ enum DataViewType {
   PDB,
   SESSIONS,
   LOG,
+  SAMPLING_DIFF,
+  LOCK_CONTENTION,
+  TIMER_DIFF,
   ALL,
   INVALID
 };
\ No newline at end of file
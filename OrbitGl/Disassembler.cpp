@@ -7,6 +7,14 @@
 #include <capstone/capstone.h>
 #include <capstone/platform.h>
 
+#include <deque>
+#include <memory>
+#include <tuple>
+
+#include "Threading.h"
+#include "absl/hash/hash.h"
+#include "absl/strings/string_view.h"
+
 #define LOGF(format, ...)                                   \
   {                                                         \
     std::string log = absl::StrFormat(format, __VA_ARGS__); \
@@ -16,6 +24,57 @@
 #define LOG(str) \
   { m_String += s2ws(str); }
 
+namespace {
+using Instructions = std::vector<Disassembler::Instruction>;
+
+// Instructions of the code disassembled last, by address, mode and content,
+// as the same functions tend to be disassembled again.
+class InstructionCache {
+ public:
+  using Key = std::tuple<uint64_t, bool, size_t, size_t>;
+
+  static Key MakeKey(const unsigned char* a_Code, size_t a_Size,
+                     uint64_t a_Address, bool a_Is64Bit) {
+    absl::string_view code(reinterpret_cast<const char*>(a_Code), a_Size);
+    return Key(a_Address, a_Is64Bit, a_Size,
+               absl::Hash<absl::string_view>()(code));
+  }
+
+  std::shared_ptr<const Instructions> Find(const Key& a_Key) {
+    ScopeLock lock(m_Mutex);
+    auto it = m_Instructions.find(a_Key);
+    return it != m_Instructions.end() ? it->second : nullptr;
+  }
+
+  void Insert(const Key& a_Key,
+              std::shared_ptr<const Instructions> a_Instructions) {
+    ScopeLock lock(m_Mutex);
+    if (!m_Instructions.emplace(a_Key, std::move(a_Instructions)).second) {
+      return;
+    }
+    m_Keys.push_back(a_Key);
+    if (m_Keys.size() > kMaxEntries) {
+      m_Instructions.erase(m_Keys.front());
+      m_Keys.pop_front();
+    }
+  }
+
+ private:
+  static constexpr size_t kMaxEntries = 64;
+
+  Mutex m_Mutex;
+  absl::flat_hash_map<Key, std::shared_ptr<const Instructions>>
+      m_Instructions;
+  // Oldest first.
+  std::deque<Key> m_Keys;
+};
+
+InstructionCache& GetInstructionCache() {
+  static InstructionCache cache;
+  return cache;
+}
+}  // namespace
+
 //-----------------------------------------------------------------------------
 void Disassembler::LogHex(const unsigned char* str, size_t len) {
   const unsigned char* c;
@@ -27,54 +86,146 @@ void Disassembler::LogHex(const unsigned char* str, size_t len) {
   LOGF("%s", "\n");
 }
 
+//-----------------------------------------------------------------------------
+void Disassembler::SetHitCounts(
+    absl::flat_hash_map<uint64_t, unsigned int> a_HitCounts) {
+  m_HitCounts = std::move(a_HitCounts);
+  m_TotalHits = 0;
+  for (const auto& pair : m_HitCounts) {
+    m_TotalHits += pair.second;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void Disassembler::SetBranchCounts(
+    absl::flat_hash_map<uint64_t, uint64_t> a_TakenCounts,
+    BranchProfile::ExecutionCounts a_ExecutionCounts) {
+  m_TakenCounts = std::move(a_TakenCounts);
+  m_ExecutionCounts = std::move(a_ExecutionCounts);
+}
+
+//-----------------------------------------------------------------------------
+void Disassembler::SetChunkCallback(
+    std::function<void(const std::wstring&)> a_Callback) {
+  m_ChunkCallback = std::move(a_Callback);
+}
+
+//-----------------------------------------------------------------------------
+void Disassembler::SetCancelCallback(std::function<bool()> a_IsCancelled) {
+  m_IsCancelled = std::move(a_IsCancelled);
+}
+
+//-----------------------------------------------------------------------------
+bool Disassembler::LogChunk(const Instructions& a_Instructions, size_t a_First,
+                            size_t a_Last) {
+  for (size_t i = a_First; i < a_Last; ++i) {
+    const Instruction& instruction = a_Instructions[i];
+    if (m_TotalHits > 0) {
+      auto it = m_HitCounts.find(instruction.m_Address);
+      if (it != m_HitCounts.end()) {
+        LOGF("%6u %5.1f%%  ", it->second,
+             100.0 * it->second / m_TotalHits);
+      } else {
+        LOG("               ");
+      }
+    }
+    if (m_ExecutionCounts.GetMax() > 0) {
+      LOGF("%5.1f%%  ", 100.0 * m_ExecutionCounts.Get(instruction.m_Address) /
+                            m_ExecutionCounts.GetMax());
+    }
+    LOGF("0x%" PRIx64 ":\t%-12s %s", instruction.m_Address,
+         instruction.m_Mnemonic, instruction.m_Operands);
+    auto taken = m_TakenCounts.find(instruction.m_Address);
+    if (taken != m_TakenCounts.end()) {
+      LOGF("    ; taken %u", taken->second);
+    }
+    LOG("\n");
+  }
+
+  FlushChunk();
+  return !m_IsCancelled || !m_IsCancelled();
+}
+
+//-----------------------------------------------------------------------------
+void Disassembler::FlushChunk() {
+  if (m_ChunkCallback && m_NumFlushed < m_String.size()) {
+    m_ChunkCallback(m_String.substr(m_NumFlushed));
+    m_NumFlushed = m_String.size();
+  }
+}
+
 //-----------------------------------------------------------------------------
 void Disassembler::Disassemble(const unsigned char* a_MachineCode,
                                size_t a_Size, DWORD64 a_Address,
                                bool a_Is64Bit) {
-  std::wstring disAsm;
-  csh handle = 0;
-  cs_arch arch = CS_ARCH_X86;
-  cs_insn* insn = nullptr;
-  size_t count = 0;
-  cs_err err;
-  cs_mode mode = a_Is64Bit ? CS_MODE_64 : CS_MODE_32;
-
   LOG("\n");
   LOGF("Platform: %s\n",
        a_Is64Bit ? "X86 64 (Intel syntax)" : "X86 32 (Intel syntax)");
-  err = cs_open(arch, mode, &handle);
-  if (err) {
-    LOGF("Failed on cs_open() with error returned: %u\n", err);
-    return;
+  if (m_TotalHits > 0) {
+    LOGF("Samples: %u\n\n", m_TotalHits);
+  }
+  if (!m_TakenCounts.empty() || m_ExecutionCounts.GetMax() > 0) {
+    LOG("Branch samples: executions relative to the hottest instruction, "
+        "and times taken\n\n");
   }
 
-  count = cs_disasm(handle, a_MachineCode, a_Size, a_Address, 0, &insn);
-
-  if (count) {
-    size_t j;
-
-    for (j = 0; j < count; j++) {
-      LOGF("0x%" PRIx64 ":\t%-12s %s\n", insn[j].address, insn[j].mnemonic,
-           insn[j].op_str);
+  InstructionCache::Key key =
+      InstructionCache::MakeKey(a_MachineCode, a_Size, a_Address, a_Is64Bit);
+  std::shared_ptr<const Instructions> instructions =
+      GetInstructionCache().Find(key);
+  if (instructions != nullptr) {
+    for (size_t first = 0; first < instructions->size();
+         first += kInstructionsPerChunk) {
+      size_t last =
+          std::min(first + kInstructionsPerChunk, instructions->size());
+      if (!LogChunk(*instructions, first, last)) return;
+    }
+  } else {
+    csh handle = 0;
+    cs_mode mode = a_Is64Bit ? CS_MODE_64 : CS_MODE_32;
+    cs_err err = cs_open(CS_ARCH_X86, mode, &handle);
+    if (err) {
+      LOGF("Failed on cs_open() with error returned: %u\n", err);
+      FlushChunk();
+      return;
+    }
 
-      /*std::string log = Format("0x%" PRIx64 ":\t%-12s %s\n"
-          , insn[j].address
-          , insn[j].mnemonic
-          , insn[j].op_str);
-      OutputDebugStringA(log.c_str());*/
+    // Decoded one instruction at a time, so that the first chunks are shown
+    // before the whole function is decoded.
+    auto decoded = std::make_shared<Instructions>();
+    cs_insn* insn = cs_malloc(handle);
+    const uint8_t* code = a_MachineCode;
+    size_t size = a_Size;
+    uint64_t address = a_Address;
+    bool cancelled = false;
+    while (!cancelled && cs_disasm_iter(handle, &code, &size, &address, insn)) {
+      decoded->push_back(
+          Instruction{insn->address, insn->size, insn->mnemonic, insn->op_str});
+      if (decoded->size() % kInstructionsPerChunk == 0) {
+        cancelled = !LogChunk(*decoded, decoded->size() - kInstructionsPerChunk,
+                              decoded->size());
+      }
     }
+    cs_free(insn, 1);
+    cs_close(&handle);
+    if (cancelled) return;
+
+    size_t numDecoded = decoded->size();
+    LogChunk(*decoded, numDecoded - numDecoded % kInstructionsPerChunk,
+             numDecoded);
+    GetInstructionCache().Insert(key, decoded);
+    instructions = std::move(decoded);
+  }
 
+  if (!instructions->empty()) {
     // print out the next offset, after the last insn
-    LOGF("0x%" PRIx64 ":\n", insn[j - 1].address + insn[j - 1].size);
-
-    // free memory allocated by cs_disasm()
-    cs_free(insn, count);
+    const Instruction& last = instructions->back();
+    LOGF("0x%" PRIx64 ":\n", last.m_Address + last.m_Size);
   } else {
     LOG("****************\n");
     LOG("ERROR: Failed to disasm given code!\n");
   }
 
   LOG("\n");
-
-  cs_close(&handle);
+  FlushChunk();
 }
@@ -3,23 +3,72 @@
 //-----------------------------------
 #pragma once
 
+#include <functional>
 #include <string>
+#include <vector>
 
 #include "BaseTypes.h"
+#include "BranchProfile.h"
 #include "Utils.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/str_format.h"
 
 //-----------------------------------------------------------------------------
 class Disassembler {
  public:
+  struct Instruction {
+    uint64_t m_Address;
+    uint32_t m_Size;
+    std::string m_Mnemonic;
+    std::string m_Operands;
+  };
+
+  // Instructions are decoded a chunk at a time, see SetChunkCallback. The
+  // instructions of code disassembled before are reused from a cache.
+  static constexpr size_t kInstructionsPerChunk = 512;
+
   void Disassemble(const unsigned char* a_MachineCode, size_t a_Size,
                    DWORD64 a_Address, bool a_Is64Bit);
   const std::wstring& GetResult() { return m_String; }
 
+  // Samples by exact instruction address, e.g. from
+  // SamplingProfiler::GetExactAddressCounts: each instruction is prefixed
+  // with its samples and their share of those of the code.
+  void SetHitCounts(absl::flat_hash_map<uint64_t, unsigned int> a_HitCounts);
+  // Branches sampled in the code, see BranchProfile: each instruction is
+  // prefixed with how often it ran relative to the hottest one, if known, and
+  // each branch is followed by how often it was taken.
+  void SetBranchCounts(absl::flat_hash_map<uint64_t, uint64_t> a_TakenCounts,
+                       BranchProfile::ExecutionCounts a_ExecutionCounts);
+  // Called by Disassemble with the text added since the previous call, after
+  // each chunk of instructions and at the end, so that the disassembly of a
+  // large function can be shown as it progresses.
+  void SetChunkCallback(std::function<void(const std::wstring&)> a_Callback);
+  // Checked by Disassemble between chunks, which returns early once it is
+  // true. The instructions of a cancelled disassembly are not cached.
+  void SetCancelCallback(std::function<bool()> a_IsCancelled);
+
   void LOGF(const std::string& format) { m_String += s2ws(format); }
 
   void LogHex(const unsigned char* str, size_t len);
 
+ protected:
+  // Logs the instructions [a_First, a_Last) and sends the text to the chunk
+  // callback. Returns false if the disassembly was cancelled.
+  bool LogChunk(const std::vector<Instruction>& a_Instructions, size_t a_First,
+                size_t a_Last);
+  void FlushChunk();
+
  public:
   std::wstring m_String;
+
+ protected:
+  absl::flat_hash_map<uint64_t, unsigned int> m_HitCounts;
+  uint64_t m_TotalHits = 0;
+  absl::flat_hash_map<uint64_t, uint64_t> m_TakenCounts;
+  BranchProfile::ExecutionCounts m_ExecutionCounts;
+  std::function<void(const std::wstring&)> m_ChunkCallback;
+  std::function<bool()> m_IsCancelled;
+  // Size of m_String sent to the chunk callback so far.
+  size_t m_NumFlushed = 0;
 };
@@ -0,0 +1,382 @@
+#include "FlameGraphWindow.h"
+
+#include <algorithm>
+
+#include "App.h"
+#include "Capture.h"
+#include "SamplingProfiler.h"
+#include "SamplingReport.h"
+#include "absl/strings/str_format.h"
+
+namespace {
+const std::wstring kResetZoom = L"Reset Zoom";
+const std::wstring kToggleIcicle = L"Toggle Icicle Graph";
+const std::wstring kGoToSource = L"Go to Source";
+}  // namespace
+
+//-----------------------------------------------------------------------------
+FlameGraphWindow::FlameGraphWindow() {
+  m_DrawUI = false;
+  m_WorldTopLeftX = 0;
+  m_WorldTopLeftY = 0;
+  m_LiveUpdateTimer.Start();
+}
+
+//-----------------------------------------------------------------------------
+FlameGraphWindow::~FlameGraphWindow() {}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::PreRender() { UpdateCallTree(); }
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::UpdateCallTree() {
+  std::shared_ptr<SamplingProfiler> profiler = Capture::GSamplingProfiler;
+  if (profiler != m_Profiler) {
+    m_Profiler = profiler;
+    m_IsLive = false;
+    SetCallTree(nullptr, /*a_SameNodes=*/false);
+  }
+  if (profiler == nullptr) {
+    return;
+  }
+
+  switch (profiler->GetState()) {
+    case SamplingProfiler::Sampling:
+      if (m_LiveUpdateTimer.QueryMillis() <
+          SamplingReport::kLiveUpdatePeriodMs) {
+        break;
+      }
+      m_LiveUpdateTimer.Start();
+      // Live trees only ever get new nodes, so that zoom and names are kept.
+      SetCallTree(profiler->GetLiveCallTree(0), /*a_SameNodes=*/m_IsLive);
+      m_IsLive = true;
+      break;
+    case SamplingProfiler::DoneProcessing:
+      if (m_IsLive || m_CallTree == nullptr) {
+        SetCallTree(profiler->GetCallTree(0), /*a_SameNodes=*/false);
+        m_IsLive = false;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::SetCallTree(std::shared_ptr<SampledCallTree> a_CallTree,
+                                   bool a_SameNodes) {
+  m_CallTree = std::move(a_CallTree);
+  if (!a_SameNodes) {
+    m_Focus = CallstackTree::kRootId;
+    m_ScrollY = 0.f;
+    m_FrameNames.clear();
+  }
+  m_NeedsLayout = true;
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::SetFocus(CallstackTree::NodeId a_Focus) {
+  if (a_Focus != m_Focus) {
+    m_Focus = a_Focus;
+    m_NeedsLayout = true;
+    NeedsRedraw();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::SetIcicle(bool a_Icicle) {
+  if (a_Icicle != m_Icicle) {
+    m_Icicle = a_Icicle;
+    m_ScrollY = 0.f;
+    m_NeedsLayout = true;
+    NeedsRedraw();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::Resize(int a_Width, int a_Height) {
+  GlCanvas::Resize(a_Width, a_Height);
+  // World units are pixels, from the bottom left corner.
+  m_DesiredWorldWidth = (float)a_Width;
+  m_DesiredWorldHeight = (float)a_Height;
+  m_WorldTopLeftX = 0.f;
+  m_WorldTopLeftY = (float)a_Height;
+  m_NeedsLayout = true;
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::UpdateLayout() {
+  m_NeedsLayout = false;
+  m_HoveredFrame = nullptr;
+  m_Frames.clear();
+  if (m_CallTree != nullptr) {
+    m_Frames = LayoutFlameGraph(m_CallTree->m_Tree,
+                                m_CallTree->m_InclusiveCounts, m_Focus,
+                                (float)getWidth(), kMinFrameWidth);
+    m_FrameNames.resize(m_CallTree->m_Tree.size());
+  }
+  UpdatePrimitives();
+}
+
+//-----------------------------------------------------------------------------
+float FlameGraphWindow::GetFrameY(uint32_t a_Depth) const {
+  // The root is the bottom row of a flame graph, and the top row of an icicle
+  // graph.
+  float y = (float)a_Depth * kFrameHeight + m_ScrollY;
+  return m_Icicle ? (float)getHeight() - y - kFrameHeight : y;
+}
+
+//-----------------------------------------------------------------------------
+Color FlameGraphWindow::GetFrameColor(const FlameGraphFrame& a_Frame) const {
+  if (a_Frame.node == CallstackTree::kInvalidId) {
+    return Color(128, 128, 128, 255);
+  }
+  if (a_Frame.node == CallstackTree::kRootId) {
+    return Color(100, 100, 100, 255);
+  }
+
+  // Warm colors, stable per function.
+  uint64_t hash = m_CallTree->m_Tree.GetAddress(a_Frame.node) *
+                  0x9E3779B97F4A7C15ull;
+  auto red = (unsigned char)(205 + (hash >> 56) % 50);
+  auto green = (unsigned char)((hash >> 40) % 200);
+  auto blue = (unsigned char)((hash >> 24) % 55);
+  return Color(red, green, blue, 255);
+}
+
+//-----------------------------------------------------------------------------
+const std::string& FlameGraphWindow::GetFrameName(
+    const FlameGraphFrame& a_Frame) {
+  static const std::string kRootName = "all";
+  static const std::string kMergedName = "...";
+  if (a_Frame.node == CallstackTree::kRootId) {
+    return kRootName;
+  }
+  if (a_Frame.node == CallstackTree::kInvalidId || m_Profiler == nullptr) {
+    return kMergedName;
+  }
+
+  std::string& name = m_FrameNames[a_Frame.node];
+  if (name.empty()) {
+    name = ws2s(m_Profiler->GetSymbolFromAddress(
+        m_CallTree->m_Tree.GetAddress(a_Frame.node)));
+  }
+  return name;
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::UpdatePrimitives() {
+  m_Batcher.Reset();
+  float z = GlCanvas::Z_VALUE_BOX_ACTIVE;
+  for (FlameGraphFrame& frame : m_Frames) {
+    float y = GetFrameY(frame.depth);
+    if (y + kFrameHeight < 0.f || y > (float)getHeight()) {
+      continue;
+    }
+
+    // A pixel of the frame's right and top edges is left for separation.
+    float width = std::max(frame.width - 1.f, 1.f);
+    float height = kFrameHeight - 1.f;
+    Box box;
+    box.m_Vertices[0] = Vec3(frame.x, y, z);
+    box.m_Vertices[1] = Vec3(frame.x, y + height, z);
+    box.m_Vertices[2] = Vec3(frame.x + width, y + height, z);
+    box.m_Vertices[3] = Vec3(frame.x + width, y, z);
+    Color colors[4];
+    Color color = GetFrameColor(frame);
+    Fill(colors, color);
+    m_Batcher.AddBox(box, colors, PickingID::BOX, &frame);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::Draw() {
+  if (m_NeedsLayout) {
+    UpdateLayout();
+  }
+
+  glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT);
+  glDisable(GL_CULL_FACE);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  DrawBoxBuffer(m_Picking);
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glPopAttrib();
+
+  if (m_Picking) {
+    return;
+  }
+
+  // Only frames wide enough for a few characters are labeled.
+  static Color s_TextColor(0, 0, 0, 255);
+  for (const FlameGraphFrame& frame : m_Frames) {
+    float y = GetFrameY(frame.depth);
+    if (frame.width < kMinLabelWidth || y + kFrameHeight < 0.f ||
+        y > (float)getHeight()) {
+      continue;
+    }
+    m_TextRenderer.AddText(GetFrameName(frame).c_str(), frame.x + 2.f,
+                           y + 5.f, GlCanvas::Z_VALUE_TEXT, s_TextColor,
+                           frame.width - 4.f);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::DrawBoxBuffer(bool a_Picking) {
+  Block<Box, BoxBuffer::NUM_BOXES_PER_BLOCK>* boxBlock =
+      m_Batcher.GetBoxBuffer().m_Boxes.m_Root;
+  Block<Color, BoxBuffer::NUM_BOXES_PER_BLOCK * 4>* colorBlock;
+
+  colorBlock = !a_Picking ? m_Batcher.GetBoxBuffer().m_Colors.m_Root
+                          : m_Batcher.GetBoxBuffer().m_PickingColors.m_Root;
+
+  while (boxBlock) {
+    if (int numElems = boxBlock->m_Size) {
+      glVertexPointer(3, GL_FLOAT, sizeof(Vec3), boxBlock->m_Data);
+      glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Color),
+                     (void*)(colorBlock->m_Data));
+      glDrawArrays(GL_QUADS, 0, numElems * 4);
+    }
+
+    boxBlock = boxBlock->m_Next;
+    colorBlock = colorBlock->m_Next;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::DrawScreenSpace() {
+  if (m_Picking) {
+    return;
+  }
+
+  static Color s_TextColor(255, 255, 255, 255);
+  std::string status;
+  if (m_CallTree == nullptr || m_Frames.empty()) {
+    status = "No samples";
+  } else if (m_HoveredFrame != nullptr) {
+    uint64_t numSamples =
+        m_CallTree->m_InclusiveCounts[CallstackTree::kRootId];
+    status = absl::StrFormat(
+        "%s: %u samples (%.2f%%)", GetFrameName(*m_HoveredFrame),
+        m_HoveredFrame->count,
+        100.f * (float)m_HoveredFrame->count / (float)numSamples);
+  } else if (m_IsLive) {
+    status = "Sampling...";
+  }
+
+  if (!status.empty()) {
+    int y = m_Icicle ? getHeight() - 5 : 20;
+    AddText2D(status.c_str(), 5, y, GlCanvas::Z_VALUE_TEXT_UI, s_TextColor);
+  }
+}
+
+//-----------------------------------------------------------------------------
+const FlameGraphFrame* FlameGraphWindow::Pick(int a_X, int a_Y) {
+  // 4 bytes per pixel (RGBA), 1x1 bitmap
+  std::vector<unsigned char> pixels(1 * 1 * 4);
+  glReadPixels(a_X, m_MainWindowHeight - a_Y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+               &pixels[0]);
+
+  PickingID pickId = PickingID::Get(*((uint32_t*)(&pixels[0])));
+  if (pickId.m_Type != PickingID::BOX) {
+    return nullptr;
+  }
+  void** framePtr = m_Batcher.GetBoxBuffer().m_UserData.SlowAt(pickId.m_Id);
+  return framePtr ? static_cast<const FlameGraphFrame*>(*framePtr) : nullptr;
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::PostRender() {
+  if (!m_Picking) {
+    return;
+  }
+
+  const FlameGraphFrame* frame = m_IsHovering
+                                     ? Pick(m_MousePosX, m_MousePosY)
+                                     : Pick(m_ScreenClickX, m_ScreenClickY);
+  if (m_IsHovering) {
+    m_IsHovering = false;
+    m_HoveredFrame = frame;
+  } else if (frame != nullptr && frame->node != CallstackTree::kInvalidId) {
+    SetFocus(frame->node);
+  }
+
+  m_Picking = false;
+  NeedsRedraw();
+  GlCanvas::Render(m_Width, m_Height);
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::MouseMoved(int a_X, int a_Y, bool /*a_Left*/,
+                                  bool /*a_Right*/, bool /*a_Middle*/) {
+  m_MousePosX = a_X;
+  m_MousePosY = a_Y;
+  m_IsHovering = true;
+  m_Picking = true;
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::LeftDown(int a_X, int a_Y) {
+  m_ScreenClickX = a_X;
+  m_ScreenClickY = a_Y;
+  m_IsHovering = false;
+  m_Picking = true;
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::LeftUp() { NeedsRedraw(); }
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::MouseWheelMoved(int /*a_X*/, int /*a_Y*/, int a_Delta,
+                                       bool /*a_Ctrl*/) {
+  if (a_Delta == 0) {
+    return;
+  }
+
+  // Scrolls through the deep stacks, one frame at a time.
+  float delta = a_Delta > 0 ? -kFrameHeight : kFrameHeight;
+  m_ScrollY = std::min(0.f, m_ScrollY + (m_Icicle ? -delta : delta));
+  UpdatePrimitives();
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::KeyPressed(unsigned int a_KeyCode, bool /*a_Ctrl*/,
+                                  bool /*a_Shift*/, bool /*a_Alt*/) {
+  switch (a_KeyCode) {
+    case 'A':
+      SetFocus(CallstackTree::kRootId);
+      break;
+    case 'I':
+      SetIcicle(!m_Icicle);
+      break;
+  }
+}
+
+//-----------------------------------------------------------------------------
+std::vector<std::wstring> FlameGraphWindow::GetContextMenu() {
+  std::vector<std::wstring> menu = {kResetZoom, kToggleIcicle};
+  if (m_HoveredFrame != nullptr &&
+      m_HoveredFrame->node != CallstackTree::kInvalidId &&
+      m_HoveredFrame->node != CallstackTree::kRootId) {
+    menu.push_back(kGoToSource);
+  }
+  return menu;
+}
+
+//-----------------------------------------------------------------------------
+void FlameGraphWindow::OnContextMenu(const std::wstring& a_Action,
+                                     int /*a_MenuIndex*/) {
+  if (a_Action == kResetZoom) {
+    SetFocus(CallstackTree::kRootId);
+  } else if (a_Action == kToggleIcicle) {
+    SetIcicle(!m_Icicle);
+  } else if (a_Action == kGoToSource && m_HoveredFrame != nullptr &&
+             m_HoveredFrame->node != CallstackTree::kInvalidId) {
+    GOrbitApp->GoToCode(m_CallTree->m_Tree.GetAddress(m_HoveredFrame->node));
+  }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Batcher.h"
+#include "FlameGraphLayout.h"
+#include "GlCanvas.h"
+
+struct SampledCallTree;
+class SamplingProfiler;
+
+// Flame graph of the samples of the current capture, or icicle graph once
+// flipped, aggregated over their call tree. It follows the live call tree
+// while sampling, and the processed one afterwards. Clicking a frame zooms
+// into it, clicking one of its callers zooms back out.
+class FlameGraphWindow : public GlCanvas {
+ public:
+  FlameGraphWindow();
+  ~FlameGraphWindow() override;
+
+  void PreRender() override;
+  void Resize(int a_Width, int a_Height) override;
+  void Draw() override;
+  void DrawScreenSpace() override;
+  void RenderUI() override {}
+  void PostRender() override;
+
+  void MouseMoved(int a_X, int a_Y, bool a_Left, bool a_Right,
+                  bool a_Middle) override;
+  void LeftDown(int a_X, int a_Y) override;
+  void LeftUp() override;
+  void MouseWheelMoved(int a_X, int a_Y, int a_Delta, bool a_Ctrl) override;
+  void KeyPressed(unsigned int a_KeyCode, bool a_Ctrl, bool a_Shift,
+                  bool a_Alt) override;
+  std::vector<std::wstring> GetContextMenu() override;
+  void OnContextMenu(const std::wstring& a_Action, int a_MenuIndex) override;
+
+  void SetCallTree(std::shared_ptr<SampledCallTree> a_CallTree,
+                   bool a_SameNodes);
+  void SetFocus(CallstackTree::NodeId a_Focus);
+  void SetIcicle(bool a_Icicle);
+
+  static constexpr float kFrameHeight = 20.f;
+  // Callees narrower than this many pixels are merged.
+  static constexpr float kMinFrameWidth = 2.f;
+  static constexpr float kMinLabelWidth = 24.f;
+
+ protected:
+  void UpdateCallTree();
+  void UpdateLayout();
+  void UpdatePrimitives();
+  void DrawBoxBuffer(bool a_Picking);
+  float GetFrameY(uint32_t a_Depth) const;
+  Color GetFrameColor(const FlameGraphFrame& a_Frame) const;
+  const std::string& GetFrameName(const FlameGraphFrame& a_Frame);
+  const FlameGraphFrame* Pick(int a_X, int a_Y);
+
+ private:
+  std::shared_ptr<SamplingProfiler> m_Profiler;
+  bool m_IsLive = false;
+  Timer m_LiveUpdateTimer;
+  std::shared_ptr<SampledCallTree> m_CallTree;
+  CallstackTree::NodeId m_Focus = CallstackTree::kRootId;
+  bool m_Icicle = false;
+  float m_ScrollY = 0.f;
+
+  // Frames only change with the tree, the focus or the width, so that
+  // drawing one more frame doesn't lay them out again.
+  std::vector<FlameGraphFrame> m_Frames;
+  bool m_NeedsLayout = true;
+  Batcher m_Batcher;
+  // Per node, resolved as frames are first drawn.
+  std::vector<std::string> m_FrameNames;
+
+  bool m_IsHovering = false;
+  const FlameGraphFrame* m_HoveredFrame = nullptr;
+};
@@ -6,12 +6,15 @@
 
 #include "App.h"
 #include "Capture.h"
+#include "ConnectionManager.h"
 #include "Core.h"
 #include "Log.h"
 #include "OrbitProcess.h"
 #include "OrbitType.h"
+#include "Params.h"
 #include "Pdb.h"
 #include "RuleEditor.h"
+#include "TimeGraph.h"
 #include "absl/strings/str_format.h"
 
 //-----------------------------------------------------------------------------
@@ -57,6 +60,18 @@ const std::vector<std::wstring>& FunctionsDataView::GetColumnHeaders() {
     Columns.push_back(L"Conv");
     s_HeaderMap.push_back(Function::CALL_CONV);
     s_HeaderRatios.push_back(0);
+    Columns.push_back(L"p50");
+    s_HeaderMap.push_back(Function::TIME_P50);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"p90");
+    s_HeaderMap.push_back(Function::TIME_P90);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"p99");
+    s_HeaderMap.push_back(Function::TIME_P99);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"p99.9");
+    s_HeaderMap.push_back(Function::TIME_P99_9);
+    s_HeaderRatios.push_back(0);
   }
 
   return Columns;
@@ -107,6 +122,18 @@ std::wstring FunctionsDataView::GetValue(int a_Row, int a_Column) {
     case Function::CALL_CONV:
       value = function.GetCallingConventionString();
       break;
+    case Function::TIME_P50:
+      value = GetPercentileString(function, 0.5);
+      break;
+    case Function::TIME_P90:
+      value = GetPercentileString(function, 0.9);
+      break;
+    case Function::TIME_P99:
+      value = GetPercentileString(function, 0.99);
+      break;
+    case Function::TIME_P99_9:
+      value = GetPercentileString(function, 0.999);
+      break;
     default:
       break;
   }
@@ -115,11 +142,29 @@ std::wstring FunctionsDataView::GetValue(int a_Row, int a_Column) {
 }
 
 //-----------------------------------------------------------------------------
-#define ORBIT_FUNC_SORT(Member)                                            \
-  [&](int a, int b) {                                                      \
-    return OrbitUtils::Compare(functions[a]->Member, functions[b]->Member, \
-                               ascending);                                 \
+std::string FunctionsDataView::GetPercentileString(const Function& a_Function,
+                                                   double a_Quantile) {
+  // Only the functions that were called have durations.
+  const FunctionStats* stats = a_Function.Stats();
+  if (stats->m_Count == 0) {
+    return "";
   }
+  return GetPrettyTime(stats->GetPercentileMs(a_Quantile));
+}
+
+//-----------------------------------------------------------------------------
+#define ORBIT_FUNC_KEY(Key) \
+  GetSortKeys(functions, [](const Function* a_Function) { return Key; })
+
+//-----------------------------------------------------------------------------
+#define ORBIT_FUNC_STRING_KEY(String) \
+  GetStringSortKeys(functions,     \
+                    [](const Function* a_Function) { return String; })
+
+//-----------------------------------------------------------------------------
+#define ORBIT_PERCENTILE_KEY(Quantile) \
+  ORBIT_FUNC_KEY(                      \
+      SortKeyFromDouble(a_Function->Stats()->GetPercentileMs(Quantile)))
 
 //-----------------------------------------------------------------------------
 void FunctionsDataView::OnSort(int a_Column, bool a_Toggle) {
@@ -136,39 +181,58 @@ void FunctionsDataView::OnSort(int a_Column, bool a_Toggle) {
   }
 
   bool ascending = m_SortingToggles[MemberID];
-  std::function<bool(int a, int b)> sorter = nullptr;
+  // Names and modules don't change: their ranks are only computed once.
+  std::vector<uint64_t> keys;
+  const std::vector<uint64_t>* sortKeys = &keys;
 
   switch (MemberID) {
     case Function::NAME:
-      sorter = ORBIT_FUNC_SORT(PrettyName());
+      sortKeys = &GetCachedSortKeys(MemberID, functions.size(), [&] {
+        return ORBIT_FUNC_STRING_KEY(a_Function->PrettyName());
+      });
       break;
     case Function::ADDRESS:
-      sorter = ORBIT_FUNC_SORT(Address());
+      keys = ORBIT_FUNC_KEY(a_Function->Address());
       break;
     case Function::MODULE:
-      sorter = ORBIT_FUNC_SORT(GetPdb()->GetName());
+      sortKeys = &GetCachedSortKeys(MemberID, functions.size(), [&] {
+        return ORBIT_FUNC_STRING_KEY(a_Function->GetPdb()->GetName());
+      });
       break;
     case Function::FILE:
-      sorter = ORBIT_FUNC_SORT(File());
+      keys = ORBIT_FUNC_STRING_KEY(a_Function->File());
       break;
     case Function::LINE:
-      sorter = ORBIT_FUNC_SORT(Line());
+      keys = ORBIT_FUNC_KEY(a_Function->Line());
       break;
     case Function::SIZE:
-      sorter = ORBIT_FUNC_SORT(Size());
+      keys = ORBIT_FUNC_KEY(a_Function->Size());
       break;
     case Function::SELECTED:
-      sorter = ORBIT_FUNC_SORT(IsSelected());
+      keys = ORBIT_FUNC_KEY(a_Function->IsSelected());
       break;
     case Function::CALL_CONV:
-      sorter = ORBIT_FUNC_SORT(CallingConvention());
+      keys = ORBIT_FUNC_KEY(SortKeyFromInt(a_Function->CallingConvention()));
+      break;
+    case Function::TIME_P50:
+      keys = ORBIT_PERCENTILE_KEY(0.5);
+      break;
+    case Function::TIME_P90:
+      keys = ORBIT_PERCENTILE_KEY(0.9);
+      break;
+    case Function::TIME_P99:
+      keys = ORBIT_PERCENTILE_KEY(0.99);
+      break;
+    case Function::TIME_P99_9:
+      keys = ORBIT_PERCENTILE_KEY(0.999);
       break;
     default:
+      sortKeys = nullptr;
       break;
   }
 
-  if (sorter) {
-    std::sort(m_Indices.begin(), m_Indices.end(), sorter);
+  if (sortKeys) {
+    SortIndices(*sortKeys, ascending);
   }
 
   m_LastSortedColumn = a_Column;
@@ -181,11 +245,21 @@ std::wstring FUN_VIEW = L"Visualize";
 std::wstring FUN_DISASSEMBLY = L"Go To Disassembly";
 std::wstring FUN_CREATE_RULE = L"Create Rule";
 std::wstring FUN_SET_AS_FRAME = L"Set As Main Frame";
+std::wstring FUN_RECORD_ALL = L"Hook: Record All Calls";
+std::wstring FUN_RECORD_EVERY_NTH = L"Hook: Record 1 Call in 100";
+std::wstring FUN_RECORD_RESERVOIR = L"Hook: Record 100 Calls per 100 ms";
+std::wstring FUN_RECORD_AGGREGATE = L"Hook: Record Stats Only";
+std::wstring FUN_TRACE_INTEL_PT = L"Trace Precisely (Intel PT)";
 
 //-----------------------------------------------------------------------------
 std::vector<std::wstring> FunctionsDataView::GetContextMenu(int a_Index) {
-  std::vector<std::wstring> menu = {FUN_SELECT, FUN_UNSELECT, FUN_VIEW,
-                                    FUN_DISASSEMBLY, FUN_CREATE_RULE};
+  std::vector<std::wstring> menu = {
+      FUN_SELECT,           FUN_UNSELECT,         FUN_RECORD_ALL,
+      FUN_RECORD_EVERY_NTH, FUN_RECORD_RESERVOIR, FUN_RECORD_AGGREGATE,
+      FUN_VIEW,             FUN_DISASSEMBLY,      FUN_CREATE_RULE};
+  if (Capture::IsCapturing() && Capture::IsLinuxData()) {
+    menu.push_back(FUN_TRACE_INTEL_PT);
+  }
 
   Append(menu, DataView::GetContextMenu(a_Index));
 
@@ -226,13 +300,44 @@ void FunctionsDataView::OnContextMenu(const std::wstring& a_Action,
   } else if (a_Action == FUN_SET_AS_FRAME) {
     for (int i : a_ItemIndices) {
       GetFunction(i).SetAsMainFrameFunction();
+      if (GCurrentTimeGraph) {
+        GCurrentTimeGraph->RebuildFrameIndex();
+      }
       break;
     }
+  } else if (a_Action == FUN_TRACE_INTEL_PT) {
+    // Only the calls during the window, without instrumentation.
+    for (int i : a_ItemIndices) {
+      ConnectionManager::Get().RequestIntelPtWindow(
+          GetFunction(i).GetVirtualAddress(),
+          GParams.m_IntelPtWindowMs * 1'000'000ull);
+    }
+  } else if (a_Action == FUN_RECORD_ALL || a_Action == FUN_RECORD_EVERY_NTH ||
+             a_Action == FUN_RECORD_RESERVOIR ||
+             a_Action == FUN_RECORD_AGGREGATE) {
+    SamplingPolicy policy;
+    if (a_Action == FUN_RECORD_EVERY_NTH) {
+      policy = {SamplingPolicy::kEveryNth, 100};
+    } else if (a_Action == FUN_RECORD_RESERVOIR) {
+      policy = {SamplingPolicy::kReservoir, 100};
+    } else if (a_Action == FUN_RECORD_AGGREGATE) {
+      policy = {SamplingPolicy::kAggregate, 0};
+    }
+    for (int i : a_ItemIndices) {
+      Function& func = GetFunction(i);
+      func.SetSamplingPolicy(policy);
+      func.Select();
+    }
   } else {
     DataView::OnContextMenu(a_Action, a_MenuIndex, a_ItemIndices);
   }
 }
 
+//-----------------------------------------------------------------------------
+void FunctionsDataView::OnSelect(int a_Index) {
+  GOrbitApp->ShowLatencyHistogram(GetFunction(a_Index));
+}
+
 //-----------------------------------------------------------------------------
 void FunctionsDataView::OnFilter(const std::wstring& a_Filter) {
   m_FilterTokens = Tokenize(ToLower(a_Filter));
@@ -240,34 +345,53 @@ void FunctionsDataView::OnFilter(const std::wstring& a_Filter) {
 #ifdef WIN32
   ParallelFilter();
 #else
-  // TODO: port parallel filtering
-  std::vector<uint32_t> indices;
-  std::vector<std::wstring> tokens = Tokenize(ToLower(a_Filter));
-  std::vector<Function*>& functions = Capture::GTargetProcess->GetFunctions();
-  for (int i = 0; i < (int)functions.size(); ++i) {
-    Function* function = functions[i];
-    std::string name = function->Lower() + function->GetPdb()->GetName();
-
-    bool match = true;
-
-    for (std::wstring& filterToken : tokens) {
-      if (name.find(ws2s(filterToken)) == std::string::npos) {
-        match = false;
-        break;
-      }
-    }
+  IndexedFilter();
+#endif
+}
 
-    if (match) {
-      indices.push_back(i);
-    }
+//-----------------------------------------------------------------------------
+void FunctionsDataView::IndexedFilter() {
+  std::vector<std::string> tokens;
+  for (const std::wstring& token : m_FilterTokens) {
+    tokens.push_back(ws2s(token));
   }
 
-  m_Indices = indices;
+  ScopeLock lock(Capture::GTargetProcess->GetDataMutex());
+  std::vector<Function*>& functions = Capture::GTargetProcess->GetFunctions();
+  // Functions are only appended, unless those of another process replace
+  // them.
+  if (functions.size() < m_SearchIndex.size() ||
+      (!functions.empty() && functions[0] != m_FirstIndexedFunction)) {
+    m_SearchIndex.Clear();
+    m_HasLastMatches = false;
+  }
+  bool isIndexComplete = m_SearchIndex.size() == functions.size();
+  for (size_t i = m_SearchIndex.size(); i < functions.size(); ++i) {
+    Function* function = functions[i];
+    m_SearchIndex.Add(function->PrettyName() + " " +
+                      function->GetPdb()->GetName());
+  }
+  m_FirstIndexedFunction = functions.empty() ? nullptr : functions[0];
+
+  // A filter containing each token of the previous one only matches
+  // functions the previous one did, unless functions were added since.
+  bool refines = isIndexComplete && m_HasLastMatches;
+  for (const std::string& lastToken : m_LastFilterTokens) {
+    refines = refines && std::any_of(tokens.begin(), tokens.end(),
+                                     [&](const std::string& token) {
+                                       return token.find(lastToken) !=
+                                              std::string::npos;
+                                     });
+  }
+  m_LastMatches =
+      m_SearchIndex.Find(tokens, refines ? &m_LastMatches : nullptr);
+  m_LastFilterTokens = std::move(tokens);
+  m_HasLastMatches = true;
+  m_Indices = m_LastMatches;
 
   if (m_LastSortedColumn != -1) {
     OnSort(m_LastSortedColumn, false);
   }
-#endif
 }
 
 //-----------------------------------------------------------------------------
@@ -314,6 +438,7 @@ void FunctionsDataView::ParallelFilter() {
 //-----------------------------------------------------------------------------
 void FunctionsDataView::OnDataChanged() {
   ScopeLock lock(Capture::GTargetProcess->GetDataMutex());
+  ClearCachedSortKeys();
 
   size_t numFunctions = Capture::GTargetProcess->GetFunctions().size();
   m_Indices.resize(numFunctions);
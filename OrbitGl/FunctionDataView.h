@@ -5,6 +5,7 @@
 
 #include "DataView.h"
 #include "OrbitType.h"
+#include "TrigramIndex.h"
 
 class FunctionsDataView : public DataView {
  public:
@@ -17,17 +18,30 @@ class FunctionsDataView : public DataView {
 
   void OnFilter(const std::wstring& a_Filter) override;
   void ParallelFilter();
+  // Filters with m_SearchIndex, extended with the functions added since the
+  // previous filter.
+  void IndexedFilter();
   void OnSort(int a_Column, bool a_Toggle = true) override;
   void OnContextMenu(const std::wstring& a_Action, int a_MenuIndex,
                      std::vector<int>& a_ItemIndices) override;
+  void OnSelect(int a_Index) override;
   void OnDataChanged() override;
 
   virtual bool SortAllowed() { return true; }
 
  protected:
   virtual Function& GetFunction(unsigned int a_Row);
+  // Empty for the functions that were not called.
+  static std::string GetPercentileString(const Function& a_Function,
+                                         double a_Quantile);
 
   std::vector<std::wstring> m_FilterTokens;
+  // Of the pretty names and modules of the functions of the process.
+  TrigramIndex m_SearchIndex;
+  Function* m_FirstIndexedFunction = nullptr;
+  std::vector<std::string> m_LastFilterTokens;
+  std::vector<uint32_t> m_LastMatches;
+  bool m_HasLastMatches = false;
   static std::vector<int> s_HeaderMap;
   static std::vector<float> s_HeaderRatios;
 };
@@ -6,9 +6,11 @@
 
 #include "BlackBoard.h"
 #include "CaptureWindow.h"
+#include "FlameGraphWindow.h"
 #include "GlCanvas.h"
 #include "HomeWindow.h"
 #include "ImmediateWindow.h"
+#include "LatencyHistogramWindow.h"
 #include "PluginCanvas.h"
 #include "RuleEditor.h"
 
@@ -32,6 +34,12 @@ GlPanel* GlPanel::Create(Type a_Type, void* a_UserData) {
     case DEBUG:
       panel = new HomeWindow();
       break;
+    case FLAME_GRAPH:
+      panel = new FlameGraphWindow();
+      break;
+    case LATENCY_HISTOGRAM:
+      panel = new LatencyHistogramWindow();
+      break;
     case PLUGIN:
       panel = new PluginCanvas((Orbit::Plugin*)a_UserData);
 
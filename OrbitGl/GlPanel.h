@@ -10,7 +10,16 @@ class GlPanel {
   GlPanel();
   virtual ~GlPanel();
 
-  enum Type { CAPTURE, IMMEDIATE, VISUALIZE, RULE_EDITOR, PLUGIN, DEBUG };
+  enum Type {
+    CAPTURE,
+    IMMEDIATE,
+    VISUALIZE,
+    RULE_EDITOR,
+    PLUGIN,
+    DEBUG,
+    FLAME_GRAPH,
+    LATENCY_HISTOGRAM
+  };
 
   static GlPanel* Create(Type a_Type, void* a_UserData = nullptr);
 
@@ -7,6 +7,7 @@
 #include "Core.h"
 #include "Log.h"
 #include "OpenGl.h"
+#include "OrbitBase/Logging.h"
 #include "absl/strings/str_format.h"
 #include "freetype-gl/freetype-gl.h"
 
@@ -60,3 +61,49 @@ void OutputGlMatrices() {
   mat4* texture = (mat4*)&matrix[0];
   PRINT_VAR(*texture);
 }
+
+namespace {
+GLuint CompileShader(GLenum a_Type, const char* a_Source) {
+  GLuint shader = glCreateShader(a_Type);
+  glShaderSource(shader, 1, &a_Source, nullptr);
+  glCompileShader(shader);
+  GLint compiled = GL_FALSE;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+  if (compiled != GL_TRUE) {
+    char log[1024] = {};
+    glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+    ERROR("Compiling shader: %s", log);
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+}  // namespace
+
+GLuint CreateGlProgram(const char* a_VertexSource,
+                       const char* a_FragmentSource) {
+  GLuint vertexShader = CompileShader(GL_VERTEX_SHADER, a_VertexSource);
+  GLuint fragmentShader = CompileShader(GL_FRAGMENT_SHADER, a_FragmentSource);
+  if (vertexShader == 0 || fragmentShader == 0) {
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    return 0;
+  }
+
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vertexShader);
+  glAttachShader(program, fragmentShader);
+  glLinkProgram(program);
+  glDeleteShader(vertexShader);
+  glDeleteShader(fragmentShader);
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (linked != GL_TRUE) {
+    char log[1024] = {};
+    glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+    ERROR("Linking shader program: %s", log);
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
@@ -5,12 +5,20 @@
 
 #include <iostream>
 
+#include "OpenGl.h"
 #include "mat4.h"
 
 void CheckGlError();
 void OutputGlMatrices();
+// Compiles and links a program from GLSL sources. Returns 0 and logs the
+// error if either does not compile or the program does not link.
+GLuint CreateGlProgram(const char* a_VertexSource,
+                       const char* a_FragmentSource);
 
-inline std::ostream& operator<<(std::ostream& os, const ftgl::mat4& mat) {
+// In the namespace of mat4, for PrintVar to find it wherever PrintVar.h was
+// included.
+namespace ftgl {
+inline std::ostream& operator<<(std::ostream& os, const mat4& mat) {
   os << std::endl;
   os << mat.m00 << "\t" << mat.m01 << "\t" << mat.m02 << "\t" << mat.m03
      << std::endl;
@@ -22,3 +30,4 @@ inline std::ostream& operator<<(std::ostream& os, const ftgl::mat4& mat) {
      << std::endl;
   return os;
 }
+}  // namespace ftgl
@@ -254,6 +254,9 @@ void GlobalsDataView::OnDataChanged() {
   }
 }
 
+//-----------------------------------------------------------------------------
+void GlobalsDataView::OnShown() { GOrbitApp->LoadTypesAndGlobals(); }
+
 //-----------------------------------------------------------------------------
 Variable& GlobalsDataView::GetVariable(unsigned int a_Row) const {
   std::vector<Variable*>& globals = Capture::GTargetProcess->GetGlobals();
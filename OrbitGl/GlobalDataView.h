@@ -21,6 +21,7 @@ class GlobalsDataView : public DataView {
   void OnContextMenu(const std::wstring& a_Action, int a_MenuIndex,
                      std::vector<int>& a_ItemIndices) override;
   void OnDataChanged() override;
+  void OnShown() override;
   void OnAddToWatch(std::vector<int>& a_Items);
 
  protected:
@@ -625,9 +625,7 @@ void WatchWindow::Draw(const char* title, bool* p_opened) {
       Capture::GTargetProcess->GetWatchedVariables();
 
   if (ImGui::Button("Sync")) {
-    for (std::shared_ptr<Variable> var : watchedVars) {
-      var->SyncValue();
-    }
+    Capture::GTargetProcess->RefreshWatchedVariables();
   }
 
   ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(2, 2));
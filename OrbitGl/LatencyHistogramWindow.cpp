@@ -0,0 +1,307 @@
+#include "LatencyHistogramWindow.h"
+
+#include <algorithm>
+
+#include "App.h"
+#include "Capture.h"
+#include "OrbitFunction.h"
+#include "OrbitProcess.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+
+namespace {
+struct PercentileMarker {
+  const char* name;
+  double quantile;
+};
+const PercentileMarker kMarkers[] = {
+    {"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p99.9", 0.999}};
+
+std::string GetPrettyDurationNs(uint64_t a_DurationNs) {
+  return GetPrettyTime((double)a_DurationNs * 0.000001);
+}
+}  // namespace
+
+//-----------------------------------------------------------------------------
+LatencyHistogramWindow::LatencyHistogramWindow() {
+  m_DrawUI = false;
+  m_WorldTopLeftX = 0;
+  m_WorldTopLeftY = 0;
+  m_UpdateTimer.Start();
+  GOrbitApp->RegisterLatencyHistogramWindow(this);
+}
+
+//-----------------------------------------------------------------------------
+LatencyHistogramWindow::~LatencyHistogramWindow() {}
+
+//-----------------------------------------------------------------------------
+void LatencyHistogramWindow::SetFunction(const Function& a_Function) {
+  m_FunctionAddress = a_Function.GetVirtualAddress();
+  m_FunctionName = a_Function.PrettyName();
+  m_Stats.Reset();
+  m_Bars.clear();
+  m_NeedsUpdate = true;
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+void LatencyHistogramWindow::PreRender() {
+  if (m_NeedsUpdate ||
+      (Capture::IsCapturing() && m_UpdateTimer.QueryMillis() >=
+                                     kUpdatePeriodMs)) {
+    m_UpdateTimer.Start();
+    m_NeedsUpdate = false;
+    UpdateHistogram();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void LatencyHistogramWindow::UpdateHistogram() {
+  FunctionStats stats;
+  if (m_FunctionAddress != 0 && Capture::GTargetProcess != nullptr) {
+    ScopeLock lock(Capture::GTargetProcess->GetDataMutex());
+    const Function* function =
+        Capture::GTargetProcess->GetFunctionFromAddress(m_FunctionAddress);
+    if (function != nullptr) {
+      stats = *function->Stats();
+    }
+  }
+  if (stats.m_Count == m_Stats.m_Count && !m_Bars.empty()) {
+    return;
+  }
+
+  m_Stats = stats;
+  m_FirstBucket = 0;
+  m_LastBucket = 0;
+  bool empty = true;
+  for (size_t i = 0; i < LatencyHistogram::kNumBuckets; ++i) {
+    if (m_Stats.m_Histogram.GetBucketCount(i) == 0) continue;
+    if (empty) m_FirstBucket = i;
+    m_LastBucket = i;
+    empty = false;
+  }
+  m_Bars.clear();
+  if (!empty) {
+    for (size_t i = m_FirstBucket; i <= m_LastBucket; ++i) {
+      m_Bars.push_back(i);
+    }
+  }
+  m_HoveredBucket = nullptr;
+  UpdatePrimitives();
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+void LatencyHistogramWindow::Resize(int a_Width, int a_Height) {
+  GlCanvas::Resize(a_Width, a_Height);
+  // World units are pixels, from the bottom left corner.
+  m_DesiredWorldWidth = (float)a_Width;
+  m_DesiredWorldHeight = (float)a_Height;
+  m_WorldTopLeftX = 0.f;
+  m_WorldTopLeftY = (float)a_Height;
+  UpdatePrimitives();
+}
+
+//-----------------------------------------------------------------------------
+float LatencyHistogramWindow::GetBarWidth() const {
+  return ((float)getWidth() - 2.f * kMargin) / (float)m_Bars.size();
+}
+
+//-----------------------------------------------------------------------------
+float LatencyHistogramWindow::GetBucketX(size_t a_Bucket) const {
+  return kMargin + (float)(a_Bucket - m_FirstBucket) * GetBarWidth();
+}
+
+//-----------------------------------------------------------------------------
+float LatencyHistogramWindow::GetMarkerX(double a_Quantile) const {
+  auto percentileNs =
+      (uint64_t)(m_Stats.GetPercentileMs(a_Quantile) * 1000000.0);
+  size_t bucket = std::clamp(LatencyHistogram::GetBucketIndex(percentileNs),
+                             m_FirstBucket, m_LastBucket);
+  return GetBucketX(bucket) + GetBarWidth() / 2.f;
+}
+
+//-----------------------------------------------------------------------------
+void LatencyHistogramWindow::UpdatePrimitives() {
+  m_Batcher.Reset();
+  if (m_Bars.empty()) {
+    return;
+  }
+
+  uint32_t maxCount = 0;
+  for (size_t bucket : m_Bars) {
+    maxCount = std::max(maxCount, m_Stats.m_Histogram.GetBucketCount(bucket));
+  }
+  float maxHeight = (float)getHeight() - 2.f * kMargin;
+  float barWidth = GetBarWidth();
+  float z = GlCanvas::Z_VALUE_BOX_ACTIVE;
+
+  static Color s_BarColor(43, 145, 175, 255);
+  for (size_t& bucket : m_Bars) {
+    uint32_t count = m_Stats.m_Histogram.GetBucketCount(bucket);
+    if (count == 0) continue;
+    float x = GetBucketX(bucket);
+    // A pixel is left between bars, and non-empty buckets are at least a
+    // pixel high.
+    float width = std::max(barWidth - 1.f, 1.f);
+    float height = std::max(maxHeight * (float)count / (float)maxCount, 1.f);
+    Box box;
+    box.m_Vertices[0] = Vec3(x, kMargin, z);
+    box.m_Vertices[1] = Vec3(x, kMargin + height, z);
+    box.m_Vertices[2] = Vec3(x + width, kMargin + height, z);
+    box.m_Vertices[3] = Vec3(x + width, kMargin, z);
+    Color colors[4];
+    Fill(colors, s_BarColor);
+    m_Batcher.AddBox(box, colors, PickingID::BOX, &bucket);
+  }
+
+  // Markers are thin boxes in the middle of the bucket of their percentile,
+  // in front of the bars.
+  static Color s_MarkerColor(248, 101, 22, 255);
+  z = GlCanvas::Z_VALUE_UI;
+  for (const PercentileMarker& marker : kMarkers) {
+    float x = GetMarkerX(marker.quantile);
+    Box box;
+    box.m_Vertices[0] = Vec3(x, kMargin, z);
+    box.m_Vertices[1] = Vec3(x, kMargin + maxHeight, z);
+    box.m_Vertices[2] = Vec3(x + 2.f, kMargin + maxHeight, z);
+    box.m_Vertices[3] = Vec3(x + 2.f, kMargin, z);
+    Color colors[4];
+    Fill(colors, s_MarkerColor);
+    m_Batcher.AddBox(box, colors, PickingID::BOX);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void LatencyHistogramWindow::Draw() {
+  glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT);
+  glDisable(GL_CULL_FACE);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  DrawBoxBuffer(m_Picking);
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glPopAttrib();
+
+  if (m_Picking || m_Bars.empty()) {
+    return;
+  }
+
+  // Markers of close percentiles share a bucket: their labels are stacked.
+  static Color s_TextColor(255, 255, 255, 255);
+  float top = (float)getHeight() - kMargin - 12.f;
+  float previousX = -1.f;
+  float y = top;
+  for (const PercentileMarker& marker : kMarkers) {
+    float x = GetMarkerX(marker.quantile);
+    y = x == previousX ? y - 12.f : top;
+    previousX = x;
+    m_TextRenderer.AddText(marker.name, x + 3.f, y, GlCanvas::Z_VALUE_TEXT,
+                           s_TextColor);
+  }
+
+  // The range of durations drawn, under the first and the last bar.
+  std::string first = GetPrettyDurationNs(
+      LatencyHistogram::GetBucketLowerBoundNs(m_FirstBucket));
+  std::string last = GetPrettyDurationNs(
+      LatencyHistogram::GetBucketUpperBoundNs(m_LastBucket));
+  m_TextRenderer.AddText(first.c_str(), kMargin, kMargin - 15.f,
+                         GlCanvas::Z_VALUE_TEXT, s_TextColor);
+  m_TextRenderer.AddText(last.c_str(), GetBucketX(m_LastBucket),
+                         kMargin - 15.f, GlCanvas::Z_VALUE_TEXT, s_TextColor);
+}
+
+//-----------------------------------------------------------------------------
+void LatencyHistogramWindow::DrawBoxBuffer(bool a_Picking) {
+  Block<Box, BoxBuffer::NUM_BOXES_PER_BLOCK>* boxBlock =
+      m_Batcher.GetBoxBuffer().m_Boxes.m_Root;
+  Block<Color, BoxBuffer::NUM_BOXES_PER_BLOCK * 4>* colorBlock;
+
+  colorBlock = !a_Picking ? m_Batcher.GetBoxBuffer().m_Colors.m_Root
+                          : m_Batcher.GetBoxBuffer().m_PickingColors.m_Root;
+
+  while (boxBlock) {
+    if (int numElems = boxBlock->m_Size) {
+      glVertexPointer(3, GL_FLOAT, sizeof(Vec3), boxBlock->m_Data);
+      glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Color),
+                     (void*)(colorBlock->m_Data));
+      glDrawArrays(GL_QUADS, 0, numElems * 4);
+    }
+
+    boxBlock = boxBlock->m_Next;
+    colorBlock = colorBlock->m_Next;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void LatencyHistogramWindow::DrawScreenSpace() {
+  if (m_Picking) {
+    return;
+  }
+
+  static Color s_TextColor(255, 255, 255, 255);
+  std::string status;
+  if (m_FunctionAddress == 0) {
+    status = "Select a function to see the durations of its calls";
+  } else if (m_Stats.m_Count == 0) {
+    status = absl::StrFormat("%s: no calls", m_FunctionName);
+  } else if (m_HoveredBucket != nullptr) {
+    uint32_t count = m_Stats.m_Histogram.GetBucketCount(*m_HoveredBucket);
+    status = absl::StrFormat(
+        "%s: %u calls (%.2f%%) from %s to %s", m_FunctionName, count,
+        100.f * (float)count / (float)m_Stats.m_Count,
+        GetPrettyDurationNs(
+            LatencyHistogram::GetBucketLowerBoundNs(*m_HoveredBucket)),
+        GetPrettyDurationNs(
+            LatencyHistogram::GetBucketUpperBoundNs(*m_HoveredBucket)));
+  } else {
+    status = absl::StrFormat("%s: %lu calls", m_FunctionName, m_Stats.m_Count);
+    for (const PercentileMarker& marker : kMarkers) {
+      absl::StrAppend(&status, "  ", marker.name, " ",
+                      GetPrettyTime(m_Stats.GetPercentileMs(marker.quantile)));
+    }
+  }
+  AddText2D(status.c_str(), 5, getHeight() - 12, GlCanvas::Z_VALUE_TEXT_UI,
+            s_TextColor);
+}
+
+//-----------------------------------------------------------------------------
+const size_t* LatencyHistogramWindow::Pick(int a_X, int a_Y) {
+  // 4 bytes per pixel (RGBA), 1x1 bitmap
+  std::vector<unsigned char> pixels(1 * 1 * 4);
+  glReadPixels(a_X, m_MainWindowHeight - a_Y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+               &pixels[0]);
+
+  PickingID pickId = PickingID::Get(*((uint32_t*)(&pixels[0])));
+  if (pickId.m_Type != PickingID::BOX) {
+    return nullptr;
+  }
+  void** bucketPtr = m_Batcher.GetBoxBuffer().m_UserData.SlowAt(pickId.m_Id);
+  return bucketPtr ? static_cast<const size_t*>(*bucketPtr) : nullptr;
+}
+
+//-----------------------------------------------------------------------------
+void LatencyHistogramWindow::PostRender() {
+  if (!m_Picking) {
+    return;
+  }
+
+  if (m_IsHovering) {
+    m_IsHovering = false;
+    m_HoveredBucket = Pick(m_MousePosX, m_MousePosY);
+  }
+
+  m_Picking = false;
+  NeedsRedraw();
+  GlCanvas::Render(m_Width, m_Height);
+}
+
+//-----------------------------------------------------------------------------
+void LatencyHistogramWindow::MouseMoved(int a_X, int a_Y, bool /*a_Left*/,
+                                        bool /*a_Right*/, bool /*a_Middle*/) {
+  m_MousePosX = a_X;
+  m_MousePosY = a_Y;
+  m_IsHovering = true;
+  m_Picking = true;
+  NeedsRedraw();
+}
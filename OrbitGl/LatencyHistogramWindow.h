@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Batcher.h"
+#include "FunctionStats.h"
+#include "GlCanvas.h"
+
+class Function;
+
+// Histogram of the durations of the calls to the function last selected in
+// the function views, from the LatencyHistogram of its stats, with markers at
+// its percentiles. Buckets are drawn with equal widths: the duration axis is
+// logarithmic. It follows the stats of the function while capturing.
+class LatencyHistogramWindow : public GlCanvas {
+ public:
+  LatencyHistogramWindow();
+  ~LatencyHistogramWindow() override;
+
+  void PreRender() override;
+  void Resize(int a_Width, int a_Height) override;
+  void Draw() override;
+  void DrawScreenSpace() override;
+  void RenderUI() override {}
+  void PostRender() override;
+
+  void MouseMoved(int a_X, int a_Y, bool a_Left, bool a_Right,
+                  bool a_Middle) override;
+
+  void SetFunction(const Function& a_Function);
+
+  static constexpr uint32_t kUpdatePeriodMs = 300;
+  static constexpr float kMargin = 30.f;
+
+ protected:
+  void UpdateHistogram();
+  void UpdatePrimitives();
+  void DrawBoxBuffer(bool a_Picking);
+  float GetBarWidth() const;
+  float GetBucketX(size_t a_Bucket) const;
+  float GetMarkerX(double a_Quantile) const;
+  const size_t* Pick(int a_X, int a_Y);
+
+ private:
+  uint64_t m_FunctionAddress = 0;
+  std::string m_FunctionName;
+  Timer m_UpdateTimer;
+  FunctionStats m_Stats;
+  // Non-empty range of buckets drawn, [m_FirstBucket, m_LastBucket].
+  size_t m_FirstBucket = 0;
+  size_t m_LastBucket = 0;
+  bool m_NeedsUpdate = false;
+
+  Batcher m_Batcher;
+  // The bucket of each bar, the user data of its box.
+  std::vector<size_t> m_Bars;
+
+  bool m_IsHovering = false;
+  const size_t* m_HoveredBucket = nullptr;
+};
@@ -22,6 +22,12 @@ enum Columns {
   TIME_AVG,
   TIME_MIN,
   TIME_MAX,
+  TIME_P50,
+  TIME_P90,
+  TIME_P99,
+  TIME_P99_9,
+  TIME_ON_CPU_AVG,
+  ON_CPU_PERCENT,
   ADDRESS,
   MODULE,
   INDEX,
@@ -72,6 +78,24 @@ const std::vector<std::wstring>& LiveFunctionsDataView::GetColumnHeaders() {
     Columns.push_back(L"Max");
     s_HeaderMap.push_back(LiveFunction::TIME_MAX);
     s_HeaderRatios.push_back(0);
+    Columns.push_back(L"p50");
+    s_HeaderMap.push_back(LiveFunction::TIME_P50);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"p90");
+    s_HeaderMap.push_back(LiveFunction::TIME_P90);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"p99");
+    s_HeaderMap.push_back(LiveFunction::TIME_P99);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"p99.9");
+    s_HeaderMap.push_back(LiveFunction::TIME_P99_9);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"Avg On-CPU");
+    s_HeaderMap.push_back(LiveFunction::TIME_ON_CPU_AVG);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"On-CPU %");
+    s_HeaderMap.push_back(LiveFunction::ON_CPU_PERCENT);
+    s_HeaderRatios.push_back(0);
     Columns.push_back(L"Module");
     s_HeaderMap.push_back(LiveFunction::MODULE);
     s_HeaderRatios.push_back(0);
@@ -124,6 +148,29 @@ std::wstring LiveFunctionsDataView::GetValue(int a_Row, int a_Column) {
     case LiveFunction::TIME_MAX:
       value = GetPrettyTime(stats->m_MaxMs);
       break;
+    case LiveFunction::TIME_P50:
+      value = GetPrettyTime(stats->GetPercentileMs(0.5));
+      break;
+    case LiveFunction::TIME_P90:
+      value = GetPrettyTime(stats->GetPercentileMs(0.9));
+      break;
+    case LiveFunction::TIME_P99:
+      value = GetPrettyTime(stats->GetPercentileMs(0.99));
+      break;
+    case LiveFunction::TIME_P99_9:
+      value = GetPrettyTime(stats->GetPercentileMs(0.999));
+      break;
+    // Blank until calls are joined with the context switches of their thread.
+    case LiveFunction::TIME_ON_CPU_AVG:
+      if (stats->m_OnCpuCount > 0) {
+        value = GetPrettyTime(stats->m_OnCpuTimeMs / stats->m_OnCpuCount);
+      }
+      break;
+    case LiveFunction::ON_CPU_PERCENT:
+      if (stats->m_OnCpuCount > 0) {
+        value = absl::StrFormat("%.1f", 100.0 * stats->GetOnCpuRatio());
+      }
+      break;
     case LiveFunction::ADDRESS:
       value = absl::StrFormat("0x%llx", function.GetVirtualAddress());
       break;
@@ -138,64 +185,131 @@ std::wstring LiveFunctionsDataView::GetValue(int a_Row, int a_Column) {
 }
 
 //-----------------------------------------------------------------------------
-#define ORBIT_FUNC_SORT(Member)                                            \
-  [&](int a, int b) {                                                      \
-    return OrbitUtils::Compare(functions[a]->Member, functions[b]->Member, \
-                               ascending);                                 \
-  }
-#define ORBIT_STAT_SORT(Member)                                           \
-  [&](int a, int b) {                                                     \
-    return OrbitUtils::Compare(functions[a]->Stats()->Member,             \
-                               functions[b]->Stats()->Member, ascending); \
-  }
+#define ORBIT_FUNC_KEY(Key)                                             \
+  GetSortKeys(functions, [](const Function* a_Function) -> uint64_t { \
+    return a_Function ? Key : 0;                                      \
+  })
+#define ORBIT_FUNC_STRING_KEY(String)                                  \
+  GetStringSortKeys(functions, [](const Function* a_Function) {        \
+    return a_Function ? std::string_view(String) : std::string_view(); \
+  })
 
 //-----------------------------------------------------------------------------
 void LiveFunctionsDataView::OnSort(int a_Column, bool a_Toggle) {
-  const std::vector<Function*>& functions = m_Functions;
   auto MemberID = LiveFunction::Columns(s_HeaderMap[a_Column]);
 
   if (a_Toggle) {
     m_SortingToggles[MemberID] = !m_SortingToggles[MemberID];
   }
 
-  bool ascending = m_SortingToggles[MemberID];
-  std::function<bool(int a, int b)> sorter = nullptr;
+  Sort(a_Column);
+}
 
-  switch (MemberID) {
-    case LiveFunction::NAME:
-      sorter = ORBIT_FUNC_SORT(PrettyName());
-      break;
+//-----------------------------------------------------------------------------
+bool LiveFunctionsDataView::IsStatColumn(int a_MemberID) {
+  switch (a_MemberID) {
     case LiveFunction::COUNT:
-      ascending = false;
-      sorter = ORBIT_STAT_SORT(m_Count);
-      break;
     case LiveFunction::TIME_TOTAL:
-      sorter = ORBIT_STAT_SORT(m_TotalTimeMs);
-      break;
     case LiveFunction::TIME_AVG:
-      sorter = ORBIT_STAT_SORT(m_AverageTimeMs);
-      break;
     case LiveFunction::TIME_MIN:
-      sorter = ORBIT_STAT_SORT(m_MinMs);
-      break;
     case LiveFunction::TIME_MAX:
-      sorter = ORBIT_STAT_SORT(m_MaxMs);
+    case LiveFunction::TIME_P50:
+    case LiveFunction::TIME_P90:
+    case LiveFunction::TIME_P99:
+    case LiveFunction::TIME_P99_9:
+    case LiveFunction::TIME_ON_CPU_AVG:
+    case LiveFunction::ON_CPU_PERCENT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+//-----------------------------------------------------------------------------
+uint64_t LiveFunctionsDataView::GetStatSortKey(const Function* a_Function,
+                                               int a_MemberID) {
+  if (a_Function == nullptr) return 0;
+  const FunctionStats* stats = a_Function->Stats();
+  switch (a_MemberID) {
+    case LiveFunction::COUNT:
+      return stats->m_Count;
+    case LiveFunction::TIME_TOTAL:
+      return SortKeyFromDouble(stats->m_TotalTimeMs);
+    case LiveFunction::TIME_AVG:
+      return SortKeyFromDouble(stats->m_AverageTimeMs);
+    case LiveFunction::TIME_MIN:
+      return SortKeyFromDouble(stats->m_MinMs);
+    case LiveFunction::TIME_MAX:
+      return SortKeyFromDouble(stats->m_MaxMs);
+    case LiveFunction::TIME_P50:
+      return SortKeyFromDouble(stats->GetPercentileMs(0.5));
+    case LiveFunction::TIME_P90:
+      return SortKeyFromDouble(stats->GetPercentileMs(0.9));
+    case LiveFunction::TIME_P99:
+      return SortKeyFromDouble(stats->GetPercentileMs(0.99));
+    case LiveFunction::TIME_P99_9:
+      return SortKeyFromDouble(stats->GetPercentileMs(0.999));
+    case LiveFunction::TIME_ON_CPU_AVG:
+      return SortKeyFromDouble(
+          stats->m_OnCpuCount > 0 ? stats->m_OnCpuTimeMs / stats->m_OnCpuCount
+                                  : 0);
+    case LiveFunction::ON_CPU_PERCENT:
+      return SortKeyFromDouble(stats->GetOnCpuRatio());
+    default:
+      return 0;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void LiveFunctionsDataView::Sort(int a_Column) {
+  const std::vector<Function*>& functions = m_Functions;
+  auto MemberID = LiveFunction::Columns(s_HeaderMap[a_Column]);
+  bool ascending = m_SortingToggles[MemberID];
+  // Names, addresses and modules don't change during the capture: they are
+  // only computed once. The keys of the stats are kept to be updated with
+  // the stats that change, see OnTimer.
+  std::vector<uint64_t> keys;
+  const std::vector<uint64_t>* sortKeys = &keys;
+  m_StatSortKeys.clear();
+
+  switch (MemberID) {
+    case LiveFunction::NAME:
+      sortKeys = &GetCachedSortKeys(MemberID, functions.size(), [&] {
+        return ORBIT_FUNC_STRING_KEY(a_Function->PrettyName());
+      });
       break;
     case LiveFunction::ADDRESS:
-      sorter = ORBIT_FUNC_SORT(Address());
+      sortKeys = &GetCachedSortKeys(MemberID, functions.size(), [&] {
+        return ORBIT_FUNC_KEY(a_Function->Address());
+      });
       break;
     case LiveFunction::MODULE:
-      sorter = ORBIT_FUNC_SORT(GetPdb()->GetName());
+      sortKeys = &GetCachedSortKeys(MemberID, functions.size(), [&] {
+        return ORBIT_FUNC_STRING_KEY(a_Function->GetPdb()->GetName());
+      });
       break;
     case LiveFunction::SELECTED:
-      sorter = ORBIT_FUNC_SORT(IsSelected());
+      keys = ORBIT_FUNC_KEY(a_Function->IsSelected());
       break;
     default:
+      if (!IsStatColumn(MemberID)) {
+        sortKeys = nullptr;
+        break;
+      }
+      if (MemberID == LiveFunction::COUNT) {
+        ascending = false;
+      }
+      m_StatSortKeys.resize(functions.size());
+      for (size_t i = 0; i < functions.size(); ++i) {
+        m_StatSortKeys[i] = GetStatSortKey(functions[i], MemberID);
+      }
+      m_StatSortAscending = ascending;
+      sortKeys = &m_StatSortKeys;
       break;
   }
 
-  if (sorter) {
-    std::sort(m_Indices.begin(), m_Indices.end(), sorter);
+  if (sortKeys) {
+    SortIndices(*sortKeys, ascending);
   }
 
   m_LastSortedColumn = a_Column;
@@ -225,6 +339,11 @@ void LiveFunctionsDataView::OnContextMenu(const std::wstring& a_Action,
   }
 }
 
+//-----------------------------------------------------------------------------
+void LiveFunctionsDataView::OnSelect(int a_Index) {
+  GOrbitApp->ShowLatencyHistogram(GetFunction(a_Index));
+}
+
 //-----------------------------------------------------------------------------
 void LiveFunctionsDataView::OnFilter(const std::wstring& a_Filter) {
   std::vector<uint32_t> indices;
@@ -276,20 +395,43 @@ void LiveFunctionsDataView::OnDataChanged() {
   }
 
   m_Functions.clear();
+  m_FunctionIndices.clear();
+  ClearCachedSortKeys();
   for (auto& pair : Capture::GFunctionCountMap) {
     const ULONG64& address = pair.first;
     Function* func = Capture::GSelectedFunctionsMap[address];
+    m_FunctionIndices[address] = (uint32_t)m_Functions.size();
     m_Functions.push_back(func);
   }
 
   OnFilter(m_Filter);
 }
 
+//-----------------------------------------------------------------------------
+bool LiveFunctionsDataView::SkipTimer() {
+  // Nothing to update while no stats change.
+  return Capture::GFunctionStatsChanges.IsEmpty();
+}
+
 //-----------------------------------------------------------------------------
 void LiveFunctionsDataView::OnTimer() {
-  if (Capture::IsCapturing()) {
-    OnSort(m_LastSortedColumn, false);
+  Capture::GFunctionStatsChanges.Take(&m_ChangedFunctions);
+  if (m_StatSortKeys.size() != m_Functions.size() || m_LastSortedColumn < 0) {
+    return;
+  }
+
+  // Only the keys of the functions whose stats changed are updated, and as
+  // few of them change from one update to the next, the previous order is
+  // patched rather than sorted again.
+  int memberID = s_HeaderMap[m_LastSortedColumn];
+  for (uint64_t address : m_ChangedFunctions) {
+    auto it = m_FunctionIndices.find(address);
+    if (it != m_FunctionIndices.end()) {
+      m_StatSortKeys[it->second] =
+          GetStatSortKey(m_Functions[it->second], memberID);
+    }
   }
+  SortIndices(m_StatSortKeys, m_StatSortAscending, /*a_Incremental=*/true);
 }
 
 //-----------------------------------------------------------------------------
@@ -5,6 +5,8 @@
 
 #include "DataView.h"
 #include "OrbitType.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 
 //-----------------------------------------------------------------------------
 class LiveFunctionsDataView : public DataView {
@@ -20,13 +22,28 @@ class LiveFunctionsDataView : public DataView {
   void OnSort(int a_Column, bool a_Toggle = true) override;
   void OnContextMenu(const std::wstring& a_Action, int a_MenuIndex,
                      std::vector<int>& a_ItemIndices) override;
+  void OnSelect(int a_Index) override;
   void OnDataChanged() override;
   void OnTimer() override;
+  bool SkipTimer() override;
 
  protected:
   Function& GetFunction(unsigned int a_Row) const;
+  // Sorts by a_Column without toggling its order.
+  void Sort(int a_Column);
+  // Whether the values of the column change with the stats of the functions.
+  static bool IsStatColumn(int a_MemberID);
+  static uint64_t GetStatSortKey(const Function* a_Function, int a_MemberID);
 
   static std::vector<int> s_HeaderMap;
   static std::vector<float> s_HeaderRatios;
   std::vector<Function*> m_Functions;
+  // Index in m_Functions of each function address.
+  absl::flat_hash_map<uint64_t, uint32_t> m_FunctionIndices;
+  // Keys of the functions when sorted by a stat column, updated for the
+  // functions whose stats changed only. Empty for the other columns.
+  std::vector<uint64_t> m_StatSortKeys;
+  bool m_StatSortAscending = false;
+  // Taken from Capture::GFunctionStatsChanges, kept to reuse its memory.
+  absl::flat_hash_set<uint64_t> m_ChangedFunctions;
 };
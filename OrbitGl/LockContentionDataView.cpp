@@ -0,0 +1,207 @@
+#include "LockContentionDataView.h"
+
+#include <algorithm>
+
+#include "App.h"
+#include "Capture.h"
+#include "Core.h"
+#include "LockContentionProfile.h"
+#include "OrbitModule.h"
+#include "OrbitProcess.h"
+#include "SamplingProfiler.h"
+
+//-----------------------------------------------------------------------------
+LockContentionDataView::LockContentionDataView() {
+  m_SortingToggles.resize(LockColumn::NumColumns, false);
+  m_UpdatePeriodMs = 1000;
+}
+
+//-----------------------------------------------------------------------------
+std::vector<int> LockContentionDataView::s_HeaderMap;
+std::vector<float> LockContentionDataView::s_HeaderRatios;
+
+//-----------------------------------------------------------------------------
+const std::vector<std::wstring>& LockContentionDataView::GetColumnHeaders() {
+  static std::vector<std::wstring> Columns;
+
+  if (s_HeaderMap.size() == 0) {
+    Columns.push_back(L"Lock");
+    s_HeaderMap.push_back(LockColumn::LockAddress);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"Call Site");
+    s_HeaderMap.push_back(LockColumn::CallSite);
+    s_HeaderRatios.push_back(0.5f);
+    Columns.push_back(L"Waits");
+    s_HeaderMap.push_back(LockColumn::Waits);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"Total Wait (ms)");
+    s_HeaderMap.push_back(LockColumn::TotalWait);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"Max Wait (ms)");
+    s_HeaderMap.push_back(LockColumn::MaxWait);
+    s_HeaderRatios.push_back(0);
+  }
+
+  return Columns;
+}
+
+//-----------------------------------------------------------------------------
+const std::vector<float>& LockContentionDataView::GetColumnHeadersRatios() {
+  return s_HeaderRatios;
+}
+
+//-----------------------------------------------------------------------------
+std::wstring LockContentionDataView::GetValue(int a_Row, int a_Column) {
+  const LockRow& row = GetRow(a_Row);
+
+  std::wstring value;
+
+  switch (s_HeaderMap[a_Column]) {
+    case LockColumn::LockAddress:
+      value = Format(L"0x%llx", row.m_LockAddress);
+      break;
+    case LockColumn::CallSite:
+      value = row.m_CallSite;
+      break;
+    case LockColumn::Waits:
+      value = Format(L"%llu", row.m_Count);
+      break;
+    case LockColumn::TotalWait:
+      value = Format(L"%.3f", row.m_TotalWaitNs / 1000000.0);
+      break;
+    case LockColumn::MaxWait:
+      value = Format(L"%.3f", row.m_MaxWaitNs / 1000000.0);
+      break;
+    default:
+      break;
+  }
+
+  return value;
+}
+
+//-----------------------------------------------------------------------------
+#define ORBIT_PROC_SORT(Member)                                            \
+  [&](int a, int b) {                                                      \
+    return OrbitUtils::Compare(rows[a].Member, rows[b].Member, ascending); \
+  }
+
+//-----------------------------------------------------------------------------
+void LockContentionDataView::OnSort(int a_Column, bool a_Toggle) {
+  std::vector<LockRow>& rows = m_Rows;
+  LockColumn column = LockColumn(s_HeaderMap[a_Column]);
+
+  if (a_Toggle) {
+    m_SortingToggles[column] = !m_SortingToggles[column];
+  }
+
+  bool ascending = m_SortingToggles[column];
+  std::function<bool(int a, int b)> sorter = nullptr;
+
+  switch (column) {
+    case LockColumn::LockAddress:
+      sorter = ORBIT_PROC_SORT(m_LockAddress);
+      break;
+    case LockColumn::CallSite:
+      sorter = ORBIT_PROC_SORT(m_CallSite);
+      break;
+    case LockColumn::Waits:
+      sorter = ORBIT_PROC_SORT(m_Count);
+      break;
+    case LockColumn::TotalWait:
+      sorter = ORBIT_PROC_SORT(m_TotalWaitNs);
+      break;
+    case LockColumn::MaxWait:
+      sorter = ORBIT_PROC_SORT(m_MaxWaitNs);
+      break;
+    default:
+      break;
+  }
+
+  if (sorter) {
+    std::sort(m_Indices.begin(), m_Indices.end(), sorter);
+  }
+
+  m_LastSortedColumn = a_Column;
+}
+
+//-----------------------------------------------------------------------------
+void LockContentionDataView::OnTimer() {
+  uint64_t waitCount = Capture::GLockContentionProfile.GetWaitCount();
+  if (waitCount == m_WaitCount) {
+    return;
+  }
+  m_WaitCount = waitCount;
+  UpdateRows();
+}
+
+//-----------------------------------------------------------------------------
+std::wstring LockContentionDataView::GetCallSiteName(CallstackID a_Id) {
+  std::shared_ptr<CallStack> callstack = Capture::GetCallstack(a_Id);
+  if (callstack == nullptr || callstack->m_Data.empty()) {
+    return L"???";
+  }
+
+  std::shared_ptr<Process> process = Capture::GTargetProcess;
+  size_t frame = 0;
+  {
+    ScopeLock lock(process->GetDataMutex());
+    frame = LockContentionProfile::FindCallSiteFrame(
+        *callstack, [&process](uint64_t a_Address) -> uint64_t {
+          std::shared_ptr<Module> module =
+              process->GetModuleFromAddress(a_Address);
+          return module != nullptr ? module->m_AddressStart : 0;
+        });
+  }
+  uint64_t address = callstack->m_Data[frame];
+  return s2ws(GOrbitApp->GetFrameStrings().GetAddressString(
+      address, FrameDisplay::kName));
+}
+
+//-----------------------------------------------------------------------------
+void LockContentionDataView::UpdateRows() {
+  m_Rows.clear();
+  for (const LockContentionProfile::Entry& entry :
+       Capture::GLockContentionProfile.GetEntries()) {
+    LockRow row;
+    row.m_LockAddress = entry.lock_address;
+    row.m_CallSite = GetCallSiteName(entry.callstack_id);
+    row.m_Count = entry.count;
+    row.m_TotalWaitNs = entry.total_wait_ns;
+    row.m_MaxWaitNs = entry.max_wait_ns;
+    m_Rows.push_back(std::move(row));
+  }
+
+  OnFilter(m_Filter);
+}
+
+//-----------------------------------------------------------------------------
+void LockContentionDataView::OnFilter(const std::wstring& a_Filter) {
+  std::vector<uint32_t> indices;
+
+  std::vector<std::wstring> tokens = Tokenize(ToLower(a_Filter));
+
+  for (uint32_t i = 0; i < m_Rows.size(); ++i) {
+    std::wstring name = ToLower(m_Rows[i].m_CallSite);
+
+    bool match = true;
+
+    for (std::wstring& filterToken : tokens) {
+      if (name.find(filterToken) == std::wstring::npos) {
+        match = false;
+        break;
+      }
+    }
+
+    if (match) {
+      indices.push_back(i);
+    }
+  }
+
+  // The entries come by decreasing total wait, which is the order until
+  // sorted otherwise.
+  m_Indices = indices;
+
+  if (m_LastSortedColumn != -1) {
+    OnSort(m_LastSortedColumn, false);
+  }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "CallstackTypes.h"
+#include "DataView.h"
+
+// The locks the threads of the target waited on the longest during the
+// capture, per lock address and per call site into the locking code, from
+// Capture::GLockContentionProfile. It updates itself as waits come in.
+class LockContentionDataView : public DataView {
+ public:
+  LockContentionDataView();
+
+  const std::vector<std::wstring>& GetColumnHeaders() override;
+  const std::vector<float>& GetColumnHeadersRatios() override;
+  std::wstring GetValue(int a_Row, int a_Column) override;
+
+  void OnFilter(const std::wstring& a_Filter) override;
+  void OnSort(int a_Column, bool a_Toggle = true) override;
+  void OnTimer() override;
+
+  enum LockColumn {
+    LockAddress,
+    CallSite,
+    Waits,
+    TotalWait,
+    MaxWait,
+    NumColumns
+  };
+
+ protected:
+  struct LockRow {
+    uint64_t m_LockAddress = 0;
+    std::wstring m_CallSite;
+    uint64_t m_Count = 0;
+    uint64_t m_TotalWaitNs = 0;
+    uint64_t m_MaxWaitNs = 0;
+  };
+
+  void UpdateRows();
+  std::wstring GetCallSiteName(CallstackID a_Id);
+  const LockRow& GetRow(unsigned int a_Row) const {
+    return m_Rows[m_Indices[a_Row]];
+  }
+
+  uint64_t m_WaitCount = 0;
+  std::vector<LockRow> m_Rows;
+
+  static std::vector<int> s_HeaderMap;
+  static std::vector<float> s_HeaderRatios;
+};
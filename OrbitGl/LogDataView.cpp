@@ -1,5 +1,6 @@
 #include "LogDataView.h"
 
+#include <algorithm>
 #include <chrono>
 
 #include "App.h"
@@ -38,9 +39,15 @@ const std::vector<float>& LogDataView::GetColumnHeadersRatios() {
   return s_HeaderRatios;
 }
 
+//-----------------------------------------------------------------------------
+size_t LogDataView::GetNumElements() {
+  return HasAllRows() ? m_EndId - m_FirstId
+                      : m_MatchingIds.size() - m_FirstMatch;
+}
+
 //-----------------------------------------------------------------------------
 std::wstring LogDataView::GetValue(int a_Row, int a_Column) {
-  const OrbitLogEntry& entry = GetEntry(a_Row);
+  OrbitLogEntry entry = GetEntry(a_Row);
   std::wstring value;
 
   switch (a_Column) {
@@ -84,54 +91,99 @@ std::wstring LogDataView::GetToolTip(int /*row*/, int /*column*/) {
 bool LogDataView::ScrollToBottom() { return true; }
 
 //-----------------------------------------------------------------------------
-bool LogDataView::SkipTimer() { return !Capture::IsCapturing(); }
-
-//-----------------------------------------------------------------------------
-void LogDataView::OnDataChanged() {
-  ScopeLock lock(m_Mutex);
-  m_Indices.resize(m_Entries.size());
-  for (uint32_t i = 0; i < m_Entries.size(); ++i) {
-    m_Indices[i] = i;
-  }
+bool LogDataView::SkipTimer() {
+  if (Capture::IsCapturing()) return false;
+  // The entries received last still need to be shown.
+  ScopeLock lock(Capture::GLogMutex);
+  return m_EndId == Capture::GLogBuffer.end_id() &&
+         m_FirstId == Capture::GLogBuffer.begin_id();
 }
 
 //-----------------------------------------------------------------------------
-void LogDataView::OnFilter(const std::wstring& a_Filter) {
-  std::vector<std::string> tokens = Tokenize(ToLower(ws2s(a_Filter)));
-  std::vector<uint32_t> indices;
+void LogDataView::OnTimer() { UpdateRows(); }
 
-  for (uint32_t i = 0; i < m_Entries.size(); ++i) {
-    const OrbitLogEntry& entry = m_Entries[i];
-    std::string text = ToLower(entry.m_Text);
-
-    bool match = true;
+//-----------------------------------------------------------------------------
+void LogDataView::OnDataChanged() { UpdateRows(); }
 
-    for (std::string& filterToken : tokens) {
-      if (!(text.find(filterToken) != std::wstring::npos)) {
-        match = false;
-        break;
-      }
+//-----------------------------------------------------------------------------
+void LogDataView::UpdateRows() {
+  ScopeLock lock(Capture::GLogMutex);
+  const LogBuffer& buffer = Capture::GLogBuffer;
+  m_FirstId = buffer.begin_id();
+  if (m_HasTimeRange) {
+    // Found by binary search on the index of the thread, so cheap to redo.
+    m_MatchingIds =
+        buffer.FindInTimeRange(m_TimeRangeThreadId, m_MinTime, m_MaxTime);
+    auto isNotMatch = [&](uint64_t id) {
+      return !buffer.Matches(id, m_FilterTokens);
+    };
+    m_MatchingIds.erase(std::remove_if(m_MatchingIds.begin(),
+                                       m_MatchingIds.end(), isNotMatch),
+                        m_MatchingIds.end());
+    m_FirstMatch = 0;
+  } else if (!m_FilterTokens.empty()) {
+    buffer.Find(m_FilterTokens, m_EndId, buffer.end_id(), &m_MatchingIds);
+    while (m_FirstMatch < m_MatchingIds.size() &&
+           m_MatchingIds[m_FirstMatch] < m_FirstId) {
+      ++m_FirstMatch;
     }
-
-    if (match) {
-      indices.push_back(i);
+    // The ids dropped are only erased once they are half of them, for
+    // erasing to stay linear in the number of matches.
+    if (m_FirstMatch > m_MatchingIds.size() / 2) {
+      m_MatchingIds.erase(m_MatchingIds.begin(),
+                          m_MatchingIds.begin() + m_FirstMatch);
+      m_FirstMatch = 0;
     }
   }
+  m_EndId = buffer.end_id();
+}
+
+//-----------------------------------------------------------------------------
+void LogDataView::OnFilter(const std::wstring& a_Filter) {
+  m_FilterTokens = Tokenize(ToLower(ws2s(a_Filter)));
+  m_MatchingIds.clear();
+  m_FirstMatch = 0;
+  m_EndId = 0;
+  UpdateRows();
+}
 
-  m_Indices = indices;
+//-----------------------------------------------------------------------------
+void LogDataView::SetTimeRange(TickType a_MinTime, TickType a_MaxTime,
+                               ThreadID a_ThreadId) {
+  m_HasTimeRange = true;
+  m_MinTime = a_MinTime;
+  m_MaxTime = a_MaxTime;
+  m_TimeRangeThreadId = a_ThreadId;
+  UpdateRows();
+}
+
+//-----------------------------------------------------------------------------
+void LogDataView::ClearTimeRange() {
+  m_HasTimeRange = false;
+  m_MatchingIds.clear();
+  m_FirstMatch = 0;
+  m_EndId = 0;
+  UpdateRows();
 }
 
+//-----------------------------------------------------------------------------
+const std::wstring LOG_SHOW_ALL_TIMES = L"Show All Times";
+
 //-----------------------------------------------------------------------------
 std::vector<std::wstring> LogDataView::GetContextMenu(int a_Index) {
-  const OrbitLogEntry& entry = LogDataView::GetEntry(a_Index);
+  OrbitLogEntry entry = LogDataView::GetEntry(a_Index);
   m_SelectedCallstack = Capture::GetCallstack(entry.m_CallstackHash);
   std::vector<std::wstring> menu;
   if (m_SelectedCallstack) {
+    FrameStringCache& frameStrings = GOrbitApp->GetFrameStrings();
     for (uint32_t i = 0; i < m_SelectedCallstack->m_Depth; ++i) {
-      DWORD64 addr = m_SelectedCallstack->m_Data[i];
-      menu.push_back(Capture::GSamplingProfiler->GetSymbolFromAddress(addr));
+      menu.push_back(s2ws(frameStrings.GetFrameString(
+          *m_SelectedCallstack, i, FrameDisplay::kName)));
     }
   }
+  if (m_HasTimeRange) {
+    menu.push_back(LOG_SHOW_ALL_TIMES);
+  }
   Append(menu, DataView::GetContextMenu(a_Index));
   return menu;
 }
@@ -139,7 +191,9 @@ std::vector<std::wstring> LogDataView::GetContextMenu(int a_Index) {
 //-----------------------------------------------------------------------------
 void LogDataView::OnContextMenu(const std::wstring& a_Action, int a_MenuIndex,
                                 std::vector<int>& a_ItemIndices) {
-  if (m_SelectedCallstack && (int)m_SelectedCallstack->m_Depth > a_MenuIndex) {
+  if (a_Action == LOG_SHOW_ALL_TIMES) {
+    ClearTimeRange();
+  } else if (m_SelectedCallstack && (int)m_SelectedCallstack->m_Depth > a_MenuIndex) {
     GOrbitApp->GoToCode(m_SelectedCallstack->m_Data[a_MenuIndex]);
   } else {
     DataView::OnContextMenu(a_Action, a_MenuIndex, a_ItemIndices);
@@ -148,14 +202,32 @@ void LogDataView::OnContextMenu(const std::wstring& a_Action, int a_MenuIndex,
 
 //-----------------------------------------------------------------------------
 void LogDataView::Add(const OrbitLogEntry& a_Msg) {
-  ScopeLock lock(m_Mutex);
-  m_Entries.push_back(a_Msg);
-  OnDataChanged();
+  // Shown on the next update of the rows, for the rows not to change under
+  // the view.
+  ScopeLock lock(Capture::GLogMutex);
+  Capture::GLogBuffer.Add(a_Msg.m_Time, a_Msg.m_CallstackHash,
+                          a_Msg.m_ThreadId, a_Msg.m_Text);
+}
+
+//-----------------------------------------------------------------------------
+uint64_t LogDataView::GetEntryId(unsigned int a_Row) const {
+  return HasAllRows() ? m_FirstId + a_Row
+                      : m_MatchingIds[m_FirstMatch + a_Row];
 }
 
 //-----------------------------------------------------------------------------
-const OrbitLogEntry& LogDataView::GetEntry(unsigned int a_Row) const {
-  return m_Entries[m_Indices[a_Row]];
+OrbitLogEntry LogDataView::GetEntry(unsigned int a_Row) {
+  OrbitLogEntry entry;
+  ScopeLock lock(Capture::GLogMutex);
+  uint64_t id = GetEntryId(a_Row);
+  // Dropped since the last update of the rows.
+  if (!Capture::GLogBuffer.Contains(id)) return entry;
+  LogBuffer::Entry bufferEntry = Capture::GLogBuffer.Get(id);
+  entry.m_Time = bufferEntry.time;
+  entry.m_CallstackHash = bufferEntry.callstack_hash;
+  entry.m_ThreadId = bufferEntry.thread_id;
+  entry.m_Text = bufferEntry.text;
+  return entry;
 }
 
 //-----------------------------------------------------------------------------
@@ -3,8 +3,10 @@
 //-----------------------------------
 #pragma once
 
+#include "CallstackTypes.h"
 #include "DataView.h"
 #include "Message.h"
+#include "Profiling.h"
 #include "Threading.h"
 
 struct CallStack;
@@ -16,25 +18,51 @@ class LogDataView : public DataView {
   virtual const std::vector<std::wstring>& GetColumnHeaders() override;
   const std::vector<float>& GetColumnHeadersRatios() override;
   virtual std::vector<std::wstring> GetContextMenu(int a_Index) override;
+  size_t GetNumElements() override;
   virtual std::wstring GetValue(int a_Row, int a_Column) override;
   virtual std::wstring GetToolTip(int a_Row, int a_Column) override;
   virtual bool ScrollToBottom() override;
   virtual bool SkipTimer() override;
 
+  void OnTimer() override;
   void OnDataChanged() override;
   void OnFilter(const std::wstring& a_Filter) override;
   void OnContextMenu(const std::wstring& a_Action, int a_MenuIndex,
                      std::vector<int>& a_ItemIndices) override;
 
   void Add(const OrbitLogEntry& a_Msg);
-  const OrbitLogEntry& GetEntry(unsigned int a_Row) const;
+  // Only shows the entries of a_ThreadId, or of all threads if 0, in
+  // [a_MinTime, a_MaxTime], e.g. the selection of the time graph.
+  void SetTimeRange(TickType a_MinTime, TickType a_MaxTime,
+                    ThreadID a_ThreadId);
+  void ClearTimeRange();
+  // A copy, as the entry can be dropped from Capture::GLogBuffer as soon as
+  // the lock is released.
+  OrbitLogEntry GetEntry(unsigned int a_Row);
   void OnReceiveMessage(const Message& a_Msg);
 
   enum OdvColumn { LDV_Message, LDV_Time, LDV_ThreadId, LDV_NumColumns };
 
  protected:
-  std::vector<OrbitLogEntry> m_Entries;
-  Mutex m_Mutex;
+  // Matches the entries added since the last update against the filter, and
+  // forgets the rows of the entries dropped since. The rows only change
+  // here, on the UI thread.
+  void UpdateRows();
+  uint64_t GetEntryId(unsigned int a_Row) const;
+  bool HasAllRows() const { return m_FilterTokens.empty() && !m_HasTimeRange; }
+
+  std::vector<std::string> m_FilterTokens;
+  bool m_HasTimeRange = false;
+  TickType m_MinTime = 0;
+  TickType m_MaxTime = 0;
+  ThreadID m_TimeRangeThreadId = 0;
+  // Without a filter or a time range, the rows are the entries
+  // [m_FirstId, m_EndId). Otherwise they are the ids in m_MatchingIds, from
+  // m_FirstMatch, the entries before m_EndId matching them.
+  uint64_t m_FirstId = 0;
+  uint64_t m_EndId = 0;
+  std::vector<uint64_t> m_MatchingIds;
+  size_t m_FirstMatch = 0;
   std::shared_ptr<CallStack> m_SelectedCallstack;
   static std::vector<float> s_HeaderRatios;
 };
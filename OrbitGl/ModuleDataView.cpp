@@ -5,12 +5,19 @@
 #include "ModuleDataView.h"
 
 #include "App.h"
+#include "Capture.h"
 #include "Core.h"
 #include "OrbitModule.h"
+#include "SamplingProfiler.h"
+#include "SamplingReport.h"
+#include "absl/strings/str_format.h"
 
 //-----------------------------------------------------------------------------
 ModulesDataView::ModulesDataView() {
   m_SortingToggles.resize(MDV_NumColumns, false);
+  m_SortingToggles[MDV_Inclusive] = true;
+  m_SortingToggles[MDV_Exclusive] = true;
+  m_UpdatePeriodMs = SamplingReport::kLiveUpdatePeriodMs;
 
   GOrbitApp->RegisterModulesDataView(this);
 }
@@ -26,6 +33,10 @@ const std::vector<std::wstring>& ModulesDataView::GetColumnHeaders() {
     s_HeaderRatios.push_back(0);
     Columns.push_back(L"Name");
     s_HeaderRatios.push_back(0.2f);
+    Columns.push_back(L"Inclusive");
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"Exclusive");
+    s_HeaderRatios.push_back(0);
     Columns.push_back(L"Path");
     s_HeaderRatios.push_back(0.3f);
     Columns.push_back(L"Address Range");
@@ -57,6 +68,18 @@ std::wstring ModulesDataView::GetValue(int row, int col) {
     case MDV_ModuleName:
       value = module->m_Name;
       break;
+    case MDV_Inclusive: {
+      unsigned int inclusive = GetCost(*module).inclusive;
+      value = inclusive > 0 ? absl::StrFormat("%.2f", GetPercent(inclusive))
+                            : "";
+      break;
+    }
+    case MDV_Exclusive: {
+      unsigned int exclusive = GetCost(*module).exclusive;
+      value = exclusive > 0 ? absl::StrFormat("%.2f", GetPercent(exclusive))
+                            : "";
+      break;
+    }
     case MDV_Path:
       value = module->m_FullName;
       break;
@@ -101,6 +124,20 @@ void ModulesDataView::OnSort(int a_Column, bool a_Toggle) {
     case MDV_ModuleName:
       sorter = ORBIT_PROC_SORT(m_Name);
       break;
+    case MDV_Inclusive:
+      sorter = [&](int a, int b) {
+        return OrbitUtils::Compare(GetCost(*m_Modules[a]).inclusive,
+                                   GetCost(*m_Modules[b]).inclusive,
+                                   ascending);
+      };
+      break;
+    case MDV_Exclusive:
+      sorter = [&](int a, int b) {
+        return OrbitUtils::Compare(GetCost(*m_Modules[a]).exclusive,
+                                   GetCost(*m_Modules[b]).exclusive,
+                                   ascending);
+      };
+      break;
     case MDV_Path:
       sorter = ORBIT_PROC_SORT(m_FullName);
       break;
@@ -131,6 +168,7 @@ void ModulesDataView::OnSort(int a_Column, bool a_Toggle) {
 const std::wstring MODULES_LOAD = L"Load Symbols";
 const std::wstring DLL_FIND_PDB = L"Find Pdb";
 const std::wstring DLL_EXPORTS = L"Load Symbols";
+const std::wstring MODULES_FILTER_SAMPLING = L"Filter Sampling Report";
 
 //-----------------------------------------------------------------------------
 std::vector<std::wstring> ModulesDataView::GetContextMenu(int a_Index) {
@@ -144,6 +182,9 @@ std::vector<std::wstring> ModulesDataView::GetContextMenu(int a_Index) {
       menu = {DLL_EXPORTS, DLL_FIND_PDB};
     }
   }
+  if (GetCost(*module).inclusive > 0) {
+    menu.push_back(MODULES_FILTER_SAMPLING);
+  }
 
   Append(menu, DataView::GetContextMenu(a_Index));
   return menu;
@@ -173,6 +214,11 @@ void ModulesDataView::OnContextMenu(const std::wstring& a_Action,
     }
 
     GOrbitApp->LoadModules();
+  } else if (a_Action == MODULES_FILTER_SAMPLING) {
+    if (!a_ItemIndices.empty()) {
+      const std::shared_ptr<Module>& module = GetModule(a_ItemIndices[0]);
+      GOrbitApp->FilterSamplingReport(s2ws(module->m_Name));
+    }
   } else if (a_Action == DLL_FIND_PDB) {
     std::wstring FileName =
         GOrbitApp->FindFile(L"Find Pdb File", L"", L"*.pdb");
@@ -182,7 +228,35 @@ void ModulesDataView::OnContextMenu(const std::wstring& a_Action,
 }
 
 //-----------------------------------------------------------------------------
-void ModulesDataView::OnTimer() {}
+void ModulesDataView::OnTimer() {
+  UpdateCosts();
+  if (m_LastSortedColumn == MDV_Inclusive ||
+      m_LastSortedColumn == MDV_Exclusive) {
+    OnSort(m_LastSortedColumn, false);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void ModulesDataView::UpdateCosts() {
+  std::shared_ptr<SamplingProfiler> profiler = Capture::GSamplingProfiler;
+  if (profiler == nullptr) {
+    m_Costs.clear();
+    m_NumSamples = 0;
+    return;
+  }
+  m_Costs = profiler->GetModuleCosts(&m_NumSamples);
+}
+
+//-----------------------------------------------------------------------------
+ModuleCosts::Cost ModulesDataView::GetCost(const Module& a_Module) const {
+  auto it = m_Costs.find(a_Module.m_AddressStart);
+  return it != m_Costs.end() ? it->second : ModuleCosts::Cost();
+}
+
+//-----------------------------------------------------------------------------
+float ModulesDataView::GetPercent(unsigned int a_Count) const {
+  return m_NumSamples > 0 ? 100.f * a_Count / m_NumSamples : 0.f;
+}
 
 //-----------------------------------------------------------------------------
 void ModulesDataView::OnFilter(const std::wstring& a_Filter) {
@@ -4,8 +4,10 @@
 #pragma once
 
 #include "DataView.h"
+#include "ModuleCosts.h"
 #include "OrbitType.h"
 #include "ProcessUtils.h"
+#include "absl/container/flat_hash_map.h"
 
 class ModulesDataView : public DataView {
  public:
@@ -31,6 +33,8 @@ class ModulesDataView : public DataView {
   enum MdvColumn {
     MDV_Index,
     MDV_ModuleName,
+    MDV_Inclusive,
+    MDV_Exclusive,
     MDV_Path,
     MDV_AddressRange,
     MDV_HasPdb,
@@ -41,9 +45,15 @@ class ModulesDataView : public DataView {
 
  protected:
   const std::shared_ptr<Module>& GetModule(unsigned int a_Row) const;
+  void UpdateCosts();
+  ModuleCosts::Cost GetCost(const Module& a_Module) const;
+  float GetPercent(unsigned int a_Count) const;
 
  protected:
   std::shared_ptr<Process> m_Process;
   std::vector<std::shared_ptr<Module> > m_Modules;
+  // Samples of the sampling profiler by module start, refreshed live.
+  absl::flat_hash_map<uint64_t, ModuleCosts::Cost> m_Costs;
+  unsigned int m_NumSamples = 0;
   static std::vector<float> s_HeaderRatios;
 };
@@ -7,6 +7,16 @@
 #include "../OrbitPlugin/OrbitSDK.h"
 #include "Core.h"
 #include "TcpServer.h"
+#include "UserDataBatch.h"
+
+namespace {
+// The batch as received, with the entries decoded in place.
+struct UserDataBatch {
+  explicit UserDataBatch(const Message& a_Msg) : m_Message(a_Msg) {}
+  MessageOwner m_Message;
+  std::vector<Orbit::UserData> m_Entries;
+};
+}  // namespace
 
 PluginManager GPluginManager;
 
@@ -26,12 +36,17 @@ void PluginManager::Initialize() {
       static int count = 0;
       newPlugin->SetPluginID(count++);
       m_Plugins.push_back(newPlugin);
+      m_Subscriptions.push_back(std::make_unique<Subscription>());
     }
   }
+  m_DataWorkers = std::make_unique<MessageWorkerPool>(kNumDataWorkers);
 
   GTcpServer->AddCallback(Msg_UserData, [=](const Message& a_Msg) {
     this->OnReceiveUserData(a_Msg);
   });
+  GTcpServer->AddCallback(Msg_UserDataBatch, [=](const Message& a_Msg) {
+    this->OnReceiveUserDataBatch(a_Msg);
+  });
   GTcpServer->AddCallback(Msg_OrbitData, [=](const Message& a_Msg) {
     this->OnReceiveOrbitData(a_Msg);
   });
@@ -50,6 +65,44 @@ void PluginManager::OnReceiveUserData(const Message& a_Msg) {
   }
 }
 
+//-----------------------------------------------------------------------------
+void PluginManager::OnReceiveUserDataBatch(const Message& a_Msg) {
+  if (m_Plugins.empty()) return;
+
+  // Copied once out of the receive buffer, then shared by all the plugins.
+  auto batch = std::make_shared<UserDataBatch>(a_Msg);
+  if (!DecodeUserDataBatch(batch->m_Message.GetData(),
+                           batch->m_Message.m_Size, &batch->m_Entries)) {
+    PRINT("Dropping corrupted user data batch\n");
+    return;
+  }
+  if (batch->m_Entries.empty()) return;
+
+  for (size_t i = 0; i < m_Plugins.size(); ++i) {
+    Orbit::Plugin* plugin = m_Plugins[i];
+    Subscription* subscription = m_Subscriptions[i].get();
+    if (subscription->m_NumPendingBatches >=
+        plugin->GetMaxPendingUserDataBatches()) {
+      subscription->m_NumDropped += batch->m_Entries.size();
+      continue;
+    }
+
+    ++subscription->m_NumPendingBatches;
+    m_DataWorkers->Post(static_cast<uint32_t>(i),
+                        [plugin, subscription, batch] {
+                          size_t numDropped =
+                              subscription->m_NumDropped.exchange(0);
+                          if (numDropped > 0) {
+                            plugin->OnUserDataDropped(numDropped);
+                          }
+                          plugin->ReceiveUserDataBatch(
+                              batch->m_Entries.data(),
+                              batch->m_Entries.size());
+                          --subscription->m_NumPendingBatches;
+                        });
+  }
+}
+
 //-----------------------------------------------------------------------------
 void PluginManager::OnReceiveOrbitData(const Message& a_Msg) {
   if (a_Msg.GetType() == Msg_OrbitData) {
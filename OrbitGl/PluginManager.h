@@ -3,8 +3,12 @@
 //-----------------------------------
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <vector>
 
+#include "MessageWorkerPool.h"
+
 namespace Orbit {
 class Plugin;
 }
@@ -15,9 +19,21 @@ class PluginManager {
   void Initialize();
 
   void OnReceiveUserData(const Message& a_Msg);
+  void OnReceiveUserDataBatch(const Message& a_Msg);
   void OnReceiveOrbitData(const Message& a_Msg);
 
   std::vector<Orbit::Plugin*> m_Plugins;
+
+ protected:
+  // The user data of a plugin is received on the stream of its index.
+  struct Subscription {
+    std::atomic<size_t> m_NumPendingBatches = 0;
+    std::atomic<size_t> m_NumDropped = 0;
+  };
+  static constexpr size_t kNumDataWorkers = 2;
+
+  std::vector<std::unique_ptr<Subscription>> m_Subscriptions;
+  std::unique_ptr<MessageWorkerPool> m_DataWorkers;
 };
 
 extern PluginManager GPluginManager;
\ No newline at end of file
@@ -4,6 +4,9 @@
 
 #include "ProcessDataView.h"
 
+#include <limits>
+#include <unordered_set>
+
 #include "App.h"
 #include "Callstack.h"
 #include "Capture.h"
@@ -11,6 +14,7 @@
 #include "OrbitType.h"
 #include "Params.h"
 #include "Pdb.h"
+#include "ProcessInfoLoader.h"
 #include "TcpClient.h"
 
 //-----------------------------------------------------------------------------
@@ -19,6 +23,7 @@ ProcessesDataView::ProcessesDataView() {
   UpdateProcessList();
   m_UpdatePeriodMs = 1000;
   m_IsRemote = false;
+  m_ProcessListGeneration = 0;
 
   GOrbitApp->RegisterProcessesDataView(this);
 }
@@ -138,14 +143,20 @@ void ProcessesDataView::OnSort(int a_Column, bool a_Toggle) {
 //-----------------------------------------------------------------------------
 void ProcessesDataView::OnSelect(int a_Index) {
   m_SelectedProcess = GetProcess(a_Index);
-  UpdateModuleDataView(m_SelectedProcess);
+  // Selected by the user, who doesn't wait for the modules to be listed.
+  UpdateModuleDataView(m_SelectedProcess, /*a_ListAsync=*/true);
 }
 
 void ProcessesDataView::UpdateModuleDataView(
-    std::shared_ptr<Process> a_Process) {
+    std::shared_ptr<Process> a_Process, bool a_ListAsync) {
   if (m_ModulesDataView) {
     if (!m_IsRemote) {
-      a_Process->ListModules();
+      if (a_ListAsync) {
+        // Shown once listed, see OrbitApp::OnProcessListed.
+        GProcessInfoLoader.ListAsync(a_Process);
+      } else {
+        GProcessInfoLoader.List(a_Process);
+      }
     } else if (a_Process->GetModules().size() == 0) {
       Message msg(Msg_RemoteProcessRequest);
       msg.m_Header.m_GenericHeader.m_Address = a_Process->GetID();
@@ -181,14 +192,15 @@ void ProcessesDataView::Refresh() {
       SetSelectedItem();
     }
   } else {
+    // The remote list is kept up to date by ApplyRemoteProcessListDiff.
     if (!m_IsRemote) {
       m_ProcessList.Refresh();
       m_ProcessList.UpdateCpuTimes();
+      UpdateProcessList();
+      OnSort(m_LastSortedColumn, false);
+      OnFilter(m_Filter);
+      SetSelectedItem();
     }
-    UpdateProcessList();
-    OnSort(m_LastSortedColumn, false);
-    OnFilter(m_Filter);
-    SetSelectedItem();
 
     if (Capture::GTargetProcess && !Capture::IsCapturing()) {
       Capture::GTargetProcess->UpdateThreadUsage();
@@ -231,7 +243,8 @@ bool ProcessesDataView::SelectProcess(const std::wstring& a_ProcessName) {
   for (uint32_t i = 0; i < GetNumElements(); ++i) {
     Process& process = *GetProcess(i);
     if (process.GetFullName().find(ws2s(a_ProcessName)) != std::string::npos) {
-      OnSelect(i);
+      m_SelectedProcess = GetProcess(i);
+      UpdateModuleDataView(m_SelectedProcess);
       Capture::GPresetToLoad = "";
       return true;
     }
@@ -247,7 +260,8 @@ std::shared_ptr<Process> ProcessesDataView::SelectProcess(DWORD a_ProcessId) {
   for (uint32_t i = 0; i < GetNumElements(); ++i) {
     Process& process = *GetProcess(i);
     if (process.GetID() == a_ProcessId) {
-      OnSelect(i);
+      m_SelectedProcess = GetProcess(i);
+      UpdateModuleDataView(m_SelectedProcess);
       Capture::GPresetToLoad = "";
       return m_SelectedProcess;
     }
@@ -256,6 +270,22 @@ std::shared_ptr<Process> ProcessesDataView::SelectProcess(DWORD a_ProcessId) {
   return nullptr;
 }
 
+//-----------------------------------------------------------------------------
+static bool MatchesFilter(const Process& a_Process,
+                          const std::vector<std::wstring>& a_Tokens) {
+  std::wstring name = s2ws(ToLower(a_Process.GetName()));
+  std::wstring type = a_Process.GetIs64Bit() ? L"64" : L"32";
+
+  for (const std::wstring& filterToken : a_Tokens) {
+    if (!(name.find(filterToken) != std::wstring::npos ||
+          type.find(filterToken) != std::wstring::npos)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 //-----------------------------------------------------------------------------
 void ProcessesDataView::OnFilter(const std::wstring& a_Filter) {
   std::vector<uint32_t> indices;
@@ -265,21 +295,7 @@ void ProcessesDataView::OnFilter(const std::wstring& a_Filter) {
   std::vector<std::wstring> tokens = Tokenize(ToLower(a_Filter));
 
   for (uint32_t i = 0; i < processes.size(); ++i) {
-    const Process& process = *processes[i];
-    std::wstring name = s2ws(ToLower(process.GetName()));
-    std::wstring type = process.GetIs64Bit() ? L"64" : L"32";
-
-    bool match = true;
-
-    for (std::wstring& filterToken : tokens) {
-      if (!(name.find(filterToken) != std::wstring::npos ||
-            type.find(filterToken) != std::wstring::npos)) {
-        match = false;
-        break;
-      }
-    }
-
-    if (match) {
+    if (MatchesFilter(*processes[i], tokens)) {
       indices.push_back(i);
     }
   }
@@ -311,6 +327,97 @@ void ProcessesDataView::SetRemoteProcessList(
   SetSelectedItem();
 }
 
+//-----------------------------------------------------------------------------
+bool ProcessesDataView::ApplyRemoteProcessListDiff(
+    const ProcessListDiff& a_Diff) {
+  if (a_Diff.IsFull()) {
+    m_IsRemote = true;
+    m_ProcessList.Clear();
+    for (const std::shared_ptr<Process>& process : a_Diff.m_AddedProcesses) {
+      m_ProcessList.m_Processes.push_back(process);
+      m_ProcessList.m_ProcessesMap[process->GetID()] = process;
+    }
+    m_ProcessListGeneration = a_Diff.m_Generation;
+    UpdateProcessList();
+    OnSort(m_LastSortedColumn, false);
+    OnFilter(m_Filter);
+    SetSelectedItem();
+    return true;
+  }
+
+  if (a_Diff.m_BaseGeneration != m_ProcessListGeneration) {
+    return false;
+  }
+  m_ProcessListGeneration = a_Diff.m_Generation;
+
+  std::vector<std::shared_ptr<Process>>& processes = m_ProcessList.m_Processes;
+  std::unordered_map<uint32_t, std::shared_ptr<Process>>& processesMap =
+      m_ProcessList.m_ProcessesMap;
+
+  // Processes replaced by another of the same pid go away, to be added back.
+  std::unordered_set<uint32_t> removedPids(a_Diff.m_RemovedPids.begin(),
+                                           a_Diff.m_RemovedPids.end());
+  for (const std::shared_ptr<Process>& process : a_Diff.m_AddedProcesses) {
+    if (processesMap.count(process->GetID()) != 0) {
+      removedPids.insert(process->GetID());
+    }
+  }
+
+  // Compacts the processes and the rows, keeping the order of both, so that
+  // the rows stay sorted.
+  if (!removedPids.empty()) {
+    constexpr uint32_t kRemoved = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> newIndices(processes.size());
+    uint32_t numProcesses = 0;
+    for (uint32_t i = 0; i < processes.size(); ++i) {
+      uint32_t pid = processes[i]->GetID();
+      if (removedPids.count(pid) != 0) {
+        processesMap.erase(pid);
+        newIndices[i] = kRemoved;
+      } else {
+        newIndices[i] = numProcesses;
+        processes[numProcesses++] = std::move(processes[i]);
+      }
+    }
+    processes.resize(numProcesses);
+
+    size_t numRows = 0;
+    for (uint32_t index : m_Indices) {
+      if (newIndices[index] != kRemoved) {
+        m_Indices[numRows++] = newIndices[index];
+      }
+    }
+    m_Indices.resize(numRows);
+  }
+
+  std::vector<std::wstring> tokens = Tokenize(ToLower(m_Filter));
+  for (const std::shared_ptr<Process>& process : a_Diff.m_AddedProcesses) {
+    processesMap[process->GetID()] = process;
+    processes.push_back(process);
+    if (MatchesFilter(*process, tokens)) {
+      m_Indices.push_back(static_cast<uint32_t>(processes.size() - 1));
+    }
+  }
+
+  for (const ProcessCpuUsage& cpuUsage : a_Diff.m_CpuUsages) {
+    auto it = processesMap.find(cpuUsage.m_Pid);
+    if (it != processesMap.end()) {
+      it->second->SetCpuUsage(cpuUsage.m_CpuUsage);
+    }
+  }
+
+  // Sorted by CPU usage when no column was.
+  bool sortedByCpu =
+      m_LastSortedColumn == -1 || m_LastSortedColumn == PDV_CPU;
+  if (!a_Diff.m_AddedProcesses.empty() ||
+      (sortedByCpu && !a_Diff.m_CpuUsages.empty())) {
+    OnSort(m_LastSortedColumn, false);
+  } else {
+    SetSelectedItem();
+  }
+  return true;
+}
+
 //-----------------------------------------------------------------------------
 void ProcessesDataView::SetRemoteProcess(std::shared_ptr<Process> a_Process) {
   std::shared_ptr<Process> targetProcess =
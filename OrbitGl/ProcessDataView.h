@@ -4,6 +4,7 @@
 #pragma once
 
 #include "DataView.h"
+#include "ProcessListDiff.h"
 #include "ProcessUtils.h"
 
 class ProcessesDataView : public DataView {
@@ -24,12 +25,19 @@ class ProcessesDataView : public DataView {
   std::shared_ptr<Process> SelectProcess(DWORD a_ProcessId);
   void UpdateProcessList();
   void SetRemoteProcessList(std::shared_ptr<ProcessList> a_RemoteProcessList);
+  // Updates the rows in place, re-sorting only when the sorted column
+  // changed. Returns false, leaving the list as is, if the diff is based on
+  // another list than this one, in which case the whole list is needed.
+  bool ApplyRemoteProcessListDiff(const ProcessListDiff& a_Diff);
   void SetRemoteProcess(std::shared_ptr<Process> a_Process);
   void SetModulesDataView(class ModulesDataView* a_ModulesCtrl) {
     m_ModulesDataView = a_ModulesCtrl;
   }
   void Refresh();
-  void UpdateModuleDataView(std::shared_ptr<Process> a_Process);
+  // Lists the modules of a_Process, on a worker thread if a_ListAsync, in
+  // which case they are shown once listed.
+  void UpdateModuleDataView(std::shared_ptr<Process> a_Process,
+                            bool a_ListAsync = false);
   void SetIsRemote(bool a_Value) { m_IsRemote = a_Value; }
 
   std::shared_ptr<Process> GetSelectedProcess() const {
@@ -52,6 +60,8 @@ class ProcessesDataView : public DataView {
   void ClearSelectedProcess();
 
   ProcessList m_ProcessList;
+  // Of the remote process list, 0 when there is none.
+  uint64_t m_ProcessListGeneration;
   std::shared_ptr<Process> m_RemoteProcess;
   ModulesDataView* m_ModulesDataView;
   std::shared_ptr<Process> m_SelectedProcess;
@@ -0,0 +1,48 @@
+#include "RenderStats.h"
+
+#include <algorithm>
+
+#include "VertexBuffer.h"
+
+//-----------------------------------------------------------------------------
+const char* RenderStats::GetName(Section a_Section) {
+  switch (a_Section) {
+    case UPDATE_PRIMITIVES:
+      return "UpdatePrimitives";
+    case UPDATE_PRIMITIVES_WORKERS:
+      return "UpdatePrimitives workers";
+    case UPDATE_EVENTS:
+      return "UpdateEvents";
+    case DRAW_BUFFERED:
+      return "DrawBuffered";
+    case DRAW_TEXT:
+      return "DrawText";
+    case PICKING:
+      return "Picking";
+    case NUM_SECTIONS:
+      break;
+  }
+  return "";
+}
+
+//-----------------------------------------------------------------------------
+void RenderStats::BeginFrame() {
+  uint64_t bytesUploaded = VertexBuffer::GetNumBytesUploaded();
+  m_Frame.m_NumBytesUploaded = bytesUploaded - m_FrameStartBytesUploaded;
+  m_FrameStartBytesUploaded = bytesUploaded;
+
+  m_History[m_NumFrames % kNumFrames] = m_Frame.m_Millis;
+  ++m_NumFrames;
+  m_LastFrame = m_Frame;
+  m_Frame = Frame();
+}
+
+//-----------------------------------------------------------------------------
+double RenderStats::GetMaxMillis(Section a_Section) const {
+  double maxMillis = 0;
+  size_t numFrames = std::min(m_NumFrames, kNumFrames);
+  for (size_t i = 0; i < numFrames; ++i) {
+    maxMillis = std::max(maxMillis, m_History[i][a_Section]);
+  }
+  return maxMillis;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "ScopeTimer.h"
+
+//-----------------------------------------------------------------------------
+// Cost of the frames of the capture window, shown by its stats overlay so that
+// slow rendering can be reported with numbers. Times and counts accumulate in
+// the current frame until BeginFrame ends it; the last frames are kept to show
+// their worst time too. Only used from the thread rendering.
+class RenderStats {
+ public:
+  enum Section {
+    UPDATE_PRIMITIVES,
+    // Generating the primitives of the tracks, summed over the workers, in the
+    // frame the update is applied.
+    UPDATE_PRIMITIVES_WORKERS,
+    UPDATE_EVENTS,
+    DRAW_BUFFERED,
+    DRAW_TEXT,
+    PICKING,
+    NUM_SECTIONS
+  };
+
+  struct Frame {
+    std::array<double, NUM_SECTIONS> m_Millis = {};
+    uint64_t m_NumBoxes = 0;
+    uint64_t m_NumLines = 0;
+    uint64_t m_NumGlyphs = 0;
+    uint64_t m_NumBytesUploaded = 0;
+  };
+
+  static const char* GetName(Section a_Section);
+
+  // Ends the current frame and starts the next one.
+  void BeginFrame();
+
+  void AddMillis(Section a_Section, double a_Millis) {
+    m_Frame.m_Millis[a_Section] += a_Millis;
+  }
+  void SetNumPrimitives(uint64_t a_NumBoxes, uint64_t a_NumLines) {
+    m_Frame.m_NumBoxes = a_NumBoxes;
+    m_Frame.m_NumLines = a_NumLines;
+  }
+  void AddNumGlyphs(uint64_t a_NumGlyphs) {
+    m_Frame.m_NumGlyphs += a_NumGlyphs;
+  }
+
+  // The last complete frame, and the worst time of a section over the last
+  // kNumFrames.
+  const Frame& GetLastFrame() const { return m_LastFrame; }
+  double GetMaxMillis(Section a_Section) const;
+
+  static constexpr size_t kNumFrames = 128;
+
+  // Adds the time spent in its scope to a section.
+  class Scope {
+   public:
+    Scope(RenderStats* a_Stats, Section a_Section)
+        : m_Stats(a_Stats), m_Section(a_Section) {
+      m_Timer.Start();
+    }
+    ~Scope() { m_Stats->AddMillis(m_Section, m_Timer.QueryMillis()); }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    RenderStats* m_Stats;
+    Section m_Section;
+    Timer m_Timer;
+  };
+
+ private:
+  Frame m_Frame;
+  Frame m_LastFrame;
+  // Of the previous frames, in a ring.
+  std::array<std::array<double, NUM_SECTIONS>, kNumFrames> m_History = {};
+  size_t m_NumFrames = 0;
+  // Of VertexBuffer::GetNumBytesUploaded when the frame began.
+  uint64_t m_FrameStartBytesUploaded = 0;
+};
@@ -0,0 +1,312 @@
+#include "SamplingDiffDataView.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "App.h"
+#include "Capture.h"
+#include "Core.h"
+#include "SamplingProfiler.h"
+
+//-----------------------------------------------------------------------------
+SamplingDiffDataView::SamplingDiffDataView() {
+  m_SortingToggles.resize(DiffColumn::NumColumns, false);
+  m_UpdatePeriodMs = 1000;
+}
+
+//-----------------------------------------------------------------------------
+std::vector<int> SamplingDiffDataView::s_HeaderMap;
+std::vector<float> SamplingDiffDataView::s_HeaderRatios;
+
+//-----------------------------------------------------------------------------
+const std::vector<std::wstring>& SamplingDiffDataView::GetColumnHeaders() {
+  static std::vector<std::wstring> Columns;
+
+  if (s_HeaderMap.size() == 0) {
+    Columns.push_back(L"Name");
+    s_HeaderMap.push_back(DiffColumn::FunctionName);
+    s_HeaderRatios.push_back(0.5f);
+    Columns.push_back(L"Baseline Exclusive");
+    s_HeaderMap.push_back(DiffColumn::BaselineExclusive);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"Exclusive");
+    s_HeaderMap.push_back(DiffColumn::Exclusive);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"Exclusive Delta");
+    s_HeaderMap.push_back(DiffColumn::ExclusiveDelta);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"Baseline Inclusive");
+    s_HeaderMap.push_back(DiffColumn::BaselineInclusive);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"Inclusive");
+    s_HeaderMap.push_back(DiffColumn::Inclusive);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"Inclusive Delta");
+    s_HeaderMap.push_back(DiffColumn::InclusiveDelta);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"Significance");
+    s_HeaderMap.push_back(DiffColumn::Significance);
+    s_HeaderRatios.push_back(0);
+  }
+
+  return Columns;
+}
+
+//-----------------------------------------------------------------------------
+const std::vector<float>& SamplingDiffDataView::GetColumnHeadersRatios() {
+  return s_HeaderRatios;
+}
+
+//-----------------------------------------------------------------------------
+std::wstring SamplingDiffDataView::GetValue(int a_Row, int a_Column) {
+  const DiffRow& row = GetRow(a_Row);
+
+  std::wstring value;
+
+  switch (s_HeaderMap[a_Column]) {
+    case DiffColumn::FunctionName:
+      value = row.m_Name;
+      break;
+    case DiffColumn::BaselineExclusive:
+      value = row.m_HasExclusive ? Format(L"%.2f", row.m_BaselineExclusive)
+                                 : L"";
+      break;
+    case DiffColumn::Exclusive:
+      value = row.m_HasExclusive ? Format(L"%.2f", row.m_Exclusive) : L"";
+      break;
+    case DiffColumn::ExclusiveDelta:
+      value = row.m_HasExclusive ? Format(L"%+.2f", row.m_ExclusiveDelta)
+                                 : L"";
+      break;
+    case DiffColumn::BaselineInclusive:
+      value = Format(L"%.2f", row.m_BaselineInclusive);
+      break;
+    case DiffColumn::Inclusive:
+      value = Format(L"%.2f", row.m_Inclusive);
+      break;
+    case DiffColumn::InclusiveDelta:
+      value = Format(L"%+.2f", row.m_InclusiveDelta);
+      break;
+    case DiffColumn::Significance:
+      value = Format(L"%+.1f", row.m_Significance);
+      break;
+    default:
+      break;
+  }
+
+  return value;
+}
+
+//-----------------------------------------------------------------------------
+#define ORBIT_PROC_SORT(Member)                                            \
+  [&](int a, int b) {                                                      \
+    return OrbitUtils::Compare(rows[a].Member, rows[b].Member, ascending); \
+  }
+
+//-----------------------------------------------------------------------------
+void SamplingDiffDataView::OnSort(int a_Column, bool a_Toggle) {
+  std::vector<DiffRow>& rows = m_Rows;
+  DiffColumn column = DiffColumn(s_HeaderMap[a_Column]);
+
+  if (a_Toggle) {
+    m_SortingToggles[column] = !m_SortingToggles[column];
+  }
+
+  bool ascending = m_SortingToggles[column];
+  std::function<bool(int a, int b)> sorter = nullptr;
+
+  switch (column) {
+    case DiffColumn::FunctionName:
+      sorter = ORBIT_PROC_SORT(m_Name);
+      break;
+    case DiffColumn::BaselineExclusive:
+      sorter = ORBIT_PROC_SORT(m_BaselineExclusive);
+      break;
+    case DiffColumn::Exclusive:
+      sorter = ORBIT_PROC_SORT(m_Exclusive);
+      break;
+    case DiffColumn::ExclusiveDelta:
+      sorter = ORBIT_PROC_SORT(m_ExclusiveDelta);
+      break;
+    case DiffColumn::BaselineInclusive:
+      sorter = ORBIT_PROC_SORT(m_BaselineInclusive);
+      break;
+    case DiffColumn::Inclusive:
+      sorter = ORBIT_PROC_SORT(m_Inclusive);
+      break;
+    case DiffColumn::InclusiveDelta:
+      sorter = ORBIT_PROC_SORT(m_InclusiveDelta);
+      break;
+    case DiffColumn::Significance:
+      sorter = ORBIT_PROC_SORT(m_Significance);
+      break;
+    default:
+      break;
+  }
+
+  if (sorter) {
+    std::sort(m_Indices.begin(), m_Indices.end(), sorter);
+  }
+
+  m_LastSortedColumn = a_Column;
+}
+
+//-----------------------------------------------------------------------------
+const std::wstring DIFF_SHOW_FUNCTIONS = L"Show Functions";
+const std::wstring DIFF_SHOW_CALL_PATHS = L"Show Call Paths";
+const std::wstring DIFF_GO_TO_DISASSEMBLY = L"Go To Disassembly";
+
+//-----------------------------------------------------------------------------
+std::vector<std::wstring> SamplingDiffDataView::GetContextMenu(int a_Index) {
+  std::vector<std::wstring> menu = {
+      m_ShowCallPaths ? DIFF_SHOW_FUNCTIONS : DIFF_SHOW_CALL_PATHS,
+      DIFF_GO_TO_DISASSEMBLY};
+  Append(menu, DataView::GetContextMenu(a_Index));
+  return menu;
+}
+
+//-----------------------------------------------------------------------------
+void SamplingDiffDataView::OnContextMenu(const std::wstring& a_Action,
+                                         int a_MenuIndex,
+                                         std::vector<int>& a_ItemIndices) {
+  if (a_Action == DIFF_SHOW_FUNCTIONS || a_Action == DIFF_SHOW_CALL_PATHS) {
+    m_ShowCallPaths = a_Action == DIFF_SHOW_CALL_PATHS;
+    UpdateRows();
+  } else if (a_Action == DIFF_GO_TO_DISASSEMBLY) {
+    for (int index : a_ItemIndices) {
+      const DiffRow& row = GetRow(index);
+      if (row.m_Address != 0) {
+        GOrbitApp->GetDisassembly(row.m_Address, 200, 400);
+      }
+    }
+  } else {
+    DataView::OnContextMenu(a_Action, a_MenuIndex, a_ItemIndices);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void SamplingDiffDataView::OnTimer() {
+  std::shared_ptr<SamplingProfiler> baseline =
+      GOrbitApp->GetSamplingDiffBaseline();
+  std::shared_ptr<SamplingProfiler> comparison = Capture::GSamplingProfiler;
+  if (baseline == m_Baseline && comparison == m_Comparison) {
+    return;
+  }
+  if (baseline == nullptr || comparison == nullptr ||
+      baseline->GetState() != SamplingProfiler::DoneProcessing ||
+      comparison->GetState() != SamplingProfiler::DoneProcessing) {
+    return;
+  }
+  m_Baseline = baseline;
+  m_Comparison = comparison;
+
+  // The diff runs on the call trees of the summaries, whose size doesn't
+  // depend on the number of samples.
+  std::shared_ptr<SampledCallTree> baselineTree = baseline->GetCallTree(0);
+  std::shared_ptr<SampledCallTree> comparisonTree = comparison->GetCallTree(0);
+  auto nameOf = [](SamplingProfiler* a_Profiler) {
+    return [a_Profiler](uint64_t a_Address) {
+      return ws2s(a_Profiler->GetSymbolFromAddress(a_Address));
+    };
+  };
+  m_Diff = DiffSampledCallTrees(
+      {baselineTree->m_Tree, baselineTree->m_InclusiveCounts,
+       nameOf(baseline.get())},
+      {comparisonTree->m_Tree, comparisonTree->m_InclusiveCounts,
+       nameOf(comparison.get())});
+  UpdateRows();
+}
+
+//-----------------------------------------------------------------------------
+void SamplingDiffDataView::UpdateRows() {
+  uint64_t numBaseline = m_Diff.num_baseline_samples;
+  uint64_t numComparison = m_Diff.num_comparison_samples;
+  auto percent = [](uint64_t a_Count, uint64_t a_Total) {
+    return a_Total > 0 ? 100.f * (float)a_Count / (float)a_Total : 0.f;
+  };
+  auto setInclusive = [&](const SampleCountDiff& a_Counts, DiffRow* a_Row) {
+    a_Row->m_BaselineInclusive = percent(a_Counts.baseline, numBaseline);
+    a_Row->m_Inclusive = percent(a_Counts.comparison, numComparison);
+    a_Row->m_InclusiveDelta =
+        GetPercentDelta(a_Counts, numBaseline, numComparison);
+    a_Row->m_Significance =
+        GetSignificance(a_Counts, numBaseline, numComparison);
+  };
+
+  m_Rows.clear();
+  if (!m_ShowCallPaths) {
+    for (const FunctionDiff& function : m_Diff.functions) {
+      DiffRow row;
+      row.m_Name = s2ws(function.name);
+      row.m_Address = function.comparison_address != 0
+                          ? function.comparison_address
+                          : function.baseline_address;
+      row.m_BaselineExclusive =
+          percent(function.exclusive.baseline, numBaseline);
+      row.m_Exclusive = percent(function.exclusive.comparison, numComparison);
+      row.m_ExclusiveDelta =
+          GetPercentDelta(function.exclusive, numBaseline, numComparison);
+      setInclusive(function.inclusive, &row);
+      m_Rows.push_back(std::move(row));
+    }
+  } else {
+    const CallstackTree& paths = m_Diff.paths;
+    for (CallstackTree::NodeId id = CallstackTree::kRootId + 1;
+         id < paths.size(); ++id) {
+      DiffRow row;
+      // Outermost function first.
+      std::vector<uint64_t> functions = paths.GetFrames(id);
+      for (auto it = functions.rbegin(); it != functions.rend(); ++it) {
+        if (!row.m_Name.empty()) {
+          row.m_Name += L" > ";
+        }
+        row.m_Name += s2ws(m_Diff.functions[*it].name);
+      }
+      const FunctionDiff& function = m_Diff.functions[paths.GetAddress(id)];
+      row.m_Address = function.comparison_address != 0
+                          ? function.comparison_address
+                          : function.baseline_address;
+      row.m_HasExclusive = false;
+      setInclusive(m_Diff.path_counts[id], &row);
+      m_Rows.push_back(std::move(row));
+    }
+  }
+
+  OnFilter(m_Filter);
+}
+
+//-----------------------------------------------------------------------------
+void SamplingDiffDataView::OnFilter(const std::wstring& a_Filter) {
+  std::vector<uint32_t> indices;
+
+  std::vector<std::wstring> tokens = Tokenize(ToLower(a_Filter));
+
+  for (uint32_t i = 0; i < m_Rows.size(); ++i) {
+    std::wstring name = ToLower(m_Rows[i].m_Name);
+
+    bool match = true;
+
+    for (std::wstring& filterToken : tokens) {
+      if (name.find(filterToken) == std::wstring::npos) {
+        match = false;
+        break;
+      }
+    }
+
+    if (match) {
+      indices.push_back(i);
+    }
+  }
+
+  m_Indices = indices;
+
+  if (m_LastSortedColumn != -1) {
+    OnSort(m_LastSortedColumn, false);
+  } else {
+    // Most significant differences first, until sorted otherwise.
+    std::sort(m_Indices.begin(), m_Indices.end(), [this](int a, int b) {
+      return std::abs(m_Rows[a].m_Significance) >
+             std::abs(m_Rows[b].m_Significance);
+    });
+  }
+}
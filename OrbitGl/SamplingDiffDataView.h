@@ -0,0 +1,71 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DataView.h"
+#include "SamplingDiff.h"
+
+class SamplingProfiler;
+
+// Differences between the sampling report of the diff baseline set by the
+// user and that of the current capture, per function or per call path. It
+// updates itself once both are processed.
+class SamplingDiffDataView : public DataView {
+ public:
+  SamplingDiffDataView();
+
+  const std::vector<std::wstring>& GetColumnHeaders() override;
+  const std::vector<float>& GetColumnHeadersRatios() override;
+  std::vector<std::wstring> GetContextMenu(int a_Index) override;
+  std::wstring GetValue(int a_Row, int a_Column) override;
+
+  void OnFilter(const std::wstring& a_Filter) override;
+  void OnSort(int a_Column, bool a_Toggle = true) override;
+  void OnContextMenu(const std::wstring& a_Action, int a_MenuIndex,
+                     std::vector<int>& a_ItemIndices) override;
+  void OnTimer() override;
+
+  enum DiffColumn {
+    FunctionName,
+    BaselineExclusive,
+    Exclusive,
+    ExclusiveDelta,
+    BaselineInclusive,
+    Inclusive,
+    InclusiveDelta,
+    Significance,
+    NumColumns
+  };
+
+ protected:
+  struct DiffRow {
+    std::wstring m_Name;
+    uint64_t m_Address = 0;
+    // Percents of the samples, blank for the exclusive columns of paths.
+    bool m_HasExclusive = true;
+    float m_BaselineExclusive = 0.f;
+    float m_Exclusive = 0.f;
+    float m_ExclusiveDelta = 0.f;
+    float m_BaselineInclusive = 0.f;
+    float m_Inclusive = 0.f;
+    float m_InclusiveDelta = 0.f;
+    // Of the inclusive delta.
+    float m_Significance = 0.f;
+  };
+
+  void UpdateRows();
+  const DiffRow& GetRow(unsigned int a_Row) const {
+    return m_Rows[m_Indices[a_Row]];
+  }
+
+  std::shared_ptr<SamplingProfiler> m_Baseline;
+  std::shared_ptr<SamplingProfiler> m_Comparison;
+  SamplingDiff m_Diff;
+  bool m_ShowCallPaths = false;
+  std::vector<DiffRow> m_Rows;
+
+  static std::vector<int> s_HeaderMap;
+  static std::vector<float> s_HeaderRatios;
+};
@@ -10,12 +10,16 @@
 
 //-----------------------------------------------------------------------------
 SamplingReport::SamplingReport(
-    std::shared_ptr<class SamplingProfiler> a_SamplingProfiler) {
+    std::shared_ptr<class SamplingProfiler> a_SamplingProfiler, bool a_Live) {
   m_Profiler = a_SamplingProfiler;
   m_SelectedAddress = 0;
   m_CallstackDataView = nullptr;
   m_SelectedSortedCallstackReport = nullptr;
-  FillReport();
+  if (a_Live) {
+    FillLiveReport();
+  } else {
+    FillReport();
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -32,7 +36,13 @@ void SamplingReport::FillReport() {
 
     std::shared_ptr<SamplingReportDataView> threadReport =
         std::make_shared<SamplingReportDataView>();
-    threadReport->SetSampledFunctions(threadSampleData->m_SampleReport);
+    // The summary is shown first, the report of a thread only when its tab
+    // is opened.
+    if (tid == 0) {
+      threadReport->SetSampledFunctions(m_Profiler->GetSampledFunctions(tid));
+    } else {
+      threadReport->LoadSampledFunctionsWhenShown();
+    }
     threadReport->SetThreadID(tid);
     threadReport->SetSamplingProfiler(m_Profiler);
     threadReport->SetSamplingReport(this);
@@ -43,6 +53,21 @@ void SamplingReport::FillReport() {
   std::string panelName = "samplingReport" + std::to_string(cnt++);
 }
 
+//-----------------------------------------------------------------------------
+void SamplingReport::FillLiveReport() {
+  for (ThreadID tid : m_Profiler->GetLiveThreadIds()) {
+    std::shared_ptr<SamplingReportDataView> threadReport =
+        std::make_shared<SamplingReportDataView>();
+    threadReport->SetSampledFunctions(
+        m_Profiler->GetLiveSampledFunctions(tid));
+    threadReport->SetThreadID(tid);
+    threadReport->SetSamplingProfiler(m_Profiler);
+    threadReport->SetSamplingReport(this);
+    threadReport->SetLiveUpdatePeriodMs(kLiveUpdatePeriodMs);
+    m_ThreadReports.push_back(threadReport);
+  }
+}
+
 //-----------------------------------------------------------------------------
 void SamplingReport::OnSelectAddress(uint64_t a_Address, ThreadID a_ThreadId) {
   if (m_CallstackDataView) {
@@ -83,7 +108,9 @@ void SamplingReport::DecrementCallstackIndex() {
 
 //-----------------------------------------------------------------------------
 std::wstring SamplingReport::GetSelectedCallstackString() {
-  if (m_SelectedSortedCallstackReport) {
+  // Callstacks of live reports are only known once the capture is processed.
+  if (m_SelectedSortedCallstackReport &&
+      !m_SelectedSortedCallstackReport->m_CallStacks.empty()) {
     int numOccurances = m_SelectedSortedCallstackReport
                             ->m_CallStacks[m_SelectedAddressCallstackIndex]
                             .m_Count;
@@ -11,10 +11,15 @@
 //-----------------------------------------------------------------------------
 class SamplingReport {
  public:
-  SamplingReport(std::shared_ptr<class SamplingProfiler> a_SamplingProfiler);
+  // A live report shows the samples received so far, and updates while the
+  // capture goes on.
+  explicit SamplingReport(
+      std::shared_ptr<class SamplingProfiler> a_SamplingProfiler,
+      bool a_Live = false);
   ~SamplingReport();
 
   void FillReport();
+  void FillLiveReport();
   std::shared_ptr<class SamplingProfiler> GetProfiler() const {
     return m_Profiler;
   }
@@ -36,6 +41,8 @@ class SamplingReport {
     return m_SelectedSortedCallstackReport != nullptr;
   }
 
+  static constexpr int kLiveUpdatePeriodMs = 1000;
+
  protected:
   std::shared_ptr<class SamplingProfiler> m_Profiler;
   std::vector<std::shared_ptr<class DataView> > m_ThreadReports;
@@ -167,11 +167,12 @@ std::wstring SELECT = L"Hook";
 std::wstring DESELECT = L"Unhook";
 std::wstring MODULES_LOAD = L"Load Symbols";
 std::wstring MODULES_DIS = L"Go To Disassembly";
+std::wstring SET_DIFF_BASELINE = L"Set as Diff Baseline";
 
 //-----------------------------------------------------------------------------
 std::vector<std::wstring> SamplingReportDataView::GetContextMenu(int a_Index) {
   std::vector<std::wstring> menu = {SELECT, DESELECT, MODULES_LOAD,
-                                    MODULES_DIS};
+                                    MODULES_DIS, SET_DIFF_BASELINE};
   Append(menu, DataView::GetContextMenu(a_Index));
   return menu;
 }
@@ -224,6 +225,8 @@ void SamplingReportDataView::OnContextMenu(const std::wstring& a_Action,
       SampledFunction& sampledFunc = GetFunction(a_ItemIndices[i]);
       GOrbitApp->GetDisassembly(sampledFunc.m_Address, 200, 400);
     }
+  } else if (a_Action == SET_DIFF_BASELINE) {
+    GOrbitApp->SetSamplingDiffBaseline(m_SamplingProfiler);
   } else {
     DataView::OnContextMenu(a_Action, a_MenuIndex, a_ItemIndices);
   }
@@ -255,6 +258,25 @@ void SamplingReportDataView::SetSampledFunctions(
   }
 }
 
+//-----------------------------------------------------------------------------
+void SamplingReportDataView::OnTimer() {
+  if (m_SamplingProfiler->GetState() != SamplingProfiler::Sampling) {
+    return;
+  }
+  SetSampledFunctions(m_SamplingProfiler->GetLiveSampledFunctions(m_TID));
+  OnFilter(m_Filter);
+}
+
+//-----------------------------------------------------------------------------
+void SamplingReportDataView::OnShown() {
+  if (!m_LoadWhenShown) {
+    return;
+  }
+  m_LoadWhenShown = false;
+  SetSampledFunctions(m_SamplingProfiler->GetSampledFunctions(m_TID));
+  OnFilter(m_Filter);
+}
+
 //-----------------------------------------------------------------------------
 void SamplingReportDataView::SetThreadID(ThreadID a_TID) {
   m_TID = a_TID;
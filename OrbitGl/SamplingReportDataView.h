@@ -23,6 +23,8 @@ class SamplingReportDataView : public DataView {
   void OnContextMenu(const std::wstring& a_Action, int a_MenuIndex,
                      std::vector<int>& a_ItemIndices) override;
   void OnSelect(int a_Index) override;
+  void OnTimer() override;
+  void OnShown() override;
 
   virtual void LinkDataView(DataView* a_DataView) override;
   void SetSamplingProfiler(std::shared_ptr<SamplingProfiler>& a_Profiler) {
@@ -32,6 +34,12 @@ class SamplingReportDataView : public DataView {
     m_SamplingReport = a_SamplingReport;
   }
   void SetSampledFunctions(const std::vector<SampledFunction>& a_Functions);
+  // Asks the profiler for the functions of the thread once shown, see
+  // SamplingProfiler::GetSampledFunctions.
+  void LoadSampledFunctionsWhenShown() { m_LoadWhenShown = true; }
+  // Pulls the functions sampled so far from the profiler every a_PeriodMs,
+  // until the capture stops.
+  void SetLiveUpdatePeriodMs(int a_PeriodMs) { m_UpdatePeriodMs = a_PeriodMs; }
   void SetThreadID(ThreadID a_TID);
   std::vector<SampledFunction>& GetFunctions() { return m_Functions; }
 
@@ -54,6 +62,7 @@ class SamplingReportDataView : public DataView {
 
  protected:
   std::vector<SampledFunction> m_Functions;
+  bool m_LoadWhenShown = false;
   ThreadID m_TID;
   std::wstring m_Name;
   std::shared_ptr<SamplingProfiler> m_SamplingProfiler;
@@ -88,14 +88,9 @@ void TextBox::Draw(TextRenderer& a_TextRenderer, float a_MinX, bool a_Visible,
 
   static unsigned char g = 100;
   Color grey(g, g, g, 255);
-  static Color selectionColor(0, 128, 255, 255);
 
   Color col = isSameThreadIdAsSelected ? m_Color : isInactive ? grey : m_Color;
 
-  if (this == Capture::GSelectedTextBox) {
-    col = selectionColor;
-  }
-
   float z = a_IsHighlighted ? GlCanvas::Z_VALUE_CONTEXT_SWITCH
                             : isInactive ? GlCanvas::Z_VALUE_BOX_INACTIVE
                                          : GlCanvas::Z_VALUE_BOX_ACTIVE;
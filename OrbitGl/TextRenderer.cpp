@@ -4,10 +4,14 @@
 
 #include "TextRenderer.h"
 
+#include <algorithm>
+#include <cstddef>
+
 #include "App.h"
 #include "Core.h"
 #include "GlCanvas.h"
 #include "GlUtils.h"
+#include "OrbitBase/Logging.h"
 #include "Params.h"
 #include "freetype-gl/vertex-buffer.h"
 #include "shader.h"
@@ -19,12 +23,54 @@ typedef struct {
   float r, g, b, a;  // color
 } vertex_t;
 
+namespace {
+// Beyond this, the runs of a font are dropped and laid out again as needed.
+constexpr size_t kMaxGlyphRunsPerFont = 64 * 1024;
+// Rect, tex rect, color and z of GlyphInstance.
+constexpr GLuint kNumInstanceAttributes = 4;
+
+//-----------------------------------------------------------------------------
+// Corners are given by gl_VertexID, as a triangle strip.
+const char* kInstanceVertexShader = R"(
+#version 330
+uniform mat4 u_Projection;
+layout(location = 0) in vec4 a_Rect;
+layout(location = 1) in vec4 a_TexRect;
+layout(location = 2) in vec4 a_Color;
+layout(location = 3) in float a_Z;
+out vec2 v_TexCoord;
+out vec4 v_Color;
+void main() {
+  vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+  v_TexCoord = mix(a_TexRect.xy, a_TexRect.zw, corner);
+  v_Color = a_Color;
+  gl_Position =
+      u_Projection * vec4(mix(a_Rect.xy, a_Rect.zw, corner), a_Z, 1.0);
+}
+)";
+
+const char* kInstanceFragmentShader = R"(
+#version 330
+uniform sampler2D u_Atlas;
+in vec2 v_TexCoord;
+in vec4 v_Color;
+out vec4 o_Color;
+void main() {
+  o_Color = vec4(v_Color.rgb, v_Color.a * texture(u_Atlas, v_TexCoord).r);
+}
+)";
+}  // namespace
+
 //-----------------------------------------------------------------------------
 TextRenderer::TextRenderer()
     : m_Atlas(NULL),
       m_Buffer(NULL),
       m_Font(NULL),
+      m_InstancesChanged(true),
+      m_AtlasChanged(true),
       m_Canvas(NULL),
+      m_Shader(0),
+      m_InstanceProgram(0),
       m_Initialized(false),
       m_DrawOutline(false) {}
 
@@ -37,6 +83,10 @@ TextRenderer::~TextRenderer() {
   if (m_Buffer) {
     vertex_buffer_delete(m_Buffer);
   }
+
+  if (m_InstanceProgram != 0) {
+    glDeleteProgram(m_InstanceProgram);
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -63,10 +113,17 @@ void TextRenderer::Init() {
 
   glGenTextures(1, &m_Atlas->id);
 
-  const auto vertShaderFileName = exePath + "shaders/v3f-t2f-c4f.vert";
-  const auto fragShaderFileName = exePath + "shaders/v3f-t2f-c4f.frag";
-  m_Shader =
-      shader_load(vertShaderFileName.c_str(), fragShaderFileName.c_str());
+  if (GLEW_VERSION_3_3) {
+    m_InstanceProgram =
+        CreateGlProgram(kInstanceVertexShader, kInstanceFragmentShader);
+  }
+  if (m_InstanceProgram == 0) {
+    LOG("Text is drawn without instances");
+    const auto vertShaderFileName = exePath + "shaders/v3f-t2f-c4f.vert";
+    const auto fragShaderFileName = exePath + "shaders/v3f-t2f-c4f.frag";
+    m_Shader =
+        shader_load(vertShaderFileName.c_str(), fragShaderFileName.c_str());
+  }
 
   mat4_set_identity(&m_Proj);
   mat4_set_identity(&m_Model);
@@ -85,48 +142,36 @@ void TextRenderer::SetFontSize(int a_Size) {
 
 //-----------------------------------------------------------------------------
 void TextRenderer::Display() {
-  if (m_DrawOutline) {
-    DrawOutline(m_Buffer);
-  }
-
   // Lazy init
   if (!m_Initialized) {
     Init();
   }
 
+  if (m_DrawOutline) {
+    DrawOutline();
+  }
+
   glBindTexture(GL_TEXTURE_2D, m_Atlas->id);
 
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, (GLsizei)m_Atlas->width,
-               (GLsizei)m_Atlas->height, 0, GL_RED, GL_UNSIGNED_BYTE,
-               m_Atlas->data);
-
-  // Get current projection matrix
-  GLfloat matrix[16];
-  glGetFloatv(GL_PROJECTION_MATRIX, matrix);
-  mat4* proj = (mat4*)&matrix[0];
-  m_Proj = *proj;
+  // Only glyphs loaded since the previous upload change the atlas.
+  if (m_AtlasChanged) {
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, (GLsizei)m_Atlas->width,
+                 (GLsizei)m_Atlas->height, 0, GL_RED, GL_UNSIGNED_BYTE,
+                 m_Atlas->data);
+    m_AtlasChanged = false;
+  }
 
   mat4_set_orthographic(&m_Proj, 0, (float)m_Canvas->getWidth(), 0,
                         (float)m_Canvas->getHeight(), -1, 1);
 
-  glUseProgram(m_Shader);
-  {
-    glUniform1i(glGetUniformLocation(m_Shader, "texture"), 0);
-    glUniformMatrix4fv(glGetUniformLocation(m_Shader, "model"), 1, 0,
-                       m_Model.data);
-    glUniformMatrix4fv(glGetUniformLocation(m_Shader, "view"), 1, 0,
-                       m_View.data);
-    glUniformMatrix4fv(glGetUniformLocation(m_Shader, "projection"), 1, 0,
-                       m_Proj.data);
-    vertex_buffer_render(m_Buffer, GL_TRIANGLES);
-
-    /*PRINT_VAR(m_Model);
-    PRINT_VAR(m_View);
-    PRINT_VAR(m_Proj);*/
+  if (m_InstanceProgram != 0) {
+    DrawInstances();
+  } else {
+    DrawVertexBuffer();
   }
 
   glBindTexture(GL_TEXTURE_2D, 0);
@@ -134,83 +179,187 @@ void TextRenderer::Display() {
 }
 
 //-----------------------------------------------------------------------------
-void TextRenderer::DrawOutline(vertex_buffer_t* a_Buffer) {
-  glBegin(GL_LINES);
+void TextRenderer::DrawInstances() {
+  if (m_InstancesChanged) {
+    m_InstanceBuffer.Upload(m_Instances);
+    m_InstancesChanged = false;
+  }
+  if (m_Instances.empty()) return;
+
+  glUseProgram(m_InstanceProgram);
+  glUniform1i(glGetUniformLocation(m_InstanceProgram, "u_Atlas"), 0);
+  glUniformMatrix4fv(glGetUniformLocation(m_InstanceProgram, "u_Projection"),
+                     1, GL_FALSE, m_Proj.data);
+
+  m_InstanceBuffer.Bind();
+  GLsizei stride = sizeof(GlyphInstance);
+  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, stride,
+                        (void*)offsetof(GlyphInstance, m_X0));
+  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride,
+                        (void*)offsetof(GlyphInstance, m_S0));
+  glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                        (void*)offsetof(GlyphInstance, m_Color));
+  glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride,
+                        (void*)offsetof(GlyphInstance, m_Z));
+  for (GLuint attribute = 0; attribute < kNumInstanceAttributes; ++attribute) {
+    glEnableVertexAttribArray(attribute);
+    glVertexAttribDivisor(attribute, 1);
+  }
+
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)m_Instances.size());
 
-  for (int i = 0; i < (int)a_Buffer->indices->size; i += 3) {
-    GLuint i0 = *(GLuint*)vector_get(a_Buffer->indices, i + 0);
-    GLuint i1 = *(GLuint*)vector_get(a_Buffer->indices, i + 1);
-    GLuint i2 = *(GLuint*)vector_get(a_Buffer->indices, i + 2);
+  for (GLuint attribute = 0; attribute < kNumInstanceAttributes; ++attribute) {
+    glVertexAttribDivisor(attribute, 0);
+    glDisableVertexAttribArray(attribute);
+  }
+  VertexBuffer::Unbind();
+}
+
+//-----------------------------------------------------------------------------
+void TextRenderer::DrawVertexBuffer() {
+  if (m_InstancesChanged) {
+    vertex_buffer_clear(m_Buffer);
+    const float coeff = 1.f / 255.f;
+    for (const GlyphInstance& glyph : m_Instances) {
+      float r = glyph.m_Color[0] * coeff, g = glyph.m_Color[1] * coeff,
+            b = glyph.m_Color[2] * coeff, a = glyph.m_Color[3] * coeff;
+      float z = glyph.m_Z;
+      GLuint indices[6] = {0, 1, 2, 0, 2, 3};
+      vertex_t vertices[4] = {
+          {glyph.m_X0, glyph.m_Y0, z, glyph.m_S0, glyph.m_T0, r, g, b, a},
+          {glyph.m_X0, glyph.m_Y1, z, glyph.m_S0, glyph.m_T1, r, g, b, a},
+          {glyph.m_X1, glyph.m_Y1, z, glyph.m_S1, glyph.m_T1, r, g, b, a},
+          {glyph.m_X1, glyph.m_Y0, z, glyph.m_S1, glyph.m_T0, r, g, b, a}};
+      vertex_buffer_push_back(m_Buffer, vertices, 4, indices, 6);
+    }
+    m_InstancesChanged = false;
+  }
+
+  glUseProgram(m_Shader);
+  glUniform1i(glGetUniformLocation(m_Shader, "texture"), 0);
+  glUniformMatrix4fv(glGetUniformLocation(m_Shader, "model"), 1, 0,
+                     m_Model.data);
+  glUniformMatrix4fv(glGetUniformLocation(m_Shader, "view"), 1, 0,
+                     m_View.data);
+  glUniformMatrix4fv(glGetUniformLocation(m_Shader, "projection"), 1, 0,
+                     m_Proj.data);
+  vertex_buffer_render(m_Buffer, GL_TRIANGLES);
+}
+
+//-----------------------------------------------------------------------------
+void TextRenderer::DrawOutline() {
+  glBegin(GL_LINES);
 
-    vertex_t v0 = *(vertex_t*)vector_get(a_Buffer->vertices, i0);
-    vertex_t v1 = *(vertex_t*)vector_get(a_Buffer->vertices, i1);
-    vertex_t v2 = *(vertex_t*)vector_get(a_Buffer->vertices, i2);
+  for (const GlyphInstance& glyph : m_Instances) {
+    glVertex3f(glyph.m_X0, glyph.m_Y0, glyph.m_Z);
+    glVertex3f(glyph.m_X0, glyph.m_Y1, glyph.m_Z);
 
-    glVertex3f(v0.x, v0.y, v0.z);
-    glVertex3f(v1.x, v1.y, v1.z);
+    glVertex3f(glyph.m_X0, glyph.m_Y1, glyph.m_Z);
+    glVertex3f(glyph.m_X1, glyph.m_Y1, glyph.m_Z);
 
-    glVertex3f(v1.x, v1.y, v1.z);
-    glVertex3f(v2.x, v2.y, v2.z);
+    glVertex3f(glyph.m_X1, glyph.m_Y1, glyph.m_Z);
+    glVertex3f(glyph.m_X1, glyph.m_Y0, glyph.m_Z);
 
-    glVertex3f(v2.x, v2.y, v2.z);
-    glVertex3f(v0.x, v0.y, v0.z);
+    glVertex3f(glyph.m_X1, glyph.m_Y0, glyph.m_Z);
+    glVertex3f(glyph.m_X0, glyph.m_Y0, glyph.m_Z);
   }
 
   glEnd();
 }
 
 //-----------------------------------------------------------------------------
-void TextRenderer::AddTextInternal(texture_font_t* font, const char* text,
-                                   const vec4& color, vec2* pen,
-                                   float a_MaxSize, float a_Z, bool) {
-  size_t i;
-  float r = color.red, g = color.green, b = color.blue, a = color.alpha;
-  float textZ = a_Z;
+const TextRenderer::GlyphRun& TextRenderer::GetGlyphRun(
+    texture_font_t* a_Font, const char* a_Text) {
+  std::unordered_map<std::string, GlyphRun>& runs = m_GlyphRuns[a_Font];
+  auto it = runs.find(a_Text);
+  if (it != runs.end()) {
+    return it->second;
+  }
 
-  float maxWidth = a_MaxSize == -1.f ? FLT_MAX : ToScreenSpace(a_MaxSize);
-  float strWidth = 0.f;
+  if (runs.size() >= kMaxGlyphRunsPerFont) {
+    runs.clear();
+  }
+  GlyphRun& run = runs[a_Text];
+  float penX = 0.f;
   int minX = INT_MAX;
   int maxX = -INT_MAX;
-
-  for (i = 0; i < strlen(text); ++i) {
-    if (!texture_font_find_glyph(font, text + i)) {
-      texture_font_load_glyph(font, text + i);
+  size_t length = strlen(a_Text);
+  for (size_t i = 0; i < length; ++i) {
+    if (!texture_font_find_glyph(a_Font, a_Text + i)) {
+      texture_font_load_glyph(a_Font, a_Text + i);
+      m_AtlasChanged = true;
     }
 
-    texture_glyph_t* glyph = texture_font_get_glyph(font, text + i);
+    texture_glyph_t* glyph = texture_font_get_glyph(a_Font, a_Text + i);
     if (glyph != NULL) {
       float kerning = 0.0f;
       if (i > 0) {
-        kerning = texture_glyph_get_kerning(glyph, text + i - 1);
+        kerning = texture_glyph_get_kerning(glyph, a_Text + i - 1);
       }
-      pen->x += kerning;
-      int x0 = (int)(pen->x + glyph->offset_x);
-      int y0 = (int)(pen->y + glyph->offset_y);
+      penX += kerning;
+      int x0 = (int)(penX + glyph->offset_x);
       int x1 = (int)(x0 + glyph->width);
-      int y1 = (int)(y0 - glyph->height);
-      float s0 = glyph->s0;
-      float t0 = glyph->t0;
-      float s1 = glyph->s1;
-      float t1 = glyph->t1;
-      GLuint indices[6] = {0, 1, 2, 0, 2, 3};
-      vertex_t vertices[4] = {
-          {(float)x0, (float)y0, textZ, s0, t0, r, g, b, a},
-          {(float)x0, (float)y1, textZ, s0, t1, r, g, b, a},
-          {(float)x1, (float)y1, textZ, s1, t1, r, g, b, a},
-          {(float)x1, (float)y0, textZ, s1, t0, r, g, b, a}};
-
       minX = std::min(minX, x0);
       maxX = std::max(maxX, x1);
-      strWidth = float(maxX - minX);
-
-      if (strWidth > maxWidth) {
-        break;
-      }
 
-      vertex_buffer_push_back(m_Buffer, vertices, 4, indices, 6);
-      pen->x += glyph->advance_x;
+      Glyph laidOut;
+      laidOut.m_Char = uint32_t(i);
+      laidOut.m_X0 = penX + glyph->offset_x;
+      laidOut.m_OffsetY = glyph->offset_y;
+      laidOut.m_Width = (float)glyph->width;
+      laidOut.m_Height = (float)glyph->height;
+      laidOut.m_S0 = glyph->s0;
+      laidOut.m_T0 = glyph->t0;
+      laidOut.m_S1 = glyph->s1;
+      laidOut.m_T1 = glyph->t1;
+      laidOut.m_Extent = float(maxX - minX);
+      run.m_Glyphs.push_back(laidOut);
+
+      penX += glyph->advance_x;
+      run.m_Height = std::max(run.m_Height, (float)glyph->height);
     }
   }
+  run.m_Advance = penX;
+  return run;
+}
+
+//-----------------------------------------------------------------------------
+size_t TextRenderer::CountFittingGlyphs(const GlyphRun& a_Run,
+                                        float a_MaxWidth) {
+  // Extents only grow along the run.
+  auto first = std::partition_point(
+      a_Run.m_Glyphs.begin(), a_Run.m_Glyphs.end(),
+      [a_MaxWidth](const Glyph& a_Glyph) {
+        return a_Glyph.m_Extent <= a_MaxWidth;
+      });
+  return size_t(first - a_Run.m_Glyphs.begin());
+}
+
+//-----------------------------------------------------------------------------
+void TextRenderer::AddTextInternal(texture_font_t* font, const char* text,
+                                   const Color& color, const vec2& pen,
+                                   float a_MaxSize, float a_Z, bool) {
+  const GlyphRun& run = GetGlyphRun(font, text);
+  float maxWidth = a_MaxSize == -1.f ? FLT_MAX : ToScreenSpace(a_MaxSize);
+  size_t numGlyphs = CountFittingGlyphs(run, maxWidth);
+  for (size_t i = 0; i < numGlyphs; ++i) {
+    const Glyph& glyph = run.m_Glyphs[i];
+    int x0 = (int)(pen.x + glyph.m_X0);
+    int y0 = (int)(pen.y + glyph.m_OffsetY);
+    GlyphInstance instance;
+    instance.m_X0 = (float)x0;
+    instance.m_Y0 = (float)y0;
+    instance.m_X1 = (float)(int)(x0 + glyph.m_Width);
+    instance.m_Y1 = (float)(int)(y0 - glyph.m_Height);
+    instance.m_S0 = glyph.m_S0;
+    instance.m_T0 = glyph.m_T0;
+    instance.m_S1 = glyph.m_S1;
+    instance.m_T1 = glyph.m_T1;
+    instance.m_Color = color;
+    instance.m_Z = a_Z;
+    m_Instances.push_back(instance);
+  }
+  m_InstancesChanged = true;
 }
 
 //-----------------------------------------------------------------------------
@@ -226,48 +375,20 @@ void TextRenderer::AddText(const char* a_Text, float a_X, float a_Y, float a_Z,
     m_Pen.x -= stringWidth;
   }
 
-  AddTextInternal(m_Font, a_Text, ColorToVec4(a_Color), &m_Pen, a_MaxSize, a_Z);
+  AddTextInternal(m_Font, a_Text, a_Color, m_Pen, a_MaxSize, a_Z);
 }
 
 //-----------------------------------------------------------------------------
 void TextRenderer::AddTextTrailingCharsPrioritized(
     const char* a_Text, float a_X, float a_Y, float a_Z, const Color& a_Color,
     size_t a_TrailingCharsLength, float a_MaxSize) {
-  float tempPenX = ToScreenSpace(a_X);
   float maxWidth = a_MaxSize == -1.f ? FLT_MAX : ToScreenSpace(a_MaxSize);
-  float strWidth = 0.f;
-  int minX = INT_MAX;
-  int maxX = -INT_MAX;
-
   const size_t textLen = strlen(a_Text);
 
-  size_t i;
-  for (i = 0; i < textLen; ++i) {
-    if (!texture_font_find_glyph(m_Font, a_Text + i)) {
-      texture_font_load_glyph(m_Font, a_Text + i);
-    }
-
-    texture_glyph_t* glyph = texture_font_get_glyph(m_Font, a_Text + i);
-    if (glyph != NULL) {
-      float kerning = 0.0f;
-      if (i > 0) {
-        kerning = texture_glyph_get_kerning(glyph, a_Text + i - 1);
-      }
-      tempPenX += kerning;
-      int x0 = (int)(tempPenX + glyph->offset_x);
-      int x1 = (int)(x0 + glyph->width);
-
-      minX = std::min(minX, x0);
-      maxX = std::max(maxX, x1);
-      strWidth = float(maxX - minX);
-
-      if (strWidth > maxWidth) {
-        break;
-      }
-
-      tempPenX += glyph->advance_x;
-    }
-  }
+  const GlyphRun& run = GetGlyphRun(m_Font, a_Text);
+  size_t numGlyphs = CountFittingGlyphs(run, maxWidth);
+  size_t i = numGlyphs < run.m_Glyphs.size() ? run.m_Glyphs[numGlyphs].m_Char
+                                              : textLen;
 
   // TODO: Technically, we'd want the size of "... <TIME>" + remaining
   // characters
@@ -313,7 +434,7 @@ int TextRenderer::AddText2D(const char* a_Text, int a_X, int a_Y, float a_Z,
   m_Pen.x = (float)a_X;
   m_Pen.y = a_InvertY ? (float)(m_Canvas->getHeight() - a_Y) : (float)a_Y;
 
-  AddTextInternal(m_Font, a_Text, ColorToVec4(a_Color), &m_Pen, a_MaxSize, a_Z);
+  AddTextInternal(m_Font, a_Text, a_Color, m_Pen, a_MaxSize, a_Z);
 
   return a_X;
 }
@@ -321,27 +442,9 @@ int TextRenderer::AddText2D(const char* a_Text, int a_X, int a_Y, float a_Z,
 //-----------------------------------------------------------------------------
 void TextRenderer::GetStringSize(const char* a_Text, int& a_Width,
                                  int& a_Height) {
-  float stringWidth = 0;
-  float stringHeight = 0;
-
-  std::size_t len = strlen(a_Text);
-  for (std::size_t i = 0; i < len; ++i) {
-    texture_glyph_t* glyph = texture_font_get_glyph(m_Font, a_Text + i);
-    if (glyph != NULL) {
-      float kerning = 0.0f;
-      if (i > 0) {
-        kerning = texture_glyph_get_kerning(glyph, a_Text + i - 1);
-      }
-
-      stringWidth += kerning;
-      stringWidth += glyph->advance_x;
-
-      if (glyph->height > stringHeight) stringHeight = (float)glyph->height;
-    }
-  }
-
-  a_Width = (int)stringWidth;
-  a_Height = (int)stringHeight;
+  const GlyphRun& run = GetGlyphRun(m_Font, a_Text);
+  a_Width = (int)run.m_Advance;
+  a_Height = (int)run.m_Height;
 }
 
 //-----------------------------------------------------------------------------
@@ -371,9 +474,8 @@ float TextRenderer::ToScreenSpace(float a_Size) {
 void TextRenderer::Clear() {
   m_Pen.x = 0.f;
   m_Pen.y = 0.f;
-  if (m_Buffer) {
-    vertex_buffer_clear(m_Buffer);
-  }
+  m_Instances.clear();
+  m_InstancesChanged = true;
 }
 
 //-----------------------------------------------------------------------------
@@ -383,5 +485,5 @@ const TextBox& TextRenderer::GetSceneBox() const {
 
 //-----------------------------------------------------------------------------
 int TextRenderer::GetNumCharacters() const {
-  return int(m_Buffer->vertices->size) / 4;
+  return int(m_Instances.size());
 }
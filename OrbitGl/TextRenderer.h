@@ -4,10 +4,14 @@
 #pragma once
 
 #include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "OpenGl.h"
 #include "Platform.h"
 #include "TextBox.h"
+#include "VertexBuffer.h"
 #include "freetype-gl/freetype-gl.h"
 #include "mat4.h"
 
@@ -16,6 +20,13 @@ struct vertex_buffer_t;
 struct texture_font_t;
 }  // namespace ftgl
 
+//-----------------------------------------------------------------------------
+// Text is laid out once per string and font into a cached run of glyphs,
+// since the same labels are added again on each update of the time graph.
+// Each glyph added is then a single instance, placed in screen space, drawn
+// from the glyph atlas with one instanced draw. Instances and the atlas are
+// only sent to the GPU when they changed. Without OpenGL 3.3, the instances
+// are drawn as triangles through a freetype-gl vertex buffer.
 class TextRenderer {
  public:
   TextRenderer();
@@ -46,20 +57,58 @@ class TextRenderer {
   void SetFontSize(int a_Size);
 
  protected:
+  struct Glyph {
+    // Index of the character in the string.
+    uint32_t m_Char;
+    // Left of the glyph, from the pen at the start of the string.
+    float m_X0;
+    float m_OffsetY;
+    float m_Width;
+    float m_Height;
+    float m_S0, m_T0, m_S1, m_T1;
+    // Width of the string up to and including this glyph.
+    float m_Extent;
+  };
+  struct GlyphRun {
+    std::vector<Glyph> m_Glyphs;
+    float m_Advance = 0.f;
+    float m_Height = 0.f;
+  };
+  struct GlyphInstance {
+    float m_X0, m_Y0, m_X1, m_Y1;
+    float m_S0, m_T0, m_S1, m_T1;
+    Color m_Color;
+    float m_Z;
+  };
+
   void AddTextInternal(texture_font_t* font, const char* text,
-                       const vec4& color, vec2* pen, float a_MaxSize = -1.f,
-                       float a_Z = -0.01f, bool a_Static = false);
+                       const Color& color, const vec2& pen,
+                       float a_MaxSize = -1.f, float a_Z = -0.01f,
+                       bool a_Static = false);
+  const GlyphRun& GetGlyphRun(texture_font_t* a_Font, const char* a_Text);
+  // Number of glyphs of a_Run, from the first, that fit in a_MaxWidth.
+  static size_t CountFittingGlyphs(const GlyphRun& a_Run, float a_MaxWidth);
   void ToScreenSpace(float a_X, float a_Y, float& o_X, float& o_Y);
   float ToScreenSpace(float a_Size);
-  void DrawOutline(vertex_buffer_t* a_Buffer);
+  void DrawInstances();
+  void DrawVertexBuffer();
+  void DrawOutline();
 
  private:
   texture_atlas_t* m_Atlas;
   vertex_buffer_t* m_Buffer;
   texture_font_t* m_Font;
   std::map<int, texture_font_t*> m_FontsBySize;
+  std::map<const texture_font_t*, std::unordered_map<std::string, GlyphRun>>
+      m_GlyphRuns;
+  std::vector<GlyphInstance> m_Instances;
+  VertexBuffer m_InstanceBuffer;
+  bool m_InstancesChanged;
+  bool m_AtlasChanged;
   GlCanvas* m_Canvas;
   GLuint m_Shader;
+  // Instanced program, 0 without OpenGL 3.3.
+  GLuint m_InstanceProgram;
   mat4 m_Model;
   mat4 m_View;
   mat4 m_Proj;
@@ -1,17 +1,24 @@
 #include "ThreadTrack.h"
 
+#include <algorithm>
 #include <limits>
+#include <string>
 
+#include "Capture.h"
 #include "EventTrack.h"
 #include "GlCanvas.h"
+#include "TextRenderer.h"
 #include "TimeGraph.h"
+#include "absl/strings/str_format.h"
 
 //-----------------------------------------------------------------------------
-ThreadTrack::ThreadTrack(TimeGraph* a_TimeGraph, uint32_t a_ThreadID) {
+ThreadTrack::ThreadTrack(TimeGraph* a_TimeGraph, uint32_t a_ThreadID,
+                         uint32_t a_Index) {
   m_TimeGraph = a_TimeGraph;
   m_ID = a_ThreadID;
   m_TextRenderer = a_TimeGraph->GetTextRenderer();
   m_ThreadID = a_ThreadID;
+  m_Index = a_Index;
 
   m_NumTimers = 0;
   m_MinTime = std::numeric_limits<TickType>::max();
@@ -24,7 +31,7 @@ ThreadTrack::ThreadTrack(TimeGraph* a_TimeGraph, uint32_t a_ThreadID) {
 //-----------------------------------------------------------------------------
 void ThreadTrack::Draw(GlCanvas* a_Canvas, bool a_Picking) {
   TimeGraphLayout& layout = m_TimeGraph->GetLayout();
-  float threadOffset = layout.GetThreadBlockStart(m_ID);
+  float threadOffset = layout.GetTrackBlockStart(m_Index);
   float trackHeight = GetHeight();
   float trackWidth = a_Canvas->GetWorldWidth() * m_TimeGraph->GetMarginRatio();
 
@@ -38,33 +45,198 @@ void ThreadTrack::Draw(GlCanvas* a_Canvas, bool a_Picking) {
   m_EventTrack->SetSize(a_Canvas->GetWorldWidth(),
                         m_TimeGraph->GetLayout().GetEventTrackHeight());
   m_EventTrack->Draw(a_Canvas, a_Picking);
+
+  if (layout.GetDrawFileIO() && !a_Picking) {
+    DrawFileIo(a_Canvas, layout.GetFileIOTrackOffset(m_ID));
+  }
+
+  if (layout.GetDrawPageFaults() && !a_Picking) {
+    DrawPageFaults(a_Canvas, layout.GetPageFaultTrackOffset(m_ID));
+  }
+
+  if (Capture::GHasThreadStates && !a_Picking) {
+    DrawThreadStates(a_Canvas, layout.GetThreadStateTrackOffset(m_ID));
+  }
+}
+
+//-----------------------------------------------------------------------------
+void ThreadTrack::DrawThreadStates(GlCanvas* a_Canvas, float a_PosY) {
+  float world_x = a_Canvas->GetWorldTopLeftX();
+  TickType min_tick = m_TimeGraph->GetTickFromWorld(world_x);
+  TickType max_tick =
+      m_TimeGraph->GetTickFromWorld(world_x + a_Canvas->GetWorldWidth());
+  float y0 = a_PosY;
+  float y1 = y0 - m_TimeGraph->GetLayout().GetEventTrackHeight();
+
+  ScopeLock lock(m_Mutex);
+  glBegin(GL_QUADS);
+  m_ThreadStates.ForEachSliceInRange(
+      min_tick, max_tick, [&](const ThreadStateTimeline::Slice& slice) {
+        float x0 = m_TimeGraph->GetWorldFromTick(slice.begin);
+        float x1 = m_TimeGraph->GetWorldFromTick(slice.end);
+        Color color = GetThreadStateColor(slice.state);
+        glColor4ubv(&color[0]);
+        glVertex3f(x0, y0, -0.1f);
+        glVertex3f(x1, y0, -0.1f);
+        glVertex3f(x1, y1, -0.1f);
+        glVertex3f(x0, y1, -0.1f);
+      });
+  glEnd();
+}
+
+//-----------------------------------------------------------------------------
+void ThreadTrack::DrawFileIo(GlCanvas* a_Canvas, float a_PosY) {
+  float world_x = a_Canvas->GetWorldTopLeftX();
+  float world_width = a_Canvas->GetWorldWidth();
+  TickType min_tick = m_TimeGraph->GetTickFromWorld(world_x);
+  TickType max_tick = m_TimeGraph->GetTickFromWorld(world_x + world_width);
+  int num_pixels = std::max(a_Canvas->getWidth(), 1);
+  // I/Os closer than a pixel are drawn as one quad.
+  TickType ticks_per_pixel = (max_tick - min_tick) / num_pixels;
+  float y0 = a_PosY;
+  float y1 = y0 - m_TimeGraph->GetLayout().GetEventTrackHeight();
+  // Spans are labeled when there is room for a few characters.
+  const float kMinLabelWidth = 40.f * world_width / num_pixels;
+  const Color kMixedColor(100, 100, 100, 255);
+  const Color kTextColor(255, 255, 255, 255);
+
+  ScopeLock lock(m_Mutex);
+  glBegin(GL_QUADS);
+  m_FileIos.ForEachSpanInRange(
+      min_tick, max_tick, ticks_per_pixel,
+      [&](const FileIoTimeline::Span& span) {
+        float x0 = m_TimeGraph->GetWorldFromTick(span.begin);
+        float x1 = m_TimeGraph->GetWorldFromTick(span.end);
+        Color color = span.has_single_syscall ? GetFileIoColor(span.syscall)
+                                              : kMixedColor;
+        glColor4ubv(&color[0]);
+        glVertex3f(x0, y0, -0.1f);
+        glVertex3f(x1, y0, -0.1f);
+        glVertex3f(x1, y1, -0.1f);
+        glVertex3f(x0, y1, -0.1f);
+
+        if (x1 - x0 < kMinLabelWidth) return;
+        const FileIo& file_io = span.first_file_io;
+        std::string label =
+            span.num_file_ios == 1
+                ? absl::StrFormat("%s(%d) = %d",
+                                  GetFileIoSyscallName(file_io.syscall),
+                                  file_io.fd, file_io.result)
+                : absl::StrFormat("%u I/Os, %u bytes", span.num_file_ios,
+                                  span.num_bytes);
+        m_TextRenderer->AddText(label.c_str(), std::max(x0, world_x), y1,
+                                GlCanvas::Z_VALUE_TEXT, kTextColor,
+                                x1 - std::max(x0, world_x));
+      });
+  glEnd();
+}
+
+//-----------------------------------------------------------------------------
+void ThreadTrack::DrawPageFaults(GlCanvas* a_Canvas, float a_PosY) {
+  float world_x = a_Canvas->GetWorldTopLeftX();
+  float world_width = a_Canvas->GetWorldWidth();
+  TickType min_tick = m_TimeGraph->GetTickFromWorld(world_x);
+  TickType max_tick = m_TimeGraph->GetTickFromWorld(world_x + world_width);
+  int num_pixels = std::max(a_Canvas->getWidth(), 1);
+  float pixel_width = world_width / num_pixels;
+  float y0 = a_PosY;
+  float y1 = y0 - m_TimeGraph->GetLayout().GetEventTrackHeight();
+  const Color kMajorColor(255, 0, 0, 255);
+  const Color kMinorColor(255, 255, 0, 255);
+
+  ScopeLock lock(m_Mutex);
+  auto it = std::lower_bound(
+      m_PageFaults.begin(), m_PageFaults.end(), min_tick,
+      [](const PageFault& fault, TickType tick) {
+        return fault.m_Time < tick;
+      });
+  // Faults within a pixel are drawn as one tick, red if any of them is major.
+  glBegin(GL_QUADS);
+  while (it != m_PageFaults.end() && it->m_Time <= max_tick) {
+    float x0 = m_TimeGraph->GetWorldFromTick(it->m_Time);
+    float x1 = x0 + pixel_width;
+    bool major = false;
+    for (; it != m_PageFaults.end() &&
+           m_TimeGraph->GetWorldFromTick(it->m_Time) < x1;
+         ++it) {
+      major |= it->m_Major;
+    }
+    const Color& color = major ? kMajorColor : kMinorColor;
+    glColor4ubv(&color[0]);
+    glVertex3f(x0, y0, -0.1f);
+    glVertex3f(x1, y0, -0.1f);
+    glVertex3f(x1, y1, -0.1f);
+    glVertex3f(x0, y1, -0.1f);
+  }
+  glEnd();
 }
 
 //-----------------------------------------------------------------------------
 void ThreadTrack::OnDrag(int a_X, int a_Y) { Track::OnDrag(a_X, a_Y); }
 
 //-----------------------------------------------------------------------------
-void ThreadTrack::OnTimer(const Timer& a_Timer) {
+const CompactTimer* ThreadTrack::OnTimer(const Timer& a_Timer) {
   UpdateDepth(a_Timer.m_Depth + 1);
-  TextBox textBox(Vec2(0, 0), Vec2(0, 0), "", Color(255, 0, 0, 255));
-  textBox.SetTimer(a_Timer);
 
-  std::shared_ptr<TimerChain> timerChain = m_Timers[a_Timer.m_Depth];
+  TimerChain* timerChain = m_WriterChains[a_Timer.m_Depth];
   if (timerChain == nullptr) {
-    timerChain = std::make_shared<TimerChain>();
-    m_Timers[a_Timer.m_Depth] = timerChain;
+    timerChain = AddTimerChain(a_Timer.m_Depth);
   }
-  timerChain->push_back(textBox);
+  const CompactTimer& timer = timerChain->Add(a_Timer);
   ++m_NumTimers;
   if (a_Timer.m_Start < m_MinTime) m_MinTime = a_Timer.m_Start;
   if (a_Timer.m_End > m_MaxTime) m_MaxTime = a_Timer.m_End;
+  return &timer;
+}
+
+//-----------------------------------------------------------------------------
+TimerChain* ThreadTrack::AddTimerChain(uint32_t a_Depth) {
+  auto timerChain = std::make_shared<TimerChain>(
+      m_TimeGraph->GetTimerTables(), m_TimeGraph->GetTimerAllocator());
+  m_WriterChains[a_Depth] = timerChain.get();
+  ScopeLock lock(m_Mutex);
+  m_Timers[a_Depth] = timerChain;
+  return timerChain.get();
+}
+
+//-----------------------------------------------------------------------------
+void ThreadTrack::OnThreadStateChange(
+    const ThreadStateChange& thread_state_change) {
+  ScopeLock lock(m_Mutex);
+  m_ThreadStates.Add(thread_state_change);
+}
+
+//-----------------------------------------------------------------------------
+void ThreadTrack::OnFileIo(const FileIo& file_io) {
+  ScopeLock lock(m_Mutex);
+  m_FileIos.Add(file_io);
+}
+
+//-----------------------------------------------------------------------------
+void ThreadTrack::OnPageFault(TickType a_Time, bool a_Major) {
+  ScopeLock lock(m_Mutex);
+  m_PageFaults.push_back({a_Time, a_Major});
+}
+
+//-----------------------------------------------------------------------------
+std::vector<uint64_t> ThreadTrack::ComputeLatencyToRunHistogram(
+    uint64_t bucket_width_ns, size_t bucket_count) const {
+  ScopeLock lock(m_Mutex);
+  return m_ThreadStates.ComputeLatencyToRunHistogram(bucket_width_ns,
+                                                     bucket_count);
+}
+
+//-----------------------------------------------------------------------------
+std::optional<ThreadStateTimeline::Slice> ThreadTrack::GetThreadStateBefore(
+    TickType a_Time) const {
+  ScopeLock lock(m_Mutex);
+  return m_ThreadStates.GetSliceBefore(a_Time);
 }
 
 //-----------------------------------------------------------------------------
 float ThreadTrack::GetHeight() const {
   TimeGraphLayout& layout = m_TimeGraph->GetLayout();
-  return layout.GetTextBoxHeight() * GetDepth() +
-         layout.GetSpaceBetweenTracksAndThread() + layout.GetEventTrackHeight();
+  return layout.GetTextBoxHeight() * GetDepth() + layout.GetTracksHeight();
 }
 
 //-----------------------------------------------------------------------------
@@ -96,39 +268,52 @@ Color ThreadTrack::GetColor(ThreadID a_TID) {
 }
 
 //-----------------------------------------------------------------------------
-const TextBox* ThreadTrack::GetFirstAfterTime(TickType a_Tick,
-                                              uint32_t a_Depth) const {
-  std::shared_ptr<TimerChain> textBoxes = GetTimers(a_Depth);
-  if (textBoxes == nullptr) return nullptr;
-
-  // TODO: do better than linear search...
-  for (TextBox& textBox : *textBoxes) {
-    if (textBox.GetTimer().m_Start > a_Tick) {
-      return &textBox;
-    }
+Color ThreadTrack::GetThreadStateColor(ThreadStateChange::State a_State) {
+  switch (a_State) {
+    case ThreadStateChange::kRunning:
+      return Color(87, 166, 74, 255);  // green
+    case ThreadStateChange::kRunnable:
+      return Color(43, 145, 175, 255);  // blue
+    case ThreadStateChange::kUninterruptibleSleep:
+      return Color(248, 101, 22, 255);  // orange
+    case ThreadStateChange::kStopped:
+    case ThreadStateChange::kTraced:
+      return Color(231, 68, 53, 255);  // red
+    default:
+      return Color(100, 100, 100, 255);  // grey, for all other sleeps
   }
-
-  return nullptr;
 }
 
 //-----------------------------------------------------------------------------
-const TextBox* ThreadTrack::GetFirstBeforeTime(TickType a_Tick,
-                                               uint32_t a_Depth) const {
-  std::shared_ptr<TimerChain> textBoxes = GetTimers(a_Depth);
-  if (textBoxes == nullptr) return nullptr;
-
-  TextBox* textBox = nullptr;
-
-  // TODO: do better than linear search...
-  for (TextBox& box : *textBoxes) {
-    if (box.GetTimer().m_Start > a_Tick) {
-      return textBox;
-    }
-
-    textBox = &box;
+Color ThreadTrack::GetFileIoColor(FileIo::Syscall a_Syscall) {
+  switch (a_Syscall) {
+    case FileIo::kRead:
+    case FileIo::kPread:
+      return Color(43, 145, 175, 255);  // blue
+    case FileIo::kWrite:
+    case FileIo::kPwrite:
+      return Color(248, 101, 22, 255);  // orange
+    case FileIo::kFsync:
+      return Color(231, 68, 53, 255);  // red
+    default:
+      return Color(87, 166, 74, 255);  // green, for openat
   }
+}
 
-  return nullptr;
+//-----------------------------------------------------------------------------
+const CompactTimer* ThreadTrack::GetFirstAfterTime(TickType a_Tick,
+                                                   uint32_t a_Depth) const {
+  std::shared_ptr<TimerChain> timers = GetTimers(a_Depth);
+  if (timers == nullptr) return nullptr;
+  return timers->FindFirstStartingAfter(a_Tick);
+}
+
+//-----------------------------------------------------------------------------
+const CompactTimer* ThreadTrack::GetFirstBeforeTime(TickType a_Tick,
+                                                    uint32_t a_Depth) const {
+  std::shared_ptr<TimerChain> timers = GetTimers(a_Depth);
+  if (timers == nullptr) return nullptr;
+  return timers->FindLastStartingBefore(a_Tick);
 }
 
 //-----------------------------------------------------------------------------
@@ -140,40 +325,38 @@ std::shared_ptr<TimerChain> ThreadTrack::GetTimers(uint32_t a_Depth) const {
 }
 
 //-----------------------------------------------------------------------------
-const TextBox* ThreadTrack::GetLeft(TextBox* a_TextBox) const {
-  const Timer& timer = a_TextBox->GetTimer();
-  if (timer.m_TID == m_ThreadID) {
-    std::shared_ptr<TimerChain> timers = GetTimers(timer.m_Depth);
-    if (timers) return timers->GetElementBefore(a_TextBox);
+const CompactTimer* ThreadTrack::GetLeft(const CompactTimer* a_Timer) const {
+  if (a_Timer->m_TID == m_ThreadID) {
+    std::shared_ptr<TimerChain> timers = GetTimers(a_Timer->m_Depth);
+    if (timers) return timers->GetElementBefore(a_Timer);
   }
   return nullptr;
 }
 
 //-----------------------------------------------------------------------------
-const TextBox* ThreadTrack::GetRight(TextBox* a_TextBox) const {
-  const Timer& timer = a_TextBox->GetTimer();
-  if (timer.m_TID == m_ThreadID) {
-    std::shared_ptr<TimerChain> timers = GetTimers(timer.m_Depth);
-    if (timers) return timers->GetElementAfter(a_TextBox);
+const CompactTimer* ThreadTrack::GetRight(
+    const CompactTimer* a_Timer) const {
+  if (a_Timer->m_TID == m_ThreadID) {
+    std::shared_ptr<TimerChain> timers = GetTimers(a_Timer->m_Depth);
+    if (timers) return timers->GetElementAfter(a_Timer);
   }
   return nullptr;
 }
 
 //-----------------------------------------------------------------------------
-const TextBox* ThreadTrack::GetUp(TextBox* a_TextBox) const {
-  const Timer& timer = a_TextBox->GetTimer();
-  return GetFirstBeforeTime(timer.m_Start, timer.m_Depth - 1);
+const CompactTimer* ThreadTrack::GetUp(const CompactTimer* a_Timer) const {
+  return GetFirstBeforeTime(a_Timer->m_Start, a_Timer->m_Depth - 1);
 }
 
 //-----------------------------------------------------------------------------
-const TextBox* ThreadTrack::GetDown(TextBox* a_TextBox) const {
-  const Timer& timer = a_TextBox->GetTimer();
-  return GetFirstAfterTime(timer.m_Start, timer.m_Depth + 1);
+const CompactTimer* ThreadTrack::GetDown(const CompactTimer* a_Timer) const {
+  return GetFirstAfterTime(a_Timer->m_Start, a_Timer->m_Depth + 1);
 }
 
 //-----------------------------------------------------------------------------
 std::vector<std::shared_ptr<TimerChain>> ThreadTrack::GetAllChains() const {
   std::vector<std::shared_ptr<TimerChain>> chains;
+  ScopeLock lock(m_Mutex);
   for (const auto& pair : m_Timers) {
     chains.push_back(pair.second);
   }
@@ -3,35 +3,48 @@
 //-----------------------------------
 #pragma once
 
+#include <array>
 #include <map>
 #include <memory>
+#include <optional>
 
 #include "BlockChain.h"
 #include "CallstackTypes.h"
-#include "TextBox.h"
+#include "FileIoTimeline.h"
+#include "ThreadStateTimeline.h"
 #include "Threading.h"
+#include "TimerChain.h"
 #include "Track.h"
 
 class TextRenderer;
 class EventTrack;
 
-typedef BlockChain<TextBox, 4 * 1024> TimerChain;
-
 //-----------------------------------------------------------------------------
 class ThreadTrack : public Track {
  public:
-  ThreadTrack(TimeGraph* a_TimeGraph, uint32_t a_ThreadID);
+  // a_Index is the compact index of the track in its TimeGraph, by order of
+  // creation, under which TimeGraphLayout keeps its layout.
+  ThreadTrack(TimeGraph* a_TimeGraph, uint32_t a_ThreadID, uint32_t a_Index);
 
   // Pickable
   void Draw(GlCanvas* a_Canvas, bool a_Picking) override;
   void OnDrag(int a_X, int a_Y) override;
-  void OnTimer(const Timer& a_Timer);
+  // Adds a timer. Only called by the thread processing the timers, while any
+  // other thread reads them: see TimerChain.
+  // Returns the compact copy of a_Timer in its chain, which stays there until
+  // the track is destroyed.
+  const CompactTimer* OnTimer(const Timer& a_Timer);
+  void OnThreadStateChange(const ThreadStateChange& thread_state_change);
+  void OnFileIo(const FileIo& file_io);
+  // Only called in order of time, by the thread processing the timers.
+  void OnPageFault(TickType a_Time, bool a_Major);
 
   // Track
   float GetHeight() const override;
 
   std::vector<std::shared_ptr<TimerChain>> GetTimers();
   uint32_t GetDepth() const { return m_Depth; }
+  uint32_t GetIndex() const { return m_Index; }
 
   Color GetColor() const;
   static Color GetColor(ThreadID a_TID);
@@ -40,16 +53,27 @@ class ThreadTrack : public Track {
   TickType GetMinTime() const { return m_MinTime; }
   TickType GetMaxTime() const { return m_MaxTime; }
 
-  const TextBox* GetFirstAfterTime(TickType a_Tick, uint32_t a_Depth) const;
-  const TextBox* GetFirstBeforeTime(TickType a_Tick, uint32_t a_Depth) const;
+  const CompactTimer* GetFirstAfterTime(TickType a_Tick,
+                                        uint32_t a_Depth) const;
+  const CompactTimer* GetFirstBeforeTime(TickType a_Tick,
+                                         uint32_t a_Depth) const;
 
-  const TextBox* GetLeft(TextBox* a_TextBox) const;
-  const TextBox* GetRight(TextBox* a_TextBox) const;
-  const TextBox* GetUp(TextBox* a_TextBox) const;
-  const TextBox* GetDown(TextBox* a_TextBox) const;
+  const CompactTimer* GetLeft(const CompactTimer* a_Timer) const;
+  const CompactTimer* GetRight(const CompactTimer* a_Timer) const;
+  const CompactTimer* GetUp(const CompactTimer* a_Timer) const;
+  const CompactTimer* GetDown(const CompactTimer* a_Timer) const;
 
   std::vector<std::shared_ptr<TimerChain>> GetAllChains() const;
 
+  // Bucket i counts the waits to run, after being woken up, between i and
+  // i + 1 times bucket_width_ns. See ThreadStateTimeline.
+  std::vector<uint64_t> ComputeLatencyToRunHistogram(uint64_t bucket_width_ns,
+                                                     size_t bucket_count) const;
+  // The state of the thread right before a_Time, see
+  // ThreadStateTimeline::GetSliceBefore.
+  std::optional<ThreadStateTimeline::Slice> GetThreadStateBefore(
+      TickType a_Time) const;
+
   bool GetVisible() const { return m_Visible; }
   void SetVisible(bool value) { m_Visible = value; }
 
@@ -58,12 +82,19 @@ class ThreadTrack : public Track {
     if (a_Depth > m_Depth) m_Depth = a_Depth;
   }
   std::shared_ptr<TimerChain> GetTimers(uint32_t a_Depth) const;
+  TimerChain* AddTimerChain(uint32_t a_Depth);
+  void DrawThreadStates(GlCanvas* a_Canvas, float a_PosY);
+  static Color GetThreadStateColor(ThreadStateChange::State a_State);
+  void DrawFileIo(GlCanvas* a_Canvas, float a_PosY);
+  static Color GetFileIoColor(FileIo::Syscall a_Syscall);
+  void DrawPageFaults(GlCanvas* a_Canvas, float a_PosY);
 
  protected:
   TextRenderer* m_TextRenderer = nullptr;
   std::shared_ptr<EventTrack> m_EventTrack;
-  uint32_t m_Depth = 1;
+  std::atomic<uint32_t> m_Depth = 1;
   ThreadID m_ThreadID;
+  uint32_t m_Index;
   bool m_Visible = true;
 
   std::atomic<uint32_t> m_NumTimers;
@@ -72,4 +103,15 @@ class ThreadTrack : public Track {
   mutable Mutex m_Mutex;
 
   std::map<int, std::shared_ptr<TimerChain>> m_Timers;
+  // The chains of m_Timers by depth, only used by OnTimer so that adding a
+  // timer takes no lock. m_Timers keeps them alive.
+  std::array<TimerChain*, 256> m_WriterChains = {};
+  ThreadStateTimeline m_ThreadStates;
+  FileIoTimeline m_FileIos;
+  struct PageFault {
+    TickType m_Time;
+    bool m_Major;
+  };
+  // Sorted by time.
+  std::vector<PageFault> m_PageFaults;
 };
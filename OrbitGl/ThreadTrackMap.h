@@ -5,6 +5,7 @@
 
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 #include "CallstackTypes.h"
 
@@ -12,4 +13,7 @@ class ThreadTrack;
 
 //-----------------------------------------------------------------------------
 typedef std::unordered_map<ThreadID, std::shared_ptr<ThreadTrack> >
-    ThreadTrackMap;
\ No newline at end of file
+    ThreadTrackMap;
+
+// Indexed by ThreadTrack::GetIndex(), tracks are only ever appended to it.
+typedef std::vector<std::shared_ptr<ThreadTrack> > ThreadTrackList;
\ No newline at end of file
@@ -5,34 +5,53 @@
 #include "TimeGraph.h"
 
 #include <algorithm>
+#include <limits>
+#include <set>
+#include <thread>
+#include <unordered_map>
 
 #include "App.h"
 #include "Batcher.h"
 #include "Capture.h"
+#include "ConnectionManager.h"
 #include "EventTracer.h"
 #include "EventTrack.h"
+#include "FileIoTimeline.h"
 #include "Geometry.h"
 #include "GlCanvas.h"
+#include "HostConnection.h"
 #include "Log.h"
 #include "OrbitType.h"
 #include "OrbitUnreal.h"
 #include "Params.h"
+#include "Path.h"
 #include "Pdb.h"
 #include "PickingManager.h"
+#include "PmuCounters.h"
 #include "SamplingProfiler.h"
 #include "StringManager.h"
 #include "Systrace.h"
 #include "TextBox.h"
 #include "TextRenderer.h"
 #include "ThreadTrack.h"
+#include "TickToWorld.h"
 #include "TimerManager.h"
 #include "Utils.h"
+#include "absl/base/casts.h"
 #include "absl/strings/str_format.h"
 
 TimeGraph* GCurrentTimeGraph = nullptr;
 
 //-----------------------------------------------------------------------------
-TimeGraph::TimeGraph() { m_LastThreadReorder.Start(); }
+TimeGraph::TimeGraph() {
+  m_LastThreadReorder.Start();
+  m_NumPrimitivesWorkers =
+      std::max<size_t>(1, std::thread::hardware_concurrency());
+  m_PrimitivesWorkers =
+      std::make_unique<MessageWorkerPool>(m_NumPrimitivesWorkers);
+  m_SelectionWorker = std::make_unique<MessageWorkerPool>(1);
+  ResetTimerArena();
+}
 
 //-----------------------------------------------------------------------------
 void TimeGraph::SetStringManager(std::shared_ptr<StringManager> str_manager) {
@@ -54,19 +73,61 @@ void TimeGraph::SetFontSize(int a_FontSize) {
 
 //-----------------------------------------------------------------------------
 void TimeGraph::Clear() {
+  // The workers hold pointers to the text boxes of the tracks cleared below.
+  m_PrimitivesWorkers->WaitUntilIdle();
+  m_PrimitivesUpdate.reset();
+  // The selection worker reads the samples cleared below.
+  CancelSelectionReport();
+  m_SelectionWorker->WaitUntilIdle();
+  m_SelectionReportUpdate.reset();
   m_Batcher.Reset();
+  m_TimerInstances.Clear();
   m_SessionMinCounter = 0xFFFFFFFFFFFFFFFF;
   m_SessionMaxCounter = 0;
-  m_ThreadCountMap.clear();
+  m_WriterThreadTracks.clear();
+  m_PendingFunctionStats.clear();
+  m_NumPendingFunctionStats = 0;
+  m_PendingOccurrences.clear();
+  m_OccurrenceIndex.Clear();
+  m_OnCpuTimeJoiner.Clear();
   GEventTracer.GetEventBuffer().Reset();
   m_MemTracker.Clear();
   m_Layout.Reset();
 
   ScopeLock lock(m_Mutex);
   m_ThreadTracks.clear();
+  m_ThreadTracksSnapshot = std::make_shared<ThreadTrackList>();
+
+  m_ContextSwitchPairer.Clear();
+  {
+    ScopeLock onCpuLock(m_OnCpuTimesMutex);
+    m_OnCpuTimes.clear();
+  }
+  m_ActiveCores.reset();
+  m_NumCores = 0;
+  m_HasFileIo = false;
+  m_HasPageFaults = false;
+  ResetTimerArena();
+  m_TimerTables = std::make_shared<TimerTables>();
+
+  ScopeLock frameLock(m_FrameIndexMutex);
+  m_FrameIndex.Clear();
+  m_FrameThreadId.reset();
+  m_NextWorstFrame = 0;
+  m_CriticalPath.clear();
+  m_CriticalPathText.clear();
+
+  ScopeLock counterLock(m_CounterSeriesMutex);
+  m_CounterSeries.clear();
+}
 
-  m_ContextSwitchesMap.clear();
-  m_CoreUtilizationMap.clear();
+//-----------------------------------------------------------------------------
+void TimeGraph::ResetTimerArena() {
+  m_TimerArena.reset();
+  if (GParams.m_TimerMemoryBudgetMb > 0) {
+    size_t budget = size_t(GParams.m_TimerMemoryBudgetMb) * 1024 * 1024;
+    m_TimerArena = std::make_shared<SpillArena>(Path::GetTmpPath(), budget);
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -107,16 +168,19 @@ void TimeGraph::ZoomAll() {
     if (m_MinTimeUs < 0) m_MinTimeUs = 0;
 
     NeedsUpdate();
-    UpdatePrimitives(false);
+    UpdatePrimitives();
   }
 }
 
 //-----------------------------------------------------------------------------
-void TimeGraph::Zoom(const TextBox* a_TextBox) {
-  const Timer& timer = a_TextBox->GetTimer();
+void TimeGraph::Zoom(const Timer& a_Timer) {
+  Zoom(a_Timer.m_Start, a_Timer.m_End);
+}
 
-  double start = MicroSecondsFromTicks(m_SessionMinCounter, timer.m_Start);
-  double end = MicroSecondsFromTicks(m_SessionMinCounter, timer.m_End);
+//-----------------------------------------------------------------------------
+void TimeGraph::Zoom(TickType a_Start, TickType a_End) {
+  double start = MicroSecondsFromTicks(m_SessionMinCounter, a_Start);
+  double end = MicroSecondsFromTicks(m_SessionMinCounter, a_End);
 
   double mid = start + ((end - start) / 2.0);
   double extent = 1.1 * (end - start) / 2.0;
@@ -170,6 +234,15 @@ void TimeGraph::SetMinMax(double a_MinTimeUs, double a_MaxTimeUs) {
   NeedsUpdate();
 }
 
+//-----------------------------------------------------------------------------
+void TimeGraph::JumpTo(TickType a_Time) {
+  double width = m_MaxTimeUs - m_MinTimeUs;
+  double time = MicroSecondsFromTicks(m_SessionMinCounter, a_Time);
+  double maxMin = GetSessionTimeSpanUs() - width;
+  double min = std::max(std::min(time - width / 2, maxMin), 0.0);
+  SetMinMax(min, min + width);
+}
+
 //-----------------------------------------------------------------------------
 void TimeGraph::PanTime(int a_InitialX, int a_CurrentX, int a_Width,
                         double a_InitialTime) {
@@ -209,6 +282,7 @@ double TimeGraph::GetTimeIntervalMicro(double a_Ratio) {
 
 //-----------------------------------------------------------------------------
 void TimeGraph::ProcessTimer(const Timer& a_Timer) {
+  m_DataGeneration.fetch_add(1, std::memory_order_relaxed);
   if (a_Timer.m_End > m_SessionMaxCounter) {
     m_SessionMaxCounter = a_Timer.m_End;
   }
@@ -220,40 +294,151 @@ void TimeGraph::ProcessTimer(const Timer& a_Timer) {
     case Timer::FREE:
       m_MemTracker.ProcessFree(a_Timer);
       return;
-    case Timer::CORE_ACTIVITY:
+    case Timer::VARIABLE: {
+      ScopeLock lock(m_CounterSeriesMutex);
+      m_CounterSeries[a_Timer.m_UserData[0]].Add(
+          a_Timer.m_Start, absl::bit_cast<double>(a_Timer.m_UserData[1]));
+      return;
+    }
+    case Timer::FILE_IO:
+      GetWriterThreadTrack(a_Timer.m_TID)->OnFileIo(FileIoFromTimer(a_Timer));
+      m_HasFileIo = true;
+      return;
+    case Timer::PAGE_FAULT: {
+      bool major = a_Timer.m_UserData[0] != 0;
+      GetWriterThreadTrack(a_Timer.m_TID)->OnPageFault(a_Timer.m_Start, major);
+      Capture::GPageFaultProfile.AddPageFaults(
+          a_Timer.m_TID, a_Timer.m_CallstackHash, major, a_Timer.m_UserData[1]);
+      m_HasPageFaults = true;
+      return;
+    }
+    case Timer::LOCK_WAIT:
+      Capture::GLockContentionProfile.AddLockWait(
+          a_Timer.m_UserData[0], a_Timer.m_CallstackHash,
+          a_Timer.m_End - a_Timer.m_Start);
+      return;
+    case Timer::CORE_ACTIVITY: {
       Capture::GHasContextSwitches = true;
+      m_OnCpuTimeJoiner.AddActivity(a_Timer.m_TID, a_Timer.m_Start,
+                                    a_Timer.m_End);
+      auto core = static_cast<uint8_t>(a_Timer.m_Processor);
+      if (!m_ActiveCores.test(core)) {
+        m_ActiveCores.set(core);
+        ++m_NumCores;
+      }
       break;
+    }
     default:
       break;
   }
 
   if (a_Timer.m_FunctionAddress > 0) {
-    Function* func = Capture::GTargetProcess->GetFunctionFromAddress(
-        a_Timer.m_FunctionAddress);
-    if (func != nullptr) {
-      ++Capture::GFunctionCountMap[a_Timer.m_FunctionAddress];
-      func->UpdateStats(a_Timer);
+    m_PendingFunctionStats[a_Timer.m_FunctionAddress].Update(a_Timer);
+    if (++m_NumPendingFunctionStats == kFunctionStatsBatchSize) {
+      FlushFunctionStats();
+    }
+    if (a_Timer.m_FunctionAddress == m_FrameFunctionAddress) {
+      AddFrame(a_Timer);
     }
   }
 
   if (!a_Timer.IsType(Timer::THREAD_ACTIVITY) &&
       !a_Timer.IsType(Timer::CORE_ACTIVITY)) {
-    std::shared_ptr<ThreadTrack> track = GetThreadTrack(a_Timer.m_TID);
+    ThreadTrack* track = GetWriterThreadTrack(a_Timer.m_TID);
     if (a_Timer.m_Type == Timer::GPU_ACTIVITY) {
       track->SetName(string_manager_->Get(a_Timer.m_UserData[1]).value_or(""));
+      Capture::GCaptureOverview.AddRange(CaptureOverview::Row::kGpu,
+                                         a_Timer.m_Start, a_Timer.m_End);
+    } else if (a_Timer.m_Type == Timer::SERVICE_STATS) {
+      track->SetName(string_manager_->Get(a_Timer.m_UserData[0]).value_or(""));
+      static const uint64_t kLostKey = StringHash("lost/s");
+      if (a_Timer.m_UserData[0] == kLostKey) {
+        double lost_per_s = absl::bit_cast<double>(a_Timer.m_UserData[1]);
+        double window_s = (a_Timer.m_End - a_Timer.m_Start) / 1e9;
+        Capture::GCaptureOverview.Add(
+            CaptureOverview::Row::kLostEvents, a_Timer.m_End,
+            static_cast<uint64_t>(lost_per_s * window_s + 0.5));
+      }
+    } else {
+      Capture::GCaptureOverview.Add(CaptureOverview::Row::kTimers,
+                                    a_Timer.m_Start);
     }
 
-    track->OnTimer(a_Timer);
-    ++m_ThreadCountMap[a_Timer.m_TID];
+    const CompactTimer* timer = track->OnTimer(a_Timer);
+    if (a_Timer.m_FunctionAddress > 0) {
+      m_PendingOccurrences.push_back(timer);
+      if (a_Timer.m_Type == Timer::NONE) {
+        m_OnCpuTimeJoiner.AddTimer(a_Timer.m_TID, a_Timer.m_Start,
+                                   a_Timer.m_End, a_Timer.m_FunctionAddress,
+                                   reinterpret_cast<uintptr_t>(timer));
+        Capture::GInstrumentedCallTree.AddTimer(
+            a_Timer.m_TID, a_Timer.m_Start, a_Timer.m_End, a_Timer.m_Depth,
+            a_Timer.m_FunctionAddress);
+      }
+    }
     if (a_Timer.m_Type == Timer::INTROSPECTION) {
       const Color kGreenIntrospection(87, 166, 74, 255);
       track->SetColor(kGreenIntrospection);
     }
   } else {
     // Use thead 0 as container for scheduling events.
-    GetThreadTrack(0)->OnTimer(a_Timer);
-    ++m_ThreadCountMap[0];
+    GetWriterThreadTrack(0)->OnTimer(a_Timer);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::FlushFunctionStats() {
+  // The calls whose on-CPU time is now known are added to the stats of the
+  // batch, whether they are part of it or of an earlier one.
+  m_JoinedTimers.clear();
+  m_OnCpuTimeJoiner.Join(&m_JoinedTimers);
+  if (!m_JoinedTimers.empty()) {
+    ScopeLock lock(m_OnCpuTimesMutex);
+    for (const OnCpuTimeJoiner::JoinedTimer& joined : m_JoinedTimers) {
+      m_PendingFunctionStats[joined.function_address].AddOnCpuTime(
+          joined.wall_ns, joined.on_cpu_ns);
+      m_OnCpuTimes[reinterpret_cast<const CompactTimer*>(joined.key)] =
+          joined.on_cpu_ns;
+    }
   }
+
+  // Looking up the function of an address is what costs, so it is done once
+  // per function of the batch rather than once per timer.
+  std::vector<uint64_t> changed;
+  changed.reserve(m_PendingFunctionStats.size());
+  for (const auto& pair : m_PendingFunctionStats) {
+    Function* func =
+        Capture::GTargetProcess->GetFunctionFromAddress(pair.first);
+    // The stats of sampled functions come from the target, see
+    // OrbitApp::OnFunctionStats, as only some of their calls have timers.
+    if (func != nullptr && func->IsSampled()) {
+      continue;
+    }
+    Capture::GFunctionCountMap[pair.first] += pair.second.m_Count;
+    if (func != nullptr) {
+      func->UpdateStats(pair.second);
+    }
+    changed.push_back(pair.first);
+  }
+  if (!changed.empty()) {
+    Capture::GFunctionStatsChanges.Add(changed);
+  }
+  m_PendingFunctionStats.clear();
+  m_NumPendingFunctionStats = 0;
+
+  m_OccurrenceIndex.Add(m_PendingOccurrences);
+  m_PendingOccurrences.clear();
+}
+
+//-----------------------------------------------------------------------------
+std::optional<uint64_t> TimeGraph::GetOnCpuTimeNs(
+    const CompactTimer* a_Timer) const {
+  ScopeLock lock(m_OnCpuTimesMutex);
+  auto it = m_OnCpuTimes.find(a_Timer);
+  if (it == m_OnCpuTimes.end()) {
+    return std::nullopt;
+  }
+  return it->second;
 }
 
 //-----------------------------------------------------------------------------
@@ -268,10 +453,7 @@ uint32_t TimeGraph::GetNumTimers() const {
 }
 
 //-----------------------------------------------------------------------------
-uint32_t TimeGraph::GetNumCores() const {
-  ScopeLock lock(m_Mutex);
-  return m_CoreUtilizationMap.size();
-}
+uint32_t TimeGraph::GetNumCores() const { return m_NumCores; }
 
 //-----------------------------------------------------------------------------
 std::vector<std::shared_ptr<TimerChain>> TimeGraph::GetAllTimerChains() const {
@@ -285,55 +467,26 @@ std::vector<std::shared_ptr<TimerChain>> TimeGraph::GetAllTimerChains() const {
 
 //-----------------------------------------------------------------------------
 void TimeGraph::AddContextSwitch(const ContextSwitch& a_CS) {
-  auto pair = std::make_pair(a_CS.m_Time, a_CS);
-
-  if (a_CS.m_Type == ContextSwitch::Out) {
-    if (true) {
-      // Processor time line
-      std::map<long long, ContextSwitch>& csMap =
-          m_CoreUtilizationMap[a_CS.m_ProcessorIndex];
-
-      if (!csMap.empty()) {
-        ContextSwitch& lastCS = csMap.rbegin()->second;
-        if (lastCS.m_Type == ContextSwitch::In) {
-          Timer timer;
-          timer.m_Start = lastCS.m_Time;
-          timer.m_End = a_CS.m_Time;
-          timer.m_TID = a_CS.m_ThreadId;
-          timer.m_Processor = (int8_t)a_CS.m_ProcessorIndex;
-          timer.m_SessionID = Message::GSessionID;
-          timer.SetType(Timer::CORE_ACTIVITY);
-
-          GTimerManager->Add(timer);
-        }
-      }
-    }
-
-    if (false) {
-      // Thread time line
-      std::map<long long, ContextSwitch>& csMap =
-          m_ContextSwitchesMap[a_CS.m_ThreadId];
-
-      if (!csMap.empty()) {
-        ContextSwitch& lastCS = csMap.rbegin()->second;
-        if (lastCS.m_Type == ContextSwitch::In) {
-          Timer timer;
-          timer.m_Start = lastCS.m_Time;
-          timer.m_End = a_CS.m_Time;
-          timer.m_TID = a_CS.m_ThreadId;
-          timer.m_SessionID = Message::GSessionID;
-          timer.SetType(Timer::THREAD_ACTIVITY);
-
-          GTimerManager->Add(timer);
-        }
-      }
+  if (a_CS.m_Type == ContextSwitch::In) {
+    m_ContextSwitchPairer.AddSwitchIn(a_CS.m_ThreadId, a_CS.m_ProcessorIndex,
+                                      a_CS.m_Time);
+  } else if (a_CS.m_Type == ContextSwitch::Out) {
+    std::optional<CoreActivity> core_activity =
+        m_ContextSwitchPairer.AddSwitchOut(a_CS.m_ThreadId,
+                                           a_CS.m_ProcessorIndex, a_CS.m_Time);
+    if (core_activity.has_value()) {
+      GTimerManager->Add(MakeCoreActivityTimer(core_activity.value()));
     }
   }
+}
 
-  // TODO: if events are already sorted by timestamp, then
-  //       we don't need to use maps. To investigate...
-  m_ContextSwitchesMap[a_CS.m_ThreadId].insert(pair);
-  m_CoreUtilizationMap[a_CS.m_ProcessorIndex].insert(pair);
+//-----------------------------------------------------------------------------
+void TimeGraph::AddThreadStateChange(
+    const ThreadStateChange& thread_state_change) {
+  Capture::GHasThreadStates = true;
+  GetThreadTrack(thread_state_change.thread_id)
+      ->OnThreadStateChange(thread_state_change);
+  m_DataGeneration.fetch_add(1, std::memory_order_relaxed);
 }
 
 //-----------------------------------------------------------------------------
@@ -408,10 +561,9 @@ void TimeGraph::Select(const Vec2& a_WorldStart, const Vec2 a_WorldStop) {
 }
 
 //-----------------------------------------------------------------------------
-void TimeGraph::SelectLeft(const TextBox* a_TextBox) {
-  TextBox* textBox = const_cast<TextBox*>(a_TextBox);
-  Capture::GSelectedTextBox = textBox;
-  const Timer& timer = textBox->GetTimer();
+void TimeGraph::SelectLeft(const CompactTimer* a_Timer) {
+  Capture::GSelectedTimer = a_Timer;
+  Timer timer = ExpandTimer(*a_Timer);
 
   if (IsVisible(timer)) {
     return;
@@ -428,10 +580,9 @@ void TimeGraph::SelectLeft(const TextBox* a_TextBox) {
 }
 
 //-----------------------------------------------------------------------------
-void TimeGraph::SelectRight(const TextBox* a_TextBox) {
-  TextBox* textBox = const_cast<TextBox*>(a_TextBox);
-  Capture::GSelectedTextBox = textBox;
-  const Timer& timer = textBox->GetTimer();
+void TimeGraph::SelectRight(const CompactTimer* a_Timer) {
+  Capture::GSelectedTimer = a_Timer;
+  Timer timer = ExpandTimer(*a_Timer);
 
   if (IsVisible(timer)) {
     return;
@@ -450,263 +601,585 @@ void TimeGraph::SelectRight(const TextBox* a_TextBox) {
 //-----------------------------------------------------------------------------
 void TimeGraph::NeedsUpdate() { m_NeedsUpdatePrimitives = true; }
 
+//-----------------------------------------------------------------------------
+bool TimeGraph::CheckForNewData() {
+  // The samples are drawn from the event buffer, which has no generation of
+  // its own: its latest event tells whether it changed.
+  uint64_t generation = m_DataGeneration.load(std::memory_order_relaxed);
+  TickType max_event_time = GEventTracer.GetEventBuffer().GetMaxTime();
+  bool has_new_data = generation != m_CheckedDataGeneration ||
+                      max_event_time != m_CheckedMaxEventTime;
+  m_CheckedDataGeneration = generation;
+  m_CheckedMaxEventTime = max_event_time;
+  return has_new_data;
+}
+
 //-----------------------------------------------------------------------------
 inline std::string GetExtraInfo(const Timer& a_Timer) {
   std::string info;
   if (!Capture::IsCapturing() && a_Timer.GetType() == Timer::UNREAL_OBJECT) {
     info =
         "[" + ws2s(GOrbitUnreal.GetObjectNames()[a_Timer.m_UserData[0]]) + "]";
+  } else if (a_Timer.GetType() == Timer::NONE) {
+    std::optional<PmuCounters> pmu_counters = GetTimerPmuCounters(a_Timer);
+    if (pmu_counters.has_value()) {
+      info = "[" + PmuCountersToString(pmu_counters.value()) + "]";
+    }
   }
   return info;
 }
 
 //-----------------------------------------------------------------------------
-void TimeGraph::UpdatePrimitives(bool a_Picking) {
+void TimeGraph::UpdatePrimitives() {
   CHECK(string_manager_);
+  RenderStats::Scope scope(&m_RenderStats, RenderStats::UPDATE_PRIMITIVES);
 
-  m_Batcher.Reset();
-  m_VisibleTextBoxes.clear();
-  m_TextRendererStatic.Clear();
-  m_TextRendererStatic.Init();  // TODO: needed?
+  if (m_PrimitivesUpdate != nullptr) {
+    // Coalesced into one update of the latest view, started once the running
+    // one has been applied.
+    m_NeedsUpdatePrimitives = true;
+    return;
+  }
+  m_NeedsUpdatePrimitives = false;
 
   UpdateMaxTimeStamp(GEventTracer.GetEventBuffer().GetMaxTime());
 
   m_SceneBox = m_Canvas->GetSceneBox();
-  float minX = m_SceneBox.GetPosX();
   m_NumDrawnTextBoxes = 0;
 
   m_TimeWindowUs = m_MaxTimeUs - m_MinTimeUs;
   m_WorldStartX = m_Canvas->GetWorldTopLeftX();
   m_WorldWidth = m_Canvas->GetWorldWidth();
-  double invTimeWindow = 1.0 / m_TimeWindowUs;
 
+  m_Layout.SetDrawFrameTrack(GetNumFrames() > 0);
+  m_Layout.SetDrawFileIO(m_HasFileIo);
+  m_Layout.SetDrawPageFaults(m_HasPageFaults);
+  {
+    ScopeLock lock(m_CounterSeriesMutex);
+    m_Layout.SetNumCounterTracks(static_cast<int>(m_CounterSeries.size()));
+  }
   UpdateThreadIds();
 
+  auto update = std::make_shared<PrimitivesUpdate>();
+  PrimitivesContext& context = update->m_Context;
+  context.m_Layout = m_Layout;
   double span = m_MaxTimeUs - m_MinTimeUs;
-  TickType rawStart = GetTickFromUs(m_MinTimeUs + m_MarginRatio * span);
-  TickType rawStop = GetTickFromUs(m_MaxTimeUs);
+  context.m_RawStart = GetTickFromUs(m_MinTimeUs + m_MarginRatio * span);
+  context.m_RawStop = GetTickFromUs(m_MaxTimeUs);
+  context.m_CanvasWidth = m_Canvas->getWidth();
+  // Timers shorter than a pixel are merged with the others of their pixel
+  // column, so that zoomed out views cost as much as their number of pixels.
+  context.m_TicksPerPixel =
+      (GetTickFromUs(m_MaxTimeUs) - GetTickFromUs(m_MinTimeUs)) /
+      std::max(context.m_CanvasWidth, 1);
+  context.m_SessionMinCounter = m_SessionMinCounter;
+  context.m_MinTimeUs = m_MinTimeUs;
+  context.m_InvTimeWindow = 1.0 / m_TimeWindowUs;
+  context.m_WorldStartX = m_WorldStartX;
+  context.m_WorldWidth = m_WorldWidth;
+  context.m_MinX = m_SceneBox.GetPosX();
+  context.m_SelectedThreadId = Capture::GSelectedThreadId;
+  context.m_SelectedTimer = Capture::GSelectedTimer;
+  context.m_HighlightedFunction =
+      Capture::GSelectedTimer != nullptr
+          ? m_TimerTables->GetFunctionAddress(*Capture::GSelectedTimer)
+          : 0;
+  context.m_SelectedFunctions = Capture::GSelectedFunctionsMap;
+  context.m_VisibleFunctions = Capture::GVisibleFunctionsMap;
+  // Filtered out timers are drawn greyed out by the batcher.
+  context.m_InstancedTimers = m_InstancedTimers &&
+                              context.m_VisibleFunctions.empty() &&
+                              m_TimerInstances.Init();
+
+  std::shared_ptr<const ThreadTrackList> tracks = GetThreadTracksSnapshot();
+  // Only the tracks on screen, and a screen above and below it for the
+  // primitives to already be there when scrolling before the next update.
+  // The scheduling track also places timers on the cores and other threads.
+  float minY;
+  float maxY;
+  GetTrackRange(1.f, &minY, &maxY);
+  for (const std::shared_ptr<ThreadTrack>& track : *tracks) {
+    uint32_t trackIndex = track->GetIndex();
+    if (track->GetID() == 0 ? m_Layout.IsTrackVisible(trackIndex)
+                            : m_Layout.IsTrackInRange(trackIndex, minY, maxY)) {
+      update->m_Tracks.push_back(track);
+    }
+  }
+  size_t numTracks = update->m_Tracks.size();
+  update->m_Primitives.resize(numTracks);
+  update->m_NumPendingTracks = numTracks;
+  m_PrimitivesUpdate = update;
+
+  // Tracks are taken one at a time by the workers, so that a few large
+  // tracks don't end up on the same worker.
+  size_t numTasks = std::min(numTracks, m_NumPrimitivesWorkers);
+  for (size_t i = 0; i < numTasks; ++i) {
+    m_PrimitivesWorkers->Post(i, [this, update] {
+      for (size_t track = update->m_NextTrack++;
+           track < update->m_Tracks.size(); track = update->m_NextTrack++) {
+        Timer timer;
+        timer.Start();
+        UpdateTrackPrimitives(update->m_Context,
+                              update->m_Tracks[track].get(),
+                              &update->m_Primitives[track]);
+        // Before the track is counted as done, for all the time to be there
+        // once the update is.
+        update->m_WorkerMicros += uint64_t(timer.QueryMillis() * 1000);
+        --update->m_NumPendingTracks;
+      }
+    });
+  }
+}
 
-  unsigned int TextBoxID = 0;
+//-----------------------------------------------------------------------------
+void TimeGraph::UpdateTrackPrimitives(const PrimitivesContext& a_Context,
+                                      ThreadTrack* a_Track,
+                                      TrackPrimitives* o_Primitives) const {
+  const TimeGraphLayout& layout = a_Context.m_Layout;
+  TickToWorld tickToWorld;
+  tickToWorld.session_min_tick = a_Context.m_SessionMinCounter;
+  tickToWorld.min_time_us = a_Context.m_MinTimeUs;
+  tickToWorld.inv_time_window = a_Context.m_InvTimeWindow;
+  tickToWorld.world_start_x = a_Context.m_WorldStartX;
+  tickToWorld.world_width = a_Context.m_WorldWidth;
+  tickToWorld.canvas_width = a_Context.m_CanvasWidth;
+  const std::map<uint64_t, Function*>& visibleFunctions =
+      a_Context.m_VisibleFunctions;
+  // The timers of a track are those of its thread, but for the scheduling
+  // track, so their offset is that of the track at their depth.
+  ThreadID trackTID = a_Track->GetID();
+  float trackOffset = layout.GetTrackOffset(a_Track->GetIndex());
+  float textBoxHeight = layout.GetTextBoxHeight();
+
+  // Adds the primitives of a_Timer, of chain, until mergedEnd, whose box
+  // starts at worldX and is worldWidth wide.
+  const TimerChain* chain = nullptr;
+  auto updateTimer = [&](const CompactTimer& a_Timer, TickType mergedEnd,
+                         float worldX, float worldWidth, bool isVisibleWidth) {
+    const Timer timer = chain->Expand(a_Timer);
+    bool isCore = timer.IsType(Timer::CORE_ACTIVITY);
+
+    float threadOffset;
+    if (isCore) {
+      threadOffset = layout.GetCoreOffset(timer.m_Processor);
+    } else if (timer.m_TID == trackTID) {
+      threadOffset = trackOffset - timer.m_Depth * textBoxHeight;
+    } else {
+      threadOffset = layout.GetThreadOffset(timer.m_TID, timer.m_Depth);
+    }
 
-  for (auto& pair : GetThreadTracksCopy()) {
-    std::shared_ptr<ThreadTrack>& threadTrack = pair.second;
+    float boxHeight = !isCore ? textBoxHeight : layout.GetTextCoresHeight();
 
-    if (!m_Layout.IsThreadVisible(threadTrack->GetID())) continue;
+    Vec2 pos(worldX, threadOffset);
+    Vec2 size(worldWidth, boxHeight);
+    bool isMerged = mergedEnd != timer.m_End;
 
-    std::vector<std::shared_ptr<TimerChain>> depthChain =
-        threadTrack->GetTimers();
-    for (auto& textBoxes : depthChain) {
-      if (textBoxes == nullptr) break;
+    if (!isCore) {
+      int& depth = timer.m_TID == trackTID
+                       ? o_Primitives->m_TrackDepth
+                       : o_Primitives->m_ThreadDepths[timer.m_TID];
+      depth = std::max(depth, timer.m_Depth + 1);
+    }
 
-      for (TextBox& textBox : *textBoxes) {
-        const Timer& timer = textBox.GetTimer();
+    bool isContextSwitch = timer.IsType(Timer::THREAD_ACTIVITY);
+    bool isSameThreadIdAsSelected =
+        isCore && (timer.m_TID == a_Context.m_SelectedThreadId);
+    auto visibleFunction = visibleFunctions.find(timer.m_FunctionAddress);
+    bool isInactive =
+        (!isContextSwitch && timer.m_FunctionAddress &&
+         (visibleFunctions.size() &&
+          (visibleFunction == visibleFunctions.end() ||
+           visibleFunction->second == nullptr))) ||
+        (a_Context.m_SelectedThreadId != 0 && isCore &&
+         !isSameThreadIdAsSelected);
+    bool isSelected = &a_Timer == a_Context.m_SelectedTimer;
+    bool isHighlighted = !isSelected && !isCore && !isContextSwitch &&
+                         timer.m_FunctionAddress != 0 &&
+                         timer.m_FunctionAddress ==
+                             a_Context.m_HighlightedFunction;
+
+    const unsigned char g = 100;
+    Color grey(g, g, g, 255);
+    static Color selectionColor(0, 128, 255, 255);
+    static Color highlightColor(100, 190, 255, 255);
+    Color col = GetTimerColor(timer);
+
+    col = isSelected
+              ? selectionColor
+              : isHighlighted ? highlightColor
+                              : isSameThreadIdAsSelected
+                                    ? col
+                                    : isInactive ? grey : col;
+    static int oddAlpha = 210;
+    if (!(timer.m_Depth & 0x1)) {
+      col[3] = oddAlpha;
+    }
 
-        if (!(rawStart > timer.m_End || rawStop < timer.m_Start)) {
-          double start =
-              MicroSecondsFromTicks(m_SessionMinCounter, timer.m_Start) -
-              m_MinTimeUs;
-          double end = MicroSecondsFromTicks(m_SessionMinCounter, timer.m_End) -
-                       m_MinTimeUs;
-          double elapsed = end - start;
+    float z = isInactive ? GlCanvas::Z_VALUE_BOX_INACTIVE
+                         : GlCanvas::Z_VALUE_BOX_ACTIVE;
+
+    // Boxes of timers as they are uploaded are left to m_TimerInstances.
+    bool isInstanced = a_Context.m_InstancedTimers && !isCore && !isMerged &&
+                       !isSelected && !isHighlighted;
+    if (isVisibleWidth) {
+      BoxPrimitive primitive;
+      Box& box = primitive.m_Box;
+      box.m_Vertices[0] = Vec3(pos[0], pos[1], z);
+      box.m_Vertices[1] = Vec3(pos[0], pos[1] + size[1], z);
+      box.m_Vertices[2] = Vec3(pos[0] + size[0], pos[1] + size[1], z);
+      box.m_Vertices[3] = Vec3(pos[0] + size[0], pos[1], z);
+      Color* colors = primitive.m_Colors;
+      Fill(primitive.m_Colors, col);
+
+      static float coeff = 0.94f;
+      Vec3 dark = Vec3(col[0], col[1], col[2]) * coeff;
+      colors[1] = Color((unsigned char)dark[0], (unsigned char)dark[1],
+                        (unsigned char)dark[2], (unsigned char)col[3]);
+      colors[0] = colors[1];
+      primitive.m_Timer = &a_Timer;
+      if (!isInstanced) {
+        o_Primitives->m_Boxes.push_back(primitive);
+      }
 
-          double NormalizedStart = start * invTimeWindow;
-          double NormalizedLength = elapsed * invTimeWindow;
+      // Labels are only made for the timers drawn, and not kept.
+      if (!isCore && !isMerged && !isContextSwitch) {
+        TextPrimitive text;
+        text.m_Text = GetTimerText(timer, a_Context.m_SelectedFunctions,
+                                   &text.m_TimeLength);
+        text.m_PosX = std::max(pos[0], a_Context.m_MinX);
+        text.m_PosY = pos[1];
+        text.m_MaxSize = pos[0] + size[0] - text.m_PosX;
+        if (!text.m_Text.empty()) {
+          o_Primitives->m_Texts.push_back(std::move(text));
+        }
+      }
+    } else {
+      LinePrimitive primitive;
+      primitive.m_Line.m_Beg = Vec3(pos[0], pos[1], z);
+      primitive.m_Line.m_End = Vec3(pos[0], pos[1] + size[1], z);
+      Fill(primitive.m_Colors, col);
+      primitive.m_Timer = &a_Timer;
+      o_Primitives->m_Lines.push_back(primitive);
+    }
+  };
+
+  // The timers in range of a chain are gathered first, for their world
+  // coordinates to be computed in one batch, then their primitives added.
+  // Reused across the tracks of a worker.
+  thread_local std::vector<const CompactTimer*> rangeTimers;
+  thread_local std::vector<TickType> starts;
+  thread_local std::vector<TickType> mergedEnds;
+  thread_local std::vector<float> worldXs;
+  thread_local std::vector<float> worldWidths;
+  thread_local std::vector<uint8_t> widerThanPixel;
+  for (auto& timers : a_Track->GetTimers()) {
+    if (timers == nullptr) break;
+
+    chain = timers.get();
+    rangeTimers.clear();
+    starts.clear();
+    mergedEnds.clear();
+    timers->ForEachInRange(
+        a_Context.m_RawStart, a_Context.m_RawStop, a_Context.m_TicksPerPixel,
+        [](const CompactTimer& a_Timer, TickType mergedEnd) {
+          rangeTimers.push_back(&a_Timer);
+          starts.push_back(a_Timer.m_Start);
+          mergedEnds.push_back(mergedEnd);
+        });
+
+    size_t numTimers = rangeTimers.size();
+    worldXs.resize(numTimers);
+    worldWidths.resize(numTimers);
+    widerThanPixel.resize(numTimers);
+    TransformTicksToWorld(tickToWorld, starts, mergedEnds,
+                          absl::MakeSpan(worldXs), absl::MakeSpan(worldWidths),
+                          absl::MakeSpan(widerThanPixel));
+    for (size_t i = 0; i < numTimers; ++i) {
+      updateTimer(*rangeTimers[i], mergedEnds[i], worldXs[i], worldWidths[i],
+                  widerThanPixel[i] != 0);
+    }
+  }
+}
 
-          bool isCore = timer.IsType(Timer::CORE_ACTIVITY);
+//-----------------------------------------------------------------------------
+std::string TimeGraph::GetTimerText(const Timer& a_Timer) const {
+  return GetTimerText(a_Timer, Capture::GSelectedFunctionsMap);
+}
 
-          float threadOffset =
-              !isCore ? m_Layout.GetThreadOffset(timer.m_TID, timer.m_Depth)
-                      : m_Layout.GetCoreOffset(timer.m_Processor);
+//-----------------------------------------------------------------------------
+std::string TimeGraph::GetTimerName(const Timer& a_Timer) const {
+  auto it = Capture::GSelectedFunctionsMap.find(a_Timer.m_FunctionAddress);
+  if (it != Capture::GSelectedFunctionsMap.end() && it->second != nullptr) {
+    return it->second->PrettyName();
+  } else if (a_Timer.m_Type == Timer::INTROSPECTION ||
+             a_Timer.m_Type == Timer::GPU_ACTIVITY ||
+             a_Timer.m_Type == Timer::SERVICE_STATS) {
+    return string_manager_->Get(a_Timer.m_UserData[0]).value_or("");
+  } else if (!SystraceManager::Get().IsEmpty()) {
+    return SystraceManager::Get().GetFunctionName(a_Timer.m_FunctionAddress);
+  } else if (!Capture::IsCapturing()) {
+    auto zone = Capture::GZoneNames.find(a_Timer.m_FunctionAddress);
+    if (zone != Capture::GZoneNames.end()) return zone->second;
+  }
+  return "";
+}
 
-          float boxHeight = !isCore ? m_Layout.GetTextBoxHeight()
-                                    : m_Layout.GetTextCoresHeight();
+//-----------------------------------------------------------------------------
+std::string TimeGraph::GetTimerText(
+    const Timer& a_Timer,
+    const std::map<uint64_t, Function*>& a_SelectedFunctions,
+    size_t* o_TimeLength) const {
+  double elapsedMillis =
+      MicroSecondsFromTicks(a_Timer.m_Start, a_Timer.m_End) * 0.001;
+  std::string time = GetPrettyTime(elapsedMillis);
+  if (o_TimeLength != nullptr) {
+    *o_TimeLength = time.length();
+  }
 
-          float WorldTimerStartX =
-              float(m_WorldStartX + NormalizedStart * m_WorldWidth);
-          float WorldTimerWidth = float(NormalizedLength * m_WorldWidth);
+  auto selectedFunction = a_SelectedFunctions.find(a_Timer.m_FunctionAddress);
+  Function* func = selectedFunction != a_SelectedFunctions.end()
+                       ? selectedFunction->second
+                       : nullptr;
+  if (func) {
+    std::string extraInfo = GetExtraInfo(a_Timer);
+    return absl::StrFormat("%s %s %s", func->PrettyName().c_str(),
+                           extraInfo.c_str(), time.c_str());
+  } else if (a_Timer.m_Type == Timer::INTROSPECTION ||
+             a_Timer.m_Type == Timer::GPU_ACTIVITY) {
+    return string_manager_->Get(a_Timer.m_UserData[0]).value_or("");
+  } else if (a_Timer.m_Type == Timer::SERVICE_STATS) {
+    // The value of the statistic, the name is the one of the track.
+    return absl::StrFormat("%.4g",
+                           absl::bit_cast<double>(a_Timer.m_UserData[1]));
+  } else if (!SystraceManager::Get().IsEmpty()) {
+    return SystraceManager::Get().GetFunctionName(a_Timer.m_FunctionAddress);
+  } else if (!Capture::IsCapturing()) {
+    // GZoneNames is populated when capturing, prevent race
+    // by accessing it only when not capturing.
+    auto it = Capture::GZoneNames.find(a_Timer.m_FunctionAddress);
+    if (it != Capture::GZoneNames.end()) {
+      return absl::StrFormat("%s %s", it->second.c_str(), time.c_str());
+    }
+  }
+  return "";
+}
 
-          Vec2 pos(WorldTimerStartX, threadOffset);
-          Vec2 size(WorldTimerWidth, boxHeight);
+//-----------------------------------------------------------------------------
+void TimeGraph::ApplyPrimitivesUpdate() {
+  std::shared_ptr<PrimitivesUpdate> update = std::move(m_PrimitivesUpdate);
+  Timer timer;
+  timer.Start();
 
-          textBox.SetPos(pos);
-          textBox.SetSize(size);
+  m_Batcher.Reset();
+  m_TextRendererStatic.Clear();
+  m_TextRendererStatic.Init();  // TODO: needed?
 
-          if (!isCore) {
-            UpdateThreadDepth(timer.m_TID, timer.m_Depth + 1);
-          }
+  // In the order of the tracks, as when they were generated on this thread.
+  static Color s_Color(255, 255, 255, 255);
+  for (size_t i = 0; i < update->m_Primitives.size(); ++i) {
+    TrackPrimitives& primitives = update->m_Primitives[i];
+    for (BoxPrimitive& box : primitives.m_Boxes) {
+      m_Batcher.AddBox(box.m_Box, box.m_Colors, PickingID::BOX,
+                       const_cast<CompactTimer*>(box.m_Timer));
+    }
+    for (LinePrimitive& line : primitives.m_Lines) {
+      m_Batcher.AddLine(line.m_Line, line.m_Colors, PickingID::LINE,
+                        const_cast<CompactTimer*>(line.m_Timer));
+    }
+    for (const TextPrimitive& text : primitives.m_Texts) {
+      m_TextRendererStatic.AddTextTrailingCharsPrioritized(
+          text.m_Text.c_str(), text.m_PosX, text.m_PosY + 1.f,
+          GlCanvas::Z_VALUE_TEXT, s_Color, text.m_TimeLength, text.m_MaxSize);
+    }
+    if (primitives.m_TrackDepth > 0) {
+      UpdateThreadDepth(update->m_Tracks[i]->GetID(), primitives.m_TrackDepth);
+    }
+    for (const auto& pair : primitives.m_ThreadDepths) {
+      UpdateThreadDepth(pair.first, pair.second);
+    }
+  }
+  AddFrameTrackPrimitives(update->m_Context);
+  AddCounterTrackPrimitives(update->m_Context);
+  m_RenderStats.AddMillis(RenderStats::UPDATE_PRIMITIVES, timer.QueryMillis());
+  m_RenderStats.AddMillis(RenderStats::UPDATE_PRIMITIVES_WORKERS,
+                          update->m_WorkerMicros * 0.001);
 
-          bool isContextSwitch = timer.IsType(Timer::THREAD_ACTIVITY);
-          bool isVisibleWidth = NormalizedLength * m_Canvas->getWidth() > 1;
-          bool isSameThreadIdAsSelected =
-              isCore && (timer.m_TID == Capture::GSelectedThreadId);
-          bool isInactive =
-              (!isContextSwitch && timer.m_FunctionAddress &&
-               (Capture::GVisibleFunctionsMap.size() &&
-                Capture::GVisibleFunctionsMap[timer.m_FunctionAddress] ==
-                    nullptr)) ||
-              (Capture::GSelectedThreadId != 0 && isCore &&
-               !isSameThreadIdAsSelected);
-          bool isSelected = &textBox == Capture::GSelectedTextBox;
-
-          const unsigned char g = 100;
-          Color grey(g, g, g, 255);
-          static Color selectionColor(0, 128, 255, 255);
-          Color col = GetThreadColor(timer.m_TID);
-
-          // We disambiguate the different types of GPU activity based on the
-          // string that is displayed on their timeslice.
-          if (timer.m_Type == Timer::GPU_ACTIVITY) {
-            constexpr const char* kSwQueueString = "sw queue";
-            constexpr const char* kHwQueueString = "hw queue";
-            constexpr const char* kHwExecutionString = "hw execution";
-            float coeff = 1.0f;
-            std::string gpu_stage =
-                string_manager_->Get(timer.m_UserData[0]).value_or("");
-            if (gpu_stage == kSwQueueString) {
-              coeff = 0.5f;
-            } else if (gpu_stage == kHwQueueString) {
-              coeff = 0.75f;
-            } else if (gpu_stage == kHwExecutionString) {
-              coeff = 1.0f;
-            }
+  UpdateEvents();
 
-            col[0] = coeff * col[0];
-            col[1] = coeff * col[1];
-            col[2] = coeff * col[2];
-          }
+  m_DrawInstancedTimers = update->m_Context.m_InstancedTimers;
+  m_NeedsRedraw = true;
+}
 
-          col = isSelected
-                    ? selectionColor
-                    : isSameThreadIdAsSelected ? col : isInactive ? grey : col;
-          textBox.SetColor(col[0], col[1], col[2]);
-          static int oddAlpha = 210;
-          if (!(timer.m_Depth & 0x1)) {
-            col[3] = oddAlpha;
-          }
+//-----------------------------------------------------------------------------
+Color TimeGraph::GetTimerColor(const Timer& a_Timer) const {
+  Color col = GetThreadColor(a_Timer.m_TID);
+
+  // We disambiguate the different types of GPU activity based on the
+  // string that is displayed on their timeslice.
+  if (a_Timer.m_Type == Timer::GPU_ACTIVITY) {
+    constexpr const char* kSwQueueString = "sw queue";
+    constexpr const char* kHwQueueString = "hw queue";
+    constexpr const char* kHwExecutionString = "hw execution";
+    float coeff = 1.0f;
+    std::string gpu_stage =
+        string_manager_->Get(a_Timer.m_UserData[0]).value_or("");
+    if (gpu_stage == kSwQueueString) {
+      coeff = 0.5f;
+    } else if (gpu_stage == kHwQueueString) {
+      coeff = 0.75f;
+    } else if (gpu_stage == kHwExecutionString) {
+      coeff = 1.0f;
+    }
 
-          float z = isInactive ? GlCanvas::Z_VALUE_BOX_INACTIVE
-                               : GlCanvas::Z_VALUE_BOX_ACTIVE;
+    col[0] = coeff * col[0];
+    col[1] = coeff * col[1];
+    col[2] = coeff * col[2];
+  }
+  return col;
+}
 
-          if (isVisibleWidth) {
-            Box box;
-            box.m_Vertices[0] = Vec3(pos[0], pos[1], z);
-            box.m_Vertices[1] = Vec3(pos[0], pos[1] + size[1], z);
-            box.m_Vertices[2] = Vec3(pos[0] + size[0], pos[1] + size[1], z);
-            box.m_Vertices[3] = Vec3(pos[0] + size[0], pos[1], z);
-            Color colors[4];
-            Fill(colors, col);
-
-            static float coeff = 0.94f;
-            Vec3 dark = Vec3(col[0], col[1], col[2]) * coeff;
-            colors[1] = Color((unsigned char)dark[0], (unsigned char)dark[1],
-                              (unsigned char)dark[2], (unsigned char)col[3]);
-            colors[0] = colors[1];
-            m_Batcher.AddBox(box, colors, PickingID::BOX, &textBox);
-
-            if (!isContextSwitch && textBox.GetText().size() == 0) {
-              double elapsedMillis = ((double)elapsed) * 0.001;
-              std::string time = GetPrettyTime(elapsedMillis);
-              Function* func =
-                  Capture::GSelectedFunctionsMap[timer.m_FunctionAddress];
-
-              textBox.SetElapsedTimeTextLength(time.length());
-
-              const char* name = nullptr;
-              if (func) {
-                std::string extraInfo = GetExtraInfo(timer);
-                name = func->PrettyName().c_str();
-                std::string text = absl::StrFormat(
-                    "%s %s %s", name, extraInfo.c_str(), time.c_str());
-
-                textBox.SetText(text);
-              } else if (timer.m_Type == Timer::INTROSPECTION) {
-                textBox.SetText(
-                    string_manager_->Get(timer.m_UserData[0]).value_or(""));
-              } else if (timer.m_Type == Timer::GPU_ACTIVITY) {
-                textBox.SetText(
-                    string_manager_->Get(timer.m_UserData[0]).value_or(""));
-              } else if (!SystraceManager::Get().IsEmpty()) {
-                textBox.SetText(SystraceManager::Get().GetFunctionName(
-                    timer.m_FunctionAddress));
-              } else if (!Capture::IsCapturing()) {
-                // GZoneNames is populated when capturing, prevent race
-                // by accessing it only when not capturing.
-                auto it = Capture::GZoneNames.find(timer.m_FunctionAddress);
-                if (it != Capture::GZoneNames.end()) {
-                  name = it->second.c_str();
-                  std::string text =
-                      absl::StrFormat("%s %s", name, time.c_str());
-                  textBox.SetText(text);
-                }
-              }
-            }
+//-----------------------------------------------------------------------------
+void TimeGraph::ToggleInstancedTimers() {
+  m_InstancedTimers = !m_InstancedTimers;
+  NeedsUpdate();
+}
 
-            if (!isCore) {
-              // m_VisibleTextBoxes.push_back(&textBox);
-              static Color s_Color(255, 255, 255, 255);
-
-              const Vec2& boxPos = textBox.GetPos();
-              const Vec2& boxSize = textBox.GetSize();
-              float posX = std::max(boxPos[0], minX);
-              float maxSize = boxPos[0] + boxSize[0] - posX;
-              m_TextRendererStatic.AddTextTrailingCharsPrioritized(
-                  textBox.GetText().c_str(), posX, textBox.GetPosY() + 1.f,
-                  GlCanvas::Z_VALUE_TEXT, s_Color,
-                  textBox.GetElapsedTimeTextLength(), maxSize);
-            }
-          } else {
-            Line line;
-            line.m_Beg = Vec3(pos[0], pos[1], z);
-            line.m_End = Vec3(pos[0], pos[1] + size[1], z);
-            Color colors[2];
-            Fill(colors, col);
-            m_Batcher.AddLine(line, colors, PickingID::LINE, &textBox);
-          }
-        }
+//-----------------------------------------------------------------------------
+const CompactTimer* TimeGraph::FindTimer(float a_WorldX, float a_WorldY) {
+  // Within half a pixel, for timers drawn as lines to be found too.
+  float halfPixel = 0.5f * m_WorldWidth / std::max(m_Canvas->getWidth(), 1);
+  TickType minTick = GetTickFromWorld(a_WorldX - halfPixel);
+  TickType maxTick = GetTickFromWorld(a_WorldX + halfPixel);
+  auto isInBox = [a_WorldY](float a_PosY, float a_Height) {
+    return a_WorldY >= a_PosY && a_WorldY <= a_PosY + a_Height;
+  };
+
+  std::shared_ptr<const ThreadTrackList> tracks = GetThreadTracksSnapshot();
+  for (const std::shared_ptr<ThreadTrack>& threadTrack : *tracks) {
+    uint32_t trackIndex = threadTrack->GetIndex();
+    // The cores are drawn above the blocks of the tracks.
+    bool hasCores = threadTrack->GetID() == 0;
+    if (!m_Layout.IsTrackVisible(trackIndex) ||
+        (!hasCores && !m_Layout.IsTrackInRange(trackIndex, a_WorldY,
+                                               a_WorldY))) {
+      continue;
+    }
 
-        ++TextBoxID;
+    for (auto& timers : threadTrack->GetTimers()) {
+      if (timers == nullptr) break;
+      if (timers->m_Root->m_Size == 0) continue;
+
+      // The timers of a chain are all at the same depth, but the timers of
+      // cores are placed by core.
+      const CompactTimer& first = timers->m_Root->m_Data[0];
+      bool isCore = first.IsType(Timer::CORE_ACTIVITY);
+      float offset = first.m_TID == threadTrack->GetID()
+                         ? m_Layout.GetTrackOffset(trackIndex, first.m_Depth)
+                         : m_Layout.GetThreadOffset(first.m_TID, first.m_Depth);
+      if (!isCore && !isInBox(offset, m_Layout.GetTextBoxHeight())) {
+        continue;
       }
-    }
-  }
 
-  if (!a_Picking) {
-    UpdateEvents();
+      const CompactTimer* timer = timers->FindFirstInRange(minTick, maxTick);
+      if (timer == nullptr) continue;
+      if (!isCore || isInBox(m_Layout.GetCoreOffset(timer->m_Processor),
+                             m_Layout.GetTextCoresHeight())) {
+        return timer;
+      }
+    }
   }
-
-  m_NeedsUpdatePrimitives = false;
-  m_NeedsRedraw = true;
+  return nullptr;
 }
 
 //-----------------------------------------------------------------------------
 void TimeGraph::UpdateEvents() {
+  RenderStats::Scope scope(&m_RenderStats, RenderStats::UPDATE_EVENTS);
   TickType rawMin = GetTickFromUs(m_MinTimeUs);
   TickType rawMax = GetTickFromUs(m_MaxTimeUs);
 
-  ScopeLock lock(GEventTracer.GetEventBuffer().GetMutex());
-
   Color lineColor[2];
   Color white(255, 255, 255, 255);
   Fill(lineColor, white);
 
-  for (auto& pair : GEventTracer.GetEventBuffer().GetCallstacks()) {
-    ThreadID threadID = pair.first;
-    std::map<long long, CallstackEvent>& callstacks = pair.second;
-
-    // Sampling Events
-    float ThreadOffset = (float)m_Layout.GetSamplingTrackOffset(threadID);
-    if (ThreadOffset != -1.f) {
-      for (auto& callstackPair : callstacks) {
-        unsigned long long time = callstackPair.first;
-
-        if (time > rawMin && time < rawMax) {
-          float x = GetWorldFromTick(time);
-          Line line;
-          line.m_Beg = Vec3(x, ThreadOffset, GlCanvas::Z_VALUE_EVENT);
-          line.m_End = Vec3(x, ThreadOffset - m_Layout.GetEventTrackHeight(),
-                            GlCanvas::Z_VALUE_EVENT);
-          m_Batcher.AddLine(line, lineColor, PickingID::EVENT);
+  // With more visible samples than pixels, lines would overlap: samples are
+  // counted per pixel instead and drawn as a strip whose brightness is their
+  // density, which only costs as much as the width of the canvas.
+  size_t numPixels = std::max(m_Canvas->getWidth(), 1);
+  std::vector<uint32_t> binCounts;
+
+  GEventTracer.GetEventBuffer().ForEachThread(
+      [&](ThreadID threadID, const CallstackEventColumns& callstacks) {
+        // Sampling Events
+        float ThreadOffset = (float)m_Layout.GetSamplingTrackOffset(threadID);
+        if (ThreadOffset == -1.f) {
+          return;
         }
-      }
+        float trackHeight = m_Layout.GetEventTrackHeight();
+        if (callstacks.CountEvents(rawMin + 1, rawMax) > numPixels) {
+          callstacks.CountEventsInBins(rawMin + 1, rawMax, numPixels,
+                                       &binCounts);
+          uint32_t maxCount =
+              *std::max_element(binCounts.begin(), binCounts.end());
+          float binWidth = m_WorldWidth / numPixels;
+          float z = GlCanvas::Z_VALUE_EVENT;
+          for (size_t i = 0; i < numPixels; ++i) {
+            if (binCounts[i] == 0) {
+              continue;
+            }
+            auto level = static_cast<unsigned char>(
+                64 + 191 * binCounts[i] / maxCount);
+            Color color(level, level, level, 255);
+            Color colors[4];
+            Fill(colors, color);
+            float x = m_WorldStartX + i * binWidth;
+            float y = ThreadOffset - trackHeight;
+            Box box;
+            box.m_Vertices[0] = Vec3(x, y, z);
+            box.m_Vertices[1] = Vec3(x, y + trackHeight, z);
+            box.m_Vertices[2] = Vec3(x + binWidth, y + trackHeight, z);
+            box.m_Vertices[3] = Vec3(x + binWidth, y, z);
+            m_Batcher.AddBox(box, colors, PickingID::EVENT);
+          }
+          return;
+        }
+
+        // Only the visible samples are visited.
+        callstacks.ForEachEvent(
+            rawMin + 1, rawMax, [&](int64_t time, CallstackID) {
+              float x = GetWorldFromTick(time);
+              Line line;
+              line.m_Beg = Vec3(x, ThreadOffset, GlCanvas::Z_VALUE_EVENT);
+              line.m_End = Vec3(x, ThreadOffset - trackHeight,
+                                GlCanvas::Z_VALUE_EVENT);
+              m_Batcher.AddLine(line, lineColor, PickingID::EVENT);
+            });
+      });
+
+  // Log entries, found by binary search in the time index of their thread,
+  // as lines over the sampling track. At most one line is drawn per pixel.
+  Color logLineColor(255, 200, 0, 255);
+  Color logColor[2];
+  Fill(logColor, logLineColor);
+  float pixelWidth = m_WorldWidth / numPixels;
+  {
+    ScopeLock lock(Capture::GLogMutex);
+    const LogBuffer& logBuffer = Capture::GLogBuffer;
+    for (ThreadID threadId : logBuffer.GetThreadIds()) {
+      float threadOffset = m_Layout.GetSamplingTrackOffset(threadId);
+      if (threadOffset == -1.f) continue;
+      float trackHeight = m_Layout.GetEventTrackHeight();
+      float lastX = -std::numeric_limits<float>::max();
+      logBuffer.ForEachInTimeRange(
+          threadId, rawMin + 1, rawMax, [&](uint64_t id) {
+            float x = GetWorldFromTick(logBuffer.Get(id).time);
+            if (x - lastX < pixelWidth) return;
+            lastX = x;
+            Line line;
+            line.m_Beg = Vec3(x, threadOffset, GlCanvas::Z_VALUE_EVENT);
+            line.m_End = Vec3(x, threadOffset - trackHeight,
+                              GlCanvas::Z_VALUE_EVENT);
+            m_Batcher.AddLine(line, logColor, PickingID::EVENT);
+          });
     }
   }
 
@@ -738,32 +1211,45 @@ void TimeGraph::SelectEvents(float a_WorldStart, float a_WorldEnd,
 
   m_SelectedCallstackEvents =
       GEventTracer.GetEventBuffer().GetCallstackEvents(t0, t1, a_TID);
+  GOrbitApp->SetLogTimeRange(t0, t1, a_TID);
+
+  // The report is built by m_SelectionWorker from the counts of the
+  // callstacks of the selection, looked up in the capture's profiler. A new
+  // selection cancels the report of the previous one.
+  CancelSelectionReport();
+  auto update = std::make_shared<SelectionReportUpdate>();
+  m_SelectionReportUpdate = update;
+  std::shared_ptr<SamplingProfiler> source = Capture::GSamplingProfiler;
+  m_SelectionWorker->Post(0, [update, source, t0, t1, a_TID] {
+    if (!update->m_Cancelled && source != nullptr) {
+      std::map<ThreadID, CallstackCounts> counts =
+          GEventTracer.GetEventBuffer().GetCallstackCounts(t0, t1, a_TID);
+      update->m_Profiler = SamplingProfiler::MakeSubsetProfiler(
+          source, counts, /*a_GenerateSummary=*/a_TID == 0,
+          update->m_Cancelled);
+    }
+    update->m_Done = true;
+  });
 
-  // Generate report
-  std::shared_ptr<SamplingProfiler> samplingProfiler =
-      std::make_shared<SamplingProfiler>(Capture::GTargetProcess);
-  samplingProfiler->SetIsLinuxPerf(
-      Capture::IsRemote());  // TODO: could be windows to windows remote
-                             // capture...
-  samplingProfiler->SetState(SamplingProfiler::Sampling);
-
-  samplingProfiler->SetGenerateSummary(a_TID == 0);
+  NeedsUpdate();
+}
 
-  for (CallstackEvent& event : m_SelectedCallstackEvents) {
-    const std::shared_ptr<CallStack> callstack =
-        Capture::GSamplingProfiler->GetCallStack(event.m_Id);
-    if (callstack) {
-      callstack->m_ThreadId = event.m_TID;
-      samplingProfiler->AddCallStack(*callstack);
-    }
+//-----------------------------------------------------------------------------
+void TimeGraph::CancelSelectionReport() {
+  if (m_SelectionReportUpdate != nullptr) {
+    m_SelectionReportUpdate->m_Cancelled = true;
   }
-  samplingProfiler->ProcessSamples();
+}
 
-  if (samplingProfiler->GetNumSamples() > 0) {
-    GOrbitApp->AddSelectionReport(samplingProfiler);
+//-----------------------------------------------------------------------------
+void TimeGraph::ApplySelectionReport() {
+  std::shared_ptr<SelectionReportUpdate> update =
+      std::move(m_SelectionReportUpdate);
+  std::shared_ptr<SamplingProfiler> profiler = update->m_Profiler;
+  if (!update->m_Cancelled && profiler != nullptr &&
+      profiler->GetNumSamples() > 0) {
+    GOrbitApp->AddSelectionReport(profiler);
   }
-
-  NeedsUpdate();
 }
 
 //-----------------------------------------------------------------------------
@@ -772,14 +1258,28 @@ void TimeGraph::Draw(bool a_Picking) {
   // memory.
   //       Now that each thread track has multiple blockchains as opposed to
   //       only having a single global one, this a bit trickier.
-  if (/*m_TextBoxes.keep( GParams.m_MaxNumTimers ) ||*/ (
-          !a_Picking && m_NeedsUpdatePrimitives) ||
-      a_Picking) {
-    UpdatePrimitives(a_Picking);
+  //
+  // The latest finished primitives are drawn, while the next ones are
+  // generated by the workers. The picking pass doesn't draw timers, they are
+  // found from the layout, see FindTimer.
+  if (!a_Picking) {
+    if (IsPrimitivesUpdateDone()) {
+      ApplyPrimitivesUpdate();
+    }
+    if (IsSelectionReportDone()) {
+      ApplySelectionReport();
+    }
+    if (/*m_TextBoxes.keep( GParams.m_MaxNumTimers ) ||*/
+        m_NeedsUpdatePrimitives) {
+      UpdatePrimitives();
+    }
   }
 
   DrawThreadTracks(a_Picking);
-  DrawBuffered(a_Picking);
+  if (!a_Picking) {
+    DrawBuffered();
+    DrawCriticalPath();
+  }
   DrawEvents(a_Picking);
 
   m_NeedsRedraw = false;
@@ -788,14 +1288,24 @@ void TimeGraph::Draw(bool a_Picking) {
 //-----------------------------------------------------------------------------
 void TimeGraph::DrawThreadTracks(bool a_Picking) {
   m_Layout.SetNumCores(GetNumCores());
+  float minY;
+  float maxY;
+  GetTrackRange(0.f, &minY, &maxY);
   const std::vector<ThreadID>& sortedThreadIds = m_Layout.GetSortedThreadIds();
   for (uint32_t i = 0; i < sortedThreadIds.size(); ++i) {
     ThreadID threadId = sortedThreadIds[i];
+    if (!m_Layout.IsThreadInRange(threadId, minY, maxY)) continue;
 
     std::shared_ptr<ThreadTrack> track = GetThreadTrack(threadId);
     if (track->GetName().empty()) {
       std::string threadName =
           Capture::GTargetProcess->GetThreadNameFromTID(threadId);
+      uint32_t host_index = GetHostIndex(threadId);
+      if (host_index > 0) {
+        threadName = absl::StrFormat(
+            "[%s] %s",
+            ConnectionManager::Get().GetHostLabel(host_index), threadName);
+      }
       track->SetName(threadName);
     }
 
@@ -806,18 +1316,39 @@ void TimeGraph::DrawThreadTracks(bool a_Picking) {
 //-----------------------------------------------------------------------------
 std::shared_ptr<ThreadTrack> TimeGraph::GetThreadTrack(ThreadID a_TID) {
   ScopeLock lock(m_Mutex);
-  std::shared_ptr<ThreadTrack> track = m_ThreadTracks[a_TID];
+  std::shared_ptr<ThreadTrack>& track = m_ThreadTracks[a_TID];
+  if (track == nullptr) {
+    track = std::make_shared<ThreadTrack>(
+        this, a_TID, static_cast<uint32_t>(m_ThreadTracksSnapshot->size()));
+    auto tracks = std::make_shared<ThreadTrackList>(*m_ThreadTracksSnapshot);
+    tracks->push_back(track);
+    m_ThreadTracksSnapshot = std::move(tracks);
+  }
+  return track;
+}
+
+//-----------------------------------------------------------------------------
+ThreadTrack* TimeGraph::GetWriterThreadTrack(ThreadID a_TID) {
+  ThreadTrack*& track = m_WriterThreadTracks[a_TID];
   if (track == nullptr) {
-    track = std::make_shared<ThreadTrack>(this, a_TID);
+    track = GetThreadTrack(a_TID).get();
   }
-  m_ThreadTracks[a_TID] = track;
   return track;
 }
 
 //-----------------------------------------------------------------------------
-ThreadTrackMap TimeGraph::GetThreadTracksCopy() const {
+std::shared_ptr<const ThreadTrackList> TimeGraph::GetThreadTracksSnapshot()
+    const {
   ScopeLock lock(m_Mutex);
-  return m_ThreadTracks;
+  return m_ThreadTracksSnapshot;
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::GetTrackRange(float a_Margin, float* o_MinY,
+                              float* o_MaxY) const {
+  float height = m_Canvas->GetWorldHeight();
+  *o_MaxY = m_Canvas->GetWorldTopLeftY() + a_Margin * height;
+  *o_MinY = m_Canvas->GetWorldTopLeftY() - (1.f + a_Margin) * height;
 }
 
 //-----------------------------------------------------------------------------
@@ -830,16 +1361,13 @@ void TimeGraph::SetThreadFilter(const std::string& a_Filter) {
 //-----------------------------------------------------------------------------
 void TimeGraph::UpdateThreadIds() {
   {
-    ScopeLock lock(GEventTracer.GetEventBuffer().GetMutex());
     m_EventCount.clear();
 
-    for (auto& pair : GEventTracer.GetEventBuffer().GetCallstacks()) {
-      ThreadID threadID = pair.first;
-      std::map<long long, CallstackEvent>& callstacks = pair.second;
-
-      m_EventCount[threadID] = (uint32_t)callstacks.size();
-      GetThreadTrack(threadID);
-    }
+    GEventTracer.GetEventBuffer().ForEachThread(
+        [this](ThreadID threadID, const CallstackEventColumns& callstacks) {
+          m_EventCount[threadID] = (uint32_t)callstacks.size();
+          GetThreadTrack(threadID);
+        });
   }
 
   // Reorder threads once every second when capturing
@@ -847,8 +1375,15 @@ void TimeGraph::UpdateThreadIds() {
     std::vector<ThreadID> sortedThreadIds;
 
     // Show threads with instrumented functions first
+    std::map<ThreadID, uint32_t> threadCountMap;
+    std::shared_ptr<const ThreadTrackList> tracks = GetThreadTracksSnapshot();
+    for (const std::shared_ptr<ThreadTrack>& track : *tracks) {
+      if (uint32_t numTimers = track->GetNumTimers()) {
+        threadCountMap[track->GetID()] = numTimers;
+      }
+    }
     std::vector<std::pair<ThreadID, uint32_t>> sortedThreads =
-        OrbitUtils::ReverseValueSort(m_ThreadCountMap);
+        OrbitUtils::ReverseValueSort(threadCountMap);
     for (auto& pair : sortedThreads) {
       sortedThreadIds.push_back(pair.first);
     }
@@ -857,11 +1392,31 @@ void TimeGraph::UpdateThreadIds() {
     std::vector<std::pair<ThreadID, uint32_t>> sortedByEvents =
         OrbitUtils::ReverseValueSort(m_EventCount);
     for (auto& pair : sortedByEvents) {
-      if (m_ThreadCountMap.find(pair.first) == m_ThreadCountMap.end()) {
+      if (threadCountMap.find(pair.first) == threadCountMap.end()) {
         sortedThreadIds.push_back(pair.first);
       }
     }
 
+    // Then the threads that only logged, for their logs to be drawn
+    std::vector<ThreadID> logThreadIds;
+    {
+      ScopeLock lock(Capture::GLogMutex);
+      logThreadIds = Capture::GLogBuffer.GetThreadIds();
+    }
+    for (ThreadID tid : logThreadIds) {
+      if (threadCountMap.find(tid) == threadCountMap.end() &&
+          m_EventCount.find(tid) == m_EventCount.end()) {
+        GetThreadTrack(tid);
+        sortedThreadIds.push_back(tid);
+      }
+    }
+
+    // Group the threads of each host, see HostConnection
+    std::stable_sort(sortedThreadIds.begin(), sortedThreadIds.end(),
+                     [](ThreadID lhs, ThreadID rhs) {
+                       return GetHostIndex(lhs) < GetHostIndex(rhs);
+                     });
+
     // Filter thread ids if needed
     if (!m_ThreadFilter.empty()) {
       std::vector<std::string> filters = Tokenize(m_ThreadFilter, " ");
@@ -893,10 +1448,10 @@ Color TimeGraph::GetThreadColor(ThreadID a_TID) const {
 
 //----------------------------------------------------------------------------
 void TimeGraph::OnLeft() {
-  TextBox* selection = Capture::GSelectedTextBox;
+  const CompactTimer* selection = Capture::GSelectedTimer;
   if (selection) {
-    const Timer& timer = selection->GetTimer();
-    const TextBox* left = GetThreadTrack(timer.m_TID)->GetLeft(selection);
+    const CompactTimer* left =
+        GetThreadTrack(selection->m_TID)->GetLeft(selection);
     if (left) {
       SelectLeft(left);
     }
@@ -906,10 +1461,10 @@ void TimeGraph::OnLeft() {
 
 //----------------------------------------------------------------------------
 void TimeGraph::OnRight() {
-  TextBox* selection = Capture::GSelectedTextBox;
+  const CompactTimer* selection = Capture::GSelectedTimer;
   if (selection) {
-    const Timer& timer = selection->GetTimer();
-    const TextBox* right = GetThreadTrack(timer.m_TID)->GetRight(selection);
+    const CompactTimer* right =
+        GetThreadTrack(selection->m_TID)->GetRight(selection);
     if (right) {
       SelectRight(right);
     }
@@ -919,10 +1474,9 @@ void TimeGraph::OnRight() {
 
 //----------------------------------------------------------------------------
 void TimeGraph::OnUp() {
-  TextBox* selection = Capture::GSelectedTextBox;
+  const CompactTimer* selection = Capture::GSelectedTimer;
   if (selection) {
-    const Timer& timer = selection->GetTimer();
-    const TextBox* up = GetThreadTrack(timer.m_TID)->GetUp(selection);
+    const CompactTimer* up = GetThreadTrack(selection->m_TID)->GetUp(selection);
     if (up) {
       Select(up);
     }
@@ -932,10 +1486,10 @@ void TimeGraph::OnUp() {
 
 //----------------------------------------------------------------------------
 void TimeGraph::OnDown() {
-  TextBox* selection = Capture::GSelectedTextBox;
+  const CompactTimer* selection = Capture::GSelectedTimer;
   if (selection) {
-    const Timer& timer = selection->GetTimer();
-    const TextBox* down = GetThreadTrack(timer.m_TID)->GetDown(selection);
+    const CompactTimer* down =
+        GetThreadTrack(selection->m_TID)->GetDown(selection);
     if (down) {
       Select(down);
     }
@@ -943,15 +1497,83 @@ void TimeGraph::OnDown() {
   NeedsUpdate();
 }
 
+//----------------------------------------------------------------------------
+void TimeGraph::OnPreviousCall() {
+  const CompactTimer* selection = Capture::GSelectedTimer;
+  if (selection) {
+    const CompactTimer* previous = FindPreviousCall(*selection);
+    if (previous) {
+      SelectLeft(previous);
+    }
+  }
+  NeedsUpdate();
+}
+
+//----------------------------------------------------------------------------
+void TimeGraph::OnNextCall() {
+  const CompactTimer* selection = Capture::GSelectedTimer;
+  if (selection) {
+    const CompactTimer* next = FindNextCall(*selection);
+    if (next) {
+      SelectRight(next);
+    }
+  }
+  NeedsUpdate();
+}
+
+//----------------------------------------------------------------------------
+const CompactTimer* TimeGraph::FindPreviousCall(
+    const CompactTimer& a_Timer) const {
+  return m_OccurrenceIndex.FindPrevious(a_Timer);
+}
+
+//----------------------------------------------------------------------------
+const CompactTimer* TimeGraph::FindNextCall(
+    const CompactTimer& a_Timer) const {
+  return m_OccurrenceIndex.FindNext(a_Timer);
+}
+
+//----------------------------------------------------------------------------
+FunctionStats TimeGraph::GetFunctionStats(uint64_t a_FunctionAddress,
+                                          TickType a_Min,
+                                          TickType a_Max) const {
+  const TimerTables& tables = *m_TimerTables;
+  FunctionStats stats = m_OccurrenceIndex.GetStats(
+      tables, tables.FindFunctionId(a_FunctionAddress), a_Min, a_Max);
+  stats.m_Address = a_FunctionAddress;
+  return stats;
+}
+
 //----------------------------------------------------------------------------
 void TimeGraph::DrawText() {
   if (m_DrawText) {
+    RenderStats::Scope scope(&m_RenderStats, RenderStats::DRAW_TEXT);
     m_TextRendererStatic.Display();
+    m_RenderStats.AddNumGlyphs(m_TextRendererStatic.GetNumCharacters());
+  }
+}
+
+//----------------------------------------------------------------------------
+void TimeGraph::UploadBatcher() {
+  uint64_t version = m_Batcher.GetVersion();
+  BoxBuffer& boxBuffer = m_Batcher.GetBoxBuffer();
+  LineBuffer& lineBuffer = m_Batcher.GetLineBuffer();
+  if (m_UploadedVersion != version) {
+    m_BoxVertices.Upload(boxBuffer.m_Boxes);
+    m_BoxColors.Upload(boxBuffer.m_Colors);
+    m_LineVertices.Upload(lineBuffer.m_Lines);
+    m_LineColors.Upload(lineBuffer.m_Colors);
+    m_UploadedVersion = version;
   }
 }
 
 //----------------------------------------------------------------------------
-void TimeGraph::DrawBuffered(bool a_Picking) {
+void TimeGraph::DrawBuffered() {
+  RenderStats::Scope scope(&m_RenderStats, RenderStats::DRAW_BUFFERED);
+  m_RenderStats.SetNumPrimitives(m_Batcher.GetBoxBuffer().m_Boxes.size(),
+                                 m_Batcher.GetLineBuffer().m_Lines.size());
+  UploadBatcher();
+
   glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   glDisable(GL_CULL_FACE);
@@ -959,56 +1581,97 @@ void TimeGraph::DrawBuffered(bool a_Picking) {
   glEnableClientState(GL_COLOR_ARRAY);
   glEnable(GL_TEXTURE_2D);
 
-  DrawBoxBuffer(a_Picking);
-  DrawLineBuffer(a_Picking);
+  if (m_DrawInstancedTimers) {
+    DrawTimerInstances();
+  }
+  DrawBoxBuffer();
+  DrawLineBuffer();
 
+  // The other draws still point to client memory.
+  VertexBuffer::Unbind();
   glDisableClientState(GL_COLOR_ARRAY);
   glDisableClientState(GL_VERTEX_ARRAY);
   glPopAttrib();
 }
 
 //----------------------------------------------------------------------------
-void TimeGraph::DrawBoxBuffer(bool a_Picking) {
-  Block<Box, BoxBuffer::NUM_BOXES_PER_BLOCK>* boxBlock =
-      m_Batcher.GetBoxBuffer().m_Boxes.m_Root;
-  Block<Color, BoxBuffer::NUM_BOXES_PER_BLOCK * 4>* colorBlock;
-
-  colorBlock = !a_Picking ? m_Batcher.GetBoxBuffer().m_Colors.m_Root
-                          : m_Batcher.GetBoxBuffer().m_PickingColors.m_Root;
-
-  while (boxBlock) {
-    if (int numElems = boxBlock->m_Size) {
-      glVertexPointer(3, GL_FLOAT, sizeof(Vec3), boxBlock->m_Data);
-      glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Color),
-                     (void*)(colorBlock->m_Data));
-      glDrawArrays(GL_QUADS, 0, numElems * 4);
+void TimeGraph::DrawTimerInstances() {
+  // In the current view, which can be ahead of the one of the primitives.
+  double timeWindowUs = m_MaxTimeUs - m_MinTimeUs;
+  if (timeWindowUs <= 0) return;
+  double worldPerUs = m_WorldWidth / timeWindowUs;
+  auto worldFromTick = [this, worldPerUs](TickType a_Tick) {
+    double us = MicroSecondsFromTicks(m_SessionMinCounter, a_Tick);
+    return float(m_WorldStartX + (us - m_MinTimeUs) * worldPerUs);
+  };
+  double worldPerTick = worldPerUs * MicroSecondsFromTicks(0, 1);
+  TickType minTick = GetTickFromUs(m_MinTimeUs);
+  TickType maxTick = GetTickFromUs(m_MaxTimeUs);
+  float pixelWidth = m_WorldWidth / std::max(m_Canvas->getWidth(), 1);
+
+  auto getColor = [this](const Timer& a_Timer) {
+    Color col = GetTimerColor(a_Timer);
+    static int oddAlpha = 210;
+    if (!(a_Timer.m_Depth & 0x1)) {
+      col[3] = oddAlpha;
+    }
+    return col;
+  };
+
+  // Drawn before the batcher at the same z, so that the boxes it draws for
+  // selected timers cover their instance.
+  m_TimerInstances.BeginDraw(pixelWidth, GlCanvas::Z_VALUE_BOX_ACTIVE);
+  std::shared_ptr<const ThreadTrackList> tracks = GetThreadTracksSnapshot();
+  float minY;
+  float maxY;
+  GetTrackRange(0.f, &minY, &maxY);
+  for (const std::shared_ptr<ThreadTrack>& threadTrack : *tracks) {
+    uint32_t trackIndex = threadTrack->GetIndex();
+    if (threadTrack->GetID() == 0 ? !m_Layout.IsTrackVisible(trackIndex)
+                                  : !m_Layout.IsTrackInRange(trackIndex, minY,
+                                                             maxY)) {
+      continue;
     }
 
-    boxBlock = boxBlock->m_Next;
-    colorBlock = colorBlock->m_Next;
+    for (auto& timers : threadTrack->GetTimers()) {
+      if (timers == nullptr) break;
+      if (timers->m_Root->m_Size == 0) continue;
+
+      m_TimerInstances.Upload(timers, getColor);
+      // The timers of a chain are all at the same depth.
+      const CompactTimer& timer = timers->m_Root->m_Data[0];
+      float offset = timer.m_TID == threadTrack->GetID()
+                         ? m_Layout.GetTrackOffset(trackIndex, timer.m_Depth)
+                         : m_Layout.GetThreadOffset(timer.m_TID, timer.m_Depth);
+      m_TimerInstances.Draw(timers.get(), minTick, maxTick, worldFromTick,
+                            worldPerTick, offset, m_Layout.GetTextBoxHeight());
+    }
   }
+  m_TimerInstances.EndDraw();
 }
 
 //----------------------------------------------------------------------------
-void TimeGraph::DrawLineBuffer(bool a_Picking) {
-  Block<Line, LineBuffer::NUM_LINES_PER_BLOCK>* lineBlock =
-      m_Batcher.GetLineBuffer().m_Lines.m_Root;
-  Block<Color, LineBuffer::NUM_LINES_PER_BLOCK * 2>* colorBlock;
-
-  colorBlock = !a_Picking ? m_Batcher.GetLineBuffer().m_Colors.m_Root
-                          : m_Batcher.GetLineBuffer().m_PickingColors.m_Root;
-
-  while (lineBlock) {
-    if (int numElems = lineBlock->m_Size) {
-      glVertexPointer(3, GL_FLOAT, sizeof(Vec3), lineBlock->m_Data);
-      glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Color),
-                     (void*)(colorBlock->m_Data));
-      glDrawArrays(GL_LINES, 0, numElems * 2);
-    }
+void TimeGraph::DrawBoxBuffer() {
+  uint32_t numBoxes = m_Batcher.GetBoxBuffer().m_Boxes.size();
+  if (numBoxes == 0) return;
+
+  m_BoxVertices.Bind();
+  glVertexPointer(3, GL_FLOAT, sizeof(Vec3), nullptr);
+  m_BoxColors.Bind();
+  glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Color), nullptr);
+  glDrawArrays(GL_QUADS, 0, numBoxes * 4);
+}
 
-    lineBlock = lineBlock->m_Next;
-    colorBlock = colorBlock->m_Next;
-  }
+//----------------------------------------------------------------------------
+void TimeGraph::DrawLineBuffer() {
+  uint32_t numLines = m_Batcher.GetLineBuffer().m_Lines.size();
+  if (numLines == 0) return;
+
+  m_LineVertices.Bind();
+  glVertexPointer(3, GL_FLOAT, sizeof(Vec3), nullptr);
+  m_LineColors.Bind();
+  glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Color), nullptr);
+  glDrawArrays(GL_LINES, 0, numLines * 2);
 }
 
 //-----------------------------------------------------------------------------
@@ -1018,8 +1681,12 @@ void TimeGraph::DrawEvents(bool a_Picking) {
   float x1 = GetWorldFromTick(m_SessionMaxCounter);
   float sizeX = x1 - x0;
 
+  float minY;
+  float maxY;
+  GetTrackRange(0.f, &minY, &maxY);
   for (uint32_t i = 0; i < m_Layout.GetSortedThreadIds().size(); ++i) {
     ThreadID threadId = m_Layout.GetSortedThreadIds()[i];
+    if (!m_Layout.IsThreadInRange(threadId, minY, maxY)) continue;
     float y0 = m_Layout.GetSamplingTrackOffset(threadId);
 
     if (y0 == -1.f) continue;
@@ -1056,6 +1723,468 @@ void TimeGraph::DrawMainFrame(TextBox& a_Box) {
   }
 }
 
+//-----------------------------------------------------------------------------
+void TimeGraph::AddFrame(const Timer& a_Timer) {
+  ScopeLock lock(m_FrameIndexMutex);
+  if (!m_FrameThreadId.has_value()) {
+    m_FrameThreadId = a_Timer.m_TID;
+  }
+  if (a_Timer.m_TID == m_FrameThreadId) {
+    m_FrameIndex.AddFrameStart(a_Timer.m_Start);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::RebuildFrameIndex() {
+  uint64_t address = Capture::GMainFrameFunction;
+  // The frames are those of the thread that called the function the most.
+  std::unordered_map<ThreadID, std::vector<uint64_t>> starts;
+
+  // Timers processed while indexing are added once it is done, or ignored if
+  // they were already found.
+  ScopeLock lock(m_FrameIndexMutex);
+  m_FrameFunctionAddress = address;
+  // Timers are compared by function id, without expanding them.
+  uint32_t functionId = m_TimerTables->FindFunctionId(address);
+  if (functionId != 0) {
+    std::shared_ptr<const ThreadTrackList> tracks = GetThreadTracksSnapshot();
+    for (const std::shared_ptr<ThreadTrack>& track : *tracks) {
+      for (const std::shared_ptr<TimerChain>& chain : track->GetAllChains()) {
+        for (const CompactTimer& timer : *chain) {
+          if (timer.m_FunctionId == functionId) {
+            starts[timer.m_TID].push_back(timer.m_Start);
+          }
+        }
+      }
+    }
+  }
+
+  auto thread = std::max_element(
+      starts.begin(), starts.end(),
+      [](const auto& a, const auto& b) {
+        return a.second.size() < b.second.size();
+      });
+  if (thread != starts.end()) {
+    m_FrameThreadId = thread->first;
+    m_FrameIndex.Build(std::move(thread->second));
+  } else {
+    m_FrameThreadId.reset();
+    m_FrameIndex.Clear();
+  }
+  m_NextWorstFrame = 0;
+  NeedsUpdate();
+}
+
+//-----------------------------------------------------------------------------
+size_t TimeGraph::GetNumFrames() const {
+  ScopeLock lock(m_FrameIndexMutex);
+  return m_FrameIndex.GetNumFrames();
+}
+
+//-----------------------------------------------------------------------------
+std::vector<TimeGraph::FrameFunctionTime> TimeGraph::GetFrameBreakdown(
+    size_t a_Frame) const {
+  TickType start = 0;
+  TickType end = 0;
+  {
+    ScopeLock lock(m_FrameIndexMutex);
+    if (a_Frame >= m_FrameIndex.GetNumFrames()) return {};
+    start = m_FrameIndex.GetFrameStart(a_Frame);
+    end = m_FrameIndex.GetFrameEnd(a_Frame);
+  }
+
+  const std::map<uint64_t, Function*>& functions =
+      Capture::GSelectedFunctionsMap;
+  uint64_t frameFunction = m_FrameFunctionAddress;
+  std::unordered_map<uint64_t, FrameFunctionTime> times;
+  const TimerTables& tables = *m_TimerTables;
+  // As short timers are not merged, a_End is the end of a_Timer.
+  auto addTimer = [&](const CompactTimer& a_Timer, TickType a_End) {
+    uint64_t address = tables.GetFunctionAddress(a_Timer);
+    if (a_Timer.m_Start < start || address == frameFunction ||
+        functions.find(address) == functions.end()) {
+      return;
+    }
+    FrameFunctionTime& time = times[address];
+    time.m_FunctionAddress = address;
+    ++time.m_Count;
+    time.m_TotalTicks += a_End - a_Timer.m_Start;
+  };
+
+  // Without merging short timers, each is counted.
+  std::shared_ptr<const ThreadTrackList> tracks = GetThreadTracksSnapshot();
+  for (const std::shared_ptr<ThreadTrack>& track : *tracks) {
+    for (auto& timers : track->GetTimers()) {
+      if (timers == nullptr) break;
+      timers->ForEachInRange(start, end - 1, 0, addTimer);
+    }
+  }
+
+  std::vector<FrameFunctionTime> breakdown;
+  breakdown.reserve(times.size());
+  for (const auto& pair : times) {
+    breakdown.push_back(pair.second);
+  }
+  std::sort(breakdown.begin(), breakdown.end(),
+            [](const FrameFunctionTime& a, const FrameFunctionTime& b) {
+              return a.m_TotalTicks > b.m_TotalTicks;
+            });
+  return breakdown;
+}
+
+//-----------------------------------------------------------------------------
+std::string TimeGraph::GetFrameText(size_t a_Frame) const {
+  TickType start = 0;
+  TickType end = 0;
+  bool isSpike = false;
+  {
+    ScopeLock lock(m_FrameIndexMutex);
+    if (a_Frame >= m_FrameIndex.GetNumFrames()) return "";
+    start = m_FrameIndex.GetFrameStart(a_Frame);
+    end = m_FrameIndex.GetFrameEnd(a_Frame);
+    isSpike = m_FrameIndex.IsSpike(a_Frame);
+  }
+
+  std::string text = absl::StrFormat(
+      "Frame %u: %s%s", a_Frame,
+      GetPrettyTime(MicroSecondsFromTicks(start, end) * 0.001),
+      isSpike ? " (spike)" : "");
+  constexpr size_t kMaxNumFunctions = 10;
+  std::vector<FrameFunctionTime> breakdown = GetFrameBreakdown(a_Frame);
+  for (size_t i = 0; i < breakdown.size() && i < kMaxNumFunctions; ++i) {
+    const FrameFunctionTime& time = breakdown[i];
+    auto it = Capture::GSelectedFunctionsMap.find(time.m_FunctionAddress);
+    Function* func =
+        it != Capture::GSelectedFunctionsMap.end() ? it->second : nullptr;
+    absl::StrAppendFormat(
+        &text, "\n%s: %u calls, %s",
+        func ? func->PrettyName().c_str() : "", time.m_Count,
+        GetPrettyTime(MicroSecondsFromTicks(0, time.m_TotalTicks) * 0.001));
+  }
+  return text;
+}
+
+//-----------------------------------------------------------------------------
+std::optional<size_t> TimeGraph::FindFrame(float a_WorldX, float a_WorldY) {
+  if (!m_Layout.GetDrawFrameTrack()) return std::nullopt;
+  float posY = m_Layout.GetFrameTrackOffset();
+  if (a_WorldY < posY || a_WorldY > posY + m_Layout.GetFrameTrackHeight()) {
+    return std::nullopt;
+  }
+
+  TickType tick = GetTickFromWorld(a_WorldX);
+  ScopeLock lock(m_FrameIndexMutex);
+  return m_FrameIndex.GetFrameAt(tick);
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::ZoomFrame(size_t a_Frame) {
+  TickType start = 0;
+  TickType end = 0;
+  {
+    ScopeLock lock(m_FrameIndexMutex);
+    if (a_Frame >= m_FrameIndex.GetNumFrames()) return;
+    start = m_FrameIndex.GetFrameStart(a_Frame);
+    end = m_FrameIndex.GetFrameEnd(a_Frame);
+  }
+  Zoom(start, end);
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::ZoomNextWorstFrame() {
+  std::vector<size_t> worstFrames;
+  {
+    ScopeLock lock(m_FrameIndexMutex);
+    worstFrames = m_FrameIndex.GetWorstFrames(kNumWorstFrames);
+  }
+  if (worstFrames.empty()) return;
+  ZoomFrame(worstFrames[m_NextWorstFrame++ % worstFrames.size()]);
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::ComputeCriticalPath(ThreadID a_TID, TickType a_Start,
+                                    TickType a_End) {
+  std::unordered_map<ThreadID, std::shared_ptr<ThreadTrack>> tracks;
+  {
+    ScopeLock lock(m_Mutex);
+    tracks.insert(m_ThreadTracks.begin(), m_ThreadTracks.end());
+  }
+  m_CriticalPath = ::ComputeCriticalPath(
+      a_TID, a_Start, a_End,
+      [&tracks](uint32_t a_ThreadId, uint64_t a_Time)
+          -> std::optional<ThreadStateTimeline::Slice> {
+        auto it = tracks.find(a_ThreadId);
+        if (it == tracks.end()) return std::nullopt;
+        return it->second->GetThreadStateBefore(a_Time);
+      });
+  m_CriticalPathText = MakeCriticalPathText();
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::ComputeCriticalPath(const CompactTimer& a_Timer) {
+  Timer timer = ExpandTimer(a_Timer);
+  ComputeCriticalPath(timer.m_TID, timer.m_Start, timer.m_End);
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::ComputeFrameCriticalPath(size_t a_Frame) {
+  TickType start = 0;
+  TickType end = 0;
+  ThreadID threadId = 0;
+  {
+    ScopeLock lock(m_FrameIndexMutex);
+    if (a_Frame >= m_FrameIndex.GetNumFrames() || !m_FrameThreadId) return;
+    start = m_FrameIndex.GetFrameStart(a_Frame);
+    end = m_FrameIndex.GetFrameEnd(a_Frame);
+    threadId = *m_FrameThreadId;
+  }
+  ComputeCriticalPath(threadId, start, end);
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::ClearCriticalPath() {
+  m_CriticalPath.clear();
+  m_CriticalPathText.clear();
+  NeedsRedraw();
+}
+
+//-----------------------------------------------------------------------------
+std::string TimeGraph::MakeCriticalPathText() const {
+  if (m_CriticalPath.empty()) return "";
+
+  std::shared_ptr<const ThreadTrackList> tracks = GetThreadTracksSnapshot();
+  std::unordered_map<ThreadID, ThreadTrack*> tracksById;
+  for (const std::shared_ptr<ThreadTrack>& track : *tracks) {
+    tracksById[track->GetID()] = track.get();
+  }
+
+  struct FunctionTime {
+    std::string m_Name;
+    TickType m_Ticks = 0;
+  };
+  std::unordered_map<uint64_t, FunctionTime> functions;
+  std::set<ThreadID> threads;
+  TickType running = 0;
+  TickType runnable = 0;
+  TickType blocked = 0;
+  const TimerTables& tables = *m_TimerTables;
+  for (const CriticalPathSegment& segment : m_CriticalPath) {
+    threads.insert(segment.thread_id);
+    TickType duration = segment.end - segment.begin;
+    if (segment.state == ThreadStateChange::kRunnable) {
+      runnable += duration;
+      continue;
+    }
+    if (segment.state != ThreadStateChange::kRunning) {
+      blocked += duration;
+      continue;
+    }
+    running += duration;
+
+    // The time running in a function is counted for each function of the
+    // timers around it, as the inclusive time of the frame breakdown.
+    auto it = tracksById.find(segment.thread_id);
+    if (it == tracksById.end()) continue;
+    for (auto& timers : it->second->GetTimers()) {
+      if (timers == nullptr) break;
+      timers->ForEachInRange(
+          segment.begin, segment.end - 1, 0,
+          [&](const CompactTimer& a_Timer, TickType a_End) {
+            TickType begin = std::max<TickType>(a_Timer.m_Start, segment.begin);
+            TickType end = std::min<TickType>(a_End, segment.end);
+            if (end <= begin) return;
+            FunctionTime& time = functions[tables.GetFunctionAddress(a_Timer)];
+            if (time.m_Name.empty()) {
+              time.m_Name = GetTimerName(tables.Expand(a_Timer));
+            }
+            time.m_Ticks += end - begin;
+          });
+    }
+  }
+
+  auto prettyTime = [](TickType a_Ticks) {
+    return GetPrettyTime(MicroSecondsFromTicks(0, a_Ticks) * 0.001);
+  };
+  std::string text = absl::StrFormat(
+      "Critical path: %s over %u threads\n"
+      "Running: %s, waiting for a core: %s, blocked: %s",
+      prettyTime(m_CriticalPath.back().end - m_CriticalPath.front().begin),
+      threads.size(), prettyTime(running), prettyTime(runnable),
+      prettyTime(blocked));
+
+  std::vector<FunctionTime> breakdown;
+  breakdown.reserve(functions.size());
+  for (const auto& pair : functions) {
+    breakdown.push_back(pair.second);
+  }
+  std::sort(breakdown.begin(), breakdown.end(),
+            [](const FunctionTime& a, const FunctionTime& b) {
+              return a.m_Ticks > b.m_Ticks;
+            });
+  constexpr size_t kMaxNumFunctions = 20;
+  for (size_t i = 0; i < breakdown.size() && i < kMaxNumFunctions; ++i) {
+    absl::StrAppendFormat(&text, "\n%s: %s", breakdown[i].m_Name,
+                          prettyTime(breakdown[i].m_Ticks));
+  }
+  return text;
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::DrawCriticalPath() {
+  if (m_CriticalPath.empty()) return;
+  float height = m_Layout.GetEventTrackHeight();
+  const Color kRunningColor(0, 255, 255, 160);
+  const Color kWaitingColor(255, 0, 255, 160);
+  const float kZ = -0.05f;
+
+  glBegin(GL_QUADS);
+  for (const CriticalPathSegment& segment : m_CriticalPath) {
+    if (!m_Layout.IsThreadVisible(segment.thread_id)) continue;
+    float y0 = m_Layout.GetThreadStateTrackOffset(segment.thread_id);
+    float y1 = y0 - height;
+    float x0 = GetWorldFromTick(segment.begin);
+    float x1 = GetWorldFromTick(segment.end);
+    const Color& color = segment.state == ThreadStateChange::kRunning
+                             ? kRunningColor
+                             : kWaitingColor;
+    glColor4ubv(&color[0]);
+    glVertex3f(x0, y0, kZ);
+    glVertex3f(x1, y0, kZ);
+    glVertex3f(x1, y1, kZ);
+    glVertex3f(x0, y1, kZ);
+  }
+  glEnd();
+
+  // The wakeups the path follows, from the waker to the thread it woke up.
+  glBegin(GL_LINES);
+  glColor4ubv(&kRunningColor[0]);
+  for (size_t i = 1; i < m_CriticalPath.size(); ++i) {
+    const CriticalPathSegment& waker = m_CriticalPath[i - 1];
+    const CriticalPathSegment& woken = m_CriticalPath[i];
+    if (waker.thread_id == woken.thread_id ||
+        !m_Layout.IsThreadVisible(waker.thread_id) ||
+        !m_Layout.IsThreadVisible(woken.thread_id)) {
+      continue;
+    }
+    float x = GetWorldFromTick(woken.begin);
+    glVertex3f(x, m_Layout.GetThreadStateTrackOffset(waker.thread_id), kZ);
+    glVertex3f(x, m_Layout.GetThreadStateTrackOffset(woken.thread_id) - height,
+               kZ);
+  }
+  glEnd();
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::AddFrameTrackPrimitives(const PrimitivesContext& a_Context) {
+  const TimeGraphLayout& layout = a_Context.m_Layout;
+  if (!layout.GetDrawFrameTrack()) return;
+
+  ScopeLock lock(m_FrameIndexMutex);
+  std::pair<size_t, size_t> frames =
+      m_FrameIndex.GetFramesInRange(a_Context.m_RawStart, a_Context.m_RawStop);
+  TickType maxDuration = 0;
+  for (size_t i = frames.first; i < frames.second; ++i) {
+    maxDuration = std::max(maxDuration, m_FrameIndex.GetFrameDuration(i));
+  }
+  if (maxDuration == 0) return;
+
+  auto worldFromTick = [&a_Context](TickType a_Tick) {
+    double us = MicroSecondsFromTicks(a_Context.m_SessionMinCounter, a_Tick) -
+                a_Context.m_MinTimeUs;
+    return float(a_Context.m_WorldStartX +
+                 us * a_Context.m_InvTimeWindow * a_Context.m_WorldWidth);
+  };
+
+  static Color frameColor(0, 160, 80, 255);
+  static Color spikeColor(220, 50, 50, 255);
+  float posY = layout.GetFrameTrackOffset();
+  float height = layout.GetFrameTrackHeight();
+  float z = GlCanvas::Z_VALUE_BOX_ACTIVE;
+  Color colors[4];
+  for (size_t i = frames.first; i < frames.second;) {
+    TickType columnEnd =
+        m_FrameIndex.GetFrameStart(i) + a_Context.m_TicksPerPixel;
+    TickType duration = m_FrameIndex.GetFrameDuration(i);
+    bool isSpike = m_FrameIndex.IsSpike(i);
+    size_t next = i + 1;
+    for (; next < frames.second && m_FrameIndex.GetFrameStart(next) < columnEnd;
+         ++next) {
+      duration = std::max(duration, m_FrameIndex.GetFrameDuration(next));
+      isSpike = isSpike || m_FrameIndex.IsSpike(next);
+    }
+
+    float x0 = worldFromTick(m_FrameIndex.GetFrameStart(i));
+    float x1 = worldFromTick(m_FrameIndex.GetFrameEnd(next - 1));
+    float barHeight = height * float(duration) / float(maxDuration);
+    Box box;
+    box.m_Vertices[0] = Vec3(x0, posY, z);
+    box.m_Vertices[1] = Vec3(x0, posY + barHeight, z);
+    box.m_Vertices[2] = Vec3(x1, posY + barHeight, z);
+    box.m_Vertices[3] = Vec3(x1, posY, z);
+    Fill(colors, isSpike ? spikeColor : frameColor);
+    m_Batcher.AddBox(box, colors, PickingID::BOX);
+    i = next;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void TimeGraph::AddCounterTrackPrimitives(const PrimitivesContext& a_Context) {
+  const TimeGraphLayout& layout = a_Context.m_Layout;
+  auto worldFromTick = [&a_Context](TickType a_Tick) {
+    double us = MicroSecondsFromTicks(a_Context.m_SessionMinCounter, a_Tick) -
+                a_Context.m_MinTimeUs;
+    return float(a_Context.m_WorldStartX +
+                 us * a_Context.m_InvTimeWindow * a_Context.m_WorldWidth);
+  };
+
+  static Color counterColor(70, 130, 220, 255);
+  static Color textColor(255, 255, 255, 255);
+  float height = layout.GetCounterTrackHeight();
+  float pixelWidth = a_Context.m_WorldWidth / m_Canvas->getWidth();
+  float z = GlCanvas::Z_VALUE_BOX_ACTIVE;
+  Color colors[4];
+  Fill(colors, counterColor);
+
+  ScopeLock lock(m_CounterSeriesMutex);
+  int index = 0;
+  for (const auto& pair : m_CounterSeries) {
+    float posY = layout.GetCounterTrackOffset(index++);
+    std::string name = string_manager_->Get(pair.first).value_or("");
+    m_TextRendererStatic.AddText(name.c_str(), a_Context.m_WorldStartX,
+                                 posY + height, GlCanvas::Z_VALUE_TEXT,
+                                 textColor);
+
+    std::vector<CounterSeries::Column> columns = pair.second.GetColumns(
+        a_Context.m_RawStart, a_Context.m_RawStop, a_Context.m_TicksPerPixel);
+    if (columns.empty()) continue;
+    CounterSeries::Range range = columns[0].range;
+    for (const CounterSeries::Column& column : columns) {
+      range.min = std::min(range.min, column.range.min);
+      range.max = std::max(range.max, column.range.max);
+    }
+    double span = range.max - range.min;
+    auto worldFromValue = [&](double a_Value) {
+      double ratio = span > 0 ? (a_Value - range.min) / span : 0.5;
+      return posY + float(ratio) * height;
+    };
+
+    for (const CounterSeries::Column& column : columns) {
+      float x0 = worldFromTick(column.begin_time);
+      float x1 = std::max(worldFromTick(column.end_time), x0 + pixelWidth);
+      float y0 = worldFromValue(column.range.min);
+      // At least a pixel high, for the columns of a single value.
+      float y1 = std::max(worldFromValue(column.range.max), y0 + 1.f);
+      Box box;
+      box.m_Vertices[0] = Vec3(x0, y0, z);
+      box.m_Vertices[1] = Vec3(x0, y1, z);
+      box.m_Vertices[2] = Vec3(x1, y1, z);
+      box.m_Vertices[3] = Vec3(x1, y0, z);
+      m_Batcher.AddBox(box, colors, PickingID::BOX);
+    }
+  }
+}
+
 //-----------------------------------------------------------------------------
 bool TimeGraph::IsVisible(const Timer& a_Timer) {
   double start = MicroSecondsFromTicks(m_SessionMinCounter, a_Timer.m_Start);
@@ -3,22 +3,41 @@
 //-----------------------------------
 #pragma once
 
+#include <atomic>
+#include <bitset>
+#include <memory>
+#include <optional>
 #include <unordered_map>
 
 #include "Batcher.h"
 #include "BlockChain.h"
 #include "ContextSwitch.h"
+#include "CoreActivity.h"
 #include "Core.h"
+#include "CounterSeries.h"
+#include "CriticalPath.h"
 #include "EventBuffer.h"
+#include "FrameIndex.h"
+#include "FunctionOccurrenceIndex.h"
+#include "FunctionStats.h"
 #include "Geometry.h"
 #include "MemoryTracker.h"
+#include "MessageWorkerPool.h"
+#include "OnCpuTimeJoiner.h"
+#include "RenderStats.h"
+#include "SpillArena.h"
 #include "StringManager.h"
 #include "TextBox.h"
 #include "TextRenderer.h"
 #include "ThreadTrack.h"
 #include "ThreadTrackMap.h"
 #include "TimeGraphLayout.h"
+#include "TimerInstanceRenderer.h"
+#include "VertexBuffer.h"
+#include "absl/container/flat_hash_map.h"
 
+class Function;
+class SamplingProfiler;
 class Systrace;
 
 class TimeGraph {
@@ -30,19 +49,30 @@ class TimeGraph {
   void DrawMainFrame(TextBox& a_Box);
   void DrawEvents(bool a_Picking = false);
   void DrawTime();
-  void DrawLineBuffer(bool a_Picking);
-  void DrawBoxBuffer(bool a_Picking);
-  void DrawBuffered(bool a_Picking);
+  void DrawLineBuffer();
+  void DrawBoxBuffer();
+  void DrawBuffered();
   void DrawText();
 
   void NeedsUpdate();
-  void UpdatePrimitives(bool a_Picking);
+  // Starts generating the primitives of the current view on the worker
+  // threads. If a generation is already running, the view is generated again
+  // once its result has been applied.
+  void UpdatePrimitives();
 
   void UpdateThreadIds();
   void UpdateEvents();
   void SelectEvents(float a_WorldStart, float a_WorldEnd, ThreadID a_TID);
 
+  // Adds a timer. The timers are processed by a single thread at a time,
+  // without locking out the threads reading them. The function stats and the
+  // function occurrence index are updated by batches of timers:
+  // FlushFunctionStats updates them with the timers processed since the last
+  // batch, and is to be called by the same thread once it has no more timers
+  // to process for now. It also joins the timers of function calls with the
+  // core activities of their threads, into their on-CPU time.
   void ProcessTimer(const Timer& a_Timer);
+  void FlushFunctionStats();
   void UpdateThreadDepth(int a_ThreadId, int a_Depth);
   void UpdateMaxTimeStamp(TickType a_Time);
   void AddContextSwitch();
@@ -59,27 +89,40 @@ class TimeGraph {
 
   void Clear();
   void ZoomAll();
-  void Zoom(const TextBox* a_TextBox);
+  void Zoom(const Timer& a_Timer);
+  void Zoom(TickType a_Start, TickType a_End);
   void ZoomTime(float a_ZoomValue, double a_MouseRatio);
   void SetMinMax(double a_MinTimeUs, double a_MaxTimeUs);
+  // Centers the view on a_Time, keeping its width.
+  void JumpTo(TickType a_Time);
   void PanTime(int a_InitialX, int a_CurrentX, int a_Width,
                double a_InitialTime);
   double GetTime(double a_Ratio);
   double GetTimeIntervalMicro(double a_Ratio);
   void Select(const Vec2& a_WorldStart, const Vec2 a_WorldStop);
-  void Select(const TextBox* a_TextBox) { SelectRight(a_TextBox); }
-  void SelectLeft(const TextBox* a_TextBox);
-  void SelectRight(const TextBox* a_TextBox);
+  void Select(const CompactTimer* a_Timer) { SelectRight(a_Timer); }
+  void SelectLeft(const CompactTimer* a_Timer);
+  void SelectRight(const CompactTimer* a_Timer);
   double GetSessionTimeSpanUs();
   double GetCurrentTimeSpanUs();
   void NeedsRedraw() { m_NeedsRedraw = true; }
-  bool IsRedrawNeeded() const { return m_NeedsRedraw; }
+  bool IsRedrawNeeded() const {
+    return m_NeedsRedraw || IsPrimitivesUpdateDone() ||
+           IsSelectionReportDone();
+  }
+  // Whether timers, thread states or samples were added since the last call,
+  // for the view to be updated only when the data changed.
+  bool CheckForNewData();
   void ToggleDrawText() { m_DrawText = !m_DrawText; }
+  // Switches between drawing the boxes of the timers of thread tracks from
+  // their copy on the GPU and tessellating them on each update.
+  void ToggleInstancedTimers();
   void SetThreadFilter(const std::string& a_Filter);
 
   bool IsVisible(const Timer& a_Timer);
   int GetNumDrawnTextBoxes() { return m_NumDrawnTextBoxes; }
   void AddContextSwitch(const ContextSwitch& a_CS);
+  void AddThreadStateChange(const ThreadStateChange& thread_state_change);
   void SetPickingManager(class PickingManager* a_Manager) {
     m_PickingManager = a_Manager;
   }
@@ -94,6 +137,17 @@ class TimeGraph {
     m_Systrace = a_Systrace;
   }
   Batcher& GetBatcher() { return m_Batcher; }
+  RenderStats& GetRenderStats() { return m_RenderStats; }
+  // Timer drawn at a_WorldX, a_WorldY, found from the layout rather than by
+  // drawing a picking pass. nullptr if there is none.
+  const CompactTimer* FindTimer(float a_WorldX, float a_WorldY);
+  // Time a_Timer, of a function call, spent running on a core. std::nullopt
+  // until it is joined with the activities of its thread, or if it can't be.
+  std::optional<uint64_t> GetOnCpuTimeNs(const CompactTimer* a_Timer) const;
+  // Label of a_Timer, as drawn on its box.
+  std::string GetTimerText(const Timer& a_Timer) const;
+  // Name of the function or zone of a_Timer, without the time of its label.
+  std::string GetTimerName(const Timer& a_Timer) const;
   uint32_t GetNumTimers() const;
   uint32_t GetNumCores() const;
   std::vector<std::shared_ptr<TimerChain> > GetAllTimerChains() const;
@@ -105,23 +159,204 @@ class TimeGraph {
   const MemoryTracker& GetMemoryTracker() const { return m_MemTracker; }
   const TimeGraphLayout& GetLayout() const { return m_Layout; }
   TimeGraphLayout& GetLayout() { return m_Layout; }
+  // Of the blocks of the timer chains, nullptr for the heap.
+  std::shared_ptr<BlockAllocator> GetTimerAllocator() const {
+    return m_TimerArena;
+  }
+  // Of the timers of the timer chains.
+  std::shared_ptr<TimerTables> GetTimerTables() const { return m_TimerTables; }
+  // The Timer a_Timer, of a timer chain, was compacted from.
+  Timer ExpandTimer(const CompactTimer& a_Timer) const {
+    return m_TimerTables->Expand(a_Timer);
+  }
   Color GetThreadColor(ThreadID a_TID) const;
 
+  // Frames of the calls to Capture::GMainFrameFunction, on the thread that
+  // called it first. Frames are indexed as the timers are processed, and
+  // drawn as a track of their durations above the cores.
+  struct FrameFunctionTime {
+    uint64_t m_FunctionAddress = 0;
+    uint32_t m_Count = 0;
+    TickType m_TotalTicks = 0;
+  };
+  // Indexes the frames of the timers already processed again, for when
+  // Capture::GMainFrameFunction changed.
+  void RebuildFrameIndex();
+  size_t GetNumFrames() const;
+  // Time in the selected functions of the calls starting in a_Frame, longest
+  // first. Only goes through the timers of the frame.
+  std::vector<FrameFunctionTime> GetFrameBreakdown(size_t a_Frame) const;
+  // Duration of a_Frame and its breakdown, as shown when hovering it.
+  std::string GetFrameText(size_t a_Frame) const;
+  // Frame drawn at a_WorldX, a_WorldY on the frame track, if any.
+  std::optional<size_t> FindFrame(float a_WorldX, float a_WorldY);
+  void ZoomFrame(size_t a_Frame);
+  // Zooms on the next of the kNumWorstFrames longest frames, in turn.
+  void ZoomNextWorstFrame();
+
+  // The critical path of what a_TID did in [a_Start, a_End), across the
+  // threads that woke it up, from the thread states: see ComputeCriticalPath.
+  // Its segments are highlighted on the thread state tracks, with the
+  // wakeups it follows, until it is cleared.
+  void ComputeCriticalPath(ThreadID a_TID, TickType a_Start, TickType a_End);
+  // Of a_Timer, or of a_Frame on the thread of the frames.
+  void ComputeCriticalPath(const CompactTimer& a_Timer);
+  void ComputeFrameCriticalPath(size_t a_Frame);
+  void ClearCriticalPath();
+  bool HasCriticalPath() const { return !m_CriticalPath.empty(); }
+  // Time of the critical path in each state, then in the functions of the
+  // timers of its running segments, longest first.
+  const std::string& GetCriticalPathText() const { return m_CriticalPathText; }
+
+  // The calls of the function of a_Timer right before and after it, on any
+  // thread, nullptr if there is none.
+  const CompactTimer* FindPreviousCall(const CompactTimer& a_Timer) const;
+  const CompactTimer* FindNextCall(const CompactTimer& a_Timer) const;
+  // Stats of the calls of a_FunctionAddress starting in [a_Min, a_Max].
+  FunctionStats GetFunctionStats(uint64_t a_FunctionAddress, TickType a_Min,
+                                 TickType a_Max) const;
+
   void OnLeft();
   void OnRight();
   void OnUp();
   void OnDown();
+  // Selects the previous or next call of the function of the selected timer.
+  void OnPreviousCall();
+  void OnNextCall();
 
  protected:
   std::shared_ptr<ThreadTrack> GetThreadTrack(ThreadID a_TID);
-  ThreadTrackMap GetThreadTracksCopy() const;
+  // The tracks as of the last track added, by index. Cheap to get: the list
+  // is only copied when a track is added.
+  std::shared_ptr<const ThreadTrackList> GetThreadTracksSnapshot() const;
+  // The world Y range on screen, extended by a_Margin screens above and
+  // below it, out of which tracks are culled.
+  void GetTrackRange(float a_Margin, float* o_MinY, float* o_MaxY) const;
 
  private:
+  // What generating the primitives reads, copied on the UI thread when the
+  // generation starts so that the view can change while it runs.
+  struct PrimitivesContext {
+    TimeGraphLayout m_Layout;
+    TickType m_RawStart = 0;
+    TickType m_RawStop = 0;
+    TickType m_TicksPerPixel = 0;
+    TickType m_SessionMinCounter = 0;
+    double m_MinTimeUs = 0;
+    double m_InvTimeWindow = 0;
+    float m_WorldStartX = 0;
+    float m_WorldWidth = 0;
+    float m_MinX = 0;
+    int m_CanvasWidth = 0;
+    ThreadID m_SelectedThreadId = 0;
+    const CompactTimer* m_SelectedTimer = nullptr;
+    // The calls of the function of the selected timer are highlighted.
+    uint64_t m_HighlightedFunction = 0;
+    std::map<uint64_t, Function*> m_SelectedFunctions;
+    std::map<uint64_t, Function*> m_VisibleFunctions;
+    // Whether the boxes of the timers of thread tracks are drawn by
+    // m_TimerInstances instead.
+    bool m_InstancedTimers = false;
+  };
+
+  struct BoxPrimitive {
+    Box m_Box;
+    Color m_Colors[4];
+    const CompactTimer* m_Timer;
+  };
+  struct LinePrimitive {
+    Line m_Line;
+    Color m_Colors[2];
+    const CompactTimer* m_Timer;
+  };
+  struct TextPrimitive {
+    std::string m_Text;
+    // Length of the elapsed time at the end of m_Text, kept when truncated.
+    size_t m_TimeLength = 0;
+    float m_PosX;
+    float m_PosY;
+    float m_MaxSize;
+  };
+  // Primitives of the timers of one thread track.
+  struct TrackPrimitives {
+    std::vector<BoxPrimitive> m_Boxes;
+    std::vector<LinePrimitive> m_Lines;
+    std::vector<TextPrimitive> m_Texts;
+    // Depth of the timers of the thread of the track, and of the timers of
+    // other threads, which only the scheduling track has.
+    int m_TrackDepth = 0;
+    std::map<ThreadID, int> m_ThreadDepths;
+  };
+
+  // Each track is generated by one worker, into its own TrackPrimitives,
+  // and only touches the text boxes of that track.
+  struct PrimitivesUpdate {
+    PrimitivesContext m_Context;
+    std::vector<std::shared_ptr<ThreadTrack>> m_Tracks;
+    std::vector<TrackPrimitives> m_Primitives;
+    std::atomic<size_t> m_NextTrack = 0;
+    std::atomic<size_t> m_NumPendingTracks = 0;
+    std::atomic<uint64_t> m_WorkerMicros = 0;
+  };
+
+  // GetThreadTrack, without locking once a thread has its track. Only called
+  // by the thread processing the timers.
+  ThreadTrack* GetWriterThreadTrack(ThreadID a_TID);
+  void UpdateTrackPrimitives(const PrimitivesContext& a_Context,
+                             ThreadTrack* a_Track,
+                             TrackPrimitives* o_Primitives) const;
+  // Label of a_Timer, with the functions of a_SelectedFunctions named.
+  // o_TimeLength receives the length of the elapsed time it ends with.
+  std::string GetTimerText(
+      const Timer& a_Timer,
+      const std::map<uint64_t, Function*>& a_SelectedFunctions,
+      size_t* o_TimeLength = nullptr) const;
+  bool IsPrimitivesUpdateDone() const {
+    return m_PrimitivesUpdate != nullptr &&
+           m_PrimitivesUpdate->m_NumPendingTracks == 0;
+  }
+  // Replaces the drawn primitives by those of the finished update.
+  void ApplyPrimitivesUpdate();
+
+  // The report of a selection of samples, built by m_SelectionWorker.
+  // Cancelled when the selection changes before it is done.
+  struct SelectionReportUpdate {
+    std::atomic<bool> m_Cancelled = false;
+    std::atomic<bool> m_Done = false;
+    // Null if there are no samples in the selection.
+    std::shared_ptr<SamplingProfiler> m_Profiler;
+  };
+  bool IsSelectionReportDone() const {
+    return m_SelectionReportUpdate != nullptr &&
+           m_SelectionReportUpdate->m_Done;
+  }
+  void ApplySelectionReport();
+  void CancelSelectionReport();
+  // Color of the box of a_Timer, before selection and filtering.
+  Color GetTimerColor(const Timer& a_Timer) const;
+  void DrawTimerInstances();
+  // Sends the primitives of m_Batcher to the GPU if they changed since they
+  // were last sent.
+  void UploadBatcher();
+  // Spills the timers beyond GParams.m_TimerMemoryBudgetMb to disk, if set.
+  void ResetTimerArena();
+  void AddFrame(const Timer& a_Timer);
+  void DrawCriticalPath();
+  std::string MakeCriticalPathText() const;
+  // Bars of the durations of the frames in the view, one per pixel column
+  // at most, with the longest frame of the column.
+  void AddFrameTrackPrimitives(const PrimitivesContext& a_Context);
+  // The values of each tracked variable in the view, as a bar from the min to
+  // the max of the values of each pixel column, scaled to the range of the
+  // values in view.
+  void AddCounterTrackPrimitives(const PrimitivesContext& a_Context);
+
   TextRenderer m_TextRendererStatic;
   TextRenderer* m_TextRenderer = nullptr;
   GlCanvas* m_Canvas = nullptr;
   TextBox m_SceneBox;
   int m_NumDrawnTextBoxes = 0;
+  RenderStats m_RenderStats;
 
   double m_RefTimeUs = 0;
   double m_MinTimeUs = 0;
@@ -144,30 +379,93 @@ class TimeGraph {
   std::map<ThreadID, class EventTrack*>
       m_EventTracks;  // TODO: put in ThreadTrack
 
-  std::map<DWORD /*ThreadId*/, std::map<long long, ContextSwitch> >
-      m_ContextSwitchesMap;
-  std::map<DWORD /*CoreId*/, std::map<long long, ContextSwitch> >
-      m_CoreUtilizationMap;
-
-  std::map<ThreadID, uint32_t> m_ThreadCountMap;
+  // Pairs the context switches of local captures and of older services,
+  // which don't send CoreActivity.
+  ContextSwitchPairer m_ContextSwitchPairer;
+  // Cores of the Timer::CORE_ACTIVITY timers, by Timer::m_Processor.
+  std::bitset<256> m_ActiveCores;
+  std::atomic<uint32_t> m_NumCores = 0;
+  // Whether any Timer::FILE_IO timer was processed.
+  std::atomic<bool> m_HasFileIo = false;
+  // Whether any Timer::PAGE_FAULT timer was processed.
+  std::atomic<bool> m_HasPageFaults = false;
 
   std::vector<CallstackEvent> m_SelectedCallstackEvents;
   bool m_NeedsUpdatePrimitives = false;
   bool m_DrawText = true;
   bool m_NeedsRedraw = false;
-  std::vector<TextBox*> m_VisibleTextBoxes;
+  // Incremented by the threads adding data, see CheckForNewData.
+  std::atomic<uint64_t> m_DataGeneration = 0;
+  uint64_t m_CheckedDataGeneration = 0;
+  TickType m_CheckedMaxEventTime = 0;
   Batcher m_Batcher;
+  VertexBuffer m_BoxVertices;
+  VertexBuffer m_BoxColors;
+  VertexBuffer m_LineVertices;
+  VertexBuffer m_LineColors;
+  uint64_t m_UploadedVersion = ~0ULL;
+  TimerInstanceRenderer m_TimerInstances;
+  bool m_InstancedTimers = false;
+  // Whether the primitives drawn left the timers to m_TimerInstances.
+  bool m_DrawInstancedTimers = false;
   PickingManager* m_PickingManager = nullptr;
   Timer m_LastThreadReorder;
   MemoryTracker m_MemTracker;
   std::shared_ptr<Systrace> m_Systrace;
 
+  // Replaced on Clear, kept alive by the timer chains still using them.
+  std::shared_ptr<SpillArena> m_TimerArena;
+  std::shared_ptr<TimerTables> m_TimerTables =
+      std::make_shared<TimerTables>();
+
   mutable Mutex m_Mutex;
   ThreadTrackMap m_ThreadTracks;
+  std::shared_ptr<const ThreadTrackList> m_ThreadTracksSnapshot =
+      std::make_shared<ThreadTrackList>();
+  // Only used by the thread processing the timers. The tracks are kept alive
+  // by m_ThreadTracks until Clear.
+  std::unordered_map<ThreadID, ThreadTrack*> m_WriterThreadTracks;
+  static constexpr uint32_t kFunctionStatsBatchSize = 4 * 1024;
+  std::unordered_map<uint64_t, FunctionStats> m_PendingFunctionStats;
+  uint32_t m_NumPendingFunctionStats = 0;
+  std::vector<const CompactTimer*> m_PendingOccurrences;
+  FunctionOccurrenceIndex m_OccurrenceIndex;
+  // Only used by the thread processing the timers, keyed by the timers.
+  OnCpuTimeJoiner m_OnCpuTimeJoiner;
+  std::vector<OnCpuTimeJoiner::JoinedTimer> m_JoinedTimers;
+  // Written by the thread processing the timers, read by the UI.
+  mutable Mutex m_OnCpuTimesMutex;
+  absl::flat_hash_map<const CompactTimer*, uint64_t> m_OnCpuTimes;
   double m_MarginRatio = 0.1;
   std::string m_ThreadFilter;
 
+  static constexpr size_t kNumWorstFrames = 10;
+  // Written by the thread processing the timers, read by the UI.
+  mutable Mutex m_FrameIndexMutex;
+  FrameIndex m_FrameIndex;
+  std::optional<ThreadID> m_FrameThreadId;
+  // The main frame function of m_FrameIndex, read without the lock for each
+  // timer processed.
+  std::atomic<uint64_t> m_FrameFunctionAddress = 0;
+  size_t m_NextWorstFrame = 0;
+
+  // Only used by the UI thread.
+  std::vector<CriticalPathSegment> m_CriticalPath;
+  std::string m_CriticalPathText;
+
+  // The values of the Timer::VARIABLE timers, by name key. Written by the
+  // thread processing the timers, read by the UI.
+  mutable Mutex m_CounterSeriesMutex;
+  std::map<uint64_t, CounterSeries> m_CounterSeries;
+
   std::shared_ptr<StringManager> string_manager_;
+
+  std::shared_ptr<PrimitivesUpdate> m_PrimitivesUpdate;
+  size_t m_NumPrimitivesWorkers = 1;
+  std::shared_ptr<SelectionReportUpdate> m_SelectionReportUpdate;
+  // Declared last, so that the workers are done before the rest is destroyed.
+  std::unique_ptr<MessageWorkerPool> m_PrimitivesWorkers;
+  std::unique_ptr<MessageWorkerPool> m_SelectionWorker;
 };
 
 extern TimeGraph* GCurrentTimeGraph;
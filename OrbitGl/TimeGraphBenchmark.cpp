@@ -0,0 +1,212 @@
+// Benchmark of the rendering of the capture timeline. Fills a TimeGraph with
+// synthetic timers and times each stage of drawing it over a scripted
+// sequence of zooms and pans:
+// - update: generating the primitives of the view, UpdatePrimitives until
+//   its workers are done;
+// - draw: applying them and drawing the tracks, Draw;
+// - redraw: drawing the same primitives again, DrawBuffered;
+// - text: DrawText;
+// - pick: finding the timers under a grid of mouse positions, FindTimer.
+// GL stages are timed up to glFinish. Needs an OpenGL context, created in a
+// hidden freeglut window: run under Xvfb on a machine without a display.
+//
+// Usage: OrbitGlBenchmark [num_threads] [max_depth] [num_timers_per_thread]
+//                         [num_frames]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Capture.h"
+#include "GL/freeglut.h"
+#include "GlCanvas.h"
+#include "OpenGl.h"
+#include "OrbitProcess.h"
+#include "Profiling.h"
+#include "ScopeTimer.h"
+#include "StringManager.h"
+#include "TimeGraph.h"
+
+namespace {
+struct Options {
+  uint32_t m_NumThreads = 16;
+  uint32_t m_MaxDepth = 8;
+  uint32_t m_NumTimersPerThread = 100 * 1000;
+  uint32_t m_NumFrames = 60;
+  int m_Width = 1920;
+  int m_Height = 1080;
+};
+
+struct Stage {
+  const char* m_Name;
+  std::vector<double> m_Millis;
+};
+
+// Adds the timer [a_Start, a_End) of a_Depth and, below it, two children
+// splitting it with gaps, down to a_MaxDepth. Children end before their
+// parent, as they would be captured.
+void AddTimers(TimeGraph& a_TimeGraph, ThreadID a_TID, TickType a_Start,
+               TickType a_End, uint32_t a_Depth, uint32_t a_MaxDepth,
+               uint32_t* io_Budget) {
+  if (*io_Budget == 0) return;
+  --*io_Budget;
+  TickType span = a_End - a_Start;
+  if (a_Depth + 1 < a_MaxDepth && span >= 8) {
+    TickType quarter = span / 4;
+    AddTimers(a_TimeGraph, a_TID, a_Start + quarter / 4, a_Start + 2 * quarter,
+              a_Depth + 1, a_MaxDepth, io_Budget);
+    AddTimers(a_TimeGraph, a_TID, a_Start + 2 * quarter + quarter / 4,
+              a_End - quarter / 4, a_Depth + 1, a_MaxDepth, io_Budget);
+  }
+
+  Timer timer;
+  timer.m_TID = a_TID;
+  timer.m_Depth = static_cast<uint8_t>(a_Depth);
+  timer.m_Start = a_Start;
+  timer.m_End = a_End;
+  a_TimeGraph.ProcessTimer(timer);
+}
+
+void AddSyntheticTimers(TimeGraph& a_TimeGraph, const Options& a_Options) {
+  // One root timer every 16 ms, as many as needed for the timer count.
+  const TickType kRootPeriod = TicksFromMicroseconds(16 * 1000);
+  const TickType kBase = TicksFromMicroseconds(1000 * 1000);
+  for (uint32_t thread = 0; thread < a_Options.m_NumThreads; ++thread) {
+    ThreadID tid = thread + 1;
+    uint32_t budget = a_Options.m_NumTimersPerThread;
+    TickType start = kBase + thread * kRootPeriod / a_Options.m_NumThreads;
+    while (budget > 0) {
+      AddTimers(a_TimeGraph, tid, start, start + kRootPeriod * 3 / 4, 0,
+                a_Options.m_MaxDepth, &budget);
+      start += kRootPeriod;
+    }
+    Capture::GTargetProcess->SetThreadName(
+        tid, "Thread " + std::to_string(tid));
+  }
+  a_TimeGraph.FlushFunctionStats();
+}
+
+// Zooms in on the middle of the session, pans across it, and zooms back out,
+// a third of the frames each.
+void SetView(TimeGraph& a_TimeGraph, uint32_t a_Frame, uint32_t a_NumFrames) {
+  const double kPanWindow = 0.01;
+  uint32_t third = std::max(1u, a_NumFrames / 3);
+  uint32_t phase = std::min(a_Frame / third, 2u);
+  double progress = std::min(1.0, double(a_Frame - phase * third) / third);
+  double window = kPanWindow;
+  double center = 0.5;
+  if (phase == 0) {
+    window = std::pow(kPanWindow, progress);
+  } else if (phase == 1) {
+    center = 0.1 + 0.8 * progress;
+  } else {
+    window = std::pow(kPanWindow, 1.0 - progress);
+  }
+
+  double sessionUs = a_TimeGraph.GetSessionTimeSpanUs();
+  a_TimeGraph.SetMinMax(sessionUs * (center - 0.5 * window),
+                        sessionUs * (center + 0.5 * window));
+}
+
+void PrintStage(const Stage& a_Stage) {
+  std::vector<double> millis = a_Stage.m_Millis;
+  if (millis.empty()) return;
+  std::sort(millis.begin(), millis.end());
+  double total = 0;
+  for (double ms : millis) total += ms;
+  printf("%-8s mean %8.3f ms  median %8.3f ms  p90 %8.3f ms  max %8.3f ms\n",
+         a_Stage.m_Name, total / millis.size(), millis[millis.size() / 2],
+         millis[millis.size() * 9 / 10], millis.back());
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (argc > 1) options.m_NumThreads = std::stoul(argv[1]);
+  if (argc > 2) options.m_MaxDepth = std::min(256ul, std::stoul(argv[2]));
+  if (argc > 3) options.m_NumTimersPerThread = std::stoul(argv[3]);
+  if (argc > 4) options.m_NumFrames = std::max(1ul, std::stoul(argv[4]));
+
+  glutInit(&argc, argv);
+  glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA | GLUT_DEPTH);
+  glutInitWindowSize(options.m_Width, options.m_Height);
+  glutCreateWindow("OrbitGlBenchmark");
+  glutHideWindow();
+
+  Capture::GTargetProcess = std::make_shared<Process>();
+  GlCanvas canvas;
+  canvas.Initialize();
+  canvas.Resize(options.m_Width, options.m_Height);
+  canvas.GetTextRenderer().Init();
+
+  TimeGraph timeGraph;
+  GCurrentTimeGraph = &timeGraph;
+  timeGraph.SetTextRenderer(&canvas.GetTextRenderer());
+  timeGraph.SetPickingManager(&canvas.GetPickingManager());
+  timeGraph.SetCanvas(&canvas);
+  timeGraph.SetStringManager(std::make_shared<StringManager>());
+
+  Timer fillTimer;
+  fillTimer.Start();
+  AddSyntheticTimers(timeGraph, options);
+  printf("%u threads, depth %u, %u timers: added in %.3f ms\n",
+         options.m_NumThreads, options.m_MaxDepth, timeGraph.GetNumTimers(),
+         fillTimer.QueryMillis());
+
+  Stage update{"update"};
+  Stage draw{"draw"};
+  Stage redraw{"redraw"};
+  Stage text{"text"};
+  Stage pick{"pick"};
+  const int kPickGrid = 16;
+  for (uint32_t frame = 0; frame < options.m_NumFrames; ++frame) {
+    canvas.prepare2DViewport(0, 0, options.m_Width, options.m_Height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    SetView(timeGraph, frame, options.m_NumFrames);
+
+    Timer timer;
+    timer.Start();
+    timeGraph.UpdatePrimitives();
+    while (!timeGraph.IsRedrawNeeded()) std::this_thread::yield();
+    update.m_Millis.push_back(timer.QueryMillis());
+
+    timer.Start();
+    timeGraph.Draw();
+    glFinish();
+    draw.m_Millis.push_back(timer.QueryMillis());
+
+    timer.Start();
+    timeGraph.DrawBuffered();
+    glFinish();
+    redraw.m_Millis.push_back(timer.QueryMillis());
+
+    timer.Start();
+    timeGraph.DrawText();
+    glFinish();
+    text.m_Millis.push_back(timer.QueryMillis());
+
+    timer.Start();
+    for (int y = 0; y < kPickGrid; ++y) {
+      for (int x = 0; x < kPickGrid; ++x) {
+        float worldX, worldY;
+        canvas.ScreenToWorld(x * options.m_Width / kPickGrid,
+                             y * options.m_Height / kPickGrid, worldX,
+                             worldY);
+        timeGraph.FindTimer(worldX, worldY);
+      }
+    }
+    pick.m_Millis.push_back(timer.QueryMillis());
+
+    glutSwapBuffers();
+  }
+
+  for (const Stage* stage : {&update, &draw, &redraw, &text, &pick}) {
+    PrintStage(*stage);
+  }
+  GCurrentTimeGraph = nullptr;
+  return 0;
+}
@@ -14,6 +14,10 @@ TimeGraphLayout::TimeGraphLayout() {
   m_TextBoxHeight = 20.f;
   m_CoresHeight = 5.f;
   m_EventTrackHeight = 10.f;
+  m_FrameTrackHeight = 40.f;
+  m_CounterTrackHeight = 30.f;
+  m_SpaceBetweenFrameTrackAndCores = 10.f;
+  m_SpaceBetweenCounterTracks = 10.f;
   m_SpaceBetweenCores = 2.f;
   m_SpaceBetweenCoresAndThread = 10.f;
   m_SpaceBetweenTracks = 2.f;
@@ -23,17 +27,37 @@ TimeGraphLayout::TimeGraphLayout() {
 
 //-----------------------------------------------------------------------------
 float TimeGraphLayout::GetThreadStart() {
+  float start = m_WorldY - GetFrameTrackSpace() - GetCounterTracksSpace();
   if (Capture::GHasContextSwitches) {
-    return m_WorldY - m_NumCores * m_CoresHeight -
+    return start - m_NumCores * m_CoresHeight -
            std::max(m_NumCores - 1, 0) * m_SpaceBetweenCores -
            m_SpaceBetweenCoresAndThread;
   }
 
-  return m_WorldY;
+  return start;
 }
 
 //-----------------------------------------------------------------------------
-float TimeGraphLayout::GetTracksHeight() {
+float TimeGraphLayout::GetFrameTrackSpace() const {
+  return m_DrawFrameTrack
+             ? m_FrameTrackHeight + m_SpaceBetweenFrameTrackAndCores
+             : 0.f;
+}
+
+//-----------------------------------------------------------------------------
+float TimeGraphLayout::GetCounterTrackOffset(int a_Index) const {
+  return m_WorldY - GetFrameTrackSpace() - m_CounterTrackHeight -
+         a_Index * (m_CounterTrackHeight + m_SpaceBetweenCounterTracks);
+}
+
+//-----------------------------------------------------------------------------
+float TimeGraphLayout::GetCounterTracksSpace() const {
+  return m_NumCounterTracks *
+         (m_CounterTrackHeight + m_SpaceBetweenCounterTracks);
+}
+
+//-----------------------------------------------------------------------------
+float TimeGraphLayout::GetTracksHeight() const {
   return m_NumTracks ? m_NumTracks * m_EventTrackHeight +
                            std::max(m_NumTracks - 1, 0) * m_SpaceBetweenTracks +
                            m_SpaceBetweenTracksAndThread
@@ -72,10 +96,20 @@ void TimeGraphLayout::SortTracksByPosition(
 
 //-----------------------------------------------------------------------------
 void TimeGraphLayout::CalculateOffsets(const ThreadTrackMap& a_ThreadTracks) {
-  m_ThreadBlockOffsets.clear();
-
   m_NumTracks = 1;
   if (m_DrawFileIO) ++m_NumTracks;
+  if (m_DrawPageFaults) ++m_NumTracks;
+  if (Capture::GHasThreadStates) ++m_NumTracks;
+
+  m_TrackIndices.clear();
+  m_TrackLayouts.assign(a_ThreadTracks.size(), TrackLayout());
+  for (auto& pair : a_ThreadTracks) {
+    uint32_t index = pair.second->GetIndex();
+    if (index >= m_TrackLayouts.size()) m_TrackLayouts.resize(index + 1);
+    m_TrackIndices[pair.first] = index;
+    m_TrackLayouts[index].m_Height =
+        GetTracksHeight() + pair.second->GetDepth() * m_TextBoxHeight;
+  }
 
   if (!Capture::IsCapturing()) {
     SortTracksByPosition(a_ThreadTracks);
@@ -87,24 +121,28 @@ void TimeGraphLayout::CalculateOffsets(const ThreadTrackMap& a_ThreadTracks) {
     if (iter == a_ThreadTracks.end()) continue;
 
     std::shared_ptr<ThreadTrack> track = iter->second;
-    m_ThreadBlockOffsets[threadID] = offset;
-    float threadBlockHeight =
-        GetTracksHeight() + track->GetDepth() * m_TextBoxHeight;
-    offset -= (threadBlockHeight + m_SpaceBetweenThreadBlocks);
+    TrackLayout& trackLayout = m_TrackLayouts[track->GetIndex()];
+    trackLayout.m_BlockStart = offset;
+    trackLayout.m_HasOffset = true;
+    trackLayout.m_Visible = true;
+    offset -= (trackLayout.m_Height + m_SpaceBetweenThreadBlocks);
   }
 
   for (auto& pair : a_ThreadTracks) {
     auto& track = pair.second;
     if (track.get() && track->IsMoving()) {
-      m_ThreadBlockOffsets[track->GetID()] = track->GetPos()[1];
+      TrackLayout& trackLayout = m_TrackLayouts[track->GetIndex()];
+      trackLayout.m_BlockStart = track->GetPos()[1];
+      trackLayout.m_HasOffset = true;
     }
   }
 }
 
 //-----------------------------------------------------------------------------
-float TimeGraphLayout::GetCoreOffset(int a_CoreId) {
+float TimeGraphLayout::GetCoreOffset(int a_CoreId) const {
   if (Capture::GHasContextSwitches) {
-    float coreOffset = m_WorldY - m_CoresHeight -
+    float coreOffset = m_WorldY - GetFrameTrackSpace() -
+                       GetCounterTracksSpace() - m_CoresHeight -
                        a_CoreId * (m_CoresHeight + m_SpaceBetweenCores);
     return coreOffset;
   }
@@ -113,20 +151,29 @@ float TimeGraphLayout::GetCoreOffset(int a_CoreId) {
 }
 
 //-----------------------------------------------------------------------------
-float TimeGraphLayout::GetThreadOffset(ThreadID a_TID, int a_Depth) {
-  return m_ThreadBlockOffsets[a_TID] - GetTracksHeight() -
+float TimeGraphLayout::GetThreadOffset(ThreadID a_TID, int a_Depth) const {
+  return GetThreadBlockStart(a_TID) - GetTracksHeight() -
          (a_Depth + 1) * m_TextBoxHeight;
 }
 
 //-----------------------------------------------------------------------------
-float TimeGraphLayout::GetThreadBlockStart(ThreadID a_TID) {
-  return m_ThreadBlockOffsets[a_TID];
+int TimeGraphLayout::GetTrackIndex(ThreadID a_TID) const {
+  auto iter = m_TrackIndices.find(a_TID);
+  return iter != m_TrackIndices.end() ? static_cast<int>(iter->second) : -1;
+}
+
+//-----------------------------------------------------------------------------
+float TimeGraphLayout::GetThreadBlockStart(ThreadID a_TID) const {
+  int index = GetTrackIndex(a_TID);
+  return index >= 0 ? m_TrackLayouts[index].m_BlockStart : 0.f;
 }
 
 //-----------------------------------------------------------------------------
 float TimeGraphLayout::GetSamplingTrackOffset(ThreadID a_TID) {
-  auto iter = m_ThreadBlockOffsets.find(a_TID);
-  if (iter != m_ThreadBlockOffsets.end()) return m_ThreadBlockOffsets[a_TID];
+  int index = GetTrackIndex(a_TID);
+  if (index >= 0 && m_TrackLayouts[index].m_HasOffset) {
+    return m_TrackLayouts[index].m_BlockStart;
+  }
   return -1.f;
 }
 
@@ -138,9 +185,32 @@ float TimeGraphLayout::GetFileIOTrackOffset(ThreadID a_TID) {
 }
 
 //-----------------------------------------------------------------------------
-bool TimeGraphLayout::IsThreadVisible(ThreadID a_TID) {
-  return std::find(m_SortedThreadIds.begin(), m_SortedThreadIds.end(), a_TID) !=
-         m_SortedThreadIds.end();
+float TimeGraphLayout::GetPageFaultTrackOffset(ThreadID a_TID) {
+  if (!m_DrawPageFaults) return 0.f;
+  float offset = m_DrawFileIO ? GetFileIOTrackOffset(a_TID)
+                              : GetSamplingTrackOffset(a_TID);
+  return offset - m_EventTrackHeight - m_SpaceBetweenTracks;
+}
+
+//-----------------------------------------------------------------------------
+float TimeGraphLayout::GetThreadStateTrackOffset(ThreadID a_TID) {
+  float offset = m_DrawPageFaults ? GetPageFaultTrackOffset(a_TID)
+                 : m_DrawFileIO   ? GetFileIOTrackOffset(a_TID)
+                                  : GetSamplingTrackOffset(a_TID);
+  return offset - m_EventTrackHeight - m_SpaceBetweenTracks;
+}
+
+//-----------------------------------------------------------------------------
+bool TimeGraphLayout::IsThreadVisible(ThreadID a_TID) const {
+  int index = GetTrackIndex(a_TID);
+  return index >= 0 && m_TrackLayouts[index].m_Visible;
+}
+
+//-----------------------------------------------------------------------------
+bool TimeGraphLayout::IsThreadInRange(ThreadID a_TID, float a_MinY,
+                                      float a_MaxY) const {
+  int index = GetTrackIndex(a_TID);
+  return index >= 0 && IsTrackInRange(index, a_MinY, a_MaxY);
 }
 
 //-----------------------------------------------------------------------------
@@ -161,4 +231,9 @@ void TimeGraphLayout::SetSortedThreadIds(
 }
 
 //-----------------------------------------------------------------------------
-void TimeGraphLayout::Reset() { m_DrawFileIO = false; }
+void TimeGraphLayout::Reset() {
+  m_DrawFileIO = false;
+  m_DrawPageFaults = false;
+  m_DrawFrameTrack = false;
+  m_NumCounterTracks = 0;
+}
@@ -9,20 +9,65 @@
 #include "CallstackTypes.h"
 #include "CoreMath.h"
 #include "ThreadTrackMap.h"
+#include "absl/container/flat_hash_map.h"
 
 //-----------------------------------------------------------------------------
 class TimeGraphLayout {
  public:
   TimeGraphLayout();
 
-  float GetCoreOffset(int a_CoreId);
+  float GetCoreOffset(int a_CoreId) const;
+  // The frame time track is drawn above the cores, when there are frames.
+  float GetFrameTrackOffset() const { return m_WorldY - m_FrameTrackHeight; }
+  float GetFrameTrackHeight() const { return m_FrameTrackHeight; }
+  bool GetDrawFrameTrack() const { return m_DrawFrameTrack; }
+  void SetDrawFrameTrack(bool a_Draw) { m_DrawFrameTrack = a_Draw; }
+  // The file I/O track of each thread is drawn below its sampling track, when
+  // file I/O was traced.
+  bool GetDrawFileIO() const { return m_DrawFileIO; }
+  void SetDrawFileIO(bool a_Draw) { m_DrawFileIO = a_Draw; }
+  // The page fault track of each thread is drawn below its file I/O track,
+  // when page faults were sampled.
+  bool GetDrawPageFaults() const { return m_DrawPageFaults; }
+  void SetDrawPageFaults(bool a_Draw) { m_DrawPageFaults = a_Draw; }
+  // The counter tracks of the tracked variables are drawn below the frame
+  // time track, one per variable.
+  float GetCounterTrackOffset(int a_Index) const;
+  float GetCounterTrackHeight() const { return m_CounterTrackHeight; }
+  void SetNumCounterTracks(int a_Num) { m_NumCounterTracks = a_Num; }
   float GetThreadStart();
-  float GetThreadBlockStart(ThreadID a_TID);
-  float GetThreadOffset(ThreadID a_TID, int a_Depth = 0);
-  float GetTracksHeight();
+  // The per-track layout is kept in flat tables indexed by
+  // ThreadTrack::GetIndex(), for the timers of a track to be placed with
+  // array loads. The ThreadID variants below first look up that index.
+  float GetTrackBlockStart(uint32_t a_Index) const {
+    return a_Index < m_TrackLayouts.size()
+               ? m_TrackLayouts[a_Index].m_BlockStart
+               : 0.f;
+  }
+  float GetTrackOffset(uint32_t a_Index, int a_Depth = 0) const {
+    return GetTrackBlockStart(a_Index) - GetTracksHeight() -
+           (a_Depth + 1) * m_TextBoxHeight;
+  }
+  bool IsTrackVisible(uint32_t a_Index) const {
+    return a_Index < m_TrackLayouts.size() && m_TrackLayouts[a_Index].m_Visible;
+  }
+  // Whether the block of a visible track intersects [a_MinY, a_MaxY], for the
+  // tracks scrolled out of view to be skipped.
+  bool IsTrackInRange(uint32_t a_Index, float a_MinY, float a_MaxY) const {
+    if (!IsTrackVisible(a_Index)) return false;
+    const TrackLayout& trackLayout = m_TrackLayouts[a_Index];
+    return trackLayout.m_BlockStart >= a_MinY &&
+           trackLayout.m_BlockStart - trackLayout.m_Height <= a_MaxY;
+  }
+  bool IsThreadInRange(ThreadID a_TID, float a_MinY, float a_MaxY) const;
+  float GetThreadBlockStart(ThreadID a_TID) const;
+  float GetThreadOffset(ThreadID a_TID, int a_Depth = 0) const;
+  float GetTracksHeight() const;
   float GetSamplingTrackOffset(ThreadID a_TID);
   float GetFileIOTrackOffset(ThreadID a_TID);
-  bool IsThreadVisible(ThreadID a_TID);
+  float GetPageFaultTrackOffset(ThreadID a_TID);
+  float GetThreadStateTrackOffset(ThreadID a_TID);
+  bool IsThreadVisible(ThreadID a_TID) const;
   float GetTotalHeight();
   float GetTextBoxHeight() const { return m_TextBoxHeight; }
   float GetTextCoresHeight() const { return m_CoresHeight; }
@@ -42,19 +87,32 @@ class TimeGraphLayout {
 
  protected:
   void SortTracksByPosition(const ThreadTrackMap& a_ThreadTracks);
+  // Height taken by the frame time track above the cores, 0 if not drawn.
+  float GetFrameTrackSpace() const;
+  // Height taken by the counter tracks, 0 if there are none.
+  float GetCounterTracksSpace() const;
+  // Index of the track of a_TID in m_TrackLayouts, or -1.
+  int GetTrackIndex(ThreadID a_TID) const;
 
  protected:
   int m_NumCores;
   int m_NumTracksPerThread;
 
   bool m_DrawFileIO;
+  bool m_DrawPageFaults;
+  bool m_DrawFrameTrack;
+  int m_NumCounterTracks;
 
   float m_WorldY;
 
   float m_TextBoxHeight;
   float m_CoresHeight;
   float m_EventTrackHeight;
+  float m_FrameTrackHeight;
+  float m_CounterTrackHeight;
 
+  float m_SpaceBetweenFrameTrackAndCores;
+  float m_SpaceBetweenCounterTracks;
   float m_SpaceBetweenCores;
   float m_SpaceBetweenCoresAndThread;
   float m_SpaceBetweenTracks;
@@ -64,7 +122,16 @@ class TimeGraphLayout {
   int m_NumTracks;
 
   std::map<ThreadID, int> m_ThreadDepths;
-  std::map<ThreadID, float> m_ThreadBlockOffsets;
+  struct TrackLayout {
+    float m_BlockStart = 0.f;
+    // Whether m_BlockStart was laid out, for GetSamplingTrackOffset.
+    bool m_HasOffset = false;
+    bool m_Visible = false;
+    // Of the whole block, cached from the depth of the track.
+    float m_Height = 0.f;
+  };
+  std::vector<TrackLayout> m_TrackLayouts;
+  absl::flat_hash_map<ThreadID, uint32_t> m_TrackIndices;
   std::vector<ThreadID> m_SortedThreadIds;
 
   ThreadTrackMap* m_ThreadTrackMap;
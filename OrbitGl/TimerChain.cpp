@@ -0,0 +1,139 @@
+#include "TimerChain.h"
+
+//-----------------------------------------------------------------------------
+void TimerChain::clear() {
+  ScopeLock lock(m_IndexMutex);
+  m_Index.clear();
+  BlockChain::clear();
+}
+
+//-----------------------------------------------------------------------------
+const CompactTimer* TimerChain::FindFirstInRange(TickType a_Min,
+                                                 TickType a_Max) {
+  ScopeLock lock(m_IndexMutex);
+  // Timers at the same depth don't overlap, so their ends are in order too.
+  auto endsBefore = [this, a_Min](const CompactTimer& a_Timer) {
+    return GetEnd(a_Timer) < a_Min;
+  };
+  for (TimerBlock* block = GetFirstBlockEndingAfter(a_Min); block != nullptr;
+       block = block->GetNext()) {
+    uint32_t size = block->GetSize();
+    const CompactTimer* begin = &block->m_Data[0];
+    const CompactTimer* end = begin + size;
+    const CompactTimer* first = std::partition_point(begin, end, endsBefore);
+    if (first != end) {
+      return first->m_Start <= a_Max ? first : nullptr;
+    }
+    if (size < kBlockSize) break;
+  }
+  return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+const CompactTimer* TimerChain::FindFirstStartingAfter(TickType a_Tick) {
+  ScopeLock lock(m_IndexMutex);
+  auto startsBefore = [a_Tick](const CompactTimer& a_Timer) {
+    return a_Timer.m_Start <= a_Tick;
+  };
+  for (TimerBlock* block = GetLastBlockStartingBefore(a_Tick);
+       block != nullptr; block = block->GetNext()) {
+    uint32_t size = block->GetSize();
+    const CompactTimer* begin = &block->m_Data[0];
+    const CompactTimer* end = begin + size;
+    const CompactTimer* first = std::partition_point(begin, end, startsBefore);
+    if (first != end) return first;
+    if (size < kBlockSize) break;
+  }
+  return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+const CompactTimer* TimerChain::FindLastStartingBefore(TickType a_Tick) {
+  ScopeLock lock(m_IndexMutex);
+  auto startsBefore = [a_Tick](const CompactTimer& a_Timer) {
+    return a_Timer.m_Start <= a_Tick;
+  };
+  const CompactTimer* last = nullptr;
+  for (TimerBlock* block = GetLastBlockStartingBefore(a_Tick);
+       block != nullptr; block = block->GetNext()) {
+    uint32_t size = block->GetSize();
+    const CompactTimer* begin = &block->m_Data[0];
+    const CompactTimer* end = begin + size;
+    const CompactTimer* first = std::partition_point(begin, end, startsBefore);
+    if (first != begin) last = first - 1;
+    if (first != end || size < kBlockSize) break;
+  }
+  return last;
+}
+
+//-----------------------------------------------------------------------------
+TimerChain::TimerBlock* TimerChain::UpdateIndex() {
+  TimerBlock* block =
+      m_Index.empty() ? m_Root : m_Index.back().m_Block->GetNext();
+  for (; block != nullptr && block->GetSize() == kBlockSize;
+       block = block->GetNext()) {
+    IndexedBlock indexed;
+    indexed.m_Block = block;
+    indexed.m_MinStart = block->m_Data[0].m_Start;
+    indexed.m_MaxEnd = m_Index.empty() ? 0 : m_Index.back().m_MaxEnd;
+    for (uint32_t i = 0; i < kBlockSize; ++i) {
+      indexed.m_MaxEnd = std::max(indexed.m_MaxEnd, GetEnd(block->m_Data[i]));
+    }
+    m_Index.push_back(indexed);
+  }
+  return block;
+}
+
+//-----------------------------------------------------------------------------
+TimerChain::TimerBlock* TimerChain::GetFirstBlockEndingAfter(TickType a_Tick) {
+  TimerBlock* tail = UpdateIndex();
+  auto it = std::lower_bound(m_Index.begin(), m_Index.end(), a_Tick,
+                             [](const IndexedBlock& a_Block, TickType a_Tick) {
+                               return a_Block.m_MaxEnd < a_Tick;
+                             });
+  return it != m_Index.end() ? it->m_Block : tail;
+}
+
+//-----------------------------------------------------------------------------
+TimerChain::TimerBlock* TimerChain::GetLastBlockStartingBefore(
+    TickType a_Tick) {
+  UpdateIndex();
+  auto it = std::upper_bound(m_Index.begin(), m_Index.end(), a_Tick,
+                             [](TickType a_Tick, const IndexedBlock& a_Block) {
+                               return a_Tick < a_Block.m_MinStart;
+                             });
+  return it != m_Index.begin() ? (it - 1)->m_Block : m_Root;
+}
+
+//-----------------------------------------------------------------------------
+void TimerChain::SkipStartingBefore(TickType a_Tick, TimerBlock** io_Block,
+                                    uint32_t* io_Index,
+                                    TickType* io_End) const {
+  auto startsBefore = [a_Tick](const CompactTimer& a_Timer) {
+    return a_Timer.m_Start < a_Tick;
+  };
+  TimerBlock* block = *io_Block;
+  uint32_t index = *io_Index;
+  while (block != nullptr) {
+    uint32_t size = block->GetSize();
+    if (index < size && startsBefore(block->m_Data[size - 1])) {
+      // The rest of the block is skipped.
+      *io_End = std::max(*io_End, GetEnd(block->m_Data[size - 1]));
+      index = size;
+    } else if (index < size) {
+      CompactTimer* first = std::partition_point(
+          &block->m_Data[index], &block->m_Data[size], startsBefore);
+      uint32_t firstIndex = uint32_t(first - &block->m_Data[0]);
+      if (firstIndex > index) {
+        *io_End = std::max(*io_End, GetEnd(block->m_Data[firstIndex - 1]));
+      }
+      index = firstIndex;
+      break;
+    }
+    if (size < kBlockSize || block->GetNext() == nullptr) break;
+    block = block->GetNext();
+    index = 0;
+  }
+  *io_Block = block;
+  *io_Index = index;
+}
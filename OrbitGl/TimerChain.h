@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "BlockChain.h"
+#include "CompactTimer.h"
+#include "Threading.h"
+
+//-----------------------------------------------------------------------------
+// Timers of one depth of a thread track. They are added as they end, which
+// at a given depth is also the order of their starts, by a single thread
+// while the UI reads them. Full blocks never change again, so they are
+// indexed by time, on demand and by the readers only, to find the timers of
+// a time range without going through all the others. Only the timers are
+// stored: what is drawn of them is computed for the visible ones only. The
+// blocks are in a_Allocator if given, e.g. the SpillArena of the time graph.
+// The timers are stored as CompactTimers, compacted with a_Tables, which
+// the chain keeps alive.
+class TimerChain : public BlockChain<CompactTimer, 4 * 1024> {
+ public:
+  static constexpr uint32_t kBlockSize = 4 * 1024;
+  using TimerBlock = Block<CompactTimer, kBlockSize>;
+
+  explicit TimerChain(std::shared_ptr<TimerTables> a_Tables,
+                      std::shared_ptr<BlockAllocator> a_Allocator = nullptr)
+      : BlockChain(std::move(a_Allocator)), m_Tables(std::move(a_Tables)) {
+    SetMemorySubsystem(MemorySubsystem::kThreadTracks);
+  }
+
+  void clear();
+
+  // Compacts a_Timer and adds it. Only called by the thread adding timers.
+  const CompactTimer& Add(const Timer& a_Timer) {
+    push_back(m_Tables->Compact(a_Timer));
+    return back();
+  }
+  Timer Expand(const CompactTimer& a_Timer) const {
+    return m_Tables->Expand(a_Timer);
+  }
+  TickType GetEnd(const CompactTimer& a_Timer) const {
+    return m_Tables->GetEnd(a_Timer);
+  }
+  const TimerTables& GetTables() const { return *m_Tables; }
+
+  // Calls a_Visitor(timer, mergedEnd) for the timers overlapping
+  // [a_Min, a_Max], in order. Timers shorter than a_Resolution ticks are
+  // merged with the timers starting in the same column of a_Resolution ticks
+  // from a_Min: a_Visitor is only called for the first of them, with the end
+  // of the last as mergedEnd. Otherwise mergedEnd is the end of the timer.
+  // Whole blocks of merged timers are skipped at once, so that a zoomed out
+  // range costs about as much as its number of columns.
+  template <class Visitor>
+  void ForEachInRange(TickType a_Min, TickType a_Max, TickType a_Resolution,
+                      Visitor&& a_Visitor) {
+    ScopeLock lock(m_IndexMutex);
+    TimerBlock* block = GetFirstBlockEndingAfter(a_Min);
+    uint32_t index = 0;
+    while (block != nullptr) {
+      uint32_t size = block->GetSize();
+      if (index >= size) {
+        if (size < kBlockSize) break;
+        block = block->GetNext();
+        index = 0;
+        continue;
+      }
+
+      const CompactTimer& timer = block->m_Data[index++];
+      if (timer.m_Start > a_Max) break;
+      TickType end = GetEnd(timer);
+      if (end < a_Min) continue;
+
+      TickType mergedEnd = end;
+      if (end - timer.m_Start < a_Resolution) {
+        TickType column =
+            timer.m_Start > a_Min ? (timer.m_Start - a_Min) / a_Resolution : 0;
+        SkipStartingBefore(a_Min + (column + 1) * a_Resolution, &block, &index,
+                           &mergedEnd);
+      }
+      a_Visitor(timer, mergedEnd);
+    }
+  }
+
+  // First timer overlapping [a_Min, a_Max], nullptr if there is none.
+  const CompactTimer* FindFirstInRange(TickType a_Min, TickType a_Max);
+  // First timer starting after a_Tick, nullptr if there is none.
+  const CompactTimer* FindFirstStartingAfter(TickType a_Tick);
+  // Last timer starting at or before a_Tick, nullptr if there is none.
+  const CompactTimer* FindLastStartingBefore(TickType a_Tick);
+
+ protected:
+  struct IndexedBlock {
+    TimerBlock* m_Block;
+    // Start of the first timer of this block, the earliest of the block.
+    TickType m_MinStart;
+    // Latest end of the timers of this block and of all the blocks before.
+    TickType m_MaxEnd;
+  };
+
+  // Indexes the blocks that got full since the previous call and returns the
+  // first block not indexed. Needs m_IndexMutex locked.
+  TimerBlock* UpdateIndex();
+  // First block with timers ending at or after a_Tick, or the first block not
+  // indexed. Needs m_IndexMutex locked.
+  TimerBlock* GetFirstBlockEndingAfter(TickType a_Tick);
+  // Last indexed block with timers starting at or before a_Tick, or the first
+  // block if there is none. The timers starting after a_Tick are in it or in
+  // the blocks after it. Needs m_IndexMutex locked.
+  TimerBlock* GetLastBlockStartingBefore(TickType a_Tick);
+  // Moves the timer at io_Index of io_Block to the first timer starting at or
+  // after a_Tick, raising io_End to the end of the timers skipped.
+  void SkipStartingBefore(TickType a_Tick, TimerBlock** io_Block,
+                          uint32_t* io_Index, TickType* io_End) const;
+
+  std::shared_ptr<TimerTables> m_Tables;
+  // Only taken by the readers.
+  Mutex m_IndexMutex;
+  std::vector<IndexedBlock> m_Index;
+};
@@ -0,0 +1,288 @@
+#include "TimerDiffDataView.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "App.h"
+#include "Core.h"
+
+//-----------------------------------------------------------------------------
+TimerDiffDataView::TimerDiffDataView() {
+  m_SortingToggles.resize(DiffColumn::NumColumns, false);
+  m_UpdatePeriodMs = 1000;
+}
+
+//-----------------------------------------------------------------------------
+std::vector<int> TimerDiffDataView::s_HeaderMap;
+std::vector<float> TimerDiffDataView::s_HeaderRatios;
+
+//-----------------------------------------------------------------------------
+const std::vector<std::wstring>& TimerDiffDataView::GetColumnHeaders() {
+  static std::vector<std::wstring> Columns;
+
+  if (s_HeaderMap.size() == 0) {
+    Columns.push_back(L"Name");
+    s_HeaderMap.push_back(DiffColumn::FunctionName);
+    s_HeaderRatios.push_back(0.4f);
+    Columns.push_back(L"Baseline Count");
+    s_HeaderMap.push_back(DiffColumn::BaselineCount);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"Count");
+    s_HeaderMap.push_back(DiffColumn::Count);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"Baseline Avg");
+    s_HeaderMap.push_back(DiffColumn::BaselineAverage);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"Avg");
+    s_HeaderMap.push_back(DiffColumn::Average);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"Median Delta");
+    s_HeaderMap.push_back(DiffColumn::MedianDelta);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"P95 Delta");
+    s_HeaderMap.push_back(DiffColumn::P95Delta);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"Shift");
+    s_HeaderMap.push_back(DiffColumn::Shift);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"p-value");
+    s_HeaderMap.push_back(DiffColumn::PValue);
+    s_HeaderRatios.push_back(0);
+    Columns.push_back(L"Change");
+    s_HeaderMap.push_back(DiffColumn::Change);
+    s_HeaderRatios.push_back(0);
+  }
+
+  return Columns;
+}
+
+//-----------------------------------------------------------------------------
+const std::vector<float>& TimerDiffDataView::GetColumnHeadersRatios() {
+  return s_HeaderRatios;
+}
+
+//-----------------------------------------------------------------------------
+std::wstring TimerDiffDataView::GetValue(int a_Row, int a_Column) {
+  const DiffRow& row = GetRow(a_Row);
+
+  std::wstring value;
+
+  switch (s_HeaderMap[a_Column]) {
+    case DiffColumn::FunctionName:
+      value = row.m_Name;
+      break;
+    case DiffColumn::BaselineCount:
+      value = Format(L"%llu", row.m_BaselineCount);
+      break;
+    case DiffColumn::Count:
+      value = Format(L"%llu", row.m_Count);
+      break;
+    case DiffColumn::BaselineAverage:
+      value = s2ws(GetPrettyTime(row.m_BaselineAverageMs));
+      break;
+    case DiffColumn::Average:
+      value = s2ws(GetPrettyTime(row.m_AverageMs));
+      break;
+    case DiffColumn::MedianDelta:
+      value = Format(L"%+.3f ms", row.m_MedianDeltaMs);
+      break;
+    case DiffColumn::P95Delta:
+      value = Format(L"%+.3f ms", row.m_P95DeltaMs);
+      break;
+    case DiffColumn::Shift:
+      value = Format(L"%+.2f", row.m_Shift);
+      break;
+    case DiffColumn::PValue:
+      value = Format(L"%.2g", row.m_PValue);
+      break;
+    case DiffColumn::Change:
+      value = row.m_Change > 0   ? L"slower"
+              : row.m_Change < 0 ? L"faster"
+                                 : L"";
+      break;
+    default:
+      break;
+  }
+
+  return value;
+}
+
+//-----------------------------------------------------------------------------
+#define ORBIT_PROC_SORT(Member)                                            \
+  [&](int a, int b) {                                                      \
+    return OrbitUtils::Compare(rows[a].Member, rows[b].Member, ascending); \
+  }
+
+//-----------------------------------------------------------------------------
+void TimerDiffDataView::OnSort(int a_Column, bool a_Toggle) {
+  std::vector<DiffRow>& rows = m_Rows;
+  DiffColumn column = DiffColumn(s_HeaderMap[a_Column]);
+
+  if (a_Toggle) {
+    m_SortingToggles[column] = !m_SortingToggles[column];
+  }
+
+  bool ascending = m_SortingToggles[column];
+  std::function<bool(int a, int b)> sorter = nullptr;
+
+  switch (column) {
+    case DiffColumn::FunctionName:
+      sorter = ORBIT_PROC_SORT(m_Name);
+      break;
+    case DiffColumn::BaselineCount:
+      sorter = ORBIT_PROC_SORT(m_BaselineCount);
+      break;
+    case DiffColumn::Count:
+      sorter = ORBIT_PROC_SORT(m_Count);
+      break;
+    case DiffColumn::BaselineAverage:
+      sorter = ORBIT_PROC_SORT(m_BaselineAverageMs);
+      break;
+    case DiffColumn::Average:
+      sorter = ORBIT_PROC_SORT(m_AverageMs);
+      break;
+    case DiffColumn::MedianDelta:
+      sorter = ORBIT_PROC_SORT(m_MedianDeltaMs);
+      break;
+    case DiffColumn::P95Delta:
+      sorter = ORBIT_PROC_SORT(m_P95DeltaMs);
+      break;
+    case DiffColumn::Shift:
+      sorter = ORBIT_PROC_SORT(m_Shift);
+      break;
+    case DiffColumn::PValue:
+      sorter = ORBIT_PROC_SORT(m_PValue);
+      break;
+    case DiffColumn::Change:
+      sorter = ORBIT_PROC_SORT(m_Change);
+      break;
+    default:
+      break;
+  }
+
+  if (sorter) {
+    std::sort(m_Indices.begin(), m_Indices.end(), sorter);
+  }
+
+  m_LastSortedColumn = a_Column;
+}
+
+//-----------------------------------------------------------------------------
+const std::wstring TIMER_DIFF_LOAD_BASELINE = L"Load Baseline Capture";
+const std::wstring TIMER_DIFF_SET_BASELINE =
+    L"Set Current Capture as Baseline";
+const std::wstring TIMER_DIFF_GO_TO_DISASSEMBLY = L"Go To Disassembly";
+
+//-----------------------------------------------------------------------------
+std::vector<std::wstring> TimerDiffDataView::GetContextMenu(int a_Index) {
+  std::vector<std::wstring> menu = {TIMER_DIFF_LOAD_BASELINE,
+                                    TIMER_DIFF_SET_BASELINE,
+                                    TIMER_DIFF_GO_TO_DISASSEMBLY};
+  Append(menu, DataView::GetContextMenu(a_Index));
+  return menu;
+}
+
+//-----------------------------------------------------------------------------
+void TimerDiffDataView::OnContextMenu(const std::wstring& a_Action,
+                                      int a_MenuIndex,
+                                      std::vector<int>& a_ItemIndices) {
+  if (a_Action == TIMER_DIFF_LOAD_BASELINE) {
+    std::wstring fileName =
+        GOrbitApp->FindFile(L"Load Baseline Capture", L"", L"*.orbit");
+    if (!fileName.empty() &&
+        GOrbitApp->LoadTimerDiffBaseline(ws2s(fileName))) {
+      UpdateRows();
+    }
+  } else if (a_Action == TIMER_DIFF_SET_BASELINE) {
+    GOrbitApp->SetTimerDiffBaseline(
+        std::make_shared<const std::vector<FunctionTimings>>(
+            OrbitApp::GetFunctionTimings()));
+    UpdateRows();
+  } else if (a_Action == TIMER_DIFF_GO_TO_DISASSEMBLY) {
+    for (int index : a_ItemIndices) {
+      const DiffRow& row = GetRow(index);
+      if (row.m_Address != 0) {
+        GOrbitApp->GetDisassembly(row.m_Address, 200, 400);
+      }
+    }
+  } else {
+    DataView::OnContextMenu(a_Action, a_MenuIndex, a_ItemIndices);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void TimerDiffDataView::OnTimer() {
+  // The stats of the current capture change as its timers come in. The diff
+  // only costs a pass over the histograms of the functions.
+  UpdateRows();
+}
+
+//-----------------------------------------------------------------------------
+void TimerDiffDataView::UpdateRows() {
+  m_Rows.clear();
+  std::shared_ptr<const std::vector<FunctionTimings>> baseline =
+      GOrbitApp->GetTimerDiffBaseline();
+  if (baseline != nullptr) {
+    std::vector<FunctionTimings> comparison = OrbitApp::GetFunctionTimings();
+    for (const TimingDiff& diff : DiffFunctionTimings(*baseline, comparison)) {
+      DiffRow row;
+      row.m_Name = s2ws(diff.name);
+      row.m_Address = diff.comparison_address != 0 ? diff.comparison_address
+                                                   : diff.baseline_address;
+      row.m_BaselineCount = diff.baseline.m_Count;
+      row.m_Count = diff.comparison.m_Count;
+      row.m_BaselineAverageMs = diff.baseline.m_AverageTimeMs;
+      row.m_AverageMs = diff.comparison.m_AverageTimeMs;
+      row.m_MedianDeltaMs = diff.comparison.GetPercentileMs(0.5) -
+                            diff.baseline.GetPercentileMs(0.5);
+      row.m_P95DeltaMs = diff.comparison.GetPercentileMs(0.95) -
+                         diff.baseline.GetPercentileMs(0.95);
+      row.m_Shift = diff.shift;
+      row.m_PValue = diff.p_value;
+      if (diff.p_value < kSignificanceLevel) {
+        row.m_Change = diff.shift > 0 ? 1 : -1;
+      }
+      m_Rows.push_back(std::move(row));
+    }
+  }
+
+  OnFilter(m_Filter);
+}
+
+//-----------------------------------------------------------------------------
+void TimerDiffDataView::OnFilter(const std::wstring& a_Filter) {
+  std::vector<uint32_t> indices;
+
+  std::vector<std::wstring> tokens = Tokenize(ToLower(a_Filter));
+
+  for (uint32_t i = 0; i < m_Rows.size(); ++i) {
+    std::wstring name = ToLower(m_Rows[i].m_Name);
+
+    bool match = true;
+
+    for (std::wstring& filterToken : tokens) {
+      if (name.find(filterToken) == std::wstring::npos) {
+        match = false;
+        break;
+      }
+    }
+
+    if (match) {
+      indices.push_back(i);
+    }
+  }
+
+  m_Indices = indices;
+
+  if (m_LastSortedColumn != -1) {
+    OnSort(m_LastSortedColumn, false);
+  } else {
+    // Most significant shifts first, until sorted otherwise.
+    std::sort(m_Indices.begin(), m_Indices.end(), [this](int a, int b) {
+      if (m_Rows[a].m_PValue != m_Rows[b].m_PValue) {
+        return m_Rows[a].m_PValue < m_Rows[b].m_PValue;
+      }
+      return std::abs(m_Rows[a].m_Shift) > std::abs(m_Rows[b].m_Shift);
+    });
+  }
+}
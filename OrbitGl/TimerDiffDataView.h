@@ -0,0 +1,71 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DataView.h"
+#include "TimerDiff.h"
+
+// Differences between the durations of the instrumented functions of the
+// timer diff baseline, e.g. a capture of another build, and those of the
+// current capture. Compares the distributions of the durations rather than
+// their averages, from the stats of the functions only.
+class TimerDiffDataView : public DataView {
+ public:
+  TimerDiffDataView();
+
+  const std::vector<std::wstring>& GetColumnHeaders() override;
+  const std::vector<float>& GetColumnHeadersRatios() override;
+  std::vector<std::wstring> GetContextMenu(int a_Index) override;
+  std::wstring GetValue(int a_Row, int a_Column) override;
+
+  void OnFilter(const std::wstring& a_Filter) override;
+  void OnSort(int a_Column, bool a_Toggle = true) override;
+  void OnContextMenu(const std::wstring& a_Action, int a_MenuIndex,
+                     std::vector<int>& a_ItemIndices) override;
+  void OnTimer() override;
+
+  enum DiffColumn {
+    FunctionName,
+    BaselineCount,
+    Count,
+    BaselineAverage,
+    Average,
+    MedianDelta,
+    P95Delta,
+    Shift,
+    PValue,
+    Change,
+    NumColumns
+  };
+
+  // Below which the shift of a function is flagged.
+  static constexpr double kSignificanceLevel = 0.01;
+
+ protected:
+  struct DiffRow {
+    std::wstring m_Name;
+    uint64_t m_Address = 0;
+    uint64_t m_BaselineCount = 0;
+    uint64_t m_Count = 0;
+    double m_BaselineAverageMs = 0;
+    double m_AverageMs = 0;
+    double m_MedianDeltaMs = 0;
+    double m_P95DeltaMs = 0;
+    double m_Shift = 0;
+    double m_PValue = 1.0;
+    // 1 if significantly slower, -1 if significantly faster, 0 otherwise.
+    int m_Change = 0;
+  };
+
+  void UpdateRows();
+  const DiffRow& GetRow(unsigned int a_Row) const {
+    return m_Rows[m_Indices[a_Row]];
+  }
+
+  std::vector<DiffRow> m_Rows;
+
+  static std::vector<int> s_HeaderMap;
+  static std::vector<float> s_HeaderRatios;
+};
@@ -0,0 +1,237 @@
+#include "TimerInstanceRenderer.h"
+
+#include <cstddef>
+
+#include "GlUtils.h"
+#include "OrbitBase/Logging.h"
+#include "VertexBuffer.h"
+
+namespace {
+// a_Start, a_End and a_Color.
+constexpr GLuint kNumAttributes = 3;
+
+//-----------------------------------------------------------------------------
+// Corners are given by gl_VertexID, as a triangle strip. Boxes narrower than
+// u_MinWidth are moved out of the clip volume.
+const char* kVertexShader = R"(
+#version 330
+uniform mat4 u_Transform;
+uniform float u_BaseX;
+uniform float u_WorldPerTick;
+uniform float u_MinWidth;
+uniform float u_Y;
+uniform float u_Height;
+uniform float u_Z;
+layout(location = 0) in float a_Start;
+layout(location = 1) in float a_End;
+layout(location = 2) in vec4 a_Color;
+out vec4 v_Color;
+void main() {
+  float width = (a_End - a_Start) * u_WorldPerTick;
+  v_Color = a_Color;
+  if (width <= u_MinWidth) {
+    gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+    return;
+  }
+  vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+  float x = u_BaseX + a_Start * u_WorldPerTick + corner.x * width;
+  gl_Position = u_Transform * vec4(x, u_Y + corner.y * u_Height, u_Z, 1.0);
+  // Darker on the left, as the boxes of the batcher.
+  if (corner.x == 0.0) {
+    v_Color.rgb *= 0.94;
+  }
+}
+)";
+
+const char* kFragmentShader = R"(
+#version 330
+in vec4 v_Color;
+out vec4 o_Color;
+void main() { o_Color = v_Color; }
+)";
+
+//-----------------------------------------------------------------------------
+// Projection times model view, for the shader to transform as the fixed
+// function pipeline does.
+void GetTransform(GLfloat o_Transform[16]) {
+  GLfloat projection[16];
+  GLfloat modelView[16];
+  glGetFloatv(GL_PROJECTION_MATRIX, projection);
+  glGetFloatv(GL_MODELVIEW_MATRIX, modelView);
+  for (int column = 0; column < 4; ++column) {
+    for (int row = 0; row < 4; ++row) {
+      GLfloat sum = 0;
+      for (int i = 0; i < 4; ++i) {
+        sum += projection[i * 4 + row] * modelView[column * 4 + i];
+      }
+      o_Transform[column * 4 + row] = sum;
+    }
+  }
+}
+}  // namespace
+
+//-----------------------------------------------------------------------------
+TimerInstanceRenderer::~TimerInstanceRenderer() {
+  Clear();
+  DeleteBuffers();
+  if (m_Program != 0) {
+    glDeleteProgram(m_Program);
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool TimerInstanceRenderer::Init() {
+  if (m_Initialized) return m_Supported;
+  m_Initialized = true;
+  if (!GLEW_VERSION_3_3) {
+    LOG("OpenGL 3.3 is not available, timers are not drawn as instances");
+    return false;
+  }
+
+  m_Program = CreateGlProgram(kVertexShader, kFragmentShader);
+  if (m_Program == 0) return false;
+
+  m_TransformLocation = glGetUniformLocation(m_Program, "u_Transform");
+  m_BaseXLocation = glGetUniformLocation(m_Program, "u_BaseX");
+  m_WorldPerTickLocation = glGetUniformLocation(m_Program, "u_WorldPerTick");
+  m_MinWidthLocation = glGetUniformLocation(m_Program, "u_MinWidth");
+  m_YLocation = glGetUniformLocation(m_Program, "u_Y");
+  m_HeightLocation = glGetUniformLocation(m_Program, "u_Height");
+  m_ZLocation = glGetUniformLocation(m_Program, "u_Z");
+  m_Supported = true;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void TimerInstanceRenderer::Upload(const std::shared_ptr<TimerChain>& a_Chain,
+                                   const ColorFunction& a_GetColor) {
+  DeleteBuffers();
+
+  ChainInstances& instances = m_Chains[a_Chain.get()];
+  instances.m_Chain = a_Chain;
+  const TimerChain::TimerBlock* block = instances.m_LastBlock;
+  uint32_t index =
+      block != nullptr ? instances.m_Blocks.back().m_NumInstances : 0;
+  if (block == nullptr) {
+    block = a_Chain->m_Root;
+  }
+
+  while (block != nullptr) {
+    uint32_t size = block->m_Size;
+    if (index == size) {
+      // Items are only added to the next block once this one is full.
+      if (size < TimerChain::kBlockSize) break;
+      block = block->m_Next;
+      index = 0;
+      continue;
+    }
+
+    if (block != instances.m_LastBlock) {
+      BlockInstances blockInstances;
+      blockInstances.m_Base = block->m_Data[0].m_Start;
+      glGenBuffers(1, &blockInstances.m_Buffer);
+      glBindBuffer(GL_ARRAY_BUFFER, blockInstances.m_Buffer);
+      glBufferData(GL_ARRAY_BUFFER, TimerChain::kBlockSize * sizeof(Instance),
+                   nullptr, GL_DYNAMIC_DRAW);
+      instances.m_Blocks.push_back(blockInstances);
+      instances.m_LastBlock = block;
+    }
+    BlockInstances& blockInstances = instances.m_Blocks.back();
+
+    m_Staging.clear();
+    for (uint32_t i = index; i < size; ++i) {
+      const CompactTimer& timer = block->m_Data[i];
+      TickType end = a_Chain->GetEnd(timer);
+      Instance instance;
+      if (timer.IsType(Timer::CORE_ACTIVITY)) {
+        // Placed by core and not by depth, left to the batcher.
+        instance.m_Start = instance.m_End = 0.f;
+      } else {
+        instance.m_Start = float(timer.m_Start - blockInstances.m_Base);
+        instance.m_End = float(end - blockInstances.m_Base);
+      }
+      instance.m_Color = a_GetColor(a_Chain->Expand(timer));
+      m_Staging.push_back(instance);
+      blockInstances.m_MaxEnd = std::max(blockInstances.m_MaxEnd, end);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, blockInstances.m_Buffer);
+    glBufferSubData(GL_ARRAY_BUFFER, index * sizeof(Instance),
+                    m_Staging.size() * sizeof(Instance), m_Staging.data());
+    VertexBuffer::CountUpload(m_Staging.size() * sizeof(Instance));
+    blockInstances.m_NumInstances = size;
+    index = size;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+//-----------------------------------------------------------------------------
+void TimerInstanceRenderer::BeginDraw(float a_MinWidth, float a_Z) {
+  GLfloat transform[16];
+  GetTransform(transform);
+  glUseProgram(m_Program);
+  glUniformMatrix4fv(m_TransformLocation, 1, GL_FALSE, transform);
+  glUniform1f(m_MinWidthLocation, a_MinWidth);
+  glUniform1f(m_ZLocation, a_Z);
+  for (GLuint attribute = 0; attribute < kNumAttributes; ++attribute) {
+    glEnableVertexAttribArray(attribute);
+    glVertexAttribDivisor(attribute, 1);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void TimerInstanceRenderer::Draw(
+    const TimerChain* a_Chain, TickType a_MinTick, TickType a_MaxTick,
+    const std::function<float(TickType)>& a_WorldFromTick,
+    double a_WorldPerTick, float a_Y, float a_Height) {
+  auto it = m_Chains.find(a_Chain);
+  if (it == m_Chains.end()) return;
+
+  glUniform1f(m_WorldPerTickLocation, float(a_WorldPerTick));
+  glUniform1f(m_YLocation, a_Y);
+  glUniform1f(m_HeightLocation, a_Height);
+  for (const BlockInstances& block : it->second.m_Blocks) {
+    // Blocks are in the order of their starts.
+    if (block.m_Base > a_MaxTick) break;
+    if (block.m_MaxEnd < a_MinTick) continue;
+
+    glUniform1f(m_BaseXLocation, a_WorldFromTick(block.m_Base));
+    glBindBuffer(GL_ARRAY_BUFFER, block.m_Buffer);
+    GLsizei stride = sizeof(Instance);
+    glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, stride,
+                          (void*)offsetof(Instance, m_Start));
+    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, stride,
+                          (void*)offsetof(Instance, m_End));
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                          (void*)offsetof(Instance, m_Color));
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, block.m_NumInstances);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void TimerInstanceRenderer::EndDraw() {
+  for (GLuint attribute = 0; attribute < kNumAttributes; ++attribute) {
+    glVertexAttribDivisor(attribute, 0);
+    glDisableVertexAttribArray(attribute);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glUseProgram(0);
+}
+
+//-----------------------------------------------------------------------------
+void TimerInstanceRenderer::Clear() {
+  for (auto& pair : m_Chains) {
+    for (const BlockInstances& block : pair.second.m_Blocks) {
+      m_BuffersToDelete.push_back(block.m_Buffer);
+    }
+  }
+  m_Chains.clear();
+}
+
+//-----------------------------------------------------------------------------
+void TimerInstanceRenderer::DeleteBuffers() {
+  if (!m_BuffersToDelete.empty()) {
+    glDeleteBuffers(GLsizei(m_BuffersToDelete.size()),
+                    m_BuffersToDelete.data());
+    m_BuffersToDelete.clear();
+  }
+}
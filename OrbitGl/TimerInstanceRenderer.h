@@ -0,0 +1,88 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "CoreMath.h"
+#include "OpenGl.h"
+#include "TimerChain.h"
+
+//-----------------------------------------------------------------------------
+// Draws the timers of thread tracks as instances of a single box, from a
+// compact copy of the timers kept on the GPU: start and end relative to the
+// first timer of their block, and color. Timers are appended
+// to that copy as they arrive and never sent again, and the vertex shader
+// places them in the current view, so panning and zooming don't tessellate
+// anything on the CPU. Needs OpenGL 3.3.
+class TimerInstanceRenderer {
+ public:
+  using ColorFunction = std::function<Color(const Timer&)>;
+
+  TimerInstanceRenderer() = default;
+  ~TimerInstanceRenderer();
+
+  TimerInstanceRenderer(const TimerInstanceRenderer&) = delete;
+  TimerInstanceRenderer& operator=(const TimerInstanceRenderer&) = delete;
+
+  // Compiles the shaders on the first call. Returns whether the current GL
+  // context can draw instances.
+  bool Init();
+
+  // Sends the timers added to a_Chain since the previous call, colored by
+  // a_GetColor.
+  void Upload(const std::shared_ptr<TimerChain>& a_Chain,
+              const ColorFunction& a_GetColor);
+
+  // Draws are done between BeginDraw and EndDraw. Boxes narrower than
+  // a_MinWidth are not drawn, as they are drawn as lines by the batcher.
+  void BeginDraw(float a_MinWidth, float a_Z);
+  // Draws the uploaded timers of a_Chain overlapping [a_MinTick, a_MaxTick],
+  // at a_Y and a_Height high, a tick being a_WorldPerTick wide.
+  void Draw(const TimerChain* a_Chain, TickType a_MinTick, TickType a_MaxTick,
+            const std::function<float(TickType)>& a_WorldFromTick,
+            double a_WorldPerTick, float a_Y, float a_Height);
+  void EndDraw();
+
+  // Forgets all the timers. Their GL buffers are deleted on the next upload,
+  // when the context is current.
+  void Clear();
+
+ protected:
+  struct Instance {
+    // In ticks from the start of the first timer of the block.
+    float m_Start;
+    float m_End;
+    Color m_Color;
+  };
+  struct BlockInstances {
+    GLuint m_Buffer = 0;
+    uint32_t m_NumInstances = 0;
+    TickType m_Base = 0;
+    TickType m_MaxEnd = 0;
+  };
+  struct ChainInstances {
+    std::shared_ptr<TimerChain> m_Chain;
+    // One per block of the chain, up to m_LastBlock.
+    std::vector<BlockInstances> m_Blocks;
+    const TimerChain::TimerBlock* m_LastBlock = nullptr;
+  };
+
+  void DeleteBuffers();
+
+  bool m_Initialized = false;
+  bool m_Supported = false;
+  GLuint m_Program = 0;
+  GLint m_TransformLocation = -1;
+  GLint m_BaseXLocation = -1;
+  GLint m_WorldPerTickLocation = -1;
+  GLint m_MinWidthLocation = -1;
+  GLint m_YLocation = -1;
+  GLint m_HeightLocation = -1;
+  GLint m_ZLocation = -1;
+
+  std::map<const TimerChain*, ChainInstances> m_Chains;
+  std::vector<Instance> m_Staging;
+  std::vector<GLuint> m_BuffersToDelete;
+};
@@ -33,6 +33,9 @@ void TypesDataView::OnDataChanged() {
   }
 }
 
+//-----------------------------------------------------------------------------
+void TypesDataView::OnShown() { GOrbitApp->LoadTypesAndGlobals(); }
+
 //-----------------------------------------------------------------------------
 std::vector<int> TypesDataView::s_HeaderMap;
 std::vector<float> TypesDataView::s_HeaderRatios;
@@ -23,6 +23,7 @@ class TypesDataView : public DataView {
   void OnContextMenu(const std::wstring& a_Action, int a_MenuIndex,
                      std::vector<int>& a_ItemIndices) override;
   void OnDataChanged() override;
+  void OnShown() override;
 
  protected:
   Type& GetType(unsigned int a_Row) const;
@@ -0,0 +1,26 @@
+#include "VertexBuffer.h"
+
+#include <algorithm>
+
+uint64_t VertexBuffer::s_NumBytesUploaded = 0;
+
+//-----------------------------------------------------------------------------
+VertexBuffer::~VertexBuffer() {
+  if (m_Id != 0) {
+    glDeleteBuffers(1, &m_Id);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void VertexBuffer::Reserve(size_t a_Size) {
+  if (m_Id == 0) {
+    glGenBuffers(1, &m_Id);
+  }
+  Bind();
+  if (a_Size > m_Capacity) {
+    // Grown geometrically, so that growing captures don't reallocate on each
+    // upload.
+    m_Capacity = std::max(a_Size, 2 * m_Capacity);
+    glBufferData(GL_ARRAY_BUFFER, m_Capacity, nullptr, GL_DYNAMIC_DRAW);
+  }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "BlockChain.h"
+#include "OpenGl.h"
+
+//-----------------------------------------------------------------------------
+// Copy of the contents of a BlockChain or vector in a GL buffer object, to
+// draw with glVertexPointer/glColorPointer offsets instead of client memory.
+// The items are only sent to the GPU when they are uploaded, not on each draw.
+class VertexBuffer {
+ public:
+  VertexBuffer() = default;
+  ~VertexBuffer();
+
+  VertexBuffer(const VertexBuffer&) = delete;
+  VertexBuffer& operator=(const VertexBuffer&) = delete;
+
+  // Replaces the contents of the buffer by the items of a_Chain, in order.
+  // Needs a current GL context.
+  template <class T, uint32_t BlockSize>
+  void Upload(const BlockChain<T, BlockSize>& a_Chain);
+  template <class T>
+  void Upload(const std::vector<T>& a_Items);
+
+  // Binds the buffer to GL_ARRAY_BUFFER, for the pointers set next to be
+  // offsets into it.
+  void Bind() const { glBindBuffer(GL_ARRAY_BUFFER, m_Id); }
+  static void Unbind() { glBindBuffer(GL_ARRAY_BUFFER, 0); }
+
+  // Bytes sent to the GPU by all uploads so far, for the render stats. Other
+  // uploads to buffer objects add theirs with CountUpload.
+  static uint64_t GetNumBytesUploaded() { return s_NumBytesUploaded; }
+  static void CountUpload(size_t a_Size) { s_NumBytesUploaded += a_Size; }
+
+ private:
+  // Binds the buffer, with room for at least a_Size bytes.
+  void Reserve(size_t a_Size);
+
+  GLuint m_Id = 0;
+  size_t m_Capacity = 0;
+  static uint64_t s_NumBytesUploaded;
+};
+
+//-----------------------------------------------------------------------------
+template <class T, uint32_t BlockSize>
+void VertexBuffer::Upload(const BlockChain<T, BlockSize>& a_Chain) {
+  Reserve(a_Chain.size() * sizeof(T));
+  // Only the last block with items is partially filled, so the items of the
+  // blocks follow each other in the buffer.
+  size_t offset = 0;
+  for (const Block<T, BlockSize>* block = a_Chain.m_Root;
+       block != nullptr && block->m_Size > 0; block = block->m_Next) {
+    size_t size = block->m_Size * sizeof(T);
+    glBufferSubData(GL_ARRAY_BUFFER, offset, size, block->m_Data);
+    offset += size;
+  }
+  CountUpload(offset);
+  Unbind();
+}
+
+//-----------------------------------------------------------------------------
+template <class T>
+void VertexBuffer::Upload(const std::vector<T>& a_Items) {
+  size_t size = a_Items.size() * sizeof(T);
+  Reserve(size);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, size, a_Items.data());
+  CountUpload(size);
+  Unbind();
+}
@@ -0,0 +1,122 @@
+#include "BatchingTracerListener.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "Utils.h"
+
+namespace LinuxTracing {
+
+void BatchingTracerListener::OnContextSwitchIn(
+    const ContextSwitchIn& context_switch_in) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  batches_.context_switches_in.push_back(context_switch_in);
+}
+
+void BatchingTracerListener::OnContextSwitchOut(
+    const ContextSwitchOut& context_switch_out) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  batches_.context_switches_out.push_back(context_switch_out);
+}
+
+void BatchingTracerListener::OnCallstack(const Callstack& callstack) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  batches_.callstacks.push_back(callstack);
+}
+
+void BatchingTracerListener::OnFunctionCall(const FunctionCall& function_call) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  batches_.function_calls.push_back(function_call);
+}
+
+void BatchingTracerListener::OnThreadStateChange(
+    const ThreadStateChange& thread_state_change) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  batches_.thread_state_changes.push_back(thread_state_change);
+}
+
+void BatchingTracerListener::OnFileIo(const FileIo& file_io) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  batches_.file_ios.push_back(file_io);
+}
+
+void BatchingTracerListener::Flush() {
+  std::lock_guard<std::mutex> flush_lock{flush_mutex_};
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    std::swap(batches_, flushed_batches_);
+  }
+
+  uint64_t now_ns = MonotonicTimestampNs();
+  AddLatencies(flushed_batches_.context_switches_in, now_ns,
+               [](const ContextSwitchIn& event) {
+                 return event.GetTimestampNs();
+               });
+  AddLatencies(flushed_batches_.context_switches_out, now_ns,
+               [](const ContextSwitchOut& event) {
+                 return event.GetTimestampNs();
+               });
+  AddLatencies(
+      flushed_batches_.callstacks, now_ns,
+      [](const Callstack& event) { return event.GetTimestampNs(); });
+  AddLatencies(flushed_batches_.function_calls, now_ns,
+               [](const FunctionCall& event) {
+                 return event.GetEndTimestampNs();
+               });
+  AddLatencies(flushed_batches_.thread_state_changes, now_ns,
+               [](const ThreadStateChange& event) {
+                 return event.GetTimestampNs();
+               });
+  AddLatencies(
+      flushed_batches_.file_ios, now_ns,
+      [](const FileIo& event) { return event.GetEndTimestampNs(); });
+
+  // Call the listener outside of mutex_, so that events can keep being
+  // buffered in the meantime.
+  if (!flushed_batches_.context_switches_in.empty()) {
+    listener_->OnContextSwitchesIn(flushed_batches_.context_switches_in);
+    flushed_batches_.context_switches_in.clear();
+  }
+  if (!flushed_batches_.context_switches_out.empty()) {
+    listener_->OnContextSwitchesOut(flushed_batches_.context_switches_out);
+    flushed_batches_.context_switches_out.clear();
+  }
+  if (!flushed_batches_.callstacks.empty()) {
+    listener_->OnCallstacks(flushed_batches_.callstacks);
+    flushed_batches_.callstacks.clear();
+  }
+  if (!flushed_batches_.function_calls.empty()) {
+    listener_->OnFunctionCalls(flushed_batches_.function_calls);
+    flushed_batches_.function_calls.clear();
+  }
+  if (!flushed_batches_.thread_state_changes.empty()) {
+    listener_->OnThreadStateChanges(flushed_batches_.thread_state_changes);
+    flushed_batches_.thread_state_changes.clear();
+  }
+  if (!flushed_batches_.file_ios.empty()) {
+    listener_->OnFileIos(flushed_batches_.file_ios);
+    flushed_batches_.file_ios.clear();
+  }
+}
+
+template <typename Event, typename GetTimestampNs>
+void BatchingTracerListener::AddLatencies(const std::vector<Event>& events,
+                                          uint64_t now_ns,
+                                          GetTimestampNs get_timestamp_ns) {
+  for (const Event& event : events) {
+    uint64_t timestamp_ns = get_timestamp_ns(event);
+    uint64_t latency_ns = now_ns > timestamp_ns ? now_ns - timestamp_ns : 0;
+    latency_stats_.total_latency_ns += latency_ns;
+    latency_stats_.max_latency_ns =
+        std::max(latency_stats_.max_latency_ns, latency_ns);
+  }
+  latency_stats_.event_count += events.size();
+}
+
+BatchingTracerListener::LatencyStats
+BatchingTracerListener::TakeLatencyStats() {
+  std::lock_guard<std::mutex> flush_lock{flush_mutex_};
+  return std::exchange(latency_stats_, LatencyStats{});
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,111 @@
+#ifndef ORBIT_LINUX_TRACING_BATCHING_TRACER_LISTENER_H_
+#define ORBIT_LINUX_TRACING_BATCHING_TRACER_LISTENER_H_
+
+#include <OrbitLinuxTracing/TracerListener.h>
+
+#include <mutex>
+#include <vector>
+
+namespace LinuxTracing {
+
+// Buffers the most frequent events reported to it, and forwards them to
+// listener in batches, one per type of event, when Flush is called. This way
+// listener receives a few calls to the batched callbacks of TracerListener per
+// pass over the events, instead of one virtual call (and whatever locking the
+// listener does) per event. The other events are forwarded immediately.
+// This class is thread-safe: events and Flush can come from any thread.
+class BatchingTracerListener : public TracerListener {
+ public:
+  explicit BatchingTracerListener(TracerListener* listener)
+      : listener_{listener} {}
+
+  void OnTid(pid_t tid) override { listener_->OnTid(tid); }
+  void OnContextSwitchIn(const ContextSwitchIn& context_switch_in) override;
+  void OnContextSwitchOut(const ContextSwitchOut& context_switch_out) override;
+  void OnCallstack(const Callstack& callstack) override;
+  void OnFunctionCall(const FunctionCall& function_call) override;
+  void OnGpuJob(const GpuJob& gpu_job) override {
+    listener_->OnGpuJob(gpu_job);
+  }
+  void OnThreadStateChange(
+      const ThreadStateChange& thread_state_change) override;
+  void OnTracerStats(const TracerStats& tracer_stats) override {
+    listener_->OnTracerStats(tracer_stats);
+  }
+  void OnProcessCpuTimes(const ProcessCpuTimes& process_cpu_times) override {
+    listener_->OnProcessCpuTimes(process_cpu_times);
+  }
+  void OnOffCpuCallstack(const OffCpuCallstack& off_cpu_callstack) override {
+    listener_->OnOffCpuCallstack(off_cpu_callstack);
+  }
+  void OnGpuSubmissionCallstack(const Callstack& callstack) override {
+    listener_->OnGpuSubmissionCallstack(callstack);
+  }
+  void OnThreadName(const ThreadName& thread_name) override {
+    listener_->OnThreadName(thread_name);
+  }
+  void OnFileIo(const FileIo& file_io) override;
+  void OnPageFault(const PageFault& page_fault) override {
+    listener_->OnPageFault(page_fault);
+  }
+  void OnHeapAllocation(const HeapAllocation& heap_allocation) override {
+    listener_->OnHeapAllocation(heap_allocation);
+  }
+  void OnHeapFree(const HeapFree& heap_free) override {
+    listener_->OnHeapFree(heap_free);
+  }
+  void OnLockWait(const LockWait& lock_wait) override {
+    listener_->OnLockWait(lock_wait);
+  }
+  void OnBranchCounts(const BranchCounts& branch_counts) override {
+    listener_->OnBranchCounts(branch_counts);
+  }
+  void OnCallstackCounts(
+      absl::Span<const CallstackCount> callstack_counts) override {
+    listener_->OnCallstackCounts(callstack_counts);
+  }
+
+  // Forwards all buffered events to listener. Batches of different types are
+  // not ordered with respect to each other, like the events reported by
+  // different threads of the tracer are not either.
+  void Flush();
+
+  // Of the events forwarded by Flush, the time from their timestamp to their
+  // forwarding, since the last call.
+  struct LatencyStats {
+    uint64_t event_count = 0;
+    uint64_t total_latency_ns = 0;
+    uint64_t max_latency_ns = 0;
+  };
+  LatencyStats TakeLatencyStats();
+
+ private:
+  template <typename Event, typename GetTimestampNs>
+  void AddLatencies(const std::vector<Event>& events, uint64_t now_ns,
+                    GetTimestampNs get_timestamp_ns);
+
+  TracerListener* listener_;
+
+  struct Batches {
+    std::vector<ContextSwitchIn> context_switches_in;
+    std::vector<ContextSwitchOut> context_switches_out;
+    std::vector<Callstack> callstacks;
+    std::vector<FunctionCall> function_calls;
+    std::vector<ThreadStateChange> thread_state_changes;
+    std::vector<FileIo> file_ios;
+  };
+
+  std::mutex mutex_;
+  Batches batches_;
+
+  // Only one Flush at a time, so that batches of the same type are forwarded
+  // in order. The batches being forwarded are swapped back into batches_ on
+  // the next Flush, which keeps the capacity of the vectors.
+  std::mutex flush_mutex_;
+  Batches flushed_batches_;
+  LatencyStats latency_stats_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_BATCHING_TRACER_LISTENER_H_
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "BatchingTracerListener.h"
+
+namespace LinuxTracing {
+
+namespace {
+// Records the sizes of the batches and the timestamps of the events, in the
+// order they are received.
+class RecordingListener : public TracerListener {
+ public:
+  void OnTid(pid_t tid) override { tids.push_back(tid); }
+  void OnContextSwitchIn(const ContextSwitchIn& context_switch_in) override {
+    timestamps.push_back(context_switch_in.GetTimestampNs());
+  }
+  void OnContextSwitchOut(
+      const ContextSwitchOut& /*context_switch_out*/) override {}
+  void OnCallstack(const Callstack& /*callstack*/) override {}
+  void OnFunctionCall(const FunctionCall& function_call) override {
+    timestamps.push_back(function_call.GetBeginTimestampNs());
+  }
+  void OnGpuJob(const GpuJob& /*gpu_job*/) override {}
+  void OnThreadStateChange(
+      const ThreadStateChange& /*thread_state_change*/) override {}
+
+  void OnContextSwitchesIn(
+      absl::Span<const ContextSwitchIn> context_switches_in) override {
+    batch_sizes.push_back(context_switches_in.size());
+    TracerListener::OnContextSwitchesIn(context_switches_in);
+  }
+  void OnFunctionCalls(absl::Span<const FunctionCall> function_calls) override {
+    batch_sizes.push_back(function_calls.size());
+    TracerListener::OnFunctionCalls(function_calls);
+  }
+
+  std::vector<pid_t> tids;
+  std::vector<size_t> batch_sizes;
+  std::vector<uint64_t> timestamps;
+};
+}  // namespace
+
+TEST(BatchingTracerListener, ForwardsEventsInBatchesOnFlush) {
+  RecordingListener listener;
+  BatchingTracerListener batching_listener{&listener};
+
+  batching_listener.OnContextSwitchIn(ContextSwitchIn{1, 0, 100});
+  batching_listener.OnFunctionCall(FunctionCall{1, 0x10, 200, 210, 0});
+  batching_listener.OnContextSwitchIn(ContextSwitchIn{1, 0, 300});
+  // Less frequent events are not buffered.
+  batching_listener.OnTid(42);
+  EXPECT_EQ(listener.tids, std::vector<pid_t>{42});
+  EXPECT_TRUE(listener.timestamps.empty());
+
+  batching_listener.Flush();
+  EXPECT_EQ(listener.batch_sizes, (std::vector<size_t>{2, 1}));
+  EXPECT_EQ(listener.timestamps, (std::vector<uint64_t>{100, 300, 200}));
+
+  // Nothing is forwarded twice, and empty batches are not forwarded.
+  batching_listener.Flush();
+  EXPECT_EQ(listener.batch_sizes.size(), 2);
+
+  batching_listener.OnFunctionCall(FunctionCall{1, 0x10, 400, 410, 0});
+  batching_listener.Flush();
+  EXPECT_EQ(listener.batch_sizes, (std::vector<size_t>{2, 1, 1}));
+  EXPECT_EQ(listener.timestamps, (std::vector<uint64_t>{100, 300, 200, 400}));
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,92 @@
+#include "Bpf.h"
+
+#include <OrbitBase/Logging.h>
+#include <OrbitBase/SafeStrerror.h>
+#include <asm/unistd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <string>
+
+namespace LinuxTracing {
+
+namespace {
+int bpf(int cmd, bpf_attr* attr) {
+  return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+}  // namespace
+
+int bpf_map_create(bpf_map_type map_type, uint32_t key_size,
+                   uint32_t value_size, uint32_t max_entries) {
+  bpf_attr attr{};
+  attr.map_type = map_type;
+  attr.key_size = key_size;
+  attr.value_size = value_size;
+  attr.max_entries = max_entries;
+  int fd = bpf(BPF_MAP_CREATE, &attr);
+  if (fd < 0) {
+    ERROR("BPF_MAP_CREATE: %s", SafeStrerror(errno));
+  }
+  return fd;
+}
+
+bool bpf_map_lookup_elem(int map_fd, const void* key, void* value) {
+  bpf_attr attr{};
+  attr.map_fd = map_fd;
+  attr.key = reinterpret_cast<uint64_t>(key);
+  attr.value = reinterpret_cast<uint64_t>(value);
+  return bpf(BPF_MAP_LOOKUP_ELEM, &attr) == 0;
+}
+
+bool bpf_map_update_elem(int map_fd, const void* key, const void* value) {
+  bpf_attr attr{};
+  attr.map_fd = map_fd;
+  attr.key = reinterpret_cast<uint64_t>(key);
+  attr.value = reinterpret_cast<uint64_t>(value);
+  attr.flags = BPF_ANY;
+  return bpf(BPF_MAP_UPDATE_ELEM, &attr) == 0;
+}
+
+bool bpf_map_delete_elem(int map_fd, const void* key) {
+  bpf_attr attr{};
+  attr.map_fd = map_fd;
+  attr.key = reinterpret_cast<uint64_t>(key);
+  return bpf(BPF_MAP_DELETE_ELEM, &attr) == 0;
+}
+
+bool bpf_map_get_next_key(int map_fd, const void* key, void* next_key) {
+  bpf_attr attr{};
+  attr.map_fd = map_fd;
+  attr.key = reinterpret_cast<uint64_t>(key);
+  attr.next_key = reinterpret_cast<uint64_t>(next_key);
+  return bpf(BPF_MAP_GET_NEXT_KEY, &attr) == 0;
+}
+
+int bpf_prog_load(bpf_prog_type prog_type, const std::vector<bpf_insn>& insns) {
+  static const char LICENSE[] = "GPL";
+  std::string log(64 * 1024, '\0');
+  bpf_attr attr{};
+  attr.prog_type = prog_type;
+  attr.insns = reinterpret_cast<uint64_t>(insns.data());
+  attr.insn_cnt = insns.size();
+  attr.license = reinterpret_cast<uint64_t>(LICENSE);
+  attr.log_buf = reinterpret_cast<uint64_t>(log.data());
+  attr.log_size = log.size();
+  attr.log_level = 1;
+  int fd = bpf(BPF_PROG_LOAD, &attr);
+  if (fd < 0) {
+    ERROR("BPF_PROG_LOAD: %s\n%s", SafeStrerror(errno), log.c_str());
+  }
+  return fd;
+}
+
+std::vector<bpf_insn> ProgramBuilder::Build() const {
+  std::vector<bpf_insn> insns = insns_;
+  for (const auto& [index, label] : jumps_) {
+    // Relative to the next instruction.
+    insns[index].off = static_cast<int16_t>(labels_.at(label) - (index + 1));
+  }
+  return insns;
+}
+
+}  // namespace LinuxTracing
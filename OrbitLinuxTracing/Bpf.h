@@ -0,0 +1,125 @@
+#ifndef ORBIT_LINUX_TRACING_BPF_H_
+#define ORBIT_LINUX_TRACING_BPF_H_
+
+#include <linux/bpf.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+
+namespace LinuxTracing {
+
+// Thin wrappers around the bpf syscall, as the tree has no libbpf. The
+// functions returning a file descriptor return -1 on error, after logging it.
+
+int bpf_map_create(bpf_map_type map_type, uint32_t key_size,
+                   uint32_t value_size, uint32_t max_entries);
+
+bool bpf_map_lookup_elem(int map_fd, const void* key, void* value);
+
+bool bpf_map_update_elem(int map_fd, const void* key, const void* value);
+
+bool bpf_map_delete_elem(int map_fd, const void* key);
+
+// With a null key, the first key of the map.
+bool bpf_map_get_next_key(int map_fd, const void* key, void* next_key);
+
+// Loads a GPL program, logging the verifier's output on error.
+int bpf_prog_load(bpf_prog_type prog_type, const std::vector<bpf_insn>& insns);
+
+// Assembles the instructions of a program, like the BPF_* macros of the
+// kernel's include/linux/filter.h, which are not part of the uapi headers.
+// Jumps target labels, which are bound to the next instruction with Bind.
+class ProgramBuilder {
+ public:
+  void MovReg(uint8_t dst, uint8_t src) {
+    Add(Insn(BPF_ALU64 | BPF_MOV | BPF_X, dst, src, 0, 0));
+  }
+  void MovImm(uint8_t dst, int32_t imm) {
+    Add(Insn(BPF_ALU64 | BPF_MOV | BPF_K, dst, 0, 0, imm));
+  }
+  // Takes two instructions.
+  void MovImm64(uint8_t dst, uint64_t imm) {
+    Add(Insn(BPF_LD | BPF_DW | BPF_IMM, dst, 0, 0,
+             static_cast<int32_t>(imm & 0xffffffff)));
+    Add(Insn(0, 0, 0, 0, static_cast<int32_t>(imm >> 32)));
+  }
+  void AluImm(uint8_t op, uint8_t dst, int32_t imm) {
+    Add(Insn(BPF_ALU64 | op | BPF_K, dst, 0, 0, imm));
+  }
+  void AluReg(uint8_t op, uint8_t dst, uint8_t src) {
+    Add(Insn(BPF_ALU64 | op | BPF_X, dst, src, 0, 0));
+  }
+  void Load32(uint8_t dst, uint8_t src, int16_t off) {
+    Add(Insn(BPF_LDX | BPF_W | BPF_MEM, dst, src, off, 0));
+  }
+  void Load64(uint8_t dst, uint8_t src, int16_t off) {
+    Add(Insn(BPF_LDX | BPF_DW | BPF_MEM, dst, src, off, 0));
+  }
+  void Store32(uint8_t dst, int16_t off, uint8_t src) {
+    Add(Insn(BPF_STX | BPF_W | BPF_MEM, dst, src, off, 0));
+  }
+  void Store64(uint8_t dst, int16_t off, uint8_t src) {
+    Add(Insn(BPF_STX | BPF_DW | BPF_MEM, dst, src, off, 0));
+  }
+  void Store64Imm(uint8_t dst, int16_t off, int32_t imm) {
+    Add(Insn(BPF_ST | BPF_DW | BPF_MEM, dst, 0, off, imm));
+  }
+  void AtomicAdd64(uint8_t dst, int16_t off, uint8_t src) {
+    Add(Insn(BPF_STX | BPF_DW | BPF_XADD, dst, src, off, 0));
+  }
+  // Takes two instructions.
+  void LoadMapFd(uint8_t dst, int map_fd) {
+    Add(Insn(BPF_LD | BPF_DW | BPF_IMM, dst, BPF_PSEUDO_MAP_FD, 0, map_fd));
+    Add(Insn(0, 0, 0, 0, 0));
+  }
+  void Call(int32_t function) {
+    Add(Insn(BPF_JMP | BPF_CALL, 0, 0, 0, function));
+  }
+  void Exit() { Add(Insn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0)); }
+
+  // Jumps to label if dst op imm, with op one of the BPF_J* codes.
+  void JumpIfImm(uint8_t op, uint8_t dst, int32_t imm, int label) {
+    jumps_.emplace_back(insns_.size(), label);
+    Add(Insn(BPF_JMP | op | BPF_K, dst, 0, 0, imm));
+  }
+  // Jumps to label if dst op src.
+  void JumpIfReg(uint8_t op, uint8_t dst, uint8_t src, int label) {
+    jumps_.emplace_back(insns_.size(), label);
+    Add(Insn(BPF_JMP | op | BPF_X, dst, src, 0, 0));
+  }
+  void JumpIfZero(uint8_t dst, int label) {
+    JumpIfImm(BPF_JEQ, dst, 0, label);
+  }
+  void Jump(int label) {
+    jumps_.emplace_back(insns_.size(), label);
+    Add(Insn(BPF_JMP | BPF_JA, 0, 0, 0, 0));
+  }
+  void Bind(int label) { labels_[label] = insns_.size(); }
+
+  std::vector<bpf_insn> Build() const;
+
+ private:
+  static bpf_insn Insn(uint8_t code, uint8_t dst_reg, uint8_t src_reg,
+                       int16_t off, int32_t imm) {
+    bpf_insn insn{};
+    insn.code = code;
+    insn.dst_reg = dst_reg;
+    insn.src_reg = src_reg;
+    insn.off = off;
+    insn.imm = imm;
+    return insn;
+  }
+  void Add(bpf_insn insn) { insns_.push_back(insn); }
+
+  std::vector<bpf_insn> insns_;
+  absl::flat_hash_map<int, size_t> labels_;
+  std::vector<std::pair<size_t, int>> jumps_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_BPF_H_
@@ -0,0 +1,280 @@
+#include "BpfFileIo.h"
+
+#include <OrbitBase/Logging.h>
+#include <OrbitBase/SafeStrerror.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <string>
+
+#include "Bpf.h"
+#include "PerfEventOpen.h"
+
+namespace LinuxTracing {
+
+namespace {
+
+// The threads that can be in a traced syscall at the same time.
+constexpr uint32_t MAX_THREADS = 16384;
+
+// The names of the tracepoints of the traced syscalls, without the
+// sys_enter_ and sys_exit_ prefixes.
+constexpr const char* TRACED_SYSCALLS[] = {"read",    "write", "pread64",
+                                           "pwrite64", "fsync", "openat"};
+
+// The context of the programs of the syscall tracepoints, as the kernel
+// passes it: the same offsets as in the format of the tracepoints.
+constexpr int16_t CONTEXT_SYSCALL_NUMBER_OFFSET = 8;
+// The first argument of sys_enter_*, and the return value of sys_exit_*.
+constexpr int16_t CONTEXT_ARGUMENT_OFFSET = 16;
+
+// The value of the map of the open syscalls, keyed by thread.
+struct OpenSyscall {
+  uint64_t begin_timestamp_ns;
+  int64_t fd;
+};
+
+// The stack offsets of the programs' variables, from the frame pointer r10.
+// The verifier wants them aligned.
+constexpr int16_t PID_OFFSET = -4;
+constexpr int16_t TID_OFFSET = -8;  // The key of the open syscalls map.
+// The entry program's.
+constexpr int16_t OPEN_SYSCALL_OFFSET = -24;
+// The exit program's.
+constexpr int16_t RECORD_OFFSET = -48;
+static_assert(sizeof(BpfFileIo::FileIoRecord) == 40);
+
+int16_t FieldOffset(int16_t struct_offset, size_t field_offset) {
+  return static_cast<int16_t>(struct_offset + field_offset);
+}
+
+void CloseFileDescriptors(const std::vector<int>& fds) {
+  for (int fd : fds) {
+    close(fd);
+  }
+}
+
+}  // namespace
+
+std::unique_ptr<BpfFileIo> BpfFileIo::Create(const std::vector<pid_t>& pids,
+                                             int32_t max_cpu) {
+  std::unique_ptr<BpfFileIo> bpf_file_io{new BpfFileIo()};
+  bpf_file_io->pids_map_fd_ =
+      bpf_map_create(BPF_MAP_TYPE_HASH, sizeof(uint32_t), sizeof(uint8_t),
+                     std::max<uint32_t>(pids.size(), 1));
+  bpf_file_io->open_syscalls_map_fd_ = bpf_map_create(
+      BPF_MAP_TYPE_HASH, sizeof(uint32_t), sizeof(OpenSyscall), MAX_THREADS);
+  bpf_file_io->outputs_map_fd_ =
+      bpf_map_create(BPF_MAP_TYPE_PERF_EVENT_ARRAY, sizeof(uint32_t),
+                     sizeof(uint32_t), max_cpu + 1);
+  if (bpf_file_io->pids_map_fd_ < 0 ||
+      bpf_file_io->open_syscalls_map_fd_ < 0 ||
+      bpf_file_io->outputs_map_fd_ < 0) {
+    return nullptr;
+  }
+
+  for (pid_t pid : pids) {
+    uint32_t key = pid;
+    uint8_t value = 1;
+    if (!bpf_map_update_elem(bpf_file_io->pids_map_fd_, &key, &value)) {
+      ERROR("Adding pid %d to the eBPF map: %s", pid, SafeStrerror(errno));
+      return nullptr;
+    }
+  }
+
+  if (!bpf_file_io->LoadEnterProgram() || !bpf_file_io->LoadExitProgram()) {
+    return nullptr;
+  }
+  return bpf_file_io;
+}
+
+BpfFileIo::~BpfFileIo() {
+  for (int fd : {exit_program_fd_, enter_program_fd_, outputs_map_fd_,
+                 open_syscalls_map_fd_, pids_map_fd_}) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+bool BpfFileIo::SetOutput(int32_t cpu, int output_fd) {
+  uint32_t key = cpu;
+  uint32_t value = output_fd;
+  if (!bpf_map_update_elem(outputs_map_fd_, &key, &value)) {
+    ERROR("Setting the eBPF output of cpu %d: %s", cpu, SafeStrerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool BpfFileIo::LoadEnterProgram() {
+  enum { EXIT };
+
+  ProgramBuilder program;
+  program.MovReg(BPF_REG_6, BPF_REG_1);  // The context.
+  // Only the syscalls of the target processes are recorded.
+  program.Call(BPF_FUNC_get_current_pid_tgid);
+  program.MovReg(BPF_REG_7, BPF_REG_0);  // tgid << 32 | tid.
+  program.AluImm(BPF_RSH, BPF_REG_0, 32);
+  program.Store32(BPF_REG_10, PID_OFFSET, BPF_REG_0);
+  program.LoadMapFd(BPF_REG_1, pids_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, PID_OFFSET);
+  program.Call(BPF_FUNC_map_lookup_elem);
+  program.JumpIfZero(BPF_REG_0, EXIT);
+
+  program.Store32(BPF_REG_10, TID_OFFSET, BPF_REG_7);
+  program.Load64(BPF_REG_1, BPF_REG_6, CONTEXT_ARGUMENT_OFFSET);
+  program.Store64(BPF_REG_10,
+                  FieldOffset(OPEN_SYSCALL_OFFSET, offsetof(OpenSyscall, fd)),
+                  BPF_REG_1);
+  program.Call(BPF_FUNC_ktime_get_ns);  // CLOCK_MONOTONIC, like perf_events.
+  program.Store64(BPF_REG_10,
+                  FieldOffset(OPEN_SYSCALL_OFFSET,
+                              offsetof(OpenSyscall, begin_timestamp_ns)),
+                  BPF_REG_0);
+  // A thread is in one syscall at a time, so the entry replaces any left by
+  // a syscall whose exit was missed.
+  program.LoadMapFd(BPF_REG_1, open_syscalls_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, TID_OFFSET);
+  program.MovReg(BPF_REG_3, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_3, OPEN_SYSCALL_OFFSET);
+  program.MovImm(BPF_REG_4, BPF_ANY);
+  program.Call(BPF_FUNC_map_update_elem);
+
+  // Returning 0 drops the record of the tracepoint.
+  program.Bind(EXIT);
+  program.MovImm(BPF_REG_0, 0);
+  program.Exit();
+
+  enter_program_fd_ = bpf_prog_load(BPF_PROG_TYPE_TRACEPOINT, program.Build());
+  return enter_program_fd_ >= 0;
+}
+
+bool BpfFileIo::LoadExitProgram() {
+  enum { EXIT };
+  auto record_field = [](size_t field_offset) {
+    return FieldOffset(RECORD_OFFSET, field_offset);
+  };
+
+  ProgramBuilder program;
+  program.MovReg(BPF_REG_6, BPF_REG_1);  // The context.
+  program.Call(BPF_FUNC_ktime_get_ns);
+  program.Store64(BPF_REG_10,
+                  record_field(offsetof(FileIoRecord, end_timestamp_ns)),
+                  BPF_REG_0);
+
+  // Only the threads of the targets in a traced syscall are in the map.
+  program.Call(BPF_FUNC_get_current_pid_tgid);
+  program.Store32(BPF_REG_10, TID_OFFSET, BPF_REG_0);
+  program.Store32(BPF_REG_10, record_field(offsetof(FileIoRecord, tid)),
+                  BPF_REG_0);
+  program.LoadMapFd(BPF_REG_1, open_syscalls_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, TID_OFFSET);
+  program.Call(BPF_FUNC_map_lookup_elem);
+  program.JumpIfZero(BPF_REG_0, EXIT);
+  program.Load64(BPF_REG_1, BPF_REG_0,
+                 offsetof(OpenSyscall, begin_timestamp_ns));
+  program.Store64(BPF_REG_10,
+                  record_field(offsetof(FileIoRecord, begin_timestamp_ns)),
+                  BPF_REG_1);
+  program.Load64(BPF_REG_1, BPF_REG_0, offsetof(OpenSyscall, fd));
+  program.Store64(BPF_REG_10, record_field(offsetof(FileIoRecord, fd)),
+                  BPF_REG_1);
+  program.LoadMapFd(BPF_REG_1, open_syscalls_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, TID_OFFSET);
+  program.Call(BPF_FUNC_map_delete_elem);
+
+  program.Load64(BPF_REG_1, BPF_REG_6, CONTEXT_ARGUMENT_OFFSET);
+  program.Store64(BPF_REG_10, record_field(offsetof(FileIoRecord, result)),
+                  BPF_REG_1);
+  program.Load64(BPF_REG_1, BPF_REG_6, CONTEXT_SYSCALL_NUMBER_OFFSET);
+  program.Store32(BPF_REG_10,
+                  record_field(offsetof(FileIoRecord, syscall_number)),
+                  BPF_REG_1);
+
+  program.MovReg(BPF_REG_1, BPF_REG_6);
+  program.LoadMapFd(BPF_REG_2, outputs_map_fd_);
+  program.MovImm64(BPF_REG_3, BPF_F_CURRENT_CPU);
+  program.MovReg(BPF_REG_4, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_4, RECORD_OFFSET);
+  program.MovImm(BPF_REG_5, sizeof(FileIoRecord));
+  program.Call(BPF_FUNC_perf_event_output);
+
+  // Returning 0 drops the record of the tracepoint.
+  program.Bind(EXIT);
+  program.MovImm(BPF_REG_0, 0);
+  program.Exit();
+
+  exit_program_fd_ = bpf_prog_load(BPF_PROG_TYPE_TRACEPOINT, program.Build());
+  return exit_program_fd_ >= 0;
+}
+
+bool BpfFileIo::OpenTracepoints(std::vector<int>* tracepoint_fds) {
+  std::vector<int> fds;
+  for (const char* syscall : TRACED_SYSCALLS) {
+    for (bool is_exit : {false, true}) {
+      std::string name =
+          std::string(is_exit ? "sys_exit_" : "sys_enter_") + syscall;
+      // The programs run whatever the cpu of the event: any will do.
+      int fd = tracepoint_event_open("syscalls", name.c_str(), -1, 0);
+      if (fd < 0) {
+        CloseFileDescriptors(fds);
+        return false;
+      }
+      fds.push_back(fd);
+      if (!perf_event_set_bpf(fd,
+                              is_exit ? exit_program_fd_ : enter_program_fd_)) {
+        CloseFileDescriptors(fds);
+        return false;
+      }
+    }
+  }
+  tracepoint_fds->insert(tracepoint_fds->end(), fds.begin(), fds.end());
+  return true;
+}
+
+std::optional<FileIo> BpfFileIo::FileIoFromRecord(const FileIoRecord& record) {
+  FileIoSyscall syscall;
+  switch (record.syscall_number) {
+    case SYS_read:
+      syscall = FileIoSyscall::kRead;
+      break;
+    case SYS_write:
+      syscall = FileIoSyscall::kWrite;
+      break;
+    case SYS_pread64:
+      syscall = FileIoSyscall::kPread;
+      break;
+    case SYS_pwrite64:
+      syscall = FileIoSyscall::kPwrite;
+      break;
+    case SYS_fsync:
+      syscall = FileIoSyscall::kFsync;
+      break;
+    case SYS_openat:
+      syscall = FileIoSyscall::kOpenat;
+      break;
+    default:
+      return std::nullopt;
+  }
+  // The first argument of openat is the directory, the file descriptor is
+  // what it returns.
+  int64_t fd = syscall == FileIoSyscall::kOpenat
+                   ? std::max<int64_t>(record.result, -1)
+                   : record.fd;
+  return FileIo{static_cast<pid_t>(record.tid),
+                syscall,
+                static_cast<int32_t>(fd),
+                record.result,
+                record.begin_timestamp_ns,
+                record.end_timestamp_ns};
+}
+
+}  // namespace LinuxTracing
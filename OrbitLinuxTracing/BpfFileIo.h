@@ -0,0 +1,73 @@
+#ifndef ORBIT_LINUX_TRACING_BPF_FILE_IO_H_
+#define ORBIT_LINUX_TRACING_BPF_FILE_IO_H_
+
+#include <OrbitLinuxTracing/Events.h>
+#include <sys/types.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace LinuxTracing {
+
+// Pairs the entries and exits of the file I/O syscalls of the target
+// processes in the kernel, with eBPF programs attached to the
+// syscalls:sys_enter_* and syscalls:sys_exit_* tracepoints of read, write,
+// pread64, pwrite64, fsync and openat. The entry program filters the threads
+// by process and keeps the time and the file descriptor of the syscall in a
+// map of the thread, the exit program writes a single record per syscall, a
+// FileIoRecord, to the ring buffer of the bpf-output event of the cpu. Both
+// drop the records of the tracepoints themselves, so the syscalls of other
+// processes cost a lookup in a map, and those of the targets one record.
+class BpfFileIo {
+ public:
+  // What the exit program writes with bpf_perf_event_output.
+  struct __attribute__((__packed__)) FileIoRecord {
+    uint64_t begin_timestamp_ns;
+    uint64_t end_timestamp_ns;
+    int64_t result;
+    // The first argument of the syscall.
+    int64_t fd;
+    uint32_t tid;
+    uint32_t syscall_number;
+  };
+
+  // Creates the maps and loads the programs, for the syscalls of the threads
+  // of pids on the cores up to max_cpu. nullptr on error, e.g., without
+  // CAP_SYS_ADMIN or on kernels older than 4.14.
+  static std::unique_ptr<BpfFileIo> Create(const std::vector<pid_t>& pids,
+                                           int32_t max_cpu);
+
+  ~BpfFileIo();
+  BpfFileIo(const BpfFileIo&) = delete;
+  BpfFileIo& operator=(const BpfFileIo&) = delete;
+
+  // The records of the syscalls returning on cpu go to the ring buffer of
+  // output_fd, opened with bpf_output_event_open.
+  bool SetOutput(int32_t cpu, int output_fd);
+
+  // Opens the tracepoints, disabled, and attaches the programs to them. The
+  // programs of a tracepoint run on all cores, so each tracepoint is opened
+  // once. On success, adds the file descriptors to tracepoint_fds, otherwise
+  // none is kept open.
+  bool OpenTracepoints(std::vector<int>* tracepoint_fds);
+
+  // std::nullopt for the syscalls that are not traced.
+  static std::optional<FileIo> FileIoFromRecord(const FileIoRecord& record);
+
+ private:
+  BpfFileIo() = default;
+  bool LoadEnterProgram();
+  bool LoadExitProgram();
+
+  int pids_map_fd_ = -1;
+  int open_syscalls_map_fd_ = -1;
+  int outputs_map_fd_ = -1;
+  int enter_program_fd_ = -1;
+  int exit_program_fd_ = -1;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_BPF_FILE_IO_H_
@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+#include <sys/syscall.h>
+
+#include "BpfFileIo.h"
+
+namespace LinuxTracing {
+
+TEST(BpfFileIo, FileIoFromRecord) {
+  BpfFileIo::FileIoRecord record{};
+  record.begin_timestamp_ns = 1000;
+  record.end_timestamp_ns = 1500;
+  record.result = 4096;
+  record.fd = 7;
+  record.tid = 42;
+  record.syscall_number = SYS_pread64;
+
+  std::optional<FileIo> file_io = BpfFileIo::FileIoFromRecord(record);
+  ASSERT_TRUE(file_io.has_value());
+  EXPECT_EQ(file_io->GetTid(), 42);
+  EXPECT_EQ(file_io->GetSyscall(), FileIoSyscall::kPread);
+  EXPECT_EQ(file_io->GetFd(), 7);
+  EXPECT_EQ(file_io->GetResult(), 4096);
+  EXPECT_EQ(file_io->GetBeginTimestampNs(), 1000);
+  EXPECT_EQ(file_io->GetEndTimestampNs(), 1500);
+}
+
+TEST(BpfFileIo, FileIoFromOpenatRecordHasTheOpenedFd) {
+  BpfFileIo::FileIoRecord record{};
+  record.syscall_number = SYS_openat;
+  // AT_FDCWD.
+  record.fd = -100;
+  record.result = 12;
+  std::optional<FileIo> file_io = BpfFileIo::FileIoFromRecord(record);
+  ASSERT_TRUE(file_io.has_value());
+  EXPECT_EQ(file_io->GetSyscall(), FileIoSyscall::kOpenat);
+  EXPECT_EQ(file_io->GetFd(), 12);
+
+  // ENOENT.
+  record.result = -2;
+  file_io = BpfFileIo::FileIoFromRecord(record);
+  ASSERT_TRUE(file_io.has_value());
+  EXPECT_EQ(file_io->GetFd(), -1);
+  EXPECT_EQ(file_io->GetResult(), -2);
+}
+
+TEST(BpfFileIo, FileIoFromRecordOfOtherSyscall) {
+  BpfFileIo::FileIoRecord record{};
+  record.syscall_number = SYS_getpid;
+  EXPECT_FALSE(BpfFileIo::FileIoFromRecord(record).has_value());
+}
+
+}  // namespace LinuxTracing
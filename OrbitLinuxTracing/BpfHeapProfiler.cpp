@@ -0,0 +1,459 @@
+#include "BpfHeapProfiler.h"
+
+#include <OrbitBase/Logging.h>
+#include <OrbitBase/SafeStrerror.h>
+#include <asm/ptrace.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+
+#include "Bpf.h"
+#include "PerfEventOpen.h"
+#include "Utils.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_split.h"
+
+namespace LinuxTracing {
+
+namespace {
+
+// The threads that can allocate at the same time. The maps of the threads
+// are LRU maps, so that those of threads that exited make room for others.
+constexpr uint32_t MAX_THREADS = 16384;
+// The sampled blocks that can be live at the same time: with the default
+// interval of 512 KB, heaps of up to 128 GB.
+constexpr uint32_t MAX_SAMPLED_BLOCKS = 1 << 18;
+// A power of 2, so that an interval is drawn with a mask.
+constexpr uint32_t INTERVAL_COUNT = 256;
+
+// The key of the map of the sampled blocks, whose value is their size.
+struct BlockKey {
+  uint64_t address;
+  uint32_t pid;
+  uint32_t padding;
+};
+
+// The stack offsets of the programs' variables, from the frame pointer r10.
+// The verifier wants them aligned.
+constexpr int16_t PID_OFFSET = -4;
+constexpr int16_t TID_OFFSET = -8;  // The key of the maps of the threads.
+constexpr int16_t INTERVAL_INDEX_OFFSET = -12;
+constexpr int16_t VALUE_OFFSET = -24;
+constexpr int16_t BLOCK_KEY_OFFSET = -40;
+constexpr int16_t RECORD_OFFSET = -64;
+static_assert(sizeof(BlockKey) == 16);
+static_assert(sizeof(BpfHeapProfiler::HeapRecord) == 24);
+
+int16_t FieldOffset(int16_t struct_offset, size_t field_offset) {
+  return static_cast<int16_t>(struct_offset + field_offset);
+}
+
+int16_t ArgumentOffset(BpfHeapProfiler::AllocationFunction function) {
+  // The size is the first argument of malloc, and the second of realloc.
+  // calloc multiplies its two arguments.
+  return function == BpfHeapProfiler::AllocationFunction::kRealloc
+             ? offsetof(pt_regs, rsi)
+             : offsetof(pt_regs, rdi);
+}
+
+// Writes a HeapRecord of type for the block at the address in address_reg,
+// of the size in size_reg, for the thread in the low bits of tid_reg.
+// Expects the context in r6.
+void EmitOutputRecord(ProgramBuilder* program, uint8_t address_reg,
+                      uint8_t size_reg, uint8_t tid_reg,
+                      BpfHeapProfiler::HeapRecordType type,
+                      int outputs_map_fd) {
+  using HeapRecord = BpfHeapProfiler::HeapRecord;
+  auto record_field = [](size_t field_offset) {
+    return FieldOffset(RECORD_OFFSET, field_offset);
+  };
+  program->Store64(BPF_REG_10, record_field(offsetof(HeapRecord, address)),
+                   address_reg);
+  program->Store64(BPF_REG_10, record_field(offsetof(HeapRecord, size)),
+                   size_reg);
+  program->Store32(BPF_REG_10, record_field(offsetof(HeapRecord, tid)),
+                   tid_reg);
+  program->MovImm(BPF_REG_1, type);
+  program->Store32(BPF_REG_10, record_field(offsetof(HeapRecord, type)),
+                   BPF_REG_1);
+  program->MovReg(BPF_REG_1, BPF_REG_6);
+  program->LoadMapFd(BPF_REG_2, outputs_map_fd);
+  program->MovImm64(BPF_REG_3, BPF_F_CURRENT_CPU);
+  program->MovReg(BPF_REG_4, BPF_REG_10);
+  program->AluImm(BPF_ADD, BPF_REG_4, RECORD_OFFSET);
+  program->MovImm(BPF_REG_5, sizeof(HeapRecord));
+  program->Call(BPF_FUNC_perf_event_output);
+}
+
+// Looks up the block at the address in address_reg of the process in the
+// high bits of pid_tgid_reg, and jumps to not_sampled if it wasn't sampled.
+// Otherwise, removes it and writes its HeapRecord of kFreeRecord. Expects
+// the context in r6, and keeps r6 to r9.
+void EmitFreeSampledBlock(ProgramBuilder* program, uint8_t address_reg,
+                          uint8_t pid_tgid_reg, int not_sampled,
+                          int sampled_blocks_map_fd, int outputs_map_fd) {
+  int16_t address_offset =
+      FieldOffset(BLOCK_KEY_OFFSET, offsetof(BlockKey, address));
+  program->Store64(BPF_REG_10, address_offset, address_reg);
+  program->MovReg(BPF_REG_1, pid_tgid_reg);
+  program->AluImm(BPF_RSH, BPF_REG_1, 32);
+  program->Store32(BPF_REG_10,
+                   FieldOffset(BLOCK_KEY_OFFSET, offsetof(BlockKey, pid)),
+                   BPF_REG_1);
+  program->MovImm(BPF_REG_1, 0);
+  program->Store32(BPF_REG_10,
+                   FieldOffset(BLOCK_KEY_OFFSET, offsetof(BlockKey, padding)),
+                   BPF_REG_1);
+  program->LoadMapFd(BPF_REG_1, sampled_blocks_map_fd);
+  program->MovReg(BPF_REG_2, BPF_REG_10);
+  program->AluImm(BPF_ADD, BPF_REG_2, BLOCK_KEY_OFFSET);
+  program->Call(BPF_FUNC_map_lookup_elem);
+  program->JumpIfZero(BPF_REG_0, not_sampled);
+  program->Load64(BPF_REG_1, BPF_REG_0, 0);
+  program->Store64(BPF_REG_10, VALUE_OFFSET, BPF_REG_1);
+  program->LoadMapFd(BPF_REG_1, sampled_blocks_map_fd);
+  program->MovReg(BPF_REG_2, BPF_REG_10);
+  program->AluImm(BPF_ADD, BPF_REG_2, BLOCK_KEY_OFFSET);
+  program->Call(BPF_FUNC_map_delete_elem);
+  program->Load64(BPF_REG_2, BPF_REG_10, address_offset);
+  program->Load64(BPF_REG_3, BPF_REG_10, VALUE_OFFSET);
+  EmitOutputRecord(program, BPF_REG_2, BPF_REG_3, pid_tgid_reg,
+                   BpfHeapProfiler::kFreeRecord, outputs_map_fd);
+}
+
+void CloseFileDescriptors(const std::vector<int>& fds) {
+  for (int fd : fds) {
+    close(fd);
+  }
+}
+
+}  // namespace
+
+std::optional<BpfHeapProfiler::Allocator> BpfHeapProfiler::FindAllocator(
+    const std::string& maps) {
+  static const std::vector<std::string> FUNCTION_NAMES{"malloc", "calloc",
+                                                       "realloc", "free"};
+  std::optional<Allocator> libc_allocator;
+  absl::flat_hash_set<std::string> read_paths;
+  std::vector<std::string> lines = absl::StrSplit(maps, '\n');
+  for (const std::string& line : lines) {
+    std::vector<std::string> fields =
+        absl::StrSplit(line, ' ', absl::SkipEmpty());
+    if (fields.size() < 6 || !absl::StartsWith(fields[5], "/") ||
+        !read_paths.emplace(fields[5]).second) {
+      continue;
+    }
+    const std::string& path = fields[5];
+    std::string file_name = path.substr(path.rfind('/') + 1);
+    if (absl::StartsWith(file_name, "ld-")) {
+      // Its minimal malloc is only used until libc is loaded.
+      continue;
+    }
+    absl::flat_hash_map<std::string, uint64_t> offsets =
+        ReadElfFunctionOffsets(path, FUNCTION_NAMES);
+    if (!offsets.contains("malloc") || !offsets.contains("free")) {
+      continue;
+    }
+    Allocator allocator{path, offsets.at("malloc"), offsets["calloc"],
+                        offsets["realloc"], offsets.at("free")};
+    if (!absl::StartsWith(file_name, "libc.") &&
+        !absl::StartsWith(file_name, "libc-")) {
+      return allocator;
+    }
+    if (!libc_allocator.has_value()) {
+      libc_allocator = std::move(allocator);
+    }
+  }
+  return libc_allocator;
+}
+
+std::unique_ptr<BpfHeapProfiler> BpfHeapProfiler::Create(
+    const std::vector<pid_t>& pids, int32_t max_cpu,
+    uint64_t sampling_interval_bytes) {
+  std::unique_ptr<BpfHeapProfiler> profiler{new BpfHeapProfiler()};
+  profiler->pids_map_fd_ =
+      bpf_map_create(BPF_MAP_TYPE_HASH, sizeof(uint32_t), sizeof(uint8_t),
+                     std::max<uint32_t>(pids.size(), 1));
+  profiler->intervals_map_fd_ = bpf_map_create(
+      BPF_MAP_TYPE_ARRAY, sizeof(uint32_t), sizeof(uint64_t), INTERVAL_COUNT);
+  profiler->bytes_until_sample_map_fd_ = bpf_map_create(
+      BPF_MAP_TYPE_LRU_HASH, sizeof(uint32_t), sizeof(int64_t), MAX_THREADS);
+  profiler->open_allocations_map_fd_ = bpf_map_create(
+      BPF_MAP_TYPE_LRU_HASH, sizeof(uint32_t), sizeof(uint64_t), MAX_THREADS);
+  profiler->sampled_blocks_map_fd_ =
+      bpf_map_create(BPF_MAP_TYPE_HASH, sizeof(BlockKey), sizeof(uint64_t),
+                     MAX_SAMPLED_BLOCKS);
+  profiler->outputs_map_fd_ =
+      bpf_map_create(BPF_MAP_TYPE_PERF_EVENT_ARRAY, sizeof(uint32_t),
+                     sizeof(uint32_t), max_cpu + 1);
+  if (profiler->pids_map_fd_ < 0 || profiler->intervals_map_fd_ < 0 ||
+      profiler->bytes_until_sample_map_fd_ < 0 ||
+      profiler->open_allocations_map_fd_ < 0 ||
+      profiler->sampled_blocks_map_fd_ < 0 || profiler->outputs_map_fd_ < 0) {
+    return nullptr;
+  }
+
+  for (pid_t pid : pids) {
+    uint32_t key = pid;
+    uint8_t value = 1;
+    if (!bpf_map_update_elem(profiler->pids_map_fd_, &key, &value)) {
+      ERROR("Adding pid %d to the eBPF map: %s", pid, SafeStrerror(errno));
+      return nullptr;
+    }
+  }
+  std::vector<uint64_t> intervals =
+      ComputeSamplingIntervals(sampling_interval_bytes);
+  for (uint32_t i = 0; i < intervals.size(); ++i) {
+    if (!bpf_map_update_elem(profiler->intervals_map_fd_, &i, &intervals[i])) {
+      ERROR("Setting the sampling intervals: %s", SafeStrerror(errno));
+      return nullptr;
+    }
+  }
+
+  if (!profiler->LoadUretprobesProgram() || !profiler->LoadFreeProgram()) {
+    return nullptr;
+  }
+  return profiler;
+}
+
+BpfHeapProfiler::~BpfHeapProfiler() {
+  CloseFileDescriptors(uprobes_program_fds_);
+  for (int fd : {free_program_fd_, uretprobes_program_fd_, outputs_map_fd_,
+                 sampled_blocks_map_fd_, open_allocations_map_fd_,
+                 bytes_until_sample_map_fd_, intervals_map_fd_,
+                 pids_map_fd_}) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+bool BpfHeapProfiler::SetOutput(int32_t cpu, int output_fd) {
+  uint32_t key = cpu;
+  uint32_t value = output_fd;
+  if (!bpf_map_update_elem(outputs_map_fd_, &key, &value)) {
+    ERROR("Setting the eBPF output of cpu %d: %s", cpu, SafeStrerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool BpfHeapProfiler::AttachAllocationUprobes(int uprobes_fd,
+                                              AllocationFunction function,
+                                              int32_t cpu) {
+  enum { EXIT, COUNT, FIRST_ALLOCATION, SAMPLE, START_COUNT };
+
+  ProgramBuilder program;
+  program.MovReg(BPF_REG_6, BPF_REG_1);  // The context, the user registers.
+  program.Call(BPF_FUNC_get_smp_processor_id);
+  program.JumpIfImm(BPF_JNE, BPF_REG_0, cpu, EXIT);
+
+  // Only the allocations of the target processes are counted.
+  program.Call(BPF_FUNC_get_current_pid_tgid);
+  program.MovReg(BPF_REG_7, BPF_REG_0);  // tgid << 32 | tid.
+  program.AluImm(BPF_RSH, BPF_REG_0, 32);
+  program.Store32(BPF_REG_10, PID_OFFSET, BPF_REG_0);
+  program.LoadMapFd(BPF_REG_1, pids_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, PID_OFFSET);
+  program.Call(BPF_FUNC_map_lookup_elem);
+  program.JumpIfZero(BPF_REG_0, EXIT);
+  program.Store32(BPF_REG_10, TID_OFFSET, BPF_REG_7);
+
+  program.Load64(BPF_REG_8, BPF_REG_6, ArgumentOffset(function));  // The size.
+  if (function == AllocationFunction::kCalloc) {
+    program.Load64(BPF_REG_1, BPF_REG_6, offsetof(pt_regs, rsi));
+    program.AluReg(BPF_MUL, BPF_REG_8, BPF_REG_1);
+  }
+  // Whether the allocation is sampled whatever its size.
+  program.MovImm(BPF_REG_9, 0);
+  if (function == AllocationFunction::kRealloc) {
+    // The block a realloc replaces is freed, and the new one is sampled if
+    // the old one was, so that the block doesn't leave the live heap.
+    program.Load64(BPF_REG_1, BPF_REG_6, offsetof(pt_regs, rdi));
+    program.JumpIfZero(BPF_REG_1, COUNT);
+    EmitFreeSampledBlock(&program, BPF_REG_1, BPF_REG_7, COUNT,
+                         sampled_blocks_map_fd_, outputs_map_fd_);
+    program.MovImm(BPF_REG_9, 1);
+    program.Bind(COUNT);
+  }
+
+  // Draws an interval into r1.
+  auto draw_interval = [this, &program] {
+    program.Call(BPF_FUNC_get_prandom_u32);
+    program.AluImm(BPF_AND, BPF_REG_0, INTERVAL_COUNT - 1);
+    program.Store32(BPF_REG_10, INTERVAL_INDEX_OFFSET, BPF_REG_0);
+    program.LoadMapFd(BPF_REG_1, intervals_map_fd_);
+    program.MovReg(BPF_REG_2, BPF_REG_10);
+    program.AluImm(BPF_ADD, BPF_REG_2, INTERVAL_INDEX_OFFSET);
+    program.Call(BPF_FUNC_map_lookup_elem);
+    program.JumpIfZero(BPF_REG_0, EXIT);
+    program.Load64(BPF_REG_1, BPF_REG_0, 0);
+  };
+  // Sets the bytes until the next sample of the thread to r1.
+  auto store_bytes_until_sample = [this, &program] {
+    program.Store64(BPF_REG_10, VALUE_OFFSET, BPF_REG_1);
+    program.LoadMapFd(BPF_REG_1, bytes_until_sample_map_fd_);
+    program.MovReg(BPF_REG_2, BPF_REG_10);
+    program.AluImm(BPF_ADD, BPF_REG_2, TID_OFFSET);
+    program.MovReg(BPF_REG_3, BPF_REG_10);
+    program.AluImm(BPF_ADD, BPF_REG_3, VALUE_OFFSET);
+    program.MovImm(BPF_REG_4, BPF_ANY);
+    program.Call(BPF_FUNC_map_update_elem);
+  };
+
+  // The allocation is sampled when the bytes until the next sample of the
+  // thread reach 0.
+  program.LoadMapFd(BPF_REG_1, bytes_until_sample_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, TID_OFFSET);
+  program.Call(BPF_FUNC_map_lookup_elem);
+  program.JumpIfZero(BPF_REG_0, FIRST_ALLOCATION);
+  program.Load64(BPF_REG_1, BPF_REG_0, 0);
+  program.AluReg(BPF_SUB, BPF_REG_1, BPF_REG_8);
+  program.Store64(BPF_REG_0, 0, BPF_REG_1);
+  program.JumpIfImm(BPF_JNE, BPF_REG_9, 0, SAMPLE);
+  program.JumpIfImm(BPF_JSGT, BPF_REG_1, 0, EXIT);
+  program.Jump(SAMPLE);
+
+  // The first allocation of a thread starts its count.
+  program.Bind(FIRST_ALLOCATION);
+  draw_interval();
+  program.AluReg(BPF_SUB, BPF_REG_1, BPF_REG_8);
+  program.JumpIfImm(BPF_JNE, BPF_REG_9, 0, SAMPLE);
+  program.JumpIfImm(BPF_JSGT, BPF_REG_1, 0, START_COUNT);
+
+  program.Bind(SAMPLE);
+  draw_interval();
+  store_bytes_until_sample();
+  // The size, for the return program.
+  program.Store64(BPF_REG_10, VALUE_OFFSET, BPF_REG_8);
+  program.LoadMapFd(BPF_REG_1, open_allocations_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, TID_OFFSET);
+  program.MovReg(BPF_REG_3, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_3, VALUE_OFFSET);
+  program.MovImm(BPF_REG_4, BPF_ANY);
+  program.Call(BPF_FUNC_map_update_elem);
+  // Returning 1 keeps the record of the uprobe, with the stack.
+  program.MovImm(BPF_REG_0, 1);
+  program.Exit();
+
+  program.Bind(START_COUNT);
+  store_bytes_until_sample();
+  // Returning 0 drops the record of the uprobe.
+  program.Bind(EXIT);
+  program.MovImm(BPF_REG_0, 0);
+  program.Exit();
+
+  int program_fd = bpf_prog_load(BPF_PROG_TYPE_KPROBE, program.Build());
+  if (program_fd < 0) {
+    return false;
+  }
+  uprobes_program_fds_.push_back(program_fd);
+  return perf_event_set_bpf(uprobes_fd, program_fd);
+}
+
+bool BpfHeapProfiler::LoadUretprobesProgram() {
+  enum { EXIT };
+
+  ProgramBuilder program;
+  program.MovReg(BPF_REG_6, BPF_REG_1);  // The context, the user registers.
+  // Only the threads in a sampled allocation are in the map.
+  program.Call(BPF_FUNC_get_current_pid_tgid);
+  program.MovReg(BPF_REG_7, BPF_REG_0);
+  program.Store32(BPF_REG_10, TID_OFFSET, BPF_REG_7);
+  program.LoadMapFd(BPF_REG_1, open_allocations_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, TID_OFFSET);
+  program.Call(BPF_FUNC_map_lookup_elem);
+  program.JumpIfZero(BPF_REG_0, EXIT);
+  program.Load64(BPF_REG_8, BPF_REG_0, 0);  // The size.
+  program.LoadMapFd(BPF_REG_1, open_allocations_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, TID_OFFSET);
+  program.Call(BPF_FUNC_map_delete_elem);
+
+  // Failed allocations return null.
+  program.Load64(BPF_REG_9, BPF_REG_6, offsetof(pt_regs, rax));
+  program.JumpIfZero(BPF_REG_9, EXIT);
+  program.Store64(BPF_REG_10,
+                  FieldOffset(BLOCK_KEY_OFFSET, offsetof(BlockKey, address)),
+                  BPF_REG_9);
+  program.MovReg(BPF_REG_1, BPF_REG_7);
+  program.AluImm(BPF_RSH, BPF_REG_1, 32);
+  program.Store32(BPF_REG_10,
+                  FieldOffset(BLOCK_KEY_OFFSET, offsetof(BlockKey, pid)),
+                  BPF_REG_1);
+  program.MovImm(BPF_REG_1, 0);
+  program.Store32(BPF_REG_10,
+                  FieldOffset(BLOCK_KEY_OFFSET, offsetof(BlockKey, padding)),
+                  BPF_REG_1);
+  program.Store64(BPF_REG_10, VALUE_OFFSET, BPF_REG_8);
+  program.LoadMapFd(BPF_REG_1, sampled_blocks_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, BLOCK_KEY_OFFSET);
+  program.MovReg(BPF_REG_3, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_3, VALUE_OFFSET);
+  program.MovImm(BPF_REG_4, BPF_ANY);
+  program.Call(BPF_FUNC_map_update_elem);
+  // A block whose free could not be recognized is not reported either.
+  program.JumpIfImm(BPF_JNE, BPF_REG_0, 0, EXIT);
+  EmitOutputRecord(&program, BPF_REG_9, BPF_REG_8, BPF_REG_7,
+                   kAllocationRecord, outputs_map_fd_);
+
+  // Returning 0 drops the record of the uretprobe.
+  program.Bind(EXIT);
+  program.MovImm(BPF_REG_0, 0);
+  program.Exit();
+
+  uretprobes_program_fd_ =
+      bpf_prog_load(BPF_PROG_TYPE_KPROBE, program.Build());
+  return uretprobes_program_fd_ >= 0;
+}
+
+bool BpfHeapProfiler::LoadFreeProgram() {
+  enum { EXIT };
+
+  ProgramBuilder program;
+  program.MovReg(BPF_REG_6, BPF_REG_1);  // The context, the user registers.
+  program.Load64(BPF_REG_8, BPF_REG_6, offsetof(pt_regs, rdi));
+  program.JumpIfZero(BPF_REG_8, EXIT);
+  program.Call(BPF_FUNC_get_current_pid_tgid);
+  program.MovReg(BPF_REG_7, BPF_REG_0);
+  EmitFreeSampledBlock(&program, BPF_REG_8, BPF_REG_7, EXIT,
+                       sampled_blocks_map_fd_, outputs_map_fd_);
+
+  // Returning 0 drops the record of the uprobe.
+  program.Bind(EXIT);
+  program.MovImm(BPF_REG_0, 0);
+  program.Exit();
+
+  free_program_fd_ = bpf_prog_load(BPF_PROG_TYPE_KPROBE, program.Build());
+  return free_program_fd_ >= 0;
+}
+
+bool BpfHeapProfiler::AttachAllocationUretprobes(int uretprobes_fd) {
+  return perf_event_set_bpf(uretprobes_fd, uretprobes_program_fd_);
+}
+
+bool BpfHeapProfiler::AttachFreeUprobes(int uprobes_fd) {
+  return perf_event_set_bpf(uprobes_fd, free_program_fd_);
+}
+
+std::vector<uint64_t> BpfHeapProfiler::ComputeSamplingIntervals(
+    uint64_t sampling_interval_bytes) {
+  std::vector<uint64_t> intervals(INTERVAL_COUNT);
+  for (uint32_t i = 0; i < INTERVAL_COUNT; ++i) {
+    double quantile = (i + 0.5) / INTERVAL_COUNT;
+    intervals[i] = std::max<uint64_t>(
+        std::llround(-std::log(quantile) * sampling_interval_bytes), 1);
+  }
+  return intervals;
+}
+
+}  // namespace LinuxTracing
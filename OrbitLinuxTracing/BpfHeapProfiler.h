@@ -0,0 +1,111 @@
+#ifndef ORBIT_LINUX_TRACING_BPF_HEAP_PROFILER_H_
+#define ORBIT_LINUX_TRACING_BPF_HEAP_PROFILER_H_
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace LinuxTracing {
+
+// Samples the heap allocations of the target processes, with eBPF programs
+// attached to u(ret)probes of the allocator. Allocations are sampled by bytes,
+// like tcmalloc does: each thread counts down a random number of bytes, drawn
+// from an exponential distribution of mean sampling_interval_bytes, and the
+// allocation that reaches zero is sampled. So an allocation of size bytes is
+// sampled with probability 1 - exp(-size / sampling_interval_bytes), whatever
+// the allocations around it, and the cost is bounded by the bytes allocated
+// rather than by the calls.
+// The entry program of malloc, calloc and realloc counts the bytes and, for a
+// sampled allocation, keeps its size in a map of the thread and returns 1, so
+// that the uprobe writes its record with the user stack. The return program
+// then keeps the address of the sampled block in a map and writes a
+// HeapRecord. The entry program of free (and of realloc, for the block it
+// replaces) only writes a HeapRecord for the blocks in that map, so that the
+// frees of blocks that were not sampled cost a lookup, and no record.
+class BpfHeapProfiler {
+ public:
+  enum HeapRecordType : uint32_t { kAllocationRecord, kFreeRecord };
+
+  // What the programs write with bpf_perf_event_output.
+  struct __attribute__((__packed__)) HeapRecord {
+    uint64_t address;
+    // For frees too, the size the block was allocated with.
+    uint64_t size;
+    uint32_t tid;
+    uint32_t type;
+  };
+
+  enum class AllocationFunction { kMalloc, kCalloc, kRealloc };
+
+  // The allocator functions of a process, as file offsets in the binary that
+  // defines them. calloc_offset and realloc_offset are 0 if the binary
+  // doesn't define them.
+  struct Allocator {
+    std::string path;
+    uint64_t malloc_offset;
+    uint64_t calloc_offset;
+    uint64_t realloc_offset;
+    uint64_t free_offset;
+  };
+
+  // The binary among those mapped in maps, in the format of /proc/<pid>/maps,
+  // that defines malloc and free: one other than libc and the dynamic loader
+  // if any, e.g., a tcmalloc or jemalloc linked into the executable or loaded
+  // as a library, otherwise libc.
+  static std::optional<Allocator> FindAllocator(const std::string& maps);
+
+  // Creates the maps and loads the programs of the return and free probes,
+  // for the allocations of the threads of pids on the cores up to max_cpu.
+  // nullptr on error, e.g., without CAP_SYS_ADMIN or on kernels older than
+  // 4.10.
+  static std::unique_ptr<BpfHeapProfiler> Create(
+      const std::vector<pid_t>& pids, int32_t max_cpu,
+      uint64_t sampling_interval_bytes);
+
+  ~BpfHeapProfiler();
+  BpfHeapProfiler(const BpfHeapProfiler&) = delete;
+  BpfHeapProfiler& operator=(const BpfHeapProfiler&) = delete;
+
+  // The records of the allocations and frees on cpu go to the ring buffer of
+  // output_fd, opened with bpf_output_event_open.
+  bool SetOutput(int32_t cpu, int output_fd);
+
+  // Loads the entry program of function for cpu, and attaches it to
+  // uprobes_fd, opened with uprobes_stack_event_open on that cpu. The programs
+  // of a uprobe run for the events of all cores, so each only counts the
+  // allocations of its own.
+  bool AttachAllocationUprobes(int uprobes_fd, AllocationFunction function,
+                               int32_t cpu);
+  // The return program runs whatever the cpu of the event: the uretprobes of
+  // each allocation function, and the uprobes of free, are opened once.
+  bool AttachAllocationUretprobes(int uretprobes_fd);
+  bool AttachFreeUprobes(int uprobes_fd);
+
+  // The intervals the programs draw from uniformly: the quantiles of the
+  // exponential distribution of mean sampling_interval_bytes, at least 1.
+  static std::vector<uint64_t> ComputeSamplingIntervals(
+      uint64_t sampling_interval_bytes);
+
+ private:
+  BpfHeapProfiler() = default;
+  bool LoadUretprobesProgram();
+  bool LoadFreeProgram();
+
+  int pids_map_fd_ = -1;
+  int intervals_map_fd_ = -1;
+  int bytes_until_sample_map_fd_ = -1;
+  int open_allocations_map_fd_ = -1;
+  int sampled_blocks_map_fd_ = -1;
+  int outputs_map_fd_ = -1;
+  int uretprobes_program_fd_ = -1;
+  int free_program_fd_ = -1;
+  std::vector<int> uprobes_program_fds_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_BPF_HEAP_PROFILER_H_
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "BpfHeapProfiler.h"
+#include "Utils.h"
+
+namespace LinuxTracing {
+
+TEST(BpfHeapProfiler, ComputeSamplingIntervals) {
+  constexpr uint64_t kSamplingIntervalBytes = 512 * 1024;
+  std::vector<uint64_t> intervals =
+      BpfHeapProfiler::ComputeSamplingIntervals(kSamplingIntervalBytes);
+  ASSERT_EQ(intervals.size(), 256);
+  double mean = std::accumulate(intervals.begin(), intervals.end(), 0.0) /
+                intervals.size();
+  // The quantiles slightly underestimate the tail of the distribution.
+  EXPECT_NEAR(mean, kSamplingIntervalBytes, kSamplingIntervalBytes * 0.02);
+  for (size_t i = 1; i < intervals.size(); ++i) {
+    EXPECT_GE(intervals[i - 1], intervals[i]);
+  }
+  EXPECT_GE(intervals.back(), 1);
+
+  for (uint64_t interval : BpfHeapProfiler::ComputeSamplingIntervals(1)) {
+    EXPECT_GE(interval, 1);
+  }
+}
+
+TEST(BpfHeapProfiler, FindAllocatorOfThisProcess) {
+  std::optional<BpfHeapProfiler::Allocator> allocator =
+      BpfHeapProfiler::FindAllocator(ReadMaps(getpid()));
+  ASSERT_TRUE(allocator.has_value());
+  EXPECT_FALSE(allocator->path.empty());
+  EXPECT_NE(allocator->malloc_offset, 0);
+  EXPECT_NE(allocator->free_offset, 0);
+}
+
+TEST(BpfHeapProfiler, FindAllocatorWithoutAllocator) {
+  EXPECT_FALSE(BpfHeapProfiler::FindAllocator("").has_value());
+  EXPECT_FALSE(BpfHeapProfiler::FindAllocator(
+                   "7f0000000000-7f0000001000 r-xp 00000000 00:00 0 "
+                   "                 [vdso]\n")
+                   .has_value());
+}
+
+}  // namespace LinuxTracing
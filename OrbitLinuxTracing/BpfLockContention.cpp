@@ -0,0 +1,229 @@
+#include "BpfLockContention.h"
+
+#include <OrbitBase/Logging.h>
+#include <OrbitBase/SafeStrerror.h>
+#include <linux/futex.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+
+#include "Bpf.h"
+#include "PerfEventOpen.h"
+
+namespace LinuxTracing {
+
+namespace {
+
+// The threads that can wait on a futex at the same time.
+constexpr uint32_t MAX_THREADS = 16384;
+
+// The context of the programs of the syscall tracepoints, as the kernel
+// passes it: the same offsets as in the format of the tracepoints.
+// The uaddr and op arguments of sys_enter_futex.
+constexpr int16_t CONTEXT_UADDR_OFFSET = 16;
+constexpr int16_t CONTEXT_OP_OFFSET = 24;
+
+// The value of the map of the open waits, keyed by thread.
+struct OpenWait {
+  uint64_t begin_timestamp_ns;
+  uint64_t lock_address;
+};
+
+// The stack offsets of the programs' variables, from the frame pointer r10.
+// The verifier wants them aligned.
+constexpr int16_t PID_OFFSET = -4;
+constexpr int16_t TID_OFFSET = -8;  // The key of the open waits map.
+// The entry program's.
+constexpr int16_t OPEN_WAIT_OFFSET = -24;
+// The exit program's.
+constexpr int16_t RECORD_OFFSET = -40;
+static_assert(sizeof(BpfLockContention::LockWaitRecord) == 28);
+
+int16_t FieldOffset(int16_t struct_offset, size_t field_offset) {
+  return static_cast<int16_t>(struct_offset + field_offset);
+}
+
+}  // namespace
+
+std::unique_ptr<BpfLockContention> BpfLockContention::Create(
+    const std::vector<pid_t>& pids, int32_t max_cpu,
+    uint64_t wait_threshold_ns) {
+  std::unique_ptr<BpfLockContention> bpf_lock_contention{
+      new BpfLockContention()};
+  bpf_lock_contention->pids_map_fd_ =
+      bpf_map_create(BPF_MAP_TYPE_HASH, sizeof(uint32_t), sizeof(uint8_t),
+                     std::max<uint32_t>(pids.size(), 1));
+  bpf_lock_contention->open_waits_map_fd_ = bpf_map_create(
+      BPF_MAP_TYPE_HASH, sizeof(uint32_t), sizeof(OpenWait), MAX_THREADS);
+  bpf_lock_contention->outputs_map_fd_ =
+      bpf_map_create(BPF_MAP_TYPE_PERF_EVENT_ARRAY, sizeof(uint32_t),
+                     sizeof(uint32_t), max_cpu + 1);
+  if (bpf_lock_contention->pids_map_fd_ < 0 ||
+      bpf_lock_contention->open_waits_map_fd_ < 0 ||
+      bpf_lock_contention->outputs_map_fd_ < 0) {
+    return nullptr;
+  }
+
+  for (pid_t pid : pids) {
+    uint32_t key = pid;
+    uint8_t value = 1;
+    if (!bpf_map_update_elem(bpf_lock_contention->pids_map_fd_, &key,
+                             &value)) {
+      ERROR("Adding pid %d to the eBPF map: %s", pid, SafeStrerror(errno));
+      return nullptr;
+    }
+  }
+
+  if (!bpf_lock_contention->LoadEnterProgram() ||
+      !bpf_lock_contention->LoadExitProgram(wait_threshold_ns)) {
+    return nullptr;
+  }
+  return bpf_lock_contention;
+}
+
+BpfLockContention::~BpfLockContention() {
+  for (int fd : {exit_program_fd_, enter_program_fd_, outputs_map_fd_,
+                 open_waits_map_fd_, pids_map_fd_}) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+bool BpfLockContention::SetOutput(int32_t cpu, int output_fd) {
+  uint32_t key = cpu;
+  uint32_t value = output_fd;
+  if (!bpf_map_update_elem(outputs_map_fd_, &key, &value)) {
+    ERROR("Setting the eBPF output of cpu %d: %s", cpu, SafeStrerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool BpfLockContention::LoadEnterProgram() {
+  enum { WAIT, EXIT };
+
+  ProgramBuilder program;
+  program.MovReg(BPF_REG_6, BPF_REG_1);  // The context.
+  // Wakes, requeues and unlocks don't block.
+  program.Load64(BPF_REG_1, BPF_REG_6, CONTEXT_OP_OFFSET);
+  program.AluImm(BPF_AND, BPF_REG_1, FUTEX_CMD_MASK);
+  program.JumpIfImm(BPF_JEQ, BPF_REG_1, FUTEX_WAIT, WAIT);
+  program.JumpIfImm(BPF_JEQ, BPF_REG_1, FUTEX_WAIT_BITSET, WAIT);
+  program.JumpIfImm(BPF_JEQ, BPF_REG_1, FUTEX_LOCK_PI, WAIT);
+  program.Jump(EXIT);
+
+  // Only the waits of the target processes are recorded.
+  program.Bind(WAIT);
+  program.Call(BPF_FUNC_get_current_pid_tgid);
+  program.MovReg(BPF_REG_7, BPF_REG_0);  // tgid << 32 | tid.
+  program.AluImm(BPF_RSH, BPF_REG_0, 32);
+  program.Store32(BPF_REG_10, PID_OFFSET, BPF_REG_0);
+  program.LoadMapFd(BPF_REG_1, pids_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, PID_OFFSET);
+  program.Call(BPF_FUNC_map_lookup_elem);
+  program.JumpIfZero(BPF_REG_0, EXIT);
+
+  program.Store32(BPF_REG_10, TID_OFFSET, BPF_REG_7);
+  program.Load64(BPF_REG_1, BPF_REG_6, CONTEXT_UADDR_OFFSET);
+  program.Store64(
+      BPF_REG_10,
+      FieldOffset(OPEN_WAIT_OFFSET, offsetof(OpenWait, lock_address)),
+      BPF_REG_1);
+  program.Call(BPF_FUNC_ktime_get_ns);  // CLOCK_MONOTONIC, like perf_events.
+  program.Store64(BPF_REG_10,
+                  FieldOffset(OPEN_WAIT_OFFSET,
+                              offsetof(OpenWait, begin_timestamp_ns)),
+                  BPF_REG_0);
+  // A thread waits on one futex at a time, so the entry replaces any left by
+  // a wait whose exit was missed.
+  program.LoadMapFd(BPF_REG_1, open_waits_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, TID_OFFSET);
+  program.MovReg(BPF_REG_3, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_3, OPEN_WAIT_OFFSET);
+  program.MovImm(BPF_REG_4, BPF_ANY);
+  program.Call(BPF_FUNC_map_update_elem);
+
+  // Returning 0 drops the record of the tracepoint.
+  program.Bind(EXIT);
+  program.MovImm(BPF_REG_0, 0);
+  program.Exit();
+
+  enter_program_fd_ = bpf_prog_load(BPF_PROG_TYPE_TRACEPOINT, program.Build());
+  return enter_program_fd_ >= 0;
+}
+
+bool BpfLockContention::LoadExitProgram(uint64_t wait_threshold_ns) {
+  enum { EXIT };
+  auto record_field = [](size_t field_offset) {
+    return FieldOffset(RECORD_OFFSET, field_offset);
+  };
+
+  ProgramBuilder program;
+  program.MovReg(BPF_REG_6, BPF_REG_1);  // The context.
+  program.Call(BPF_FUNC_ktime_get_ns);
+  program.MovReg(BPF_REG_8, BPF_REG_0);
+  program.Store64(BPF_REG_10,
+                  record_field(offsetof(LockWaitRecord, end_timestamp_ns)),
+                  BPF_REG_0);
+
+  // Only the threads of the targets in a wait are in the map.
+  program.Call(BPF_FUNC_get_current_pid_tgid);
+  program.Store32(BPF_REG_10, TID_OFFSET, BPF_REG_0);
+  program.Store32(BPF_REG_10, record_field(offsetof(LockWaitRecord, tid)),
+                  BPF_REG_0);
+  program.LoadMapFd(BPF_REG_1, open_waits_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, TID_OFFSET);
+  program.Call(BPF_FUNC_map_lookup_elem);
+  program.JumpIfZero(BPF_REG_0, EXIT);
+  program.Load64(BPF_REG_7, BPF_REG_0, offsetof(OpenWait, begin_timestamp_ns));
+  program.Store64(BPF_REG_10,
+                  record_field(offsetof(LockWaitRecord, begin_timestamp_ns)),
+                  BPF_REG_7);
+  program.Load64(BPF_REG_1, BPF_REG_0, offsetof(OpenWait, lock_address));
+  program.Store64(BPF_REG_10,
+                  record_field(offsetof(LockWaitRecord, lock_address)),
+                  BPF_REG_1);
+  program.LoadMapFd(BPF_REG_1, open_waits_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, TID_OFFSET);
+  program.Call(BPF_FUNC_map_delete_elem);
+
+  // The short waits are dropped, and so are their stacks.
+  program.AluReg(BPF_SUB, BPF_REG_8, BPF_REG_7);
+  program.MovImm64(BPF_REG_1, wait_threshold_ns);
+  program.JumpIfReg(BPF_JGT, BPF_REG_1, BPF_REG_8, EXIT);
+
+  program.MovReg(BPF_REG_1, BPF_REG_6);
+  program.LoadMapFd(BPF_REG_2, outputs_map_fd_);
+  program.MovImm64(BPF_REG_3, BPF_F_CURRENT_CPU);
+  program.MovReg(BPF_REG_4, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_4, RECORD_OFFSET);
+  program.MovImm(BPF_REG_5, sizeof(LockWaitRecord));
+  program.Call(BPF_FUNC_perf_event_output);
+  // Returning 1 keeps the record of the tracepoint, with the stack.
+  program.MovImm(BPF_REG_0, 1);
+  program.Exit();
+
+  program.Bind(EXIT);
+  program.MovImm(BPF_REG_0, 0);
+  program.Exit();
+
+  exit_program_fd_ = bpf_prog_load(BPF_PROG_TYPE_TRACEPOINT, program.Build());
+  return exit_program_fd_ >= 0;
+}
+
+bool BpfLockContention::AttachEnterProgram(int tracepoint_fd) {
+  return perf_event_set_bpf(tracepoint_fd, enter_program_fd_);
+}
+
+bool BpfLockContention::AttachExitProgram(int tracepoint_fd) {
+  return perf_event_set_bpf(tracepoint_fd, exit_program_fd_);
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,72 @@
+#ifndef ORBIT_LINUX_TRACING_BPF_LOCK_CONTENTION_H_
+#define ORBIT_LINUX_TRACING_BPF_LOCK_CONTENTION_H_
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace LinuxTracing {
+
+// Reports the long futex waits of the target processes, with eBPF programs
+// attached to the syscalls:sys_enter_futex and syscalls:sys_exit_futex
+// tracepoints. The pthread mutexes, rwlocks and condition variables, and
+// std::mutex on top of them, only enter the kernel to wait when contended,
+// so uncontended locking costs nothing. The entry program filters the threads
+// by process and keeps the time and the address of the waits (FUTEX_WAIT,
+// FUTEX_WAIT_BITSET and FUTEX_LOCK_PI) in a map of the thread. The exit
+// program drops the waits shorter than the threshold. For the others, it
+// writes a LockWaitRecord to the ring buffer of the bpf-output event of the
+// cpu, and returns 1, so that the events of sys_exit_futex opened with
+// tracepoint_stack_event_open copy the user stack of the thread, which
+// follows the record.
+class BpfLockContention {
+ public:
+  // What the exit program writes with bpf_perf_event_output.
+  struct __attribute__((__packed__)) LockWaitRecord {
+    uint64_t begin_timestamp_ns;
+    uint64_t end_timestamp_ns;
+    // The first argument of the syscall, the address of the futex word.
+    uint64_t lock_address;
+    uint32_t tid;
+  };
+
+  // Creates the maps and loads the programs, for the waits of the threads of
+  // pids on the cores up to max_cpu lasting at least wait_threshold_ns.
+  // nullptr on error, e.g., without CAP_SYS_ADMIN or on kernels older than
+  // 4.14.
+  static std::unique_ptr<BpfLockContention> Create(
+      const std::vector<pid_t>& pids, int32_t max_cpu,
+      uint64_t wait_threshold_ns);
+
+  ~BpfLockContention();
+  BpfLockContention(const BpfLockContention&) = delete;
+  BpfLockContention& operator=(const BpfLockContention&) = delete;
+
+  // The records of the waits ending on cpu go to the ring buffer of
+  // output_fd, opened with bpf_output_event_open.
+  bool SetOutput(int32_t cpu, int output_fd);
+
+  // The programs of a tracepoint run for the events of all cores, and their
+  // return value applies to all the events of the tracepoint, so each is
+  // attached once: the entry program to a sys_enter_futex event, the exit
+  // program to one of the sys_exit_futex events with stacks.
+  bool AttachEnterProgram(int tracepoint_fd);
+  bool AttachExitProgram(int tracepoint_fd);
+
+ private:
+  BpfLockContention() = default;
+  bool LoadEnterProgram();
+  bool LoadExitProgram(uint64_t wait_threshold_ns);
+
+  int pids_map_fd_ = -1;
+  int open_waits_map_fd_ = -1;
+  int outputs_map_fd_ = -1;
+  int enter_program_fd_ = -1;
+  int exit_program_fd_ = -1;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_BPF_LOCK_CONTENTION_H_
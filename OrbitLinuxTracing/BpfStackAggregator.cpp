@@ -0,0 +1,248 @@
+#include "BpfStackAggregator.h"
+
+#include <OrbitBase/Logging.h>
+#include <OrbitBase/SafeStrerror.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <optional>
+
+#include "Bpf.h"
+#include "PerfEventOpen.h"
+#include "Utils.h"
+#include "absl/container/node_hash_map.h"
+
+namespace LinuxTracing {
+
+namespace {
+
+// The callstacks the stack trace map can hold between two drains.
+constexpr uint32_t MAX_STACKS = 8192;
+// The (thread, callstack) pairs the counts map can hold between two drains.
+constexpr uint32_t MAX_COUNTS = 16384;
+
+// The key of the counts map, as the program writes it.
+struct CountKey {
+  uint32_t pid;
+  uint32_t tid;
+  int32_t kernel_stack_id;
+  int32_t user_stack_id;
+};
+
+}  // namespace
+
+std::unique_ptr<BpfStackAggregator> BpfStackAggregator::Create(
+    const std::vector<pid_t>& pids) {
+  std::unique_ptr<BpfStackAggregator> aggregator{new BpfStackAggregator()};
+  aggregator->pids_map_fd_ =
+      bpf_map_create(BPF_MAP_TYPE_HASH, sizeof(uint32_t), sizeof(uint8_t),
+                     std::max<uint32_t>(pids.size(), 1));
+  aggregator->stacks_map_fd_ =
+      bpf_map_create(BPF_MAP_TYPE_STACK_TRACE, sizeof(uint32_t),
+                     MAX_STACK_DEPTH * sizeof(uint64_t), MAX_STACKS);
+  aggregator->counts_map_fd_ = bpf_map_create(
+      BPF_MAP_TYPE_HASH, sizeof(CountKey), sizeof(uint64_t), MAX_COUNTS);
+  if (aggregator->pids_map_fd_ < 0 || aggregator->stacks_map_fd_ < 0 ||
+      aggregator->counts_map_fd_ < 0) {
+    return nullptr;
+  }
+
+  for (pid_t pid : pids) {
+    uint32_t key = pid;
+    uint8_t value = 1;
+    if (!bpf_map_update_elem(aggregator->pids_map_fd_, &key, &value)) {
+      ERROR("Adding pid %d to the eBPF map: %s", pid, SafeStrerror(errno));
+      return nullptr;
+    }
+  }
+
+  if (!aggregator->LoadProgram()) {
+    return nullptr;
+  }
+  aggregator->last_drain_timestamp_ns_ = MonotonicTimestampNs();
+  return aggregator;
+}
+
+BpfStackAggregator::~BpfStackAggregator() {
+  for (int fd : {program_fd_, counts_map_fd_, stacks_map_fd_, pids_map_fd_}) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+bool BpfStackAggregator::LoadProgram() {
+  // The stack offsets of the program's variables, from the frame pointer r10.
+  constexpr int16_t KEY_OFFSET = -16;  // The CountKey, and the pid before.
+  constexpr int16_t PID_OFFSET = -4;
+  constexpr int16_t ONE_OFFSET = -24;  // The initial count.
+  enum { EXIT, INSERT };
+  auto key_field = [](size_t field_offset) {
+    return static_cast<int16_t>(KEY_OFFSET + field_offset);
+  };
+
+  ProgramBuilder program;
+  program.MovReg(BPF_REG_6, BPF_REG_1);  // The context, for bpf_get_stackid.
+
+  // Only the samples of the target processes are counted.
+  program.Call(BPF_FUNC_get_current_pid_tgid);
+  program.MovReg(BPF_REG_7, BPF_REG_0);  // tgid << 32 | tid.
+  program.AluImm(BPF_RSH, BPF_REG_0, 32);
+  program.Store32(BPF_REG_10, PID_OFFSET, BPF_REG_0);
+  program.LoadMapFd(BPF_REG_1, pids_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, PID_OFFSET);
+  program.Call(BPF_FUNC_map_lookup_elem);
+  program.JumpIfZero(BPF_REG_0, EXIT);
+
+  program.MovReg(BPF_REG_1, BPF_REG_7);
+  program.AluImm(BPF_RSH, BPF_REG_1, 32);
+  program.Store32(BPF_REG_10, key_field(offsetof(CountKey, pid)), BPF_REG_1);
+  program.Store32(BPF_REG_10, key_field(offsetof(CountKey, tid)), BPF_REG_7);
+  // Negative stack ids, e.g., for no kernel callchain, are kept as they are.
+  program.MovReg(BPF_REG_1, BPF_REG_6);
+  program.LoadMapFd(BPF_REG_2, stacks_map_fd_);
+  program.MovImm(BPF_REG_3, 0);
+  program.Call(BPF_FUNC_get_stackid);
+  program.Store32(BPF_REG_10, key_field(offsetof(CountKey, kernel_stack_id)),
+                  BPF_REG_0);
+  program.MovReg(BPF_REG_1, BPF_REG_6);
+  program.LoadMapFd(BPF_REG_2, stacks_map_fd_);
+  program.MovImm(BPF_REG_3, BPF_F_USER_STACK);
+  program.Call(BPF_FUNC_get_stackid);
+  program.Store32(BPF_REG_10, key_field(offsetof(CountKey, user_stack_id)),
+                  BPF_REG_0);
+
+  program.LoadMapFd(BPF_REG_1, counts_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, KEY_OFFSET);
+  program.Call(BPF_FUNC_map_lookup_elem);
+  program.JumpIfZero(BPF_REG_0, INSERT);
+  program.MovImm(BPF_REG_1, 1);
+  program.AtomicAdd64(BPF_REG_0, 0, BPF_REG_1);
+  program.Jump(EXIT);
+
+  program.Bind(INSERT);
+  program.Store64Imm(BPF_REG_10, ONE_OFFSET, 1);
+  program.LoadMapFd(BPF_REG_1, counts_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, KEY_OFFSET);
+  program.MovReg(BPF_REG_3, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_3, ONE_OFFSET);
+  program.MovImm(BPF_REG_4, BPF_NOEXIST);
+  program.Call(BPF_FUNC_map_update_elem);
+
+  // Returning 0 drops the sample instead of writing it to a ring buffer.
+  program.Bind(EXIT);
+  program.MovImm(BPF_REG_0, 0);
+  program.Exit();
+
+  program_fd_ = bpf_prog_load(BPF_PROG_TYPE_PERF_EVENT, program.Build());
+  return program_fd_ >= 0;
+}
+
+bool BpfStackAggregator::Attach(int perf_event_fd) {
+  return perf_event_set_bpf(perf_event_fd, program_fd_);
+}
+
+bool BpfStackAggregator::LookupStack(int32_t stack_id,
+                                     std::vector<uint64_t>* ips) {
+  ips->assign(MAX_STACK_DEPTH, 0);
+  if (stack_id < 0) {
+    // No callchain, e.g., a user thread sampled in user space has no kernel
+    // callchain.
+    ips->clear();
+    return true;
+  }
+  return bpf_map_lookup_elem(stacks_map_fd_, &stack_id, ips->data());
+}
+
+std::vector<CallstackCount> BpfStackAggregator::Drain() {
+  uint64_t timestamp_ns = MonotonicTimestampNs();
+
+  // Keys are listed before being deleted, as deleting the current key
+  // restarts the iteration from the beginning.
+  std::vector<CountKey> keys;
+  CountKey key;
+  CountKey next_key;
+  bool has_key = false;
+  while (bpf_map_get_next_key(counts_map_fd_, has_key ? &key : nullptr,
+                              &next_key)) {
+    keys.push_back(next_key);
+    key = next_key;
+    has_key = true;
+  }
+
+  // Empty for the callchains that were evicted from the stack trace map. The
+  // references get_stack returns must survive the next insertions.
+  absl::node_hash_map<int32_t, std::optional<std::vector<uint64_t>>> stacks;
+  auto get_stack = [this, &stacks](int32_t stack_id)
+      -> const std::optional<std::vector<uint64_t>>& {
+    auto it = stacks.find(stack_id);
+    if (it == stacks.end()) {
+      std::vector<uint64_t> ips;
+      std::optional<std::vector<uint64_t>> stack;
+      if (LookupStack(stack_id, &ips)) {
+        stack = std::move(ips);
+      }
+      it = stacks.emplace(stack_id, std::move(stack)).first;
+    }
+    return it->second;
+  };
+
+  std::vector<CallstackCount> callstack_counts;
+  callstack_counts.reserve(keys.size());
+  for (const CountKey& count_key : keys) {
+    uint64_t count = 0;
+    if (!bpf_map_lookup_elem(counts_map_fd_, &count_key, &count)) {
+      continue;
+    }
+    // The samples counted in between are lost.
+    bpf_map_delete_elem(counts_map_fd_, &count_key);
+    const std::optional<std::vector<uint64_t>>& kernel_ips =
+        get_stack(count_key.kernel_stack_id);
+    const std::optional<std::vector<uint64_t>>& user_ips =
+        get_stack(count_key.user_stack_id);
+    if (!kernel_ips.has_value() || !user_ips.has_value()) {
+      lost_count_ += count;
+      continue;
+    }
+    Callstack callstack = CallstackFromStackIps(
+        count_key.tid, kernel_ips.value(), user_ips.value(), timestamp_ns);
+    if (callstack.GetFrames().empty()) {
+      lost_count_ += count;
+      continue;
+    }
+    callstack_counts.emplace_back(std::move(callstack), count,
+                                  last_drain_timestamp_ns_);
+  }
+
+  // Frees the stack trace map for the next callstacks.
+  for (const auto& [stack_id, stack] : stacks) {
+    if (stack_id >= 0) {
+      bpf_map_delete_elem(stacks_map_fd_, &stack_id);
+    }
+  }
+  last_drain_timestamp_ns_ = timestamp_ns;
+  return callstack_counts;
+}
+
+Callstack BpfStackAggregator::CallstackFromStackIps(
+    pid_t tid, absl::Span<const uint64_t> kernel_ips,
+    absl::Span<const uint64_t> user_ips, uint64_t timestamp_ns) {
+  std::vector<CallstackFrame> frames;
+  for (absl::Span<const uint64_t> ips : {kernel_ips, user_ips}) {
+    for (uint64_t ip : ips) {
+      if (ip == 0) {
+        break;
+      }
+      // Function names are resolved from the symbols later.
+      frames.emplace_back(ip, "", 0, "");
+    }
+  }
+  return Callstack{tid, std::move(frames), timestamp_ns};
+}
+
+}  // namespace LinuxTracing
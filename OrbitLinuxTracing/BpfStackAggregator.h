@@ -0,0 +1,70 @@
+#ifndef ORBIT_LINUX_TRACING_BPF_STACK_AGGREGATOR_H_
+#define ORBIT_LINUX_TRACING_BPF_STACK_AGGREGATOR_H_
+
+#include <OrbitLinuxTracing/Events.h>
+#include <sys/types.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/types/span.h"
+
+namespace LinuxTracing {
+
+// Counts the callstacks of stack samples in the kernel, with an eBPF program
+// attached to the sampling events (see bpf_sample_event_open), instead of
+// copying each sample to a ring buffer. The program collects the kernel and
+// user callchains of the samples of the target processes into a stack trace
+// map, by following frame pointers like PERF_SAMPLE_CALLCHAIN, and counts the
+// samples per thread and pair of callchains in a hash map, which Drain reads
+// and empties. Only the callstacks of targets built with
+// -fno-omit-frame-pointer are correct.
+class BpfStackAggregator {
+ public:
+  // Maximum number of frames of each of the kernel and user callchains, the
+  // default of /proc/sys/kernel/perf_event_max_stack.
+  static constexpr uint32_t MAX_STACK_DEPTH = 127;
+
+  // Creates the maps and loads the program, for the samples of pids only.
+  // nullptr on error, e.g., without CAP_SYS_ADMIN or on kernels older than 4.9.
+  static std::unique_ptr<BpfStackAggregator> Create(
+      const std::vector<pid_t>& pids);
+
+  ~BpfStackAggregator();
+  BpfStackAggregator(const BpfStackAggregator&) = delete;
+  BpfStackAggregator& operator=(const BpfStackAggregator&) = delete;
+
+  // Runs the program on the samples of the event from then on.
+  bool Attach(int perf_event_fd);
+
+  // The callstacks counted since the previous call, timestamped now. Samples
+  // counted while draining can be lost, as can the ones whose callchains were
+  // evicted by others in the stack trace map, see GetLostCount.
+  std::vector<CallstackCount> Drain();
+  uint64_t GetLostCount() const { return lost_count_; }
+
+  // Kernel frames first, then user frames, innermost first, like the
+  // callchains of CallchainSamplePerfEvent. The ips of a callchain end at the
+  // first zero, or after MAX_STACK_DEPTH.
+  static Callstack CallstackFromStackIps(pid_t tid,
+                                         absl::Span<const uint64_t> kernel_ips,
+                                         absl::Span<const uint64_t> user_ips,
+                                         uint64_t timestamp_ns);
+
+ private:
+  BpfStackAggregator() = default;
+  bool LoadProgram();
+  bool LookupStack(int32_t stack_id, std::vector<uint64_t>* ips);
+
+  int pids_map_fd_ = -1;
+  int stacks_map_fd_ = -1;
+  int counts_map_fd_ = -1;
+  int program_fd_ = -1;
+  uint64_t last_drain_timestamp_ns_ = 0;
+  uint64_t lost_count_ = 0;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_BPF_STACK_AGGREGATOR_H_
@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "BpfStackAggregator.h"
+
+namespace LinuxTracing {
+
+TEST(BpfStackAggregator, CallstackFromStackIps) {
+  std::vector<uint64_t> kernel_ips{0xffff1, 0xffff2, 0, 0xdead};
+  std::vector<uint64_t> user_ips(BpfStackAggregator::MAX_STACK_DEPTH, 0);
+  user_ips[0] = 0x11;
+  user_ips[1] = 0x22;
+  user_ips[2] = 0x33;
+
+  Callstack callstack = BpfStackAggregator::CallstackFromStackIps(
+      42, kernel_ips, user_ips, 1000);
+  EXPECT_EQ(callstack.GetTid(), 42);
+  EXPECT_EQ(callstack.GetTimestampNs(), 1000);
+  std::vector<uint64_t> pcs;
+  for (const CallstackFrame& frame : callstack.GetFrames()) {
+    pcs.push_back(frame.GetPc());
+  }
+  EXPECT_EQ(pcs, (std::vector<uint64_t>{0xffff1, 0xffff2, 0x11, 0x22, 0x33}));
+}
+
+TEST(BpfStackAggregator, CallstackFromStackIpsWithoutKernelCallchain) {
+  std::vector<uint64_t> user_ips{0x11, 0x22};
+  Callstack callstack =
+      BpfStackAggregator::CallstackFromStackIps(42, {}, user_ips, 1000);
+  ASSERT_EQ(callstack.GetFrames().size(), 2);
+  EXPECT_EQ(callstack.GetFrames()[0].GetPc(), 0x11);
+
+  EXPECT_TRUE(BpfStackAggregator::CallstackFromStackIps(42, {}, {}, 1000)
+                  .GetFrames()
+                  .empty());
+}
+
+}  // namespace LinuxTracing
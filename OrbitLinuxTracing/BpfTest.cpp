@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "Bpf.h"
+
+namespace LinuxTracing {
+
+TEST(ProgramBuilder, ResolvesJumpsRelativeToTheNextInstruction) {
+  enum { FORWARD, BACKWARD };
+  ProgramBuilder program;
+  program.Bind(BACKWARD);
+  program.MovImm(BPF_REG_0, 0);
+  program.JumpIfZero(BPF_REG_0, FORWARD);
+  program.Jump(BACKWARD);
+  program.Bind(FORWARD);
+  program.Exit();
+
+  std::vector<bpf_insn> insns = program.Build();
+  ASSERT_EQ(insns.size(), 4);
+  EXPECT_EQ(insns[1].code, BPF_JMP | BPF_JEQ | BPF_K);
+  EXPECT_EQ(insns[1].off, 1);
+  EXPECT_EQ(insns[2].code, BPF_JMP | BPF_JA);
+  EXPECT_EQ(insns[2].off, -3);
+}
+
+TEST(ProgramBuilder, ComparesRegisters) {
+  enum { EXIT };
+  ProgramBuilder program;
+  program.JumpIfReg(BPF_JGT, BPF_REG_1, BPF_REG_2, EXIT);
+  program.MovImm(BPF_REG_0, 1);
+  program.Bind(EXIT);
+  program.Exit();
+
+  std::vector<bpf_insn> insns = program.Build();
+  ASSERT_EQ(insns.size(), 3);
+  EXPECT_EQ(insns[0].code, BPF_JMP | BPF_JGT | BPF_X);
+  EXPECT_EQ(insns[0].dst_reg, BPF_REG_1);
+  EXPECT_EQ(insns[0].src_reg, BPF_REG_2);
+  EXPECT_EQ(insns[0].off, 1);
+}
+
+TEST(ProgramBuilder, SplitsWideImmediatesOverTwoInstructions) {
+  ProgramBuilder program;
+  program.MovImm64(BPF_REG_1, 0x1234567890abcdef);
+  program.LoadMapFd(BPF_REG_2, 42);
+
+  std::vector<bpf_insn> insns = program.Build();
+  ASSERT_EQ(insns.size(), 4);
+  EXPECT_EQ(insns[0].code, BPF_LD | BPF_DW | BPF_IMM);
+  EXPECT_EQ(insns[0].dst_reg, BPF_REG_1);
+  EXPECT_EQ(static_cast<uint32_t>(insns[0].imm), 0x90abcdef);
+  EXPECT_EQ(static_cast<uint32_t>(insns[1].imm), 0x12345678);
+  EXPECT_EQ(insns[2].src_reg, BPF_PSEUDO_MAP_FD);
+  EXPECT_EQ(insns[2].imm, 42);
+  EXPECT_EQ(insns[3].imm, 0);
+}
+
+}  // namespace LinuxTracing
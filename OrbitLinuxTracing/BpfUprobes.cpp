@@ -0,0 +1,294 @@
+#include "BpfUprobes.h"
+
+#include <OrbitBase/Logging.h>
+#include <OrbitBase/SafeStrerror.h>
+#include <asm/ptrace.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+
+#include "Bpf.h"
+#include "PerfEventOpen.h"
+
+namespace LinuxTracing {
+
+namespace {
+
+// The threads that can be in an instrumented function at the same time.
+constexpr uint32_t MAX_THREADS = 16384;
+// The calls that can be open at the same time, on all threads.
+constexpr uint32_t MAX_OPEN_CALLS = 65536;
+
+// The key and the value of the map of the open calls, as the programs use
+// them.
+struct OpenCallKey {
+  uint32_t tid;
+  uint32_t depth;
+};
+struct OpenCall {
+  uint64_t begin_timestamp_ns;
+  uint64_t function_address;
+};
+
+// The stack offsets of the programs' variables, from the frame pointer r10.
+constexpr int16_t PID_OFFSET = -4;
+constexpr int16_t TID_OFFSET = -8;  // The key of the depths map.
+constexpr int16_t KEY_OFFSET = -16;
+// The entry program's.
+constexpr int16_t OPEN_CALL_OFFSET = -32;
+constexpr int16_t DEPTH_OFFSET = -36;
+// The return program's.
+constexpr int16_t RECORD_OFFSET = -56;
+
+int16_t FieldOffset(int16_t struct_offset, size_t field_offset) {
+  return static_cast<int16_t>(struct_offset + field_offset);
+}
+
+}  // namespace
+
+std::unique_ptr<BpfUprobes> BpfUprobes::Create(const std::vector<pid_t>& pids,
+                                               int32_t max_cpu) {
+  std::unique_ptr<BpfUprobes> bpf_uprobes{new BpfUprobes()};
+  bpf_uprobes->pids_map_fd_ =
+      bpf_map_create(BPF_MAP_TYPE_HASH, sizeof(uint32_t), sizeof(uint8_t),
+                     std::max<uint32_t>(pids.size(), 1));
+  bpf_uprobes->depths_map_fd_ = bpf_map_create(
+      BPF_MAP_TYPE_HASH, sizeof(uint32_t), sizeof(uint32_t), MAX_THREADS);
+  bpf_uprobes->open_calls_map_fd_ = bpf_map_create(
+      BPF_MAP_TYPE_HASH, sizeof(OpenCallKey), sizeof(OpenCall), MAX_OPEN_CALLS);
+  bpf_uprobes->outputs_map_fd_ =
+      bpf_map_create(BPF_MAP_TYPE_PERF_EVENT_ARRAY, sizeof(uint32_t),
+                     sizeof(uint32_t), max_cpu + 1);
+  if (bpf_uprobes->pids_map_fd_ < 0 || bpf_uprobes->depths_map_fd_ < 0 ||
+      bpf_uprobes->open_calls_map_fd_ < 0 ||
+      bpf_uprobes->outputs_map_fd_ < 0) {
+    return nullptr;
+  }
+
+  for (pid_t pid : pids) {
+    uint32_t key = pid;
+    uint8_t value = 1;
+    if (!bpf_map_update_elem(bpf_uprobes->pids_map_fd_, &key, &value)) {
+      ERROR("Adding pid %d to the eBPF map: %s", pid, SafeStrerror(errno));
+      return nullptr;
+    }
+  }
+
+  if (!bpf_uprobes->LoadUretprobesProgram()) {
+    return nullptr;
+  }
+  return bpf_uprobes;
+}
+
+BpfUprobes::~BpfUprobes() {
+  for (const auto& [function_address, program_fd] : uprobes_program_fds_) {
+    close(program_fd);
+  }
+  for (int fd : {uretprobes_program_fd_, outputs_map_fd_, open_calls_map_fd_,
+                 depths_map_fd_, pids_map_fd_}) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+bool BpfUprobes::SetOutput(int32_t cpu, int output_fd) {
+  uint32_t key = cpu;
+  uint32_t value = output_fd;
+  if (!bpf_map_update_elem(outputs_map_fd_, &key, &value)) {
+    ERROR("Setting the eBPF output of cpu %d: %s", cpu, SafeStrerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool BpfUprobes::LoadUprobesProgram(uint64_t function_address) {
+  if (uprobes_program_fds_.contains(function_address)) {
+    return true;
+  }
+  enum { EXIT, PUSH };
+
+  ProgramBuilder program;
+  // Only the calls of the target processes are recorded.
+  program.Call(BPF_FUNC_get_current_pid_tgid);
+  program.MovReg(BPF_REG_7, BPF_REG_0);  // tgid << 32 | tid.
+  program.AluImm(BPF_RSH, BPF_REG_0, 32);
+  program.Store32(BPF_REG_10, PID_OFFSET, BPF_REG_0);
+  program.LoadMapFd(BPF_REG_1, pids_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, PID_OFFSET);
+  program.Call(BPF_FUNC_map_lookup_elem);
+  program.JumpIfZero(BPF_REG_0, EXIT);
+
+  // The depth of the call is the number of calls open on the thread.
+  program.Store32(BPF_REG_10, TID_OFFSET, BPF_REG_7);
+  program.LoadMapFd(BPF_REG_1, depths_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, TID_OFFSET);
+  program.Call(BPF_FUNC_map_lookup_elem);
+  program.MovImm(BPF_REG_8, 0);
+  program.JumpIfZero(BPF_REG_0, PUSH);
+  program.Load32(BPF_REG_8, BPF_REG_0, 0);
+  program.Bind(PUSH);
+  program.JumpIfImm(BPF_JGE, BPF_REG_8, MAX_DEPTH, EXIT);
+
+  program.Store32(BPF_REG_10,
+                  FieldOffset(KEY_OFFSET, offsetof(OpenCallKey, tid)),
+                  BPF_REG_7);
+  program.Store32(BPF_REG_10,
+                  FieldOffset(KEY_OFFSET, offsetof(OpenCallKey, depth)),
+                  BPF_REG_8);
+  program.Call(BPF_FUNC_ktime_get_ns);  // CLOCK_MONOTONIC, like perf_events.
+  program.Store64(
+      BPF_REG_10,
+      FieldOffset(OPEN_CALL_OFFSET, offsetof(OpenCall, begin_timestamp_ns)),
+      BPF_REG_0);
+  program.MovImm64(BPF_REG_1, function_address);
+  program.Store64(
+      BPF_REG_10,
+      FieldOffset(OPEN_CALL_OFFSET, offsetof(OpenCall, function_address)),
+      BPF_REG_1);
+  program.LoadMapFd(BPF_REG_1, open_calls_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, KEY_OFFSET);
+  program.MovReg(BPF_REG_3, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_3, OPEN_CALL_OFFSET);
+  program.MovImm(BPF_REG_4, BPF_ANY);
+  program.Call(BPF_FUNC_map_update_elem);
+  program.JumpIfImm(BPF_JNE, BPF_REG_0, 0, EXIT);
+
+  program.AluImm(BPF_ADD, BPF_REG_8, 1);
+  program.Store32(BPF_REG_10, DEPTH_OFFSET, BPF_REG_8);
+  program.LoadMapFd(BPF_REG_1, depths_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, TID_OFFSET);
+  program.MovReg(BPF_REG_3, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_3, DEPTH_OFFSET);
+  program.MovImm(BPF_REG_4, BPF_ANY);
+  program.Call(BPF_FUNC_map_update_elem);
+
+  // Returning 0 drops the record of the uprobe.
+  program.Bind(EXIT);
+  program.MovImm(BPF_REG_0, 0);
+  program.Exit();
+
+  int program_fd = bpf_prog_load(BPF_PROG_TYPE_KPROBE, program.Build());
+  if (program_fd < 0) {
+    return false;
+  }
+  uprobes_program_fds_.emplace(function_address, program_fd);
+  return true;
+}
+
+bool BpfUprobes::LoadUretprobesProgram() {
+  enum { EXIT, KEEP_DEPTH };
+  auto record_field = [](size_t field_offset) {
+    return FieldOffset(RECORD_OFFSET, field_offset);
+  };
+
+  ProgramBuilder program;
+  program.MovReg(BPF_REG_6, BPF_REG_1);  // The context, the user registers.
+  program.Call(BPF_FUNC_ktime_get_ns);
+  program.Store64(BPF_REG_10,
+                  record_field(offsetof(FunctionCallRecord, end_timestamp_ns)),
+                  BPF_REG_0);
+  program.Load64(BPF_REG_1, BPF_REG_6, offsetof(pt_regs, rax));
+  program.Store64(BPF_REG_10,
+                  record_field(offsetof(FunctionCallRecord, return_value)),
+                  BPF_REG_1);
+
+  // Only the threads with open calls are in the depths map.
+  program.Call(BPF_FUNC_get_current_pid_tgid);
+  program.MovReg(BPF_REG_7, BPF_REG_0);
+  program.Store32(BPF_REG_10, TID_OFFSET, BPF_REG_7);
+  program.LoadMapFd(BPF_REG_1, depths_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, TID_OFFSET);
+  program.Call(BPF_FUNC_map_lookup_elem);
+  program.JumpIfZero(BPF_REG_0, EXIT);
+  program.Load32(BPF_REG_8, BPF_REG_0, 0);
+  program.JumpIfZero(BPF_REG_8, EXIT);
+  program.AluImm(BPF_SUB, BPF_REG_8, 1);
+  program.Store32(BPF_REG_0, 0, BPF_REG_8);
+  // Threads leave the map with their last open call.
+  program.JumpIfImm(BPF_JNE, BPF_REG_8, 0, KEEP_DEPTH);
+  program.LoadMapFd(BPF_REG_1, depths_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, TID_OFFSET);
+  program.Call(BPF_FUNC_map_delete_elem);
+  program.Bind(KEEP_DEPTH);
+
+  program.Store32(BPF_REG_10,
+                  FieldOffset(KEY_OFFSET, offsetof(OpenCallKey, tid)),
+                  BPF_REG_7);
+  program.Store32(BPF_REG_10,
+                  FieldOffset(KEY_OFFSET, offsetof(OpenCallKey, depth)),
+                  BPF_REG_8);
+  program.LoadMapFd(BPF_REG_1, open_calls_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, KEY_OFFSET);
+  program.Call(BPF_FUNC_map_lookup_elem);
+  program.JumpIfZero(BPF_REG_0, EXIT);
+  program.Load64(BPF_REG_1, BPF_REG_0, offsetof(OpenCall, begin_timestamp_ns));
+  program.Store64(
+      BPF_REG_10,
+      record_field(offsetof(FunctionCallRecord, begin_timestamp_ns)),
+      BPF_REG_1);
+  program.Load64(BPF_REG_1, BPF_REG_0, offsetof(OpenCall, function_address));
+  program.Store64(BPF_REG_10,
+                  record_field(offsetof(FunctionCallRecord, function_address)),
+                  BPF_REG_1);
+  program.Store32(BPF_REG_10, record_field(offsetof(FunctionCallRecord, tid)),
+                  BPF_REG_7);
+  program.Store32(BPF_REG_10,
+                  record_field(offsetof(FunctionCallRecord, depth)),
+                  BPF_REG_8);
+  program.LoadMapFd(BPF_REG_1, open_calls_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, KEY_OFFSET);
+  program.Call(BPF_FUNC_map_delete_elem);
+
+  program.MovReg(BPF_REG_1, BPF_REG_6);
+  program.LoadMapFd(BPF_REG_2, outputs_map_fd_);
+  program.MovImm64(BPF_REG_3, BPF_F_CURRENT_CPU);
+  program.MovReg(BPF_REG_4, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_4, RECORD_OFFSET);
+  program.MovImm(BPF_REG_5, sizeof(FunctionCallRecord));
+  program.Call(BPF_FUNC_perf_event_output);
+
+  // Returning 0 drops the record of the uretprobe.
+  program.Bind(EXIT);
+  program.MovImm(BPF_REG_0, 0);
+  program.Exit();
+
+  uretprobes_program_fd_ =
+      bpf_prog_load(BPF_PROG_TYPE_KPROBE, program.Build());
+  return uretprobes_program_fd_ >= 0;
+}
+
+bool BpfUprobes::AttachUprobes(int uprobes_fd, uint64_t function_address) {
+  auto program_fd_it = uprobes_program_fds_.find(function_address);
+  if (program_fd_it == uprobes_program_fds_.end()) {
+    ERROR("No eBPF program for function at %#016lx", function_address);
+    return false;
+  }
+  return perf_event_set_bpf(uprobes_fd, program_fd_it->second);
+}
+
+bool BpfUprobes::AttachUretprobes(int uretprobes_fd) {
+  return perf_event_set_bpf(uretprobes_fd, uretprobes_program_fd_);
+}
+
+FunctionCall BpfUprobes::FunctionCallFromRecord(
+    const FunctionCallRecord& record) {
+  return FunctionCall{static_cast<pid_t>(record.tid),
+                      record.function_address,
+                      record.begin_timestamp_ns,
+                      record.end_timestamp_ns,
+                      record.depth,
+                      record.return_value};
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,74 @@
+#ifndef ORBIT_LINUX_TRACING_BPF_UPROBES_H_
+#define ORBIT_LINUX_TRACING_BPF_UPROBES_H_
+
+#include <OrbitLinuxTracing/Events.h>
+#include <sys/types.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+
+namespace LinuxTracing {
+
+// Pairs the uprobes and uretprobes of functions in the kernel, with eBPF
+// programs attached to them, instead of UprobesFunctionCallManager. The entry
+// program pushes the function and the time on a stack of the thread kept in a
+// map, the return program pops it and writes a single record per call, a
+// FunctionCallRecord, to the ring buffer of the bpf-output event of the cpu.
+// Both drop the records of the u(ret)probes themselves.
+class BpfUprobes {
+ public:
+  // What the return program writes with bpf_perf_event_output.
+  struct __attribute__((__packed__)) FunctionCallRecord {
+    uint64_t function_address;
+    uint64_t begin_timestamp_ns;
+    uint64_t end_timestamp_ns;
+    uint64_t return_value;
+    uint32_t tid;
+    uint32_t depth;
+  };
+
+  // Calls nested deeper on a thread are not recorded.
+  static constexpr uint32_t MAX_DEPTH = 256;
+
+  // Creates the maps and loads the return program, for the calls of the
+  // threads of pids on the cores up to max_cpu. nullptr on error, e.g.,
+  // without CAP_SYS_ADMIN or on kernels older than 4.9.
+  static std::unique_ptr<BpfUprobes> Create(const std::vector<pid_t>& pids,
+                                            int32_t max_cpu);
+
+  ~BpfUprobes();
+  BpfUprobes(const BpfUprobes&) = delete;
+  BpfUprobes& operator=(const BpfUprobes&) = delete;
+
+  // The records of the calls returning on cpu go to the ring buffer of
+  // output_fd, opened with bpf_output_event_open.
+  bool SetOutput(int32_t cpu, int output_fd);
+
+  // Loads the entry program of the function at function_address, once per
+  // function. Returns false on error, when nothing is attached yet.
+  bool LoadUprobesProgram(uint64_t function_address);
+  // With the program loaded by LoadUprobesProgram.
+  bool AttachUprobes(int uprobes_fd, uint64_t function_address);
+  bool AttachUretprobes(int uretprobes_fd);
+
+  static FunctionCall FunctionCallFromRecord(const FunctionCallRecord& record);
+
+ private:
+  BpfUprobes() = default;
+  bool LoadUretprobesProgram();
+
+  int pids_map_fd_ = -1;
+  int depths_map_fd_ = -1;
+  int open_calls_map_fd_ = -1;
+  int outputs_map_fd_ = -1;
+  int uretprobes_program_fd_ = -1;
+  // Keyed by the function address baked into each program.
+  absl::flat_hash_map<uint64_t, int> uprobes_program_fds_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_BPF_UPROBES_H_
@@ -0,0 +1,27 @@
+#include <gtest/gtest.h>
+
+#include "BpfUprobes.h"
+
+namespace LinuxTracing {
+
+TEST(BpfUprobes, FunctionCallFromRecord) {
+  BpfUprobes::FunctionCallRecord record{};
+  record.function_address = 0x401000;
+  record.begin_timestamp_ns = 1000;
+  record.end_timestamp_ns = 1500;
+  record.return_value = 7;
+  record.tid = 42;
+  record.depth = 2;
+
+  FunctionCall function_call = BpfUprobes::FunctionCallFromRecord(record);
+  EXPECT_EQ(function_call.GetTid(), 42);
+  EXPECT_EQ(function_call.GetVirtualAddress(), 0x401000);
+  EXPECT_EQ(function_call.GetBeginTimestampNs(), 1000);
+  EXPECT_EQ(function_call.GetEndTimestampNs(), 1500);
+  EXPECT_EQ(function_call.GetDepth(), 2);
+  EXPECT_EQ(function_call.GetReturnValue(), 7);
+  EXPECT_TRUE(function_call.GetArguments().empty());
+  EXPECT_FALSE(function_call.GetPmuCounters().has_value());
+}
+
+}  // namespace LinuxTracing
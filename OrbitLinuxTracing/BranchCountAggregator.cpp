@@ -0,0 +1,45 @@
+#include "BranchCountAggregator.h"
+
+namespace LinuxTracing {
+
+void BranchCountAggregator::AddBranchStack(
+    absl::Span<const perf_branch_entry> entries, uint64_t timestamp_ns) {
+  if (begin_timestamp_ns_ == 0) {
+    begin_timestamp_ns_ = timestamp_ns;
+  }
+  for (size_t i = 0; i < entries.size(); ++i) {
+    // Entries of records the core didn't fill are zero.
+    if (entries[i].from == 0 || entries[i].to == 0) {
+      continue;
+    }
+    ++branches_[{entries[i].from, entries[i].to}];
+    if (!count_ranges_ || i + 1 == entries.size()) {
+      continue;
+    }
+    // The code from the target of the previous branch to this one ran
+    // straight.
+    uint64_t first = entries[i + 1].to;
+    uint64_t last = entries[i].from;
+    if (first != 0 && first <= last && last - first < kMaxRangeBytes) {
+      ++ranges_[{first, last}];
+    }
+  }
+}
+
+BranchCounts BranchCountAggregator::TakeCounts(uint64_t timestamp_ns) {
+  BranchCounts counts{begin_timestamp_ns_ == 0 ? timestamp_ns
+                                               : begin_timestamp_ns_,
+                      timestamp_ns};
+  for (const auto& [branch, count] : branches_) {
+    counts.AddBranch(branch.first, branch.second, count);
+  }
+  for (const auto& [range, count] : ranges_) {
+    counts.AddRange(range.first, range.second, count);
+  }
+  branches_.clear();
+  ranges_.clear();
+  begin_timestamp_ns_ = timestamp_ns;
+  return counts;
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,52 @@
+#ifndef ORBIT_LINUX_TRACING_BRANCH_COUNT_AGGREGATOR_H_
+#define ORBIT_LINUX_TRACING_BRANCH_COUNT_AGGREGATOR_H_
+
+#include <OrbitLinuxTracing/Events.h>
+#include <linux/perf_event.h>
+
+#include <cstdint>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
+
+namespace LinuxTracing {
+
+// Counts the branches of the last branch records of the samples of
+// Tracer::SetBranchSampling by source and target, and optionally the ranges of
+// code executed between them, until they are taken as BranchCounts. The
+// records are read straight from the ring buffers, and only the counts of
+// distinct branches are kept, so this costs a few map operations per branch
+// record and no copy of the samples.
+class BranchCountAggregator {
+ public:
+  // Longer ranges between two branch records mean that records were missed in
+  // between, e.g. when the core was interrupted, and are not counted.
+  static constexpr uint64_t kMaxRangeBytes = 4096;
+
+  // With count_ranges, the branches must be all the taken branches, see
+  // BranchSampling::kAllBranches.
+  explicit BranchCountAggregator(bool count_ranges = false)
+      : count_ranges_(count_ranges) {}
+
+  // entries as in a sample with PERF_SAMPLE_BRANCH_STACK, the most recent
+  // branch first.
+  void AddBranchStack(absl::Span<const perf_branch_entry> entries,
+                      uint64_t timestamp_ns);
+
+  bool IsEmpty() const { return branches_.empty(); }
+
+  // Returns the counts since the last call, from its timestamp_ns, or from the
+  // first branch stack added, to timestamp_ns.
+  BranchCounts TakeCounts(uint64_t timestamp_ns);
+
+ private:
+  bool count_ranges_;
+  absl::flat_hash_map<std::pair<uint64_t, uint64_t>, uint64_t> branches_;
+  absl::flat_hash_map<std::pair<uint64_t, uint64_t>, uint64_t> ranges_;
+  uint64_t begin_timestamp_ns_ = 0;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_BRANCH_COUNT_AGGREGATOR_H_
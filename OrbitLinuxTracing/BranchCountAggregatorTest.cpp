@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+#include "BranchCountAggregator.h"
+
+namespace LinuxTracing {
+
+namespace {
+perf_branch_entry MakeEntry(uint64_t from, uint64_t to) {
+  perf_branch_entry entry{};
+  entry.from = from;
+  entry.to = to;
+  return entry;
+}
+
+std::vector<std::tuple<uint64_t, uint64_t, uint64_t>> Sorted(
+    const std::vector<BranchCounts::Count>& counts) {
+  std::vector<std::tuple<uint64_t, uint64_t, uint64_t>> sorted;
+  for (const BranchCounts::Count& count : counts) {
+    sorted.emplace_back(count.from, count.to, count.count);
+  }
+  std::sort(sorted.begin(), sorted.end());
+  return sorted;
+}
+}  // namespace
+
+TEST(BranchCountAggregator, CountsBranchesBySourceAndTarget) {
+  BranchCountAggregator aggregator;
+  std::vector<perf_branch_entry> first{
+      MakeEntry(0x110, 0x200), MakeEntry(0x100, 0x200), MakeEntry(0, 0)};
+  aggregator.AddBranchStack(first, 1000);
+  std::vector<perf_branch_entry> second{MakeEntry(0x100, 0x200)};
+  aggregator.AddBranchStack(second, 2000);
+
+  BranchCounts counts = aggregator.TakeCounts(3000);
+  EXPECT_EQ(counts.GetBeginTimestampNs(), 1000);
+  EXPECT_EQ(counts.GetEndTimestampNs(), 3000);
+  std::vector<std::tuple<uint64_t, uint64_t, uint64_t>> expected{
+      {0x100, 0x200, 2}, {0x110, 0x200, 1}};
+  EXPECT_EQ(Sorted(counts.GetBranches()), expected);
+  EXPECT_TRUE(counts.GetRanges().empty());
+  EXPECT_TRUE(aggregator.IsEmpty());
+
+  aggregator.AddBranchStack(second, 4000);
+  counts = aggregator.TakeCounts(5000);
+  EXPECT_EQ(counts.GetBeginTimestampNs(), 3000);
+  EXPECT_EQ(Sorted(counts.GetBranches()).size(), 1);
+}
+
+TEST(BranchCountAggregator, CountsRangesBetweenBranches) {
+  BranchCountAggregator aggregator{/*count_ranges=*/true};
+  // Most recent first: 0x1200 jumped to 0x1300, which ran to 0x1320 and
+  // jumped to 0x1400, which jumped right away back to 0x1100. The range
+  // before 0x1200 is too long to be trusted.
+  std::vector<perf_branch_entry> entries{
+      MakeEntry(0x1400, 0x1100), MakeEntry(0x1320, 0x1400),
+      MakeEntry(0x1200, 0x1300),
+      MakeEntry(0x100, 0x1200 - BranchCountAggregator::kMaxRangeBytes - 1)};
+  aggregator.AddBranchStack(entries, 1000);
+
+  BranchCounts counts = aggregator.TakeCounts(2000);
+  std::vector<std::tuple<uint64_t, uint64_t, uint64_t>> expected{
+      {0x1300, 0x1320, 1}, {0x1400, 0x1400, 1}};
+  EXPECT_EQ(Sorted(counts.GetRanges()), expected);
+  EXPECT_EQ(counts.GetBranches().size(), 4);
+}
+
+}  // namespace LinuxTracing
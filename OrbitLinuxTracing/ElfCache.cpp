@@ -0,0 +1,75 @@
+#include "ElfCache.h"
+
+#include <OrbitBase/Logging.h>
+#include <sys/stat.h>
+
+#include <mutex>
+#include <optional>
+
+namespace LinuxTracing {
+
+void ElfCache::AttachElfs(std::shared_ptr<unwindstack::Maps> maps) {
+  CHECK(maps != nullptr);
+  // The Elfs created while unwinding with the previous snapshot.
+  AddElfsFromLastMaps();
+
+  absl::flat_hash_map<std::string, std::optional<FileId>> file_ids;
+  absl::flat_hash_map<Key, CachedElf> still_mapped_elfs;
+  absl::flat_hash_map<unwindstack::MapInfo*, Key> maps_keys;
+  for (const auto& map_info : *maps) {
+    // Skip anonymous and special maps like [vdso].
+    if (map_info->name.empty() || map_info->name[0] != '/') {
+      continue;
+    }
+    // A file is usually mapped several times, once per segment.
+    auto file_id_it = file_ids.find(map_info->name);
+    if (file_id_it == file_ids.end()) {
+      file_id_it =
+          file_ids.emplace(map_info->name, ReadFileId(map_info->name)).first;
+    }
+    if (!file_id_it->second.has_value()) {
+      continue;
+    }
+
+    Key key{map_info->name, file_id_it->second.value(), map_info->offset};
+    auto cached_elf_it = cached_elfs_.find(key);
+    if (cached_elf_it != cached_elfs_.end()) {
+      const CachedElf& cached_elf = cached_elf_it->second;
+      map_info->elf = cached_elf.elf;
+      map_info->elf_offset = cached_elf.elf_offset;
+      map_info->elf_start_offset = cached_elf.elf_start_offset;
+      still_mapped_elfs.emplace(key, cached_elf);
+    }
+    maps_keys.emplace(map_info.get(), std::move(key));
+  }
+
+  cached_elfs_ = std::move(still_mapped_elfs);
+  last_maps_ = std::move(maps);
+  last_maps_keys_ = std::move(maps_keys);
+}
+
+std::optional<ElfCache::FileId> ElfCache::ReadFileId(const std::string& path) {
+  struct stat file_stat {};
+  if (stat(path.c_str(), &file_stat) != 0) {
+    // E.g., the file has been deleted.
+    return std::nullopt;
+  }
+  return FileId{file_stat.st_dev, file_stat.st_ino,
+                file_stat.st_mtim.tv_sec * 1'000'000'000LL +
+                    file_stat.st_mtim.tv_nsec};
+}
+
+void ElfCache::AddElfsFromLastMaps() {
+  for (const auto& [map_info, key] : last_maps_keys_) {
+    // Elfs are created lazily under this lock, possibly by other threads.
+    std::lock_guard<std::mutex> lock{map_info->mutex_};
+    if (map_info->elf == nullptr || !map_info->elf->valid()) {
+      continue;
+    }
+    cached_elfs_.try_emplace(
+        key, CachedElf{map_info->elf, map_info->elf_offset,
+                       map_info->elf_start_offset});
+  }
+}
+
+}  // namespace LinuxTracing
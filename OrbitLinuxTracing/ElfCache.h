@@ -0,0 +1,87 @@
+#ifndef ORBIT_LINUX_TRACING_ELF_CACHE_H_
+#define ORBIT_LINUX_TRACING_ELF_CACHE_H_
+
+#include <sys/types.h>
+#include <unwindstack/Elf.h>
+#include <unwindstack/MapInfo.h>
+#include <unwindstack/Maps.h>
+
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+
+namespace LinuxTracing {
+
+// libunwindstack lazily creates an unwindstack::Elf for each map an unwind goes
+// through, which parses the headers of the file and then caches the
+// eh_frame/debug_frame entries it looks up. As this state lives in the
+// unwindstack::MapInfo objects, it is lost every time a new snapshot of the
+// maps is created, i.e., on every maps change, and rebuilt by the following
+// unwinds. ElfCache attaches to the MapInfos of a new snapshot the Elf objects
+// already created for the previous one, so that they persist as long as their
+// file stays mapped. Elfs are identified by the path, the device and
+// inode, and the modification time of the file, and by the offset of the
+// mapping: this avoids reusing an Elf for a file that was replaced on disk.
+// An Elf is only dropped when its file is no longer mapped.
+// AttachElfs must not be called concurrently, but the unwinding that uses the
+// snapshots can happen on other threads.
+class ElfCache {
+ public:
+  ElfCache() = default;
+  ElfCache(const ElfCache&) = delete;
+  ElfCache& operator=(const ElfCache&) = delete;
+  ElfCache(ElfCache&&) = default;
+  ElfCache& operator=(ElfCache&&) = default;
+
+  // Attaches the cached Elfs to maps, which replaces the previous snapshot.
+  void AttachElfs(std::shared_ptr<unwindstack::Maps> maps);
+
+ private:
+  struct FileId {
+    dev_t device;
+    ino_t inode;
+    int64_t modification_time_ns;
+    bool operator==(const FileId& other) const {
+      return device == other.device && inode == other.inode &&
+             modification_time_ns == other.modification_time_ns;
+    }
+  };
+
+  struct Key {
+    std::string path;
+    FileId file_id;
+    uint64_t offset;
+
+    bool operator==(const Key& other) const {
+      return path == other.path && file_id == other.file_id &&
+             offset == other.offset;
+    }
+    template <typename H>
+    friend H AbslHashValue(H h, const Key& key) {
+      return H::combine(std::move(h), key.path, key.file_id.device,
+                        key.file_id.inode, key.file_id.modification_time_ns,
+                        key.offset);
+    }
+  };
+
+  struct CachedElf {
+    std::shared_ptr<unwindstack::Elf> elf;
+    uint64_t elf_offset;
+    uint64_t elf_start_offset;
+  };
+
+  static std::optional<FileId> ReadFileId(const std::string& path);
+  void AddElfsFromLastMaps();
+
+  absl::flat_hash_map<Key, CachedElf> cached_elfs_;
+  // The keys of the MapInfos of the last snapshot, whose Elfs are added to the
+  // cache when parsing the next maps.
+  std::shared_ptr<unwindstack::Maps> last_maps_;
+  absl::flat_hash_map<unwindstack::MapInfo*, Key> last_maps_keys_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_ELF_CACHE_H_
@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <unwindstack/Memory.h>
+
+#include "ElfCache.h"
+#include "LibunwindstackUnwinder.h"
+#include "Utils.h"
+
+namespace LinuxTracing {
+
+namespace {
+std::shared_ptr<unwindstack::Maps> ParseMapsWithCache(
+    const std::string& maps_buffer, ElfCache* elf_cache) {
+  std::shared_ptr<unwindstack::Maps> maps =
+      LibunwindstackUnwinder::ParseMaps(maps_buffer);
+  if (maps != nullptr) {
+    elf_cache->AttachElfs(maps);
+  }
+  return maps;
+}
+
+// Returns the first file-backed map of the maps, normally the one of this
+// test's executable.
+unwindstack::MapInfo* FindFirstFileMap(unwindstack::Maps* maps) {
+  for (const auto& map_info : *maps) {
+    if (!map_info->name.empty() && map_info->name[0] == '/') {
+      return map_info.get();
+    }
+  }
+  return nullptr;
+}
+}  // namespace
+
+TEST(ElfCache, ElfsAreSharedBetweenSnapshots) {
+  std::string maps_buffer = ReadMaps(getpid());
+  ElfCache elf_cache;
+
+  std::shared_ptr<unwindstack::Maps> first_maps =
+      ParseMapsWithCache(maps_buffer, &elf_cache);
+  ASSERT_NE(first_maps, nullptr);
+  unwindstack::MapInfo* first_map_info = FindFirstFileMap(first_maps.get());
+  ASSERT_NE(first_map_info, nullptr);
+  EXPECT_EQ(first_map_info->elf, nullptr);
+  unwindstack::Elf* elf = first_map_info->GetElf(
+      unwindstack::Memory::CreateProcessMemory(getpid()),
+      unwindstack::ARCH_X86_64);
+  ASSERT_NE(elf, nullptr);
+
+  std::shared_ptr<unwindstack::Maps> second_maps =
+      ParseMapsWithCache(maps_buffer, &elf_cache);
+  ASSERT_NE(second_maps, nullptr);
+  unwindstack::MapInfo* second_map_info = FindFirstFileMap(second_maps.get());
+  ASSERT_NE(second_map_info, nullptr);
+  EXPECT_EQ(second_map_info->elf.get(), elf);
+  EXPECT_EQ(second_map_info->elf_offset, first_map_info->elf_offset);
+}
+
+TEST(ElfCache, ElfsAreDroppedWhenNoLongerMapped) {
+  std::string maps_buffer = ReadMaps(getpid());
+  ElfCache elf_cache;
+
+  std::shared_ptr<unwindstack::Maps> maps =
+      ParseMapsWithCache(maps_buffer, &elf_cache);
+  ASSERT_NE(maps, nullptr);
+  unwindstack::MapInfo* map_info = FindFirstFileMap(maps.get());
+  ASSERT_NE(map_info, nullptr);
+  ASSERT_NE(map_info->GetElf(unwindstack::Memory::CreateProcessMemory(getpid()),
+                             unwindstack::ARCH_X86_64),
+            nullptr);
+
+  // The file is not mapped in this snapshot.
+  ASSERT_NE(ParseMapsWithCache("", &elf_cache), nullptr);
+
+  maps = ParseMapsWithCache(maps_buffer, &elf_cache);
+  ASSERT_NE(maps, nullptr);
+  map_info = FindFirstFileMap(maps.get());
+  ASSERT_NE(map_info, nullptr);
+  EXPECT_EQ(map_info->elf, nullptr);
+}
+
+}  // namespace LinuxTracing
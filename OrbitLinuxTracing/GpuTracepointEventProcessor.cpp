@@ -1,10 +1,14 @@
 #include "GpuTracepointEventProcessor.h"
 
+#include <OrbitBase/Logging.h>
+#include <OrbitLinuxTracing/Events.h>
+
+#include <cstring>
 #include <string>
 #include <tuple>
 #include <vector>
 
-#include <OrbitLinuxTracing/Events.h>
+#include "absl/strings/string_view.h"
 
 namespace LinuxTracing {
 
@@ -52,31 +56,58 @@ struct __attribute__((__packed__)) perf_event_dma_fence_signaled {
 
 }  // namespace
 
+uint32_t GpuTracepointEventProcessor::InternTimeline(
+    absl::Span<const uint8_t> raw_data, int32_t data_loc) {
+  // The upper 16 bits of a data_loc field are the size of the data, the lower
+  // 16 bits its offset from the beginning of the raw data.
+  size_t data_loc_size = static_cast<uint32_t>(data_loc) >> 16;
+  size_t data_loc_offset = static_cast<uint32_t>(data_loc) & 0xffff;
+  if (data_loc_offset + data_loc_size > raw_data.size()) {
+    ERROR("Timeline of GPU tracepoint out of the raw data");
+    data_loc_size = 0;
+  }
+
+  // The string should be null terminated, but we don't rely on it.
+  const char* data = reinterpret_cast<const char*>(raw_data.data()) +
+                     data_loc_offset;
+  absl::string_view timeline{data, strnlen(data, data_loc_size)};
+
+  auto it = timeline_ids_.find(timeline);
+  if (it != timeline_ids_.end()) {
+    return it->second;
+  }
+  auto timeline_id = static_cast<uint32_t>(timelines_.size());
+  timelines_.emplace_back(timeline);
+  timeline_ids_.emplace(timeline, timeline_id);
+  return timeline_id;
+}
+
 int GpuTracepointEventProcessor::ComputeDepthForEvent(
-    const std::string& timeline,
-    uint64_t start_timestamp, uint64_t end_timestamp) {
-  if (timeline_to_latest_timestamp_per_depth_.count(timeline) == 0) {
-    std::vector<uint64_t> vec;
-    timeline_to_latest_timestamp_per_depth_.emplace(timeline, vec);
+    uint32_t timeline_id, uint64_t start_timestamp, uint64_t end_timestamp) {
+  TimelineDepths& depths = timeline_to_depths_[timeline_id];
+
+  // Release the rows whose last event ended before this one starts. Jobs are
+  // assumed to be reported roughly in order of start, so these rows are not
+  // needed by later events either and can be forgotten.
+  while (!depths.busy_rows.empty() &&
+         depths.busy_rows.top().first <= start_timestamp) {
+    depths.free_rows.push(depths.busy_rows.top().second);
+    depths.busy_rows.pop();
   }
-  auto it = timeline_to_latest_timestamp_per_depth_.find(timeline);
-  std::vector<uint64_t>& vec = it->second;
-
-  for (int d = 0; d < vec.size(); ++d) {
-    // We add a small amount of slack on each row of the GPU track timeline to
-    // make sure events don't get too crowded.
-    constexpr uint64_t slack_ns = 5 * 1000000;
-    if (start_timestamp >= (vec[d] + slack_ns)) {
-      vec[d] = end_timestamp;
-      return d;
-    }
+
+  int depth;
+  if (!depths.free_rows.empty()) {
+    depth = depths.free_rows.top();
+    depths.free_rows.pop();
+  } else {
+    depth = depths.row_count++;
   }
 
-  // Note that this vector only grows in size until a certain maximum depth is
-  // reached. Since there are only O(10) events per frame created, the depth
-  // is not likely to grow to a very large size.
-  vec.push_back(end_timestamp);
-  return static_cast<int>(vec.size());
+  // We add a small amount of slack on each row of the GPU track timeline to
+  // make sure events don't get too crowded.
+  constexpr uint64_t slack_ns = 5 * 1000000;
+  depths.busy_rows.emplace(end_timestamp + slack_ns, depth);
+  return depth;
 }
 
 void GpuTracepointEventProcessor::CreateGpuExecutionEventIfComplete(
@@ -94,7 +125,7 @@ void GpuTracepointEventProcessor::CreateGpuExecutionEventIfComplete(
     return;
   }
 
-  std::string timeline = cs_it->second.timeline;
+  uint32_t timeline_id = cs_it->second.timeline_id;
   pid_t tid = cs_it->second.tid;
 
   // We assume that GPU jobs (command buffer submissions) immediately
@@ -104,22 +135,20 @@ void GpuTracepointEventProcessor::CreateGpuExecutionEventIfComplete(
   // timeline_to_latest_dma_signal_. If a previous job is still running
   // at the timestamp of scheduling the current job, we push the start
   // time for starting on the hardware back.
-  if (timeline_to_latest_dma_signal_.count(timeline) == 0) {
-    timeline_to_latest_dma_signal_.emplace(
-        timeline, dma_it->second.timestamp_ns);
-  }
-  auto it = timeline_to_latest_dma_signal_.find(timeline);
+  auto it = timeline_to_latest_dma_signal_
+                .try_emplace(timeline_id, dma_it->second.timestamp_ns)
+                .first;
   uint64_t hw_start_time = sched_it->second.timestamp_ns;
   if (hw_start_time < it->second) {
     hw_start_time = it->second;
   }
 
-  int depth = ComputeDepthForEvent(timeline, cs_it->second.timestamp_ns,
+  int depth = ComputeDepthForEvent(timeline_id, cs_it->second.timestamp_ns,
                                    dma_it->second.timestamp_ns);
   GpuJob gpu_job(tid,
                  cs_it->second.context,
                  cs_it->second.seqno,
-                 cs_it->second.timeline,
+                 timelines_[timeline_id],
                  depth,
                  cs_it->second.timestamp_ns,
                  sched_it->second.timestamp_ns,
@@ -138,11 +167,11 @@ void GpuTracepointEventProcessor::CreateGpuExecutionEventIfComplete(
 }
 
 void GpuTracepointEventProcessor::PushEvent(
-    const std::unique_ptr<PerfEventSampleRaw>& sample) {
-  pid_t tid = sample->ring_buffer_record.sample_id.tid;
-  uint64_t timestamp_ns = sample->ring_buffer_record.sample_id.time;
-  int tp_id =
-      static_cast<int>(*reinterpret_cast<const uint16_t*>(&sample->data[0]));
+    pid_t tid, uint64_t timestamp_ns, absl::Span<const uint8_t> raw_data) {
+  uint16_t common_type;
+  CHECK(raw_data.size() >= sizeof(common_type));
+  std::memcpy(&common_type, raw_data.data(), sizeof(common_type));
+  int tp_id = static_cast<int>(common_type);
 
   // Handle the three different types of events that we can get from the GPU
   // driver tracepoints we are tracing. We allow for the possibility that these
@@ -153,44 +182,47 @@ void GpuTracepointEventProcessor::PushEvent(
   // This event is only be created when all three types of GPU events have been
   // received.
   if (tp_id == amdgpu_cs_ioctl_id_) {
-    const perf_event_amdgpu_cs_ioctl* tracepoint_data =
-        reinterpret_cast<const perf_event_amdgpu_cs_ioctl*>(&sample->data[0]);
+    CHECK(raw_data.size() >= sizeof(perf_event_amdgpu_cs_ioctl));
+    const auto* tracepoint_data =
+        reinterpret_cast<const perf_event_amdgpu_cs_ioctl*>(raw_data.data());
 
     uint32_t context = tracepoint_data->context;
     uint32_t seqno = tracepoint_data->seqno;
-    std::string timeline = ExtractTimelineString(tracepoint_data);
+    uint32_t timeline_id = InternTimeline(raw_data, tracepoint_data->timeline);
 
-    AmdgpuCsIoctlEvent event{tid, timestamp_ns, context, seqno, timeline};
-    Key key = std::make_tuple(context, seqno, timeline);
+    AmdgpuCsIoctlEvent event{tid, timestamp_ns, context, seqno, timeline_id};
+    Key key = std::make_tuple(context, seqno, timeline_id);
 
     amdgpu_cs_ioctl_events_.emplace(key, event);
 
     CreateGpuExecutionEventIfComplete(key);
   } else if (tp_id == amdgpu_sched_run_job_id_) {
-    const perf_event_amdgpu_sched_run_job* tracepoint_data =
+    CHECK(raw_data.size() >= sizeof(perf_event_amdgpu_sched_run_job));
+    const auto* tracepoint_data =
         reinterpret_cast<const perf_event_amdgpu_sched_run_job*>(
-            &sample->data[0]);
+            raw_data.data());
 
     uint32_t context = tracepoint_data->context;
     uint32_t seqno = tracepoint_data->seqno;
-    std::string timeline = ExtractTimelineString(tracepoint_data);
+    uint32_t timeline_id = InternTimeline(raw_data, tracepoint_data->timeline);
 
-    AmdgpuSchedRunJobEvent event{timestamp_ns, context, seqno, timeline};
-    Key key = std::make_tuple(context, seqno, timeline);
+    AmdgpuSchedRunJobEvent event{timestamp_ns, context, seqno, timeline_id};
+    Key key = std::make_tuple(context, seqno, timeline_id);
 
     amdgpu_sched_run_job_events_.emplace(key, event);
     CreateGpuExecutionEventIfComplete(key);
   } else if (tp_id == dma_fence_signaled_id_) {
-    const perf_event_dma_fence_signaled* tracepoint_data =
+    CHECK(raw_data.size() >= sizeof(perf_event_dma_fence_signaled));
+    const auto* tracepoint_data =
         reinterpret_cast<const perf_event_dma_fence_signaled*>(
-            &sample->data[0]);
+            raw_data.data());
 
     uint32_t context = tracepoint_data->context;
     uint32_t seqno = tracepoint_data->seqno;
-    std::string timeline = ExtractTimelineString(tracepoint_data);
+    uint32_t timeline_id = InternTimeline(raw_data, tracepoint_data->timeline);
 
-    DmaFenceSignaledEvent event{timestamp_ns, context, seqno, timeline};
-    Key key = std::make_tuple(context, seqno, timeline);
+    DmaFenceSignaledEvent event{timestamp_ns, context, seqno, timeline_id};
+    Key key = std::make_tuple(context, seqno, timeline_id);
 
     dma_fence_signaled_events_.emplace(key, event);
     CreateGpuExecutionEventIfComplete(key);
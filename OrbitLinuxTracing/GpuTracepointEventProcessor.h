@@ -2,10 +2,16 @@
 #ifndef ORBIT_LINUX_TRACING_GPU_TRACEPOINT_EVENT_PROCESSOR
 #define ORBIT_LINUX_TRACING_GPU_TRACEPOINT_EVENT_PROCESSOR
 
+#include <functional>
+#include <queue>
+#include <string>
 #include <tuple>
+#include <utility>
+#include <vector>
+
 #include "OrbitLinuxTracing/TracerListener.h"
-#include "PerfEvent.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
 
 namespace LinuxTracing {
 
@@ -18,33 +24,25 @@ class GpuTracepointEventProcessor {
       amdgpu_sched_run_job_id_(amdgpu_sched_run_job_id),
       dma_fence_signaled_id_(dma_fence_signaled_id) {}
 
-  void PushEvent(const std::unique_ptr<PerfEventSampleRaw>& sample);
+  // raw_data is the raw data of a PERF_SAMPLE_RAW sample of one of the three
+  // tracepoints, read in place from the ring buffer.
+  void PushEvent(pid_t tid, uint64_t timestamp_ns,
+                 absl::Span<const uint8_t> raw_data);
   void SetListener(TracerListener* listener);
 
  private:
-  // Keys are context, seqno, and timeline
-  typedef std::tuple<uint32_t, uint32_t, std::string> Key;
-
-  template<typename T> std::string ExtractTimelineString(
-      const T* tracepoint_data) {
-    int32_t data_loc = tracepoint_data->timeline;
-    int16_t data_loc_size = static_cast<int16_t>(data_loc >> 16);
-    int16_t data_loc_offset = static_cast<int16_t>(data_loc & 0x00ff);
-
-    std::vector<char> data_loc_data(data_loc_size);
-    std::memcpy(&data_loc_data[0],
-                reinterpret_cast<const char*>(tracepoint_data)
-                + data_loc_offset, data_loc_size);
-
-    // While the string should be null terminated here, we make sure that it
-    // actually is by adding a zero in the last position. In the case of
-    // expected behavior, this is a no-op.
-    data_loc_data[data_loc_data.size()-1] = 0;
-    return std::string(&data_loc_data[0]);
-  }
-
-  int ComputeDepthForEvent(const std::string& timeline,
-    uint64_t start_timestamp, uint64_t end_timestamp);
+  // Keys are context, seqno, and timeline id (see InternTimeline).
+  typedef std::tuple<uint32_t, uint32_t, uint32_t> Key;
+
+  // Returns the id of the timeline string pointed to by the data_loc field
+  // timeline of the tracepoint, adding the string to timelines_ the first
+  // time it is seen. The string is read in place, without copying it, so that
+  // each event only costs a lookup in timeline_ids_.
+  uint32_t InternTimeline(absl::Span<const uint8_t> raw_data,
+                          int32_t data_loc);
+
+  int ComputeDepthForEvent(uint32_t timeline_id, uint64_t start_timestamp,
+                           uint64_t end_timestamp);
 
   void CreateGpuExecutionEventIfComplete(const Key& key);
 
@@ -59,7 +57,7 @@ class GpuTracepointEventProcessor {
     uint64_t timestamp_ns;
     uint32_t context;
     uint32_t seqno;
-    std::string timeline;
+    uint32_t timeline_id;
   };
   absl::flat_hash_map<Key, AmdgpuCsIoctlEvent> amdgpu_cs_ioctl_events_;
 
@@ -67,7 +65,7 @@ class GpuTracepointEventProcessor {
     uint64_t timestamp_ns;
     uint32_t context;
     uint32_t seqno;
-    std::string timeline;
+    uint32_t timeline_id;
   };
   absl::flat_hash_map<Key, AmdgpuSchedRunJobEvent>
       amdgpu_sched_run_job_events_;
@@ -76,16 +74,31 @@ class GpuTracepointEventProcessor {
     uint64_t timestamp_ns;
     uint32_t context;
     uint32_t seqno;
-    std::string timeline;
+    uint32_t timeline_id;
   };
   absl::flat_hash_map<Key, DmaFenceSignaledEvent>
       dma_fence_signaled_events_;
 
-  absl::flat_hash_map<std::string, uint64_t>
-      timeline_to_latest_dma_signal_;
-
-  absl::flat_hash_map<std::string, std::vector<uint64_t>>
-      timeline_to_latest_timestamp_per_depth_;
+  absl::flat_hash_map<std::string, uint32_t> timeline_ids_;
+  std::vector<std::string> timelines_;
+
+  absl::flat_hash_map<uint32_t, uint64_t> timeline_to_latest_dma_signal_;
+
+  // The rows of the GPU track of a timeline, in which events are stacked so
+  // that each event is in the lowest row that is free at its start. Both
+  // queues only hold one entry per row, so that assigning a depth is
+  // O(log(row_count)).
+  struct TimelineDepths {
+    // Pairs of the time the last event of the row ends (plus slack) and of the
+    // row, earliest first.
+    std::priority_queue<std::pair<uint64_t, int>,
+                        std::vector<std::pair<uint64_t, int>>,
+                        std::greater<>>
+        busy_rows;
+    std::priority_queue<int, std::vector<int>, std::greater<>> free_rows;
+    int row_count = 0;
+  };
+  absl::flat_hash_map<uint32_t, TimelineDepths> timeline_to_depths_;
 };
 
 }
@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "GpuTracepointEventProcessor.h"
+
+namespace LinuxTracing {
+
+namespace {
+constexpr int AMDGPU_CS_IOCTL_ID = 1;
+constexpr int AMDGPU_SCHED_RUN_JOB_ID = 2;
+constexpr int DMA_FENCE_SIGNALED_ID = 3;
+
+class RecordingListener : public TracerListener {
+ public:
+  void OnTid(pid_t /*tid*/) override {}
+  void OnContextSwitchIn(
+      const ContextSwitchIn& /*context_switch_in*/) override {}
+  void OnContextSwitchOut(
+      const ContextSwitchOut& /*context_switch_out*/) override {}
+  void OnCallstack(const Callstack& /*callstack*/) override {}
+  void OnFunctionCall(const FunctionCall& /*function_call*/) override {}
+  void OnGpuJob(const GpuJob& gpu_job) override { gpu_jobs.push_back(gpu_job); }
+  void OnThreadStateChange(
+      const ThreadStateChange& /*thread_state_change*/) override {}
+
+  std::vector<GpuJob> gpu_jobs;
+};
+
+template <typename T>
+void Write(std::vector<uint8_t>* raw_data, size_t offset, T value) {
+  std::memcpy(raw_data->data() + offset, &value, sizeof(value));
+}
+
+// Builds the raw data of one of the tracepoints, with the fixed-size part of
+// the given size and the timeline string appended after it, as the kernel
+// does for data_loc fields. The offsets are the ones of the fields in the
+// format files of the tracepoints.
+std::vector<uint8_t> MakeRawData(uint16_t tracepoint_id, size_t size,
+                                 size_t timeline_offset, uint32_t context,
+                                 uint32_t seqno, const std::string& timeline) {
+  std::vector<uint8_t> raw_data(size + timeline.size() + 1, 0);
+  Write<uint16_t>(&raw_data, 0, tracepoint_id);
+  int32_t data_loc = static_cast<int32_t>(((timeline.size() + 1) << 16) | size);
+  Write(&raw_data, timeline_offset, data_loc);
+  Write(&raw_data, timeline_offset + 4, context);
+  Write(&raw_data, timeline_offset + 8, seqno);
+  std::memcpy(raw_data.data() + size, timeline.c_str(), timeline.size() + 1);
+  return raw_data;
+}
+
+std::vector<uint8_t> MakeAmdgpuCsIoctl(uint32_t context, uint32_t seqno,
+                                       const std::string& timeline) {
+  return MakeRawData(AMDGPU_CS_IOCTL_ID, 48, 16, context, seqno, timeline);
+}
+
+std::vector<uint8_t> MakeAmdgpuSchedRunJob(uint32_t context, uint32_t seqno,
+                                           const std::string& timeline) {
+  return MakeRawData(AMDGPU_SCHED_RUN_JOB_ID, 40, 16, context, seqno, timeline);
+}
+
+std::vector<uint8_t> MakeDmaFenceSignaled(uint32_t context, uint32_t seqno,
+                                          const std::string& timeline) {
+  return MakeRawData(DMA_FENCE_SIGNALED_ID, 24, 12, context, seqno, timeline);
+}
+
+class GpuTracepointEventProcessorTest : public ::testing::Test {
+ protected:
+  void SetUp() override { processor_.SetListener(&listener_); }
+
+  void Push(pid_t tid, uint64_t timestamp_ns,
+            const std::vector<uint8_t>& raw_data) {
+    processor_.PushEvent(tid, timestamp_ns, absl::MakeConstSpan(raw_data));
+  }
+
+  RecordingListener listener_;
+  GpuTracepointEventProcessor processor_{
+      AMDGPU_CS_IOCTL_ID, AMDGPU_SCHED_RUN_JOB_ID, DMA_FENCE_SIGNALED_ID};
+};
+}  // namespace
+
+TEST_F(GpuTracepointEventProcessorTest, CreatesJobFromEventsInAnyOrder) {
+  Push(42, 300, MakeDmaFenceSignaled(1, 10, "gfx"));
+  Push(42, 100, MakeAmdgpuCsIoctl(1, 10, "gfx"));
+  EXPECT_TRUE(listener_.gpu_jobs.empty());
+  Push(42, 200, MakeAmdgpuSchedRunJob(1, 10, "gfx"));
+
+  ASSERT_EQ(listener_.gpu_jobs.size(), 1);
+  const GpuJob& gpu_job = listener_.gpu_jobs[0];
+  EXPECT_EQ(gpu_job.GetTid(), 42);
+  EXPECT_EQ(gpu_job.GetContext(), 1);
+  EXPECT_EQ(gpu_job.GetSeqno(), 10);
+  EXPECT_EQ(gpu_job.GetTimeline(), "gfx");
+  EXPECT_EQ(gpu_job.GetAmdgpuCsIoctlTimeNs(), 100);
+  EXPECT_EQ(gpu_job.GetAmdgpuSchedRunJobTimeNs(), 200);
+  EXPECT_EQ(gpu_job.GetDmaFenceSignaledTimeNs(), 300);
+}
+
+TEST_F(GpuTracepointEventProcessorTest, DistinguishesTimelines) {
+  Push(42, 100, MakeAmdgpuCsIoctl(1, 10, "gfx"));
+  Push(42, 110, MakeAmdgpuSchedRunJob(1, 10, "sdma0"));
+  Push(42, 120, MakeDmaFenceSignaled(1, 10, "gfx"));
+  EXPECT_TRUE(listener_.gpu_jobs.empty());
+
+  Push(42, 130, MakeAmdgpuSchedRunJob(1, 10, "gfx"));
+  ASSERT_EQ(listener_.gpu_jobs.size(), 1);
+  EXPECT_EQ(listener_.gpu_jobs[0].GetTimeline(), "gfx");
+
+  Push(43, 140, MakeAmdgpuCsIoctl(1, 10, "sdma0"));
+  Push(43, 150, MakeDmaFenceSignaled(1, 10, "sdma0"));
+  ASSERT_EQ(listener_.gpu_jobs.size(), 2);
+  EXPECT_EQ(listener_.gpu_jobs[1].GetTid(), 43);
+  EXPECT_EQ(listener_.gpu_jobs[1].GetTimeline(), "sdma0");
+}
+
+TEST_F(GpuTracepointEventProcessorTest, DelaysHardwareStartOnBusyTimeline) {
+  Push(42, 100, MakeAmdgpuCsIoctl(1, 10, "gfx"));
+  Push(42, 110, MakeAmdgpuSchedRunJob(1, 10, "gfx"));
+  Push(42, 500, MakeDmaFenceSignaled(1, 10, "gfx"));
+
+  Push(42, 200, MakeAmdgpuCsIoctl(1, 11, "gfx"));
+  Push(42, 210, MakeAmdgpuSchedRunJob(1, 11, "gfx"));
+  Push(42, 600, MakeDmaFenceSignaled(1, 11, "gfx"));
+
+  ASSERT_EQ(listener_.gpu_jobs.size(), 2);
+  EXPECT_EQ(listener_.gpu_jobs[1].GetGpuHardwareStartTimeNs(), 500);
+}
+
+TEST_F(GpuTracepointEventProcessorTest, StacksOverlappingJobs) {
+  constexpr uint64_t MS = 1'000'000;
+  auto push_job = [this](uint32_t seqno, uint64_t start_ns, uint64_t end_ns) {
+    Push(42, start_ns, MakeAmdgpuCsIoctl(1, seqno, "gfx"));
+    Push(42, start_ns, MakeAmdgpuSchedRunJob(1, seqno, "gfx"));
+    Push(42, end_ns, MakeDmaFenceSignaled(1, seqno, "gfx"));
+  };
+
+  push_job(1, 100 * MS, 200 * MS);
+  push_job(2, 150 * MS, 300 * MS);
+  push_job(3, 160 * MS, 170 * MS);
+  // The first row is free again, but not the second one.
+  push_job(4, 250 * MS, 260 * MS);
+  // Both rows are free, the lowest one is used.
+  push_job(5, 400 * MS, 500 * MS);
+
+  ASSERT_EQ(listener_.gpu_jobs.size(), 5);
+  EXPECT_EQ(listener_.gpu_jobs[0].GetDepth(), 0);
+  EXPECT_EQ(listener_.gpu_jobs[1].GetDepth(), 1);
+  EXPECT_EQ(listener_.gpu_jobs[2].GetDepth(), 2);
+  EXPECT_EQ(listener_.gpu_jobs[3].GetDepth(), 0);
+  EXPECT_EQ(listener_.gpu_jobs[4].GetDepth(), 0);
+}
+
+}  // namespace LinuxTracing
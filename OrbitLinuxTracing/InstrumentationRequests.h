@@ -0,0 +1,50 @@
+#ifndef ORBIT_LINUX_TRACING_INSTRUMENTATION_REQUESTS_H_
+#define ORBIT_LINUX_TRACING_INSTRUMENTATION_REQUESTS_H_
+
+#include <OrbitLinuxTracing/Function.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace LinuxTracing {
+
+// Changes to the set of instrumented functions requested through Tracer while
+// a capture is running, and windows of Intel Processor Trace, to be applied
+// by the TracerThread running it. Push and Consume can be called from
+// different threads.
+class InstrumentationRequests {
+ public:
+  struct Request {
+    enum class Type { kAdd, kRemove, kTraceWithIntelPt };
+    Type type;
+    Function function;
+    // Only for kTraceWithIntelPt.
+    uint64_t function_size = 0;
+    uint64_t duration_ns = 0;
+  };
+
+  void Push(Request request) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    requests_.push_back(std::move(request));
+    has_requests_ = true;
+  }
+
+  // Cheap check to avoid locking when there are no requests.
+  bool HasRequests() const { return has_requests_; }
+
+  std::vector<Request> Consume() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    has_requests_ = false;
+    return std::move(requests_);
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<Request> requests_;
+  std::atomic<bool> has_requests_ = false;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_INSTRUMENTATION_REQUESTS_H_
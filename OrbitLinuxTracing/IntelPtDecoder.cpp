@@ -0,0 +1,260 @@
+#include "IntelPtDecoder.h"
+
+#include <algorithm>
+#include <array>
+
+namespace LinuxTracing {
+
+namespace {
+// The PSB packet, 02 82 repeated 8 times, which the trace is synchronized on.
+constexpr std::array<uint8_t, 16> kPsb{0x02, 0x82, 0x02, 0x82, 0x02, 0x82,
+                                       0x02, 0x82, 0x02, 0x82, 0x02, 0x82,
+                                       0x02, 0x82, 0x02, 0x82};
+
+size_t FindPsb(absl::Span<const uint8_t> data, size_t offset) {
+  auto it = std::search(data.begin() + std::min(offset, data.size()),
+                        data.end(), kPsb.begin(), kPsb.end());
+  return it - data.begin();
+}
+
+uint64_t ReadLittleEndian(absl::Span<const uint8_t> data, size_t offset,
+                          size_t size) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < size; ++i) {
+    value |= static_cast<uint64_t>(data[offset + i]) << (8 * i);
+  }
+  return value;
+}
+
+// The sizes of the extended packets, 02 followed by their opcode, with a
+// fixed size.
+size_t GetExtendedPacketSize(uint8_t opcode) {
+  switch (opcode) {
+    case 0x23:  // PSBEND
+    case 0x83:  // TraceStop
+    case 0xf3:  // OVF
+    case 0x62:  // EXSTOP
+    case 0xe2:  // EXSTOP with IP
+      return 2;
+    case 0x03:  // CBR
+    case 0x22:  // PWRE
+      return 4;
+    case 0x73:  // TMA
+    case 0xa2:  // PWRX
+    case 0xc8:  // VMCS
+      return 7;
+    case 0xa3:  // Long TNT
+    case 0x43:  // PIP
+      return 8;
+    case 0xc2:  // MWAIT
+      return 10;
+    case 0xc3:  // MNT
+      return 11;
+    default:
+      if ((opcode & 0x1f) == 0x12) {  // PTWRITE, with 4 or 8 bytes
+        return (opcode & 0x20) != 0 ? 10 : 6;
+      }
+      return 0;
+  }
+}
+}  // namespace
+
+std::vector<IntelPtDecoder::Call> IntelPtDecoder::Decode(
+    absl::Span<const uint8_t> data) {
+  std::vector<Call> calls;
+  size_t offset = FindPsb(data, 0);
+  while (offset < data.size()) {
+    size_t size = DecodePacket(data, offset, &calls);
+    if (size == 0) {
+      // Short of the longest packet, it might just be cut at the end.
+      if (data.size() - offset >= kPsb.size()) {
+        ++num_decoding_errors_;
+      }
+      Resynchronize();
+      offset = FindPsb(data, offset + 1);
+      continue;
+    }
+    offset += size;
+  }
+  return calls;
+}
+
+size_t IntelPtDecoder::DecodePacket(absl::Span<const uint8_t> data,
+                                    size_t offset, std::vector<Call>* calls) {
+  const size_t remaining = data.size() - offset;
+  const uint8_t header = data[offset];
+
+  if (header == 0x02) {
+    if (remaining < 2) {
+      return 0;
+    }
+    const uint8_t opcode = data[offset + 1];
+    if (opcode == 0x82) {  // PSB
+      if (remaining < kPsb.size() ||
+          !std::equal(kPsb.begin(), kPsb.end(), data.begin() + offset)) {
+        return 0;
+      }
+      last_ip_ = 0;
+      return kPsb.size();
+    }
+    size_t size = GetExtendedPacketSize(opcode);
+    if (size == 0 || remaining < size) {
+      return 0;
+    }
+    if (opcode == 0x73) {  // TMA, the CTC when the last TSC was taken.
+      has_tma_ = true;
+      tma_tsc_ = tsc_;
+      tma_ctc_ = ReadLittleEndian(data, offset + 2, 2);
+      mtc_ctc_ = tma_ctc_ >> mtc_period_;
+    } else if (opcode == 0xf3) {  // OVF: packets were lost.
+      in_call_ = false;
+      has_disable_ = false;
+    }
+    return size;
+  }
+
+  if (header == 0x00) {  // PAD
+    return 1;
+  }
+  if ((header & 0x01) == 0) {  // Short TNT
+    return 1;
+  }
+  if ((header & 0x03) == 0x03) {  // CYC, with its optional extensions
+    size_t size = 1;
+    if ((header & 0x04) != 0) {
+      do {
+        if (size >= remaining) {
+          return 0;
+        }
+      } while ((data[offset + size++] & 0x01) != 0);
+    }
+    return size;
+  }
+  if (header == 0x19) {  // TSC
+    if (remaining < 8) {
+      return 0;
+    }
+    tsc_ = ReadLittleEndian(data, offset + 1, 7);
+    has_tma_ = false;
+    return 8;
+  }
+  if (header == 0x59) {  // MTC
+    if (remaining < 2) {
+      return 0;
+    }
+    OnMtc(data[offset + 1]);
+    return 2;
+  }
+  if (header == 0x99) {  // MODE
+    return remaining < 2 ? 0 : 2;
+  }
+
+  const uint8_t type = header & 0x1f;
+  if (type == 0x0d || type == 0x11 || type == 0x01 || type == 0x1d) {
+    uint64_t ip;
+    int ip_size = DecodeIp(data, offset, &ip);
+    if (ip_size < 0) {
+      return 0;
+    }
+    // The IP of a TIP.PGD, if any, is outside of the function.
+    if (type == 0x11) {
+      OnEnable(ip_size > 0 ? ip : 0, calls);
+    } else if (type == 0x01) {
+      OnDisable();
+    }
+    return 1 + ip_size;
+  }
+
+  return 0;
+}
+
+int IntelPtDecoder::DecodeIp(absl::Span<const uint8_t> data, size_t offset,
+                             uint64_t* ip) {
+  const size_t remaining = data.size() - offset - 1;
+  const uint8_t ip_bytes = data[offset] >> 5;
+  size_t size;
+  switch (ip_bytes) {
+    case 0:  // Suppressed, e.g. when the target is outside of the filter.
+      return 0;
+    case 1:
+      size = 2;
+      break;
+    case 2:
+      size = 4;
+      break;
+    case 3:
+    case 4:
+      size = 6;
+      break;
+    case 6:
+      size = 8;
+      break;
+    default:
+      return -1;
+  }
+  if (remaining < size) {
+    return -1;
+  }
+  uint64_t value = ReadLittleEndian(data, offset + 1, size);
+  switch (ip_bytes) {
+    case 1:
+      *ip = (last_ip_ & ~0xffffull) | value;
+      break;
+    case 2:
+      *ip = (last_ip_ & ~0xffffffffull) | value;
+      break;
+    case 3:  // Sign-extended from bit 47.
+      *ip = (value & (1ull << 47)) != 0 ? value | 0xffff000000000000ull
+                                         : value;
+      break;
+    case 4:
+      *ip = (last_ip_ & ~0xffffffffffffull) | value;
+      break;
+    default:
+      *ip = value;
+      break;
+  }
+  last_ip_ = *ip;
+  return static_cast<int>(size);
+}
+
+void IntelPtDecoder::OnEnable(uint64_t ip, std::vector<Call>* calls) {
+  if (ip != function_address_) {
+    return;
+  }
+  if (in_call_ && has_disable_) {
+    calls->push_back({call_begin_tsc_, last_disable_tsc_});
+  }
+  in_call_ = true;
+  call_begin_tsc_ = tsc_;
+  has_disable_ = false;
+}
+
+void IntelPtDecoder::OnDisable() {
+  has_disable_ = true;
+  last_disable_tsc_ = tsc_;
+}
+
+void IntelPtDecoder::OnMtc(uint8_t ctc) {
+  if (!has_tma_) {
+    return;
+  }
+  // The payload is bits [mtc_period + 7 : mtc_period] of the CTC, which only
+  // moves forward.
+  mtc_ctc_ += static_cast<uint8_t>(ctc - static_cast<uint8_t>(mtc_ctc_));
+  uint64_t mtc_ctc = mtc_ctc_ << mtc_period_;
+  if (mtc_ctc <= tma_ctc_) {
+    return;
+  }
+  tsc_ = tma_tsc_ +
+         static_cast<uint64_t>((mtc_ctc - tma_ctc_) * tsc_ctc_ratio_);
+}
+
+void IntelPtDecoder::Resynchronize() {
+  last_ip_ = 0;
+  has_tma_ = false;
+  in_call_ = false;
+  has_disable_ = false;
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,89 @@
+#ifndef ORBIT_LINUX_TRACING_INTEL_PT_DECODER_H_
+#define ORBIT_LINUX_TRACING_INTEL_PT_DECODER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/types/span.h"
+
+namespace LinuxTracing {
+
+// Decodes the Intel Processor Trace of a thread filtered to the code of a
+// single function (see intel_pt_event_open and perf_event_set_address_filter)
+// into the calls to this function. The trace is then enabled whenever the
+// thread enters the function and disabled whenever it leaves it, to call
+// another function, on a syscall or an interrupt, or to return. Only the
+// TIP.PGE and TIP.PGD packets telling that matter, the other packets are just
+// parsed for their size, the compression of the addresses and the time.
+//
+// An enable at the address of the function is a call: the previous call
+// returned at the last disable before it, while an enable elsewhere in the
+// function resumes the current call. Recursive calls are part of the
+// outermost one, and the last call of the trace is dropped, as it can't be
+// told whether it returned. With filtering, the trace has no instruction
+// flow to follow, so unlike a full decoder this needs neither the binary nor
+// a disassembler.
+//
+// The time is in TSC ticks: set by the TSC packets, then advanced by the MTC
+// packets, every 2^mtc_period ticks of the crystal clock (CTC), each of which
+// is tsc_ctc_ratio TSC ticks (see CPUID leaf 0x15). Without MTC packets, the
+// time only advances with the TSC packets, which is much coarser.
+class IntelPtDecoder {
+ public:
+  struct Call {
+    uint64_t begin_tsc;
+    uint64_t end_tsc;
+  };
+
+  IntelPtDecoder(uint64_t function_address, uint32_t mtc_period,
+                 double tsc_ctc_ratio)
+      : function_address_(function_address),
+        mtc_period_(mtc_period),
+        tsc_ctc_ratio_(tsc_ctc_ratio) {}
+
+  // data is the whole AUX buffer of the trace, or any part of it: decoding
+  // starts at its first PSB packet.
+  std::vector<Call> Decode(absl::Span<const uint8_t> data);
+
+  // Of the packets not understood, e.g. because of corrupted data, after
+  // each of which decoding resumed at the next PSB packet.
+  uint64_t GetNumDecodingErrors() const { return num_decoding_errors_; }
+
+ private:
+  // Returns the size of the packet at data[offset], 0 if it is unknown or
+  // truncated.
+  size_t DecodePacket(absl::Span<const uint8_t> data, size_t offset,
+                      std::vector<Call>* calls);
+  // Returns the size of the address after the header of a TIP, TIP.PGE,
+  // TIP.PGD or FUP packet, updating last_ip_, or -1 if unknown.
+  int DecodeIp(absl::Span<const uint8_t> data, size_t offset, uint64_t* ip);
+  void OnEnable(uint64_t ip, std::vector<Call>* calls);
+  void OnDisable();
+  void OnMtc(uint8_t ctc);
+  void Resynchronize();
+
+  uint64_t function_address_;
+  uint32_t mtc_period_;
+  double tsc_ctc_ratio_;
+
+  uint64_t last_ip_ = 0;
+  uint64_t tsc_ = 0;
+  // Of the last TSC and TMA packets, for the MTC packets that follow.
+  bool has_tma_ = false;
+  uint64_t tma_tsc_ = 0;
+  uint64_t tma_ctc_ = 0;
+  // CTC >> mtc_period, as of the last MTC packet.
+  uint64_t mtc_ctc_ = 0;
+
+  bool in_call_ = false;
+  uint64_t call_begin_tsc_ = 0;
+  bool has_disable_ = false;
+  uint64_t last_disable_tsc_ = 0;
+
+  uint64_t num_decoding_errors_ = 0;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_INTEL_PT_DECODER_H_
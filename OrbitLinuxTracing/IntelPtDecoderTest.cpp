@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "IntelPtDecoder.h"
+
+namespace LinuxTracing {
+
+namespace {
+constexpr uint64_t kFunctionAddress = 0x7f0000401000;
+
+// Builds the packets of a trace.
+class Trace {
+ public:
+  Trace& Psb() {
+    for (int i = 0; i < 8; ++i) {
+      Append({0x02, 0x82});
+    }
+    return *this;
+  }
+  Trace& PsbEnd() { return Append({0x02, 0x23}); }
+  Trace& Tsc(uint64_t tsc) {
+    Append({0x19});
+    return AppendLittleEndian(tsc, 7);
+  }
+  Trace& Tma(uint16_t ctc) {
+    Append({0x02, 0x73});
+    AppendLittleEndian(ctc, 2);
+    return Append({0x00, 0x00, 0x00});
+  }
+  Trace& Mtc(uint8_t ctc) { return Append({0x59, ctc}); }
+  // With the full address.
+  Trace& Enable(uint64_t ip) {
+    Append({0xd1});
+    return AppendLittleEndian(ip, 8);
+  }
+  // With the low 16 bits of the address only.
+  Trace& EnableCompressed(uint16_t ip) {
+    Append({0x31});
+    return AppendLittleEndian(ip, 2);
+  }
+  Trace& Disable() { return Append({0x01}); }
+  Trace& Tnt() { return Append({0x0a}); }
+  Trace& Overflow() { return Append({0x02, 0xf3}); }
+  Trace& Append(std::vector<uint8_t> bytes) {
+    data_.insert(data_.end(), bytes.begin(), bytes.end());
+    return *this;
+  }
+
+  const std::vector<uint8_t>& GetData() const { return data_; }
+
+ private:
+  Trace& AppendLittleEndian(uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      data_.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+    return *this;
+  }
+
+  std::vector<uint8_t> data_;
+};
+}  // namespace
+
+TEST(IntelPtDecoder, PairsEntriesWithLastExits) {
+  // MTC every CTC tick, 10 TSC ticks each.
+  IntelPtDecoder decoder(kFunctionAddress, 0, 10.0);
+  Trace trace;
+  trace.Psb().Tsc(1000).Tma(0x1f0).PsbEnd();
+  // A call, which calls another function then returns.
+  trace.Mtc(0xf1).Enable(kFunctionAddress).Tnt();
+  trace.Mtc(0xf2).Disable();
+  trace.Mtc(0xf5).EnableCompressed(0x1020).Tnt();
+  trace.Mtc(0xf6).Disable();
+  // A second call, across the wrap of the payload of MTC.
+  trace.Mtc(0x02).Enable(kFunctionAddress);
+  trace.Mtc(0x03).Disable();
+  // The last call might not have returned.
+  trace.Mtc(0x04).Enable(kFunctionAddress).Mtc(0x05).Disable();
+
+  std::vector<IntelPtDecoder::Call> calls = decoder.Decode(trace.GetData());
+  ASSERT_EQ(calls.size(), 2);
+  EXPECT_EQ(calls[0].begin_tsc, 1010);
+  EXPECT_EQ(calls[0].end_tsc, 1060);
+  EXPECT_EQ(calls[1].begin_tsc, 1180);
+  EXPECT_EQ(calls[1].end_tsc, 1190);
+  EXPECT_EQ(decoder.GetNumDecodingErrors(), 0);
+}
+
+TEST(IntelPtDecoder, DropsCallsAcrossLostPackets) {
+  IntelPtDecoder decoder(kFunctionAddress, 0, 1.0);
+  Trace trace;
+  // Data before the first PSB is skipped.
+  trace.Append({0x42, 0x17}).Psb().Tsc(100).PsbEnd();
+  trace.Enable(kFunctionAddress).Overflow().Disable();
+  trace.Tsc(200).Enable(kFunctionAddress).Disable();
+  // An unknown packet: the decoder resumes at the next PSB.
+  trace.Tsc(300).Enable(kFunctionAddress).Append({0x02, 0xff});
+  trace.Disable().Tsc(400).Enable(kFunctionAddress);
+  trace.Psb().Tsc(500).PsbEnd().Enable(kFunctionAddress).Disable();
+  trace.Tsc(600).Enable(kFunctionAddress);
+
+  std::vector<IntelPtDecoder::Call> calls = decoder.Decode(trace.GetData());
+  ASSERT_EQ(calls.size(), 2);
+  EXPECT_EQ(calls[0].begin_tsc, 200);
+  EXPECT_EQ(calls[0].end_tsc, 200);
+  EXPECT_EQ(calls[1].begin_tsc, 500);
+  EXPECT_EQ(calls[1].end_tsc, 500);
+  EXPECT_EQ(decoder.GetNumDecodingErrors(), 1);
+}
+
+}  // namespace LinuxTracing
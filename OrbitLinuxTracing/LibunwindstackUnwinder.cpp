@@ -1,11 +1,18 @@
 #include "LibunwindstackUnwinder.h"
 
 #include <OrbitBase/Logging.h>
+#include <sys/mman.h>
 
 #include <array>
+#include <cstring>
+
+#include "Utils.h"
 
 namespace LinuxTracing {
 
+std::atomic<uint64_t> LibunwindstackUnwinder::unwind_count_ = 0;
+std::atomic<uint64_t> LibunwindstackUnwinder::total_unwinding_ns_ = 0;
+
 std::unique_ptr<unwindstack::BufferMaps> LibunwindstackUnwinder::ParseMaps(
     const std::string& maps_buffer) {
   auto maps = std::make_unique<unwindstack::BufferMaps>(maps_buffer.c_str());
@@ -28,6 +35,36 @@ std::vector<unwindstack::FrameData> LibunwindstackUnwinder::Unwind(
     unwindstack::Maps* maps,
     const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
     const char* stack_dump, uint64_t stack_dump_size) {
+  uint64_t begin_ns = MonotonicTimestampNs();
+  std::vector<unwindstack::FrameData> frames =
+      UnwindUntimed(maps, perf_regs, stack_dump, stack_dump_size);
+  total_unwinding_ns_.fetch_add(MonotonicTimestampNs() - begin_ns,
+                                std::memory_order_relaxed);
+  unwind_count_.fetch_add(1, std::memory_order_relaxed);
+  return frames;
+}
+
+LibunwindstackUnwinder::UnwindingStats
+LibunwindstackUnwinder::TakeUnwindingStats() {
+  UnwindingStats stats;
+  stats.unwind_count = unwind_count_.exchange(0, std::memory_order_relaxed);
+  stats.total_unwinding_ns =
+      total_unwinding_ns_.exchange(0, std::memory_order_relaxed);
+  return stats;
+}
+
+std::vector<unwindstack::FrameData> LibunwindstackUnwinder::UnwindUntimed(
+    unwindstack::Maps* maps,
+    const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
+    const char* stack_dump, uint64_t stack_dump_size) {
+  if (use_frame_pointers_) {
+    std::optional<std::vector<unwindstack::FrameData>> frames =
+        UnwindWithFramePointers(maps, perf_regs, stack_dump, stack_dump_size);
+    if (frames.has_value()) {
+      return std::move(frames.value());
+    }
+  }
+
   unwindstack::RegsX86_64 regs{};
   for (size_t perf_reg = 0; perf_reg < unwindstack::X86_64_REG_LAST;
        ++perf_reg) {
@@ -60,6 +97,56 @@ std::vector<unwindstack::FrameData> LibunwindstackUnwinder::Unwind(
   return unwinder.frames();
 }
 
+std::optional<std::vector<unwindstack::FrameData>>
+LibunwindstackUnwinder::UnwindWithFramePointers(
+    unwindstack::Maps* maps,
+    const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
+    const char* stack_dump, uint64_t stack_dump_size) {
+  const uint64_t stack_begin = perf_regs[PERF_REG_X86_SP];
+  const uint64_t stack_end = stack_begin + stack_dump_size;
+
+  std::vector<unwindstack::FrameData> frames;
+  uint64_t pc = perf_regs[PERF_REG_X86_IP];
+  uint64_t sp = stack_begin;
+  uint64_t fp = perf_regs[PERF_REG_X86_BP];
+  while (frames.size() < MAX_FRAMES) {
+    unwindstack::MapInfo* map_info = maps->Find(pc);
+    if (map_info == nullptr || (map_info->flags & PROT_EXEC) == 0) {
+      return std::nullopt;
+    }
+
+    unwindstack::FrameData& frame = frames.emplace_back();
+    frame.num = frames.size() - 1;
+    frame.pc = pc;
+    frame.sp = sp;
+    frame.map_name = map_info->name;
+    frame.map_start = map_info->start;
+    frame.map_end = map_info->end;
+    frame.map_exact_offset = map_info->offset;
+    frame.map_flags = map_info->flags;
+
+    if (map_info->name == "[uprobes]" || fp == 0) {
+      return frames;
+    }
+
+    // A frame record is the caller's rbp followed by the return address.
+    uint64_t frame_record[2];
+    if (fp < sp || fp + sizeof(frame_record) > stack_end) {
+      return std::nullopt;
+    }
+    memcpy(frame_record, stack_dump + (fp - stack_begin), sizeof(frame_record));
+    // The stack grows towards lower addresses, so the frame records of the
+    // callers must be at higher addresses: this also guarantees termination.
+    if (frame_record[0] != 0 && frame_record[0] <= fp) {
+      return std::nullopt;
+    }
+    pc = frame_record[1];
+    sp = fp + sizeof(frame_record);
+    fp = frame_record[0];
+  }
+  return std::nullopt;
+}
+
 std::vector<unwindstack::FrameData> LibunwindstackUnwinder::Unwind(
     const std::string& maps_buffer,
     const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
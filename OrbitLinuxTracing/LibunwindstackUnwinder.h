@@ -6,6 +6,8 @@
 #include <unwindstack/RegsX86_64.h>
 #include <unwindstack/Unwinder.h>
 
+#include <atomic>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -16,6 +18,15 @@ class LibunwindstackUnwinder {
   static std::unique_ptr<unwindstack::BufferMaps> ParseMaps(
       const std::string& maps_buffer);
 
+  // When set, the callstacks are first unwound by following the chain of frame
+  // pointers (see UnwindWithFramePointers), which is much faster than DWARF
+  // unwinding but only correct for binaries built with
+  // -fno-omit-frame-pointer. DWARF unwinding is still used when the frame
+  // pointer chain cannot be followed to the end.
+  void SetUseFramePointers(bool use_frame_pointers) {
+    use_frame_pointers_ = use_frame_pointers;
+  }
+
   std::vector<unwindstack::FrameData> Unwind(
       unwindstack::Maps* maps,
       const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
@@ -26,9 +37,41 @@ class LibunwindstackUnwinder {
       const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
       const char* stack_dump, uint64_t stack_dump_size);
 
+  // Walks the chain of frame records (saved rbp, return address) starting from
+  // rbp, reading them from the stack dump. Returns std::nullopt, meaning that
+  // DWARF unwinding is needed, if an address of the callstack is not in an
+  // executable mapping or if the chain leaves the stack dump before reaching
+  // the outermost frame (rbp equal to 0). Like for DWARF unwinding, the
+  // callstack ends at a return address hijacked by uretprobes. Function names
+  // are not resolved.
+  // Note that a sample in the prologue of a function, before rbp is set up,
+  // misses the caller of the function.
+  static std::optional<std::vector<unwindstack::FrameData>>
+  UnwindWithFramePointers(
+      unwindstack::Maps* maps,
+      const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
+      const char* stack_dump, uint64_t stack_dump_size);
+
+  // Of the calls to Unwind of all unwinders since the last call.
+  struct UnwindingStats {
+    uint64_t unwind_count = 0;
+    uint64_t total_unwinding_ns = 0;
+  };
+  static UnwindingStats TakeUnwindingStats();
+
  private:
   static constexpr size_t MAX_FRAMES = 1024;  // This is arbitrary.
 
+  std::vector<unwindstack::FrameData> UnwindUntimed(
+      unwindstack::Maps* maps,
+      const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
+      const char* stack_dump, uint64_t stack_dump_size);
+
+  static std::atomic<uint64_t> unwind_count_;
+  static std::atomic<uint64_t> total_unwinding_ns_;
+
+  bool use_frame_pointers_ = false;
+
   static const std::array<size_t, unwindstack::X86_64_REG_LAST>
       UNWINDSTACK_REGS_TO_PERF_REGS;
 
@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+
+#include <cstring>
+#include <vector>
+
+#include "LibunwindstackUnwinder.h"
+
+namespace LinuxTracing {
+
+namespace {
+constexpr uint64_t STACK_BEGIN = 0x7f0000000000;
+
+class FramePointersTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    maps_.Add(0x1000, 0x2000, 0, PROT_READ | PROT_EXEC, "/path/to/a.out", 0);
+    maps_.Add(0x2000, 0x3000, 0x1000, PROT_READ | PROT_WRITE, "/path/to/a.out",
+              0);
+    maps_.Add(0x8000, 0x9000, 0, PROT_READ | PROT_EXEC, "[uprobes]", 0);
+    perf_regs_.fill(0);
+    perf_regs_[PERF_REG_X86_SP] = STACK_BEGIN;
+    perf_regs_[PERF_REG_X86_IP] = 0x1100;
+  }
+
+  // Writes a frame record (caller's rbp, return address) into the stack dump
+  // at address.
+  void AddFrameRecord(uint64_t address, uint64_t caller_fp,
+                      uint64_t return_address) {
+    uint64_t offset = address - STACK_BEGIN;
+    if (stack_.size() < offset + 2 * sizeof(uint64_t)) {
+      stack_.resize(offset + 2 * sizeof(uint64_t));
+    }
+    memcpy(stack_.data() + offset, &caller_fp, sizeof(caller_fp));
+    memcpy(stack_.data() + offset + sizeof(caller_fp), &return_address,
+           sizeof(return_address));
+  }
+
+  std::optional<std::vector<unwindstack::FrameData>> Unwind() {
+    return LibunwindstackUnwinder::UnwindWithFramePointers(
+        &maps_, perf_regs_, stack_.data(), stack_.size());
+  }
+
+  static std::vector<uint64_t> Pcs(
+      const std::vector<unwindstack::FrameData>& frames) {
+    std::vector<uint64_t> pcs;
+    for (const unwindstack::FrameData& frame : frames) {
+      pcs.push_back(frame.pc);
+    }
+    return pcs;
+  }
+
+  unwindstack::Maps maps_;
+  std::array<uint64_t, PERF_REG_X86_64_MAX> perf_regs_{};
+  std::vector<char> stack_;
+};
+}  // namespace
+
+TEST_F(FramePointersTest, FollowsChainToOutermostFrame) {
+  perf_regs_[PERF_REG_X86_BP] = STACK_BEGIN + 0x10;
+  AddFrameRecord(STACK_BEGIN + 0x10, STACK_BEGIN + 0x40, 0x1200);
+  AddFrameRecord(STACK_BEGIN + 0x40, 0, 0x1300);
+
+  std::optional<std::vector<unwindstack::FrameData>> frames = Unwind();
+  ASSERT_TRUE(frames.has_value());
+  EXPECT_EQ(Pcs(frames.value()),
+            (std::vector<uint64_t>{0x1100, 0x1200, 0x1300}));
+  EXPECT_EQ(frames.value()[1].sp, STACK_BEGIN + 0x20);
+  EXPECT_EQ(frames.value()[2].map_name, "/path/to/a.out");
+  EXPECT_EQ(frames.value()[2].num, 2);
+}
+
+TEST_F(FramePointersTest, StopsAtUprobes) {
+  perf_regs_[PERF_REG_X86_BP] = STACK_BEGIN;
+  AddFrameRecord(STACK_BEGIN, STACK_BEGIN + 0x40, 0x8000);
+  AddFrameRecord(STACK_BEGIN + 0x40, 0, 0x1300);
+
+  std::optional<std::vector<unwindstack::FrameData>> frames = Unwind();
+  ASSERT_TRUE(frames.has_value());
+  EXPECT_EQ(Pcs(frames.value()), (std::vector<uint64_t>{0x1100, 0x8000}));
+  EXPECT_EQ(frames.value().back().map_name, "[uprobes]");
+}
+
+TEST_F(FramePointersTest, FailsOnNonExecutableAddress) {
+  perf_regs_[PERF_REG_X86_BP] = STACK_BEGIN;
+  AddFrameRecord(STACK_BEGIN, 0, 0x2100);
+  EXPECT_FALSE(Unwind().has_value());
+
+  // Unmapped.
+  AddFrameRecord(STACK_BEGIN, 0, 0x5000);
+  EXPECT_FALSE(Unwind().has_value());
+}
+
+TEST_F(FramePointersTest, FailsWhenChainLeavesStackDump) {
+  perf_regs_[PERF_REG_X86_BP] = STACK_BEGIN;
+  AddFrameRecord(STACK_BEGIN, STACK_BEGIN + 0x1000, 0x1200);
+  EXPECT_FALSE(Unwind().has_value());
+
+  // rbp is not a frame pointer, like in code built without frame pointers.
+  perf_regs_[PERF_REG_X86_BP] = 42;
+  EXPECT_FALSE(Unwind().has_value());
+}
+
+TEST_F(FramePointersTest, FailsOnNonIncreasingFramePointers) {
+  perf_regs_[PERF_REG_X86_BP] = STACK_BEGIN + 0x10;
+  AddFrameRecord(STACK_BEGIN + 0x10, STACK_BEGIN + 0x10, 0x1200);
+  EXPECT_FALSE(Unwind().has_value());
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,114 @@
+#include "PerProcessVisitor.h"
+
+namespace LinuxTracing {
+
+void PerProcessVisitor::AddProcess(pid_t pid,
+                                   const std::string& initial_maps) {
+  visitors_.insert_or_assign(pid, visitor_factory_(pid, initial_maps));
+}
+
+PerfEventVisitor* PerProcessVisitor::GetVisitor(pid_t pid) const {
+  auto it = visitors_.find(pid);
+  return it != visitors_.end() ? it->second.get() : nullptr;
+}
+
+void PerProcessVisitor::visit(StackSamplePerfEvent* event) {
+  if (PerfEventVisitor* visitor = GetVisitor(event->GetPid())) {
+    visitor->visit(event);
+  }
+}
+
+void PerProcessVisitor::visit(OffCpuStackSamplePerfEvent* event) {
+  if (PerfEventVisitor* visitor = GetVisitor(event->GetPid())) {
+    visitor->visit(event);
+  }
+}
+
+void PerProcessVisitor::visit(SchedSwitchInPerfEvent* event) {
+  for (const auto& pid_and_visitor : visitors_) {
+    pid_and_visitor.second->visit(event);
+  }
+}
+
+void PerProcessVisitor::visit(GpuSubmissionStackSamplePerfEvent* event) {
+  if (PerfEventVisitor* visitor = GetVisitor(event->GetPid())) {
+    visitor->visit(event);
+  }
+}
+
+void PerProcessVisitor::visit(PageFaultStackSamplePerfEvent* event) {
+  if (PerfEventVisitor* visitor = GetVisitor(event->GetPid())) {
+    visitor->visit(event);
+  }
+}
+
+void PerProcessVisitor::visit(HeapAllocationStackSamplePerfEvent* event) {
+  if (PerfEventVisitor* visitor = GetVisitor(event->GetPid())) {
+    visitor->visit(event);
+  }
+}
+
+void PerProcessVisitor::visit(LockWaitStackSamplePerfEvent* event) {
+  if (PerfEventVisitor* visitor = GetVisitor(event->GetPid())) {
+    visitor->visit(event);
+  }
+}
+
+void PerProcessVisitor::visit(UprobesWithStackPerfEvent* event) {
+  if (PerfEventVisitor* visitor = GetVisitor(event->GetPid())) {
+    visitor->visit(event);
+  }
+}
+
+void PerProcessVisitor::visit(UprobesPerfEvent* event) {
+  if (PerfEventVisitor* visitor = GetVisitor(event->GetPid())) {
+    visitor->visit(event);
+  }
+}
+
+void PerProcessVisitor::visit(UretprobesPerfEvent* event) {
+  if (PerfEventVisitor* visitor = GetVisitor(event->GetPid())) {
+    visitor->visit(event);
+  }
+}
+
+void PerProcessVisitor::visit(PmuCounterSwitchPerfEvent* event) {
+  for (const auto& pid_and_visitor : visitors_) {
+    pid_and_visitor.second->visit(event);
+  }
+}
+
+void PerProcessVisitor::visit(HeapAllocationPerfEvent* event) {
+  if (PerfEventVisitor* visitor = GetVisitor(event->GetPid())) {
+    visitor->visit(event);
+  }
+}
+
+void PerProcessVisitor::visit(HeapFreePerfEvent* event) {
+  if (PerfEventVisitor* visitor = GetVisitor(event->GetPid())) {
+    visitor->visit(event);
+  }
+}
+
+void PerProcessVisitor::visit(LockWaitPerfEvent* event) {
+  if (PerfEventVisitor* visitor = GetVisitor(event->GetPid())) {
+    visitor->visit(event);
+  }
+}
+
+void PerProcessVisitor::visit(MapsPerfEvent* event) {
+  PerfEventVisitor* visitor = GetVisitor(event->GetPid());
+  if (visitor == nullptr) {
+    AddProcess(event->GetPid(), event->GetMaps());
+    return;
+  }
+  visitor->visit(event);
+}
+
+void PerProcessVisitor::visit(MmapPerfEvent* event) {
+  if (PerfEventVisitor* visitor = GetVisitor(event->GetPid())) {
+    visitor->visit(event);
+  }
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,64 @@
+#ifndef ORBIT_LINUX_TRACING_PER_PROCESS_VISITOR_H_
+#define ORBIT_LINUX_TRACING_PER_PROCESS_VISITOR_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "PerfEvent.h"
+#include "PerfEventVisitor.h"
+#include "absl/container/flat_hash_map.h"
+
+namespace LinuxTracing {
+
+// Passes the events of each target process to a visitor of its own, created
+// with visitor_factory from the initial maps of the process, so that a single
+// capture can trace several processes with separate maps and unwinders (see
+// Tracer::Tracer(std::vector<pid_t>, ...)). The context switches of the PMU
+// counters and the switches in of threads carry no pid, and are passed to all
+// the visitors: they only keep state per thread, and thread ids are unique
+// across processes. Events of processes without a visitor are dropped, except
+// for maps, which add the process.
+class PerProcessVisitor : public PerfEventVisitor {
+ public:
+  using VisitorFactory = std::function<std::unique_ptr<PerfEventVisitor>(
+      pid_t pid, const std::string& initial_maps)>;
+
+  explicit PerProcessVisitor(VisitorFactory visitor_factory)
+      : visitor_factory_(std::move(visitor_factory)) {}
+
+  PerProcessVisitor(const PerProcessVisitor&) = delete;
+  PerProcessVisitor& operator=(const PerProcessVisitor&) = delete;
+
+  // Replaces the visitor of pid, if any.
+  void AddProcess(pid_t pid, const std::string& initial_maps);
+  size_t GetProcessCount() const { return visitors_.size(); }
+
+  void visit(StackSamplePerfEvent* event) override;
+  void visit(OffCpuStackSamplePerfEvent* event) override;
+  void visit(SchedSwitchInPerfEvent* event) override;
+  void visit(GpuSubmissionStackSamplePerfEvent* event) override;
+  void visit(PageFaultStackSamplePerfEvent* event) override;
+  void visit(HeapAllocationStackSamplePerfEvent* event) override;
+  void visit(LockWaitStackSamplePerfEvent* event) override;
+  void visit(UprobesWithStackPerfEvent* event) override;
+  void visit(UprobesPerfEvent* event) override;
+  void visit(UretprobesPerfEvent* event) override;
+  void visit(PmuCounterSwitchPerfEvent* event) override;
+  void visit(HeapAllocationPerfEvent* event) override;
+  void visit(HeapFreePerfEvent* event) override;
+  void visit(LockWaitPerfEvent* event) override;
+  void visit(MapsPerfEvent* event) override;
+  void visit(MmapPerfEvent* event) override;
+
+ private:
+  // nullptr if pid is not a target process.
+  PerfEventVisitor* GetVisitor(pid_t pid) const;
+
+  VisitorFactory visitor_factory_;
+  absl::flat_hash_map<pid_t, std::unique_ptr<PerfEventVisitor>> visitors_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_PER_PROCESS_VISITOR_H_
@@ -0,0 +1,100 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "PerProcessVisitor.h"
+
+namespace LinuxTracing {
+
+namespace {
+// Records, in one log shared by all the processes, "<pid>:<event>".
+class LoggingVisitor : public PerfEventVisitor {
+ public:
+  LoggingVisitor(pid_t pid, std::vector<std::string>* log)
+      : pid_(pid), log_(log) {}
+
+  void visit(UprobesPerfEvent* event) override {
+    Log("uprobes " + std::to_string(event->GetTid()));
+  }
+  void visit(SchedSwitchInPerfEvent* event) override {
+    Log("switch in " + std::to_string(event->GetTid()));
+  }
+  void visit(MapsPerfEvent* event) override {
+    Log("maps " + event->GetMaps());
+  }
+  void visit(MmapPerfEvent* event) override {
+    Log("mmap " + event->GetFilename());
+  }
+
+ private:
+  void Log(const std::string& entry) {
+    log_->push_back(std::to_string(pid_) + ":" + entry);
+  }
+
+  pid_t pid_;
+  std::vector<std::string>* log_;
+};
+
+PerProcessVisitor MakeLoggingVisitor(std::vector<std::string>* log) {
+  return PerProcessVisitor{[log](pid_t pid, const std::string& initial_maps) {
+    log->push_back(std::to_string(pid) + ":created with " + initial_maps);
+    return std::make_unique<LoggingVisitor>(pid, log);
+  }};
+}
+}  // namespace
+
+TEST(PerProcessVisitor, RoutesEventsByPid) {
+  std::vector<std::string> log;
+  PerProcessVisitor visitor = MakeLoggingVisitor(&log);
+  visitor.AddProcess(10, "maps of 10");
+  visitor.AddProcess(20, "maps of 20");
+  ASSERT_EQ(visitor.GetProcessCount(), 2);
+  log.clear();
+
+  UprobesPerfEvent uprobes_of_10{1, 10, 11, 0, 0, 0, {}};
+  uprobes_of_10.Accept(&visitor);
+  UprobesPerfEvent uprobes_of_20{2, 20, 21, 0, 0, 0, {}};
+  uprobes_of_20.Accept(&visitor);
+  // Not a target process.
+  UprobesPerfEvent uprobes_of_30{3, 30, 31, 0, 0, 0, {}};
+  uprobes_of_30.Accept(&visitor);
+  MmapPerfEvent mmap_of_20{4, 20, 0x1000, 0x1000, 0, "/lib.so"};
+  mmap_of_20.Accept(&visitor);
+  MapsPerfEvent maps_of_10{5, 10, "new maps"};
+  maps_of_10.Accept(&visitor);
+
+  EXPECT_THAT(log,
+              ::testing::ElementsAre("10:uprobes 11", "20:uprobes 21",
+                                     "20:mmap /lib.so", "10:maps new maps"));
+}
+
+TEST(PerProcessVisitor, PassesEventsWithoutPidToAllProcesses) {
+  std::vector<std::string> log;
+  PerProcessVisitor visitor = MakeLoggingVisitor(&log);
+  visitor.AddProcess(10, "");
+  visitor.AddProcess(20, "");
+  log.clear();
+
+  SchedSwitchInPerfEvent switch_in{1, 21};
+  switch_in.Accept(&visitor);
+  EXPECT_THAT(log, ::testing::UnorderedElementsAre("10:switch in 21",
+                                                   "20:switch in 21"));
+}
+
+TEST(PerProcessVisitor, MapsOfAnotherProcessAddIt) {
+  std::vector<std::string> log;
+  PerProcessVisitor visitor = MakeLoggingVisitor(&log);
+  MapsPerfEvent maps_of_10{1, 10, "maps of 10"};
+  maps_of_10.Accept(&visitor);
+  UprobesPerfEvent uprobes_of_10{2, 10, 11, 0, 0, 0, {}};
+  uprobes_of_10.Accept(&visitor);
+
+  EXPECT_EQ(visitor.GetProcessCount(), 1);
+  EXPECT_THAT(log, ::testing::ElementsAre("10:created with maps of 10",
+                                          "10:uprobes 11"));
+}
+
+}  // namespace LinuxTracing
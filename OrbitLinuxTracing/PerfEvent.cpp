@@ -4,36 +4,11 @@
 
 namespace LinuxTracing {
 
-// These cannot be implemented in the header PerfEvent.h, because there
+// This cannot be implemented in the header PerfEvent.h, because there
 // PerfEventVisitor needs to be an incomplete type to avoid the circular
 // dependency between PerfEvent.h and PerfEventVisitor.h.
-
-void ForkPerfEvent::Accept(PerfEventVisitor* visitor) { visitor->visit(this); }
-
-void ExitPerfEvent::Accept(PerfEventVisitor* visitor) { visitor->visit(this); }
-
-void ContextSwitchPerfEvent::Accept(PerfEventVisitor* visitor) {
-  visitor->visit(this);
-}
-
-void SystemWideContextSwitchPerfEvent::Accept(PerfEventVisitor* visitor) {
-  visitor->visit(this);
-}
-
-void StackSamplePerfEvent::Accept(PerfEventVisitor* visitor) {
-  visitor->visit(this);
+void PerfEvent::Accept(PerfEventVisitor* visitor) {
+  VisitPerfEvent(this, visitor);
 }
 
-void UprobesWithStackPerfEvent::Accept(PerfEventVisitor* visitor) {
-  visitor->visit(this);
-}
-
-void UretprobesPerfEvent::Accept(PerfEventVisitor* visitor) {
-  visitor->visit(this);
-}
-
-void LostPerfEvent::Accept(PerfEventVisitor* visitor) { visitor->visit(this); }
-
-void MapsPerfEvent::Accept(PerfEventVisitor* visitor) { visitor->visit(this); }
-
 }  // namespace LinuxTracing
@@ -1,46 +1,93 @@
 #ifndef ORBIT_LINUX_TRACING_PERF_EVENT_H_
 #define ORBIT_LINUX_TRACING_PERF_EVENT_H_
 
+#include <OrbitLinuxTracing/Events.h>
 #include <OrbitLinuxTracing/Function.h>
 
 #include <array>
 #include <memory>
+#include <optional>
+#include <vector>
 
 #include "MakeUniqueForOverwrite.h"
+#include "PerfEventMemoryPool.h"
 #include "PerfEventRecords.h"
 
 namespace LinuxTracing {
 
 class PerfEventVisitor;
 
+// The concrete type of a PerfEvent, for the events to be dispatched with a
+// switch instead of a virtual call per event, see VisitPerfEvent. Keep this in
+// sync with the hierarchy of PerfEvent.
+enum class PerfEventType : uint8_t {
+  kFork,
+  kExit,
+  kContextSwitch,
+  kSystemWideContextSwitch,
+  kStackSample,
+  kOffCpuStackSample,
+  kSchedSwitchIn,
+  kGpuSubmissionStackSample,
+  kPageFaultStackSample,
+  kHeapAllocationStackSample,
+  kLockWaitStackSample,
+  kUprobesWithStack,
+  kUprobes,
+  kUretprobes,
+  kLost,
+  kMaps,
+  kMmap,
+  kComm,
+  kCallchainSample,
+  kThreadState,
+  kPmuCounterSwitch,
+  kHeapAllocation,
+  kHeapFree,
+  kLockWait,
+};
+
 // This base class is used to do processing of different perf_event_open events
 // using the visitor pattern. To avoid unnecessary copies, the data of the
 // perf_event_open records will be copied from the ring buffer directly into the
 // concrete subclass (depending on the event type), in general into a
 // "ring_buffer_record" field.
+// PerfEvents are allocated from PerfEventMemoryPool, as they are created and
+// destroyed at a very high rate and on different threads.
 
 class PerfEvent {
  public:
+  explicit PerfEvent(PerfEventType type) : type_{type} {}
   virtual ~PerfEvent() = default;
+  static void* operator new(size_t size) {
+    return PerfEventMemoryPool::Allocate(size);
+  }
+  static void operator delete(void* ptr, size_t size) {
+    PerfEventMemoryPool::Deallocate(ptr, size);
+  }
   virtual uint64_t GetTimestamp() const = 0;
-  virtual void Accept(PerfEventVisitor* visitor) = 0;
+  PerfEventType GetType() const { return type_; }
+  // Calls the visit method of visitor for the concrete type of this event, see
+  // VisitPerfEvent.
+  void Accept(PerfEventVisitor* visitor);
   void SetOriginFileDescriptor(int fd) { origin_file_descriptor_ = fd; }
   int GetOriginFileDescriptor() const { return origin_file_descriptor_; }
 
  private:
+  PerfEventType type_;
   int origin_file_descriptor_ = -1;
 };
 
 class ContextSwitchPerfEvent : public PerfEvent {
  public:
+  ContextSwitchPerfEvent() : PerfEvent{PerfEventType::kContextSwitch} {}
+
   perf_event_context_switch ring_buffer_record;
 
   uint64_t GetTimestamp() const override {
     return ring_buffer_record.sample_id.time;
   }
 
-  void Accept(PerfEventVisitor* visitor) override;
-
   pid_t GetPid() const { return ring_buffer_record.sample_id.pid; }
 
   pid_t GetTid() const { return ring_buffer_record.sample_id.tid; }
@@ -59,14 +106,15 @@ class ContextSwitchPerfEvent : public PerfEvent {
 
 class SystemWideContextSwitchPerfEvent : public PerfEvent {
  public:
+  SystemWideContextSwitchPerfEvent()
+      : PerfEvent{PerfEventType::kSystemWideContextSwitch} {}
+
   perf_event_context_switch_cpu_wide ring_buffer_record;
 
   uint64_t GetTimestamp() const override {
     return ring_buffer_record.sample_id.time;
   }
 
-  void Accept(PerfEventVisitor* visitor) override;
-
   pid_t GetPid() const { return ring_buffer_record.sample_id.pid; }
 
   pid_t GetTid() const { return ring_buffer_record.sample_id.tid; }
@@ -109,12 +157,12 @@ class SystemWideContextSwitchPerfEvent : public PerfEvent {
 
 class ForkPerfEvent : public PerfEvent {
  public:
+  ForkPerfEvent() : PerfEvent{PerfEventType::kFork} {}
+
   perf_event_fork_exit ring_buffer_record;
 
   uint64_t GetTimestamp() const override { return ring_buffer_record.time; }
 
-  void Accept(PerfEventVisitor* visitor) override;
-
   pid_t GetPid() const { return ring_buffer_record.pid; }
   pid_t GetParentPid() const { return ring_buffer_record.ppid; }
   pid_t GetTid() const { return ring_buffer_record.tid; }
@@ -129,12 +177,12 @@ class ForkPerfEvent : public PerfEvent {
 
 class ExitPerfEvent : public PerfEvent {
  public:
+  ExitPerfEvent() : PerfEvent{PerfEventType::kExit} {}
+
   perf_event_fork_exit ring_buffer_record;
 
   uint64_t GetTimestamp() const override { return ring_buffer_record.time; }
 
-  void Accept(PerfEventVisitor* visitor) override;
-
   pid_t GetPid() const { return ring_buffer_record.pid; }
   pid_t GetParentPid() const { return ring_buffer_record.ppid; }
   pid_t GetTid() const { return ring_buffer_record.tid; }
@@ -149,14 +197,14 @@ class ExitPerfEvent : public PerfEvent {
 
 class LostPerfEvent : public PerfEvent {
  public:
+  LostPerfEvent() : PerfEvent{PerfEventType::kLost} {}
+
   perf_event_lost ring_buffer_record;
 
   uint64_t GetTimestamp() const override {
     return ring_buffer_record.sample_id.time;
   }
 
-  void Accept(PerfEventVisitor* visitor) override;
-
   uint64_t GetNumLost() const { return ring_buffer_record.lost; }
 
   uint64_t GetStreamId() const {
@@ -170,11 +218,11 @@ struct __attribute__((__packed__)) dynamically_sized_perf_event_stack_sample {
   struct __attribute__((__packed__))
   dynamically_sized_perf_event_sample_stack_user {
     uint64_t dyn_size;
-    std::unique_ptr<char[]> data;
+    PooledArray<char> data;
 
     explicit dynamically_sized_perf_event_sample_stack_user(uint64_t dyn_size)
         : dyn_size{dyn_size},
-          data{make_unique_for_overwrite<char[]>(dyn_size)} {}
+          data{make_pooled_array_for_overwrite<char>(dyn_size)} {}
   };
 
   perf_event_header header;
@@ -184,14 +232,22 @@ struct __attribute__((__packed__)) dynamically_sized_perf_event_stack_sample {
 
   explicit dynamically_sized_perf_event_stack_sample(uint64_t dyn_size)
       : stack{dyn_size} {}
+
+  static void* operator new(size_t size) {
+    return PerfEventMemoryPool::Allocate(size);
+  }
+  static void operator delete(void* ptr, size_t size) {
+    PerfEventMemoryPool::Deallocate(ptr, size);
+  }
 };
 
 class SamplePerfEvent : public PerfEvent {
  public:
   std::unique_ptr<dynamically_sized_perf_event_stack_sample> ring_buffer_record;
 
-  explicit SamplePerfEvent(uint64_t dyn_size)
-      : ring_buffer_record{
+  SamplePerfEvent(PerfEventType type, uint64_t dyn_size)
+      : PerfEvent{type},
+        ring_buffer_record{
             std::make_unique<dynamically_sized_perf_event_stack_sample>(
                 dyn_size)} {}
 
@@ -255,9 +311,85 @@ class SamplePerfEvent : public PerfEvent {
 class StackSamplePerfEvent : public SamplePerfEvent {
  public:
   explicit StackSamplePerfEvent(uint64_t dyn_size)
-      : SamplePerfEvent{dyn_size} {}
+      : SamplePerfEvent{PerfEventType::kStackSample, dyn_size} {}
 
-  void Accept(PerfEventVisitor* visitor) override;
+ protected:
+  // For the more specific stack samples.
+  StackSamplePerfEvent(PerfEventType type, uint64_t dyn_size)
+      : SamplePerfEvent{type, dyn_size} {}
+};
+
+// The stack of a thread of the target process when it blocked and was switched
+// out of a core, from sched:sched_switch (see sched_switch_stack_event_open).
+// Its callstack is only reported once the thread is switched in again
+// (SchedSwitchInPerfEvent), with the time the thread spent off the cores.
+class OffCpuStackSamplePerfEvent : public StackSamplePerfEvent {
+ public:
+  explicit OffCpuStackSamplePerfEvent(uint64_t dyn_size)
+      : StackSamplePerfEvent{PerfEventType::kOffCpuStackSample, dyn_size} {}
+};
+
+// The stack of a thread of the target process when it submitted a command
+// buffer to the GPU, from amdgpu:amdgpu_cs_ioctl (see
+// tracepoint_stack_event_open). Its timestamp is the one of the tracepoint,
+// which the GpuJob of the submission also carries.
+class GpuSubmissionStackSamplePerfEvent : public StackSamplePerfEvent {
+ public:
+  explicit GpuSubmissionStackSamplePerfEvent(uint64_t dyn_size)
+      : StackSamplePerfEvent{PerfEventType::kGpuSubmissionStackSample,
+                             dyn_size} {}
+};
+
+// The stack of a thread of a target process when it faulted on a page, from
+// the page fault software events (see page_fault_event_open).
+class PageFaultStackSamplePerfEvent : public StackSamplePerfEvent {
+ public:
+  explicit PageFaultStackSamplePerfEvent(uint64_t dyn_size)
+      : StackSamplePerfEvent{PerfEventType::kPageFaultStackSample, dyn_size} {}
+
+  bool IsMajor() const { return major_; }
+  void SetMajor(bool major) { major_ = major; }
+
+ private:
+  bool major_ = false;
+};
+
+// The stack of a thread of a target process when it called the allocator for
+// an allocation sampled by BpfHeapProfiler, from the uprobes of the allocation
+// functions. The allocation is only reported once it returned
+// (HeapAllocationPerfEvent).
+class HeapAllocationStackSamplePerfEvent : public StackSamplePerfEvent {
+ public:
+  explicit HeapAllocationStackSamplePerfEvent(uint64_t dyn_size)
+      : StackSamplePerfEvent{PerfEventType::kHeapAllocationStackSample,
+                             dyn_size} {}
+};
+
+// The stack of a thread of a target process when it returned from a futex
+// wait that BpfLockContention reported, from syscalls:sys_exit_futex (see
+// tracepoint_stack_event_open). It follows the LockWaitPerfEvent of the wait.
+class LockWaitStackSamplePerfEvent : public StackSamplePerfEvent {
+ public:
+  explicit LockWaitStackSamplePerfEvent(uint64_t dyn_size)
+      : StackSamplePerfEvent{PerfEventType::kLockWaitStackSample, dyn_size} {}
+};
+
+// A thread of the target process was switched in on a core, decoded by
+// TracerThread from the same records as OffCpuStackSamplePerfEvent.
+class SchedSwitchInPerfEvent : public PerfEvent {
+ public:
+  SchedSwitchInPerfEvent(uint64_t timestamp, pid_t tid)
+      : PerfEvent{PerfEventType::kSchedSwitchIn},
+        timestamp_{timestamp},
+        tid_{tid} {}
+
+  uint64_t GetTimestamp() const override { return timestamp_; }
+
+  pid_t GetTid() const { return tid_; }
+
+ private:
+  uint64_t timestamp_;
+  pid_t tid_;
 };
 
 class AbstractUprobesPerfEvent {
@@ -265,29 +397,75 @@ class AbstractUprobesPerfEvent {
   const Function* GetFunction() const { return function_; }
   void SetFunction(const Function* function) { function_ = function; }
 
+  // For functions with Function::RecordingMode::kTimingAndPmuCounters, the
+  // values of the PMU counters of the cpu when the probe fired.
+  const std::optional<PmuCounterValues>& GetPmuCounters() const {
+    return pmu_counters_;
+  }
+  void SetPmuCounters(const PmuCounterValues& pmu_counters) {
+    pmu_counters_ = pmu_counters;
+  }
+
  private:
   const Function* function_ = nullptr;
+  std::optional<PmuCounterValues> pmu_counters_;
 };
 
 class UprobesWithStackPerfEvent : public SamplePerfEvent,
                                   public AbstractUprobesPerfEvent {
  public:
   explicit UprobesWithStackPerfEvent(uint64_t dyn_size)
-      : SamplePerfEvent{dyn_size} {}
+      : SamplePerfEvent{PerfEventType::kUprobesWithStack, dyn_size} {}
+};
+
+// Uprobes of functions instrumented without callstack, which only carry the
+// registers in SAMPLE_REGS_USER_SP_IP, and possibly the arguments.
+class UprobesPerfEvent : public PerfEvent, public AbstractUprobesPerfEvent {
+ public:
+  UprobesPerfEvent(uint64_t timestamp, pid_t pid, pid_t tid, uint32_t cpu,
+                   uint64_t sp, uint64_t ip, std::vector<uint64_t> arguments)
+      : PerfEvent{PerfEventType::kUprobes},
+        timestamp_{timestamp},
+        pid_{pid},
+        tid_{tid},
+        cpu_{cpu},
+        sp_{sp},
+        ip_{ip},
+        arguments_{std::move(arguments)} {}
+
+  uint64_t GetTimestamp() const override { return timestamp_; }
+
+  pid_t GetPid() const { return pid_; }
+  pid_t GetTid() const { return tid_; }
+  uint32_t GetCpu() const { return cpu_; }
+  uint64_t GetSp() const { return sp_; }
+  uint64_t GetIp() const { return ip_; }
 
-  void Accept(PerfEventVisitor* visitor) override;
+  // The integer arguments in order (rdi, rsi, rdx, rcx, r8, r9), or empty if
+  // they were not recorded.
+  const std::vector<uint64_t>& GetArguments() const { return arguments_; }
+
+ private:
+  uint64_t timestamp_;
+  pid_t pid_;
+  pid_t tid_;
+  uint32_t cpu_;
+  uint64_t sp_;
+  uint64_t ip_;
+  std::vector<uint64_t> arguments_;
 };
 
 class UretprobesPerfEvent : public PerfEvent, public AbstractUprobesPerfEvent {
  public:
-  perf_event_empty_sample ring_buffer_record;
+  UretprobesPerfEvent() : PerfEvent{PerfEventType::kUretprobes} {}
+
+  // When the record has no registers (see perf_event_ax_sample), ax is zero.
+  perf_event_ax_sample ring_buffer_record{};
 
   uint64_t GetTimestamp() const override {
     return ring_buffer_record.sample_id.time;
   }
 
-  void Accept(PerfEventVisitor* visitor) override;
-
   pid_t GetPid() const { return ring_buffer_record.sample_id.pid; }
   pid_t GetTid() const { return ring_buffer_record.sample_id.tid; }
 
@@ -296,32 +474,251 @@ class UretprobesPerfEvent : public PerfEvent, public AbstractUprobesPerfEvent {
   }
 
   uint32_t GetCpu() const { return ring_buffer_record.sample_id.cpu; }
+
+  uint64_t GetReturnValue() const { return ring_buffer_record.regs.ax; }
+};
+
+// This is decoded from the sched tracepoints by TracerThread, which only keeps
+// the changes of the threads of the target process.
+class ThreadStatePerfEvent : public PerfEvent {
+ public:
+  ThreadStatePerfEvent(uint64_t timestamp, pid_t tid, ThreadState state,
+                       pid_t waker_tid)
+      : PerfEvent{PerfEventType::kThreadState},
+        timestamp_{timestamp},
+        tid_{tid},
+        state_{state},
+        waker_tid_{waker_tid} {}
+
+  uint64_t GetTimestamp() const override { return timestamp_; }
+
+  pid_t GetTid() const { return tid_; }
+  ThreadState GetState() const { return state_; }
+  pid_t GetWakerTid() const { return waker_tid_; }
+
+ private:
+  uint64_t timestamp_;
+  pid_t tid_;
+  ThreadState state_;
+  pid_t waker_tid_;
+};
+
+// The values of the PMU counters of a cpu when a thread is switched out of it,
+// from sched:sched_switch (see sched_switch_pmu_counters_event_open), which
+// tell the counts of the thread while it ran.
+class PmuCounterSwitchPerfEvent : public PerfEvent {
+ public:
+  PmuCounterSwitchPerfEvent(uint64_t timestamp, pid_t prev_tid, uint32_t cpu,
+                            const PmuCounterValues& pmu_counters)
+      : PerfEvent{PerfEventType::kPmuCounterSwitch},
+        timestamp_{timestamp},
+        prev_tid_{prev_tid},
+        cpu_{cpu},
+        pmu_counters_{pmu_counters} {}
+
+  uint64_t GetTimestamp() const override { return timestamp_; }
+
+  pid_t GetPrevTid() const { return prev_tid_; }
+  uint32_t GetCpu() const { return cpu_; }
+  const PmuCounterValues& GetPmuCounters() const { return pmu_counters_; }
+
+ private:
+  uint64_t timestamp_;
+  pid_t prev_tid_;
+  uint32_t cpu_;
+  PmuCounterValues pmu_counters_;
+};
+
+// A sampled allocation returned, or a sampled block was freed, decoded by
+// TracerThread from the records of BpfHeapProfiler.
+class HeapAllocationPerfEvent : public PerfEvent {
+ public:
+  HeapAllocationPerfEvent(uint64_t timestamp, pid_t pid, pid_t tid,
+                          uint64_t address, uint64_t size)
+      : PerfEvent{PerfEventType::kHeapAllocation},
+        timestamp_{timestamp},
+        pid_{pid},
+        tid_{tid},
+        address_{address},
+        size_{size} {}
+
+  uint64_t GetTimestamp() const override { return timestamp_; }
+
+  pid_t GetPid() const { return pid_; }
+  pid_t GetTid() const { return tid_; }
+  uint64_t GetAddress() const { return address_; }
+  uint64_t GetSize() const { return size_; }
+
+ private:
+  uint64_t timestamp_;
+  pid_t pid_;
+  pid_t tid_;
+  uint64_t address_;
+  uint64_t size_;
+};
+
+class HeapFreePerfEvent : public PerfEvent {
+ public:
+  HeapFreePerfEvent(uint64_t timestamp, pid_t pid, pid_t tid,
+                    uint64_t address)
+      : PerfEvent{PerfEventType::kHeapFree},
+        timestamp_{timestamp},
+        pid_{pid},
+        tid_{tid},
+        address_{address} {}
+
+  uint64_t GetTimestamp() const override { return timestamp_; }
+
+  pid_t GetPid() const { return pid_; }
+  pid_t GetTid() const { return tid_; }
+  uint64_t GetAddress() const { return address_; }
+
+ private:
+  uint64_t timestamp_;
+  pid_t pid_;
+  pid_t tid_;
+  uint64_t address_;
+};
+
+// A thread waited on a futex for at least the threshold of BpfLockContention,
+// decoded by TracerThread from its records. Its timestamp is the one of the
+// record, before the LockWaitStackSamplePerfEvent of the same wait.
+class LockWaitPerfEvent : public PerfEvent {
+ public:
+  LockWaitPerfEvent(uint64_t timestamp, pid_t pid, pid_t tid,
+                    uint64_t begin_timestamp_ns, uint64_t end_timestamp_ns,
+                    uint64_t lock_address)
+      : PerfEvent{PerfEventType::kLockWait},
+        timestamp_{timestamp},
+        pid_{pid},
+        tid_{tid},
+        begin_timestamp_ns_{begin_timestamp_ns},
+        end_timestamp_ns_{end_timestamp_ns},
+        lock_address_{lock_address} {}
+
+  uint64_t GetTimestamp() const override { return timestamp_; }
+
+  pid_t GetPid() const { return pid_; }
+  pid_t GetTid() const { return tid_; }
+  uint64_t GetBeginTimestampNs() const { return begin_timestamp_ns_; }
+  uint64_t GetEndTimestampNs() const { return end_timestamp_ns_; }
+  uint64_t GetLockAddress() const { return lock_address_; }
+
+ private:
+  uint64_t timestamp_;
+  pid_t pid_;
+  pid_t tid_;
+  uint64_t begin_timestamp_ns_;
+  uint64_t end_timestamp_ns_;
+  uint64_t lock_address_;
 };
 
 // This carries a snapshot of /proc/<pid>/maps and does not reflect a
 // perf_event_open event, but we want it to be part of the same hierarchy.
 class MapsPerfEvent : public PerfEvent {
  public:
-  MapsPerfEvent(uint64_t timestamp, std::string maps)
-      : timestamp_{timestamp}, maps_{std::move(maps)} {}
+  MapsPerfEvent(uint64_t timestamp, pid_t pid, std::string maps)
+      : PerfEvent{PerfEventType::kMaps},
+        timestamp_{timestamp},
+        pid_{pid},
+        maps_{std::move(maps)} {}
 
   uint64_t GetTimestamp() const override { return timestamp_; }
 
-  void Accept(PerfEventVisitor* visitor) override;
-
+  pid_t GetPid() const { return pid_; }
   const std::string& GetMaps() const { return maps_; }
 
  private:
   uint64_t timestamp_;
+  pid_t pid_;
   std::string maps_;
 };
 
-class PerfEventSampleRaw {
+// An executable mapping added to a target process, as reported by
+// PERF_RECORD_MMAP. This allows to update the maps incrementally instead of
+// reading them again as for MapsPerfEvent.
+class MmapPerfEvent : public PerfEvent {
+ public:
+  MmapPerfEvent(uint64_t timestamp, pid_t pid, uint64_t address,
+                uint64_t length, uint64_t page_offset, std::string filename)
+      : PerfEvent{PerfEventType::kMmap},
+        timestamp_{timestamp},
+        pid_{pid},
+        address_{address},
+        length_{length},
+        page_offset_{page_offset},
+        filename_{std::move(filename)} {}
+
+  uint64_t GetTimestamp() const override { return timestamp_; }
+
+  pid_t GetPid() const { return pid_; }
+  uint64_t GetAddress() const { return address_; }
+  uint64_t GetLength() const { return length_; }
+  uint64_t GetPageOffset() const { return page_offset_; }
+  const std::string& GetFilename() const { return filename_; }
+
+ private:
+  uint64_t timestamp_;
+  pid_t pid_;
+  uint64_t address_;
+  uint64_t length_;
+  uint64_t page_offset_;
+  std::string filename_;
+};
+
+// A thread was renamed, e.g., with prctl(PR_SET_NAME), or its process called
+// exec.
+class CommPerfEvent : public PerfEvent {
+ public:
+  CommPerfEvent(uint64_t timestamp, pid_t pid, pid_t tid, std::string comm,
+                bool is_exec)
+      : PerfEvent{PerfEventType::kComm},
+        timestamp_{timestamp},
+        pid_{pid},
+        tid_{tid},
+        comm_{std::move(comm)},
+        is_exec_{is_exec} {}
+
+  uint64_t GetTimestamp() const override { return timestamp_; }
+
+  pid_t GetPid() const { return pid_; }
+  pid_t GetTid() const { return tid_; }
+  const std::string& GetComm() const { return comm_; }
+  bool IsExec() const { return is_exec_; }
+
+ private:
+  uint64_t timestamp_;
+  pid_t pid_;
+  pid_t tid_;
+  std::string comm_;
+  bool is_exec_;
+};
+
+// A stack sample whose callchain was collected by the kernel
+// (PERF_SAMPLE_CALLCHAIN), which only requires frame pointers and no unwinding
+// in user space. The ips contain both kernel and user-space frames, from the
+// innermost, interleaved with PERF_CONTEXT_* markers.
+class CallchainSamplePerfEvent : public PerfEvent {
  public:
-  perf_event_sample_raw ring_buffer_record;
-  std::vector<uint8_t> data;
-  explicit PerfEventSampleRaw(uint32_t size)
-      : data(size) {}
+  CallchainSamplePerfEvent(uint64_t timestamp, pid_t pid, pid_t tid,
+                           std::vector<uint64_t> ips)
+      : PerfEvent{PerfEventType::kCallchainSample},
+        timestamp_{timestamp},
+        pid_{pid},
+        tid_{tid},
+        ips_{std::move(ips)} {}
+
+  uint64_t GetTimestamp() const override { return timestamp_; }
+
+  pid_t GetPid() const { return pid_; }
+  pid_t GetTid() const { return tid_; }
+  const std::vector<uint64_t>& GetIps() const { return ips_; }
+
+ private:
+  uint64_t timestamp_;
+  pid_t pid_;
+  pid_t tid_;
+  std::vector<uint64_t> ips_;
 };
 
 }  // namespace LinuxTracing
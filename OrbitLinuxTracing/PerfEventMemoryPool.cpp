@@ -0,0 +1,190 @@
+#include "PerfEventMemoryPool.h"
+
+#include <OrbitBase/Logging.h>
+
+#include <algorithm>
+#include <array>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace LinuxTracing {
+
+namespace {
+
+constexpr size_t MIN_BLOCK_SIZE_LOG2 = 6;
+constexpr size_t MAX_BLOCK_SIZE_LOG2 = 16;
+static_assert(PerfEventMemoryPool::MIN_BLOCK_SIZE ==
+              size_t{1} << MIN_BLOCK_SIZE_LOG2);
+static_assert(PerfEventMemoryPool::MAX_BLOCK_SIZE ==
+              size_t{1} << MAX_BLOCK_SIZE_LOG2);
+constexpr size_t SIZE_CLASS_COUNT =
+    MAX_BLOCK_SIZE_LOG2 - MIN_BLOCK_SIZE_LOG2 + 1;
+
+// Number of blocks moved at once between a thread cache and the shared pool.
+constexpr size_t TRANSFER_BATCH_SIZE = 64;
+// Memory beyond this amount per size class is returned to the system, so that a
+// burst of events doesn't keep a lot of memory allocated for the whole capture.
+constexpr size_t MAX_SHARED_BYTES_PER_SIZE_CLASS = 32 * 1024 * 1024;
+
+size_t SizeClassOf(size_t size) {
+  if (size <= PerfEventMemoryPool::MIN_BLOCK_SIZE) {
+    return 0;
+  }
+  // Index of the smallest power of two greater than or equal to size.
+  size_t log2 = 64 - __builtin_clzl(size - 1);
+  return log2 - MIN_BLOCK_SIZE_LOG2;
+}
+
+size_t BlockSizeOf(size_t size_class) {
+  return size_t{1} << (size_class + MIN_BLOCK_SIZE_LOG2);
+}
+
+class SharedSizeClassPool {
+ public:
+  explicit SharedSizeClassPool(size_t block_size)
+      : max_block_count_{std::max(MAX_SHARED_BYTES_PER_SIZE_CLASS / block_size,
+                                  TRANSFER_BATCH_SIZE)} {}
+
+  ~SharedSizeClassPool() {
+    for (void* block : blocks_) {
+      ::operator delete(block);
+    }
+  }
+
+  SharedSizeClassPool(const SharedSizeClassPool&) = delete;
+  SharedSizeClassPool& operator=(const SharedSizeClassPool&) = delete;
+
+  // Moves up to TRANSFER_BATCH_SIZE blocks to *thread_blocks.
+  void Take(std::vector<void*>* thread_blocks) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    size_t count = std::min(blocks_.size(), TRANSFER_BATCH_SIZE);
+    thread_blocks->insert(thread_blocks->end(), blocks_.end() - count,
+                          blocks_.end());
+    blocks_.resize(blocks_.size() - count);
+  }
+
+  // Moves the last count blocks from *thread_blocks to this pool and frees the
+  // ones that don't fit.
+  void Give(std::vector<void*>* thread_blocks, size_t count) {
+    CHECK(count <= thread_blocks->size());
+    auto first_to_move = thread_blocks->end() - count;
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      size_t count_to_keep =
+          std::min(count, max_block_count_ - blocks_.size());
+      blocks_.insert(blocks_.end(), first_to_move,
+                     first_to_move + count_to_keep);
+      first_to_move += count_to_keep;
+    }
+    for (auto it = first_to_move; it != thread_blocks->end(); ++it) {
+      ::operator delete(*it);
+    }
+    thread_blocks->resize(thread_blocks->size() - count);
+  }
+
+ private:
+  const size_t max_block_count_;
+  std::mutex mutex_;
+  std::vector<void*> blocks_;
+};
+
+class SharedPool {
+ public:
+  static SharedPool& Get() {
+    static SharedPool shared_pool;
+    return shared_pool;
+  }
+
+  SharedSizeClassPool& GetSizeClassPool(size_t size_class) {
+    return *size_class_pools_[size_class];
+  }
+
+ private:
+  SharedPool() {
+    for (size_t size_class = 0; size_class < SIZE_CLASS_COUNT; ++size_class) {
+      size_class_pools_[size_class] =
+          std::make_unique<SharedSizeClassPool>(BlockSizeOf(size_class));
+    }
+  }
+
+  std::array<std::unique_ptr<SharedSizeClassPool>, SIZE_CLASS_COUNT>
+      size_class_pools_;
+};
+
+class ThreadCache {
+ public:
+  // Accessing the SharedPool here guarantees that it is constructed before,
+  // hence destroyed after, the ThreadCache of the main thread.
+  ThreadCache() : shared_pool_{&SharedPool::Get()} {}
+
+  ~ThreadCache() { ReleaseAll(); }
+
+  ThreadCache(const ThreadCache&) = delete;
+  ThreadCache& operator=(const ThreadCache&) = delete;
+
+  void* Allocate(size_t size_class) {
+    std::vector<void*>& blocks = blocks_[size_class];
+    if (blocks.empty()) {
+      shared_pool_->GetSizeClassPool(size_class).Take(&blocks);
+      if (blocks.empty()) {
+        return ::operator new(BlockSizeOf(size_class));
+      }
+    }
+    void* block = blocks.back();
+    blocks.pop_back();
+    return block;
+  }
+
+  void Deallocate(void* block, size_t size_class) {
+    std::vector<void*>& blocks = blocks_[size_class];
+    blocks.push_back(block);
+    // Keep one batch for this thread to reuse and move the rest at once.
+    if (blocks.size() >= 2 * TRANSFER_BATCH_SIZE) {
+      shared_pool_->GetSizeClassPool(size_class)
+          .Give(&blocks, blocks.size() - TRANSFER_BATCH_SIZE);
+    }
+  }
+
+  void ReleaseAll() {
+    for (size_t size_class = 0; size_class < SIZE_CLASS_COUNT; ++size_class) {
+      std::vector<void*>& blocks = blocks_[size_class];
+      shared_pool_->GetSizeClassPool(size_class).Give(&blocks, blocks.size());
+    }
+  }
+
+ private:
+  SharedPool* shared_pool_;
+  std::array<std::vector<void*>, SIZE_CLASS_COUNT> blocks_;
+};
+
+ThreadCache& GetThreadCache() {
+  thread_local ThreadCache thread_cache;
+  return thread_cache;
+}
+
+}  // namespace
+
+void* PerfEventMemoryPool::Allocate(size_t size) {
+  if (size > MAX_BLOCK_SIZE) {
+    return ::operator new(size);
+  }
+  return GetThreadCache().Allocate(SizeClassOf(size));
+}
+
+void PerfEventMemoryPool::Deallocate(void* ptr, size_t size) {
+  if (ptr == nullptr) {
+    return;
+  }
+  if (size > MAX_BLOCK_SIZE) {
+    ::operator delete(ptr);
+    return;
+  }
+  GetThreadCache().Deallocate(ptr, SizeClassOf(size));
+}
+
+void PerfEventMemoryPool::ReleaseThreadCache() {
+  GetThreadCache().ReleaseAll();
+}
+
+}  // namespace LinuxTracing
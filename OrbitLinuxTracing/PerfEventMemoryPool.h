@@ -0,0 +1,57 @@
+#ifndef ORBIT_LINUX_TRACING_PERF_EVENT_MEMORY_POOL_H_
+#define ORBIT_LINUX_TRACING_PERF_EVENT_MEMORY_POOL_H_
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+namespace LinuxTracing {
+
+// PerfEvents and their stack dumps are allocated at a very high rate by the
+// threads reading the ring buffers and freed by the thread processing them,
+// once visited. Going through the global allocator for each of them is
+// expensive, so this pool keeps freed blocks around for reuse instead.
+// Blocks are grouped in power-of-two size classes. Each thread keeps a cache
+// of free blocks per size class, accessed without locking, and exchanges
+// blocks with a shared, mutex-protected pool in batches: this way the memory
+// freed by the processing thread flows back to the reading threads in bulk.
+// Requests larger than the largest size class go to the global allocator.
+class PerfEventMemoryPool {
+ public:
+  static void* Allocate(size_t size);
+  // size must be the same that was passed to Allocate.
+  static void Deallocate(void* ptr, size_t size);
+
+  // Moves all the blocks cached by the calling thread to the shared pool.
+  // This also happens automatically when a thread exits.
+  static void ReleaseThreadCache();
+
+  static constexpr size_t MIN_BLOCK_SIZE = 64;
+  static constexpr size_t MAX_BLOCK_SIZE = 64 * 1024;
+};
+
+// Deleter for memory obtained from PerfEventMemoryPool::Allocate, for use with
+// std::unique_ptr. It needs to remember the size of the allocation.
+struct PerfEventMemoryPoolDeleter {
+  size_t size = 0;
+  void operator()(void* ptr) const {
+    PerfEventMemoryPool::Deallocate(ptr, size);
+  }
+};
+
+template <typename T>
+using PooledArray = std::unique_ptr<T[], PerfEventMemoryPoolDeleter>;
+
+// Like make_unique_for_overwrite<T[]>, but allocating from PerfEventMemoryPool.
+// Only meant for trivial types, as no constructor or destructor is called.
+template <typename T>
+inline PooledArray<T> make_pooled_array_for_overwrite(size_t count) {
+  static_assert(std::is_trivial_v<T>);
+  size_t size = count * sizeof(T);
+  return PooledArray<T>(static_cast<T*>(PerfEventMemoryPool::Allocate(size)),
+                        PerfEventMemoryPoolDeleter{size});
+}
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_PERF_EVENT_MEMORY_POOL_H_
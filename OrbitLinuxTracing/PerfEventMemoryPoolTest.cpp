@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "PerfEvent.h"
+#include "PerfEventMemoryPool.h"
+
+namespace LinuxTracing {
+
+TEST(PerfEventMemoryPool, ReusesBlocksOfTheSameSizeClass) {
+  void* first = PerfEventMemoryPool::Allocate(100);
+  PerfEventMemoryPool::Deallocate(first, 100);
+  // 100 and 120 bytes both belong to the 128-byte size class.
+  void* second = PerfEventMemoryPool::Allocate(120);
+  EXPECT_EQ(second, first);
+  PerfEventMemoryPool::Deallocate(second, 120);
+}
+
+TEST(PerfEventMemoryPool, BlocksAreLargeEnough) {
+  std::vector<std::pair<void*, size_t>> allocations;
+  for (size_t size : {0ul, 1ul, 63ul, 64ul, 65ul, 1000ul, 65000ul,
+                      PerfEventMemoryPool::MAX_BLOCK_SIZE,
+                      PerfEventMemoryPool::MAX_BLOCK_SIZE + 1}) {
+    void* ptr = PerfEventMemoryPool::Allocate(size);
+    ASSERT_NE(ptr, nullptr);
+    memset(ptr, 0xAB, size);
+    allocations.emplace_back(ptr, size);
+  }
+  for (const auto& [ptr, size] : allocations) {
+    PerfEventMemoryPool::Deallocate(ptr, size);
+  }
+}
+
+TEST(PerfEventMemoryPool, BlocksFreedOnOneThreadAreReusedOnAnother) {
+  constexpr size_t SIZE = 256;
+  constexpr size_t COUNT = 1024;
+  PerfEventMemoryPool::ReleaseThreadCache();
+
+  std::vector<void*> blocks;
+  std::thread producer{[&blocks] {
+    for (size_t i = 0; i < COUNT; ++i) {
+      blocks.push_back(PerfEventMemoryPool::Allocate(SIZE));
+    }
+  }};
+  producer.join();
+
+  std::thread consumer{[&blocks] {
+    for (void* block : blocks) {
+      PerfEventMemoryPool::Deallocate(block, SIZE);
+    }
+  }};
+  // The consumer releases its cache to the shared pool when exiting.
+  consumer.join();
+
+  void* reused = PerfEventMemoryPool::Allocate(SIZE);
+  EXPECT_NE(std::find(blocks.begin(), blocks.end(), reused), blocks.end());
+  PerfEventMemoryPool::Deallocate(reused, SIZE);
+}
+
+TEST(PerfEventMemoryPool, StackSamplePerfEventUsesPool) {
+  constexpr uint64_t STACK_SIZE = 4096;
+  auto event = std::make_unique<StackSamplePerfEvent>(STACK_SIZE);
+  ASSERT_EQ(event->GetStackSize(), STACK_SIZE);
+  memset(event->ring_buffer_record->stack.data.get(), 0xCD, STACK_SIZE);
+  const char* stack_data = event->GetStackData();
+  event.reset();
+
+  void* reused = PerfEventMemoryPool::Allocate(STACK_SIZE);
+  EXPECT_EQ(reused, stack_data);
+  PerfEventMemoryPool::Deallocate(reused, STACK_SIZE);
+}
+
+}  // namespace LinuxTracing
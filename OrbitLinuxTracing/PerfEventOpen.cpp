@@ -6,8 +6,13 @@
 #include <linux/perf_event.h>
 
 #include <cerrno>
+#include <optional>
+#include <string>
 
 #include "Utils.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
 
 namespace LinuxTracing {
 namespace {
@@ -31,8 +36,9 @@ perf_event_attr generic_event_attr() {
   return pe;
 }
 
-int generic_event_open(perf_event_attr* attr, pid_t pid, int32_t cpu) {
-  int fd = perf_event_open(attr, pid, cpu, -1, 0);
+int generic_event_open(perf_event_attr* attr, pid_t pid, int32_t cpu,
+                       int group_fd = -1) {
+  int fd = perf_event_open(attr, pid, cpu, group_fd, 0);
   if (fd == -1) {
     ERROR("perf_event_open: %s", SafeStrerror(errno));
   }
@@ -51,6 +57,12 @@ perf_event_attr uprobe_event_attr(const char* module,
 
   return pe;
 }
+
+// For the events that read the group of PMU counters they belong to.
+void add_read_group(perf_event_attr* pe) {
+  pe->sample_type |= PERF_SAMPLE_READ;
+  pe->read_format = PERF_FORMAT_GROUP;
+}
 }  // namespace
 
 int context_switch_event_open(pid_t pid, int32_t cpu) {
@@ -68,20 +80,131 @@ int mmap_task_event_open(pid_t pid, int32_t cpu) {
   pe.config = PERF_COUNT_SW_DUMMY;
   pe.mmap = 1;
   pe.task = 1;
+  pe.comm = 1;
+  pe.comm_exec = 1;
 
   return generic_event_open(&pe, pid, cpu);
 }
 
-int sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu) {
+int sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu,
+                      uint16_t stack_size) {
   perf_event_attr pe = generic_event_attr();
   pe.type = PERF_TYPE_SOFTWARE;
   pe.config = PERF_COUNT_SW_CPU_CLOCK;
   pe.sample_period = period_ns;
   pe.sample_type |= PERF_SAMPLE_STACK_USER | PERF_SAMPLE_REGS_USER;
+  pe.sample_stack_user = stack_size;
+
+  return generic_event_open(&pe, pid, cpu);
+}
+
+int callchain_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu) {
+  perf_event_attr pe = generic_event_attr();
+  pe.type = PERF_TYPE_SOFTWARE;
+  pe.config = PERF_COUNT_SW_CPU_CLOCK;
+  pe.sample_period = period_ns;
+  pe.sample_type |= PERF_SAMPLE_CALLCHAIN;
 
   return generic_event_open(&pe, pid, cpu);
 }
 
+int page_fault_event_open(bool major, uint64_t period, pid_t pid,
+                          int32_t cpu) {
+  perf_event_attr pe = generic_event_attr();
+  pe.type = PERF_TYPE_SOFTWARE;
+  pe.config =
+      major ? PERF_COUNT_SW_PAGE_FAULTS_MAJ : PERF_COUNT_SW_PAGE_FAULTS_MIN;
+  pe.sample_period = period;
+  pe.sample_type |= PERF_SAMPLE_STACK_USER | PERF_SAMPLE_REGS_USER;
+
+  return generic_event_open(&pe, pid, cpu);
+}
+
+int branch_stack_sample_event_open(BranchSampling branch_sampling,
+                                   uint64_t period, int32_t cpu) {
+  perf_event_attr pe = generic_event_attr();
+  pe.type = PERF_TYPE_HARDWARE;
+  // Sampling taken branches makes the counts of the branches in the records
+  // proportional to how often they are taken, unlike sampling cycles.
+  pe.config = PERF_COUNT_HW_BRANCH_INSTRUCTIONS;
+  pe.sample_period = period;
+  pe.exclude_kernel = 1;
+  pe.exclude_hv = 1;
+  pe.sample_type |= PERF_SAMPLE_BRANCH_STACK;
+  pe.branch_sample_type =
+      PERF_SAMPLE_BRANCH_USER | (branch_sampling == BranchSampling::kCalls
+                                     ? PERF_SAMPLE_BRANCH_ANY_CALL
+                                     : PERF_SAMPLE_BRANCH_ANY);
+
+  return generic_event_open(&pe, -1, cpu);
+}
+
+int intel_pt_pmu_type() {
+  std::optional<std::string> type =
+      ReadFile("/sys/bus/event_source/devices/intel_pt/type");
+  int pmu_type;
+  if (!type.has_value() ||
+      !absl::SimpleAtoi(absl::StripAsciiWhitespace(type.value()),
+                        &pmu_type)) {
+    return -1;
+  }
+  return pmu_type;
+}
+
+int intel_pt_event_open(uint32_t mtc_period, pid_t tid) {
+  int pmu_type = intel_pt_pmu_type();
+  if (pmu_type < 0) {
+    ERROR("Intel Processor Trace is not supported");
+    return -1;
+  }
+  // The bits of the config, from
+  // /sys/bus/event_source/devices/intel_pt/format.
+  constexpr uint64_t kMtc = 1ul << 9;
+  constexpr uint64_t kTsc = 1ul << 10;
+  constexpr uint64_t kBranch = 1ul << 13;
+  constexpr uint32_t kMtcPeriodShift = 14;
+
+  perf_event_attr pe = generic_event_attr();
+  pe.type = pmu_type;
+  pe.config = kBranch | kTsc | kMtc |
+              (static_cast<uint64_t>(mtc_period & 0xf) << kMtcPeriodShift);
+  pe.exclude_kernel = 1;
+  pe.exclude_hv = 1;
+
+  return generic_event_open(&pe, tid, -1);
+}
+
+bool perf_event_set_address_filter(int file_descriptor, const char* path,
+                                   uint64_t offset, uint64_t size) {
+  std::string filter =
+      absl::StrFormat("filter %#lx/%#lx@%s", offset, size, path);
+  int ret = ioctl(file_descriptor, PERF_EVENT_IOC_SET_FILTER, filter.c_str());
+  if (ret != 0) {
+    ERROR("PERF_EVENT_IOC_SET_FILTER \"%s\": %s", filter.c_str(),
+          SafeStrerror(errno));
+    return false;
+  }
+  return true;
+}
+
+int bpf_sample_event_open(uint64_t period_ns, int32_t cpu) {
+  perf_event_attr pe = generic_event_attr();
+  pe.type = PERF_TYPE_SOFTWARE;
+  pe.config = PERF_COUNT_SW_CPU_CLOCK;
+  pe.sample_period = period_ns;
+
+  return generic_event_open(&pe, -1, cpu);
+}
+
+int bpf_output_event_open(int32_t cpu) {
+  perf_event_attr pe = generic_event_attr();
+  pe.type = PERF_TYPE_SOFTWARE;
+  pe.config = PERF_COUNT_SW_BPF_OUTPUT;
+  pe.sample_type |= PERF_SAMPLE_RAW;
+
+  return generic_event_open(&pe, -1, cpu);
+}
+
 int uprobes_stack_event_open(const char* module, uint64_t function_offset,
                              pid_t pid, int32_t cpu) {
   perf_event_attr pe = uprobe_event_attr(module, function_offset);
@@ -91,14 +214,109 @@ int uprobes_stack_event_open(const char* module, uint64_t function_offset,
   return generic_event_open(&pe, pid, cpu);
 }
 
+int uprobes_regs_event_open(const char* module, uint64_t function_offset,
+                            bool with_arguments, pid_t pid, int32_t cpu) {
+  perf_event_attr pe = uprobe_event_attr(module, function_offset);
+  pe.config = 0;
+  pe.sample_type |= PERF_SAMPLE_REGS_USER;
+  pe.sample_regs_user = with_arguments ? SAMPLE_REGS_USER_SP_IP_ARGUMENTS
+                                        : SAMPLE_REGS_USER_SP_IP;
+
+  return generic_event_open(&pe, pid, cpu);
+}
+
 int uretprobes_event_open(const char* module, uint64_t function_offset,
                           pid_t pid, int32_t cpu) {
   perf_event_attr pe = uprobe_event_attr(module, function_offset);
   pe.config = 1;  // Set bit 0 of config for uretprobe.
+  pe.sample_type |= PERF_SAMPLE_REGS_USER;
+  pe.sample_regs_user = SAMPLE_REGS_USER_AX;
 
   return generic_event_open(&pe, pid, cpu);
 }
 
+int pmu_counter_event_open(PmuCounter counter, int32_t cpu, int group_fd) {
+  perf_event_attr pe = generic_event_attr();
+  pe.type = PERF_TYPE_HARDWARE;
+  switch (counter) {
+    case PmuCounter::kCycles:
+      pe.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case PmuCounter::kInstructions:
+      pe.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case PmuCounter::kLlcMisses:
+      // On x86, this is the event for the misses of the last level cache.
+      pe.config = PERF_COUNT_HW_CACHE_MISSES;
+      break;
+    case PmuCounter::kBranchMisses:
+      pe.config = PERF_COUNT_HW_BRANCH_MISSES;
+      break;
+  }
+  // Only counting: no records are generated for the counters themselves.
+  pe.sample_period = 0;
+  pe.sample_type = 0;
+  pe.sample_id_all = 0;
+  pe.exclude_hv = 1;
+  pe.read_format = PERF_FORMAT_GROUP;
+  // Otherwise the group can be multiplexed with other users of the PMU, and
+  // while it is not on the PMU, neither the counters nor the probes in the
+  // group are active.
+  pe.pinned = group_fd == -1 ? 1 : 0;
+
+  return generic_event_open(&pe, -1, cpu, group_fd);
+}
+
+int uprobes_pmu_counters_event_open(const char* module,
+                                    uint64_t function_offset, int32_t cpu,
+                                    int group_fd) {
+  perf_event_attr pe = uprobe_event_attr(module, function_offset);
+  pe.config = 0;
+  pe.sample_type |= PERF_SAMPLE_REGS_USER;
+  pe.sample_regs_user = SAMPLE_REGS_USER_SP_IP;
+  add_read_group(&pe);
+
+  return generic_event_open(&pe, -1, cpu, group_fd);
+}
+
+int uretprobes_pmu_counters_event_open(const char* module,
+                                       uint64_t function_offset, int32_t cpu,
+                                       int group_fd) {
+  perf_event_attr pe = uprobe_event_attr(module, function_offset);
+  pe.config = 1;  // Set bit 0 of config for uretprobe.
+  pe.sample_type |= PERF_SAMPLE_REGS_USER;
+  pe.sample_regs_user = SAMPLE_REGS_USER_AX;
+  add_read_group(&pe);
+
+  return generic_event_open(&pe, -1, cpu, group_fd);
+}
+
+int sched_switch_pmu_counters_event_open(int32_t cpu, int group_fd) {
+  int tp_id = GetTracepointId("sched", "sched_switch");
+  perf_event_attr pe = generic_event_attr();
+  pe.type = PERF_TYPE_TRACEPOINT;
+  pe.config = tp_id;
+  add_read_group(&pe);
+
+  return generic_event_open(&pe, -1, cpu, group_fd);
+}
+
+int sched_switch_stack_event_open(int32_t cpu) {
+  return tracepoint_stack_event_open("sched", "sched_switch", cpu);
+}
+
+int tracepoint_stack_event_open(const char* tracepoint_category,
+                                const char* tracepoint_name, int32_t cpu) {
+  int tp_id = GetTracepointId(tracepoint_category, tracepoint_name);
+  perf_event_attr pe = generic_event_attr();
+  pe.type = PERF_TYPE_TRACEPOINT;
+  pe.config = tp_id;
+  pe.sample_type |=
+      PERF_SAMPLE_RAW | PERF_SAMPLE_STACK_USER | PERF_SAMPLE_REGS_USER;
+
+  return generic_event_open(&pe, -1, cpu);
+}
+
 void* perf_event_open_mmap_ring_buffer(int fd, uint64_t mmap_length) {
   // The size of the ring buffer excluding the metadata page must be a power of
   // two number of pages.
@@ -119,6 +337,28 @@ void* perf_event_open_mmap_ring_buffer(int fd, uint64_t mmap_length) {
   return mmap_ret;
 }
 
+void* perf_event_open_mmap_aux_buffer(int fd, void* ring_buffer,
+                                      uint64_t mmap_length,
+                                      uint64_t aux_size) {
+  if (aux_size < getpagesize() || __builtin_popcountl(aux_size) != 1) {
+    ERROR("AUX buffer size for perf_event_open not 2^n pages: %lu", aux_size);
+    return nullptr;
+  }
+
+  auto* metadata = static_cast<perf_event_mmap_page*>(ring_buffer);
+  metadata->aux_offset = mmap_length;
+  metadata->aux_size = aux_size;
+  // Mapped writable, the AUX buffer is not overwritten once full.
+  void* mmap_ret = mmap(nullptr, aux_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                        fd, mmap_length);
+  if (mmap_ret == reinterpret_cast<void*>(-1)) {
+    ERROR("mmap AUX: %s", SafeStrerror(errno));
+    return nullptr;
+  }
+
+  return mmap_ret;
+}
+
 int tracepoint_event_open(const char* tracepoint_category,
                           const char* tracepoint_name, pid_t pid, int32_t cpu) {
   int tp_id = GetTracepointId(tracepoint_category, tracepoint_name);
@@ -3,6 +3,7 @@
 
 #include <OrbitBase/Logging.h>
 #include <OrbitBase/SafeStrerror.h>
+#include <OrbitLinuxTracing/Events.h>
 #include <asm/perf_regs.h>
 #include <asm/unistd.h>
 #include <linux/perf_event.h>
@@ -56,6 +57,24 @@ inline void perf_event_redirect(int from_fd, int to_fd) {
   }
 }
 
+inline void perf_event_set_period(int file_descriptor, uint64_t period) {
+  int ret = ioctl(file_descriptor, PERF_EVENT_IOC_PERIOD, &period);
+  if (ret != 0) {
+    ERROR("PERF_EVENT_IOC_PERIOD: %s", SafeStrerror(errno));
+  }
+}
+
+// Runs the eBPF program prog_fd on every sample of the event, instead of
+// writing the sample to the ring buffer if the program returns 0.
+inline bool perf_event_set_bpf(int file_descriptor, int prog_fd) {
+  int ret = ioctl(file_descriptor, PERF_EVENT_IOC_SET_BPF, prog_fd);
+  if (ret != 0) {
+    ERROR("PERF_EVENT_IOC_SET_BPF: %s", SafeStrerror(errno));
+    return false;
+  }
+  return true;
+}
+
 inline uint64_t perf_event_get_id(int file_descriptor) {
   uint64_t id;
   int ret = ioctl(file_descriptor, PERF_EVENT_IOC_ID, &id);
@@ -88,37 +107,158 @@ static constexpr uint64_t SAMPLE_REGS_USER_ALL =
     (1lu << PERF_REG_X86_R12) | (1lu << PERF_REG_X86_R13) |
     (1lu << PERF_REG_X86_R14) | (1lu << PERF_REG_X86_R15);
 
+// For uprobes without stack dump, the stack pointer and instruction pointer
+// are still needed to detect duplicate uprobes.
+// This must be in sync with struct perf_event_sample_regs_user_sp_ip in
+// PerfEventRecords.h.
+static constexpr uint64_t SAMPLE_REGS_USER_SP_IP =
+    (1lu << PERF_REG_X86_SP) | (1lu << PERF_REG_X86_IP);
+
+// The registers of the first six integer arguments in the System V AMD64 ABI,
+// in addition to SAMPLE_REGS_USER_SP_IP.
+// This must be in sync with struct perf_event_sample_regs_user_sp_ip_arguments
+// in PerfEventRecords.h.
+static constexpr uint64_t SAMPLE_REGS_USER_SP_IP_ARGUMENTS =
+    SAMPLE_REGS_USER_SP_IP | (1lu << PERF_REG_X86_DI) |
+    (1lu << PERF_REG_X86_SI) | (1lu << PERF_REG_X86_DX) |
+    (1lu << PERF_REG_X86_CX) | (1lu << PERF_REG_X86_R8) |
+    (1lu << PERF_REG_X86_R9);
+
+// The integer return value for uretprobes.
+// This must be in sync with struct perf_event_sample_regs_user_ax in
+// PerfEventRecords.h.
+static constexpr uint64_t SAMPLE_REGS_USER_AX = 1lu << PERF_REG_X86_AX;
+
 // Max to pass to perf_event_open without getting an error is (1u << 16u) - 8,
 // because the kernel stores this in a short and because of alignment reasons.
 // But the size the kernel actually returns is smaller, because the maximum size
 // of the entire record the kernel is willing to return is (1u << 16u) - 8.
 // If we want the size we pass to coincide with the size we get, we need to pass
-// a lower value. For the current layout of perf_event_stack_sample, the maximum
-// size is 65312, but let's leave some extra room.
-// TODO: As this amount of memory has to be copied from the ring buffer for each
-//  sample, this constant should be a parameters and should be made available in
-//  some setting.
+// a lower value. For the current layout of perf_event_stack_sample_fixed, the
+// maximum size is 65312, but let's leave some extra room.
+// As this amount of memory has to be copied from the ring buffer for each
+// sample, the stack sampling events are reopened with the size that the
+// sampled threads actually need, see StackDumpSizeTuner.
 static constexpr uint16_t SAMPLE_STACK_USER_SIZE = 65000;
+// The least size the stack sampling events are reopened with.
+static constexpr uint16_t MIN_SAMPLE_STACK_USER_SIZE = 4096;
 
 // perf_event_open for context switches.
 int context_switch_event_open(pid_t pid, int32_t cpu);
 
-// perf_event_open for task (fork and exit) and mmap records in the same buffer.
+// perf_event_open for task (fork and exit), comm (thread renames and exec) and
+// mmap records in the same buffer.
 int mmap_task_event_open(pid_t pid, int32_t cpu);
 
-// perf_event_open for stack sampling.
-int sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu);
+// perf_event_open for stack sampling, dumping stack_size bytes of the stack.
+int sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu,
+                      uint16_t stack_size = SAMPLE_STACK_USER_SIZE);
+
+// perf_event_open for stack sampling where the kernel collects the callchain,
+// including kernel frames, by following frame pointers, instead of copying the
+// user stack.
+int callchain_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu);
+
+// perf_event_open for sampling one in period major, or minor, page faults,
+// with the registers and the user stack of the thread that faulted, like
+// sample_event_open.
+int page_fault_event_open(bool major, uint64_t period, pid_t pid, int32_t cpu);
+
+// perf_event_open for sampling one in period taken branches of user space,
+// with the last branch records of the core (PERF_SAMPLE_BRANCH_STACK), which
+// are filtered to calls with BranchSampling::kCalls. Fails on machines without
+// LBR, e.g. most virtual machines. See perf_event_branch_stack_sample_fixed in
+// PerfEventRecords.h.
+int branch_stack_sample_event_open(BranchSampling branch_sampling,
+                                   uint64_t period, int32_t cpu);
+
+// The PMU type of Intel Processor Trace, for perf_event_attr::type, or -1 if
+// neither the processor nor the kernel support it, e.g. on AMD processors and
+// in most virtual machines.
+int intel_pt_pmu_type();
+
+// perf_event_open for the Intel Processor Trace of the user space of thread
+// tid, on any cpu, with TSC packets and MTC packets every 2^mtc_period ticks of
+// the crystal clock, see IntelPtDecoder. The trace goes to the AUX buffer of
+// perf_event_open_mmap_aux_buffer, not to the ring buffer.
+int intel_pt_event_open(uint32_t mtc_period, pid_t tid);
+
+// Restricts the trace of an event like intel_pt_event_open to
+// [offset, offset + size) of the file at path, e.g. the code of a function.
+bool perf_event_set_address_filter(int file_descriptor, const char* path,
+                                   uint64_t offset, uint64_t size);
+
+// perf_event_open for stack sampling where the samples are aggregated in the
+// kernel by the eBPF program of a BpfStackAggregator, attached with
+// perf_event_set_bpf, instead of being written to a ring buffer.
+int bpf_sample_event_open(uint64_t period_ns, int32_t cpu);
+
+// perf_event_open for the records an eBPF program writes on cpu with
+// bpf_perf_event_output, as the raw data of samples (perf_event_sample_raw).
+int bpf_output_event_open(int32_t cpu);
 
 // perf_event_open for uprobes and uretprobes.
 int uprobes_stack_event_open(const char* module, uint64_t function_offset,
                              pid_t pid, int32_t cpu);
 
+// perf_event_open for uprobes that only sample the registers in
+// SAMPLE_REGS_USER_SP_IP, or in SAMPLE_REGS_USER_SP_IP_ARGUMENTS if
+// with_arguments, and no stack.
+int uprobes_regs_event_open(const char* module, uint64_t function_offset,
+                            bool with_arguments, pid_t pid, int32_t cpu);
+
+// perf_event_open for uretprobes, sampling the register in
+// SAMPLE_REGS_USER_AX for the return value.
 int uretprobes_event_open(const char* module, uint64_t function_offset,
                           pid_t pid, int32_t cpu);
 
+// perf_event_open for a hardware performance counter counting on cpu, to be
+// read by the other events of its group, and not sampled. With group_fd -1,
+// the counter becomes the leader of a new group, which is pinned to the PMU.
+int pmu_counter_event_open(PmuCounter counter, int32_t cpu, int group_fd);
+
+// The events below join the group of counters of group_fd and carry the values
+// of the group when they fire (PERF_SAMPLE_READ with PERF_FORMAT_GROUP). See
+// perf_event_sample_read_group_fixed in PerfEventRecords.h.
+
+// perf_event_open for uprobes that only sample the registers in
+// SAMPLE_REGS_USER_SP_IP, in addition to the counters.
+int uprobes_pmu_counters_event_open(const char* module,
+                                    uint64_t function_offset, int32_t cpu,
+                                    int group_fd);
+
+// perf_event_open for uretprobes, sampling the register in SAMPLE_REGS_USER_AX
+// in addition to the counters.
+int uretprobes_pmu_counters_event_open(const char* module,
+                                       uint64_t function_offset, int32_t cpu,
+                                       int group_fd);
+
+// perf_event_open for the sched:sched_switch tracepoint, with only the
+// counters, so that they can be attributed to the thread that stops running.
+int sched_switch_pmu_counters_event_open(int32_t cpu, int group_fd);
+
+// perf_event_open for the sched:sched_switch tracepoint, sampling the raw data
+// of the tracepoint (perf_event_sched_switch_tracepoint), then the registers in
+// SAMPLE_REGS_USER_ALL and the user stack of the thread switched out. The raw
+// data has variable size, see DecodeOffCpuStackSamplePerfEvent.
+int sched_switch_stack_event_open(int32_t cpu);
+
+// perf_event_open for any tracepoint on cpu, for all processes, with the same
+// layout as sched_switch_stack_event_open: the raw data of the tracepoint, then
+// the registers and the user stack of the thread in whose context it fires.
+int tracepoint_stack_event_open(const char* tracepoint_category,
+                                const char* tracepoint_name, int32_t cpu);
+
 // Create the ring buffer to use perf_event_open in sampled mode.
 void* perf_event_open_mmap_ring_buffer(int fd, uint64_t mmap_length);
 
+// Creates the AUX buffer of fd, of aux_size bytes (2^n pages), after its ring
+// buffer, created with perf_event_open_mmap_ring_buffer at ring_buffer. The
+// kernel stops writing to it when it is full, instead of overwriting the
+// oldest data.
+void* perf_event_open_mmap_aux_buffer(int fd, void* ring_buffer,
+                                      uint64_t mmap_length, uint64_t aux_size);
+
 // perf_event_open for tracepoint events. This opens a perf event for the
 // tracepoint given by the category (for example, "sched") and the name
 // (for example, "sched_waking"). Returns the file descriptor for the
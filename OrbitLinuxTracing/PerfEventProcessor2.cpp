@@ -2,97 +2,204 @@
 
 #include <OrbitBase/Logging.h>
 
+#include <algorithm>
+#include <limits>
 #include <memory>
-#include <queue>
+#include <utility>
 
 #include "PerfEvent.h"
 #include "Utils.h"
 
 namespace LinuxTracing {
 
+std::unique_ptr<PerfEvent> PerfEventQueue::EventQueue::Pop() {
+  std::unique_ptr<PerfEvent> event = std::move(events_[front_index_].event);
+  ++front_index_;
+  if (front_index_ == events_.size()) {
+    // Keep the capacity, as more events of this fd are bound to come.
+    events_.clear();
+    front_index_ = 0;
+  } else if (front_index_ >= events_.size() / 2 &&
+             front_index_ >= MIN_COMPACTION_SIZE) {
+    // Discard the moved-from pointers at the front.
+    events_.erase(events_.begin(), events_.begin() + front_index_);
+    front_index_ = 0;
+  }
+  return event;
+}
+
 void PerfEventQueue::PushEvent(int origin_fd,
                                std::unique_ptr<PerfEvent> event) {
-  if (fd_event_queues_.count(origin_fd) > 0) {
-    std::shared_ptr<std::queue<std::unique_ptr<PerfEvent>>> event_queue =
-        fd_event_queues_.at(origin_fd);
-    CHECK(!event_queue->empty());
+  uint64_t timestamp = event->GetTimestamp();
+  PushEvent(origin_fd, timestamp, std::move(event));
+}
+
+void PerfEventQueue::PushEvent(int origin_fd, uint64_t timestamp,
+                               std::unique_ptr<PerfEvent> event) {
+  auto [it, inserted] =
+      fd_to_queue_index_.try_emplace(origin_fd, queues_.size());
+  if (inserted) {
+    queues_.emplace_back();
+  }
+  size_t queue_index = it->second;
+  FdQueue& queue = queues_[queue_index];
+
+  if (!queue.events.Empty()) {
     // Fundamental assumption: events from the same file descriptor come already
     // in order.
-    CHECK(event->GetTimestamp() >= event_queue->front()->GetTimestamp());
-    event_queue->push(std::move(event));
-  } else {
-    auto event_queue =
-        std::make_shared<std::queue<std::unique_ptr<PerfEvent>>>();
-    fd_event_queues_.insert(std::make_pair(origin_fd, event_queue));
-    event_queue->push(std::move(event));
-    event_queues_queue_.push(std::make_pair(origin_fd, event_queue));
+    CHECK(timestamp >= queue.events.FrontTimestamp());
+    // The front of the queue doesn't change, so neither does the heap.
+    queue.events.Push(timestamp, std::move(event));
+    return;
   }
-}
 
-bool PerfEventQueue::HasEvent() { return !event_queues_queue_.empty(); }
+  queue.events.Push(timestamp, std::move(event));
+  queue.heap_index = heap_.size();
+  heap_.push_back({timestamp, queue_index});
+  SiftUp(queue.heap_index);
+}
 
 PerfEvent* PerfEventQueue::TopEvent() {
-  return event_queues_queue_.top().second->front().get();
+  return queues_[heap_.front().queue_index].events.Front();
 }
 
 std::unique_ptr<PerfEvent> PerfEventQueue::PopEvent() {
-  std::pair<int, std::shared_ptr<std::queue<std::unique_ptr<PerfEvent>>>>
-      top_fd_queue = event_queues_queue_.top();
-  event_queues_queue_.pop();
-  const int& top_fd = top_fd_queue.first;
-  std::shared_ptr<std::queue<std::unique_ptr<PerfEvent>>>& top_queue =
-      top_fd_queue.second;
-
-  std::unique_ptr<PerfEvent> top_event = std::move(top_queue->front());
-  top_queue->pop();
-  if (top_queue->empty()) {
-    fd_event_queues_.erase(top_fd);
+  FdQueue& top_queue = queues_[heap_.front().queue_index];
+  std::unique_ptr<PerfEvent> top_event = top_queue.events.Pop();
+
+  if (top_queue.events.Empty()) {
+    // Remove the queue from the heap by replacing it with the last element.
+    SwapHeapElements(0, heap_.size() - 1);
+    heap_.pop_back();
   } else {
-    // Remove and re-insert so that the queue is in the right position in the
-    // heap after the front of the queue has been removed.
-    event_queues_queue_.push(top_fd_queue);
+    heap_.front().front_timestamp = top_queue.events.FrontTimestamp();
+  }
+  if (!heap_.empty()) {
+    // Either the front of the top queue has a larger timestamp now, or the top
+    // of the heap has been replaced: in both cases, restore the heap property.
+    SiftDown(0);
   }
 
   return top_event;
 }
 
+void PerfEventQueue::SwapHeapElements(size_t lhs, size_t rhs) {
+  std::swap(heap_[lhs], heap_[rhs]);
+  queues_[heap_[lhs].queue_index].heap_index = lhs;
+  queues_[heap_[rhs].queue_index].heap_index = rhs;
+}
+
+void PerfEventQueue::SiftUp(size_t heap_index) {
+  while (heap_index > 0) {
+    size_t parent_index = (heap_index - 1) / 2;
+    if (heap_[parent_index].front_timestamp <=
+        heap_[heap_index].front_timestamp) {
+      break;
+    }
+    SwapHeapElements(heap_index, parent_index);
+    heap_index = parent_index;
+  }
+}
+
+void PerfEventQueue::SiftDown(size_t heap_index) {
+  const size_t heap_size = heap_.size();
+  while (true) {
+    size_t smallest_index = heap_index;
+    uint64_t smallest_timestamp = heap_[heap_index].front_timestamp;
+    for (size_t child_index = 2 * heap_index + 1;
+         child_index <= 2 * heap_index + 2 && child_index < heap_size;
+         ++child_index) {
+      uint64_t child_timestamp = heap_[child_index].front_timestamp;
+      if (child_timestamp < smallest_timestamp) {
+        smallest_index = child_index;
+        smallest_timestamp = child_timestamp;
+      }
+    }
+    if (smallest_index == heap_index) {
+      return;
+    }
+    SwapHeapElements(heap_index, smallest_index);
+    heap_index = smallest_index;
+  }
+}
+
+void PerfEventProcessor2::AddOriginFileDescriptor(int origin_fd) {
+  watermarks_per_fd_.try_emplace(origin_fd, 0);
+}
+
+void PerfEventProcessor2::AdvanceWatermark(int origin_fd,
+                                           uint64_t timestamp_ns) {
+  auto it = watermarks_per_fd_.find(origin_fd);
+  if (it != watermarks_per_fd_.end()) {
+    it->second = std::max(it->second, timestamp_ns);
+  }
+}
+
+uint64_t PerfEventProcessor2::ComputeWatermark() const {
+  if (watermarks_per_fd_.empty()) {
+    // We don't know which file descriptors events could still come from.
+    return 0;
+  }
+  uint64_t watermark = std::numeric_limits<uint64_t>::max();
+  for (const auto& fd_and_watermark : watermarks_per_fd_) {
+    watermark = std::min(watermark, fd_and_watermark.second);
+  }
+  return watermark;
+}
+
 void PerfEventProcessor2::AddEvent(int origin_fd,
                                    std::unique_ptr<PerfEvent> event) {
+  uint64_t timestamp = event->GetTimestamp();
 #ifndef NDEBUG
   if (last_processed_timestamp_ > 0 &&
-      event->GetTimestamp() <
+      timestamp <
           last_processed_timestamp_ - PROCESSING_DELAY_MS * 1'000'000) {
     ERROR("Processed an event out of order");
   }
 #endif
-  event_queue_.PushEvent(origin_fd, std::move(event));
+  AdvanceWatermark(origin_fd, timestamp);
+  event_queue_.PushEvent(origin_fd, timestamp, std::move(event));
+}
+
+void PerfEventProcessor2::VisitEvent(PerfEvent* event) {
+  VisitPerfEvent(event, visitor_.get());
+  for (const std::unique_ptr<PerfEventVisitor>& visitor :
+       additional_visitors_) {
+    VisitPerfEvent(event, visitor.get());
+  }
 }
 
 void PerfEventProcessor2::ProcessAllEvents() {
   while (event_queue_.HasEvent()) {
-    std::unique_ptr<PerfEvent> event = event_queue_.PopEvent();
-    event->Accept(visitor_.get());
 #ifndef NDEBUG
-    last_processed_timestamp_ = event->GetTimestamp();
+    last_processed_timestamp_ = event_queue_.TopTimestamp();
 #endif
+    std::unique_ptr<PerfEvent> event = event_queue_.PopEvent();
+    VisitEvent(event.get());
   }
 }
 
 void PerfEventProcessor2::ProcessOldEvents() {
-  uint64_t max_timestamp = MonotonicTimestampNs();
+  ProcessOldEvents(MonotonicTimestampNs());
+}
+
+void PerfEventProcessor2::ProcessOldEvents(uint64_t current_timestamp_ns) {
+  uint64_t max_timestamp = current_timestamp_ns;
+  uint64_t watermark = ComputeWatermark();
 
   while (event_queue_.HasEvent()) {
-    PerfEvent* event = event_queue_.TopEvent();
+    uint64_t timestamp = event_queue_.TopTimestamp();
 
-    // Do not read the most recent events as out-of-order events could arrive.
-    if (event->GetTimestamp() + PROCESSING_DELAY_MS * 1'000'000 >=
-        max_timestamp) {
+    // Do not read the most recent events as out-of-order events could arrive,
+    // unless we know that no older event can arrive anymore.
+    if (timestamp >= watermark &&
+        timestamp + PROCESSING_DELAY_MS * 1'000'000 >= max_timestamp) {
       break;
     }
 
-    event->Accept(visitor_.get());
+    VisitEvent(event_queue_.TopEvent());
 #ifndef NDEBUG
-    last_processed_timestamp_ = event->GetTimestamp();
+    last_processed_timestamp_ = timestamp;
 #endif
     event_queue_.PopEvent();
   }
@@ -3,7 +3,7 @@
 
 #include <ctime>
 #include <memory>
-#include <queue>
+#include <vector>
 
 #include "PerfEvent.h"
 #include "PerfEventVisitor.h"
@@ -17,49 +17,76 @@ namespace LinuxTracing {
 // Instead of keeping a single priority queue with all the events to process,
 // on which push/pop operations would be logarithmic in the number of events,
 // we leverage the fact that events coming from the same perf_event_open ring
-// buffer are already sorted. We then keep a priority queue of queues, where
-// the events in each queue come from the same ring buffer. Whenever an event
-// is removed from a queue, we need to move such queue down the priority
-// queue. As std::priority_queue does not support decreasing the priority of
-// an element, we achieve this by removing and re-inserting.
-// In order to be able to add an event to a queue, we also need to maintain
-// the association between a queue and its ring buffer. We use the file
-// descriptor used to read from the ring buffer as identifier for a ring
-// buffer. Keeping this association is what the pairs and the map are for.
-// TODO: Implement a custom priority queue that supports decreasing the
-//  priority.
+// buffer are already sorted. We then keep a queue of events per ring buffer,
+// and an indexed binary min-heap of the non-empty queues, keyed by the
+// timestamp of their front event. As every queue knows its position in the
+// heap, when the front of a queue is removed we can sift the queue down the
+// heap in place, instead of removing and re-inserting it. The heap stores the
+// front timestamps next to the queue indices, and each queue stores the
+// timestamps next to its events, so that the timestamp of an event is read
+// (with a virtual call) only once, when it is pushed: comparisons never need to
+// dereference the events.
+// We use the file descriptor used to read from the ring buffer as identifier
+// for a ring buffer. The queues are stored contiguously and are never freed
+// while the PerfEventQueue is alive, as the set of ring buffers is small and
+// fixed for the duration of a capture: this avoids allocations when a queue
+// becomes empty and then receives new events.
 class PerfEventQueue {
  public:
   void PushEvent(int origin_fd, std::unique_ptr<PerfEvent> event);
-  bool HasEvent();
+  // As above, with the timestamp of event already read.
+  void PushEvent(int origin_fd, uint64_t timestamp,
+                 std::unique_ptr<PerfEvent> event);
+  bool HasEvent() const { return !heap_.empty(); }
   PerfEvent* TopEvent();
+  uint64_t TopTimestamp() const { return heap_.front().front_timestamp; }
   std::unique_ptr<PerfEvent> PopEvent();
 
  private:
-  // Comparator for the priority queue: pop will return the queue associated
-  // with the file descriptor from which the oldest event still to process
-  // originated.
-  struct QueueFrontTimestampReverseCompare {
-    bool operator()(
-        const std::pair<
-            int, std::shared_ptr<std::queue<std::unique_ptr<PerfEvent>>>>& lhs,
-        const std::pair<
-            int, std::shared_ptr<std::queue<std::unique_ptr<PerfEvent>>>>&
-            rhs) {
-      return lhs.second->front()->GetTimestamp() >
-             rhs.second->front()->GetTimestamp();
+  // A FIFO queue backed by a single vector. Popped elements are only removed
+  // from the vector in bulk, which keeps both operations amortized O(1).
+  class EventQueue {
+   public:
+    bool Empty() const { return front_index_ == events_.size(); }
+    PerfEvent* Front() const { return events_[front_index_].event.get(); }
+    uint64_t FrontTimestamp() const {
+      return events_[front_index_].timestamp;
     }
+    void Push(uint64_t timestamp, std::unique_ptr<PerfEvent> event) {
+      events_.push_back({timestamp, std::move(event)});
+    }
+    std::unique_ptr<PerfEvent> Pop();
+
+   private:
+    struct TimestampedEvent {
+      uint64_t timestamp;
+      std::unique_ptr<PerfEvent> event;
+    };
+
+    static constexpr size_t MIN_COMPACTION_SIZE = 1024;
+    std::vector<TimestampedEvent> events_;
+    size_t front_index_ = 0;
+  };
+
+  struct FdQueue {
+    EventQueue events;
+    // Position of this queue in heap_, only meaningful if events is not empty.
+    size_t heap_index = 0;
+  };
+
+  struct HeapElement {
+    uint64_t front_timestamp;
+    size_t queue_index;
   };
 
-  std::priority_queue<
-      std::pair<int, std::shared_ptr<std::queue<std::unique_ptr<PerfEvent>>>>,
-      std::vector<std::pair<
-          int, std::shared_ptr<std::queue<std::unique_ptr<PerfEvent>>>>>,
-      QueueFrontTimestampReverseCompare>
-      event_queues_queue_{};
-  absl::flat_hash_map<int,
-                      std::shared_ptr<std::queue<std::unique_ptr<PerfEvent>>>>
-      fd_event_queues_{};
+  void SwapHeapElements(size_t lhs, size_t rhs);
+  void SiftUp(size_t heap_index);
+  void SiftDown(size_t heap_index);
+
+  std::vector<FdQueue> queues_;
+  absl::flat_hash_map<int, size_t> fd_to_queue_index_;
+  // The non-empty queues.
+  std::vector<HeapElement> heap_;
 };
 
 // This class receives perf_event_open events coming from several ring buffers
@@ -68,6 +95,13 @@ class PerfEventQueue {
 // a timestamp older than PROCESSING_DELAY_MS to be added. By not processing
 // events that are not older than this delay, we will never process events out
 // of order.
+// In addition, if all the file descriptors events can come from are known
+// (AddOriginFileDescriptor), the processor keeps a watermark per file
+// descriptor: the timestamp below which no more events are expected from it,
+// either because a more recent event was already added (events from the same
+// file descriptor come in order) or because of AdvanceWatermark. Events older
+// than the minimum of these watermarks can be processed without waiting for
+// PROCESSING_DELAY_MS, which then only remains as an upper bound.
 class PerfEventProcessor2 {
  public:
   // Do not process events that are more recent than 0.1 seconds. There could be
@@ -79,15 +113,37 @@ class PerfEventProcessor2 {
   explicit PerfEventProcessor2(std::unique_ptr<PerfEventVisitor> visitor)
       : visitor_(std::move(visitor)) {}
 
+  // Events are visited by the visitor passed to the constructor first, then
+  // by the additional visitors in the order they were added. As the first
+  // visitor can move from the events it visits, the additional visitors should
+  // only handle other types of events.
+  void AddVisitor(std::unique_ptr<PerfEventVisitor> visitor) {
+    additional_visitors_.push_back(std::move(visitor));
+  }
+
+  void AddOriginFileDescriptor(int origin_fd);
+
+  // Declares that no more events older than timestamp_ns will be added with
+  // this origin_fd, for example because its ring buffer was found empty.
+  void AdvanceWatermark(int origin_fd, uint64_t timestamp_ns);
+
   void AddEvent(int origin_fd, std::unique_ptr<PerfEvent> event);
 
   void ProcessAllEvents();
 
   void ProcessOldEvents();
+  // As ProcessOldEvents, with current_timestamp_ns as the current time instead
+  // of MonotonicTimestampNs, e.g., the time of a capture being replayed.
+  void ProcessOldEvents(uint64_t current_timestamp_ns);
 
  private:
+  uint64_t ComputeWatermark() const;
+  void VisitEvent(PerfEvent* event);
+
   PerfEventQueue event_queue_;
   std::unique_ptr<PerfEventVisitor> visitor_;
+  std::vector<std::unique_ptr<PerfEventVisitor>> additional_visitors_;
+  absl::flat_hash_map<int, uint64_t> watermarks_per_fd_;
 
 #ifndef NDEBUG
   uint64_t last_processed_timestamp_ = 0;
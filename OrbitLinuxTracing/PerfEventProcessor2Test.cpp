@@ -1,25 +1,48 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
 #include "PerfEventProcessor2.h"
+#include "Utils.h"
 
 namespace LinuxTracing {
 
 namespace {
-class TestEvent : public PerfEvent {
- public:
-  explicit TestEvent(uint64_t timestamp) : timestamp_(timestamp) {}
+std::unique_ptr<PerfEvent> MakeTestEvent(uint64_t timestamp) {
+  return std::make_unique<SchedSwitchInPerfEvent>(timestamp, /*tid=*/0);
+}
 
-  uint64_t GetTimestamp() const override { return timestamp_; }
+// Records the timestamps of the events it visits, in visiting order.
+class TimestampRecordingVisitor : public PerfEventVisitor {
+ public:
+  explicit TimestampRecordingVisitor(
+      std::vector<uint64_t>* processed_timestamps)
+      : processed_timestamps_(processed_timestamps) {}
 
-  void Accept(PerfEventVisitor* visitor) override {}
+  void visit(SchedSwitchInPerfEvent* event) override {
+    processed_timestamps_->push_back(event->GetTimestamp());
+  }
 
  private:
-  uint64_t timestamp_;
+  std::vector<uint64_t>* processed_timestamps_;
 };
 
-std::unique_ptr<PerfEvent> MakeTestEvent(uint64_t timestamp) {
-  return std::make_unique<TestEvent>(timestamp);
-}
+// Records which visit method each event was dispatched to.
+class TypeRecordingVisitor : public PerfEventVisitor {
+ public:
+  void visit(StackSamplePerfEvent* /*event*/) override {
+    visited.push_back("StackSample");
+  }
+  void visit(OffCpuStackSamplePerfEvent* /*event*/) override {
+    visited.push_back("OffCpuStackSample");
+  }
+  void visit(MapsPerfEvent* /*event*/) override { visited.push_back("Maps"); }
+
+  std::vector<std::string> visited;
+};
 }  // namespace
 
 TEST(PerfEventQueue, SingleFd) {
@@ -106,4 +129,113 @@ TEST(PerfEventQueue, MultipleFd) {
   EXPECT_FALSE(event_queue.HasEvent());
 }
 
+TEST(PerfEventQueue, ManyFdsRandomlyInterleaved) {
+  constexpr int kFdCount = 64;
+  constexpr int kEventsPerFd = 100;
+  PerfEventQueue event_queue;
+  std::mt19937 random_engine{42};
+
+  // Each fd gets increasing timestamps, but fds are interleaved randomly and
+  // the queue is drained partially between pushes.
+  std::vector<uint64_t> next_timestamp_per_fd(kFdCount, 0);
+  std::vector<int> fds_to_push;
+  for (int fd = 0; fd < kFdCount; ++fd) {
+    fds_to_push.insert(fds_to_push.end(), kEventsPerFd, fd);
+  }
+  std::shuffle(fds_to_push.begin(), fds_to_push.end(), random_engine);
+
+  std::vector<uint64_t> popped_timestamps;
+  uint64_t min_timestamp_to_pop = 0;
+  for (size_t i = 0; i < fds_to_push.size(); ++i) {
+    int fd = fds_to_push[i];
+    next_timestamp_per_fd[fd] +=
+        std::uniform_int_distribution<uint64_t>{1, 10}(random_engine);
+    uint64_t timestamp =
+        std::max(next_timestamp_per_fd[fd], min_timestamp_to_pop);
+    next_timestamp_per_fd[fd] = timestamp;
+    event_queue.PushEvent(fd, MakeTestEvent(timestamp));
+
+    if (i % 7 == 0) {
+      ASSERT_TRUE(event_queue.HasEvent());
+      uint64_t top_timestamp = event_queue.TopEvent()->GetTimestamp();
+      EXPECT_EQ(event_queue.PopEvent()->GetTimestamp(), top_timestamp);
+      popped_timestamps.push_back(top_timestamp);
+      // Never push events older than what was already popped.
+      min_timestamp_to_pop = top_timestamp;
+    }
+  }
+  while (event_queue.HasEvent()) {
+    popped_timestamps.push_back(event_queue.PopEvent()->GetTimestamp());
+  }
+
+  EXPECT_EQ(popped_timestamps.size(), fds_to_push.size());
+  EXPECT_TRUE(
+      std::is_sorted(popped_timestamps.begin(), popped_timestamps.end()));
+}
+
+TEST(PerfEventProcessor2, WatermarkAllowsProcessingRecentEvents) {
+  std::vector<uint64_t> processed_timestamps;
+  PerfEventProcessor2 processor{
+      std::make_unique<TimestampRecordingVisitor>(&processed_timestamps)};
+  processor.AddOriginFileDescriptor(11);
+  processor.AddOriginFileDescriptor(22);
+
+  uint64_t now = MonotonicTimestampNs();
+  processor.AddEvent(11, MakeTestEvent(now));
+  processor.AddEvent(11, MakeTestEvent(now + 2));
+
+  // Nothing is known about fd 22 yet, so the events are too recent.
+  processor.ProcessOldEvents();
+  EXPECT_TRUE(processed_timestamps.empty());
+
+  processor.AddEvent(22, MakeTestEvent(now + 1));
+  processor.ProcessOldEvents();
+  ASSERT_EQ(processed_timestamps.size(), 1);
+  EXPECT_EQ(processed_timestamps[0], now);
+
+  // An event from fd 11 could still come before now + 2.
+  processor.AdvanceWatermark(22, now + 10);
+  processor.ProcessOldEvents();
+  ASSERT_EQ(processed_timestamps.size(), 2);
+  EXPECT_EQ(processed_timestamps[1], now + 1);
+
+  processor.AdvanceWatermark(11, now + 10);
+  processor.ProcessOldEvents();
+  ASSERT_EQ(processed_timestamps.size(), 3);
+  EXPECT_EQ(processed_timestamps[2], now + 2);
+}
+
+TEST(PerfEventProcessor2, WithoutOriginFileDescriptorsUsesFixedDelay) {
+  std::vector<uint64_t> processed_timestamps;
+  PerfEventProcessor2 processor{
+      std::make_unique<TimestampRecordingVisitor>(&processed_timestamps)};
+
+  uint64_t now = MonotonicTimestampNs();
+  uint64_t old = now - 2 * PerfEventProcessor2::PROCESSING_DELAY_MS * 1'000'000;
+  processor.AddEvent(11, MakeTestEvent(old));
+  processor.AddEvent(11, MakeTestEvent(now));
+  processor.AdvanceWatermark(11, now + 10);
+
+  processor.ProcessOldEvents();
+  ASSERT_EQ(processed_timestamps.size(), 1);
+  EXPECT_EQ(processed_timestamps[0], old);
+
+  processor.ProcessAllEvents();
+  ASSERT_EQ(processed_timestamps.size(), 2);
+  EXPECT_EQ(processed_timestamps[1], now);
+}
+
+TEST(PerfEventProcessor2, VisitsEventsByConcreteType) {
+  TypeRecordingVisitor visitor;
+  StackSamplePerfEvent stack_sample{/*dyn_size=*/0};
+  OffCpuStackSamplePerfEvent off_cpu_stack_sample{/*dyn_size=*/0};
+  MapsPerfEvent maps{/*timestamp=*/1, /*pid=*/10, "maps"};
+  VisitPerfEvent(&stack_sample, &visitor);
+  VisitPerfEvent(&off_cpu_stack_sample, &visitor);
+  maps.Accept(&visitor);
+  EXPECT_EQ(visitor.visited,
+            (std::vector<std::string>{"StackSample", "OffCpuStackSample",
+                                      "Maps"}));
+}
+
 }  // namespace LinuxTracing
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <queue>
+#include <random>
+
+#include "PerfEventProcessor2.h"
+
+// Microbenchmark of PerfEventQueue against the previous implementation, a
+// std::priority_queue of std::shared_ptr<std::queue>, which removes and
+// re-inserts a queue on every pop. Disabled by default, run with:
+//   OrbitLinuxTracingTests --gtest_also_run_disabled_tests \
+//       --gtest_filter='PerfEventQueueBenchmark.*'
+
+namespace LinuxTracing {
+
+namespace {
+class PriorityQueueOfQueues {
+ public:
+  void PushEvent(int origin_fd, std::unique_ptr<PerfEvent> event) {
+    if (fd_event_queues_.count(origin_fd) > 0) {
+      fd_event_queues_.at(origin_fd)->push(std::move(event));
+    } else {
+      auto event_queue = std::make_shared<EventQueue>();
+      fd_event_queues_.insert(std::make_pair(origin_fd, event_queue));
+      event_queue->push(std::move(event));
+      event_queues_queue_.push(std::make_pair(origin_fd, event_queue));
+    }
+  }
+
+  bool HasEvent() { return !event_queues_queue_.empty(); }
+
+  std::unique_ptr<PerfEvent> PopEvent() {
+    FdAndQueue top_fd_queue = event_queues_queue_.top();
+    event_queues_queue_.pop();
+    std::unique_ptr<PerfEvent> top_event =
+        std::move(top_fd_queue.second->front());
+    top_fd_queue.second->pop();
+    if (top_fd_queue.second->empty()) {
+      fd_event_queues_.erase(top_fd_queue.first);
+    } else {
+      event_queues_queue_.push(top_fd_queue);
+    }
+    return top_event;
+  }
+
+ private:
+  using EventQueue = std::queue<std::unique_ptr<PerfEvent>>;
+  using FdAndQueue = std::pair<int, std::shared_ptr<EventQueue>>;
+
+  struct QueueFrontTimestampReverseCompare {
+    bool operator()(const FdAndQueue& lhs, const FdAndQueue& rhs) {
+      return lhs.second->front()->GetTimestamp() >
+             rhs.second->front()->GetTimestamp();
+    }
+  };
+
+  std::priority_queue<FdAndQueue, std::vector<FdAndQueue>,
+                      QueueFrontTimestampReverseCompare>
+      event_queues_queue_{};
+  absl::flat_hash_map<int, std::shared_ptr<EventQueue>> fd_event_queues_{};
+};
+
+// Simulates the pattern of TracerThread and PerfEventProcessor2: events from
+// fd_count ring buffers are pushed in batches, and after each batch the queue
+// is drained down to a backlog of roughly backlog_size events.
+template <typename QueueT>
+double MeasureNsPerEvent(int fd_count, size_t event_count,
+                         size_t backlog_size) {
+  std::mt19937 random_engine{fd_count};
+  std::uniform_int_distribution<int> fd_distribution{0, fd_count - 1};
+  std::vector<int> fds(event_count);
+  for (int& fd : fds) {
+    fd = fd_distribution(random_engine);
+  }
+  // Pre-allocate the events, so that we only measure the queue.
+  std::vector<std::unique_ptr<PerfEvent>> events;
+  events.reserve(event_count);
+  for (size_t i = 0; i < event_count; ++i) {
+    events.push_back(std::make_unique<SchedSwitchInPerfEvent>(i, /*tid=*/0));
+  }
+
+  QueueT queue;
+  size_t queued_count = 0;
+  uint64_t checksum = 0;
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < event_count; ++i) {
+    queue.PushEvent(fds[i], std::move(events[i]));
+    ++queued_count;
+    if (queued_count > backlog_size) {
+      checksum += queue.PopEvent()->GetTimestamp();
+      --queued_count;
+    }
+  }
+  while (queue.HasEvent()) {
+    checksum += queue.PopEvent()->GetTimestamp();
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  EXPECT_EQ(checksum, event_count * (event_count - 1) / 2);
+  return std::chrono::duration<double, std::nano>(end - begin).count() /
+         event_count;
+}
+}  // namespace
+
+TEST(PerfEventQueueBenchmark, DISABLED_CompareWithPriorityQueueOfQueues) {
+  constexpr size_t kEventCount = 2'000'000;
+  constexpr size_t kBacklogSize = 10'000;
+  for (int fd_count : {1, 4, 16, 64, 256}) {
+    double previous_ns = MeasureNsPerEvent<PriorityQueueOfQueues>(
+        fd_count, kEventCount, kBacklogSize);
+    double current_ns =
+        MeasureNsPerEvent<PerfEventQueue>(fd_count, kEventCount, kBacklogSize);
+    printf("%3d ring buffers: PerfEventQueue %6.1f ns/event, "
+           "priority queue of queues %6.1f ns/event (%.2fx)\n",
+           fd_count, current_ns, previous_ns, previous_ns / current_ns);
+  }
+}
+
+}  // namespace LinuxTracing
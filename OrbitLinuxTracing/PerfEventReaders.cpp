@@ -1,12 +1,90 @@
 #include "PerfEventReaders.h"
 
 #include <OrbitBase/Logging.h>
+
+#include <algorithm>
+#include <cstring>
+
 #include "PerfEventRecords.h"
-#include "PerfEventRingBuffer.h"
 
 namespace LinuxTracing {
 
-pid_t ReadMmapRecordPid(PerfEventRingBuffer* ring_buffer) {
+namespace {
+// Reads the values of pmu_counters from a record with the layout of
+// perf_event_sample_read_group_fixed. Returns the offset of the data that
+// follows the values of the group, or 0 if the record is too short.
+size_t ReadPmuCounterValues(absl::Span<const uint8_t> record_view,
+                            const std::vector<PmuCounter>& pmu_counters,
+                            PmuCounterValues* values) {
+  if (record_view.size() < sizeof(perf_event_sample_read_group_fixed)) {
+    return 0;
+  }
+  const auto* record =
+      RecordViewAs<perf_event_sample_read_group_fixed>(record_view);
+  uint64_t nr = record->nr;
+  constexpr size_t values_offset = sizeof(perf_event_sample_read_group_fixed);
+  if (nr < pmu_counters.size() ||
+      nr > (record_view.size() - values_offset) / sizeof(uint64_t)) {
+    return 0;
+  }
+
+  values->fill(0);
+  for (size_t i = 0; i < pmu_counters.size(); ++i) {
+    uint64_t value;
+    memcpy(&value, record_view.data() + values_offset + i * sizeof(uint64_t),
+           sizeof(uint64_t));
+    (*values)[static_cast<size_t>(pmu_counters[i])] = value;
+  }
+  return values_offset + nr * sizeof(uint64_t);
+}
+
+// The registers and the user stack that follow the raw data of a record of
+// tracepoint_stack_event_open.
+template <typename StackSamplePerfEventT>
+std::unique_ptr<StackSamplePerfEventT> DecodeRawDataStackSample(
+    absl::Span<const uint8_t> record_view) {
+  // The raw data is padded by the kernel so that the size and the data
+  // together keep the fields that follow 8-byte aligned.
+  const auto* record = RecordViewAs<perf_event_sample_raw>(record_view);
+  size_t regs_offset = sizeof(perf_event_sample_raw) + record->size;
+  if (regs_offset + sizeof(uint64_t) > record_view.size()) {
+    return nullptr;
+  }
+  uint64_t abi;
+  memcpy(&abi, record_view.data() + regs_offset, sizeof(abi));
+  // Without registers, the record continues with a zero stack size.
+  size_t stack_offset = regs_offset + sizeof(perf_event_sample_regs_user_all);
+  if (abi == PERF_SAMPLE_REGS_ABI_NONE ||
+      stack_offset + sizeof(uint64_t) > record_view.size()) {
+    return nullptr;
+  }
+
+  // The stack dump is smaller than SAMPLE_STACK_USER_SIZE if the record would
+  // otherwise exceed the maximum size of a record, so read its actual size.
+  uint64_t stack_size;
+  memcpy(&stack_size, record_view.data() + stack_offset, sizeof(stack_size));
+  size_t stack_data_offset = stack_offset + sizeof(uint64_t);
+  if (stack_size == 0 || stack_data_offset + stack_size + sizeof(uint64_t) >
+                             record_view.size()) {
+    return nullptr;
+  }
+  uint64_t dyn_size;
+  memcpy(&dyn_size, record_view.data() + stack_data_offset + stack_size,
+         sizeof(dyn_size));
+  dyn_size = std::min(dyn_size, stack_size);
+
+  auto event = std::make_unique<StackSamplePerfEventT>(dyn_size);
+  event->ring_buffer_record->header = record->header;
+  event->ring_buffer_record->sample_id = record->sample_id;
+  memcpy(&event->ring_buffer_record->regs, record_view.data() + regs_offset,
+         sizeof(perf_event_sample_regs_user_all));
+  memcpy(event->ring_buffer_record->stack.data.get(),
+         record_view.data() + stack_data_offset, dyn_size);
+  return event;
+}
+}  // namespace
+
+pid_t ReadMmapRecordPid(absl::Span<const uint8_t> record_view) {
   // Mmap records have the following layout:
   // struct {
   //   struct perf_event_header header;
@@ -19,40 +97,258 @@ pid_t ReadMmapRecordPid(PerfEventRingBuffer* ring_buffer) {
   // };
   // Because of filename, the layout is not fixed.
 
+  DCHECK(record_view.size() >= sizeof(perf_event_header) + sizeof(pid_t));
   pid_t pid;
-  ring_buffer->ReadValueAtOffset(&pid, sizeof(perf_event_header));
+  memcpy(&pid, record_view.data() + sizeof(perf_event_header), sizeof(pid_t));
   return pid;
 }
 
-pid_t ReadSampleRecordPid(PerfEventRingBuffer* ring_buffer) {
-  pid_t pid;
-  ring_buffer->ReadValueAtOffset(
-      &pid, offsetof(perf_event_stack_sample, sample_id.pid));
-  return pid;
+std::unique_ptr<MmapPerfEvent> DecodeMmapPerfEvent(
+    absl::Span<const uint8_t> record_view) {
+  // See ReadMmapRecordPid for the layout. The sample_id is at the end.
+  const auto* record = RecordViewAs<perf_event_mmap_up_to_pgoff>(record_view);
+  constexpr size_t filename_offset = sizeof(perf_event_mmap_up_to_pgoff);
+  constexpr size_t sample_id_size =
+      sizeof(perf_event_sample_id_tid_time_streamid_cpu);
+  DCHECK(record_view.size() >= filename_offset + sample_id_size);
+  size_t sample_id_offset = record_view.size() - sample_id_size;
+
+  perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  memcpy(&sample_id, record_view.data() + sample_id_offset, sample_id_size);
+
+  const char* filename_begin =
+      reinterpret_cast<const char*>(record_view.data()) + filename_offset;
+  std::string filename{filename_begin,
+                       strnlen(filename_begin,
+                               sample_id_offset - filename_offset)};
+
+  // Copy the packed fields, as make_unique would take references to them.
+  uint64_t timestamp = sample_id.time;
+  pid_t pid = static_cast<pid_t>(record->pid);
+  uint64_t address = record->address;
+  uint64_t length = record->length;
+  uint64_t page_offset = record->page_offset;
+  return std::make_unique<MmapPerfEvent>(timestamp, pid, address, length,
+                                         page_offset, std::move(filename));
 }
 
-pid_t ReadUretprobesRecordPid(PerfEventRingBuffer* ring_buffer) {
-  pid_t pid;
-  ring_buffer->ReadValueAtOffset(
-      &pid, offsetof(perf_event_empty_sample, sample_id.pid));
-  return pid;
+std::unique_ptr<CommPerfEvent> DecodeCommPerfEvent(
+    absl::Span<const uint8_t> record_view) {
+  // Like for mmap records, the sample_id is at the end, after comm.
+  const auto* record = RecordViewAs<perf_event_comm_up_to_tid>(record_view);
+  constexpr size_t comm_offset = sizeof(perf_event_comm_up_to_tid);
+  constexpr size_t sample_id_size =
+      sizeof(perf_event_sample_id_tid_time_streamid_cpu);
+  DCHECK(record_view.size() >= comm_offset + sample_id_size);
+  size_t sample_id_offset = record_view.size() - sample_id_size;
+
+  perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  memcpy(&sample_id, record_view.data() + sample_id_offset, sample_id_size);
+
+  const char* comm_begin =
+      reinterpret_cast<const char*>(record_view.data()) + comm_offset;
+  std::string comm{comm_begin,
+                   strnlen(comm_begin, sample_id_offset - comm_offset)};
+
+  uint64_t timestamp = sample_id.time;
+  pid_t pid = static_cast<pid_t>(record->pid);
+  pid_t tid = static_cast<pid_t>(record->tid);
+  bool is_exec = (record->header.misc & PERF_RECORD_MISC_COMM_EXEC) != 0;
+  return std::make_unique<CommPerfEvent>(timestamp, pid, tid, std::move(comm),
+                                         is_exec);
+}
+
+pid_t ReadSampleRecordPid(absl::Span<const uint8_t> record_view) {
+  // All our PERF_RECORD_SAMPLEs start with the same sample_id, independently of
+  // what follows (registers and stack, raw tracepoint data, or nothing).
+  return RecordViewAs<perf_event_empty_sample>(record_view)->sample_id.pid;
+}
+
+pid_t ReadSampleRecordTid(absl::Span<const uint8_t> record_view) {
+  return RecordViewAs<perf_event_empty_sample>(record_view)->sample_id.tid;
+}
+
+uint64_t ReadSampleRecordStreamId(absl::Span<const uint8_t> record_view) {
+  return RecordViewAs<perf_event_empty_sample>(record_view)
+      ->sample_id.stream_id;
 }
 
-std::unique_ptr<PerfEventSampleRaw> ConsumeSampleRaw(
-    PerfEventRingBuffer* ring_buffer, const perf_event_header& header) {
-  uint32_t size = 0;
-  ring_buffer->ReadValueAtOffset(
-      &size, offsetof(perf_event_sample_raw, size));
-  auto event = std::make_unique<PerfEventSampleRaw>(size);
-  ring_buffer->ReadRawAtOffset(
-      reinterpret_cast<uint8_t*>(&event->ring_buffer_record),
-      0, sizeof(perf_event_sample_raw));
-  ring_buffer->ReadRawAtOffset(
-      &event->data[0],
-      offsetof(perf_event_sample_raw, size) + sizeof(uint32_t),
-      size);
-  ring_buffer->SkipRecord(header);
+pid_t ReadUretprobesRecordPid(absl::Span<const uint8_t> record_view) {
+  return RecordViewAs<perf_event_empty_sample>(record_view)->sample_id.pid;
+}
+
+std::unique_ptr<UprobesPerfEvent> DecodeUprobesPerfEvent(
+    absl::Span<const uint8_t> record_view, bool with_arguments) {
+  // Copy the packed fields, as make_unique would take references to them.
+  if (with_arguments) {
+    const auto* record =
+        RecordViewAs<perf_event_sp_ip_arguments_sample>(record_view);
+    uint64_t timestamp = record->sample_id.time;
+    pid_t pid = record->sample_id.pid;
+    pid_t tid = record->sample_id.tid;
+    uint32_t cpu = record->sample_id.cpu;
+    uint64_t sp = record->regs.sp;
+    uint64_t ip = record->regs.ip;
+    std::vector<uint64_t> arguments{record->regs.di, record->regs.si,
+                                    record->regs.dx, record->regs.cx,
+                                    record->regs.r8, record->regs.r9};
+    return std::make_unique<UprobesPerfEvent>(timestamp, pid, tid, cpu, sp, ip,
+                                              std::move(arguments));
+  }
+
+  const auto* record = RecordViewAs<perf_event_sp_ip_sample>(record_view);
+  uint64_t timestamp = record->sample_id.time;
+  pid_t pid = record->sample_id.pid;
+  pid_t tid = record->sample_id.tid;
+  uint32_t cpu = record->sample_id.cpu;
+  uint64_t sp = record->regs.sp;
+  uint64_t ip = record->regs.ip;
+  return std::make_unique<UprobesPerfEvent>(timestamp, pid, tid, cpu, sp, ip,
+                                            std::vector<uint64_t>{});
+}
+
+std::unique_ptr<UretprobesPerfEvent> DecodeUretprobesPerfEvent(
+    absl::Span<const uint8_t> record_view) {
+  // The record is shorter than perf_event_ax_sample if the abi is
+  // PERF_SAMPLE_REGS_ABI_NONE: the rest of ring_buffer_record stays zero.
+  auto event = std::make_unique<UretprobesPerfEvent>();
+  memcpy(&event->ring_buffer_record, record_view.data(),
+         std::min(record_view.size(), sizeof(perf_event_ax_sample)));
+  return event;
+}
+
+std::unique_ptr<UprobesPerfEvent> DecodeUprobesWithPmuCountersPerfEvent(
+    absl::Span<const uint8_t> record_view,
+    const std::vector<PmuCounter>& pmu_counters) {
+  PmuCounterValues values;
+  size_t regs_offset = ReadPmuCounterValues(record_view, pmu_counters, &values);
+  if (regs_offset == 0) {
+    return nullptr;
+  }
+  // Without user-space registers, only the abi is there: sp and ip stay zero.
+  perf_event_sample_regs_user_sp_ip regs{};
+  memcpy(&regs, record_view.data() + regs_offset,
+         std::min(record_view.size() - regs_offset, sizeof(regs)));
+
+  // Copy the packed fields, as make_unique would take references to them.
+  const auto* record =
+      RecordViewAs<perf_event_sample_read_group_fixed>(record_view);
+  uint64_t timestamp = record->sample_id.time;
+  pid_t pid = record->sample_id.pid;
+  pid_t tid = record->sample_id.tid;
+  uint32_t cpu = record->sample_id.cpu;
+  uint64_t sp = regs.sp;
+  uint64_t ip = regs.ip;
+  auto event = std::make_unique<UprobesPerfEvent>(timestamp, pid, tid, cpu, sp,
+                                                  ip, std::vector<uint64_t>{});
+  event->SetPmuCounters(values);
+  return event;
+}
+
+std::unique_ptr<UretprobesPerfEvent> DecodeUretprobesWithPmuCountersPerfEvent(
+    absl::Span<const uint8_t> record_view,
+    const std::vector<PmuCounter>& pmu_counters) {
+  PmuCounterValues values;
+  size_t regs_offset = ReadPmuCounterValues(record_view, pmu_counters, &values);
+  if (regs_offset == 0) {
+    return nullptr;
+  }
+
+  // Laid out as a record of uretprobes_event_open, without the counters.
+  const auto* record =
+      RecordViewAs<perf_event_sample_read_group_fixed>(record_view);
+  auto event = std::make_unique<UretprobesPerfEvent>();
+  event->ring_buffer_record.header = record->header;
+  event->ring_buffer_record.sample_id = record->sample_id;
+  memcpy(&event->ring_buffer_record.regs, record_view.data() + regs_offset,
+         std::min(record_view.size() - regs_offset,
+                  sizeof(event->ring_buffer_record.regs)));
+  event->SetPmuCounters(values);
   return event;
 }
 
+std::unique_ptr<PmuCounterSwitchPerfEvent> DecodePmuCounterSwitchPerfEvent(
+    absl::Span<const uint8_t> record_view,
+    const std::vector<PmuCounter>& pmu_counters) {
+  PmuCounterValues values;
+  if (ReadPmuCounterValues(record_view, pmu_counters, &values) == 0) {
+    return nullptr;
+  }
+  // sched:sched_switch fires in the context of the thread switched out.
+  const auto* record =
+      RecordViewAs<perf_event_sample_read_group_fixed>(record_view);
+  uint64_t timestamp = record->sample_id.time;
+  pid_t prev_tid = record->sample_id.tid;
+  uint32_t cpu = record->sample_id.cpu;
+  return std::make_unique<PmuCounterSwitchPerfEvent>(timestamp, prev_tid, cpu,
+                                                     values);
+}
+
+std::unique_ptr<CallchainSamplePerfEvent> DecodeCallchainSamplePerfEvent(
+    absl::Span<const uint8_t> record_view) {
+  const auto* record =
+      RecordViewAs<perf_event_callchain_sample_fixed>(record_view);
+  uint64_t nr = record->nr;
+  DCHECK(sizeof(perf_event_callchain_sample_fixed) + nr * sizeof(uint64_t) <=
+         record_view.size());
+  std::vector<uint64_t> ips(nr);
+  memcpy(ips.data(),
+         record_view.data() + sizeof(perf_event_callchain_sample_fixed),
+         nr * sizeof(uint64_t));
+
+  // Copy the packed fields, as make_unique would take references to them.
+  uint64_t timestamp = record->sample_id.time;
+  pid_t pid = record->sample_id.pid;
+  pid_t tid = record->sample_id.tid;
+  return std::make_unique<CallchainSamplePerfEvent>(timestamp, pid, tid,
+                                                    std::move(ips));
+}
+
+std::unique_ptr<OffCpuStackSamplePerfEvent> DecodeOffCpuStackSamplePerfEvent(
+    absl::Span<const uint8_t> record_view) {
+  return DecodeRawDataStackSample<OffCpuStackSamplePerfEvent>(record_view);
+}
+
+std::unique_ptr<GpuSubmissionStackSamplePerfEvent>
+DecodeGpuSubmissionStackSamplePerfEvent(absl::Span<const uint8_t> record_view) {
+  return DecodeRawDataStackSample<GpuSubmissionStackSamplePerfEvent>(
+      record_view);
+}
+
+std::unique_ptr<LockWaitStackSamplePerfEvent>
+DecodeLockWaitStackSamplePerfEvent(absl::Span<const uint8_t> record_view) {
+  return DecodeRawDataStackSample<LockWaitStackSamplePerfEvent>(record_view);
+}
+
+ThreadState ThreadStateFromSchedSwitchPrevState(int64_t prev_state) {
+  // Since Linux 4.14, prev_state has at most one of the bits of TASK_REPORT
+  // (0x7f) or TASK_REPORT_IDLE (0x80) set, and is TASK_REPORT_MAX (0x100) if
+  // the thread was preempted. Also see task_state_to_char in the kernel.
+  if (prev_state & 0x01) {
+    return ThreadState::kInterruptibleSleep;
+  }
+  if (prev_state & 0x02) {
+    return ThreadState::kUninterruptibleSleep;
+  }
+  if (prev_state & 0x04) {
+    return ThreadState::kStopped;
+  }
+  if (prev_state & 0x08) {
+    return ThreadState::kTraced;
+  }
+  if (prev_state & 0x10) {
+    return ThreadState::kDead;
+  }
+  if (prev_state & 0x20) {
+    return ThreadState::kZombie;
+  }
+  if (prev_state & 0x40) {
+    return ThreadState::kParked;
+  }
+  if (prev_state & 0x80) {
+    return ThreadState::kIdle;
+  }
+  return ThreadState::kRunnable;
+}
+
 }  // namespace LinuxTracing
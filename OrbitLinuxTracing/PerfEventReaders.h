@@ -1,40 +1,121 @@
 #ifndef ORBIT_LINUX_TRACING_PERF_EVENT_READERS_H_
 #define ORBIT_LINUX_TRACING_PERF_EVENT_READERS_H_
 
+#include <OrbitBase/Logging.h>
+
+#include <algorithm>
+#include <cstring>
+
 #include "PerfEvent.h"
 #include "PerfEventRingBuffer.h"
+#include "absl/types/span.h"
 
 namespace LinuxTracing {
 
-// Helper functions for reads from a perf_event_open ring buffer that require
-// more complex operations than simply copying an entire perf_event_open record.
-pid_t ReadMmapRecordPid(PerfEventRingBuffer* ring_buffer);
+// Helper functions to decode perf_event_open records directly from a view
+// returned by PerfEventRingBuffer::ReadRecordView, so that the data only
+// needs to be copied once, into the PerfEvent that outlives the record.
+
+// All record structs in PerfEventRecords.h are packed, so we can reinterpret
+// the view regardless of its alignment.
+template <typename RecordT>
+inline const RecordT* RecordViewAs(absl::Span<const uint8_t> record_view) {
+  DCHECK(record_view.size() >= sizeof(RecordT));
+  return reinterpret_cast<const RecordT*>(record_view.data());
+}
+
+pid_t ReadMmapRecordPid(absl::Span<const uint8_t> record_view);
+
+std::unique_ptr<MmapPerfEvent> DecodeMmapPerfEvent(
+    absl::Span<const uint8_t> record_view);
+
+// ReadMmapRecordPid also reads the pid of PERF_RECORD_COMM records, which
+// have it at the same offset.
+std::unique_ptr<CommPerfEvent> DecodeCommPerfEvent(
+    absl::Span<const uint8_t> record_view);
+
+pid_t ReadSampleRecordPid(absl::Span<const uint8_t> record_view);
+
+pid_t ReadSampleRecordTid(absl::Span<const uint8_t> record_view);
+
+uint64_t ReadSampleRecordStreamId(absl::Span<const uint8_t> record_view);
+
+pid_t ReadUretprobesRecordPid(absl::Span<const uint8_t> record_view);
+
+// Decodes a record of a uprobes opened with uprobes_regs_event_open.
+std::unique_ptr<UprobesPerfEvent> DecodeUprobesPerfEvent(
+    absl::Span<const uint8_t> record_view, bool with_arguments);
+
+std::unique_ptr<UretprobesPerfEvent> DecodeUretprobesPerfEvent(
+    absl::Span<const uint8_t> record_view);
+
+// Decode the records of the events opened with
+// uprobes_pmu_counters_event_open, uretprobes_pmu_counters_event_open and
+// sched_switch_pmu_counters_event_open. pmu_counters are the counters of the
+// group, in the order they were opened, i.e., the first values of the group.
+// Return nullptr if the record doesn't have the values of all of them.
+std::unique_ptr<UprobesPerfEvent> DecodeUprobesWithPmuCountersPerfEvent(
+    absl::Span<const uint8_t> record_view,
+    const std::vector<PmuCounter>& pmu_counters);
+
+std::unique_ptr<UretprobesPerfEvent> DecodeUretprobesWithPmuCountersPerfEvent(
+    absl::Span<const uint8_t> record_view,
+    const std::vector<PmuCounter>& pmu_counters);
+
+std::unique_ptr<PmuCounterSwitchPerfEvent> DecodePmuCounterSwitchPerfEvent(
+    absl::Span<const uint8_t> record_view,
+    const std::vector<PmuCounter>& pmu_counters);
+
+std::unique_ptr<CallchainSamplePerfEvent> DecodeCallchainSamplePerfEvent(
+    absl::Span<const uint8_t> record_view);
+
+// Decodes the registers and the user stack of a record of
+// sched_switch_stack_event_open, which follow the raw data of the tracepoint.
+// Returns nullptr if the thread switched out had no user-space registers or
+// stack, e.g., for kernel threads.
+std::unique_ptr<OffCpuStackSamplePerfEvent> DecodeOffCpuStackSamplePerfEvent(
+    absl::Span<const uint8_t> record_view);
 
-pid_t ReadSampleRecordPid(PerfEventRingBuffer* ring_buffer);
+// Decodes the registers and the user stack of a record of amdgpu_cs_ioctl
+// opened with tracepoint_stack_event_open, like
+// DecodeOffCpuStackSamplePerfEvent.
+std::unique_ptr<GpuSubmissionStackSamplePerfEvent>
+DecodeGpuSubmissionStackSamplePerfEvent(absl::Span<const uint8_t> record_view);
 
-pid_t ReadUretprobesRecordPid(PerfEventRingBuffer* ring_buffer);
+// Decodes the registers and the user stack of a record of sys_exit_futex
+// opened with tracepoint_stack_event_open, like
+// DecodeOffCpuStackSamplePerfEvent.
+std::unique_ptr<LockWaitStackSamplePerfEvent>
+DecodeLockWaitStackSamplePerfEvent(absl::Span<const uint8_t> record_view);
 
-std::unique_ptr<PerfEventSampleRaw> ConsumeSampleRaw(
-    PerfEventRingBuffer* ring_buffer, const perf_event_header& header);
+// The state a thread that was switched out is left in, from the prev_state
+// field of sched:sched_switch. A thread that was preempted is kRunnable.
+ThreadState ThreadStateFromSchedSwitchPrevState(int64_t prev_state);
 
 template <typename SamplePerfEventT>
-inline std::unique_ptr<SamplePerfEventT> ConsumeSamplePerfEvent(
-    PerfEventRingBuffer* ring_buffer, const perf_event_header& header) {
-  // Data in the ring buffer has the layout of perf_event_stack_sample, but we
-  // copy it into dynamically_sized_perf_event_stack_sample.
-  uint64_t dyn_size;
-  ring_buffer->ReadValueAtOffset(
-      &dyn_size, offsetof(perf_event_stack_sample, stack.dyn_size));
+inline std::unique_ptr<SamplePerfEventT> DecodeSamplePerfEvent(
+    absl::Span<const uint8_t> record_view) {
+  // Data in the ring buffer has the layout of perf_event_stack_sample_fixed
+  // followed by the stack dump, but we copy it into
+  // dynamically_sized_perf_event_stack_sample, only copying the dyn_size bytes
+  // of the stack that were actually dumped.
+  const auto* record =
+      RecordViewAs<perf_event_stack_sample_fixed>(record_view);
+  uint64_t stack_size = record->stack_size;
+  size_t stack_data_offset = sizeof(perf_event_stack_sample_fixed);
+  uint64_t dyn_size = 0;
+  if (stack_size != 0 && stack_data_offset + stack_size + sizeof(uint64_t) <=
+                             record_view.size()) {
+    memcpy(&dyn_size, record_view.data() + stack_data_offset + stack_size,
+           sizeof(dyn_size));
+    dyn_size = std::min(dyn_size, stack_size);
+  }
   auto event = std::make_unique<SamplePerfEventT>(dyn_size);
-  event->ring_buffer_record->header = header;
-  ring_buffer->ReadValueAtOffset(&event->ring_buffer_record->sample_id,
-                                 offsetof(perf_event_stack_sample, sample_id));
-  ring_buffer->ReadValueAtOffset(&event->ring_buffer_record->regs,
-                                 offsetof(perf_event_stack_sample, regs));
-  ring_buffer->ReadRawAtOffset(event->ring_buffer_record->stack.data.get(),
-                               offsetof(perf_event_stack_sample, stack.data),
-                               dyn_size);
-  ring_buffer->SkipRecord(header);
+  event->ring_buffer_record->header = record->header;
+  event->ring_buffer_record->sample_id = record->sample_id;
+  event->ring_buffer_record->regs = record->regs;
+  memcpy(event->ring_buffer_record->stack.data.get(),
+         record_view.data() + stack_data_offset, dyn_size);
   return event;
 }
 
@@ -0,0 +1,134 @@
+#include "PerfEventRecordFile.h"
+
+#include <OrbitBase/Logging.h>
+#include <OrbitBase/SafeStrerror.h>
+
+namespace LinuxTracing {
+
+namespace {
+constexpr char MAGIC[8] = {'O', 'R', 'B', 'P', 'E', 'R', 'F', '\0'};
+constexpr uint32_t VERSION = 2;
+
+struct EntryHeader {
+  RecordFileEntryType type;
+  uint32_t payload_size;
+};
+}  // namespace
+
+RecordFileEntryBuilder& RecordFileEntryBuilder::AddBytes(
+    absl::Span<const uint8_t> bytes) {
+  Add(static_cast<uint32_t>(bytes.size()));
+  payload_.append(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  return *this;
+}
+
+RecordFileEntryBuilder& RecordFileEntryBuilder::AddString(
+    std::string_view string) {
+  return AddBytes(absl::MakeConstSpan(
+      reinterpret_cast<const uint8_t*>(string.data()), string.size()));
+}
+
+bool RecordFileEntryParser::ReadBytes(absl::Span<const uint8_t>* bytes) {
+  absl::Span<const uint8_t> payload = payload_;
+  uint32_t size;
+  if (!Read(&size) || payload_.size() < size) {
+    payload_ = payload;
+    return false;
+  }
+  *bytes = payload_.subspan(0, size);
+  payload_.remove_prefix(size);
+  return true;
+}
+
+bool RecordFileEntryParser::ReadString(std::string* string) {
+  absl::Span<const uint8_t> bytes;
+  if (!ReadBytes(&bytes)) return false;
+  string->assign(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  return true;
+}
+
+std::unique_ptr<RecordFileWriter> RecordFileWriter::Create(
+    const std::string& path) {
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    ERROR("Creating record file %s: %s", path.c_str(), SafeStrerror(errno));
+    return nullptr;
+  }
+  std::unique_ptr<RecordFileWriter> writer{new RecordFileWriter(file)};
+  setvbuf(file, writer->buffer_.data(), _IOFBF, writer->buffer_.size());
+  std::fwrite(MAGIC, sizeof(MAGIC), 1, file);
+  std::fwrite(&VERSION, sizeof(VERSION), 1, file);
+  writer->written_bytes_ = sizeof(MAGIC) + sizeof(VERSION);
+  return writer;
+}
+
+RecordFileWriter::~RecordFileWriter() {
+  if (std::fclose(file_) != 0) {
+    ERROR("Closing record file: %s", SafeStrerror(errno));
+  }
+}
+
+void RecordFileWriter::Write(
+    RecordFileEntryType type,
+    std::initializer_list<absl::Span<const uint8_t>> parts) {
+  EntryHeader header{type, 0};
+  for (absl::Span<const uint8_t> part : parts) {
+    header.payload_size += part.size();
+  }
+  std::lock_guard<std::mutex> lock{mutex_};
+  std::fwrite(&header, sizeof(header), 1, file_);
+  for (absl::Span<const uint8_t> part : parts) {
+    std::fwrite(part.data(), 1, part.size(), file_);
+  }
+  written_bytes_ += sizeof(header) + header.payload_size;
+}
+
+uint64_t RecordFileWriter::GetWrittenBytes() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return written_bytes_;
+}
+
+std::unique_ptr<RecordFileReader> RecordFileReader::Open(
+    const std::string& path) {
+  std::FILE* file = std::fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    ERROR("Opening record file %s: %s", path.c_str(), SafeStrerror(errno));
+    return nullptr;
+  }
+  std::unique_ptr<RecordFileReader> reader{new RecordFileReader(file)};
+  char magic[sizeof(MAGIC)];
+  uint32_t version;
+  if (std::fread(magic, sizeof(magic), 1, file) != 1 ||
+      memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      std::fread(&version, sizeof(version), 1, file) != 1) {
+    ERROR("%s is not a record file", path.c_str());
+    return nullptr;
+  }
+  if (version != VERSION) {
+    ERROR("Record file %s has version %u, expected %u", path.c_str(), version,
+          VERSION);
+    return nullptr;
+  }
+  return reader;
+}
+
+RecordFileReader::~RecordFileReader() { std::fclose(file_); }
+
+bool RecordFileReader::ReadEntry(RecordFileEntryType* type,
+                                 absl::Span<const uint8_t>* payload) {
+  EntryHeader header;
+  if (std::fread(&header, sizeof(header), 1, file_) != 1) {
+    return false;
+  }
+  payload_.resize(header.payload_size);
+  if (std::fread(payload_.data(), 1, payload_.size(), file_) !=
+      payload_.size()) {
+    ERROR("Truncated entry at the end of the record file");
+    return false;
+  }
+  *type = header.type;
+  *payload = absl::MakeConstSpan(payload_);
+  return true;
+}
+
+}  // namespace LinuxTracing
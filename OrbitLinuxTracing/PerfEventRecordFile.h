@@ -0,0 +1,144 @@
+#ifndef ORBIT_LINUX_TRACING_PERF_EVENT_RECORD_FILE_H_
+#define ORBIT_LINUX_TRACING_PERF_EVENT_RECORD_FILE_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "absl/types/span.h"
+
+namespace LinuxTracing {
+
+// A file of the raw perf_event_open records of a capture, together with what
+// is needed to process them again offline: the ring buffers they come from,
+// the functions of the u(ret)probes, the maps of the targets and the build ids
+// of their binaries. See TracerThread::SetRecordFilePath and
+// TracerThread::Replay for the entries and their fields.
+// The file is a header (magic and version) followed by entries, each a type,
+// the size of the payload, and the payload. All integers are in the byte order
+// of the machine that recorded the file.
+enum class RecordFileEntryType : uint32_t {
+  kTarget = 0,
+  kRingBuffer,
+  kUprobes,
+  kPmuCounters,
+  kGpuTracepointIds,
+  kThreads,
+  kMaps,
+  kBuildId,
+  kRecord,
+  kWatermark,
+};
+
+// Serializes the fields of the payload of an entry.
+class RecordFileEntryBuilder {
+ public:
+  template <typename T>
+  RecordFileEntryBuilder& Add(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    payload_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    return *this;
+  }
+
+  // Prefixed with their size.
+  RecordFileEntryBuilder& AddBytes(absl::Span<const uint8_t> bytes);
+  RecordFileEntryBuilder& AddString(std::string_view string);
+
+  absl::Span<const uint8_t> GetPayload() const {
+    return absl::MakeConstSpan(
+        reinterpret_cast<const uint8_t*>(payload_.data()), payload_.size());
+  }
+
+ private:
+  std::string payload_;
+};
+
+// Deserializes the fields of the payload of an entry, in the order they were
+// added. Each read fails, leaving the field unchanged, when the rest of the
+// payload is too short for it.
+class RecordFileEntryParser {
+ public:
+  explicit RecordFileEntryParser(absl::Span<const uint8_t> payload)
+      : payload_(payload) {}
+
+  template <typename T>
+  bool Read(T* value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    if (payload_.size() < sizeof(T)) return false;
+    memcpy(value, payload_.data(), sizeof(T));
+    payload_.remove_prefix(sizeof(T));
+    return true;
+  }
+
+  // The bytes point into the payload.
+  bool ReadBytes(absl::Span<const uint8_t>* bytes);
+  bool ReadString(std::string* string);
+
+ private:
+  absl::Span<const uint8_t> payload_;
+};
+
+// Writes are serialized, so that the reader threads of the tracer can share
+// a writer: the entries of each thread keep their order.
+class RecordFileWriter {
+ public:
+  // Returns nullptr if the file can't be created.
+  static std::unique_ptr<RecordFileWriter> Create(const std::string& path);
+  ~RecordFileWriter();
+
+  RecordFileWriter(const RecordFileWriter&) = delete;
+  RecordFileWriter& operator=(const RecordFileWriter&) = delete;
+
+  // The payload is the concatenation of parts.
+  void Write(RecordFileEntryType type,
+             std::initializer_list<absl::Span<const uint8_t>> parts);
+  void Write(RecordFileEntryType type, const RecordFileEntryBuilder& entry) {
+    Write(type, {entry.GetPayload()});
+  }
+
+  uint64_t GetWrittenBytes() const;
+
+ private:
+  explicit RecordFileWriter(std::FILE* file) : file_(file) {}
+
+  static constexpr size_t BUFFER_SIZE = 1024 * 1024;
+
+  mutable std::mutex mutex_;
+  std::FILE* file_;
+  std::vector<char> buffer_ = std::vector<char>(BUFFER_SIZE);
+  uint64_t written_bytes_ = 0;
+};
+
+class RecordFileReader {
+ public:
+  // Returns nullptr if the file can't be opened or is not a record file of
+  // this version.
+  static std::unique_ptr<RecordFileReader> Open(const std::string& path);
+  ~RecordFileReader();
+
+  RecordFileReader(const RecordFileReader&) = delete;
+  RecordFileReader& operator=(const RecordFileReader&) = delete;
+
+  // Returns false at the end of the file, or if the last entry is truncated,
+  // e.g., because the recording tracer was killed. The payload is only valid
+  // until the next call.
+  bool ReadEntry(RecordFileEntryType* type,
+                 absl::Span<const uint8_t>* payload);
+
+ private:
+  explicit RecordFileReader(std::FILE* file) : file_(file) {}
+
+  std::FILE* file_;
+  std::vector<uint8_t> payload_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_PERF_EVENT_RECORD_FILE_H_
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include <linux/perf_event.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "PerfEventRecordFile.h"
+#include "PerfEventRingBuffer.h"
+
+namespace LinuxTracing {
+
+namespace {
+std::string TempFilePath(const std::string& name) {
+  return testing::TempDir() + "/" + name;
+}
+
+std::vector<uint8_t> MakeRecord(uint16_t size, uint8_t value) {
+  std::vector<uint8_t> record(size, value);
+  perf_event_header header{};
+  header.type = PERF_RECORD_SAMPLE;
+  header.size = size;
+  memcpy(record.data(), &header, sizeof(header));
+  return record;
+}
+}  // namespace
+
+TEST(PerfEventRecordFile, ReadsTheEntriesWritten) {
+  const std::string path = TempFilePath("entries.orbitperf");
+  const std::vector<uint8_t> record = MakeRecord(40, 7);
+  {
+    std::unique_ptr<RecordFileWriter> writer = RecordFileWriter::Create(path);
+    ASSERT_NE(writer, nullptr);
+    writer->Write(RecordFileEntryType::kRingBuffer,
+                  RecordFileEntryBuilder{}.Add(3).Add(int32_t{1}).AddString(
+                      "sampling_1"));
+    writer->Write(RecordFileEntryType::kRecord,
+                  RecordFileEntryBuilder{}.Add(3).AddBytes(record));
+    writer->Write(RecordFileEntryType::kThreads, RecordFileEntryBuilder{});
+  }
+
+  std::unique_ptr<RecordFileReader> reader = RecordFileReader::Open(path);
+  ASSERT_NE(reader, nullptr);
+  RecordFileEntryType type;
+  absl::Span<const uint8_t> payload;
+
+  ASSERT_TRUE(reader->ReadEntry(&type, &payload));
+  EXPECT_EQ(type, RecordFileEntryType::kRingBuffer);
+  RecordFileEntryParser ring_buffer_parser{payload};
+  int fd = 0;
+  int32_t cpu = 0;
+  std::string name;
+  EXPECT_TRUE(ring_buffer_parser.Read(&fd));
+  EXPECT_TRUE(ring_buffer_parser.Read(&cpu));
+  EXPECT_TRUE(ring_buffer_parser.ReadString(&name));
+  EXPECT_EQ(fd, 3);
+  EXPECT_EQ(cpu, 1);
+  EXPECT_EQ(name, "sampling_1");
+  // Nothing is left.
+  EXPECT_FALSE(ring_buffer_parser.Read(&fd));
+
+  ASSERT_TRUE(reader->ReadEntry(&type, &payload));
+  EXPECT_EQ(type, RecordFileEntryType::kRecord);
+  RecordFileEntryParser record_parser{payload};
+  absl::Span<const uint8_t> bytes;
+  EXPECT_TRUE(record_parser.Read(&fd));
+  EXPECT_TRUE(record_parser.ReadBytes(&bytes));
+  EXPECT_EQ(std::vector<uint8_t>(bytes.begin(), bytes.end()), record);
+
+  ASSERT_TRUE(reader->ReadEntry(&type, &payload));
+  EXPECT_EQ(type, RecordFileEntryType::kThreads);
+  EXPECT_TRUE(payload.empty());
+  EXPECT_FALSE(reader->ReadEntry(&type, &payload));
+  unlink(path.c_str());
+}
+
+TEST(PerfEventRecordFile, StopsAtATruncatedEntry) {
+  const std::string path = TempFilePath("truncated.orbitperf");
+  uint64_t complete_size;
+  {
+    std::unique_ptr<RecordFileWriter> writer = RecordFileWriter::Create(path);
+    ASSERT_NE(writer, nullptr);
+    writer->Write(RecordFileEntryType::kWatermark,
+                  RecordFileEntryBuilder{}.Add(3).Add(uint64_t{1000}));
+    complete_size = writer->GetWrittenBytes();
+    writer->Write(RecordFileEntryType::kWatermark,
+                  RecordFileEntryBuilder{}.Add(3).Add(uint64_t{2000}));
+  }
+  ASSERT_EQ(truncate(path.c_str(), complete_size + 10), 0);
+
+  std::unique_ptr<RecordFileReader> reader = RecordFileReader::Open(path);
+  ASSERT_NE(reader, nullptr);
+  RecordFileEntryType type;
+  absl::Span<const uint8_t> payload;
+  EXPECT_TRUE(reader->ReadEntry(&type, &payload));
+  EXPECT_FALSE(reader->ReadEntry(&type, &payload));
+  unlink(path.c_str());
+}
+
+TEST(PerfEventRecordFile, RejectsOtherFiles) {
+  const std::string path = TempFilePath("not_a_record_file");
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+  std::fputs("not a record file", file);
+  std::fclose(file);
+  EXPECT_EQ(RecordFileReader::Open(path), nullptr);
+  EXPECT_EQ(RecordFileReader::Open(TempFilePath("missing")), nullptr);
+  unlink(path.c_str());
+}
+
+TEST(PerfEventRecordFile, InMemoryRingBufferReadsTheRecordsWritten) {
+  PerfEventRingBuffer ring_buffer =
+      PerfEventRingBuffer::CreateInMemory(3, 4, "in_memory");
+  ASSERT_TRUE(ring_buffer.IsOpen());
+  EXPECT_EQ(ring_buffer.GetFileDescriptor(), 3);
+  EXPECT_FALSE(ring_buffer.HasNewData());
+
+  // Enough records of 1000 bytes to wrap around the 4 KB several times.
+  for (uint8_t value = 0; value < 20; ++value) {
+    std::vector<uint8_t> record = MakeRecord(1000, value);
+    ring_buffer.WriteRecord(record);
+    ASSERT_TRUE(ring_buffer.HasNewData());
+    perf_event_header header;
+    ring_buffer.ReadHeader(&header);
+    absl::Span<const uint8_t> view = ring_buffer.ReadRecordView(header);
+    EXPECT_EQ(std::vector<uint8_t>(view.begin(), view.end()), record);
+    ring_buffer.SkipRecord(header);
+    EXPECT_FALSE(ring_buffer.HasNewData());
+  }
+}
+
+}  // namespace LinuxTracing
@@ -61,10 +61,33 @@ struct __attribute__((__packed__)) perf_event_sample_regs_user_all {
   uint64_t r15;
 };
 
-struct __attribute__((__packed__)) perf_event_sample_stack_user {
-  uint64_t size;                     /* if PERF_SAMPLE_STACK_USER */
-  char data[SAMPLE_STACK_USER_SIZE]; /* if PERF_SAMPLE_STACK_USER */
-  uint64_t dyn_size; /* if PERF_SAMPLE_STACK_USER && size != 0 */
+// This struct must be in sync with the SAMPLE_REGS_USER_SP_IP in
+// PerfEventOpen.h.
+struct __attribute__((__packed__)) perf_event_sample_regs_user_sp_ip {
+  uint64_t abi;
+  uint64_t sp;
+  uint64_t ip;
+};
+
+// This struct must be in sync with the SAMPLE_REGS_USER_SP_IP_ARGUMENTS in
+// PerfEventOpen.h. The kernel writes registers in the order of their index in
+// enum perf_event_x86_regs.
+struct __attribute__((__packed__)) perf_event_sample_regs_user_sp_ip_arguments {
+  uint64_t abi;
+  uint64_t cx;
+  uint64_t dx;
+  uint64_t si;
+  uint64_t di;
+  uint64_t sp;
+  uint64_t ip;
+  uint64_t r8;
+  uint64_t r9;
+};
+
+// This struct must be in sync with the SAMPLE_REGS_USER_AX in PerfEventOpen.h.
+struct __attribute__((__packed__)) perf_event_sample_regs_user_ax {
+  uint64_t abi;
+  uint64_t ax;
 };
 
 struct __attribute__((__packed__)) perf_event_empty_sample {
@@ -72,11 +95,61 @@ struct __attribute__((__packed__)) perf_event_empty_sample {
   perf_event_sample_id_tid_time_streamid_cpu sample_id;
 };
 
-struct __attribute__((__packed__)) perf_event_stack_sample {
+// A PERF_RECORD_SAMPLE with PERF_SAMPLE_STACK_USER continues with
+// char data[stack_size] and, if stack_size is not 0, u64 dyn_size. stack_size
+// is the sample_stack_user the event was opened with, or less for the record
+// to fit in its maximum size, and can differ between the events of a ring
+// buffer (see StackDumpSizeTuner).
+struct __attribute__((__packed__)) perf_event_stack_sample_fixed {
   perf_event_header header;
   perf_event_sample_id_tid_time_streamid_cpu sample_id;
   perf_event_sample_regs_user_all regs;
-  perf_event_sample_stack_user stack;
+  uint64_t stack_size;
+};
+
+struct __attribute__((__packed__)) perf_event_sp_ip_sample {
+  perf_event_header header;
+  perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  perf_event_sample_regs_user_sp_ip regs;
+};
+
+struct __attribute__((__packed__)) perf_event_sp_ip_arguments_sample {
+  perf_event_header header;
+  perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  perf_event_sample_regs_user_sp_ip_arguments regs;
+};
+
+// When the sampled thread has no user-space registers, abi is
+// PERF_SAMPLE_REGS_ABI_NONE and the record ends after it.
+struct __attribute__((__packed__)) perf_event_ax_sample {
+  perf_event_header header;
+  perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  perf_event_sample_regs_user_ax regs;
+};
+
+// A PERF_RECORD_SAMPLE with PERF_SAMPLE_CALLCHAIN continues with u64 ips[nr].
+struct __attribute__((__packed__)) perf_event_callchain_sample_fixed {
+  perf_event_header header;
+  perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  uint64_t nr;
+};
+
+// A PERF_RECORD_SAMPLE with PERF_SAMPLE_BRANCH_STACK continues with
+// perf_branch_entry entries[nr], the most recent branch first.
+struct __attribute__((__packed__)) perf_event_branch_stack_sample_fixed {
+  perf_event_header header;
+  perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  uint64_t nr;
+};
+
+// A PERF_RECORD_SAMPLE with PERF_SAMPLE_READ and PERF_FORMAT_GROUP continues
+// with u64 values[nr], the values of all the events in the group, the leader
+// first and then the others in the order they were opened, followed by the
+// user registers, if sampled.
+struct __attribute__((__packed__)) perf_event_sample_read_group_fixed {
+  perf_event_header header;
+  perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  uint64_t nr;
 };
 
 struct __attribute__((__packed__)) perf_event_lost {
@@ -86,6 +159,23 @@ struct __attribute__((__packed__)) perf_event_lost {
   perf_event_sample_id_tid_time_streamid_cpu sample_id;
 };
 
+// PERF_RECORD_MMAP continues with a null-terminated, u64-aligned char
+// filename[], followed by the sample_id.
+struct __attribute__((__packed__)) perf_event_mmap_up_to_pgoff {
+  perf_event_header header;
+  uint32_t pid, tid;
+  uint64_t address;
+  uint64_t length;
+  uint64_t page_offset;
+};
+
+// PERF_RECORD_COMM continues with a null-terminated, u64-aligned char comm[],
+// followed by the sample_id.
+struct __attribute__((__packed__)) perf_event_comm_up_to_tid {
+  perf_event_header header;
+  uint32_t pid, tid;
+};
+
 struct __attribute__((__packed__)) perf_event_sample_raw {
   perf_event_header header;
   perf_event_sample_id_tid_time_streamid_cpu sample_id;
@@ -93,6 +183,49 @@ struct __attribute__((__packed__)) perf_event_sample_raw {
   // The rest of the sample is a char[size] that we read dynamically
 };
 
+// Formats of the raw data of the sched tracepoints, from
+// /sys/kernel/debug/tracing/events/sched/<name>/format.
+struct __attribute__((__packed__)) perf_event_sched_switch_tracepoint {
+  uint16_t common_type;
+  uint8_t common_flags;
+  uint8_t common_preempt_count;
+  int32_t common_pid;
+  char prev_comm[16];
+  int32_t prev_pid;
+  int32_t prev_prio;
+  int64_t prev_state;
+  char next_comm[16];
+  int32_t next_pid;
+  int32_t next_prio;
+};
+
+// Shared by sched_waking and sched_wakeup.
+struct __attribute__((__packed__)) perf_event_sched_wakeup_tracepoint {
+  uint16_t common_type;
+  uint8_t common_flags;
+  uint8_t common_preempt_count;
+  int32_t common_pid;
+  char comm[16];
+  int32_t pid;
+  int32_t prio;
+  int32_t success;
+  int32_t target_cpu;
+};
+
+struct __attribute__((__packed__)) perf_event_sched_switch_sample {
+  perf_event_header header;
+  perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  uint32_t size;
+  perf_event_sched_switch_tracepoint data;
+};
+
+struct __attribute__((__packed__)) perf_event_sched_wakeup_sample {
+  perf_event_header header;
+  perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  uint32_t size;
+  perf_event_sched_wakeup_tracepoint data;
+};
+
 }  // namespace LinuxTracing
 
 #endif  // ORBIT_LINUX_TRACING_PERF_EVENT_RECORDS_H_
@@ -5,6 +5,7 @@
 #include <linux/perf_event.h>
 #include <sys/mman.h>
 
+#include <algorithm>
 #include <utility>
 
 #include "PerfEventOpen.h"
@@ -39,23 +40,52 @@ PerfEventRingBuffer::PerfEventRingBuffer(int perf_event_fd, uint64_t size_kb,
 
   file_descriptor_ = perf_event_fd;
   name_ = name;
+  Mmap(size_kb);
+}
+
+PerfEventRingBuffer PerfEventRingBuffer::CreateInMemory(int file_descriptor,
+                                                        uint64_t size_kb,
+                                                        std::string name) {
+  PerfEventRingBuffer ring_buffer;
+  ring_buffer.file_descriptor_ = file_descriptor;
+  ring_buffer.in_memory_ = true;
+  ring_buffer.name_ = std::move(name);
+  ring_buffer.Mmap(size_kb);
+  return ring_buffer;
+}
 
+bool PerfEventRingBuffer::Mmap(uint64_t size_kb) {
   // The size of a perf_event_open ring buffer is required to be a power of two
   // memory pages (from perf_event_open's manpage: "The mmap size should be
   // 1+2^n pages"), otherwise mmap on the file descriptor fails.
   if (1024 * size_kb < getpagesize() || __builtin_popcountl(size_kb) != 1) {
-    return;
+    return false;
+  }
+
+  uint64_t mmap_length = getpagesize() + 1024 * size_kb;
+  void* mmap_address;
+  if (in_memory_) {
+    mmap_address = mmap(nullptr, mmap_length, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mmap_address == MAP_FAILED) {
+      ERROR("mmap: %s", SafeStrerror(errno));
+      return false;
+    }
+    // What the kernel fills in for a perf_event_open ring buffer.
+    auto* metadata_page = static_cast<perf_event_mmap_page*>(mmap_address);
+    metadata_page->data_offset = getpagesize();
+    metadata_page->data_size = 1024 * size_kb;
+  } else {
+    mmap_address =
+        perf_event_open_mmap_ring_buffer(file_descriptor_, mmap_length);
+    if (mmap_address == nullptr) {
+      return false;
+    }
   }
 
   ring_buffer_size_ = 1024 * size_kb;
   ring_buffer_size_log2_ = __builtin_ffsl(ring_buffer_size_) - 1;
-  mmap_length_ = getpagesize() + ring_buffer_size_;
-
-  void* mmap_address =
-      perf_event_open_mmap_ring_buffer(perf_event_fd, mmap_length_);
-  if (mmap_address == nullptr) {
-    return;
-  }
+  mmap_length_ = mmap_length;
 
   // The first page, just before the ring buffer, is the metadata page.
   metadata_page_ = reinterpret_cast<perf_event_mmap_page*>(mmap_address);
@@ -64,6 +94,34 @@ PerfEventRingBuffer::PerfEventRingBuffer(int perf_event_fd, uint64_t size_kb,
   ring_buffer_ =
       reinterpret_cast<char*>(mmap_address) + metadata_page_->data_offset;
   CHECK(metadata_page_->data_offset == getpagesize());
+  return true;
+}
+
+void PerfEventRingBuffer::Munmap() {
+  if (metadata_page_ != nullptr) {
+    int munmap_ret = munmap(metadata_page_, mmap_length_);
+    if (munmap_ret != 0) {
+      ERROR("munmap: %s", SafeStrerror(errno));
+    }
+  }
+  metadata_page_ = nullptr;
+  ring_buffer_ = nullptr;
+}
+
+bool PerfEventRingBuffer::Resize(uint64_t size_kb) {
+  DCHECK(IsOpen());
+  uint64_t previous_size_kb = GetSizeKb();
+  // Unmapping the only mapping detaches the kernel's buffer from the event,
+  // which allows to mmap a buffer of a different size.
+  Munmap();
+  if (Mmap(size_kb)) {
+    return true;
+  }
+  ERROR("Resizing ring buffer %s to %lu KB", name_.c_str(), size_kb);
+  if (!Mmap(previous_size_kb)) {
+    ERROR("Restoring ring buffer %s", name_.c_str());
+  }
+  return false;
 }
 
 PerfEventRingBuffer::PerfEventRingBuffer(PerfEventRingBuffer&& o) noexcept {
@@ -73,7 +131,9 @@ PerfEventRingBuffer::PerfEventRingBuffer(PerfEventRingBuffer&& o) noexcept {
   std::swap(ring_buffer_size_, o.ring_buffer_size_);
   std::swap(ring_buffer_size_log2_, o.ring_buffer_size_log2_);
   std::swap(file_descriptor_, o.file_descriptor_);
+  std::swap(in_memory_, o.in_memory_);
   std::swap(name_, o.name_);
+  std::swap(wrapped_record_buffer_, o.wrapped_record_buffer_);
 }
 
 PerfEventRingBuffer& PerfEventRingBuffer::operator=(
@@ -85,18 +145,26 @@ PerfEventRingBuffer& PerfEventRingBuffer::operator=(
     std::swap(ring_buffer_size_, o.ring_buffer_size_);
     std::swap(ring_buffer_size_log2_, o.ring_buffer_size_log2_);
     std::swap(file_descriptor_, o.file_descriptor_);
+    std::swap(in_memory_, o.in_memory_);
     std::swap(name_, o.name_);
+    std::swap(wrapped_record_buffer_, o.wrapped_record_buffer_);
   }
   return *this;
 }
 
-PerfEventRingBuffer::~PerfEventRingBuffer() {
-  if (metadata_page_ != nullptr) {
-    int munmap_ret = munmap(metadata_page_, mmap_length_);
-    if (munmap_ret != 0) {
-      ERROR("munmap: %s", SafeStrerror(errno));
-    }
-  }
+PerfEventRingBuffer::~PerfEventRingBuffer() { Munmap(); }
+
+void PerfEventRingBuffer::WriteRecord(absl::Span<const uint8_t> record) {
+  CHECK(in_memory_ && IsOpen());
+  uint64_t head = metadata_page_->data_head;
+  CHECK(head + record.size() <= metadata_page_->data_tail + ring_buffer_size_);
+  const uint64_t index_mod_size = head & (ring_buffer_size_ - 1);
+  const uint64_t first_part_size =
+      std::min<uint64_t>(record.size(), ring_buffer_size_ - index_mod_size);
+  memcpy(ring_buffer_ + index_mod_size, record.data(), first_part_size);
+  memcpy(ring_buffer_, record.data() + first_part_size,
+         record.size() - first_part_size);
+  metadata_page_->data_head = head + record.size();
 }
 
 bool PerfEventRingBuffer::HasNewData() {
@@ -126,6 +194,27 @@ void PerfEventRingBuffer::ConsumeRecord(const perf_event_header& header,
   SkipRecord(header);
 }
 
+absl::Span<const uint8_t> PerfEventRingBuffer::ReadRecordView(
+    const perf_event_header& header) {
+  DCHECK(IsOpen());
+  DCHECK(metadata_page_->data_tail + header.size <=
+         ReadRingBufferHead(metadata_page_));
+
+  const uint64_t index_mod_size =
+      metadata_page_->data_tail & (ring_buffer_size_ - 1);
+  if (index_mod_size + header.size <= ring_buffer_size_) {
+    // The record is contiguous in memory: no copy needed.
+    return absl::MakeConstSpan(
+        reinterpret_cast<const uint8_t*>(ring_buffer_) + index_mod_size,
+        header.size);
+  }
+
+  // The record wraps around the end of the ring buffer.
+  wrapped_record_buffer_.resize(header.size);
+  ReadAtTail(wrapped_record_buffer_.data(), header.size);
+  return absl::MakeConstSpan(wrapped_record_buffer_);
+}
+
 void PerfEventRingBuffer::ReadAtOffsetFromTail(uint8_t* dest,
                                                uint64_t offset_from_tail,
                                                uint64_t count) {
@@ -4,8 +4,10 @@
 #include <linux/perf_event.h>
 
 #include <string>
+#include <vector>
 
 #include "PerfEventOpen.h"
+#include "absl/types/span.h"
 
 namespace LinuxTracing {
 
@@ -15,6 +17,14 @@ class PerfEventRingBuffer {
                                std::string name);
   ~PerfEventRingBuffer();
 
+  // Creates a ring buffer in anonymous memory, filled with WriteRecord instead
+  // of by the kernel, to replay recorded records through the code that reads
+  // them live (see TracerThread::Replay). file_descriptor only identifies the
+  // ring buffer, as the one the records were recorded from, and is never used.
+  static PerfEventRingBuffer CreateInMemory(int file_descriptor,
+                                            uint64_t size_kb,
+                                            std::string name);
+
   PerfEventRingBuffer(PerfEventRingBuffer&&) noexcept;
   PerfEventRingBuffer& operator=(PerfEventRingBuffer&&) noexcept;
 
@@ -24,12 +34,36 @@ class PerfEventRingBuffer {
   bool IsOpen() const { return ring_buffer_ != nullptr; }
   int GetFileDescriptor() const { return file_descriptor_; }
   const std::string& GetName() const { return name_; }
+  uint64_t GetSizeKb() const { return ring_buffer_size_ / 1024; }
+
+  // Replaces the ring buffer with a new one of size_kb, mmap'd from the same
+  // file descriptor, so that the events keep being recorded without being
+  // reopened. Records not read yet, and records generated while the ring
+  // buffer is being replaced, are lost without a PERF_RECORD_LOST, and the
+  // events redirected to this ring buffer (perf_event_redirect) are detached
+  // from it and must be redirected again. On failure, the previous size is
+  // restored if possible, otherwise the ring buffer is no longer open.
+  bool Resize(uint64_t size_kb);
+
+  // Appends a record at the head of a ring buffer created with
+  // CreateInMemory. The record must fit before the tail. Not synchronized with
+  // reads, which must happen on the same thread.
+  void WriteRecord(absl::Span<const uint8_t> record);
 
   bool HasNewData();
   void ReadHeader(perf_event_header* header);
   void SkipRecord(const perf_event_header& header);
   void ConsumeRecord(const perf_event_header& header, void* record);
 
+  // Returns a view over the entire record (header included) at the tail of the
+  // ring buffer, without advancing the tail. The view points directly into the
+  // mmap'd ring buffer, unless the record wraps around the end of the buffer,
+  // in which case (and only then) the record is copied into an internal buffer.
+  // The view is only valid until the next call to any read, skip or consume
+  // method: call SkipRecord once done decoding, so that the kernel doesn't
+  // overwrite the data while it is still being read.
+  absl::Span<const uint8_t> ReadRecordView(const perf_event_header& header);
+
   template <typename T>
   void ReadValueAtOffset(T* value, uint64_t offset) {
     ReadAtOffsetFromTail(reinterpret_cast<uint8_t*>(value), offset, sizeof(T));
@@ -44,6 +78,8 @@ class PerfEventRingBuffer {
   }
 
  private:
+  PerfEventRingBuffer() = default;
+
   uint64_t mmap_length_ = 0;
   perf_event_mmap_page* metadata_page_ = nullptr;
   char* ring_buffer_ = nullptr;
@@ -52,7 +88,13 @@ class PerfEventRingBuffer {
   // division.
   uint32_t ring_buffer_size_log2_ = 0;
   int file_descriptor_ = -1;
+  bool in_memory_ = false;
   std::string name_;
+  // Only used for records that wrap around the end of the ring buffer.
+  std::vector<uint8_t> wrapped_record_buffer_;
+
+  bool Mmap(uint64_t size_kb);
+  void Munmap();
 
   void ReadAtTail(uint8_t* dest, uint64_t count) {
     return ReadAtOffsetFromTail(dest, 0, count);
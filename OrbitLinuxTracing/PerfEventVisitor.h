@@ -14,12 +14,106 @@ class PerfEventVisitor {
   virtual void visit(ContextSwitchPerfEvent*) {}
   virtual void visit(SystemWideContextSwitchPerfEvent*) {}
   virtual void visit(StackSamplePerfEvent*) {}
+  virtual void visit(OffCpuStackSamplePerfEvent*) {}
+  virtual void visit(SchedSwitchInPerfEvent*) {}
+  virtual void visit(GpuSubmissionStackSamplePerfEvent*) {}
+  virtual void visit(PageFaultStackSamplePerfEvent*) {}
+  virtual void visit(HeapAllocationStackSamplePerfEvent*) {}
+  virtual void visit(LockWaitStackSamplePerfEvent*) {}
   virtual void visit(UprobesWithStackPerfEvent*) {}
+  virtual void visit(UprobesPerfEvent*) {}
   virtual void visit(UretprobesPerfEvent*) {}
   virtual void visit(LostPerfEvent*) {}
   virtual void visit(MapsPerfEvent*) {}
+  virtual void visit(MmapPerfEvent*) {}
+  virtual void visit(CommPerfEvent*) {}
+  virtual void visit(CallchainSamplePerfEvent*) {}
+  virtual void visit(ThreadStatePerfEvent*) {}
+  virtual void visit(PmuCounterSwitchPerfEvent*) {}
+  virtual void visit(HeapAllocationPerfEvent*) {}
+  virtual void visit(HeapFreePerfEvent*) {}
+  virtual void visit(LockWaitPerfEvent*) {}
 };
 
+// Calls the visit method of visitor for the concrete type of event, with a
+// switch on PerfEvent::GetType rather than a virtual call to Accept first.
+inline void VisitPerfEvent(PerfEvent* event, PerfEventVisitor* visitor) {
+  switch (event->GetType()) {
+    case PerfEventType::kFork:
+      visitor->visit(static_cast<ForkPerfEvent*>(event));
+      return;
+    case PerfEventType::kExit:
+      visitor->visit(static_cast<ExitPerfEvent*>(event));
+      return;
+    case PerfEventType::kContextSwitch:
+      visitor->visit(static_cast<ContextSwitchPerfEvent*>(event));
+      return;
+    case PerfEventType::kSystemWideContextSwitch:
+      visitor->visit(static_cast<SystemWideContextSwitchPerfEvent*>(event));
+      return;
+    case PerfEventType::kStackSample:
+      visitor->visit(static_cast<StackSamplePerfEvent*>(event));
+      return;
+    case PerfEventType::kOffCpuStackSample:
+      visitor->visit(static_cast<OffCpuStackSamplePerfEvent*>(event));
+      return;
+    case PerfEventType::kSchedSwitchIn:
+      visitor->visit(static_cast<SchedSwitchInPerfEvent*>(event));
+      return;
+    case PerfEventType::kGpuSubmissionStackSample:
+      visitor->visit(static_cast<GpuSubmissionStackSamplePerfEvent*>(event));
+      return;
+    case PerfEventType::kPageFaultStackSample:
+      visitor->visit(static_cast<PageFaultStackSamplePerfEvent*>(event));
+      return;
+    case PerfEventType::kHeapAllocationStackSample:
+      visitor->visit(static_cast<HeapAllocationStackSamplePerfEvent*>(event));
+      return;
+    case PerfEventType::kLockWaitStackSample:
+      visitor->visit(static_cast<LockWaitStackSamplePerfEvent*>(event));
+      return;
+    case PerfEventType::kUprobesWithStack:
+      visitor->visit(static_cast<UprobesWithStackPerfEvent*>(event));
+      return;
+    case PerfEventType::kUprobes:
+      visitor->visit(static_cast<UprobesPerfEvent*>(event));
+      return;
+    case PerfEventType::kUretprobes:
+      visitor->visit(static_cast<UretprobesPerfEvent*>(event));
+      return;
+    case PerfEventType::kLost:
+      visitor->visit(static_cast<LostPerfEvent*>(event));
+      return;
+    case PerfEventType::kMaps:
+      visitor->visit(static_cast<MapsPerfEvent*>(event));
+      return;
+    case PerfEventType::kMmap:
+      visitor->visit(static_cast<MmapPerfEvent*>(event));
+      return;
+    case PerfEventType::kComm:
+      visitor->visit(static_cast<CommPerfEvent*>(event));
+      return;
+    case PerfEventType::kCallchainSample:
+      visitor->visit(static_cast<CallchainSamplePerfEvent*>(event));
+      return;
+    case PerfEventType::kThreadState:
+      visitor->visit(static_cast<ThreadStatePerfEvent*>(event));
+      return;
+    case PerfEventType::kPmuCounterSwitch:
+      visitor->visit(static_cast<PmuCounterSwitchPerfEvent*>(event));
+      return;
+    case PerfEventType::kHeapAllocation:
+      visitor->visit(static_cast<HeapAllocationPerfEvent*>(event));
+      return;
+    case PerfEventType::kHeapFree:
+      visitor->visit(static_cast<HeapFreePerfEvent*>(event));
+      return;
+    case PerfEventType::kLockWait:
+      visitor->visit(static_cast<LockWaitPerfEvent*>(event));
+      return;
+  }
+}
+
 }  // namespace LinuxTracing
 
 #endif  // ORBIT_LINUX_TRACING_PERF_EVENT_VISITOR_H_
@@ -0,0 +1,58 @@
+#ifndef ORBIT_LINUX_TRACING_PMU_COUNTER_ACCUMULATOR_H_
+#define ORBIT_LINUX_TRACING_PMU_COUNTER_ACCUMULATOR_H_
+
+#include <OrbitLinuxTracing/Events.h>
+
+#include "absl/container/flat_hash_map.h"
+
+namespace LinuxTracing {
+
+// The PMU counters are opened per cpu, and count whatever runs on it. This
+// turns their values, read when threads are switched out and when probes
+// fire, into counters of each thread, which only advance while the thread
+// runs, on whichever cpu. The difference of the counters of a thread between
+// two of its probes is then exact even if the thread was preempted or migrated
+// in between. Events must be passed in the order they happened.
+// Only the threads whose counters were read with GetThreadCounters are
+// tracked.
+class PmuCounterAccumulator {
+ public:
+  // prev_tid was switched out of cpu, whose counters had pmu_counters.
+  void OnSwitch(pid_t prev_tid, uint32_t cpu,
+                const PmuCounterValues& pmu_counters) {
+    PmuCounterValues& last_switch_counters = last_switch_counters_per_cpu_[cpu];
+    auto thread_it = counters_per_thread_.find(prev_tid);
+    if (thread_it != counters_per_thread_.end()) {
+      for (size_t i = 0; i < kNumPmuCounters; ++i) {
+        thread_it->second[i] += pmu_counters[i] - last_switch_counters[i];
+      }
+    }
+    last_switch_counters = pmu_counters;
+  }
+
+  // The counters of tid, running on cpu, whose counters have pmu_counters.
+  // They start from an arbitrary value: only their differences are
+  // meaningful.
+  PmuCounterValues GetThreadCounters(pid_t tid, uint32_t cpu,
+                                     const PmuCounterValues& pmu_counters) {
+    // Until the first switch on the cpu, counters are taken from zero.
+    const PmuCounterValues& last_switch_counters =
+        last_switch_counters_per_cpu_[cpu];
+    PmuCounterValues thread_counters = counters_per_thread_[tid];
+    for (size_t i = 0; i < kNumPmuCounters; ++i) {
+      thread_counters[i] += pmu_counters[i] - last_switch_counters[i];
+    }
+    return thread_counters;
+  }
+
+  void ForgetThread(pid_t tid) { counters_per_thread_.erase(tid); }
+
+ private:
+  absl::flat_hash_map<uint32_t, PmuCounterValues> last_switch_counters_per_cpu_;
+  // The counts of each thread until the last time it was switched out.
+  absl::flat_hash_map<pid_t, PmuCounterValues> counters_per_thread_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_PMU_COUNTER_ACCUMULATOR_H_
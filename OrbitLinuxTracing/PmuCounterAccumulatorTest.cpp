@@ -0,0 +1,70 @@
+#include <gmock/gmock-matchers.h>
+#include <gtest/gtest.h>
+
+#include "PmuCounterAccumulator.h"
+
+namespace LinuxTracing {
+
+namespace {
+PmuCounterValues Cycles(uint64_t cycles) { return {cycles, 0, 0, 0}; }
+}  // namespace
+
+TEST(PmuCounterAccumulator, CountsWhileRunningOnTheSameCpu) {
+  PmuCounterAccumulator accumulator;
+  accumulator.OnSwitch(10, 0, Cycles(1000));
+
+  PmuCounterValues begin = accumulator.GetThreadCounters(42, 0, Cycles(1100));
+  PmuCounterValues end = accumulator.GetThreadCounters(42, 0, Cycles(1500));
+  EXPECT_EQ(end[0] - begin[0], 400);
+}
+
+TEST(PmuCounterAccumulator, ExcludesOtherThreadsWhileSwitchedOut) {
+  PmuCounterAccumulator accumulator;
+  accumulator.OnSwitch(10, 0, Cycles(1000));
+
+  PmuCounterValues begin = accumulator.GetThreadCounters(42, 0, Cycles(1100));
+  accumulator.OnSwitch(42, 0, Cycles(1300));
+  // Thread 10 runs from 1300 to 2000.
+  accumulator.OnSwitch(10, 0, Cycles(2000));
+  PmuCounterValues end = accumulator.GetThreadCounters(42, 0, Cycles(2100));
+  EXPECT_EQ(end[0] - begin[0], 300);
+}
+
+TEST(PmuCounterAccumulator, FollowsMigratedThreads) {
+  PmuCounterAccumulator accumulator;
+  accumulator.OnSwitch(10, 0, Cycles(1000));
+  accumulator.OnSwitch(20, 1, Cycles(50'000));
+
+  PmuCounterValues begin = accumulator.GetThreadCounters(42, 0, Cycles(1100));
+  accumulator.OnSwitch(42, 0, Cycles(1300));
+  accumulator.OnSwitch(30, 1, Cycles(51'000));
+  PmuCounterValues end = accumulator.GetThreadCounters(42, 1, Cycles(51'400));
+  EXPECT_EQ(end[0] - begin[0], 200 + 400);
+}
+
+TEST(PmuCounterAccumulator, CountsFromTheFirstReadWithoutSwitches) {
+  PmuCounterAccumulator accumulator;
+  PmuCounterValues begin =
+      accumulator.GetThreadCounters(42, 0, {100, 200, 3, 4});
+  accumulator.OnSwitch(42, 0, {150, 300, 5, 4});
+  accumulator.OnSwitch(10, 1, {1000, 1000, 1000, 1000});
+  PmuCounterValues end =
+      accumulator.GetThreadCounters(42, 1, {1010, 1020, 1000, 1001});
+
+  PmuCounterValues deltas;
+  for (size_t i = 0; i < kNumPmuCounters; ++i) {
+    deltas[i] = end[i] - begin[i];
+  }
+  EXPECT_THAT(deltas, testing::ElementsAre(60, 120, 2, 1));
+}
+
+TEST(PmuCounterAccumulator, ForgetThread) {
+  PmuCounterAccumulator accumulator;
+  accumulator.GetThreadCounters(42, 0, Cycles(100));
+  accumulator.OnSwitch(42, 0, Cycles(500));
+  accumulator.ForgetThread(42);
+  accumulator.OnSwitch(10, 0, Cycles(800));
+  EXPECT_EQ(accumulator.GetThreadCounters(42, 0, Cycles(900))[0], 100);
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,73 @@
+#include "PrewarmedRingBuffers.h"
+
+#include <unistd.h>
+
+#include "Utils.h"
+
+namespace LinuxTracing {
+
+namespace {
+
+void Close(PerfEventRingBuffer ring_buffer) {
+  int fd = ring_buffer.GetFileDescriptor();
+  // Unmaps the ring buffer before its file descriptor is closed.
+  { PerfEventRingBuffer unmapped = std::move(ring_buffer); }
+  close(fd);
+}
+
+}  // namespace
+
+PrewarmedRingBuffers& PrewarmedRingBuffers::Get() {
+  // Never destroyed, as Expire can be called from a detached thread.
+  static auto* prewarmed_ring_buffers = new PrewarmedRingBuffers();
+  return *prewarmed_ring_buffers;
+}
+
+uint64_t PrewarmedRingBuffers::Put(
+    std::vector<std::pair<Key, PerfEventRingBuffer>> ring_buffers) {
+  absl::MutexLock lock(&mutex_);
+  ClearLocked();
+  for (auto& [key, ring_buffer] : ring_buffers) {
+    if (!ring_buffers_.try_emplace(key, std::move(ring_buffer)).second) {
+      Close(std::move(ring_buffer));
+    }
+  }
+  prewarm_timestamp_ns_ = MonotonicTimestampNs();
+  return ++prewarm_id_;
+}
+
+std::optional<PerfEventRingBuffer> PrewarmedRingBuffers::Take(const Key& key) {
+  absl::MutexLock lock(&mutex_);
+  if (MonotonicTimestampNs() > prewarm_timestamp_ns_ + MAX_AGE_NS) {
+    ClearLocked();
+    return std::nullopt;
+  }
+  auto it = ring_buffers_.find(key);
+  if (it == ring_buffers_.end()) {
+    return std::nullopt;
+  }
+  std::optional<PerfEventRingBuffer> ring_buffer = std::move(it->second);
+  ring_buffers_.erase(it);
+  return ring_buffer;
+}
+
+void PrewarmedRingBuffers::Expire(uint64_t prewarm_id) {
+  absl::MutexLock lock(&mutex_);
+  if (prewarm_id == prewarm_id_) {
+    ClearLocked();
+  }
+}
+
+void PrewarmedRingBuffers::Clear() {
+  absl::MutexLock lock(&mutex_);
+  ClearLocked();
+}
+
+void PrewarmedRingBuffers::ClearLocked() {
+  for (auto& [key, ring_buffer] : ring_buffers_) {
+    Close(std::move(ring_buffer));
+  }
+  ring_buffers_.clear();
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,76 @@
+#ifndef ORBIT_LINUX_TRACING_PREWARMED_RING_BUFFERS_H_
+#define ORBIT_LINUX_TRACING_PREWARMED_RING_BUFFERS_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "PerfEventRingBuffer.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
+namespace LinuxTracing {
+
+// Per-core perf_event_open file descriptors and their ring buffers, opened
+// and mmap'd while disabled, ahead of a capture (see Tracer::Prewarm), e.g.
+// while the user is still selecting the functions to instrument.
+// TracerThread::Run takes the ones matching what it would open instead of
+// opening them at the start of the capture.
+//
+// A prewarm replaces the previous one, and what is not taken is closed after
+// MAX_AGE_NS, as the ring buffers hold a lot of memory.
+class PrewarmedRingBuffers {
+ public:
+  static constexpr uint64_t MAX_AGE_NS = 60'000'000'000;
+
+  struct Key {
+    // E.g., "sampling", see TracerThread::PerCpuEvent.
+    std::string event;
+    int32_t cpu;
+    uint64_t size_kb;
+    // Only for the sampling events.
+    uint64_t sampling_period_ns;
+
+    bool operator==(const Key& other) const {
+      return event == other.event && cpu == other.cpu &&
+             size_kb == other.size_kb &&
+             sampling_period_ns == other.sampling_period_ns;
+    }
+    template <typename H>
+    friend H AbslHashValue(H h, const Key& key) {
+      return H::combine(std::move(h), key.event, key.cpu, key.size_kb,
+                        key.sampling_period_ns);
+    }
+  };
+
+  static PrewarmedRingBuffers& Get();
+
+  PrewarmedRingBuffers() = default;
+  ~PrewarmedRingBuffers() { Clear(); }
+  PrewarmedRingBuffers(const PrewarmedRingBuffers&) = delete;
+  PrewarmedRingBuffers& operator=(const PrewarmedRingBuffers&) = delete;
+
+  // Replaces what was prewarmed, closing it, and returns the id of this
+  // prewarm for Expire.
+  uint64_t Put(std::vector<std::pair<Key, PerfEventRingBuffer>> ring_buffers);
+  // The ring buffer prewarmed for key, still disabled, if any.
+  std::optional<PerfEventRingBuffer> Take(const Key& key);
+  // Closes what prewarm_id put, if it was not replaced yet.
+  void Expire(uint64_t prewarm_id);
+  void Clear();
+
+ private:
+  void ClearLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  absl::Mutex mutex_;
+  absl::flat_hash_map<Key, PerfEventRingBuffer> ring_buffers_
+      ABSL_GUARDED_BY(mutex_);
+  uint64_t prewarm_id_ ABSL_GUARDED_BY(mutex_) = 0;
+  uint64_t prewarm_timestamp_ns_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_PREWARMED_RING_BUFFERS_H_
@@ -0,0 +1,71 @@
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include "PrewarmedRingBuffers.h"
+
+namespace LinuxTracing {
+
+namespace {
+// The file descriptors are only closed, so any will do.
+int OpenFileDescriptor() { return dup(STDIN_FILENO); }
+
+bool IsClosed(int fd) { return fcntl(fd, F_GETFD) == -1; }
+
+std::pair<PrewarmedRingBuffers::Key, PerfEventRingBuffer> MakeRingBuffer(
+    const std::string& event, int32_t cpu, int fd) {
+  return {PrewarmedRingBuffers::Key{event, cpu, 4, 0},
+          PerfEventRingBuffer::CreateInMemory(fd, 4, event)};
+}
+}  // namespace
+
+TEST(PrewarmedRingBuffers, TakesTheRingBufferOfAKeyOnce) {
+  PrewarmedRingBuffers prewarmed;
+  int fd = OpenFileDescriptor();
+  std::vector<std::pair<PrewarmedRingBuffers::Key, PerfEventRingBuffer>>
+      ring_buffers;
+  ring_buffers.push_back(MakeRingBuffer("mmap_task", 0, fd));
+  prewarmed.Put(std::move(ring_buffers));
+
+  // Another size, or another core.
+  EXPECT_FALSE(prewarmed.Take({"mmap_task", 0, 8, 0}).has_value());
+  EXPECT_FALSE(prewarmed.Take({"mmap_task", 1, 4, 0}).has_value());
+
+  std::optional<PerfEventRingBuffer> ring_buffer =
+      prewarmed.Take({"mmap_task", 0, 4, 0});
+  ASSERT_TRUE(ring_buffer.has_value());
+  EXPECT_TRUE(ring_buffer->IsOpen());
+  EXPECT_EQ(ring_buffer->GetFileDescriptor(), fd);
+  EXPECT_FALSE(prewarmed.Take({"mmap_task", 0, 4, 0}).has_value());
+
+  // Taken, the file descriptor is left open.
+  prewarmed.Clear();
+  EXPECT_FALSE(IsClosed(fd));
+  close(fd);
+}
+
+TEST(PrewarmedRingBuffers, ClosesWhatIsReplacedOrExpired) {
+  PrewarmedRingBuffers prewarmed;
+  int first_fd = OpenFileDescriptor();
+  std::vector<std::pair<PrewarmedRingBuffers::Key, PerfEventRingBuffer>>
+      ring_buffers;
+  ring_buffers.push_back(MakeRingBuffer("sampling", 0, first_fd));
+  uint64_t first_id = prewarmed.Put(std::move(ring_buffers));
+  EXPECT_FALSE(IsClosed(first_fd));
+
+  int second_fd = OpenFileDescriptor();
+  ring_buffers.clear();
+  ring_buffers.push_back(MakeRingBuffer("sampling", 1, second_fd));
+  uint64_t second_id = prewarmed.Put(std::move(ring_buffers));
+  EXPECT_TRUE(IsClosed(first_fd));
+  EXPECT_FALSE(prewarmed.Take({"sampling", 0, 4, 0}).has_value());
+
+  // The expiration of a replaced prewarm doesn't close the next one.
+  prewarmed.Expire(first_id);
+  EXPECT_FALSE(IsClosed(second_fd));
+  prewarmed.Expire(second_id);
+  EXPECT_TRUE(IsClosed(second_fd));
+  EXPECT_FALSE(prewarmed.Take({"sampling", 1, 4, 0}).has_value());
+}
+
+}  // namespace LinuxTracing
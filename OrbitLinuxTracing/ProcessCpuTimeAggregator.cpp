@@ -0,0 +1,70 @@
+#include "ProcessCpuTimeAggregator.h"
+
+#include <algorithm>
+
+namespace LinuxTracing {
+
+void ProcessCpuTimeAggregator::OnSwitchIn(pid_t pid, uint16_t core,
+                                          uint64_t timestamp_ns) {
+  running_per_core_[core] = RunningThread{pid, timestamp_ns};
+}
+
+void ProcessCpuTimeAggregator::OnSwitchOut(pid_t pid, uint16_t core,
+                                           uint64_t timestamp_ns) {
+  auto it = running_per_core_.find(core);
+  if (it == running_per_core_.end()) {
+    return;
+  }
+  RunningThread running = it->second;
+  running_per_core_.erase(it);
+  // Otherwise the switch in of this thread was lost.
+  if (running.pid == pid && running.begin_ns < timestamp_ns) {
+    AddCpuTime(pid, running.begin_ns, timestamp_ns);
+  }
+}
+
+std::vector<ProcessCpuTimes> ProcessCpuTimeAggregator::TakeBucketsEndingBefore(
+    uint64_t timestamp_ns) {
+  const uint64_t end_bucket = timestamp_ns / bucket_duration_ns_;
+  if (end_bucket <= first_open_bucket_) {
+    return {};
+  }
+  const uint64_t end_ns = end_bucket * bucket_duration_ns_;
+  // Threads that run for long without being switched out still count.
+  for (auto& [core, running] : running_per_core_) {
+    if (running.begin_ns < end_ns) {
+      AddCpuTime(running.pid, running.begin_ns, end_ns);
+      running.begin_ns = end_ns;
+    }
+  }
+
+  std::vector<ProcessCpuTimes> taken;
+  auto end_it = buckets_.lower_bound(end_bucket);
+  for (auto it = buckets_.begin(); it != end_it; ++it) {
+    ProcessCpuTimes& process_cpu_times =
+        taken.emplace_back(it->first * bucket_duration_ns_,
+                           (it->first + 1) * bucket_duration_ns_);
+    for (const auto& [pid, cpu_time_ns] : it->second) {
+      process_cpu_times.AddProcess(pid, cpu_time_ns);
+    }
+  }
+  buckets_.erase(buckets_.begin(), end_it);
+  first_open_bucket_ = end_bucket;
+  return taken;
+}
+
+void ProcessCpuTimeAggregator::AddCpuTime(pid_t pid, uint64_t begin_ns,
+                                          uint64_t end_ns) {
+  uint64_t bucket = begin_ns / bucket_duration_ns_;
+  while (begin_ns < end_ns) {
+    uint64_t piece_end_ns =
+        std::min(end_ns, (bucket + 1) * bucket_duration_ns_);
+    if (bucket >= first_open_bucket_) {
+      buckets_[bucket][pid] += piece_end_ns - begin_ns;
+    }
+    begin_ns = piece_end_ns;
+    ++bucket;
+  }
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,52 @@
+#ifndef ORBIT_LINUX_TRACING_PROCESS_CPU_TIME_AGGREGATOR_H_
+#define ORBIT_LINUX_TRACING_PROCESS_CPU_TIME_AGGREGATOR_H_
+
+#include <OrbitLinuxTracing/Events.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+
+namespace LinuxTracing {
+
+// Sums the time that the threads of each process spend on the cores, computed
+// from their context switches, into consecutive buckets of fixed duration.
+// This summarizes the scheduling of all the processes of the system at the
+// cost of a few map operations per context switch. The context switches of
+// each core must be added in the order they happened.
+class ProcessCpuTimeAggregator {
+ public:
+  explicit ProcessCpuTimeAggregator(uint64_t bucket_duration_ns)
+      : bucket_duration_ns_(bucket_duration_ns) {}
+
+  void OnSwitchIn(pid_t pid, uint16_t core, uint64_t timestamp_ns);
+  void OnSwitchOut(pid_t pid, uint16_t core, uint64_t timestamp_ns);
+
+  // Returns, in time order, the buckets that end at or before timestamp_ns,
+  // counting the threads still running on the cores up to there. These buckets
+  // are then closed: time later added to them, from late context switches, is
+  // dropped. Buckets without any time are not returned.
+  std::vector<ProcessCpuTimes> TakeBucketsEndingBefore(uint64_t timestamp_ns);
+
+ private:
+  void AddCpuTime(pid_t pid, uint64_t begin_ns, uint64_t end_ns);
+
+  struct RunningThread {
+    pid_t pid;
+    // Switch in, or end of the last bucket taken if later.
+    uint64_t begin_ns;
+  };
+
+  uint64_t bucket_duration_ns_;
+  absl::flat_hash_map<uint16_t, RunningThread> running_per_core_;
+  // Keyed by the index of the bucket, i.e., its begin / bucket_duration_ns_.
+  std::map<uint64_t, absl::flat_hash_map<pid_t, uint64_t>> buckets_;
+  uint64_t first_open_bucket_ = 0;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_PROCESS_CPU_TIME_AGGREGATOR_H_
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include "ProcessCpuTimeAggregator.h"
+
+namespace LinuxTracing {
+
+namespace {
+std::vector<std::pair<pid_t, uint64_t>> SortedCpuTimes(
+    const ProcessCpuTimes& process_cpu_times) {
+  std::vector<std::pair<pid_t, uint64_t>> cpu_times_ns =
+      process_cpu_times.GetCpuTimesNs();
+  std::sort(cpu_times_ns.begin(), cpu_times_ns.end());
+  return cpu_times_ns;
+}
+}  // namespace
+
+TEST(ProcessCpuTimeAggregator, SumsThreadsAndCoresOfEachProcess) {
+  ProcessCpuTimeAggregator aggregator{1000};
+  aggregator.OnSwitchIn(10, 0, 100);
+  aggregator.OnSwitchIn(10, 1, 200);
+  aggregator.OnSwitchOut(10, 0, 300);
+  aggregator.OnSwitchIn(20, 0, 300);
+  aggregator.OnSwitchOut(10, 1, 500);
+  aggregator.OnSwitchOut(20, 0, 350);
+
+  std::vector<ProcessCpuTimes> buckets =
+      aggregator.TakeBucketsEndingBefore(1000);
+  ASSERT_EQ(buckets.size(), 1);
+  EXPECT_EQ(buckets[0].GetBeginTimestampNs(), 0);
+  EXPECT_EQ(buckets[0].GetEndTimestampNs(), 1000);
+  std::vector<std::pair<pid_t, uint64_t>> expected{{10, 500}, {20, 50}};
+  EXPECT_EQ(SortedCpuTimes(buckets[0]), expected);
+}
+
+TEST(ProcessCpuTimeAggregator, SplitsTimeAmongBuckets) {
+  ProcessCpuTimeAggregator aggregator{1000};
+  aggregator.OnSwitchIn(10, 0, 800);
+  aggregator.OnSwitchOut(10, 0, 3100);
+
+  std::vector<ProcessCpuTimes> buckets =
+      aggregator.TakeBucketsEndingBefore(3999);
+  ASSERT_EQ(buckets.size(), 3);
+  std::vector<uint64_t> expected_cpu_times_ns{200, 1000, 1000};
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    EXPECT_EQ(buckets[i].GetBeginTimestampNs(), i * 1000);
+    ASSERT_EQ(buckets[i].GetCpuTimesNs().size(), 1);
+    EXPECT_EQ(buckets[i].GetCpuTimesNs()[0].first, 10);
+    EXPECT_EQ(buckets[i].GetCpuTimesNs()[0].second, expected_cpu_times_ns[i]);
+  }
+
+  buckets = aggregator.TakeBucketsEndingBefore(4000);
+  ASSERT_EQ(buckets.size(), 1);
+  EXPECT_EQ(buckets[0].GetBeginTimestampNs(), 3000);
+  EXPECT_EQ(buckets[0].GetCpuTimesNs()[0].second, 100);
+}
+
+TEST(ProcessCpuTimeAggregator, CountsThreadsStillRunning) {
+  ProcessCpuTimeAggregator aggregator{1000};
+  aggregator.OnSwitchIn(10, 0, 500);
+
+  std::vector<ProcessCpuTimes> buckets =
+      aggregator.TakeBucketsEndingBefore(2000);
+  ASSERT_EQ(buckets.size(), 2);
+  EXPECT_EQ(buckets[0].GetCpuTimesNs()[0].second, 500);
+  EXPECT_EQ(buckets[1].GetCpuTimesNs()[0].second, 1000);
+
+  aggregator.OnSwitchOut(10, 0, 2300);
+  buckets = aggregator.TakeBucketsEndingBefore(3000);
+  ASSERT_EQ(buckets.size(), 1);
+  EXPECT_EQ(buckets[0].GetBeginTimestampNs(), 2000);
+  EXPECT_EQ(buckets[0].GetCpuTimesNs()[0].second, 300);
+}
+
+TEST(ProcessCpuTimeAggregator, DropsTimeOfTakenBuckets) {
+  ProcessCpuTimeAggregator aggregator{1000};
+  EXPECT_TRUE(aggregator.TakeBucketsEndingBefore(2000).empty());
+
+  // A late context switch.
+  aggregator.OnSwitchIn(10, 0, 1500);
+  aggregator.OnSwitchOut(10, 0, 2500);
+  std::vector<ProcessCpuTimes> buckets =
+      aggregator.TakeBucketsEndingBefore(3000);
+  ASSERT_EQ(buckets.size(), 1);
+  EXPECT_EQ(buckets[0].GetBeginTimestampNs(), 2000);
+  EXPECT_EQ(buckets[0].GetCpuTimesNs()[0].second, 500);
+}
+
+TEST(ProcessCpuTimeAggregator, DropsSwitchesWithoutPair) {
+  ProcessCpuTimeAggregator aggregator{1000};
+  aggregator.OnSwitchOut(10, 0, 100);
+  // The switch out of process 20 was lost.
+  aggregator.OnSwitchIn(20, 0, 200);
+  aggregator.OnSwitchIn(30, 0, 300);
+  aggregator.OnSwitchOut(30, 0, 400);
+  // The switch in of process 40 was lost.
+  aggregator.OnSwitchIn(50, 0, 500);
+  aggregator.OnSwitchOut(40, 0, 600);
+
+  std::vector<ProcessCpuTimes> buckets =
+      aggregator.TakeBucketsEndingBefore(1000);
+  ASSERT_EQ(buckets.size(), 1);
+  std::vector<std::pair<pid_t, uint64_t>> expected{{30, 100}};
+  EXPECT_EQ(SortedCpuTimes(buckets[0]), expected);
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,128 @@
+#include "SampledThreadFilter.h"
+
+#include <OrbitBase/Logging.h>
+#include <OrbitBase/SafeStrerror.h>
+#include <fnmatch.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <mutex>
+
+#include "Bpf.h"
+#include "PerfEventOpen.h"
+
+namespace LinuxTracing {
+
+SampledThreadFilter::SampledThreadFilter(const ThreadSelection& selection)
+    : selected_tids_(selection.tids.begin(), selection.tids.end()),
+      name_patterns_(selection.name_patterns) {}
+
+SampledThreadFilter::~SampledThreadFilter() {
+  for (int fd : {program_fd_, tids_map_fd_}) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+bool SampledThreadFilter::LoadBpfProgram() {
+  std::unique_lock<std::shared_mutex> lock{mutex_};
+  tids_map_fd_ = bpf_map_create(BPF_MAP_TYPE_HASH, sizeof(uint32_t),
+                                sizeof(uint8_t), MAX_BPF_THREADS);
+  if (tids_map_fd_ < 0) {
+    return false;
+  }
+  for (pid_t tid : selected_tids_) {
+    AddToBpfMap(tid);
+  }
+  for (pid_t tid : named_tids_) {
+    AddToBpfMap(tid);
+  }
+
+  // The stack offset of the tid, from the frame pointer r10.
+  constexpr int16_t TID_OFFSET = -4;
+  enum { DROP };
+  ProgramBuilder program;
+  program.Call(BPF_FUNC_get_current_pid_tgid);
+  // The lower half of tgid << 32 | tid.
+  program.Store32(BPF_REG_10, TID_OFFSET, BPF_REG_0);
+  program.LoadMapFd(BPF_REG_1, tids_map_fd_);
+  program.MovReg(BPF_REG_2, BPF_REG_10);
+  program.AluImm(BPF_ADD, BPF_REG_2, TID_OFFSET);
+  program.Call(BPF_FUNC_map_lookup_elem);
+  program.JumpIfZero(BPF_REG_0, DROP);
+  program.MovImm(BPF_REG_0, 1);
+  program.Exit();
+  // Returning 0 drops the sample instead of writing it to a ring buffer.
+  program.Bind(DROP);
+  program.MovImm(BPF_REG_0, 0);
+  program.Exit();
+
+  program_fd_ = bpf_prog_load(BPF_PROG_TYPE_PERF_EVENT, program.Build());
+  return program_fd_ >= 0;
+}
+
+bool SampledThreadFilter::Attach(int perf_event_fd) {
+  return perf_event_set_bpf(perf_event_fd, program_fd_);
+}
+
+void SampledThreadFilter::OnName(pid_t tid, std::string_view name) {
+  if (selected_tids_.contains(tid)) {
+    return;
+  }
+  bool matches = MatchesNamePatterns(name);
+  std::unique_lock<std::shared_mutex> lock{mutex_};
+  if (matches && named_tids_.insert(tid).second) {
+    AddToBpfMap(tid);
+  } else if (!matches && named_tids_.erase(tid) > 0) {
+    RemoveFromBpfMap(tid);
+  }
+}
+
+void SampledThreadFilter::OnExit(pid_t tid) {
+  std::unique_lock<std::shared_mutex> lock{mutex_};
+  // The tid can be reused by a thread with another name.
+  if (named_tids_.erase(tid) > 0) {
+    RemoveFromBpfMap(tid);
+  }
+}
+
+bool SampledThreadFilter::IsSampled(pid_t tid) const {
+  if (selected_tids_.contains(tid)) {
+    return true;
+  }
+  std::shared_lock<std::shared_mutex> lock{mutex_};
+  return named_tids_.contains(tid);
+}
+
+bool SampledThreadFilter::MatchesNamePatterns(std::string_view name) const {
+  std::string name_str{name};
+  return std::any_of(name_patterns_.begin(), name_patterns_.end(),
+                     [&name_str](const std::string& pattern) {
+                       return fnmatch(pattern.c_str(), name_str.c_str(), 0) ==
+                              0;
+                     });
+}
+
+void SampledThreadFilter::AddToBpfMap(pid_t tid) {
+  if (tids_map_fd_ < 0) {
+    return;
+  }
+  uint32_t key = tid;
+  uint8_t value = 1;
+  if (!bpf_map_update_elem(tids_map_fd_, &key, &value)) {
+    ERROR("Adding thread %d to the eBPF map of the sampled threads: %s", tid,
+          SafeStrerror(errno));
+  }
+}
+
+void SampledThreadFilter::RemoveFromBpfMap(pid_t tid) {
+  if (tids_map_fd_ < 0) {
+    return;
+  }
+  uint32_t key = tid;
+  bpf_map_delete_elem(tids_map_fd_, &key);
+}
+
+}  // namespace LinuxTracing
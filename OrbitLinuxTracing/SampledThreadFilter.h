@@ -0,0 +1,68 @@
+#ifndef ORBIT_LINUX_TRACING_SAMPLED_THREAD_FILTER_H_
+#define ORBIT_LINUX_TRACING_SAMPLED_THREAD_FILTER_H_
+
+#include <OrbitLinuxTracing/Tracer.h>
+#include <sys/types.h>
+
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+
+namespace LinuxTracing {
+
+// Which threads are sampled, see Tracer::SetSampledThreads. A thread is
+// sampled if its tid was selected, or while its name matches one of the
+// patterns, as the names are known at the start of the capture and then
+// reported by the PERF_RECORD_FORK and PERF_RECORD_COMM records. With
+// LoadBpfProgram, the sampled threads are also kept in an eBPF map, which a
+// program attached to the sampling events looks the current thread up in:
+// the samples of the other threads are then dropped by the kernel before
+// their stack is copied. Otherwise, they are dropped as they are read, before
+// being unwound. Thread safe.
+class SampledThreadFilter {
+ public:
+  // The threads the map of the program can hold.
+  static constexpr uint32_t MAX_BPF_THREADS = 16384;
+
+  explicit SampledThreadFilter(const ThreadSelection& selection);
+  ~SampledThreadFilter();
+  SampledThreadFilter(const SampledThreadFilter&) = delete;
+  SampledThreadFilter& operator=(const SampledThreadFilter&) = delete;
+
+  // Creates the map with the threads sampled so far and loads the program.
+  // Returns false on error, e.g., without CAP_SYS_ADMIN or on kernels older
+  // than 4.9, and the threads are then only filtered by IsSampled.
+  bool LoadBpfProgram();
+  // Runs the program on the samples of the event from then on. Only after a
+  // successful LoadBpfProgram.
+  bool Attach(int perf_event_fd);
+
+  // tid has a new name, or had name when the capture started or when it was
+  // spawned.
+  void OnName(pid_t tid, std::string_view name);
+  void OnExit(pid_t tid);
+
+  bool IsSampled(pid_t tid) const;
+
+ private:
+  bool MatchesNamePatterns(std::string_view name) const;
+  void AddToBpfMap(pid_t tid);
+  void RemoveFromBpfMap(pid_t tid);
+
+  const absl::flat_hash_set<pid_t> selected_tids_;
+  const std::vector<std::string> name_patterns_;
+
+  mutable std::shared_mutex mutex_;
+  // The threads sampled for their name.
+  absl::flat_hash_set<pid_t> named_tids_;
+  int tids_map_fd_ = -1;
+  int program_fd_ = -1;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_SAMPLED_THREAD_FILTER_H_
@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+
+#include "SampledThreadFilter.h"
+
+namespace LinuxTracing {
+
+TEST(SampledThreadFilter, SamplesTheSelectedTidsWhateverTheirName) {
+  SampledThreadFilter filter{ThreadSelection{{42, 43}, {}}};
+  EXPECT_TRUE(filter.IsSampled(42));
+  EXPECT_TRUE(filter.IsSampled(43));
+  EXPECT_FALSE(filter.IsSampled(44));
+
+  filter.OnName(42, "Worker");
+  filter.OnExit(43);
+  EXPECT_TRUE(filter.IsSampled(42));
+  EXPECT_TRUE(filter.IsSampled(43));
+}
+
+TEST(SampledThreadFilter, SamplesTheThreadsWhileTheirNameMatches) {
+  SampledThreadFilter filter{ThreadSelection{{}, {"Render*", "Audio"}}};
+  filter.OnName(1, "RenderThread");
+  filter.OnName(2, "Audio");
+  filter.OnName(3, "AudioMixer");
+  filter.OnName(4, "Worker");
+  EXPECT_TRUE(filter.IsSampled(1));
+  EXPECT_TRUE(filter.IsSampled(2));
+  EXPECT_FALSE(filter.IsSampled(3));
+  EXPECT_FALSE(filter.IsSampled(4));
+
+  filter.OnName(1, "Idle");
+  filter.OnName(4, "Render 2");
+  EXPECT_FALSE(filter.IsSampled(1));
+  EXPECT_TRUE(filter.IsSampled(4));
+}
+
+TEST(SampledThreadFilter, ForgetsTheNamesOfTheThreadsThatExited) {
+  SampledThreadFilter filter{ThreadSelection{{}, {"Render*"}}};
+  filter.OnName(1, "RenderThread");
+  filter.OnExit(1);
+  EXPECT_FALSE(filter.IsSampled(1));
+}
+
+}  // namespace LinuxTracing
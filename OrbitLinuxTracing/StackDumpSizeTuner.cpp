@@ -0,0 +1,64 @@
+#include "StackDumpSizeTuner.h"
+
+#include <algorithm>
+
+namespace LinuxTracing {
+
+void StackDumpSizeTuner::AddSample(
+    pid_t tid, uint64_t dump_size,
+    const std::vector<unwindstack::FrameData>& frames) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  ThreadNeeds& needs = needs_per_thread_[tid];
+  if (!frames.empty()) {
+    // The stack grows towards lower addresses.
+    uint64_t used_size = frames.back().sp >= frames.front().sp
+                             ? frames.back().sp - frames.front().sp
+                             : 0;
+    needs.size = std::max(needs.size, used_size + kOutermostFrameSize);
+    needs.failure_count = 0;
+    ++sample_count_since_retune_;
+    return;
+  }
+
+  // A dump smaller than the size ended with the stack, or was taken before the
+  // size grew.
+  if (dump_size < size_ || ++needs.failure_count < kFailuresBeforeGrowing) {
+    return;
+  }
+  needs.size = std::max(needs.size, 2 * dump_size);
+  needs.failure_count = 0;
+}
+
+void StackDumpSizeTuner::RemoveThread(pid_t tid) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  needs_per_thread_.erase(tid);
+}
+
+uint16_t StackDumpSizeTuner::GetSize() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return size_;
+}
+
+std::optional<uint16_t> StackDumpSizeTuner::Retune() {
+  std::lock_guard<std::mutex> lock{mutex_};
+  uint64_t needed_size = min_size_;
+  for (const auto& [tid, needs] : needs_per_thread_) {
+    // A quarter more, for the deeper callstacks not sampled yet.
+    needed_size = std::max(needed_size, needs.size + needs.size / 4);
+  }
+  needed_size = (needed_size + kSizeGranularity - 1) / kSizeGranularity *
+                kSizeGranularity;
+  needed_size = std::min<uint64_t>(needed_size, max_size_);
+
+  bool grow = needed_size > size_;
+  bool shrink = 2 * needed_size <= size_ &&
+                sample_count_since_retune_ >= kSamplesBeforeShrinking;
+  if (!grow && !shrink) {
+    return std::nullopt;
+  }
+  size_ = static_cast<uint16_t>(needed_size);
+  sample_count_since_retune_ = 0;
+  return size_;
+}
+
+}  // namespace LinuxTracing
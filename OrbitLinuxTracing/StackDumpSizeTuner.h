@@ -0,0 +1,70 @@
+#ifndef ORBIT_LINUX_TRACING_STACK_DUMP_SIZE_TUNER_H_
+#define ORBIT_LINUX_TRACING_STACK_DUMP_SIZE_TUNER_H_
+
+#include <sys/types.h>
+#include <unwindstack/Unwinder.h>
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+
+namespace LinuxTracing {
+
+// Tunes the size of the user stack copied with each stack sample
+// (perf_event_attr::sample_stack_user), which is copied through the ring
+// buffers and to the unwinders: most threads only use a small part of the
+// maximum. Records, per thread, the part of the stack that the frames unwound
+// from its samples span, and suggests the smallest size covering all threads
+// with some headroom. As an unwind that failed on a complete dump might have
+// been cut short by the size, the needs of a thread are doubled after a few of
+// those. The needs of a thread are forgotten once it exits.
+// Thread safe: samples are added by the unwinding threads, while the tracer
+// retunes the sampling events.
+class StackDumpSizeTuner {
+ public:
+  StackDumpSizeTuner(uint16_t initial_size, uint16_t min_size,
+                     uint16_t max_size)
+      : size_{initial_size}, min_size_{min_size}, max_size_{max_size} {}
+
+  // A stack sample of tid with a dump of dump_size bytes, and the frames
+  // unwound from it, empty if unwinding failed.
+  void AddSample(pid_t tid, uint64_t dump_size,
+                 const std::vector<unwindstack::FrameData>& frames);
+  void RemoveThread(pid_t tid);
+
+  uint16_t GetSize() const;
+  // The size to reopen the sampling events with, if the needs of the threads
+  // grew past the current size, or fell to half of it after enough samples,
+  // which then becomes the current size.
+  std::optional<uint16_t> Retune();
+
+  // Of the stack above the stack pointer of the outermost frame, read to
+  // unwind it.
+  static constexpr uint64_t kOutermostFrameSize = 512;
+  static constexpr uint64_t kSizeGranularity = 1024;
+  // Unwound samples since the last retune before the size can shrink, so that
+  // it doesn't before the deeper callstacks were sampled.
+  static constexpr uint64_t kSamplesBeforeShrinking = 1000;
+  // Unwinding also fails for other reasons, e.g., missing unwind information.
+  static constexpr uint32_t kFailuresBeforeGrowing = 3;
+
+ private:
+  struct ThreadNeeds {
+    uint64_t size = 0;
+    uint32_t failure_count = 0;
+  };
+
+  mutable std::mutex mutex_;
+  uint16_t size_;
+  uint16_t min_size_;
+  uint16_t max_size_;
+  uint64_t sample_count_since_retune_ = 0;
+  absl::flat_hash_map<pid_t, ThreadNeeds> needs_per_thread_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_STACK_DUMP_SIZE_TUNER_H_
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "StackDumpSizeTuner.h"
+
+namespace LinuxTracing {
+
+namespace {
+std::vector<unwindstack::FrameData> MakeFrames(uint64_t innermost_sp,
+                                               uint64_t outermost_sp) {
+  std::vector<unwindstack::FrameData> frames(2);
+  frames[0].sp = innermost_sp;
+  frames[1].sp = outermost_sp;
+  return frames;
+}
+
+void AddSamples(StackDumpSizeTuner* tuner, pid_t tid, uint64_t used_size,
+                uint64_t count) {
+  for (uint64_t i = 0; i < count; ++i) {
+    tuner->AddSample(tid, tuner->GetSize(),
+                     MakeFrames(0x10000, 0x10000 + used_size));
+  }
+}
+}  // namespace
+
+TEST(StackDumpSizeTuner, ShrinksToTheDeepestThreadAfterEnoughSamples) {
+  StackDumpSizeTuner tuner{65000, 4096, 65000};
+  AddSamples(&tuner, 1, 1000, StackDumpSizeTuner::kSamplesBeforeShrinking - 1);
+  AddSamples(&tuner, 2, 10000, 1);
+  EXPECT_EQ(tuner.GetSize(), 65000);
+
+  AddSamples(&tuner, 1, 1000, 1);
+  // (10000 + 512) * 1.25, rounded up.
+  EXPECT_EQ(tuner.Retune(), 13312);
+  EXPECT_EQ(tuner.GetSize(), 13312);
+  EXPECT_EQ(tuner.Retune(), std::nullopt);
+
+  // Not shrunk before enough samples again.
+  tuner.RemoveThread(2);
+  AddSamples(&tuner, 1, 1000, 10);
+  EXPECT_EQ(tuner.Retune(), std::nullopt);
+  AddSamples(&tuner, 1, 1000, StackDumpSizeTuner::kSamplesBeforeShrinking);
+  EXPECT_EQ(tuner.Retune(), 4096);
+}
+
+TEST(StackDumpSizeTuner, GrowsAsSoonAsAThreadNeedsMore) {
+  StackDumpSizeTuner tuner{8192, 4096, 65000};
+  AddSamples(&tuner, 1, 8000, 1);
+  EXPECT_EQ(tuner.Retune(), 11264);
+}
+
+TEST(StackDumpSizeTuner, GrowsAfterFailuresOnCompleteDumps) {
+  StackDumpSizeTuner tuner{8192, 4096, 65000};
+  for (uint32_t i = 0; i < StackDumpSizeTuner::kFailuresBeforeGrowing; ++i) {
+    // Dumps cut by the end of the stack don't count.
+    tuner.AddSample(1, 2048, {});
+  }
+  EXPECT_EQ(tuner.Retune(), std::nullopt);
+
+  for (uint32_t i = 0; i < StackDumpSizeTuner::kFailuresBeforeGrowing; ++i) {
+    tuner.AddSample(1, 8192, {});
+  }
+  EXPECT_EQ(tuner.Retune(), 20480);
+
+  for (uint32_t i = 0; i < StackDumpSizeTuner::kFailuresBeforeGrowing; ++i) {
+    tuner.AddSample(1, 20480, {});
+  }
+  EXPECT_EQ(tuner.Retune(), 51200);
+  for (uint32_t i = 0; i < StackDumpSizeTuner::kFailuresBeforeGrowing; ++i) {
+    tuner.AddSample(1, 51200, {});
+  }
+  EXPECT_EQ(tuner.Retune(), 65000);
+}
+
+}  // namespace LinuxTracing
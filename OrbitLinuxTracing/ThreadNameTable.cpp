@@ -0,0 +1,76 @@
+#include "ThreadNameTable.h"
+
+#include <algorithm>
+
+namespace LinuxTracing {
+
+namespace {
+template <typename Names>
+auto FirstNameAfter(Names& names, uint64_t timestamp_ns) {
+  return std::upper_bound(
+      names.begin(), names.end(), timestamp_ns,
+      [](uint64_t timestamp_ns, const auto& name) {
+        return timestamp_ns < name.timestamp_ns;
+      });
+}
+}  // namespace
+
+bool ThreadNameTable::OnRename(pid_t tid, uint64_t timestamp_ns,
+                               std::string_view name) {
+  std::vector<Name>& names = threads_[tid].names;
+  auto it = FirstNameAfter(names, timestamp_ns);
+  if (it != names.begin() && (it - 1)->name == name) {
+    return false;
+  }
+  names.insert(it, Name{timestamp_ns, std::string(name)});
+  return true;
+}
+
+std::optional<std::string> ThreadNameTable::OnFork(pid_t tid,
+                                                   pid_t parent_tid,
+                                                   uint64_t timestamp_ns) {
+  std::optional<std::string> name = GetName(parent_tid, timestamp_ns);
+  // Drops what is left of a thread that exited with the same tid.
+  Thread& thread = threads_[tid];
+  thread = Thread{};
+  if (name.has_value()) {
+    thread.names.push_back(Name{timestamp_ns, name.value()});
+  }
+  return name;
+}
+
+void ThreadNameTable::OnExit(pid_t tid, uint64_t timestamp_ns) {
+  auto thread_it = threads_.find(tid);
+  if (thread_it != threads_.end()) {
+    thread_it->second.exit_timestamp_ns = timestamp_ns;
+    exited_tids_.emplace_back(timestamp_ns, tid);
+  }
+
+  while (!exited_tids_.empty() &&
+         exited_tids_.front().first + kKeepExitedNs < timestamp_ns) {
+    auto [exit_timestamp_ns, exited_tid] = exited_tids_.front();
+    exited_tids_.pop_front();
+    auto exited_it = threads_.find(exited_tid);
+    // Unless the tid was reused since.
+    if (exited_it != threads_.end() &&
+        exited_it->second.exit_timestamp_ns == exit_timestamp_ns) {
+      threads_.erase(exited_it);
+    }
+  }
+}
+
+std::optional<std::string> ThreadNameTable::GetName(
+    pid_t tid, uint64_t timestamp_ns) const {
+  auto thread_it = threads_.find(tid);
+  if (thread_it == threads_.end()) {
+    return std::nullopt;
+  }
+  const std::vector<Name>& names = thread_it->second.names;
+  auto it = FirstNameAfter(names, timestamp_ns);
+  if (it == names.begin()) {
+    return std::nullopt;
+  }
+  return (it - 1)->name;
+}
+
+}  // namespace LinuxTracing
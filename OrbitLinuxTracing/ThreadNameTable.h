@@ -0,0 +1,59 @@
+#ifndef ORBIT_LINUX_TRACING_THREAD_NAME_TABLE_H_
+#define ORBIT_LINUX_TRACING_THREAD_NAME_TABLE_H_
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+
+namespace LinuxTracing {
+
+// The names of the threads of the target over time, from the PERF_RECORD_COMM,
+// PERF_RECORD_FORK and PERF_RECORD_EXIT records, with the names they had
+// before each rename: the events reported late, like unwound samples, can
+// predate the last rename of their thread. Records of different cores can be
+// added out of order. The names of the threads that exited are kept for
+// kKeepExitedNs, then forgotten, as their tids get reused.
+class ThreadNameTable {
+ public:
+  static constexpr uint64_t kKeepExitedNs = 1'000'000'000;
+
+  // Returns whether tid now has a new name from timestamp_ns on, i.e., whether
+  // the rename is to be reported.
+  bool OnRename(pid_t tid, uint64_t timestamp_ns, std::string_view name);
+  // A new thread starts with the name of the thread that created it. Returns
+  // that name, if known.
+  std::optional<std::string> OnFork(pid_t tid, pid_t parent_tid,
+                                    uint64_t timestamp_ns);
+  void OnExit(pid_t tid, uint64_t timestamp_ns);
+
+  // The name tid had at timestamp_ns, if known.
+  std::optional<std::string> GetName(pid_t tid, uint64_t timestamp_ns) const;
+
+ private:
+  struct Name {
+    uint64_t timestamp_ns;
+    std::string name;
+  };
+
+  struct Thread {
+    // Sorted by timestamp.
+    std::vector<Name> names;
+    std::optional<uint64_t> exit_timestamp_ns;
+  };
+
+  absl::flat_hash_map<pid_t, Thread> threads_;
+  // The threads that exited, with the time they did, as they were added.
+  std::deque<std::pair<uint64_t, pid_t>> exited_tids_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_THREAD_NAME_TABLE_H_
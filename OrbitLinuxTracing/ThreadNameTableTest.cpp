@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+
+#include "ThreadNameTable.h"
+
+namespace LinuxTracing {
+
+TEST(ThreadNameTable, KeepsTheNamesBeforeEachRename) {
+  ThreadNameTable table;
+  EXPECT_TRUE(table.OnRename(10, 100, "main"));
+  EXPECT_FALSE(table.OnRename(10, 150, "main"));
+  EXPECT_TRUE(table.OnRename(10, 300, "render"));
+  // From another core, before the last rename.
+  EXPECT_TRUE(table.OnRename(10, 200, "loader"));
+
+  EXPECT_FALSE(table.GetName(10, 50).has_value());
+  EXPECT_EQ(table.GetName(10, 150), "main");
+  EXPECT_EQ(table.GetName(10, 250), "loader");
+  EXPECT_EQ(table.GetName(10, 300), "render");
+  EXPECT_FALSE(table.GetName(20, 300).has_value());
+}
+
+TEST(ThreadNameTable, NewThreadsStartWithTheNameOfTheirParent) {
+  ThreadNameTable table;
+  table.OnRename(10, 100, "pool");
+  EXPECT_EQ(table.OnFork(11, 10, 200), "pool");
+  EXPECT_EQ(table.GetName(11, 200), "pool");
+  EXPECT_TRUE(table.OnRename(11, 210, "pool-worker-1"));
+  EXPECT_EQ(table.GetName(10, 210), "pool");
+
+  EXPECT_FALSE(table.OnFork(21, 20, 300).has_value());
+  EXPECT_FALSE(table.GetName(21, 300).has_value());
+}
+
+TEST(ThreadNameTable, ForgetsExitedThreadsAfterAWhile) {
+  ThreadNameTable table;
+  table.OnRename(10, 100, "short-lived");
+  table.OnExit(10, 200);
+  EXPECT_EQ(table.GetName(10, 150), "short-lived");
+
+  // The tid is reused by a new thread, which the exit of 10 doesn't forget.
+  table.OnRename(11, 300, "pool");
+  table.OnFork(10, 11, 400);
+  uint64_t later_ns = 200 + ThreadNameTable::kKeepExitedNs + 1;
+  table.OnExit(12, later_ns);
+  EXPECT_EQ(table.GetName(10, later_ns), "pool");
+  EXPECT_FALSE(table.GetName(10, 150).has_value());
+
+  table.OnExit(10, later_ns);
+  table.OnExit(12, later_ns + ThreadNameTable::kKeepExitedNs + 1);
+  EXPECT_FALSE(table.GetName(10, later_ns).has_value());
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,30 @@
+#include "ThreadStateVisitor.h"
+
+#include <OrbitBase/Logging.h>
+
+namespace LinuxTracing {
+
+void ThreadStateVisitor::visit(ThreadStatePerfEvent* event) {
+  CHECK(listener_ != nullptr);
+
+  auto [it, inserted] =
+      thread_states_.try_emplace(event->GetTid(), event->GetState());
+  if (!inserted) {
+    if (it->second == event->GetState()) {
+      return;
+    }
+    it->second = event->GetState();
+  }
+
+  listener_->OnThreadStateChange(ThreadStateChange{
+      event->GetTid(), event->GetState(), event->GetTimestamp(),
+      event->GetWakerTid()});
+
+  if (event->GetState() == ThreadState::kDead ||
+      event->GetState() == ThreadState::kZombie) {
+    // No more changes are expected for this thread.
+    thread_states_.erase(it);
+  }
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,31 @@
+#ifndef ORBIT_LINUX_TRACING_THREAD_STATE_VISITOR_H_
+#define ORBIT_LINUX_TRACING_THREAD_STATE_VISITOR_H_
+
+#include <OrbitLinuxTracing/Events.h>
+#include <OrbitLinuxTracing/TracerListener.h>
+
+#include "PerfEvent.h"
+#include "PerfEventVisitor.h"
+#include "absl/container/flat_hash_map.h"
+
+namespace LinuxTracing {
+
+// ThreadStateVisitor turns the ThreadStatePerfEvents decoded from the sched
+// tracepoints, assuming they come in order, into a stream of thread state
+// changes. As the same transition can be reported by more than one tracepoint
+// (e.g., both sched_waking and sched_wakeup make a thread kRunnable), only
+// the events that actually change the state of a thread are passed on.
+class ThreadStateVisitor : public PerfEventVisitor {
+ public:
+  void SetListener(TracerListener* listener) { listener_ = listener; }
+
+  void visit(ThreadStatePerfEvent* event) override;
+
+ private:
+  TracerListener* listener_ = nullptr;
+  absl::flat_hash_map<pid_t, ThreadState> thread_states_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_THREAD_STATE_VISITOR_H_
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+
+#include <tuple>
+#include <vector>
+
+#include "PerfEventReaders.h"
+#include "ThreadStateVisitor.h"
+
+namespace LinuxTracing {
+
+namespace {
+using ThreadStateChangeTuple = std::tuple<pid_t, ThreadState, uint64_t, pid_t>;
+
+class RecordingListener : public TracerListener {
+ public:
+  void OnTid(pid_t /*tid*/) override {}
+  void OnContextSwitchIn(
+      const ContextSwitchIn& /*context_switch_in*/) override {}
+  void OnContextSwitchOut(
+      const ContextSwitchOut& /*context_switch_out*/) override {}
+  void OnCallstack(const Callstack& /*callstack*/) override {}
+  void OnFunctionCall(const FunctionCall& /*function_call*/) override {}
+  void OnGpuJob(const GpuJob& /*gpu_job*/) override {}
+  void OnThreadStateChange(
+      const ThreadStateChange& thread_state_change) override {
+    changes.emplace_back(
+        thread_state_change.GetTid(), thread_state_change.GetState(),
+        thread_state_change.GetTimestampNs(),
+        thread_state_change.GetWakerTid());
+  }
+
+  std::vector<ThreadStateChangeTuple> changes;
+};
+
+void Visit(ThreadStateVisitor* visitor, uint64_t timestamp, pid_t tid,
+           ThreadState state, pid_t waker_tid = -1) {
+  ThreadStatePerfEvent event{timestamp, tid, state, waker_tid};
+  event.Accept(visitor);
+}
+}  // namespace
+
+TEST(ThreadStateVisitor, OnlyReportsChanges) {
+  RecordingListener listener;
+  ThreadStateVisitor visitor;
+  visitor.SetListener(&listener);
+
+  Visit(&visitor, 1, 42, ThreadState::kRunning);
+  Visit(&visitor, 2, 42, ThreadState::kInterruptibleSleep);
+  // sched_waking followed by sched_wakeup.
+  Visit(&visitor, 3, 42, ThreadState::kRunnable, 43);
+  Visit(&visitor, 4, 42, ThreadState::kRunnable);
+  Visit(&visitor, 5, 42, ThreadState::kRunning);
+  Visit(&visitor, 6, 44, ThreadState::kRunning);
+  // Preempted.
+  Visit(&visitor, 7, 42, ThreadState::kRunnable);
+
+  EXPECT_EQ(listener.changes,
+            (std::vector<ThreadStateChangeTuple>{
+                {42, ThreadState::kRunning, 1, -1},
+                {42, ThreadState::kInterruptibleSleep, 2, -1},
+                {42, ThreadState::kRunnable, 3, 43},
+                {42, ThreadState::kRunning, 5, -1},
+                {44, ThreadState::kRunning, 6, -1},
+                {42, ThreadState::kRunnable, 7, -1}}));
+}
+
+TEST(ThreadStateVisitor, ForgetsDeadThreads) {
+  RecordingListener listener;
+  ThreadStateVisitor visitor;
+  visitor.SetListener(&listener);
+
+  Visit(&visitor, 1, 42, ThreadState::kDead);
+  // The tid was reused.
+  Visit(&visitor, 2, 42, ThreadState::kDead);
+
+  EXPECT_EQ(listener.changes, (std::vector<ThreadStateChangeTuple>{
+                                  {42, ThreadState::kDead, 1, -1},
+                                  {42, ThreadState::kDead, 2, -1}}));
+}
+
+TEST(ThreadStateVisitor, ThreadStateFromSchedSwitchPrevState) {
+  EXPECT_EQ(ThreadStateFromSchedSwitchPrevState(0), ThreadState::kRunnable);
+  EXPECT_EQ(ThreadStateFromSchedSwitchPrevState(0x100), ThreadState::kRunnable);
+  EXPECT_EQ(ThreadStateFromSchedSwitchPrevState(0x01),
+            ThreadState::kInterruptibleSleep);
+  EXPECT_EQ(ThreadStateFromSchedSwitchPrevState(0x02),
+            ThreadState::kUninterruptibleSleep);
+  EXPECT_EQ(ThreadStateFromSchedSwitchPrevState(0x20), ThreadState::kZombie);
+  EXPECT_EQ(ThreadStateFromSchedSwitchPrevState(0x80), ThreadState::kIdle);
+}
+
+}  // namespace LinuxTracing
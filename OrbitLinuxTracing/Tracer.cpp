@@ -1,13 +1,27 @@
 #include <OrbitBase/Logging.h>
 #include <OrbitLinuxTracing/Tracer.h>
 
+#include <sched.h>
+
+#include <chrono>
+
+#include "InstrumentationRequests.h"
+#include "PrewarmedRingBuffers.h"
 #include "TracerThread.h"
+#include "Utils.h"
 
 namespace LinuxTracing {
 
 Tracer::Tracer(pid_t pid, double sampling_frequency,
                std::vector<Function> instrumented_functions)
-    : pid_{pid}, instrumented_functions_{std::move(instrumented_functions)} {
+    : Tracer{std::vector<pid_t>{pid}, sampling_frequency,
+             std::move(instrumented_functions)} {}
+
+Tracer::Tracer(std::vector<pid_t> pids, double sampling_frequency,
+               std::vector<Function> instrumented_functions)
+    : pids_{std::move(pids)},
+      instrumented_functions_{std::move(instrumented_functions)},
+      instrumentation_requests_{std::make_shared<InstrumentationRequests>()} {
   std::optional<uint64_t> sampling_period_ns =
       ComputeSamplingPeriodNs(sampling_frequency);
   if (sampling_period_ns.has_value()) {
@@ -20,17 +34,151 @@ Tracer::Tracer(pid_t pid, double sampling_frequency,
   }
 }
 
-void Tracer::Run(pid_t pid, uint64_t sampling_period_ns,
+std::vector<pid_t> Tracer::ListCgroupProcesses(
+    const std::string& cgroup_path) {
+  return LinuxTracing::ListCgroupProcesses(cgroup_path);
+}
+
+bool Tracer::PlaceCurrentThread(const ThreadPlacement& thread_placement) {
+  bool success = true;
+  if (!thread_placement.cpus.empty()) {
+    success &= SetCurrentThreadAffinity(thread_placement.cpus);
+  }
+  if (thread_placement.policy != ThreadPlacement::Policy::kDefault ||
+      thread_placement.nice != 0) {
+    int policy = SCHED_OTHER;
+    if (thread_placement.policy == ThreadPlacement::Policy::kBatch) {
+      policy = SCHED_BATCH;
+    } else if (thread_placement.policy == ThreadPlacement::Policy::kIdle) {
+      policy = SCHED_IDLE;
+    }
+    success &= SetCurrentThreadScheduling(policy, thread_placement.nice);
+  }
+  return success;
+}
+
+void Tracer::AddInstrumentedFunction(Function function) {
+  instrumentation_requests_->Push(
+      {InstrumentationRequests::Request::Type::kAdd, std::move(function)});
+}
+
+void Tracer::RemoveInstrumentedFunction(Function function) {
+  instrumentation_requests_->Push(
+      {InstrumentationRequests::Request::Type::kRemove, std::move(function)});
+}
+
+void Tracer::TraceWithIntelPt(Function function, uint64_t function_size,
+                              uint64_t duration_ns) {
+  instrumentation_requests_->Push(
+      {InstrumentationRequests::Request::Type::kTraceWithIntelPt,
+       std::move(function), function_size, duration_ns});
+}
+
+void Tracer::Run(const std::vector<pid_t>& pids, uint64_t sampling_period_ns,
                  const std::vector<Function>& instrumented_functions,
                  TracerListener* listener, bool trace_context_switches,
                  bool trace_callstacks, bool trace_instrumented_functions,
+                 uint32_t cpus_per_reader_thread,
+                 const ThreadPlacement& thread_placement,
+                 uint32_t unwinding_thread_count,
+                 bool unwind_with_frame_pointers, bool sample_callchains,
+                 bool bpf_stack_aggregation, bool bpf_function_calls,
+                 uint64_t ring_buffers_memory_budget_kb,
+                 bool trace_thread_states,
+                 bool trace_system_wide_scheduling,
+                 const std::vector<PmuCounter>& pmu_counters,
+                 bool trace_off_cpu_callstacks,
+                 bool trace_gpu_driver_events,
+                 bool trace_gpu_submission_callstacks, bool trace_file_io,
+                 uint64_t page_fault_sampling_period,
+                 uint64_t heap_sampling_interval_bytes,
+                 uint64_t lock_wait_threshold_ns,
+                 BranchSampling branch_sampling,
+                 uint64_t branch_sampling_period,
+                 const ThreadSelection& sampled_threads,
+                 const std::string& record_file_path,
+                 const std::shared_ptr<InstrumentationRequests>&
+                     instrumentation_requests,
                  const std::shared_ptr<std::atomic<bool>>& exit_requested) {
-  TracerThread session{pid, sampling_period_ns, instrumented_functions};
+  PlaceCurrentThread(thread_placement);
+  TracerThread session{pids, sampling_period_ns, instrumented_functions};
   session.SetListener(listener);
   session.SetTraceContextSwitches(trace_context_switches);
   session.SetTraceCallstacks(trace_callstacks);
   session.SetTraceInstrumentedFunctions(trace_instrumented_functions);
+  session.SetCpusPerReaderThread(cpus_per_reader_thread);
+  session.SetThreadPlacement(thread_placement);
+  session.SetUnwindingThreadCount(unwinding_thread_count);
+  session.SetUnwindWithFramePointers(unwind_with_frame_pointers);
+  session.SetSampleCallchains(sample_callchains);
+  session.SetBpfStackAggregation(bpf_stack_aggregation);
+  session.SetBpfFunctionCalls(bpf_function_calls);
+  session.SetRingBuffersMemoryBudgetKb(ring_buffers_memory_budget_kb);
+  session.SetTraceThreadStates(trace_thread_states);
+  session.SetTraceSystemWideScheduling(trace_system_wide_scheduling);
+  session.SetPmuCounters(pmu_counters);
+  session.SetTraceOffCpuCallstacks(trace_off_cpu_callstacks);
+  session.SetTraceGpuDriverEvents(trace_gpu_driver_events);
+  session.SetTraceGpuSubmissionCallstacks(trace_gpu_submission_callstacks);
+  session.SetTraceFileIo(trace_file_io);
+  session.SetPageFaultSamplingPeriod(page_fault_sampling_period);
+  session.SetHeapSamplingInterval(heap_sampling_interval_bytes);
+  session.SetLockWaitThresholdNs(lock_wait_threshold_ns);
+  session.SetBranchSampling(branch_sampling, branch_sampling_period);
+  session.SetSampledThreads(sampled_threads);
+  session.SetRecordFilePath(record_file_path);
+  session.SetInstrumentationRequests(instrumentation_requests);
   session.Run(exit_requested);
 }
 
+void Tracer::Prewarm() {
+  // Only the settings that determine the per-core events and the sizes of
+  // their ring buffers matter.
+  std::thread{[pids = pids_, sampling_period_ns = sampling_period_ns_,
+               instrumented_functions = instrumented_functions_,
+               trace_context_switches = trace_context_switches_,
+               trace_callstacks = trace_callstacks_,
+               trace_instrumented_functions = trace_instrumented_functions_,
+               sample_callchains = sample_callchains_,
+               bpf_stack_aggregation = bpf_stack_aggregation_,
+               ring_buffers_memory_budget_kb = ring_buffers_memory_budget_kb_,
+               trace_thread_states = trace_thread_states_,
+               trace_off_cpu_callstacks = trace_off_cpu_callstacks_,
+               trace_gpu_driver_events = trace_gpu_driver_events_,
+               trace_gpu_submission_callstacks =
+                   trace_gpu_submission_callstacks_,
+               trace_file_io = trace_file_io_] {
+    uint64_t prewarm_id;
+    {
+      TracerThread session{pids, sampling_period_ns, instrumented_functions};
+      session.SetTraceContextSwitches(trace_context_switches);
+      session.SetTraceCallstacks(trace_callstacks);
+      session.SetTraceInstrumentedFunctions(trace_instrumented_functions);
+      session.SetSampleCallchains(sample_callchains);
+      session.SetBpfStackAggregation(bpf_stack_aggregation);
+      session.SetRingBuffersMemoryBudgetKb(ring_buffers_memory_budget_kb);
+      session.SetTraceThreadStates(trace_thread_states);
+      session.SetTraceOffCpuCallstacks(trace_off_cpu_callstacks);
+      session.SetTraceGpuDriverEvents(trace_gpu_driver_events);
+      session.SetTraceGpuSubmissionCallstacks(trace_gpu_submission_callstacks);
+      session.SetTraceFileIo(trace_file_io);
+      prewarm_id = session.Prewarm();
+    }
+    std::this_thread::sleep_for(
+        std::chrono::nanoseconds{PrewarmedRingBuffers::MAX_AGE_NS});
+    PrewarmedRingBuffers::Get().Expire(prewarm_id);
+  }}.detach();
+}
+
+bool Tracer::Replay(const std::string& record_file_path,
+                    TracerListener* listener, uint32_t unwinding_thread_count,
+                    bool unwind_with_frame_pointers) {
+  // The target and what was traced come from the file.
+  TracerThread session{/*pids=*/{}, /*sampling_period_ns=*/0, {}};
+  session.SetListener(listener);
+  session.SetUnwindingThreadCount(unwinding_thread_count);
+  session.SetUnwindWithFramePointers(unwind_with_frame_pointers);
+  return session.Replay(record_file_path);
+}
+
 }  // namespace LinuxTracing
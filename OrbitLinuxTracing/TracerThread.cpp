@@ -2,10 +2,21 @@
 
 #include <OrbitBase/Logging.h>
 #include <OrbitBase/Tracing.h>
+#include <x86intrin.h>
 
+#include <algorithm>
+#include <cstring>
+#include <functional>
 #include <thread>
+#include <tuple>
+#include <utility>
 
+#include "IntelPtDecoder.h"
+#include "LibunwindstackUnwinder.h"
+#include "PerProcessVisitor.h"
+#include "ThreadStateVisitor.h"
 #include "UprobesUnwindingVisitor.h"
+#include "absl/strings/ascii.h"
 #include "absl/strings/str_format.h"
 
 namespace LinuxTracing {
@@ -20,24 +31,25 @@ void CloseFileDescriptors(const std::vector<int>& fds) {
 
 }  // namespace
 
-bool TracerThread::OpenRingBufferForGpuTracepoint(
+bool TracerThread::OpenRingBufferForTracepoint(
     const char* tracepoint_category, const char* tracepoint_name, int32_t cpu,
-    std::vector<int>* gpu_tracing_fds,
+    uint64_t ring_buffer_size_kb, std::vector<int>* tracing_fds,
     std::vector<PerfEventRingBuffer>* ring_buffers) {
   int fd = tracepoint_event_open(tracepoint_category, tracepoint_name, -1, cpu);
   if (fd == -1) {
     return false;
   }
-  gpu_tracing_fds->push_back(fd);
+  tracing_fds->push_back(fd);
 
   std::string buffer_name =
       absl::StrFormat("%s:%s_%i", tracepoint_category, tracepoint_name, cpu);
-  PerfEventRingBuffer ring_buffer{fd, GPU_TRACING_RING_BUFFER_SIZE_KB,
-                                  buffer_name};
+  PerfEventRingBuffer ring_buffer{
+      fd, ScaledRingBufferSizeKb(ring_buffer_size_kb), buffer_name};
   if (!ring_buffer.IsOpen()) {
     return false;
   }
   ring_buffers->push_back(std::move(ring_buffer));
+  ring_buffer_fds_to_cpu_.emplace(fd, cpu);
 
   return true;
 }
@@ -54,23 +66,52 @@ bool TracerThread::OpenRingBufferForGpuTracepoint(
 // above, that share the same timeline, context, and seqno.
 // We have to record events system-wide (per CPU) to ensure we record all
 // relevant events.
+// With trace_gpu_submission_callstacks_, "amdgpu_cs_ioctl", which fires in the
+// context of the thread submitting the job, also samples its user stack (see
+// tracepoint_stack_event_open) in a larger ring buffer. The kernel dumps the
+// stacks of all processes, but only the ones of the target processes are
+// unwound.
 // This method returns true on success, otherwise false.
 bool TracerThread::OpenGpuTracepoints(const std::vector<int32_t>& cpus) {
   std::vector<PerfEventRingBuffer> ring_buffers;
   std::vector<int> gpu_tracing_fds;
+  std::vector<int> gpu_submission_fds;
   for (int32_t cpu : cpus) {
-    if (!OpenRingBufferForGpuTracepoint("amdgpu", "amdgpu_cs_ioctl", cpu,
-                                        &gpu_tracing_fds, &ring_buffers)) {
+    if (trace_gpu_submission_callstacks_) {
+      int fd = tracepoint_stack_event_open("amdgpu", "amdgpu_cs_ioctl", cpu);
+      if (fd == -1) {
+        CloseFileDescriptors(gpu_tracing_fds);
+        return false;
+      }
+      gpu_tracing_fds.push_back(fd);
+      gpu_submission_fds.push_back(fd);
+
+      std::string buffer_name =
+          absl::StrFormat("amdgpu:amdgpu_cs_ioctl_stack_%i", cpu);
+      PerfEventRingBuffer ring_buffer{
+          fd, ScaledRingBufferSizeKb(GPU_SUBMISSION_RING_BUFFER_SIZE_KB),
+          buffer_name};
+      if (!ring_buffer.IsOpen()) {
+        CloseFileDescriptors(gpu_tracing_fds);
+        return false;
+      }
+      ring_buffers.push_back(std::move(ring_buffer));
+      ring_buffer_fds_to_cpu_.emplace(fd, cpu);
+    } else if (!OpenRingBufferForTracepoint("amdgpu", "amdgpu_cs_ioctl", cpu,
+                                            GPU_TRACING_RING_BUFFER_SIZE_KB,
+                                            &gpu_tracing_fds, &ring_buffers)) {
       CloseFileDescriptors(gpu_tracing_fds);
       return false;
     }
-    if (!OpenRingBufferForGpuTracepoint("amdgpu", "amdgpu_sched_run_job", cpu,
-                                        &gpu_tracing_fds, &ring_buffers)) {
+    if (!OpenRingBufferForTracepoint("amdgpu", "amdgpu_sched_run_job", cpu,
+                                     GPU_TRACING_RING_BUFFER_SIZE_KB,
+                                     &gpu_tracing_fds, &ring_buffers)) {
       CloseFileDescriptors(gpu_tracing_fds);
       return false;
     }
-    if (!OpenRingBufferForGpuTracepoint("dma_fence", "dma_fence_signaled", cpu,
-                                        &gpu_tracing_fds, &ring_buffers)) {
+    if (!OpenRingBufferForTracepoint("dma_fence", "dma_fence_signaled", cpu,
+                                     GPU_TRACING_RING_BUFFER_SIZE_KB,
+                                     &gpu_tracing_fds, &ring_buffers)) {
       CloseFileDescriptors(gpu_tracing_fds);
       return false;
     }
@@ -82,6 +123,155 @@ bool TracerThread::OpenGpuTracepoints(const std::vector<int32_t>& cpus) {
     gpu_tracing_fds_.emplace(fd);
     tracing_fds_.push_back(fd);
   }
+  for (int fd : gpu_submission_fds) {
+    gpu_submission_fds_.emplace(fd);
+    uprobes_event_processor_watermarks_.try_emplace(fd, 0);
+  }
+  for (PerfEventRingBuffer& buffer : ring_buffers) {
+    ring_buffers_.emplace_back(std::move(buffer));
+  }
+
+  return true;
+}
+
+// This method enables the sched tracepoints that report the changes of the
+// scheduling state of threads:
+// - "sched_switch" reports the state a thread is left in when it is switched
+//   out (e.g., sleeping, or runnable if it was preempted), and the thread that
+//   starts running;
+// - "sched_waking" is reported in the context of the thread that wakes up
+//   another one, which tells us the waker;
+// - "sched_wakeup" is reported when the woken up thread is actually made
+//   runnable, and is kept for kernels without "sched_waking".
+// Like for GPU tracepoints, we have to record events system-wide (per CPU), as
+// a thread can be woken up by any other thread, and only keep the ones of the
+// threads of the target process.
+// This method returns true on success, otherwise false.
+bool TracerThread::OpenThreadStateTracepoints(
+    const std::vector<int32_t>& cpus) {
+  std::vector<PerfEventRingBuffer> ring_buffers;
+  std::vector<int> sched_switch_fds;
+  std::vector<int> sched_waking_fds;
+  std::vector<int> sched_wakeup_fds;
+  for (int32_t cpu : cpus) {
+    bool opened = OpenRingBufferForTracepoint(
+        "sched", "sched_switch", cpu, THREAD_STATE_RING_BUFFER_SIZE_KB,
+        &sched_switch_fds, &ring_buffers);
+    opened = opened && OpenRingBufferForTracepoint(
+                           "sched", "sched_waking", cpu,
+                           THREAD_STATE_RING_BUFFER_SIZE_KB, &sched_waking_fds,
+                           &ring_buffers);
+    opened = opened && OpenRingBufferForTracepoint(
+                           "sched", "sched_wakeup", cpu,
+                           THREAD_STATE_RING_BUFFER_SIZE_KB, &sched_wakeup_fds,
+                           &ring_buffers);
+    if (!opened) {
+      CloseFileDescriptors(sched_switch_fds);
+      CloseFileDescriptors(sched_waking_fds);
+      CloseFileDescriptors(sched_wakeup_fds);
+      return false;
+    }
+  }
+
+  // Since all tracepoints could successfully be opened, we can now commit all
+  // file descriptors and ring buffers to the TracerThread members.
+  sched_switch_fds_.insert(sched_switch_fds.begin(), sched_switch_fds.end());
+  sched_waking_fds_.insert(sched_waking_fds.begin(), sched_waking_fds.end());
+  sched_wakeup_fds_.insert(sched_wakeup_fds.begin(), sched_wakeup_fds.end());
+  for (const std::vector<int>* fds :
+       {&sched_switch_fds, &sched_waking_fds, &sched_wakeup_fds}) {
+    for (int fd : *fds) {
+      tracing_fds_.push_back(fd);
+      uprobes_event_processor_watermarks_.try_emplace(fd, 0);
+    }
+  }
+  for (PerfEventRingBuffer& buffer : ring_buffers) {
+    ring_buffers_.emplace_back(std::move(buffer));
+  }
+
+  return true;
+}
+
+// This method opens the sched:sched_switch tracepoint with the user stack of
+// the thread switched out (see sched_switch_stack_event_open). Like for the
+// thread states, the tracepoint is recorded system-wide and only the records
+// of the threads of the target process are kept: their stacks when they
+// block, and the records of them being switched in again. These go to
+// UprobesUnwindingVisitor, in order with the memory maps needed to unwind the
+// stacks. Only the cores of the cpuset of the target are needed.
+// This method returns true on success, otherwise false.
+bool TracerThread::OpenOffCpuTracepoints(const std::vector<int32_t>& cpus) {
+  std::vector<int> off_cpu_fds;
+  std::vector<PerfEventRingBuffer> ring_buffers;
+  std::vector<std::pair<int, int32_t>> fds_and_cpus;
+  for (int32_t cpu : cpus) {
+    int fd = sched_switch_stack_event_open(cpu);
+    if (fd == -1) {
+      CloseFileDescriptors(off_cpu_fds);
+      return false;
+    }
+    off_cpu_fds.push_back(fd);
+
+    std::string buffer_name = absl::StrFormat("off_cpu_%u", cpu);
+    PerfEventRingBuffer ring_buffer{
+        fd, ScaledRingBufferSizeKb(OFF_CPU_RING_BUFFER_SIZE_KB), buffer_name};
+    if (!ring_buffer.IsOpen()) {
+      CloseFileDescriptors(off_cpu_fds);
+      return false;
+    }
+    ring_buffers.push_back(std::move(ring_buffer));
+    fds_and_cpus.emplace_back(fd, cpu);
+  }
+
+  for (const auto& [fd, cpu] : fds_and_cpus) {
+    off_cpu_fds_.insert(fd);
+    tracing_fds_.push_back(fd);
+    ring_buffer_fds_to_cpu_.emplace(fd, cpu);
+    uprobes_event_processor_watermarks_.try_emplace(fd, 0);
+  }
+  for (PerfEventRingBuffer& buffer : ring_buffers) {
+    ring_buffers_.emplace_back(std::move(buffer));
+  }
+
+  return true;
+}
+
+bool TracerThread::OpenPageFaultEvents(const std::vector<int32_t>& cpus) {
+  std::vector<int> opened_fds;
+  std::vector<PerfEventRingBuffer> ring_buffers;
+  std::vector<std::tuple<int, int32_t, bool>> fds_cpus_and_majors;
+  for (int32_t cpu : cpus) {
+    for (bool major : {false, true}) {
+      int fd = page_fault_event_open(
+          major, major ? 1 : page_fault_sampling_period_, -1, cpu);
+      if (fd == -1) {
+        CloseFileDescriptors(opened_fds);
+        return false;
+      }
+      opened_fds.push_back(fd);
+
+      std::string buffer_name = absl::StrFormat(
+          "%s_%u", major ? "major_page_faults" : "page_faults", cpu);
+      PerfEventRingBuffer ring_buffer{
+          fd,
+          ScaledRingBufferSizeKb(major ? MAJOR_PAGE_FAULTS_RING_BUFFER_SIZE_KB
+                                       : PAGE_FAULTS_RING_BUFFER_SIZE_KB),
+          buffer_name};
+      if (!ring_buffer.IsOpen()) {
+        CloseFileDescriptors(opened_fds);
+        return false;
+      }
+      ring_buffers.push_back(std::move(ring_buffer));
+      fds_cpus_and_majors.emplace_back(fd, cpu, major);
+    }
+  }
+
+  for (const auto& [fd, cpu, major] : fds_cpus_and_majors) {
+    (major ? major_page_fault_fds_ : page_fault_fds_).insert(fd);
+    tracing_fds_.push_back(fd);
+    ring_buffer_fds_to_cpu_.emplace(fd, cpu);
+    uprobes_event_processor_watermarks_.try_emplace(fd, 0);
+  }
   for (PerfEventRingBuffer& buffer : ring_buffers) {
     ring_buffers_.emplace_back(std::move(buffer));
   }
@@ -89,6 +279,70 @@ bool TracerThread::OpenGpuTracepoints(const std::vector<int32_t>& cpus) {
   return true;
 }
 
+// The PMU counters are opened as a group per cpu, whose leader is the first
+// counter. The uprobes and uretprobes of the functions recorded with
+// Function::RecordingMode::kTimingAndPmuCounters join the group of their cpu
+// and read the values of all its counters when they fire. As the counters
+// count whatever runs on the cpu, a sched:sched_switch event also joins each
+// group, so that PmuCounterAccumulator can attribute the counts to threads.
+// This method returns true on success, otherwise false.
+bool TracerThread::OpenPmuCounters(const std::vector<int32_t>& cpus) {
+  absl::flat_hash_map<int32_t, int> group_fds_per_cpu;
+  std::vector<int> counter_fds;
+  for (int32_t cpu : cpus) {
+    int group_fd = -1;
+    for (PmuCounter counter : pmu_counters_) {
+      int fd = pmu_counter_event_open(counter, cpu, group_fd);
+      if (fd < 0) {
+        CloseFileDescriptors(counter_fds);
+        return false;
+      }
+      counter_fds.push_back(fd);
+      if (group_fd == -1) {
+        group_fd = fd;
+      }
+    }
+    group_fds_per_cpu.emplace(cpu, group_fd);
+  }
+
+  pmu_counter_group_fds_per_cpu_ = std::move(group_fds_per_cpu);
+  // The leaders come before the u(ret)probes in tracing_fds_: the events of a
+  // group only count, or fire, while its leader is enabled.
+  for (int fd : counter_fds) {
+    tracing_fds_.push_back(fd);
+  }
+  return true;
+}
+
+bool TracerThread::OpenPmuCounterSwitches() {
+  std::lock_guard<std::mutex> lock{uprobes_redirect_mutex_};
+  for (const auto& [cpu, group_fd] : pmu_counter_group_fds_per_cpu_) {
+    auto ring_buffer_fd_it = uprobes_ring_buffer_fds_per_cpu_.find(cpu);
+    if (ring_buffer_fd_it == uprobes_ring_buffer_fds_per_cpu_.end()) {
+      // No function was instrumented successfully.
+      continue;
+    }
+    int fd = sched_switch_pmu_counters_event_open(cpu, group_fd);
+    if (fd < 0) {
+      return false;
+    }
+    // In the same ring buffer as the u(ret)probes of the cpu, so that the
+    // switches are ordered with them.
+    perf_event_redirect(fd, ring_buffer_fd_it->second);
+    redirected_fds_per_ring_buffer_fd_[ring_buffer_fd_it->second].push_back(
+        fd);
+    pmu_counter_switch_ids_.insert(perf_event_get_id(fd));
+    tracing_fds_.push_back(fd);
+  }
+  return true;
+}
+
+bool TracerThread::RecordsPmuCounters(const Function& function) const {
+  return function.GetRecordingMode() ==
+             Function::RecordingMode::kTimingAndPmuCounters &&
+         !pmu_counter_group_fds_per_cpu_.empty();
+}
+
 bool TracerThread::InitGpuTracepointEventProcessor() {
   int amdgpu_cs_ioctl_id = GetTracepointId("amdgpu", "amdgpu_cs_ioctl");
   if (amdgpu_cs_ioctl_id == -1) {
@@ -106,9 +360,53 @@ bool TracerThread::InitGpuTracepointEventProcessor() {
       = std::make_shared<GpuTracepointEventProcessor>(
           amdgpu_cs_ioctl_id, amdgpu_sched_run_job_id, dma_fence_signaled_id);
   gpu_event_processor_->SetListener(listener_);
+  if (record_file_writer_ != nullptr) {
+    record_file_writer_->Write(RecordFileEntryType::kGpuTracepointIds,
+                               RecordFileEntryBuilder{}
+                                   .Add(amdgpu_cs_ioctl_id)
+                                   .Add(amdgpu_sched_run_job_id)
+                                   .Add(dma_fence_signaled_id));
+  }
   return true;
 }
 
+void TracerThread::CreateUprobesEventProcessor(
+    const absl::flat_hash_map<pid_t, std::string>& initial_maps_per_pid) {
+  // The unwinding threads are shared out between the processes.
+  size_t process_count = std::max<size_t>(initial_maps_per_pid.size(), 1);
+  size_t unwinding_thread_count_per_process =
+      unwinding_thread_count_ == 0
+          ? 0
+          : std::max<size_t>(unwinding_thread_count_ / process_count, 1);
+  auto per_process_visitor = std::make_unique<PerProcessVisitor>(
+      [this, unwinding_thread_count_per_process](
+          pid_t /*pid*/, const std::string& initial_maps) {
+        auto uprobes_unwinding_visitor =
+            std::make_unique<UprobesUnwindingVisitor>(
+                initial_maps, unwinding_thread_count_per_process,
+                unwind_with_frame_pointers_);
+        uprobes_unwinding_visitor->SetListener(listener_);
+        if (stack_dump_size_tuner_ != nullptr) {
+          uprobes_unwinding_visitor->SetStackDumpSizeTuner(
+              stack_dump_size_tuner_.get());
+        }
+        return uprobes_unwinding_visitor;
+      });
+  for (const auto& [pid, initial_maps] : initial_maps_per_pid) {
+    per_process_visitor->AddProcess(pid, initial_maps);
+  }
+  // Switch between PerfEventProcessor and PerfEventProcessor2 here.
+  // PerfEventProcessor2 is supposedly faster but assumes that events from the
+  // same perf_event_open ring buffer are already sorted.
+  uprobes_event_processor_ =
+      std::make_shared<PerfEventProcessor2>(std::move(per_process_visitor));
+  if (trace_thread_states_) {
+    auto thread_state_visitor = std::make_unique<ThreadStateVisitor>();
+    thread_state_visitor->SetListener(listener_);
+    uprobes_event_processor_->AddVisitor(std::move(thread_state_visitor));
+  }
+}
+
 // TODO: Refactor this huge method.
 void TracerThread::Run(
     const std::shared_ptr<std::atomic<bool>>& exit_requested) {
@@ -116,172 +414,130 @@ void TracerThread::Run(
 
   Reset();
 
-  // perf_event_open refers to cores as "CPUs".
+  const uint64_t run_begin_ns = MonotonicTimestampNs();
 
-  // Record context switches from all cores for all processes.
-  std::vector<int32_t> all_cpus;
-  for (int32_t cpu = 0; cpu < GetNumCores(); ++cpu) {
-    all_cpus.push_back(cpu);
+  if (!record_file_path_.empty()) {
+    record_file_writer_ = RecordFileWriter::Create(record_file_path_);
   }
 
-  // Record calls to dynamically instrumented functions and sample only on cores
-  // in this process's cgroup's cpuset, as these are the only cores the process
-  // will be scheduled on.
-  std::vector<int32_t> cpuset_cpus = GetCpusetCpus(pid_);
-  if (cpuset_cpus.empty()) {
-    ERROR("Could not read cpuset");
-    cpuset_cpus = all_cpus;
-  }
+  std::vector<int32_t> all_cpus;
+  std::vector<int32_t> cpuset_cpus;
+  ComputeCpus(&all_cpus, &cpuset_cpus);
+  ComputeRingBufferSizeShift(all_cpus, cpuset_cpus);
 
   bool perf_event_open_errors = false;
   bool uprobes_event_open_errors = false;
 
+  // The per-core events are opened in parallel, or taken from a prewarm.
   if (trace_context_switches_) {
-    for (int32_t cpu : all_cpus) {
-      int context_switch_fd = context_switch_event_open(-1, cpu);
-      std::string buffer_name = absl::StrFormat("context_switch_%u", cpu);
-      PerfEventRingBuffer context_switch_ring_buffer{
-          context_switch_fd, CONTEXT_SWITCHES_RING_BUFFER_SIZE_KB, buffer_name};
-      if (context_switch_ring_buffer.IsOpen()) {
-        tracing_fds_.push_back(context_switch_fd);
-        ring_buffers_.push_back(std::move(context_switch_ring_buffer));
-      } else {
-        perf_event_open_errors = true;
-      }
-    }
+    OpenPerCpuEvents(PerCpuEvent::kContextSwitch, all_cpus,
+                     &perf_event_open_errors);
   }
 
-  auto uprobes_unwinding_visitor =
-      std::make_unique<UprobesUnwindingVisitor>(ReadMaps(pid_));
-  uprobes_unwinding_visitor->SetListener(listener_);
-  // Switch between PerfEventProcessor and PerfEventProcessor2 here.
-  // PerfEventProcessor2 is supposedly faster but assumes that events from the
-  // same perf_event_open ring buffer are already sorted.
-  uprobes_event_processor_ = std::make_shared<PerfEventProcessor2>(
-      std::move(uprobes_unwinding_visitor));
+  absl::flat_hash_map<pid_t, std::string> initial_maps_per_pid;
+  for (pid_t pid : pids_) {
+    initial_maps_per_pid.emplace(pid, ReadMaps(pid));
+  }
+  if (trace_callstacks_ && !sample_callchains_) {
+    // Before the visitors, which pass it the unwound samples.
+    stack_dump_size_tuner_ = std::make_unique<StackDumpSizeTuner>(
+        SAMPLE_STACK_USER_SIZE, MIN_SAMPLE_STACK_USER_SIZE,
+        SAMPLE_STACK_USER_SIZE);
+  }
+  CreateUprobesEventProcessor(initial_maps_per_pid);
 
   if (!InitGpuTracepointEventProcessor()) {
     ERROR("Failed to initialize GPU tracepoint event processor.");
   }
 
   if (trace_instrumented_functions_) {
-    absl::flat_hash_map<int32_t, int> uprobes_ring_buffer_fds_per_cpu;
-
-    for (const auto& function : instrumented_functions_) {
-      absl::flat_hash_map<int32_t, int> function_uprobes_fds_per_cpu;
-      absl::flat_hash_map<int32_t, int> function_uretprobes_fds_per_cpu;
-      bool function_uprobes_open_error = false;
-
-      for (int32_t cpu : cpuset_cpus) {
-        int uprobes_fd = uprobes_stack_event_open(
-            function.BinaryPath().c_str(), function.FileOffset(), -1, cpu);
-        if (uprobes_fd < 0) {
-          function_uprobes_open_error = true;
-          break;
-        }
-        function_uprobes_fds_per_cpu.emplace(cpu, uprobes_fd);
-
-        int uretprobes_fd = uretprobes_event_open(
-            function.BinaryPath().c_str(), function.FileOffset(), -1, cpu);
-        if (uretprobes_fd < 0) {
-          function_uprobes_open_error = true;
-          break;
-        }
-        function_uretprobes_fds_per_cpu.emplace(cpu, uretprobes_fd);
-      }
-
-      if (function_uprobes_open_error) {
+    if (!pmu_counters_.empty() && !OpenPmuCounters(cpuset_cpus)) {
+      ERROR(
+          "Opening the PMU counters, functions will be recorded without them");
+    }
+    if (bpf_function_calls_ && !OpenBpfUprobes(cpuset_cpus)) {
+      LOG("Could not load the eBPF programs to pair u(ret)probes, functions "
+          "are recorded as usual");
+    }
+    // Registering a uprobe can take milliseconds, so the u(ret)probes of the
+    // functions are opened in parallel, and then added in order.
+    std::vector<UprobesFds> uprobes_fds(instrumented_functions_.size());
+    std::unique_ptr<bool[]> uprobes_opened{
+        new bool[instrumented_functions_.size()]};
+    RunInParallel(instrumented_functions_.size(), MAX_SETUP_THREADS,
+                  [&](size_t i) {
+                    uprobes_opened[i] = OpenUprobesFds(
+                        instrumented_functions_[i], cpuset_cpus,
+                        &uprobes_fds[i]);
+                  });
+    for (size_t i = 0; i < instrumented_functions_.size(); ++i) {
+      if (uprobes_opened[i]) {
+        AddUprobes(instrumented_functions_[i], cpuset_cpus, uprobes_fds[i]);
+      } else {
         perf_event_open_errors = true;
         uprobes_event_open_errors = true;
-        ERROR("Opening u(ret)probes for function at %#016lx",
-              function.VirtualAddress());
-        for (const auto& uprobes_fd : function_uprobes_fds_per_cpu) {
-          close(uprobes_fd.second);
-        }
-        for (const auto& uretprobes_fd : function_uretprobes_fds_per_cpu) {
-          close(uretprobes_fd.second);
-        }
-        continue;
-      }
-
-      // Add function_uretprobes_fds_per_cpu to tracing_fds_ before
-      // function_uprobes_fds_per_cpu. As we support having uretprobes without
-      // associated uprobes, but not the opposite, this way the uretprobe is
-      // enabled before the uprobe.
-      for (const auto& uretprobes_fd : function_uretprobes_fds_per_cpu) {
-        tracing_fds_.push_back(uretprobes_fd.second);
-      }
-      for (const auto& uprobes_fd : function_uprobes_fds_per_cpu) {
-        tracing_fds_.push_back(uprobes_fd.second);
-      }
-
-      // Record the association between the stream_id and the function.
-      for (const auto& uprobes_fd : function_uprobes_fds_per_cpu) {
-        uprobes_ids_to_function_.emplace(perf_event_get_id(uprobes_fd.second),
-                                         &function);
-      }
-      for (const auto& uretprobes_fd : function_uretprobes_fds_per_cpu) {
-        uprobes_ids_to_function_.emplace(
-            perf_event_get_id(uretprobes_fd.second), &function);
-      }
-
-      // Redirect all uprobes and uretprobes on the same cpu to a single ring
-      // buffer to reduce the number of ring buffers.
-      for (int32_t cpu : cpuset_cpus) {
-        int uprobes_fd = function_uprobes_fds_per_cpu.at(cpu);
-        int uretprobes_fd = function_uretprobes_fds_per_cpu.at(cpu);
-        if (uprobes_ring_buffer_fds_per_cpu.contains(cpu)) {
-          // Redirect to the already opened ring buffer.
-          int ring_buffer_fd = uprobes_ring_buffer_fds_per_cpu.at(cpu);
-          perf_event_redirect(uprobes_fd, ring_buffer_fd);
-          perf_event_redirect(uretprobes_fd, ring_buffer_fd);
-        } else {
-          // No ring buffer has yet been created for this cpu, as this is the
-          // first uprobes to have been opened successfully. Hence, create a
-          // ring buffer for this cpu associated to uprobes_fd and redirect the
-          // uretprobes to it. The other uprobes and uretprobes for this cpu
-          // will be redirected to this ring buffer.
-          int ring_buffer_fd = uprobes_fd;
-          std::string buffer_name =
-              absl::StrFormat("uprobes_uretprobes_%u", cpu);
-          ring_buffers_.emplace_back(ring_buffer_fd,
-                                     UPROBES_RING_BUFFER_SIZE_KB, buffer_name);
-          uprobes_ring_buffer_fds_per_cpu[cpu] = ring_buffer_fd;
-          uprobes_fds_.emplace(ring_buffer_fd);
-          // Must be called after the ring buffer has been opened.
-          perf_event_redirect(uretprobes_fd, ring_buffer_fd);
-        }
       }
     }
+    if (!pmu_counter_group_fds_per_cpu_.empty() && !OpenPmuCounterSwitches()) {
+      ERROR(
+          "Opening the context switches of the PMU counters, their counts "
+          "include other threads");
+    }
   }
 
-  for (int32_t cpu : cpuset_cpus) {
-    int mmap_task_fd = mmap_task_event_open(-1, cpu);
-    std::string buffer_name = absl::StrFormat("mmap_task_%u", cpu);
-    PerfEventRingBuffer mmap_task_ring_buffer{
-        mmap_task_fd, MMAP_TASK_RING_BUFFER_SIZE_KB, buffer_name};
-    if (mmap_task_ring_buffer.IsOpen()) {
-      tracing_fds_.push_back(mmap_task_fd);
-      ring_buffers_.push_back(std::move(mmap_task_ring_buffer));
-    } else {
-      perf_event_open_errors = true;
-    }
+  for (int mmap_task_fd : OpenPerCpuEvents(PerCpuEvent::kMmapTask,
+                                           cpuset_cpus,
+                                           &perf_event_open_errors)) {
+    mmap_task_fds_.insert(mmap_task_fd);
+    uprobes_event_processor_watermarks_.try_emplace(mmap_task_fd, 0);
   }
 
-  if (trace_callstacks_) {
+  if (trace_callstacks_ && bpf_stack_aggregation_) {
+    bpf_stack_aggregator_ = BpfStackAggregator::Create(
+        std::vector<pid_t>(pids_.begin(), pids_.end()));
+    if (bpf_stack_aggregator_ == nullptr) {
+      LOG("Could not load the eBPF program to aggregate stack samples, the "
+          "samples are copied to the ring buffers instead");
+    }
+  }
+  if (bpf_stack_aggregator_ != nullptr) {
+    // No ring buffers: the samples are counted in the kernel and dropped.
     for (int32_t cpu : cpuset_cpus) {
-      int sampling_fd = sample_event_open(sampling_period_ns_, -1, cpu);
-      std::string buffer_name = absl::StrFormat("sampling_%u", cpu);
-      PerfEventRingBuffer sampling_ring_buffer{
-          sampling_fd, SAMPLING_RING_BUFFER_SIZE_KB, buffer_name};
-      if (sampling_ring_buffer.IsOpen()) {
-        tracing_fds_.push_back(sampling_fd);
-        ring_buffers_.push_back(std::move(sampling_ring_buffer));
-      } else {
+      int sampling_fd = bpf_sample_event_open(sampling_period_ns_, cpu);
+      if (sampling_fd < 0) {
+        perf_event_open_errors = true;
+        continue;
+      }
+      if (!bpf_stack_aggregator_->Attach(sampling_fd)) {
+        close(sampling_fd);
         perf_event_open_errors = true;
+        continue;
+      }
+      tracing_fds_.push_back(sampling_fd);
+    }
+    next_bpf_drain_ns_ = MonotonicTimestampNs() + BPF_DRAIN_PERIOD_NS;
+  } else if (trace_callstacks_) {
+    std::vector<int> sampling_fds = OpenPerCpuEvents(
+        PerCpuEvent::kSampling, cpuset_cpus, &perf_event_open_errors);
+    for (int sampling_fd : sampling_fds) {
+      sampling_fds_.insert(sampling_fd);
+      if (sample_callchains_) {
+        // These samples need no unwinding and are not deferred.
+        callchain_sampling_fds_.insert(sampling_fd);
+      } else {
+        uprobes_event_processor_watermarks_.try_emplace(sampling_fd, 0);
+        active_sampling_events_per_ring_buffer_fd_.emplace(
+            sampling_fd, ActiveSamplingEvent{sampling_fd, sampling_period_ns_});
       }
     }
+    if (!sampled_threads_.IsEmpty()) {
+      CreateSampledThreadFilter(sampling_fds);
+    }
+    next_stack_dump_retune_ns_ =
+        MonotonicTimestampNs() + STACK_DUMP_RETUNE_PERIOD_NS;
   }
+  // What was prewarmed for other settings is not needed anymore.
+  PrewarmedRingBuffers::Get().Clear();
 
   bool gpu_event_open_errors = false;
   if (trace_gpu_driver_events_) {
@@ -293,6 +549,41 @@ void TracerThread::Run(
     LOG("There were errors opening GPU tracepoint events.");
   }
 
+  if (trace_thread_states_ && !OpenThreadStateTracepoints(all_cpus)) {
+    LOG("There were errors opening thread state tracepoint events.");
+  }
+
+  if (trace_off_cpu_callstacks_ && !OpenOffCpuTracepoints(cpuset_cpus)) {
+    LOG("There were errors opening the tracepoint events for off-CPU "
+        "callstacks.");
+  }
+
+  if (trace_file_io_ && !OpenBpfFileIo(cpuset_cpus)) {
+    LOG("Could not load the eBPF programs on the syscall tracepoints, file "
+        "I/O is not traced");
+  }
+
+  if (page_fault_sampling_period_ > 0 && !OpenPageFaultEvents(cpuset_cpus)) {
+    LOG("There were errors opening the page fault events.");
+  }
+
+  if (heap_sampling_interval_bytes_ > 0 &&
+      !OpenHeapProfiler(cpuset_cpus, initial_maps_per_pid)) {
+    LOG("Could not load the eBPF programs on the allocator, heap allocations "
+        "are not sampled");
+  }
+
+  if (lock_wait_threshold_ns_ > 0 && !OpenBpfLockContention(cpuset_cpus)) {
+    LOG("Could not load the eBPF programs on the futex tracepoints, lock "
+        "contention is not traced");
+  }
+
+  if (branch_sampling_ != BranchSampling::kNone &&
+      !OpenBranchStackEvents(cpuset_cpus)) {
+    LOG("Could not open the branch stack sampling events, e.g. because the "
+        "cores have no last branch records: branches are not sampled");
+  }
+
   if (uprobes_event_open_errors) {
     LOG("There were errors with perf_event_open, including for uprobes: did "
         "you forget to run as root?");
@@ -301,114 +592,105 @@ void TracerThread::Run(
         "or to set /proc/sys/kernel/perf_event_paranoid to -1?");
   }
 
+  for (const auto& fd_and_watermark : uprobes_event_processor_watermarks_) {
+    uprobes_event_processor_->AddOriginFileDescriptor(fd_and_watermark.first);
+  }
+
+  uint64_t ring_buffers_total_size_kb = 0;
+  for (const PerfEventRingBuffer& ring_buffer : ring_buffers_) {
+    ring_buffers_total_size_kb += ring_buffer.GetSizeKb();
+    lost_count_per_ring_buffer_fd_.try_emplace(ring_buffer.GetFileDescriptor(),
+                                               0);
+  }
+  ring_buffers_total_size_kb_ = ring_buffers_total_size_kb;
+  LOG("Ring buffers use %lu KB", ring_buffers_total_size_kb);
+
+  if (trace_thread_states_ || trace_off_cpu_callstacks_) {
+    // The threads spawned from now on are added by ProcessForkEvent.
+    std::vector<pid_t> tids = ListTargetThreads();
+    std::unique_lock<std::shared_mutex> lock{thread_state_tids_mutex_};
+    thread_state_tids_.insert(tids.begin(), tids.end());
+  }
+
   // Start recording events.
   for (int fd : tracing_fds_) {
     perf_event_enable(fd);
   }
+  uint64_t enabled_ns = MonotonicTimestampNs();
+  start_latency_ns_ = enabled_ns - run_begin_ns;
+  LOG("Capture started in %.1f ms", start_latency_ns_ / 1e6);
 
-  for (pid_t tid : ListThreads(pid_)) {
+  std::vector<pid_t> tids = ListTargetThreads();
+  for (pid_t tid : tids) {
     // Keep threads in sync.
     listener_->OnTid(tid);
   }
+  ReportInitialThreadNames(enabled_ns);
+
+  if (record_file_writer_ != nullptr) {
+    RecordCaptureSetup(initial_maps_per_pid, tids);
+  }
 
   stats_.Reset();
 
-  bool last_iteration_saw_events = false;
   std::thread deferred_events_thread(&TracerThread::ProcessDeferredEvents,
                                      this);
 
-  while (!(*exit_requested)) {
-    ORBIT_SCOPE("Tracer Iteration");
-
-    if (!last_iteration_saw_events) {
-      // Periodically print event statistics.
-      PrintStatsIfTimerElapsed();
-
-      // Sleep if there was no new event in the last iteration so that we are
-      // not constantly polling. Don't sleep so long that ring buffers overflow.
-      // TODO: Refine this sleeping pattern, possibly using exponential backoff.
-      {
-        ORBIT_SCOPE("Sleep");
-        usleep(IDLE_TIME_ON_EMPTY_RING_BUFFERS_US);
-      }
+  std::vector<std::vector<PerfEventRingBuffer*>> reader_ring_buffers =
+      AssignRingBuffersToReaders();
+  if (reader_ring_buffers.size() == 1) {
+    // Poll all ring buffers from this thread.
+    ReadRingBuffers(std::move(reader_ring_buffers[0]), /*main_thread=*/true,
+                    *exit_requested);
+  } else {
+    LOG("Reading from %lu ring buffers with %lu reader threads",
+        ring_buffers_.size(), reader_ring_buffers.size());
+    std::vector<std::thread> reader_threads;
+    reader_threads.reserve(reader_ring_buffers.size());
+    for (std::vector<PerfEventRingBuffer*>& ring_buffers :
+         reader_ring_buffers) {
+      reader_threads.emplace_back(&TracerThread::ReadRingBuffers, this,
+                                  std::move(ring_buffers),
+                                  /*main_thread=*/false,
+                                  std::cref(*exit_requested));
     }
 
-    last_iteration_saw_events = false;
-
-    // Read and process events from all ring buffers. In order to ensure that no
-    // buffer is read constantly while others overflow, we schedule the reading
-    // using round-robin like scheduling.
-    for (PerfEventRingBuffer& ring_buffer : ring_buffers_) {
-      if (*exit_requested) {
-        break;
-      }
-
-      // Read up to ROUND_ROBIN_POLLING_BATCH_SIZE (5) new events.
-      // TODO: Some event types (e.g., stack samples) have a much longer
-      //  processing time but are less frequent than others (e.g., context
-      //  switches). Take this into account in our scheduling algorithm.
-      for (int32_t read_from_this_buffer = 0;
-           read_from_this_buffer < ROUND_ROBIN_POLLING_BATCH_SIZE;
-           ++read_from_this_buffer) {
-        if (*exit_requested) {
-          break;
-        }
-        if (!ring_buffer.HasNewData()) {
-          break;
-        }
+    while (!(*exit_requested)) {
+      ReportStatsIfTimerElapsed();
+      ReportProcessCpuTimes();
+      ReportBpfCallstackCounts(/*force=*/false);
+      ReportBranchCounts(/*force=*/false);
+      ProcessInstrumentationRequests();
+      UpdateIntelPtWindow(/*force=*/false);
+      RetuneStackDumpSizeIfTimerElapsed();
+      usleep(IDLE_TIME_ON_EMPTY_DEFERRED_EVENTS_US);
+    }
 
-        last_iteration_saw_events = true;
-        perf_event_header header;
-        ring_buffer.ReadHeader(&header);
-
-        // perf_event_header::type contains the type of record, e.g.,
-        // PERF_RECORD_SAMPLE, PERF_RECORD_MMAP, etc., defined in enum
-        // perf_event_type in linux/perf_event.h.
-        switch (header.type) {
-          case PERF_RECORD_SWITCH:
-            // Note: as we are recording context switches on CPUs and not on
-            // threads, we don't expect this type of record.
-            ERROR(
-                "Unexpected PERF_RECORD_SWITCH (only "
-                "PERF_RECORD_SWITCH_CPU_WIDE are expected)");
-            ProcessContextSwitchEvent(header, &ring_buffer);
-            break;
-          case PERF_RECORD_SWITCH_CPU_WIDE:
-            ProcessContextSwitchCpuWideEvent(header, &ring_buffer);
-            break;
-          case PERF_RECORD_FORK:
-            ProcessForkEvent(header, &ring_buffer);
-            break;
-          case PERF_RECORD_EXIT:
-            ProcessExitEvent(header, &ring_buffer);
-            break;
-          case PERF_RECORD_MMAP:
-            ProcessMmapEvent(header, &ring_buffer);
-            break;
-          case PERF_RECORD_SAMPLE:
-            ProcessSampleEvent(header, &ring_buffer);
-            break;
-          case PERF_RECORD_LOST:
-            ProcessLostEvent(header, &ring_buffer);
-            break;
-          default:
-            ERROR("Unexpected perf_event_header::type: %u", header.type);
-            ring_buffer.SkipRecord(header);
-            break;
-        }
-      }
+    for (std::thread& reader_thread : reader_threads) {
+      reader_thread.join();
     }
   }
 
+  UpdateIntelPtWindow(/*force=*/true);
+
   // Finish processing all deferred events.
   stop_deferred_thread_ = true;
   deferred_events_thread.join();
   uprobes_event_processor_->ProcessAllEvents();
+  // Destroying the UprobesUnwindingVisitor waits for the callstacks that are
+  // still being unwound by its worker threads, if any, to be reported.
+  uprobes_event_processor_.reset();
+  batching_listener_->Flush();
 
   // Stop recording.
   for (int fd : tracing_fds_) {
     perf_event_disable(fd);
   }
+  if (bpf_stack_aggregator_ != nullptr) {
+    ReportBpfCallstackCounts(/*force=*/true);
+    bpf_stack_aggregator_.reset();
+  }
+  ReportBranchCounts(/*force=*/true);
 
   // Close the ring buffers.
   ring_buffers_.clear();
@@ -417,80 +699,2434 @@ void TracerThread::Run(
   for (int fd : tracing_fds_) {
     close(fd);
   }
+  bpf_uprobes_.reset();
+  bpf_file_io_.reset();
+  bpf_heap_profiler_.reset();
+  bpf_lock_contention_.reset();
+
+  if (record_file_writer_ != nullptr) {
+    LOG("Recorded %lu bytes to %s", record_file_writer_->GetWrittenBytes(),
+        record_file_path_.c_str());
+    record_file_writer_.reset();
+  }
 }
 
-void TracerThread::ProcessContextSwitchEvent(const perf_event_header& header,
-                                             PerfEventRingBuffer* ring_buffer) {
-  ContextSwitchPerfEvent event;
-  ring_buffer->ConsumeRecord(header, &event.ring_buffer_record);
-  pid_t tid = event.GetTid();
-  uint16_t cpu = static_cast<uint16_t>(event.GetCpu());
-  uint64_t time = event.GetTimestamp();
-
-  if (event.IsSwitchOut()) {
-    listener_->OnContextSwitchOut(ContextSwitchOut(tid, cpu, time));
-  } else {
-    listener_->OnContextSwitchIn(ContextSwitchIn(tid, cpu, time));
+std::vector<pid_t> TracerThread::ListTargetThreads() const {
+  std::vector<pid_t> tids;
+  for (pid_t pid : pids_) {
+    std::vector<pid_t> pid_tids = ListThreads(pid);
+    tids.insert(tids.end(), pid_tids.begin(), pid_tids.end());
   }
+  return tids;
+}
 
-  ++stats_.sched_switch_count;
+void TracerThread::ReportInitialThreadNames(uint64_t timestamp_ns) {
+  for (pid_t pid : pids_) {
+    for (pid_t tid : ListThreads(pid)) {
+      std::optional<std::string> comm =
+          ReadFile(absl::StrFormat("/proc/%d/task/%d/comm", pid, tid));
+      if (!comm.has_value()) {
+        // The thread already exited.
+        continue;
+      }
+      std::string name{absl::StripTrailingAsciiWhitespace(comm.value())};
+      {
+        std::lock_guard<std::mutex> lock(thread_names_mutex_);
+        // Unless renamed since tracing started.
+        if (!thread_names_.OnRename(tid, timestamp_ns, name)) {
+          continue;
+        }
+      }
+      std::unique_lock<std::mutex> lock = LockListenerIfNeeded();
+      listener_->OnThreadName(
+          ThreadName(pid, tid, std::move(name), timestamp_ns));
+    }
+  }
 }
 
-void TracerThread::ProcessContextSwitchCpuWideEvent(
-    const perf_event_header& header, PerfEventRingBuffer* ring_buffer) {
-  SystemWideContextSwitchPerfEvent event;
-  ring_buffer->ConsumeRecord(header, &event.ring_buffer_record);
-  pid_t tid = event.GetTid();
-  uint16_t cpu = static_cast<uint16_t>(event.GetCpu());
-  uint64_t time = event.GetTimestamp();
-  
-  if (event.IsSwitchOut()) {
-    listener_->OnContextSwitchOut(ContextSwitchOut(tid, cpu, time));
-  } else {
-    listener_->OnContextSwitchIn(ContextSwitchIn(tid, cpu, time));
+void TracerThread::RecordCaptureSetup(
+    const absl::flat_hash_map<pid_t, std::string>& initial_maps_per_pid,
+    const std::vector<pid_t>& tids) {
+  RecordFileEntryBuilder target_entry;
+  target_entry.Add(static_cast<uint32_t>(pids_.size()));
+  for (pid_t pid : pids_) {
+    target_entry.Add(pid);
+  }
+  target_entry.Add(trace_system_wide_scheduling_)
+      .Add(trace_thread_states_)
+      .Add(trace_off_cpu_callstacks_);
+  record_file_writer_->Write(RecordFileEntryType::kTarget, target_entry);
+
+  for (const PerfEventRingBuffer& ring_buffer : ring_buffers_) {
+    int fd = ring_buffer.GetFileDescriptor();
+    auto cpu_it = ring_buffer_fds_to_cpu_.find(fd);
+    int32_t cpu = cpu_it != ring_buffer_fds_to_cpu_.end() ? cpu_it->second : -1;
+    uint32_t kinds = 0;
+    const std::pair<const absl::flat_hash_set<int>*, RingBufferKind>
+        fd_sets_and_kinds[] = {
+            {&uprobes_fds_, kUprobesRingBuffer},
+            {&mmap_task_fds_, kMmapTaskRingBuffer},
+            {&sampling_fds_, kSamplingRingBuffer},
+            {&callchain_sampling_fds_, kCallchainSamplingRingBuffer},
+            {&gpu_tracing_fds_, kGpuTracingRingBuffer},
+            {&sched_switch_fds_, kSchedSwitchRingBuffer},
+            {&sched_waking_fds_, kSchedWakingRingBuffer},
+            {&sched_wakeup_fds_, kSchedWakeupRingBuffer},
+            {&off_cpu_fds_, kOffCpuRingBuffer},
+            {&bpf_function_calls_fds_, kBpfFunctionCallsRingBuffer},
+            {&gpu_submission_fds_, kGpuSubmissionRingBuffer},
+            {&bpf_file_io_fds_, kBpfFileIoRingBuffer},
+            {&heap_allocation_fds_, kHeapAllocationRingBuffer},
+            {&bpf_heap_record_fds_, kBpfHeapRecordRingBuffer},
+            {&page_fault_fds_, kPageFaultRingBuffer},
+            {&major_page_fault_fds_, kMajorPageFaultRingBuffer},
+            {&bpf_lock_wait_fds_, kBpfLockWaitRingBuffer},
+            {&lock_wait_stack_fds_, kLockWaitStackRingBuffer},
+            {&branch_stack_fds_, kBranchStackRingBuffer},
+        };
+    for (const auto& [fds, kind] : fd_sets_and_kinds) {
+      if (fds->contains(fd)) kinds |= kind;
+    }
+    if (uprobes_event_processor_watermarks_.contains(fd)) {
+      kinds |= kDeferredRingBuffer;
+    }
+    record_file_writer_->Write(
+        RecordFileEntryType::kRingBuffer,
+        RecordFileEntryBuilder{}.Add(fd).Add(cpu).Add(kinds).AddString(
+            ring_buffer.GetName()));
   }
 
-  ++stats_.sched_switch_count;
-}
+  if (!pmu_counter_group_fds_per_cpu_.empty()) {
+    RecordFileEntryBuilder entry;
+    entry.Add(static_cast<uint32_t>(pmu_counters_.size()));
+    for (PmuCounter counter : pmu_counters_) {
+      entry.Add(counter);
+    }
+    entry.Add(static_cast<uint32_t>(pmu_counter_group_fds_per_cpu_.size()));
+    for (const auto& [cpu, group_fd] : pmu_counter_group_fds_per_cpu_) {
+      entry.Add(cpu).Add(group_fd);
+    }
+    entry.Add(static_cast<uint32_t>(pmu_counter_switch_ids_.size()));
+    for (uint64_t stream_id : pmu_counter_switch_ids_) {
+      entry.Add(stream_id);
+    }
+    record_file_writer_->Write(RecordFileEntryType::kPmuCounters, entry);
+  }
 
-void TracerThread::ProcessForkEvent(const perf_event_header& header,
-                                    PerfEventRingBuffer* ring_buffer) {
-  ForkPerfEvent event;
-  ring_buffer->ConsumeRecord(header, &event.ring_buffer_record);
+  // The maps before the threads, as the threads entry creates
+  // uprobes_event_processor_ with them.
+  uint64_t timestamp_ns = MonotonicTimestampNs();
+  for (const auto& [pid, initial_maps] : initial_maps_per_pid) {
+    record_file_writer_->Write(RecordFileEntryType::kMaps,
+                               RecordFileEntryBuilder{}
+                                   .Add(-1)
+                                   .Add(pid)
+                                   .Add(timestamp_ns)
+                                   .AddString(initial_maps));
+  }
 
-  if (event.GetPid() != pid_) {
-    return;
+  // The binaries can only be unwound with the same build ids.
+  absl::flat_hash_set<std::string> paths;
+  for (const auto& [pid, initial_maps] : initial_maps_per_pid) {
+    std::unique_ptr<unwindstack::BufferMaps> maps =
+        LibunwindstackUnwinder::ParseMaps(initial_maps);
+    if (maps == nullptr) continue;
+    for (const auto& map_info : *maps) {
+      const std::string& path = map_info->name;
+      if (path.empty() || path[0] != '/' || !paths.insert(path).second) {
+        continue;
+      }
+      std::string build_id = ReadElfBuildId(path);
+      if (build_id.empty()) continue;
+      record_file_writer_->Write(
+          RecordFileEntryType::kBuildId,
+          RecordFileEntryBuilder{}.AddString(path).AddString(build_id));
+    }
   }
 
-  // A new thread of the sampled process was spawned.
-  listener_->OnTid(event.GetTid());
+  RecordFileEntryBuilder threads_entry;
+  for (pid_t tid : tids) {
+    threads_entry.Add(tid);
+  }
+  record_file_writer_->Write(RecordFileEntryType::kThreads, threads_entry);
 }
 
-void TracerThread::ProcessExitEvent(const perf_event_header& header,
+bool TracerThread::Replay(const std::string& record_file_path) {
+  FAIL_IF(listener_ == nullptr, "No listener set");
+  std::unique_ptr<RecordFileReader> reader =
+      RecordFileReader::Open(record_file_path);
+  if (reader == nullptr) {
+    return false;
+  }
+
+  Reset();
+  replaying_ = true;
+  const uint64_t begin_ns = MonotonicTimestampNs();
+  ReplayState state;
+  bool valid = true;
+  RecordFileEntryType type;
+  absl::Span<const uint8_t> payload;
+  while (reader->ReadEntry(&type, &payload)) {
+    if (!ReplayEntry(type, payload, &state)) {
+      ERROR("Invalid entry of type %u in record file %s",
+            static_cast<uint32_t>(type), record_file_path.c_str());
+      valid = false;
+      break;
+    }
+  }
+
+  if (uprobes_event_processor_ != nullptr) {
+    AddReplayedDeferredEvents();
+    uprobes_event_processor_->ProcessAllEvents();
+    uprobes_event_processor_.reset();
+  }
+  batching_listener_->Flush();
+  ring_buffers_.clear();
+  replaying_ = false;
+
+  LOG("Replayed %lu records in %.3f s", state.record_count,
+      (MonotonicTimestampNs() - begin_ns) / 1e9);
+  return valid;
+}
+
+bool TracerThread::ReplayEntry(RecordFileEntryType type,
+                               absl::Span<const uint8_t> payload,
+                               ReplayState* state) {
+  RecordFileEntryParser parser{payload};
+  switch (type) {
+    case RecordFileEntryType::kTarget: {
+      uint32_t pid_count;
+      if (!parser.Read(&pid_count)) return false;
+      pids_.clear();
+      for (uint32_t i = 0; i < pid_count; ++i) {
+        pid_t pid;
+        if (!parser.Read(&pid)) return false;
+        pids_.insert(pid);
+      }
+      return parser.Read(&trace_system_wide_scheduling_) &&
+             parser.Read(&trace_thread_states_) &&
+             parser.Read(&trace_off_cpu_callstacks_);
+    }
+
+    case RecordFileEntryType::kRingBuffer: {
+      int fd;
+      int32_t cpu;
+      uint32_t kinds;
+      std::string name;
+      if (!parser.Read(&fd) || !parser.Read(&cpu) || !parser.Read(&kinds) ||
+          !parser.ReadString(&name)) {
+        return false;
+      }
+      const std::pair<absl::flat_hash_set<int>*, RingBufferKind>
+          fd_sets_and_kinds[] = {
+              {&uprobes_fds_, kUprobesRingBuffer},
+              {&mmap_task_fds_, kMmapTaskRingBuffer},
+              {&sampling_fds_, kSamplingRingBuffer},
+              {&callchain_sampling_fds_, kCallchainSamplingRingBuffer},
+              {&gpu_tracing_fds_, kGpuTracingRingBuffer},
+              {&sched_switch_fds_, kSchedSwitchRingBuffer},
+              {&sched_waking_fds_, kSchedWakingRingBuffer},
+              {&sched_wakeup_fds_, kSchedWakeupRingBuffer},
+              {&off_cpu_fds_, kOffCpuRingBuffer},
+              {&bpf_function_calls_fds_, kBpfFunctionCallsRingBuffer},
+              {&gpu_submission_fds_, kGpuSubmissionRingBuffer},
+              {&bpf_file_io_fds_, kBpfFileIoRingBuffer},
+              {&heap_allocation_fds_, kHeapAllocationRingBuffer},
+              {&bpf_heap_record_fds_, kBpfHeapRecordRingBuffer},
+              {&page_fault_fds_, kPageFaultRingBuffer},
+              {&major_page_fault_fds_, kMajorPageFaultRingBuffer},
+              {&bpf_lock_wait_fds_, kBpfLockWaitRingBuffer},
+              {&lock_wait_stack_fds_, kLockWaitStackRingBuffer},
+              {&branch_stack_fds_, kBranchStackRingBuffer},
+          };
+      for (const auto& [fds, kind] : fd_sets_and_kinds) {
+        if ((kinds & kind) != 0) fds->insert(fd);
+      }
+      if ((kinds & kDeferredRingBuffer) != 0) {
+        uprobes_event_processor_watermarks_.try_emplace(fd, 0);
+      }
+      if (cpu >= 0) {
+        ring_buffer_fds_to_cpu_.emplace(fd, cpu);
+      }
+      state->ring_buffer_indices.emplace(fd, ring_buffers_.size());
+      ring_buffers_.push_back(PerfEventRingBuffer::CreateInMemory(
+          fd, REPLAY_RING_BUFFER_SIZE_KB, std::move(name)));
+      return ring_buffers_.back().IsOpen();
+    }
+
+    case RecordFileEntryType::kUprobes: {
+      std::string binary_path;
+      uint64_t file_offset;
+      uint64_t virtual_address;
+      Function::RecordingMode recording_mode;
+      if (!parser.ReadString(&binary_path) || !parser.Read(&file_offset) ||
+          !parser.Read(&virtual_address) || !parser.Read(&recording_mode)) {
+        return false;
+      }
+      const Function& function = added_instrumented_functions_.emplace_back(
+          std::move(binary_path), file_offset, virtual_address,
+          recording_mode);
+      uint64_t stream_id;
+      bool is_uretprobe;
+      while (parser.Read(&stream_id)) {
+        if (!parser.Read(&is_uretprobe)) return false;
+        uprobes_ids_to_function_.emplace(stream_id, &function);
+        if (is_uretprobe) uretprobes_ids_.insert(stream_id);
+      }
+      return true;
+    }
+
+    case RecordFileEntryType::kPmuCounters: {
+      uint32_t count;
+      if (!parser.Read(&count)) return false;
+      pmu_counters_.resize(count);
+      for (PmuCounter& counter : pmu_counters_) {
+        if (!parser.Read(&counter)) return false;
+      }
+      if (!parser.Read(&count)) return false;
+      for (uint32_t i = 0; i < count; ++i) {
+        int32_t cpu;
+        int group_fd;
+        if (!parser.Read(&cpu) || !parser.Read(&group_fd)) return false;
+        pmu_counter_group_fds_per_cpu_.emplace(cpu, group_fd);
+      }
+      if (!parser.Read(&count)) return false;
+      for (uint32_t i = 0; i < count; ++i) {
+        uint64_t stream_id;
+        if (!parser.Read(&stream_id)) return false;
+        pmu_counter_switch_ids_.insert(stream_id);
+      }
+      return true;
+    }
+
+    case RecordFileEntryType::kGpuTracepointIds: {
+      int amdgpu_cs_ioctl_id;
+      int amdgpu_sched_run_job_id;
+      int dma_fence_signaled_id;
+      if (!parser.Read(&amdgpu_cs_ioctl_id) ||
+          !parser.Read(&amdgpu_sched_run_job_id) ||
+          !parser.Read(&dma_fence_signaled_id)) {
+        return false;
+      }
+      gpu_event_processor_ = std::make_shared<GpuTracepointEventProcessor>(
+          amdgpu_cs_ioctl_id, amdgpu_sched_run_job_id, dma_fence_signaled_id);
+      gpu_event_processor_->SetListener(listener_);
+      return true;
+    }
+
+    case RecordFileEntryType::kThreads: {
+      // The last entry of the setup of the capture, after the initial maps.
+      CreateUprobesEventProcessor(state->initial_maps_per_pid);
+      for (const auto& fd_and_watermark : uprobes_event_processor_watermarks_) {
+        uprobes_event_processor_->AddOriginFileDescriptor(
+            fd_and_watermark.first);
+      }
+      pid_t tid;
+      while (parser.Read(&tid)) {
+        if (trace_thread_states_ || trace_off_cpu_callstacks_) {
+          thread_state_tids_.insert(tid);
+        }
+        listener_->OnTid(tid);
+      }
+      return true;
+    }
+
+    case RecordFileEntryType::kMaps: {
+      int fd;
+      pid_t pid;
+      uint64_t timestamp_ns;
+      std::string maps;
+      if (!parser.Read(&fd) || !parser.Read(&pid) ||
+          !parser.Read(&timestamp_ns) || !parser.ReadString(&maps)) {
+        return false;
+      }
+      state->timestamp_ns = std::max(state->timestamp_ns, timestamp_ns);
+      if (fd == -1) {
+        // The maps at the beginning of the capture.
+        state->initial_maps_per_pid.insert_or_assign(pid, std::move(maps));
+        return true;
+      }
+      auto maps_event =
+          std::make_unique<MapsPerfEvent>(timestamp_ns, pid, std::move(maps));
+      maps_event->SetOriginFileDescriptor(fd);
+      DeferEvent(std::move(maps_event));
+      return true;
+    }
+
+    case RecordFileEntryType::kBuildId: {
+      std::string path;
+      std::string build_id;
+      if (!parser.ReadString(&path) || !parser.ReadString(&build_id)) {
+        return false;
+      }
+      std::string local_build_id = ReadElfBuildId(path);
+      if (local_build_id != build_id) {
+        ERROR(
+            "%s has build id \"%s\" instead of \"%s\" when recorded: its "
+            "callstacks will not be unwound correctly",
+            path.c_str(), local_build_id.c_str(), build_id.c_str());
+      }
+      return true;
+    }
+
+    case RecordFileEntryType::kRecord: {
+      int fd;
+      absl::Span<const uint8_t> record;
+      if (!parser.Read(&fd) || !parser.ReadBytes(&record) ||
+          record.size() < sizeof(perf_event_header) ||
+          uprobes_event_processor_ == nullptr) {
+        return false;
+      }
+      auto index_it = state->ring_buffer_indices.find(fd);
+      if (index_it == state->ring_buffer_indices.end()) {
+        return false;
+      }
+      PerfEventRingBuffer* ring_buffer = &ring_buffers_[index_it->second];
+      ring_buffer->WriteRecord(record);
+      ReadAndProcessRecord(ring_buffer);
+      if (++state->record_count % REPLAY_DEFERRED_EVENTS_BATCH_SIZE == 0) {
+        AddReplayedDeferredEvents();
+        uprobes_event_processor_->ProcessOldEvents(state->timestamp_ns);
+        batching_listener_->Flush();
+      }
+      return true;
+    }
+
+    case RecordFileEntryType::kWatermark: {
+      int fd;
+      uint64_t watermark;
+      if (!parser.Read(&fd) || !parser.Read(&watermark) ||
+          uprobes_event_processor_ == nullptr) {
+        return false;
+      }
+      // The events deferred before the watermark was recorded first.
+      AddReplayedDeferredEvents();
+      uprobes_event_processor_->AdvanceWatermark(fd, watermark);
+      state->timestamp_ns =
+          std::max(state->timestamp_ns,
+                   watermark + EMPTY_RING_BUFFER_WATERMARK_MARGIN_NS);
+      uprobes_event_processor_->ProcessOldEvents(state->timestamp_ns);
+      batching_listener_->Flush();
+      return true;
+    }
+  }
+  return false;
+}
+
+void TracerThread::AddReplayedDeferredEvents() {
+  for (auto& event : ConsumeDeferredEvents()) {
+    int fd = event->GetOriginFileDescriptor();
+    uprobes_event_processor_->AddEvent(fd, std::move(event));
+  }
+}
+
+void TracerThread::ComputeCpus(std::vector<int32_t>* all_cpus,
+                               std::vector<int32_t>* cpuset_cpus) const {
+  // perf_event_open refers to cores as "CPUs".
+
+  // Record context switches from all cores for all processes.
+  all_cpus->clear();
+  for (int32_t cpu = 0; cpu < GetNumCores(); ++cpu) {
+    all_cpus->push_back(cpu);
+  }
+
+  // Record calls to dynamically instrumented functions and sample only on cores
+  // in the cpusets of the cgroups of the processes, as these are the only cores
+  // the processes will be scheduled on.
+  cpuset_cpus->clear();
+  for (pid_t pid : pids_) {
+    std::vector<int32_t> pid_cpuset_cpus = GetCpusetCpus(pid);
+    if (pid_cpuset_cpus.empty()) {
+      cpuset_cpus->clear();
+      break;
+    }
+    cpuset_cpus->insert(cpuset_cpus->end(), pid_cpuset_cpus.begin(),
+                        pid_cpuset_cpus.end());
+  }
+  std::sort(cpuset_cpus->begin(), cpuset_cpus->end());
+  cpuset_cpus->erase(std::unique(cpuset_cpus->begin(), cpuset_cpus->end()),
+                     cpuset_cpus->end());
+  if (cpuset_cpus->empty()) {
+    ERROR("Could not read cpuset");
+    *cpuset_cpus = *all_cpus;
+  }
+}
+
+void TracerThread::ComputeRingBufferSizeShift(
+    const std::vector<int32_t>& all_cpus,
+    const std::vector<int32_t>& cpuset_cpus) {
+  if (ring_buffers_memory_budget_kb_ == 0) {
+    return;
+  }
+  uint64_t default_total_size_kb =
+      MMAP_TASK_RING_BUFFER_SIZE_KB * cpuset_cpus.size();
+  if (trace_context_switches_) {
+    default_total_size_kb +=
+        CONTEXT_SWITCHES_RING_BUFFER_SIZE_KB * all_cpus.size();
+  }
+  if (trace_instrumented_functions_ && !instrumented_functions_.empty()) {
+    default_total_size_kb += UPROBES_RING_BUFFER_SIZE_KB * cpuset_cpus.size();
+    if (bpf_function_calls_) {
+      default_total_size_kb +=
+          BPF_FUNCTION_CALLS_RING_BUFFER_SIZE_KB * cpuset_cpus.size();
+    }
+  }
+  if (trace_callstacks_ && !bpf_stack_aggregation_) {
+    default_total_size_kb += SAMPLING_RING_BUFFER_SIZE_KB * cpuset_cpus.size();
+  }
+  if (trace_gpu_driver_events_) {
+    // Three tracepoints per core, see OpenGpuTracepoints.
+    uint64_t cs_ioctl_size_kb = trace_gpu_submission_callstacks_
+                                    ? GPU_SUBMISSION_RING_BUFFER_SIZE_KB
+                                    : GPU_TRACING_RING_BUFFER_SIZE_KB;
+    default_total_size_kb +=
+        (2 * GPU_TRACING_RING_BUFFER_SIZE_KB + cs_ioctl_size_kb) *
+        all_cpus.size();
+  }
+  if (trace_thread_states_) {
+    // Three tracepoints per core, see OpenThreadStateTracepoints.
+    default_total_size_kb +=
+        3 * THREAD_STATE_RING_BUFFER_SIZE_KB * all_cpus.size();
+  }
+  if (trace_off_cpu_callstacks_) {
+    default_total_size_kb += OFF_CPU_RING_BUFFER_SIZE_KB * cpuset_cpus.size();
+  }
+  if (trace_file_io_) {
+    default_total_size_kb +=
+        BPF_FILE_IO_RING_BUFFER_SIZE_KB * cpuset_cpus.size();
+  }
+  ComputeRingBufferSizeShift(default_total_size_kb);
+}
+
+void TracerThread::ComputeRingBufferSizeShift(uint64_t default_total_size_kb) {
+  // Ring buffers can't be smaller than one page, so the budget might not
+  // be met when it is very small.
+  constexpr uint32_t MAX_RING_BUFFER_SIZE_SHIFT = 16;
+  ring_buffer_size_shift_ = 0;
+  while ((default_total_size_kb >> ring_buffer_size_shift_) >
+             ring_buffers_memory_budget_kb_ &&
+         ring_buffer_size_shift_ < MAX_RING_BUFFER_SIZE_SHIFT) {
+    ++ring_buffer_size_shift_;
+  }
+  if (ring_buffer_size_shift_ > 0) {
+    LOG("Ring buffers reduced by a factor of %u to fit in %lu KB",
+        1u << ring_buffer_size_shift_, ring_buffers_memory_budget_kb_);
+  }
+}
+
+uint64_t TracerThread::ScaledRingBufferSizeKb(uint64_t default_size_kb) const {
+  uint64_t page_size_kb = getpagesize() / 1024;
+  return std::max(default_size_kb >> ring_buffer_size_shift_, page_size_kb);
+}
+
+PrewarmedRingBuffers::Key TracerThread::GetPerCpuEventKey(PerCpuEvent event,
+                                                         int32_t cpu) const {
+  switch (event) {
+    case PerCpuEvent::kContextSwitch:
+      return {"context_switch", cpu,
+              ScaledRingBufferSizeKb(CONTEXT_SWITCHES_RING_BUFFER_SIZE_KB), 0};
+    case PerCpuEvent::kMmapTask:
+      return {"mmap_task", cpu,
+              ScaledRingBufferSizeKb(MMAP_TASK_RING_BUFFER_SIZE_KB), 0};
+    case PerCpuEvent::kSampling:
+      return {sample_callchains_ ? "callchain_sampling" : "sampling", cpu,
+              ScaledRingBufferSizeKb(SAMPLING_RING_BUFFER_SIZE_KB),
+              sampling_period_ns_};
+  }
+  return {};
+}
+
+std::optional<PerfEventRingBuffer> TracerThread::OpenPerCpuEvent(
+    PerCpuEvent event, int32_t cpu) const {
+  int fd = -1;
+  const char* name = "";
+  switch (event) {
+    case PerCpuEvent::kContextSwitch:
+      fd = context_switch_event_open(-1, cpu);
+      name = "context_switch";
+      break;
+    case PerCpuEvent::kMmapTask:
+      fd = mmap_task_event_open(-1, cpu);
+      name = "mmap_task";
+      break;
+    case PerCpuEvent::kSampling:
+      fd = sample_callchains_
+               ? callchain_sample_event_open(sampling_period_ns_, -1, cpu)
+               : sample_event_open(sampling_period_ns_, -1, cpu);
+      name = "sampling";
+      break;
+  }
+  if (fd < 0) {
+    return std::nullopt;
+  }
+
+  std::string buffer_name = absl::StrFormat("%s_%u", name, cpu);
+  PerfEventRingBuffer ring_buffer{
+      fd, GetPerCpuEventKey(event, cpu).size_kb, buffer_name};
+  if (!ring_buffer.IsOpen()) {
+    close(fd);
+    return std::nullopt;
+  }
+  return ring_buffer;
+}
+
+std::vector<int> TracerThread::OpenPerCpuEvents(
+    PerCpuEvent event, const std::vector<int32_t>& cpus, bool* errors) {
+  std::vector<std::optional<PerfEventRingBuffer>> ring_buffers(cpus.size());
+  std::vector<size_t> not_prewarmed;
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    ring_buffers[i] =
+        PrewarmedRingBuffers::Get().Take(GetPerCpuEventKey(event, cpus[i]));
+    if (!ring_buffers[i].has_value()) {
+      not_prewarmed.push_back(i);
+    }
+  }
+  RunInParallel(not_prewarmed.size(), MAX_SETUP_THREADS, [&](size_t i) {
+    size_t cpu_index = not_prewarmed[i];
+    ring_buffers[cpu_index] = OpenPerCpuEvent(event, cpus[cpu_index]);
+  });
+
+  std::vector<int> fds;
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    if (!ring_buffers[i].has_value()) {
+      *errors = true;
+      continue;
+    }
+    int fd = ring_buffers[i]->GetFileDescriptor();
+    tracing_fds_.push_back(fd);
+    ring_buffers_.push_back(std::move(ring_buffers[i].value()));
+    ring_buffer_fds_to_cpu_.emplace(fd, cpus[i]);
+    fds.push_back(fd);
+  }
+  return fds;
+}
+
+uint64_t TracerThread::Prewarm() {
+  std::vector<int32_t> all_cpus;
+  std::vector<int32_t> cpuset_cpus;
+  ComputeCpus(&all_cpus, &cpuset_cpus);
+  ComputeRingBufferSizeShift(all_cpus, cpuset_cpus);
+
+  // The same per-core events as Run, see there.
+  std::vector<std::pair<PerCpuEvent, int32_t>> events;
+  if (trace_context_switches_) {
+    for (int32_t cpu : all_cpus) {
+      events.emplace_back(PerCpuEvent::kContextSwitch, cpu);
+    }
+  }
+  for (int32_t cpu : cpuset_cpus) {
+    events.emplace_back(PerCpuEvent::kMmapTask, cpu);
+  }
+  if (trace_callstacks_ && !bpf_stack_aggregation_) {
+    for (int32_t cpu : cpuset_cpus) {
+      events.emplace_back(PerCpuEvent::kSampling, cpu);
+    }
+  }
+
+  std::vector<std::optional<PerfEventRingBuffer>> ring_buffers(events.size());
+  RunInParallel(events.size(), MAX_SETUP_THREADS, [&](size_t i) {
+    ring_buffers[i] = OpenPerCpuEvent(events[i].first, events[i].second);
+  });
+
+  std::vector<std::pair<PrewarmedRingBuffers::Key, PerfEventRingBuffer>>
+      prewarmed;
+  for (size_t i = 0; i < events.size(); ++i) {
+    if (ring_buffers[i].has_value()) {
+      prewarmed.emplace_back(
+          GetPerCpuEventKey(events[i].first, events[i].second),
+          std::move(ring_buffers[i].value()));
+    }
+  }
+  LOG("Prewarmed %lu of %lu ring buffers", prewarmed.size(), events.size());
+  return PrewarmedRingBuffers::Get().Put(std::move(prewarmed));
+}
+
+void TracerThread::AdaptRingBuffer(PerfEventRingBuffer* ring_buffer,
+                                   RingBufferAdaptationState* state) {
+  int fd = ring_buffer->GetFileDescriptor();
+  auto lost_count_it = lost_count_per_ring_buffer_fd_.find(fd);
+  if (lost_count_it == lost_count_per_ring_buffer_fd_.end() ||
+      lost_count_it->second.exchange(0) == 0) {
+    state->lossy_period_count = 0;
+    return;
+  }
+  ++state->lossy_period_count;
+
+  if (GrowRingBuffer(ring_buffer)) {
+    return;
+  }
+
+  // The ring buffer can't grow, so reduce the rate of samples instead.
+  if (!sampling_fds_.contains(fd) ||
+      state->lossy_period_count < LOSSY_PERIODS_BEFORE_THROTTLING ||
+      state->sampling_period_ns >=
+          MAX_SAMPLING_PERIOD_MULTIPLIER * sampling_period_ns_) {
+    return;
+  }
+  state->sampling_period_ns *= 2;
+  state->lossy_period_count = 0;
+  {
+    // The event recording to the ring buffer might have been replaced by
+    // RetuneStackDumpSizeIfTimerElapsed.
+    std::lock_guard<std::mutex> lock{active_sampling_events_mutex_};
+    auto active_it = active_sampling_events_per_ring_buffer_fd_.find(fd);
+    if (active_it != active_sampling_events_per_ring_buffer_fd_.end()) {
+      active_it->second.period_ns = state->sampling_period_ns;
+      perf_event_set_period(active_it->second.fd, state->sampling_period_ns);
+    } else {
+      perf_event_set_period(fd, state->sampling_period_ns);
+    }
+  }
+  LOG("Persistent losses in %s: sampling period increased to %lu ns",
+      ring_buffer->GetName().c_str(), state->sampling_period_ns);
+}
+
+bool TracerThread::GrowRingBuffer(PerfEventRingBuffer* ring_buffer) {
+  uint64_t size_kb = ring_buffer->GetSizeKb();
+  // Reserve the additional memory from the budget.
+  uint64_t total_size_kb = ring_buffers_total_size_kb_.load();
+  do {
+    if (total_size_kb + size_kb > ring_buffers_memory_budget_kb_) {
+      return false;
+    }
+  } while (!ring_buffers_total_size_kb_.compare_exchange_weak(
+      total_size_kb, total_size_kb + size_kb));
+
+  // The records still in the ring buffer would be lost by the resize.
+  while (ring_buffer->HasNewData()) {
+    ReadAndProcessRecord(ring_buffer);
+  }
+  int fd = ring_buffer->GetFileDescriptor();
+  bool resized;
+  {
+    // Functions instrumented during the capture must not be redirected to
+    // this ring buffer while it is being replaced.
+    std::lock_guard<std::mutex> lock{uprobes_redirect_mutex_};
+    resized = ring_buffer->Resize(2 * size_kb);
+    if (!resized) {
+      ring_buffers_total_size_kb_ -= size_kb;
+      if (!ring_buffer->IsOpen()) {
+        ring_buffers_total_size_kb_ -= size_kb;
+        return false;
+      }
+    }
+
+    auto redirected_fds_it = redirected_fds_per_ring_buffer_fd_.find(fd);
+    if (redirected_fds_it != redirected_fds_per_ring_buffer_fd_.end()) {
+      for (int redirected_fd : redirected_fds_it->second) {
+        perf_event_redirect(redirected_fd, fd);
+      }
+    }
+  }
+  if (mmap_task_fds_.contains(fd)) {
+    // Mmap records might have been lost while the ring buffer was replaced.
+    DeferMapsEvent(fd, MonotonicTimestampNs());
+  }
+
+  if (resized) {
+    LOG("Lost events in %s: ring buffer resized to %lu KB",
+        ring_buffer->GetName().c_str(), ring_buffer->GetSizeKb());
+  }
+  return resized;
+}
+
+void TracerThread::CreateSampledThreadFilter(
+    const std::vector<int>& sampling_fds) {
+  sampled_thread_filter_ =
+      std::make_unique<SampledThreadFilter>(sampled_threads_);
+  // Before the sampling events are enabled, the threads spawned or renamed
+  // since then are added by ProcessForkEvent and ProcessCommEvent.
+  for (pid_t pid : pids_) {
+    for (pid_t tid : ListThreads(pid)) {
+      std::optional<std::string> comm =
+          ReadFile(absl::StrFormat("/proc/%d/task/%d/comm", pid, tid));
+      if (comm.has_value()) {
+        sampled_thread_filter_->OnName(
+            tid, std::string{absl::StripTrailingAsciiWhitespace(comm.value())});
+      }
+    }
+  }
+
+  if (!sampled_thread_filter_->LoadBpfProgram()) {
+    LOG("Could not load the eBPF program to filter the sampled threads, the "
+        "samples of the other threads are dropped as they are read instead");
+    return;
+  }
+  for (int fd : sampling_fds) {
+    sampled_thread_filter_->Attach(fd);
+  }
+}
+
+void TracerThread::RetuneStackDumpSizeIfTimerElapsed() {
+  if (stack_dump_size_tuner_ == nullptr ||
+      MonotonicTimestampNs() < next_stack_dump_retune_ns_) {
+    return;
+  }
+  next_stack_dump_retune_ns_ =
+      MonotonicTimestampNs() + STACK_DUMP_RETUNE_PERIOD_NS;
+  std::optional<uint16_t> stack_size = stack_dump_size_tuner_->Retune();
+  if (!stack_size.has_value()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock{active_sampling_events_mutex_};
+  for (auto& [ring_buffer_fd, active] :
+       active_sampling_events_per_ring_buffer_fd_) {
+    int32_t cpu = ring_buffer_fds_to_cpu_.at(ring_buffer_fd);
+    int fd = sample_event_open(active.period_ns, -1, cpu, *stack_size);
+    if (fd < 0) {
+      ERROR("Opening sampling event with stack dumps of %u bytes on cpu %d",
+            *stack_size, cpu);
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> redirect_lock{uprobes_redirect_mutex_};
+      perf_event_redirect(fd, ring_buffer_fd);
+      redirected_fds_per_ring_buffer_fd_[ring_buffer_fd].push_back(fd);
+    }
+    if (sampled_thread_filter_ != nullptr) {
+      sampled_thread_filter_->Attach(fd);
+    }
+    // Briefly both or neither, which is not noticeable among the samples.
+    perf_event_enable(fd);
+    perf_event_disable(active.fd);
+    tracing_fds_.push_back(fd);
+
+    if (active.fd != ring_buffer_fd) {
+      // The ring buffer's own event stays open, but not the previous ones.
+      {
+        std::lock_guard<std::mutex> redirect_lock{uprobes_redirect_mutex_};
+        std::vector<int>& redirected_fds =
+            redirected_fds_per_ring_buffer_fd_[ring_buffer_fd];
+        redirected_fds.erase(std::find(redirected_fds.begin(),
+                                       redirected_fds.end(), active.fd));
+      }
+      tracing_fds_.erase(
+          std::find(tracing_fds_.begin(), tracing_fds_.end(), active.fd));
+      close(active.fd);
+    }
+    active.fd = fd;
+  }
+  LOG("Sampling with user stack dumps of %u bytes", *stack_size);
+}
+
+bool TracerThread::OpenUprobes(const Function& function,
+                               const std::vector<int32_t>& cpus,
+                               bool create_ring_buffers) {
+  if (!create_ring_buffers && !UsesBpfUprobes(function)) {
+    for (int32_t cpu : cpus) {
+      if (!uprobes_ring_buffer_fds_per_cpu_.contains(cpu)) {
+        ERROR("No uprobes ring buffer for cpu %d", cpu);
+        return false;
+      }
+    }
+  }
+
+  UprobesFds fds;
+  if (!OpenUprobesFds(function, cpus, &fds)) {
+    return false;
+  }
+  AddUprobes(function, cpus, fds);
+  return true;
+}
+
+bool TracerThread::OpenUprobesFds(const Function& function,
+                                  const std::vector<int32_t>& cpus,
+                                  UprobesFds* fds) const {
+  absl::flat_hash_map<int32_t, int>& function_uprobes_fds_per_cpu =
+      fds->uprobes_fds_per_cpu;
+  absl::flat_hash_map<int32_t, int>& function_uretprobes_fds_per_cpu =
+      fds->uretprobes_fds_per_cpu;
+  bool function_uprobes_open_error = false;
+
+  for (int32_t cpu : cpus) {
+    int uprobes_fd = -1;
+    switch (function.GetRecordingMode()) {
+      case Function::RecordingMode::kTimingAndCallstack:
+        uprobes_fd = uprobes_stack_event_open(function.BinaryPath().c_str(),
+                                              function.FileOffset(), -1, cpu);
+        break;
+      case Function::RecordingMode::kTimingOnly:
+        uprobes_fd = uprobes_regs_event_open(function.BinaryPath().c_str(),
+                                             function.FileOffset(),
+                                             /*with_arguments=*/false, -1, cpu);
+        break;
+      case Function::RecordingMode::kTimingAndArguments:
+        uprobes_fd = uprobes_regs_event_open(function.BinaryPath().c_str(),
+                                             function.FileOffset(),
+                                             /*with_arguments=*/true, -1, cpu);
+        break;
+      case Function::RecordingMode::kTimingAndPmuCounters:
+        // Without the counters, the function is recorded as kTimingOnly.
+        if (!RecordsPmuCounters(function)) {
+          uprobes_fd = uprobes_regs_event_open(
+              function.BinaryPath().c_str(), function.FileOffset(),
+              /*with_arguments=*/false, -1, cpu);
+        } else {
+          uprobes_fd = uprobes_pmu_counters_event_open(
+              function.BinaryPath().c_str(), function.FileOffset(), cpu,
+              pmu_counter_group_fds_per_cpu_.at(cpu));
+        }
+        break;
+    }
+    if (uprobes_fd < 0) {
+      function_uprobes_open_error = true;
+      break;
+    }
+    function_uprobes_fds_per_cpu.emplace(cpu, uprobes_fd);
+
+    int uretprobes_fd =
+        RecordsPmuCounters(function)
+            ? uretprobes_pmu_counters_event_open(
+                  function.BinaryPath().c_str(), function.FileOffset(), cpu,
+                  pmu_counter_group_fds_per_cpu_.at(cpu))
+            : uretprobes_event_open(function.BinaryPath().c_str(),
+                                    function.FileOffset(), -1, cpu);
+    if (uretprobes_fd < 0) {
+      function_uprobes_open_error = true;
+      break;
+    }
+    function_uretprobes_fds_per_cpu.emplace(cpu, uretprobes_fd);
+  }
+
+  if (function_uprobes_open_error) {
+    ERROR("Opening u(ret)probes for function at %#016lx",
+          function.VirtualAddress());
+    for (const auto& uprobes_fd : function_uprobes_fds_per_cpu) {
+      close(uprobes_fd.second);
+    }
+    for (const auto& uretprobes_fd : function_uretprobes_fds_per_cpu) {
+      close(uretprobes_fd.second);
+    }
+    return false;
+  }
+  return true;
+}
+
+void TracerThread::AddUprobes(const Function& function,
+                              const std::vector<int32_t>& cpus,
+                              const UprobesFds& fds) {
+  if (UsesBpfUprobes(function) && AttachBpfUprobes(function, fds)) {
+    return;
+  }
+
+  const absl::flat_hash_map<int32_t, int>& function_uprobes_fds_per_cpu =
+      fds.uprobes_fds_per_cpu;
+  const absl::flat_hash_map<int32_t, int>& function_uretprobes_fds_per_cpu =
+      fds.uretprobes_fds_per_cpu;
+
+  // Add function_uretprobes_fds_per_cpu to tracing_fds_ before
+  // function_uprobes_fds_per_cpu. As we support having uretprobes without
+  // associated uprobes, but not the opposite, this way the uretprobe is
+  // enabled before the uprobe.
+  InstrumentedFunctionFds& function_fds =
+      instrumented_function_fds_[function.VirtualAddress()];
+  for (const auto& uretprobes_fd : function_uretprobes_fds_per_cpu) {
+    tracing_fds_.push_back(uretprobes_fd.second);
+    function_fds.uretprobes_fds.push_back(uretprobes_fd.second);
+  }
+  for (const auto& uprobes_fd : function_uprobes_fds_per_cpu) {
+    tracing_fds_.push_back(uprobes_fd.second);
+    function_fds.uprobes_fds.push_back(uprobes_fd.second);
+  }
+
+  // Record the association between the stream_id and the function.
+  {
+    std::unique_lock<std::shared_mutex> lock{uprobes_ids_to_function_mutex_};
+    for (const auto& uprobes_fd : function_uprobes_fds_per_cpu) {
+      uprobes_ids_to_function_.emplace(perf_event_get_id(uprobes_fd.second),
+                                       &function);
+    }
+    for (const auto& uretprobes_fd : function_uretprobes_fds_per_cpu) {
+      uint64_t stream_id = perf_event_get_id(uretprobes_fd.second);
+      uprobes_ids_to_function_.emplace(stream_id, &function);
+      uretprobes_ids_.insert(stream_id);
+    }
+  }
+  if (record_file_writer_ != nullptr) {
+    RecordFileEntryBuilder entry;
+    entry.AddString(function.BinaryPath())
+        .Add(function.FileOffset())
+        .Add(function.VirtualAddress())
+        .Add(function.GetRecordingMode());
+    for (const auto& uprobes_fd : function_uprobes_fds_per_cpu) {
+      entry.Add(perf_event_get_id(uprobes_fd.second)).Add(false);
+    }
+    for (const auto& uretprobes_fd : function_uretprobes_fds_per_cpu) {
+      entry.Add(perf_event_get_id(uretprobes_fd.second)).Add(true);
+    }
+    record_file_writer_->Write(RecordFileEntryType::kUprobes, entry);
+  }
+
+  // Redirect all uprobes and uretprobes on the same cpu to a single ring
+  // buffer to reduce the number of ring buffers.
+  std::lock_guard<std::mutex> lock{uprobes_redirect_mutex_};
+  for (int32_t cpu : cpus) {
+    int uprobes_fd = function_uprobes_fds_per_cpu.at(cpu);
+    int uretprobes_fd = function_uretprobes_fds_per_cpu.at(cpu);
+    if (uprobes_ring_buffer_fds_per_cpu_.contains(cpu)) {
+      // Redirect to the already opened ring buffer.
+      int ring_buffer_fd = uprobes_ring_buffer_fds_per_cpu_.at(cpu);
+      perf_event_redirect(uprobes_fd, ring_buffer_fd);
+      perf_event_redirect(uretprobes_fd, ring_buffer_fd);
+      redirected_fds_per_ring_buffer_fd_[ring_buffer_fd].push_back(uprobes_fd);
+      redirected_fds_per_ring_buffer_fd_[ring_buffer_fd].push_back(
+          uretprobes_fd);
+    } else {
+      // No ring buffer has yet been created for this cpu, as this is the
+      // first uprobes to have been opened successfully. Hence, create a
+      // ring buffer for this cpu associated to uprobes_fd and redirect the
+      // uretprobes to it. The other uprobes and uretprobes for this cpu
+      // will be redirected to this ring buffer.
+      int ring_buffer_fd = uprobes_fd;
+      std::string buffer_name = absl::StrFormat("uprobes_uretprobes_%u", cpu);
+      ring_buffers_.emplace_back(
+          ring_buffer_fd, ScaledRingBufferSizeKb(UPROBES_RING_BUFFER_SIZE_KB),
+          buffer_name);
+      uprobes_ring_buffer_fds_per_cpu_[cpu] = ring_buffer_fd;
+      ring_buffer_fds_to_cpu_.emplace(ring_buffer_fd, cpu);
+      uprobes_fds_.emplace(ring_buffer_fd);
+      uprobes_event_processor_watermarks_.try_emplace(ring_buffer_fd, 0);
+      // Must be called after the ring buffer has been opened.
+      perf_event_redirect(uretprobes_fd, ring_buffer_fd);
+      redirected_fds_per_ring_buffer_fd_[ring_buffer_fd].push_back(
+          uretprobes_fd);
+    }
+  }
+}
+
+bool TracerThread::OpenBpfUprobes(const std::vector<int32_t>& cpus) {
+  if (cpus.empty()) {
+    return false;
+  }
+  std::unique_ptr<BpfUprobes> bpf_uprobes =
+      BpfUprobes::Create(std::vector<pid_t>(pids_.begin(), pids_.end()),
+                         *std::max_element(cpus.begin(), cpus.end()));
+  if (bpf_uprobes == nullptr) {
+    return false;
+  }
+
+  std::vector<int> output_fds;
+  std::vector<PerfEventRingBuffer> ring_buffers;
+  for (int32_t cpu : cpus) {
+    int fd = bpf_output_event_open(cpu);
+    if (fd < 0) {
+      CloseFileDescriptors(output_fds);
+      return false;
+    }
+    output_fds.push_back(fd);
+    PerfEventRingBuffer ring_buffer{
+        fd, ScaledRingBufferSizeKb(BPF_FUNCTION_CALLS_RING_BUFFER_SIZE_KB),
+        absl::StrFormat("bpf_function_calls_%u", cpu)};
+    if (!ring_buffer.IsOpen() || !bpf_uprobes->SetOutput(cpu, fd)) {
+      CloseFileDescriptors(output_fds);
+      return false;
+    }
+    ring_buffers.push_back(std::move(ring_buffer));
+  }
+
+  // The bpf-output events come before the u(ret)probes in tracing_fds_, so
+  // that they are enabled first.
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    tracing_fds_.push_back(output_fds[i]);
+    bpf_function_calls_fds_.insert(output_fds[i]);
+    ring_buffer_fds_to_cpu_.emplace(output_fds[i], cpus[i]);
+    ring_buffers_.push_back(std::move(ring_buffers[i]));
+  }
+  bpf_uprobes_ = std::move(bpf_uprobes);
+  return true;
+}
+
+bool TracerThread::OpenBpfFileIo(const std::vector<int32_t>& cpus) {
+  if (cpus.empty()) {
+    return false;
+  }
+  std::unique_ptr<BpfFileIo> bpf_file_io =
+      BpfFileIo::Create(std::vector<pid_t>(pids_.begin(), pids_.end()),
+                        *std::max_element(cpus.begin(), cpus.end()));
+  if (bpf_file_io == nullptr) {
+    return false;
+  }
+
+  std::vector<int> output_fds;
+  std::vector<PerfEventRingBuffer> ring_buffers;
+  for (int32_t cpu : cpus) {
+    int fd = bpf_output_event_open(cpu);
+    if (fd < 0) {
+      CloseFileDescriptors(output_fds);
+      return false;
+    }
+    output_fds.push_back(fd);
+    PerfEventRingBuffer ring_buffer{
+        fd, ScaledRingBufferSizeKb(BPF_FILE_IO_RING_BUFFER_SIZE_KB),
+        absl::StrFormat("bpf_file_io_%u", cpu)};
+    if (!ring_buffer.IsOpen() || !bpf_file_io->SetOutput(cpu, fd)) {
+      CloseFileDescriptors(output_fds);
+      return false;
+    }
+    ring_buffers.push_back(std::move(ring_buffer));
+  }
+  std::vector<int> tracepoint_fds;
+  if (!bpf_file_io->OpenTracepoints(&tracepoint_fds)) {
+    CloseFileDescriptors(output_fds);
+    return false;
+  }
+
+  // The bpf-output events come before the tracepoints in tracing_fds_, so
+  // that they are enabled first.
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    tracing_fds_.push_back(output_fds[i]);
+    bpf_file_io_fds_.insert(output_fds[i]);
+    ring_buffer_fds_to_cpu_.emplace(output_fds[i], cpus[i]);
+    ring_buffers_.push_back(std::move(ring_buffers[i]));
+  }
+  tracing_fds_.insert(tracing_fds_.end(), tracepoint_fds.begin(),
+                      tracepoint_fds.end());
+  bpf_file_io_ = std::move(bpf_file_io);
+  return true;
+}
+
+// The heap allocations of the target processes are sampled by the programs of
+// a BpfHeapProfiler, on the u(ret)probes of the allocator of each process.
+// The allocator is usually the libc shared by all processes, so the probes
+// are opened for all processes, and the programs drop the records of the other
+// processes, as well as of the allocations that are not sampled. The uprobes
+// of the allocation functions on a cpu share a ring buffer, for the stacks of
+// the sampled allocations, and the records of the programs go to the
+// bpf-output event of the cpu. Both are deferred, so that the stacks are
+// unwound with the maps of their time and joined with the records of the
+// returns of the allocations, which are ordered with the frees.
+// This method returns true on success, otherwise false.
+bool TracerThread::OpenHeapProfiler(
+    const std::vector<int32_t>& cpus,
+    const absl::flat_hash_map<pid_t, std::string>& initial_maps_per_pid) {
+  if (cpus.empty()) {
+    return false;
+  }
+  // The processes with the same allocator share its probes.
+  absl::flat_hash_map<std::string, BpfHeapProfiler::Allocator> allocators;
+  for (const auto& [pid, initial_maps] : initial_maps_per_pid) {
+    std::optional<BpfHeapProfiler::Allocator> allocator =
+        BpfHeapProfiler::FindAllocator(initial_maps);
+    if (!allocator.has_value()) {
+      ERROR("No allocator found in the maps of process %d", pid);
+      continue;
+    }
+    allocators.try_emplace(allocator->path, std::move(allocator.value()));
+  }
+  if (allocators.empty()) {
+    return false;
+  }
+  std::unique_ptr<BpfHeapProfiler> bpf_heap_profiler = BpfHeapProfiler::Create(
+      std::vector<pid_t>(pids_.begin(), pids_.end()),
+      *std::max_element(cpus.begin(), cpus.end()),
+      heap_sampling_interval_bytes_);
+  if (bpf_heap_profiler == nullptr) {
+    return false;
+  }
+
+  // All the file descriptors opened, to close them on error.
+  std::vector<int> opened_fds;
+  std::vector<int> output_fds;
+  std::vector<PerfEventRingBuffer> ring_buffers;
+  for (int32_t cpu : cpus) {
+    int fd = bpf_output_event_open(cpu);
+    if (fd < 0) {
+      CloseFileDescriptors(opened_fds);
+      return false;
+    }
+    opened_fds.push_back(fd);
+    output_fds.push_back(fd);
+    PerfEventRingBuffer ring_buffer{
+        fd, ScaledRingBufferSizeKb(BPF_HEAP_RECORDS_RING_BUFFER_SIZE_KB),
+        absl::StrFormat("bpf_heap_records_%u", cpu)};
+    if (!ring_buffer.IsOpen() || !bpf_heap_profiler->SetOutput(cpu, fd)) {
+      CloseFileDescriptors(opened_fds);
+      return false;
+    }
+    ring_buffers.push_back(std::move(ring_buffer));
+  }
+
+  // The programs of the uretprobes and of the uprobes of free run whatever
+  // the cpu of the probe, so these are opened once.
+  std::vector<int> return_and_free_fds;
+  std::vector<int> allocation_fds;
+  absl::flat_hash_map<int32_t, int> stack_ring_buffer_fds_per_cpu;
+  absl::flat_hash_map<int, std::vector<int>> redirected_fds_per_ring_buffer_fd;
+  for (const auto& [path, allocator] : allocators) {
+    using AllocationFunction = BpfHeapProfiler::AllocationFunction;
+    const std::pair<uint64_t, AllocationFunction> offsets_and_functions[] = {
+        {allocator.malloc_offset, AllocationFunction::kMalloc},
+        {allocator.calloc_offset, AllocationFunction::kCalloc},
+        {allocator.realloc_offset, AllocationFunction::kRealloc},
+    };
+    for (const auto& [offset, function] : offsets_and_functions) {
+      if (offset == 0) {
+        continue;
+      }
+      int uretprobes_fd =
+          uretprobes_event_open(path.c_str(), offset, -1, cpus[0]);
+      if (uretprobes_fd < 0) {
+        CloseFileDescriptors(opened_fds);
+        return false;
+      }
+      opened_fds.push_back(uretprobes_fd);
+      return_and_free_fds.push_back(uretprobes_fd);
+      if (!bpf_heap_profiler->AttachAllocationUretprobes(uretprobes_fd)) {
+        CloseFileDescriptors(opened_fds);
+        return false;
+      }
+
+      for (int32_t cpu : cpus) {
+        int uprobes_fd =
+            uprobes_stack_event_open(path.c_str(), offset, -1, cpu);
+        if (uprobes_fd < 0) {
+          CloseFileDescriptors(opened_fds);
+          return false;
+        }
+        opened_fds.push_back(uprobes_fd);
+        allocation_fds.push_back(uprobes_fd);
+        if (!bpf_heap_profiler->AttachAllocationUprobes(uprobes_fd, function,
+                                                        cpu)) {
+          CloseFileDescriptors(opened_fds);
+          return false;
+        }
+        auto ring_buffer_fd_it = stack_ring_buffer_fds_per_cpu.find(cpu);
+        if (ring_buffer_fd_it != stack_ring_buffer_fds_per_cpu.end()) {
+          perf_event_redirect(uprobes_fd, ring_buffer_fd_it->second);
+          redirected_fds_per_ring_buffer_fd[ring_buffer_fd_it->second]
+              .push_back(uprobes_fd);
+          continue;
+        }
+        PerfEventRingBuffer ring_buffer{
+            uprobes_fd,
+            ScaledRingBufferSizeKb(HEAP_ALLOCATIONS_RING_BUFFER_SIZE_KB),
+            absl::StrFormat("heap_allocations_%u", cpu)};
+        if (!ring_buffer.IsOpen()) {
+          CloseFileDescriptors(opened_fds);
+          return false;
+        }
+        ring_buffers.push_back(std::move(ring_buffer));
+        stack_ring_buffer_fds_per_cpu.emplace(cpu, uprobes_fd);
+      }
+    }
+
+    int free_fd = uprobes_regs_event_open(path.c_str(), allocator.free_offset,
+                                          /*with_arguments=*/false, -1,
+                                          cpus[0]);
+    if (free_fd < 0) {
+      CloseFileDescriptors(opened_fds);
+      return false;
+    }
+    opened_fds.push_back(free_fd);
+    return_and_free_fds.push_back(free_fd);
+    if (!bpf_heap_profiler->AttachFreeUprobes(free_fd)) {
+      CloseFileDescriptors(opened_fds);
+      return false;
+    }
+  }
+
+  // The bpf-output events come first in tracing_fds_, and the uprobes of the
+  // allocation functions last, so that no allocation is sampled before its
+  // return and its free can be recorded.
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    bpf_heap_record_fds_.insert(output_fds[i]);
+    ring_buffer_fds_to_cpu_.emplace(output_fds[i], cpus[i]);
+    uprobes_event_processor_watermarks_.try_emplace(output_fds[i], 0);
+  }
+  for (const auto& [cpu, fd] : stack_ring_buffer_fds_per_cpu) {
+    heap_allocation_fds_.insert(fd);
+    ring_buffer_fds_to_cpu_.emplace(fd, cpu);
+    uprobes_event_processor_watermarks_.try_emplace(fd, 0);
+  }
+  {
+    std::lock_guard<std::mutex> lock{uprobes_redirect_mutex_};
+    for (auto& [fd, redirected_fds] : redirected_fds_per_ring_buffer_fd) {
+      std::vector<int>& all_redirected_fds =
+          redirected_fds_per_ring_buffer_fd_[fd];
+      all_redirected_fds.insert(all_redirected_fds.end(),
+                                redirected_fds.begin(), redirected_fds.end());
+    }
+  }
+  for (const std::vector<int>* fds :
+       {&output_fds, &return_and_free_fds, &allocation_fds}) {
+    tracing_fds_.insert(tracing_fds_.end(), fds->begin(), fds->end());
+  }
+  for (PerfEventRingBuffer& ring_buffer : ring_buffers) {
+    ring_buffers_.push_back(std::move(ring_buffer));
+  }
+  bpf_heap_profiler_ = std::move(bpf_heap_profiler);
+  return true;
+}
+
+// The long futex waits of the target processes are reported by the programs
+// of a BpfLockContention, on the futex syscall tracepoints. The records of the
+// exit program go to the bpf-output event of each cpu, and the stacks of the
+// same waits to the sys_exit_futex event with stacks of the cpu. Both are
+// deferred, so that the stacks are unwound with the maps of their time and
+// joined with the records that precede them.
+// This method returns true on success, otherwise false.
+bool TracerThread::OpenBpfLockContention(const std::vector<int32_t>& cpus) {
+  if (cpus.empty()) {
+    return false;
+  }
+  std::unique_ptr<BpfLockContention> bpf_lock_contention =
+      BpfLockContention::Create(std::vector<pid_t>(pids_.begin(), pids_.end()),
+                                *std::max_element(cpus.begin(), cpus.end()),
+                                lock_wait_threshold_ns_);
+  if (bpf_lock_contention == nullptr) {
+    return false;
+  }
+
+  // All the file descriptors opened, to close them on error.
+  std::vector<int> opened_fds;
+  std::vector<int> output_fds;
+  std::vector<int> stack_fds;
+  std::vector<PerfEventRingBuffer> ring_buffers;
+  for (int32_t cpu : cpus) {
+    int output_fd = bpf_output_event_open(cpu);
+    if (output_fd < 0) {
+      CloseFileDescriptors(opened_fds);
+      return false;
+    }
+    opened_fds.push_back(output_fd);
+    output_fds.push_back(output_fd);
+    PerfEventRingBuffer output_ring_buffer{
+        output_fd,
+        ScaledRingBufferSizeKb(BPF_LOCK_WAITS_RING_BUFFER_SIZE_KB),
+        absl::StrFormat("bpf_lock_waits_%u", cpu)};
+    if (!output_ring_buffer.IsOpen() ||
+        !bpf_lock_contention->SetOutput(cpu, output_fd)) {
+      CloseFileDescriptors(opened_fds);
+      return false;
+    }
+    ring_buffers.push_back(std::move(output_ring_buffer));
+
+    int stack_fd =
+        tracepoint_stack_event_open("syscalls", "sys_exit_futex", cpu);
+    if (stack_fd < 0) {
+      CloseFileDescriptors(opened_fds);
+      return false;
+    }
+    opened_fds.push_back(stack_fd);
+    stack_fds.push_back(stack_fd);
+    PerfEventRingBuffer stack_ring_buffer{
+        stack_fd, ScaledRingBufferSizeKb(LOCK_WAIT_STACKS_RING_BUFFER_SIZE_KB),
+        absl::StrFormat("lock_wait_stacks_%u", cpu)};
+    if (!stack_ring_buffer.IsOpen()) {
+      CloseFileDescriptors(opened_fds);
+      return false;
+    }
+    ring_buffers.push_back(std::move(stack_ring_buffer));
+  }
+  // The programs run whatever the cpu of the event: any will do.
+  int enter_fd = tracepoint_event_open("syscalls", "sys_enter_futex", -1, 0);
+  if (enter_fd < 0) {
+    CloseFileDescriptors(opened_fds);
+    return false;
+  }
+  opened_fds.push_back(enter_fd);
+  if (!bpf_lock_contention->AttachEnterProgram(enter_fd) ||
+      !bpf_lock_contention->AttachExitProgram(stack_fds[0])) {
+    CloseFileDescriptors(opened_fds);
+    return false;
+  }
+
+  // The bpf-output events come first in tracing_fds_, and the entry
+  // tracepoint last, so that no wait begins before its end can be recorded.
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    bpf_lock_wait_fds_.insert(output_fds[i]);
+    lock_wait_stack_fds_.insert(stack_fds[i]);
+    for (int fd : {output_fds[i], stack_fds[i]}) {
+      ring_buffer_fds_to_cpu_.emplace(fd, cpus[i]);
+      uprobes_event_processor_watermarks_.try_emplace(fd, 0);
+    }
+  }
+  for (const std::vector<int>* fds : {&output_fds, &stack_fds}) {
+    tracing_fds_.insert(tracing_fds_.end(), fds->begin(), fds->end());
+  }
+  tracing_fds_.push_back(enter_fd);
+  for (PerfEventRingBuffer& ring_buffer : ring_buffers) {
+    ring_buffers_.push_back(std::move(ring_buffer));
+  }
+  bpf_lock_contention_ = std::move(bpf_lock_contention);
+  return true;
+}
+
+bool TracerThread::OpenBranchStackEvents(const std::vector<int32_t>& cpus) {
+  std::vector<int> opened_fds;
+  std::vector<PerfEventRingBuffer> ring_buffers;
+  for (int32_t cpu : cpus) {
+    int fd = branch_stack_sample_event_open(branch_sampling_,
+                                            branch_sampling_period_, cpu);
+    if (fd == -1) {
+      CloseFileDescriptors(opened_fds);
+      return false;
+    }
+    opened_fds.push_back(fd);
+
+    PerfEventRingBuffer ring_buffer{
+        fd, ScaledRingBufferSizeKb(BRANCH_STACKS_RING_BUFFER_SIZE_KB),
+        absl::StrFormat("branch_stacks_%u", cpu)};
+    if (!ring_buffer.IsOpen()) {
+      CloseFileDescriptors(opened_fds);
+      return false;
+    }
+    ring_buffers.push_back(std::move(ring_buffer));
+  }
+
+  // The branches are counted as they are read, not deferred.
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    branch_stack_fds_.insert(opened_fds[i]);
+    tracing_fds_.push_back(opened_fds[i]);
+    ring_buffer_fds_to_cpu_.emplace(opened_fds[i], cpus[i]);
+  }
+  for (PerfEventRingBuffer& ring_buffer : ring_buffers) {
+    ring_buffers_.push_back(std::move(ring_buffer));
+  }
+  branch_count_aggregator_ = BranchCountAggregator{
+      /*count_ranges=*/branch_sampling_ == BranchSampling::kAllBranches};
+  return true;
+}
+
+bool TracerThread::UsesBpfUprobes(const Function& function) const {
+  // The other modes need the registers or the stack at entry, or the PMU
+  // counters, which the records of the programs don't have.
+  return bpf_uprobes_ != nullptr &&
+         function.GetRecordingMode() == Function::RecordingMode::kTimingOnly;
+}
+
+bool TracerThread::AttachBpfUprobes(const Function& function,
+                                    const UprobesFds& fds) {
+  if (!bpf_uprobes_->LoadUprobesProgram(function.VirtualAddress())) {
+    return false;
+  }
+
+  // Like in AddUprobes, the uretprobes are enabled before the uprobes. The
+  // records of a u(ret)probe whose program could not be attached are lost, as
+  // it has no ring buffer.
+  InstrumentedFunctionFds& function_fds =
+      instrumented_function_fds_[function.VirtualAddress()];
+  for (const auto& [cpu, uretprobes_fd] : fds.uretprobes_fds_per_cpu) {
+    if (!bpf_uprobes_->AttachUretprobes(uretprobes_fd)) {
+      ERROR("Attaching the eBPF program to a uretprobe of function at %#016lx",
+            function.VirtualAddress());
+    }
+    tracing_fds_.push_back(uretprobes_fd);
+    function_fds.uretprobes_fds.push_back(uretprobes_fd);
+  }
+  for (const auto& [cpu, uprobes_fd] : fds.uprobes_fds_per_cpu) {
+    if (!bpf_uprobes_->AttachUprobes(uprobes_fd, function.VirtualAddress())) {
+      ERROR("Attaching the eBPF program to a uprobe of function at %#016lx",
+            function.VirtualAddress());
+    }
+    tracing_fds_.push_back(uprobes_fd);
+    function_fds.uprobes_fds.push_back(uprobes_fd);
+  }
+  return true;
+}
+
+void TracerThread::ProcessInstrumentationRequests() {
+  if (instrumentation_requests_ == nullptr ||
+      !instrumentation_requests_->HasRequests()) {
+    return;
+  }
+  for (const InstrumentationRequests::Request& request :
+       instrumentation_requests_->Consume()) {
+    switch (request.type) {
+      case InstrumentationRequests::Request::Type::kAdd:
+        AddInstrumentedFunction(request.function);
+        break;
+      case InstrumentationRequests::Request::Type::kRemove:
+        RemoveInstrumentedFunction(request.function.VirtualAddress());
+        break;
+      case InstrumentationRequests::Request::Type::kTraceWithIntelPt:
+        StartIntelPtWindow(request.function, request.function_size,
+                           request.duration_ns);
+        break;
+    }
+  }
+}
+
+void TracerThread::AddInstrumentedFunction(const Function& function) {
+  if (!trace_instrumented_functions_ ||
+      instrumented_function_fds_.contains(function.VirtualAddress())) {
+    return;
+  }
+
+  // New u(ret)probes can only be redirected to the existing ring buffers, as
+  // the reader threads only poll the ring buffers opened at the beginning.
+  std::vector<int32_t> cpus;
+  for (const auto& cpu_and_fd : uprobes_ring_buffer_fds_per_cpu_) {
+    cpus.push_back(cpu_and_fd.first);
+  }
+  if (cpus.empty() && UsesBpfUprobes(function)) {
+    // The records of the programs go to the bpf-output ring buffers.
+    for (int fd : bpf_function_calls_fds_) {
+      cpus.push_back(ring_buffer_fds_to_cpu_.at(fd));
+    }
+  }
+  if (cpus.empty()) {
+    ERROR(
+        "Cannot instrument function at %#016lx during the capture, as no "
+        "function was instrumented at the beginning",
+        function.VirtualAddress());
+    return;
+  }
+
+  // The events keep a pointer to their Function.
+  const Function& added_function =
+      added_instrumented_functions_.emplace_back(function);
+  if (!OpenUprobes(added_function, cpus, /*create_ring_buffers=*/false)) {
+    return;
+  }
+
+  const InstrumentedFunctionFds& function_fds =
+      instrumented_function_fds_.at(function.VirtualAddress());
+  for (int fd : function_fds.uretprobes_fds) {
+    perf_event_enable(fd);
+  }
+  for (int fd : function_fds.uprobes_fds) {
+    perf_event_enable(fd);
+  }
+  LOG("Instrumented function at %#016lx", function.VirtualAddress());
+}
+
+void TracerThread::RemoveInstrumentedFunction(uint64_t virtual_address) {
+  auto function_fds_it = instrumented_function_fds_.find(virtual_address);
+  if (function_fds_it == instrumented_function_fds_.end()) {
+    ERROR("Function at %#016lx is not instrumented", virtual_address);
+    return;
+  }
+  const InstrumentedFunctionFds& function_fds = function_fds_it->second;
+
+  // Disable the uprobes first, so that no new call is recorded without its
+  // return. Calls in progress still miss their return.
+  for (int fd : function_fds.uprobes_fds) {
+    perf_event_disable(fd);
+  }
+  for (int fd : function_fds.uretprobes_fds) {
+    perf_event_disable(fd);
+  }
+
+  // The events whose file descriptor owns a ring buffer must stay open, but
+  // disabled. The stream ids of all the events are kept in
+  // uprobes_ids_to_function_, as their ring buffers can still contain records.
+  std::vector<int> fds_to_close;
+  for (const std::vector<int>* fds :
+       {&function_fds.uprobes_fds, &function_fds.uretprobes_fds}) {
+    for (int fd : *fds) {
+      if (!uprobes_fds_.contains(fd)) {
+        fds_to_close.push_back(fd);
+      }
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock{uprobes_redirect_mutex_};
+    for (auto& ring_buffer_fd_and_redirected_fds :
+         redirected_fds_per_ring_buffer_fd_) {
+      std::vector<int>& redirected_fds =
+          ring_buffer_fd_and_redirected_fds.second;
+      redirected_fds.erase(
+          std::remove_if(redirected_fds.begin(), redirected_fds.end(),
+                         [&fds_to_close](int fd) {
+                           return std::find(fds_to_close.begin(),
+                                            fds_to_close.end(),
+                                            fd) != fds_to_close.end();
+                         }),
+          redirected_fds.end());
+    }
+  }
+  for (int fd : fds_to_close) {
+    close(fd);
+    tracing_fds_.erase(std::find(tracing_fds_.begin(), tracing_fds_.end(), fd));
+  }
+
+  instrumented_function_fds_.erase(function_fds_it);
+  LOG("Removed instrumentation of function at %#016lx", virtual_address);
+}
+
+void TracerThread::StartIntelPtWindow(const Function& function,
+                                      uint64_t function_size,
+                                      uint64_t duration_ns) {
+  if (!intel_pt_traces_.empty() || intel_pt_decoding_thread_.joinable()) {
+    ERROR("A window of Intel PT is still in progress");
+    return;
+  }
+  if (intel_pt_pmu_type() < 0) {
+    ERROR("Intel Processor Trace is not supported on this machine");
+    return;
+  }
+  std::optional<double> tsc_ctc_ratio = GetTscCtcRatio();
+  if (!tsc_ctc_ratio.has_value()) {
+    ERROR("Intel PT needs the frequency of the crystal clock (CPUID 0x15)");
+    return;
+  }
+
+  const uint64_t mmap_length = 2 * getpagesize();
+  const uint64_t aux_size = INTEL_PT_AUX_BUFFER_SIZE_KB * 1024;
+  for (pid_t pid : pids_) {
+    for (pid_t tid : ListThreads(pid)) {
+      int fd = intel_pt_event_open(INTEL_PT_MTC_PERIOD, tid);
+      if (fd == -1) {
+        continue;
+      }
+      void* ring_buffer = perf_event_open_mmap_ring_buffer(fd, mmap_length);
+      void* aux_buffer =
+          ring_buffer == nullptr
+              ? nullptr
+              : perf_event_open_mmap_aux_buffer(fd, ring_buffer, mmap_length,
+                                                aux_size);
+      if (aux_buffer == nullptr ||
+          !perf_event_set_address_filter(fd, function.BinaryPath().c_str(),
+                                         function.FileOffset(),
+                                         function_size)) {
+        if (aux_buffer != nullptr) {
+          munmap(aux_buffer, aux_size);
+        }
+        if (ring_buffer != nullptr) {
+          munmap(ring_buffer, mmap_length);
+        }
+        close(fd);
+        continue;
+      }
+      intel_pt_traces_.push_back({tid, fd, ring_buffer, aux_buffer});
+    }
+  }
+  if (intel_pt_traces_.empty()) {
+    ERROR("Could not trace any thread with Intel PT");
+    return;
+  }
+
+  intel_pt_function_.emplace(function);
+  intel_pt_tsc_ctc_ratio_ = tsc_ctc_ratio.value();
+  intel_pt_begin_tsc_ = __rdtsc();
+  intel_pt_begin_ns_ = MonotonicTimestampNs();
+  intel_pt_end_ns_ = intel_pt_begin_ns_ + duration_ns;
+  for (const IntelPtTrace& trace : intel_pt_traces_) {
+    perf_event_enable(trace.fd);
+  }
+  LOG("Tracing function at %#016lx with Intel PT on %lu threads for %.1f ms",
+      function.VirtualAddress(), intel_pt_traces_.size(), duration_ns / 1e6);
+}
+
+void TracerThread::UpdateIntelPtWindow(bool force) {
+  if (!intel_pt_traces_.empty() &&
+      (force || MonotonicTimestampNs() >= intel_pt_end_ns_)) {
+    for (const IntelPtTrace& trace : intel_pt_traces_) {
+      perf_event_disable(trace.fd);
+    }
+    const uint64_t end_tsc = __rdtsc();
+    const uint64_t end_ns = MonotonicTimestampNs();
+
+    // The traces are copied, for the events to be closed right away.
+    const uint64_t mmap_length = 2 * getpagesize();
+    const uint64_t aux_size = INTEL_PT_AUX_BUFFER_SIZE_KB * 1024;
+    std::vector<std::pair<pid_t, std::vector<uint8_t>>> traces;
+    uint64_t total_size = 0;
+    for (const IntelPtTrace& trace : intel_pt_traces_) {
+      auto* metadata = static_cast<perf_event_mmap_page*>(trace.ring_buffer);
+      uint64_t head = smp_load_acquire(&metadata->aux_head);
+      uint64_t tail = metadata->aux_tail;
+      uint64_t size = std::min(head - tail, aux_size);
+      std::vector<uint8_t> data(size);
+      const auto* aux_buffer = static_cast<const uint8_t*>(trace.aux_buffer);
+      for (uint64_t copied = 0; copied < size;) {
+        uint64_t offset = (tail + copied) % aux_size;
+        uint64_t chunk_size = std::min(size - copied, aux_size - offset);
+        std::memcpy(data.data() + copied, aux_buffer + offset, chunk_size);
+        copied += chunk_size;
+      }
+      total_size += size;
+      traces.emplace_back(trace.tid, std::move(data));
+      munmap(trace.aux_buffer, aux_size);
+      munmap(trace.ring_buffer, mmap_length);
+      close(trace.fd);
+    }
+    intel_pt_traces_.clear();
+    LOG("Decoding %lu bytes of Intel PT of %lu threads", total_size,
+        traces.size());
+
+    const uint64_t function_address = intel_pt_function_->VirtualAddress();
+    intel_pt_decoded_ = false;
+    intel_pt_decoding_thread_ = std::thread([this, traces = std::move(traces),
+                                             function_address, end_tsc,
+                                             end_ns]() {
+      std::vector<std::vector<IntelPtDecoder::Call>> calls(traces.size());
+      std::atomic<uint64_t> num_decoding_errors = 0;
+      RunInParallel(traces.size(), GetNumCores(), [&](size_t index) {
+        IntelPtDecoder decoder(function_address, INTEL_PT_MTC_PERIOD,
+                               intel_pt_tsc_ctc_ratio_);
+        calls[index] = decoder.Decode(traces[index].second);
+        num_decoding_errors += decoder.GetNumDecodingErrors();
+      });
+
+      // The TSC is converted with the time measured at both ends of the
+      // window.
+      const double ns_per_tick =
+          static_cast<double>(end_ns - intel_pt_begin_ns_) /
+          (end_tsc - intel_pt_begin_tsc_);
+      auto to_ns = [this, ns_per_tick](uint64_t tsc) {
+        return intel_pt_begin_ns_ +
+               static_cast<int64_t>(
+                   static_cast<int64_t>(tsc - intel_pt_begin_tsc_) *
+                   ns_per_tick);
+      };
+      intel_pt_calls_.clear();
+      for (size_t i = 0; i < traces.size(); ++i) {
+        for (const IntelPtDecoder::Call& call : calls[i]) {
+          intel_pt_calls_.emplace_back(traces[i].first, function_address,
+                                       to_ns(call.begin_tsc),
+                                       to_ns(call.end_tsc), /*depth=*/0);
+        }
+      }
+      LOG("Decoded %lu calls from Intel PT, with %lu decoding errors",
+          intel_pt_calls_.size(), num_decoding_errors.load());
+      intel_pt_decoded_ = true;
+    });
+  }
+
+  if (intel_pt_decoding_thread_.joinable() && (force || intel_pt_decoded_)) {
+    intel_pt_decoding_thread_.join();
+    std::unique_lock<std::mutex> lock = LockListenerIfNeeded();
+    for (const FunctionCall& function_call : intel_pt_calls_) {
+      listener_->OnFunctionCall(function_call);
+    }
+    intel_pt_calls_.clear();
+  }
+}
+
+const Function* TracerThread::GetUprobesFunction(uint64_t stream_id,
+                                                 bool* is_uretprobe) {
+  std::shared_lock<std::shared_mutex> lock{uprobes_ids_to_function_mutex_};
+  *is_uretprobe = uretprobes_ids_.contains(stream_id);
+  return uprobes_ids_to_function_.at(stream_id);
+}
+
+std::vector<std::vector<PerfEventRingBuffer*>>
+TracerThread::AssignRingBuffersToReaders() {
+  std::vector<std::vector<PerfEventRingBuffer*>> reader_ring_buffers;
+  if (thread_placement_.numa_local_readers) {
+    numa_node_cpus_ = GetNumaNodeCpus();
+    if (numa_node_cpus_.size() > 1) {
+      for (const auto& [node, cpus] : numa_node_cpus_) {
+        for (int cpu : cpus) {
+          cpu_numa_nodes_[cpu] = node;
+        }
+      }
+    } else {
+      numa_node_cpus_.clear();
+    }
+  }
+  if (cpus_per_reader_thread_ == 0 && cpu_numa_nodes_.empty()) {
+    // A single reader, in charge of all ring buffers.
+    reader_ring_buffers.emplace_back();
+    for (PerfEventRingBuffer& ring_buffer : ring_buffers_) {
+      reader_ring_buffers[0].push_back(&ring_buffer);
+    }
+    return reader_ring_buffers;
+  }
+
+  // Group ring buffers by the cpu they belong to, so that every reader thread
+  // only deals with the ring buffers of cpus_per_reader_thread_ cores, or of
+  // all cores if 0, and by NUMA node, so that no reader spans two nodes.
+  absl::flat_hash_map<std::pair<int, int32_t>,
+                      std::vector<PerfEventRingBuffer*>>
+      ring_buffers_per_reader;
+  for (PerfEventRingBuffer& ring_buffer : ring_buffers_) {
+    int32_t cpu = ring_buffer_fds_to_cpu_.at(ring_buffer.GetFileDescriptor());
+    auto node_it = cpu_numa_nodes_.find(cpu);
+    int node = node_it != cpu_numa_nodes_.end() ? node_it->second : 0;
+    int32_t group =
+        cpus_per_reader_thread_ > 0 ? cpu / cpus_per_reader_thread_ : 0;
+    ring_buffers_per_reader[{node, group}].push_back(&ring_buffer);
+  }
+  for (auto& reader_and_ring_buffers : ring_buffers_per_reader) {
+    reader_ring_buffers.emplace_back(
+        std::move(reader_and_ring_buffers.second));
+  }
+  if (reader_ring_buffers.empty()) {
+    reader_ring_buffers.emplace_back();
+  }
+  reader_threads_count_ = reader_ring_buffers.size();
+  return reader_ring_buffers;
+}
+
+void TracerThread::PinReaderToNumaNode(
+    const std::vector<PerfEventRingBuffer*>& ring_buffers) {
+  if (ring_buffers.empty()) {
+    return;
+  }
+  auto node_it = cpu_numa_nodes_.find(
+      ring_buffer_fds_to_cpu_.at(ring_buffers[0]->GetFileDescriptor()));
+  if (node_it == cpu_numa_nodes_.end()) {
+    return;
+  }
+  const std::vector<int>& node_cpus = numa_node_cpus_.at(node_it->second);
+  // Within the cpus of the ThreadPlacement, if any.
+  std::vector<int> cpus;
+  for (int cpu : node_cpus) {
+    if (thread_placement_.cpus.empty() ||
+        std::find(thread_placement_.cpus.begin(), thread_placement_.cpus.end(),
+                  cpu) != thread_placement_.cpus.end()) {
+      cpus.push_back(cpu);
+    }
+  }
+  if (cpus.empty()) {
+    return;
+  }
+  SetCurrentThreadAffinity(cpus);
+}
+
+void TracerThread::ReadRingBuffers(
+    std::vector<PerfEventRingBuffer*> ring_buffers, bool main_thread,
+    const std::atomic<bool>& exit_requested) {
+  if (!main_thread) {
+    // Before anything is allocated, so that it is on the local node too.
+    PinReaderToNumaNode(ring_buffers);
+  }
+
+  // Where to advance the watermark when a ring buffer is found empty, or
+  // nullptr if its events are not deferred.
+  std::vector<std::atomic<uint64_t>*> watermarks;
+  watermarks.reserve(ring_buffers.size());
+  for (PerfEventRingBuffer* ring_buffer : ring_buffers) {
+    auto it = uprobes_event_processor_watermarks_.find(
+        ring_buffer->GetFileDescriptor());
+    watermarks.push_back(it != uprobes_event_processor_watermarks_.end()
+                             ? &it->second
+                             : nullptr);
+  }
+
+  // When the watermark of each ring buffer was last recorded.
+  std::vector<uint64_t> watermark_recorded_ns(ring_buffers.size(), 0);
+
+  const bool adapt_ring_buffers = ring_buffers_memory_budget_kb_ > 0;
+  std::vector<RingBufferAdaptationState> adaptation_states(
+      ring_buffers.size(), RingBufferAdaptationState{sampling_period_ns_});
+  uint64_t next_adaptation_ns =
+      MonotonicTimestampNs() + RING_BUFFER_ADAPTATION_PERIOD_NS;
+
+  bool last_iteration_saw_events = false;
+
+  while (!exit_requested) {
+    ORBIT_SCOPE("Tracer Iteration");
+
+    if (!last_iteration_saw_events) {
+      // Periodically report event statistics.
+      if (main_thread) {
+        ReportStatsIfTimerElapsed();
+        ReportProcessCpuTimes();
+        ReportBpfCallstackCounts(/*force=*/false);
+        ReportBranchCounts(/*force=*/false);
+      }
+
+      // Sleep if there was no new event in the last iteration so that we are
+      // not constantly polling. Don't sleep so long that ring buffers overflow.
+      // TODO: Refine this sleeping pattern, possibly using exponential backoff.
+      {
+        ORBIT_SCOPE("Sleep");
+        usleep(IDLE_TIME_ON_EMPTY_RING_BUFFERS_US);
+      }
+    }
+
+    last_iteration_saw_events = false;
+    const uint64_t round_begin_ns = MonotonicTimestampNs();
+
+    if (adapt_ring_buffers && round_begin_ns >= next_adaptation_ns) {
+      for (size_t i = 0; i < ring_buffers.size(); ++i) {
+        if (ring_buffers[i]->IsOpen()) {
+          AdaptRingBuffer(ring_buffers[i], &adaptation_states[i]);
+        }
+      }
+      next_adaptation_ns = round_begin_ns + RING_BUFFER_ADAPTATION_PERIOD_NS;
+    }
+
+    if (main_thread) {
+      ProcessInstrumentationRequests();
+      UpdateIntelPtWindow(/*force=*/false);
+      RetuneStackDumpSizeIfTimerElapsed();
+    }
+
+    // Read and process events from all ring buffers. In order to ensure that no
+    // buffer is read constantly while others overflow, we schedule the reading
+    // using round-robin like scheduling.
+    for (size_t i = 0; i < ring_buffers.size(); ++i) {
+      PerfEventRingBuffer* ring_buffer = ring_buffers[i];
+      if (exit_requested) {
+        break;
+      }
+      if (!ring_buffer->IsOpen()) {
+        // Only possible after a failed resize.
+        continue;
+      }
+
+      // Read up to ROUND_ROBIN_POLLING_BATCH_SIZE (5) new events.
+      // TODO: Some event types (e.g., stack samples) have a much longer
+      //  processing time but are less frequent than others (e.g., context
+      //  switches). Take this into account in our scheduling algorithm.
+      for (int32_t read_from_this_buffer = 0;
+           read_from_this_buffer < ROUND_ROBIN_POLLING_BATCH_SIZE;
+           ++read_from_this_buffer) {
+        if (exit_requested) {
+          break;
+        }
+        if (!ring_buffer->HasNewData()) {
+          if (watermarks[i] != nullptr &&
+              round_begin_ns > EMPTY_RING_BUFFER_WATERMARK_MARGIN_NS) {
+            // Release: all events deferred so far from this ring buffer must
+            // be visible to whoever observes the new watermark.
+            watermarks[i]->store(
+                round_begin_ns - EMPTY_RING_BUFFER_WATERMARK_MARGIN_NS,
+                std::memory_order_release);
+            if (record_file_writer_ != nullptr &&
+                round_begin_ns >=
+                    watermark_recorded_ns[i] + RECORDED_WATERMARK_PERIOD_NS) {
+              record_file_writer_->Write(
+                  RecordFileEntryType::kWatermark,
+                  RecordFileEntryBuilder{}
+                      .Add(ring_buffer->GetFileDescriptor())
+                      .Add(round_begin_ns -
+                           EMPTY_RING_BUFFER_WATERMARK_MARGIN_NS));
+              watermark_recorded_ns[i] = round_begin_ns;
+            }
+          }
+          break;
+        }
+
+        last_iteration_saw_events = true;
+        ReadAndProcessRecord(ring_buffer);
+      }
+    }
+  }
+}
+
+void TracerThread::ReadAndProcessRecord(PerfEventRingBuffer* ring_buffer) {
+  perf_event_header header;
+  ring_buffer->ReadHeader(&header);
+
+  if (record_file_writer_ != nullptr) {
+    // Before processing, so that the entries written while processing, e.g.,
+    // the maps read again after lost records, come after the record.
+    int fd = ring_buffer->GetFileDescriptor();
+    uint32_t size = header.size;
+    record_file_writer_->Write(
+        RecordFileEntryType::kRecord,
+        {absl::MakeConstSpan(reinterpret_cast<const uint8_t*>(&fd), sizeof(fd)),
+         absl::MakeConstSpan(reinterpret_cast<const uint8_t*>(&size),
+                             sizeof(size)),
+         ring_buffer->ReadRecordView(header)});
+  }
+
+  // perf_event_header::type contains the type of record, e.g.,
+  // PERF_RECORD_SAMPLE, PERF_RECORD_MMAP, etc., defined in enum
+  // perf_event_type in linux/perf_event.h.
+  switch (header.type) {
+    case PERF_RECORD_SWITCH:
+      // Note: as we are recording context switches on CPUs and not on
+      // threads, we don't expect this type of record.
+      ERROR(
+          "Unexpected PERF_RECORD_SWITCH (only "
+          "PERF_RECORD_SWITCH_CPU_WIDE are expected)");
+      ProcessContextSwitchEvent(header, ring_buffer);
+      break;
+    case PERF_RECORD_SWITCH_CPU_WIDE:
+      ProcessContextSwitchCpuWideEvent(header, ring_buffer);
+      break;
+    case PERF_RECORD_FORK:
+      ProcessForkEvent(header, ring_buffer);
+      break;
+    case PERF_RECORD_EXIT:
+      ProcessExitEvent(header, ring_buffer);
+      break;
+    case PERF_RECORD_COMM:
+      ProcessCommEvent(header, ring_buffer);
+      break;
+    case PERF_RECORD_MMAP:
+      ProcessMmapEvent(header, ring_buffer);
+      break;
+    case PERF_RECORD_SAMPLE:
+      ProcessSampleEvent(header, ring_buffer);
+      break;
+    case PERF_RECORD_LOST:
+      ProcessLostEvent(header, ring_buffer);
+      break;
+    default:
+      ERROR("Unexpected perf_event_header::type: %u", header.type);
+      ring_buffer->SkipRecord(header);
+      break;
+  }
+}
+
+void TracerThread::ProcessContextSwitchEvent(const perf_event_header& header,
+                                             PerfEventRingBuffer* ring_buffer) {
+  ContextSwitchPerfEvent event;
+  ring_buffer->ConsumeRecord(header, &event.ring_buffer_record);
+  pid_t tid = event.GetTid();
+  uint16_t cpu = static_cast<uint16_t>(event.GetCpu());
+  uint64_t time = event.GetTimestamp();
+
+  {
+    std::unique_lock<std::mutex> lock = LockListenerIfNeeded();
+    if (event.IsSwitchOut()) {
+      listener_->OnContextSwitchOut(ContextSwitchOut(tid, cpu, time));
+    } else {
+      listener_->OnContextSwitchIn(ContextSwitchIn(tid, cpu, time));
+    }
+  }
+
+  ++stats_.sched_switch_count;
+}
+
+void TracerThread::ProcessContextSwitchCpuWideEvent(
+    const perf_event_header& header, PerfEventRingBuffer* ring_buffer) {
+  SystemWideContextSwitchPerfEvent event;
+  ring_buffer->ConsumeRecord(header, &event.ring_buffer_record);
+  pid_t pid = event.GetPid();
+  pid_t tid = event.GetTid();
+  uint16_t cpu = static_cast<uint16_t>(event.GetCpu());
+  uint64_t time = event.GetTimestamp();
+  ++stats_.sched_switch_count;
+
+  if (trace_system_wide_scheduling_) {
+    // Pid 0 is the idle task of the core.
+    if (pid != 0) {
+      std::lock_guard<std::mutex> lock(process_cpu_time_aggregator_mutex_);
+      if (event.IsSwitchOut()) {
+        process_cpu_time_aggregator_.OnSwitchOut(pid, cpu, time);
+      } else {
+        process_cpu_time_aggregator_.OnSwitchIn(pid, cpu, time);
+      }
+    }
+  } else if (!pids_.contains(pid)) {
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock = LockListenerIfNeeded();
+    if (event.IsSwitchOut()) {
+      listener_->OnContextSwitchOut(ContextSwitchOut(tid, cpu, time));
+    } else {
+      listener_->OnContextSwitchIn(ContextSwitchIn(tid, cpu, time));
+    }
+  }
+}
+
+void TracerThread::ProcessForkEvent(const perf_event_header& header,
+                                    PerfEventRingBuffer* ring_buffer) {
+  ForkPerfEvent event;
+  ring_buffer->ConsumeRecord(header, &event.ring_buffer_record);
+
+  if (!pids_.contains(event.GetPid())) {
+    return;
+  }
+
+  // A new thread of the sampled process was spawned.
+  if (trace_thread_states_ || trace_off_cpu_callstacks_) {
+    std::unique_lock<std::shared_mutex> lock{thread_state_tids_mutex_};
+    thread_state_tids_.insert(event.GetTid());
+  }
+  std::optional<std::string> name;
+  {
+    std::lock_guard<std::mutex> lock(thread_names_mutex_);
+    name = thread_names_.OnFork(event.GetTid(), event.GetParentTid(),
+                                event.GetTimestamp());
+  }
+  if (sampled_thread_filter_ != nullptr && name.has_value()) {
+    sampled_thread_filter_->OnName(event.GetTid(), name.value());
+  }
+  std::unique_lock<std::mutex> lock = LockListenerIfNeeded();
+  listener_->OnTid(event.GetTid());
+  if (name.has_value()) {
+    listener_->OnThreadName(ThreadName(event.GetPid(), event.GetTid(),
+                                       std::move(name.value()),
+                                       event.GetTimestamp()));
+  }
+}
+
+void TracerThread::ProcessExitEvent(const perf_event_header& header,
                                     PerfEventRingBuffer* ring_buffer) {
   ExitPerfEvent event;
   ring_buffer->ConsumeRecord(header, &event.ring_buffer_record);
 
-  if (event.GetPid() != pid_) {
+  if (!pids_.contains(event.GetPid())) {
+    return;
+  }
+
+  if (stack_dump_size_tuner_ != nullptr) {
+    stack_dump_size_tuner_->RemoveThread(event.GetTid());
+  }
+  if (sampled_thread_filter_ != nullptr) {
+    sampled_thread_filter_->OnExit(event.GetTid());
+  }
+  std::lock_guard<std::mutex> lock(thread_names_mutex_);
+  thread_names_.OnExit(event.GetTid(), event.GetTimestamp());
+}
+
+void TracerThread::ProcessCommEvent(const perf_event_header& header,
+                                    PerfEventRingBuffer* ring_buffer) {
+  absl::Span<const uint8_t> record_view = ring_buffer->ReadRecordView(header);
+  if (!pids_.contains(ReadMmapRecordPid(record_view))) {
+    ring_buffer->SkipRecord(header);
     return;
   }
+  std::unique_ptr<CommPerfEvent> event = DecodeCommPerfEvent(record_view);
+  ring_buffer->SkipRecord(header);
 
-  // Nothing to do.
+  // Renamed, or, with IsExec, the name of the new executable.
+  {
+    std::lock_guard<std::mutex> lock(thread_names_mutex_);
+    if (!thread_names_.OnRename(event->GetTid(), event->GetTimestamp(),
+                                event->GetComm())) {
+      return;
+    }
+  }
+  if (sampled_thread_filter_ != nullptr) {
+    sampled_thread_filter_->OnName(event->GetTid(), event->GetComm());
+  }
+  std::unique_lock<std::mutex> lock = LockListenerIfNeeded();
+  listener_->OnThreadName(ThreadName(event->GetPid(), event->GetTid(),
+                                     event->GetComm(),
+                                     event->GetTimestamp()));
 }
 
 void TracerThread::ProcessMmapEvent(const perf_event_header& header,
                                     PerfEventRingBuffer* ring_buffer) {
-  pid_t pid = ReadMmapRecordPid(ring_buffer);
+  absl::Span<const uint8_t> record_view = ring_buffer->ReadRecordView(header);
+  pid_t pid = ReadMmapRecordPid(record_view);
+  if (!pids_.contains(pid)) {
+    ring_buffer->SkipRecord(header);
+    return;
+  }
+
+  // There was a call to mmap with PROT_EXEC: instead of reading the maps
+  // again, pass the new mapping, which is applied to the current maps.
+  std::unique_ptr<MmapPerfEvent> event = DecodeMmapPerfEvent(record_view);
+  ring_buffer->SkipRecord(header);
+  event->SetOriginFileDescriptor(ring_buffer->GetFileDescriptor());
+  DeferEvent(std::move(event));
+}
+
+Callstack TracerThread::CallstackFromCallchainSample(
+    const CallchainSamplePerfEvent& event) {
+  std::vector<CallstackFrame> frames;
+  frames.reserve(event.GetIps().size());
+  for (uint64_t ip : event.GetIps()) {
+    // Skip the PERF_CONTEXT_KERNEL, PERF_CONTEXT_USER, etc. markers that
+    // separate kernel and user-space frames.
+    if (ip >= PERF_CONTEXT_MAX) {
+      continue;
+    }
+    // Function names are resolved from the symbols later.
+    frames.emplace_back(ip, "", 0, "");
+  }
+  return Callstack{event.GetTid(), std::move(frames), event.GetTimestamp()};
+}
+
+void TracerThread::ProcessThreadStateEvent(const perf_event_header& header,
+                                           PerfEventRingBuffer* ring_buffer) {
+  int fd = ring_buffer->GetFileDescriptor();
+  absl::Span<const uint8_t> record_view = ring_buffer->ReadRecordView(header);
+
+  if (sched_switch_fds_.contains(fd)) {
+    const auto* record =
+        RecordViewAs<perf_event_sched_switch_sample>(record_view);
+    uint64_t timestamp = record->sample_id.time;
+    pid_t prev_tid = record->data.prev_pid;
+    ThreadState prev_state =
+        ThreadStateFromSchedSwitchPrevState(record->data.prev_state);
+    pid_t next_tid = record->data.next_pid;
+    ring_buffer->SkipRecord(header);
+
+    bool is_prev_tid_traced;
+    bool is_next_tid_traced;
+    {
+      std::shared_lock<std::shared_mutex> lock{thread_state_tids_mutex_};
+      is_prev_tid_traced = thread_state_tids_.contains(prev_tid);
+      is_next_tid_traced = thread_state_tids_.contains(next_tid);
+    }
+    // Events from the same file descriptor keep their order.
+    if (is_prev_tid_traced) {
+      auto event = std::make_unique<ThreadStatePerfEvent>(timestamp, prev_tid,
+                                                          prev_state, -1);
+      event->SetOriginFileDescriptor(fd);
+      DeferEvent(std::move(event));
+    }
+    if (is_next_tid_traced) {
+      auto event = std::make_unique<ThreadStatePerfEvent>(
+          timestamp, next_tid, ThreadState::kRunning, -1);
+      event->SetOriginFileDescriptor(fd);
+      DeferEvent(std::move(event));
+    }
+    stats_.thread_state_count += is_prev_tid_traced + is_next_tid_traced;
+    return;
+  }
+
+  const auto* record =
+      RecordViewAs<perf_event_sched_wakeup_sample>(record_view);
+  uint64_t timestamp = record->sample_id.time;
+  pid_t tid = record->data.pid;
+  // sched_waking is reported by the waker, sched_wakeup not necessarily.
+  pid_t waker_tid =
+      sched_waking_fds_.contains(fd) ? record->sample_id.tid : -1;
+  ring_buffer->SkipRecord(header);
+
+  {
+    std::shared_lock<std::shared_mutex> lock{thread_state_tids_mutex_};
+    if (!thread_state_tids_.contains(tid)) {
+      return;
+    }
+  }
+  auto event = std::make_unique<ThreadStatePerfEvent>(
+      timestamp, tid, ThreadState::kRunnable, waker_tid);
+  event->SetOriginFileDescriptor(fd);
+  DeferEvent(std::move(event));
+  ++stats_.thread_state_count;
+}
+
+void TracerThread::ProcessOffCpuEvent(const perf_event_header& header,
+                                      PerfEventRingBuffer* ring_buffer) {
+  int fd = ring_buffer->GetFileDescriptor();
+  absl::Span<const uint8_t> record_view = ring_buffer->ReadRecordView(header);
+
+  // The raw data of the tracepoint comes first, like in the records of the
+  // sched_switch tracepoints of OpenThreadStateTracepoints. The tracepoint
+  // fires in the context of the thread switched out.
+  const auto* record =
+      RecordViewAs<perf_event_sched_switch_sample>(record_view);
+  uint64_t timestamp = record->sample_id.time;
+  pid_t prev_pid = record->sample_id.pid;
+  ThreadState prev_state =
+      ThreadStateFromSchedSwitchPrevState(record->data.prev_state);
+  pid_t next_tid = record->data.next_pid;
+
+  // Threads that are preempted aren't waiting for anything but a core, and
+  // exiting threads are never switched in again: only keep the stacks of the
+  // threads that block.
+  std::unique_ptr<OffCpuStackSamplePerfEvent> switch_out_event;
+  if (pids_.contains(prev_pid) &&
+      (prev_state == ThreadState::kInterruptibleSleep ||
+       prev_state == ThreadState::kUninterruptibleSleep)) {
+    switch_out_event = DecodeOffCpuStackSamplePerfEvent(record_view);
+  }
+  ring_buffer->SkipRecord(header);
+
+  bool is_next_tid_traced;
+  {
+    std::shared_lock<std::shared_mutex> lock{thread_state_tids_mutex_};
+    is_next_tid_traced = thread_state_tids_.contains(next_tid);
+  }
+  // Events from the same file descriptor keep their order.
+  if (switch_out_event != nullptr) {
+    switch_out_event->SetOriginFileDescriptor(fd);
+    DeferEvent(std::move(switch_out_event));
+    ++stats_.off_cpu_stack_count;
+  }
+  if (is_next_tid_traced) {
+    auto event = std::make_unique<SchedSwitchInPerfEvent>(timestamp, next_tid);
+    event->SetOriginFileDescriptor(fd);
+    DeferEvent(std::move(event));
+  }
+}
+
+void TracerThread::ProcessBpfFunctionCallEvent(
+    const perf_event_header& header, PerfEventRingBuffer* ring_buffer) {
+  // The function calls are complete, so they need no sorting and go to the
+  // listener directly.
+  absl::Span<const uint8_t> record_view = ring_buffer->ReadRecordView(header);
+  const auto* record = RecordViewAs<perf_event_sample_raw>(record_view);
+  BpfUprobes::FunctionCallRecord function_call_record;
+  if (record->size < sizeof(function_call_record) ||
+      sizeof(perf_event_sample_raw) + sizeof(function_call_record) >
+          record_view.size()) {
+    ERROR("Unexpected size of eBPF function call record: %u", record->size);
+    ring_buffer->SkipRecord(header);
+    return;
+  }
+  std::memcpy(&function_call_record,
+              record_view.data() + sizeof(perf_event_sample_raw),
+              sizeof(function_call_record));
+  ring_buffer->SkipRecord(header);
+
+  FunctionCall function_call =
+      BpfUprobes::FunctionCallFromRecord(function_call_record);
+  {
+    std::unique_lock<std::mutex> lock = LockListenerIfNeeded();
+    listener_->OnFunctionCall(function_call);
+  }
+  ++stats_.uprobes_count;
+}
+
+void TracerThread::ProcessBpfFileIoEvent(const perf_event_header& header,
+                                         PerfEventRingBuffer* ring_buffer) {
+  // Like the function calls of the eBPF programs, the syscalls are complete
+  // and go to the listener directly.
+  absl::Span<const uint8_t> record_view = ring_buffer->ReadRecordView(header);
+  const auto* record = RecordViewAs<perf_event_sample_raw>(record_view);
+  BpfFileIo::FileIoRecord file_io_record;
+  if (record->size < sizeof(file_io_record) ||
+      sizeof(perf_event_sample_raw) + sizeof(file_io_record) >
+          record_view.size()) {
+    ERROR("Unexpected size of eBPF file I/O record: %u", record->size);
+    ring_buffer->SkipRecord(header);
+    return;
+  }
+  std::memcpy(&file_io_record,
+              record_view.data() + sizeof(perf_event_sample_raw),
+              sizeof(file_io_record));
   ring_buffer->SkipRecord(header);
 
-  if (pid != pid_) {
+  std::optional<FileIo> file_io = BpfFileIo::FileIoFromRecord(file_io_record);
+  if (!file_io.has_value()) {
+    return;
+  }
+  {
+    std::unique_lock<std::mutex> lock = LockListenerIfNeeded();
+    listener_->OnFileIo(file_io.value());
+  }
+  ++stats_.file_io_count;
+}
+
+void TracerThread::ProcessPageFaultEvent(const perf_event_header& header,
+                                         PerfEventRingBuffer* ring_buffer) {
+  absl::Span<const uint8_t> record_view = ring_buffer->ReadRecordView(header);
+  // The page faults of all processes are sampled: only the stacks of the
+  // target processes are copied out of the ring buffer.
+  if (!pids_.contains(ReadSampleRecordPid(record_view))) {
+    ring_buffer->SkipRecord(header);
     return;
   }
+  auto event =
+      DecodeSamplePerfEvent<PageFaultStackSamplePerfEvent>(record_view);
+  ring_buffer->SkipRecord(header);
+  int fd = ring_buffer->GetFileDescriptor();
+  event->SetMajor(major_page_fault_fds_.contains(fd));
+  event->SetOriginFileDescriptor(fd);
+  DeferEvent(std::move(event));
+  ++stats_.page_fault_count;
+}
+
+void TracerThread::ProcessBranchStackEvent(const perf_event_header& header,
+                                           PerfEventRingBuffer* ring_buffer) {
+  absl::Span<const uint8_t> record_view = ring_buffer->ReadRecordView(header);
+  // The branches of all processes are sampled: only those of the targets are
+  // counted, straight from the ring buffer.
+  const auto* record =
+      RecordViewAs<perf_event_branch_stack_sample_fixed>(record_view);
+  if (pids_.contains(static_cast<pid_t>(record->sample_id.pid))) {
+    size_t max_entries =
+        (record_view.size() - sizeof(perf_event_branch_stack_sample_fixed)) /
+        sizeof(perf_branch_entry);
+    const auto* entries = reinterpret_cast<const perf_branch_entry*>(
+        record_view.data() + sizeof(perf_event_branch_stack_sample_fixed));
+    std::lock_guard<std::mutex> lock(branch_count_aggregator_mutex_);
+    branch_count_aggregator_.AddBranchStack(
+        absl::MakeConstSpan(entries, std::min<size_t>(record->nr, max_entries)),
+        record->sample_id.time);
+  }
+  ring_buffer->SkipRecord(header);
+  ++stats_.branch_stack_count;
+}
 
-  // There was a call to mmap with PROT_EXEC, hence refresh the maps.
-  // This should happen rarely.
+void TracerThread::ProcessHeapAllocationEvent(
+    const perf_event_header& header, PerfEventRingBuffer* ring_buffer) {
+  absl::Span<const uint8_t> record_view = ring_buffer->ReadRecordView(header);
+  // The programs only keep the stacks of the sampled allocations of the
+  // target processes, but the check is cheap.
+  if (!pids_.contains(ReadSampleRecordPid(record_view))) {
+    ring_buffer->SkipRecord(header);
+    return;
+  }
   auto event =
-      std::make_unique<MapsPerfEvent>(MonotonicTimestampNs(), ReadMaps(pid_));
+      DecodeSamplePerfEvent<HeapAllocationStackSamplePerfEvent>(record_view);
+  ring_buffer->SkipRecord(header);
+  event->SetOriginFileDescriptor(ring_buffer->GetFileDescriptor());
+  DeferEvent(std::move(event));
+}
+
+void TracerThread::ProcessBpfHeapRecordEvent(const perf_event_header& header,
+                                             PerfEventRingBuffer* ring_buffer) {
+  // Unlike the records of the other eBPF programs, these are deferred, to be
+  // joined with the stacks of the allocations and ordered with the frees.
+  absl::Span<const uint8_t> record_view = ring_buffer->ReadRecordView(header);
+  const auto* record = RecordViewAs<perf_event_sample_raw>(record_view);
+  BpfHeapProfiler::HeapRecord heap_record;
+  if (record->size < sizeof(heap_record) ||
+      sizeof(perf_event_sample_raw) + sizeof(heap_record) >
+          record_view.size()) {
+    ERROR("Unexpected size of eBPF heap record: %u", record->size);
+    ring_buffer->SkipRecord(header);
+    return;
+  }
+  std::memcpy(&heap_record, record_view.data() + sizeof(perf_event_sample_raw),
+              sizeof(heap_record));
+  uint64_t timestamp = record->sample_id.time;
+  pid_t pid = record->sample_id.pid;
+  ring_buffer->SkipRecord(header);
+
+  // The fields of the packed record can't be forwarded by reference.
+  auto tid = static_cast<pid_t>(heap_record.tid);
+  uint64_t address = heap_record.address;
+  uint64_t size = heap_record.size;
+  std::unique_ptr<PerfEvent> event;
+  if (heap_record.type == BpfHeapProfiler::kAllocationRecord) {
+    event = std::make_unique<HeapAllocationPerfEvent>(timestamp, pid, tid,
+                                                      address, size);
+    ++stats_.heap_allocation_count;
+  } else {
+    event = std::make_unique<HeapFreePerfEvent>(timestamp, pid, tid, address);
+  }
+  event->SetOriginFileDescriptor(ring_buffer->GetFileDescriptor());
+  DeferEvent(std::move(event));
+}
+
+void TracerThread::ProcessBpfLockWaitEvent(const perf_event_header& header,
+                                           PerfEventRingBuffer* ring_buffer) {
+  // Like the heap records, these are deferred, to be joined with the stacks
+  // of the waits that follow them.
+  absl::Span<const uint8_t> record_view = ring_buffer->ReadRecordView(header);
+  const auto* record = RecordViewAs<perf_event_sample_raw>(record_view);
+  BpfLockContention::LockWaitRecord lock_wait_record;
+  if (record->size < sizeof(lock_wait_record) ||
+      sizeof(perf_event_sample_raw) + sizeof(lock_wait_record) >
+          record_view.size()) {
+    ERROR("Unexpected size of eBPF lock wait record: %u", record->size);
+    ring_buffer->SkipRecord(header);
+    return;
+  }
+  std::memcpy(&lock_wait_record,
+              record_view.data() + sizeof(perf_event_sample_raw),
+              sizeof(lock_wait_record));
+  uint64_t timestamp = record->sample_id.time;
+  pid_t pid = record->sample_id.pid;
+  ring_buffer->SkipRecord(header);
+
+  auto tid = static_cast<pid_t>(lock_wait_record.tid);
+  uint64_t begin_timestamp_ns = lock_wait_record.begin_timestamp_ns;
+  uint64_t end_timestamp_ns = lock_wait_record.end_timestamp_ns;
+  uint64_t lock_address = lock_wait_record.lock_address;
+  auto event = std::make_unique<LockWaitPerfEvent>(
+      timestamp, pid, tid, begin_timestamp_ns, end_timestamp_ns, lock_address);
+  event->SetOriginFileDescriptor(ring_buffer->GetFileDescriptor());
+  DeferEvent(std::move(event));
+  ++stats_.lock_wait_count;
+}
+
+void TracerThread::ProcessLockWaitStackEvent(const perf_event_header& header,
+                                             PerfEventRingBuffer* ring_buffer) {
+  absl::Span<const uint8_t> record_view = ring_buffer->ReadRecordView(header);
+  // The exit program only keeps the stacks of the long waits of the target
+  // processes, but the check is cheap.
+  if (!pids_.contains(ReadSampleRecordPid(record_view))) {
+    ring_buffer->SkipRecord(header);
+    return;
+  }
+  std::unique_ptr<LockWaitStackSamplePerfEvent> event =
+      DecodeLockWaitStackSamplePerfEvent(record_view);
+  ring_buffer->SkipRecord(header);
+  if (event == nullptr) {
+    return;
+  }
   event->SetOriginFileDescriptor(ring_buffer->GetFileDescriptor());
   DeferEvent(std::move(event));
 }
@@ -498,55 +3134,197 @@ void TracerThread::ProcessMmapEvent(const perf_event_header& header,
 void TracerThread::ProcessSampleEvent(const perf_event_header& header,
                                       PerfEventRingBuffer* ring_buffer) {
   int fd = ring_buffer->GetFileDescriptor();
+  if (off_cpu_fds_.contains(fd)) {
+    ProcessOffCpuEvent(header, ring_buffer);
+    return;
+  }
+  if (bpf_function_calls_fds_.contains(fd)) {
+    ProcessBpfFunctionCallEvent(header, ring_buffer);
+    return;
+  }
+  if (bpf_file_io_fds_.contains(fd)) {
+    ProcessBpfFileIoEvent(header, ring_buffer);
+    return;
+  }
+  if (page_fault_fds_.contains(fd) || major_page_fault_fds_.contains(fd)) {
+    ProcessPageFaultEvent(header, ring_buffer);
+    return;
+  }
+  if (heap_allocation_fds_.contains(fd)) {
+    ProcessHeapAllocationEvent(header, ring_buffer);
+    return;
+  }
+  if (bpf_heap_record_fds_.contains(fd)) {
+    ProcessBpfHeapRecordEvent(header, ring_buffer);
+    return;
+  }
+  if (bpf_lock_wait_fds_.contains(fd)) {
+    ProcessBpfLockWaitEvent(header, ring_buffer);
+    return;
+  }
+  if (lock_wait_stack_fds_.contains(fd)) {
+    ProcessLockWaitStackEvent(header, ring_buffer);
+    return;
+  }
+  if (branch_stack_fds_.contains(fd)) {
+    ProcessBranchStackEvent(header, ring_buffer);
+    return;
+  }
+  // These tracepoints are system-wide and are filtered by thread id instead of
+  // by the pid of the sample.
+  if (sched_switch_fds_.contains(fd) || sched_waking_fds_.contains(fd) ||
+      sched_wakeup_fds_.contains(fd)) {
+    ProcessThreadStateEvent(header, ring_buffer);
+    return;
+  }
+
   bool is_probe = uprobes_fds_.contains(fd);
   bool is_gpu_event = gpu_tracing_fds_.contains(fd);
 
   // An event can never be a probe and a GPU event.
   CHECK(!(is_probe && is_gpu_event));
 
-  constexpr size_t size_of_uretprobe = sizeof(perf_event_empty_sample);
-  bool is_uretprobe = is_probe && (header.size == size_of_uretprobe);
+  // Decode directly from the memory of the ring buffer. The tail is only
+  // advanced (with SkipRecord) once we are done reading the record.
+  absl::Span<const uint8_t> record_view = ring_buffer->ReadRecordView(header);
+
+  // The uprobes and uretprobes of all functions on a cpu share the same ring
+  // buffer: tell them apart by their stream id.
+  const Function* probe_function = nullptr;
+  bool is_uretprobe = false;
+  if (is_probe) {
+    uint64_t stream_id = ReadSampleRecordStreamId(record_view);
+    // The context switches of the PMU counters, which share the ring buffer,
+    // are kept for all threads, as they also delimit the counts of the
+    // threads of the target process.
+    if (pmu_counter_switch_ids_.contains(stream_id)) {
+      auto event = DecodePmuCounterSwitchPerfEvent(record_view, pmu_counters_);
+      ring_buffer->SkipRecord(header);
+      if (event != nullptr) {
+        event->SetOriginFileDescriptor(fd);
+        DeferEvent(std::move(event));
+      }
+      return;
+    }
+    probe_function = GetUprobesFunction(stream_id, &is_uretprobe);
+  }
   bool is_uprobe = is_probe && !is_uretprobe;
 
   pid_t pid;
   if (is_uretprobe) {
-    pid = ReadUretprobesRecordPid(ring_buffer);
+    pid = ReadUretprobesRecordPid(record_view);
   } else {
-    pid = ReadSampleRecordPid(ring_buffer);
+    pid = ReadSampleRecordPid(record_view);
   }
 
-  // We skip this sample if it is not an event of the currently selected
-  // process, unless it is a GPU tracepoint event as we want to have
-  // visibility into all GPU activity across the system.
-  if (pid != pid_ && !is_gpu_event) {
+  // We skip this sample if it is not an event of the traced processes, unless
+  // it is a GPU tracepoint event as we want to have visibility into all GPU
+  // activity across the system.
+  if (!pids_.contains(pid) && !is_gpu_event) {
+    ring_buffer->SkipRecord(header);
+    return;
+  }
+  // The samples of the threads not selected, if the eBPF program of the
+  // filter didn't already drop them.
+  if (sampled_thread_filter_ != nullptr && sampling_fds_.contains(fd) &&
+      !sampled_thread_filter_->IsSampled(ReadSampleRecordTid(record_view))) {
     ring_buffer->SkipRecord(header);
     return;
   }
 
-  if (is_uprobe) {
+  if (is_uprobe && probe_function->GetRecordingMode() ==
+                       Function::RecordingMode::kTimingAndCallstack) {
+    auto event = DecodeSamplePerfEvent<UprobesWithStackPerfEvent>(record_view);
+    ring_buffer->SkipRecord(header);
+    event->SetFunction(probe_function);
+    event->SetOriginFileDescriptor(fd);
+    DeferEvent(std::move(event));
+    ++stats_.uprobes_count;
+
+  } else if (is_uprobe && RecordsPmuCounters(*probe_function)) {
+    auto event =
+        DecodeUprobesWithPmuCountersPerfEvent(record_view, pmu_counters_);
+    ring_buffer->SkipRecord(header);
+    if (event == nullptr) {
+      return;
+    }
+    event->SetFunction(probe_function);
+    event->SetOriginFileDescriptor(fd);
+    DeferEvent(std::move(event));
+    ++stats_.uprobes_count;
+
+  } else if (is_uprobe) {
+    bool with_arguments = probe_function->GetRecordingMode() ==
+                          Function::RecordingMode::kTimingAndArguments;
+    DCHECK(header.size == (with_arguments
+                               ? sizeof(perf_event_sp_ip_arguments_sample)
+                               : sizeof(perf_event_sp_ip_sample)));
+    auto event = DecodeUprobesPerfEvent(record_view, with_arguments);
+    ring_buffer->SkipRecord(header);
+    event->SetFunction(probe_function);
+    event->SetOriginFileDescriptor(fd);
+    DeferEvent(std::move(event));
+    ++stats_.uprobes_count;
+
+  } else if (is_uretprobe && RecordsPmuCounters(*probe_function)) {
     auto event =
-        ConsumeSamplePerfEvent<UprobesWithStackPerfEvent>(ring_buffer, header);
-    event->SetFunction(uprobes_ids_to_function_.at(event->GetStreamId()));
+        DecodeUretprobesWithPmuCountersPerfEvent(record_view, pmu_counters_);
+    ring_buffer->SkipRecord(header);
+    if (event == nullptr) {
+      return;
+    }
+    event->SetFunction(probe_function);
     event->SetOriginFileDescriptor(fd);
     DeferEvent(std::move(event));
     ++stats_.uprobes_count;
 
   } else if (is_uretprobe) {
-    auto event = make_unique_for_overwrite<UretprobesPerfEvent>();
-    ring_buffer->ConsumeRecord(header, &event->ring_buffer_record);
-    event->SetFunction(uprobes_ids_to_function_.at(event->GetStreamId()));
+    DCHECK(header.size <= sizeof(perf_event_ax_sample));
+    auto event = DecodeUretprobesPerfEvent(record_view);
+    ring_buffer->SkipRecord(header);
+    event->SetFunction(probe_function);
     event->SetOriginFileDescriptor(fd);
     DeferEvent(std::move(event));
     ++stats_.uprobes_count;
 
+  } else if (callchain_sampling_fds_.contains(fd)) {
+    auto event = DecodeCallchainSamplePerfEvent(record_view);
+    ring_buffer->SkipRecord(header);
+    Callstack callstack = CallstackFromCallchainSample(*event);
+    if (!callstack.GetFrames().empty()) {
+      std::unique_lock<std::mutex> lock = LockListenerIfNeeded();
+      listener_->OnCallstack(callstack);
+    }
+    ++stats_.sample_count;
+
   } else if (is_gpu_event) {
     // TODO: Consider deferring events.
-    auto event = ConsumeSampleRaw(ring_buffer, header);
-    gpu_event_processor_->PushEvent(event);
+    // The raw data is decoded in place, before the record is skipped.
+    const auto* record = RecordViewAs<perf_event_sample_raw>(record_view);
+    DCHECK(sizeof(perf_event_sample_raw) + record->size <= record_view.size());
+    absl::Span<const uint8_t> raw_data =
+        record_view.subspan(sizeof(perf_event_sample_raw), record->size);
+    {
+      std::unique_lock<std::mutex> lock = LockListenerIfNeeded();
+      gpu_event_processor_->PushEvent(record->sample_id.tid,
+                                      record->sample_id.time, raw_data);
+    }
+    // Only the stacks of the submissions of the target processes are unwound,
+    // in order with their maps.
+    std::unique_ptr<GpuSubmissionStackSamplePerfEvent> submission_event;
+    if (gpu_submission_fds_.contains(fd) && pids_.contains(pid)) {
+      submission_event = DecodeGpuSubmissionStackSamplePerfEvent(record_view);
+    }
+    ring_buffer->SkipRecord(header);
     ++stats_.gpu_events_count;
+    if (submission_event != nullptr) {
+      submission_event->SetOriginFileDescriptor(fd);
+      DeferEvent(std::move(submission_event));
+      ++stats_.gpu_submission_stack_count;
+    }
   } else {
-    auto event =
-        ConsumeSamplePerfEvent<StackSamplePerfEvent>(ring_buffer, header);
+    auto event = DecodeSamplePerfEvent<StackSamplePerfEvent>(record_view);
+    ring_buffer->SkipRecord(header);
     event->SetOriginFileDescriptor(fd);
     DeferEvent(std::move(event));
     ++stats_.sample_count;
@@ -558,18 +3336,66 @@ void TracerThread::ProcessLostEvent(const perf_event_header& header,
   LostPerfEvent event;
   ring_buffer->ConsumeRecord(header, &event.ring_buffer_record);
   stats_.lost_count += event.GetNumLost();
-  stats_.lost_count_per_buffer[ring_buffer] += event.GetNumLost();
+  {
+    std::lock_guard<std::mutex> lock(stats_.lost_count_per_buffer_mutex);
+    stats_.lost_count_per_buffer[ring_buffer] += event.GetNumLost();
+  }
+
+  int fd = ring_buffer->GetFileDescriptor();
+  auto lost_count_it = lost_count_per_ring_buffer_fd_.find(fd);
+  if (lost_count_it != lost_count_per_ring_buffer_fd_.end()) {
+    lost_count_it->second += event.GetNumLost();
+  }
+
+  if (mmap_task_fds_.contains(fd)) {
+    // As the maps are updated incrementally, lost mmap records would leave
+    // them incomplete: read them again entirely.
+    DeferMapsEvent(fd, event.GetTimestamp());
+  }
+}
+
+void TracerThread::DeferMapsEvent(int fd, uint64_t timestamp_ns) {
+  if (replaying_) {
+    // The maps that were read are replayed from the entry after the record.
+    return;
+  }
+  for (pid_t pid : pids_) {
+    std::string maps = ReadMaps(pid);
+    if (record_file_writer_ != nullptr) {
+      record_file_writer_->Write(RecordFileEntryType::kMaps,
+                                 RecordFileEntryBuilder{}
+                                     .Add(fd)
+                                     .Add(pid)
+                                     .Add(timestamp_ns)
+                                     .AddString(maps));
+    }
+    auto maps_event =
+        std::make_unique<MapsPerfEvent>(timestamp_ns, pid, std::move(maps));
+    maps_event->SetOriginFileDescriptor(fd);
+    DeferEvent(std::move(maps_event));
+  }
 }
 
 void TracerThread::DeferEvent(std::unique_ptr<PerfEvent> event) {
-  std::lock_guard<std::mutex> lock(deferred_events_mutex_);
-  deferred_events_.emplace_back(std::move(event));
+  // ConcurrentQueue preserves the order of the events enqueued by the same
+  // thread. As every ring buffer is only read by one thread, events from the
+  // same ring buffer are still consumed in order, as PerfEventProcessor2
+  // requires.
+  deferred_events_.enqueue(std::move(event));
 }
 
 std::vector<std::unique_ptr<PerfEvent>> TracerThread::ConsumeDeferredEvents() {
-  std::lock_guard<std::mutex> lock(deferred_events_mutex_);
-  std::vector<std::unique_ptr<PerfEvent>> events(std::move(deferred_events_));
-  deferred_events_.clear();
+  // Dequeue until the queue is empty, as size_approx could underestimate.
+  constexpr size_t BULK_SIZE = 1024;
+  std::vector<std::unique_ptr<PerfEvent>> events;
+  size_t dequeued_count;
+  do {
+    size_t previous_size = events.size();
+    events.resize(previous_size + BULK_SIZE);
+    dequeued_count = deferred_events_.try_dequeue_bulk(
+        events.begin() + previous_size, BULK_SIZE);
+    events.resize(previous_size + dequeued_count);
+  } while (dequeued_count > 0);
   return events;
 }
 
@@ -579,17 +3405,34 @@ void TracerThread::ProcessDeferredEvents() {
     // When "should_exit" becomes true, we know that we have stopped generating
     // deferred events. The last iteration will consume all remaining events.
     should_exit = stop_deferred_thread_;
+
+    // Load the watermarks before consuming the events: as a watermark is only
+    // advanced after deferring the events read until then, all events older
+    // than the watermarks we load are among the ones we consume next.
+    std::vector<std::pair<int, uint64_t>> watermarks;
+    watermarks.reserve(uprobes_event_processor_watermarks_.size());
+    for (const auto& fd_and_watermark : uprobes_event_processor_watermarks_) {
+      watermarks.emplace_back(
+          fd_and_watermark.first,
+          fd_and_watermark.second.load(std::memory_order_acquire));
+    }
+
     std::vector<std::unique_ptr<PerfEvent>> events = ConsumeDeferredEvents();
+    for (auto& event : events) {
+      int fd = event->GetOriginFileDescriptor();
+      uprobes_event_processor_->AddEvent(fd, std::move(event));
+    }
+    for (const auto& [fd, watermark] : watermarks) {
+      uprobes_event_processor_->AdvanceWatermark(fd, watermark);
+    }
+
+    // Even without new events, advanced watermarks can allow processing more.
+    uprobes_event_processor_->ProcessOldEvents();
+    batching_listener_->Flush();
+
     if (events.empty()) {
       // TODO: use a wait/notify mechanism instead of check/sleep.
       usleep(IDLE_TIME_ON_EMPTY_DEFERRED_EVENTS_US);
-    } else {
-      for (auto& event : events) {
-        int fd = event->GetOriginFileDescriptor();
-        uprobes_event_processor_->AddEvent(fd, std::move(event));
-      }
-
-      uprobes_event_processor_->ProcessOldEvents();
     }
   }
 }
@@ -598,31 +3441,205 @@ void TracerThread::Reset() {
   tracing_fds_.clear();
   ring_buffers_.clear();
   uprobes_fds_.clear();
+  mmap_task_fds_.clear();
+  sampling_fds_.clear();
+  callchain_sampling_fds_.clear();
+  bpf_function_calls_fds_.clear();
+  bpf_file_io_fds_.clear();
+  page_fault_fds_.clear();
+  major_page_fault_fds_.clear();
+  heap_allocation_fds_.clear();
+  bpf_heap_record_fds_.clear();
+  bpf_lock_wait_fds_.clear();
+  lock_wait_stack_fds_.clear();
+  branch_stack_fds_.clear();
   uprobes_ids_to_function_.clear();
+  uretprobes_ids_.clear();
+  uprobes_ring_buffer_fds_per_cpu_.clear();
+  pmu_counter_group_fds_per_cpu_.clear();
+  pmu_counter_switch_ids_.clear();
+  instrumented_function_fds_.clear();
+  added_instrumented_functions_.clear();
   gpu_tracing_fds_.clear();
-  deferred_events_.clear();
+  sched_switch_fds_.clear();
+  sched_waking_fds_.clear();
+  sched_wakeup_fds_.clear();
+  off_cpu_fds_.clear();
+  gpu_submission_fds_.clear();
+  thread_state_tids_.clear();
+  thread_names_ = ThreadNameTable{};
+  ring_buffer_fds_to_cpu_.clear();
+  uprobes_event_processor_watermarks_.clear();
+  ring_buffer_size_shift_ = 0;
+  ring_buffers_total_size_kb_ = 0;
+  lost_count_per_ring_buffer_fd_.clear();
+  redirected_fds_per_ring_buffer_fd_.clear();
+  sampled_thread_filter_.reset();
+  stack_dump_size_tuner_.reset();
+  next_stack_dump_retune_ns_ = 0;
+  active_sampling_events_per_ring_buffer_fd_.clear();
+  reader_threads_count_ = 1;
+  process_cpu_time_aggregator_ =
+      ProcessCpuTimeAggregator{PROCESS_CPU_TIME_BUCKET_NS};
+  bpf_stack_aggregator_.reset();
+  bpf_lost_count_ = 0;
+  branch_count_aggregator_ = BranchCountAggregator{};
+  next_branch_counts_report_ns_ = 0;
+  intel_pt_function_.reset();
+  bpf_uprobes_.reset();
+  bpf_file_io_.reset();
+  bpf_heap_profiler_.reset();
+  bpf_lock_contention_.reset();
+  ConsumeDeferredEvents();
   stop_deferred_thread_ = false;
 }
 
-void TracerThread::PrintStatsIfTimerElapsed() {
-  constexpr uint64_t EVENT_COUNT_WINDOW_S = 5;
+void TracerThread::ReportStatsIfTimerElapsed() {
+  constexpr uint64_t STATS_WINDOW_NS = 1'000'000'000;
+  constexpr uint64_t STATS_LOG_PERIOD_NS = 5'000'000'000;
 
-  if (stats_.event_count_begin_ns + EVENT_COUNT_WINDOW_S * 1'000'000'000 <
-      MonotonicTimestampNs()) {
-    double actual_window_s =
-        (MonotonicTimestampNs() - stats_.event_count_begin_ns) / 1e9;
-    LOG("Events per second (last %.1f s):", actual_window_s);
-    LOG("  sched switches: %.0f", stats_.sched_switch_count / actual_window_s);
-    LOG("  samples: %.0f", stats_.sample_count / actual_window_s);
-    LOG("  u(ret)probes: %.0f", stats_.uprobes_count / actual_window_s);
-    LOG("  gpu events: %.0f", stats_.gpu_events_count / actual_window_s);
-    LOG("  lost: %.0f, of which:", stats_.lost_count / actual_window_s);
+  const uint64_t now_ns = MonotonicTimestampNs();
+  if (stats_.event_count_begin_ns + STATS_WINDOW_NS > now_ns) {
+    return;
+  }
+  double actual_window_s = (now_ns - stats_.event_count_begin_ns) / 1e9;
+  TracerStats tracer_stats{stats_.event_count_begin_ns, now_ns};
+  tracer_stats.AddValue("sched switches/s",
+                        stats_.sched_switch_count / actual_window_s);
+  tracer_stats.AddValue("samples/s", stats_.sample_count / actual_window_s);
+  tracer_stats.AddValue("u(ret)probes/s",
+                        stats_.uprobes_count / actual_window_s);
+  tracer_stats.AddValue("gpu events/s",
+                        stats_.gpu_events_count / actual_window_s);
+  tracer_stats.AddValue("thread states/s",
+                        stats_.thread_state_count / actual_window_s);
+  tracer_stats.AddValue("off-cpu stacks/s",
+                        stats_.off_cpu_stack_count / actual_window_s);
+  tracer_stats.AddValue("file I/O syscalls/s",
+                        stats_.file_io_count / actual_window_s);
+  tracer_stats.AddValue("page fault stacks/s",
+                        stats_.page_fault_count / actual_window_s);
+  tracer_stats.AddValue("heap samples/s",
+                        stats_.heap_allocation_count / actual_window_s);
+  tracer_stats.AddValue("lock waits/s",
+                        stats_.lock_wait_count / actual_window_s);
+  tracer_stats.AddValue("gpu submission stacks/s",
+                        stats_.gpu_submission_stack_count / actual_window_s);
+  tracer_stats.AddValue("branch stacks/s",
+                        stats_.branch_stack_count / actual_window_s);
+  tracer_stats.AddValue("lost/s", stats_.lost_count / actual_window_s);
+  {
+    std::lock_guard<std::mutex> lock(stats_.lost_count_per_buffer_mutex);
     for (const auto& lost_from_buffer : stats_.lost_count_per_buffer) {
-      LOG("    from %s: %.0f", lost_from_buffer.first->GetName().c_str(),
+      tracer_stats.AddValue(
+          absl::StrFormat("lost from %s/s", lost_from_buffer.first->GetName()),
           lost_from_buffer.second / actual_window_s);
     }
-    stats_.Reset();
   }
+
+  tracer_stats.AddValue("deferred events queue",
+                        deferred_events_.size_approx());
+  tracer_stats.AddValue("ring buffers KB", ring_buffers_total_size_kb_);
+  tracer_stats.AddValue("capture start ms", start_latency_ns_ / 1e6);
+
+  BatchingTracerListener::LatencyStats latency_stats =
+      batching_listener_->TakeLatencyStats();
+  if (latency_stats.event_count > 0) {
+    tracer_stats.AddValue("listener latency avg us",
+                          latency_stats.total_latency_ns / 1e3 /
+                              latency_stats.event_count);
+    tracer_stats.AddValue("listener latency max us",
+                          latency_stats.max_latency_ns / 1e3);
+  }
+
+  LibunwindstackUnwinder::UnwindingStats unwinding_stats =
+      LibunwindstackUnwinder::TakeUnwindingStats();
+  tracer_stats.AddValue("unwound callstacks/s",
+                        unwinding_stats.unwind_count / actual_window_s);
+  if (unwinding_stats.unwind_count > 0) {
+    tracer_stats.AddValue("unwinding us/callstack",
+                          unwinding_stats.total_unwinding_ns / 1e3 /
+                              unwinding_stats.unwind_count);
+  }
+
+  if (now_ns >= next_stats_log_ns_) {
+    LOG("Tracer statistics (last %.1f s):", actual_window_s);
+    for (const auto& [name, value] : tracer_stats.GetValues()) {
+      LOG("  %s: %.1f", name.c_str(), value);
+    }
+    next_stats_log_ns_ = now_ns + STATS_LOG_PERIOD_NS;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock = LockListenerIfNeeded();
+    listener_->OnTracerStats(tracer_stats);
+  }
+  stats_.Reset();
+}
+
+void TracerThread::ReportProcessCpuTimes() {
+  if (!trace_system_wide_scheduling_) {
+    return;
+  }
+  const uint64_t now_ns = MonotonicTimestampNs();
+  if (now_ns < PROCESS_CPU_TIME_REPORT_DELAY_NS) {
+    return;
+  }
+  std::vector<ProcessCpuTimes> buckets;
+  {
+    std::lock_guard<std::mutex> lock(process_cpu_time_aggregator_mutex_);
+    buckets = process_cpu_time_aggregator_.TakeBucketsEndingBefore(
+        now_ns - PROCESS_CPU_TIME_REPORT_DELAY_NS);
+  }
+  for (const ProcessCpuTimes& process_cpu_times : buckets) {
+    std::unique_lock<std::mutex> lock = LockListenerIfNeeded();
+    listener_->OnProcessCpuTimes(process_cpu_times);
+  }
+}
+
+void TracerThread::ReportBpfCallstackCounts(bool force) {
+  if (bpf_stack_aggregator_ == nullptr) {
+    return;
+  }
+  const uint64_t now_ns = MonotonicTimestampNs();
+  if (!force && now_ns < next_bpf_drain_ns_) {
+    return;
+  }
+  next_bpf_drain_ns_ = now_ns + BPF_DRAIN_PERIOD_NS;
+
+  std::vector<CallstackCount> callstack_counts = bpf_stack_aggregator_->Drain();
+  for (const CallstackCount& callstack_count : callstack_counts) {
+    stats_.sample_count += callstack_count.GetCount();
+  }
+  uint64_t lost_count = bpf_stack_aggregator_->GetLostCount();
+  stats_.lost_count += lost_count - bpf_lost_count_;
+  bpf_lost_count_ = lost_count;
+  if (!callstack_counts.empty()) {
+    std::unique_lock<std::mutex> lock = LockListenerIfNeeded();
+    listener_->OnCallstackCounts(callstack_counts);
+  }
+}
+
+void TracerThread::ReportBranchCounts(bool force) {
+  if (branch_stack_fds_.empty()) {
+    return;
+  }
+  const uint64_t now_ns = MonotonicTimestampNs();
+  if (!force && now_ns < next_branch_counts_report_ns_) {
+    return;
+  }
+  next_branch_counts_report_ns_ = now_ns + BRANCH_COUNTS_REPORT_PERIOD_NS;
+
+  std::optional<BranchCounts> branch_counts;
+  {
+    std::lock_guard<std::mutex> lock(branch_count_aggregator_mutex_);
+    if (branch_count_aggregator_.IsEmpty()) {
+      return;
+    }
+    branch_counts = branch_count_aggregator_.TakeCounts(now_ns);
+  }
+  std::unique_lock<std::mutex> lock = LockListenerIfNeeded();
+  listener_->OnBranchCounts(branch_counts.value());
 }
 
 }  // namespace LinuxTracing
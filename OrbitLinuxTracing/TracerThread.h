@@ -3,33 +3,54 @@
 
 #include <OrbitLinuxTracing/Events.h>
 #include <OrbitLinuxTracing/Function.h>
+#include <OrbitLinuxTracing/Tracer.h>
 #include <OrbitLinuxTracing/TracerListener.h>
+#include <concurrentqueue.h>
 #include <linux/perf_event.h>
 
 #include <atomic>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <regex>
+#include <shared_mutex>
+#include <thread>
 #include <vector>
 
+#include "BatchingTracerListener.h"
+#include "BpfFileIo.h"
+#include "BpfLockContention.h"
+#include "BpfHeapProfiler.h"
+#include "BpfStackAggregator.h"
+#include "BpfUprobes.h"
+#include "BranchCountAggregator.h"
 #include "GpuTracepointEventProcessor.h"
+#include "InstrumentationRequests.h"
 #include "PerfEvent.h"
 #include "PerfEventProcessor.h"
 #include "PerfEventProcessor2.h"
 #include "PerfEventReaders.h"
+#include "PerfEventRecordFile.h"
 #include "PerfEventRingBuffer.h"
+#include "PrewarmedRingBuffers.h"
+#include "ProcessCpuTimeAggregator.h"
+#include "SampledThreadFilter.h"
+#include "StackDumpSizeTuner.h"
+#include "ThreadNameTable.h"
 #include "Utils.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/container/node_hash_map.h"
 
 namespace LinuxTracing {
 
 class TracerThread {
  public:
-  TracerThread(pid_t pid, uint64_t sampling_period_ns,
+  // The processes in pids are traced together, see Tracer.
+  TracerThread(const std::vector<pid_t>& pids, uint64_t sampling_period_ns,
                std::vector<Function> instrumented_functions)
-      : pid_(pid),
+      : pids_(pids.begin(), pids.end()),
         sampling_period_ns_(sampling_period_ns),
         instrumented_functions_(std::move(instrumented_functions)) {}
 
@@ -38,7 +59,16 @@ class TracerThread {
   TracerThread(TracerThread&&) = delete;
   TracerThread& operator=(TracerThread&&) = delete;
 
-  void SetListener(TracerListener* listener) { listener_ = listener; }
+  // Events are reported to listener in batches, see BatchingTracerListener.
+  void SetListener(TracerListener* listener) {
+    if (listener == nullptr) {
+      batching_listener_.reset();
+      listener_ = nullptr;
+      return;
+    }
+    batching_listener_ = std::make_unique<BatchingTracerListener>(listener);
+    listener_ = batching_listener_.get();
+  }
 
   void SetTraceContextSwitches(bool trace_context_switches) {
     trace_context_switches_ = trace_context_switches;
@@ -52,17 +82,342 @@ class TracerThread {
     trace_instrumented_functions_ = trace_instrumented_functions;
   }
 
+  // See Tracer::SetCpusPerReaderThread.
+  void SetCpusPerReaderThread(uint32_t cpus_per_reader_thread) {
+    cpus_per_reader_thread_ = cpus_per_reader_thread;
+  }
+
+  // See Tracer::SetThreadPlacement. Only numa_local_readers is applied here,
+  // Tracer applies the rest to the thread calling Run.
+  void SetThreadPlacement(ThreadPlacement thread_placement) {
+    thread_placement_ = std::move(thread_placement);
+  }
+
+  // See Tracer::SetUnwindingThreadCount.
+  void SetUnwindingThreadCount(uint32_t unwinding_thread_count) {
+    unwinding_thread_count_ = unwinding_thread_count;
+  }
+
+  // See Tracer::SetTraceThreadStates.
+  void SetTraceThreadStates(bool trace_thread_states) {
+    trace_thread_states_ = trace_thread_states;
+  }
+
+  // See Tracer::SetTraceSystemWideScheduling.
+  void SetTraceSystemWideScheduling(bool trace_system_wide_scheduling) {
+    trace_system_wide_scheduling_ = trace_system_wide_scheduling;
+  }
+
+  // See Tracer::SetPmuCounters.
+  void SetPmuCounters(std::vector<PmuCounter> pmu_counters) {
+    pmu_counters_ = std::move(pmu_counters);
+  }
+
+  // See Tracer::SetTraceOffCpuCallstacks.
+  void SetTraceOffCpuCallstacks(bool trace_off_cpu_callstacks) {
+    trace_off_cpu_callstacks_ = trace_off_cpu_callstacks;
+  }
+
+  // See Tracer::SetTraceGpuDriverEvents.
+  void SetTraceGpuDriverEvents(bool trace_gpu_driver_events) {
+    trace_gpu_driver_events_ = trace_gpu_driver_events;
+  }
+
+  // See Tracer::SetTraceGpuSubmissionCallstacks.
+  void SetTraceGpuSubmissionCallstacks(bool trace_gpu_submission_callstacks) {
+    trace_gpu_submission_callstacks_ = trace_gpu_submission_callstacks;
+  }
+
+  // See Tracer::SetSampleCallchains.
+  void SetSampleCallchains(bool sample_callchains) {
+    sample_callchains_ = sample_callchains;
+  }
+
+  // See Tracer::SetSampledThreads.
+  void SetSampledThreads(ThreadSelection sampled_threads) {
+    sampled_threads_ = std::move(sampled_threads);
+  }
+
+  // See Tracer::SetBpfStackAggregation.
+  void SetBpfStackAggregation(bool bpf_stack_aggregation) {
+    bpf_stack_aggregation_ = bpf_stack_aggregation;
+  }
+
+  // See Tracer::SetBpfFunctionCalls.
+  void SetBpfFunctionCalls(bool bpf_function_calls) {
+    bpf_function_calls_ = bpf_function_calls;
+  }
+
+  // See Tracer::SetTraceFileIo.
+  void SetTraceFileIo(bool trace_file_io) { trace_file_io_ = trace_file_io; }
+
+  // See Tracer::SetPageFaultSamplingPeriod.
+  void SetPageFaultSamplingPeriod(uint64_t page_fault_sampling_period) {
+    page_fault_sampling_period_ = page_fault_sampling_period;
+  }
+
+  // See Tracer::SetHeapSamplingInterval.
+  void SetHeapSamplingInterval(uint64_t heap_sampling_interval_bytes) {
+    heap_sampling_interval_bytes_ = heap_sampling_interval_bytes;
+  }
+
+  // See Tracer::SetLockWaitThresholdNs.
+  void SetLockWaitThresholdNs(uint64_t lock_wait_threshold_ns) {
+    lock_wait_threshold_ns_ = lock_wait_threshold_ns;
+  }
+
+  // See Tracer::SetBranchSampling.
+  void SetBranchSampling(BranchSampling branch_sampling, uint64_t period) {
+    branch_sampling_ = branch_sampling;
+    branch_sampling_period_ = period;
+  }
+
+  // Functions to instrument or to stop instrumenting during the capture, see
+  // Tracer::AddInstrumentedFunction.
+  void SetInstrumentationRequests(
+      std::shared_ptr<InstrumentationRequests> instrumentation_requests) {
+    instrumentation_requests_ = std::move(instrumentation_requests);
+  }
+
+  // See Tracer::SetRingBuffersMemoryBudgetKb.
+  void SetRingBuffersMemoryBudgetKb(uint64_t ring_buffers_memory_budget_kb) {
+    ring_buffers_memory_budget_kb_ = ring_buffers_memory_budget_kb;
+  }
+
+  // See Tracer::SetUnwindWithFramePointers.
+  void SetUnwindWithFramePointers(bool unwind_with_frame_pointers) {
+    unwind_with_frame_pointers_ = unwind_with_frame_pointers;
+  }
+
+  // See Tracer::SetRecordFilePath. An empty path records nothing.
+  void SetRecordFilePath(std::string record_file_path) {
+    record_file_path_ = std::move(record_file_path);
+  }
+
   void Run(const std::shared_ptr<std::atomic<bool>>& exit_requested);
 
+  // Opens the per-core events that Run opens whatever the instrumented
+  // functions, disabled, and leaves them with their ring buffers in
+  // PrewarmedRingBuffers for Run to take. Returns the id of the prewarm, see
+  // PrewarmedRingBuffers::Expire.
+  uint64_t Prewarm();
+
+  // Processes the records of a file written by Run with SetRecordFilePath, as
+  // Run processed them, on this thread and without opening any perf_event.
+  // The events are reported to the listener, unwound with the binaries of this
+  // machine, which must be the ones that were profiled. The thread counts, the
+  // ring buffers and the u(ret)probes are those of the recording, the
+  // unwinding settings those of this TracerThread. Returns false if the file
+  // can't be read or is invalid, after processing the records before the
+  // error.
+  bool Replay(const std::string& record_file_path);
+
  private:
-  bool OpenRingBufferForGpuTracepoint(
+  bool OpenRingBufferForTracepoint(
       const char* tracepoint_category, const char* tracepoint_name, int32_t cpu,
-      std::vector<int>* gpu_tracing_fds,
+      uint64_t ring_buffer_size_kb, std::vector<int>* tracing_fds,
       std::vector<PerfEventRingBuffer>* ring_buffers);
 
   bool OpenGpuTracepoints(const std::vector<int32_t>& cpus);
   bool InitGpuTracepointEventProcessor();
 
+  bool OpenThreadStateTracepoints(const std::vector<int32_t>& cpus);
+  bool OpenOffCpuTracepoints(const std::vector<int32_t>& cpus);
+  // The minor and the major page faults of each of cpus, each in a ring
+  // buffer of its own. On error, none is kept open.
+  bool OpenPageFaultEvents(const std::vector<int32_t>& cpus);
+
+  // Opens the groups of pmu_counters_ on cpus, before the u(ret)probes that
+  // join them. On error, none is kept open.
+  bool OpenPmuCounters(const std::vector<int32_t>& cpus);
+  // Adds the sched:sched_switch events that read the counters to the groups,
+  // redirected to the uprobes ring buffers.
+  bool OpenPmuCounterSwitches();
+  // Whether the u(ret)probes of function are in the groups of PMU counters.
+  bool RecordsPmuCounters(const Function& function) const;
+
+  // The cores to record the context switches on, all of them, and the cores
+  // in the cpusets of the processes, to record everything else on.
+  void ComputeCpus(std::vector<int32_t>* all_cpus,
+                   std::vector<int32_t>* cpuset_cpus) const;
+  // With a memory budget, computes ring_buffer_size_shift_ from the ring
+  // buffers Run opens on these cores.
+  void ComputeRingBufferSizeShift(const std::vector<int32_t>& all_cpus,
+                                  const std::vector<int32_t>& cpuset_cpus);
+  void ComputeRingBufferSizeShift(uint64_t default_total_size_kb);
+  uint64_t ScaledRingBufferSizeKb(uint64_t default_size_kb) const;
+
+  struct RingBufferAdaptationState {
+    uint64_t sampling_period_ns;
+    // Consecutive adaptation periods with lost events.
+    uint32_t lossy_period_count = 0;
+  };
+  void AdaptRingBuffer(PerfEventRingBuffer* ring_buffer,
+                       RingBufferAdaptationState* state);
+  bool GrowRingBuffer(PerfEventRingBuffer* ring_buffer);
+  // Creates sampled_thread_filter_ with the current names of the threads of
+  // the targets, and attaches its program to sampling_fds, if it loads.
+  void CreateSampledThreadFilter(const std::vector<int>& sampling_fds);
+  // Reopens the sampling events with the size of stack dump chosen by
+  // stack_dump_size_tuner_, if it changed, every STACK_DUMP_RETUNE_PERIOD_NS.
+  // The new events are redirected to the ring buffers of the old ones.
+  void RetuneStackDumpSizeIfTimerElapsed();
+
+  // The per-core events that have a ring buffer of their own, which Run
+  // opens on every core, before the capture starts and in parallel.
+  enum class PerCpuEvent { kContextSwitch, kMmapTask, kSampling };
+  PrewarmedRingBuffers::Key GetPerCpuEventKey(PerCpuEvent event,
+                                              int32_t cpu) const;
+  // Opens event on cpu with its ring buffer, disabled. Only reads the state of
+  // this object, so several threads can open events at once.
+  std::optional<PerfEventRingBuffer> OpenPerCpuEvent(PerCpuEvent event,
+                                                     int32_t cpu) const;
+  // Opens event on each of cpus, taking the ring buffers prewarmed for them,
+  // and adds them to tracing_fds_, ring_buffers_ and ring_buffer_fds_to_cpu_.
+  // Returns the file descriptors, and sets errors if some could not be opened.
+  std::vector<int> OpenPerCpuEvents(PerCpuEvent event,
+                                    const std::vector<int32_t>& cpus,
+                                    bool* errors);
+
+  // Opens and redirects the uprobes and uretprobes for function on cpus,
+  // without enabling them. Without create_ring_buffers, a uprobes ring buffer
+  // must already exist for all cpus.
+  bool OpenUprobes(const Function& function, const std::vector<int32_t>& cpus,
+                   bool create_ring_buffers);
+  struct UprobesFds {
+    absl::flat_hash_map<int32_t, int> uprobes_fds_per_cpu;
+    absl::flat_hash_map<int32_t, int> uretprobes_fds_per_cpu;
+  };
+  // The first half of OpenUprobes: opens the u(ret)probes for function on
+  // cpus, closing them all on error. Only reads the state of this object, so
+  // the u(ret)probes of several functions can be opened at once.
+  bool OpenUprobesFds(const Function& function,
+                      const std::vector<int32_t>& cpus, UprobesFds* fds) const;
+  // The second half: keeps the u(ret)probes and redirects them to the uprobes
+  // ring buffers, creating the ones that don't exist yet.
+  void AddUprobes(const Function& function, const std::vector<int32_t>& cpus,
+                  const UprobesFds& fds);
+  // Creates bpf_uprobes_, with a bpf-output event and its ring buffer on each
+  // of cpus. On error, bpf_uprobes_ stays null.
+  bool OpenBpfUprobes(const std::vector<int32_t>& cpus);
+  // Whether the u(ret)probes of function are paired by bpf_uprobes_.
+  bool UsesBpfUprobes(const Function& function) const;
+  // Instead of redirecting them, attaches the programs of bpf_uprobes_ to the
+  // u(ret)probes and keeps them. Returns false if the program of the function
+  // can't be loaded, with nothing attached.
+  bool AttachBpfUprobes(const Function& function, const UprobesFds& fds);
+  // Creates bpf_file_io_, with a bpf-output event and its ring buffer on each
+  // of cpus, and opens the syscall tracepoints. On error, bpf_file_io_ stays
+  // null.
+  bool OpenBpfFileIo(const std::vector<int32_t>& cpus);
+  // Creates bpf_heap_profiler_, with a bpf-output event and its ring buffer on
+  // each of cpus, and opens the u(ret)probes of the allocator of each process
+  // of initial_maps_per_pid. On error, bpf_heap_profiler_ stays null.
+  bool OpenHeapProfiler(
+      const std::vector<int32_t>& cpus,
+      const absl::flat_hash_map<pid_t, std::string>& initial_maps_per_pid);
+  // Creates bpf_lock_contention_, with a bpf-output event and a sys_exit_futex
+  // event with stacks, and their ring buffers, on each of cpus. On error,
+  // bpf_lock_contention_ stays null.
+  bool OpenBpfLockContention(const std::vector<int32_t>& cpus);
+  // Opens the branch stack sampling events and their ring buffers on cpus,
+  // closing them all on error, e.g. without LBR.
+  bool OpenBranchStackEvents(const std::vector<int32_t>& cpus);
+  void ProcessInstrumentationRequests();
+  void AddInstrumentedFunction(const Function& function);
+  void RemoveInstrumentedFunction(uint64_t virtual_address);
+  // Opens and enables the Intel PT events of Tracer::TraceWithIntelPt on the
+  // threads of the targets, unless a window is still in progress.
+  void StartIntelPtWindow(const Function& function, uint64_t function_size,
+                          uint64_t duration_ns);
+  // Once the window of Intel PT has elapsed, or if force, closes its events
+  // and decodes their traces in the background. Reports the calls decoded
+  // once done, or waits for them if force.
+  void UpdateIntelPtWindow(bool force);
+  const Function* GetUprobesFunction(uint64_t stream_id, bool* is_uretprobe);
+
+  // Shared by Run and Replay. The events of each process are unwound with
+  // its own maps, see PerProcessVisitor.
+  void CreateUprobesEventProcessor(
+      const absl::flat_hash_map<pid_t, std::string>& initial_maps_per_pid);
+
+  // The threads of all the processes in pids_.
+  std::vector<pid_t> ListTargetThreads() const;
+  // Reads the names of the threads of pids_ from /proc, as their names from
+  // timestamp_ns on. Renames from then on come from PERF_RECORD_COMM.
+  void ReportInitialThreadNames(uint64_t timestamp_ns);
+
+  // Writes what Replay needs, besides the records, to record_file_writer_.
+  void RecordCaptureSetup(
+      const absl::flat_hash_map<pid_t, std::string>& initial_maps_per_pid,
+      const std::vector<pid_t>& tids);
+  // Bits of the kRingBuffer entries, for the sets of file descriptors a ring
+  // buffer is in.
+  enum RingBufferKind : uint32_t {
+    kUprobesRingBuffer = 1 << 0,
+    kMmapTaskRingBuffer = 1 << 1,
+    kSamplingRingBuffer = 1 << 2,
+    kCallchainSamplingRingBuffer = 1 << 3,
+    kGpuTracingRingBuffer = 1 << 4,
+    kSchedSwitchRingBuffer = 1 << 5,
+    kSchedWakingRingBuffer = 1 << 6,
+    kSchedWakeupRingBuffer = 1 << 7,
+    kOffCpuRingBuffer = 1 << 8,
+    // Its events go to uprobes_event_processor_.
+    kDeferredRingBuffer = 1 << 9,
+    kBpfFunctionCallsRingBuffer = 1 << 10,
+    kGpuSubmissionRingBuffer = 1 << 11,
+    kBpfFileIoRingBuffer = 1 << 12,
+    kHeapAllocationRingBuffer = 1 << 13,
+    kBpfHeapRecordRingBuffer = 1 << 14,
+    kPageFaultRingBuffer = 1 << 15,
+    kMajorPageFaultRingBuffer = 1 << 16,
+    kBpfLockWaitRingBuffer = 1 << 17,
+    kLockWaitStackRingBuffer = 1 << 18,
+    kBranchStackRingBuffer = 1 << 19,
+  };
+  struct ReplayState {
+    // Into ring_buffers_, by the file descriptor they were recorded from.
+    absl::flat_hash_map<int, size_t> ring_buffer_indices;
+    // The maps at the beginning of the capture, until the threads entry
+    // creates uprobes_event_processor_ with them.
+    absl::flat_hash_map<pid_t, std::string> initial_maps_per_pid;
+    // The time of the capture, as far as the entries replayed so far tell.
+    uint64_t timestamp_ns = 0;
+    uint64_t record_count = 0;
+  };
+  // Returns false if the entry is invalid.
+  bool ReplayEntry(RecordFileEntryType type, absl::Span<const uint8_t> payload,
+                   ReplayState* state);
+  // Passes the deferred events to uprobes_event_processor_, as
+  // ProcessDeferredEvents does during Run.
+  void AddReplayedDeferredEvents();
+
+  std::vector<std::vector<PerfEventRingBuffer*>> AssignRingBuffersToReaders();
+  // With ThreadPlacement::numa_local_readers, restricts the calling reader
+  // thread to the cpus of the NUMA node of the ring buffers it reads.
+  void PinReaderToNumaNode(
+      const std::vector<PerfEventRingBuffer*>& ring_buffers);
+  // The main thread also prints statistics and processes the instrumentation
+  // requests.
+  void ReadRingBuffers(std::vector<PerfEventRingBuffer*> ring_buffers,
+                       bool main_thread,
+                       const std::atomic<bool>& exit_requested);
+  void ReadAndProcessRecord(PerfEventRingBuffer* ring_buffer);
+
+  // Records that don't need to be sorted are passed to the listener (or to the
+  // GpuTracepointEventProcessor) directly by the thread reading them. When
+  // there are multiple reader threads, these calls need to be serialized.
+  std::unique_lock<std::mutex> LockListenerIfNeeded() {
+    if (reader_threads_count_ > 1) {
+      return std::unique_lock<std::mutex>{listener_mutex_};
+    }
+    return std::unique_lock<std::mutex>{};
+  }
+
+  static Callstack CallstackFromCallchainSample(
+      const CallchainSamplePerfEvent& event);
+
   void ProcessContextSwitchEvent(const perf_event_header& header,
                                  PerfEventRingBuffer* ring_buffer);
   void ProcessContextSwitchCpuWideEvent(const perf_event_header& header,
@@ -71,17 +426,53 @@ class TracerThread {
                         PerfEventRingBuffer* ring_buffer);
   void ProcessExitEvent(const perf_event_header& header,
                         PerfEventRingBuffer* ring_buffer);
+  void ProcessCommEvent(const perf_event_header& header,
+                        PerfEventRingBuffer* ring_buffer);
   void ProcessMmapEvent(const perf_event_header& header,
                         PerfEventRingBuffer* ring_buffer);
   void ProcessSampleEvent(const perf_event_header& header,
                           PerfEventRingBuffer* ring_buffer);
+  void ProcessThreadStateEvent(const perf_event_header& header,
+                               PerfEventRingBuffer* ring_buffer);
+  void ProcessOffCpuEvent(const perf_event_header& header,
+                          PerfEventRingBuffer* ring_buffer);
+  void ProcessBpfFunctionCallEvent(const perf_event_header& header,
+                                   PerfEventRingBuffer* ring_buffer);
+  void ProcessBpfFileIoEvent(const perf_event_header& header,
+                             PerfEventRingBuffer* ring_buffer);
+  void ProcessPageFaultEvent(const perf_event_header& header,
+                             PerfEventRingBuffer* ring_buffer);
+  void ProcessHeapAllocationEvent(const perf_event_header& header,
+                                  PerfEventRingBuffer* ring_buffer);
+  void ProcessBpfHeapRecordEvent(const perf_event_header& header,
+                                 PerfEventRingBuffer* ring_buffer);
+  void ProcessBpfLockWaitEvent(const perf_event_header& header,
+                               PerfEventRingBuffer* ring_buffer);
+  void ProcessLockWaitStackEvent(const perf_event_header& header,
+                                 PerfEventRingBuffer* ring_buffer);
+  void ProcessBranchStackEvent(const perf_event_header& header,
+                               PerfEventRingBuffer* ring_buffer);
   void ProcessLostEvent(const perf_event_header& header,
                         PerfEventRingBuffer* ring_buffer);
 
   void Reset();
-  void PrintStatsIfTimerElapsed();
+  // Reports the statistics of the stages of the tracer to the listener, once
+  // per window, and logs them every few windows.
+  void ReportStatsIfTimerElapsed();
+  // Reports to the listener the buckets of process_cpu_time_aggregator_ that
+  // ended at least PROCESS_CPU_TIME_REPORT_DELAY_NS before now.
+  void ReportProcessCpuTimes();
+  // With the stack samples aggregated in the kernel, reports the callstacks
+  // counted since the last call, every BPF_DRAIN_PERIOD_NS or if force.
+  void ReportBpfCallstackCounts(bool force);
+  // With branch sampling, reports the branches counted since the last call,
+  // every BRANCH_COUNTS_REPORT_PERIOD_NS or if force.
+  void ReportBranchCounts(bool force);
 
   void DeferEvent(std::unique_ptr<PerfEvent> event);
+  // Defers the maps of the targets read again entirely, as if they were an
+  // event of the ring buffer of fd.
+  void DeferMapsEvent(int fd, uint64_t timestamp_ns);
   std::vector<std::unique_ptr<PerfEvent>> ConsumeDeferredEvents();
   void ProcessDeferredEvents();
 
@@ -94,45 +485,327 @@ class TracerThread {
   static constexpr uint64_t MMAP_TASK_RING_BUFFER_SIZE_KB = 64;
   static constexpr uint64_t SAMPLING_RING_BUFFER_SIZE_KB = 2 * 1024;
   static constexpr uint64_t GPU_TRACING_RING_BUFFER_SIZE_KB = 256;
+  // For amdgpu_cs_ioctl with the user stacks, of all processes.
+  static constexpr uint64_t GPU_SUBMISSION_RING_BUFFER_SIZE_KB = 1024;
+  static constexpr uint64_t THREAD_STATE_RING_BUFFER_SIZE_KB = 256;
+  static constexpr uint64_t OFF_CPU_RING_BUFFER_SIZE_KB = 2 * 1024;
+  // A record per call instead of two, and smaller ones.
+  static constexpr uint64_t BPF_FUNCTION_CALLS_RING_BUFFER_SIZE_KB = 16 * 1024;
+  // 40 bytes per syscall, for bursts of a few 100k syscalls per second.
+  static constexpr uint64_t BPF_FILE_IO_RING_BUFFER_SIZE_KB = 4 * 1024;
+  // The stacks of the sampled minor page faults, of all processes, and of all
+  // the major ones, which are much rarer.
+  static constexpr uint64_t PAGE_FAULTS_RING_BUFFER_SIZE_KB = 2 * 1024;
+  static constexpr uint64_t MAJOR_PAGE_FAULTS_RING_BUFFER_SIZE_KB = 512;
+  // About 800 bytes per sample with 32 branch records, and a thousand samples
+  // per second and core with the default period.
+  static constexpr uint64_t BRANCH_STACKS_RING_BUFFER_SIZE_KB = 1024;
+  // The stacks of the sampled allocations: a few thousand per second with the
+  // default interval, even for allocation-heavy targets.
+  static constexpr uint64_t HEAP_ALLOCATIONS_RING_BUFFER_SIZE_KB = 8 * 1024;
+  // 64 bytes per sampled allocation or free.
+  static constexpr uint64_t BPF_HEAP_RECORDS_RING_BUFFER_SIZE_KB = 512;
+  // The stacks of the waits above the threshold, which is meant to keep them
+  // to at most a few thousand per second, and their records.
+  static constexpr uint64_t LOCK_WAIT_STACKS_RING_BUFFER_SIZE_KB = 2 * 1024;
+  static constexpr uint64_t BPF_LOCK_WAITS_RING_BUFFER_SIZE_KB = 256;
+  // Per thread, for the trace of a function during a window of Intel PT:
+  // mostly timing packets, about 6 MB per second of running with the MTC
+  // period below, so a window of up to a few hundred milliseconds.
+  static constexpr uint64_t INTEL_PT_AUX_BUFFER_SIZE_KB = 2 * 1024;
+  // MTC packets every 2^3 ticks of the crystal clock, e.g. every 333 ns at
+  // 24 MHz, which is the precision of the calls decoded.
+  static constexpr uint32_t INTEL_PT_MTC_PERIOD = 3;
+
+  // With a memory budget for the ring buffers, how often each reader thread
+  // checks its ring buffers for lost events. A ring buffer that lost events
+  // since the last check is doubled in size, if the budget allows. If it
+  // doesn't, the sampling period of a sampling ring buffer that lost events in
+  // LOSSY_PERIODS_BEFORE_THROTTLING consecutive checks is doubled, up to
+  // MAX_SAMPLING_PERIOD_MULTIPLIER times the requested one.
+  static constexpr uint64_t RING_BUFFER_ADAPTATION_PERIOD_NS = 1'000'000'000;
+  static constexpr uint32_t LOSSY_PERIODS_BEFORE_THROTTLING = 3;
+  static constexpr uint64_t MAX_SAMPLING_PERIOD_MULTIPLIER = 16;
+
+  // How often the size of the user stacks dumped by the sampling events is
+  // adapted to the stacks of the sampled threads, see StackDumpSizeTuner.
+  static constexpr uint64_t STACK_DUMP_RETUNE_PERIOD_NS = 5'000'000'000;
+
+  // When a ring buffer is found empty, we assume that any record still to come
+  // has a timestamp not older than the beginning of the polling round, minus
+  // this margin. The margin accounts for the time between the kernel taking
+  // the timestamp of a record and the record being visible in the ring buffer.
+  static constexpr uint64_t EMPTY_RING_BUFFER_WATERMARK_MARGIN_NS = 1'000'000;
+
+  // With system-wide scheduling, the time each process spends on the cores is
+  // reported for every PROCESS_CPU_TIME_BUCKET_NS, once no more context
+  // switches are expected in that window, i.e., after a delay that covers the
+  // time records spend in the ring buffers.
+  static constexpr uint64_t PROCESS_CPU_TIME_BUCKET_NS = 100'000'000;
+  static constexpr uint64_t PROCESS_CPU_TIME_REPORT_DELAY_NS = 200'000'000;
+
+  // Short enough for the distinct callstacks sampled in between to fit in the
+  // maps of BpfStackAggregator.
+  static constexpr uint64_t BPF_DRAIN_PERIOD_NS = 500'000'000;
+
+  static constexpr uint64_t BRANCH_COUNTS_REPORT_PERIOD_NS = 500'000'000;
+
+  // While recording, the watermark of an empty ring buffer is recorded at most
+  // once per RECORDED_WATERMARK_PERIOD_NS, which is enough for Replay to
+  // process the events with a similar delay as Run.
+  static constexpr uint64_t RECORDED_WATERMARK_PERIOD_NS = 10'000'000;
+  // Replay processes the deferred events at least every
+  // REPLAY_DEFERRED_EVENTS_BATCH_SIZE records.
+  static constexpr uint64_t REPLAY_DEFERRED_EVENTS_BATCH_SIZE = 1024;
+  // Replayed records are written to a ring buffer and read right away, so the
+  // ring buffer only needs to fit the largest record, of less than 64 KB.
+  static constexpr uint64_t REPLAY_RING_BUFFER_SIZE_KB = 128;
+
+  // perf_event_open and mmap mostly wait on the kernel, e.g. for uprobes to
+  // be registered, so events are opened with more threads than cores.
+  static constexpr size_t MAX_SETUP_THREADS = 32;
 
   static constexpr uint32_t IDLE_TIME_ON_EMPTY_RING_BUFFERS_US = 100;
   static constexpr uint32_t IDLE_TIME_ON_EMPTY_DEFERRED_EVENTS_US = 1000;
 
-  pid_t pid_;
+  absl::flat_hash_set<pid_t> pids_;
   uint64_t sampling_period_ns_;
   std::vector<Function> instrumented_functions_;
 
+  std::unique_ptr<BatchingTracerListener> batching_listener_;
+  // Either batching_listener_ or nullptr.
   TracerListener* listener_ = nullptr;
 
   bool trace_context_switches_ = true;
   bool trace_callstacks_ = true;
   bool trace_instrumented_functions_ = true;
   bool trace_gpu_driver_events_ = false;
+  bool trace_thread_states_ = false;
+  bool trace_system_wide_scheduling_ = true;
+  uint32_t cpus_per_reader_thread_ = 0;
+  ThreadPlacement thread_placement_;
+  uint32_t unwinding_thread_count_ = 0;
+  bool unwind_with_frame_pointers_ = false;
+  bool sample_callchains_ = false;
+  ThreadSelection sampled_threads_;
+  bool bpf_stack_aggregation_ = false;
+  bool bpf_function_calls_ = false;
+  uint64_t ring_buffers_memory_budget_kb_ = 0;
+  std::vector<PmuCounter> pmu_counters_;
+  bool trace_off_cpu_callstacks_ = false;
+  bool trace_gpu_submission_callstacks_ = false;
+  bool trace_file_io_ = false;
+  uint64_t page_fault_sampling_period_ = 0;
+  uint64_t heap_sampling_interval_bytes_ = 0;
+  uint64_t lock_wait_threshold_ns_ = 0;
+  BranchSampling branch_sampling_ = BranchSampling::kNone;
+  uint64_t branch_sampling_period_ = 0;
 
   std::vector<int> tracing_fds_;
   std::vector<PerfEventRingBuffer> ring_buffers_;
   absl::flat_hash_set<int> uprobes_fds_;
+  absl::flat_hash_set<int> mmap_task_fds_;
+  absl::flat_hash_set<int> sampling_fds_;
+  absl::flat_hash_set<int> callchain_sampling_fds_;
+  absl::flat_hash_set<int> bpf_function_calls_fds_;
+  absl::flat_hash_set<int> bpf_file_io_fds_;
+  absl::flat_hash_set<int> page_fault_fds_;
+  absl::flat_hash_set<int> major_page_fault_fds_;
+  // The ring buffers of the uprobes of the allocation functions, and of the
+  // records of bpf_heap_profiler_.
+  absl::flat_hash_set<int> heap_allocation_fds_;
+  absl::flat_hash_set<int> bpf_heap_record_fds_;
+  // The ring buffers of the records of bpf_lock_contention_, and of the
+  // stacks of the waits.
+  absl::flat_hash_set<int> bpf_lock_wait_fds_;
+  absl::flat_hash_set<int> lock_wait_stack_fds_;
+  absl::flat_hash_set<int> branch_stack_fds_;
+  // Functions can be instrumented by the main thread while the reader threads
+  // look up their stream ids, which are the only way to demultiplex the
+  // records of the uprobes ring buffers shared by all functions.
   absl::flat_hash_map<uint64_t, const Function*> uprobes_ids_to_function_;
+  absl::flat_hash_set<uint64_t> uretprobes_ids_;
+  std::shared_mutex uprobes_ids_to_function_mutex_;
+  absl::flat_hash_map<int32_t, int> uprobes_ring_buffer_fds_per_cpu_;
+  struct InstrumentedFunctionFds {
+    std::vector<int> uprobes_fds;
+    std::vector<int> uretprobes_fds;
+  };
+  // Keyed by the virtual address of the function.
+  absl::flat_hash_map<uint64_t, InstrumentedFunctionFds>
+      instrumented_function_fds_;
+  // The functions instrumented during the capture, in a container that keeps
+  // their addresses stable.
+  std::deque<Function> added_instrumented_functions_;
+  std::shared_ptr<InstrumentationRequests> instrumentation_requests_;
+  // The leaders of the groups of PMU counters, empty if the counters are not
+  // recorded. Only written before the reader threads start.
+  absl::flat_hash_map<int32_t, int> pmu_counter_group_fds_per_cpu_;
+  // The stream ids of the sched:sched_switch events of the groups, whose
+  // records go to the uprobes ring buffers.
+  absl::flat_hash_set<uint64_t> pmu_counter_switch_ids_;
   absl::flat_hash_set<int> gpu_tracing_fds_;
+  // The amdgpu_cs_ioctl tracepoints with the user stacks, also in
+  // gpu_tracing_fds_. Only the stacks of the target processes are deferred.
+  absl::flat_hash_set<int> gpu_submission_fds_;
+  absl::flat_hash_set<int> sched_switch_fds_;
+  absl::flat_hash_set<int> sched_waking_fds_;
+  absl::flat_hash_set<int> sched_wakeup_fds_;
+  absl::flat_hash_set<int> off_cpu_fds_;
+  // The threads of the target processes, whose records of the sched tracepoints
+  // are kept, for the thread states and the off-CPU callstacks. Threads are
+  // added by the reader thread that sees them spawn.
+  absl::flat_hash_set<pid_t> thread_state_tids_;
+  std::shared_mutex thread_state_tids_mutex_;
+  // The names of the threads of the target processes, from the records of the
+  // mmap_task ring buffers, which all reader threads can read.
+  ThreadNameTable thread_names_;
+  std::mutex thread_names_mutex_;
+  absl::flat_hash_map<int, int32_t> ring_buffer_fds_to_cpu_;
+  // With ThreadPlacement::numa_local_readers, filled by
+  // AssignRingBuffersToReaders. Empty without NUMA.
+  absl::flat_hash_map<int, std::vector<int>> numa_node_cpus_;
+  absl::flat_hash_map<int32_t, int> cpu_numa_nodes_;
+  // For the ring buffers whose events go to uprobes_event_processor_, the
+  // timestamp below which no more records are expected (see
+  // PerfEventProcessor2::AdvanceWatermark). Each entry is written by the thread
+  // reading that ring buffer and read by the thread processing deferred events.
+  absl::node_hash_map<int, std::atomic<uint64_t>>
+      uprobes_event_processor_watermarks_;
+
+  // The default ring buffer sizes are divided by 2^ring_buffer_size_shift_ to
+  // fit in ring_buffers_memory_budget_kb_.
+  uint32_t ring_buffer_size_shift_ = 0;
+  std::atomic<uint64_t> ring_buffers_total_size_kb_ = 0;
+  // Unlike EventStats::lost_count_per_buffer, these counts are not reset when
+  // printing statistics, but by AdaptRingBuffer.
+  absl::node_hash_map<int, std::atomic<uint64_t>>
+      lost_count_per_ring_buffer_fd_;
+  // The file descriptors of the events whose records go to the ring buffer of
+  // another file descriptor, which need to be redirected again on resize.
+  absl::flat_hash_map<int, std::vector<int>> redirected_fds_per_ring_buffer_fd_;
+  // Protects redirected_fds_per_ring_buffer_fd_ and prevents redirecting to a
+  // ring buffer being resized.
+  std::mutex uprobes_redirect_mutex_;
+
+  // Only with a non-empty sampled_threads_, and samples in ring buffers.
+  std::unique_ptr<SampledThreadFilter> sampled_thread_filter_;
+
+  // Only when the sampled stacks are unwound in user space.
+  std::unique_ptr<StackDumpSizeTuner> stack_dump_size_tuner_;
+  uint64_t next_stack_dump_retune_ns_ = 0;
+  // The sampling event currently recording to the ring buffer of each of
+  // sampling_fds_, which is the ring buffer's own until the size of stack dump
+  // changes, and its sampling period, which AdaptRingBuffer can increase.
+  struct ActiveSamplingEvent {
+    int fd;
+    uint64_t period_ns;
+  };
+  absl::flat_hash_map<int, ActiveSamplingEvent>
+      active_sampling_events_per_ring_buffer_fd_;
+  std::mutex active_sampling_events_mutex_;
+
+  size_t reader_threads_count_ = 1;
+  std::mutex listener_mutex_;
+
+  // Fed by all reader threads with the context switches of all processes.
+  ProcessCpuTimeAggregator process_cpu_time_aggregator_{
+      PROCESS_CPU_TIME_BUCKET_NS};
+  std::mutex process_cpu_time_aggregator_mutex_;
+  // Also fed by all reader threads, with the branch stacks of the target.
+  BranchCountAggregator branch_count_aggregator_;
+  std::mutex branch_count_aggregator_mutex_;
+  uint64_t next_branch_counts_report_ns_ = 0;
+
+  // The events of the window of Intel PT in progress, one per thread, only
+  // accessed by the main thread.
+  struct IntelPtTrace {
+    pid_t tid;
+    int fd;
+    void* ring_buffer;
+    void* aux_buffer;
+  };
+  std::vector<IntelPtTrace> intel_pt_traces_;
+  std::optional<Function> intel_pt_function_;
+  double intel_pt_tsc_ctc_ratio_ = 0;
+  // The TSC and the time at the beginning of the window, to convert the
+  // timestamps of the trace.
+  uint64_t intel_pt_begin_tsc_ = 0;
+  uint64_t intel_pt_begin_ns_ = 0;
+  uint64_t intel_pt_end_ns_ = 0;
+  // Decodes the traces of the last window into intel_pt_calls_, then sets
+  // intel_pt_decoded_.
+  std::thread intel_pt_decoding_thread_;
+  std::atomic<bool> intel_pt_decoded_ = false;
+  std::vector<FunctionCall> intel_pt_calls_;
+
+  std::string record_file_path_;
+  // Only set while Run records.
+  std::unique_ptr<RecordFileWriter> record_file_writer_;
+  // Set during Replay, where nothing is read from the machine but the
+  // binaries, as maps and threads come from the record file.
+  bool replaying_ = false;
 
   std::atomic<bool> stop_deferred_thread_ = false;
-  std::vector<std::unique_ptr<PerfEvent>> deferred_events_;
-  std::mutex deferred_events_mutex_;
+  moodycamel::ConcurrentQueue<std::unique_ptr<PerfEvent>> deferred_events_;
   std::shared_ptr<PerfEventProcessor2> uprobes_event_processor_;
   std::shared_ptr<GpuTracepointEventProcessor> gpu_event_processor_;
 
+  // The counters can be incremented by multiple reader threads.
   struct EventStats {
-    void Reset() { *this = EventStats(); }
+    void Reset() {
+      event_count_begin_ns = MonotonicTimestampNs();
+      sched_switch_count = 0;
+      sample_count = 0;
+      uprobes_count = 0;
+      gpu_events_count = 0;
+      thread_state_count = 0;
+      off_cpu_stack_count = 0;
+      file_io_count = 0;
+      heap_allocation_count = 0;
+      page_fault_count = 0;
+      lock_wait_count = 0;
+      gpu_submission_stack_count = 0;
+      branch_stack_count = 0;
+      lost_count = 0;
+      std::lock_guard<std::mutex> lock(lost_count_per_buffer_mutex);
+      lost_count_per_buffer.clear();
+    }
     uint64_t event_count_begin_ns = MonotonicTimestampNs();
-    uint64_t sched_switch_count = 0;
-    uint64_t sample_count = 0;
-    uint64_t uprobes_count = 0;
-    uint64_t gpu_events_count = 0;
-    uint64_t lost_count = 0;
+    std::atomic<uint64_t> sched_switch_count = 0;
+    std::atomic<uint64_t> sample_count = 0;
+    std::atomic<uint64_t> uprobes_count = 0;
+    std::atomic<uint64_t> gpu_events_count = 0;
+    std::atomic<uint64_t> thread_state_count = 0;
+    std::atomic<uint64_t> off_cpu_stack_count = 0;
+    std::atomic<uint64_t> file_io_count = 0;
+    std::atomic<uint64_t> heap_allocation_count = 0;
+    std::atomic<uint64_t> page_fault_count = 0;
+    std::atomic<uint64_t> lock_wait_count = 0;
+    std::atomic<uint64_t> gpu_submission_stack_count = 0;
+    std::atomic<uint64_t> branch_stack_count = 0;
+    std::atomic<uint64_t> lost_count = 0;
     absl::flat_hash_map<PerfEventRingBuffer*, uint64_t> lost_count_per_buffer{};
+    std::mutex lost_count_per_buffer_mutex;
   };
 
   EventStats stats_;
+  uint64_t next_stats_log_ns_ = 0;
+
+  // Only while the stack samples are aggregated in the kernel.
+  std::unique_ptr<BpfStackAggregator> bpf_stack_aggregator_;
+  uint64_t next_bpf_drain_ns_ = 0;
+  uint64_t bpf_lost_count_ = 0;
+  // Only while the u(ret)probes are paired in the kernel.
+  std::unique_ptr<BpfUprobes> bpf_uprobes_;
+  // Only while the file I/O syscalls are traced.
+  std::unique_ptr<BpfFileIo> bpf_file_io_;
+  // Only while the heap allocations are sampled.
+  std::unique_ptr<BpfHeapProfiler> bpf_heap_profiler_;
+  // Only while the lock contention is traced.
+  std::unique_ptr<BpfLockContention> bpf_lock_contention_;
+  // From the call to Run to the events being enabled.
+  uint64_t start_latency_ns_ = 0;
 };
 
 }  // namespace LinuxTracing
@@ -0,0 +1,258 @@
+#include <gtest/gtest.h>
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "GpuTracepointEventProcessor.h"
+#include "LibunwindstackUnwinder.h"
+#include "OrbitBase/Logging.h"
+#include "PerfEventOpen.h"
+#include "PerfEventRingBuffer.h"
+
+// Microbenchmarks of the stages of the tracing pipeline after the kernel:
+// reading records from a ring buffer, unwinding the callstack of a sample, and
+// matching GPU tracepoints into jobs. The events are synthetic, with the sizes
+// of the records of a real capture, so that the benchmarks do not depend on
+// the machine they run on. Reordering the events is measured by
+// PerfEventQueueBenchmark. Disabled by default, run with:
+//   OrbitLinuxTracingTests --gtest_also_run_disabled_tests \
+//       --gtest_filter='TracingPipelineBenchmark.*'
+
+namespace LinuxTracing {
+
+namespace {
+double NsPerIteration(std::chrono::steady_clock::time_point begin,
+                      std::chrono::steady_clock::time_point end,
+                      uint64_t iteration_count) {
+  return std::chrono::duration<double, std::nano>(end - begin).count() /
+         iteration_count;
+}
+
+// Writes records into a ring buffer as the kernel does. The ring buffer is
+// backed by a memfd instead of a perf_event_open file descriptor, as the
+// kernel does not allow user space to write the data pages of the latter.
+class RingBufferWriter {
+ public:
+  explicit RingBufferWriter(uint64_t size_kb) : size_(1024 * size_kb) {
+    fd_ = memfd_create("ring_buffer", MFD_CLOEXEC);
+    uint64_t mmap_length = getpagesize() + size_;
+    CHECK(fd_ >= 0 && ftruncate(fd_, mmap_length) == 0);
+    metadata_page_ = static_cast<perf_event_mmap_page*>(
+        perf_event_open_mmap_ring_buffer(fd_, mmap_length));
+    CHECK(metadata_page_ != nullptr);
+    metadata_page_->data_offset = getpagesize();
+    metadata_page_->data_size = size_;
+    data_ = reinterpret_cast<uint8_t*>(metadata_page_) + getpagesize();
+  }
+
+  ~RingBufferWriter() {
+    munmap(metadata_page_, getpagesize() + size_);
+    close(fd_);
+  }
+
+  int GetFileDescriptor() const { return fd_; }
+
+  // Returns false if the record does not fit before the tail.
+  bool Write(const std::vector<uint8_t>& record) {
+    uint64_t tail =
+        __atomic_load_n(&metadata_page_->data_tail, __ATOMIC_ACQUIRE);
+    if (head_ + record.size() > tail + size_) return false;
+    uint64_t offset = head_ & (size_ - 1);
+    uint64_t first_part = std::min<uint64_t>(record.size(), size_ - offset);
+    memcpy(data_ + offset, record.data(), first_part);
+    memcpy(data_, record.data() + first_part, record.size() - first_part);
+    head_ += record.size();
+    return true;
+  }
+
+  void Publish() {
+    __atomic_store_n(&metadata_page_->data_head, head_, __ATOMIC_RELEASE);
+  }
+
+ private:
+  int fd_ = -1;
+  uint64_t size_;
+  perf_event_mmap_page* metadata_page_ = nullptr;
+  uint8_t* data_ = nullptr;
+  uint64_t head_ = 0;
+};
+
+std::vector<uint8_t> MakeRecord(uint16_t size, uint64_t value) {
+  std::vector<uint8_t> record(size, 0);
+  perf_event_header header{};
+  header.type = PERF_RECORD_SAMPLE;
+  header.size = size;
+  memcpy(record.data(), &header, sizeof(header));
+  memcpy(record.data() + sizeof(header), &value, sizeof(value));
+  return record;
+}
+
+// The frame pointer chain of a sample of the given depth, as
+// FramePointersTest builds it.
+struct UnwindingSample {
+  static constexpr uint64_t kStackBegin = 0x10000;
+  static constexpr uint64_t kFrameSize = 0x40;
+
+  explicit UnwindingSample(size_t depth) {
+    maps.Add(0x1000, 0x9000, 0, PROT_READ | PROT_EXEC, "/path/to/a.out", 0);
+    perf_regs.fill(0);
+    perf_regs[PERF_REG_X86_SP] = kStackBegin;
+    perf_regs[PERF_REG_X86_BP] = kStackBegin;
+    perf_regs[PERF_REG_X86_IP] = 0x1000;
+    stack.resize(depth * kFrameSize);
+    for (size_t i = 0; i < depth; ++i) {
+      uint64_t caller_fp =
+          i + 1 < depth ? kStackBegin + (i + 1) * kFrameSize : 0;
+      uint64_t return_address = 0x1000 + 0x10 * (i + 1);
+      memcpy(stack.data() + i * kFrameSize, &caller_fp, sizeof(caller_fp));
+      memcpy(stack.data() + i * kFrameSize + sizeof(caller_fp),
+             &return_address, sizeof(return_address));
+    }
+  }
+
+  unwindstack::Maps maps;
+  std::array<uint64_t, PERF_REG_X86_64_MAX> perf_regs{};
+  std::vector<char> stack;
+};
+
+class CountingListener : public TracerListener {
+ public:
+  void OnTid(pid_t /*tid*/) override {}
+  void OnContextSwitchIn(
+      const ContextSwitchIn& /*context_switch_in*/) override {}
+  void OnContextSwitchOut(
+      const ContextSwitchOut& /*context_switch_out*/) override {}
+  void OnCallstack(const Callstack& /*callstack*/) override {}
+  void OnFunctionCall(const FunctionCall& /*function_call*/) override {}
+  void OnGpuJob(const GpuJob& /*gpu_job*/) override { ++gpu_job_count; }
+  void OnThreadStateChange(
+      const ThreadStateChange& /*thread_state_change*/) override {}
+
+  uint64_t gpu_job_count = 0;
+};
+
+// The raw data of a GPU tracepoint, as in GpuTracepointEventProcessorTest.
+std::vector<uint8_t> MakeGpuRawData(uint16_t tracepoint_id, size_t size,
+                                    size_t timeline_offset, uint32_t context,
+                                    uint32_t seqno,
+                                    const std::string& timeline) {
+  std::vector<uint8_t> raw_data(size + timeline.size() + 1, 0);
+  memcpy(raw_data.data(), &tracepoint_id, sizeof(tracepoint_id));
+  int32_t data_loc = static_cast<int32_t>(((timeline.size() + 1) << 16) | size);
+  memcpy(raw_data.data() + timeline_offset, &data_loc, sizeof(data_loc));
+  memcpy(raw_data.data() + timeline_offset + 4, &context, sizeof(context));
+  memcpy(raw_data.data() + timeline_offset + 8, &seqno, sizeof(seqno));
+  memcpy(raw_data.data() + size, timeline.c_str(), timeline.size() + 1);
+  return raw_data;
+}
+}  // namespace
+
+TEST(TracingPipelineBenchmark, DISABLED_RingBufferReads) {
+  constexpr uint64_t kSizeKb = 1024;
+  constexpr uint64_t kRecordCount = 4'000'000;
+  // Context switches, samples with a 512-byte stack dump, and samples with
+  // the default 64 KB stack dump.
+  for (uint16_t record_size : {48, 600, 65000}) {
+    RingBufferWriter writer{kSizeKb};
+    PerfEventRingBuffer ring_buffer{writer.GetFileDescriptor(), kSizeKb,
+                                    "benchmark"};
+    ASSERT_TRUE(ring_buffer.IsOpen());
+
+    uint64_t record_count =
+        std::min<uint64_t>(kRecordCount, 4096 * kSizeKb * 1024 / record_size);
+    std::vector<uint8_t> record = MakeRecord(record_size, 1);
+    uint64_t written_count = 0;
+    uint64_t checksum = 0;
+    std::chrono::duration<double, std::nano> read_duration{0};
+    while (written_count < record_count) {
+      while (written_count < record_count && writer.Write(record)) {
+        ++written_count;
+      }
+      writer.Publish();
+
+      auto begin = std::chrono::steady_clock::now();
+      while (ring_buffer.HasNewData()) {
+        perf_event_header header;
+        ring_buffer.ReadHeader(&header);
+        absl::Span<const uint8_t> view = ring_buffer.ReadRecordView(header);
+        uint64_t value;
+        memcpy(&value, view.data() + sizeof(header), sizeof(value));
+        checksum += value;
+        ring_buffer.SkipRecord(header);
+      }
+      read_duration += std::chrono::steady_clock::now() - begin;
+    }
+
+    EXPECT_EQ(checksum, record_count);
+    // Only the records that wrap around the end of the ring buffer are copied.
+    printf("%5u-byte records: %6.1f ns/record\n", record_size,
+           read_duration.count() / record_count);
+  }
+}
+
+TEST(TracingPipelineBenchmark, DISABLED_FramePointerUnwinding) {
+  constexpr uint64_t kSampleCount = 200'000;
+  for (size_t depth : {8, 32, 128}) {
+    UnwindingSample sample{depth};
+    LibunwindstackUnwinder unwinder;
+    unwinder.SetUseFramePointers(true);
+    uint64_t frame_count = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < kSampleCount; ++i) {
+      frame_count += unwinder
+                         .Unwind(&sample.maps, sample.perf_regs,
+                                 sample.stack.data(), sample.stack.size())
+                         .size();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    EXPECT_EQ(frame_count, kSampleCount * (depth + 1));
+    printf("%3zu frames: %8.1f ns/sample\n", depth,
+           NsPerIteration(begin, end, kSampleCount));
+  }
+}
+
+TEST(TracingPipelineBenchmark, DISABLED_GpuJobs) {
+  constexpr int kCsIoctlId = 1;
+  constexpr int kSchedRunJobId = 2;
+  constexpr int kDmaFenceSignaledId = 3;
+  constexpr uint32_t kJobCount = 500'000;
+  const std::vector<std::string> timelines = {"gfx", "sdma0", "comp_1.0.0"};
+
+  // Pre-build the raw data, so that we only measure the processor.
+  std::vector<std::vector<uint8_t>> raw_data;
+  raw_data.reserve(3 * kJobCount);
+  for (uint32_t seqno = 0; seqno < kJobCount; ++seqno) {
+    const std::string& timeline = timelines[seqno % timelines.size()];
+    raw_data.push_back(
+        MakeGpuRawData(kCsIoctlId, 48, 16, 1, seqno, timeline));
+    raw_data.push_back(
+        MakeGpuRawData(kSchedRunJobId, 40, 16, 1, seqno, timeline));
+    raw_data.push_back(
+        MakeGpuRawData(kDmaFenceSignaledId, 24, 12, 1, seqno, timeline));
+  }
+
+  CountingListener listener;
+  GpuTracepointEventProcessor processor{kCsIoctlId, kSchedRunJobId,
+                                        kDmaFenceSignaledId};
+  processor.SetListener(&listener);
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < raw_data.size(); ++i) {
+    // Jobs are submitted, scheduled and signaled 1 us apart.
+    processor.PushEvent(42, 1000 * i, absl::MakeConstSpan(raw_data[i]));
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  EXPECT_EQ(listener.gpu_job_count, kJobCount);
+  printf("GpuTracepointEventProcessor: %.1f ns/event\n",
+         NsPerIteration(begin, end, raw_data.size()));
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,89 @@
+#include "UnwindingMaps.h"
+
+#include <OrbitBase/Logging.h>
+#include <sys/mman.h>
+#include <unwindstack/MapInfo.h>
+
+#include <iterator>
+
+#include "LibunwindstackUnwinder.h"
+
+namespace LinuxTracing {
+
+void UnwindingMaps::Reset(const std::string& maps_buffer) {
+  mappings_.clear();
+  snapshot_ = nullptr;
+
+  std::shared_ptr<unwindstack::BufferMaps> maps =
+      LibunwindstackUnwinder::ParseMaps(maps_buffer);
+  if (maps == nullptr) {
+    ERROR("Failed to parse maps");
+    return;
+  }
+  for (const auto& map_info : *maps) {
+    mappings_.emplace(map_info->start,
+                      Mapping{map_info->end, map_info->offset, map_info->flags,
+                              map_info->name});
+  }
+  // The parsed maps can directly be the current snapshot.
+  elf_cache_.AttachElfs(maps);
+  snapshot_ = std::move(maps);
+}
+
+void UnwindingMaps::AddMmap(uint64_t address, uint64_t length,
+                            uint64_t page_offset, const std::string& filename) {
+  uint64_t end = address + length;
+  auto it = mappings_.lower_bound(address);
+
+  // The mapping starting before address might overlap with the new one: keep
+  // the part before address and the part after end, if any.
+  if (it != mappings_.begin()) {
+    auto previous_it = std::prev(it);
+    Mapping& previous = previous_it->second;
+    if (previous.end > address) {
+      if (previous.end > end) {
+        Mapping tail = previous;
+        tail.offset += end - previous_it->first;
+        mappings_.emplace(end, std::move(tail));
+      }
+      previous.end = address;
+    }
+  }
+
+  // Mappings starting inside the new one are removed, except for the part
+  // after end of the last one.
+  while (it != mappings_.end() && it->first < end) {
+    if (it->second.end > end) {
+      Mapping tail = std::move(it->second);
+      tail.offset += end - it->first;
+      mappings_.erase(it);
+      mappings_.emplace(end, std::move(tail));
+      break;
+    }
+    it = mappings_.erase(it);
+  }
+
+  // PERF_RECORD_MMAP is only generated for executable mappings.
+  mappings_.insert_or_assign(
+      address, Mapping{end, page_offset, PROT_READ | PROT_EXEC, filename});
+  snapshot_ = nullptr;
+}
+
+std::shared_ptr<unwindstack::Maps> UnwindingMaps::Get() {
+  if (snapshot_ != nullptr) {
+    return snapshot_;
+  }
+
+  auto maps = std::make_shared<unwindstack::Maps>();
+  for (const auto& [start, mapping] : mappings_) {
+    // A load bias of -1 means that it is computed lazily from the Elf, like
+    // for the maps parsed by unwindstack::BufferMaps.
+    maps->Add(start, mapping.end, mapping.offset, mapping.flags, mapping.name,
+              static_cast<uint64_t>(-1));
+  }
+  elf_cache_.AttachElfs(maps);
+  snapshot_ = std::move(maps);
+  return snapshot_;
+}
+
+}  // namespace LinuxTracing
@@ -0,0 +1,63 @@
+#ifndef ORBIT_LINUX_TRACING_UNWINDING_MAPS_H_
+#define ORBIT_LINUX_TRACING_UNWINDING_MAPS_H_
+
+#include <unwindstack/Maps.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "ElfCache.h"
+
+namespace LinuxTracing {
+
+// UnwindingMaps keeps the memory maps of the target process up-to-date for
+// unwinding. The full content of /proc/<pid>/maps is only parsed initially
+// (Reset), while the mmaps reported by perf_event_open are applied as
+// incremental changes (AddMmap), without reading /proc/<pid>/maps again.
+// Get returns an immutable snapshot of the maps: snapshots are shared (e.g.,
+// with LateUnwindCallstack) until the maps change, and a new one is only
+// created when requested after a change, so that a burst of mmaps (e.g., from
+// dlopen) results in a single new snapshot. The unwindstack::Elf objects, the
+// expensive part of the maps, are shared between snapshots through an
+// ElfCache.
+// Note that perf_event_open doesn't report munmaps: mappings are only removed
+// when replaced by a new overlapping mmap, or by a new Reset.
+class UnwindingMaps {
+ public:
+  UnwindingMaps() = default;
+  UnwindingMaps(const UnwindingMaps&) = delete;
+  UnwindingMaps& operator=(const UnwindingMaps&) = delete;
+  UnwindingMaps(UnwindingMaps&&) = default;
+  UnwindingMaps& operator=(UnwindingMaps&&) = default;
+
+  // Replaces all the maps with the ones described by maps_buffer, with the
+  // format of /proc/<pid>/maps.
+  void Reset(const std::string& maps_buffer);
+
+  // Adds an executable mapping as reported by PERF_RECORD_MMAP, replacing the
+  // ranges of the existing mappings it overlaps with.
+  void AddMmap(uint64_t address, uint64_t length, uint64_t page_offset,
+               const std::string& filename);
+
+  std::shared_ptr<unwindstack::Maps> Get();
+
+ private:
+  struct Mapping {
+    uint64_t end;
+    uint64_t offset;
+    uint64_t flags;
+    std::string name;
+  };
+
+  // Keyed by start address.
+  std::map<uint64_t, Mapping> mappings_;
+  // nullptr when the mappings have changed since the last snapshot.
+  std::shared_ptr<unwindstack::Maps> snapshot_;
+  ElfCache elf_cache_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_UNWINDING_MAPS_H_
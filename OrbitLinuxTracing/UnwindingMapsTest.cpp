@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <unwindstack/MapInfo.h>
+
+#include <tuple>
+#include <vector>
+
+#include "UnwindingMaps.h"
+
+namespace LinuxTracing {
+
+namespace {
+using MapTuple = std::tuple<uint64_t, uint64_t, uint64_t, std::string>;
+
+std::vector<MapTuple> MapsToTuples(unwindstack::Maps* maps) {
+  std::vector<MapTuple> tuples;
+  for (const auto& map_info : *maps) {
+    tuples.emplace_back(map_info->start, map_info->end, map_info->offset,
+                        map_info->name);
+  }
+  return tuples;
+}
+
+constexpr const char* TEST_MAPS =
+    "1000-3000 r-xp 00000000 00:00 0 /path/to/a.so\n"
+    "3000-4000 r--p 00002000 00:00 0 /path/to/a.so\n"
+    "8000-9000 r-xp 00000000 00:00 0 /path/to/b.so\n";
+}  // namespace
+
+TEST(UnwindingMaps, ResetParsesMaps) {
+  UnwindingMaps unwinding_maps;
+  unwinding_maps.Reset(TEST_MAPS);
+  std::shared_ptr<unwindstack::Maps> maps = unwinding_maps.Get();
+  ASSERT_NE(maps, nullptr);
+  EXPECT_EQ(MapsToTuples(maps.get()),
+            (std::vector<MapTuple>{{0x1000, 0x3000, 0, "/path/to/a.so"},
+                                   {0x3000, 0x4000, 0x2000, "/path/to/a.so"},
+                                   {0x8000, 0x9000, 0, "/path/to/b.so"}}));
+}
+
+TEST(UnwindingMaps, SnapshotIsSharedUntilMapsChange) {
+  UnwindingMaps unwinding_maps;
+  unwinding_maps.Reset(TEST_MAPS);
+  std::shared_ptr<unwindstack::Maps> first_snapshot = unwinding_maps.Get();
+  EXPECT_EQ(unwinding_maps.Get(), first_snapshot);
+
+  unwinding_maps.AddMmap(0x5000, 0x1000, 0, "/path/to/c.so");
+  unwinding_maps.AddMmap(0x6000, 0x1000, 0, "/path/to/d.so");
+  std::shared_ptr<unwindstack::Maps> second_snapshot = unwinding_maps.Get();
+  EXPECT_NE(second_snapshot, first_snapshot);
+  EXPECT_EQ(unwinding_maps.Get(), second_snapshot);
+
+  // The old snapshot is unchanged.
+  EXPECT_EQ(first_snapshot->Total(), 3);
+  EXPECT_EQ(second_snapshot->Total(), 5);
+}
+
+TEST(UnwindingMaps, AddMmapReplacesOverlappingRanges) {
+  UnwindingMaps unwinding_maps;
+  unwinding_maps.Reset(TEST_MAPS);
+
+  // Overlaps with the end of the first mapping and the start of the second.
+  unwinding_maps.AddMmap(0x2000, 0x1800, 0x10000, "/path/to/jit");
+  EXPECT_EQ(MapsToTuples(unwinding_maps.Get().get()),
+            (std::vector<MapTuple>{{0x1000, 0x2000, 0, "/path/to/a.so"},
+                                   {0x2000, 0x3800, 0x10000, "/path/to/jit"},
+                                   {0x3800, 0x4000, 0x2800, "/path/to/a.so"},
+                                   {0x8000, 0x9000, 0, "/path/to/b.so"}}));
+
+  // Inside a single mapping, which is split in two.
+  unwinding_maps.AddMmap(0x8400, 0x400, 0, "/path/to/e.so");
+  EXPECT_EQ(MapsToTuples(unwinding_maps.Get().get()),
+            (std::vector<MapTuple>{{0x1000, 0x2000, 0, "/path/to/a.so"},
+                                   {0x2000, 0x3800, 0x10000, "/path/to/jit"},
+                                   {0x3800, 0x4000, 0x2800, "/path/to/a.so"},
+                                   {0x8000, 0x8400, 0, "/path/to/b.so"},
+                                   {0x8400, 0x8800, 0, "/path/to/e.so"},
+                                   {0x8800, 0x9000, 0x800, "/path/to/b.so"}}));
+
+  // Covering several mappings entirely.
+  unwinding_maps.AddMmap(0x1000, 0x3000, 0, "/path/to/f.so");
+  EXPECT_EQ(MapsToTuples(unwinding_maps.Get().get()),
+            (std::vector<MapTuple>{{0x1000, 0x4000, 0, "/path/to/f.so"},
+                                   {0x8000, 0x8400, 0, "/path/to/b.so"},
+                                   {0x8400, 0x8800, 0, "/path/to/e.so"},
+                                   {0x8800, 0x9000, 0x800, "/path/to/b.so"}}));
+}
+
+TEST(UnwindingMaps, AddedMappingsAreExecutable) {
+  UnwindingMaps unwinding_maps;
+  unwinding_maps.Reset("");
+  unwinding_maps.AddMmap(0x1000, 0x1000, 0, "/path/to/a.so");
+  std::shared_ptr<unwindstack::Maps> maps = unwinding_maps.Get();
+  ASSERT_EQ(maps->Total(), 1);
+  EXPECT_EQ(maps->Get(0)->flags, PROT_READ | PROT_EXEC);
+}
+
+}  // namespace LinuxTracing
@@ -3,6 +3,8 @@
 
 #include "LibunwindstackUnwinder.h"
 #include "PerfEvent.h"
+#include "StackDumpSizeTuner.h"
+#include "UnwindingMaps.h"
 #include "absl/container/flat_hash_map.h"
 
 namespace LinuxTracing {
@@ -11,9 +13,12 @@ namespace LinuxTracing {
 // of the maps needed to unwind it, or the already unwound callstack.
 class LateUnwindCallstack {
  public:
+  // For uprobes without stack dump: the callstack is unwound and invalid.
+  LateUnwindCallstack() = default;
+
   // uprobes_event needs to be moved from because a copy would be expensive.
   explicit LateUnwindCallstack(UprobesWithStackPerfEvent&& uprobes_event,
-                               std::shared_ptr<unwindstack::BufferMaps> maps)
+                               std::shared_ptr<unwindstack::Maps> maps)
       : uprobes_event_{std::make_unique<UprobesWithStackPerfEvent>(
             std::move(uprobes_event))},
         maps_{std::move(maps)} {}
@@ -24,7 +29,7 @@ class LateUnwindCallstack {
     return uprobes_event_.get();
   }
 
-  unwindstack::BufferMaps* GetMaps() const { return maps_.get(); }
+  unwindstack::Maps* GetMaps() const { return maps_.get(); }
 
   void SetCallstack(std::vector<unwindstack::FrameData> callstack) {
     uprobes_event_ = nullptr;
@@ -40,7 +45,7 @@ class LateUnwindCallstack {
 
  private:
   std::unique_ptr<UprobesWithStackPerfEvent> uprobes_event_;
-  std::shared_ptr<unwindstack::BufferMaps> maps_;
+  std::shared_ptr<unwindstack::Maps> maps_;
   std::vector<unwindstack::FrameData> callstack_{};
 };
 
@@ -54,28 +59,64 @@ class UprobesCallstackManager {
     ProcessMaps(initial_maps);
   }
 
+  UprobesCallstackManager(UnwinderT* unwinder,
+                          std::shared_ptr<unwindstack::Maps> initial_maps)
+      : unwinder_{unwinder}, current_maps_{std::move(initial_maps)} {}
+
   UprobesCallstackManager(const UprobesCallstackManager&) = delete;
   UprobesCallstackManager& operator=(const UprobesCallstackManager&) = delete;
 
   UprobesCallstackManager(UprobesCallstackManager&&) = default;
   UprobesCallstackManager& operator=(UprobesCallstackManager&&) = default;
 
+  // Receives the stack dumps of the time-based stack samples
+  // (PerfEventType::kStackSample) and the frames unwound from them, if set.
+  void SetStackDumpSizeTuner(StackDumpSizeTuner* stack_dump_size_tuner) {
+    stack_dump_size_tuner_ = stack_dump_size_tuner;
+  }
+
   void ProcessMaps(const std::string& maps_buffer) {
-    current_maps_ = LibunwindstackUnwinder::ParseMaps(maps_buffer);
+    unwinding_maps_.Reset(maps_buffer);
+    current_maps_ = nullptr;
+  }
+
+  void ProcessMmap(uint64_t address, uint64_t length, uint64_t page_offset,
+                   const std::string& filename) {
+    unwinding_maps_.AddMmap(address, length, page_offset, filename);
+    current_maps_ = nullptr;
+  }
+
+  // Allows sharing the same maps between several instances, in place of
+  // ProcessMaps(const std::string&) and ProcessMmap.
+  void ProcessMaps(std::shared_ptr<unwindstack::Maps> maps) {
+    current_maps_ = std::move(maps);
   }
 
   void ProcessUprobesCallstack(pid_t tid,
                                UprobesWithStackPerfEvent&& uprobes_event) {
     std::vector<LateUnwindCallstack>& previous_callstacks =
         tid_uprobes_callstacks_stacks_[tid];
-    previous_callstacks.emplace_back(std::move(uprobes_event), current_maps_);
+    previous_callstacks.emplace_back(std::move(uprobes_event),
+                                     GetCurrentMaps());
+  }
+
+  // The functions instrumented without callstack still need an entry on the
+  // stack of callstacks, as it must be kept in sync with uretprobes. Samples
+  // that need to be joined with such an entry are discarded.
+  void ProcessUprobesWithoutCallstack(pid_t tid) {
+    tid_uprobes_callstacks_stacks_[tid].emplace_back();
   }
 
   std::vector<unwindstack::FrameData> ProcessSampledCallstack(
       pid_t tid, const StackSamplePerfEvent& sample_event) {
     std::vector<unwindstack::FrameData> this_callstack = unwinder_->Unwind(
-        current_maps_.get(), sample_event.GetRegisters(),
+        GetCurrentMaps().get(), sample_event.GetRegisters(),
         sample_event.GetStackData(), sample_event.GetStackSize());
+    if (stack_dump_size_tuner_ != nullptr &&
+        sample_event.GetType() == PerfEventType::kStackSample) {
+      stack_dump_size_tuner_->AddSample(tid, sample_event.GetStackSize(),
+                                        this_callstack);
+    }
     if (this_callstack.empty()) {
       return {};
     }
@@ -98,12 +139,22 @@ class UprobesCallstackManager {
 
  private:
   UnwinderT* unwinder_;
-  std::shared_ptr<unwindstack::BufferMaps> current_maps_ = nullptr;
+  StackDumpSizeTuner* stack_dump_size_tuner_ = nullptr;
+  UnwindingMaps unwinding_maps_;
+  // The snapshot of unwinding_maps_ (created lazily), or shared maps.
+  std::shared_ptr<unwindstack::Maps> current_maps_ = nullptr;
   // This map keeps, for every thread, the stack of callstacks collected when
   // entering a uprobes-instrumented function.
   absl::flat_hash_map<pid_t, std::vector<LateUnwindCallstack>>
       tid_uprobes_callstacks_stacks_{};
 
+  const std::shared_ptr<unwindstack::Maps>& GetCurrentMaps() {
+    if (current_maps_ == nullptr) {
+      current_maps_ = unwinding_maps_.Get();
+    }
+    return current_maps_;
+  }
+
   void UnwindPreviousUprobesCallstacks(pid_t tid) {
     std::vector<LateUnwindCallstack>& previous_callstacks =
         tid_uprobes_callstacks_stacks_[tid];
@@ -21,14 +21,22 @@ class UprobesFunctionCallManager {
   UprobesFunctionCallManager(UprobesFunctionCallManager&&) = default;
   UprobesFunctionCallManager& operator=(UprobesFunctionCallManager&&) = default;
 
-  void ProcessUprobes(pid_t tid, uint64_t function_address,
-                      uint64_t begin_timestamp) {
+  // pmu_counters are the counters of the thread at entry, see
+  // PmuCounterAccumulator.
+  void ProcessUprobes(
+      pid_t tid, uint64_t function_address, uint64_t begin_timestamp,
+      std::vector<uint64_t> arguments = {},
+      std::optional<PmuCounterValues> pmu_counters = std::nullopt) {
     auto& tid_timer_stack = tid_timer_stacks_[tid];
-    tid_timer_stack.emplace(function_address, begin_timestamp);
+    tid_timer_stack.emplace(function_address, begin_timestamp,
+                            std::move(arguments), pmu_counters);
   }
 
-  std::optional<FunctionCall> ProcessUretprobes(pid_t tid,
-                                                uint64_t end_timestamp) {
+  // The function call has the differences of the counters of the thread
+  // between entry and exit, if both are known.
+  std::optional<FunctionCall> ProcessUretprobes(
+      pid_t tid, uint64_t end_timestamp, uint64_t return_value = 0,
+      std::optional<PmuCounterValues> pmu_counters = std::nullopt) {
     if (tid_timer_stacks_.count(tid) == 0) {
       return std::optional<FunctionCall>{};
     }
@@ -38,10 +46,22 @@ class UprobesFunctionCallManager {
     // As we erase the stack for this thread as soon as it becomes empty.
     CHECK(!tid_timer_stack.empty());
 
+    std::optional<PmuCounterValues> pmu_counter_deltas;
+    const std::optional<PmuCounterValues>& begin_pmu_counters =
+        tid_timer_stack.top().pmu_counters;
+    if (begin_pmu_counters.has_value() && pmu_counters.has_value()) {
+      pmu_counter_deltas.emplace();
+      for (size_t i = 0; i < kNumPmuCounters; ++i) {
+        pmu_counter_deltas.value()[i] =
+            pmu_counters.value()[i] - begin_pmu_counters.value()[i];
+      }
+    }
+
     auto function_call = std::make_optional<FunctionCall>(
         tid, tid_timer_stack.top().function_address,
         tid_timer_stack.top().begin_timestamp, end_timestamp,
-        tid_timer_stack.size() - 1);
+        tid_timer_stack.size() - 1, return_value,
+        std::move(tid_timer_stack.top().arguments), pmu_counter_deltas);
     tid_timer_stack.pop();
     if (tid_timer_stack.empty()) {
       tid_timer_stacks_.erase(tid);
@@ -49,13 +69,23 @@ class UprobesFunctionCallManager {
     return function_call;
   }
 
+  bool HasOpenUprobes(pid_t tid) const {
+    return tid_timer_stacks_.contains(tid);
+  }
+
  private:
   struct OpenUprobes {
-    OpenUprobes(uint64_t function_address, uint64_t begin_timestamp)
+    OpenUprobes(uint64_t function_address, uint64_t begin_timestamp,
+                std::vector<uint64_t> arguments,
+                std::optional<PmuCounterValues> pmu_counters)
         : function_address(function_address),
-          begin_timestamp(begin_timestamp) {}
+          begin_timestamp(begin_timestamp),
+          arguments(std::move(arguments)),
+          pmu_counters(pmu_counters) {}
     uint64_t function_address;
     uint64_t begin_timestamp;
+    std::vector<uint64_t> arguments;
+    std::optional<PmuCounterValues> pmu_counters;
   };
 
   // This map keeps the stack of the dynamically-instrumented functions entered.
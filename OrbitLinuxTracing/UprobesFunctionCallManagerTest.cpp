@@ -84,6 +84,28 @@ TEST(UprobesFunctionCallManager, TwoUprobesDifferentThreads) {
   EXPECT_EQ(processed_function_call.value().GetDepth(), 0);
 }
 
+TEST(UprobesFunctionCallManager, ArgumentsAndReturnValue) {
+  constexpr pid_t tid = 42;
+  std::optional<FunctionCall> processed_function_call;
+  UprobesFunctionCallManager function_call_manager;
+
+  function_call_manager.ProcessUprobes(tid, 100, 1, {1, 2, 3, 4, 5, 6});
+  function_call_manager.ProcessUprobes(tid, 200, 2);
+
+  processed_function_call = function_call_manager.ProcessUretprobes(tid, 3, 7);
+  ASSERT_TRUE(processed_function_call.has_value());
+  EXPECT_EQ(processed_function_call.value().GetVirtualAddress(), 200);
+  EXPECT_EQ(processed_function_call.value().GetReturnValue(), 7);
+  EXPECT_TRUE(processed_function_call.value().GetArguments().empty());
+
+  processed_function_call = function_call_manager.ProcessUretprobes(tid, 4, 8);
+  ASSERT_TRUE(processed_function_call.has_value());
+  EXPECT_EQ(processed_function_call.value().GetVirtualAddress(), 100);
+  EXPECT_EQ(processed_function_call.value().GetReturnValue(), 8);
+  EXPECT_EQ(processed_function_call.value().GetArguments(),
+            (std::vector<uint64_t>{1, 2, 3, 4, 5, 6}));
+}
+
 TEST(UprobesFunctionCallManager, OnlyUretprobe) {
   constexpr pid_t tid = 42;
   std::optional<FunctionCall> processed_function_call;
@@ -93,4 +115,28 @@ TEST(UprobesFunctionCallManager, OnlyUretprobe) {
   ASSERT_FALSE(processed_function_call.has_value());
 }
 
+TEST(UprobesFunctionCallManager, PmuCounters) {
+  constexpr pid_t tid = 42;
+  std::optional<FunctionCall> processed_function_call;
+  UprobesFunctionCallManager function_call_manager;
+
+  function_call_manager.ProcessUprobes(tid, 100, 1, {},
+                                       PmuCounterValues{1000, 2000, 10, 5});
+  function_call_manager.ProcessUprobes(tid, 200, 2);
+
+  processed_function_call = function_call_manager.ProcessUretprobes(
+      tid, 3, 0, PmuCounterValues{1500, 2600, 12, 5});
+  ASSERT_TRUE(processed_function_call.has_value());
+  EXPECT_FALSE(processed_function_call.value().GetPmuCounters().has_value());
+  EXPECT_TRUE(function_call_manager.HasOpenUprobes(tid));
+
+  processed_function_call = function_call_manager.ProcessUretprobes(
+      tid, 4, 0, PmuCounterValues{3000, 5000, 20, 7});
+  ASSERT_TRUE(processed_function_call.has_value());
+  ASSERT_TRUE(processed_function_call.value().GetPmuCounters().has_value());
+  EXPECT_THAT(processed_function_call.value().GetPmuCounters().value(),
+              testing::ElementsAre(2000, 3000, 10, 2));
+  EXPECT_FALSE(function_call_manager.HasOpenUprobes(tid));
+}
+
 }  // namespace LinuxTracing
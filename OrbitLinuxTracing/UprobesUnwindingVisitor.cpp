@@ -2,22 +2,241 @@
 
 namespace LinuxTracing {
 
+UprobesUnwindingVisitor::UprobesUnwindingVisitor(
+    const std::string& initial_maps, size_t unwinding_thread_count,
+    bool unwind_with_frame_pointers) {
+  unwinder_.SetUseFramePointers(unwind_with_frame_pointers);
+  if (unwinding_thread_count == 0) {
+    callstack_manager_ =
+        std::make_unique<UprobesCallstackManager<LibunwindstackUnwinder>>(
+            &unwinder_, initial_maps);
+  } else {
+    unwinding_worker_pool_ =
+        std::make_unique<UprobesUnwindingWorkerPool<LibunwindstackUnwinder>>(
+            unwinding_thread_count, initial_maps,
+            [this](pid_t tid, uint64_t timestamp_ns,
+                   const std::vector<unwindstack::FrameData>& callstack) {
+              OnCallstack(tid, timestamp_ns, callstack);
+            },
+            unwinder_);
+    unwinding_worker_pool_->SetOffCpuCallstackCallback(
+        [this](pid_t tid, uint64_t begin_timestamp_ns,
+               uint64_t end_timestamp_ns,
+               const std::vector<unwindstack::FrameData>& callstack) {
+          OnOffCpuCallstack(tid, begin_timestamp_ns, end_timestamp_ns,
+                            callstack);
+        });
+    unwinding_worker_pool_->SetGpuSubmissionCallstackCallback(
+        [this](pid_t tid, uint64_t timestamp_ns,
+               const std::vector<unwindstack::FrameData>& callstack) {
+          OnGpuSubmissionCallstack(tid, timestamp_ns, callstack);
+        });
+    unwinding_worker_pool_->SetPageFaultCallback(
+        [this](pid_t tid, uint64_t timestamp_ns, bool major,
+               const std::vector<unwindstack::FrameData>& callstack) {
+          OnPageFault(tid, timestamp_ns, major, callstack);
+        });
+    unwinding_worker_pool_->SetHeapCallbacks(
+        [this](pid_t tid, uint64_t timestamp_ns, uint64_t address,
+               uint64_t size,
+               const std::vector<unwindstack::FrameData>& callstack) {
+          OnHeapAllocation(tid, timestamp_ns, address, size, callstack);
+        },
+        [this](pid_t tid, uint64_t timestamp_ns, uint64_t address) {
+          OnHeapFree(tid, timestamp_ns, address);
+        });
+    unwinding_worker_pool_->SetLockWaitCallback(
+        [this](pid_t tid, uint64_t begin_timestamp_ns,
+               uint64_t end_timestamp_ns, uint64_t lock_address,
+               const std::vector<unwindstack::FrameData>& callstack) {
+          OnLockWait(tid, begin_timestamp_ns, end_timestamp_ns, lock_address,
+                     callstack);
+        });
+  }
+}
+
+void UprobesUnwindingVisitor::SetStackDumpSizeTuner(
+    StackDumpSizeTuner* stack_dump_size_tuner) {
+  if (unwinding_worker_pool_ != nullptr) {
+    unwinding_worker_pool_->SetStackDumpSizeTuner(stack_dump_size_tuner);
+  } else {
+    callstack_manager_->SetStackDumpSizeTuner(stack_dump_size_tuner);
+  }
+}
+
 void UprobesUnwindingVisitor::visit(StackSamplePerfEvent* event) {
   CHECK(listener_ != nullptr);
+  if (unwinding_worker_pool_ != nullptr) {
+    // The event is destroyed after being visited, so move its content.
+    unwinding_worker_pool_->ProcessSampledCallstack(event->GetTid(),
+                                                    std::move(*event));
+    return;
+  }
+
   const std::vector<unwindstack::FrameData>& full_callstack =
-      callstack_manager_.ProcessSampledCallstack(event->GetTid(), *event);
+      callstack_manager_->ProcessSampledCallstack(event->GetTid(), *event);
   if (!full_callstack.empty()) {
-    Callstack returned_callstack{
-        event->GetTid(),
-        CallstackFramesFromLibunwindstackFrames(full_callstack),
-        event->GetTimestamp()};
-    listener_->OnCallstack(returned_callstack);
+    OnCallstack(event->GetTid(), event->GetTimestamp(), full_callstack);
   }
 }
 
-void UprobesUnwindingVisitor::visit(UprobesWithStackPerfEvent* event) {
+void UprobesUnwindingVisitor::visit(OffCpuStackSamplePerfEvent* event) {
+  // If the switch in of the thread was lost, the previous stack is replaced.
+  // The event is destroyed after being visited, so move its content.
+  off_cpu_stack_samples_per_thread_[event->GetTid()] =
+      std::make_unique<OffCpuStackSamplePerfEvent>(std::move(*event));
+}
+
+void UprobesUnwindingVisitor::visit(SchedSwitchInPerfEvent* event) {
+  CHECK(listener_ != nullptr);
+  auto it = off_cpu_stack_samples_per_thread_.find(event->GetTid());
+  if (it == off_cpu_stack_samples_per_thread_.end()) {
+    return;
+  }
+  std::unique_ptr<OffCpuStackSamplePerfEvent> switch_out_event =
+      std::move(it->second);
+  off_cpu_stack_samples_per_thread_.erase(it);
+
+  if (unwinding_worker_pool_ != nullptr) {
+    unwinding_worker_pool_->ProcessOffCpuCallstack(
+        event->GetTid(), std::move(*switch_out_event), event->GetTimestamp());
+    return;
+  }
+
+  const std::vector<unwindstack::FrameData>& full_callstack =
+      callstack_manager_->ProcessSampledCallstack(event->GetTid(),
+                                                  *switch_out_event);
+  if (!full_callstack.empty()) {
+    OnOffCpuCallstack(event->GetTid(), switch_out_event->GetTimestamp(),
+                      event->GetTimestamp(), full_callstack);
+  }
+}
+
+void UprobesUnwindingVisitor::visit(GpuSubmissionStackSamplePerfEvent* event) {
+  CHECK(listener_ != nullptr);
+  if (unwinding_worker_pool_ != nullptr) {
+    // The event is destroyed after being visited, so move its content.
+    unwinding_worker_pool_->ProcessGpuSubmissionCallstack(event->GetTid(),
+                                                          std::move(*event));
+    return;
+  }
+
+  const std::vector<unwindstack::FrameData>& full_callstack =
+      callstack_manager_->ProcessSampledCallstack(event->GetTid(), *event);
+  if (!full_callstack.empty()) {
+    OnGpuSubmissionCallstack(event->GetTid(), event->GetTimestamp(),
+                             full_callstack);
+  }
+}
+
+void UprobesUnwindingVisitor::visit(PageFaultStackSamplePerfEvent* event) {
+  CHECK(listener_ != nullptr);
+  bool major = event->IsMajor();
+  if (unwinding_worker_pool_ != nullptr) {
+    // The event is destroyed after being visited, so move its content.
+    unwinding_worker_pool_->ProcessPageFaultCallstack(event->GetTid(),
+                                                      std::move(*event), major);
+    return;
+  }
+
+  const std::vector<unwindstack::FrameData>& full_callstack =
+      callstack_manager_->ProcessSampledCallstack(event->GetTid(), *event);
+  if (!full_callstack.empty()) {
+    OnPageFault(event->GetTid(), event->GetTimestamp(), major, full_callstack);
+  }
+}
+
+void UprobesUnwindingVisitor::visit(HeapAllocationStackSamplePerfEvent* event) {
+  // If the allocation failed, the previous stack is replaced.
+  // The event is destroyed after being visited, so move its content.
+  heap_allocation_stack_samples_per_thread_[event->GetTid()] =
+      std::make_unique<HeapAllocationStackSamplePerfEvent>(std::move(*event));
+}
+
+void UprobesUnwindingVisitor::visit(HeapAllocationPerfEvent* event) {
   CHECK(listener_ != nullptr);
+  std::unique_ptr<HeapAllocationStackSamplePerfEvent> allocation_event;
+  auto it = heap_allocation_stack_samples_per_thread_.find(event->GetTid());
+  if (it != heap_allocation_stack_samples_per_thread_.end()) {
+    allocation_event = std::move(it->second);
+    heap_allocation_stack_samples_per_thread_.erase(it);
+  }
 
+  if (unwinding_worker_pool_ != nullptr) {
+    unwinding_worker_pool_->ProcessHeapAllocation(
+        event->GetTid(), std::move(allocation_event), event->GetTimestamp(),
+        event->GetAddress(), event->GetSize());
+    return;
+  }
+
+  std::vector<unwindstack::FrameData> full_callstack;
+  if (allocation_event != nullptr) {
+    full_callstack = callstack_manager_->ProcessSampledCallstack(
+        event->GetTid(), *allocation_event);
+  }
+  OnHeapAllocation(event->GetTid(), event->GetTimestamp(), event->GetAddress(),
+                   event->GetSize(), full_callstack);
+}
+
+void UprobesUnwindingVisitor::visit(HeapFreePerfEvent* event) {
+  CHECK(listener_ != nullptr);
+  if (unwinding_worker_pool_ != nullptr) {
+    unwinding_worker_pool_->ProcessHeapFree(
+        event->GetTid(), event->GetTimestamp(), event->GetAddress());
+    return;
+  }
+  OnHeapFree(event->GetTid(), event->GetTimestamp(), event->GetAddress());
+}
+
+void UprobesUnwindingVisitor::visit(LockWaitPerfEvent* event) {
+  CHECK(listener_ != nullptr);
+  auto it = lock_waits_per_thread_.find(event->GetTid());
+  if (it != lock_waits_per_thread_.end()) {
+    // The stack of the previous wait was lost.
+    ProcessLockWait(*it->second, nullptr);
+    lock_waits_per_thread_.erase(it);
+  }
+  lock_waits_per_thread_.emplace(event->GetTid(),
+                                 std::make_unique<LockWaitPerfEvent>(*event));
+}
+
+void UprobesUnwindingVisitor::visit(LockWaitStackSamplePerfEvent* event) {
+  CHECK(listener_ != nullptr);
+  auto it = lock_waits_per_thread_.find(event->GetTid());
+  if (it == lock_waits_per_thread_.end()) {
+    // The record of the wait was lost.
+    return;
+  }
+  std::unique_ptr<LockWaitPerfEvent> wait = std::move(it->second);
+  lock_waits_per_thread_.erase(it);
+  // The event is destroyed after being visited, so move its content.
+  ProcessLockWait(*wait,
+                  std::make_unique<StackSamplePerfEvent>(std::move(*event)));
+}
+
+void UprobesUnwindingVisitor::ProcessLockWait(
+    const LockWaitPerfEvent& wait,
+    std::unique_ptr<StackSamplePerfEvent> wait_event) {
+  if (unwinding_worker_pool_ != nullptr) {
+    unwinding_worker_pool_->ProcessLockWait(
+        wait.GetTid(), std::move(wait_event), wait.GetBeginTimestampNs(),
+        wait.GetEndTimestampNs(), wait.GetLockAddress());
+    return;
+  }
+
+  std::vector<unwindstack::FrameData> full_callstack;
+  if (wait_event != nullptr) {
+    full_callstack = callstack_manager_->ProcessSampledCallstack(
+        wait.GetTid(), *wait_event);
+  }
+  OnLockWait(wait.GetTid(), wait.GetBeginTimestampNs(),
+             wait.GetEndTimestampNs(), wait.GetLockAddress(), full_callstack);
+}
+
+bool UprobesUnwindingVisitor::ProcessUprobeSpIpCpu(pid_t tid,
+                                                   uint64_t uprobe_sp,
+                                                   uint64_t uprobe_ip,
+                                                   uint32_t uprobe_cpu) {
   // We are seeing that, on thread migration, uprobe events can sometimes be
   // duplicated: the duplicate uprobe event will have the same stack pointer and
   // instruction pointer as the previous uprobe, but different cpu. In that
@@ -26,13 +245,8 @@ void UprobesUnwindingVisitor::visit(UprobesWithStackPerfEvent* event) {
   // stack pointers, as for a given thread's sequence of u(ret)probe events, two
   // consecutive uprobe events must be associated with non-increasing stack
   // pointers (the stack grows towards lower addresses).
-
-  // Duplicate uprobe detection.
-  uint64_t uprobe_sp = event->GetRegisters()[PERF_REG_X86_SP];
-  uint64_t uprobe_ip = event->GetRegisters()[PERF_REG_X86_IP];
-  uint32_t uprobe_cpu = event->GetCpu();
   std::vector<std::tuple<uint64_t, uint64_t, uint32_t>>& uprobe_sps_ips_cpus =
-      uprobe_sps_ips_cpus_per_thread_[event->GetTid()];
+      uprobe_sps_ips_cpus_per_thread_[tid];
   if (!uprobe_sps_ips_cpus.empty()) {
     uint64_t last_uprobe_sp = std::get<0>(uprobe_sps_ips_cpus.back());
     uint64_t last_uprobe_ip = std::get<1>(uprobe_sps_ips_cpus.back());
@@ -40,14 +254,27 @@ void UprobesUnwindingVisitor::visit(UprobesWithStackPerfEvent* event) {
     uprobe_sps_ips_cpus.pop_back();
     if (uprobe_sp > last_uprobe_sp) {
       ERROR("MISSING URETPROBE OR DUPLICATE UPROBE");
-      return;
+      return false;
     } else if (uprobe_sp == last_uprobe_sp && uprobe_ip == last_uprobe_ip &&
                uprobe_cpu != last_uprobe_cpu) {
       ERROR("Duplicate uprobe on thread migration");
-      return;
+      return false;
     }
   }
   uprobe_sps_ips_cpus.emplace_back(uprobe_sp, uprobe_ip, uprobe_cpu);
+  return true;
+}
+
+void UprobesUnwindingVisitor::visit(UprobesWithStackPerfEvent* event) {
+  CHECK(listener_ != nullptr);
+
+  // Duplicate uprobe detection.
+  if (!ProcessUprobeSpIpCpu(event->GetTid(),
+                            event->GetRegisters()[PERF_REG_X86_SP],
+                            event->GetRegisters()[PERF_REG_X86_IP],
+                            event->GetCpu())) {
+    return;
+  }
 
   function_call_manager_.ProcessUprobes(event->GetTid(),
                                         event->GetFunction()->VirtualAddress(),
@@ -55,8 +282,34 @@ void UprobesUnwindingVisitor::visit(UprobesWithStackPerfEvent* event) {
 
   // Careful: UprobesWithStackPerfEvent* event ends up being moved from
   // LateUnwindCallstack's constructor.
-  callstack_manager_.ProcessUprobesCallstack(event->GetTid(),
-                                             std::move(*event));
+  if (unwinding_worker_pool_ != nullptr) {
+    unwinding_worker_pool_->ProcessUprobesCallstack(event->GetTid(),
+                                                    std::move(*event));
+  } else {
+    callstack_manager_->ProcessUprobesCallstack(event->GetTid(),
+                                                std::move(*event));
+  }
+}
+
+void UprobesUnwindingVisitor::visit(UprobesPerfEvent* event) {
+  CHECK(listener_ != nullptr);
+
+  // Duplicate uprobe detection.
+  if (!ProcessUprobeSpIpCpu(event->GetTid(), event->GetSp(), event->GetIp(),
+                            event->GetCpu())) {
+    return;
+  }
+
+  function_call_manager_.ProcessUprobes(
+      event->GetTid(), event->GetFunction()->VirtualAddress(),
+      event->GetTimestamp(), event->GetArguments(),
+      GetThreadPmuCounters(*event, event->GetTid(), event->GetCpu()));
+
+  if (unwinding_worker_pool_ != nullptr) {
+    unwinding_worker_pool_->ProcessUprobesWithoutCallstack(event->GetTid());
+  } else {
+    callstack_manager_->ProcessUprobesWithoutCallstack(event->GetTid());
+  }
 }
 
 void UprobesUnwindingVisitor::visit(UretprobesPerfEvent* event) {
@@ -70,17 +323,128 @@ void UprobesUnwindingVisitor::visit(UretprobesPerfEvent* event) {
   }
 
   std::optional<FunctionCall> function_call =
-      function_call_manager_.ProcessUretprobes(event->GetTid(),
-                                               event->GetTimestamp());
+      function_call_manager_.ProcessUretprobes(
+          event->GetTid(), event->GetTimestamp(), event->GetReturnValue(),
+          GetThreadPmuCounters(*event, event->GetTid(), event->GetCpu()));
+  if (event->GetPmuCounters().has_value() &&
+      !function_call_manager_.HasOpenUprobes(event->GetTid())) {
+    // Only differences within a call are used.
+    pmu_counter_accumulator_.ForgetThread(event->GetTid());
+  }
   if (function_call.has_value()) {
+    std::lock_guard<std::mutex> lock{listener_mutex_};
     listener_->OnFunctionCall(function_call.value());
   }
 
-  callstack_manager_.ProcessUretprobes(event->GetTid());
+  if (unwinding_worker_pool_ != nullptr) {
+    unwinding_worker_pool_->ProcessUretprobes(event->GetTid());
+  } else {
+    callstack_manager_->ProcessUretprobes(event->GetTid());
+  }
+}
+
+void UprobesUnwindingVisitor::visit(PmuCounterSwitchPerfEvent* event) {
+  pmu_counter_accumulator_.OnSwitch(event->GetPrevTid(), event->GetCpu(),
+                                    event->GetPmuCounters());
+}
+
+std::optional<PmuCounterValues> UprobesUnwindingVisitor::GetThreadPmuCounters(
+    const AbstractUprobesPerfEvent& event, pid_t tid, uint32_t cpu) {
+  if (!event.GetPmuCounters().has_value()) {
+    return std::nullopt;
+  }
+  return pmu_counter_accumulator_.GetThreadCounters(
+      tid, cpu, event.GetPmuCounters().value());
 }
 
 void UprobesUnwindingVisitor::visit(MapsPerfEvent* event) {
-  callstack_manager_.ProcessMaps(event->GetMaps());
+  if (unwinding_worker_pool_ != nullptr) {
+    unwinding_worker_pool_->ProcessMaps(event->GetMaps());
+  } else {
+    callstack_manager_->ProcessMaps(event->GetMaps());
+  }
+}
+
+void UprobesUnwindingVisitor::visit(MmapPerfEvent* event) {
+  if (unwinding_worker_pool_ != nullptr) {
+    unwinding_worker_pool_->ProcessMmap(event->GetAddress(), event->GetLength(),
+                                        event->GetPageOffset(),
+                                        event->GetFilename());
+  } else {
+    callstack_manager_->ProcessMmap(event->GetAddress(), event->GetLength(),
+                                    event->GetPageOffset(),
+                                    event->GetFilename());
+  }
+}
+
+void UprobesUnwindingVisitor::OnCallstack(
+    pid_t tid, uint64_t timestamp_ns,
+    const std::vector<unwindstack::FrameData>& callstack) {
+  Callstack returned_callstack{
+      tid, CallstackFramesFromLibunwindstackFrames(callstack), timestamp_ns};
+  std::lock_guard<std::mutex> lock{listener_mutex_};
+  listener_->OnCallstack(returned_callstack);
+}
+
+void UprobesUnwindingVisitor::OnOffCpuCallstack(
+    pid_t tid, uint64_t begin_timestamp_ns, uint64_t end_timestamp_ns,
+    const std::vector<unwindstack::FrameData>& callstack) {
+  OffCpuCallstack off_cpu_callstack{
+      Callstack{tid, CallstackFramesFromLibunwindstackFrames(callstack),
+                begin_timestamp_ns},
+      end_timestamp_ns};
+  std::lock_guard<std::mutex> lock{listener_mutex_};
+  listener_->OnOffCpuCallstack(off_cpu_callstack);
+}
+
+void UprobesUnwindingVisitor::OnGpuSubmissionCallstack(
+    pid_t tid, uint64_t timestamp_ns,
+    const std::vector<unwindstack::FrameData>& callstack) {
+  Callstack returned_callstack{
+      tid, CallstackFramesFromLibunwindstackFrames(callstack), timestamp_ns};
+  std::lock_guard<std::mutex> lock{listener_mutex_};
+  listener_->OnGpuSubmissionCallstack(returned_callstack);
+}
+
+void UprobesUnwindingVisitor::OnPageFault(
+    pid_t tid, uint64_t timestamp_ns, bool major,
+    const std::vector<unwindstack::FrameData>& callstack) {
+  PageFault page_fault{
+      Callstack{tid, CallstackFramesFromLibunwindstackFrames(callstack),
+                timestamp_ns},
+      major};
+  std::lock_guard<std::mutex> lock{listener_mutex_};
+  listener_->OnPageFault(page_fault);
+}
+
+void UprobesUnwindingVisitor::OnHeapAllocation(
+    pid_t tid, uint64_t timestamp_ns, uint64_t address, uint64_t size,
+    const std::vector<unwindstack::FrameData>& callstack) {
+  HeapAllocation heap_allocation{
+      Callstack{tid, CallstackFramesFromLibunwindstackFrames(callstack),
+                timestamp_ns},
+      address, size};
+  std::lock_guard<std::mutex> lock{listener_mutex_};
+  listener_->OnHeapAllocation(heap_allocation);
+}
+
+void UprobesUnwindingVisitor::OnHeapFree(pid_t tid, uint64_t timestamp_ns,
+                                         uint64_t address) {
+  HeapFree heap_free{tid, timestamp_ns, address};
+  std::lock_guard<std::mutex> lock{listener_mutex_};
+  listener_->OnHeapFree(heap_free);
+}
+
+void UprobesUnwindingVisitor::OnLockWait(
+    pid_t tid, uint64_t begin_timestamp_ns, uint64_t end_timestamp_ns,
+    uint64_t lock_address,
+    const std::vector<unwindstack::FrameData>& callstack) {
+  LockWait lock_wait{
+      Callstack{tid, CallstackFramesFromLibunwindstackFrames(callstack),
+                end_timestamp_ns},
+      begin_timestamp_ns, lock_address};
+  std::lock_guard<std::mutex> lock{listener_mutex_};
+  listener_->OnLockWait(lock_wait);
 }
 
 std::vector<CallstackFrame>
@@ -4,13 +4,18 @@
 #include <OrbitLinuxTracing/Events.h>
 #include <OrbitLinuxTracing/TracerListener.h>
 
+#include <memory>
+#include <mutex>
 #include <stack>
 
 #include "LibunwindstackUnwinder.h"
 #include "PerfEvent.h"
 #include "PerfEventVisitor.h"
+#include "PmuCounterAccumulator.h"
+#include "StackDumpSizeTuner.h"
 #include "UprobesCallstackManager.h"
 #include "UprobesFunctionCallManager.h"
+#include "UprobesUnwindingWorkerPool.h"
 #include "absl/container/flat_hash_map.h"
 
 namespace LinuxTracing {
@@ -32,31 +37,110 @@ namespace LinuxTracing {
 //  uretprobes events should be rare if they don't come with a stack sample).
 //  Start by passing the function_address to ProcessUretprobes as well for a
 //  comparison against the address of the uprobe on the stack.
+// With a positive unwinding_thread_count, the work of UprobesCallstackManager
+// is done by an UprobesUnwindingWorkerPool instead, and callstacks are passed
+// to the listener from its worker threads. The destructor waits for all pending
+// callstacks to be reported.
+// Functions instrumented without callstack (UprobesPerfEvent) only produce
+// function calls: stack samples falling inside them are discarded, as their
+// callstacks cannot be reconstructed.
+// With unwind_with_frame_pointers, callstacks are unwound by following frame
+// pointers when possible (see LibunwindstackUnwinder::SetUseFramePointers).
+// For functions instrumented with PMU counters, the counters of the cpus read
+// by the probes are turned into counters of the threads with the ones read at
+// context switches (PmuCounterSwitchPerfEvent), see PmuCounterAccumulator.
+// The stack of a thread switched out while blocked (OffCpuStackSamplePerfEvent)
+// is kept until the thread is switched in again (SchedSwitchInPerfEvent), and
+// only then unwound and reported as an OffCpuCallstack. As the thread didn't
+// run in between, neither its stack of uprobes callstacks nor, in practice,
+// the maps it uses have changed.
+// The stack of a thread submitting work to the GPU
+// (GpuSubmissionStackSamplePerfEvent) is unwound like a sample, and reported
+// with TracerListener::OnGpuSubmissionCallstack instead, and so is the stack
+// of a thread that faulted on a page (PageFaultStackSamplePerfEvent), reported
+// as a PageFault.
+// The stack of a thread calling the allocator for a sampled heap allocation
+// (HeapAllocationStackSamplePerfEvent) is kept until the allocation returns
+// (HeapAllocationPerfEvent), and only then unwound and reported as a
+// HeapAllocation, with no frames if the stack was lost. The frees of the
+// sampled blocks (HeapFreePerfEvent) are reported in order with them.
+// A long futex wait (LockWaitPerfEvent) comes before the stack of its thread
+// at the end of the wait (LockWaitStackSamplePerfEvent): it is kept until
+// then, and reported as a LockWait with that callstack, or with no frames if
+// the next wait of the thread comes first.
 
 class UprobesUnwindingVisitor : public PerfEventVisitor {
  public:
-  explicit UprobesUnwindingVisitor(const std::string& initial_maps)
-      : callstack_manager_{&unwinder_, initial_maps} {}
+  explicit UprobesUnwindingVisitor(const std::string& initial_maps,
+                                   size_t unwinding_thread_count = 0,
+                                   bool unwind_with_frame_pointers = false);
 
   UprobesUnwindingVisitor(const UprobesUnwindingVisitor&) = delete;
   UprobesUnwindingVisitor& operator=(const UprobesUnwindingVisitor&) = delete;
 
-  UprobesUnwindingVisitor(UprobesUnwindingVisitor&&) = default;
-  UprobesUnwindingVisitor& operator=(UprobesUnwindingVisitor&&) = default;
+  UprobesUnwindingVisitor(UprobesUnwindingVisitor&&) = delete;
+  UprobesUnwindingVisitor& operator=(UprobesUnwindingVisitor&&) = delete;
 
   void SetListener(TracerListener* listener) { listener_ = listener; }
+  // Has to be set before the first stack sample, see
+  // UprobesCallstackManager::SetStackDumpSizeTuner.
+  void SetStackDumpSizeTuner(StackDumpSizeTuner* stack_dump_size_tuner);
 
   void visit(StackSamplePerfEvent* event) override;
+  void visit(OffCpuStackSamplePerfEvent* event) override;
+  void visit(SchedSwitchInPerfEvent* event) override;
+  void visit(GpuSubmissionStackSamplePerfEvent* event) override;
+  void visit(PageFaultStackSamplePerfEvent* event) override;
+  void visit(HeapAllocationStackSamplePerfEvent* event) override;
+  void visit(LockWaitStackSamplePerfEvent* event) override;
   void visit(UprobesWithStackPerfEvent* event) override;
+  void visit(UprobesPerfEvent* event) override;
   void visit(UretprobesPerfEvent* event) override;
+  void visit(PmuCounterSwitchPerfEvent* event) override;
+  void visit(HeapAllocationPerfEvent* event) override;
+  void visit(HeapFreePerfEvent* event) override;
+  void visit(LockWaitPerfEvent* event) override;
   void visit(MapsPerfEvent* event) override;
+  void visit(MmapPerfEvent* event) override;
 
  private:
+  void OnCallstack(pid_t tid, uint64_t timestamp_ns,
+                   const std::vector<unwindstack::FrameData>& callstack);
+  void OnOffCpuCallstack(pid_t tid, uint64_t begin_timestamp_ns,
+                         uint64_t end_timestamp_ns,
+                         const std::vector<unwindstack::FrameData>& callstack);
+  void OnGpuSubmissionCallstack(
+      pid_t tid, uint64_t timestamp_ns,
+      const std::vector<unwindstack::FrameData>& callstack);
+  void OnPageFault(pid_t tid, uint64_t timestamp_ns, bool major,
+                   const std::vector<unwindstack::FrameData>& callstack);
+  void OnHeapAllocation(pid_t tid, uint64_t timestamp_ns, uint64_t address,
+                        uint64_t size,
+                        const std::vector<unwindstack::FrameData>& callstack);
+  void OnHeapFree(pid_t tid, uint64_t timestamp_ns, uint64_t address);
+  void OnLockWait(pid_t tid, uint64_t begin_timestamp_ns,
+                  uint64_t end_timestamp_ns, uint64_t lock_address,
+                  const std::vector<unwindstack::FrameData>& callstack);
+
+  // wait_event is nullptr if the stack of the wait was lost.
+  void ProcessLockWait(const LockWaitPerfEvent& wait,
+                       std::unique_ptr<StackSamplePerfEvent> wait_event);
+
+  // Returns false if the uprobes event should be discarded.
+  bool ProcessUprobeSpIpCpu(pid_t tid, uint64_t uprobe_sp, uint64_t uprobe_ip,
+                            uint32_t uprobe_cpu);
+
+  // The counters of the thread of a u(ret)probes with PMU counters.
+  std::optional<PmuCounterValues> GetThreadPmuCounters(
+      const AbstractUprobesPerfEvent& event, pid_t tid, uint32_t cpu);
+
   UprobesFunctionCallManager function_call_manager_{};
+  PmuCounterAccumulator pmu_counter_accumulator_{};
   LibunwindstackUnwinder unwinder_{};
-  UprobesCallstackManager<LibunwindstackUnwinder> callstack_manager_;
 
   TracerListener* listener_ = nullptr;
+  // The worker threads of unwinding_worker_pool_ also call the listener.
+  std::mutex listener_mutex_;
 
   static std::vector<CallstackFrame> CallstackFramesFromLibunwindstackFrames(
       const std::vector<unwindstack::FrameData>& libunwindstack_frames);
@@ -64,6 +148,26 @@ class UprobesUnwindingVisitor : public PerfEventVisitor {
   absl::flat_hash_map<pid_t,
                       std::vector<std::tuple<uint64_t, uint64_t, uint32_t>>>
       uprobe_sps_ips_cpus_per_thread_{};
+
+  // The stacks of the threads switched out while blocked, until they are
+  // switched in again.
+  absl::flat_hash_map<pid_t, std::unique_ptr<OffCpuStackSamplePerfEvent>>
+      off_cpu_stack_samples_per_thread_{};
+  // The stacks of the threads in a sampled allocation, until it returns.
+  absl::flat_hash_map<pid_t,
+                      std::unique_ptr<HeapAllocationStackSamplePerfEvent>>
+      heap_allocation_stack_samples_per_thread_{};
+  // The long waits of the threads, until their stacks come.
+  absl::flat_hash_map<pid_t, std::unique_ptr<LockWaitPerfEvent>>
+      lock_waits_per_thread_{};
+
+  // Exactly one of callstack_manager_ and unwinding_worker_pool_ is set.
+  // Declared last, so that the workers, which use the fields above, are joined
+  // first on destruction.
+  std::unique_ptr<UprobesCallstackManager<LibunwindstackUnwinder>>
+      callstack_manager_;
+  std::unique_ptr<UprobesUnwindingWorkerPool<LibunwindstackUnwinder>>
+      unwinding_worker_pool_;
 };
 
 }  // namespace LinuxTracing
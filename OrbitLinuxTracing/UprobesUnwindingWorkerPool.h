@@ -0,0 +1,525 @@
+#ifndef ORBIT_LINUX_TRACING_UPROBES_UNWINDING_WORKER_POOL_H_
+#define ORBIT_LINUX_TRACING_UPROBES_UNWINDING_WORKER_POOL_H_
+
+#include <OrbitBase/Logging.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "LibunwindstackUnwinder.h"
+#include "PerfEvent.h"
+#include "UnwindingMaps.h"
+#include "UprobesCallstackManager.h"
+#include "absl/container/flat_hash_map.h"
+
+namespace LinuxTracing {
+
+// UprobesUnwindingWorkerPool moves the work of UprobesCallstackManager, i.e.,
+// unwinding the stack samples and the stacks collected at uprobes, off the
+// thread processing the events, to a pool of worker threads.
+// Threads are partitioned among the workers by tid: each worker owns an
+// UprobesCallstackManager and receives, in order, all the uprobes, uretprobes
+// and stack samples of its threads, so that the per-thread stacks of uprobes
+// callstacks stay consistent. Maps updates are applied once, and workers share
+// the same snapshots of the maps (libunwindstack synchronizes the lazy loading
+// of ELF files internally): a new snapshot is sent to all workers before the
+// next task that needs it.
+// As workers progress at different speeds, unwound samples are re-sequenced
+// before being passed to the callback: this happens in the order in which the
+// samples were submitted, which is the order of their timestamps. The callback
+// is called from the worker threads, but never concurrently, and is not called
+// for samples whose unwinding failed.
+// The stacks of threads switched out while blocked are unwound like samples,
+// in the same sequence, but are passed to the off-CPU callstack callback with
+// the time the thread was switched in again. So are the stacks of threads
+// submitting work to the GPU, passed to the GPU submission callstack callback,
+// and the stacks of the page faults, passed to the page fault callback.
+// So are the stacks of the sampled heap allocations, passed to the heap
+// allocation callback even if their unwinding failed, as the live heap needs
+// the allocation either way. The frees of their blocks take a number in the
+// same sequence, so that a block is never freed before it was allocated.
+// The stacks of the long futex waits are likewise passed to the lock wait
+// callback even without frames, as the wait itself is worth reporting.
+// This is a class template to simplify testing, so that we can pass a mock
+// unwinder.
+template <typename UnwinderT>
+class UprobesUnwindingWorkerPool {
+ public:
+  using CallstackCallback = std::function<void(
+      pid_t tid, uint64_t timestamp_ns,
+      const std::vector<unwindstack::FrameData>& callstack)>;
+  using OffCpuCallstackCallback = std::function<void(
+      pid_t tid, uint64_t begin_timestamp_ns, uint64_t end_timestamp_ns,
+      const std::vector<unwindstack::FrameData>& callstack)>;
+  using PageFaultCallback = std::function<void(
+      pid_t tid, uint64_t timestamp_ns, bool major,
+      const std::vector<unwindstack::FrameData>& callstack)>;
+  using HeapAllocationCallback = std::function<void(
+      pid_t tid, uint64_t timestamp_ns, uint64_t address, uint64_t size,
+      const std::vector<unwindstack::FrameData>& callstack)>;
+  using HeapFreeCallback =
+      std::function<void(pid_t tid, uint64_t timestamp_ns, uint64_t address)>;
+  using LockWaitCallback = std::function<void(
+      pid_t tid, uint64_t begin_timestamp_ns, uint64_t end_timestamp_ns,
+      uint64_t lock_address,
+      const std::vector<unwindstack::FrameData>& callstack)>;
+
+  // Each worker unwinds with its own copy of unwinder.
+  UprobesUnwindingWorkerPool(size_t thread_count,
+                             const std::string& initial_maps,
+                             CallstackCallback callback,
+                             const UnwinderT& unwinder = UnwinderT{})
+      : callback_{std::move(callback)} {
+    CHECK(thread_count > 0);
+    unwinding_maps_.Reset(initial_maps);
+    std::shared_ptr<unwindstack::Maps> maps = unwinding_maps_.Get();
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+      workers_.push_back(std::make_unique<Worker>(this, maps, unwinder));
+    }
+  }
+
+  // Waits for all the submitted work to be completed.
+  ~UprobesUnwindingWorkerPool() {
+    for (std::unique_ptr<Worker>& worker : workers_) {
+      worker->Stop();
+    }
+    workers_.clear();
+    CHECK(unwound_samples_.empty());
+  }
+
+  UprobesUnwindingWorkerPool(const UprobesUnwindingWorkerPool&) = delete;
+  UprobesUnwindingWorkerPool& operator=(const UprobesUnwindingWorkerPool&) =
+      delete;
+  UprobesUnwindingWorkerPool(UprobesUnwindingWorkerPool&&) = delete;
+  UprobesUnwindingWorkerPool& operator=(UprobesUnwindingWorkerPool&&) = delete;
+
+  // Has to be set before the first call to ProcessOffCpuCallstack.
+  void SetOffCpuCallstackCallback(OffCpuCallstackCallback callback) {
+    off_cpu_callback_ = std::move(callback);
+  }
+
+  // Has to be set before the first call to ProcessGpuSubmissionCallstack.
+  void SetGpuSubmissionCallstackCallback(CallstackCallback callback) {
+    gpu_submission_callback_ = std::move(callback);
+  }
+
+  // Has to be set before the first call to ProcessPageFaultCallstack.
+  void SetPageFaultCallback(PageFaultCallback callback) {
+    page_fault_callback_ = std::move(callback);
+  }
+
+  // Have to be set before the first call to ProcessHeapAllocation and
+  // ProcessHeapFree.
+  void SetHeapCallbacks(HeapAllocationCallback allocation_callback,
+                        HeapFreeCallback free_callback) {
+    heap_allocation_callback_ = std::move(allocation_callback);
+    heap_free_callback_ = std::move(free_callback);
+  }
+
+  // Has to be set before the first call to ProcessLockWait.
+  void SetLockWaitCallback(LockWaitCallback callback) {
+    lock_wait_callback_ = std::move(callback);
+  }
+
+  // Has to be set before the first call to ProcessSampledCallstack, see
+  // UprobesCallstackManager::SetStackDumpSizeTuner.
+  void SetStackDumpSizeTuner(StackDumpSizeTuner* stack_dump_size_tuner) {
+    for (std::unique_ptr<Worker>& worker : workers_) {
+      worker->SetStackDumpSizeTuner(stack_dump_size_tuner);
+    }
+  }
+
+  void ProcessMaps(const std::string& maps_buffer) {
+    unwinding_maps_.Reset(maps_buffer);
+    maps_changed_ = true;
+  }
+
+  void ProcessMmap(uint64_t address, uint64_t length, uint64_t page_offset,
+                   const std::string& filename) {
+    unwinding_maps_.AddMmap(address, length, page_offset, filename);
+    maps_changed_ = true;
+  }
+
+  void ProcessUprobesCallstack(pid_t tid,
+                               UprobesWithStackPerfEvent&& uprobes_event) {
+    SendMapsIfChanged();
+    Task task{Task::Type::kUprobes, tid};
+    task.uprobes_event =
+        std::make_unique<UprobesWithStackPerfEvent>(std::move(uprobes_event));
+    GetWorker(tid)->Push(std::move(task));
+  }
+
+  void ProcessUprobesWithoutCallstack(pid_t tid) {
+    GetWorker(tid)->Push(Task{Task::Type::kUprobesWithoutCallstack, tid});
+  }
+
+  void ProcessSampledCallstack(pid_t tid, StackSamplePerfEvent&& sample_event) {
+    SendMapsIfChanged();
+    Task task{Task::Type::kSample, tid, next_sequence_number_to_submit_++};
+    task.sample_event =
+        std::make_unique<StackSamplePerfEvent>(std::move(sample_event));
+    GetWorker(tid)->Push(std::move(task));
+  }
+
+  // switch_out_event is the stack of tid when it was switched out, and
+  // switch_in_timestamp_ns when it was switched in again.
+  void ProcessOffCpuCallstack(pid_t tid,
+                              StackSamplePerfEvent&& switch_out_event,
+                              uint64_t switch_in_timestamp_ns) {
+    CHECK(off_cpu_callback_ != nullptr);
+    SendMapsIfChanged();
+    Task task{Task::Type::kOffCpuSample, tid,
+              next_sequence_number_to_submit_++};
+    task.sample_event =
+        std::make_unique<StackSamplePerfEvent>(std::move(switch_out_event));
+    task.switch_in_timestamp_ns = switch_in_timestamp_ns;
+    GetWorker(tid)->Push(std::move(task));
+  }
+
+  void ProcessGpuSubmissionCallstack(pid_t tid,
+                                     StackSamplePerfEvent&& submission_event) {
+    CHECK(gpu_submission_callback_ != nullptr);
+    SendMapsIfChanged();
+    Task task{Task::Type::kGpuSubmissionSample, tid,
+              next_sequence_number_to_submit_++};
+    task.sample_event =
+        std::make_unique<StackSamplePerfEvent>(std::move(submission_event));
+    GetWorker(tid)->Push(std::move(task));
+  }
+
+  void ProcessPageFaultCallstack(pid_t tid, StackSamplePerfEvent&& fault_event,
+                                 bool major) {
+    CHECK(page_fault_callback_ != nullptr);
+    SendMapsIfChanged();
+    Task task{Task::Type::kPageFaultSample, tid,
+              next_sequence_number_to_submit_++};
+    task.sample_event =
+        std::make_unique<StackSamplePerfEvent>(std::move(fault_event));
+    task.major_page_fault = major;
+    GetWorker(tid)->Push(std::move(task));
+  }
+
+  // allocation_event is the stack of tid when it called the allocator, or
+  // nullptr if it was lost, and timestamp_ns when the allocation returned.
+  void ProcessHeapAllocation(
+      pid_t tid, std::unique_ptr<StackSamplePerfEvent> allocation_event,
+      uint64_t timestamp_ns, uint64_t address, uint64_t size) {
+    CHECK(heap_allocation_callback_ != nullptr);
+    Task task{Task::Type::kHeapAllocationSample, tid,
+              next_sequence_number_to_submit_++};
+    task.timestamp_ns = timestamp_ns;
+    task.heap_address = address;
+    task.heap_size = size;
+    if (allocation_event == nullptr) {
+      // Nothing to unwind.
+      OnSampleUnwound(task.sequence_number, UnwoundSampleFromTask(task, {}));
+      return;
+    }
+    SendMapsIfChanged();
+    task.sample_event = std::move(allocation_event);
+    GetWorker(tid)->Push(std::move(task));
+  }
+
+  void ProcessHeapFree(pid_t tid, uint64_t timestamp_ns, uint64_t address) {
+    CHECK(heap_free_callback_ != nullptr);
+    Task task{Task::Type::kHeapFree, tid, next_sequence_number_to_submit_++};
+    task.timestamp_ns = timestamp_ns;
+    task.heap_address = address;
+    OnSampleUnwound(task.sequence_number, UnwoundSampleFromTask(task, {}));
+  }
+
+  // wait_event is the stack of tid when its wait ended, or nullptr if it was
+  // lost.
+  void ProcessLockWait(pid_t tid,
+                       std::unique_ptr<StackSamplePerfEvent> wait_event,
+                       uint64_t begin_timestamp_ns, uint64_t end_timestamp_ns,
+                       uint64_t lock_address) {
+    CHECK(lock_wait_callback_ != nullptr);
+    Task task{Task::Type::kLockWaitSample, tid,
+              next_sequence_number_to_submit_++};
+    task.timestamp_ns = end_timestamp_ns;
+    task.begin_timestamp_ns = begin_timestamp_ns;
+    task.lock_address = lock_address;
+    if (wait_event == nullptr) {
+      OnSampleUnwound(task.sequence_number, UnwoundSampleFromTask(task, {}));
+      return;
+    }
+    SendMapsIfChanged();
+    task.sample_event = std::move(wait_event);
+    GetWorker(tid)->Push(std::move(task));
+  }
+
+  void ProcessUretprobes(pid_t tid) {
+    GetWorker(tid)->Push(Task{Task::Type::kUretprobes, tid});
+  }
+
+ private:
+  struct Task {
+    enum class Type {
+      kMaps,
+      kUprobes,
+      kUprobesWithoutCallstack,
+      kUretprobes,
+      kSample,
+      kOffCpuSample,
+      kGpuSubmissionSample,
+      kPageFaultSample,
+      kHeapAllocationSample,
+      kHeapFree,
+      kLockWaitSample
+    };
+    Type type;
+    pid_t tid = -1;
+    uint64_t sequence_number = 0;
+    std::shared_ptr<unwindstack::Maps> maps;
+    std::unique_ptr<UprobesWithStackPerfEvent> uprobes_event;
+    std::unique_ptr<StackSamplePerfEvent> sample_event;
+    // Only for kOffCpuSample.
+    uint64_t switch_in_timestamp_ns = 0;
+    // Only for kPageFaultSample.
+    bool major_page_fault = false;
+    // Only for kHeapAllocationSample and kLockWaitSample, whose timestamps
+    // are not the ones of their sample_event, and kHeapFree.
+    uint64_t timestamp_ns = 0;
+    uint64_t heap_address = 0;
+    uint64_t heap_size = 0;
+    // Only for kLockWaitSample, whose timestamp is the end of the wait.
+    uint64_t begin_timestamp_ns = 0;
+    uint64_t lock_address = 0;
+  };
+
+  struct UnwoundSample {
+    // One of the types of Task for samples.
+    typename Task::Type type;
+    pid_t tid;
+    uint64_t timestamp_ns;
+    // Only for kOffCpuSample.
+    uint64_t switch_in_timestamp_ns;
+    // Only for kPageFaultSample.
+    bool major_page_fault;
+    // Only for kHeapAllocationSample and kHeapFree.
+    uint64_t heap_address;
+    uint64_t heap_size;
+    // Only for kLockWaitSample.
+    uint64_t begin_timestamp_ns;
+    uint64_t lock_address;
+    std::vector<unwindstack::FrameData> callstack;
+  };
+
+  static UnwoundSample UnwoundSampleFromTask(
+      const Task& task, std::vector<unwindstack::FrameData> callstack) {
+    return UnwoundSample{task.type,
+                         task.tid,
+                         task.timestamp_ns,
+                         task.switch_in_timestamp_ns,
+                         task.major_page_fault,
+                         task.heap_address,
+                         task.heap_size,
+                         task.begin_timestamp_ns,
+                         task.lock_address,
+                         std::move(callstack)};
+  }
+
+  class Worker {
+   public:
+    Worker(UprobesUnwindingWorkerPool* pool,
+           std::shared_ptr<unwindstack::Maps> initial_maps,
+           const UnwinderT& unwinder)
+        : pool_{pool},
+          unwinder_{unwinder},
+          callstack_manager_{&unwinder_, std::move(initial_maps)},
+          thread_{&Worker::Run, this} {}
+
+    ~Worker() { thread_.join(); }
+
+    Worker(const Worker&) = delete;
+    Worker& operator=(const Worker&) = delete;
+
+    void Push(Task&& task) {
+      {
+        std::lock_guard<std::mutex> lock{mutex_};
+        tasks_.push_back(std::move(task));
+      }
+      tasks_available_.notify_one();
+    }
+
+    void SetStackDumpSizeTuner(StackDumpSizeTuner* stack_dump_size_tuner) {
+      std::lock_guard<std::mutex> lock{mutex_};
+      callstack_manager_.SetStackDumpSizeTuner(stack_dump_size_tuner);
+    }
+
+    // The worker thread exits once all the pushed tasks have been executed.
+    void Stop() {
+      {
+        std::lock_guard<std::mutex> lock{mutex_};
+        stop_requested_ = true;
+      }
+      tasks_available_.notify_one();
+    }
+
+   private:
+    void Run() {
+      std::deque<Task> tasks;
+      while (true) {
+        {
+          std::unique_lock<std::mutex> lock{mutex_};
+          tasks_available_.wait(
+              lock, [this] { return !tasks_.empty() || stop_requested_; });
+          if (tasks_.empty()) {
+            return;
+          }
+          // Take all the pending tasks at once to lock only once per batch.
+          tasks.swap(tasks_);
+        }
+        for (Task& task : tasks) {
+          Execute(&task);
+        }
+        tasks.clear();
+      }
+    }
+
+    void Execute(Task* task) {
+      switch (task->type) {
+        case Task::Type::kMaps:
+          callstack_manager_.ProcessMaps(std::move(task->maps));
+          break;
+        case Task::Type::kUprobes:
+          callstack_manager_.ProcessUprobesCallstack(
+              task->tid, std::move(*task->uprobes_event));
+          break;
+        case Task::Type::kUprobesWithoutCallstack:
+          callstack_manager_.ProcessUprobesWithoutCallstack(task->tid);
+          break;
+        case Task::Type::kUretprobes:
+          callstack_manager_.ProcessUretprobes(task->tid);
+          break;
+        case Task::Type::kSample:
+        case Task::Type::kOffCpuSample:
+        case Task::Type::kGpuSubmissionSample:
+        case Task::Type::kPageFaultSample:
+        case Task::Type::kHeapAllocationSample:
+        case Task::Type::kLockWaitSample: {
+          std::vector<unwindstack::FrameData> callstack =
+              callstack_manager_.ProcessSampledCallstack(task->tid,
+                                                         *task->sample_event);
+          if (task->type != Task::Type::kHeapAllocationSample &&
+              task->type != Task::Type::kLockWaitSample) {
+            task->timestamp_ns = task->sample_event->GetTimestamp();
+          }
+          // The stack dump is no longer needed.
+          task->sample_event.reset();
+          pool_->OnSampleUnwound(
+              task->sequence_number,
+              UnwoundSampleFromTask(*task, std::move(callstack)));
+        } break;
+        case Task::Type::kHeapFree:
+          // Never pushed to a worker.
+          break;
+      }
+    }
+
+    UprobesUnwindingWorkerPool* pool_;
+    UnwinderT unwinder_;
+    UprobesCallstackManager<UnwinderT> callstack_manager_;
+
+    std::mutex mutex_;
+    std::condition_variable tasks_available_;
+    std::deque<Task> tasks_;
+    bool stop_requested_ = false;
+
+    // Declared last, so that the thread starts after everything else has been
+    // initialized.
+    std::thread thread_;
+  };
+
+  void SendMapsIfChanged() {
+    if (!maps_changed_) {
+      return;
+    }
+    std::shared_ptr<unwindstack::Maps> maps = unwinding_maps_.Get();
+    for (std::unique_ptr<Worker>& worker : workers_) {
+      Task task{Task::Type::kMaps};
+      task.maps = maps;
+      worker->Push(std::move(task));
+    }
+    maps_changed_ = false;
+  }
+
+  Worker* GetWorker(pid_t tid) {
+    return workers_[static_cast<size_t>(tid) % workers_.size()].get();
+  }
+
+  void OnSampleUnwound(uint64_t sequence_number, UnwoundSample unwound_sample) {
+    std::lock_guard<std::mutex> lock{resequencing_mutex_};
+    unwound_samples_.emplace(sequence_number, std::move(unwound_sample));
+    // Report all the samples that are now consecutive to the last one reported.
+    for (auto it = unwound_samples_.find(next_sequence_number_to_report_);
+         it != unwound_samples_.end();
+         it = unwound_samples_.find(next_sequence_number_to_report_)) {
+      const UnwoundSample& unwound_sample = it->second;
+      if (unwound_sample.type == Task::Type::kHeapAllocationSample) {
+        heap_allocation_callback_(
+            unwound_sample.tid, unwound_sample.timestamp_ns,
+            unwound_sample.heap_address, unwound_sample.heap_size,
+            unwound_sample.callstack);
+      } else if (unwound_sample.type == Task::Type::kHeapFree) {
+        heap_free_callback_(unwound_sample.tid, unwound_sample.timestamp_ns,
+                            unwound_sample.heap_address);
+      } else if (unwound_sample.type == Task::Type::kLockWaitSample) {
+        lock_wait_callback_(unwound_sample.tid,
+                            unwound_sample.begin_timestamp_ns,
+                            unwound_sample.timestamp_ns,
+                            unwound_sample.lock_address,
+                            unwound_sample.callstack);
+      } else if (!unwound_sample.callstack.empty()) {
+        if (unwound_sample.type == Task::Type::kOffCpuSample) {
+          off_cpu_callback_(unwound_sample.tid, unwound_sample.timestamp_ns,
+                            unwound_sample.switch_in_timestamp_ns,
+                            unwound_sample.callstack);
+        } else if (unwound_sample.type == Task::Type::kGpuSubmissionSample) {
+          gpu_submission_callback_(unwound_sample.tid,
+                                   unwound_sample.timestamp_ns,
+                                   unwound_sample.callstack);
+        } else if (unwound_sample.type == Task::Type::kPageFaultSample) {
+          page_fault_callback_(unwound_sample.tid, unwound_sample.timestamp_ns,
+                               unwound_sample.major_page_fault,
+                               unwound_sample.callstack);
+        } else {
+          callback_(unwound_sample.tid, unwound_sample.timestamp_ns,
+                    unwound_sample.callstack);
+        }
+      }
+      unwound_samples_.erase(it);
+      ++next_sequence_number_to_report_;
+    }
+  }
+
+  CallstackCallback callback_;
+  OffCpuCallstackCallback off_cpu_callback_;
+  CallstackCallback gpu_submission_callback_;
+  PageFaultCallback page_fault_callback_;
+  HeapAllocationCallback heap_allocation_callback_;
+  HeapFreeCallback heap_free_callback_;
+  LockWaitCallback lock_wait_callback_;
+  // Only accessed by the thread submitting the work.
+  UnwindingMaps unwinding_maps_;
+  bool maps_changed_ = false;
+  uint64_t next_sequence_number_to_submit_ = 0;
+
+  std::mutex resequencing_mutex_;
+  uint64_t next_sequence_number_to_report_ = 0;
+  absl::flat_hash_map<uint64_t, UnwoundSample> unwound_samples_;
+
+  // Declared last, so that the workers are destroyed, hence joined, first.
+  std::vector<std::unique_ptr<Worker>> workers_;
+};
+
+}  // namespace LinuxTracing
+
+#endif  // ORBIT_LINUX_TRACING_UPROBES_UNWINDING_WORKER_POOL_H_
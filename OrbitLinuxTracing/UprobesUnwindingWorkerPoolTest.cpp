@@ -0,0 +1,415 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "UprobesUnwindingWorkerPool.h"
+
+namespace LinuxTracing {
+
+namespace {
+
+// The stack dumps used in these tests only contain a uint64_t: the value
+// determines the callstack returned by TestUnwinder. Other values than the
+// ones below produce the callstack "main" -> value.
+constexpr uint64_t UNWINDING_ERROR_STACK = 0;
+constexpr uint64_t UPROBES_STACK = 1;
+
+class TestUnwinder {
+ public:
+  std::vector<unwindstack::FrameData> Unwind(
+      unwindstack::Maps* /*maps*/,
+      const std::array<uint64_t, PERF_REG_X86_64_MAX>& /*perf_regs*/,
+      const char* stack_dump, uint64_t stack_dump_size) {
+    CHECK(stack_dump_size == sizeof(uint64_t));
+    uint64_t value;
+    memcpy(&value, stack_dump, sizeof(value));
+    // Make workers progress at different speeds.
+    usleep(value % 3 * 100);
+
+    if (value == UNWINDING_ERROR_STACK) {
+      return {};
+    }
+    unwindstack::FrameData frame{};
+    frame.function_name = std::to_string(value);
+    frame.map_name = "a.out";
+    unwindstack::FrameData caller_frame{};
+    if (value == UPROBES_STACK) {
+      caller_frame.function_name = "uprobes";
+      caller_frame.map_name = "[uprobes]";
+    } else {
+      caller_frame.function_name = "main";
+      caller_frame.map_name = "a.out";
+    }
+    return {frame, caller_frame};
+  }
+};
+
+template <typename EventT>
+EventT MakeTestEvent(pid_t tid, uint64_t timestamp_ns, uint64_t stack_value) {
+  EventT event{sizeof(stack_value)};
+  event.ring_buffer_record->sample_id.pid = 1;
+  event.ring_buffer_record->sample_id.tid = tid;
+  event.ring_buffer_record->sample_id.time = timestamp_ns;
+  memcpy(event.ring_buffer_record->stack.data.get(), &stack_value,
+         sizeof(stack_value));
+  return event;
+}
+
+struct ReportedCallstack {
+  pid_t tid;
+  uint64_t timestamp_ns;
+  std::vector<std::string> function_names;
+};
+
+}  // namespace
+
+TEST(UprobesUnwindingWorkerPool, CallstacksAreReportedInOrder) {
+  constexpr size_t THREAD_COUNT = 4;
+  constexpr pid_t TID_COUNT = 16;
+  constexpr uint64_t SAMPLE_COUNT = 1000;
+
+  std::mutex mutex;
+  std::vector<ReportedCallstack> reported_callstacks;
+  bool concurrent_report = false;
+  {
+    UprobesUnwindingWorkerPool<TestUnwinder> pool{
+        THREAD_COUNT, "",
+        [&](pid_t tid, uint64_t timestamp_ns,
+            const std::vector<unwindstack::FrameData>& callstack) {
+          std::unique_lock<std::mutex> lock{mutex, std::try_to_lock};
+          if (!lock.owns_lock()) {
+            concurrent_report = true;
+            return;
+          }
+          std::vector<std::string> function_names;
+          for (const auto& frame : callstack) {
+            function_names.push_back(frame.function_name);
+          }
+          reported_callstacks.push_back(
+              {tid, timestamp_ns, std::move(function_names)});
+        }};
+    for (uint64_t i = 0; i < SAMPLE_COUNT; ++i) {
+      pid_t tid = static_cast<pid_t>(i % TID_COUNT);
+      // Every tenth sample is an unwinding error.
+      uint64_t value = (i % 10 == 0) ? UNWINDING_ERROR_STACK : i + 2;
+      pool.ProcessSampledCallstack(
+          tid, MakeTestEvent<StackSamplePerfEvent>(tid, 1000 + i, value));
+    }
+  }
+
+  EXPECT_FALSE(concurrent_report);
+  ASSERT_EQ(reported_callstacks.size(), SAMPLE_COUNT - SAMPLE_COUNT / 10);
+  uint64_t previous_timestamp_ns = 0;
+  for (const ReportedCallstack& reported_callstack : reported_callstacks) {
+    uint64_t i = reported_callstack.timestamp_ns - 1000;
+    EXPECT_GT(reported_callstack.timestamp_ns, previous_timestamp_ns);
+    EXPECT_EQ(reported_callstack.tid, static_cast<pid_t>(i % TID_COUNT));
+    EXPECT_EQ(reported_callstack.function_names,
+              (std::vector<std::string>{std::to_string(i + 2), "main"}));
+    previous_timestamp_ns = reported_callstack.timestamp_ns;
+  }
+}
+
+TEST(UprobesUnwindingWorkerPool, UprobesCallstacksArePerThread) {
+  constexpr pid_t TID_1 = 42;
+  constexpr pid_t TID_2 = 43;
+
+  std::vector<ReportedCallstack> reported_callstacks;
+  {
+    UprobesUnwindingWorkerPool<TestUnwinder> pool{
+        2, "",
+        [&](pid_t tid, uint64_t timestamp_ns,
+            const std::vector<unwindstack::FrameData>& callstack) {
+          std::vector<std::string> function_names;
+          for (const auto& frame : callstack) {
+            function_names.push_back(frame.function_name);
+          }
+          reported_callstacks.push_back(
+              {tid, timestamp_ns, std::move(function_names)});
+        }};
+
+    pool.ProcessUprobesCallstack(
+        TID_1, MakeTestEvent<UprobesWithStackPerfEvent>(TID_1, 1, 100));
+    // Broken by the uprobe of TID_1, to be completed.
+    pool.ProcessSampledCallstack(
+        TID_1, MakeTestEvent<StackSamplePerfEvent>(TID_1, 2, UPROBES_STACK));
+    // TID_2 has no uprobes callstack to complete this one with.
+    pool.ProcessSampledCallstack(
+        TID_2, MakeTestEvent<StackSamplePerfEvent>(TID_2, 3, UPROBES_STACK));
+    pool.ProcessUretprobes(TID_1);
+    // The stack of uprobes callstacks of TID_1 is now empty.
+    pool.ProcessSampledCallstack(
+        TID_1, MakeTestEvent<StackSamplePerfEvent>(TID_1, 4, UPROBES_STACK));
+  }
+
+  ASSERT_EQ(reported_callstacks.size(), 3);
+  EXPECT_EQ(reported_callstacks[0].tid, TID_1);
+  EXPECT_EQ(reported_callstacks[0].function_names,
+            (std::vector<std::string>{"1", "main"}));
+  EXPECT_EQ(reported_callstacks[1].tid, TID_2);
+  EXPECT_EQ(reported_callstacks[1].function_names,
+            std::vector<std::string>{"1"});
+  EXPECT_EQ(reported_callstacks[2].tid, TID_1);
+  EXPECT_EQ(reported_callstacks[2].timestamp_ns, 4);
+  EXPECT_EQ(reported_callstacks[2].function_names,
+            std::vector<std::string>{"1"});
+}
+
+TEST(UprobesUnwindingWorkerPool, OffCpuCallstacksKeepTheirSequence) {
+  constexpr pid_t TID = 42;
+
+  // Both kinds of callstacks are appended to the same vector, in the order
+  // they are reported. Off-CPU callstacks are prefixed with "off-cpu".
+  std::vector<ReportedCallstack> reported_callstacks;
+  std::vector<uint64_t> switch_in_timestamps_ns;
+  {
+    UprobesUnwindingWorkerPool<TestUnwinder> pool{
+        3, "",
+        [&](pid_t tid, uint64_t timestamp_ns,
+            const std::vector<unwindstack::FrameData>& callstack) {
+          reported_callstacks.push_back(
+              {tid, timestamp_ns, {callstack[0].function_name}});
+        }};
+    pool.SetOffCpuCallstackCallback(
+        [&](pid_t tid, uint64_t begin_timestamp_ns, uint64_t end_timestamp_ns,
+            const std::vector<unwindstack::FrameData>& callstack) {
+          reported_callstacks.push_back(
+              {tid, begin_timestamp_ns,
+               {"off-cpu", callstack[0].function_name}});
+          switch_in_timestamps_ns.push_back(end_timestamp_ns);
+        });
+
+    pool.ProcessSampledCallstack(
+        TID, MakeTestEvent<StackSamplePerfEvent>(TID, 1, 10));
+    pool.ProcessOffCpuCallstack(
+        TID, MakeTestEvent<OffCpuStackSamplePerfEvent>(TID, 2, 11), 50);
+    pool.ProcessOffCpuCallstack(
+        TID + 1,
+        MakeTestEvent<OffCpuStackSamplePerfEvent>(TID + 1, 3,
+                                                  UNWINDING_ERROR_STACK),
+        60);
+    pool.ProcessSampledCallstack(
+        TID + 2, MakeTestEvent<StackSamplePerfEvent>(TID + 2, 4, 12));
+  }
+
+  ASSERT_EQ(reported_callstacks.size(), 3);
+  EXPECT_EQ(reported_callstacks[0].function_names,
+            std::vector<std::string>{"10"});
+  EXPECT_EQ(reported_callstacks[1].tid, TID);
+  EXPECT_EQ(reported_callstacks[1].timestamp_ns, 2);
+  EXPECT_EQ(reported_callstacks[1].function_names,
+            (std::vector<std::string>{"off-cpu", "11"}));
+  EXPECT_EQ(reported_callstacks[2].function_names,
+            std::vector<std::string>{"12"});
+  EXPECT_EQ(switch_in_timestamps_ns, std::vector<uint64_t>{50});
+}
+
+TEST(UprobesUnwindingWorkerPool, GpuSubmissionCallstacksKeepTheirSequence) {
+  constexpr pid_t TID = 42;
+
+  // GPU submission callstacks are prefixed with "gpu".
+  std::vector<ReportedCallstack> reported_callstacks;
+  {
+    UprobesUnwindingWorkerPool<TestUnwinder> pool{
+        2, "",
+        [&](pid_t tid, uint64_t timestamp_ns,
+            const std::vector<unwindstack::FrameData>& callstack) {
+          reported_callstacks.push_back(
+              {tid, timestamp_ns, {callstack[0].function_name}});
+        }};
+    pool.SetGpuSubmissionCallstackCallback(
+        [&](pid_t tid, uint64_t timestamp_ns,
+            const std::vector<unwindstack::FrameData>& callstack) {
+          reported_callstacks.push_back(
+              {tid, timestamp_ns, {"gpu", callstack[0].function_name}});
+        });
+
+    pool.ProcessGpuSubmissionCallstack(
+        TID, MakeTestEvent<GpuSubmissionStackSamplePerfEvent>(TID, 1, 10));
+    pool.ProcessSampledCallstack(
+        TID + 1, MakeTestEvent<StackSamplePerfEvent>(TID + 1, 2, 11));
+  }
+
+  ASSERT_EQ(reported_callstacks.size(), 2);
+  EXPECT_EQ(reported_callstacks[0].tid, TID);
+  EXPECT_EQ(reported_callstacks[0].timestamp_ns, 1);
+  EXPECT_EQ(reported_callstacks[0].function_names,
+            (std::vector<std::string>{"gpu", "10"}));
+  EXPECT_EQ(reported_callstacks[1].function_names,
+            std::vector<std::string>{"11"});
+}
+
+TEST(UprobesUnwindingWorkerPool, PageFaultCallstacksKeepTheirSequence) {
+  constexpr pid_t TID = 42;
+
+  // Page fault callstacks are prefixed with "major" or "minor".
+  std::vector<ReportedCallstack> reported_callstacks;
+  {
+    UprobesUnwindingWorkerPool<TestUnwinder> pool{
+        2, "",
+        [&](pid_t tid, uint64_t timestamp_ns,
+            const std::vector<unwindstack::FrameData>& callstack) {
+          reported_callstacks.push_back(
+              {tid, timestamp_ns, {callstack[0].function_name}});
+        }};
+    pool.SetPageFaultCallback(
+        [&](pid_t tid, uint64_t timestamp_ns, bool major,
+            const std::vector<unwindstack::FrameData>& callstack) {
+          reported_callstacks.push_back(
+              {tid,
+               timestamp_ns,
+               {major ? "major" : "minor", callstack[0].function_name}});
+        });
+
+    pool.ProcessPageFaultCallstack(
+        TID, MakeTestEvent<PageFaultStackSamplePerfEvent>(TID, 1, 10), true);
+    pool.ProcessPageFaultCallstack(
+        TID + 1,
+        MakeTestEvent<PageFaultStackSamplePerfEvent>(TID + 1, 2,
+                                                     UNWINDING_ERROR_STACK),
+        false);
+    pool.ProcessSampledCallstack(
+        TID + 1, MakeTestEvent<StackSamplePerfEvent>(TID + 1, 3, 11));
+    pool.ProcessPageFaultCallstack(
+        TID, MakeTestEvent<PageFaultStackSamplePerfEvent>(TID, 4, 12), false);
+  }
+
+  ASSERT_EQ(reported_callstacks.size(), 3);
+  EXPECT_EQ(reported_callstacks[0].tid, TID);
+  EXPECT_EQ(reported_callstacks[0].timestamp_ns, 1);
+  EXPECT_EQ(reported_callstacks[0].function_names,
+            (std::vector<std::string>{"major", "10"}));
+  EXPECT_EQ(reported_callstacks[1].function_names,
+            std::vector<std::string>{"11"});
+  EXPECT_EQ(reported_callstacks[2].timestamp_ns, 4);
+  EXPECT_EQ(reported_callstacks[2].function_names,
+            (std::vector<std::string>{"minor", "12"}));
+}
+
+TEST(UprobesUnwindingWorkerPool, HeapFreesFollowTheirAllocations) {
+  constexpr pid_t TID = 42;
+
+  // Heap allocations are prefixed with "alloc", their address and size, and
+  // frees with "free" and their address.
+  std::vector<ReportedCallstack> reported_callstacks;
+  {
+    UprobesUnwindingWorkerPool<TestUnwinder> pool{
+        2, "",
+        [&](pid_t tid, uint64_t timestamp_ns,
+            const std::vector<unwindstack::FrameData>& callstack) {
+          reported_callstacks.push_back(
+              {tid, timestamp_ns, {callstack[0].function_name}});
+        }};
+    pool.SetHeapCallbacks(
+        [&](pid_t tid, uint64_t timestamp_ns, uint64_t address, uint64_t size,
+            const std::vector<unwindstack::FrameData>& callstack) {
+          std::vector<std::string> names{"alloc", std::to_string(address),
+                                         std::to_string(size)};
+          if (!callstack.empty()) {
+            names.push_back(callstack[0].function_name);
+          }
+          reported_callstacks.push_back({tid, timestamp_ns, names});
+        },
+        [&](pid_t tid, uint64_t timestamp_ns, uint64_t address) {
+          reported_callstacks.push_back(
+              {tid, timestamp_ns, {"free", std::to_string(address)}});
+        });
+
+    pool.ProcessSampledCallstack(
+        TID, MakeTestEvent<StackSamplePerfEvent>(TID, 1, 10));
+    // The stack was taken at the call, the allocation returned at 3.
+    pool.ProcessHeapAllocation(
+        TID,
+        std::make_unique<HeapAllocationStackSamplePerfEvent>(
+            MakeTestEvent<HeapAllocationStackSamplePerfEvent>(TID, 2, 11)),
+        3, 0x1000, 64);
+    // Reported without frames, as the live heap needs it.
+    pool.ProcessHeapAllocation(
+        TID + 1,
+        std::make_unique<HeapAllocationStackSamplePerfEvent>(
+            MakeTestEvent<HeapAllocationStackSamplePerfEvent>(
+                TID + 1, 4, UNWINDING_ERROR_STACK)),
+        5, 0x2000, 128);
+    pool.ProcessHeapAllocation(TID, nullptr, 6, 0x3000, 256);
+    // Freed by another thread than the one that allocated it.
+    pool.ProcessHeapFree(TID + 1, 7, 0x1000);
+  }
+
+  ASSERT_EQ(reported_callstacks.size(), 5);
+  EXPECT_EQ(reported_callstacks[0].function_names,
+            std::vector<std::string>{"10"});
+  EXPECT_EQ(reported_callstacks[1].tid, TID);
+  EXPECT_EQ(reported_callstacks[1].timestamp_ns, 3);
+  EXPECT_EQ(reported_callstacks[1].function_names,
+            (std::vector<std::string>{"alloc", "4096", "64", "11"}));
+  EXPECT_EQ(reported_callstacks[2].function_names,
+            (std::vector<std::string>{"alloc", "8192", "128"}));
+  EXPECT_EQ(reported_callstacks[3].function_names,
+            (std::vector<std::string>{"alloc", "12288", "256"}));
+  EXPECT_EQ(reported_callstacks[4].tid, TID + 1);
+  EXPECT_EQ(reported_callstacks[4].timestamp_ns, 7);
+  EXPECT_EQ(reported_callstacks[4].function_names,
+            (std::vector<std::string>{"free", "4096"}));
+}
+
+TEST(UprobesUnwindingWorkerPool, LockWaitsAreReportedWithoutStacks) {
+  constexpr pid_t TID = 42;
+
+  // Lock waits are prefixed with "wait", their lock address and begin.
+  std::vector<ReportedCallstack> reported_callstacks;
+  {
+    UprobesUnwindingWorkerPool<TestUnwinder> pool{
+        2, "",
+        [&](pid_t tid, uint64_t timestamp_ns,
+            const std::vector<unwindstack::FrameData>& callstack) {
+          reported_callstacks.push_back(
+              {tid, timestamp_ns, {callstack[0].function_name}});
+        }};
+    pool.SetLockWaitCallback(
+        [&](pid_t tid, uint64_t begin_timestamp_ns, uint64_t end_timestamp_ns,
+            uint64_t lock_address,
+            const std::vector<unwindstack::FrameData>& callstack) {
+          std::vector<std::string> names{"wait", std::to_string(lock_address),
+                                         std::to_string(begin_timestamp_ns)};
+          if (!callstack.empty()) {
+            names.push_back(callstack[0].function_name);
+          }
+          reported_callstacks.push_back({tid, end_timestamp_ns, names});
+        });
+
+    // The stack was taken at the end of the wait.
+    pool.ProcessLockWait(
+        TID,
+        std::make_unique<LockWaitStackSamplePerfEvent>(
+            MakeTestEvent<LockWaitStackSamplePerfEvent>(TID, 3, 10)),
+        1, 3, 0x1000);
+    pool.ProcessSampledCallstack(
+        TID + 1, MakeTestEvent<StackSamplePerfEvent>(TID + 1, 4, 11));
+    pool.ProcessLockWait(
+        TID + 1,
+        std::make_unique<LockWaitStackSamplePerfEvent>(
+            MakeTestEvent<LockWaitStackSamplePerfEvent>(TID + 1, 6,
+                                                        UNWINDING_ERROR_STACK)),
+        5, 6, 0x2000);
+    pool.ProcessLockWait(TID, nullptr, 7, 8, 0x1000);
+  }
+
+  ASSERT_EQ(reported_callstacks.size(), 4);
+  EXPECT_EQ(reported_callstacks[0].tid, TID);
+  EXPECT_EQ(reported_callstacks[0].timestamp_ns, 3);
+  EXPECT_EQ(reported_callstacks[0].function_names,
+            (std::vector<std::string>{"wait", "4096", "1", "10"}));
+  EXPECT_EQ(reported_callstacks[1].function_names,
+            std::vector<std::string>{"11"});
+  EXPECT_EQ(reported_callstacks[2].tid, TID + 1);
+  EXPECT_EQ(reported_callstacks[2].function_names,
+            (std::vector<std::string>{"wait", "8192", "5"}));
+  EXPECT_EQ(reported_callstacks[3].timestamp_ns, 8);
+  EXPECT_EQ(reported_callstacks[3].function_names,
+            (std::vector<std::string>{"wait", "4096", "7"}));
+}
+
+}  // namespace LinuxTracing
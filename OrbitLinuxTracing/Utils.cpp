@@ -2,10 +2,22 @@
 #define ORBIT_LINUX_TRACING_UTILS_H_
 
 #include <OrbitBase/Logging.h>
+#include <OrbitBase/SafeStrerror.h>
+#include <cpuid.h>
+#include <elf.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <optional>
+#include <string>
 #include <thread>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_split.h"
@@ -159,6 +171,107 @@ std::vector<int> GetCpusetCpus(pid_t pid) {
   return ParseCpusetCpus(cpuset_cpus_content_opt.value());
 }
 
+std::vector<pid_t> ParseCgroupProcs(const std::string& cgroup_procs_content) {
+  std::vector<pid_t> pids;
+  for (absl::string_view line : absl::StrSplit(
+           cgroup_procs_content, absl::ByChar('\n'), absl::SkipWhitespace())) {
+    pid_t pid;
+    if (!absl::SimpleAtoi(line, &pid)) {
+      ERROR("Error parsing pid \"%s\" of cgroup.procs",
+            std::string{line}.c_str());
+      continue;
+    }
+    pids.push_back(pid);
+  }
+  return pids;
+}
+
+std::vector<pid_t> ListCgroupProcesses(const std::string& cgroup_path) {
+  std::optional<std::string> cgroup_procs_content =
+      ReadFile(cgroup_path + "/cgroup.procs");
+  if (!cgroup_procs_content.has_value()) {
+    return {};
+  }
+  return ParseCgroupProcs(cgroup_procs_content.value());
+}
+
+void RunInParallel(size_t count, size_t max_threads,
+                   const std::function<void(size_t)>& work) {
+  std::atomic<size_t> next_index = 0;
+  auto run = [&next_index, count, &work] {
+    for (size_t index = next_index++; index < count; index = next_index++) {
+      work(index);
+    }
+  };
+  size_t thread_count = std::min(count, max_threads);
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < thread_count; ++i) {
+    threads.emplace_back(run);
+  }
+  run();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+absl::flat_hash_map<int, std::vector<int>> GetNumaNodeCpus() {
+  absl::flat_hash_map<int, std::vector<int>> numa_node_cpus;
+  std::optional<std::string> online_nodes =
+      ReadFile("/sys/devices/system/node/online");
+  if (!online_nodes.has_value()) {
+    return numa_node_cpus;
+  }
+  // Same format as cpuset.cpus, e.g. "0-1".
+  for (int node : ParseCpusetCpus(online_nodes.value())) {
+    std::optional<std::string> cpulist = ReadFile(
+        absl::StrFormat("/sys/devices/system/node/node%d/cpulist", node));
+    if (cpulist.has_value()) {
+      numa_node_cpus.emplace(node, ParseCpusetCpus(cpulist.value()));
+    }
+  }
+  return numa_node_cpus;
+}
+
+bool SetCurrentThreadAffinity(const std::vector<int>& cpus) {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (int cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &cpu_set);
+    }
+  }
+  // With pid 0, only the calling thread.
+  if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+    ERROR("sched_setaffinity: %s", SafeStrerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool SetCurrentThreadScheduling(int policy, int nice) {
+  sched_param param{};
+  if (sched_setscheduler(0, policy, &param) != 0) {
+    ERROR("sched_setscheduler: %s", SafeStrerror(errno));
+    return false;
+  }
+  // The nice value is per thread on Linux, unlike what POSIX says.
+  if (policy != SCHED_IDLE &&
+      setpriority(PRIO_PROCESS, syscall(SYS_gettid), nice) != 0) {
+    ERROR("setpriority: %s", SafeStrerror(errno));
+    return false;
+  }
+  return true;
+}
+
+std::optional<double> GetTscCtcRatio() {
+  uint32_t eax, ebx, ecx, edx;
+  if (__get_cpuid(0x15, &eax, &ebx, &ecx, &edx) == 0 || eax == 0 ||
+      ebx == 0) {
+    return std::nullopt;
+  }
+  return static_cast<double>(ebx) / eax;
+}
+
 int GetTracepointId(const char* tracepoint_category,
                     const char* tracepoint_name) {
   std::string filename =
@@ -178,6 +291,144 @@ int GetTracepointId(const char* tracepoint_category,
   return tp_id;
 }
 
+std::string ReadElfBuildId(const std::string& path) {
+  std::ifstream file{path, std::ios::in | std::ios::binary};
+  Elf64_Ehdr elf_header;
+  if (!file.read(reinterpret_cast<char*>(&elf_header), sizeof(elf_header)) ||
+      memcmp(elf_header.e_ident, ELFMAG, SELFMAG) != 0 ||
+      elf_header.e_ident[EI_CLASS] != ELFCLASS64 ||
+      elf_header.e_phentsize != sizeof(Elf64_Phdr)) {
+    return "";
+  }
+
+  for (uint16_t i = 0; i < elf_header.e_phnum; ++i) {
+    Elf64_Phdr program_header;
+    file.seekg(elf_header.e_phoff + i * sizeof(program_header));
+    if (!file.read(reinterpret_cast<char*>(&program_header),
+                   sizeof(program_header))) {
+      return "";
+    }
+    if (program_header.p_type != PT_NOTE) {
+      continue;
+    }
+
+    // Notes are a header, then the name and the descriptor, each padded to 4
+    // bytes.
+    std::string notes(program_header.p_filesz, '\0');
+    file.seekg(program_header.p_offset);
+    if (!file.read(notes.data(), notes.size())) {
+      return "";
+    }
+    size_t offset = 0;
+    while (offset + sizeof(Elf64_Nhdr) <= notes.size()) {
+      Elf64_Nhdr note_header;
+      memcpy(&note_header, notes.data() + offset, sizeof(note_header));
+      size_t name_offset = offset + sizeof(note_header);
+      size_t desc_offset = name_offset + ((note_header.n_namesz + 3) & ~3);
+      offset = desc_offset + ((note_header.n_descsz + 3) & ~3);
+      if (offset > notes.size()) {
+        break;
+      }
+      if (note_header.n_type != NT_GNU_BUILD_ID ||
+          notes.compare(name_offset, note_header.n_namesz,
+                        std::string_view{ELF_NOTE_GNU, sizeof(ELF_NOTE_GNU)}) !=
+              0) {
+        continue;
+      }
+      std::string build_id;
+      for (size_t j = 0; j < note_header.n_descsz; ++j) {
+        absl::StrAppendFormat(
+            &build_id, "%02x",
+            static_cast<uint8_t>(notes[desc_offset + j]));
+      }
+      return build_id;
+    }
+  }
+  return "";
+}
+
+absl::flat_hash_map<std::string, uint64_t> ReadElfFunctionOffsets(
+    const std::string& path, const std::vector<std::string>& names) {
+  absl::flat_hash_map<std::string, uint64_t> offsets;
+  std::ifstream file{path, std::ios::in | std::ios::binary};
+  Elf64_Ehdr elf_header;
+  if (!file.read(reinterpret_cast<char*>(&elf_header), sizeof(elf_header)) ||
+      memcmp(elf_header.e_ident, ELFMAG, SELFMAG) != 0 ||
+      elf_header.e_ident[EI_CLASS] != ELFCLASS64 ||
+      elf_header.e_phentsize != sizeof(Elf64_Phdr) ||
+      elf_header.e_shentsize != sizeof(Elf64_Shdr)) {
+    return offsets;
+  }
+
+  // The symbols have virtual addresses, which the loadable segments map to
+  // offsets in the file.
+  std::vector<Elf64_Phdr> load_segments;
+  for (uint16_t i = 0; i < elf_header.e_phnum; ++i) {
+    Elf64_Phdr program_header;
+    file.seekg(elf_header.e_phoff + i * sizeof(program_header));
+    if (!file.read(reinterpret_cast<char*>(&program_header),
+                   sizeof(program_header))) {
+      return offsets;
+    }
+    if (program_header.p_type == PT_LOAD) {
+      load_segments.push_back(program_header);
+    }
+  }
+
+  std::vector<Elf64_Shdr> section_headers(elf_header.e_shnum);
+  file.seekg(elf_header.e_shoff);
+  if (!file.read(reinterpret_cast<char*>(section_headers.data()),
+                 section_headers.size() * sizeof(Elf64_Shdr))) {
+    return offsets;
+  }
+  auto read_section = [&file](const Elf64_Shdr& section_header,
+                              std::string* data) {
+    data->resize(section_header.sh_size);
+    file.seekg(section_header.sh_offset);
+    return static_cast<bool>(file.read(data->data(), data->size()));
+  };
+
+  for (const Elf64_Shdr& section_header : section_headers) {
+    if ((section_header.sh_type != SHT_SYMTAB &&
+         section_header.sh_type != SHT_DYNSYM) ||
+        section_header.sh_entsize != sizeof(Elf64_Sym) ||
+        section_header.sh_link >= section_headers.size()) {
+      continue;
+    }
+    std::string symbols;
+    std::string names_data;
+    if (!read_section(section_header, &symbols) ||
+        !read_section(section_headers[section_header.sh_link], &names_data)) {
+      continue;
+    }
+    for (size_t offset = 0; offset + sizeof(Elf64_Sym) <= symbols.size();
+         offset += sizeof(Elf64_Sym)) {
+      Elf64_Sym symbol;
+      memcpy(&symbol, symbols.data() + offset, sizeof(symbol));
+      if (ELF64_ST_TYPE(symbol.st_info) != STT_FUNC ||
+          symbol.st_shndx == SHN_UNDEF || symbol.st_value == 0 ||
+          symbol.st_name >= names_data.size()) {
+        continue;
+      }
+      std::string name{names_data.c_str() + symbol.st_name};
+      if (offsets.contains(name) ||
+          std::find(names.begin(), names.end(), name) == names.end()) {
+        continue;
+      }
+      for (const Elf64_Phdr& segment : load_segments) {
+        if (symbol.st_value >= segment.p_vaddr &&
+            symbol.st_value < segment.p_vaddr + segment.p_filesz) {
+          offsets.emplace(std::move(name), symbol.st_value -
+                                               segment.p_vaddr +
+                                               segment.p_offset);
+          break;
+        }
+      }
+    }
+  }
+  return offsets;
+}
+
 }  // namespace LinuxTracing
 
 #endif  // ORBIT_LINUX_TRACING_UTILS_H_
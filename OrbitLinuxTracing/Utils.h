@@ -4,7 +4,12 @@
 #include <OrbitBase/Logging.h>
 #include <unistd.h>
 
+#include <functional>
 #include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
 
 namespace LinuxTracing {
 
@@ -31,6 +36,19 @@ std::vector<int> ParseCpusetCpus(const std::string& cpuset_cpus_content);
 
 std::vector<int> GetCpusetCpus(pid_t pid);
 
+// Parses the content of a cgroup.procs file, one pid per line.
+std::vector<pid_t> ParseCgroupProcs(const std::string& cgroup_procs_content);
+
+// The processes of a cgroup, from the cgroup.procs file of its directory,
+// e.g., "/sys/fs/cgroup/pids/services". Empty if the file can't be read.
+std::vector<pid_t> ListCgroupProcesses(const std::string& cgroup_path);
+
+// Calls work(index) for every index in [0, count), on up to max_threads
+// threads including the calling one, and returns once all calls are done.
+// Meant for syscalls that mostly wait on the kernel, like perf_event_open.
+void RunInParallel(size_t count, size_t max_threads,
+                   const std::function<void(size_t)>& work);
+
 #if defined(__x86_64__)
 
 #define READ_ONCE(x) (*(volatile typeof(x)*)&x)
@@ -52,12 +70,42 @@ std::vector<int> GetCpusetCpus(pid_t pid);
 
 #endif
 
+// The cpus of each online NUMA node, by node, from /sys/devices/system/node.
+// Empty if the kernel exposes no NUMA node.
+absl::flat_hash_map<int, std::vector<int>> GetNumaNodeCpus();
+
+// Restricts the calling thread to cpus. As with SetCurrentThreadScheduling,
+// the threads it creates afterwards inherit this.
+bool SetCurrentThreadAffinity(const std::vector<int>& cpus);
+
+// Sets the scheduling policy of the calling thread among SCHED_OTHER,
+// SCHED_BATCH and SCHED_IDLE, with nice from -20 to 19, ignored with
+// SCHED_IDLE. Raising the priority needs CAP_SYS_NICE.
+bool SetCurrentThreadScheduling(int policy, int nice);
+
+// The number of TSC ticks per tick of the crystal clock (CTC), which times the
+// MTC packets of Intel Processor Trace, from CPUID leaf 0x15. nullopt if the
+// processor doesn't report it, e.g. before Skylake.
+std::optional<double> GetTscCtcRatio();
+
 // Looks up the tracepoint id for the given category (example: "sched")
 // and name (example: "sched_waking"). Returns the tracepoint id or
 // -1 in case of any errors.
 int GetTracepointId(const char* tracepoint_category,
                     const char* tracepoint_name);
 
+// The GNU build id of a 64-bit ELF file, in hexadecimal, from its
+// NT_GNU_BUILD_ID note. Returns an empty string if the file can't be read or
+// has no build id.
+std::string ReadElfBuildId(const std::string& path);
+
+// The file offsets, where uprobes are opened, of the functions among names
+// that a 64-bit ELF file defines in its .symtab or .dynsym section. The
+// functions it doesn't define, or all of them if the file can't be read, are
+// missing from the result.
+absl::flat_hash_map<std::string, uint64_t> ReadElfFunctionOffsets(
+    const std::string& path, const std::vector<std::string>& names);
+
 }  // namespace LinuxTracing
 
 #endif  // ORBIT_LINUX_TRACING_UTILS_H_
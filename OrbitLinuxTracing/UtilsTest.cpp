@@ -1,12 +1,24 @@
 #include <gmock/gmock-matchers.h>
+#include <elf.h>
 #include <gtest/gtest.h>
 #include <sys/syscall.h>
 
+#include <atomic>
 #include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <string>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 #include "Utils.h"
+#include "absl/strings/str_split.h"
+
+extern "C" __attribute__((noinline)) int ReadElfFunctionOffsetsTestFunction(
+    int value) {
+  return value + 1;
+}
 
 namespace LinuxTracing {
 
@@ -113,4 +125,114 @@ TEST(ParseCpusetCpus, SingleValuesAndRanges) {
   EXPECT_THAT(returned_cpus, ::testing::ElementsAre(0, 1, 2, 4, 7, 12, 13, 14));
 }
 
+TEST(ParseCgroupProcs, OnePidPerLine) {
+  EXPECT_TRUE(ParseCgroupProcs("").empty());
+  EXPECT_THAT(ParseCgroupProcs("1\n42\n\n31337\n"),
+              ::testing::ElementsAre(1, 42, 31337));
+}
+
+TEST(ListCgroupProcesses, ReadsCgroupProcs) {
+  std::string cgroup_path = testing::TempDir();
+  std::string cgroup_procs_path = cgroup_path + "/cgroup.procs";
+  std::FILE* file = std::fopen(cgroup_procs_path.c_str(), "w");
+  ASSERT_NE(file, nullptr);
+  std::fputs("100\n200\n", file);
+  std::fclose(file);
+  EXPECT_THAT(ListCgroupProcesses(cgroup_path),
+              ::testing::ElementsAre(100, 200));
+  std::remove(cgroup_procs_path.c_str());
+
+  EXPECT_TRUE(ListCgroupProcesses("/nonexistent/cgroup").empty());
+}
+
+TEST(RunInParallel, CallsWorkOnceForEachIndex) {
+  std::vector<std::atomic<int>> calls(100);
+  RunInParallel(calls.size(), 8, [&calls](size_t index) { ++calls[index]; });
+  for (const std::atomic<int>& count : calls) {
+    EXPECT_EQ(count, 1);
+  }
+
+  bool called = false;
+  RunInParallel(0, 8, [&called](size_t) { called = true; });
+  EXPECT_FALSE(called);
+  RunInParallel(1, 0, [&called](size_t) { called = true; });
+  EXPECT_TRUE(called);
+}
+
+TEST(ReadElfBuildId, FindsTheBuildIdNote) {
+  // An ELF header, a single PT_NOTE program header, and the notes: one that is
+  // not a build id, then the build id.
+  const uint8_t build_id[] = {0xde, 0xad, 0xbe, 0xef, 0x01};
+  Elf64_Ehdr elf_header{};
+  memcpy(elf_header.e_ident, ELFMAG, SELFMAG);
+  elf_header.e_ident[EI_CLASS] = ELFCLASS64;
+  elf_header.e_phoff = sizeof(elf_header);
+  elf_header.e_phentsize = sizeof(Elf64_Phdr);
+  elf_header.e_phnum = 1;
+
+  std::string notes;
+  auto add_note = [&notes](uint32_t type, const void* desc, uint32_t size) {
+    Elf64_Nhdr note_header{sizeof(ELF_NOTE_GNU), size, type};
+    notes.append(reinterpret_cast<const char*>(&note_header),
+                 sizeof(note_header));
+    notes.append(ELF_NOTE_GNU, sizeof(ELF_NOTE_GNU));
+    notes.append(static_cast<const char*>(desc), size);
+    notes.append((4 - size % 4) % 4, '\0');
+  };
+  uint32_t abi_tag[] = {0, 3, 2, 0};
+  add_note(NT_GNU_ABI_TAG, abi_tag, sizeof(abi_tag));
+  add_note(NT_GNU_BUILD_ID, build_id, sizeof(build_id));
+
+  Elf64_Phdr program_header{};
+  program_header.p_type = PT_NOTE;
+  program_header.p_offset = sizeof(elf_header) + sizeof(program_header);
+  program_header.p_filesz = notes.size();
+
+  std::string path = testing::TempDir() + "read_elf_build_id_test";
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+  std::fwrite(&elf_header, sizeof(elf_header), 1, file);
+  std::fwrite(&program_header, sizeof(program_header), 1, file);
+  std::fwrite(notes.data(), notes.size(), 1, file);
+  std::fclose(file);
+
+  EXPECT_EQ(ReadElfBuildId(path), "deadbeef01");
+  std::remove(path.c_str());
+
+  EXPECT_EQ(ReadElfBuildId("/proc/self/maps"), "");
+  EXPECT_EQ(ReadElfBuildId("/does/not/exist"), "");
+}
+
+TEST(ReadElfFunctionOffsets, FindsAFunctionOfThisBinary) {
+  // The offset in the file is where the function is mapped from.
+  auto address =
+      reinterpret_cast<uint64_t>(&ReadElfFunctionOffsetsTestFunction);
+  std::string path;
+  uint64_t expected_offset = 0;
+  std::vector<std::string> lines = absl::StrSplit(ReadMaps(getpid()), '\n');
+  for (const std::string& line : lines) {
+    uint64_t start;
+    uint64_t end;
+    uint64_t offset;
+    char file_path[4096];
+    if (std::sscanf(line.c_str(), "%lx-%lx %*s %lx %*s %*s %4095s", &start,
+                    &end, &offset, file_path) == 4 &&
+        address >= start && address < end) {
+      path = file_path;
+      expected_offset = address - start + offset;
+      break;
+    }
+  }
+  ASSERT_FALSE(path.empty());
+
+  absl::flat_hash_map<std::string, uint64_t> offsets = ReadElfFunctionOffsets(
+      path, {"ReadElfFunctionOffsetsTestFunction", "NoSuchFunction"});
+  ASSERT_EQ(offsets.size(), 1);
+  EXPECT_EQ(offsets.at("ReadElfFunctionOffsetsTestFunction"),
+            expected_offset);
+
+  EXPECT_TRUE(ReadElfFunctionOffsets("/proc/self/maps", {"main"}).empty());
+  EXPECT_TRUE(ReadElfFunctionOffsets("/does/not/exist", {"main"}).empty());
+}
+
 }  // namespace LinuxTracing
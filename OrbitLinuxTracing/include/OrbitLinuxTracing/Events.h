@@ -3,7 +3,9 @@
 
 #include <unistd.h>
 
+#include <array>
 #include <cstdint>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -38,6 +40,112 @@ class ContextSwitchOut : public ContextSwitch {
       : ContextSwitch(tid, core, timestamp_ns) {}
 };
 
+// The scheduling state of a thread, as reported by the sched:sched_switch,
+// sched:sched_waking and sched:sched_wakeup tracepoints.
+enum class ThreadState : uint8_t {
+  kRunning,
+  // Ready to run, either after a wakeup or because it was preempted, but
+  // waiting for a core.
+  kRunnable,
+  // Blocked, e.g., waiting on a lock, a condition variable, or sleeping.
+  kInterruptibleSleep,
+  // Blocked, usually waiting for I/O.
+  kUninterruptibleSleep,
+  kStopped,
+  kTraced,
+  kDead,
+  kZombie,
+  kParked,
+  kIdle,
+};
+
+class ThreadStateChange {
+ public:
+  ThreadStateChange(pid_t tid, ThreadState state, uint64_t timestamp_ns,
+                    pid_t waker_tid = -1)
+      : tid_(tid),
+        state_(state),
+        timestamp_ns_(timestamp_ns),
+        waker_tid_(waker_tid) {}
+
+  pid_t GetTid() const { return tid_; }
+  ThreadState GetState() const { return state_; }
+  uint64_t GetTimestampNs() const { return timestamp_ns_; }
+  // For a change to kRunnable caused by a wakeup, the thread that woke this
+  // one up, otherwise -1.
+  pid_t GetWakerTid() const { return waker_tid_; }
+
+ private:
+  pid_t tid_;
+  ThreadState state_;
+  uint64_t timestamp_ns_;
+  pid_t waker_tid_;
+};
+
+// The name of a thread of a target process from timestamp_ns on: when the
+// tracing started, when the thread was spawned with the name of its parent,
+// or when it was renamed.
+class ThreadName {
+ public:
+  ThreadName(pid_t pid, pid_t tid, std::string name, uint64_t timestamp_ns)
+      : pid_(pid),
+        tid_(tid),
+        name_(std::move(name)),
+        timestamp_ns_(timestamp_ns) {}
+
+  pid_t GetPid() const { return pid_; }
+  pid_t GetTid() const { return tid_; }
+  const std::string& GetName() const { return name_; }
+  uint64_t GetTimestampNs() const { return timestamp_ns_; }
+
+ private:
+  pid_t pid_;
+  pid_t tid_;
+  std::string name_;
+  uint64_t timestamp_ns_;
+};
+
+// The file I/O syscalls traced with Tracer::SetTraceFileIo.
+enum class FileIoSyscall : uint8_t {
+  kRead,
+  kWrite,
+  kPread,
+  kPwrite,
+  kFsync,
+  kOpenat,
+};
+
+// A file I/O syscall of a thread of a target process, from its entry to its
+// exit. The file descriptor is the one opened for kOpenat, and -1 if openat
+// failed. The result is the return value of the syscall: the bytes
+// transferred for reads and writes, or the negated errno on failure.
+class FileIo {
+ public:
+  FileIo(pid_t tid, FileIoSyscall syscall, int32_t fd, int64_t result,
+         uint64_t begin_timestamp_ns, uint64_t end_timestamp_ns)
+      : tid_(tid),
+        syscall_(syscall),
+        fd_(fd),
+        result_(result),
+        begin_timestamp_ns_(begin_timestamp_ns),
+        end_timestamp_ns_(end_timestamp_ns) {}
+
+  pid_t GetTid() const { return tid_; }
+  FileIoSyscall GetSyscall() const { return syscall_; }
+  int32_t GetFd() const { return fd_; }
+  int64_t GetResult() const { return result_; }
+  uint64_t GetBeginTimestampNs() const { return begin_timestamp_ns_; }
+  uint64_t GetEndTimestampNs() const { return end_timestamp_ns_; }
+
+ private:
+  pid_t tid_;
+  FileIoSyscall syscall_;
+  int32_t fd_;
+  int64_t result_;
+  uint64_t begin_timestamp_ns_;
+  uint64_t end_timestamp_ns_;
+};
+
 class CallstackFrame {
  public:
   CallstackFrame(uint64_t pc, std::string function_name,
@@ -75,15 +183,204 @@ class Callstack {
   uint64_t timestamp_ns_;
 };
 
+// The callstack of a thread when it blocked and was switched out of its core,
+// with the time at which it was switched in again, see
+// Tracer::SetTraceOffCpuCallstacks. The timestamp of the callstack is when the
+// thread was switched out.
+class OffCpuCallstack {
+ public:
+  OffCpuCallstack(Callstack callstack, uint64_t end_timestamp_ns)
+      : callstack_(std::move(callstack)), end_timestamp_ns_(end_timestamp_ns) {}
+
+  const Callstack& GetCallstack() const { return callstack_; }
+  uint64_t GetBeginTimestampNs() const { return callstack_.GetTimestampNs(); }
+  uint64_t GetEndTimestampNs() const { return end_timestamp_ns_; }
+
+ private:
+  Callstack callstack_;
+  uint64_t end_timestamp_ns_;
+};
+
+// A page fault of a thread of a target process sampled by
+// Tracer::SetPageFaultSamplingPeriod, with the callstack of the access that
+// faulted. Major faults needed I/O to bring the page in, minor ones didn't.
+class PageFault {
+ public:
+  PageFault(Callstack callstack, bool major)
+      : callstack_(std::move(callstack)), major_(major) {}
+
+  const Callstack& GetCallstack() const { return callstack_; }
+  pid_t GetTid() const { return callstack_.GetTid(); }
+  uint64_t GetTimestampNs() const { return callstack_.GetTimestampNs(); }
+  bool IsMajor() const { return major_; }
+
+ private:
+  Callstack callstack_;
+  bool major_;
+};
+
+// An allocation of a thread of a target process sampled by
+// Tracer::SetHeapSamplingInterval, with the callstack of the call to the
+// allocator: the timestamp of the callstack is when the call returned. The
+// callstack has no frames if its stack was lost. The size is the size
+// requested, not the one the allocator reserved.
+class HeapAllocation {
+ public:
+  HeapAllocation(Callstack callstack, uint64_t address, uint64_t size)
+      : callstack_(std::move(callstack)), address_(address), size_(size) {}
+
+  const Callstack& GetCallstack() const { return callstack_; }
+  pid_t GetTid() const { return callstack_.GetTid(); }
+  uint64_t GetTimestampNs() const { return callstack_.GetTimestampNs(); }
+  uint64_t GetAddress() const { return address_; }
+  uint64_t GetSize() const { return size_; }
+
+ private:
+  Callstack callstack_;
+  uint64_t address_;
+  uint64_t size_;
+};
+
+// The free, or the realloc, of the block of a HeapAllocation, by any thread of
+// its process. The frees of blocks that were not sampled are not reported.
+class HeapFree {
+ public:
+  HeapFree(pid_t tid, uint64_t timestamp_ns, uint64_t address)
+      : tid_(tid), timestamp_ns_(timestamp_ns), address_(address) {}
+
+  pid_t GetTid() const { return tid_; }
+  uint64_t GetTimestampNs() const { return timestamp_ns_; }
+  uint64_t GetAddress() const { return address_; }
+
+ private:
+  pid_t tid_;
+  uint64_t timestamp_ns_;
+  uint64_t address_;
+};
+
+// A wait of a thread of a target process on a lock, or any futex, at least as
+// long as Tracer::SetLockWaitThresholdNs, with the callstack of the thread
+// when the wait ended: the timestamp of the callstack is the end of the wait.
+// The callstack has no frames if its stack was lost. The lock address is the
+// address of the futex word, e.g., of the pthread_mutex_t.
+class LockWait {
+ public:
+  LockWait(Callstack callstack, uint64_t begin_timestamp_ns,
+           uint64_t lock_address)
+      : callstack_(std::move(callstack)),
+        begin_timestamp_ns_(begin_timestamp_ns),
+        lock_address_(lock_address) {}
+
+  const Callstack& GetCallstack() const { return callstack_; }
+  pid_t GetTid() const { return callstack_.GetTid(); }
+  uint64_t GetBeginTimestampNs() const { return begin_timestamp_ns_; }
+  uint64_t GetEndTimestampNs() const { return callstack_.GetTimestampNs(); }
+  uint64_t GetLockAddress() const { return lock_address_; }
+
+ private:
+  Callstack callstack_;
+  uint64_t begin_timestamp_ns_;
+  uint64_t lock_address_;
+};
+
+// A callstack sampled count times on a thread between the begin timestamp and
+// the timestamp of the callstack, aggregated in the kernel, see
+// Tracer::SetBpfStackAggregation.
+class CallstackCount {
+ public:
+  CallstackCount(Callstack callstack, uint64_t count,
+                 uint64_t begin_timestamp_ns)
+      : callstack_(std::move(callstack)),
+        count_(count),
+        begin_timestamp_ns_(begin_timestamp_ns) {}
+
+  const Callstack& GetCallstack() const { return callstack_; }
+  uint64_t GetCount() const { return count_; }
+  uint64_t GetBeginTimestampNs() const { return begin_timestamp_ns_; }
+  uint64_t GetEndTimestampNs() const { return callstack_.GetTimestampNs(); }
+
+ private:
+  Callstack callstack_;
+  uint64_t count_;
+  uint64_t begin_timestamp_ns_;
+};
+
+// The branches read from the last branch records (LBR) of the samples of
+// Tracer::SetBranchSampling.
+enum class BranchSampling {
+  kNone = 0,
+  // Only calls, for the counts of the edges from call sites to callees.
+  kCalls,
+  // All taken branches, which also tell the code executed between them.
+  kAllBranches
+};
+
+// The branches taken by the threads of the target between two timestamps, in
+// the last branch records of the samples of Tracer::SetBranchSampling,
+// counted by source and target address. With BranchSampling::kAllBranches,
+// the ranges of code executed straight between two consecutive branches, from
+// the target of the first to the source of the second, are counted as well.
+// These counts are statistical: each is proportional to how often the branch,
+// or range, was executed.
+class BranchCounts {
+ public:
+  struct Count {
+    uint64_t from;
+    uint64_t to;
+    uint64_t count;
+  };
+
+  BranchCounts(uint64_t begin_timestamp_ns, uint64_t end_timestamp_ns)
+      : begin_timestamp_ns_(begin_timestamp_ns),
+        end_timestamp_ns_(end_timestamp_ns) {}
+
+  void AddBranch(uint64_t from, uint64_t to, uint64_t count) {
+    branches_.push_back({from, to, count});
+  }
+  void AddRange(uint64_t first, uint64_t last, uint64_t count) {
+    ranges_.push_back({first, last, count});
+  }
+
+  uint64_t GetBeginTimestampNs() const { return begin_timestamp_ns_; }
+  uint64_t GetEndTimestampNs() const { return end_timestamp_ns_; }
+  const std::vector<Count>& GetBranches() const { return branches_; }
+  // From the first address of the range to the source of the branch ending
+  // it, both included.
+  const std::vector<Count>& GetRanges() const { return ranges_; }
+
+ private:
+  uint64_t begin_timestamp_ns_;
+  uint64_t end_timestamp_ns_;
+  std::vector<Count> branches_;
+  std::vector<Count> ranges_;
+};
+
+// The hardware performance counters that can be recorded for the calls to
+// instrumented functions, see Tracer::SetPmuCounters.
+enum class PmuCounter {
+  kCycles = 0,
+  kInstructions,
+  kLlcMisses,
+  kBranchMisses
+};
+constexpr size_t kNumPmuCounters = 4;
+// Indexed by PmuCounter. The counters that were not recorded are zero.
+using PmuCounterValues = std::array<uint64_t, kNumPmuCounters>;
+
 class FunctionCall {
  public:
   FunctionCall(pid_t tid, uint64_t virtual_address, uint64_t begin_timestamp_ns,
-               uint64_t end_timestamp_ns, uint32_t depth)
+               uint64_t end_timestamp_ns, uint32_t depth,
+               uint64_t return_value = 0, std::vector<uint64_t> arguments = {},
+               std::optional<PmuCounterValues> pmu_counters = std::nullopt)
       : tid_(tid),
         virtual_address_(virtual_address),
         begin_timestamp_ns_(begin_timestamp_ns),
         end_timestamp_ns_(end_timestamp_ns),
-        depth_{depth} {}
+        depth_{depth},
+        return_value_{return_value},
+        arguments_{std::move(arguments)},
+        pmu_counters_{pmu_counters} {}
 
   pid_t GetTid() const { return tid_; }
   uint64_t GetVirtualAddress() const { return virtual_address_; }
@@ -91,12 +388,29 @@ class FunctionCall {
   uint64_t GetEndTimestampNs() const { return end_timestamp_ns_; }
   uint32_t GetDepth() const { return depth_; }
 
+  // The content of rax on return.
+  uint64_t GetReturnValue() const { return return_value_; }
+
+  // The integer arguments (rdi, rsi, rdx, rcx, r8, r9) on entry, only recorded
+  // for functions with Function::RecordingMode::kTimingAndArguments.
+  const std::vector<uint64_t>& GetArguments() const { return arguments_; }
+
+  // The counts of the hardware performance counters of the thread during the
+  // call, including the functions it called, only recorded for functions with
+  // Function::RecordingMode::kTimingAndPmuCounters.
+  const std::optional<PmuCounterValues>& GetPmuCounters() const {
+    return pmu_counters_;
+  }
+
  private:
   pid_t tid_;
   uint64_t virtual_address_;
   uint64_t begin_timestamp_ns_;
   uint64_t end_timestamp_ns_;
   uint32_t depth_;
+  uint64_t return_value_;
+  std::vector<uint64_t> arguments_;
+  std::optional<PmuCounterValues> pmu_counters_;
 };
 
 class GpuJob {
@@ -161,6 +475,54 @@ class GpuJob {
   uint64_t dma_fence_signaled_time_ns_;
 };
 
+// Statistics of the stages of the tracer over a window of time, e.g., events
+// per second or the latency of their delivery, each a named value.
+class TracerStats {
+ public:
+  TracerStats(uint64_t begin_timestamp_ns, uint64_t end_timestamp_ns)
+      : begin_timestamp_ns_(begin_timestamp_ns),
+        end_timestamp_ns_(end_timestamp_ns) {}
+
+  void AddValue(std::string name, double value) {
+    values_.emplace_back(std::move(name), value);
+  }
+
+  uint64_t GetBeginTimestampNs() const { return begin_timestamp_ns_; }
+  uint64_t GetEndTimestampNs() const { return end_timestamp_ns_; }
+  const std::vector<std::pair<std::string, double>>& GetValues() const {
+    return values_;
+  }
+
+ private:
+  uint64_t begin_timestamp_ns_;
+  uint64_t end_timestamp_ns_;
+  std::vector<std::pair<std::string, double>> values_;
+};
+
+// The time that each process spent on the cores in a window of time, summed
+// over its threads and the cores. Only the processes that ran are listed.
+class ProcessCpuTimes {
+ public:
+  ProcessCpuTimes(uint64_t begin_timestamp_ns, uint64_t end_timestamp_ns)
+      : begin_timestamp_ns_(begin_timestamp_ns),
+        end_timestamp_ns_(end_timestamp_ns) {}
+
+  void AddProcess(pid_t pid, uint64_t cpu_time_ns) {
+    cpu_times_ns_.emplace_back(pid, cpu_time_ns);
+  }
+
+  uint64_t GetBeginTimestampNs() const { return begin_timestamp_ns_; }
+  uint64_t GetEndTimestampNs() const { return end_timestamp_ns_; }
+  const std::vector<std::pair<pid_t, uint64_t>>& GetCpuTimesNs() const {
+    return cpu_times_ns_;
+  }
+
+ private:
+  uint64_t begin_timestamp_ns_;
+  uint64_t end_timestamp_ns_;
+  std::vector<std::pair<pid_t, uint64_t>> cpu_times_ns_;
+};
+
 }  // namespace LinuxTracing
 
 #endif  // ORBIT_LINUX_TRACING_EVENTS_H_
@@ -7,11 +7,28 @@
 namespace LinuxTracing {
 class Function {
  public:
+  // What is recorded on every call, besides its begin and end timestamps and
+  // its return value. Collecting the callstack requires copying the stack at
+  // each function entry, which is by far the most expensive part of the
+  // instrumentation, so it can be skipped for functions whose callstacks we
+  // are not interested in. Note that without callstacks at entry, stack
+  // samples that fall inside such a function cannot be unwound past it.
+  // kTimingAndPmuCounters also records the hardware performance counters
+  // selected with Tracer::SetPmuCounters at entry and exit, without callstack.
+  enum class RecordingMode {
+    kTimingAndCallstack,
+    kTimingOnly,
+    kTimingAndArguments,
+    kTimingAndPmuCounters
+  };
+
   Function(std::string binary_path, uint64_t file_offset,
-           uint64_t virtual_address)
+           uint64_t virtual_address,
+           RecordingMode recording_mode = RecordingMode::kTimingAndCallstack)
       : binary_path_{std::move(binary_path)},
         file_offset_{file_offset},
-        virtual_address_{virtual_address} {}
+        virtual_address_{virtual_address},
+        recording_mode_{recording_mode} {}
 
   const std::string& BinaryPath() const { return binary_path_; }
 
@@ -19,10 +36,13 @@ class Function {
 
   uint64_t VirtualAddress() const { return virtual_address_; }
 
+  RecordingMode GetRecordingMode() const { return recording_mode_; }
+
  private:
   std::string binary_path_;
   uint64_t file_offset_;
   uint64_t virtual_address_;
+  RecordingMode recording_mode_;
 };
 }  // namespace LinuxTracing
 
@@ -10,17 +10,61 @@
 #include <functional>
 #include <memory>
 #include <optional>
+#include <string>
 #include <thread>
 #include <vector>
 
 namespace LinuxTracing {
 
+class InstrumentationRequests;
+
+// Where and how the threads of a capture run (see Tracer::SetThreadPlacement),
+// so that they compete less with the threads of the target and perturb the
+// measurement less.
+struct ThreadPlacement {
+  enum class Policy { kDefault, kBatch, kIdle };
+
+  // The cpus the threads run on, any if empty.
+  std::vector<int> cpus;
+  // SCHED_OTHER, SCHED_BATCH or SCHED_IDLE.
+  Policy policy = Policy::kDefault;
+  // From -20 to 19, ignored with kIdle.
+  int nice = 0;
+  // On machines with several NUMA nodes, the ring buffers of the cores of
+  // different nodes are read by different reader threads, each running on
+  // the cpus of its node, so that neither the ring buffers, which the kernel
+  // allocates on the node of their core, nor what the reader allocates are
+  // accessed across nodes.
+  bool numa_local_readers = false;
+};
+
+// The threads whose stacks are sampled (see Tracer::SetSampledThreads), e.g.,
+// the few threads of interest of a server running thousands of them.
+struct ThreadSelection {
+  // Sampled whatever their name.
+  std::vector<pid_t> tids;
+  // Shell wildcard patterns, e.g., "Render*": the threads are sampled while
+  // their name matches one of them, including the threads spawned or renamed
+  // during the capture.
+  std::vector<std::string> name_patterns;
+
+  bool IsEmpty() const { return tids.empty() && name_patterns.empty(); }
+};
+
 class Tracer {
  public:
   static constexpr double DEFAULT_SAMPLING_FREQUENCY = 1000.0;
 
   Tracer(pid_t pid, double sampling_frequency,
          std::vector<Function> instrumented_functions);
+  // Traces several processes in a single capture, e.g., the processes of a
+  // cgroup (see ListCgroupProcesses), sharing the per-core ring buffers. The
+  // events of each process are unwound with its own memory maps. The set of
+  // processes is fixed at Start: processes they spawn later are not traced.
+  // The uprobes of the instrumented functions are set on their binaries, so
+  // their calls are reported for all the processes that map these binaries.
+  Tracer(std::vector<pid_t> pids, double sampling_frequency,
+         std::vector<Function> instrumented_functions);
 
   ~Tracer() { Stop(); }
 
@@ -29,6 +73,10 @@ class Tracer {
   Tracer(Tracer&&) = default;
   Tracer& operator=(Tracer&&) = default;
 
+  // The processes in cgroup_path, e.g.,
+  // "/sys/fs/cgroup/system.slice/foo.service". Empty on error.
+  static std::vector<pid_t> ListCgroupProcesses(const std::string& cgroup_path);
+
   void SetListener(TracerListener* listener) { listener_ = listener; }
 
   void SetTraceContextSwitches(bool trace_context_switches) {
@@ -43,19 +91,306 @@ class Tracer {
     trace_instrumented_functions_ = trace_instrumented_functions;
   }
 
+  // Instruments a function, or stops instrumenting it, while the capture is
+  // running, without reopening the other perf_event_open file descriptors.
+  // Functions are identified by their virtual address. The u(ret)probes of the
+  // functions instrumented during the capture use the ring buffers of the ones
+  // instrumented from the beginning, so at least one function must have been
+  // passed to the constructor. Calls in progress when a function is removed
+  // are never reported as completed.
+  void AddInstrumentedFunction(Function function);
+  void RemoveInstrumentedFunction(Function function);
+
+  // Traces the calls of the threads of the target to function, of
+  // function_size bytes, for the next duration_ns of the capture with Intel
+  // Processor Trace, filtered to the code of the function. The trace is
+  // decoded once the window ends, in parallel for each thread, and the calls
+  // are then reported to TracerListener::OnFunctionCall like the ones of
+  // instrumented functions, without the cost of the uprobes and with the
+  // precision of the MTC packets, a few hundred nanoseconds. One window at a
+  // time. Needs a processor with Intel PT reporting the frequency of its
+  // crystal clock, i.e. Skylake or later, which most virtual machines don't
+  // expose. The threads spawned during the window are not traced.
+  void TraceWithIntelPt(Function function, uint64_t function_size,
+                        uint64_t duration_ns);
+
+  // By default, a single thread polls all perf_event_open ring buffers in
+  // round-robin. With a positive cpus_per_reader_thread, one reader thread is
+  // created for every group of cpus_per_reader_thread cores instead, and each
+  // of them only polls the ring buffers of its own cores (e.g., pass 1 for one
+  // reader thread per core). This helps on machines with many cores, where a
+  // single thread can't keep up and events are lost.
+  void SetCpusPerReaderThread(uint32_t cpus_per_reader_thread) {
+    cpus_per_reader_thread_ = cpus_per_reader_thread;
+  }
+
+  // The tracing thread applies thread_placement to itself before it creates
+  // the reader, processing and unwinding threads, which inherit it.
+  void SetThreadPlacement(ThreadPlacement thread_placement) {
+    thread_placement_ = std::move(thread_placement);
+  }
+
+  // Applies the cpus, policy and nice value of thread_placement to the
+  // calling thread, e.g. to the thread sending the events of the capture.
+  // Returns false if any of them fails.
+  static bool PlaceCurrentThread(const ThreadPlacement& thread_placement);
+
+  // By default, stack samples and the stacks collected at uprobes are unwound
+  // by the thread processing the sorted events. With a positive
+  // unwinding_thread_count, the unwinding is distributed, by thread id, among
+  // this number of worker threads instead. Callstacks are still reported in
+  // the order of their timestamps.
+  void SetUnwindingThreadCount(uint32_t unwinding_thread_count) {
+    unwinding_thread_count_ = unwinding_thread_count;
+  }
+
+  // By default, the perf_event_open ring buffers have fixed sizes, for each
+  // core and type of event. With a positive ring_buffers_memory_budget_kb,
+  // these sizes are reduced as needed so that all ring buffers fit in the
+  // budget, and ring buffers that lose events are doubled in size during the
+  // capture while the budget allows. When a sampling ring buffer keeps losing
+  // events and can't grow, the sampling frequency on that core is lowered.
+  void SetRingBuffersMemoryBudgetKb(uint64_t ring_buffers_memory_budget_kb) {
+    ring_buffers_memory_budget_kb_ = ring_buffers_memory_budget_kb;
+  }
+
+  // For targets built with -fno-omit-frame-pointer, callstacks can be unwound
+  // by simply following the frame pointers in the stack dumps, which is much
+  // cheaper than the default DWARF unwinding and allows higher sampling
+  // frequencies. DWARF unwinding is still used for the callstacks whose chain
+  // of frame pointers goes through code outside of executable mappings or
+  // leaves the stack dump, e.g., because of libraries built without frame
+  // pointers.
+  void SetUnwindWithFramePointers(bool unwind_with_frame_pointers) {
+    unwind_with_frame_pointers_ = unwind_with_frame_pointers;
+  }
+
+  // By default, stack samples copy the user-space stack, which is then unwound
+  // in user space. With sample_callchains, the callchain of each sample,
+  // including kernel frames, is collected by the kernel by following frame
+  // pointers instead (PERF_SAMPLE_CALLCHAIN), and reported as it is. This needs
+  // a fraction of the bandwidth, but callstacks are only correct for targets
+  // built with -fno-omit-frame-pointer, and are not repaired when they go
+  // through functions instrumented with uretprobes.
+  void SetSampleCallchains(bool sample_callchains) {
+    sample_callchains_ = sample_callchains;
+  }
+
+  // With a non-empty sampled_threads, only the threads it selects are
+  // sampled, instead of all the threads of the target. An eBPF program
+  // attached to the sampling events drops the samples of the other threads in
+  // the kernel, before their stack is copied, so they cost neither bandwidth
+  // nor unwinding. Without CAP_SYS_ADMIN, or on kernels older than 4.9, these
+  // samples are still copied but dropped as soon as they are read. Not
+  // applied with SetBpfStackAggregation, whose program counts the samples of
+  // all the threads.
+  void SetSampledThreads(ThreadSelection sampled_threads) {
+    sampled_threads_ = std::move(sampled_threads);
+  }
+
+  // With bpf_stack_aggregation, the callchains of the stack samples are
+  // collected by following frame pointers, like with sample_callchains, but
+  // by an eBPF program attached to the sampling events, which counts them per
+  // thread and callstack in the kernel instead of writing each sample to a
+  // ring buffer. The counts are reported every half second, with
+  // TracerListener::OnCallstackCounts, which makes sampling almost free of
+  // bandwidth, e.g. for continuous profiling. Like with sample_callchains,
+  // callstacks are only correct for targets built with
+  // -fno-omit-frame-pointer. If the program can't be loaded, e.g., on kernels
+  // older than 4.9, the samples go through the ring buffers as usual. The
+  // counts are not written to the file of SetRecordFilePath.
+  void SetBpfStackAggregation(bool bpf_stack_aggregation) {
+    bpf_stack_aggregation_ = bpf_stack_aggregation;
+  }
+
+  // With bpf_function_calls, the uprobes and uretprobes of the functions
+  // recorded with Function::RecordingMode::kTimingOnly are paired in the
+  // kernel by eBPF programs, which write a single record per call instead of
+  // one per u(ret)probe, with the same FunctionCall reported. As these calls
+  // are unknown to the unwinding, the callstacks sampled inside the functions
+  // stop at the innermost of them. If the programs can't be loaded,
+  // e.g., on kernels older than 4.9, the functions are recorded as usual.
+  void SetBpfFunctionCalls(bool bpf_function_calls) {
+    bpf_function_calls_ = bpf_function_calls;
+  }
+
+  // With trace_thread_states, the scheduling state of every thread of the
+  // target (running, runnable, sleeping, ...) is reported at each change,
+  // together with the thread that woke it up, using the sched tracepoints.
+  // This is what tells why a thread is not running, e.g., to compute how long
+  // threads wait to be scheduled after being woken up.
+  void SetTraceThreadStates(bool trace_thread_states) {
+    trace_thread_states_ = trace_thread_states;
+  }
+
+  // Context switches are recorded on all cores, for all processes. With
+  // trace_system_wide_scheduling (the default), the context switches of all
+  // processes are reported, and the time each process spends on the cores is
+  // also reported periodically (see TracerListener::OnProcessCpuTimes), which
+  // shows the interference of other processes with the target. Without it,
+  // the context switches of other processes are dropped as soon as they are
+  // read. Samples are only reported for the target, whose memory maps are
+  // needed to unwind them, in both cases.
+  void SetTraceSystemWideScheduling(bool trace_system_wide_scheduling) {
+    trace_system_wide_scheduling_ = trace_system_wide_scheduling;
+  }
+
+  // With non-empty pmu_counters, these hardware performance counters are
+  // opened as a group on each core, and read when the functions with
+  // Function::RecordingMode::kTimingAndPmuCounters are entered and return,
+  // and when threads are switched out. Their counts are then reported per
+  // call, excluding the other threads that ran on the core in the meantime,
+  // in FunctionCall::GetPmuCounters. If the PMU can't schedule the group,
+  // these functions are recorded like with kTimingOnly.
+  void SetPmuCounters(std::vector<PmuCounter> pmu_counters) {
+    pmu_counters_ = std::move(pmu_counters);
+  }
+
+  // With trace_off_cpu_callstacks, the user stack of the threads of the target
+  // is also collected each time they block and are switched out of a core
+  // (sched:sched_switch with the thread not runnable), and the callstack is
+  // reported with the time the thread stays off the cores, once it is switched
+  // in again (TracerListener::OnOffCpuCallstack). This tells where threads
+  // wait, e.g., on locks or I/O. Like samples, this copies the user stack of
+  // each such thread: it costs as much as sampling at the rate at which the
+  // threads block.
+  void SetTraceOffCpuCallstacks(bool trace_off_cpu_callstacks) {
+    trace_off_cpu_callstacks_ = trace_off_cpu_callstacks;
+  }
+
+  // With trace_gpu_driver_events, the command buffers submitted to AMD GPUs by
+  // all processes are reported as GpuJobs, from the tracepoints of the amdgpu
+  // driver (TracerListener::OnGpuJob).
+  void SetTraceGpuDriverEvents(bool trace_gpu_driver_events) {
+    trace_gpu_driver_events_ = trace_gpu_driver_events;
+  }
+
+  // With trace_gpu_submission_callstacks, and the GPU driver events, the user
+  // stack of the threads of the target is also collected when they submit a
+  // job, and its callstack is reported to
+  // TracerListener::OnGpuSubmissionCallstack. The stacks of the submissions of
+  // all processes are copied by the kernel, but submissions are rare compared
+  // to samples.
+  void SetTraceGpuSubmissionCallstacks(bool trace_gpu_submission_callstacks) {
+    trace_gpu_submission_callstacks_ = trace_gpu_submission_callstacks;
+  }
+
+  // With trace_file_io, the read, write, pread64, pwrite64, fsync and openat
+  // syscalls of the threads of the target are reported with their duration,
+  // file descriptor and result (TracerListener::OnFileIo). eBPF programs on
+  // the syscall tracepoints filter the threads in the kernel and pair the
+  // entries with the exits, so each syscall of the target costs a single
+  // small record, and those of other processes none. This needs
+  // CAP_SYS_ADMIN and a kernel 4.14 or newer, otherwise nothing is reported.
+  void SetTraceFileIo(bool trace_file_io) { trace_file_io_ = trace_file_io; }
+
+  // With a positive page_fault_sampling_period, one in
+  // page_fault_sampling_period minor page faults of the target, and every
+  // major one, are reported with the callstack of the access that faulted
+  // (TracerListener::OnPageFault). Major faults wait for I/O and are rare, so
+  // each is worth its stack. Like samples, each copies the user stack, and
+  // the page faults of all processes are recorded by the kernel.
+  void SetPageFaultSamplingPeriod(uint64_t page_fault_sampling_period) {
+    page_fault_sampling_period_ = page_fault_sampling_period;
+  }
+
+  // With a positive heap_sampling_interval_bytes, the allocations of the
+  // target are sampled every heap_sampling_interval_bytes allocated on
+  // average, like tcmalloc samples them, and reported with the callstack of
+  // the call to the allocator (TracerListener::OnHeapAllocation), as well as
+  // the frees of the sampled blocks (TracerListener::OnHeapFree). eBPF
+  // programs on the uprobes of malloc, calloc, realloc and free count the
+  // bytes and only copy the stacks of the sampled allocations, so operator
+  // new and delete are covered through them. The allocator of a process is
+  // the binary it maps that defines malloc and free, preferring one other
+  // than libc, e.g., a linked-in tcmalloc. As it is usually the libc shared
+  // by all processes, every call to it traps into the kernel, also in other
+  // processes. The uretprobes also hijack the return addresses of the
+  // allocation functions, so stack samples inside them stop there. This
+  // needs CAP_SYS_ADMIN, otherwise nothing is reported.
+  void SetHeapSamplingInterval(uint64_t heap_sampling_interval_bytes) {
+    heap_sampling_interval_bytes_ = heap_sampling_interval_bytes;
+  }
+
+  // With a positive lock_wait_threshold_ns, the futex waits of the threads of
+  // the target lasting at least lock_wait_threshold_ns are reported with the
+  // address of the futex and the callstack of the thread when the wait ended
+  // (TracerListener::OnLockWait). Contended pthread mutexes and rwlocks, and
+  // std::mutex, wait on futexes, and so do condition variables, which the
+  // callstacks tell apart. eBPF programs on the futex syscall tracepoints
+  // pair the entries with the exits and drop the short waits in the kernel,
+  // so uncontended locks cost nothing, and only the long waits copy the user
+  // stack. This needs CAP_SYS_ADMIN and a kernel 4.14 or newer, otherwise
+  // nothing is reported.
+  void SetLockWaitThresholdNs(uint64_t lock_wait_threshold_ns) {
+    lock_wait_threshold_ns_ = lock_wait_threshold_ns;
+  }
+
+  // With branch_sampling, one in period taken branches of user space is
+  // sampled on all cores with the last branch records (LBR) of the core, i.e.
+  // the last 16 or 32 branches it took, filtered to calls with
+  // BranchSampling::kCalls. The records of the target are counted by source
+  // and target as they are read, without copying any stack, and reported
+  // every half second (TracerListener::OnBranchCounts): these counts estimate
+  // how often functions are called from each call site, or how often each
+  // branch and range of code runs, with little overhead even for small hot
+  // functions. Not reported on machines without LBR, e.g. most virtual
+  // machines, nor written to the file of SetRecordFilePath.
+  void SetBranchSampling(BranchSampling branch_sampling, uint64_t period) {
+    branch_sampling_ = branch_sampling;
+    branch_sampling_period_ = period;
+  }
+
+  // With a non-empty record_file_path, the raw perf_event_open records of the
+  // capture are also written to that file, with the ring buffers they come
+  // from, the maps of the target and the build ids of its binaries, so that
+  // the capture can be processed again offline with Replay, e.g., to profile
+  // or debug the processing without the target. This adds a copy of every
+  // record, and the file grows by the bandwidth of the ring buffers.
+  void SetRecordFilePath(std::string record_file_path) {
+    record_file_path_ = std::move(record_file_path);
+  }
+
+  // Processes the records of a file written with SetRecordFilePath on the
+  // calling thread, reporting the events to listener as during the capture.
+  // The callstacks are unwound with the binaries of this machine, which must
+  // be the ones that were profiled. Process CPU times are not reported.
+  // Returns false if the file can't be read or is invalid.
+  static bool Replay(const std::string& record_file_path,
+                     TracerListener* listener, uint32_t unwinding_thread_count,
+                     bool unwind_with_frame_pointers);
+
   void Start() {
     *exit_requested_ = false;
     thread_ = std::make_shared<std::thread>(
-        &Tracer::Run, pid_, sampling_period_ns_, instrumented_functions_,
+        &Tracer::Run, pids_, sampling_period_ns_, instrumented_functions_,
         listener_, trace_context_switches_, trace_callstacks_,
-        trace_instrumented_functions_, exit_requested_);
+        trace_instrumented_functions_, cpus_per_reader_thread_,
+        thread_placement_, unwinding_thread_count_, unwind_with_frame_pointers_,
+        sample_callchains_, bpf_stack_aggregation_, bpf_function_calls_,
+        ring_buffers_memory_budget_kb_,
+        trace_thread_states_, trace_system_wide_scheduling_, pmu_counters_,
+        trace_off_cpu_callstacks_, trace_gpu_driver_events_,
+        trace_gpu_submission_callstacks_, trace_file_io_,
+        page_fault_sampling_period_, heap_sampling_interval_bytes_,
+        lock_wait_threshold_ns_, branch_sampling_, branch_sampling_period_,
+        sampled_threads_, record_file_path_, instrumentation_requests_,
+        exit_requested_);
     thread_->detach();
   }
 
   void Stop() { *exit_requested_ = true; }
 
+  // Opens the per-core perf_event_open file descriptors and ring buffers of a
+  // capture with the current settings in the background, disabled, so that
+  // a Start within the next minute, by this or another Tracer with the same
+  // settings, only has to enable them. Opening them takes most of the time to
+  // start a capture on machines with many cores. What is not used by then is
+  // closed, and a new Prewarm replaces the previous one.
+  void Prewarm();
+
  private:
-  pid_t pid_;
+  std::vector<pid_t> pids_;
   uint64_t sampling_period_ns_;
   std::vector<Function> instrumented_functions_;
 
@@ -64,6 +399,28 @@ class Tracer {
   bool trace_context_switches_ = true;
   bool trace_callstacks_ = true;
   bool trace_instrumented_functions_ = true;
+  uint32_t cpus_per_reader_thread_ = 0;
+  ThreadPlacement thread_placement_;
+  uint32_t unwinding_thread_count_ = 0;
+  bool unwind_with_frame_pointers_ = false;
+  bool sample_callchains_ = false;
+  bool bpf_stack_aggregation_ = false;
+  bool bpf_function_calls_ = false;
+  uint64_t ring_buffers_memory_budget_kb_ = 0;
+  bool trace_thread_states_ = false;
+  bool trace_system_wide_scheduling_ = true;
+  std::vector<PmuCounter> pmu_counters_;
+  bool trace_off_cpu_callstacks_ = false;
+  bool trace_gpu_driver_events_ = false;
+  bool trace_gpu_submission_callstacks_ = false;
+  bool trace_file_io_ = false;
+  uint64_t page_fault_sampling_period_ = 0;
+  uint64_t heap_sampling_interval_bytes_ = 0;
+  uint64_t lock_wait_threshold_ns_ = 0;
+  BranchSampling branch_sampling_ = BranchSampling::kNone;
+  uint64_t branch_sampling_period_ = 0;
+  ThreadSelection sampled_threads_;
+  std::string record_file_path_;
 
   // exit_requested_ must outlive this object because it is used by thread_.
   // The control block of shared_ptr is thread safe (i.e., reference counting
@@ -71,11 +428,34 @@ class Tracer {
   std::shared_ptr<std::atomic<bool>> exit_requested_ =
       std::make_unique<std::atomic<bool>>(true);
   std::shared_ptr<std::thread> thread_;
+  // Also shared with thread_.
+  std::shared_ptr<InstrumentationRequests> instrumentation_requests_;
 
-  static void Run(pid_t pid, uint64_t sampling_period_ns,
+  static void Run(const std::vector<pid_t>& pids, uint64_t sampling_period_ns,
                   const std::vector<Function>& instrumented_functions,
                   TracerListener* listener, bool trace_context_switches,
                   bool trace_callstacks, bool trace_instrumented_functions,
+                  uint32_t cpus_per_reader_thread,
+                  const ThreadPlacement& thread_placement,
+                  uint32_t unwinding_thread_count,
+                  bool unwind_with_frame_pointers, bool sample_callchains,
+                  bool bpf_stack_aggregation, bool bpf_function_calls,
+                  uint64_t ring_buffers_memory_budget_kb,
+                  bool trace_thread_states,
+                  bool trace_system_wide_scheduling,
+                  const std::vector<PmuCounter>& pmu_counters,
+                  bool trace_off_cpu_callstacks,
+                  bool trace_gpu_driver_events,
+                  bool trace_gpu_submission_callstacks, bool trace_file_io,
+                  uint64_t page_fault_sampling_period,
+                  uint64_t heap_sampling_interval_bytes,
+                  uint64_t lock_wait_threshold_ns,
+                  BranchSampling branch_sampling,
+                  uint64_t branch_sampling_period,
+                  const ThreadSelection& sampled_threads,
+                  const std::string& record_file_path,
+                  const std::shared_ptr<InstrumentationRequests>&
+                      instrumentation_requests,
                   const std::shared_ptr<std::atomic<bool>>& exit_requested);
 
   static std::optional<uint64_t> ComputeSamplingPeriodNs(
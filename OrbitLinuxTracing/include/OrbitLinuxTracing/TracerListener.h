@@ -3,6 +3,10 @@
 
 #include <OrbitLinuxTracing/Events.h>
 
+#include <vector>
+
+#include "absl/types/span.h"
+
 namespace LinuxTracing {
 
 class TracerListener {
@@ -15,6 +19,87 @@ class TracerListener {
   virtual void OnCallstack(const Callstack& callstack) = 0;
   virtual void OnFunctionCall(const FunctionCall& function_call) = 0;
   virtual void OnGpuJob(const GpuJob& gpu_job) = 0;
+  virtual void OnThreadStateChange(
+      const ThreadStateChange& thread_state_change) = 0;
+  // Periodically while tracing, from a single thread.
+  virtual void OnTracerStats(const TracerStats& /*tracer_stats*/) {}
+  // Periodically while tracing, from a single thread, with system-wide
+  // scheduling (see Tracer::SetTraceSystemWideScheduling).
+  virtual void OnProcessCpuTimes(
+      const ProcessCpuTimes& /*process_cpu_times*/) {}
+  // With Tracer::SetTraceOffCpuCallstacks, once the thread is switched in
+  // again.
+  virtual void OnOffCpuCallstack(
+      const OffCpuCallstack& /*off_cpu_callstack*/) {}
+  // With Tracer::SetTraceGpuSubmissionCallstacks, the callstack of a thread of
+  // the target when it submitted a GpuJob: the timestamp of the callstack is
+  // the GpuJob::GetAmdgpuCsIoctlTimeNs of the job of the same thread. It can
+  // be reported before or after the job.
+  virtual void OnGpuSubmissionCallstack(const Callstack& /*callstack*/) {}
+  // Only when the name changes: the names of a thread over time are its
+  // ThreadNames in the order of their timestamps, which they can be reported
+  // out of.
+  virtual void OnThreadName(const ThreadName& /*thread_name*/) {}
+  // With Tracer::SetTraceFileIo, once the syscall returned.
+  virtual void OnFileIo(const FileIo& /*file_io*/) {}
+  // With Tracer::SetPageFaultSamplingPeriod.
+  virtual void OnPageFault(const PageFault& /*page_fault*/) {}
+  // With Tracer::SetHeapSamplingInterval, in the order of the allocations and
+  // frees of each process: a block is freed after it was allocated.
+  virtual void OnHeapAllocation(const HeapAllocation& /*heap_allocation*/) {}
+  virtual void OnHeapFree(const HeapFree& /*heap_free*/) {}
+  // With Tracer::SetLockWaitThresholdNs, once the wait ended.
+  virtual void OnLockWait(const LockWait& /*lock_wait*/) {}
+  // With Tracer::SetBranchSampling, periodically, from a single thread.
+  virtual void OnBranchCounts(const BranchCounts& /*branch_counts*/) {}
+
+  // The tracer reports the most frequent events in batches, one per type of
+  // event, after each pass over the events it has collected. Listeners can
+  // override these to handle a whole batch at once (e.g., taking a lock only
+  // once). By default, each event is forwarded to the callback above.
+  virtual void OnContextSwitchesIn(
+      absl::Span<const ContextSwitchIn> context_switches_in) {
+    for (const ContextSwitchIn& context_switch_in : context_switches_in) {
+      OnContextSwitchIn(context_switch_in);
+    }
+  }
+  virtual void OnContextSwitchesOut(
+      absl::Span<const ContextSwitchOut> context_switches_out) {
+    for (const ContextSwitchOut& context_switch_out : context_switches_out) {
+      OnContextSwitchOut(context_switch_out);
+    }
+  }
+  virtual void OnCallstacks(absl::Span<const Callstack> callstacks) {
+    for (const Callstack& callstack : callstacks) {
+      OnCallstack(callstack);
+    }
+  }
+  // With Tracer::SetBpfStackAggregation, periodically. By default, each
+  // callstack is forwarded to OnCallstacks as many times as it was sampled.
+  virtual void OnCallstackCounts(
+      absl::Span<const CallstackCount> callstack_counts) {
+    for (const CallstackCount& callstack_count : callstack_counts) {
+      std::vector<Callstack> callstacks(callstack_count.GetCount(),
+                                        callstack_count.GetCallstack());
+      OnCallstacks(callstacks);
+    }
+  }
+  virtual void OnFunctionCalls(absl::Span<const FunctionCall> function_calls) {
+    for (const FunctionCall& function_call : function_calls) {
+      OnFunctionCall(function_call);
+    }
+  }
+  virtual void OnThreadStateChanges(
+      absl::Span<const ThreadStateChange> thread_state_changes) {
+    for (const ThreadStateChange& thread_state_change : thread_state_changes) {
+      OnThreadStateChange(thread_state_change);
+    }
+  }
+  virtual void OnFileIos(absl::Span<const FileIo> file_ios) {
+    for (const FileIo& file_io : file_ios) {
+      OnFileIo(file_io);
+    }
+  }
 };
 
 }  // namespace LinuxTracing
@@ -0,0 +1,115 @@
+#include <OrbitLinuxTracing/Tracer.h>
+#include <OrbitLinuxTracing/TracerListener.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// Processes a file of raw perf_event_open records written by a capture with
+// Params::m_PerfRecordFilePath (see LinuxTracing::Tracer::SetRecordFilePath),
+// and prints the number of events of each type and the processing throughput.
+// This reproduces the processing of the service offline, to profile it or
+// compare unwinding settings on the same capture. Run it on the machine of the
+// capture, or one with the same binaries, as they are needed for unwinding.
+
+namespace {
+class CountingListener : public LinuxTracing::TracerListener {
+ public:
+  void OnTid(pid_t /*tid*/) override { ++tid_count; }
+  void OnContextSwitchIn(
+      const LinuxTracing::ContextSwitchIn& /*context_switch_in*/) override {
+    ++context_switch_count;
+  }
+  void OnContextSwitchOut(
+      const LinuxTracing::ContextSwitchOut& /*context_switch_out*/) override {
+    ++context_switch_count;
+  }
+  void OnCallstack(const LinuxTracing::Callstack& callstack) override {
+    ++callstack_count;
+    frame_count += callstack.GetFrames().size();
+  }
+  void OnFunctionCall(
+      const LinuxTracing::FunctionCall& /*function_call*/) override {
+    ++function_call_count;
+  }
+  void OnGpuJob(const LinuxTracing::GpuJob& /*gpu_job*/) override {
+    ++gpu_job_count;
+  }
+  void OnThreadStateChange(const LinuxTracing::ThreadStateChange&
+                           /*thread_state_change*/) override {
+    ++thread_state_change_count;
+  }
+  void OnOffCpuCallstack(
+      const LinuxTracing::OffCpuCallstack& /*off_cpu_callstack*/) override {
+    ++off_cpu_callstack_count;
+  }
+
+  uint64_t tid_count = 0;
+  uint64_t context_switch_count = 0;
+  uint64_t callstack_count = 0;
+  uint64_t frame_count = 0;
+  uint64_t function_call_count = 0;
+  uint64_t gpu_job_count = 0;
+  uint64_t thread_state_change_count = 0;
+  uint64_t off_cpu_callstack_count = 0;
+};
+
+void PrintUsage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [--frame_pointers] [--unwinding_threads N] "
+          "RECORD_FILE\n",
+          program);
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::string record_file_path;
+  bool unwind_with_frame_pointers = false;
+  uint32_t unwinding_thread_count = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--frame_pointers") == 0) {
+      unwind_with_frame_pointers = true;
+    } else if (strcmp(argv[i], "--unwinding_threads") == 0 && i + 1 < argc) {
+      unwinding_thread_count = std::stoul(argv[++i]);
+    } else if (argv[i][0] != '-' && record_file_path.empty()) {
+      record_file_path = argv[i];
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (record_file_path.empty()) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  CountingListener listener;
+  auto begin = std::chrono::steady_clock::now();
+  bool valid = LinuxTracing::Tracer::Replay(record_file_path, &listener,
+                                            unwinding_thread_count,
+                                            unwind_with_frame_pointers);
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - begin)
+                       .count();
+
+  printf("threads:             %lu\n", listener.tid_count);
+  printf("context switches:    %lu\n", listener.context_switch_count);
+  printf("callstacks:          %lu (%.1f frames on average)\n",
+         listener.callstack_count,
+         listener.callstack_count > 0
+             ? static_cast<double>(listener.frame_count) /
+                   listener.callstack_count
+             : 0.0);
+  printf("function calls:      %lu\n", listener.function_call_count);
+  printf("GPU jobs:            %lu\n", listener.gpu_job_count);
+  printf("thread states:       %lu\n", listener.thread_state_change_count);
+  printf("off-CPU callstacks:  %lu\n", listener.off_cpu_callstack_count);
+  uint64_t event_count =
+      listener.context_switch_count + listener.callstack_count +
+      listener.function_call_count + listener.gpu_job_count +
+      listener.thread_state_change_count + listener.off_cpu_callstack_count;
+  printf("%lu events in %.3f s: %.0f events/s\n", event_count, seconds,
+         seconds > 0 ? event_count / seconds : 0.0);
+  return valid ? 0 : 1;
+}
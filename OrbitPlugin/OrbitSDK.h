@@ -3,6 +3,8 @@
 //-----------------------------------
 #pragma once
 
+#include <cstddef>
+
 #include "OrbitData.h"
 #include "OrbitUserData.h"
 
@@ -29,6 +31,24 @@ class Plugin {
   virtual void ReceiveUserData(const Orbit::UserData* a_Data) = 0;
   virtual void ReceiveOrbitData(const Orbit::Data* a_Data) = 0;
 
+  // Data Thread, one per plugin. The entries of a batch, and their m_Data,
+  // are only valid during the call. They point into the one buffer the batch
+  // was received in, shared by all the plugins. Override this rather than
+  // ReceiveUserData to process many entries without a call for each.
+  virtual void ReceiveUserDataBatch(const Orbit::UserData* a_Data,
+                                    size_t a_Count) {
+    for (size_t i = 0; i < a_Count; ++i) {
+      ReceiveUserData(&a_Data[i]);
+    }
+  }
+  // Batches received while this many are still waiting for the plugin are
+  // dropped rather than queued, so that a slow plugin holds back neither the
+  // connection nor the other plugins.
+  virtual size_t GetMaxPendingUserDataBatches() { return 64; }
+  // Data Thread, before the next batch, with the number of entries dropped
+  // since the previous batch.
+  virtual void OnUserDataDropped(size_t a_Count) {}
+
  protected:
   int m_ID;
 };
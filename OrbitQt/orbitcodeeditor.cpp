@@ -58,6 +58,7 @@
 #include "../OrbitCore/LogInterface.h"
 #include "../OrbitCore/Path.h"
 #include "../OrbitCore/PrintVar.h"
+#include "../OrbitCore/SamplingProfiler.h"
 #include "../OrbitCore/Utils.h"
 #include "../OrbitGl/App.h"
 #include "absl/strings/str_format.h"
@@ -162,10 +163,30 @@ int OrbitCodeEditor::lineNumberAreaWidth() {
   }
 
   int space = 3 + fontMetrics().width(QLatin1Char('9')) * digits;
+  if (m_LineCounts) {
+    // Exclusive percentage of the line, left of its number.
+    space += fontMetrics().width(QLatin1String("100.0%")) + 6;
+  }
 
   return space;
 }
 
+//-----------------------------------------------------------------------------
+void OrbitCodeEditor::SetLineCounts(
+    std::shared_ptr<const SourceLineCounts> a_Counts) {
+  m_LineCounts = std::move(a_Counts);
+  m_MaxLineInclusive = 0;
+  if (m_LineCounts) {
+    for (const auto& pair : m_LineCounts->m_Lines) {
+      m_MaxLineInclusive =
+          std::max(m_MaxLineInclusive, pair.second.m_Inclusive);
+    }
+    if (m_MaxLineInclusive == 0) m_LineCounts = nullptr;
+  }
+  updateLineNumberAreaWidth(0);
+  lineNumberArea->update();
+}
+
 //-----------------------------------------------------------------------------
 bool OrbitCodeEditor::loadCode(std::string a_Msg) {
   std::vector<std::string> tokens = Tokenize(a_Msg, "^");
@@ -175,6 +196,8 @@ bool OrbitCodeEditor::loadCode(std::string a_Msg) {
     bool success = file.open(QFile::ReadOnly | QFile::Text);
     if (success) {
       QTextStream ReadFile(&file);
+      SetLineCounts(m_Type == CODE_VIEW ? GOrbitApp->GetSourceLineCounts()
+                                        : nullptr);
       this->document()->setPlainText(ReadFile.readAll());
       int lineNumber = atoi(tokens[2].c_str());
       gotoLine(lineNumber);
@@ -184,6 +207,7 @@ bool OrbitCodeEditor::loadCode(std::string a_Msg) {
       msg +=
           "Please modify FileMapping.txt shown below if the source code is "
           "available at another location.";
+      SetLineCounts(nullptr);
       document()->setPlainText(msg.c_str());
       return false;
     }
@@ -198,6 +222,7 @@ void OrbitCodeEditor::loadFileMap() {
   bool success = file.open(QFile::ReadWrite | QFile::Text);
   if (success) {
     QTextStream ReadFile(&file);
+    SetLineCounts(nullptr);
     this->document()->setPlainText(ReadFile.readAll());
   }
   file.close();
@@ -241,6 +266,7 @@ void OrbitCodeEditor::OnTimer() {
 
 //-----------------------------------------------------------------------------
 void OrbitCodeEditor::SetText(const std::wstring& a_Text) {
+  SetLineCounts(nullptr);
   this->document()->setPlainText(QString::fromStdWString(a_Text));
 }
 
@@ -418,6 +444,9 @@ void OrbitCodeEditor::lineNumberAreaPaintEvent(QPaintEvent* event) {
   //![extraAreaPaintEvent_2]
   while (block.isValid() && top <= event->rect().bottom()) {
     if (block.isVisible() && bottom >= event->rect().top()) {
+      if (m_LineCounts) {
+        PaintLineHeat(painter, blockNumber + 1, top, bottom - top);
+      }
       QString number = QString::number(blockNumber + 1);
       painter.setPen(QColor(43, 145, 175));
       painter.drawText(0, top, lineNumberArea->width(), fontMetrics().height(),
@@ -431,6 +460,30 @@ void OrbitCodeEditor::lineNumberAreaPaintEvent(QPaintEvent* event) {
   }
 }
 
+//-----------------------------------------------------------------------------
+void OrbitCodeEditor::PaintLineHeat(QPainter& a_Painter, uint32_t a_Line,
+                                    int a_Top, int a_Height) {
+  auto it = m_LineCounts->m_Lines.find(a_Line);
+  if (it == m_LineCounts->m_Lines.end()) return;
+  const SourceLineCount& count = it->second;
+
+  // From the background to red, by the inclusive count relative to the
+  // hottest line.
+  float heat = (float)count.m_Inclusive / (float)m_MaxLineInclusive;
+  QColor color(30 + (int)(heat * (231 - 30)), 30 + (int)(heat * (68 - 30)),
+               30 + (int)(heat * (53 - 30)));
+  a_Painter.fillRect(0, a_Top, lineNumberArea->width(), a_Height, color);
+
+  if (count.m_Exclusive > 0 && m_LineCounts->m_NumSamples > 0) {
+    float percent =
+        100.f * (float)count.m_Exclusive / (float)m_LineCounts->m_NumSamples;
+    a_Painter.setPen(QColor(255, 255, 255));
+    a_Painter.drawText(3, a_Top, lineNumberArea->width(),
+                       fontMetrics().height(), Qt::AlignLeft,
+                       QString::number(percent, 'f', 1) + "%");
+  }
+}
+
 //-----------------------------------------------------------------------------
 Highlighter::Highlighter(QTextDocument* parent) : QSyntaxHighlighter(parent) {
   HighlightingRule rule;
@@ -55,6 +55,7 @@
 #include <QPlainTextEdit>
 #include <QSyntaxHighlighter>
 #include <QTextCharFormat>
+#include <memory>
 
 #include "../OrbitCore/RingBuffer.h"
 
@@ -67,6 +68,7 @@ class QTextDocument;
 QT_END_NAMESPACE
 
 class LineNumberArea;
+struct SourceLineCounts;
 
 //![codeeditordefinition]
 
@@ -97,12 +99,17 @@ class OrbitCodeEditor : public QPlainTextEdit {
   void SetFindLineEdit(class QLineEdit* a_Find);
   void SetSaveButton(class QPushButton* a_Button);
   void SetIsOutputWindow() { m_IsOutput = true; }
+  // Samples per line of the code loaded, shown as heat next to the line
+  // numbers. Cleared by passing nullptr.
+  void SetLineCounts(std::shared_ptr<const SourceLineCounts> a_Counts);
 
  protected:
   void resizeEvent(QResizeEvent* event) Q_DECL_OVERRIDE;
   void keyPressEvent(QKeyEvent* e) override;
   bool eventFilter(QObject* object, QEvent* event) override;
   void Find(const QString& a_String, bool a_BackWards = false);
+  void PaintLineHeat(class QPainter& a_Painter, uint32_t a_Line, int a_Top,
+                     int a_Height);
 
  private slots:
   void updateLineNumberAreaWidth(int newBlockCount);
@@ -118,6 +125,9 @@ class OrbitCodeEditor : public QPlainTextEdit {
   class QPushButton* m_SaveButton;
   EditorType m_Type;
   bool m_IsOutput;
+  std::shared_ptr<const SourceLineCounts> m_LineCounts;
+  // Inclusive count of the hottest line, for the heat of the others.
+  unsigned int m_MaxLineInclusive = 0;
 
   static OrbitCodeEditor* GFileMapEditor;
   static QWidget* GFileMapWidget;
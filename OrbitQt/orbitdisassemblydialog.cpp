@@ -16,4 +16,11 @@ void OrbitDisassemblyDialog::SetText(const std::wstring& a_Text) {
   ui->plainTextEdit->SetText(a_Text);
   ui->plainTextEdit->moveCursor(QTextCursor::Start);
   ui->plainTextEdit->ensureCursorVisible();
+}
+
+//-----------------------------------------------------------------------------
+void OrbitDisassemblyDialog::AppendText(const std::wstring& a_Text) {
+  QTextCursor cursor(ui->plainTextEdit->document());
+  cursor.movePosition(QTextCursor::End);
+  cursor.insertText(QString::fromStdWString(a_Text));
 }
\ No newline at end of file
@@ -16,6 +16,8 @@ class OrbitDisassemblyDialog : public QDialog {
   ~OrbitDisassemblyDialog();
 
   void SetText(const std::wstring& a_Text);
+  // Adds a_Text at the end, without moving the view.
+  void AppendText(const std::wstring& a_Text);
 
  private:
   Ui::OrbitDisassemblyDialog* ui;
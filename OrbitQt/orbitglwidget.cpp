@@ -25,6 +25,7 @@ OrbitGLWidget::OrbitGLWidget(QWidget* parent) : QOpenGLWidget(parent) {
   setMouseTracking(true);
   setUpdateBehavior(QOpenGLWidget::PartialUpdate);
   installEventFilter(this);
+  m_LastPaintTimer.start();
 }
 
 //-----------------------------------------------------------------------------
@@ -40,6 +41,19 @@ bool OrbitGLWidget::eventFilter(QObject* /*object*/, QEvent* event) {
   return false;
 }
 
+//-----------------------------------------------------------------------------
+bool OrbitGLWidget::UpdateIfNeeded() {
+  if (!m_OrbitPanel || !isVisible()) {
+    return false;
+  }
+  m_OrbitPanel->PreRender();
+  if (!m_OrbitPanel->GetNeedsRedraw()) {
+    return false;
+  }
+  update();
+  return true;
+}
+
 //-----------------------------------------------------------------------------
 void OrbitGLWidget::Initialize(GlPanel::Type a_Type,
                                OrbitMainWindow* a_MainWindow,
@@ -188,6 +202,7 @@ void OrbitGLWidget::resizeGL(int w, int h) {
 
 //-----------------------------------------------------------------------------
 void OrbitGLWidget::paintGL() {
+  m_LastPaintTimer.restart();
   if (m_OrbitPanel) {
     m_OrbitPanel->Render(width(), height());
   }
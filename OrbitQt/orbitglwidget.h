@@ -3,6 +3,7 @@
 //-----------------------------------
 #pragma once
 
+#include <QElapsedTimer>
 #include <QOpenGLFunctions>
 #include <QOpenGLWidget>
 
@@ -22,6 +23,10 @@ class OrbitGLWidget : public QOpenGLWidget, protected QOpenGLFunctions {
   void resizeGL(int w, int h) override;
   void paintGL() override;
   bool eventFilter(QObject* object, QEvent* event) override;
+  // Schedules a repaint if the panel needs to be redrawn, returns whether it
+  // did.
+  bool UpdateIfNeeded();
+  qint64 GetMsSinceLastPaint() const { return m_LastPaintTimer.elapsed(); }
   void TakeScreenShot();
   GlPanel* GetPanel() { return m_OrbitPanel; }
   void PrintContextInformation();
@@ -42,4 +47,5 @@ class OrbitGLWidget : public QOpenGLWidget, protected QOpenGLFunctions {
  private:
   GlPanel* m_OrbitPanel;
   QOpenGLDebugLogger* m_DebugLogger;
+  QElapsedTimer m_LastPaintTimer;
 };
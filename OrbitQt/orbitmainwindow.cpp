@@ -7,11 +7,17 @@
 #include <QBuffer>
 #include <QClipboard>
 #include <QFileDialog>
+#include <QLineEdit>
 #include <QMessageBox>
 #include <QMouseEvent>
+#include <QPushButton>
 #include <QTimer>
 #include <QToolTip>
+#include <QTreeView>
+#include <limits>
 
+#include "../OrbitCore/Capture.h"
+#include "../OrbitCore/OrbitFunction.h"
 #include "../OrbitCore/Path.h"
 #include "../OrbitCore/PrintVar.h"
 #include "../OrbitCore/Utils.h"
@@ -21,11 +27,14 @@
 #include "../OrbitGl/SamplingReport.h"
 #include "../OrbitPlugin/OrbitSDK.h"
 #include "../external/concurrentqueue/concurrentqueue.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_format.h"
 #include "licensedialog.h"
+#include "orbitdataviewpanel.h"
 #include "orbitdiffdialog.h"
 #include "orbitdisassemblydialog.h"
 #include "orbitsamplingreport.h"
+#include "orbittreemodel.h"
 #include "orbitvisualizer.h"
 #include "outputdialog.h"
 #include "showincludesdialog.h"
@@ -68,6 +77,14 @@ OrbitMainWindow::OrbitMainWindow(QApplication* a_App, QWidget* parent)
       [this](std::shared_ptr<SamplingReport> a_Report) {
         this->OnNewSelection(a_Report);
       });
+  GOrbitApp->AddOffCpuReportCallback(
+      [this](std::shared_ptr<SamplingReport> a_Report) {
+        this->OnNewOffCpuReport(a_Report);
+      });
+  GOrbitApp->AddPageFaultReportCallback(
+      [this](std::shared_ptr<SamplingReport> a_Report) {
+        this->OnNewPageFaultReport(a_Report);
+      });
   GOrbitApp->AddUiMessageCallback([this](const std::wstring& a_Message) {
     this->OnReceiveMessage(a_Message);
   });
@@ -84,6 +101,10 @@ OrbitMainWindow::OrbitMainWindow(QApplication* a_App, QWidget* parent)
       });
   GOrbitApp->SetClipboardCallback(
       [this](const std::wstring& a_Text) { this->OnSetClipboard(a_Text); });
+  GOrbitApp->SetSamplingReportFilterCallback(
+      [this](const std::wstring& a_Filter) {
+        this->OnFilterSamplingReport(a_Filter);
+      });
 
   ParseCommandlineArguments();
 
@@ -128,6 +149,14 @@ OrbitMainWindow::OrbitMainWindow(QApplication* a_App, QWidget* parent)
 
   CreateSamplingTab();
   CreateSelectionTab();
+  CreateOffCpuTab();
+  CreatePageFaultTab();
+  CreateFlameGraphTab();
+  CreateLatencyHistogramTab();
+  CreateSamplingDiffTab();
+  CreateTimerDiffTab();
+  CreateLockContentionTab();
+  CreateCallTreeTab();
   CreatePluginTabs();
 
   this->setWindowTitle("Orbit Profiler");
@@ -274,6 +303,175 @@ void OrbitMainWindow::CreateSamplingTab() {
   ui->RightTabWidget->addTab(m_SamplingTab, QString("sampling"));
 }
 
+//-----------------------------------------------------------------------------
+void OrbitMainWindow::CreateFlameGraphTab() {
+  QWidget* widget = new QWidget();
+  QGridLayout* layout = new QGridLayout(widget);
+  layout->setSpacing(6);
+  layout->setContentsMargins(11, 11, 11, 11);
+  OrbitGLWidget* glWidget = new OrbitGLWidget(widget);
+  layout->addWidget(glWidget, 0, 0, 1, 1);
+  ui->RightTabWidget->addTab(widget, QString("flame graph"));
+
+  glWidget->Initialize(GlPanel::FLAME_GRAPH, this);
+}
+
+//-----------------------------------------------------------------------------
+void OrbitMainWindow::CreateLatencyHistogramTab() {
+  QWidget* widget = new QWidget();
+  QGridLayout* layout = new QGridLayout(widget);
+  layout->setSpacing(6);
+  layout->setContentsMargins(11, 11, 11, 11);
+  OrbitGLWidget* glWidget = new OrbitGLWidget(widget);
+  layout->addWidget(glWidget, 0, 0, 1, 1);
+  ui->RightTabWidget->addTab(widget, QString("latency"));
+
+  glWidget->Initialize(GlPanel::LATENCY_HISTOGRAM, this);
+}
+
+//-----------------------------------------------------------------------------
+void OrbitMainWindow::CreateSamplingDiffTab() {
+  QWidget* widget = new QWidget();
+  QGridLayout* layout = new QGridLayout(widget);
+  layout->setSpacing(6);
+  layout->setContentsMargins(11, 11, 11, 11);
+  OrbitDataViewPanel* diffView = new OrbitDataViewPanel(widget);
+  diffView->Initialize(DataViewType::SAMPLING_DIFF);
+  layout->addWidget(diffView, 0, 0, 1, 1);
+  ui->RightTabWidget->addTab(widget, QString("diff"));
+}
+
+//-----------------------------------------------------------------------------
+void OrbitMainWindow::CreateTimerDiffTab() {
+  QWidget* widget = new QWidget();
+  QGridLayout* layout = new QGridLayout(widget);
+  layout->setSpacing(6);
+  layout->setContentsMargins(11, 11, 11, 11);
+  OrbitDataViewPanel* diffView = new OrbitDataViewPanel(widget);
+  diffView->Initialize(DataViewType::TIMER_DIFF);
+  layout->addWidget(diffView, 0, 0, 1, 1);
+  ui->RightTabWidget->addTab(widget, QString("timing diff"));
+}
+
+//-----------------------------------------------------------------------------
+void OrbitMainWindow::CreateLockContentionTab() {
+  QWidget* widget = new QWidget();
+  QGridLayout* layout = new QGridLayout(widget);
+  layout->setSpacing(6);
+  layout->setContentsMargins(11, 11, 11, 11);
+  OrbitDataViewPanel* lockView = new OrbitDataViewPanel(widget);
+  lockView->Initialize(DataViewType::LOCK_CONTENTION);
+  layout->addWidget(lockView, 0, 0, 1, 1);
+  ui->RightTabWidget->addTab(widget, QString("contention"));
+}
+
+//-----------------------------------------------------------------------------
+// Beyond that, a filter matches too much for its paths to be expanded.
+static constexpr size_t kMaxCallTreeMatches = 1000;
+
+//-----------------------------------------------------------------------------
+static std::vector<OrbitTreeModel::LazyItem> GetCallTreeItems(uint64_t a_Id) {
+  std::vector<OrbitTreeModel::LazyItem> items;
+  uint64_t totalNs = Capture::GInstrumentedCallTree.GetTotalNs();
+  // With branch sampling, the calls sampled from the code of the caller, or
+  // from anywhere for the outermost calls.
+  bool hasBranches = !Capture::GBranchProfile.IsEmpty();
+  uint64_t callerBegin = 0;
+  uint64_t callerEnd = std::numeric_limits<uint64_t>::max();
+  auto caller = Capture::GSelectedFunctionsMap.find(
+      Capture::GInstrumentedCallTree.GetFunctionAddress(a_Id));
+  if (a_Id != InstrumentedCallTree::kRootId &&
+      caller != Capture::GSelectedFunctionsMap.end()) {
+    callerBegin = caller->first;
+    callerEnd = callerBegin + caller->second->Size();
+  }
+  for (const InstrumentedCallTree::Node& node :
+       Capture::GInstrumentedCallTree.GetChildren(a_Id)) {
+    std::string name = absl::StrFormat("0x%llx", node.function_address);
+    auto it = Capture::GSelectedFunctionsMap.find(node.function_address);
+    if (it != Capture::GSelectedFunctionsMap.end()) {
+      name = it->second->PrettyName();
+    }
+    double percent =
+        totalNs == 0 ? 0 : 100.0 * node.inclusive_ns / totalNs;
+    QString sampledCalls;
+    if (hasBranches) {
+      sampledCalls = QString::number(Capture::GBranchProfile.GetCallCount(
+          callerBegin, callerEnd, node.function_address));
+    }
+    QList<QVariant> data;
+    data << QString::fromStdString(name)
+         << QString::number(node.count)
+         << QString::fromStdString(GetPrettyTime(node.inclusive_ns * 1e-6))
+         << QString::fromStdString(absl::StrFormat("%.2f", percent))
+         << QString::fromStdString(GetPrettyTime(node.exclusive_ns * 1e-6))
+         << QString::fromStdString(GetPrettyTime(node.p50_ns * 1e-6))
+         << QString::fromStdString(GetPrettyTime(node.p90_ns * 1e-6))
+         << QString::fromStdString(GetPrettyTime(node.p99_ns * 1e-6))
+         << QString::fromStdString(GetPrettyTime(node.max_ns * 1e-6))
+         << sampledCalls;
+    items.push_back({node.id, data, node.has_children});
+  }
+  return items;
+}
+
+//-----------------------------------------------------------------------------
+void OrbitMainWindow::CreateCallTreeTab() {
+  QWidget* widget = new QWidget();
+  QGridLayout* layout = new QGridLayout(widget);
+  layout->setSpacing(6);
+  layout->setContentsMargins(11, 11, 11, 11);
+  QStringList headers = {"Function", "Count", "Inclusive", "%",
+                         "Exclusive", "p50",  "p90",       "p99",
+                         "Max",       "Sampled calls"};
+  // Only the expanded nodes are built, from the tree as it is then.
+  OrbitTreeModel* model =
+      new OrbitTreeModel(headers, &GetCallTreeItems, widget);
+  QTreeView* treeView = new QTreeView(widget);
+  treeView->setModel(model);
+  QPushButton* refreshButton = new QPushButton("Refresh", widget);
+  connect(refreshButton, &QPushButton::clicked, [model]() { model->Reload(); });
+
+  // The functions matching the filter are looked up here, their paths are
+  // searched in the background, and only those are loaded and expanded.
+  QLineEdit* filterEdit = new QLineEdit(widget);
+  filterEdit->setPlaceholderText("Filter");
+  connect(filterEdit, &QLineEdit::textChanged, [model](const QString& text) {
+    absl::flat_hash_set<uint64_t> addresses;
+    std::string filter = text.toStdString();
+    if (!filter.empty()) {
+      for (const auto& pair : Capture::GSelectedFunctionsMap) {
+        if (Contains(pair.second->PrettyName(), filter, false)) {
+          addresses.insert(pair.first);
+        }
+      }
+    }
+    model->FilterInBackground([addresses]() {
+      std::vector<std::vector<uint64_t>> paths;
+      for (const std::vector<InstrumentedCallTree::NodeId>& path :
+           Capture::GInstrumentedCallTree.FindPaths(addresses,
+                                                    kMaxCallTreeMatches)) {
+        paths.emplace_back(path.begin(), path.end());
+      }
+      return paths;
+    });
+  });
+  connect(model, &OrbitTreeModel::FilterFinished,
+          [treeView](const QList<QModelIndex>& matches) {
+            for (const QModelIndex& match : matches) {
+              for (QModelIndex parent = match.parent(); parent.isValid();
+                   parent = parent.parent()) {
+                treeView->expand(parent);
+              }
+            }
+          });
+
+  layout->addWidget(refreshButton, 0, 0, 1, 1);
+  layout->addWidget(filterEdit, 0, 1, 1, 1);
+  layout->addWidget(treeView, 1, 0, 1, 2);
+  ui->RightTabWidget->addTab(widget, QString("call tree"));
+}
+
 //-----------------------------------------------------------------------------
 void OrbitMainWindow::CreatePluginTabs() {
   for (Orbit::Plugin* plugin : GPluginManager.m_Plugins) {
@@ -312,6 +510,12 @@ void OrbitMainWindow::CreateSelectionTab() {
   ui->RightTabWidget->addTab(m_SelectionTab, QString("selection"));
 }
 
+//-----------------------------------------------------------------------------
+void OrbitMainWindow::OnFilterSamplingReport(const std::wstring& a_Filter) {
+  m_OrbitSamplingReport->SetFilter(QString::fromStdWString(a_Filter));
+  ui->RightTabWidget->setCurrentWidget(m_SamplingTab);
+}
+
 //-----------------------------------------------------------------------------
 void OrbitMainWindow::OnNewSelection(
     std::shared_ptr<class SamplingReport> a_SamplingReport) {
@@ -325,6 +529,50 @@ void OrbitMainWindow::OnNewSelection(
   ui->RightTabWidget->setCurrentWidget(m_SelectionTab);
 }
 
+//-----------------------------------------------------------------------------
+void OrbitMainWindow::CreateOffCpuTab() {
+  m_OffCpuTab = new QWidget();
+  m_OffCpuLayout = new QGridLayout(m_OffCpuTab);
+  m_OffCpuLayout->setSpacing(6);
+  m_OffCpuLayout->setContentsMargins(11, 11, 11, 11);
+  m_OffCpuReport = new OrbitSamplingReport(m_OffCpuTab);
+  m_OffCpuLayout->addWidget(m_OffCpuReport, 0, 0, 1, 1);
+  ui->RightTabWidget->addTab(m_OffCpuTab, QString("off-cpu"));
+}
+
+//-----------------------------------------------------------------------------
+void OrbitMainWindow::OnNewOffCpuReport(
+    std::shared_ptr<class SamplingReport> a_SamplingReport) {
+  m_OffCpuLayout->removeWidget(m_OffCpuReport);
+  delete m_OffCpuReport;
+
+  m_OffCpuReport = new OrbitSamplingReport(m_OffCpuTab);
+  m_OffCpuReport->Initialize(a_SamplingReport);
+  m_OffCpuLayout->addWidget(m_OffCpuReport, 0, 0, 1, 1);
+}
+
+//-----------------------------------------------------------------------------
+void OrbitMainWindow::CreatePageFaultTab() {
+  m_PageFaultTab = new QWidget();
+  m_PageFaultLayout = new QGridLayout(m_PageFaultTab);
+  m_PageFaultLayout->setSpacing(6);
+  m_PageFaultLayout->setContentsMargins(11, 11, 11, 11);
+  m_PageFaultReport = new OrbitSamplingReport(m_PageFaultTab);
+  m_PageFaultLayout->addWidget(m_PageFaultReport, 0, 0, 1, 1);
+  ui->RightTabWidget->addTab(m_PageFaultTab, QString("page faults"));
+}
+
+//-----------------------------------------------------------------------------
+void OrbitMainWindow::OnNewPageFaultReport(
+    std::shared_ptr<class SamplingReport> a_SamplingReport) {
+  m_PageFaultLayout->removeWidget(m_PageFaultReport);
+  delete m_PageFaultReport;
+
+  m_PageFaultReport = new OrbitSamplingReport(m_PageFaultTab);
+  m_PageFaultReport->Initialize(a_SamplingReport);
+  m_PageFaultLayout->addWidget(m_PageFaultReport, 0, 0, 1, 1);
+}
+
 //-----------------------------------------------------------------------------
 void OrbitMainWindow::OnReceiveMessage(const std::wstring& a_Message) {
   if (a_Message == L"ScreenShot") {
@@ -388,6 +636,8 @@ void OrbitMainWindow::OnReceiveMessage(const std::wstring& a_Message) {
     QMessageBox::about(this, title.c_str(), msg.c_str());
   } else if (StartsWith(a_Message, L"asm:")) {
     OpenDisassembly(a_Message);
+  } else if (StartsWith(a_Message, L"asmchunk:")) {
+    AppendDisassembly(Replace(a_Message, L"asmchunk:", L""));
   } else if (StartsWith(a_Message, L"RuleEditor")) {
     m_RuleEditor->show();
   } else if (StartsWith(a_Message, L"UpdateProcessParams")) {
@@ -426,23 +676,49 @@ void OrbitMainWindow::on_actionAbout_triggered() {
   QMessageBox::about(this, title.c_str(), text.c_str());
 }
 
+//-----------------------------------------------------------------------------
+namespace {
+// Period of the main tick while panels are being redrawn, ~60 FPS, and while
+// nothing changes, when it only processes the messages from the service.
+constexpr int kActiveTickMs = 16;
+constexpr int kIdleTickMs = 100;
+// Since the last paint of a panel, e.g. after an input event, after which
+// the main tick goes back to the idle period.
+constexpr qint64 kActivePeriodMs = 500;
+// While capturing, the data changes all the time: frames are limited to
+// ~30 FPS, which leaves the main thread time to take in the data.
+constexpr qint64 kCaptureFrameIntervalMs = 33;
+}  // namespace
+
 //-----------------------------------------------------------------------------
 void OrbitMainWindow::StartMainTimer() {
   m_MainTimer = new QTimer(this);
   connect(m_MainTimer, SIGNAL(timeout()), this, SLOT(OnTimer()));
-
-  // Update period set to 16ms (~60FPS)
-  int msec = 16;
-  m_MainTimer->start(msec);
+  m_FrameTimer.start();
+  m_MainTimer->start(kActiveTickMs);
 }
 
 //-----------------------------------------------------------------------------
 void OrbitMainWindow::OnTimer() {
   OrbitApp::MainTick();
 
+  // Panels are only repainted when they need to be redrawn. Input events
+  // repaint the panel they go to right away, see OrbitGLWidget.
+  bool capturing = Capture::IsCapturing();
+  if (!capturing || m_FrameTimer.elapsed() >= kCaptureFrameIntervalMs) {
+    bool updated = false;
+    for (OrbitGLWidget* glWidget : m_GlWidgets) {
+      updated = glWidget->UpdateIfNeeded() || updated;
+    }
+    if (updated) {
+      m_FrameTimer.restart();
+    }
+  }
+  bool active = capturing;
   for (OrbitGLWidget* glWidget : m_GlWidgets) {
-    glWidget->update();
+    active = active || glWidget->GetMsSinceLastPaint() < kActivePeriodMs;
   }
+  m_MainTimer->setInterval(active ? kActiveTickMs : kIdleTickMs);
 
   // Output window
   this->ui->plainTextEdit->OnTimer();
@@ -558,14 +834,17 @@ void OrbitMainWindow::on_actionSave_Capture_triggered() {
   QString file = QFileDialog::getSaveFileName(
       this, "Save capture...",
       (Path::GetCapturePath() + ws2s(GOrbitApp->GetCaptureFileName())).c_str(),
-      "*.orbit");
+      "Capture (*.orbit);;Chrome trace (*.json);;Perfetto trace (*.pftrace);;"
+      "pprof profile (*.pb.gz)");
   GOrbitApp->OnSaveCapture(file.toStdString());
 }
 
 //-----------------------------------------------------------------------------
 void OrbitMainWindow::on_actionOpen_Capture_2_triggered() {
   QStringList list = QFileDialog::getOpenFileNames(
-      this, "Open capture...", Path::GetCapturePath().c_str(), "*.orbit");
+      this, "Open capture...", Path::GetCapturePath().c_str(),
+      "Capture (*.orbit);;Chrome trace (*.json);;"
+      "Perfetto trace (*.pftrace *.perfetto-trace)");
   for (auto& file : list) {
     GOrbitApp->OnLoadCapture(file.toStdString());
     SetTitle(file.toStdString());
@@ -603,6 +882,17 @@ void OrbitMainWindow::OpenDisassembly(const std::wstring& a_String) {
   dialog->setWindowFlags(dialog->windowFlags() | Qt::WindowMinimizeButtonHint |
                          Qt::WindowMaximizeButtonHint);
   dialog->show();
+  m_DisassemblyDialog = dialog;
+}
+
+//-----------------------------------------------------------------------------
+void OrbitMainWindow::AppendDisassembly(const std::wstring& a_String) {
+  if (m_DisassemblyDialog.isNull()) {
+    // Closed before the end of the disassembly, which is not needed anymore.
+    GOrbitApp->CancelDisassembly();
+    return;
+  }
+  m_DisassemblyDialog->AppendText(a_String);
 }
 
 //-----------------------------------------------------------------------------
@@ -3,7 +3,9 @@
 //-----------------------------------
 #pragma once
 
+#include <QElapsedTimer>
 #include <QMainWindow>
+#include <QPointer>
 #include <atomic>
 #include <memory>
 #include <thread>
@@ -30,13 +32,26 @@ class OrbitMainWindow : public QMainWindow {
       std::shared_ptr<class SamplingReport> a_SamplingReport);
   void CreateSamplingTab();
   void CreateSelectionTab();
+  void CreateOffCpuTab();
+  void CreatePageFaultTab();
   void CreatePluginTabs();
+  void CreateFlameGraphTab();
+  void CreateLatencyHistogramTab();
+  void CreateSamplingDiffTab();
+  void CreateTimerDiffTab();
+  void CreateLockContentionTab();
+  void CreateCallTreeTab();
   void OnNewSelection(std::shared_ptr<class SamplingReport> a_SamplingReport);
+  void OnNewOffCpuReport(
+      std::shared_ptr<class SamplingReport> a_SamplingReport);
+  void OnNewPageFaultReport(
+      std::shared_ptr<class SamplingReport> a_SamplingReport);
   void OnReceiveMessage(const std::wstring& a_Message);
   void OnAddToWatch(const class Variable* a_Variable);
   void OnGetSaveFileName(const std::wstring& a_Extension,
                          std::wstring& a_FileName);
   void OnSetClipboard(const std::wstring& a_Text);
+  void OnFilterSamplingReport(const std::wstring& a_Filter);
   void ParseCommandlineArguments();
   bool IsHeadless() { return m_Headless; }
   void PostInit();
@@ -45,6 +60,7 @@ class OrbitMainWindow : public QMainWindow {
                         const std::wstring& a_Dir,
                         const std::wstring& a_Filter);
   void OpenDisassembly(const std::wstring& a_String);
+  void AppendDisassembly(const std::wstring& a_String);
   void SetTitle(const std::string& a_Title);
 
  private slots:
@@ -99,6 +115,8 @@ class OrbitMainWindow : public QMainWindow {
   QApplication* m_App;
   Ui::OrbitMainWindow* ui;
   QTimer* m_MainTimer;
+  // Since the last frame scheduled by OnTimer.
+  QElapsedTimer m_FrameTimer;
   std::vector<OrbitGLWidget*> m_GlWidgets;
   bool m_Headless;
 
@@ -112,10 +130,22 @@ class OrbitMainWindow : public QMainWindow {
   class OrbitSamplingReport* m_SelectionReport;
   class QGridLayout* m_SelectionLayout;
 
+  // off-cpu tab
+  class QWidget* m_OffCpuTab;
+  class OrbitSamplingReport* m_OffCpuReport;
+  class QGridLayout* m_OffCpuLayout;
+
+  // page faults tab
+  class QWidget* m_PageFaultTab;
+  class OrbitSamplingReport* m_PageFaultReport;
+  class QGridLayout* m_PageFaultLayout;
+
   // Rule editor
   class OrbitVisualizer* m_RuleEditor;
 
   class OutputDialog* m_OutputDialog;
+  // Dialog of the disassembly being streamed, null once it is closed.
+  QPointer<class OrbitDisassemblyDialog> m_DisassemblyDialog;
   std::string m_CurrentPdbName;
   bool m_IsDev;
 };
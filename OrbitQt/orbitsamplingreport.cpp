@@ -60,12 +60,20 @@ void OrbitSamplingReport::Initialize(std::shared_ptr<SamplingReport> a_Report) {
         QHeaderView::ResizeToContents);
 
     treeView->Link(ui->CallstackTreeView);
+    m_ThreadPanels.push_back(treeView);
 
     QString threadName = QString::fromStdWString(report->GetName());
     ui->tabWidget->addTab(tab, threadName);
   }
 }
 
+//-----------------------------------------------------------------------------
+void OrbitSamplingReport::SetFilter(const QString& a_Filter) {
+  for (OrbitDataViewPanel* panel : m_ThreadPanels) {
+    panel->SetFilter(a_Filter);
+  }
+}
+
 //-----------------------------------------------------------------------------
 void OrbitSamplingReport::on_NextCallstackButton_clicked() {
   assert(m_SamplingReport);
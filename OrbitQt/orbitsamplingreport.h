@@ -5,6 +5,7 @@
 
 #include <QWidget>
 #include <memory>
+#include <vector>
 
 namespace Ui {
 class OrbitSamplingReport;
@@ -18,6 +19,8 @@ class OrbitSamplingReport : public QWidget {
   ~OrbitSamplingReport();
 
   void Initialize(std::shared_ptr<class SamplingReport> a_Report);
+  // Filters the reports of all threads.
+  void SetFilter(const QString& a_Filter);
 
  protected:
   void Refresh();
@@ -29,4 +32,5 @@ class OrbitSamplingReport : public QWidget {
  private:
   Ui::OrbitSamplingReport* ui;
   std::shared_ptr<SamplingReport> m_SamplingReport;
+  std::vector<class OrbitDataViewPanel*> m_ThreadPanels;
 };
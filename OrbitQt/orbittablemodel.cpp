@@ -9,6 +9,9 @@
 
 #define UNUSED(x) (void)(x)
 
+// Rows whose display strings are kept at most, a few screens' worth.
+static const size_t kMaxNumCachedRows = 1024;
+
 //-----------------------------------------------------------------------------
 OrbitTableModel::OrbitTableModel(DataViewType a_Type, QObject* parent)
     : QAbstractTableModel(parent),
@@ -24,7 +27,9 @@ OrbitTableModel::OrbitTableModel(DataViewType a_Type, QObject* parent)
 
 //-----------------------------------------------------------------------------
 OrbitTableModel::OrbitTableModel(QObject* parent)
-    : QAbstractTableModel(parent), m_DataView(nullptr) {}
+    : QAbstractTableModel(parent),
+      m_DataView(nullptr),
+      m_AlternateRowColor(true) {}
 
 //-----------------------------------------------------------------------------
 OrbitTableModel::~OrbitTableModel() {}
@@ -64,8 +69,7 @@ QVariant OrbitTableModel::headerData(int section, Qt::Orientation orientation,
 //-----------------------------------------------------------------------------
 QVariant OrbitTableModel::data(const QModelIndex& index, int role) const {
   if (role == Qt::DisplayRole) {
-    return QVariant(QString::fromStdWString(
-        m_DataView->GetValue(index.row(), index.column()).c_str()));
+    return GetDisplayString(index);
   } else if (role == Qt::BackgroundRole) {
     if (m_AlternateRowColor) {
       if (index.row() & 1)
@@ -90,17 +94,44 @@ QVariant OrbitTableModel::data(const QModelIndex& index, int role) const {
   return QVariant();
 }
 
+//-----------------------------------------------------------------------------
+const QString& OrbitTableModel::GetDisplayString(
+    const QModelIndex& index) const {
+  auto it = m_DisplayStrings.find(index.row());
+  if (it == m_DisplayStrings.end()) {
+    if (m_DisplayStrings.size() >= kMaxNumCachedRows) {
+      m_DisplayStrings.clear();
+    }
+    // All the columns of a row are painted together.
+    std::vector<QString> values(columnCount());
+    for (int column = 0; column < (int)values.size(); ++column) {
+      values[column] = QString::fromStdWString(
+          m_DataView->GetValue(index.row(), column));
+    }
+    it = m_DisplayStrings.emplace(index.row(), std::move(values)).first;
+  }
+
+  static const QString empty;
+  const std::vector<QString>& values = it->second;
+  return index.column() < (int)values.size() ? values[index.column()] : empty;
+}
+
 //-----------------------------------------------------------------------------
 void OrbitTableModel::sort(int column, Qt::SortOrder /*order*/) {
   m_DataView->OnSort(column, true);
+  Invalidate();
 }
 
 //-----------------------------------------------------------------------------
-void OrbitTableModel::OnTimer() { m_DataView->OnTimer(); }
+void OrbitTableModel::OnTimer() {
+  m_DataView->OnTimer();
+  Invalidate();
+}
 
 //-----------------------------------------------------------------------------
 void OrbitTableModel::OnFilter(const QString& a_Filter) {
   m_DataView->SetFilter(a_Filter.toStdWString());
+  Invalidate();
 }
 
 //-----------------------------------------------------------------------------
@@ -4,7 +4,10 @@
 #pragma once
 
 #include <QAbstractTableModel>
+#include <QString>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "../OrbitGl/DataView.h"
 
@@ -30,13 +33,25 @@ class OrbitTableModel : public QAbstractTableModel {
     return createIndex(a_Row, a_Column);
   }
   std::shared_ptr<DataView> GetDataView() { return m_DataView; }
-  void SetDataView(std::shared_ptr<DataView> a_Model) { m_DataView = a_Model; }
+  void SetDataView(std::shared_ptr<DataView> a_Model) {
+    m_DataView = a_Model;
+    Invalidate();
+  }
+  // Drops the strings formatted for display, to call when the rows, their
+  // order or their values changed.
+  void Invalidate() { m_DisplayStrings.clear(); }
 
   void OnTimer();
   void OnFilter(const QString& a_Filter);
   void OnClicked(const QModelIndex& index);
 
  protected:
+  const QString& GetDisplayString(const QModelIndex& index) const;
+
   std::shared_ptr<DataView> m_DataView;
   bool m_AlternateRowColor;
+  // Display strings of the rows painted since the last Invalidate, by row.
+  // The view only asks for the rows it paints: rows off screen are never
+  // formatted, and painting a row again doesn't format it again.
+  mutable std::unordered_map<int, std::vector<QString>> m_DisplayStrings;
 };
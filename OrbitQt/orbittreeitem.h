@@ -2,6 +2,7 @@
 
 #include <QList>
 #include <QVariant>
+#include <cstdint>
 
 class OrbitTreeItem {
  public:
@@ -21,10 +22,16 @@ class OrbitTreeItem {
   bool MatchesFilter() const { return m_MatchesFilter; }
   void SetVisibleRecursive(bool a_Visible);
   void SetMatchRecursive(bool a_Match);
+  void SetMatch(bool a_Match) { m_MatchesFilter = a_Match; }
   void SetParentsVisible(bool a_Visible);
   void Filter(const std::wstring& a_Filter);
   void FilterRecursive(const std::wstring& a_Filter);
   bool Contains(const std::wstring& a_Filter);
+  // For the items of a tree loaded lazily, see OrbitTreeModel::ChildLoader.
+  uint64_t GetId() const { return m_Id; }
+  void SetId(uint64_t a_Id) { m_Id = a_Id; }
+  bool HasUnloadedChildren() const { return m_HasUnloadedChildren; }
+  void SetHasUnloadedChildren(bool a_Value) { m_HasUnloadedChildren = a_Value; }
 
  private:
   QList<OrbitTreeItem*> m_childItems;
@@ -32,4 +39,6 @@ class OrbitTreeItem {
   OrbitTreeItem* m_parentItem;
   bool m_IsVisible;
   bool m_MatchesFilter;
+  uint64_t m_Id = 0;
+  bool m_HasUnloadedChildren = false;
 };
\ No newline at end of file
@@ -13,7 +13,125 @@ OrbitTreeModel::OrbitTreeModel(const QString& data, QObject* parent)
   setupModelData(data.split(QString("\n")), rootItem);
 }
 
-OrbitTreeModel::~OrbitTreeModel() { delete rootItem; }
+OrbitTreeModel::OrbitTreeModel(const QStringList& a_Headers,
+                               ChildLoader a_Loader, QObject* parent)
+    : QAbstractItemModel(parent), m_Loader(std::move(a_Loader)) {
+  for (const QString& header : a_Headers) {
+    m_Headers << header;
+  }
+  rootItem = new OrbitTreeItem(m_Headers);
+  rootItem->SetHasUnloadedChildren(true);
+}
+
+OrbitTreeModel::~OrbitTreeModel() {
+  if (m_SearchThread.joinable()) {
+    m_SearchThread.join();
+  }
+  delete rootItem;
+}
+
+OrbitTreeItem* OrbitTreeModel::GetItem(const QModelIndex& index) const {
+  return index.isValid() ? static_cast<OrbitTreeItem*>(index.internalPointer())
+                         : rootItem;
+}
+
+bool OrbitTreeModel::hasChildren(const QModelIndex& parent) const {
+  if (parent.column() > 0) return false;
+  OrbitTreeItem* item = GetItem(parent);
+  return item->childCount() > 0 || item->HasUnloadedChildren();
+}
+
+bool OrbitTreeModel::canFetchMore(const QModelIndex& parent) const {
+  return GetItem(parent)->HasUnloadedChildren();
+}
+
+void OrbitTreeModel::fetchMore(const QModelIndex& parent) {
+  OrbitTreeItem* item = GetItem(parent);
+  if (!item->HasUnloadedChildren() || !m_Loader) return;
+  item->SetHasUnloadedChildren(false);
+
+  std::vector<LazyItem> children = m_Loader(item->GetId());
+  if (children.empty()) return;
+  beginInsertRows(parent, 0, static_cast<int>(children.size()) - 1);
+  for (LazyItem& child : children) {
+    OrbitTreeItem* childItem = new OrbitTreeItem(child.m_Data, item);
+    childItem->SetId(child.m_Id);
+    childItem->SetHasUnloadedChildren(child.m_HasChildren);
+    item->appendChild(childItem);
+  }
+  endInsertRows();
+}
+
+void OrbitTreeModel::FilterInBackground(PathSearch a_Search) {
+  uint64_t generation = ++m_SearchGeneration;
+  if (m_SearchThread.joinable()) {
+    m_SearchThread.join();
+  }
+  m_SearchThread = std::thread([this, generation, a_Search]() {
+    std::vector<std::vector<uint64_t>> paths = a_Search();
+    if (generation != m_SearchGeneration) return;
+    // Queued to the thread of the model, which joins this one before it is
+    // destroyed.
+    QMetaObject::invokeMethod(
+        this,
+        [this, generation, paths]() { OnPathsFound(generation, paths); },
+        Qt::QueuedConnection);
+  });
+}
+
+void OrbitTreeModel::OnPathsFound(
+    uint64_t a_Generation, const std::vector<std::vector<uint64_t>>& a_Paths) {
+  if (a_Generation != m_SearchGeneration) return;
+  for (const QPersistentModelIndex& match : m_Matches) {
+    if (!match.isValid()) continue;
+    static_cast<OrbitTreeItem*>(match.internalPointer())->SetMatch(false);
+    emit dataChanged(match, match.sibling(match.row(), columnCount() - 1));
+  }
+  m_Matches.clear();
+
+  // Only the items along the paths are loaded.
+  QList<QModelIndex> matches;
+  for (const std::vector<uint64_t>& path : a_Paths) {
+    QModelIndex parent;
+    OrbitTreeItem* item = rootItem;
+    for (uint64_t id : path) {
+      if (canFetchMore(parent)) {
+        fetchMore(parent);
+      }
+      OrbitTreeItem* child = nullptr;
+      for (int i = 0; i < item->childCount(); ++i) {
+        if (item->child(i)->GetId() == id) {
+          child = item->child(i);
+          break;
+        }
+      }
+      // Loaded before the path was added to the tree.
+      if (child == nullptr) {
+        item = nullptr;
+        break;
+      }
+      item = child;
+      parent = createIndex(item->row(), 0, item);
+    }
+    if (item != nullptr && item != rootItem) {
+      item->SetMatch(true);
+      emit dataChanged(parent, parent.sibling(parent.row(), columnCount() - 1));
+      m_Matches << parent;
+      matches << parent;
+    }
+  }
+  emit FilterFinished(matches);
+}
+
+void OrbitTreeModel::Reload() {
+  if (!m_Loader) return;
+  beginResetModel();
+  m_Matches.clear();
+  delete rootItem;
+  rootItem = new OrbitTreeItem(m_Headers);
+  rootItem->SetHasUnloadedChildren(true);
+  endResetModel();
+}
 
 int OrbitTreeModel::columnCount(const QModelIndex& parent) const {
   if (parent.isValid())
@@ -2,7 +2,13 @@
 
 #include <QAbstractItemModel>
 #include <QModelIndex>
+#include <QList>
 #include <QVariant>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
 
 class OrbitTreeItem;
 
@@ -10,7 +16,23 @@ class OrbitTreeModel : public QAbstractItemModel {
   Q_OBJECT
 
  public:
+  // An item of a tree loaded lazily, and whether it has children to load.
+  struct LazyItem {
+    uint64_t m_Id;
+    QList<QVariant> m_Data;
+    bool m_HasChildren;
+  };
+  // The children of the item a_Id, 0 for the top level items.
+  using ChildLoader = std::function<std::vector<LazyItem>(uint64_t a_Id)>;
+  // The paths to the matching items, as the ids from a top level item down
+  // to the match. Run on a background thread.
+  using PathSearch = std::function<std::vector<std::vector<uint64_t>>()>;
+
   explicit OrbitTreeModel(const QString& data, QObject* parent = 0);
+  // A tree whose children are loaded with a_Loader as their parent is first
+  // expanded, so that only the expanded part of a large tree is built.
+  OrbitTreeModel(const QStringList& a_Headers, ChildLoader a_Loader,
+                 QObject* parent = 0);
   ~OrbitTreeModel();
 
   QVariant data(const QModelIndex& index, int role) const override;
@@ -22,11 +44,33 @@ class OrbitTreeModel : public QAbstractItemModel {
   QModelIndex parent(const QModelIndex& index) const override;
   int rowCount(const QModelIndex& parent = QModelIndex()) const override;
   int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+  bool hasChildren(const QModelIndex& parent = QModelIndex()) const override;
+  bool canFetchMore(const QModelIndex& parent) const override;
+  void fetchMore(const QModelIndex& parent) override;
 
   void Filter(const std::wstring& a_Filter);
+  // Of a lazily loaded tree, runs a_Search in the background, then loads the
+  // paths found and highlights their matches. Replaces any search running.
+  void FilterInBackground(PathSearch a_Search);
+  // Of a lazily loaded tree, drops the items loaded, to load them again as
+  // they are expanded, e.g. as the tree changed.
+  void Reload();
+
+ signals:
+  // The matches of FilterInBackground, e.g. to be expanded to.
+  void FilterFinished(const QList<QModelIndex>& a_Matches);
 
  private:
+  void OnPathsFound(uint64_t a_Generation,
+                    const std::vector<std::vector<uint64_t>>& a_Paths);
   void setupModelData(const QStringList& lines, OrbitTreeItem* parent);
+  OrbitTreeItem* GetItem(const QModelIndex& index) const;
 
   OrbitTreeItem* rootItem;
+  QList<QVariant> m_Headers;
+  ChildLoader m_Loader;
+  std::thread m_SearchThread;
+  // Of the last search, to drop the results of those it replaced.
+  std::atomic<uint64_t> m_SearchGeneration{0};
+  QList<QPersistentModelIndex> m_Matches;
 };
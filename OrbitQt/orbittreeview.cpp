@@ -85,6 +85,12 @@ void OrbitTreeView::SetDataModel(std::shared_ptr<DataView> a_Model) {
   m_Model = new OrbitTableModel();
   m_Model->SetDataView(a_Model);
   setModel(m_Model);
+
+  if (m_Model->GetUpdatePeriodMs() > 0 && m_Timer == nullptr) {
+    m_Timer = new QTimer(this);
+    connect(m_Timer, SIGNAL(timeout()), this, SLOT(OnTimer()));
+    m_Timer->start(m_Model->GetUpdatePeriodMs());
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -126,6 +132,7 @@ void OrbitTreeView::OnClicked(const QModelIndex& index) {
 //-----------------------------------------------------------------------------
 void OrbitTreeView::Refresh() {
   QModelIndexList list = selectionModel()->selectedIndexes();
+  m_Model->Invalidate();
 
   if (this->m_Model->GetDataView()->GetType() == DataViewType::LIVEFUNCTIONS) {
     m_Model->layoutAboutToBeChanged();
@@ -163,6 +170,20 @@ void OrbitTreeView::resizeEvent(QResizeEvent* event) {
   QTreeView::resizeEvent(event);
 }
 
+//-----------------------------------------------------------------------------
+void OrbitTreeView::showEvent(QShowEvent* event) {
+  if (m_Model && m_Model->GetDataView()) {
+    // Data views may only fill in their data once shown.
+    size_t numElements = m_Model->GetDataView()->GetNumElements();
+    m_Model->GetDataView()->OnShown();
+    if (m_Model->GetDataView()->GetNumElements() != numElements) {
+      Refresh();
+    }
+  }
+
+  QTreeView::showEvent(event);
+}
+
 //-----------------------------------------------------------------------------
 void OrbitTreeView::Link(OrbitTreeView* a_Link) {
   m_Links.push_back(a_Link);
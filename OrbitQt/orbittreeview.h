@@ -23,6 +23,7 @@ class OrbitTreeView : public QTreeView {
   void SetGlWidget(OrbitGLWidget* a_Link);
   void resizeEvent(QResizeEvent* event) override;
   void keyPressEvent(QKeyEvent* event) override;
+  void showEvent(QShowEvent* event) override;
   OrbitTableModel* GetModel() { return m_Model; }
   std::wstring GetLabel();
 
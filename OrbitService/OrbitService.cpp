@@ -5,6 +5,7 @@
 #include "Capture.h"
 #include "ConnectionManager.h"
 #include "Core.h"
+#include "KernelSymbols.h"
 #include "TimerManager.h"
 #include "TcpServer.h"
 
@@ -16,6 +17,9 @@ OrbitService::OrbitService() {
 
   GTcpServer->Start(Capture::GCapturePort);
   ConnectionManager::Get().InitAsService();
+
+  // Rather than with the first kernel frame of a capture.
+  KernelSymbols::Get();
 }
 
 void OrbitService::Run() {
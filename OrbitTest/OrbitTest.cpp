@@ -1,6 +1,10 @@
 #include "OrbitTest.h"
 
 #include <stdio.h>
+#if __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #include <chrono>
 #include <iostream>
@@ -29,17 +33,18 @@ void SetThreadName(const std::string& a_Name) {
 
 //-----------------------------------------------------------------------------
 OrbitTest::OrbitTest(uint32_t num_threads, uint32_t recurse_depth,
-                     uint32_t sleep_us)
+                     uint32_t sleep_us, uint32_t mmaps_per_s)
     : num_threads_(num_threads),
       recurse_depth_(recurse_depth),
-      sleep_us_(sleep_us) {}
+      sleep_us_(sleep_us),
+      mmaps_per_s_(mmaps_per_s) {}
 
 //-----------------------------------------------------------------------------
 OrbitTest::~OrbitTest() {
   m_ExitRequested = true;
 
-  for (uint32_t i = 0; i < num_threads_; ++i) {
-    m_Threads[i]->join();
+  for (const std::shared_ptr<std::thread>& thread : m_Threads) {
+    thread->join();
   }
 }
 
@@ -47,11 +52,16 @@ OrbitTest::~OrbitTest() {
 void OrbitTest::Start() {
   std::cout << "Starting OrbitTest num_threads: " << num_threads_
             << " recurse_depth: " << recurse_depth_
-            << " sleep_us: " << sleep_us_ << std::endl;
+            << " sleep_us: " << sleep_us_ << " mmaps_per_s: " << mmaps_per_s_
+            << std::endl;
   for (uint32_t i = 0; i < num_threads_; ++i) {
     auto thread = std::make_shared<std::thread>(&OrbitTest::Loop, this);
     m_Threads.push_back(thread);
   }
+  if (mmaps_per_s_ > 0) {
+    m_Threads.push_back(
+        std::make_shared<std::thread>(&OrbitTest::MmapLoop, this));
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -63,6 +73,22 @@ void OrbitTest::Loop() {
   }
 }
 
+//-----------------------------------------------------------------------------
+void OrbitTest::MmapLoop() {
+#if __linux__
+  SetThreadName("OrbitMmapChurn");
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  auto period = std::chrono::microseconds(1'000'000 / mmaps_per_s_);
+  while (!m_ExitRequested) {
+    // Only executable mappings are reported to the service.
+    void* page = mmap(nullptr, page_size, PROT_READ | PROT_EXEC,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (page != MAP_FAILED) munmap(page, page_size);
+    std::this_thread::sleep_for(period);
+  }
+#endif
+}
+
 //-----------------------------------------------------------------------------
 void NO_INLINE OrbitTest::TestFunc(uint32_t a_Depth) {
   if (a_Depth == recurse_depth_) return;
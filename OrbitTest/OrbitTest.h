@@ -6,13 +6,17 @@
 class OrbitTest {
  public:
   OrbitTest() = default;
-  OrbitTest(uint32_t num_threads, uint32_t recurse_depth, uint32_t sleep_us);
+  // With mmaps_per_s, another thread maps and unmaps an executable page at
+  // that rate, which the service has to follow to unwind callstacks.
+  OrbitTest(uint32_t num_threads, uint32_t recurse_depth, uint32_t sleep_us,
+            uint32_t mmaps_per_s = 0);
   ~OrbitTest();
 
   void Start();
 
  private:
   void Loop();
+  void MmapLoop();
   void TestFunc(uint32_t a_Depth = 0);
   void TestFunc2(uint32_t a_Depth = 0);
   void BusyWork(uint64_t microseconds);
@@ -23,4 +27,5 @@ class OrbitTest {
   uint32_t num_threads_ = 10;
   uint32_t recurse_depth_ = 10;
   uint32_t sleep_us_ = 100'000;
+  uint32_t mmaps_per_s_ = 0;
 };
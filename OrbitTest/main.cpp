@@ -5,11 +5,13 @@
 
 int main(int argc, char* argv[]) {
   std::unique_ptr<OrbitTest> test;
-  if (argc == 4) {
+  if (argc == 4 || argc == 5) {
     uint32_t num_threads = std::stoul(argv[1]);
     uint32_t recurse_depth = std::stoul(argv[2]);
     uint32_t sleep_us = std::stoul(argv[3]);
-    test = std::make_unique<OrbitTest>(num_threads, recurse_depth, sleep_us);
+    uint32_t mmaps_per_s = argc == 5 ? std::stoul(argv[4]) : 0;
+    test = std::make_unique<OrbitTest>(num_threads, recurse_depth, sleep_us,
+                                       mmaps_per_s);
   } else {
     test = std::make_unique<OrbitTest>();
   }
@@ -42,6 +42,7 @@ class OrbitConan(ConanFile):
         self.requires("gtest/1.8.1@bincrafters/stable")
         self.requires("libcurl/7.66.0")
         self.requires("llvm_object/9.0.1@orbitdeps/stable")
+        self.requires("llvm_debuginfo_dwarf/9.0.1@orbitdeps/stable")
         self.requires("openssl/1.1.1d@{}".format(self._orbit_channel))
         if self.settings.os != "Windows":
             self.requires(